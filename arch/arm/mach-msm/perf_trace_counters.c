@@ -22,6 +22,7 @@ DEFINE_PER_CPU(unsigned long, l2_enmask);
 DEFINE_PER_CPU(u32, previous_ccnt);
 DEFINE_PER_CPU(u32[NUM_L1_CTRS], previous_l1_cnts);
 DEFINE_PER_CPU(u32[NUM_L2_PERCPU], previous_l2_cnts);
+DEFINE_PER_CPU(u32[NUM_L1_CTRS], previous_l1_evts);
 DEFINE_PER_CPU(u32, old_pid);
 DEFINE_PER_CPU(u32, hotplug_flag);
 /* Reset per_cpu variables that store counter values uppn CPU hotplug */
@@ -60,9 +61,44 @@ static void setup_prev_cnts(u32 cpu, u32 cnten_val)
 			asm volatile("mrc p15, 0, %0, c9, c13, 2"
 				: "=r"(per_cpu(previous_l1_cnts[i], cpu)));
 		}
+		/* Force the event selection to be traced again */
+		per_cpu(previous_l1_evts[i], cpu) = ~0;
 	}
 }
 
+/*
+ * The counter deltas in sched_switch_with_ctrs only make sense together
+ * with the events perf has programmed, e.g. L2 refills, bus accesses or
+ * store buffer stalls on Cortex-A7.  Emit the selection whenever it
+ * changes on this CPU so that traces are self-describing.
+ */
+static void trace_ctrs_cfg(u32 cpu, u32 cnten_val)
+{
+	u32 evts[NUM_L1_CTRS];
+	bool changed = false;
+	int i;
+
+	for (i = 0; i < NUM_L1_CTRS; i++) {
+		evts[i] = 0;
+		if (cnten_val & (1 << i)) {
+			/* Select */
+			asm volatile("mcr p15, 0, %0, c9, c12, 5"
+				: : "r"(i));
+			/* Read event type */
+			asm volatile("mrc p15, 0, %0, c9, c13, 1"
+				: "=r"(evts[i]));
+			evts[i] &= 0xff;
+		}
+		if (evts[i] != per_cpu(previous_l1_evts[i], cpu)) {
+			per_cpu(previous_l1_evts[i], cpu) = evts[i];
+			changed = true;
+		}
+	}
+
+	if (changed)
+		trace_sched_switch_ctrs_cfg(cpu, cnten_val, evts);
+}
+
 static int tracectr_notifier(struct notifier_block *self, unsigned long cmd,
 		void *v)
 {
@@ -92,6 +128,14 @@ static int tracectr_notifier(struct notifier_block *self, unsigned long cmd,
 		if (per_cpu(hotplug_flag, cpu) == 1) {
 			per_cpu(hotplug_flag, cpu) = 0;
 			setup_prev_cnts(cpu, cnten_val);
+		} else if (!IS_ENABLED(CONFIG_ARCH_MSM_KRAIT)) {
+			/*
+			 * Cortex-A7 has no separate L2 PMU, L2 and bus
+			 * events are counted by the CPU counters above.
+			 */
+			trace_ctrs_cfg(cpu, cnten_val);
+			trace_sched_switch_with_ctrs(per_cpu(old_pid, cpu),
+				current_pid);
 		} else {
 			/* check # L2 counters */
 			val = get_l2_indirect_reg(L2PMCR);
@@ -113,6 +157,7 @@ static int tracectr_notifier(struct notifier_block *self, unsigned long cmd,
 					per_cpu(l2_enmask, cpu) |= bit;
 				}
 			}
+			trace_ctrs_cfg(cpu, cnten_val);
 			trace_sched_switch_with_ctrs(per_cpu(old_pid, cpu),
 				current_pid);
 			/* Enable L2*/
@@ -206,8 +251,11 @@ int __init init_tracecounters(void)
 		return -ENOMEM;
 	}
 	register_cpu_notifier(&tracectr_cpu_hotplug_notifier_block);
-	for_each_possible_cpu(cpu)
+	for_each_possible_cpu(cpu) {
 		per_cpu(old_pid, cpu) = -1;
+		memset(per_cpu(previous_l1_evts, cpu), 0xff,
+			sizeof(per_cpu(previous_l1_evts, cpu)));
+	}
 	return 0;
 }
 
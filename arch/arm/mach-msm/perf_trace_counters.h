@@ -36,6 +36,7 @@ DECLARE_PER_CPU(unsigned long, l2_enmask);
 DECLARE_PER_CPU(u32, previous_ccnt);
 DECLARE_PER_CPU(u32[NUM_L1_CTRS], previous_l1_cnts);
 DECLARE_PER_CPU(u32[NUM_L2_PERCPU], previous_l2_cnts);
+DECLARE_PER_CPU(u32[NUM_L1_CTRS], previous_l1_evts);
 TRACE_EVENT(sched_switch_with_ctrs,
 
 		TP_PROTO(pid_t prev, pid_t next),
@@ -70,8 +71,11 @@ TRACE_EVENT(sched_switch_with_ctrs,
 			__entry->old_pid	= prev;
 			__entry->new_pid	= next;
 
-			val = get_l2_indirect_reg(L2PMCR);
-			num_l2ctrs = ((val >> 11) & 0x1f) + 1;
+			num_l2ctrs = 0;
+			if (IS_ENABLED(CONFIG_ARCH_MSM_KRAIT)) {
+				val = get_l2_indirect_reg(L2PMCR);
+				num_l2ctrs = ((val >> 11) & 0x1f) + 1;
+			}
 
 			cnten_val = per_cpu(cntenset_val, cpu);
 			if (cnten_val & CC) {
@@ -136,6 +140,36 @@ TRACE_EVENT(sched_switch_with_ctrs,
 				__entry->lctr0, __entry->lctr1)
 );
 
+TRACE_EVENT(sched_switch_ctrs_cfg,
+
+		TP_PROTO(u32 cpu, u32 cnten, u32 *evts),
+
+		TP_ARGS(cpu, cnten, evts),
+
+		TP_STRUCT__entry(
+			__field(u32, cpu)
+			__field(u32, cnten)
+			__field(u32, evt0)
+			__field(u32, evt1)
+			__field(u32, evt2)
+			__field(u32, evt3)
+		),
+
+		TP_fast_assign(
+			__entry->cpu	= cpu;
+			__entry->cnten	= cnten;
+			__entry->evt0	= evts[0];
+			__entry->evt1	= evts[1];
+			__entry->evt2	= evts[2];
+			__entry->evt3	= evts[3];
+		),
+
+		TP_printk("cpu=%u, CNTEN: %#x, EVT0: %#x, EVT1: %#x, EVT2: %#x, EVT3: %#x",
+				__entry->cpu, __entry->cnten,
+				__entry->evt0, __entry->evt1,
+				__entry->evt2, __entry->evt3)
+);
+
 #endif
 #undef TRACE_INCLUDE_PATH
 #define TRACE_INCLUDE_PATH ../../arch/arm/mach-msm
@@ -26,6 +26,7 @@
 #include <linux/compiler.h>
 #include <linux/blktrace_api.h>
 #include <linux/hrtimer.h>
+#include "blk-cgroup.h"
 
 /*
  * enum row_queue_prio - Priorities of the ROW queues
@@ -64,18 +65,21 @@ enum row_queue_prio {
  *			in a dispatch cycle
  * @is_urgent: Flags indicating whether the queue can notify on
  *			urgent requests
+ * @target_lat_ms: Completion latency (msec) the queue should stay
+ *			under in latency target mode
  *
  */
 struct row_queue_params {
 	bool idling_enabled;
 	int quantum;
 	bool is_urgent;
+	int target_lat_ms;
 };
 
 /*
  * This array holds the default values of the different configurables
  * for each ROW queue. Each row of the array holds the following values:
- * {idling_enabled, quantum, is_urgent}
+ * {idling_enabled, quantum, is_urgent, target_lat_ms}
  * Each row corresponds to a queue with the same index (according to
  * enum row_queue_prio)
  * Note: The quantums are valid inside their priority type. For example:
@@ -85,20 +89,39 @@ struct row_queue_params {
  *       be dispatched.
  */
 static const struct row_queue_params row_queues_def[] = {
-/* idling_enabled, quantum, is_urgent */
-	{true, 10, true},	/* ROWQ_PRIO_HIGH_READ */
-	{false, 1, false},	/* ROWQ_PRIO_HIGH_SWRITE */
-	{true, 100, true},	/* ROWQ_PRIO_REG_READ */
-	{false, 1, false},	/* ROWQ_PRIO_REG_SWRITE */
-	{false, 1, false},	/* ROWQ_PRIO_REG_WRITE */
-	{false, 1, false},	/* ROWQ_PRIO_LOW_READ */
-	{false, 1, false}	/* ROWQ_PRIO_LOW_SWRITE */
+/* idling_enabled, quantum, is_urgent, target_lat_ms */
+	{true, 10, true, 20},		/* ROWQ_PRIO_HIGH_READ */
+	{false, 1, false, 100},		/* ROWQ_PRIO_HIGH_SWRITE */
+	{true, 100, true, 50},		/* ROWQ_PRIO_REG_READ */
+	{false, 1, false, 200},		/* ROWQ_PRIO_REG_SWRITE */
+	{false, 1, false, 1000},	/* ROWQ_PRIO_REG_WRITE */
+	{false, 1, false, 500},		/* ROWQ_PRIO_LOW_READ */
+	{false, 1, false, 1000}		/* ROWQ_PRIO_LOW_SWRITE */
 };
 
 /* Default values for idling on read queues (in msec) */
 #define ROW_IDLE_TIME_MSEC 5
 #define ROW_READ_FREQ_MSEC 5
 
+/*
+ * Latency target mode: the completion latency of each queue is averaged
+ * with a 1/ROW_LAT_EWMA_WEIGHT weight. A queue above its target gets its
+ * quantum doubled (up to ROW_LAT_MAX_BOOST times), a queue below half of
+ * its target gets it halved back towards the configured value.
+ */
+#define ROW_LAT_EWMA_WEIGHT	8
+#define ROW_LAT_MAX_BOOST	3
+#define ROW_MAX_TARGET_LAT_MSEC	10000
+
+/*
+ * Default blkio cgroup weights for cgroup classification: requests from
+ * a cgroup weighing at least ROW_FG_CGROUP_WEIGHT are foreground ones,
+ * requests from a cgroup weighing at most ROW_BG_CGROUP_WEIGHT are
+ * background ones.
+ */
+#define ROW_FG_CGROUP_WEIGHT	CFQ_WEIGHT_MAX
+#define ROW_BG_CGROUP_WEIGHT	100
+
 /**
  * struct rowq_idling_data -  parameters for idling on the queue
  * @last_insert_time:	time the last request was inserted
@@ -122,6 +145,10 @@ struct rowq_idling_data {
  * @dispatch quantum:	number of requests this queue may
  *			dispatch in a dispatch cycle
  * @idle_data:		data for idling on queues
+ * @target_lat_ms:	target completion latency (msec), 0 if none
+ * @lat_ewma_us:	average completion latency (usec)
+ * @lat_boost:		log2 of the factor the dispatch quantum is
+ *			currently scaled by in latency target mode
  *
  */
 struct row_queue {
@@ -136,6 +163,10 @@ struct row_queue {
 
 	/* used only for READ queues */
 	struct rowq_idling_data	idle_data;
+
+	int			target_lat_ms;
+	unsigned int		lat_ewma_us;
+	unsigned int		lat_boost;
 };
 
 /**
@@ -187,6 +218,11 @@ struct starvation_data {
  * @reg_prio_starvation: starvation data for REGULAR priority queues
  * @low_prio_starvation: starvation data for LOW priority queues
  * @cycle_flags:	used for marking unserved queueus
+ * @lat_target_mode:	adapt the quantums to the queues latency targets
+ * @lat_missed_flags:	used for marking queues above their latency target
+ * @cgroup_classify:	classify BE requests by their blkio cgroup weight
+ * @fg_cgroup_weight:	min weight of a foreground cgroup
+ * @bg_cgroup_weight:	max weight of a background cgroup
  *
  */
 struct row_data {
@@ -206,6 +242,13 @@ struct row_data {
 	struct starvation_data		low_prio_starvation;
 
 	unsigned int			cycle_flags;
+
+	int				lat_target_mode;
+	unsigned int			lat_missed_flags;
+
+	int				cgroup_classify;
+	int				fg_cgroup_weight;
+	int				bg_cgroup_weight;
 };
 
 #define RQ_ROWQ(rq) ((struct row_queue *) ((rq)->elv.priv[0]))
@@ -234,6 +277,37 @@ static inline int row_rowq_unserved(struct row_data *rd,
 	return rd->cycle_flags & (1 << qnum);
 }
 
+/*
+ * row_rowq_quantum() - Return the dispatch quantum of the queue, scaled
+ *			up if it misses its latency target
+ * @rqueue:	pointer to struct row_queue
+ */
+static inline int row_rowq_quantum(struct row_queue *rqueue)
+{
+	return rqueue->disp_quantum << rqueue->lat_boost;
+}
+
+/*
+ * row_lat_target_missed() - Check if a queue with pending requests in the
+ *			     given range is above its latency target
+ * @rd:		pointer to struct row_data
+ * @start_idx/end_idx: indexes in the row_queues array to check
+ */
+static inline bool row_lat_target_missed(struct row_data *rd,
+					 int start_idx, int end_idx)
+{
+	int i;
+
+	if (!rd->lat_target_mode)
+		return false;
+
+	for (i = start_idx; i < end_idx; i++)
+		if ((rd->lat_missed_flags & (1 << i)) &&
+		    !list_empty(&rd->row_queues[i].fifo))
+			return true;
+	return false;
+}
+
 static inline void __maybe_unused row_dump_queues_stat(struct row_data *rd)
 {
 	int i;
@@ -241,9 +315,10 @@ static inline void __maybe_unused row_dump_queues_stat(struct row_data *rd)
 	row_log(rd->dispatch_queue, " Queues status:");
 	for (i = 0; i < ROWQ_MAX_PRIO; i++)
 		row_log(rd->dispatch_queue,
-			"queue%d: dispatched= %d, nr_req=%d", i,
+			"queue%d: dispatched= %d, nr_req=%d, lat=%uus", i,
 			rd->row_queues[i].nr_dispatched,
-			rd->row_queues[i].nr_req);
+			rd->row_queues[i].nr_req,
+			rd->row_queues[i].lat_ewma_us);
 }
 
 /******************** Static helper functions ***********************/
@@ -449,10 +524,74 @@ static int row_reinsert_req(struct request_queue *q,
 	return 0;
 }
 
+/*
+ * row_update_lat() - Account the completion latency of a request and adapt
+ *		      the quantum of its queue to the queue latency target
+ * @rd:		pointer to struct row_data
+ * @rq:		the completed request
+ *
+ */
+static void row_update_lat(struct row_data *rd, struct request *rq)
+{
+	struct row_queue *rqueue = RQ_ROWQ(rq);
+	unsigned int lat_us, target_us;
+
+	if (!rqueue || rqueue->prio >= ROWQ_MAX_PRIO || !rqueue->target_lat_ms)
+		return;
+
+	target_us = rqueue->target_lat_ms * USEC_PER_MSEC;
+
+	lat_us = jiffies_to_usecs(jiffies - rq->start_time);
+	if (!rqueue->lat_ewma_us)
+		rqueue->lat_ewma_us = lat_us;
+	else
+		rqueue->lat_ewma_us = (rqueue->lat_ewma_us *
+			(ROW_LAT_EWMA_WEIGHT - 1) + lat_us) /
+			ROW_LAT_EWMA_WEIGHT;
+
+	if (rqueue->lat_ewma_us > target_us) {
+		rd->lat_missed_flags |= (1 << rqueue->prio);
+		if (rqueue->lat_boost < ROW_LAT_MAX_BOOST) {
+			rqueue->lat_boost++;
+			row_log_rowq(rd, rqueue->prio,
+				"above latency target (%uus), quantum=%d",
+				rqueue->lat_ewma_us, row_rowq_quantum(rqueue));
+		}
+	} else {
+		rd->lat_missed_flags &= ~(1 << rqueue->prio);
+		if (rqueue->lat_boost &&
+		    rqueue->lat_ewma_us < target_us / 2) {
+			rqueue->lat_boost--;
+			row_log_rowq(rd, rqueue->prio,
+				"below latency target (%uus), quantum=%d",
+				rqueue->lat_ewma_us, row_rowq_quantum(rqueue));
+		}
+	}
+}
+
+/*
+ * row_reset_lat() - Drop the latency history and quantum scaling
+ * @rd:		pointer to struct row_data
+ *
+ */
+static void row_reset_lat(struct row_data *rd)
+{
+	int i;
+
+	for (i = 0; i < ROWQ_MAX_PRIO; i++) {
+		rd->row_queues[i].lat_ewma_us = 0;
+		rd->row_queues[i].lat_boost = 0;
+	}
+	rd->lat_missed_flags = 0;
+}
+
 static void row_completed_req(struct request_queue *q, struct request *rq)
 {
 	struct row_data *rd = q->elevator->elevator_data;
 
+	if (rd->lat_target_mode)
+		row_update_lat(rd, rq);
+
 	 if (rq->cmd_flags & REQ_URGENT) {
 		if (!rd->urgent_in_flight) {
 			WARN_ON(1);
@@ -597,6 +736,16 @@ static int row_get_ioprio_class_to_serve(struct row_data *rd, int force)
 			    (rd->low_prio_starvation.starvation_counter >=
 			     rd->low_prio_starvation.starvation_limit))
 				ret = IOPRIO_CLASS_IDLE;
+			/*
+			 * In latency target mode a lower class above its
+			 * target is served first, as long as the high
+			 * priority queues meet theirs
+			 */
+			else if (!row_lat_target_missed(rd,
+					ROWQ_HIGH_PRIO_IDX, ROWQ_REG_PRIO_IDX) &&
+				 row_lat_target_missed(rd,
+					ROWQ_REG_PRIO_IDX, ROWQ_LOW_PRIO_IDX))
+				ret = IOPRIO_CLASS_BE;
 			else
 				ret = IOPRIO_CLASS_RT;
 
@@ -632,6 +781,11 @@ check_idling:
 			    (rd->low_prio_starvation.starvation_counter >=
 			     rd->low_prio_starvation.starvation_limit))
 				ret = IOPRIO_CLASS_IDLE;
+			else if (!row_lat_target_missed(rd,
+					ROWQ_REG_PRIO_IDX, ROWQ_LOW_PRIO_IDX) &&
+				 row_lat_target_missed(rd,
+					ROWQ_LOW_PRIO_IDX, ROWQ_MAX_PRIO))
+				ret = IOPRIO_CLASS_IDLE;
 			else
 				ret = IOPRIO_CLASS_BE;
 			goto done;
@@ -662,7 +816,7 @@ static void row_restart_cycle(struct row_data *rd,
 	row_dump_queues_stat(rd);
 	for (i = start_idx; i < end_idx; i++) {
 		if (rd->row_queues[i].nr_dispatched <
-		    rd->row_queues[i].disp_quantum)
+		    row_rowq_quantum(&rd->row_queues[i]))
 			row_mark_rowq_unserved(rd, i);
 		rd->row_queues[i].nr_dispatched = 0;
 	}
@@ -690,7 +844,7 @@ static int row_get_next_queue(struct request_queue *q, struct row_data *rd,
 	do {
 		if (list_empty(&rd->row_queues[i].fifo) ||
 		    rd->row_queues[i].nr_dispatched >=
-		    rd->row_queues[i].disp_quantum) {
+		    row_rowq_quantum(&rd->row_queues[i])) {
 			i++;
 			if (i == end_idx && restart) {
 				/* Restart cycle for this priority class */
@@ -810,6 +964,8 @@ static int row_init_queue(struct request_queue *q, struct elevator_type *e)
 		rdata->row_queues[i].idle_data.begin_idling = false;
 		rdata->row_queues[i].idle_data.last_insert_time =
 			ktime_set(0, 0);
+		rdata->row_queues[i].target_lat_ms =
+			row_queues_def[i].target_lat_ms;
 	}
 
 	rdata->reg_prio_starvation.starvation_limit =
@@ -828,6 +984,8 @@ static int row_init_queue(struct request_queue *q, struct elevator_type *e)
 	rdata->rd_idle_data.hr_timer.function = &row_idle_hrtimer_fn;
 
 	INIT_WORK(&rdata->rd_idle_data.idle_work, kick_queue);
+	rdata->fg_cgroup_weight = ROW_FG_CGROUP_WEIGHT;
+	rdata->bg_cgroup_weight = ROW_BG_CGROUP_WEIGHT;
 	rdata->last_served_ioprio_class = IOPRIO_CLASS_NONE;
 	rdata->rd_idle_data.idling_queue_idx = ROWQ_MAX_PRIO;
 	rdata->dispatch_queue = q;
@@ -880,6 +1038,62 @@ static void row_merged_requests(struct request_queue *q, struct request *rq,
 	rqueue->rdata->nr_reqs[rq_data_dir(rq)]--;
 }
 
+/*
+ * row_get_cgroup_weight() - Get the blkio cgroup weight of a request
+ * @bio:	bio the request is allocated for, may be NULL
+ *
+ * Return the weight of the cgroup the bio (or current task) belongs to,
+ * 0 if unknown.
+ *
+ */
+static int row_get_cgroup_weight(struct bio *bio)
+{
+	int weight = 0;
+#ifdef CONFIG_BLK_CGROUP
+	struct blkcg *blkcg;
+
+	rcu_read_lock();
+	blkcg = bio_blkcg(bio);
+	if (blkcg)
+		weight = blkcg->cfq_weight;
+	rcu_read_unlock();
+#endif
+	return weight;
+}
+
+/*
+ * row_get_cgroup_queue_prio() - Get queue priority for a BE request
+ *				 according to its blkio cgroup
+ * @bio:	bio the request is allocated for, may be NULL
+ * @rd:		pointer to struct row_data
+ * @q_type:	queue chosen by the request ioprio
+ *
+ * Reads of foreground cgroups are moved to the high priority read queue,
+ * reads and sync writes of background cgroups to the low priority queues.
+ * Async writes always stay on the regular write queue.
+ *
+ */
+static enum row_queue_prio row_get_cgroup_queue_prio(struct bio *bio,
+				struct row_data *rd, enum row_queue_prio q_type)
+{
+	int weight = row_get_cgroup_weight(bio);
+
+	if (!weight || q_type == ROWQ_PRIO_REG_WRITE)
+		return q_type;
+
+	if (weight >= rd->fg_cgroup_weight) {
+		if (q_type == ROWQ_PRIO_REG_READ)
+			q_type = ROWQ_PRIO_HIGH_READ;
+	} else if (weight <= rd->bg_cgroup_weight) {
+		if (q_type == ROWQ_PRIO_REG_READ)
+			q_type = ROWQ_PRIO_LOW_READ;
+		else
+			q_type = ROWQ_PRIO_LOW_SWRITE;
+	}
+
+	return q_type;
+}
+
 /*
  * row_get_queue_prio() - Get queue priority for a given request
  *
@@ -889,7 +1103,7 @@ static void row_merged_requests(struct request_queue *q, struct request *rq,
  *
  */
 static enum row_queue_prio row_get_queue_prio(struct request *rq,
-				struct row_data *rd)
+				struct bio *bio, struct row_data *rd)
 {
 	const int data_dir = rq_data_dir(rq);
 	const bool is_sync = rq_is_sync(rq);
@@ -928,6 +1142,8 @@ static enum row_queue_prio row_get_queue_prio(struct request *rq,
 			q_type = ROWQ_PRIO_REG_SWRITE;
 		else
 			q_type = ROWQ_PRIO_REG_WRITE;
+		if (rd->cgroup_classify)
+			q_type = row_get_cgroup_queue_prio(bio, rd, q_type);
 		break;
 	}
 
@@ -950,7 +1166,7 @@ row_set_request(struct request_queue *q, struct request *rq, struct bio *bio,
 
 	spin_lock_irqsave(q->queue_lock, flags);
 	rq->elv.priv[0] =
-		(void *)(&rd->row_queues[row_get_queue_prio(rq, rd)]);
+		(void *)(&rd->row_queues[row_get_queue_prio(rq, bio, rd)]);
 	spin_unlock_irqrestore(q->queue_lock, flags);
 
 	return 0;
@@ -997,6 +1213,24 @@ SHOW_FUNCTION(row_reg_starv_limit_show,
 	rowd->reg_prio_starvation.starvation_limit);
 SHOW_FUNCTION(row_low_starv_limit_show,
 	rowd->low_prio_starvation.starvation_limit);
+SHOW_FUNCTION(row_lat_target_mode_show, rowd->lat_target_mode);
+SHOW_FUNCTION(row_hp_read_target_lat_show,
+	rowd->row_queues[ROWQ_PRIO_HIGH_READ].target_lat_ms);
+SHOW_FUNCTION(row_rp_read_target_lat_show,
+	rowd->row_queues[ROWQ_PRIO_REG_READ].target_lat_ms);
+SHOW_FUNCTION(row_hp_swrite_target_lat_show,
+	rowd->row_queues[ROWQ_PRIO_HIGH_SWRITE].target_lat_ms);
+SHOW_FUNCTION(row_rp_swrite_target_lat_show,
+	rowd->row_queues[ROWQ_PRIO_REG_SWRITE].target_lat_ms);
+SHOW_FUNCTION(row_rp_write_target_lat_show,
+	rowd->row_queues[ROWQ_PRIO_REG_WRITE].target_lat_ms);
+SHOW_FUNCTION(row_lp_read_target_lat_show,
+	rowd->row_queues[ROWQ_PRIO_LOW_READ].target_lat_ms);
+SHOW_FUNCTION(row_lp_swrite_target_lat_show,
+	rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].target_lat_ms);
+SHOW_FUNCTION(row_cgroup_classify_show, rowd->cgroup_classify);
+SHOW_FUNCTION(row_fg_cgroup_weight_show, rowd->fg_cgroup_weight);
+SHOW_FUNCTION(row_bg_cgroup_weight_show, rowd->bg_cgroup_weight);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX)			\
@@ -1043,9 +1277,51 @@ STORE_FUNCTION(row_reg_starv_limit_store,
 STORE_FUNCTION(row_low_starv_limit_store,
 			&rowd->low_prio_starvation.starvation_limit,
 			1, INT_MAX);
+STORE_FUNCTION(row_hp_read_target_lat_store,
+			&rowd->row_queues[ROWQ_PRIO_HIGH_READ].target_lat_ms,
+			0, ROW_MAX_TARGET_LAT_MSEC);
+STORE_FUNCTION(row_rp_read_target_lat_store,
+			&rowd->row_queues[ROWQ_PRIO_REG_READ].target_lat_ms,
+			0, ROW_MAX_TARGET_LAT_MSEC);
+STORE_FUNCTION(row_hp_swrite_target_lat_store,
+			&rowd->row_queues[ROWQ_PRIO_HIGH_SWRITE].target_lat_ms,
+			0, ROW_MAX_TARGET_LAT_MSEC);
+STORE_FUNCTION(row_rp_swrite_target_lat_store,
+			&rowd->row_queues[ROWQ_PRIO_REG_SWRITE].target_lat_ms,
+			0, ROW_MAX_TARGET_LAT_MSEC);
+STORE_FUNCTION(row_rp_write_target_lat_store,
+			&rowd->row_queues[ROWQ_PRIO_REG_WRITE].target_lat_ms,
+			0, ROW_MAX_TARGET_LAT_MSEC);
+STORE_FUNCTION(row_lp_read_target_lat_store,
+			&rowd->row_queues[ROWQ_PRIO_LOW_READ].target_lat_ms,
+			0, ROW_MAX_TARGET_LAT_MSEC);
+STORE_FUNCTION(row_lp_swrite_target_lat_store,
+			&rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].target_lat_ms,
+			0, ROW_MAX_TARGET_LAT_MSEC);
+STORE_FUNCTION(row_cgroup_classify_store, &rowd->cgroup_classify, 0, 1);
+STORE_FUNCTION(row_fg_cgroup_weight_store, &rowd->fg_cgroup_weight,
+			CFQ_WEIGHT_MIN, CFQ_WEIGHT_MAX);
+STORE_FUNCTION(row_bg_cgroup_weight_store, &rowd->bg_cgroup_weight,
+			CFQ_WEIGHT_MIN, CFQ_WEIGHT_MAX);
 
 #undef STORE_FUNCTION
 
+static ssize_t row_lat_target_mode_store(struct elevator_queue *e,
+		const char *page, size_t count)
+{
+	struct row_data *rowd = e->elevator_data;
+	struct request_queue *q = rowd->dispatch_queue;
+	int __data;
+	int ret = row_var_store(&__data, (page), count);
+
+	spin_lock_irq(q->queue_lock);
+	rowd->lat_target_mode = !!__data;
+	row_reset_lat(rowd);
+	spin_unlock_irq(q->queue_lock);
+
+	return ret;
+}
+
 #define ROW_ATTR(name) \
 	__ATTR(name, S_IRUGO|S_IWUSR, row_##name##_show, \
 				      row_##name##_store)
@@ -1062,6 +1338,17 @@ static struct elv_fs_entry row_attrs[] = {
 	ROW_ATTR(rd_idle_data_freq),
 	ROW_ATTR(reg_starv_limit),
 	ROW_ATTR(low_starv_limit),
+	ROW_ATTR(lat_target_mode),
+	ROW_ATTR(hp_read_target_lat),
+	ROW_ATTR(rp_read_target_lat),
+	ROW_ATTR(hp_swrite_target_lat),
+	ROW_ATTR(rp_swrite_target_lat),
+	ROW_ATTR(rp_write_target_lat),
+	ROW_ATTR(lp_read_target_lat),
+	ROW_ATTR(lp_swrite_target_lat),
+	ROW_ATTR(cgroup_classify),
+	ROW_ATTR(fg_cgroup_weight),
+	ROW_ATTR(bg_cgroup_weight),
 	__ATTR_NULL
 };
 
@@ -28,6 +28,7 @@
 #include <linux/debugfs.h>
 #include <linux/test-iosched.h>
 #include <linux/delay.h>
+#include <linux/sort.h>
 #include "blk.h"
 
 #define MODULE_NAME "test-iosched"
@@ -141,10 +142,84 @@ static void end_test_req(struct request *rq, int err)
 
 	test_rq->req_completed = true;
 	test_rq->req_result = err;
+	test_iosched_account_lat(test_rq);
 
 	check_test_completion();
 }
 
+/**
+ * test_iosched_account_lat() - Add the completion latency of a
+ * test request to the test latency statistics
+ * @test_rq:	the completed test request
+ *
+ * Called from the request completion callback, with the queue
+ * lock held.
+ */
+void test_iosched_account_lat(struct test_request *test_rq)
+{
+	struct test_lat_stats *stats;
+	int dir;
+
+	if (!ptd || !test_rq->rq || !ktime_to_ns(test_rq->dispatch_time))
+		return;
+
+	stats = &ptd->lat_stats;
+	dir = rq_data_dir(test_rq->rq);
+	if (!stats->samples[dir] ||
+	    stats->nr_samples[dir] >= TEST_MAX_LAT_SAMPLES)
+		return;
+
+	stats->samples[dir][stats->nr_samples[dir]++] =
+		(u32)ktime_us_delta(ktime_get(), test_rq->dispatch_time);
+}
+EXPORT_SYMBOL(test_iosched_account_lat);
+
+static int cmp_lat_sample(const void *a, const void *b)
+{
+	u32 lhs = *(const u32 *)a;
+	u32 rhs = *(const u32 *)b;
+
+	if (lhs < rhs)
+		return -1;
+	return lhs > rhs;
+}
+
+/**
+ * test_iosched_get_lat_report() - Summarize the completion
+ * latency of the requests of the last test round
+ * @direction:	READ/WRITE
+ * @rep:	the summary to fill
+ *
+ * Must be called once the test is completed. Returns -ENODATA
+ * if no request of the given direction completed.
+ */
+int test_iosched_get_lat_report(int direction, struct test_lat_report *rep)
+{
+	struct test_lat_stats *stats;
+	unsigned int n;
+	u32 *samples;
+
+	if (!ptd)
+		return -ENODEV;
+
+	stats = &ptd->lat_stats;
+	samples = stats->samples[direction];
+	n = stats->nr_samples[direction];
+	memset(rep, 0, sizeof(*rep));
+	if (!samples || !n)
+		return -ENODATA;
+
+	sort(samples, n, sizeof(*samples), cmp_lat_sample, NULL);
+	rep->nr_samples = n;
+	rep->p50_us = samples[(n * 50) / 100];
+	rep->p90_us = samples[(n * 90) / 100];
+	rep->p99_us = samples[(n * 99) / 100];
+	rep->max_us = samples[n - 1];
+
+	return 0;
+}
+EXPORT_SYMBOL(test_iosched_get_lat_report);
+
 /**
  * test_iosched_add_unique_test_req() - Create and queue a non
  * read/write request (such as FLUSH/DISCRAD/SANITIZE).
@@ -743,6 +818,8 @@ int test_iosched_start_test(struct test_info *t_info)
 
 		ptd->ignore_round = false;
 		ptd->fs_wr_reqs_during_test = false;
+		ptd->lat_stats.nr_samples[READ] = 0;
+		ptd->lat_stats.nr_samples[WRITE] = 0;
 
 		ptd->test_state = TEST_RUNNING;
 
@@ -1015,6 +1092,7 @@ static int test_dispatch_from(struct request_queue *q,
 		spin_unlock_irq(&ptd->lock);
 
 		print_req(rq);
+		test_rq->dispatch_time = ktime_get();
 		elv_dispatch_sort(q, rq);
 		ptd->test_info.test_byte_count += test_rq->buf_size;
 		ret = 1;
@@ -1147,6 +1225,13 @@ static int test_init_queue(struct request_queue *q, struct elevator_type *e)
 
 	spin_lock_init(&ptd->lock);
 
+	ptd->lat_stats.samples[READ] = kcalloc(TEST_MAX_LAT_SAMPLES,
+					       sizeof(u32), GFP_KERNEL);
+	ptd->lat_stats.samples[WRITE] = kcalloc(TEST_MAX_LAT_SAMPLES,
+						sizeof(u32), GFP_KERNEL);
+	if (!ptd->lat_stats.samples[READ] || !ptd->lat_stats.samples[WRITE])
+		pr_err("%s: no memory for latency statistics", __func__);
+
 	if (test_debugfs_init(ptd)) {
 		pr_err("%s: Failed to create debugfs files", __func__);
 		return -ENOMEM;
@@ -1174,6 +1259,8 @@ static void test_exit_queue(struct elevator_queue *e)
 
 	test_debugfs_cleanup(td);
 
+	kfree(td->lat_stats.samples[READ]);
+	kfree(td->lat_stats.samples[WRITE]);
 	kfree(td);
 }
 
@@ -25,6 +25,8 @@
 #include <linux/async.h>
 #include <linux/pm_runtime.h>
 #include <linux/pinctrl/devinfo.h>
+#include <linux/of.h>
+#include <soc/qcom/boot_stats.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -346,6 +348,7 @@ probe_failed:
 	if (ret == -EPROBE_DEFER) {
 		/* Driver requested deferred probing */
 		dev_info(dev, "Driver %s requests probe deferral\n", drv->name);
+		boot_stats_marker("probe deferred %s", dev_name(dev));
 		driver_deferred_probe_add(dev);
 		/* Did a trigger occur while probing? Need to re-trigger if yes */
 		if (local_trigger_count != atomic_read(&deferred_trigger_count))
@@ -408,6 +411,81 @@ EXPORT_SYMBOL_GPL(wait_for_device_probe);
  * This function must be called with @dev lock held.  When called for a
  * USB interface, @dev->parent lock must be held as well.
  */
+/*
+ * Devices marked "qcom,async-probe" in device tree are not needed to get
+ * to userspace.  Their probe is held back on async_probe_list until
+ * driver_async_probe_start() is called, and then run in parallel outside
+ * of the boot critical path.  The list reuses the deferred_probe node and
+ * mutex, so driver_deferred_probe_del() takes a removed device off it too.
+ */
+static LIST_HEAD(async_probe_list);
+static bool async_probe_hold = true;
+static ASYNC_DOMAIN_EXCLUSIVE(async_probe_domain);
+
+static bool driver_async_probe_held(struct device *dev)
+{
+	bool held = false;
+
+	if (!ACCESS_ONCE(async_probe_hold) || !dev->of_node ||
+	    !of_property_read_bool(dev->of_node, "qcom,async-probe"))
+		return false;
+
+	mutex_lock(&deferred_probe_mutex);
+	if (async_probe_hold) {
+		if (list_empty(&dev->p->deferred_probe)) {
+			dev_dbg(dev, "Added to async probe list\n");
+			list_add_tail(&dev->p->deferred_probe,
+				      &async_probe_list);
+		}
+		held = true;
+	}
+	mutex_unlock(&deferred_probe_mutex);
+
+	return held;
+}
+
+static void driver_async_probe_func(void *data, async_cookie_t cookie)
+{
+	struct device *dev = data;
+
+	boot_stats_marker("async probe %s start", dev_name(dev));
+	bus_probe_device(dev);
+	boot_stats_marker("async probe %s done", dev_name(dev));
+	put_device(dev);
+}
+
+/**
+ * driver_async_probe_start() - Probe the devices held for async probing
+ *
+ * Called once the root filesystem is available.  Devices registered from
+ * here on are probed synchronously as usual.  The probes run in their own
+ * async domain, so init does not wait for them before starting userspace.
+ */
+void driver_async_probe_start(void)
+{
+	struct device_private *private;
+	struct device *dev;
+	LIST_HEAD(pending);
+
+	mutex_lock(&deferred_probe_mutex);
+	async_probe_hold = false;
+	list_splice_init(&async_probe_list, &pending);
+	while (!list_empty(&pending)) {
+		private = list_first_entry(&pending, typeof(*dev->p),
+					   deferred_probe);
+		dev = private->device;
+		list_del_init(&private->deferred_probe);
+		get_device(dev);
+
+		/* The probe may run inline and touch the deferred lists */
+		mutex_unlock(&deferred_probe_mutex);
+		async_schedule_domain(driver_async_probe_func, dev,
+				      &async_probe_domain);
+		mutex_lock(&deferred_probe_mutex);
+	}
+	mutex_unlock(&deferred_probe_mutex);
+}
+
 int driver_probe_device(struct device_driver *drv, struct device *dev)
 {
 	int ret = 0;
@@ -415,6 +493,9 @@ int driver_probe_device(struct device_driver *drv, struct device *dev)
 	if (!device_is_registered(dev))
 		return -ENODEV;
 
+	if (driver_async_probe_held(dev))
+		return 0;
+
 	pr_debug("bus: '%s': %s: matched device %s with driver %s\n",
 		 drv->bus->name, __func__, dev_name(dev), drv->name);
 
@@ -317,6 +317,36 @@ static noinline_for_stack long fw_file_size(struct file *file)
 	return st.size;
 }
 
+/* Largest window of the destination a direct load maps at a time */
+#define FW_DIRECT_CHUNK_SIZE	(1024 * 1024)
+
+/*
+ * Stream the file into the destination region one chunk at a time, so a
+ * large image never needs a mapping of its full size.
+ */
+static bool fw_read_file_direct(struct file *file, struct firmware_buf *fw_buf,
+				long size)
+{
+	long offset = 0, chunk;
+	char *buf;
+	int ret;
+
+	while (offset < size) {
+		chunk = min_t(long, size - offset, FW_DIRECT_CHUNK_SIZE);
+		buf = fw_buf->map_fw_mem(fw_buf->dest_addr + offset, chunk,
+					 fw_buf->map_data);
+		if (!buf)
+			return false;
+		ret = kernel_read(file, offset, buf, chunk);
+		fw_buf->unmap_fw_mem(buf, chunk, fw_buf->map_data);
+		if (ret != chunk)
+			return false;
+		offset += chunk;
+	}
+	fw_buf->size = size;
+	return true;
+}
+
 static bool fw_read_file_contents(struct file *file, struct firmware_buf *fw_buf)
 {
 	long size;
@@ -329,24 +359,17 @@ static bool fw_read_file_contents(struct file *file, struct firmware_buf *fw_buf
 		return false;
 
 	if (fw_buf->dest_addr)
-		buf = fw_buf->map_fw_mem(fw_buf->dest_addr,
-					   fw_buf->dest_size, fw_buf->map_data);
-	else
-		buf = vmalloc(size);
+		return fw_read_file_direct(file, fw_buf, size);
+
+	buf = vmalloc(size);
 	if (!buf)
 		return false;
 	if (kernel_read(file, 0, buf, size) != size) {
-		if (fw_buf->dest_addr)
-			fw_buf->unmap_fw_mem(buf, fw_buf->dest_size,
-							fw_buf->map_data);
-		else
-			vfree(buf);
+		vfree(buf);
 		return false;
 	}
 	fw_buf->data = buf;
 	fw_buf->size = size;
-	if (fw_buf->dest_addr)
-		fw_buf->unmap_fw_mem(buf, fw_buf->size, fw_buf->map_data);
 	return true;
 }
 
@@ -63,8 +63,9 @@
 #define HCI_IBS_WAKE_IND	0xFD
 #define HCI_IBS_WAKE_ACK	0xFC
 
-/* TX idle time out value */
+/* Initial and minimum TX idle time out values */
 #define TX_IDLE_TO		1000
+#define TX_IDLE_MIN_TO		100
 
 /* HCI_IBS receiver States */
 #define HCI_IBS_W4_PACKET_TYPE	0
@@ -115,6 +116,9 @@ struct ibs_struct {
 	unsigned long rx_vote;		/* clock must be on for RX */
 	struct	timer_list tx_idle_timer;
 	struct	timer_list wake_retrans_timer;
+	unsigned long tx_idle_ms;	/* current TX idle time out */
+	unsigned long tx_last_jif;	/* last packet queued while awake */
+	unsigned long tx_sleep_jif;	/* last SLEEP_IND sent */
 	struct	workqueue_struct *workqueue;
 	struct	work_struct ws_awake_rx;
 	struct	work_struct ws_awake_device;
@@ -341,6 +345,7 @@ static void hci_ibs_tx_idle_timeout(unsigned long arg)
 	struct hci_uart *hu = (struct hci_uart *) arg;
 	struct ibs_struct *ibs = hu->priv;
 	unsigned long flags;
+	unsigned long deadline;
 
 	BT_DBG("hu %pK idle timeout in %lu state", hu, ibs->tx_ibs_state);
 
@@ -354,11 +359,18 @@ static void hci_ibs_tx_idle_timeout(unsigned long arg)
 		BT_ERR("spurrious timeout in tx state %ld", ibs->tx_ibs_state);
 		goto out;
 	case HCI_IBS_TX_AWAKE: /* TX_IDLE, go to SLEEP */
+		/* the timer is not re-armed per packet, check for late ones */
+		deadline = ibs->tx_last_jif + msecs_to_jiffies(ibs->tx_idle_ms);
+		if (time_before(jiffies, deadline)) {
+			mod_timer(&ibs->tx_idle_timer, deadline);
+			goto out;
+		}
 		if (send_hci_ibs_cmd(HCI_IBS_SLEEP_IND, hu) < 0) {
 			BT_ERR("cannot send SLEEP to device");
 			goto out;
 		}
 		ibs->tx_ibs_state = HCI_IBS_TX_ASLEEP;
+		ibs->tx_sleep_jif = jiffies;
 		ibs->ibs_sent_slps++; /* debug */
 		break;
 	}
@@ -438,6 +450,7 @@ static int ibs_open(struct hci_uart *hu)
 	/* clocks actually on, but we start votes off */
 	ibs->tx_vote = 0;
 	ibs->rx_vote = 0;
+	ibs->tx_idle_ms = TX_IDLE_TO;
 
 	/* debug */
 	ibs->ibs_sent_wacks = 0;
@@ -477,6 +490,7 @@ void ibs_log_local_stats(struct ibs_struct *ibs)
 	BT_INFO("HCI_IBS stats: tx_idle_delay=%lu, wake_retrans=%lu",
 		tx_idle_delay, wake_retrans);
 
+	BT_INFO("HCI_IBS stats: tx_idle_ms=%lu", ibs->tx_idle_ms);
 	BT_INFO("HCI_IBS stats: tx_ibs_state=%lu, rx_ibs_state=%lu",
 		ibs->tx_ibs_state, ibs->rx_ibs_state);
 	BT_INFO("HCI_IBS stats: sent: sleep=%lu, wake=%lu, wake_ack=%lu",
@@ -659,8 +673,9 @@ static void ibs_device_woke_up(struct hci_uart *hu)
 			skb_queue_tail(&ibs->txq, skb);
 		/* switch timers and change state to HCI_IBS_TX_AWAKE */
 		del_timer(&ibs->wake_retrans_timer);
+		ibs->tx_last_jif = jiffies;
 		mod_timer(&ibs->tx_idle_timer, jiffies +
-			msecs_to_jiffies(TX_IDLE_TO));
+			msecs_to_jiffies(ibs->tx_idle_ms));
 		ibs->tx_ibs_state = HCI_IBS_TX_AWAKE;
 	}
 
@@ -670,6 +685,29 @@ static void ibs_device_woke_up(struct hci_uart *hu)
 	hci_uart_tx_wakeup(hu);
 }
 
+/*
+ * Adapt the TX idle time out to the traffic. Waking the device again
+ * within one time out of putting it to sleep means the link is busy, so
+ * stay awake longer; a long sleep means it is idle, so sleep sooner.
+ * Called with hci_ibs_lock held when leaving HCI_IBS_TX_ASLEEP.
+ */
+static void ibs_update_tx_idle_to(struct ibs_struct *ibs)
+{
+	unsigned long max_ms = max_t(unsigned long, TX_IDLE_MIN_TO,
+				     jiffies_to_msecs(tx_idle_delay));
+	unsigned long slept_ms;
+
+	if (!ibs->ibs_sent_slps)
+		return;
+
+	slept_ms = jiffies_to_msecs(jiffies - ibs->tx_sleep_jif);
+	if (slept_ms < ibs->tx_idle_ms)
+		ibs->tx_idle_ms = min(ibs->tx_idle_ms * 2, max_ms);
+	else if (slept_ms > ibs->tx_idle_ms * 4)
+		ibs->tx_idle_ms = max_t(unsigned long, TX_IDLE_MIN_TO,
+					ibs->tx_idle_ms / 2);
+}
+
 /* Enqueue frame for transmittion (padding, crc, etc) */
 /* may be called from two simultaneous tasklets */
 static int ibs_enqueue(struct hci_uart *hu, struct sk_buff *skb)
@@ -690,8 +728,7 @@ static int ibs_enqueue(struct hci_uart *hu, struct sk_buff *skb)
 	case HCI_IBS_TX_AWAKE:
 		BT_DBG("device awake, sending normally");
 		skb_queue_tail(&ibs->txq, skb);
-		mod_timer(&ibs->tx_idle_timer, jiffies +
-			msecs_to_jiffies(TX_IDLE_TO));
+		ibs->tx_last_jif = jiffies;
 		break;
 
 	case HCI_IBS_TX_ASLEEP:
@@ -699,6 +736,7 @@ static int ibs_enqueue(struct hci_uart *hu, struct sk_buff *skb)
 		/* save packet for later */
 		skb_queue_tail(&ibs->tx_wait_q, skb);
 
+		ibs_update_tx_idle_to(ibs);
 		ibs->tx_ibs_state = HCI_IBS_TX_WAKING;
 		/* schedule a work queue to wake up device */
 		queue_work(ibs->workqueue, &ibs->ws_awake_device);
@@ -910,4 +948,5 @@ module_param(wake_retrans, ulong, 0644);
 MODULE_PARM_DESC(wake_retrans, "Delay (1/HZ) to retransmit WAKE_IND");
 
 module_param(tx_idle_delay, ulong, 0644);
-MODULE_PARM_DESC(tx_idle_delay, "Delay (1/HZ) since last tx for SLEEP_IND");
+MODULE_PARM_DESC(tx_idle_delay,
+		 "Longest delay (1/HZ) since last tx for SLEEP_IND");
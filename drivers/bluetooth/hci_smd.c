@@ -154,112 +154,55 @@ static void hci_smd_destruct(struct hci_dev *hdev)
 		kfree(hdev->driver_data);
 }
 
-static void hci_smd_recv_data(void)
+/* Called by smd_read_packets() with the SMD lock held */
+static void *hci_smd_rx_buf(void *priv, int len)
 {
-	int len = 0;
-	int rc = 0;
-	struct sk_buff *skb = NULL;
-	struct hci_smd_data *hsmd = &hs;
-	wake_lock(&hs.wake_lock_rx);
+	struct sk_buff_head *q = priv;
+	struct sk_buff *skb;
 
-	len = smd_read_avail(hsmd->data_channel);
 	if (len > HCI_MAX_FRAME_SIZE) {
 		BT_ERR("Frame larger than the allowed size, flushing frame");
-		smd_read(hsmd->data_channel, NULL, len);
-		goto out_data;
+		return NULL;
 	}
 
-	if (len <= 0)
-		goto out_data;
-
 	skb = bt_skb_alloc(len, GFP_ATOMIC);
 	if (!skb) {
 		BT_ERR("Error in allocating socket buffer");
-		smd_read(hsmd->data_channel, NULL, len);
-		goto out_data;
-	}
-
-	rc = smd_read(hsmd->data_channel, skb_put(skb, len), len);
-	if (rc < len) {
-		BT_ERR("Error in reading from the channel");
-		goto out_data;
+		return NULL;
 	}
 
-	skb->dev = (void *)hsmd->hdev;
-	bt_cb(skb)->pkt_type = HCI_ACLDATA_PKT;
-	skb_orphan(skb);
-
-	rc = hci_recv_frame(skb);
-	if (rc < 0) {
-		BT_ERR("Error in passing the packet to HCI Layer");
-		/*
-		 * skb is getting freed in hci_recv_frame, making it
-		 * to null to avoid multiple access
-		 */
-		skb = NULL;
-		goto out_data;
-	}
-
-	/*
-	 * Start the timer to monitor whether the Rx queue is
-	 * empty for releasing the Rx wake lock
-	 */
-	BT_DBG("Rx Timer is starting");
-	mod_timer(&hsmd->rx_q_timer,
-			jiffies + msecs_to_jiffies(RX_Q_MONITOR));
-
-out_data:
-	release_lock();
-	if (rc)
-		kfree_skb(skb);
+	__skb_queue_tail(q, skb);
+	return skb_put(skb, len);
 }
 
-static void hci_smd_recv_event(void)
+/*
+ * Drain every complete packet pending on @ch into skbs in one SMD lock
+ * hold, then pass them to the HCI layer. Returns the number of packets
+ * read from the channel.
+ */
+static int hci_smd_recv(struct smd_channel *ch, u8 pkt_type)
 {
-	int len = 0;
-	int rc = 0;
-	struct sk_buff *skb = NULL;
 	struct hci_smd_data *hsmd = &hs;
-	wake_lock(&hs.wake_lock_rx);
-
-	len = smd_read_avail(hsmd->event_channel);
-	if (len > HCI_MAX_FRAME_SIZE) {
-		BT_ERR("Frame larger than the allowed size, flushing frame");
-		rc = smd_read(hsmd->event_channel, NULL, len);
-		goto out_event;
-	}
+	struct sk_buff_head q;
+	struct sk_buff *skb;
+	int n;
 
-	while (len > 0) {
-		skb = bt_skb_alloc(len, GFP_ATOMIC);
-		if (!skb) {
-			BT_ERR("Error in allocating socket buffer");
-			smd_read(hsmd->event_channel, NULL, len);
-			goto out_event;
-		}
-
-		rc = smd_read(hsmd->event_channel, skb_put(skb, len), len);
-		if (rc < len) {
-			BT_ERR("Error in reading from the event channel");
-			goto out_event;
-		}
+	__skb_queue_head_init(&q);
+	n = smd_read_packets(ch, hci_smd_rx_buf, &q, 0);
+	if (n < 0)
+		BT_ERR("Error in reading from the channel %d", n);
 
+	while ((skb = __skb_dequeue(&q))) {
 		skb->dev = (void *)hsmd->hdev;
-		bt_cb(skb)->pkt_type = HCI_EVENT_PKT;
-
+		bt_cb(skb)->pkt_type = pkt_type;
 		skb_orphan(skb);
 
-		rc = hci_recv_frame(skb);
-		if (rc < 0) {
+		/* skb is freed by hci_recv_frame on failure */
+		if (hci_recv_frame(skb) < 0)
 			BT_ERR("Error in passing the packet to HCI Layer");
-			/*
-			 * skb is getting freed in hci_recv_frame, making it
-			 *  to null to avoid multiple access
-			 */
-			skb = NULL;
-			goto out_event;
-		}
+	}
 
-		len = smd_read_avail(hsmd->event_channel);
+	if (n > 0) {
 		/*
 		 * Start the timer to monitor whether the Rx queue is
 		 * empty for releasing the Rx wake lock
@@ -268,10 +211,8 @@ static void hci_smd_recv_event(void)
 		mod_timer(&hsmd->rx_q_timer,
 				jiffies + msecs_to_jiffies(RX_Q_MONITOR));
 	}
-out_event:
-	release_lock();
-	if (rc)
-		kfree_skb(skb);
+
+	return n;
 }
 
 static int hci_smd_send_frame(struct sk_buff *skb)
@@ -322,11 +263,14 @@ static void hci_smd_rx(unsigned long arg)
 {
 	struct hci_smd_data *hsmd = &hs;
 
-	while ((smd_read_avail(hsmd->event_channel) > 0) ||
-				(smd_read_avail(hsmd->data_channel) > 0)) {
-		hci_smd_recv_event();
-		hci_smd_recv_data();
-	}
+	int events, data;
+
+	wake_lock(&hs.wake_lock_rx);
+	do {
+		events = hci_smd_recv(hsmd->event_channel, HCI_EVENT_PKT);
+		data = hci_smd_recv(hsmd->data_channel, HCI_ACLDATA_PKT);
+	} while (events > 0 || data > 0);
+	release_lock();
 }
 
 static void hci_smd_notify_event(void *data, unsigned int event)
@@ -48,6 +48,7 @@
 #define RPC_HASH_SZ	(1 << RPC_HASH_BITS)
 #define BALIGN		32
 #define NUM_CHANNELS    2
+#define FASTRPC_ARG_MAP_MAX	32
 
 #define LOCK_MMAP(kernel)\
 		do {\
@@ -228,9 +229,19 @@ struct fastrpc_mmap {
 	int refs;
 };
 
+/* SMMU mapping of an ion buffer passed as an invoke argument */
+struct fastrpc_arg_map {
+	struct list_head lru;
+	struct ion_handle *handle;
+	ion_phys_addr_t iova;
+	int refs;
+};
+
 struct file_data {
 	spinlock_t hlock;
 	struct hlist_head hlst;
+	struct list_head amaps;
+	int num_amaps;
 	uint32_t mode;
 	int cid;
 	int tgid;
@@ -330,6 +341,137 @@ static void unmap_iommu_mem(struct ion_handle *handle, struct file_data *fdata,
 	}
 }
 
+/*
+ * Argument buffers stay mapped in the SMMU after an invoke returns, so
+ * a buffer handed to the DSP again skips the map. Each cached entry holds
+ * its own ion handle reference and mapping. Once there are more than
+ * FASTRPC_ARG_MAP_MAX, entries no invoke is using are dropped, least
+ * recently used first. Called with fdata->hlock held.
+ */
+static struct fastrpc_arg_map *arg_map_find(struct file_data *fdata,
+					struct ion_handle *handle)
+{
+	struct fastrpc_arg_map *amap;
+
+	list_for_each_entry(amap, &fdata->amaps, lru) {
+		if (amap->handle == handle)
+			return amap;
+	}
+	return NULL;
+}
+
+static void arg_map_release(struct fastrpc_arg_map *amap,
+				struct file_data *fdata)
+{
+	unmap_iommu_mem(amap->handle, fdata, 0);
+	ion_free(gfa.iclient, amap->handle);
+	kfree(amap);
+}
+
+static void arg_map_trim(struct file_data *fdata)
+{
+	struct fastrpc_arg_map *amap, *victim;
+
+	do {
+		victim = NULL;
+		spin_lock(&fdata->hlock);
+		if (fdata->num_amaps > FASTRPC_ARG_MAP_MAX) {
+			list_for_each_entry_reverse(amap, &fdata->amaps, lru) {
+				if (!amap->refs) {
+					list_del(&amap->lru);
+					fdata->num_amaps--;
+					victim = amap;
+					break;
+				}
+			}
+		}
+		spin_unlock(&fdata->hlock);
+		if (victim)
+			arg_map_release(victim, fdata);
+	} while (victim);
+}
+
+static int map_arg_cached(struct file_data *fdata, int fd,
+			struct ion_handle *handle, ion_phys_addr_t *iova,
+			unsigned long len)
+{
+	struct fastrpc_mmap *map;
+	struct fastrpc_arg_map *amap, *new = NULL;
+	int err = 0;
+
+	spin_lock(&fdata->hlock);
+	amap = arg_map_find(fdata, handle);
+	if (amap) {
+		amap->refs++;
+		list_move(&amap->lru, &fdata->amaps);
+		*iova = amap->iova;
+		spin_unlock(&fdata->hlock);
+		return 0;
+	}
+	/* Buffers mapped through FASTRPC_IOCTL_MMAP already persist */
+	hlist_for_each_entry(map, &fdata->hlst, hn) {
+		if (map->handle == handle) {
+			*iova = map->phys;
+			spin_unlock(&fdata->hlock);
+			return 0;
+		}
+	}
+	spin_unlock(&fdata->hlock);
+
+	VERIFY(err, NULL != (new = kzalloc(sizeof(*new), GFP_KERNEL)));
+	if (err)
+		return err;
+	new->handle = ion_import_dma_buf(gfa.iclient, fd);
+	VERIFY(err, new->handle == handle);
+	if (err)
+		goto bail;
+	VERIFY(err, 0 == map_iommu_mem(new->handle, fdata, &new->iova, len));
+	if (err)
+		goto bail;
+
+	spin_lock(&fdata->hlock);
+	amap = arg_map_find(fdata, handle);
+	if (!amap) {
+		list_add(&new->lru, &fdata->amaps);
+		fdata->num_amaps++;
+		amap = new;
+		new = NULL;
+	} else {
+		list_move(&amap->lru, &fdata->amaps);
+	}
+	amap->refs++;
+	*iova = amap->iova;
+	spin_unlock(&fdata->hlock);
+
+	/* Lost a race with another thread mapping the same buffer */
+	if (new)
+		arg_map_release(new, fdata);
+	arg_map_trim(fdata);
+	return 0;
+ bail:
+	if (!IS_ERR_OR_NULL(new->handle))
+		ion_free(gfa.iclient, new->handle);
+	kfree(new);
+	return err;
+}
+
+/* Drop an invoke's use of a cached mapping, false if none is cached */
+static bool unmap_arg_cached(struct file_data *fdata,
+			struct ion_handle *handle)
+{
+	struct fastrpc_arg_map *amap;
+
+	spin_lock(&fdata->hlock);
+	amap = arg_map_find(fdata, handle);
+	if (amap)
+		amap->refs--;
+	spin_unlock(&fdata->hlock);
+
+	if (amap)
+		arg_map_trim(fdata);
+	return amap != NULL;
+}
+
 static void free_mem(struct fastrpc_buf *buf, struct file_data *fd)
 {
 	struct fastrpc_apps *me = &gfa;
@@ -601,7 +743,10 @@ static void context_free(struct smq_invoke_ctx *ctx, int remove)
 			for (i = 0; i < bufs; i++) {
 				if (IS_ERR_OR_NULL(ctx->handles[i]))
 					continue;
-				unmap_iommu_mem(ctx->handles[i], ctx->fdata, 1);
+				if (!unmap_arg_cached(ctx->fdata,
+							ctx->handles[i]))
+					unmap_iommu_mem(ctx->handles[i],
+							ctx->fdata, 1);
 				ion_free(clnt, ctx->handles[i]);
 			}
 		}
@@ -823,10 +968,13 @@ static int get_args(uint32_t kernel, struct smq_invoke_ctx *ctx,
 			VERIFY(err, 0 == IS_ERR_OR_NULL(handles[i]));
 			if (err)
 				goto bail;
-			VERIFY(err, 0 == map_iommu_mem(handles[i],
-						ctx->fdata, &iova, len));
-			if (err)
+			VERIFY(err, 0 == map_arg_cached(ctx->fdata, fds[i],
+						handles[i], &iova, len));
+			if (err) {
+				ion_free(me->iclient, handles[i]);
+				handles[i] = NULL;
 				goto bail;
+			}
 			VERIFY(err, 0 != (vma = find_vma(current->mm, start)));
 			if (err)
 				goto bail;
@@ -985,9 +1133,23 @@ static int put_args(uint32_t kernel, uint32_t sc, remote_arg_t *pra,
 	return err;
 }
 
-static void inv_args_pre(uint32_t sc, remote_arg_t *rpra)
+/* Ion buffers the CPU maps uncached need no cache maintenance */
+static bool arg_uncached(struct smq_invoke_ctx *ctx, int i)
+{
+	unsigned long flags;
+
+	if (!ctx->handles || IS_ERR_OR_NULL(ctx->handles[i]))
+		return false;
+	if (ion_handle_get_flags(ctx->apps->iclient, ctx->handles[i], &flags))
+		return false;
+	return !(flags & ION_FLAG_CACHED);
+}
+
+static void inv_args_pre(struct smq_invoke_ctx *ctx)
 {
 	int i, inbufs, outbufs;
+	uint32_t sc = ctx->sc;
+	remote_arg_t *rpra = ctx->rpra;
 	uintptr_t end;
 
 	inbufs = REMOTE_SCALARS_INBUFS(sc);
@@ -997,6 +1159,8 @@ static void inv_args_pre(uint32_t sc, remote_arg_t *rpra)
 			continue;
 		if (buf_page_start(rpra) == buf_page_start(rpra[i].buf.pv))
 			continue;
+		if (arg_uncached(ctx, i))
+			continue;
 		if (!IS_CACHE_ALIGNED((uintptr_t)rpra[i].buf.pv))
 			dmac_flush_range(rpra[i].buf.pv,
 				(char *)rpra[i].buf.pv + 1);
@@ -1007,17 +1171,20 @@ static void inv_args_pre(uint32_t sc, remote_arg_t *rpra)
 	}
 }
 
-static void inv_args(uint32_t sc, remote_arg_t *rpra, int used)
+static void inv_args(struct smq_invoke_ctx *ctx)
 {
 	int i, inbufs, outbufs;
 	int inv = 0;
+	uint32_t sc = ctx->sc;
+	remote_arg_t *rpra = ctx->rpra;
+	int used = ctx->obuf.used;
 
 	inbufs = REMOTE_SCALARS_INBUFS(sc);
 	outbufs = REMOTE_SCALARS_OUTBUFS(sc);
 	for (i = inbufs; i < inbufs + outbufs; ++i) {
 		if (buf_page_start(rpra) == buf_page_start(rpra[i].buf.pv))
 			inv = 1;
-		else if (rpra[i].buf.len)
+		else if (rpra[i].buf.len && !arg_uncached(ctx, i))
 			dmac_inv_range(rpra[i].buf.pv,
 				(char *)rpra[i].buf.pv + rpra[i].buf.len);
 	}
@@ -1270,15 +1437,15 @@ static int fastrpc_internal_invoke(struct fastrpc_apps *me, uint32_t mode,
 			goto bail;
 	}
 
-	inv_args_pre(ctx->sc, ctx->rpra);
+	inv_args_pre(ctx);
 	if (FASTRPC_MODE_SERIAL == mode)
-		inv_args(ctx->sc, ctx->rpra, ctx->obuf.used);
+		inv_args(ctx);
 	VERIFY(err, 0 == fastrpc_invoke_send(me, kernel, invoke->handle,
 						ctx->sc, ctx, &ctx->obuf));
 	if (err)
 		goto bail;
 	if (FASTRPC_MODE_PARALLEL == mode)
-		inv_args(ctx->sc, ctx->rpra, ctx->obuf.used);
+		inv_args(ctx);
  wait:
 	if (kernel)
 		wait_for_completion(&ctx->work);
@@ -1670,6 +1837,7 @@ static int fastrpc_device_release(struct inode *inode, struct file *file)
 	struct smq_invoke_ctx *ictx = NULL, *ctxfree;
 	struct hlist_node *n;
 	struct fastrpc_mmap *map = NULL;
+	struct fastrpc_arg_map *amap, *atmp;
 	int cid = MINOR(inode->i_rdev);
 
 	if (!fdata)
@@ -1699,6 +1867,10 @@ static int fastrpc_device_release(struct inode *inode, struct file *file)
 		free_map(map, fdata);
 		kfree(map);
 	}
+	list_for_each_entry_safe(amap, atmp, &fdata->amaps, lru) {
+		list_del(&amap->lru);
+		arg_map_release(amap, fdata);
+	}
 	if (fdata->ssrcount == me->channel[cid].ssrcount)
 		kref_put_mutex(&me->channel[cid].kref,
 				fastrpc_channel_close, &me->smd_mutex);
@@ -1747,6 +1919,7 @@ static int fastrpc_device_open(struct inode *inode, struct file *filp)
 
 		spin_lock_init(&fdata->hlock);
 		INIT_HLIST_HEAD(&fdata->hlst);
+		INIT_LIST_HEAD(&fdata->amaps);
 		fdata->cid = cid;
 		fdata->tgid = current->tgid;
 		fdata->ssrcount = ssrcount;
@@ -24,6 +24,7 @@
 #include <linux/spinlock.h>
 #include <linux/ratelimit.h>
 #include <linux/reboot.h>
+#include <linux/mm.h>
 #include <asm/current.h>
 #include <soc/qcom/restart.h>
 #ifdef CONFIG_DIAG_OVER_USB
@@ -37,6 +38,7 @@
 #include "diag_dci.h"
 #include "diag_masks.h"
 #include "diagfwd_bridge.h"
+#include "diag_memorydevice.h"
 
 static struct timer_list dci_drain_timer;
 static int dci_timer_in_progress;
@@ -1043,6 +1045,109 @@ void extract_dci_pkt_rsp(unsigned char *buf, int len, int data_source,
 	dci_add_buffer_to_list(entry, rsp_buf);
 }
 
+static void dci_batch_timeout(unsigned long data)
+{
+	struct diag_dci_client_tbl *client = (struct diag_dci_client_tbl *)data;
+
+	client->batch_expired = 1;
+	wake_up_interruptible(&driver->wait_q);
+}
+
+/*
+ * Writes a log or event straight into the client's shared ring, skipping
+ * the per-client buffers. Returns -ENODEV if the client has no ring mapped.
+ */
+static int dci_ring_write(struct diag_dci_client_tbl *client, int type,
+			  unsigned char *buf, int len)
+{
+	int used = 0;
+	struct diag_md_ring *ring = client->ring;
+
+	if (!ring)
+		return -ENODEV;
+
+	used = diag_md_ring_insert(ring, type, buf, len);
+	if (used < 0)
+		return used;
+
+	if (used == 0) {
+		/* This record starts a new batch */
+		client->batch_expired = 0;
+		if (client->batch_ms)
+			mod_timer(&client->batch_timer, jiffies +
+				  msecs_to_jiffies(client->batch_ms));
+		if (!client->batch_bytes)
+			wake_up_interruptible(&driver->wait_q);
+	}
+
+	if (client->batch_bytes && used < client->batch_bytes &&
+	    diag_md_ring_used(ring) >= client->batch_bytes)
+		wake_up_interruptible(&driver->wait_q);
+
+	return 0;
+}
+
+int diag_dci_mmap_ready(int tgid)
+{
+	int ready = 0;
+	unsigned int used = 0;
+	struct diag_dci_client_tbl *entry = NULL;
+
+	entry = dci_lookup_client_entry_pid(tgid);
+	if (!entry || !entry->ring)
+		return 0;
+
+	used = diag_md_ring_used(entry->ring);
+	if (used > 0 && (used >= entry->batch_bytes || entry->batch_expired))
+		ready = 1;
+
+	return ready;
+}
+
+int diag_dci_mmap(struct vm_area_struct *vma)
+{
+	int err = 0;
+	struct diag_dci_client_tbl *entry = NULL;
+	struct diag_md_ring *ring = NULL;
+	struct diag_md_ring *old = NULL;
+
+	mutex_lock(&driver->dci_mutex);
+	entry = dci_lookup_client_entry_pid(current->tgid);
+	if (!entry) {
+		err = -EINVAL;
+		goto fail;
+	}
+	if (diag_md_ring_mapped(entry->ring)) {
+		err = -EBUSY;
+		goto fail;
+	}
+
+	ring = diag_md_ring_create(vma);
+	if (IS_ERR(ring)) {
+		err = PTR_ERR(ring);
+		goto fail;
+	}
+	old = entry->ring;
+	entry->ring = ring;
+	entry->batch_expired = 0;
+
+fail:
+	mutex_unlock(&driver->dci_mutex);
+	diag_md_ring_put(old);
+	return err;
+}
+
+int diag_dci_set_batch(struct diag_dci_client_tbl *entry, uint32_t bytes,
+		       uint32_t ms)
+{
+	if (!entry)
+		return DIAG_DCI_NOT_SUPPORTED;
+
+	entry->batch_bytes = min_t(uint32_t, bytes, DIAG_MD_RING_MAX_SIZE);
+	entry->batch_ms = ms;
+	return DIAG_DCI_NO_ERROR;
+}
+
 static void copy_dci_event(unsigned char *buf, int len,
 			   struct diag_dci_client_tbl *client, int data_source)
 {
@@ -1058,6 +1163,17 @@ static void copy_dci_event(unsigned char *buf, int len,
 	total_len = sizeof(int) + len;
 
 	proc_buf = &client->buffers[data_source];
+	err = dci_ring_write(client, DCI_EVENT_TYPE, buf, len);
+	if (err != -ENODEV) {
+		mutex_lock(&proc_buf->health_mutex);
+		if (err)
+			proc_buf->health.dropped_events++;
+		else
+			proc_buf->health.received_events++;
+		mutex_unlock(&proc_buf->health_mutex);
+		return;
+	}
+
 	mutex_lock(&proc_buf->buf_mutex);
 	mutex_lock(&proc_buf->health_mutex);
 	err = diag_dci_get_buffer(client, data_source, total_len);
@@ -1221,6 +1337,18 @@ static void copy_dci_log(unsigned char *buf, int len,
 	}
 
 	proc_buf = &client->buffers[data_source];
+	err = dci_ring_write(client, DCI_LOG_TYPE, buf + sizeof(int),
+			     log_length);
+	if (err != -ENODEV) {
+		mutex_lock(&proc_buf->health_mutex);
+		if (err)
+			proc_buf->health.dropped_logs++;
+		else
+			proc_buf->health.received_logs++;
+		mutex_unlock(&proc_buf->health_mutex);
+		return;
+	}
+
 	mutex_lock(&proc_buf->buf_mutex);
 	mutex_lock(&proc_buf->health_mutex);
 	err = diag_dci_get_buffer(client, data_source, total_len);
@@ -2883,6 +3011,9 @@ int diag_dci_register_client(struct diag_dci_reg_tbl_t *reg_entry)
 	new_entry->in_service = 0;
 	INIT_LIST_HEAD(&new_entry->list_write_buf);
 	mutex_init(&new_entry->write_buf_mutex);
+	new_entry->ring = NULL;
+	setup_timer(&new_entry->batch_timer, dci_batch_timeout,
+		    (unsigned long)new_entry);
 	new_entry->dci_log_mask =  kzalloc(DCI_LOG_MASK_SIZE, GFP_KERNEL);
 	if (!new_entry->dci_log_mask) {
 		pr_err("diag: Unable to create log mask for client, %d",
@@ -2998,6 +3129,9 @@ int diag_dci_deinit_client(struct diag_dci_client_tbl *entry)
 	 */
 	list_del(&entry->track);
 	driver->num_dci_client--;
+	del_timer_sync(&entry->batch_timer);
+	diag_md_ring_put(entry->ring);
+	entry->ring = NULL;
 	/*
 	 * Clear the client's log and event masks, update the cumulative
 	 * masks and send the masks to peripherals
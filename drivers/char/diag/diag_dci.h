@@ -93,6 +93,17 @@ struct diag_dci_reg_tbl_t {
 	int token;
 } __packed;
 
+/*
+ * Registration with batched delivery through the shared ring. The client
+ * is woken once batch_bytes are pending or batch_ms after the first
+ * record of a batch, whichever comes first; zero disables either bound.
+ */
+struct diag_dci_reg_batch_t {
+	struct diag_dci_reg_tbl_t reg;
+	uint32_t batch_bytes;
+	uint32_t batch_ms;
+} __packed;
+
 struct diag_dci_health_t {
 	int dropped_logs;
 	int dropped_events;
@@ -142,6 +153,11 @@ struct diag_dci_client_tbl {
 	uint8_t in_service;
 	struct list_head list_write_buf;
 	struct mutex write_buf_mutex;
+	struct diag_md_ring *ring;
+	uint32_t batch_bytes;
+	uint32_t batch_ms;
+	uint8_t batch_expired;
+	struct timer_list batch_timer;
 };
 
 struct diag_dci_health_stats {
@@ -238,6 +254,10 @@ extern struct mutex dci_stat_mutex;
 int diag_dci_init(void);
 void diag_dci_exit(void);
 int diag_dci_register_client(struct diag_dci_reg_tbl_t *reg_entry);
+int diag_dci_set_batch(struct diag_dci_client_tbl *entry, uint32_t bytes,
+		       uint32_t ms);
+int diag_dci_mmap(struct vm_area_struct *vma);
+int diag_dci_mmap_ready(int tgid);
 int diag_dci_deinit_client(struct diag_dci_client_tbl *entry);
 void diag_update_smd_dci_work_fn(struct work_struct *);
 void diag_dci_notify_client(int peripheral_mask, int data, int proc);
@@ -14,6 +14,7 @@
 
 #include <linux/slab.h>
 #include <linux/debugfs.h>
+#include <linux/circ_buf.h>
 #include "diagchar.h"
 #include "diagfwd.h"
 #include "diagfwd_bridge.h"
@@ -460,6 +461,55 @@ static ssize_t diag_dbgfs_read_power(struct file *file, char __user *ubuf,
 	return ret;
 }
 
+static ssize_t diag_dbgfs_read_smd_ring(struct file *file,
+				char __user *ubuf, size_t count, loff_t *ppos)
+{
+	char *buf;
+	int ret = 0;
+	int i;
+	unsigned int buf_size;
+	struct diag_smd_ring *ring;
+
+	buf = kzalloc(sizeof(char) * DEBUG_BUF_SIZE, GFP_KERNEL);
+	if (!buf) {
+		pr_err("diag: %s, Error allocating memory\n", __func__);
+		return -ENOMEM;
+	}
+
+	buf_size = ksize(buf);
+	for (i = 0; i < NUM_SMD_DATA_CHANNELS; i++) {
+		ring = &driver->smd_data[i].ring;
+		ret += scnprintf(buf + ret, buf_size - ret,
+			"peripheral: %d\n"
+			"ring size: %u\n"
+			"ring used: %u\n"
+			"ring max used: %u\n"
+			"packets: %lu\n"
+			"bytes: %lu\n"
+			"dropped packets: %lu\n"
+			"dropped bytes: %lu\n"
+			"ring full: %lu\n"
+			"drain work pending: %d\n\n",
+			i,
+			ring->size,
+			ring->size ? CIRC_CNT(ring->head, ring->tail,
+					      ring->size) : 0,
+			ring->max_used,
+			ring->pkts,
+			ring->bytes,
+			ring->dropped_pkts,
+			ring->dropped_bytes,
+			ring->full,
+			work_pending(&driver->smd_data[i].
+					diag_ring_drain_work));
+	}
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, ret);
+
+	kfree(buf);
+	return ret;
+}
+
 static ssize_t diag_dbgfs_read_workpending(struct file *file,
 				char __user *ubuf, size_t count, loff_t *ppos)
 {
@@ -632,11 +682,15 @@ static ssize_t diag_dbgfs_read_mempool(struct file *file, char __user *ubuf,
 	char *buf = NULL;
 	int ret = 0;
 	int i = 0;
+	int cpu;
+	unsigned long hits;
+	unsigned long misses;
 	unsigned int buf_size;
 	unsigned int bytes_remaining = 0;
 	unsigned int bytes_written = 0;
 	unsigned int bytes_in_buffer = 0;
 	struct diag_mempool_t *mempool = NULL;
+	struct diag_mempool_cache_t *cache = NULL;
 
 	if (diag_dbgfs_mempool_index >= NUM_MEMORY_POOLS) {
 		/* Done. Reset to prepare for future requests */
@@ -657,24 +711,45 @@ static ssize_t diag_dbgfs_read_mempool(struct file *file, char __user *ubuf,
 			"%-10s\t"
 			"%-5s\t"
 			"%-5s\t"
-			"%-5s\n",
-			"POOL", "HANDLE", "COUNT", "SIZE", "ITEMSIZE");
+			"%-5s\t"
+			"%-5s\t"
+			"%-10s\t"
+			"%-10s\t"
+			"%-10s\n",
+			"POOL", "HANDLE", "COUNT", "PEAK", "SIZE", "ITEMSIZE",
+			"CACHE_HIT", "CACHE_MISS", "FAIL");
 	bytes_in_buffer += bytes_written;
 	bytes_remaining = buf_size - bytes_in_buffer;
 
 	for (i = diag_dbgfs_mempool_index; i < NUM_MEMORY_POOLS; i++) {
 		mempool = &diag_mempools[i];
+		hits = 0;
+		misses = 0;
+		if (mempool->cache) {
+			for_each_possible_cpu(cpu) {
+				cache = per_cpu_ptr(mempool->cache, cpu);
+				hits += cache->hits;
+				misses += cache->misses;
+			}
+		}
 		bytes_written = scnprintf(buf+bytes_in_buffer, bytes_remaining,
 			"%-24s\t"
 			"%-10p\t"
 			"%-5d\t"
 			"%-5d\t"
-			"%-5d\n",
+			"%-5d\t"
+			"%-5d\t"
+			"%-10lu\t"
+			"%-10lu\t"
+			"%-10lu\n",
 			mempool->name,
 			mempool->pool,
-			mempool->count,
+			atomic_read(&mempool->count),
+			mempool->peak,
 			mempool->poolsize,
-			mempool->itemsize);
+			mempool->itemsize,
+			hits, misses,
+			mempool->fail);
 		bytes_in_buffer += bytes_written;
 
 		/* Check if there is room to add another table entry */
@@ -1008,6 +1083,10 @@ const struct file_operations diag_dbgfs_power_ops = {
 	.read = diag_dbgfs_read_power,
 };
 
+const struct file_operations diag_dbgfs_smd_ring_ops = {
+	.read = diag_dbgfs_read_smd_ring,
+};
+
 int diag_debugfs_init(void)
 {
 	struct dentry *entry = NULL;
@@ -1051,6 +1130,11 @@ int diag_debugfs_init(void)
 	if (!entry)
 		goto err;
 
+	entry = debugfs_create_file("smd_ring", 0444, diag_dbgfs_dent, 0,
+				    &diag_dbgfs_smd_ring_ops);
+	if (!entry)
+		goto err;
+
 #ifdef CONFIG_DIAGFWD_BRIDGE_CODE
 	entry = debugfs_create_file("bridge", 0444, diag_dbgfs_dent, 0,
 				    &diag_dbgfs_bridge_ops);
@@ -16,6 +16,8 @@
 #include <linux/kmemleak.h>
 #include <linux/workqueue.h>
 #include <linux/uaccess.h>
+#include <linux/moduleparam.h>
+#include <linux/bitmap.h>
 #include "diagchar.h"
 #include "diagfwd_cntl.h"
 #include "diag_masks.h"
@@ -58,6 +60,31 @@ static const struct diag_ssid_range_t msg_mask_tbl[] = {
 	{ .ssid_first = MSG_SSID_24, .ssid_last = MSG_SSID_24_LAST }
 };
 
+/*
+ * Mask changes are not sent to the peripherals as they arrive. The parts
+ * that changed are recorded per control channel and sent together once
+ * mask_update_delay_ms has passed since the first change, so that a burst
+ * of mask commands costs one update per peripheral. Zero sends at once.
+ */
+static unsigned int mask_update_delay_ms = 20;
+module_param(mask_update_delay_ms, uint, S_IRUGO | S_IWUSR);
+
+#define DIAG_MASK_PEND_EVENT	0x01
+#define DIAG_MASK_PEND_LOG_ALL	0x02
+#define DIAG_MASK_PEND_MSG_ALL	0x04
+
+struct diag_mask_pending_t {
+	uint8_t flags;
+	DECLARE_BITMAP(log_equip, MAX_EQUIP_ID);
+	DECLARE_BITMAP(msg_tbl, MSG_MASK_TBL_CNT);
+};
+
+static struct diag_mask_pending_t mask_pending[NUM_SMD_CONTROL_CHANNELS];
+static DEFINE_SPINLOCK(mask_pending_lock);
+
+static void diag_mask_flush_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(diag_mask_flush_work, diag_mask_flush_fn);
+
 static int diag_apps_responds(void)
 {
 	/*
@@ -376,6 +403,110 @@ static void diag_send_feature_mask_update(struct diag_smd_info *smd_info)
 	mutex_unlock(&driver->diag_cntl_mutex);
 }
 
+static void diag_mask_flush(void)
+{
+	int i, j;
+	unsigned long flags;
+	struct diag_smd_info *smd_info = NULL;
+	struct diag_msg_mask_t *mask = NULL;
+	struct diag_mask_pending_t pend;
+
+	for (i = 0; i < NUM_SMD_CONTROL_CHANNELS; i++) {
+		spin_lock_irqsave(&mask_pending_lock, flags);
+		pend = mask_pending[i];
+		memset(&mask_pending[i], 0, sizeof(struct diag_mask_pending_t));
+		spin_unlock_irqrestore(&mask_pending_lock, flags);
+
+		smd_info = &driver->smd_cntl[i];
+		if (pend.flags & DIAG_MASK_PEND_MSG_ALL) {
+			diag_send_msg_mask_update(smd_info, ALL_SSID, ALL_SSID);
+		} else {
+			for_each_set_bit(j, pend.msg_tbl, MSG_MASK_TBL_CNT) {
+				if (j >= driver->msg_mask_tbl_count)
+					break;
+				mask = (struct diag_msg_mask_t *)msg_mask.ptr + j;
+				diag_send_msg_mask_update(smd_info,
+							  mask->ssid_first,
+							  mask->ssid_first);
+			}
+		}
+
+		if (pend.flags & DIAG_MASK_PEND_LOG_ALL) {
+			diag_send_log_mask_update(smd_info, ALL_EQUIP_ID);
+		} else {
+			for_each_set_bit(j, pend.log_equip, MAX_EQUIP_ID)
+				diag_send_log_mask_update(smd_info, j);
+		}
+
+		if (pend.flags & DIAG_MASK_PEND_EVENT)
+			diag_send_event_mask_update(smd_info);
+	}
+}
+
+static void diag_mask_flush_fn(struct work_struct *work)
+{
+	diag_mask_flush();
+}
+
+static void diag_mask_schedule_flush(void)
+{
+	/*
+	 * schedule_delayed_work() does nothing if the work is already
+	 * pending, which is what coalesces the updates.
+	 */
+	if (mask_update_delay_ms)
+		schedule_delayed_work(&diag_mask_flush_work,
+				      msecs_to_jiffies(mask_update_delay_ms));
+	else
+		diag_mask_flush();
+}
+
+/* An equip_id of ALL_EQUIP_ID marks the whole log mask */
+static void diag_mask_mark_log(int equip_id)
+{
+	int i;
+	unsigned long flags;
+
+	spin_lock_irqsave(&mask_pending_lock, flags);
+	for (i = 0; i < NUM_SMD_CONTROL_CHANNELS; i++) {
+		if (equip_id == ALL_EQUIP_ID)
+			mask_pending[i].flags |= DIAG_MASK_PEND_LOG_ALL;
+		else if (equip_id >= 0 && equip_id < MAX_EQUIP_ID)
+			set_bit(equip_id, mask_pending[i].log_equip);
+	}
+	spin_unlock_irqrestore(&mask_pending_lock, flags);
+	diag_mask_schedule_flush();
+}
+
+/* A tbl_index of ALL_SSID marks every msg mask table */
+static void diag_mask_mark_msg(int tbl_index)
+{
+	int i;
+	unsigned long flags;
+
+	spin_lock_irqsave(&mask_pending_lock, flags);
+	for (i = 0; i < NUM_SMD_CONTROL_CHANNELS; i++) {
+		if (tbl_index == ALL_SSID)
+			mask_pending[i].flags |= DIAG_MASK_PEND_MSG_ALL;
+		else if (tbl_index >= 0 && tbl_index < MSG_MASK_TBL_CNT)
+			set_bit(tbl_index, mask_pending[i].msg_tbl);
+	}
+	spin_unlock_irqrestore(&mask_pending_lock, flags);
+	diag_mask_schedule_flush();
+}
+
+static void diag_mask_mark_event(void)
+{
+	int i;
+	unsigned long flags;
+
+	spin_lock_irqsave(&mask_pending_lock, flags);
+	for (i = 0; i < NUM_SMD_CONTROL_CHANNELS; i++)
+		mask_pending[i].flags |= DIAG_MASK_PEND_EVENT;
+	spin_unlock_irqrestore(&mask_pending_lock, flags);
+	diag_mask_schedule_flush();
+}
+
 static int diag_cmd_get_ssid_range(unsigned char *src_buf, int src_len,
 				   unsigned char *dest_buf, int dest_len)
 {
@@ -527,6 +658,8 @@ static int diag_cmd_set_msg_mask(unsigned char *src_buf, int src_len,
 	int write_len = 0;
 	int header_len = sizeof(struct diag_msg_build_mask_t);
 	int found = 0;
+	int changed = 0;
+	int tbl_index = 0;
 	uint32_t mask_size = 0;
 	uint32_t offset = 0;
 	struct diag_msg_mask_t *mask = NULL;
@@ -559,6 +692,7 @@ static int diag_cmd_set_msg_mask(unsigned char *src_buf, int src_len,
 		}
 		mask_next = NULL;
 		found = 1;
+		tbl_index = i;
 		mask_size = req->ssid_last - req->ssid_first + 1;
 		if (mask_size > MAX_SSID_PER_RANGE) {
 			pr_warn("diag: In %s, truncating ssid range, %d-%d to max allowed: %d\n",
@@ -584,6 +718,7 @@ static int diag_cmd_set_msg_mask(unsigned char *src_buf, int src_len,
 				return -ENOMEM;
 			}
 			mask->ptr = temp;
+			changed = 1;
 		}
 
 		offset = req->ssid_first - mask->ssid_first;
@@ -593,6 +728,9 @@ static int diag_cmd_set_msg_mask(unsigned char *src_buf, int src_len,
 			break;
 		}
 		mask_size = mask_size * sizeof(uint32_t);
+		if (msg_mask.status != DIAG_CTRL_MASK_VALID ||
+		    memcmp(mask->ptr + offset, src_buf + header_len, mask_size))
+			changed = 1;
 		memcpy(mask->ptr + offset, src_buf + header_len, mask_size);
 		msg_mask.status = DIAG_CTRL_MASK_VALID;
 		break;
@@ -619,10 +757,8 @@ static int diag_cmd_set_msg_mask(unsigned char *src_buf, int src_len,
 		mask_size = dest_len - write_len;
 	memcpy(dest_buf + write_len, src_buf + header_len, mask_size);
 	write_len += mask_size;
-	for (i = 0; i < NUM_SMD_CONTROL_CHANNELS; i++) {
-		diag_send_msg_mask_update(&driver->smd_cntl[i],
-					  req->ssid_first, req->ssid_last);
-	}
+	if (changed)
+		diag_mask_mark_msg(tbl_index);
 end:
 	return write_len;
 }
@@ -668,10 +804,7 @@ static int diag_cmd_set_all_msg_mask(unsigned char *src_buf, int src_len,
 	memcpy(dest_buf, &rsp, header_len);
 	write_len += header_len;
 
-	for (i = 0; i < NUM_SMD_CONTROL_CHANNELS; i++) {
-		diag_send_msg_mask_update(&driver->smd_cntl[i], ALL_SSID,
-					  ALL_SSID);
-	}
+	diag_mask_mark_msg(ALL_SSID);
 
 	return write_len;
 }
@@ -714,7 +847,7 @@ static int diag_cmd_get_event_mask(unsigned char *src_buf, int src_len,
 static int diag_cmd_update_event_mask(unsigned char *src_buf, int src_len,
 				      unsigned char *dest_buf, int dest_len)
 {
-	int i;
+	int changed = 0;
 	int write_len = 0;
 	int mask_len = 0;
 	int header_len = sizeof(struct diag_event_mask_config_t);
@@ -736,6 +869,9 @@ static int diag_cmd_update_event_mask(unsigned char *src_buf, int src_len,
 	}
 
 	mutex_lock(&event_mask.lock);
+	if (event_mask.status != DIAG_CTRL_MASK_VALID ||
+	    memcmp(event_mask.ptr, src_buf + header_len, mask_len))
+		changed = 1;
 	memcpy(event_mask.ptr, src_buf + header_len, mask_len);
 	event_mask.status = DIAG_CTRL_MASK_VALID;
 	mutex_unlock(&event_mask.lock);
@@ -754,8 +890,8 @@ static int diag_cmd_update_event_mask(unsigned char *src_buf, int src_len,
 	memcpy(dest_buf + write_len, event_mask.ptr, mask_len);
 	write_len += mask_len;
 
-	for (i = 0; i < NUM_SMD_CONTROL_CHANNELS; i++)
-		diag_send_event_mask_update(&driver->smd_cntl[i]);
+	if (changed)
+		diag_mask_mark_event();
 
 	return write_len;
 }
@@ -763,7 +899,6 @@ static int diag_cmd_update_event_mask(unsigned char *src_buf, int src_len,
 static int diag_cmd_toggle_events(unsigned char *src_buf, int src_len,
 				  unsigned char *dest_buf, int dest_len)
 {
-	int i;
 	int write_len = 0;
 	uint8_t toggle = 0;
 	struct diag_event_report_t header;
@@ -792,8 +927,7 @@ static int diag_cmd_toggle_events(unsigned char *src_buf, int src_len,
 	 */
 	header.cmd_code = DIAG_CMD_EVENT_TOGGLE;
 	header.padding = 0;
-	for (i = 0; i < NUM_SMD_CONTROL_CHANNELS; i++)
-		diag_send_event_mask_update(&driver->smd_cntl[i]);
+	diag_mask_mark_event();
 	memcpy(dest_buf, &header, sizeof(header));
 	write_len += sizeof(header);
 
@@ -915,9 +1049,11 @@ static int diag_cmd_set_log_mask(unsigned char *src_buf, int src_len,
 	int status = LOG_STATUS_SUCCESS;
 	int read_len = 0;
 	int payload_len = 0;
+	int changed = 0;
 	int req_header_len = sizeof(struct diag_log_config_req_t);
 	int rsp_header_len = sizeof(struct diag_log_config_set_rsp_t);
 	uint32_t mask_size = 0;
+	uint32_t num_items = 0;
 	struct diag_log_mask_t *mask = (struct diag_log_mask_t *)log_mask.ptr;
 	struct diag_log_config_req_t *req;
 	struct diag_log_config_set_rsp_t rsp;
@@ -940,6 +1076,7 @@ static int diag_cmd_set_log_mask(unsigned char *src_buf, int src_len,
 	for (i = 0; i < MAX_EQUIP_ID && !status; i++, mask++) {
 		if (mask->equip_id != req->equip_id)
 			continue;
+		num_items = mask->num_items;
 		if (req->num_items < mask->num_items)
 			mask->num_items = req->num_items;
 		mask_size = LOG_ITEMS_TO_SIZE(req->num_items);
@@ -954,6 +1091,11 @@ static int diag_cmd_set_log_mask(unsigned char *src_buf, int src_len,
 			mask->num_items = LOG_SIZE_TO_ITEMS(mask_size);
 			req->num_items = mask->num_items;
 		}
+		if (log_mask.status != DIAG_CTRL_MASK_VALID ||
+		    num_items != mask->num_items ||
+		    (mask_size > 0 &&
+		     memcmp(mask->ptr, src_buf + read_len, mask_size)))
+			changed = 1;
 		if (mask_size > 0)
 			memcpy(mask->ptr, src_buf + read_len, mask_size);
 		log_mask.status = DIAG_CTRL_MASK_VALID;
@@ -987,8 +1129,8 @@ static int diag_cmd_set_log_mask(unsigned char *src_buf, int src_len,
 	memcpy(dest_buf + write_len, src_buf + read_len, payload_len);
 	write_len += payload_len;
 
-	for (i = 0; i < NUM_SMD_CONTROL_CHANNELS; i++)
-		diag_send_log_mask_update(&driver->smd_cntl[i], req->equip_id);
+	if (changed)
+		diag_mask_mark_log(req->equip_id);
 end:
 	return write_len;
 }
@@ -1026,8 +1168,7 @@ static int diag_cmd_disable_log_mask(unsigned char *src_buf, int src_len,
 	header.status = LOG_STATUS_SUCCESS;
 	memcpy(dest_buf, &header, sizeof(struct diag_log_config_rsp_t));
 	write_len += sizeof(struct diag_log_config_rsp_t);
-	for (i = 0; i < NUM_SMD_CONTROL_CHANNELS; i++)
-		diag_send_log_mask_update(&driver->smd_cntl[i], ALL_EQUIP_ID);
+	diag_mask_mark_log(ALL_EQUIP_ID);
 
 	return write_len;
 }
@@ -1486,6 +1627,7 @@ int diag_copy_to_user_log_mask(char __user *buf, size_t count)
 
 void diag_mask_update_fn(struct work_struct *work)
 {
+	unsigned long flags;
 	struct diag_smd_info *smd_info = container_of(work,
 						struct diag_smd_info,
 						diag_notify_update_smd_work);
@@ -1495,6 +1637,15 @@ void diag_mask_update_fn(struct work_struct *work)
 		return;
 	}
 
+	/* The full masks sent below supersede anything still pending */
+	if (smd_info->peripheral >= 0 &&
+	    smd_info->peripheral < NUM_SMD_CONTROL_CHANNELS) {
+		spin_lock_irqsave(&mask_pending_lock, flags);
+		memset(&mask_pending[smd_info->peripheral], 0,
+		       sizeof(struct diag_mask_pending_t));
+		spin_unlock_irqrestore(&mask_pending_lock, flags);
+	}
+
 	diag_send_feature_mask_update(smd_info);
 	diag_send_msg_mask_update(smd_info, ALL_SSID, ALL_SSID);
 	diag_send_log_mask_update(smd_info, ALL_EQUIP_ID);
@@ -1606,6 +1757,7 @@ fail:
 
 void diag_masks_exit(void)
 {
+	cancel_delayed_work_sync(&diag_mask_flush_work);
 	diag_msg_mask_exit();
 	diag_build_time_mask_exit();
 	diag_log_mask_exit();
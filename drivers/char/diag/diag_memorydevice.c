@@ -22,6 +22,9 @@
 #include <linux/delay.h>
 #include <linux/kmemleak.h>
 #include <linux/uaccess.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/kref.h>
 #include "diag_memorydevice.h"
 #include "diagfwd_bridge.h"
 #include "diag_mux.h"
@@ -64,6 +67,292 @@ struct diag_md_info diag_md[NUM_DIAG_MD_DEV] = {
 #endif
 };
 
+static struct diag_md_ring *diag_md_shared;
+static DEFINE_SPINLOCK(diag_md_shared_lock);
+static DEFINE_MUTEX(diag_md_shared_mutex);
+
+static void diag_md_ring_release(struct kref *kref)
+{
+	struct diag_md_ring *ring = container_of(kref, struct diag_md_ring,
+						 kref);
+
+	vfree(ring->base);
+	kfree(ring);
+}
+
+static void diag_md_ring_vm_open(struct vm_area_struct *vma)
+{
+	unsigned long flags;
+	struct diag_md_ring *ring = vma->vm_private_data;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	ring->mapped++;
+	spin_unlock_irqrestore(&ring->lock, flags);
+	kref_get(&ring->kref);
+}
+
+static void diag_md_ring_vm_close(struct vm_area_struct *vma)
+{
+	unsigned long flags;
+	struct diag_md_ring *ring = vma->vm_private_data;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	ring->mapped--;
+	spin_unlock_irqrestore(&ring->lock, flags);
+	diag_md_ring_put(ring);
+}
+
+static const struct vm_operations_struct diag_md_ring_vm_ops = {
+	.open = diag_md_ring_vm_open,
+	.close = diag_md_ring_vm_close,
+};
+
+/*
+ * Allocates a ring covering the whole of @vma and maps it. The caller owns
+ * one reference and the mapping holds another, so the memory lives until
+ * both the owner has called diag_md_ring_put() and the last VMA is gone.
+ */
+struct diag_md_ring *diag_md_ring_create(struct vm_area_struct *vma)
+{
+	int err = 0;
+	unsigned long len = vma->vm_end - vma->vm_start;
+	struct diag_md_ring *ring = NULL;
+
+	if (len <= PAGE_SIZE || len - PAGE_SIZE > DIAG_MD_RING_MAX_SIZE)
+		return ERR_PTR(-EINVAL);
+
+	ring = kzalloc(sizeof(struct diag_md_ring), GFP_KERNEL);
+	if (!ring)
+		return ERR_PTR(-ENOMEM);
+
+	ring->base = vmalloc_user(len);
+	if (!ring->base) {
+		kfree(ring);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	err = remap_vmalloc_range(vma, ring->base, 0);
+	if (err) {
+		vfree(ring->base);
+		kfree(ring);
+		return ERR_PTR(err);
+	}
+
+	spin_lock_init(&ring->lock);
+	kref_init(&ring->kref);
+	kref_get(&ring->kref);
+	ring->mapped = 1;
+	ring->hdr = ring->base;
+	ring->data = (unsigned char *)ring->base + PAGE_SIZE;
+	ring->size = len - PAGE_SIZE;
+	ring->hdr->size = ring->size;
+	ring->hdr->magic = DIAG_MD_RING_MAGIC;
+
+	vma->vm_flags |= VM_DONTCOPY;
+	vma->vm_private_data = ring;
+	vma->vm_ops = &diag_md_ring_vm_ops;
+
+	return ring;
+}
+
+void diag_md_ring_put(struct diag_md_ring *ring)
+{
+	if (ring)
+		kref_put(&ring->kref, diag_md_ring_release);
+}
+
+int diag_md_ring_mapped(struct diag_md_ring *ring)
+{
+	int mapped = 0;
+	unsigned long flags;
+
+	if (!ring)
+		return 0;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	mapped = (ring->mapped > 0);
+	spin_unlock_irqrestore(&ring->lock, flags);
+
+	return mapped;
+}
+
+static unsigned int diag_md_ring_used_locked(struct diag_md_ring *ring,
+					     unsigned int tail)
+{
+	if (tail >= ring->size)
+		return 0;
+	if (ring->head >= tail)
+		return ring->head - tail;
+	return ring->size - tail + ring->head;
+}
+
+/* Returns the number of bytes the client has yet to consume */
+unsigned int diag_md_ring_used(struct diag_md_ring *ring)
+{
+	unsigned int used = 0;
+	unsigned long flags;
+
+	if (!ring)
+		return 0;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	if (ring->mapped)
+		used = diag_md_ring_used_locked(ring,
+					ACCESS_ONCE(ring->hdr->tail));
+	spin_unlock_irqrestore(&ring->lock, flags);
+
+	return used;
+}
+
+/*
+ * Copies one record into @ring. On success returns the number of bytes
+ * that were pending before the record was added, so that a return of 0
+ * tells the caller the client may be waiting for a wakeup. Returns
+ * -ENODEV when the ring is no longer mapped and -ENOSPC when the record
+ * was dropped for lack of room, which is also counted in hdr->dropped.
+ */
+int diag_md_ring_insert(struct diag_md_ring *ring, int token,
+			unsigned char *buf, int len)
+{
+	int used = 0;
+	unsigned int head, tail, need, off, next;
+	unsigned long flags;
+	struct diag_md_ring_rec rec;
+
+	if (!ring || !buf || len < 0)
+		return -EINVAL;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	if (!ring->mapped) {
+		spin_unlock_irqrestore(&ring->lock, flags);
+		return -ENODEV;
+	}
+
+	head = ring->head;
+	tail = ACCESS_ONCE(ring->hdr->tail);
+	/* Order the tail load before we overwrite what the client released */
+	smp_mb();
+	need = ALIGN(sizeof(rec) + len, 4);
+	if (tail >= ring->size || (tail & 3))
+		goto drop;
+
+	if (head >= tail) {
+		if (ring->size - head > need ||
+		    (ring->size - head == need && tail > 0)) {
+			off = head;
+		} else if (tail > need) {
+			if (ring->size - head >= sizeof(rec)) {
+				rec.len = DIAG_MD_RING_WRAP;
+				rec.token = 0;
+				memcpy(ring->data + head, &rec, sizeof(rec));
+			}
+			off = 0;
+		} else {
+			goto drop;
+		}
+	} else {
+		if (tail - head <= need)
+			goto drop;
+		off = head;
+	}
+
+	used = diag_md_ring_used_locked(ring, tail);
+	rec.len = len;
+	rec.token = token;
+	memcpy(ring->data + off, &rec, sizeof(rec));
+	memcpy(ring->data + off + sizeof(rec), buf, len);
+	next = off + need;
+	if (next == ring->size)
+		next = 0;
+
+	/* Publish the record before the client can see the new head */
+	smp_wmb();
+	ring->hdr->head = next;
+	ring->head = next;
+	spin_unlock_irqrestore(&ring->lock, flags);
+
+	return used;
+
+drop:
+	ring->hdr->dropped = ++ring->dropped;
+	spin_unlock_irqrestore(&ring->lock, flags);
+	return -ENOSPC;
+}
+
+int diag_md_mmap(struct vm_area_struct *vma)
+{
+	int err = 0;
+	unsigned long flags;
+	struct diag_md_ring *ring = NULL;
+	struct diag_md_ring *old = NULL;
+
+	if (vma->vm_pgoff != 0)
+		return -EINVAL;
+	if (current->tgid != driver->logging_process_id)
+		return -EPERM;
+
+	mutex_lock(&diag_md_shared_mutex);
+	if (diag_md_ring_mapped(diag_md_shared)) {
+		err = -EBUSY;
+		goto fail;
+	}
+
+	ring = diag_md_ring_create(vma);
+	if (IS_ERR(ring)) {
+		err = PTR_ERR(ring);
+		goto fail;
+	}
+
+	spin_lock_irqsave(&diag_md_shared_lock, flags);
+	old = diag_md_shared;
+	diag_md_shared = ring;
+	spin_unlock_irqrestore(&diag_md_shared_lock, flags);
+	diag_md_ring_put(old);
+
+fail:
+	mutex_unlock(&diag_md_shared_mutex);
+	return err;
+}
+
+int diag_md_mmap_pending(void)
+{
+	int pending = 0;
+	unsigned long flags;
+
+	spin_lock_irqsave(&diag_md_shared_lock, flags);
+	pending = (diag_md_ring_used(diag_md_shared) > 0);
+	spin_unlock_irqrestore(&diag_md_shared_lock, flags);
+
+	return pending;
+}
+
+/*
+ * Copies a frame into the logging process's shared ring. Returns -ENODEV
+ * when no ring is mapped, in which case the frame goes through the table.
+ */
+static int diag_md_mmap_write(int id, unsigned char *buf, int len)
+{
+	int err = -ENODEV;
+	unsigned long flags;
+
+	spin_lock_irqsave(&diag_md_shared_lock, flags);
+	if (diag_md_shared)
+		err = diag_md_ring_insert(diag_md_shared,
+					  (id > 0) ? diag_get_remote(id) : 0,
+					  buf, len);
+	spin_unlock_irqrestore(&diag_md_shared_lock, flags);
+
+	if (err == -ENODEV)
+		return err;
+	if (err == -ENOSPC)
+		pr_err_ratelimited("diag: In %s, shared ring full, dropping %d bytes, proc: %d\n",
+				   __func__, len, id);
+	else if (err == 0)
+		wake_up_interruptible(&driver->wait_q);
+
+	return 0;
+}
+
 int diag_md_register(int id, int ctx, struct diag_mux_ops *ops)
 {
 	if (id < 0 || id >= NUM_DIAG_MD_DEV || !ops)
@@ -137,6 +426,19 @@ int diag_md_write(int id, unsigned char *buf, int len, int ctx)
 		return -EINVAL;
 
 	ch = &diag_md[id];
+
+	/*
+	 * If the logging process has mapped the shared ring, the frame is
+	 * copied there and the buffer is handed back right away.
+	 */
+	if (!diag_md_mmap_write(id, buf, len)) {
+		spin_lock_irqsave(&ch->lock, flags);
+		if (ch->ops && ch->ops->write_done)
+			ch->ops->write_done(buf, len, ctx,
+					    DIAG_MEMORY_DEVICE_MODE);
+		spin_unlock_irqrestore(&ch->lock, flags);
+		return 0;
+	}
 	spin_lock_irqsave(&ch->lock, flags);
 	for (i = 0; i < ch->num_tbl_entries && !found; i++) {
 		if (ch->tbl[i].buf != buf)
@@ -280,7 +582,8 @@ int diag_md_init()
 
 	for (i = 0; i < NUM_DIAG_MD_DEV; i++) {
 		ch = &diag_md[i];
-		ch->num_tbl_entries = diag_mempools[ch->mempool].poolsize;
+		ch->num_tbl_entries = diag_mempools[ch->mempool].poolsize +
+				      diag_mempools[ch->mempool].burst;
 		ch->tbl = kzalloc(ch->num_tbl_entries *
 				  sizeof(struct diag_buf_tbl_t),
 				  GFP_KERNEL);
@@ -43,6 +43,20 @@ struct diag_md_info {
 	struct diag_mux_ops *ops;
 };
 
+#define DIAG_MD_RING_MAX_SIZE	(4 * 1024 * 1024)
+
+struct diag_md_ring {
+	struct kref kref;
+	int mapped;
+	unsigned int size;
+	unsigned int head;
+	unsigned int dropped;
+	void *base;
+	unsigned char *data;
+	struct diag_md_ring_hdr *hdr;
+	spinlock_t lock;
+};
+
 extern struct diag_md_info diag_md[NUM_DIAG_MD_DEV];
 
 int diag_md_init(void);
@@ -52,4 +66,12 @@ void diag_md_close_all(void);
 int diag_md_register(int id, int ctx, struct diag_mux_ops *ops);
 int diag_md_write(int id, unsigned char *buf, int len, int ctx);
 int diag_md_copy_to_user(char __user *buf, int *pret, size_t buf_size);
+struct diag_md_ring *diag_md_ring_create(struct vm_area_struct *vma);
+void diag_md_ring_put(struct diag_md_ring *ring);
+int diag_md_ring_mapped(struct diag_md_ring *ring);
+unsigned int diag_md_ring_used(struct diag_md_ring *ring);
+int diag_md_ring_insert(struct diag_md_ring *ring, int token,
+			unsigned char *buf, int len);
+int diag_md_mmap(struct vm_area_struct *vma);
+int diag_md_mmap_pending(void);
 #endif
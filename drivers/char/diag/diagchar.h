@@ -307,6 +307,32 @@ struct diag_mask_info {
 	struct mutex lock;
 };
 
+/*
+ * Single producer/single consumer byte ring that decouples draining an
+ * SMD data channel from handing the data to the logging transport. The
+ * producer is the channel's read work, the consumer its drain work, so
+ * head and tail each have exactly one writer. Records are a u32 length
+ * followed by the packet payload and may wrap around the end.
+ */
+struct diag_smd_ring {
+	unsigned char *buf;
+	unsigned int size;	/* power of two, 0 if the ring is disabled */
+	unsigned int head;	/* written by the producer only */
+	unsigned int tail;	/* written by the consumer only */
+	/* producer state for a packet only partially read from SMD */
+	unsigned int wr_len;
+	unsigned int wr_done;
+	int wr_drop;
+	int stalled;
+	/* statistics */
+	unsigned long pkts;
+	unsigned long bytes;
+	unsigned long dropped_pkts;
+	unsigned long dropped_bytes;
+	unsigned long full;
+	unsigned int max_used;
+};
+
 struct diag_smd_info {
 	int peripheral;	/* The peripheral this smd channel communicates with */
 	int type;	/* The type of smd channel (data, control, dci) */
@@ -339,6 +365,9 @@ struct diag_smd_info {
 
 	struct workqueue_struct *wq;
 
+	struct diag_smd_ring ring;
+	struct work_struct diag_ring_drain_work;
+
 	struct work_struct diag_read_smd_work;
 	struct work_struct diag_notify_update_smd_work;
 	int notify_context;
@@ -448,6 +477,7 @@ struct diagchar_dev {
 	int usb_connected;
 #endif
 	struct workqueue_struct *diag_wq;
+	struct workqueue_struct *diag_ring_wq;
 	struct work_struct diag_drain_work;
 	struct workqueue_struct *diag_cntl_wq;
 	uint8_t log_on_demand_support;
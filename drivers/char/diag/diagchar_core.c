@@ -23,6 +23,7 @@
 #include <linux/sched.h>
 #include <linux/ratelimit.h>
 #include <linux/timer.h>
+#include <linux/poll.h>
 #ifdef CONFIG_DIAG_OVER_USB
 #include <linux/usb/usbdiag.h>
 #endif
@@ -76,6 +77,12 @@ module_param(poolsize, uint, 0);
 static unsigned int itemsize_hdlc = DIAG_HDLC_BUF_SIZE;
 static unsigned int poolsize_hdlc = 10;
 module_param(poolsize_hdlc, uint, 0);
+/*
+ * Extra HDLC buffers that may be allocated while all poolsize_hdlc of them
+ * are in flight to the host, so that heavy logging doesn't stall on USB.
+ */
+static unsigned int poolsize_hdlc_burst = 16;
+module_param(poolsize_hdlc_burst, uint, 0);
 
 /*
  * This is used for incoming DCI requests from the user space clients.
@@ -999,6 +1006,28 @@ static int diag_ioctl_dci_reg(unsigned long ioarg)
 	return result;
 }
 
+static int diag_ioctl_dci_reg_batch(unsigned long ioarg)
+{
+	int result = -EINVAL;
+	struct diag_dci_reg_batch_t params;
+	struct diag_dci_client_tbl *dci_client = NULL;
+
+	if (copy_from_user(&params, (void __user *)ioarg,
+				sizeof(struct diag_dci_reg_batch_t)))
+		return -EFAULT;
+
+	result = diag_dci_register_client(&params.reg);
+	if (result != params.reg.client_id)
+		return result;
+
+	mutex_lock(&driver->dci_mutex);
+	dci_client = diag_dci_get_client_entry(result);
+	diag_dci_set_batch(dci_client, params.batch_bytes, params.batch_ms);
+	mutex_unlock(&driver->dci_mutex);
+
+	return result;
+}
+
 static int diag_ioctl_dci_health_stats(unsigned long ioarg)
 {
 	int result = -EINVAL;
@@ -1267,6 +1296,9 @@ long diagchar_compat_ioctl(struct file *filp,
 	case DIAG_IOCTL_DCI_REG:
 		result = diag_ioctl_dci_reg(ioarg);
 		break;
+	case DIAG_IOCTL_DCI_REG_BATCH:
+		result = diag_ioctl_dci_reg_batch(ioarg);
+		break;
 	case DIAG_IOCTL_DCI_DEINIT:
 		if (copy_from_user((void *)&client_id, (void __user *)ioarg,
 			sizeof(int)))
@@ -1364,6 +1396,9 @@ long diagchar_ioctl(struct file *filp,
 	case DIAG_IOCTL_DCI_REG:
 		result = diag_ioctl_dci_reg(ioarg);
 		break;
+	case DIAG_IOCTL_DCI_REG_BATCH:
+		result = diag_ioctl_dci_reg_batch(ioarg);
+		break;
 	case DIAG_IOCTL_DCI_DEINIT:
 		if (copy_from_user((void *)&client_id, (void __user *)ioarg,
 			sizeof(int)))
@@ -2228,9 +2263,44 @@ int mask_request_validate(unsigned char mask_buf[])
 	return 0;
 }
 
+static unsigned int diagchar_poll(struct file *file, poll_table *wait)
+{
+	int i;
+	unsigned int mask = 0;
+
+	poll_wait(file, &driver->wait_q, wait);
+
+	for (i = 0; i < driver->num_clients; i++) {
+		if (driver->client_map[i].pid != current->tgid)
+			continue;
+		if (driver->data_ready[i])
+			mask |= POLLIN | POLLRDNORM;
+		break;
+	}
+
+	if (current->tgid == driver->logging_process_id &&
+	    diag_md_mmap_pending())
+		mask |= POLLIN | POLLRDNORM;
+
+	if (diag_dci_mmap_ready(current->tgid))
+		mask |= POLLIN | POLLRDNORM;
+
+	return mask;
+}
+
+static int diagchar_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	if (vma->vm_pgoff == (DIAG_DCI_RING_OFFSET >> PAGE_SHIFT))
+		return diag_dci_mmap(vma);
+
+	return diag_md_mmap(vma);
+}
+
 static const struct file_operations diagcharfops = {
 	.owner = THIS_MODULE,
 	.read = diagchar_read,
+	.poll = diagchar_poll,
+	.mmap = diagchar_mmap,
 	.write = diagchar_write,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = diagchar_compat_ioctl,
@@ -2334,6 +2404,9 @@ static int __init diagchar_init(void)
 	diagmem_setsize(POOL_TYPE_MUX_APPS, itemsize_usb_apps,
 			poolsize_usb_apps + 1 + (NUM_SMD_DATA_CHANNELS * 2) +
 			NUM_SMD_CMD_CHANNELS);
+	/* Every extra HDLC buffer needs a MUX write slot as well */
+	diagmem_setburst(POOL_TYPE_HDLC, poolsize_hdlc_burst);
+	diagmem_setburst(POOL_TYPE_MUX_APPS, poolsize_hdlc_burst);
 	diagmem_setsize(POOL_TYPE_DCI, itemsize_dci, poolsize_dci);
 	driver->num_clients = max_clients;
 	driver->logging_mode = USB_MODE;
@@ -2363,6 +2436,7 @@ static int __init diagchar_init(void)
 	ret = diag_mux_init();
 	if (ret)
 		goto fail;
+	diag_hdlc_init();
 	ret = diagfwd_init();
 	if (ret)
 		goto fail;
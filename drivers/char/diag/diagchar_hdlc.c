@@ -20,6 +20,7 @@
 #include <linux/uaccess.h>
 #include <linux/ratelimit.h>
 #include <linux/crc-ccitt.h>
+#include <asm/unaligned.h>
 #include "diagchar_hdlc.h"
 #include "diagchar.h"
 
@@ -31,6 +32,62 @@ MODULE_LICENSE("GPL v2");
 #define CRC_16_L_STEP(xx_crc, xx_c) \
 	crc_ccitt_byte(xx_crc, xx_c)
 
+/*
+ * Slicing-by-4 tables for CRC-CCITT: diag_crc_table[k][n] is the CRC
+ * contribution of byte n followed by k zero bytes, so four bytes can be
+ * folded into the CRC with four independent table lookups.
+ */
+static uint16_t diag_crc_table[4][256];
+
+void diag_hdlc_init(void)
+{
+	int i, k;
+	uint16_t crc;
+
+	for (i = 0; i < 256; i++)
+		diag_crc_table[0][i] = crc_ccitt_table[i];
+
+	for (k = 1; k < 4; k++) {
+		for (i = 0; i < 256; i++) {
+			crc = diag_crc_table[k - 1][i];
+			diag_crc_table[k][i] = (crc >> 8) ^
+				crc_ccitt_table[crc & 0xFF];
+		}
+	}
+}
+
+static inline uint16_t diag_crc_step4(uint16_t crc, uint32_t le_word)
+{
+	uint32_t x = crc ^ le_word;
+
+	return diag_crc_table[3][x & 0xFF] ^
+	       diag_crc_table[2][(x >> 8) & 0xFF] ^
+	       diag_crc_table[1][(x >> 16) & 0xFF] ^
+	       diag_crc_table[0][x >> 24];
+}
+
+static uint16_t diag_crc_ccitt(uint16_t crc, const uint8_t *buf,
+			       unsigned int len)
+{
+	for (; len >= 4; len -= 4, buf += 4)
+		crc = diag_crc_step4(crc, get_unaligned_le32(buf));
+
+	while (len--)
+		crc = CRC_16_L_STEP(crc, *buf++);
+
+	return crc;
+}
+
+/* True if none of the four bytes needs escaping (0x7E or 0x7D) */
+static inline int diag_hdlc_word_clean(uint32_t v)
+{
+	uint32_t x = v ^ 0x7E7E7E7E;
+	uint32_t y = v ^ 0x7D7D7D7D;
+
+	return !((((x - 0x01010101) & ~x) | ((y - 0x01010101) & ~y)) &
+		 0x80808080);
+}
+
 void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 		      struct diag_hdlc_dest_type *enc)
 {
@@ -67,6 +124,25 @@ void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 			   of 2 dest bytes for an escaped byte */
 			while (src <= src_last && dest <= dest_last) {
 
+				/*
+				 * Fast path: copy runs that need no escaping
+				 * a word at a time while both sides have room
+				 */
+				while (src + 3 <= src_last &&
+				       dest + 3 <= dest_last) {
+					uint32_t v = get_unaligned_le32(src);
+
+					if (!diag_hdlc_word_clean(v))
+						break;
+					put_unaligned_le32(v, dest);
+					crc = diag_crc_step4(crc, v);
+					src += 4;
+					dest += 4;
+					used += 4;
+				}
+				if (src > src_last || dest > dest_last)
+					break;
+
 				src_byte = *src++;
 
 				if ((src_byte == CONTROL_CHAR) ||
@@ -192,6 +268,26 @@ int diag_hdlc_decode(struct diag_hdlc_decode_type *hdlc)
 
 		for (i = 0; i < src_length; i++) {
 
+			/*
+			 * Fast path: unescaped runs are copied a word at a
+			 * time; the byte loop below handles the rest,
+			 * including running out of destination space.
+			 */
+			if (!hdlc->escaping) {
+				while (i + 4 <= src_length &&
+				       len + 4 < dest_length &&
+				       diag_hdlc_word_clean(get_unaligned(
+						(uint32_t *)&src_ptr[i]))) {
+					put_unaligned(get_unaligned(
+						(uint32_t *)&src_ptr[i]),
+						(uint32_t *)&dest_ptr[len]);
+					i += 4;
+					len += 4;
+				}
+				if (i >= src_length)
+					break;
+			}
+
 			src_byte = src_ptr[i];
 
 			if (hdlc->escaping) {
@@ -251,7 +347,7 @@ int crc_check(uint8_t *buf, uint16_t len)
 	 * Run CRC check for the original input. Skip the last 3 CRC
 	 * bytes
 	 */
-	crc = crc_ccitt(crc, buf, len-3);
+	crc = diag_crc_ccitt(crc, buf, len-3);
 	crc ^= CRC_16_L_SEED;
 
 	/* Check the computed CRC against the original CRC bytes. */
@@ -18,6 +18,9 @@
 #include <linux/sched.h>
 #include <linux/ratelimit.h>
 #include <linux/workqueue.h>
+#include <linux/circ_buf.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
 #include <linux/pm_runtime.h>
 #include <linux/diagchar.h>
 #include <linux/delay.h>
@@ -51,6 +54,14 @@
 
 #define SMD_DRAIN_BUF_SIZE 4096
 
+/*
+ * Size in bytes of the ring buffering each peripheral's SMD data channel,
+ * rounded up to a power of two; 0 reads straight into the in_busy buffers.
+ */
+static unsigned int smd_ring_size = 131072;
+module_param(smd_ring_size, uint, S_IRUGO);
+MODULE_PARM_DESC(smd_ring_size, "Per peripheral SMD data ring size");
+
 int diag_debug_buf_idx;
 unsigned char diag_debug_buf[1024];
 /* Number of entries in table of buffers */
@@ -518,6 +529,245 @@ static int diag_smd_resize_buf(struct diag_smd_info *smd_info, void **buf,
 	return success;
 }
 
+static void diag_smd_ring_copy_in(struct diag_smd_ring *ring,
+				  unsigned int pos, const void *src,
+				  unsigned int len)
+{
+	unsigned int first = min(len, ring->size - pos);
+
+	memcpy(ring->buf + pos, src, first);
+	memcpy(ring->buf, src + first, len - first);
+}
+
+static void diag_smd_ring_copy_out(struct diag_smd_ring *ring,
+				   unsigned int pos, void *dst,
+				   unsigned int len)
+{
+	unsigned int first = min(len, ring->size - pos);
+
+	memcpy(dst, ring->buf + pos, first);
+	memcpy(dst + first, ring->buf, len - first);
+}
+
+/* Read @len bytes of the current SMD packet into the ring at @pos */
+static void diag_smd_ring_read(struct diag_smd_info *smd_info,
+			       unsigned int pos, unsigned int len)
+{
+	struct diag_smd_ring *ring = &smd_info->ring;
+	unsigned int first = min(len, ring->size - pos);
+
+	smd_read(smd_info->ch, ring->buf + pos, first);
+	if (len > first)
+		smd_read(smd_info->ch, ring->buf, len - first);
+}
+
+/*
+ * Producer: move every complete or partial packet the SMD fifo holds into
+ * the ring, so the peripheral can keep logging while the transport is
+ * still busy with earlier buffers. Only stops early when the ring is full.
+ */
+static void diag_smd_ring_fill(struct diag_smd_info *smd_info)
+{
+	struct diag_smd_ring *ring = &smd_info->ring;
+	unsigned int mask = ring->size - 1;
+	unsigned int pkt_len, avail, used;
+	uint32_t hdr;
+
+	while (smd_info->ch) {
+		if (!ring->wr_len) {
+			pkt_len = smd_cur_packet_size(smd_info->ch);
+			if (!pkt_len)
+				break;
+
+			if (pkt_len > MAX_IN_BUF_SIZE ||
+			    pkt_len + sizeof(hdr) >= ring->size) {
+				pr_err_ratelimited("diag: In %s, SMD peripheral: %d, dropping packet of %d bytes\n",
+					__func__, smd_info->peripheral,
+					pkt_len);
+				ring->wr_drop = 1;
+			} else if (CIRC_SPACE(ring->head,
+					      ACCESS_ONCE(ring->tail),
+					      ring->size) <
+						pkt_len + sizeof(hdr)) {
+				ring->stalled = 1;
+				/* pairs with the barrier in the consumer */
+				smp_mb();
+				if (CIRC_SPACE(ring->head,
+					       ACCESS_ONCE(ring->tail),
+					       ring->size) <
+						pkt_len + sizeof(hdr)) {
+					ring->full++;
+					break;
+				}
+				ring->stalled = 0;
+			}
+			ring->wr_len = pkt_len;
+			ring->wr_done = 0;
+		}
+
+		avail = smd_read_avail(smd_info->ch);
+		if (!avail)
+			break;
+		avail = min(avail, ring->wr_len - ring->wr_done);
+
+		if (ring->wr_drop)
+			smd_read(smd_info->ch, NULL, avail);	/* discard */
+		else
+			diag_smd_ring_read(smd_info, (ring->head +
+				sizeof(hdr) + ring->wr_done) & mask, avail);
+		ring->wr_done += avail;
+		if (ring->wr_done < ring->wr_len)
+			continue;
+
+		if (ring->wr_drop) {
+			ring->dropped_pkts++;
+			ring->dropped_bytes += ring->wr_len;
+			ring->wr_drop = 0;
+		} else {
+			hdr = ring->wr_len;
+			diag_smd_ring_copy_in(ring, ring->head, &hdr,
+					      sizeof(hdr));
+			/* publish the record only once it is complete */
+			smp_wmb();
+			ACCESS_ONCE(ring->head) = (ring->head + sizeof(hdr) +
+						   ring->wr_len) & mask;
+			ring->pkts++;
+			ring->bytes += ring->wr_len;
+			used = CIRC_CNT(ring->head, ACCESS_ONCE(ring->tail),
+					ring->size);
+			if (used > ring->max_used)
+				ring->max_used = used;
+		}
+		ring->wr_len = 0;
+	}
+
+	if (CIRC_CNT(ring->head, ACCESS_ONCE(ring->tail), ring->size))
+		queue_work(driver->diag_ring_wq,
+			   &smd_info->diag_ring_drain_work);
+	else if (driver->logging_mode == MEMORY_DEVICE_MODE)
+		diag_ws_release();
+}
+
+/* Find a buffer for the consumer, in the order diag_smd_send_req uses */
+static void *diag_smd_ring_get_buf(struct diag_smd_info *smd_info,
+				   unsigned int *buf_size)
+{
+	if (smd_info->encode_hdlc) {
+		if (!smd_info->in_busy_1) {
+			*buf_size = smd_info->buf_in_1_raw_size;
+			return smd_info->buf_in_1_raw;
+		} else if (!smd_info->in_busy_2) {
+			*buf_size = smd_info->buf_in_2_raw_size;
+			return smd_info->buf_in_2_raw;
+		}
+	} else {
+		if (!smd_info->in_busy_1) {
+			*buf_size = smd_info->buf_in_1_size;
+			return smd_info->buf_in_1;
+		} else if (!smd_info->in_busy_2) {
+			*buf_size = smd_info->buf_in_2_size;
+			return smd_info->buf_in_2;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Consumer: copy ring records into whichever in_busy buffer is free and
+ * pass it on. Data the apps side HDLC encodes gets one packet per buffer
+ * so that every packet keeps its own frame; pre-encoded data is batched.
+ */
+static void diag_smd_ring_drain_work_fn(struct work_struct *work)
+{
+	struct diag_smd_info *smd_info = container_of(work,
+						struct diag_smd_info,
+						diag_ring_drain_work);
+	struct diag_smd_ring *ring = &smd_info->ring;
+	unsigned int mask = ring->size - 1;
+	unsigned int head, tail, buf_size = 0;
+	int len;
+	uint32_t pkt_len;
+	void *buf;
+
+	for (;;) {
+		head = ACCESS_ONCE(ring->head);
+		/* read the records only after seeing the new head */
+		smp_rmb();
+		tail = ring->tail;
+		if (head == tail)
+			break;
+
+		buf = diag_smd_ring_get_buf(smd_info, &buf_size);
+		if (!buf)
+			return;	/* diag_smd_reset_buf() brings us back */
+
+		len = 0;
+		do {
+			diag_smd_ring_copy_out(ring, tail, &pkt_len,
+					       sizeof(pkt_len));
+			if (len + pkt_len > buf_size) {
+				if (len)
+					break;
+				if (!diag_smd_resize_buf(smd_info, &buf,
+						&buf_size, pkt_len) ||
+				    pkt_len > buf_size) {
+					ring->dropped_pkts++;
+					ring->dropped_bytes += pkt_len;
+					tail = (tail + sizeof(pkt_len) +
+						pkt_len) & mask;
+					continue;
+				}
+			}
+			diag_smd_ring_copy_out(ring,
+				(tail + sizeof(pkt_len)) & mask,
+				buf + len, pkt_len);
+			len += pkt_len;
+			tail = (tail + sizeof(pkt_len) + pkt_len) & mask;
+		} while (!smd_info->encode_hdlc && tail != head);
+
+		/* finish reading the records before handing the space back */
+		smp_mb();
+		ACCESS_ONCE(ring->tail) = tail;
+		/* pairs with the barrier in the producer */
+		smp_mb();
+		if (ACCESS_ONCE(ring->stalled)) {
+			ring->stalled = 0;
+			queue_work(smd_info->wq,
+				   &smd_info->diag_read_smd_work);
+		}
+
+		if (len > 0)
+			smd_info->process_smd_read_data(smd_info, buf, len);
+	}
+
+	if (driver->logging_mode == MEMORY_DEVICE_MODE)
+		diag_ws_release();
+}
+
+static int diag_smd_ring_init(struct diag_smd_info *smd_info)
+{
+	struct diag_smd_ring *ring = &smd_info->ring;
+
+	memset(ring, 0, sizeof(*ring));
+	INIT_WORK(&smd_info->diag_ring_drain_work,
+		  diag_smd_ring_drain_work_fn);
+	if (!smd_ring_size)
+		return 0;
+
+	ring->size = roundup_pow_of_two(max_t(unsigned int, smd_ring_size,
+					      MAX_IN_BUF_SIZE));
+	ring->buf = vzalloc(ring->size);
+	if (!ring->buf) {
+		pr_err("diag: In %s, SMD peripheral: %d, unable to allocate %u byte ring, reading directly\n",
+			__func__, smd_info->peripheral, ring->size);
+		ring->size = 0;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
 void diag_smd_send_req(struct diag_smd_info *smd_info)
 {
 	void *buf = NULL, *temp_buf = NULL;
@@ -534,6 +784,11 @@ void diag_smd_send_req(struct diag_smd_info *smd_info)
 		return;
 	}
 
+	if (smd_info->type == SMD_DATA_TYPE && smd_info->ring.buf) {
+		diag_smd_ring_fill(smd_info);
+		return;
+	}
+
 	/* Determine the buffer to read the data into. */
 	if (smd_info->type == SMD_DATA_TYPE) {
 		/* If the data is raw and not hdlc encoded */
@@ -1808,8 +2063,13 @@ int device_supports_separate_cmdrsp(void)
 
 void diag_smd_destructor(struct diag_smd_info *smd_info)
 {
-	if (smd_info->type == SMD_DATA_TYPE)
+	if (smd_info->type == SMD_DATA_TYPE) {
+		if (smd_info->ring.buf)
+			cancel_work_sync(&smd_info->diag_ring_drain_work);
 		destroy_workqueue(smd_info->wq);
+		vfree(smd_info->ring.buf);
+		smd_info->ring.buf = NULL;
+	}
 
 	if (smd_info->ch)
 		smd_close(smd_info->ch);
@@ -1956,6 +2216,8 @@ int diag_smd_constructor(struct diag_smd_info *smd_info, int peripheral,
 		}
 		if (!smd_info->wq)
 			goto err;
+		/* Fall back to direct reads if the ring can't be allocated */
+		diag_smd_ring_init(smd_info);
 	} else {
 		smd_info->wq = NULL;
 	}
@@ -2109,6 +2371,13 @@ int diagfwd_init(void)
 		driver->stm_state[i] = DISABLE_STM;
 	}
 
+	/* Unbound so that each peripheral's ring drains in parallel */
+	driver->diag_ring_wq = alloc_workqueue("diag_ring_wq",
+					       WQ_UNBOUND | WQ_HIGHPRI,
+					       NUM_SMD_DATA_CHANNELS);
+	if (!driver->diag_ring_wq)
+		goto err;
+
 	for (i = 0; i < NUM_SMD_DATA_CHANNELS; i++) {
 		ret = diag_smd_constructor(&driver->smd_data[i], i,
 							SMD_DATA_TYPE);
@@ -2207,6 +2476,8 @@ err:
 	kfree(driver->user_space_data_buf);
 	if (driver->diag_wq)
 		destroy_workqueue(driver->diag_wq);
+	if (driver->diag_ring_wq)
+		destroy_workqueue(driver->diag_ring_wq);
 	return -ENOMEM;
 }
 
@@ -2237,4 +2508,5 @@ void diagfwd_exit(void)
 	kfree(driver->apps_rsp_buf);
 	kfree(driver->user_space_data_buf);
 	destroy_workqueue(driver->diag_wq);
+	destroy_workqueue(driver->diag_ring_wq);
 }
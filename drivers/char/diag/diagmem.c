@@ -22,6 +22,7 @@
 #include <linux/slab.h>
 #include <linux/of.h>
 #include <linux/kmemleak.h>
+#include <linux/percpu.h>
 
 #include "diagchar.h"
 #include "diagmem.h"
@@ -33,7 +34,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	},
 	{
 		.id = POOL_TYPE_HDLC,
@@ -41,7 +42,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	},
 	{
 		.id = POOL_TYPE_USER,
@@ -49,7 +50,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	},
 	{
 		.id = POOL_TYPE_MUX_APPS,
@@ -57,7 +58,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	},
 	{
 		.id = POOL_TYPE_DCI,
@@ -65,7 +66,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	},
 #ifdef CONFIG_DIAGFWD_BRIDGE_CODE
 	{
@@ -74,7 +75,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	},
 	{
 		.id = POOL_TYPE_MDM2,
@@ -82,7 +83,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	},
 	{
 		.id = POOL_TYPE_MDM_DCI,
@@ -90,7 +91,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	},
 	{
 		.id = POOL_TYPE_MDM2_DCI,
@@ -98,7 +99,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	},
 	{
 		.id = POOL_TYPE_MDM_MUX,
@@ -106,7 +107,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	},
 	{
 		.id = POOL_TYPE_MDM2_MUX,
@@ -114,7 +115,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	},
 	{
 		.id = POOL_TYPE_MDM_DCI_WRITE,
@@ -122,7 +123,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	},
 	{
 		.id = POOL_TYPE_MDM2_DCI_WRITE,
@@ -130,7 +131,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	},
 	{
 		.id = POOL_TYPE_QSC_MUX,
@@ -138,7 +139,7 @@ struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS] = {
 		.pool = NULL,
 		.itemsize = 0,
 		.poolsize = 0,
-		.count = 0
+		.count = ATOMIC_INIT(0)
 	}
 #endif
 };
@@ -158,11 +159,80 @@ void diagmem_setsize(int pool_idx, int itemsize, int poolsize)
 		 diag_mempools[pool_idx].poolsize);
 }
 
+void diagmem_setburst(int pool_idx, int burst)
+{
+	if (pool_idx < 0 || pool_idx >= NUM_MEMORY_POOLS) {
+		pr_err("diag: Invalid pool index %d in %s\n", pool_idx,
+		       __func__);
+		return;
+	}
+
+	diag_mempools[pool_idx].burst = burst;
+}
+
+static void *diagmem_cache_get(struct diag_mempool_t *mempool)
+{
+	void *buf = NULL;
+	unsigned long flags;
+	struct diag_mempool_cache_t *cache = NULL;
+
+	if (!mempool->cache)
+		return NULL;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(mempool->cache);
+	if (cache->num > 0) {
+		buf = cache->items[--cache->num];
+		cache->hits++;
+	} else {
+		cache->misses++;
+	}
+	local_irq_restore(flags);
+
+	return buf;
+}
+
+static int diagmem_cache_put(struct diag_mempool_t *mempool, void *buf)
+{
+	int ret = 0;
+	unsigned long flags;
+	struct diag_mempool_cache_t *cache = NULL;
+
+	if (!mempool->cache)
+		return 0;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(mempool->cache);
+	if (cache->num < DIAG_MEMPOOL_CACHE_SIZE) {
+		cache->items[cache->num++] = buf;
+		ret = 1;
+	}
+	local_irq_restore(flags);
+
+	return ret;
+}
+
+static void diagmem_cache_drain(struct diag_mempool_t *mempool)
+{
+	int cpu;
+	struct diag_mempool_cache_t *cache = NULL;
+
+	if (!mempool->cache)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		cache = per_cpu_ptr(mempool->cache, cpu);
+		while (cache->num > 0)
+			mempool_free(cache->items[--cache->num],
+				     mempool->pool);
+	}
+}
+
 void *diagmem_alloc(struct diagchar_dev *driver, int size, int pool_type)
 {
 	void *buf = NULL;
 	int i = 0;
-	unsigned long flags;
+	int count = 0;
 	struct diag_mempool_t *mempool = NULL;
 
 	if (!driver)
@@ -182,19 +252,29 @@ void *diagmem_alloc(struct diagchar_dev *driver, int size, int pool_type)
 					   mempool->name, size);
 			break;
 		}
-		spin_lock_irqsave(&mempool->lock, flags);
-		if (mempool->count < mempool->poolsize) {
-			atomic_add(1, (atomic_t *)&mempool->count);
-			buf = mempool_alloc(mempool->pool, GFP_ATOMIC);
-			kmemleak_not_leak(buf);
+		/*
+		 * Reserve a slot against poolsize first, then try this CPU's
+		 * cache before falling back to the mempool itself.
+		 */
+		count = atomic_inc_return(&mempool->count);
+		if (count <= mempool->poolsize + mempool->burst) {
+			buf = diagmem_cache_get(mempool);
+			if (!buf) {
+				buf = mempool_alloc(mempool->pool, GFP_ATOMIC);
+				kmemleak_not_leak(buf);
+			}
 		}
-		spin_unlock_irqrestore(&mempool->lock, flags);
 		if (!buf) {
+			atomic_dec(&mempool->count);
+			mempool->fail++;
 			pr_debug_ratelimited("diag: Unable to allocate buffer from memory pool %s, size: %d/%d count: %d/%d\n",
 					     mempool->name,
 					     size, mempool->itemsize,
-					     mempool->count,
+					     atomic_read(&mempool->count),
 					     mempool->poolsize);
+		} else if (count > mempool->peak) {
+			/* Statistic only, a lost update here is harmless */
+			mempool->peak = count;
 		}
 		break;
 	}
@@ -205,7 +285,7 @@ void *diagmem_alloc(struct diagchar_dev *driver, int size, int pool_type)
 void diagmem_free(struct diagchar_dev *driver, void *buf, int pool_type)
 {
 	int i = 0;
-	unsigned long flags;
+	int count = 0;
 	struct diag_mempool_t *mempool = NULL;
 
 	if (!driver || !buf)
@@ -220,15 +300,16 @@ void diagmem_free(struct diagchar_dev *driver, void *buf, int pool_type)
 					   mempool->name);
 			break;
 		}
-		spin_lock_irqsave(&mempool->lock, flags);
-		if (mempool->count > 0) {
-			mempool_free(buf, mempool->pool);
-			atomic_add(-1, (atomic_t *)&mempool->count);
-		} else {
+		count = atomic_dec_if_positive(&mempool->count);
+		if (count < 0) {
 			pr_err_ratelimited("diag: Attempting to free items from %s mempool which is already empty\n",
 					   mempool->name);
+			break;
 		}
-		spin_unlock_irqrestore(&mempool->lock, flags);
+		/* Don't keep burst items around once the load has passed */
+		if (count >= mempool->poolsize ||
+		    !diagmem_cache_put(mempool, buf))
+			mempool_free(buf, mempool->pool);
 		break;
 	}
 }
@@ -259,17 +340,21 @@ void diagmem_init(struct diagchar_dev *driver, int index)
 
 	mempool->pool = mempool_create_kmalloc_pool(mempool->poolsize,
 						    mempool->itemsize);
-	if (!mempool->pool)
+	if (!mempool->pool) {
 		pr_err("diag: cannot allocate %s mempool\n", mempool->name);
-	else
-		kmemleak_not_leak(mempool->pool);
+		return;
+	}
+	kmemleak_not_leak(mempool->pool);
 
-	spin_lock_init(&mempool->lock);
+	/* The pool still works without the per-CPU caches, only slower */
+	mempool->cache = alloc_percpu(struct diag_mempool_cache_t);
+	if (!mempool->cache)
+		pr_err("diag: cannot allocate per-cpu cache for %s mempool\n",
+		       mempool->name);
 }
 
 void diagmem_exit(struct diagchar_dev *driver, int index)
 {
-	unsigned long flags;
 	struct diag_mempool_t *mempool = NULL;
 
 	if (!driver)
@@ -281,14 +366,15 @@ void diagmem_exit(struct diagchar_dev *driver, int index)
 	}
 
 	mempool = &diag_mempools[index];
-	spin_lock_irqsave(&mempool->lock, flags);
-	if (mempool->count == 0) {
+	if (atomic_read(&mempool->count) == 0) {
+		diagmem_cache_drain(mempool);
+		free_percpu(mempool->cache);
+		mempool->cache = NULL;
 		mempool_destroy(mempool->pool);
 		mempool->pool = NULL;
 	} else {
 		pr_err("diag: Unable to destory %s pool, count: %d\n",
-		       mempool->name, mempool->count);
+		       mempool->name, atomic_read(&mempool->count));
 	}
-	spin_unlock_irqrestore(&mempool->lock, flags);
 }
 
@@ -41,6 +41,15 @@
 
 #define DIAG_MEMPOOL_NAME_SZ		24
 #define DIAG_MEMPOOL_GET_NAME(x)	(diag_mempools[x].name)
+#define DIAG_MEMPOOL_CACHE_SIZE		8
+
+/* Per-CPU stack of free items sitting in front of a mempool */
+struct diag_mempool_cache_t {
+	int num;
+	void *items[DIAG_MEMPOOL_CACHE_SIZE];
+	unsigned long hits;
+	unsigned long misses;
+};
 
 struct diag_mempool_t {
 	int id;
@@ -48,13 +57,18 @@ struct diag_mempool_t {
 	mempool_t *pool;
 	unsigned int itemsize;
 	unsigned int poolsize;
-	int count;
-	spinlock_t lock;
-} __packed;
+	/* Items allowed above poolsize, freed again as soon as they return */
+	unsigned int burst;
+	atomic_t count;
+	int peak;
+	unsigned long fail;
+	struct diag_mempool_cache_t __percpu *cache;
+};
 
 extern struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS];
 
 void diagmem_setsize(int pool_idx, int itemsize, int poolsize);
+void diagmem_setburst(int pool_idx, int burst);
 void *diagmem_alloc(struct diagchar_dev *driver, int size, int pool_type);
 void diagmem_free(struct diagchar_dev *driver, void *buf, int pool_type);
 void diagmem_init(struct diagchar_dev *driver, int type);
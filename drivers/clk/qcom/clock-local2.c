@@ -130,7 +130,6 @@ void set_rate_mnd(struct rcg_clk *rcg, struct clk_freq_tbl *nf)
 	unsigned long flags;
 
 	spin_lock_irqsave(&local_clock_reg_lock, flags);
-	cfg_regval = readl_relaxed(CFG_RCGR_REG(rcg));
 	writel_relaxed(nf->m_val, M_REG(rcg));
 	writel_relaxed(nf->n_val, N_REG(rcg));
 	writel_relaxed(nf->d_val, D_REG(rcg));
@@ -167,27 +166,45 @@ static int rcg_clk_set_rate(struct clk *c, unsigned long rate)
 	int rc;
 	unsigned long flags;
 
-	for (nf = rcg->freq_tbl; nf->freq_hz != FREQ_END
-			&& nf->freq_hz != rate; nf++)
-		;
+	nf = rcg->prev_freq;
+	if (!nf || nf->freq_hz != rate) {
+		for (nf = rcg->freq_tbl; nf->freq_hz != FREQ_END
+				&& nf->freq_hz != rate; nf++)
+			;
 
-	if (nf->freq_hz == FREQ_END)
-		return -EINVAL;
+		if (nf->freq_hz == FREQ_END)
+			return -EINVAL;
+	}
 
 	cf = rcg->current_freq;
 
+	BUG_ON(!rcg->set_rate);
+
+	/*
+	 * Staying on the same source needs no prepare/enable votes moved
+	 * between parents, only the enable state of the RCG held steady.
+	 */
+	if (nf->src_clk == cf->src_clk) {
+		spin_lock_irqsave(&c->lock, flags);
+		rcg->set_rate(rcg, nf);
+		rcg->current_freq = nf;
+		spin_unlock_irqrestore(&c->lock, flags);
+		goto out;
+	}
+
 	rc = __clk_pre_reparent(c, nf->src_clk, &flags);
 	if (rc)
 		return rc;
 
-	BUG_ON(!rcg->set_rate);
-
 	/* Perform clock-specific frequency switch operations. */
 	rcg->set_rate(rcg, nf);
 	rcg->current_freq = nf;
 	c->parent = nf->src_clk;
 
 	__clk_post_reparent(c, cf->src_clk, &flags);
+out:
+	if (cf != &rcg_dummy_freq)
+		rcg->prev_freq = cf;
 
 	return 0;
 }
@@ -212,6 +212,16 @@ static void unvote_rate_vdd(struct clk *clk, unsigned long rate)
 	unvote_vdd_level(clk->vdd_class, level);
 }
 
+/* Check if moving @clk from one rate to another needs a new vdd vote. */
+static bool rate_vdd_changes(struct clk *clk, unsigned long from,
+			     unsigned long to)
+{
+	if (!clk->vdd_class)
+		return false;
+
+	return find_vdd_level(clk, from) != find_vdd_level(clk, to);
+}
+
 /* Check if the rate is within the voltage limits of the clock. */
 static bool is_rate_valid(struct clk *clk, unsigned long rate)
 {
@@ -649,6 +659,7 @@ int clk_set_rate(struct clk *clk, unsigned long rate)
 	unsigned long start_rate;
 	int rc = 0;
 	const char *name;
+	bool vdd_vote = false;
 
 	if (IS_ERR_OR_NULL(clk))
 		return -EINVAL;
@@ -681,8 +692,13 @@ int clk_set_rate(struct clk *clk, unsigned long rate)
 			goto abort_set_rate;
 	}
 
-	/* Enforce vdd requirements for target frequency. */
-	if (clk->prepare_count) {
+	/*
+	 * Enforce vdd requirements for target frequency. Rates sharing a
+	 * voltage level would vote and unvote the same corner, so skip it.
+	 */
+	vdd_vote = clk->prepare_count &&
+		   rate_vdd_changes(clk, start_rate, rate);
+	if (vdd_vote) {
 		rc = vote_rate_vdd(clk, rate);
 		if (rc)
 			goto err_vote_vdd;
@@ -694,7 +710,7 @@ int clk_set_rate(struct clk *clk, unsigned long rate)
 	clk->rate = rate;
 
 	/* Release vdd requirements for starting frequency. */
-	if (clk->prepare_count)
+	if (vdd_vote)
 		unvote_rate_vdd(clk, start_rate);
 
 	if (clk->ops->post_set_rate)
@@ -710,7 +726,7 @@ out:
 abort_set_rate:
 	__clk_notify(clk, ABORT_RATE_CHANGE, clk->rate, rate);
 err_set_rate:
-	if (clk->prepare_count)
+	if (vdd_vote)
 		unvote_rate_vdd(clk, rate);
 err_vote_vdd:
 	/* clk->rate is still the old rate. So, pass the new rate instead. */
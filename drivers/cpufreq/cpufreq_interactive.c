@@ -55,6 +55,11 @@ struct cpufreq_interactive_cpuinfo {
 	u64 hispeed_validate_time; /* cluster hispeed_validate_time */
 	u64 local_hvtime; /* per-cpu hispeed_validate_time */
 	u64 max_freq_idle_start_time;
+	/* recent loadadjfreq samples, protected by target_freq_lock */
+#define LOAD_HIST_SIZE 8
+	unsigned int load_hist[LOAD_HIST_SIZE];
+	unsigned int load_hist_idx;
+	unsigned int nr_load_hist;
 	struct rw_semaphore enable_sem;
 	bool reject_notification;
 	int governor_enabled;
@@ -141,6 +146,16 @@ struct cpufreq_interactive_tunables {
 	 * frequency.
 	 */
 	unsigned int max_freq_hysteresis;
+
+	/*
+	 * Predict the load of the next window from the recent load history
+	 * of the CPU.  A prediction at least prediction_confidence percent
+	 * confident replaces the measured load, and min_sample_time and
+	 * max_freq_hysteresis shrink as the confidence grows.
+	 */
+	bool use_prediction;
+#define DEFAULT_PREDICTION_CONFIDENCE 80
+	unsigned int prediction_confidence;
 };
 
 /* For cases where we have single governor instance for system */
@@ -386,6 +401,71 @@ static u64 update_load(int cpu)
 	return now;
 }
 
+static void record_load(struct cpufreq_interactive_cpuinfo *pcpu,
+			unsigned int loadadjfreq)
+{
+	pcpu->load_hist[pcpu->load_hist_idx] = loadadjfreq;
+	pcpu->load_hist_idx = (pcpu->load_hist_idx + 1) % LOAD_HIST_SIZE;
+	if (pcpu->nr_load_hist < LOAD_HIST_SIZE)
+		pcpu->nr_load_hist++;
+}
+
+/* Load recorded @i windows before the last one */
+static unsigned int hist_load(struct cpufreq_interactive_cpuinfo *pcpu,
+			      unsigned int i)
+{
+	return pcpu->load_hist[(pcpu->load_hist_idx + LOAD_HIST_SIZE - 1 - i)
+			       % LOAD_HIST_SIZE];
+}
+
+/*
+ * Find the period, in windows, that best explains the load history of
+ * the CPU, and predict the load of the next window as the load one
+ * period before it.  Periodic work (audio, video frames, sensor polls)
+ * repeats with a period of a few windows; steady load is period 1.
+ *
+ * Returns the predicted loadadjfreq.  *confidence is set to how well
+ * the period matches the history, in percent of the mean load.
+ */
+static unsigned int predict_load(struct cpufreq_interactive_cpuinfo *pcpu,
+				 unsigned int *confidence)
+{
+	unsigned int p, i, best_period = 1;
+	u64 err, best_err = ULLONG_MAX, mean = 0;
+
+	*confidence = 0;
+	if (pcpu->nr_load_hist < LOAD_HIST_SIZE)
+		return 0;
+
+	for (i = 0; i < LOAD_HIST_SIZE; i++)
+		mean += hist_load(pcpu, i);
+	do_div(mean, LOAD_HIST_SIZE);
+
+	for (p = 1; p <= LOAD_HIST_SIZE / 2; p++) {
+		err = 0;
+		for (i = 0; i + p < LOAD_HIST_SIZE; i++)
+			err += abs((int)hist_load(pcpu, i) -
+				   (int)hist_load(pcpu, i + p));
+		do_div(err, LOAD_HIST_SIZE - p);
+		if (err < best_err) {
+			best_err = err;
+			best_period = p;
+		}
+	}
+
+	if (!mean)
+		*confidence = 100;
+	else if (best_err < mean)
+		*confidence = 100 - div64_u64(best_err * 100, mean);
+
+	return hist_load(pcpu, best_period - 1);
+}
+
+static inline u64 scale_hysteresis(u64 hysteresis, unsigned int percent)
+{
+	return div_u64(hysteresis * percent, 100);
+}
+
 static void cpufreq_interactive_timer(unsigned long data)
 {
 	u64 now;
@@ -402,6 +482,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 	unsigned long flags;
 	bool boosted;
 	struct cpufreq_govinfo int_info;
+	unsigned int confidence, hyst_pct = 100;
 
 	if (!down_read_trylock(&pcpu->enable_sem))
 		return;
@@ -449,6 +530,15 @@ static void cpufreq_interactive_timer(unsigned long data)
 					CPUFREQ_LOAD_CHANGE, &int_info);
 
 	spin_lock_irqsave(&pcpu->target_freq_lock, flags);
+	record_load(pcpu, loadadjfreq);
+	if (tunables->use_prediction) {
+		unsigned int predicted = predict_load(pcpu, &confidence);
+
+		if (confidence >= tunables->prediction_confidence)
+			loadadjfreq = predicted;
+		hyst_pct = 100 - confidence;
+	}
+
 	cpu_load = loadadjfreq / pcpu->policy->cur;
 	boosted = tunables->boost_val || now < tunables->boostpulse_endtime;
 
@@ -490,7 +580,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 	if (pcpu->target_freq >= pcpu->policy->max
 	    && new_freq < pcpu->target_freq
 	    && now - pcpu->max_freq_idle_start_time <
-	    tunables->max_freq_hysteresis) {
+	    scale_hysteresis(tunables->max_freq_hysteresis, hyst_pct)) {
 		trace_cpufreq_interactive_notyet(data, cpu_load,
 			pcpu->target_freq, pcpu->policy->cur, new_freq);
 		spin_unlock_irqrestore(&pcpu->target_freq_lock, flags);
@@ -503,7 +593,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 	 */
 	if (new_freq < pcpu->floor_freq) {
 		if (now - pcpu->floor_validate_time <
-				tunables->min_sample_time) {
+			scale_hysteresis(tunables->min_sample_time, hyst_pct)) {
 			trace_cpufreq_interactive_notyet(
 				data, cpu_load, pcpu->target_freq,
 				pcpu->policy->cur, new_freq);
@@ -993,6 +1083,8 @@ static ssize_t store_##file_name(					\
 }
 show_store_one(max_freq_hysteresis);
 show_store_one(align_windows);
+show_store_one(use_prediction);
+show_store_one(prediction_confidence);
 
 static ssize_t show_go_hispeed_load(struct cpufreq_interactive_tunables
 		*tunables, char *buf)
@@ -1042,7 +1134,7 @@ static ssize_t store_timer_rate(struct cpufreq_interactive_tunables *tunables,
 		const char *buf, size_t count)
 {
 	int ret;
-	unsigned long val, val_round;
+	unsigned long val, val_round, old_rate;
 	struct cpufreq_interactive_tunables *t;
 	int cpu;
 
@@ -1054,6 +1146,7 @@ static ssize_t store_timer_rate(struct cpufreq_interactive_tunables *tunables,
 	if (val != val_round)
 		pr_warn("timer_rate not aligned to jiffy. Rounded up to %lu\n",
 			val_round);
+	old_rate = tunables->timer_rate;
 	tunables->timer_rate = val_round;
 
 	if (!tunables->use_sched_load)
@@ -1064,7 +1157,23 @@ static ssize_t store_timer_rate(struct cpufreq_interactive_tunables *tunables,
 		if (t && t->use_sched_load)
 			t->timer_rate = val_round;
 	}
-	set_window_helper(tunables);
+
+	/*
+	 * The scheduler window must track the sampling period, or the
+	 * busy time read from it no longer matches timer_rate.  Keep the
+	 * old rate if the scheduler refuses the window.
+	 */
+	ret = set_window_helper(tunables);
+	if (ret) {
+		pr_err("%s: Failed to set sched window\n", __func__);
+		for_each_possible_cpu(cpu) {
+			t = per_cpu(cpuinfo, cpu).cached_tunables;
+			if (t && t->use_sched_load)
+				t->timer_rate = old_rate;
+		}
+		tunables->timer_rate = old_rate;
+		return ret;
+	}
 
 	return count;
 }
@@ -1377,6 +1486,8 @@ show_store_gov_pol_sys(use_sched_load);
 show_store_gov_pol_sys(use_migration_notif);
 show_store_gov_pol_sys(max_freq_hysteresis);
 show_store_gov_pol_sys(align_windows);
+show_store_gov_pol_sys(use_prediction);
+show_store_gov_pol_sys(prediction_confidence);
 
 #define gov_sys_attr_rw(_name)						\
 static struct global_attr _name##_gov_sys =				\
@@ -1404,6 +1515,8 @@ gov_sys_pol_attr_rw(use_sched_load);
 gov_sys_pol_attr_rw(use_migration_notif);
 gov_sys_pol_attr_rw(max_freq_hysteresis);
 gov_sys_pol_attr_rw(align_windows);
+gov_sys_pol_attr_rw(use_prediction);
+gov_sys_pol_attr_rw(prediction_confidence);
 
 static struct global_attr boostpulse_gov_sys =
 	__ATTR(boostpulse, 0200, NULL, store_boostpulse_gov_sys);
@@ -1428,6 +1541,8 @@ static struct attribute *interactive_attributes_gov_sys[] = {
 	&use_migration_notif_gov_sys.attr,
 	&max_freq_hysteresis_gov_sys.attr,
 	&align_windows_gov_sys.attr,
+	&use_prediction_gov_sys.attr,
+	&prediction_confidence_gov_sys.attr,
 	NULL,
 };
 
@@ -1453,6 +1568,8 @@ static struct attribute *interactive_attributes_gov_pol[] = {
 	&use_migration_notif_gov_pol.attr,
 	&max_freq_hysteresis_gov_pol.attr,
 	&align_windows_gov_pol.attr,
+	&use_prediction_gov_pol.attr,
+	&prediction_confidence_gov_pol.attr,
 	NULL,
 };
 
@@ -1527,6 +1644,7 @@ static struct cpufreq_interactive_tunables *alloc_tunable(
 	tunables->boostpulse_duration_val = DEFAULT_MIN_SAMPLE_TIME;
 	tunables->timer_slack_val = DEFAULT_TIMER_SLACK;
 	tunables->align_windows = true;
+	tunables->prediction_confidence = DEFAULT_PREDICTION_CONFIDENCE;
 
 	spin_lock_init(&tunables->target_loads_lock);
 	spin_lock_init(&tunables->above_hispeed_delay_lock);
@@ -1657,6 +1775,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			pcpu->hispeed_validate_time =
 				pcpu->floor_validate_time;
 			pcpu->local_hvtime = pcpu->floor_validate_time;
+			pcpu->nr_load_hist = 0;
 			pcpu->max_freq = policy->max;
 			pcpu->reject_notification = true;
 			down_write(&pcpu->enable_sem);
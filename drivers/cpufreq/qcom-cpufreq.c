@@ -34,6 +34,8 @@ static DEFINE_MUTEX(l2bw_lock);
 static struct clk *cpu_clk[NR_CPUS];
 static struct clk *l2_clk;
 static DEFINE_PER_CPU(struct cpufreq_frequency_table *, freq_table);
+/* Clock rate in Hz of each table entry, indexed by its driver_data */
+static DEFINE_PER_CPU(unsigned long *, freq_rate);
 static bool hotplug_ready;
 
 struct cpufreq_suspend_t {
@@ -48,6 +50,7 @@ static int set_cpu_freq(struct cpufreq_policy *policy, unsigned int new_freq,
 {
 	int ret = 0;
 	struct cpufreq_freqs freqs;
+	struct clk *c = cpu_clk[policy->cpu];
 	unsigned long rate;
 
 	freqs.old = policy->cur;
@@ -58,9 +61,14 @@ static int set_cpu_freq(struct cpufreq_policy *policy, unsigned int new_freq,
 
 	trace_cpu_frequency_switch_start(freqs.old, freqs.new, policy->cpu);
 
-	rate = new_freq * 1000;
-	rate = clk_round_rate(cpu_clk[policy->cpu], rate);
-	ret = clk_set_rate(cpu_clk[policy->cpu], rate);
+	/*
+	 * The rates were rounded by the clock driver when the table was
+	 * parsed, so there is no need to round them again on every switch.
+	 * Skip the clock altogether if it already runs at the new rate.
+	 */
+	rate = per_cpu(freq_rate, policy->cpu)[index];
+	if (clk_get_rate(c) != rate)
+		ret = clk_set_rate(c, rate);
 	if (!ret) {
 		cpufreq_notify_transition(policy, &freqs, CPUFREQ_POSTCHANGE);
 		trace_cpu_frequency_switch_end(policy->cpu);
@@ -312,11 +320,12 @@ static struct cpufreq_driver msm_cpufreq_driver = {
 };
 
 static struct cpufreq_frequency_table *cpufreq_parse_dt(struct device *dev,
-						char *tbl_name, int cpu)
+				char *tbl_name, int cpu, unsigned long **rates)
 {
 	int ret, nf, i;
 	u32 *data;
 	struct cpufreq_frequency_table *ftbl;
+	unsigned long *rtbl;
 
 	/* Parse list of usable CPU frequencies. */
 	if (!of_find_property(dev->of_node, tbl_name, &nf))
@@ -338,12 +347,17 @@ static struct cpufreq_frequency_table *cpufreq_parse_dt(struct device *dev,
 	if (!ftbl)
 		return ERR_PTR(-ENOMEM);
 
+	rtbl = devm_kzalloc(dev, nf * sizeof(*rtbl), GFP_KERNEL);
+	if (!rtbl)
+		return ERR_PTR(-ENOMEM);
+
 	for (i = 0; i < nf; i++) {
 		unsigned long f;
 
 		f = clk_round_rate(cpu_clk[cpu], data[i] * 1000);
 		if (IS_ERR_VALUE(f))
 			break;
+		rtbl[i] = f;
 		f /= 1000;
 
 		/*
@@ -373,6 +387,7 @@ static struct cpufreq_frequency_table *cpufreq_parse_dt(struct device *dev,
 
 	devm_kfree(dev, data);
 
+	*rates = rtbl;
 	return ftbl;
 }
 
@@ -384,6 +399,7 @@ static int __init msm_cpufreq_probe(struct platform_device *pdev)
 	struct clk *c;
 	int cpu;
 	struct cpufreq_frequency_table *ftbl;
+	unsigned long *rtbl;
 
 	l2_clk = devm_clk_get(dev, "l2_clk");
 	if (IS_ERR(l2_clk))
@@ -403,10 +419,12 @@ static int __init msm_cpufreq_probe(struct platform_device *pdev)
 		msm_cpufreq_driver.flags |= CPUFREQ_HAVE_GOVERNOR_PER_POLICY;
 
 	/* Parse commong cpufreq table for all CPUs */
-	ftbl = cpufreq_parse_dt(dev, "qcom,cpufreq-table", 0);
+	ftbl = cpufreq_parse_dt(dev, "qcom,cpufreq-table", 0, &rtbl);
 	if (!IS_ERR(ftbl)) {
-		for_each_possible_cpu(cpu)
+		for_each_possible_cpu(cpu) {
 			per_cpu(freq_table, cpu) = ftbl;
+			per_cpu(freq_rate, cpu) = rtbl;
+		}
 		return 0;
 	}
 
@@ -417,7 +435,7 @@ static int __init msm_cpufreq_probe(struct platform_device *pdev)
 	for_each_possible_cpu(cpu) {
 		snprintf(tbl_name, sizeof(tbl_name),
 			 "qcom,cpufreq-table-%d", cpu);
-		ftbl = cpufreq_parse_dt(dev, tbl_name, cpu);
+		ftbl = cpufreq_parse_dt(dev, tbl_name, cpu, &rtbl);
 
 		/* CPU0 must contain freq table */
 		if (cpu == 0 && IS_ERR(ftbl)) {
@@ -426,6 +444,7 @@ static int __init msm_cpufreq_probe(struct platform_device *pdev)
 		}
 		if (cpu == 0) {
 			per_cpu(freq_table, cpu) = ftbl;
+			per_cpu(freq_rate, cpu) = rtbl;
 			continue;
 		}
 
@@ -443,8 +462,10 @@ static int __init msm_cpufreq_probe(struct platform_device *pdev)
 				kfree(ftbl);
 			}
 			ftbl = per_cpu(freq_table, cpu - 1);
+			rtbl = per_cpu(freq_rate, cpu - 1);
 		}
 		per_cpu(freq_table, cpu) = ftbl;
+		per_cpu(freq_rate, cpu) = rtbl;
 	}
 
 	return 0;
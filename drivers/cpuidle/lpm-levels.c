@@ -43,6 +43,7 @@
 #include <asm/cacheflush.h>
 #include "lpm-levels.h"
 #include "lpm-workarounds.h"
+#include "lpm-wake-stats.h"
 #include <trace/events/power.h>
 #define CREATE_TRACE_POINTS
 #include <trace/events/trace_msm_low_power.h>
@@ -111,6 +112,48 @@ static bool sleep_disabled;
 module_param_named(sleep_disabled,
 	sleep_disabled, bool, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Idle duration prediction.  The next timer event is a poor guess of
+ * how long a cpu will sleep when it is woken by device interrupts
+ * (network, modem, IPA ...).  Each cpu keeps the residencies of its last
+ * MAXSAMPLES idle periods.  When they are tightly clustered, the next
+ * one is predicted to be their average.  Otherwise levels the cpu keeps
+ * leaving before their target residency (time_overhead_us) are avoided.
+ */
+#define MAXSAMPLES 5
+
+static bool lpm_prediction = true;
+module_param_named(lpm_prediction,
+	lpm_prediction, bool, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Standard deviation (us) below which the samples predict their average */
+static uint32_t ref_stddev = 100;
+module_param_named(ref_stddev,
+	ref_stddev, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Premature exits, out of MAXSAMPLES, that restrict a level */
+static uint32_t ref_premature_cnt = 3;
+module_param_named(ref_premature_cnt,
+	ref_premature_cnt, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Slack (us) past the prediction before it is assumed wrong */
+static uint32_t tmr_add = 100;
+module_param_named(tmr_add,
+	tmr_add, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+struct lpm_history {
+	uint32_t resi[MAXSAMPLES];
+	int mode[MAXSAMPLES];
+	int nsamp;
+	uint32_t hptr;
+	bool hinvalid;
+	bool htmr_wkup;
+	ktime_t pred_wakeup;
+};
+
+static DEFINE_PER_CPU(struct lpm_history, hist);
+static DEFINE_PER_CPU(struct hrtimer, histtimer);
+
 s32 msm_cpuidle_get_deep_idle_latency(void)
 {
 	return 10;
@@ -160,6 +203,7 @@ static int lpm_cpu_callback(struct notifier_block *cpu_nb,
 
 	switch (action & ~CPU_TASKS_FROZEN) {
 	case CPU_STARTING:
+		memset(&per_cpu(hist, cpu), 0, sizeof(struct lpm_history));
 		cluster_unprepare(cluster, get_cpu_mask((unsigned int) cpu),
 				NR_LPM_LEVELS, false);
 		break;
@@ -234,6 +278,162 @@ int set_cci_mode(struct low_power_ops *ops, int mode, bool notify_rpm)
 	return msm_spm_config_low_power_mode(ops->spm, mode, notify_rpm);
 }
 
+static enum hrtimer_restart histtimer_fn(struct hrtimer *h)
+{
+	struct lpm_history *history = &__get_cpu_var(hist);
+
+	/*
+	 * The cpu slept well past the prediction.  Ignore the history for
+	 * the next selection, so the cpu can go back to sleep in the level
+	 * its timers allow.
+	 */
+	history->hinvalid = true;
+	history->htmr_wkup = true;
+
+	return HRTIMER_NORESTART;
+}
+
+static void histtimer_start(uint32_t time_us)
+{
+	struct hrtimer *timer = &__get_cpu_var(histtimer);
+	u64 time_ns = (u64)time_us * NSEC_PER_USEC;
+
+	hrtimer_start(timer, ns_to_ktime(time_ns), HRTIMER_MODE_REL_PINNED);
+}
+
+static void histtimer_cancel(void)
+{
+	struct hrtimer *timer = &__get_cpu_var(histtimer);
+
+	if (!hrtimer_active(timer))
+		return;
+
+	/* An expired timer woke the cpu, let its callback run */
+	if (ktime_to_us(hrtimer_get_remaining(timer)) <= 0)
+		return;
+
+	hrtimer_try_to_cancel(timer);
+}
+
+/*
+ * Returns the predicted sleep length in us, or 0 if the history shows no
+ * pattern.  In that case *idx_restrict is set to the shallowest level the
+ * cpu keeps leaving early, and *idx_restrict_time to the average
+ * residency it got out of it.
+ */
+static uint32_t lpm_cpuidle_predict(struct cpuidle_device *dev,
+		struct lpm_cpu *cpu, int *idx_restrict,
+		uint32_t *idx_restrict_time)
+{
+	struct lpm_history *history = &per_cpu(hist, dev->cpu);
+	uint64_t max, avg, stddev;
+	int64_t thresh = LLONG_MAX;
+	int i, j, divisor;
+
+	if (!lpm_prediction)
+		return 0;
+
+	if (history->hinvalid) {
+		history->hinvalid = false;
+		return 0;
+	}
+
+	if (history->nsamp < MAXSAMPLES)
+		return 0;
+
+again:
+	max = avg = divisor = stddev = 0;
+	for (i = 0; i < MAXSAMPLES; i++) {
+		int64_t value = history->resi[i];
+
+		if (value <= thresh) {
+			avg += value;
+			divisor++;
+			if (value > max)
+				max = value;
+		}
+	}
+	do_div(avg, divisor);
+
+	for (i = 0; i < MAXSAMPLES; i++) {
+		int64_t value = history->resi[i];
+
+		if (value <= thresh) {
+			int64_t diff = value - avg;
+
+			stddev += diff * diff;
+		}
+	}
+	do_div(stddev, divisor);
+	stddev = int_sqrt(stddev);
+
+	/*
+	 * The samples predict their average if they are close to each
+	 * other, either absolutely or relative to the average.  Failing
+	 * that, retry once without the longest one: a single timer wakeup
+	 * in a run of interrupt wakeups should not hide the pattern.
+	 */
+	if ((avg > stddev * 6 && divisor >= MAXSAMPLES - 1) ||
+			stddev <= ref_stddev)
+		return (uint32_t)avg;
+	else if (divisor == MAXSAMPLES) {
+		thresh = max - 1;
+		goto again;
+	}
+
+	for (j = 1; j < cpu->nlevels; j++) {
+		uint32_t failed = 0;
+		uint64_t total = 0;
+
+		for (i = 0; i < MAXSAMPLES; i++) {
+			if (history->mode[i] == j && history->resi[i] <
+					cpu->levels[j].pwr.time_overhead_us) {
+				failed++;
+				total += history->resi[i];
+			}
+		}
+
+		if (failed >= ref_premature_cnt) {
+			*idx_restrict = j;
+			do_div(total, failed);
+			*idx_restrict_time = total;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static void update_history(struct cpuidle_device *dev, int idx)
+{
+	struct lpm_history *history = &per_cpu(hist, dev->cpu);
+
+	if (!lpm_prediction)
+		return;
+
+	/*
+	 * A wakeup from the history timer does not end the idle period,
+	 * add it to the sample it interrupted.
+	 */
+	if (history->htmr_wkup) {
+		history->htmr_wkup = false;
+		if (history->nsamp) {
+			history->hptr = history->hptr ?
+				history->hptr - 1 : MAXSAMPLES - 1;
+			history->resi[history->hptr] += dev->last_residency;
+			history->mode[history->hptr] = idx;
+			history->hptr = (history->hptr + 1) % MAXSAMPLES;
+			return;
+		}
+	}
+
+	history->resi[history->hptr] = dev->last_residency;
+	history->mode[history->hptr] = idx;
+	history->hptr = (history->hptr + 1) % MAXSAMPLES;
+	if (history->nsamp < MAXSAMPLES)
+		history->nsamp++;
+}
+
 static int cpu_power_select(struct cpuidle_device *dev,
 		struct lpm_cpu *cpu, int *index)
 {
@@ -250,6 +450,9 @@ static int cpu_power_select(struct cpuidle_device *dev,
 	uint32_t lvl_latency_us = 0;
 	uint32_t lvl_overhead_us = 0;
 	uint32_t lvl_overhead_energy = 0;
+	uint32_t pred_us = 0;
+	uint32_t idx_restrict_time = 0;
+	int idx_restrict;
 
 	if (!cpu)
 		return -EINVAL;
@@ -257,6 +460,10 @@ static int cpu_power_select(struct cpuidle_device *dev,
 	if (sleep_disabled)
 		return 0;
 
+	idx_restrict = cpu->nlevels + 1;
+	pred_us = lpm_cpuidle_predict(dev, cpu, &idx_restrict,
+			&idx_restrict_time);
+
 	/*
 	 * TODO:
 	 * Assumes event happens always on Core0. Need to check for validity
@@ -295,6 +502,12 @@ static int cpu_power_select(struct cpuidle_device *dev,
 				next_wakeup_us = next_event_us - lvl_latency_us;
 		}
 
+		/* Unless a timer is due earlier, trust the history */
+		if (pred_us && pred_us < next_wakeup_us)
+			next_wakeup_us = pred_us;
+		else if (i >= idx_restrict && idx_restrict_time < next_wakeup_us)
+			next_wakeup_us = idx_restrict_time;
+
 		if (next_wakeup_us <= pwr_params->time_overhead_us)
 			continue;
 
@@ -327,9 +540,56 @@ static int cpu_power_select(struct cpuidle_device *dev,
 	if (modified_time_us && !dev->cpu)
 		msm_pm_set_timer(modified_time_us);
 
+	/*
+	 * If the history kept the cpu out of a deeper level, make sure a
+	 * wrong guess does not leave it in a shallow one for the whole
+	 * sleep: wake it up a little past the guess to select again.
+	 */
+	if ((pred_us || idx_restrict <= cpu->nlevels) && best_level >= 0 &&
+			best_level < cpu->nlevels - 1) {
+		uint32_t htime = (pred_us ? pred_us : idx_restrict_time) +
+					tmr_add;
+
+		if (sleep_us > htime && sleep_us - htime >
+			cpu->levels[best_level + 1].pwr.time_overhead_us)
+			histtimer_start(htime);
+	}
+
+	/* Let cluster_select() know when this cpu expects to wake up */
+	if (pred_us && pred_us < sleep_us && best_level >= 0)
+		per_cpu(hist, dev->cpu).pred_wakeup =
+			ktime_add_us(ktime_get(), pred_us);
+
 	return best_level;
 }
 
+/*
+ * Earliest wakeup predicted by the cpus of the cluster, in us from now,
+ * or ~0U if none of them has a pending prediction.
+ */
+static uint32_t cluster_predicted_sleep(struct lpm_cluster *cluster)
+{
+	ktime_t now = ktime_get();
+	uint32_t pred_us = ~0U;
+	int cpu;
+
+	if (!lpm_prediction)
+		return pred_us;
+
+	for_each_cpu(cpu, &cluster->num_childs_in_sync) {
+		ktime_t pred_wakeup = per_cpu(hist, cpu).pred_wakeup;
+
+		/* predictions already overdue have proven wrong */
+		if (!pred_wakeup.tv64 || pred_wakeup.tv64 <= now.tv64)
+			continue;
+
+		pred_us = min_t(uint32_t, pred_us,
+				ktime_us_delta(pred_wakeup, now));
+	}
+
+	return pred_us;
+}
+
 static uint64_t get_cluster_sleep_time(struct lpm_cluster *cluster,
 		struct cpumask *mask, bool from_idle)
 {
@@ -385,6 +645,8 @@ static int cluster_select(struct lpm_cluster *cluster, bool from_idle)
 		return -EINVAL;
 
 	sleep_us = (uint32_t)get_cluster_sleep_time(cluster, NULL, from_idle);
+	if (from_idle)
+		sleep_us = min(sleep_us, cluster_predicted_sleep(cluster));
 
 	if (cpumask_and(&mask, cpu_online_mask, &cluster->child_cpus))
 		latency_us = pm_qos_request_for_cpumask(PM_QOS_CPU_DMA_LATENCY,
@@ -683,6 +945,7 @@ static int lpm_cpuidle_enter(struct cpuidle_device *dev,
 	cluster_prepare(cluster, cpumask, idx, true);
 	trace_cpu_idle_enter(idx);
 	lpm_stats_cpu_enter(idx);
+	lpm_wake_stats_enter(dev->cpu);
 	success = msm_cpu_pm_enter_sleep(cluster->cpu->levels[idx].mode, true);
 	lpm_stats_cpu_exit(idx, success);
 	trace_cpu_idle_exit(idx, success);
@@ -694,8 +957,14 @@ static int lpm_cpuidle_enter(struct cpuidle_device *dev,
 	time = ktime_to_ns(ktime_get()) - time;
 	do_div(time, 1000);
 	dev->last_residency = (int)time;
+	if (success)
+		lpm_wake_stats_exit(dev->cpu, cluster->cpu, idx,
+				dev->last_residency);
+	update_history(dev, idx);
 
 exit:
+	histtimer_cancel();
+	per_cpu(hist, dev->cpu).pred_wakeup.tv64 = 0;
 	local_irq_enable();
 	trace_cpu_idle_rcuidle(PWR_EVENT_EXIT, dev->cpu);
 	return idx;
@@ -812,6 +1081,7 @@ static void register_cpu_lpm_stats(struct lpm_cpu *cpu,
 		struct lpm_cluster *parent)
 {
 	const char **level_name;
+	uint32_t *residency;
 	int i;
 
 	level_name = kzalloc(cpu->nlevels * sizeof(*level_name), GFP_KERNEL);
@@ -826,6 +1096,20 @@ static void register_cpu_lpm_stats(struct lpm_cpu *cpu,
 			parent->stats, &parent->child_cpus);
 
 	kfree(level_name);
+
+	residency = kzalloc(cpu->nlevels * sizeof(*residency), GFP_KERNEL);
+
+	if (!residency)
+		return;
+
+	/* shallowest level is always worth entering */
+	for (i = 1; i < cpu->nlevels; i++)
+		residency[i] = cpu->levels[i].pwr.time_overhead_us;
+
+	lpm_stats_config_cpu_residency(residency, cpu->nlevels,
+			&parent->child_cpus);
+
+	kfree(residency);
 }
 
 static void register_cluster_lpm_stats(struct lpm_cluster *cl,
@@ -913,6 +1197,7 @@ static int lpm_probe(struct platform_device *pdev)
 {
 	int ret;
 	int size;
+	unsigned int cpu;
 	struct kobject *module_kobj = NULL;
 
 	lpm_root_node = lpm_of_parse_cluster(pdev);
@@ -937,6 +1222,12 @@ static int lpm_probe(struct platform_device *pdev)
 	put_cpu();
 	suspend_set_ops(&lpm_suspend_ops);
 	hrtimer_init(&lpm_hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	for_each_possible_cpu(cpu) {
+		struct hrtimer *timer = &per_cpu(histtimer, cpu);
+
+		hrtimer_init(timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		timer->function = histtimer_fn;
+	}
 
 	ret = remote_spin_lock_init(&scm_handoff_lock, SCM_HANDOFF_LOCK_ID);
 	if (ret) {
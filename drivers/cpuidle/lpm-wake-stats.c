@@ -0,0 +1,378 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Per wakeup source idle statistics.
+ *
+ * For every idle period, record the interrupt that ended it, the level
+ * selected against the level that would have been ideal for the
+ * residency the cpu actually got, and, for wakeups by the timer the
+ * selection was based on, how late past that timer the cpu came back.
+ *
+ * The wakeup interrupt is the first one handled after the cpu leaves
+ * the level, caught with a probe on the irq_handler_entry tracepoint,
+ * which is only registered while the statistics are enabled.  Idle
+ * periods no interrupt is handled after (IPIs, need_resched) are
+ * accounted as "none".
+ *
+ * All the statistics of a cpu are only written by that cpu, from the
+ * idle path with interrupts disabled or from its interrupt handlers.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/irq.h>
+#include <linux/irqdesc.h>
+#include <linux/interrupt.h>
+#include <linux/ktime.h>
+#include <linux/tick.h>
+#include <linux/pm_qos.h>
+#include <linux/smp.h>
+#include <trace/events/irq.h>
+#include "lpm-levels.h"
+#include "lpm-wake-stats.h"
+
+#define WAKE_IRQ_SLOTS		16
+#define WAKE_IRQ_OTHER		WAKE_IRQ_SLOTS
+#define WAKE_IRQ_NONE		(WAKE_IRQ_SLOTS + 1)
+#define WAKE_IRQ_ENTRIES	(WAKE_IRQ_SLOTS + 2)
+
+/* log2 buckets of exit latency in us, the last one is open ended */
+#define LAT_BUCKETS		10
+
+/* Timer wakeups later than this were not delayed by the exit only */
+#define MAX_EXIT_LATENCY_US	10000
+
+struct wake_irq_stats {
+	int irq;
+	uint32_t count;
+	uint32_t too_deep;
+	uint32_t too_shallow;
+	uint64_t residency_us;
+};
+
+struct lpm_wake_stats {
+	struct wake_irq_stats irqs[WAKE_IRQ_ENTRIES];
+	/* [selected level][ideal level] */
+	uint32_t select[NR_LPM_LEVELS][NR_LPM_LEVELS];
+	uint32_t exit_latency[NR_LPM_LEVELS][LAT_BUCKETS];
+	int nlevels;
+
+	/* Idle period waiting for its wakeup interrupt */
+	bool pending;
+	int sel;
+	int ideal;
+	uint32_t residency_us;
+
+	ktime_t expected_wakeup;
+};
+
+static DEFINE_PER_CPU(struct lpm_wake_stats, wake_stats);
+static DEFINE_MUTEX(wake_stats_lock);
+static bool wake_stats_enabled;
+
+static void account_wakeup(struct lpm_wake_stats *stats, int slot, int irq)
+{
+	struct wake_irq_stats *w = &stats->irqs[slot];
+
+	w->irq = irq;
+	w->count++;
+	w->residency_us += stats->residency_us;
+	if (stats->sel > stats->ideal)
+		w->too_deep++;
+	else if (stats->sel < stats->ideal)
+		w->too_shallow++;
+
+	stats->pending = false;
+}
+
+static void wake_stats_irq_probe(void *ignore, int irq,
+		struct irqaction *action)
+{
+	struct lpm_wake_stats *stats = &__get_cpu_var(wake_stats);
+	int i;
+
+	if (!stats->pending)
+		return;
+
+	for (i = 0; i < WAKE_IRQ_SLOTS; i++) {
+		if (stats->irqs[i].irq == irq || !stats->irqs[i].count) {
+			account_wakeup(stats, i, irq);
+			return;
+		}
+	}
+
+	account_wakeup(stats, WAKE_IRQ_OTHER, -1);
+}
+
+/**
+ * lpm_wake_stats_enter() - Record a cpu entering an idle level.
+ *
+ * @cpu:	The cpu, which must be the calling one.
+ */
+void lpm_wake_stats_enter(unsigned int cpu)
+{
+	struct lpm_wake_stats *stats = &per_cpu(wake_stats, cpu);
+
+	if (!wake_stats_enabled)
+		return;
+
+	/* The previous idle period ended without an interrupt */
+	if (stats->pending)
+		account_wakeup(stats, WAKE_IRQ_NONE, -1);
+
+	stats->expected_wakeup = ktime_add(ktime_get(),
+					tick_nohz_get_sleep_length());
+}
+
+/*
+ * Deepest level worth entering for @residency_us, within the latency
+ * constraint of @cpu.
+ */
+static int ideal_level(unsigned int cpu, struct lpm_cpu *lpm_cpu,
+		uint32_t residency_us)
+{
+	uint32_t latency_us = pm_qos_request_for_cpu(PM_QOS_CPU_DMA_LATENCY,
+							cpu);
+	int i;
+
+	for (i = lpm_cpu->nlevels - 1; i > 0; i--) {
+		struct lpm_cpu_level *level = &lpm_cpu->levels[i];
+
+		if (!lpm_cpu_mode_allow(cpu, level->mode, true))
+			continue;
+
+		if (level->pwr.latency_us > latency_us)
+			continue;
+
+		if (residency_us > level->pwr.time_overhead_us)
+			break;
+	}
+
+	return i;
+}
+
+/**
+ * lpm_wake_stats_exit() - Record a cpu leaving an idle level.
+ *
+ * @cpu:		The cpu, which must be the calling one.
+ * @lpm_cpu:		Levels of the cpu.
+ * @idx:		The level left.
+ * @residency_us:	Time spent in the level.
+ */
+void lpm_wake_stats_exit(unsigned int cpu, struct lpm_cpu *lpm_cpu,
+		int idx, uint32_t residency_us)
+{
+	struct lpm_wake_stats *stats = &per_cpu(wake_stats, cpu);
+	s64 late_us;
+
+	if (!wake_stats_enabled)
+		return;
+
+	stats->nlevels = lpm_cpu->nlevels;
+	stats->sel = idx;
+	stats->ideal = ideal_level(cpu, lpm_cpu, residency_us);
+	stats->residency_us = residency_us;
+	stats->pending = true;
+	stats->select[stats->sel][stats->ideal]++;
+
+	/*
+	 * Woken up by the timer the selection was based on: how late the
+	 * cpu came back is its exit latency.
+	 */
+	late_us = ktime_us_delta(ktime_get(), stats->expected_wakeup);
+	if (late_us >= 0 && late_us < MAX_EXIT_LATENCY_US)
+		stats->exit_latency[idx][min(fls((int)late_us),
+					      LAT_BUCKETS - 1)]++;
+}
+
+static void wake_stats_reset(void *ignore)
+{
+	struct lpm_wake_stats *stats = &__get_cpu_var(wake_stats);
+	int nlevels = stats->nlevels;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->nlevels = nlevels;
+}
+
+static void wake_irq_print(struct seq_file *m, struct wake_irq_stats *w,
+		const char *name)
+{
+	uint64_t avg = w->residency_us;
+
+	do_div(avg, w->count);
+	seq_printf(m, "  %-24s %8u %10llu %8u %8u\n", name, w->count,
+			avg, w->too_deep, w->too_shallow);
+}
+
+static int wake_stats_show(struct seq_file *m, void *v)
+{
+	unsigned int cpu;
+	char label[16];
+	int i, j;
+
+	for_each_possible_cpu(cpu) {
+		struct lpm_wake_stats *stats = &per_cpu(wake_stats, cpu);
+
+		if (!stats->nlevels)
+			continue;
+
+		seq_printf(m, "cpu%u:\n", cpu);
+		seq_printf(m, "  %-24s %8s %10s %8s %8s\n", "wakeup irq",
+				"count", "avg us", "too deep", "too shallow");
+
+		for (i = 0; i < WAKE_IRQ_SLOTS; i++) {
+			struct wake_irq_stats *w = &stats->irqs[i];
+			struct irq_desc *desc = irq_to_desc(w->irq);
+			char name[32];
+			unsigned long flags;
+
+			if (!w->count)
+				break;
+
+			snprintf(name, sizeof(name), "%d", w->irq);
+			if (desc) {
+				raw_spin_lock_irqsave(&desc->lock, flags);
+				if (desc->action && desc->action->name)
+					snprintf(name, sizeof(name), "%d %s",
+						w->irq, desc->action->name);
+				raw_spin_unlock_irqrestore(&desc->lock, flags);
+			}
+			wake_irq_print(m, w, name);
+		}
+
+		if (stats->irqs[WAKE_IRQ_OTHER].count)
+			wake_irq_print(m, &stats->irqs[WAKE_IRQ_OTHER],
+					"other");
+		if (stats->irqs[WAKE_IRQ_NONE].count)
+			wake_irq_print(m, &stats->irqs[WAKE_IRQ_NONE], "none");
+
+		seq_puts(m, "  selected/ideal level:\n");
+		for (i = 0; i < stats->nlevels; i++) {
+			seq_printf(m, "    %d:", i);
+			for (j = 0; j < stats->nlevels; j++)
+				seq_printf(m, " %8u", stats->select[i][j]);
+			seq_puts(m, "\n");
+		}
+
+		seq_puts(m, "  exit latency (us):\n      ");
+		for (j = 0; j < LAT_BUCKETS - 1; j++) {
+			snprintf(label, sizeof(label), "<%u", 1 << j);
+			seq_printf(m, " %8s", label);
+		}
+		snprintf(label, sizeof(label), ">=%u", 1 << (LAT_BUCKETS - 2));
+		seq_printf(m, " %8s\n", label);
+		for (i = 0; i < stats->nlevels; i++) {
+			seq_printf(m, "    %d:", i);
+			for (j = 0; j < LAT_BUCKETS; j++)
+				seq_printf(m, " %8u", stats->exit_latency[i][j]);
+			seq_puts(m, "\n");
+		}
+	}
+
+	return 0;
+}
+
+static int wake_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wake_stats_show, inode->i_private);
+}
+
+static ssize_t wake_stats_write(struct file *file,
+		const char __user *buffer, size_t count, loff_t *off)
+{
+	char buf[8] = {0};
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, buffer, count))
+		return -EFAULT;
+
+	if (strncmp(buf, "reset", 5))
+		return -EINVAL;
+
+	on_each_cpu(wake_stats_reset, NULL, 1);
+
+	return count;
+}
+
+static const struct file_operations wake_stats_fops = {
+	.owner	  = THIS_MODULE,
+	.open	  = wake_stats_open,
+	.read	  = seq_read,
+	.write	  = wake_stats_write,
+	.llseek	  = seq_lseek,
+	.release  = single_release,
+};
+
+static int wake_stats_enable_get(void *data, u64 *val)
+{
+	*val = wake_stats_enabled;
+	return 0;
+}
+
+static int wake_stats_enable_set(void *data, u64 val)
+{
+	int ret = 0;
+
+	mutex_lock(&wake_stats_lock);
+	if (!!val == wake_stats_enabled)
+		goto out;
+
+	if (val) {
+		ret = register_trace_irq_handler_entry(wake_stats_irq_probe,
+							NULL);
+		if (ret)
+			goto out;
+		on_each_cpu(wake_stats_reset, NULL, 1);
+		wake_stats_enabled = true;
+	} else {
+		wake_stats_enabled = false;
+		unregister_trace_irq_handler_entry(wake_stats_irq_probe,
+							NULL);
+		tracepoint_synchronize_unregister();
+	}
+out:
+	mutex_unlock(&wake_stats_lock);
+	return ret;
+}
+DEFINE_SIMPLE_ATTRIBUTE(wake_stats_enable_fops, wake_stats_enable_get,
+			wake_stats_enable_set, "%llu\n");
+
+static int __init lpm_wake_stats_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("lpm_wake_stats", NULL);
+	if (!dir) {
+		pr_err("%s: Unable to create debugfs directory\n", __func__);
+		return -ENOMEM;
+	}
+
+	if (!debugfs_create_file("enable", S_IRUGO | S_IWUSR, dir, NULL,
+				&wake_stats_enable_fops) ||
+	    !debugfs_create_file("stats", S_IRUGO | S_IWUSR, dir, NULL,
+				&wake_stats_fops)) {
+		pr_err("%s: Unable to create debugfs files\n", __func__);
+		debugfs_remove_recursive(dir);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+late_initcall(lpm_wake_stats_init);
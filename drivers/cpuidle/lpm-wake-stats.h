@@ -0,0 +1,33 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __LPM_WAKE_STATS_H
+#define __LPM_WAKE_STATS_H
+
+struct lpm_cpu;
+
+#ifdef CONFIG_MSM_IDLE_WAKE_STATS
+void lpm_wake_stats_enter(unsigned int cpu);
+void lpm_wake_stats_exit(unsigned int cpu, struct lpm_cpu *lpm_cpu,
+		int idx, uint32_t residency_us);
+#else
+static inline void lpm_wake_stats_enter(unsigned int cpu)
+{
+}
+
+static inline void lpm_wake_stats_exit(unsigned int cpu,
+		struct lpm_cpu *lpm_cpu, int idx, uint32_t residency_us)
+{
+}
+#endif
+#endif  /* __LPM_WAKE_STATS_H */
@@ -27,9 +27,13 @@
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
 #include <linux/cache.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
 
 
 #include <linux/qcota.h>
+#include <linux/qcota_batch.h>
 #include "qce.h"
 #include "qce_ota.h"
 
@@ -56,6 +60,8 @@ struct ota_async_req {
 	} req;
 	unsigned int steps;
 	struct ota_qce_dev  *pqce;
+	/* completion callback of asynchronous requests, NULL if waited on */
+	void (*done)(struct ota_async_req *areq);
 };
 
 /*
@@ -96,12 +102,33 @@ struct ota_qce_dev {
 	u64 err_req;
 };
 
+/* per open file state, collects the completed batch operations */
+struct qcota_handle {
+	struct ota_dev_control *podev;
+	spinlock_t lock;
+	struct list_head done_list;
+	uint32_t inflight;
+	uint32_t done_count;
+	wait_queue_head_t wq;
+};
+
+struct ota_batch_op {
+	struct ota_async_req areq;
+	struct list_head list;
+	struct qcota_handle *handle;
+	uint64_t user_data;
+	uint8_t *k_buf;
+	uint8_t *user_dst;
+	uint32_t total;
+};
+
 #define OTA_MAGIC 0x4f544143
 
 static long qcota_ioctl(struct file *file,
 			  unsigned cmd, unsigned long arg);
 static int qcota_open(struct inode *inode, struct file *file);
 static int qcota_release(struct inode *inode, struct file *file);
+static unsigned int qcota_poll(struct file *file, poll_table *wait);
 static int start_req(struct ota_qce_dev *pqce, struct ota_async_req *areq);
 static void f8_cb(void *cookie, unsigned char *icv, unsigned char *iv, int ret);
 
@@ -110,6 +137,7 @@ static const struct file_operations qcota_fops = {
 	.unlocked_ioctl = qcota_ioctl,
 	.open = qcota_open,
 	.release = qcota_release,
+	.poll = qcota_poll,
 };
 
 static struct ota_dev_control qcota_dev = {
@@ -137,6 +165,8 @@ struct qcota_stat {
 	u64 f8_v_mp_op_fail;
 	u64 f9_op_success;
 	u64 f9_op_fail;
+	u64 batch_req;
+	u64 batch_op;
 };
 static struct qcota_stat _qcota_stat;
 static struct dentry *_debug_dent;
@@ -152,6 +182,7 @@ static struct ota_dev_control *qcota_control(void)
 static int qcota_open(struct inode *inode, struct file *file)
 {
 	struct ota_dev_control *podev;
+	struct qcota_handle *handle;
 
 	podev = qcota_control();
 	if (podev == NULL) {
@@ -160,27 +191,68 @@ static int qcota_open(struct inode *inode, struct file *file)
 		return -ENOENT;
 	}
 
-	file->private_data = podev;
+	handle = kzalloc(sizeof(struct qcota_handle), GFP_KERNEL);
+	if (handle == NULL)
+		return -ENOMEM;
+
+	handle->podev = podev;
+	spin_lock_init(&handle->lock);
+	INIT_LIST_HEAD(&handle->done_list);
+	init_waitqueue_head(&handle->wq);
+	file->private_data = handle;
 
 	return 0;
 }
 
+static void qcota_batch_op_free(struct ota_batch_op *bop)
+{
+	kfree(bop->k_buf);
+	kfree(bop);
+}
+
 static int qcota_release(struct inode *inode, struct file *file)
 {
+	struct qcota_handle *handle;
 	struct ota_dev_control *podev;
+	struct ota_batch_op *bop, *n;
+	unsigned long flags;
 
-	podev =  file->private_data;
+	handle =  file->private_data;
+	podev = handle->podev;
 
 	if (podev != NULL && podev->magic != OTA_MAGIC) {
 		pr_err("%s: invalid handle %p\n",
 			__func__, podev);
 	}
 
+	/* the engines still reference the batch operations in flight */
+	wait_event(handle->wq, ACCESS_ONCE(handle->inflight) == 0);
+
+	spin_lock_irqsave(&handle->lock, flags);
+	list_for_each_entry_safe(bop, n, &handle->done_list, list) {
+		list_del(&bop->list);
+		qcota_batch_op_free(bop);
+	}
+	spin_unlock_irqrestore(&handle->lock, flags);
+
+	kfree(handle);
 	file->private_data = NULL;
 
 	return 0;
 }
 
+static unsigned int qcota_poll(struct file *file, poll_table *wait)
+{
+	struct qcota_handle *handle = file->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(file, &handle->wq, wait);
+	if (ACCESS_ONCE(handle->done_count))
+		mask |= POLLIN | POLLRDNORM;
+
+	return mask;
+}
+
 static bool  _next_v_mp_req(struct ota_async_req *areq)
 {
 	unsigned char *p;
@@ -203,6 +275,14 @@ static bool  _next_v_mp_req(struct ota_async_req *areq)
 	return true;
 }
 
+static void ota_req_complete(struct ota_async_req *areq)
+{
+	if (areq->done)
+		areq->done(areq);
+	else
+		complete(&areq->complete);
+}
+
 static void req_done(unsigned long data)
 {
 	struct ota_qce_dev *pqce = (struct ota_qce_dev *)data;
@@ -248,7 +328,7 @@ static void req_done(unsigned long data)
 			ret = start_req(pqce, new_req);
 			if (unlikely(new_req && ret)) {
 				new_req->err = ret;
-				complete(&new_req->complete);
+				ota_req_complete(new_req);
 				ret = 0;
 				new_req = NULL;
 				spin_lock_irqsave(&podev->lock, flags);
@@ -262,7 +342,7 @@ static void req_done(unsigned long data)
 		};
 	}
 	if (areq)
-		complete(&areq->complete);
+		ota_req_complete(areq);
 	return;
 }
 
@@ -360,11 +440,15 @@ static struct ota_qce_dev *schedule_qce(struct ota_dev_control *podev)
 	return NULL;
 }
 
-static int submit_req(struct ota_async_req *areq, struct ota_dev_control *podev)
+/*
+ * Start the request on an idle engine or queue it, without waiting for it.
+ * Returns non zero if it could not be started, the request is finished then.
+ */
+static int _submit_req(struct ota_async_req *areq,
+				struct ota_dev_control *podev)
 {
 	unsigned long flags;
 	int ret = 0;
-	struct qcota_stat *pstat;
 	struct ota_qce_dev *pqce;
 
 	areq->err = 0;
@@ -387,8 +471,12 @@ static int submit_req(struct ota_async_req *areq, struct ota_dev_control *podev)
 		spin_unlock_irqrestore(&podev->lock, flags);
 	}
 
-	if (ret == 0)
-		wait_for_completion(&areq->complete);
+	return ret;
+}
+
+static void ota_req_stats(struct ota_async_req *areq)
+{
+	struct qcota_stat *pstat;
 
 	pstat = &_qcota_stat;
 	switch (areq->op) {
@@ -421,14 +509,223 @@ static int submit_req(struct ota_async_req *areq, struct ota_dev_control *podev)
 			pstat->f8_v_mp_op_success++;
 		break;
 	};
+}
+
+static int submit_req(struct ota_async_req *areq, struct ota_dev_control *podev)
+{
+	if (_submit_req(areq, podev) == 0)
+		wait_for_completion(&areq->complete);
 
+	ota_req_stats(areq);
 	return areq->err;
 }
 
+/* Completion of a batch operation, called from the engine tasklet */
+static void qcota_batch_done(struct ota_async_req *areq)
+{
+	struct ota_batch_op *bop = container_of(areq, struct ota_batch_op,
+									areq);
+	struct qcota_handle *handle = bop->handle;
+	unsigned long flags;
+
+	ota_req_stats(areq);
+
+	spin_lock_irqsave(&handle->lock, flags);
+	handle->inflight--;
+	handle->done_count++;
+	list_add_tail(&bop->list, &handle->done_list);
+	/* wake up under the lock, release may free the handle right after */
+	wake_up(&handle->wq);
+	spin_unlock_irqrestore(&handle->lock, flags);
+}
+
+/* Copy the input of a batch operation into a kernel buffer */
+static int qcota_batch_prep(struct ota_batch_op *bop,
+				struct qcota_batch_op *uop)
+{
+	struct qce_f8_req *pf8;
+	struct qce_f9_req *pf9;
+	uint8_t *user_src;
+
+	switch (uop->type) {
+	case QCOTA_BATCH_OP_F8:
+		pf8 = &bop->areq.req.f8_req;
+		memcpy(pf8, &uop->f8_req, sizeof(struct qce_f8_req));
+		bop->total = pf8->data_len;
+		user_src = pf8->data_in;
+		bop->user_dst = pf8->data_out;
+		if (!bop->total)
+			return -EINVAL;
+		if (user_src && !access_ok(VERIFY_READ, (void __user *)
+					user_src, bop->total))
+			return -EFAULT;
+		if (!access_ok(VERIFY_WRITE, (void __user *)
+					bop->user_dst, bop->total))
+			return -EFAULT;
+
+		/* k_buf returned from kmalloc should be cache line aligned */
+		bop->k_buf = kmalloc(bop->total, GFP_KERNEL);
+		if (bop->k_buf == NULL)
+			return -ENOMEM;
+		if (user_src && __copy_from_user(bop->k_buf,
+				(void __user *)user_src, bop->total))
+			return -EFAULT;
+
+		pf8->data_in = user_src ? bop->k_buf : NULL;
+		pf8->data_out = bop->k_buf;
+		bop->areq.op = QCE_OTA_F8_OPER;
+		break;
+
+	case QCOTA_BATCH_OP_F9:
+		pf9 = &bop->areq.req.f9_req;
+		memcpy(pf9, &uop->f9_req, sizeof(struct qce_f9_req));
+		user_src = pf9->message;
+		if (!pf9->msize)
+			return -EINVAL;
+		if (!access_ok(VERIFY_READ, (void __user *)user_src,
+					pf9->msize))
+			return -EFAULT;
+
+		bop->k_buf = kmalloc(pf9->msize, GFP_KERNEL);
+		if (bop->k_buf == NULL)
+			return -ENOMEM;
+		if (__copy_from_user(bop->k_buf, (void __user *)user_src,
+					pf9->msize))
+			return -EFAULT;
+
+		pf9->message = bop->k_buf;
+		bop->areq.op = QCE_OTA_F9_OPER;
+		break;
+
+	default:
+		return -EINVAL;
+	};
+
+	return 0;
+}
+
+static int qcota_batch_submit(struct qcota_handle *handle,
+				struct qcota_batch_submit *sub)
+{
+	struct ota_batch_op *bop;
+	struct qcota_batch_op uop;
+	unsigned long flags;
+	bool full;
+	uint32_t i;
+	int err = 0;
+
+	for (i = 0; i < sub->num_ops; i++) {
+		spin_lock_irqsave(&handle->lock, flags);
+		full = (handle->inflight + handle->done_count) >=
+					QCOTA_BATCH_MAX_OUTSTANDING;
+		if (!full)
+			handle->inflight++;
+		spin_unlock_irqrestore(&handle->lock, flags);
+		if (full) {
+			err = -EAGAIN;
+			break;
+		}
+
+		bop = kzalloc(sizeof(struct ota_batch_op), GFP_KERNEL);
+		if (bop == NULL)
+			err = -ENOMEM;
+		else if (copy_from_user(&uop, (void __user *)&sub->ops[i],
+					sizeof(struct qcota_batch_op)))
+			err = -EFAULT;
+		else
+			err = qcota_batch_prep(bop, &uop);
+		if (err) {
+			if (bop)
+				qcota_batch_op_free(bop);
+			spin_lock_irqsave(&handle->lock, flags);
+			handle->inflight--;
+			wake_up(&handle->wq);
+			spin_unlock_irqrestore(&handle->lock, flags);
+			break;
+		}
+
+		bop->handle = handle;
+		bop->user_data = uop.user_data;
+		init_completion(&bop->areq.complete);
+		bop->areq.done = qcota_batch_done;
+
+		_qcota_stat.batch_op++;
+		if (_submit_req(&bop->areq, handle->podev))
+			qcota_batch_done(&bop->areq);
+	}
+
+	sub->num_submitted = i;
+	if (i == 0 && sub->num_ops)
+		return err;
+	return 0;
+}
+
+static int qcota_batch_reap(struct qcota_handle *handle,
+				struct qcota_batch_reap *reap)
+{
+	struct qcota_batch_completion comp;
+	struct ota_batch_op *bop;
+	unsigned long flags;
+	uint32_t min_comp;
+	uint32_t n = 0;
+	int err;
+
+	if ((reap->max_completions == 0) ||
+		(reap->max_completions > QCOTA_BATCH_MAX_OUTSTANDING))
+		return -EINVAL;
+	if (!access_ok(VERIFY_WRITE, (void __user *)reap->completions,
+			reap->max_completions *
+			sizeof(struct qcota_batch_completion)))
+		return -EFAULT;
+
+	spin_lock_irqsave(&handle->lock, flags);
+	min_comp = min3(reap->min_completions, reap->max_completions,
+				handle->inflight + handle->done_count);
+	spin_unlock_irqrestore(&handle->lock, flags);
+
+	err = wait_event_interruptible(handle->wq,
+			ACCESS_ONCE(handle->done_count) >= min_comp);
+	if (err)
+		return err;
+
+	while (n < reap->max_completions) {
+		spin_lock_irqsave(&handle->lock, flags);
+		if (list_empty(&handle->done_list)) {
+			spin_unlock_irqrestore(&handle->lock, flags);
+			break;
+		}
+		bop = list_first_entry(&handle->done_list,
+					struct ota_batch_op, list);
+		list_del(&bop->list);
+		handle->done_count--;
+		spin_unlock_irqrestore(&handle->lock, flags);
+
+		comp.user_data = bop->user_data;
+		comp.status = bop->areq.err;
+		comp.mac_i = 0;
+		if (bop->areq.op == QCE_OTA_F9_OPER)
+			comp.mac_i = bop->areq.req.f9_req.mac_i;
+		else if (comp.status == 0 && __copy_to_user(
+				(void __user *)bop->user_dst, bop->k_buf,
+				bop->total))
+			comp.status = -EFAULT;
+		qcota_batch_op_free(bop);
+
+		if (__copy_to_user((void __user *)&reap->completions[n],
+				&comp, sizeof(struct qcota_batch_completion)))
+			return -EFAULT;
+		n++;
+	}
+
+	reap->num_completions = n;
+	return 0;
+}
+
 static long qcota_ioctl(struct file *file,
 			  unsigned cmd, unsigned long arg)
 {
 	int err = 0;
+	struct qcota_handle *handle;
 	struct ota_dev_control *podev;
 	uint8_t *user_src;
 	uint8_t *user_dst;
@@ -439,7 +736,8 @@ static long qcota_ioctl(struct file *file,
 	int i;
 	uint8_t *p = NULL;
 
-	podev =  file->private_data;
+	handle = file->private_data;
+	podev = handle->podev;
 	if (podev == NULL || podev->magic != OTA_MAGIC) {
 		pr_err("%s: invalid handle %p\n",
 			__func__, podev);
@@ -451,6 +749,7 @@ static long qcota_ioctl(struct file *file,
 		return -ENOTTY;
 
 	init_completion(&areq.complete);
+	areq.done = NULL;
 
 	pstat = &_qcota_stat;
 
@@ -660,6 +959,42 @@ static long qcota_ioctl(struct file *file,
 		}
 		kfree(k_buf);
 		break;
+
+	case QCOTA_BATCH_SUBMIT_REQ:
+		{
+		struct qcota_batch_submit sub;
+
+		if (copy_from_user(&sub, (void __user *)arg,
+				sizeof(struct qcota_batch_submit)))
+			return -EFAULT;
+
+		pstat->batch_req++;
+		err = qcota_batch_submit(handle, &sub);
+		if (err)
+			return err;
+		if (copy_to_user((void __user *)arg, &sub,
+				sizeof(struct qcota_batch_submit)))
+			return -EFAULT;
+		}
+		break;
+
+	case QCOTA_BATCH_REAP_REQ:
+		{
+		struct qcota_batch_reap reap;
+
+		if (copy_from_user(&reap, (void __user *)arg,
+				sizeof(struct qcota_batch_reap)))
+			return -EFAULT;
+
+		err = qcota_batch_reap(handle, &reap);
+		if (err)
+			return err;
+		if (copy_to_user((void __user *)arg, &reap,
+				sizeof(struct qcota_batch_reap)))
+			return -EFAULT;
+		}
+		break;
+
 	default:
 		return -ENOTTY;
 	}
@@ -843,6 +1178,13 @@ static int _disp_stats(void)
 			"   F9 operation fail               : %llu\n",
 					pstat->f9_op_fail);
 
+	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   Batch request                   : %llu\n",
+					pstat->batch_req);
+	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   Batch operation                 : %llu\n",
+					pstat->batch_op);
+
 	spin_lock_irqsave(&podev->lock, flags);
 
 	list_for_each_entry(p, &podev->qce_dev, qlist) {
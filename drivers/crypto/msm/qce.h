@@ -125,6 +125,7 @@ struct ce_hw_support {
 	bool clk_mgmt_sus_res;
 	unsigned int ce_device;
 	unsigned int ce_hw_instance;
+	unsigned int max_request; /* cipher/hash requests queued at once */
 };
 
 /* Sha operation parameters */
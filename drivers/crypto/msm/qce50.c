@@ -61,8 +61,10 @@ static LIST_HEAD(qce50_bam_list);
 /*
  * CE HW device structure.
  * Each engine has an instance of the structure.
- * Each engine can only handle one crypto operation at one time. It is up to
- * the sw above to ensure single threading of operation on an engine.
+ * Up to max_req cipher and hash requests can be queued to an engine at one
+ * time, each in its own ce_request_info slot. Aead and ota operations still
+ * need the engine to themselves. It is up to the sw above to serialize the
+ * issuing of requests and to keep within those limits.
  */
 struct qce_device {
 	struct device *pdev;        /* Handle to platform_device structure */
@@ -97,8 +99,6 @@ struct qce_device {
 	int dst_nents;
 
 	dma_addr_t phy_iv_in;
-	unsigned char dec_iv[16];
-	int dir;
 	void *areq;
 	enum qce_cipher_mode_enum mode;
 	struct qce_ce_cfg_reg_setting reg;
@@ -115,6 +115,10 @@ struct qce_device {
 	bool use_sw_ahash_algo;
 	bool use_sw_hmac_algo;
 	bool use_sw_aes_ccm_algo;
+
+	int max_req;			/* max cipher/hash requests queued */
+	unsigned int ce_request_index;	/* last request slot handed out */
+	struct ce_request_info ce_request_info[MAX_QCE_BAM_REQ];
 };
 
 /* Standard initialization vector for SHA-1, source: FIPS 180-2 */
@@ -203,6 +207,35 @@ static int qce_dma_unmap_sg(struct device *dev, struct scatterlist *sg,
 	return nents;
 }
 
+static int qce_alloc_req_info(struct qce_device *pce_dev)
+{
+	int i;
+	unsigned int request_index = pce_dev->ce_request_index;
+
+	for (i = 0; i < pce_dev->max_req; i++) {
+		request_index++;
+		if (request_index >= pce_dev->max_req)
+			request_index = 0;
+		if (atomic_xchg(&pce_dev->ce_request_info[request_index].in_use,
+								1) == 0) {
+			pce_dev->ce_request_index = request_index;
+			return request_index;
+		}
+	}
+	pr_warn("qce50: no request slot available, max_req %d\n",
+						pce_dev->max_req);
+	return -EBUSY;
+}
+
+static inline void qce_free_req_info(struct qce_device *pce_dev,
+				struct ce_request_info *preq_info)
+{
+	preq_info->areq = NULL;
+	/* finish with the slot before it can be handed out again */
+	smp_mb();
+	atomic_set(&preq_info->in_use, 0);
+}
+
 static int _probe_ce_engine(struct qce_device *pce_dev)
 {
 	unsigned int rev;
@@ -251,10 +284,9 @@ static int _probe_ce_engine(struct qce_device *pce_dev)
 };
 
 static struct qce_cmdlist_info *_ce_get_hash_cmdlistinfo(
-			struct qce_device *pce_dev, struct qce_sha_req *sreq)
+			struct qce_cmdlistptr_ops *cmdlistptr,
+			struct qce_sha_req *sreq)
 {
-	struct qce_cmdlistptr_ops *cmdlistptr = &pce_dev->ce_sps.cmdlistptr;
-
 	switch (sreq->alg) {
 	case QCE_HASH_SHA1:
 		return &cmdlistptr->auth_sha1;
@@ -604,10 +636,9 @@ static int _ce_setup_aead(struct qce_device *pce_dev, struct qce_req *q_req,
 };
 
 static struct qce_cmdlist_info *_ce_get_cipher_cmdlistinfo(
-			struct qce_device *pce_dev, struct qce_req *creq)
+			struct qce_cmdlistptr_ops *cmdlistptr,
+			struct qce_req *creq)
 {
-	struct qce_cmdlistptr_ops *cmdlistptr = &pce_dev->ce_sps.cmdlistptr;
-
 	if (creq->alg != CIPHER_ALG_AES) {
 		switch (creq->alg) {
 		case CIPHER_ALG_DES:
@@ -2047,36 +2078,39 @@ static int _aead_complete(struct qce_device *pce_dev)
 	return 0;
 };
 
-static int _sha_complete(struct qce_device *pce_dev)
+static int _sha_complete(struct qce_device *pce_dev,
+				struct ce_request_info *preq_info)
 {
 	struct ahash_request *areq;
 	unsigned char digest[SHA256_DIGEST_SIZE];
 	uint32_t bytecount32[2];
 	int32_t result_status;
 	uint32_t result_dump_status;
+	qce_comp_func_ptr_t qce_cb = preq_info->qce_cb;
 
-	areq = (struct ahash_request *) pce_dev->areq;
+	areq = (struct ahash_request *) preq_info->areq;
 	if (!areq) {
 		pr_err("sha operation error. areq is NULL\n");
 		return -ENXIO;
 	}
-	qce_dma_unmap_sg(pce_dev->pdev, areq->src, pce_dev->src_nents,
+	qce_dma_unmap_sg(pce_dev->pdev, areq->src, preq_info->src_nents,
 				DMA_TO_DEVICE);
-	memcpy(digest, (char *)(&pce_dev->ce_sps.result->auth_iv[0]),
+	memcpy(digest, (char *)(&preq_info->result->auth_iv[0]),
 						SHA256_DIGEST_SIZE);
 	_byte_stream_to_net_words(bytecount32,
-		(unsigned char *)pce_dev->ce_sps.result->auth_byte_count,
+		(unsigned char *)preq_info->result->auth_byte_count,
 					2 * CRYPTO_REG_SIZE);
 
 	if (_qce_unlock_other_pipes(pce_dev)) {
-		pce_dev->qce_cb(areq, digest, (char *)bytecount32,
-				-ENXIO);
+		qce_free_req_info(pce_dev, preq_info);
+		qce_cb(areq, digest, (char *)bytecount32, -ENXIO);
 		return -ENXIO;
 	}
 
 	result_status = 0;
-	result_dump_status = be32_to_cpu(pce_dev->ce_sps.result->status);
-	pce_dev->ce_sps.result->status = 0;
+	result_dump_status = be32_to_cpu(preq_info->result->status);
+	preq_info->result->status = 0;
+	qce_free_req_info(pce_dev, preq_info);
 	if (result_dump_status & ((1 << CRYPTO_SW_ERR) | (1 << CRYPTO_AXI_ERR)
 			| (1 <<  CRYPTO_HSD_ERR))) {
 
@@ -2087,8 +2121,7 @@ static int _sha_complete(struct qce_device *pce_dev)
 			pce_dev->ce_sps.consumer_status);
 		result_status = -ENXIO;
 	}
-	pce_dev->qce_cb(areq, digest, (char *)bytecount32,
-				result_status);
+	qce_cb(areq, digest, (char *)bytecount32, result_status);
 	return 0;
 };
 
@@ -2128,30 +2161,33 @@ static int _f9_complete(struct qce_device *pce_dev)
 	return 0;
 }
 
-static int _ablk_cipher_complete(struct qce_device *pce_dev)
+static int _ablk_cipher_complete(struct qce_device *pce_dev,
+				struct ce_request_info *preq_info)
 {
 	struct ablkcipher_request *areq;
 	unsigned char iv[NUM_OF_CRYPTO_CNTR_IV_REG * CRYPTO_REG_SIZE];
 	int32_t result_status;
 	uint32_t result_dump_status;
+	qce_comp_func_ptr_t qce_cb = preq_info->qce_cb;
 
-	areq = (struct ablkcipher_request *) pce_dev->areq;
+	areq = (struct ablkcipher_request *) preq_info->areq;
 
 	if (areq->src != areq->dst) {
 		qce_dma_unmap_sg(pce_dev->pdev, areq->dst,
-			pce_dev->dst_nents, DMA_FROM_DEVICE);
+			preq_info->dst_nents, DMA_FROM_DEVICE);
 	}
-	qce_dma_unmap_sg(pce_dev->pdev, areq->src, pce_dev->src_nents,
+	qce_dma_unmap_sg(pce_dev->pdev, areq->src, preq_info->src_nents,
 		(areq->src == areq->dst) ? DMA_BIDIRECTIONAL :
 						DMA_TO_DEVICE);
 
 	if (_qce_unlock_other_pipes(pce_dev)) {
-		pce_dev->qce_cb(areq, NULL, NULL, -ENXIO);
+		qce_free_req_info(pce_dev, preq_info);
+		qce_cb(areq, NULL, NULL, -ENXIO);
 		return -ENXIO;
 	}
 	result_status = 0;
-	result_dump_status = be32_to_cpu(pce_dev->ce_sps.result->status);
-	pce_dev->ce_sps.result->status = 0;
+	result_dump_status = be32_to_cpu(preq_info->result->status);
+	preq_info->result->status = 0;
 
 	if (result_dump_status & ((1 << CRYPTO_SW_ERR) | (1 << CRYPTO_AXI_ERR)
 			| (1 <<  CRYPTO_HSD_ERR))) {
@@ -2166,15 +2202,16 @@ static int _ablk_cipher_complete(struct qce_device *pce_dev)
 		result_status = -ENXIO;
 	}
 
-	if (pce_dev->mode == QCE_MODE_ECB) {
-		pce_dev->qce_cb(areq, NULL, NULL,
+	if (preq_info->mode == QCE_MODE_ECB) {
+		qce_free_req_info(pce_dev, preq_info);
+		qce_cb(areq, NULL, NULL,
 					pce_dev->ce_sps.consumer_status |
 					result_status);
 	} else {
 		if (pce_dev->ce_sps.minor_version == 0) {
-			if (pce_dev->mode == QCE_MODE_CBC) {
-				if  (pce_dev->dir == QCE_DECRYPT)
-					memcpy(iv, (char *)pce_dev->dec_iv,
+			if (preq_info->mode == QCE_MODE_CBC) {
+				if  (preq_info->dir == QCE_DECRYPT)
+					memcpy(iv, (char *)preq_info->dec_iv,
 								sizeof(iv));
 				else
 					memcpy(iv, (unsigned char *)
@@ -2182,15 +2219,15 @@ static int _ablk_cipher_complete(struct qce_device *pce_dev)
 						areq->src->length - 16),
 						sizeof(iv));
 			}
-			if ((pce_dev->mode == QCE_MODE_CTR) ||
-				(pce_dev->mode == QCE_MODE_XTS)) {
+			if ((preq_info->mode == QCE_MODE_CTR) ||
+				(preq_info->mode == QCE_MODE_XTS)) {
 				uint32_t num_blk = 0;
 				uint32_t cntr_iv3 = 0;
 				unsigned long long cntr_iv64 = 0;
 				unsigned char *b = (unsigned char *)(&cntr_iv3);
 
 				memcpy(iv, areq->info, sizeof(iv));
-				if (pce_dev->mode != QCE_MODE_XTS)
+				if (preq_info->mode != QCE_MODE_XTS)
 					num_blk = areq->nbytes/16;
 				else
 					num_blk = 1;
@@ -2212,10 +2249,11 @@ static int _ablk_cipher_complete(struct qce_device *pce_dev)
 			}
 		} else {
 			memcpy(iv,
-				(char *)(pce_dev->ce_sps.result->encr_cntr_iv),
+				(char *)(preq_info->result->encr_cntr_iv),
 				sizeof(iv));
 		}
-		pce_dev->qce_cb(areq, NULL, iv, result_status);
+		qce_free_req_info(pce_dev, preq_info);
+		qce_cb(areq, NULL, iv, result_status);
 	}
 	return 0;
 };
@@ -2712,6 +2750,16 @@ static int qce_sps_init(struct qce_device *pce_dev)
 	pr_debug("BAM device registered. bam_handle=0x%lx\n",
 		pce_dev->ce_sps.bam_handle);
 
+	/*
+	 * Requests can only be queued back to back when the engine is
+	 * programmed through command descriptors and the result dump is
+	 * part of the original producer transfer.
+	 */
+	if (pce_dev->support_cmd_dscr && pce_dev->no_get_around)
+		pce_dev->max_req = MAX_QCE_BAM_REQ;
+	else
+		pce_dev->max_req = 1;
+
 	rc = qce_sps_init_ep_conn(pce_dev, &pce_dev->ce_sps.producer, true);
 	if (rc)
 		goto sps_connect_producer_err;
@@ -2791,16 +2839,6 @@ static void _aead_sps_producer_callback(struct sps_event_notify *notify)
 	}
 }
 
-static void _sha_sps_producer_callback(struct sps_event_notify *notify)
-{
-	struct qce_device *pce_dev = (struct qce_device *)
-		((struct sps_event_notify *)notify)->user;
-
-	pce_dev->ce_sps.notify = *notify;
-	print_notify_debug(notify);
-	_sha_complete(pce_dev);
-}
-
 static void _f9_sps_producer_callback(struct sps_event_notify *notify)
 {
 	struct qce_device *pce_dev = (struct qce_device *)
@@ -2821,21 +2859,34 @@ static void _f8_sps_producer_callback(struct sps_event_notify *notify)
 	_f8_complete(pce_dev);
 }
 
-static void _ablk_cipher_sps_producer_callback(struct sps_event_notify *notify)
+/*
+ * Producer callback shared by the cipher and hash requests. Those can be
+ * queued back to back, so the callback registered when the request was
+ * issued may not be the one for the request that completed; the slot of
+ * the completed request comes back as the user pointer of its last
+ * descriptor.
+ */
+static void _qce_req_sps_producer_callback(struct sps_event_notify *notify)
 {
 	struct qce_device *pce_dev = (struct qce_device *)
 		((struct sps_event_notify *)notify)->user;
+	struct ce_request_info *preq_info = (struct ce_request_info *)
+		notify->data.transfer.user;
 
 	pce_dev->ce_sps.notify = *notify;
 	print_notify_debug(notify);
+	if (preq_info->xfer_type == QCE_XFER_HASHING) {
+		_sha_complete(pce_dev, preq_info);
+		return;
+	}
 	if (pce_dev->ce_sps.producer_state == QCE_PIPE_STATE_COMP) {
 		pce_dev->ce_sps.producer_state = QCE_PIPE_STATE_IDLE;
-		_ablk_cipher_complete(pce_dev);
+		_ablk_cipher_complete(pce_dev, preq_info);
 	} else {
 		int rc = 0;
 		pce_dev->ce_sps.producer_state = QCE_PIPE_STATE_COMP;
 		pce_dev->ce_sps.out_transfer.iovec_count = 0;
-		_qce_sps_add_data(GET_PHYS_ADDR(pce_dev->ce_sps.result_dump),
+		_qce_sps_add_data(GET_PHYS_ADDR(preq_info->result_dump),
 					CRYPTO_RESULT_DUMP_SIZE,
 					  &pce_dev->ce_sps.out_transfer);
 		_qce_set_flag(&pce_dev->ce_sps.out_transfer,
@@ -3865,15 +3916,16 @@ static int _setup_unlock_pipe_cmdlistptrs(struct qce_device *pdev,
 	return 0;
 }
 
-static int qce_setup_cmdlistptrs(struct qce_device *pdev,
-					unsigned char **pvaddr)
+static int qce_setup_req_cmdlistptrs(struct qce_device *pdev,
+				struct ce_request_info *preq_info,
+				unsigned char **pvaddr)
 {
 	struct sps_command_element *ce_vaddr =
 				(struct sps_command_element *)(*pvaddr);
 	/*
-	 * Designate chunks of the allocated memory to various
-	 * command list pointers related to operations defined
-	 * in ce_cmdlistptrs_ops structure.
+	 * Designate chunks of the allocated memory to the cipher and
+	 * hash command lists of one request slot. These are built in
+	 * ce_sps.cmdlistptr and then copied to the slot.
 	 */
 	ce_vaddr =
 		(struct sps_command_element *)ALIGN(((uintptr_t) ce_vaddr),
@@ -3903,6 +3955,26 @@ static int qce_setup_cmdlistptrs(struct qce_device *pdev,
 	_setup_auth_cmdlistptrs(pdev, pvaddr, QCE_HASH_AES_CMAC, true);
 	_setup_auth_cmdlistptrs(pdev, pvaddr, QCE_HASH_AES_CMAC, false);
 
+	preq_info->cmdlistptr = pdev->ce_sps.cmdlistptr;
+
+	return 0;
+}
+
+static int qce_setup_cmdlistptrs(struct qce_device *pdev,
+					unsigned char **pvaddr)
+{
+	struct sps_command_element *ce_vaddr =
+				(struct sps_command_element *)(*pvaddr);
+	/*
+	 * Designate chunks of the allocated memory to various
+	 * command list pointers related to operations defined
+	 * in ce_cmdlistptrs_ops structure.
+	 */
+	ce_vaddr =
+		(struct sps_command_element *)ALIGN(((uintptr_t) ce_vaddr),
+					pdev->ce_sps.ce_burst_size);
+	*pvaddr = (unsigned char *) ce_vaddr;
+
 	_setup_aead_cmdlistptrs(pdev, pvaddr, CIPHER_ALG_DES, QCE_MODE_CBC,
 					DES_KEY_SIZE, true);
 	_setup_aead_cmdlistptrs(pdev, pvaddr, CIPHER_ALG_3DES, QCE_MODE_CBC,
@@ -3934,6 +4006,8 @@ static int qce_setup_cmdlistptrs(struct qce_device *pdev,
 static int qce_setup_ce_sps_data(struct qce_device *pce_dev)
 {
 	unsigned char *vaddr;
+	struct ce_request_info *preq_info;
+	int i;
 
 	vaddr = pce_dev->coh_vmem;
 	vaddr = (unsigned char *)ALIGN(((uintptr_t)vaddr),
@@ -3949,6 +4023,18 @@ static int qce_setup_ce_sps_data(struct qce_device *pce_dev)
 					(uintptr_t)GET_PHYS_ADDR(vaddr);
 	vaddr += QCE_MAX_NUM_DSCR * sizeof(struct sps_iovec);
 
+	for (i = 0; i < pce_dev->max_req; i++) {
+		preq_info = &pce_dev->ce_request_info[i];
+		atomic_set(&preq_info->in_use, 0);
+		if (pce_dev->support_cmd_dscr)
+			qce_setup_req_cmdlistptrs(pce_dev, preq_info, &vaddr);
+		vaddr = (unsigned char *)ALIGN(((uintptr_t)vaddr),
+					pce_dev->ce_sps.ce_burst_size);
+		preq_info->result_dump = (uintptr_t)vaddr;
+		preq_info->result = (struct ce_result_dump_format *)vaddr;
+		vaddr += CRYPTO_RESULT_DUMP_SIZE;
+	}
+
 	if (pce_dev->support_cmd_dscr)
 		qce_setup_cmdlistptrs(pce_dev, &vaddr);
 	vaddr = (unsigned char *)ALIGN(((uintptr_t)vaddr),
@@ -4210,7 +4296,8 @@ static int _qce_aead_ccm_req(void *handle, struct qce_req *q_req)
 	}
 
 	if (pce_dev->support_cmd_dscr) {
-		cmdlistinfo = _ce_get_cipher_cmdlistinfo(pce_dev, q_req);
+		cmdlistinfo = _ce_get_cipher_cmdlistinfo(
+					&pce_dev->ce_sps.cmdlistptr, q_req);
 		if (cmdlistinfo == NULL) {
 			pr_err("Unsupported cipher algorithm %d, mode %d\n",
 						q_req->alg, q_req->mode);
@@ -4394,6 +4481,8 @@ static int _qce_resume(void *handle)
 
 	pce_dev->ce_sps.out_transfer.user = pce_dev->ce_sps.producer.pipe;
 	pce_dev->ce_sps.in_transfer.user = pce_dev->ce_sps.consumer.pipe;
+	/* events are dropped on disconnect, register again on next request */
+	pce_dev->ce_sps.producer.event.callback = NULL;
 
 	qce_disable_clk(pce_dev);
 	return rc;
@@ -4627,39 +4716,50 @@ int qce_ablk_cipher_req(void *handle, struct qce_req *c_req)
 	struct ablkcipher_request *areq = (struct ablkcipher_request *)
 						c_req->areq;
 	struct qce_cmdlist_info *cmdlistinfo = NULL;
+	int req_info = -1;
+	struct ce_request_info *preq_info;
 
-	pce_dev->src_nents = 0;
-	pce_dev->dst_nents = 0;
+	req_info = qce_alloc_req_info(pce_dev);
+	if (req_info < 0)
+		return -EBUSY;
+	preq_info = &pce_dev->ce_request_info[req_info];
+
+	preq_info->src_nents = 0;
+	preq_info->dst_nents = 0;
 
 	/* cipher input */
-	pce_dev->src_nents = count_sg(areq->src, areq->nbytes);
+	preq_info->src_nents = count_sg(areq->src, areq->nbytes);
 
-	qce_dma_map_sg(pce_dev->pdev, areq->src, pce_dev->src_nents,
+	qce_dma_map_sg(pce_dev->pdev, areq->src, preq_info->src_nents,
 		(areq->src == areq->dst) ? DMA_BIDIRECTIONAL :
 							DMA_TO_DEVICE);
 	/* cipher output */
 	if (areq->src != areq->dst) {
-		pce_dev->dst_nents = count_sg(areq->dst, areq->nbytes);
+		preq_info->dst_nents = count_sg(areq->dst, areq->nbytes);
 			qce_dma_map_sg(pce_dev->pdev, areq->dst,
-				pce_dev->dst_nents, DMA_FROM_DEVICE);
+				preq_info->dst_nents, DMA_FROM_DEVICE);
 	} else {
-		pce_dev->dst_nents = pce_dev->src_nents;
+		preq_info->dst_nents = preq_info->src_nents;
 	}
-	pce_dev->dir = c_req->dir;
+	preq_info->dir = c_req->dir;
+	preq_info->mode = c_req->mode;
 	if  ((pce_dev->ce_sps.minor_version == 0) && (c_req->dir == QCE_DECRYPT)
 			&& (c_req->mode == QCE_MODE_CBC)) {
-		memcpy(pce_dev->dec_iv, (unsigned char *)sg_virt(areq->src) +
-					 areq->src->length - 16,
+		memcpy(preq_info->dec_iv, (unsigned char *)
+					sg_virt(areq->src) +
+					areq->src->length - 16,
 			NUM_OF_CRYPTO_CNTR_IV_REG * CRYPTO_REG_SIZE);
 	}
 
 	/* set up crypto device */
 	if (pce_dev->support_cmd_dscr) {
-		cmdlistinfo = _ce_get_cipher_cmdlistinfo(pce_dev, c_req);
+		cmdlistinfo = _ce_get_cipher_cmdlistinfo(
+					&preq_info->cmdlistptr, c_req);
 		if (cmdlistinfo == NULL) {
 			pr_err("Unsupported cipher algorithm %d, mode %d\n",
 						c_req->alg, c_req->mode);
-			return -EINVAL;
+			rc = -EINVAL;
+			goto bad;
 		}
 		rc = _ce_setup_cipher(pce_dev, c_req, areq->nbytes, 0,
 							cmdlistinfo);
@@ -4670,20 +4770,27 @@ int qce_ablk_cipher_req(void *handle, struct qce_req *c_req)
 		goto bad;
 
 	/* setup for client callback, and issue command to BAM */
-	pce_dev->areq = areq;
-	pce_dev->qce_cb = c_req->qce_cb;
+	preq_info->areq = areq;
+	preq_info->qce_cb = c_req->qce_cb;
+	preq_info->xfer_type = QCE_XFER_CIPHERING;
 
 	/* Register callback event for EOT (End of transfer) event. */
-	pce_dev->ce_sps.producer.event.callback =
-				_ablk_cipher_sps_producer_callback;
-	pce_dev->ce_sps.producer.event.options = SPS_O_DESC_DONE;
-	rc = sps_register_event(pce_dev->ce_sps.producer.pipe,
+	if (pce_dev->ce_sps.producer.event.callback !=
+					_qce_req_sps_producer_callback) {
+		pce_dev->ce_sps.producer.event.callback =
+					_qce_req_sps_producer_callback;
+		pce_dev->ce_sps.producer.event.options = SPS_O_DESC_DONE;
+		rc = sps_register_event(pce_dev->ce_sps.producer.pipe,
 					&pce_dev->ce_sps.producer.event);
-	if (rc) {
-		pr_err("Producer callback registration failed rc = %d\n", rc);
-		goto bad;
+		if (rc) {
+			pce_dev->ce_sps.producer.event.callback = NULL;
+			pr_err("Producer callback registration failed rc = %d\n",
+									rc);
+			goto bad;
+		}
 	}
 	_qce_sps_iovec_count_init(pce_dev);
+	pce_dev->ce_sps.out_transfer.user = preq_info;
 	if (pce_dev->support_cmd_dscr)
 		_qce_sps_add_cmd(pce_dev, SPS_IOVEC_FLAG_LOCK, cmdlistinfo,
 					&pce_dev->ce_sps.in_transfer);
@@ -4704,7 +4811,7 @@ int qce_ablk_cipher_req(void *handle, struct qce_req *c_req)
 	if (pce_dev->no_get_around || areq->nbytes <= SPS_MAX_PKT_SIZE) {
 		pce_dev->ce_sps.producer_state = QCE_PIPE_STATE_COMP;
 		if (_qce_sps_add_data(
-				GET_PHYS_ADDR(pce_dev->ce_sps.result_dump),
+				GET_PHYS_ADDR(preq_info->result_dump),
 				CRYPTO_RESULT_DUMP_SIZE,
 				&pce_dev->ce_sps.out_transfer))
 			goto bad;
@@ -4718,17 +4825,18 @@ int qce_ablk_cipher_req(void *handle, struct qce_req *c_req)
 		return 0;
 bad:
 	if (areq->src != areq->dst) {
-		if (pce_dev->dst_nents) {
+		if (preq_info->dst_nents) {
 			qce_dma_unmap_sg(pce_dev->pdev, areq->dst,
-			pce_dev->dst_nents, DMA_FROM_DEVICE);
+			preq_info->dst_nents, DMA_FROM_DEVICE);
 		}
 	}
-	if (pce_dev->src_nents) {
+	if (preq_info->src_nents) {
 		qce_dma_unmap_sg(pce_dev->pdev, areq->src,
-				pce_dev->src_nents,
+				preq_info->src_nents,
 				(areq->src == areq->dst) ?
 				DMA_BIDIRECTIONAL : DMA_TO_DEVICE);
 	}
+	qce_free_req_info(pce_dev, preq_info);
 	return rc;
 }
 EXPORT_SYMBOL(qce_ablk_cipher_req);
@@ -4740,16 +4848,25 @@ int qce_process_sha_req(void *handle, struct qce_sha_req *sreq)
 
 	struct ahash_request *areq = (struct ahash_request *)sreq->areq;
 	struct qce_cmdlist_info *cmdlistinfo = NULL;
+	int req_info = -1;
+	struct ce_request_info *preq_info;
+
+	req_info = qce_alloc_req_info(pce_dev);
+	if (req_info < 0)
+		return -EBUSY;
+	preq_info = &pce_dev->ce_request_info[req_info];
 
-	pce_dev->src_nents = count_sg(sreq->src, sreq->size);
-	qce_dma_map_sg(pce_dev->pdev, sreq->src, pce_dev->src_nents,
+	preq_info->src_nents = count_sg(sreq->src, sreq->size);
+	qce_dma_map_sg(pce_dev->pdev, sreq->src, preq_info->src_nents,
 							DMA_TO_DEVICE);
 
 	if (pce_dev->support_cmd_dscr) {
-		cmdlistinfo = _ce_get_hash_cmdlistinfo(pce_dev, sreq);
+		cmdlistinfo = _ce_get_hash_cmdlistinfo(&preq_info->cmdlistptr,
+							sreq);
 		if (cmdlistinfo == NULL) {
 			pr_err("Unsupported hash algorithm %d\n", sreq->alg);
-			return -EINVAL;
+			rc = -EINVAL;
+			goto bad;
 		}
 		rc = _ce_setup_hash(pce_dev, sreq, cmdlistinfo);
 	} else {
@@ -4758,19 +4875,27 @@ int qce_process_sha_req(void *handle, struct qce_sha_req *sreq)
 	if (rc < 0)
 		goto bad;
 
-	pce_dev->areq = areq;
-	pce_dev->qce_cb = sreq->qce_cb;
+	preq_info->areq = areq;
+	preq_info->qce_cb = sreq->qce_cb;
+	preq_info->xfer_type = QCE_XFER_HASHING;
 
 	/* Register callback event for EOT (End of transfer) event. */
-	pce_dev->ce_sps.producer.event.callback = _sha_sps_producer_callback;
-	pce_dev->ce_sps.producer.event.options = SPS_O_DESC_DONE;
-	rc = sps_register_event(pce_dev->ce_sps.producer.pipe,
+	if (pce_dev->ce_sps.producer.event.callback !=
+					_qce_req_sps_producer_callback) {
+		pce_dev->ce_sps.producer.event.callback =
+					_qce_req_sps_producer_callback;
+		pce_dev->ce_sps.producer.event.options = SPS_O_DESC_DONE;
+		rc = sps_register_event(pce_dev->ce_sps.producer.pipe,
 					&pce_dev->ce_sps.producer.event);
-	if (rc) {
-		pr_err("Producer callback registration failed rc = %d\n", rc);
-		goto bad;
+		if (rc) {
+			pce_dev->ce_sps.producer.event.callback = NULL;
+			pr_err("Producer callback registration failed rc = %d\n",
+									rc);
+			goto bad;
+		}
 	}
 	_qce_sps_iovec_count_init(pce_dev);
+	pce_dev->ce_sps.out_transfer.user = preq_info;
 
 	if (pce_dev->support_cmd_dscr)
 		_qce_sps_add_cmd(pce_dev, SPS_IOVEC_FLAG_LOCK, cmdlistinfo,
@@ -4792,7 +4917,7 @@ int qce_process_sha_req(void *handle, struct qce_sha_req *sreq)
 			&pce_dev->ce_sps.cmdlistptr.unlock_all_pipes,
 			&pce_dev->ce_sps.in_transfer);
 
-	if (_qce_sps_add_data(GET_PHYS_ADDR(pce_dev->ce_sps.result_dump),
+	if (_qce_sps_add_data(GET_PHYS_ADDR(preq_info->result_dump),
 					CRYPTO_RESULT_DUMP_SIZE,
 					  &pce_dev->ce_sps.out_transfer))
 		goto bad;
@@ -4802,10 +4927,11 @@ int qce_process_sha_req(void *handle, struct qce_sha_req *sreq)
 		goto bad;
 		return 0;
 bad:
-	if (pce_dev->src_nents) {
+	if (preq_info->src_nents) {
 		qce_dma_unmap_sg(pce_dev->pdev, sreq->src,
-				pce_dev->src_nents, DMA_TO_DEVICE);
+				preq_info->src_nents, DMA_TO_DEVICE);
 	}
+	qce_free_req_info(pce_dev, preq_info);
 	return rc;
 }
 EXPORT_SYMBOL(qce_process_sha_req);
@@ -5358,7 +5484,8 @@ void *qce_open(struct platform_device *pdev, int *rc)
 		goto err_pce_dev;
 	}
 
-	pce_dev->memsize = 10 * PAGE_SIZE;
+	/* shared descriptors and command lists, plus one chunk per request */
+	pce_dev->memsize = 10 * PAGE_SIZE + MAX_QCE_BAM_REQ * 3 * PAGE_SIZE;
 	pce_dev->coh_vmem = dma_alloc_coherent(pce_dev->pdev,
 			pce_dev->memsize, &pce_dev->coh_pmem, GFP_KERNEL);
 	if (pce_dev->coh_vmem == NULL) {
@@ -5462,6 +5589,7 @@ int qce_hw_support(void *handle, struct ce_hw_support *ce_support)
 	ce_support->hw_key = pce_dev->support_hw_key;
 	ce_support->aes_ccm = true;
 	ce_support->clk_mgmt_sus_res = pce_dev->support_clk_mgmt_sus_res;
+	ce_support->max_request = pce_dev->max_req;
 	if (pce_dev->ce_sps.minor_version)
 		ce_support->aligned_only = false;
 	else
@@ -38,6 +38,9 @@
 #define QCE_MAX_NUM_DESC    128
 #define SPS_MAX_PKT_SIZE  (32 * 1024  - 64)
 
+/* Max number of cipher/hash requests queued to the BAM pipes at once */
+#define MAX_QCE_BAM_REQ 4
+
 /* State of consumer/producer Pipe */
 enum qce_pipe_st_enum {
 	QCE_PIPE_STATE_IDLE = 0,
@@ -46,6 +49,13 @@ enum qce_pipe_st_enum {
 	QCE_PIPE_STATE_LAST
 };
 
+/* Type of a request held in a ce_request_info slot */
+enum qce_xfr_type_enum {
+	QCE_XFER_HASHING,
+	QCE_XFER_CIPHERING,
+	QCE_XFER_TYPE_LAST
+};
+
 struct qce_sps_ep_conn_data {
 	struct sps_pipe			*pipe;
 	struct sps_connect		connect;
@@ -201,4 +211,24 @@ struct ce_sps_data {
 	struct ce_result_dump_format *result;
 	uint32_t minor_version;
 };
+/*
+ * Per request state of a cipher or hash request queued to the BAM pipes.
+ * Each slot has its own command lists and result dump, so a request can
+ * be set up while earlier ones are still being processed by the engine.
+ */
+struct ce_request_info {
+	atomic_t in_use;
+	enum qce_xfr_type_enum xfer_type;
+	void *areq;
+	qce_comp_func_ptr_t qce_cb;	/* qce callback function pointer */
+	int src_nents;
+	int dst_nents;
+	int dir;
+	enum qce_cipher_mode_enum mode;
+	unsigned char dec_iv[16];
+
+	struct qce_cmdlistptr_ops cmdlistptr;
+	uint32_t result_dump;
+	struct ce_result_dump_format *result;
+};
 #endif /* _DRIVERS_CRYPTO_MSM_QCE50_H */
@@ -12,6 +12,9 @@
  * GNU General Public License for more details.
  */
 #include <linux/mman.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/jiffies.h>
 #include <linux/types.h>
 #include <linux/platform_device.h>
 #include <linux/dma-mapping.h>
@@ -158,6 +161,10 @@ struct qcedev_stat {
 	u32 qcedev_enc_fail;
 	u32 qcedev_sha_success;
 	u32 qcedev_sha_fail;
+	u32 qcedev_zc_cipher;
+	u32 qcedev_zc_sha;
+	u32 qcedev_pin_hit;
+	u32 qcedev_pin_miss;
 };
 
 static struct qcedev_stat _qcedev_stat;
@@ -176,6 +183,418 @@ static struct qcedev_control *qcedev_minor_to_control(unsigned n)
 	return NULL;
 }
 
+/*
+ * Zero-copy path: large requests on suitably aligned user buffers are run
+ * by the CE directly on the pinned user pages instead of a bounce buffer.
+ */
+#define QCEDEV_ZC_MIN_LEN	PAGE_SIZE
+#define QCEDEV_ZC_MAX_LEN	(256 * PAGE_SIZE)
+#define QCEDEV_ZC_MAX_SG	(QCE_MAX_OPER_DATA / PAGE_SIZE + \
+					2 * QCEDEV_MAX_BUFFERS + 1)
+
+struct qcedev_zc_seg {
+	struct qcedev_pin_entry *pin;
+	unsigned long uaddr;
+	uint32_t len;
+};
+
+struct qcedev_zc_buf {
+	int nsegs;
+	struct qcedev_zc_seg seg[QCEDEV_MAX_BUFFERS];
+};
+
+struct qcedev_zc_req {
+	struct qcedev_zc_buf src;
+	struct qcedev_zc_buf dst;
+	struct scatterlist sg_src[QCEDEV_ZC_MAX_SG];
+	struct scatterlist sg_dst[QCEDEV_ZC_MAX_SG];
+};
+
+static void qcedev_pin_release(struct qcedev_pin_entry *e)
+{
+	unsigned int i;
+
+	for (i = 0; i < e->nr_pages; i++)
+		put_page(e->pages[i]);
+	kfree(e->pages);
+	kfree(e);
+}
+
+/*
+ * Unhook the cached regions overlapping [start, end). Called with the cache
+ * lock held, idle entries are returned in drop for the caller to release,
+ * busy ones are released by their last user.
+ */
+static int qcedev_pin_cache_drop(struct qcedev_pin_cache *cache,
+		unsigned long start, unsigned long end,
+		struct qcedev_pin_entry **drop)
+{
+	struct qcedev_pin_entry *e;
+	int i, n = 0;
+
+	for (i = 0; i < QCEDEV_PIN_CACHE_SIZE; i++) {
+		e = cache->entry[i];
+		if (e == NULL)
+			continue;
+		if ((e->start >= end) ||
+			(e->start + (e->nr_pages << PAGE_SHIFT) <= start))
+			continue;
+		cache->entry[i] = NULL;
+		e->cached = false;
+		if (e->users == 0)
+			drop[n++] = e;
+	}
+	return n;
+}
+
+static void qcedev_pin_cache_invalidate(struct qcedev_pin_cache *cache,
+		unsigned long start, unsigned long end, bool release)
+{
+	struct qcedev_pin_entry *drop[QCEDEV_PIN_CACHE_SIZE];
+	int i, n;
+
+	spin_lock(&cache->lock);
+	cache->invalidate_seq++;
+	if (release)
+		cache->released = true;
+	n = qcedev_pin_cache_drop(cache, start, end, drop);
+	spin_unlock(&cache->lock);
+
+	for (i = 0; i < n; i++)
+		qcedev_pin_release(drop[i]);
+}
+
+static void qcedev_mn_release(struct mmu_notifier *mn, struct mm_struct *mm)
+{
+	struct qcedev_pin_cache *cache =
+			container_of(mn, struct qcedev_pin_cache, mn);
+
+	qcedev_pin_cache_invalidate(cache, 0, ULONG_MAX, true);
+}
+
+static void qcedev_mn_invalidate_page(struct mmu_notifier *mn,
+		struct mm_struct *mm, unsigned long address)
+{
+	struct qcedev_pin_cache *cache =
+			container_of(mn, struct qcedev_pin_cache, mn);
+
+	qcedev_pin_cache_invalidate(cache, address & PAGE_MASK,
+			(address & PAGE_MASK) + PAGE_SIZE, false);
+}
+
+static void qcedev_mn_invalidate_range_start(struct mmu_notifier *mn,
+		struct mm_struct *mm, unsigned long start, unsigned long end)
+{
+	struct qcedev_pin_cache *cache =
+			container_of(mn, struct qcedev_pin_cache, mn);
+
+	spin_lock(&cache->lock);
+	cache->invalidate_count++;
+	spin_unlock(&cache->lock);
+	qcedev_pin_cache_invalidate(cache, start, end, false);
+}
+
+static void qcedev_mn_invalidate_range_end(struct mmu_notifier *mn,
+		struct mm_struct *mm, unsigned long start, unsigned long end)
+{
+	struct qcedev_pin_cache *cache =
+			container_of(mn, struct qcedev_pin_cache, mn);
+
+	spin_lock(&cache->lock);
+	cache->invalidate_count--;
+	spin_unlock(&cache->lock);
+}
+
+static const struct mmu_notifier_ops qcedev_mn_ops = {
+	.release		= qcedev_mn_release,
+	.invalidate_page	= qcedev_mn_invalidate_page,
+	.invalidate_range_start	= qcedev_mn_invalidate_range_start,
+	.invalidate_range_end	= qcedev_mn_invalidate_range_end,
+};
+
+/*
+ * Return the pin cache of the handle, creating it for the calling process
+ * on first use. NULL if the handle is used from another process or the
+ * cache can not be set up, pinned pages are then not kept for reuse.
+ */
+static struct qcedev_pin_cache *qcedev_get_pin_cache(
+					struct qcedev_handle *handle)
+{
+	struct qcedev_pin_cache *cache;
+
+	mutex_lock(&handle->pin_cache_lock);
+	cache = handle->pin_cache;
+	if (cache == NULL) {
+		cache = kzalloc(sizeof(struct qcedev_pin_cache), GFP_KERNEL);
+		if (cache) {
+			spin_lock_init(&cache->lock);
+			cache->mn.ops = &qcedev_mn_ops;
+			cache->mm = current->mm;
+			if (mmu_notifier_register(&cache->mn, cache->mm)) {
+				kfree(cache);
+				cache = NULL;
+			} else {
+				handle->pin_cache = cache;
+			}
+		}
+	}
+	mutex_unlock(&handle->pin_cache_lock);
+
+	if (cache && (cache->mm != current->mm))
+		return NULL;
+	return cache;
+}
+
+static void qcedev_pin_cache_destroy(struct qcedev_handle *handle)
+{
+	struct qcedev_pin_cache *cache = handle->pin_cache;
+
+	if (cache == NULL)
+		return;
+
+	/* runs ->release, which drops all the cached regions */
+	mmu_notifier_unregister(&cache->mn, cache->mm);
+	kfree(cache);
+	handle->pin_cache = NULL;
+}
+
+static int qcedev_pin_user(struct qcedev_handle *handle, unsigned long uaddr,
+		uint32_t len, bool write, struct qcedev_pin_entry **pentry)
+{
+	struct qcedev_pin_cache *cache;
+	struct qcedev_pin_entry *e, *victim = NULL;
+	unsigned long start = uaddr & PAGE_MASK;
+	unsigned long end;
+	unsigned long seq = 0;
+	int i, ret, slot = -1;
+
+	if (uaddr + len < uaddr)
+		return -EFAULT;
+	end = PAGE_ALIGN(uaddr + len);
+
+	cache = qcedev_get_pin_cache(handle);
+	if (cache) {
+		spin_lock(&cache->lock);
+		for (i = 0; i < QCEDEV_PIN_CACHE_SIZE; i++) {
+			e = cache->entry[i];
+			if (e && (e->write || !write) && (e->start <= start) &&
+				(end <= e->start + (e->nr_pages << PAGE_SHIFT))) {
+				e->users++;
+				e->last_use = jiffies;
+				_qcedev_stat.qcedev_pin_hit++;
+				spin_unlock(&cache->lock);
+				*pentry = e;
+				return 0;
+			}
+		}
+		seq = cache->invalidate_seq;
+		spin_unlock(&cache->lock);
+	}
+	_qcedev_stat.qcedev_pin_miss++;
+
+	e = kzalloc(sizeof(struct qcedev_pin_entry), GFP_KERNEL);
+	if (e == NULL)
+		return -ENOMEM;
+	e->start = start;
+	e->nr_pages = (end - start) >> PAGE_SHIFT;
+	e->write = write;
+	e->users = 1;
+	e->pages = kcalloc(e->nr_pages, sizeof(struct page *), GFP_KERNEL);
+	if (e->pages == NULL) {
+		kfree(e);
+		return -ENOMEM;
+	}
+
+	ret = get_user_pages_fast(start, e->nr_pages, write, e->pages);
+	if (ret < (int)e->nr_pages) {
+		e->nr_pages = (ret > 0) ? ret : 0;
+		qcedev_pin_release(e);
+		return -EFAULT;
+	}
+
+	if (cache) {
+		spin_lock(&cache->lock);
+		/* only keep pages no invalidation could have raced with */
+		if (!cache->released && !cache->invalidate_count &&
+				(seq == cache->invalidate_seq)) {
+			for (i = 0; i < QCEDEV_PIN_CACHE_SIZE; i++) {
+				if (cache->entry[i] == NULL) {
+					slot = i;
+					break;
+				}
+				if (cache->entry[i]->users)
+					continue;
+				if ((slot < 0) ||
+					time_before(cache->entry[i]->last_use,
+						cache->entry[slot]->last_use))
+					slot = i;
+			}
+			if (slot >= 0) {
+				victim = cache->entry[slot];
+				if (victim)
+					victim->cached = false;
+				e->cached = true;
+				e->last_use = jiffies;
+				cache->entry[slot] = e;
+			}
+		}
+		spin_unlock(&cache->lock);
+		if (victim)
+			qcedev_pin_release(victim);
+	}
+
+	*pentry = e;
+	return 0;
+}
+
+static void qcedev_unpin_user(struct qcedev_handle *handle,
+					struct qcedev_pin_entry *e)
+{
+	struct qcedev_pin_cache *cache = handle->pin_cache;
+	bool release = true;
+
+	if (cache) {
+		spin_lock(&cache->lock);
+		e->users--;
+		release = !e->cached && (e->users == 0);
+		spin_unlock(&cache->lock);
+	}
+	if (release)
+		qcedev_pin_release(e);
+}
+
+static void qcedev_zc_unpin_buf(struct qcedev_handle *handle,
+				struct qcedev_zc_buf *zbuf, bool dirty)
+{
+	struct qcedev_zc_seg *seg;
+	unsigned long p, first, last;
+	int i;
+
+	for (i = 0; i < zbuf->nsegs; i++) {
+		seg = &zbuf->seg[i];
+		if (dirty) {
+			first = (seg->uaddr - seg->pin->start) >> PAGE_SHIFT;
+			last = (seg->uaddr + seg->len - 1 - seg->pin->start) >>
+								PAGE_SHIFT;
+			for (p = first; p <= last; p++)
+				set_page_dirty_lock(seg->pin->pages[p]);
+		}
+		qcedev_unpin_user(handle, seg->pin);
+	}
+	zbuf->nsegs = 0;
+}
+
+static int qcedev_zc_pin_buf(struct qcedev_handle *handle,
+		struct buf_info *bufs, int entries, bool write,
+		struct qcedev_zc_buf *zbuf)
+{
+	struct qcedev_zc_seg *seg;
+	int i, ret;
+
+	zbuf->nsegs = 0;
+	for (i = 0; i < entries; i++) {
+		if (bufs[i].len == 0)
+			continue;
+		seg = &zbuf->seg[zbuf->nsegs];
+		seg->uaddr = (unsigned long)bufs[i].vaddr;
+		seg->len = bufs[i].len;
+		ret = qcedev_pin_user(handle, seg->uaddr, seg->len, write,
+								&seg->pin);
+		if (ret) {
+			qcedev_zc_unpin_buf(handle, zbuf, false);
+			return ret;
+		}
+		zbuf->nsegs++;
+	}
+	return 0;
+}
+
+/*
+ * Describe bytes [off, off + len) of a pinned buffer in sg, which must have
+ * been initialized for nents entries. Returns the number of entries used.
+ */
+static int qcedev_zc_fill_sg(struct qcedev_zc_buf *zbuf, uint32_t off,
+		uint32_t len, struct scatterlist *sg, int nents)
+{
+	struct qcedev_zc_seg *seg;
+	unsigned long addr;
+	unsigned int poff, chunk;
+	uint32_t seglen;
+	int i, n = 0;
+
+	for (i = 0; (i < zbuf->nsegs) && len; i++) {
+		seg = &zbuf->seg[i];
+		if (off >= seg->len) {
+			off -= seg->len;
+			continue;
+		}
+		addr = seg->uaddr + off;
+		seglen = min(seg->len - off, len);
+		off = 0;
+		len -= seglen;
+		while (seglen) {
+			if (n == nents)
+				return -E2BIG;
+			poff = addr & ~PAGE_MASK;
+			chunk = min_t(uint32_t, PAGE_SIZE - poff, seglen);
+			sg_set_page(&sg[n++], seg->pin->pages[
+				(addr - seg->pin->start) >> PAGE_SHIFT],
+				chunk, poff);
+			addr += chunk;
+			seglen -= chunk;
+		}
+	}
+	if ((n == 0) || len)
+		return -EINVAL;
+	sg_mark_end(&sg[n - 1]);
+	return n;
+}
+
+static bool qcedev_zc_check_bufs(struct buf_info *bufs, int entries,
+							uint32_t align)
+{
+	int i;
+
+	for (i = 0; i < entries; i++) {
+		if (bufs[i].len == 0)
+			continue;
+		if (bufs[i].vaddr == NULL)
+			return false;
+		if (((uintptr_t)bufs[i].vaddr | bufs[i].len) & (align - 1))
+			return false;
+	}
+	return true;
+}
+
+/* Copy bytes [off, off + len) of a user buffer list into k_dst */
+static int qcedev_copy_from_user_bufs(struct buf_info *bufs, int entries,
+		uint32_t off, uint32_t len, uint8_t *k_dst)
+{
+	uint32_t n;
+	int i;
+
+	for (i = 0; (i < entries) && len; i++) {
+		if (off >= bufs[i].len) {
+			off -= bufs[i].len;
+			continue;
+		}
+		n = min(bufs[i].len - off, len);
+		if (copy_from_user(k_dst,
+				(void __user *)(bufs[i].vaddr + off), n))
+			return -EFAULT;
+		k_dst += n;
+		len -= n;
+		off = 0;
+	}
+	return 0;
+}
+
+static bool qcedev_zc_supported(struct qcedev_control *podev)
+{
+	/* CE without BAM or with aligned_only expects lowmem, linear data */
+	return podev->ce_support.bam && !podev->ce_support.aligned_only;
+}
+
 static int qcedev_open(struct inode *inode, struct file *file)
 {
 	struct qcedev_handle *handle;
@@ -202,6 +621,7 @@ static int qcedev_open(struct inode *inode, struct file *file)
 	}
 
 	handle->cntl = podev;
+	mutex_init(&handle->pin_cache_lock);
 	file->private_data = handle;
 	if (podev->platform_support.bus_scale_table != NULL)
 		qcedev_ce_high_bw_req(podev, true);
@@ -219,6 +639,7 @@ static int qcedev_release(struct inode *inode, struct file *file)
 		pr_err("%s: invalid handle %p\n",
 					__func__, podev);
 	}
+	qcedev_pin_cache_destroy(handle);
 	kzfree(handle);
 	file->private_data = NULL;
 	if (podev != NULL && podev->platform_support.bus_scale_table != NULL)
@@ -581,6 +1002,103 @@ static int qcedev_sha_init(struct qcedev_async_req *areq,
 }
 
 
+static bool qcedev_sha_use_zc(struct qcedev_control *podev,
+				struct qcedev_sha_op_req *sreq)
+{
+	if (!qcedev_zc_supported(podev))
+		return false;
+	if (sreq->data_len < QCEDEV_ZC_MIN_LEN)
+		return false;
+	return qcedev_zc_check_bufs(sreq->data, sreq->entries, 1);
+}
+
+/*
+ * Hash the trailing block of the previous update followed by the user data
+ * straight from the pinned user pages. Only the new trailing block is
+ * copied from user space.
+ */
+static int qcedev_sha_update_zc(struct qcedev_async_req *qcedev_areq,
+				struct qcedev_handle *handle, uint32_t total)
+{
+	struct qcedev_sha_op_req *sreq = &qcedev_areq->sha_op_req;
+	struct qcedev_zc_req *zreq;
+	uint8_t k_tail[CE_SHA_BLOCK_SIZE];
+	uint8_t *k_buf_src = NULL;
+	uint8_t *k_align_src = NULL;
+	uint32_t t_buf = handle->sha_ctxt.trailing_buf_len;
+	uint32_t sha_pad_len;
+	uint32_t trailing_buf_len;
+	uint32_t hash_len;
+	int first = 0;
+	int nents;
+	int err;
+
+	sha_pad_len = ALIGN(total, CE_SHA_BLOCK_SIZE) - total;
+	trailing_buf_len =  CE_SHA_BLOCK_SIZE - sha_pad_len;
+	hash_len = sreq->data_len - trailing_buf_len;
+
+	err = qcedev_copy_from_user_bufs(sreq->data, sreq->entries, hash_len,
+					trailing_buf_len, k_tail);
+	if (err)
+		return err;
+
+	zreq = kzalloc(sizeof(struct qcedev_zc_req), GFP_KERNEL);
+	if (zreq == NULL) {
+		pr_err("%s: Can't Allocate memory: zreq\n", __func__);
+		return -ENOMEM;
+	}
+	sg_init_table(zreq->sg_src, QCEDEV_ZC_MAX_SG);
+
+	/* trailing buffer from previous updates goes first */
+	if (t_buf > 0) {
+		k_buf_src = kmalloc(t_buf + CACHE_LINE_SIZE * 2, GFP_KERNEL);
+		if (k_buf_src == NULL) {
+			pr_err("%s: Can't Allocate memory: k_buf_src\n",
+								__func__);
+			err = -ENOMEM;
+			goto exit;
+		}
+		k_align_src = (uint8_t *)ALIGN(((uintptr_t)k_buf_src),
+							CACHE_LINE_SIZE);
+		memcpy(k_align_src, &handle->sha_ctxt.trailing_buf[0], t_buf);
+		sg_set_buf(&zreq->sg_src[0], k_align_src, t_buf);
+		first = 1;
+	}
+
+	err = qcedev_zc_pin_buf(handle, sreq->data, sreq->entries, false,
+								&zreq->src);
+	if (err)
+		goto exit;
+
+	nents = qcedev_zc_fill_sg(&zreq->src, 0, hash_len,
+			&zreq->sg_src[first], QCEDEV_ZC_MAX_SG - first);
+	if (nents < 0) {
+		err = nents;
+		goto unpin;
+	}
+
+	qcedev_areq->sha_req.sreq.src = zreq->sg_src;
+	qcedev_areq->sha_req.sreq.nbytes = total - trailing_buf_len;
+
+	/*  update sha_ctxt trailing buf content to new trailing buf */
+	memset(&handle->sha_ctxt.trailing_buf[0], 0, 64);
+	memcpy(&handle->sha_ctxt.trailing_buf[0], k_tail, trailing_buf_len);
+	handle->sha_ctxt.trailing_buf_len = trailing_buf_len;
+
+	err = submit_req(qcedev_areq, handle);
+	if (!err)
+		_qcedev_stat.qcedev_zc_sha++;
+
+	handle->sha_ctxt.last_blk = 0;
+	handle->sha_ctxt.first_blk = 0;
+unpin:
+	qcedev_zc_unpin_buf(handle, &zreq->src, false);
+exit:
+	kzfree(k_buf_src);
+	kfree(zreq);
+	return err;
+}
+
 static int qcedev_sha_update_max_xfer(struct qcedev_async_req *qcedev_areq,
 				struct qcedev_handle *handle,
 				struct scatterlist *sg_src)
@@ -631,6 +1149,8 @@ static int qcedev_sha_update_max_xfer(struct qcedev_async_req *qcedev_areq,
 		return 0;
 	}
 
+	if (qcedev_sha_use_zc(handle->cntl, &qcedev_areq->sha_op_req))
+		return qcedev_sha_update_zc(qcedev_areq, handle, total);
 
 	k_buf_src = kmalloc(total + CACHE_LINE_SIZE * 2,
 				GFP_KERNEL);
@@ -1206,6 +1726,99 @@ static int qcedev_vbuf_ablk_cipher_max_xfer(struct qcedev_async_req *areq,
 	return err;
 };
 
+static bool qcedev_cipher_use_zc(struct qcedev_control *podev,
+				struct qcedev_cipher_op_req *creq)
+{
+	uint32_t align = dma_get_cache_alignment();
+
+	if (!qcedev_zc_supported(podev))
+		return false;
+	if (creq->byteoffset || (creq->data_len < QCEDEV_ZC_MIN_LEN) ||
+			(creq->data_len > QCEDEV_ZC_MAX_LEN))
+		return false;
+	/* output must not share cache lines with unrelated user data */
+	return qcedev_zc_check_bufs(creq->vbuf.src, creq->entries, align) &&
+		qcedev_zc_check_bufs(creq->vbuf.dst, creq->entries, align);
+}
+
+/*
+ * Run the cipher request on the pinned user pages, QCE_MAX_OPER_DATA
+ * bytes at a time. The IV returned by each operation chains into the
+ * next one, as for the bounce buffer path.
+ */
+static int qcedev_vbuf_ablk_cipher_zc(struct qcedev_async_req *areq,
+						struct qcedev_handle *handle)
+{
+	struct qcedev_cipher_op_req *creq = &areq->cipher_op_req;
+	struct qcedev_zc_req *zreq;
+	uint32_t data_len = creq->data_len;
+	uint32_t off, len;
+	bool in_place;
+	int nents;
+	int err;
+
+	zreq = kzalloc(sizeof(struct qcedev_zc_req), GFP_KERNEL);
+	if (zreq == NULL) {
+		pr_err("%s: Can't Allocate memory: zreq\n", __func__);
+		return -ENOMEM;
+	}
+
+	in_place = !memcmp(creq->vbuf.src, creq->vbuf.dst,
+				creq->entries * sizeof(struct buf_info));
+	if (!in_place) {
+		err = qcedev_zc_pin_buf(handle, creq->vbuf.src, creq->entries,
+							false, &zreq->src);
+		if (err)
+			goto exit;
+	}
+	err = qcedev_zc_pin_buf(handle, creq->vbuf.dst, creq->entries, true,
+								&zreq->dst);
+	if (err)
+		goto unpin_src;
+
+	for (off = 0; off < data_len; off += len) {
+		len = min_t(uint32_t, data_len - off, QCE_MAX_OPER_DATA);
+
+		sg_init_table(zreq->sg_dst, QCEDEV_ZC_MAX_SG);
+		nents = qcedev_zc_fill_sg(&zreq->dst, off, len, zreq->sg_dst,
+							QCEDEV_ZC_MAX_SG);
+		if (nents < 0) {
+			err = nents;
+			break;
+		}
+		if (in_place) {
+			areq->cipher_req.creq.src = zreq->sg_dst;
+		} else {
+			sg_init_table(zreq->sg_src, QCEDEV_ZC_MAX_SG);
+			nents = qcedev_zc_fill_sg(&zreq->src, off, len,
+					zreq->sg_src, QCEDEV_ZC_MAX_SG);
+			if (nents < 0) {
+				err = nents;
+				break;
+			}
+			areq->cipher_req.creq.src = zreq->sg_src;
+		}
+		areq->cipher_req.creq.dst = zreq->sg_dst;
+		areq->cipher_req.creq.nbytes = len;
+		areq->cipher_req.creq.info = creq->iv;
+		creq->data_len = len;
+
+		err = submit_req(areq, handle);
+		if (err)
+			break;
+	}
+	creq->data_len = data_len;
+	if (!err)
+		_qcedev_stat.qcedev_zc_cipher++;
+
+	qcedev_zc_unpin_buf(handle, &zreq->dst, true);
+unpin_src:
+	qcedev_zc_unpin_buf(handle, &zreq->src, false);
+exit:
+	kfree(zreq);
+	return err;
+}
+
 static int qcedev_vbuf_ablk_cipher(struct qcedev_async_req *areq,
 						struct qcedev_handle *handle)
 {
@@ -1224,6 +1837,9 @@ static int qcedev_vbuf_ablk_cipher(struct qcedev_async_req *areq,
 	struct qcedev_cipher_op_req *saved_req;
 	struct	qcedev_cipher_op_req *creq = &areq->cipher_op_req;
 
+	if (qcedev_cipher_use_zc(handle->cntl, creq))
+		return qcedev_vbuf_ablk_cipher_zc(areq, handle);
+
 	total = 0;
 
 	if (areq->cipher_op_req.mode == QCEDEV_AES_MODE_CTR)
@@ -2099,6 +2715,18 @@ static int _disp_stats(int id)
 	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
 			"   Encryption operation fail          : %d\n",
 					pstat->qcedev_dec_fail);
+	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   Zero-copy cipher operations        : %d\n",
+					pstat->qcedev_zc_cipher);
+	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   Zero-copy hash operations          : %d\n",
+					pstat->qcedev_zc_sha);
+	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   Pinned user region cache hit       : %d\n",
+					pstat->qcedev_pin_hit);
+	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   Pinned user region cache miss      : %d\n",
+					pstat->qcedev_pin_miss);
 
 	return len;
 }
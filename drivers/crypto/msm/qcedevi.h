@@ -17,6 +17,8 @@
 
 #include <linux/interrupt.h>
 #include <linux/miscdevice.h>
+#include <linux/mmu_notifier.h>
+#include <linux/mutex.h>
 #include <crypto/hash.h>
 #include <linux/platform_data/qcom_crypto_device.h>
 #include <linux/fips_status.h>
@@ -25,6 +27,9 @@
 #define CACHE_LINE_SIZE 32
 #define CE_SHA_BLOCK_SIZE SHA256_BLOCK_SIZE
 
+/* Number of pinned user regions kept per handle for reuse */
+#define QCEDEV_PIN_CACHE_SIZE	4
+
 /* FIPS global status variable */
 extern enum fips_status g_fips140_status;
 
@@ -114,11 +119,43 @@ struct qcedev_control {
 	struct tasklet_struct done_tasklet;
 };
 
+/*
+ * User pages pinned for a zero-copy request. An entry is either held in
+ * the handle's pin cache (cached set, protected by the cache lock) or
+ * private to the request that pinned it and released once it is done.
+ */
+struct qcedev_pin_entry {
+	unsigned long		start;		/* page aligned user address */
+	unsigned int		nr_pages;
+	bool			write;
+	bool			cached;
+	unsigned int		users;
+	unsigned long		last_use;
+	struct page		**pages;
+};
+
+/*
+ * Recently pinned user regions of the process that owns the handle. The
+ * mmu notifier drops any region whose mapping changes underneath us.
+ */
+struct qcedev_pin_cache {
+	struct mmu_notifier	mn;
+	struct mm_struct	*mm;
+	spinlock_t		lock;
+	unsigned long		invalidate_seq;
+	int			invalidate_count;
+	bool			released;
+	struct qcedev_pin_entry	*entry[QCEDEV_PIN_CACHE_SIZE];
+};
+
 struct qcedev_handle {
 	/* qcedev control handle */
 	struct qcedev_control *cntl;
 	/* qce internal sha context*/
 	struct qcedev_sha_ctxt sha_ctxt;
+	/* pinned user pages for zero-copy requests, set up on first use */
+	struct mutex pin_cache_lock;
+	struct qcedev_pin_cache *pin_cache;
 };
 
 void qcedev_cipher_req_cb(void *cookie, unsigned char *icv,
@@ -28,6 +28,8 @@
 #include <linux/sched.h>
 #include <linux/init.h>
 #include <linux/cache.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/platform_data/qcom_crypto_device.h>
 #include <linux/msm-bus.h>
 #include <linux/qcrypto.h>
@@ -58,6 +60,9 @@
 
 #define QCRYPTO_HIGH_BANDWIDTH_TIMEOUT 1000
 
+/* max requests issued to one engine at a time */
+#define QCRYPTO_MAX_ENGINE_REQ 4
+
 /* are FIPS self tests done ?? */
 static bool is_fips_qcrypto_tests_done;
 
@@ -110,13 +115,23 @@ static struct dentry *_debug_dent;
 static char _debug_read_buf[DEBUG_MAX_RW_BUF];
 static bool _qcrypto_init_assign;
 struct crypto_priv;
+
+/* a request issued to an engine and not yet completed */
+struct qcrypto_req_control {
+	bool in_use;
+	struct crypto_async_request *req; /* active request */
+	struct qcrypto_resp_ctx *arsp;    /* rsp associcated with req */
+	int res;                          /* execution result */
+};
+
 struct crypto_engine {
 	struct list_head elist;
 	void *qce; /* qce handle */
 	struct platform_device *pdev; /* platform device */
-	struct crypto_async_request *req; /* current active request */
-	struct qcrypto_resp_ctx *arsp;    /* rsp associcated with req */
-	int res;                          /* execution result */
+	struct qcrypto_req_control req_control[QCRYPTO_MAX_ENGINE_REQ];
+	int max_req;		/* max requests issued to qce at a time */
+	int req_count;		/* requests issued to qce */
+	bool issue_req;		/* a context is issuing requests to qce */
 	struct crypto_priv *pcp;
 	struct tasklet_struct done_tasklet;
 	uint32_t  bus_scale_handle;
@@ -127,6 +142,9 @@ struct crypto_engine {
 					 */
 	u64 total_req;
 	u64 err_req;
+	ktime_t busy_start;	/* req_count went from 0 to 1 */
+	u64 busy_ns;		/* time with requests issued since stats_start */
+	ktime_t stats_start;	/* start of the utilization window */
 	u32 unit;
 	u32 ce_device;
 	u32 ce_hw_instance;
@@ -278,9 +296,14 @@ struct qcrypto_alg {
 
 #define	QCRYPTO_CCM4309_NONCE_LEN	3
 
+/*
+ * The leading members of qcrypto_cipher_ctx and qcrypto_sha_ctx are
+ * common, the request dispatch code accesses them through either type.
+ */
 struct qcrypto_cipher_ctx {
 	struct list_head rsp_queue;     /* response queue */
 	struct crypto_engine *pengine;  /* fixed engine assigned to this tfm */
+	struct crypto_engine *last_engine; /* engine last used by this tfm */
 	struct crypto_priv *cp;
 	unsigned int flags;
 
@@ -337,6 +360,15 @@ struct qcrypto_cipher_req_ctx {
 
 #define	MSM_QCRYPTO_REQ_QUEUE_LENGTH 50
 
+/*
+ * The authenc template ranks itself at cipher priority * 10 + hash
+ * priority, so a software authenc() built on top of our own ablkcipher
+ * would always win over the 300 of the native AEADs and IPsec would end
+ * up doing the HMAC on the CPU. Rank the native AEADs above any such
+ * combination unless the platform asked for the software AEADs.
+ */
+#define QCRYPTO_AEAD_AUTHENC_PRIORITY	4000
+
 static uint8_t  _std_init_vector_sha1_uint8[] =   {
 	0x67, 0x45, 0x23, 0x01, 0xEF, 0xCD, 0xAB, 0x89,
 	0x98, 0xBA, 0xDC, 0xFE, 0x10, 0x32, 0x54, 0x76,
@@ -354,6 +386,7 @@ static uint8_t _std_init_vector_sha256_uint8[] = {
 struct qcrypto_sha_ctx {
 	struct list_head rsp_queue;     /* response queue */
 	struct crypto_engine *pengine;  /* fixed engine assigned to this tfm */
+	struct crypto_engine *last_engine; /* engine last used by this tfm */
 	struct crypto_priv *cp;
 	unsigned int flags;
 	enum qce_hash_alg_enum  alg;
@@ -551,11 +584,11 @@ static void qcrypto_bw_reaper_work(struct work_struct *work)
 		(active_seq == pengine->last_active_seq)) {
 
 		/* check if engine is stuck */
-		if (pengine->req) {
+		if (pengine->req_count) {
 			if (pengine->check_flag)
 				dev_warn(&pengine->pdev->dev,
-				"The engine appears to be stuck seq %d req %p.\n",
-				active_seq, pengine->req);
+				"The engine appears to be stuck seq %d reqs %d.\n",
+				active_seq, pengine->req_count);
 			pengine->check_flag = false;
 			goto ret;
 		}
@@ -697,6 +730,7 @@ static int _qcrypto_cipher_cra_init(struct crypto_tfm *tfm)
 			return -ENODEV;
 	} else
 		ctx->pengine = NULL;
+	ctx->last_engine = NULL;
 	INIT_LIST_HEAD(&ctx->rsp_queue);
 	ctx->auth_alg = QCE_HASH_LAST;
 	return 0;
@@ -728,6 +762,7 @@ static int _qcrypto_ahash_cra_init(struct crypto_tfm *tfm)
 			return -ENODEV;
 	} else
 		sha_ctx->pengine = NULL;
+	sha_ctx->last_engine = NULL;
 	INIT_LIST_HEAD(&sha_ctx->rsp_queue);
 	return 0;
 };
@@ -879,6 +914,9 @@ static int _disp_stats(int id)
 	unsigned long flags;
 	struct crypto_priv *cp = &qcrypto_dev;
 	struct crypto_engine *pe;
+	ktime_t now = ktime_get();
+	u64 busy_ns;
+	u64 elapsed_ns;
 
 	pstat = &_qcrypto_stat;
 	len = scnprintf(_debug_read_buf, DEBUG_MAX_RW_BUF - 1,
@@ -1018,6 +1056,31 @@ static int _disp_stats(int id)
 			pe->unit,
 			pe->err_req
 		);
+		busy_ns = pe->busy_ns;
+		if (pe->req_count)
+			busy_ns += ktime_to_ns(ktime_sub(now, pe->busy_start));
+		elapsed_ns = ktime_to_ns(ktime_sub(now, pe->stats_start));
+		len += scnprintf(
+			_debug_read_buf + len,
+			DEBUG_MAX_RW_BUF - len - 1,
+			"   Engine %4d Req In Flight           : %d\n",
+			pe->unit,
+			pe->req_count
+		);
+		len += scnprintf(
+			_debug_read_buf + len,
+			DEBUG_MAX_RW_BUF - len - 1,
+			"   Engine %4d Req Queued              : %u\n",
+			pe->unit,
+			pe->req_queue.qlen
+		);
+		len += scnprintf(
+			_debug_read_buf + len,
+			DEBUG_MAX_RW_BUF - len - 1,
+			"   Engine %4d Busy (percent)          : %llu\n",
+			pe->unit,
+			elapsed_ns ? div64_u64(busy_ns * 100, elapsed_ns) : 0
+		);
 	}
 	spin_unlock_irqrestore(&cp->lock, flags);
 	return len;
@@ -1286,34 +1349,104 @@ again:
 	}
 }
 
+/* called with cp->lock held */
+static struct qcrypto_req_control *qcrypto_alloc_req_control(
+						struct crypto_engine *pengine)
+{
+	int i;
+	struct qcrypto_req_control *pqcrypto_req_control;
+
+	for (i = 0; i < pengine->max_req; i++) {
+		pqcrypto_req_control = &pengine->req_control[i];
+		if (!pqcrypto_req_control->in_use) {
+			pqcrypto_req_control->in_use = true;
+			if (pengine->req_count++ == 0)
+				pengine->busy_start = ktime_get();
+			return pqcrypto_req_control;
+		}
+	}
+	return NULL;
+}
+
+/* called with cp->lock held */
+static void qcrypto_free_req_control(struct crypto_engine *pengine,
+		struct qcrypto_req_control *pqcrypto_req_control)
+{
+	pqcrypto_req_control->req = NULL;
+	pqcrypto_req_control->arsp = NULL;
+	pqcrypto_req_control->in_use = false;
+	if (--pengine->req_count == 0)
+		pengine->busy_ns += ktime_to_ns(ktime_sub(ktime_get(),
+						pengine->busy_start));
+}
+
+/* called with cp->lock held */
+static struct qcrypto_req_control *find_req_control_for_areq(
+					struct crypto_engine *pengine,
+					struct crypto_async_request *areq)
+{
+	int i;
+	struct qcrypto_req_control *pqcrypto_req_control;
+
+	for (i = 0; i < pengine->max_req; i++) {
+		pqcrypto_req_control = &pengine->req_control[i];
+		if (pqcrypto_req_control->in_use &&
+				pqcrypto_req_control->req == areq)
+			return pqcrypto_req_control;
+	}
+	return NULL;
+}
+
+/* record the result of an issued request, and defer its completion */
+static void qcrypto_req_finished(struct crypto_engine *pengine,
+				struct crypto_async_request *areq, int res)
+{
+	struct crypto_priv *cp = pengine->pcp;
+	struct qcrypto_req_control *pqcrypto_req_control;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cp->lock, flags);
+	pqcrypto_req_control = find_req_control_for_areq(pengine, areq);
+	if (pqcrypto_req_control)
+		pqcrypto_req_control->res = res;
+	else
+		dev_err(&pengine->pdev->dev,
+			"qcrypto: completion for unknown request %p\n", areq);
+	spin_unlock_irqrestore(&cp->lock, flags);
+
+	tasklet_schedule(&pengine->done_tasklet);
+}
+
 static void req_done(unsigned long data)
 {
 	struct crypto_async_request *areq;
 	struct crypto_engine *pengine = (struct crypto_engine *)data;
 	struct crypto_priv *cp;
 	unsigned long flags;
-	struct qcrypto_resp_ctx *arsp;
-	int res;
-	u32 type = 0;
-	void *tfm_ctx = NULL;
+	struct qcrypto_req_control *pqcrypto_req_control;
+	u32 type[QCRYPTO_MAX_ENGINE_REQ];
+	void *tfm_ctx[QCRYPTO_MAX_ENGINE_REQ];
+	int i;
+	int num_done = 0;
 
 	cp = pengine->pcp;
 	spin_lock_irqsave(&cp->lock, flags);
-	areq = pengine->req;
-
-	arsp = pengine->arsp;
-	res = pengine->res;
-	pengine->req = NULL;
-	pengine->arsp = NULL;
-	if (areq) {
-		type = crypto_tfm_alg_type(areq->tfm);
-		tfm_ctx = crypto_tfm_ctx(areq->tfm);
-		arsp->res = res;
+	for (i = 0; i < pengine->max_req; i++) {
+		pqcrypto_req_control = &pengine->req_control[i];
+		if (!pqcrypto_req_control->in_use ||
+				pqcrypto_req_control->res == -EINPROGRESS)
+			continue;
+		areq = pqcrypto_req_control->req;
+		type[num_done] = crypto_tfm_alg_type(areq->tfm);
+		tfm_ctx[num_done] = crypto_tfm_ctx(areq->tfm);
+		num_done++;
+		pqcrypto_req_control->arsp->res = pqcrypto_req_control->res;
+		qcrypto_free_req_control(pengine, pqcrypto_req_control);
 	}
 	spin_unlock_irqrestore(&cp->lock, flags);
 	_start_qcrypto_process(cp, pengine);
-	if (areq)
-		_qcrypto_tfm_complete(cp, type, tfm_ctx);
+	for (i = 0; i < num_done; i++)
+		_qcrypto_tfm_complete(cp, type[i], tfm_ctx[i]);
 }
 
 static void _qce_ahash_complete(void *cookie, unsigned char *digest,
@@ -1328,6 +1461,7 @@ static void _qce_ahash_complete(void *cookie, unsigned char *digest,
 	uint32_t diglen = crypto_ahash_digestsize(ahash);
 	uint32_t *auth32 = (uint32_t *)authdata;
 	struct crypto_engine *pengine;
+	int res;
 
 	pstat = &_qcrypto_stat;
 
@@ -1353,10 +1487,10 @@ static void _qce_ahash_complete(void *cookie, unsigned char *digest,
 	rctx->first_blk = 0;
 
 	if (ret) {
-		pengine->res = -ENXIO;
+		res = -ENXIO;
 		pstat->ahash_op_fail++;
 	} else {
-		pengine->res = 0;
+		res = 0;
 		pstat->ahash_op_success++;
 	}
 	if (cp->ce_support.aligned_only)  {
@@ -1364,7 +1498,7 @@ static void _qce_ahash_complete(void *cookie, unsigned char *digest,
 		kfree(rctx->data);
 	}
 
-	tasklet_schedule(&pengine->done_tasklet);
+	qcrypto_req_finished(pengine, &areq->base, res);
 };
 
 static void _qce_ablk_cipher_complete(void *cookie, unsigned char *icb,
@@ -1377,6 +1511,7 @@ static void _qce_ablk_cipher_complete(void *cookie, unsigned char *icb,
 	struct crypto_stat *pstat;
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct crypto_engine *pengine;
+	int res;
 
 	pstat = &_qcrypto_stat;
 	rctx = ablkcipher_request_ctx(areq);
@@ -1389,10 +1524,10 @@ static void _qce_ablk_cipher_complete(void *cookie, unsigned char *icb,
 		memcpy(ctx->iv, iv, crypto_ablkcipher_ivsize(ablk));
 
 	if (ret) {
-		pengine->res = -ENXIO;
+		res = -ENXIO;
 		pstat->ablk_cipher_op_fail++;
 	} else {
-		pengine->res = 0;
+		res = 0;
 		pstat->ablk_cipher_op_success++;
 	}
 
@@ -1414,7 +1549,7 @@ static void _qce_ablk_cipher_complete(void *cookie, unsigned char *icb,
 		kzfree(rctx->data);
 	}
 
-	tasklet_schedule(&pengine->done_tasklet);
+	qcrypto_req_finished(pengine, &areq->base, res);
 };
 
 
@@ -1527,9 +1662,7 @@ static void _qce_aead_complete(void *cookie, unsigned char *icv,
 	else
 		pstat->aead_op_success++;
 
-	pengine->res = ret;
-
-	tasklet_schedule(&pengine->done_tasklet);
+	qcrypto_req_finished(pengine, &areq->base, ret);
 }
 
 static int aead_ccm_set_msg_len(u8 *block, unsigned int msglen, int csize)
@@ -1964,12 +2097,49 @@ static struct crypto_engine *_qcrypto_static_assign_engine(
 	return pengine;
 }
 
+static struct crypto_async_request *_qcrypto_peek_request(
+					struct crypto_queue *queue)
+{
+	if (!queue->qlen)
+		return NULL;
+	return list_first_entry(&queue->list, struct crypto_async_request,
+					list);
+}
+
+/*
+ * Cipher and hash requests may be issued to an engine that is still
+ * processing earlier ones, up to max_req of them. Aead requests need
+ * the engine to themselves. Called with cp->lock held.
+ */
+static bool _qcrypto_can_issue(struct crypto_engine *pengine,
+				struct crypto_async_request *async_req)
+{
+	int i;
+	struct qcrypto_req_control *pqcrypto_req_control;
+
+	if (pengine->req_count == 0)
+		return true;
+	if (pengine->req_count >= pengine->max_req)
+		return false;
+	if (crypto_tfm_alg_type(async_req->tfm) == CRYPTO_ALG_TYPE_AEAD)
+		return false;
+	for (i = 0; i < pengine->max_req; i++) {
+		pqcrypto_req_control = &pengine->req_control[i];
+		if (pqcrypto_req_control->in_use &&
+			crypto_tfm_alg_type(pqcrypto_req_control->req->tfm) ==
+						CRYPTO_ALG_TYPE_AEAD)
+			return false;
+	}
+	return true;
+}
+
 static int _start_qcrypto_process(struct crypto_priv *cp,
 				struct crypto_engine *pengine)
 {
 	struct crypto_async_request *async_req = NULL;
 	struct crypto_async_request *backlog_eng = NULL;
 	struct crypto_async_request *backlog_cp = NULL;
+	struct crypto_queue *queue;
 	unsigned long flags;
 	u32 type;
 	int ret = 0;
@@ -1981,38 +2151,46 @@ static int _start_qcrypto_process(struct crypto_priv *cp,
 	struct ahash_request *ahash_req;
 	struct aead_request *aead_req;
 	struct qcrypto_resp_ctx *arsp;
+	struct qcrypto_req_control *pqcrypto_req_control;
+	bool issuing = false;
 
 	pstat = &_qcrypto_stat;
 
 again:
 	spin_lock_irqsave(&cp->lock, flags);
-	if (pengine->req) {
+	/* only one context issues requests to the engine at a time */
+	if (!issuing && pengine->issue_req) {
 		spin_unlock_irqrestore(&cp->lock, flags);
 		return 0;
 	}
 
 	backlog_eng = crypto_get_backlog(&pengine->req_queue);
+	backlog_cp = NULL;
 
 	/* make sure it is in high bandwidth state */
-	if (pengine->bw_state != BUS_HAS_BANDWIDTH) {
-		spin_unlock_irqrestore(&cp->lock, flags);
-		return 0;
-	}
+	if (pengine->bw_state != BUS_HAS_BANDWIDTH)
+		goto out;
 
 	/* try to get request from request queue of the engine first */
-	async_req = crypto_dequeue_request(&pengine->req_queue);
+	queue = &pengine->req_queue;
+	async_req = _qcrypto_peek_request(queue);
 	if (!async_req) {
 		/*
 		 * if no request from the engine,
 		 * try to  get from request queue of driver
 		 */
-		backlog_cp = crypto_get_backlog(&cp->req_queue);
-		async_req = crypto_dequeue_request(&cp->req_queue);
-		if (!async_req) {
-			spin_unlock_irqrestore(&cp->lock, flags);
-			return 0;
-		}
+		queue = &cp->req_queue;
+		async_req = _qcrypto_peek_request(queue);
+		if (!async_req)
+			goto out;
+		backlog_cp = crypto_get_backlog(queue);
 	}
+	if (!_qcrypto_can_issue(pengine, async_req))
+		goto out;
+	pqcrypto_req_control = qcrypto_alloc_req_control(pengine);
+	if (!pqcrypto_req_control)
+		goto out;
+	async_req = crypto_dequeue_request(queue);
 
 	/* add associated rsp entry to tfm response queue */
 	type = crypto_tfm_alg_type(async_req->tfm);
@@ -2051,12 +2229,16 @@ again:
 		break;
 	}
 
+	((struct qcrypto_sha_ctx *)tfm_ctx)->last_engine = pengine;
 	arsp->res = -EINPROGRESS;
 	arsp->async_req = async_req;
-	pengine->req = async_req;
-	pengine->arsp = arsp;
+	pqcrypto_req_control->req = async_req;
+	pqcrypto_req_control->arsp = arsp;
+	pqcrypto_req_control->res = -EINPROGRESS;
 	pengine->active_seq++;
 	pengine->check_flag = true;
+	pengine->issue_req = true;
+	issuing = true;
 
 	spin_unlock_irqrestore(&cp->lock, flags);
 	if (backlog_eng)
@@ -2081,8 +2263,7 @@ again:
 		arsp->res = ret;
 		pengine->err_req++;
 		spin_lock_irqsave(&cp->lock, flags);
-		pengine->req = NULL;
-		pengine->arsp = NULL;
+		qcrypto_free_req_control(pengine, pqcrypto_req_control);
 		spin_unlock_irqrestore(&cp->lock, flags);
 
 		if (type == CRYPTO_ALG_TYPE_ABLKCIPHER)
@@ -2094,20 +2275,44 @@ again:
 				pstat->aead_op_fail++;
 
 		_qcrypto_tfm_complete(cp, type, tfm_ctx);
-		goto again;
 	};
-	return ret;
+	/* keep the engine busy while it has room for more requests */
+	goto again;
+out:
+	pengine->issue_req = false;
+	spin_unlock_irqrestore(&cp->lock, flags);
+	return 0;
 }
 
-static struct crypto_engine *_avail_eng(struct crypto_priv *cp)
+/*
+ * Pick the least loaded engine with room for another request. Among
+ * equally loaded engines the one that last served the tfm is preferred,
+ * so a busy tfm does not bounce between engines. Called with cp->lock
+ * held.
+ */
+static struct crypto_engine *_avail_eng(struct crypto_priv *cp,
+				struct crypto_async_request *req)
 {
 	struct crypto_engine *pe = NULL;
+	struct crypto_engine *best = NULL;
+	struct crypto_engine *last_engine;
+	int load;
+	int best_load = INT_MAX;
+
+	last_engine = ((struct qcrypto_sha_ctx *)
+			crypto_tfm_ctx(req->tfm))->last_engine;
 
 	list_for_each_entry(pe, &cp->engine_list, elist) {
-		if (pe->req == NULL)
-			return pe;
+		if (pe->req_count >= pe->max_req)
+			continue;
+		load = pe->req_count + pe->req_queue.qlen;
+		if (load < best_load ||
+				(load == best_load && pe == last_engine)) {
+			best = pe;
+			best_load = load;
+		}
 	}
-	return NULL;
+	return best;
 }
 
 static int _qcrypto_queue_req(struct crypto_priv *cp,
@@ -2123,7 +2328,7 @@ static int _qcrypto_queue_req(struct crypto_priv *cp,
 		ret = crypto_enqueue_request(&pengine->req_queue, req);
 	} else {
 		ret = crypto_enqueue_request(&cp->req_queue, req);
-		pengine = _avail_eng(cp);
+		pengine = _avail_eng(cp, req);
 	}
 	if (pengine) {
 		switch (pengine->bw_state) {
@@ -4499,7 +4704,9 @@ static int  _qcrypto_probe(struct platform_device *pdev)
 	pengine->qce = handle;
 	pengine->pcp = cp;
 	pengine->pdev = pdev;
-	pengine->req = NULL;
+	pengine->req_count = 0;
+	pengine->issue_req = false;
+	pengine->stats_start = ktime_get();
 	pengine->signature = 0xdeadbeef;
 
 	init_timer(&(pengine->bw_reaper_timer));
@@ -4526,6 +4733,8 @@ static int  _qcrypto_probe(struct platform_device *pdev)
 
 	qce_hw_support(pengine->qce, &cp->ce_support);
 	pengine->ce_hw_instance = cp->ce_support.ce_hw_instance;
+	pengine->max_req = clamp_t(int, cp->ce_support.max_request, 1,
+					QCRYPTO_MAX_ENGINE_REQ);
 	if (cp->ce_support.bam)	 {
 		cp->platform_support.ce_shared = cp->ce_support.is_shared;
 		cp->platform_support.shared_ce_resource = 0;
@@ -4705,6 +4914,9 @@ static int  _qcrypto_probe(struct platform_device *pdev)
 					kfree(q_alg);
 					goto err;
 				}
+			} else {
+				q_alg->cipher_alg.cra_priority =
+					QCRYPTO_AEAD_AUTHENC_PRIORITY;
 			}
 			rc = crypto_register_alg(&q_alg->cipher_alg);
 			if (rc) {
@@ -4743,6 +4955,9 @@ static int  _qcrypto_probe(struct platform_device *pdev)
 					kfree(q_alg);
 					goto err;
 				}
+			} else {
+				q_alg->cipher_alg.cra_priority =
+					QCRYPTO_AEAD_AUTHENC_PRIORITY;
 			}
 			rc = crypto_register_alg(&q_alg->cipher_alg);
 			if (rc) {
@@ -4906,7 +5121,7 @@ static int _qcrypto_engine_in_use(struct crypto_engine *pengine)
 {
 	struct crypto_priv *cp = pengine->pcp;
 
-	if (pengine->req || pengine->req_queue.qlen || cp->req_queue.qlen)
+	if (pengine->req_count || pengine->req_queue.qlen || cp->req_queue.qlen)
 		return 1;
 	return 0;
 }
@@ -5067,6 +5282,10 @@ static ssize_t _debug_stats_write(struct file *file, const char __user *buf,
 	list_for_each_entry(pe, &cp->engine_list, elist) {
 		pe->total_req = 0;
 		pe->err_req = 0;
+		pe->busy_ns = 0;
+		pe->stats_start = ktime_get();
+		if (pe->req_count)
+			pe->busy_start = pe->stats_start;
 	}
 	spin_unlock_irqrestore(&cp->lock, flags);
 	return count;
@@ -0,0 +1,569 @@
+/* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Qualcomm crypto engine benchmark.
+ *
+ * Drives an ablkcipher, aead or ahash algorithm with a configurable number
+ * of requests in flight, for every combination of the requested sizes and
+ * queue depths, and reports throughput, per request latency percentiles
+ * and CPU usage. The algorithm is looked up by name, so the same run can
+ * be done against the qcrypto drivers ("qcom-cbc(aes)") and the software
+ * implementations ("cbc(aes)") for comparison.
+ *
+ * Like tcrypt, all the work is done at load time and the module then
+ * refuses to stay loaded, e.g.
+ *
+ *   insmod qcrypto_bench.ko type=cipher alg="qcom-cbc(aes)" depth=1,4,16
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/err.h>
+#include <linux/string.h>
+#include <linux/random.h>
+#include <linux/scatterlist.h>
+#include <linux/completion.h>
+#include <linux/spinlock.h>
+#include <linux/atomic.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sort.h>
+#include <linux/kernel_stat.h>
+#include <linux/cpumask.h>
+#include <linux/rtnetlink.h>
+#include <linux/crypto.h>
+#include <crypto/aead.h>
+#include <crypto/hash.h>
+#include <crypto/authenc.h>
+
+#define BENCH_MAX_PARAMS	16
+#define BENCH_MAX_DEPTH		64
+#define BENCH_MAX_SIZE		(64 * 1024)
+#define BENCH_MAX_KEY		64
+#define BENCH_MAX_IV		32
+#define BENCH_MAX_DIGEST	64
+#define BENCH_MAX_SAMPLES	(64 * 1024)
+
+enum bench_type {
+	BENCH_CIPHER = 0,
+	BENCH_AEAD,
+	BENCH_HASH,
+};
+
+static char *type = "cipher";
+module_param(type, charp, 0);
+MODULE_PARM_DESC(type, "Algorithm type: cipher, aead or hash");
+
+static char *alg = "qcom-cbc(aes)";
+module_param(alg, charp, 0);
+MODULE_PARM_DESC(alg, "Algorithm or driver name to benchmark");
+
+static unsigned int sizes[BENCH_MAX_PARAMS] = {
+	64, 256, 1024, 4096, 16384, 65536 };
+static int num_sizes = 6;
+module_param_array(sizes, uint, &num_sizes, 0);
+MODULE_PARM_DESC(sizes, "Request sizes in bytes");
+
+static unsigned int depth[BENCH_MAX_PARAMS] = { 1, 4, 16 };
+static int num_depth = 3;
+module_param_array(depth, uint, &num_depth, 0);
+MODULE_PARM_DESC(depth, "Number of requests kept in flight");
+
+static unsigned int sec = 1;
+module_param(sec, uint, 0);
+MODULE_PARM_DESC(sec, "Length in seconds of each test");
+
+static unsigned int klen = 16;
+module_param(klen, uint, 0);
+MODULE_PARM_DESC(klen, "Cipher key length, 0 for unkeyed hashes");
+
+static unsigned int auth_klen = 32;
+module_param(auth_klen, uint, 0);
+MODULE_PARM_DESC(auth_klen, "Authentication key length of authenc()");
+
+static unsigned int assoclen = 16;
+module_param(assoclen, uint, 0);
+MODULE_PARM_DESC(assoclen, "AEAD associated data length");
+
+static unsigned int authsize = 16;
+module_param(authsize, uint, 0);
+MODULE_PARM_DESC(authsize, "AEAD authentication tag length");
+
+static bool decrypt;
+module_param(decrypt, bool, 0);
+MODULE_PARM_DESC(decrypt, "Measure decryption instead of encryption");
+
+struct bench_ctx {
+	enum bench_type type;
+	union {
+		struct crypto_ablkcipher *ablk;
+		struct crypto_aead *aead;
+		struct crypto_ahash *ahash;
+	} tfm;
+	unsigned int size;
+	u64 deadline_ns;
+
+	spinlock_t lock;
+	bool stop;
+	int err;
+	u64 ops;
+	u32 *lat;
+	unsigned int nlat;
+
+	atomic_t outstanding;
+	struct completion drained;
+};
+
+struct bench_req {
+	struct bench_ctx *ctx;
+	union {
+		struct ablkcipher_request *ablk;
+		struct aead_request *aead;
+		struct ahash_request *ahash;
+	} req;
+	u8 *buf;
+	struct scatterlist sg;
+	struct scatterlist assoc_sg;
+	u8 iv[BENCH_MAX_IV];
+	u8 result[BENCH_MAX_DIGEST];
+	ktime_t start;
+};
+
+struct bench_cpu_snap {
+	u64 busy;
+};
+
+static void bench_cb(struct crypto_async_request *areq, int err);
+
+static void bench_cpu_snapshot(struct bench_cpu_snap *snap)
+{
+	int cpu;
+	u64 *stat;
+
+	snap->busy = 0;
+	for_each_possible_cpu(cpu) {
+		stat = kcpustat_cpu(cpu).cpustat;
+		snap->busy += stat[CPUTIME_USER] + stat[CPUTIME_NICE] +
+			stat[CPUTIME_SYSTEM] + stat[CPUTIME_IRQ] +
+			stat[CPUTIME_SOFTIRQ];
+	}
+}
+
+static int bench_do_op(struct bench_req *breq)
+{
+	struct bench_ctx *ctx = breq->ctx;
+
+	switch (ctx->type) {
+	case BENCH_CIPHER:
+		ablkcipher_request_set_crypt(breq->req.ablk, &breq->sg,
+				&breq->sg, ctx->size, breq->iv);
+		return decrypt ? crypto_ablkcipher_decrypt(breq->req.ablk) :
+				crypto_ablkcipher_encrypt(breq->req.ablk);
+	case BENCH_AEAD:
+		aead_request_set_crypt(breq->req.aead, &breq->sg, &breq->sg,
+				ctx->size, breq->iv);
+		aead_request_set_assoc(breq->req.aead, &breq->assoc_sg,
+				assoclen);
+		return decrypt ? crypto_aead_decrypt(breq->req.aead) :
+				crypto_aead_encrypt(breq->req.aead);
+	case BENCH_HASH:
+	default:
+		ahash_request_set_crypt(breq->req.ahash, &breq->sg,
+				breq->result, ctx->size);
+		return crypto_ahash_digest(breq->req.ahash);
+	}
+}
+
+/* Record a finished request, returns false once the test must stop */
+static bool bench_account(struct bench_req *breq, int err)
+{
+	struct bench_ctx *ctx = breq->ctx;
+	u64 lat = ktime_to_ns(ktime_sub(ktime_get(), breq->start));
+	unsigned long flags;
+	bool more;
+
+	/* random data never authenticates, the work is done all the same */
+	if (err == -EBADMSG && ctx->type == BENCH_AEAD && decrypt)
+		err = 0;
+
+	spin_lock_irqsave(&ctx->lock, flags);
+	if (err) {
+		if (!ctx->err)
+			ctx->err = err;
+		ctx->stop = true;
+	} else {
+		ctx->ops++;
+		if (ctx->nlat < BENCH_MAX_SAMPLES)
+			ctx->lat[ctx->nlat++] = (u32)min_t(u64, lat, U32_MAX);
+	}
+	more = !ctx->stop;
+	spin_unlock_irqrestore(&ctx->lock, flags);
+
+	return more;
+}
+
+/*
+ * Keep one request slot busy until the deadline. Asynchronous completions
+ * come back through bench_cb(), synchronous ones are looped on here.
+ */
+static void bench_issue(struct bench_req *breq)
+{
+	struct bench_ctx *ctx = breq->ctx;
+	int rc;
+
+	for (;;) {
+		breq->start = ktime_get();
+		if (ACCESS_ONCE(ctx->stop) ||
+				ktime_to_ns(breq->start) >= ctx->deadline_ns)
+			break;
+
+		rc = bench_do_op(breq);
+		if (rc == -EINPROGRESS || rc == -EBUSY)
+			return;
+		if (!bench_account(breq, rc))
+			break;
+	}
+
+	if (atomic_dec_and_test(&ctx->outstanding))
+		complete(&ctx->drained);
+}
+
+static void bench_cb(struct crypto_async_request *areq, int err)
+{
+	struct bench_req *breq = areq->data;
+
+	if (err == -EINPROGRESS)
+		return;
+
+	if (bench_account(breq, err)) {
+		bench_issue(breq);
+		return;
+	}
+	if (atomic_dec_and_test(&breq->ctx->outstanding))
+		complete(&breq->ctx->drained);
+}
+
+static int bench_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a;
+	u32 y = *(const u32 *)b;
+
+	return (x > y) - (x < y);
+}
+
+static u32 bench_percentile(struct bench_ctx *ctx, unsigned int pct)
+{
+	unsigned int i;
+
+	if (!ctx->nlat)
+		return 0;
+	i = (ctx->nlat * pct) / 100;
+	if (i >= ctx->nlat)
+		i = ctx->nlat - 1;
+	return ctx->lat[i];
+}
+
+static void bench_run(struct bench_ctx *ctx, struct bench_req *breqs,
+			unsigned int size, unsigned int nreq)
+{
+	struct bench_cpu_snap cpu0, cpu1;
+	ktime_t t0, t1;
+	u64 elapsed_us, bytes, mbps, cpu_us, cpu_pct;
+	unsigned int i;
+
+	ctx->size = size;
+	ctx->stop = false;
+	ctx->err = 0;
+	ctx->ops = 0;
+	ctx->nlat = 0;
+	atomic_set(&ctx->outstanding, nreq);
+	init_completion(&ctx->drained);
+
+	bench_cpu_snapshot(&cpu0);
+	t0 = ktime_get();
+	ctx->deadline_ns = ktime_to_ns(t0) + (u64)sec * NSEC_PER_SEC;
+
+	for (i = 0; i < nreq; i++)
+		bench_issue(&breqs[i]);
+	wait_for_completion(&ctx->drained);
+
+	t1 = ktime_get();
+	bench_cpu_snapshot(&cpu1);
+
+	if (ctx->err) {
+		pr_err("qcrypto_bench: %s size %u depth %u failed, err %d\n",
+				alg, size, nreq, ctx->err);
+		return;
+	}
+
+	elapsed_us = max_t(u64, ktime_to_us(ktime_sub(t1, t0)), 1);
+	bytes = ctx->ops * size;
+	/* hundredths of MB/s */
+	mbps = div64_u64(bytes * 100 * USEC_PER_SEC, elapsed_us << 20);
+	cpu_us = cputime_to_usecs((cputime_t)(cpu1.busy - cpu0.busy));
+	cpu_pct = div64_u64(cpu_us * 100,
+			elapsed_us * num_online_cpus());
+
+	sort(ctx->lat, ctx->nlat, sizeof(u32), bench_cmp_u32, NULL);
+
+	pr_info("qcrypto_bench: %s %s size %6u depth %2u: %llu.%02llu MB/s, %llu ops/s, lat us p50 %u p90 %u p99 %u max %u, cpu %llu%%\n",
+		alg, (ctx->type == BENCH_HASH) ? "digest" :
+			(decrypt ? "dec" : "enc"),
+		size, nreq, mbps / 100, mbps % 100,
+		div64_u64(ctx->ops * USEC_PER_SEC, elapsed_us),
+		bench_percentile(ctx, 50) / NSEC_PER_USEC,
+		bench_percentile(ctx, 90) / NSEC_PER_USEC,
+		bench_percentile(ctx, 99) / NSEC_PER_USEC,
+		bench_percentile(ctx, 100) / NSEC_PER_USEC,
+		cpu_pct);
+}
+
+/* authenc() keys carry the encryption key length in an rtattr header */
+static int bench_aead_setkey(struct crypto_aead *aead)
+{
+	u8 key[RTA_SPACE(sizeof(struct crypto_authenc_key_param)) +
+			2 * BENCH_MAX_KEY];
+	struct crypto_authenc_key_param *param;
+	struct rtattr *rta = (struct rtattr *)key;
+	unsigned int len;
+
+	if (!strstr(alg, "authenc")) {
+		get_random_bytes(key, klen);
+		return crypto_aead_setkey(aead, key, klen);
+	}
+
+	if (auth_klen > BENCH_MAX_KEY)
+		return -EINVAL;
+	rta->rta_type = CRYPTO_AUTHENC_KEYA_PARAM;
+	rta->rta_len = RTA_LENGTH(sizeof(*param));
+	param = RTA_DATA(rta);
+	param->enckeylen = cpu_to_be32(klen);
+	len = RTA_SPACE(sizeof(*param));
+	get_random_bytes(key + len, auth_klen + klen);
+	return crypto_aead_setkey(aead, key, len + auth_klen + klen);
+}
+
+static int bench_alloc_tfm(struct bench_ctx *ctx)
+{
+	u8 key[BENCH_MAX_KEY];
+	int ret = 0;
+
+	if (klen > BENCH_MAX_KEY)
+		return -EINVAL;
+	get_random_bytes(key, klen);
+
+	switch (ctx->type) {
+	case BENCH_CIPHER:
+		ctx->tfm.ablk = crypto_alloc_ablkcipher(alg, 0, 0);
+		if (IS_ERR(ctx->tfm.ablk))
+			return PTR_ERR(ctx->tfm.ablk);
+		if (crypto_ablkcipher_ivsize(ctx->tfm.ablk) > BENCH_MAX_IV)
+			return -EINVAL;
+		ret = crypto_ablkcipher_setkey(ctx->tfm.ablk, key, klen);
+		break;
+	case BENCH_AEAD:
+		ctx->tfm.aead = crypto_alloc_aead(alg, 0, 0);
+		if (IS_ERR(ctx->tfm.aead))
+			return PTR_ERR(ctx->tfm.aead);
+		if (crypto_aead_ivsize(ctx->tfm.aead) > BENCH_MAX_IV)
+			return -EINVAL;
+		ret = crypto_aead_setauthsize(ctx->tfm.aead, authsize);
+		if (!ret)
+			ret = bench_aead_setkey(ctx->tfm.aead);
+		break;
+	case BENCH_HASH:
+		ctx->tfm.ahash = crypto_alloc_ahash(alg, 0, 0);
+		if (IS_ERR(ctx->tfm.ahash))
+			return PTR_ERR(ctx->tfm.ahash);
+		if (crypto_ahash_digestsize(ctx->tfm.ahash) > BENCH_MAX_DIGEST)
+			return -EINVAL;
+		if (klen)
+			ret = crypto_ahash_setkey(ctx->tfm.ahash, key, klen);
+		break;
+	}
+	return ret;
+}
+
+static void bench_free_tfm(struct bench_ctx *ctx)
+{
+	switch (ctx->type) {
+	case BENCH_CIPHER:
+		if (!IS_ERR_OR_NULL(ctx->tfm.ablk))
+			crypto_free_ablkcipher(ctx->tfm.ablk);
+		break;
+	case BENCH_AEAD:
+		if (!IS_ERR_OR_NULL(ctx->tfm.aead))
+			crypto_free_aead(ctx->tfm.aead);
+		break;
+	case BENCH_HASH:
+		if (!IS_ERR_OR_NULL(ctx->tfm.ahash))
+			crypto_free_ahash(ctx->tfm.ahash);
+		break;
+	}
+}
+
+static int bench_alloc_req(struct bench_ctx *ctx, struct bench_req *breq,
+				unsigned int max_size)
+{
+	breq->ctx = ctx;
+	breq->buf = kmalloc(max_size + assoclen + authsize, GFP_KERNEL);
+	if (!breq->buf)
+		return -ENOMEM;
+	get_random_bytes(breq->buf, max_size + assoclen + authsize);
+	get_random_bytes(breq->iv, sizeof(breq->iv));
+
+	switch (ctx->type) {
+	case BENCH_CIPHER:
+		breq->req.ablk = ablkcipher_request_alloc(ctx->tfm.ablk,
+							GFP_KERNEL);
+		if (!breq->req.ablk)
+			return -ENOMEM;
+		ablkcipher_request_set_callback(breq->req.ablk,
+				CRYPTO_TFM_REQ_MAY_BACKLOG, bench_cb, breq);
+		break;
+	case BENCH_AEAD:
+		breq->req.aead = aead_request_alloc(ctx->tfm.aead, GFP_KERNEL);
+		if (!breq->req.aead)
+			return -ENOMEM;
+		aead_request_set_callback(breq->req.aead,
+				CRYPTO_TFM_REQ_MAY_BACKLOG, bench_cb, breq);
+		/* CCM takes L' in the first IV byte */
+		if (strstr(alg, "ccm"))
+			breq->iv[0] = 3;
+		sg_init_one(&breq->assoc_sg, breq->buf + max_size + authsize,
+				assoclen);
+		break;
+	case BENCH_HASH:
+		breq->req.ahash = ahash_request_alloc(ctx->tfm.ahash,
+							GFP_KERNEL);
+		if (!breq->req.ahash)
+			return -ENOMEM;
+		ahash_request_set_callback(breq->req.ahash,
+				CRYPTO_TFM_REQ_MAY_BACKLOG, bench_cb, breq);
+		break;
+	}
+
+	/* room for the tag of AEAD done in place */
+	sg_init_one(&breq->sg, breq->buf, max_size + authsize);
+	return 0;
+}
+
+static void bench_free_req(struct bench_ctx *ctx, struct bench_req *breq)
+{
+	switch (ctx->type) {
+	case BENCH_CIPHER:
+		if (breq->req.ablk)
+			ablkcipher_request_free(breq->req.ablk);
+		break;
+	case BENCH_AEAD:
+		if (breq->req.aead)
+			aead_request_free(breq->req.aead);
+		break;
+	case BENCH_HASH:
+		if (breq->req.ahash)
+			ahash_request_free(breq->req.ahash);
+		break;
+	}
+	kfree(breq->buf);
+}
+
+static int __init qcrypto_bench_init(void)
+{
+	struct bench_ctx *ctx;
+	struct bench_req *breqs = NULL;
+	unsigned int max_size = 0, max_depth = 0;
+	int i, j;
+	int ret;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	spin_lock_init(&ctx->lock);
+
+	if (!strcmp(type, "cipher"))
+		ctx->type = BENCH_CIPHER;
+	else if (!strcmp(type, "aead"))
+		ctx->type = BENCH_AEAD;
+	else if (!strcmp(type, "hash"))
+		ctx->type = BENCH_HASH;
+	else {
+		pr_err("qcrypto_bench: unknown type %s\n", type);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < num_sizes; i++)
+		max_size = max(max_size, sizes[i]);
+	for (i = 0; i < num_depth; i++)
+		max_depth = max(max_depth, depth[i]);
+	if (!max_size || max_size > BENCH_MAX_SIZE || !max_depth ||
+			max_depth > BENCH_MAX_DEPTH || !sec) {
+		pr_err("qcrypto_bench: invalid sizes/depth/sec\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = bench_alloc_tfm(ctx);
+	if (ret) {
+		pr_err("qcrypto_bench: can not set up %s, err %d\n", alg, ret);
+		goto out_tfm;
+	}
+
+	ctx->lat = vmalloc(BENCH_MAX_SAMPLES * sizeof(u32));
+	breqs = kcalloc(max_depth, sizeof(*breqs), GFP_KERNEL);
+	if (!ctx->lat || !breqs) {
+		ret = -ENOMEM;
+		goto out_req;
+	}
+	for (i = 0; i < max_depth; i++) {
+		ret = bench_alloc_req(ctx, &breqs[i], max_size);
+		if (ret)
+			goto out_req;
+	}
+
+	pr_info("qcrypto_bench: %s (%s), %u s per test\n", alg, type, sec);
+	for (i = 0; i < num_depth; i++)
+		for (j = 0; j < num_sizes; j++) {
+			if (!depth[i] || !sizes[j])
+				continue;
+			bench_run(ctx, breqs, sizes[j], depth[i]);
+		}
+
+	/* We intentionally return -EAGAIN to prevent keeping the module */
+	ret = -EAGAIN;
+out_req:
+	if (breqs)
+		for (i = 0; i < max_depth; i++)
+			bench_free_req(ctx, &breqs[i]);
+	kfree(breqs);
+	vfree(ctx->lat);
+out_tfm:
+	bench_free_tfm(ctx);
+out:
+	kfree(ctx);
+	return ret;
+}
+
+static void __exit qcrypto_bench_exit(void)
+{
+}
+
+module_init(qcrypto_bench_init);
+module_exit(qcrypto_bench_exit);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("Qualcomm crypto engine benchmark");
@@ -57,6 +57,7 @@ struct bwmon {
 	void __iomem *global_base;
 	unsigned int mport;
 	unsigned int irq;
+	u32 limit;
 	const struct bwmon_spec *spec;
 	struct device *dev;
 	struct bw_hwmon hw;
@@ -222,6 +223,7 @@ static unsigned long meas_bw_and_set_irq(struct bw_hwmon *hw,
 	else
 		limit = mbps_to_bytes(max(mbps, 400UL), sample_ms, tol);
 
+	m->limit = limit;
 	mon_set_limit(m, limit);
 
 	mon_clear(m);
@@ -232,6 +234,22 @@ static unsigned long meas_bw_and_set_irq(struct bw_hwmon *hw,
 	return mbps;
 }
 
+static int set_irq_level(struct bw_hwmon *hw, unsigned int level,
+			 unsigned int nr_levels)
+{
+	struct bwmon *m = to_bwmon(hw);
+	u32 limit = div_u64((u64)m->limit * level, nr_levels);
+
+	mon_set_limit(m, limit);
+	mon_irq_clear(m);
+
+	/* The count won't cross a threshold that it has already passed */
+	if (readl_relaxed(MON_CNT(m)) >= limit)
+		return -EAGAIN;
+
+	return 0;
+}
+
 static irqreturn_t bwmon_intr_handler(int irq, void *dev)
 {
 	struct bwmon *m = dev;
@@ -261,6 +279,7 @@ static int start_bw_hwmon(struct bw_hwmon *hw, unsigned long mbps)
 	mon_disable(m);
 
 	limit = mbps_to_bytes(mbps, hw->df->profile->polling_ms, 0);
+	m->limit = limit;
 	mon_set_limit(m, limit);
 
 	mon_clear(m);
@@ -392,6 +411,12 @@ static int bimc_bwmon_driver_probe(struct platform_device *pdev)
 	m->hw.suspend_hwmon = &suspend_bw_hwmon,
 	m->hw.resume_hwmon = &resume_bw_hwmon,
 	m->hw.meas_bw_and_set_irq = &meas_bw_and_set_irq,
+	/*
+	 * Counters that wrap on the threshold lose the count below it, so
+	 * they can't be stepped through several thresholds per window.
+	 */
+	if (!m->spec->wrap_on_thres)
+		m->hw.set_irq_level = &set_irq_level;
 
 	ret = register_bw_hwmon(dev, &m->hw);
 	if (ret) {
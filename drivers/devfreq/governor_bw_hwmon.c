@@ -28,6 +28,8 @@
 #include <linux/platform_device.h>
 #include <linux/of.h>
 #include <linux/devfreq.h>
+#include <linux/cpufreq.h>
+#include <linux/workqueue.h>
 #include "governor.h"
 #include "governor_bw_hwmon.h"
 
@@ -37,6 +39,14 @@ struct hwmon_node {
 	unsigned int decay_rate;
 	unsigned int io_percent;
 	unsigned int bw_step;
+	unsigned int cpufreq_scale;
+	unsigned int irq_levels;
+	unsigned int irq_level;
+	unsigned int hold_windows;
+	unsigned int hold_cnt;
+	unsigned long bytes_per_kcycle;
+	unsigned int meas_cpu_mhz;
+	struct work_struct cpufreq_work;
 	unsigned long prev_ab;
 	unsigned long *dev_ab;
 	unsigned long resume_freq;
@@ -54,6 +64,7 @@ static LIST_HEAD(hwmon_list);
 static DEFINE_MUTEX(list_lock);
 
 static int use_cnt;
+static bool cpufreq_nb_registered;
 static DEFINE_MUTEX(state_lock);
 
 #define show_attr(name) \
@@ -122,6 +133,47 @@ static unsigned long measure_bw_and_set_irq(struct hwmon_node *node)
 	return mbps;
 }
 
+/* Frequency of the fastest online CPU, which sets the pace of its traffic */
+static unsigned int cpu_cur_mhz(void)
+{
+	unsigned int cpu, khz = 0;
+
+	for_each_online_cpu(cpu)
+		khz = max(khz, cpufreq_quick_get(cpu));
+
+	return khz / 1000;
+}
+
+/*
+ * Turn the measured traffic into bytes per CPU cycle of the window it was
+ * measured in, and project it onto the current CPU frequency. With
+ * cpufreq_scale at 100 the vote follows the CPU frequency as soon as it
+ * changes, rather than one sampling window later; lower values blend the
+ * projection with the plain measurement.
+ */
+static unsigned long scale_bw_to_cpufreq(struct hwmon_node *node,
+					unsigned long mbps)
+{
+	unsigned int cpu_mhz = cpu_cur_mhz();
+	unsigned long pred;
+
+	if (!node->cpufreq_scale || !cpu_mhz) {
+		node->meas_cpu_mhz = 0;
+		return mbps;
+	}
+
+	if (node->meas_cpu_mhz)
+		node->bytes_per_kcycle = mbps * 1000 / node->meas_cpu_mhz;
+	node->meas_cpu_mhz = cpu_mhz;
+	if (!node->bytes_per_kcycle)
+		return mbps;
+
+	pred = node->bytes_per_kcycle * cpu_mhz / 1000;
+	if (pred > mbps)
+		return mbps + (pred - mbps) * node->cpufreq_scale / 100;
+	return mbps - (mbps - pred) * node->cpufreq_scale / 100;
+}
+
 static void compute_bw(struct hwmon_node *node, int mbps,
 			unsigned long *freq, unsigned long *ab)
 {
@@ -131,6 +183,11 @@ static void compute_bw(struct hwmon_node *node, int mbps,
 
 	if (mbps > node->prev_ab) {
 		new_bw = mbps;
+		node->hold_cnt = node->hold_windows;
+	} else if (node->hold_cnt) {
+		/* Ride out the gaps of bursty traffic before decaying */
+		node->hold_cnt--;
+		new_bw = node->prev_ab;
 	} else {
 		new_bw = mbps * node->decay_rate
 			+ node->prev_ab * (100 - node->decay_rate);
@@ -162,27 +219,13 @@ static struct hwmon_node *find_hwmon_node(struct devfreq *df)
 }
 
 #define TOO_SOON_US	(1 * USEC_PER_MSEC)
-int update_bw_hwmon(struct bw_hwmon *hwmon)
+static void __update_bw_hwmon(struct hwmon_node *node)
 {
-	struct devfreq *df;
-	struct hwmon_node *node;
+	struct devfreq *df = node->hw->df;
 	ktime_t ts;
 	unsigned int us;
 	int ret;
 
-	if (!hwmon)
-		return -EINVAL;
-	df = hwmon->df;
-	if (!df)
-		return -ENODEV;
-	node = find_hwmon_node(df);
-	if (!node)
-		return -ENODEV;
-
-	if (!node->mon_started)
-		return -EBUSY;
-
-	dev_dbg(df->dev.parent, "Got update request\n");
 	devfreq_monitor_stop(df);
 
 	/*
@@ -207,10 +250,118 @@ int update_bw_hwmon(struct bw_hwmon *hwmon)
 	}
 
 	devfreq_monitor_start(df);
+}
+
+/*
+ * With irq_levels > 1 the threshold of a window is split into that many
+ * steps. Reaching a step no sooner than the same fraction of the window
+ * means the traffic is within the current vote, and only moves the
+ * threshold to the next step. Reaching it early is a burst and ramps the
+ * vote up right away, without waiting for the whole window's worth of
+ * bytes to go through first.
+ */
+static void start_irq_levels(struct hwmon_node *node)
+{
+	struct bw_hwmon *hw = node->hw;
+
+	node->irq_level = node->irq_levels;
+	if (node->irq_levels <= 1 || !hw->set_irq_level)
+		return;
+
+	if (!hw->set_irq_level(hw, 1, node->irq_levels))
+		node->irq_level = 1;
+	else
+		hw->set_irq_level(hw, node->irq_levels, node->irq_levels);
+}
+
+static bool next_irq_level(struct hwmon_node *node)
+{
+	struct bw_hwmon *hw = node->hw;
+	unsigned int us, window_us;
+
+	if (node->irq_level >= node->irq_levels || !hw->set_irq_level)
+		return false;
+
+	us = ktime_to_us(ktime_sub(ktime_get(), node->prev_ts));
+	window_us = hw->df->profile->polling_ms * USEC_PER_MSEC;
+	if ((u64)us * node->irq_levels < (u64)window_us * node->irq_level)
+		return false;
+
+	node->irq_level++;
+	if (hw->set_irq_level(hw, node->irq_level, node->irq_levels))
+		return false;
+
+	dev_dbg(hw->df->dev.parent, "IRQ level %u/%u at %u us\n",
+		node->irq_level, node->irq_levels, us);
+	return true;
+}
+
+int update_bw_hwmon(struct bw_hwmon *hwmon)
+{
+	struct devfreq *df;
+	struct hwmon_node *node;
+
+	if (!hwmon)
+		return -EINVAL;
+	df = hwmon->df;
+	if (!df)
+		return -ENODEV;
+	node = find_hwmon_node(df);
+	if (!node)
+		return -ENODEV;
+
+	if (!node->mon_started)
+		return -EBUSY;
+
+	if (next_irq_level(node))
+		return 0;
+
+	dev_dbg(df->dev.parent, "Got update request\n");
+	__update_bw_hwmon(node);
+
+	return 0;
+}
+
+static void cpufreq_update_work(struct work_struct *work)
+{
+	struct hwmon_node *node = container_of(work, struct hwmon_node,
+						cpufreq_work);
+	unsigned int cpu_mhz = cpu_cur_mhz();
+	unsigned int diff;
+
+	if (!node->mon_started || !node->meas_cpu_mhz)
+		return;
+
+	diff = abs((int)cpu_mhz - (int)node->meas_cpu_mhz);
+	if (diff * 100 <= node->meas_cpu_mhz * node->tolerance_percent)
+		return;
+
+	dev_dbg(node->hw->df->dev.parent, "CPU freq %u -> %u MHz\n",
+		node->meas_cpu_mhz, cpu_mhz);
+	__update_bw_hwmon(node);
+}
+
+static int bw_hwmon_cpufreq_trans_notifier(struct notifier_block *nb,
+		unsigned long event, void *data)
+{
+	struct hwmon_node *node;
+
+	if (event != CPUFREQ_POSTCHANGE)
+		return 0;
+
+	mutex_lock(&list_lock);
+	list_for_each_entry(node, &hwmon_list, list)
+		if (node->cpufreq_scale && node->mon_started)
+			schedule_work(&node->cpufreq_work);
+	mutex_unlock(&list_lock);
 
 	return 0;
 }
 
+static struct notifier_block bw_hwmon_cpufreq_trans_nb = {
+	.notifier_call = bw_hwmon_cpufreq_trans_notifier,
+};
+
 static int start_monitor(struct devfreq *df, bool init)
 {
 	struct hwmon_node *node = df->data;
@@ -223,6 +374,9 @@ static int start_monitor(struct devfreq *df, bool init)
 
 	if (init) {
 		node->prev_ab = 0;
+		node->hold_cnt = 0;
+		node->bytes_per_kcycle = 0;
+		node->meas_cpu_mhz = 0;
 		node->resume_freq = 0;
 		node->resume_ab = 0;
 		mbps = (df->previous_freq * node->io_percent) / 100;
@@ -252,6 +406,7 @@ static void stop_monitor(struct devfreq *df, bool init)
 	struct bw_hwmon *hw = node->hw;
 
 	node->mon_started = false;
+	cancel_work_sync(&node->cpufreq_work);
 
 	if (init) {
 		devfreq_monitor_stop(df);
@@ -393,6 +548,8 @@ static int devfreq_bw_hwmon_get_freq(struct devfreq *df,
 	}
 
 	mbps = measure_bw_and_set_irq(node);
+	start_irq_levels(node);
+	mbps = scale_bw_to_cpufreq(node, mbps);
 	compute_bw(node, mbps, freq, node->dev_ab);
 
 	return 0;
@@ -403,6 +560,9 @@ gov_attr(guard_band_mbps, 0U, 2000U);
 gov_attr(decay_rate, 0U, 100U);
 gov_attr(io_percent, 1U, 100U);
 gov_attr(bw_step, 50U, 1000U);
+gov_attr(cpufreq_scale, 0U, 100U);
+gov_attr(irq_levels, 1U, 8U);
+gov_attr(hold_windows, 0U, 50U);
 
 static struct attribute *dev_attr[] = {
 	&dev_attr_tolerance_percent.attr,
@@ -410,6 +570,9 @@ static struct attribute *dev_attr[] = {
 	&dev_attr_decay_rate.attr,
 	&dev_attr_io_percent.attr,
 	&dev_attr_bw_step.attr,
+	&dev_attr_cpufreq_scale.attr,
+	&dev_attr_irq_levels.attr,
+	&dev_attr_hold_windows.attr,
 	NULL,
 };
 
@@ -523,12 +686,21 @@ int register_bw_hwmon(struct device *dev, struct bw_hwmon *hwmon)
 	node->decay_rate = 90;
 	node->io_percent = 16;
 	node->bw_step = 190;
+	node->irq_levels = 1;
 	node->hw = hwmon;
+	INIT_WORK(&node->cpufreq_work, cpufreq_update_work);
 
 	mutex_lock(&list_lock);
 	list_add_tail(&node->list, &hwmon_list);
 	mutex_unlock(&list_lock);
 
+	mutex_lock(&state_lock);
+	if (!cpufreq_nb_registered &&
+	    !cpufreq_register_notifier(&bw_hwmon_cpufreq_trans_nb,
+					CPUFREQ_TRANSITION_NOTIFIER))
+		cpufreq_nb_registered = true;
+	mutex_unlock(&state_lock);
+
 	if (hwmon->gov) {
 		ret = devfreq_add_governor(hwmon->gov);
 	} else {
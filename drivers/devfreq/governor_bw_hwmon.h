@@ -26,6 +26,12 @@
  * @meas_bw_and_set_irq:	Return the measured bandwidth and set up the
  *				IRQ to fire if the usage exceeds current
  *				measurement by @tol percent.
+ * @set_irq_level:		Optional. Move the IRQ threshold to @level /
+ *				@nr_levels of the limit set by the last
+ *				meas_bw_and_set_irq() without restarting the
+ *				count, and clear a pending threshold IRQ.
+ *				Returns an error if the count is already past
+ *				the new threshold.
  * @irq:			IRQ number that corresponds to this HW
  *				monitor.
  * @dev:			Pointer to device that this HW monitor can
@@ -51,6 +57,8 @@ struct bw_hwmon {
 	int (*resume_hwmon)(struct bw_hwmon *hw);
 	unsigned long (*meas_bw_and_set_irq)(struct bw_hwmon *hw,
 					unsigned int tol, unsigned int us);
+	int (*set_irq_level)(struct bw_hwmon *hw, unsigned int level,
+					unsigned int nr_levels);
 	struct device *dev;
 	struct device_node *of_node;
 	struct devfreq_governor *gov;
@@ -55,6 +55,18 @@ static DEFINE_SPINLOCK(tz_lock);
 
 #define TAG "msm_adreno_tz: "
 
+/*
+ * In frame aware mode the frequency follows the GPU time of the frames the
+ * kgsl dispatcher retires, and the TZ algorithm is only used for windows
+ * without any frame.
+ */
+static bool frame_aware;
+module_param(frame_aware, bool, 0644);
+
+/* Percentage of the frame period left unused as a safety margin */
+static unsigned int frame_headroom = 20;
+module_param(frame_headroom, uint, 0644);
+
 struct msm_adreno_extended_profile *partner_gpu_profile;
 static void do_partner_start_event(struct work_struct *work);
 static void do_partner_stop_event(struct work_struct *work);
@@ -169,6 +181,40 @@ static int tz_init(struct devfreq_msm_adreno_tz_data *priv,
 	return ret;
 }
 
+/*
+ * Pick the lowest level that runs the predicted frame within its period.
+ * The prediction is kept in GPU cycles so that it survives frequency
+ * changes: it follows a more expensive frame right away and decays by 1/8
+ * of the difference towards a cheaper one, so a single light frame does
+ * not drop the clock.
+ */
+static int tz_frame_level(struct devfreq *devfreq,
+		struct devfreq_msm_adreno_tz_data *priv, unsigned long cur_freq)
+{
+	unsigned int headroom = min(ACCESS_ONCE(frame_headroom), 90U);
+	u64 cycles, budget;
+	int level;
+
+	cycles = div_u64(priv->frame.gpu_time * cur_freq, NSEC_PER_SEC);
+
+	if (cycles >= priv->frame.predicted)
+		priv->frame.predicted = cycles;
+	else
+		priv->frame.predicted -= (priv->frame.predicted - cycles) >> 3;
+
+	/* GPU time the next frame can take, in ns */
+	budget = div_u64(priv->frame.period * (100 - headroom), 100);
+
+	for (level = devfreq->profile->max_state - 1; level > 0; level--) {
+		u64 f = devfreq->profile->freq_table[level];
+
+		if (div64_u64(priv->frame.predicted * NSEC_PER_SEC, f) <= budget)
+			break;
+	}
+
+	return level;
+}
+
 static int tz_get_target_freq(struct devfreq *devfreq, unsigned long *freq,
 				u32 *flag)
 {
@@ -186,6 +232,19 @@ static int tz_get_target_freq(struct devfreq *devfreq, unsigned long *freq,
 	}
 
 	*freq = stats.current_frequency;
+
+	/*
+	 * The frames are only handed over for this window, so act on them
+	 * now rather than waiting for FLOOR worth of busy stats.
+	 */
+	if (frame_aware && priv->frame.count && stats.current_frequency) {
+		level = tz_frame_level(devfreq, priv, stats.current_frequency);
+		priv->bin.total_time = 0;
+		priv->bin.busy_time = 0;
+		*freq = devfreq->profile->freq_table[level];
+		return 0;
+	}
+
 	priv->bin.total_time += stats.total_time;
 	priv->bin.busy_time += stats.busy_time;
 
@@ -357,6 +416,7 @@ static int tz_suspend(struct devfreq *devfreq)
 
 	priv->bin.total_time = 0;
 	priv->bin.busy_time = 0;
+	priv->frame.predicted = 0;
 	return 0;
 }
 
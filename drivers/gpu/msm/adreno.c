@@ -2042,6 +2042,10 @@ static int adreno_init_sysfs(struct kgsl_device *device)
 		goto done;
 
 	ret  = sysfs_create_file(&device->ppd_kobj, &attr_enable.attr);
+	if (ret)
+		goto done;
+
+	ret = adreno_telemetry_init(ADRENO_DEVICE(device));
 
 done:
 	return ret;
@@ -2049,6 +2053,8 @@ done:
 
 static void adreno_uninit_sysfs(struct kgsl_device *device)
 {
+	adreno_telemetry_close(ADRENO_DEVICE(device));
+
 	sysfs_remove_file(&device->ppd_kobj, &attr_enable.attr);
 
 	kobject_put(&device->ppd_kobj);
@@ -2188,6 +2194,22 @@ int adreno_set_constraint(struct kgsl_device *device,
 			context->pwr_constraint.sub_type);
 		}
 		break;
+	case KGSL_CONSTRAINT_SCHED: {
+		struct kgsl_device_constraint_sched sched;
+
+		if (constraint->size != sizeof(sched))
+			return -EINVAL;
+
+		if (copy_from_user(&sched,
+				(void __user *)constraint->data,
+				sizeof(sched)))
+			return -EFAULT;
+
+		/* Not a power constraint, leave the current one alone */
+		return adreno_dispatcher_set_sched(ADRENO_DEVICE(device),
+				ADRENO_CONTEXT(context), sched.weight,
+				sched.deadline_us);
+		}
 	case KGSL_CONSTRAINT_NONE:
 		if (context->pwr_constraint.type == KGSL_CONSTRAINT_PWRLEVEL)
 			trace_kgsl_user_pwrlevel_constraint(device,
@@ -18,6 +18,7 @@
 #include "adreno_drawctxt.h"
 #include "adreno_ringbuffer.h"
 #include "adreno_profile.h"
+#include "adreno_telemetry.h"
 #include "adreno_dispatch.h"
 #include "kgsl_iommu.h"
 #include <linux/stat.h>
@@ -230,6 +231,7 @@ struct adreno_device {
 	unsigned int ft_pf_policy;
 	struct ocmem_buf *ocmem_hdl;
 	struct adreno_profile profile;
+	struct adreno_telemetry telemetry;
 	struct adreno_dispatcher dispatcher;
 	struct kgsl_memdesc pwron_fixup;
 	unsigned int pwron_fixup_dwords;
@@ -710,6 +712,9 @@ int adreno_perfcounter_query_group(struct adreno_device *adreno_dev,
 int adreno_perfcounter_read_group(struct adreno_device *adreno_dev,
 	struct kgsl_perfcounter_read_group __user *reads, unsigned int count);
 
+uint64_t adreno_perfcounter_read(struct adreno_device *adreno_dev,
+	unsigned int groupid, unsigned int countable);
+
 int adreno_set_constraint(struct kgsl_device *device,
 				struct kgsl_context *context,
 				struct kgsl_device_constraint *constraint);
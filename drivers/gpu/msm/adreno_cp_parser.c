@@ -10,6 +10,8 @@
  * GNU General Public License for more details.
  */
 
+#include <linux/jhash.h>
+
 #include "kgsl.h"
 #include "kgsl_sharedmem.h"
 #include "kgsl_snapshot.h"
@@ -21,6 +23,33 @@
 
 #define MAX_IB_OBJS 1000
 #define NUM_SET_DRAW_GROUPS 32
+#define IB_CACHE_ENTRIES 8
+
+/*
+ * struct ib_cache_entry - Objects found in an IB, kept for the next time
+ * the same IB gets parsed
+ * @pid: Process the IB belongs to, 0 for an unused entry
+ * @gpuaddr: GPU address of the IB
+ * @dwords: Size of the IB in dwords
+ * @generation: Hash of every command stream found in the IB, the IB itself
+ * included, when it was parsed
+ * @objs: The objects found, without references to their memory entries
+ * @num_objs: Number of entries in @objs
+ * @age: Value of ib_cache_clock at the last use of the entry
+ */
+struct ib_cache_entry {
+	pid_t pid;
+	unsigned int gpuaddr;
+	unsigned int dwords;
+	u32 generation;
+	struct adreno_ib_object *objs;
+	int num_objs;
+	unsigned long age;
+};
+
+static struct ib_cache_entry ib_cache[IB_CACHE_ENTRIES];
+static unsigned long ib_cache_clock;
+static DEFINE_MUTEX(ib_cache_lock);
 
 struct set_draw_state {
 	unsigned int cmd_stream_addr;
@@ -843,6 +872,160 @@ done:
 }
 
 
+/*
+ * Hash the contents of the IB and draw state objects in a list. Any change
+ * to a command stream referenced from the IB changes the hash, the buffers
+ * those streams point to do not matter since the objects are found again by
+ * address. Return 0 if one of the streams is gone.
+ */
+static u32 _ib_cache_generation(struct kgsl_process_private *process,
+		struct adreno_ib_object *objs, int num_objs)
+{
+	u32 hash = 0;
+	int i;
+
+	for (i = 0; i < num_objs; i++) {
+		struct kgsl_mem_entry *entry;
+		unsigned int *src;
+
+		if (objs[i].snapshot_obj_type != SNAPSHOT_GPU_OBJECT_IB &&
+			objs[i].snapshot_obj_type != SNAPSHOT_GPU_OBJECT_DRAW)
+			continue;
+
+		entry = kgsl_sharedmem_find_region(process, objs[i].gpuaddr,
+			objs[i].size);
+		if (!entry)
+			return 0;
+
+		src = kgsl_gpuaddr_to_vaddr(&entry->memdesc, objs[i].gpuaddr);
+		if (src) {
+			hash = jhash2(src, objs[i].size >> 2, hash);
+			kgsl_memdesc_unmap(&entry->memdesc);
+		}
+		kgsl_mem_entry_put(entry);
+
+		if (!src)
+			return 0;
+	}
+
+	return hash ? hash : 1;
+}
+
+static struct ib_cache_entry *_ib_cache_find(
+		struct kgsl_process_private *process,
+		unsigned int gpuaddr, unsigned int dwords)
+{
+	int i;
+
+	for (i = 0; i < IB_CACHE_ENTRIES; i++)
+		if (ib_cache[i].pid == process->pid &&
+			ib_cache[i].gpuaddr == gpuaddr &&
+			ib_cache[i].dwords == dwords)
+			return &ib_cache[i];
+
+	return NULL;
+}
+
+static void _ib_cache_drop(struct ib_cache_entry *cache)
+{
+	vfree(cache->objs);
+	memset(cache, 0, sizeof(*cache));
+}
+
+/*
+ * Fill ib_obj_list from the cache if the IB and every command stream it
+ * references are unchanged since they were parsed. The memory entries are
+ * looked up again so the list holds references like a parsed one. Returns
+ * true on a hit.
+ */
+static bool _ib_cache_lookup(struct kgsl_process_private *process,
+		unsigned int gpuaddr, unsigned int dwords,
+		struct adreno_ib_object_list *ib_obj_list)
+{
+	struct ib_cache_entry *cache;
+	bool hit = false;
+	int i;
+
+	mutex_lock(&ib_cache_lock);
+
+	cache = _ib_cache_find(process, gpuaddr, dwords);
+	if (cache == NULL)
+		goto done;
+
+	if (cache->generation != _ib_cache_generation(process, cache->objs,
+		cache->num_objs)) {
+		_ib_cache_drop(cache);
+		goto done;
+	}
+
+	for (i = 0; i < cache->num_objs; i++) {
+		struct adreno_ib_object *obj = &cache->objs[i];
+		struct kgsl_mem_entry *entry;
+
+		entry = kgsl_sharedmem_find_region(process, obj->gpuaddr,
+			obj->size);
+		if (!entry)
+			continue;
+
+		adreno_ib_init_ib_obj(obj->gpuaddr, obj->size,
+			obj->snapshot_obj_type, entry,
+			&ib_obj_list->obj_list[ib_obj_list->num_objs++]);
+	}
+
+	cache->age = ++ib_cache_clock;
+	hit = true;
+done:
+	mutex_unlock(&ib_cache_lock);
+	return hit;
+}
+
+/* Remember the objects found in a fully parsed IB, evicting the oldest entry */
+static void _ib_cache_store(struct kgsl_process_private *process,
+		unsigned int gpuaddr, unsigned int dwords,
+		struct adreno_ib_object_list *ib_obj_list)
+{
+	struct ib_cache_entry *cache;
+	struct adreno_ib_object *objs;
+	u32 generation;
+	int i;
+
+	generation = _ib_cache_generation(process, ib_obj_list->obj_list,
+		ib_obj_list->num_objs);
+	if (generation == 0)
+		return;
+
+	objs = vmalloc(ib_obj_list->num_objs * sizeof(*objs));
+	if (objs == NULL)
+		return;
+
+	for (i = 0; i < ib_obj_list->num_objs; i++) {
+		objs[i] = ib_obj_list->obj_list[i];
+		objs[i].entry = NULL;
+	}
+
+	mutex_lock(&ib_cache_lock);
+
+	cache = _ib_cache_find(process, gpuaddr, dwords);
+	if (cache == NULL) {
+		cache = &ib_cache[0];
+		for (i = 1; i < IB_CACHE_ENTRIES; i++)
+			if (ib_cache[i].age < cache->age)
+				cache = &ib_cache[i];
+	}
+
+	_ib_cache_drop(cache);
+
+	cache->pid = process->pid;
+	cache->gpuaddr = gpuaddr;
+	cache->dwords = dwords;
+	cache->generation = generation;
+	cache->objs = objs;
+	cache->num_objs = ib_obj_list->num_objs;
+	cache->age = ++ib_cache_clock;
+
+	mutex_unlock(&ib_cache_lock);
+}
+
 /*
  * adreno_ib_create_object_list() - Find all the memory objects in IB
  * @device: The device pointer on which the IB executes
@@ -852,7 +1035,10 @@ done:
  * @ib_obj_list: The list in which the IB and the objects in it are added.
  *
  * Find all the memory objects that an IB needs for execution and place
- * them in a list including the IB.
+ * them in a list including the IB. The result of a successful parse is
+ * cached and reused for as long as the command streams involved do not
+ * change, so an IB that is needed again by the next snapshot or dump is
+ * not decoded a second time.
  * Returns the ib object list. On success 0 is returned, on failure error
  * code is returned along with number of objects that was saved before
  * error occurred. If no objects found then the list pointer is set to
@@ -883,9 +1069,20 @@ int adreno_ib_create_object_list(struct kgsl_device *device,
 		return -ENOMEM;
 	}
 
+	if (_ib_cache_lookup(process, gpuaddr, dwords, ib_obj_list)) {
+		if (ib_obj_list->num_objs)
+			*out_ib_obj_list = ib_obj_list;
+		else
+			adreno_ib_destroy_obj_list(ib_obj_list);
+		return 0;
+	}
+
 	ret = adreno_ib_find_objs(device, process, gpuaddr, dwords,
 		SNAPSHOT_GPU_OBJECT_IB, ib_obj_list, 1);
 
+	if (!ret && ib_obj_list->num_objs)
+		_ib_cache_store(process, gpuaddr, dwords, ib_obj_list);
+
 	/* Even if there was an error return the remaining objects found */
 	if (ib_obj_list->num_objs)
 		*out_ib_obj_list = ib_obj_list;
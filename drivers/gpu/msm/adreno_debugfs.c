@@ -198,6 +198,10 @@ static int ctx_print(struct seq_file *s, void *unused)
 		   queued, consumed, retired,
 		   drawctxt->internal_timestamp);
 
+	seq_printf(s, "sched: weight: %u deadline_us: %u vtime: %llu gpu_time: %llu\n",
+		   drawctxt->weight, drawctxt->deadline_us,
+		   drawctxt->vtime, drawctxt->gpu_time);
+
 	seq_puts(s, "cmdqueue:\n");
 
 	spin_lock(&drawctxt->lock);
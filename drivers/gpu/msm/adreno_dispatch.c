@@ -57,6 +57,19 @@ static unsigned int _dispatcher_q_inflight_hi = 15;
  */
 static unsigned int _dispatcher_q_inflight_lo = 4;
 
+/*
+ * Maximum number of command batches a single context can have inflight when
+ * multiple contexts are active so that one busy context can't take all the
+ * inflight slots ahead of the others
+ */
+static unsigned int _context_inflight_budget = 2;
+
+/*
+ * GPU time (in microseconds) a context with a deadline hint is allowed to run
+ * ahead of the other contexts at the same priority to meet its deadlines
+ */
+static unsigned int _context_deadline_credit = 8000;
+
 /* Command batch timeout (in milliseconds) */
 static unsigned int _cmdbatch_timeout = 2000;
 
@@ -136,6 +149,141 @@ _cmdqueue_inflight(struct adreno_dispatcher_cmdqueue *cmdqueue)
 		? _dispatcher_q_inflight_lo : _dispatcher_q_inflight_hi;
 }
 
+/* Return the number of command batches the context has in the dispatch q */
+static unsigned int
+_context_inflight(struct adreno_dispatcher_cmdqueue *cmdqueue,
+		struct adreno_context *drawctxt)
+{
+	unsigned int i, count = 0;
+
+	for (i = cmdqueue->head; i != cmdqueue->tail;
+		i = CMDQUEUE_NEXT(i, ADRENO_DISPATCH_CMDQUEUE_SIZE))
+		if (cmdqueue->cmd_q[i]->context == &drawctxt->base)
+			count++;
+
+	return count;
+}
+
+/* The inflight budget of a single context, only enforced when sharing */
+static inline unsigned int
+_context_inflight_limit(struct adreno_dispatcher_cmdqueue *cmdqueue)
+{
+	return (cmdqueue->active_context_count > 1)
+		? _context_inflight_budget : ADRENO_DISPATCH_CMDQUEUE_SIZE;
+}
+
+/*
+ * (Re)arm the deadline of a context from its deadline hint. The deadline
+ * restarts when the context has just sent commands, otherwise an armed
+ * deadline is left alone. Must be called with the plist_lock held.
+ */
+static void _sched_arm_deadline(struct adreno_context *drawctxt, bool restart)
+{
+	if (drawctxt->deadline_us == 0) {
+		drawctxt->deadline = 0;
+		return;
+	}
+
+	if (restart || drawctxt->deadline == 0)
+		drawctxt->deadline = local_clock() +
+			(u64) drawctxt->deadline_us * NSEC_PER_USEC;
+}
+
+/*
+ * Return true if context a should be dispatched before context b of the same
+ * priority. Contexts with a deadline hint go earliest deadline first as long
+ * as they have not run more than _context_deadline_credit ahead of the other
+ * context, everything else is ordered by the weighted GPU time consumed.
+ */
+static bool _sched_before(struct adreno_context *a, struct adreno_context *b)
+{
+	u64 credit = (u64) _context_deadline_credit * NSEC_PER_USEC;
+
+	if (a->deadline && (!b->deadline || a->deadline < b->deadline))
+		return a->vtime <= b->vtime + credit;
+
+	if (b->deadline && (!a->deadline || b->deadline < a->deadline))
+		return b->vtime > a->vtime + credit;
+
+	return a->vtime < b->vtime;
+}
+
+/*
+ * Pick the next context to dispatch from: the pending list is sorted by
+ * priority so only the contexts at the highest pending priority compete.
+ * Must be called with the plist_lock held and a non empty pending list.
+ */
+static struct adreno_context *_sched_pick(struct adreno_dispatcher *dispatcher)
+{
+	struct adreno_context *drawctxt, *next;
+	int prio;
+
+	drawctxt = plist_first_entry(&dispatcher->pending,
+		struct adreno_context, pending);
+	prio = drawctxt->pending.prio;
+
+	plist_for_each_entry(next, &dispatcher->pending, pending) {
+		if (next->pending.prio != prio)
+			break;
+
+		if (_sched_before(next, drawctxt))
+			drawctxt = next;
+	}
+
+	dispatcher->vtime_floor = drawctxt->vtime;
+
+	return drawctxt;
+}
+
+/*
+ * Charge the GPU time of a retired command batch to its context and return
+ * it in ns
+ */
+static u64 _sched_charge(struct adreno_dispatcher *dispatcher,
+		struct adreno_dispatcher_cmdqueue *dispatch_q,
+		struct adreno_context *drawctxt, struct kgsl_cmdbatch *cmdbatch)
+{
+	u64 ns = adreno_profile_cmdbatch_gpu_time(dispatch_q, drawctxt,
+			cmdbatch);
+
+	spin_lock(&dispatcher->plist_lock);
+	drawctxt->vtime += div_u64(ns * KGSL_SCHED_WEIGHT_DEFAULT,
+			drawctxt->weight);
+	spin_unlock(&dispatcher->plist_lock);
+
+	return ns;
+}
+
+/*
+ * Add the GPU time of a retired command batch to the frame of its context
+ * and report the frame to pwrscale when this was the last command batch of
+ * it. A frame has until the deadline hint of the context to complete, or
+ * else as long as the previous frame of the context took.
+ */
+static void _sched_frame(struct kgsl_device *device,
+		struct adreno_context *drawctxt, struct kgsl_cmdbatch *cmdbatch,
+		u64 busy)
+{
+	u64 now, period = 0;
+
+	drawctxt->frame_time += busy;
+
+	if (!(cmdbatch->flags & KGSL_CMDBATCH_END_OF_FRAME))
+		return;
+
+	now = local_clock();
+
+	if (drawctxt->deadline_us)
+		period = (u64) drawctxt->deadline_us * NSEC_PER_USEC;
+	else if (drawctxt->frame_end)
+		period = now - drawctxt->frame_end;
+
+	kgsl_pwrscale_frame(device, drawctxt->frame_time, period);
+
+	drawctxt->frame_end = now;
+	drawctxt->frame_time = 0;
+}
+
 /**
  * fault_detect_read() - Read the set of fault detect registers
  * @device: Pointer to the KGSL device struct
@@ -506,6 +654,14 @@ static void  dispatcher_queue_context(struct adreno_device *adreno_dev,
 	if (plist_node_empty(&drawctxt->pending)) {
 		/* Get a reference to the context while it sits on the list */
 		if (_kgsl_context_get(&drawctxt->base)) {
+			/*
+			 * An idle context doesn't get to bank GPU time - start
+			 * it level with the last context that was picked
+			 */
+			if (drawctxt->vtime < dispatcher->vtime_floor)
+				drawctxt->vtime = dispatcher->vtime_floor;
+			_sched_arm_deadline(drawctxt, false);
+
 			trace_dispatch_queue_context(drawctxt);
 			plist_add(&drawctxt->pending, &dispatcher->pending);
 		}
@@ -613,6 +769,7 @@ static int sendcmd(struct adreno_device *adreno_dev,
 		time.ticks, (unsigned long) secs, nsecs / 1000);
 
 	cmdbatch->submit_ticks = time.ticks;
+	cmdbatch->submit_ktime = time.ktime;
 
 	dispatch_q->cmd_q[dispatch_q->tail] = cmdbatch;
 	dispatch_q->tail = (dispatch_q->tail + 1) %
@@ -663,18 +820,22 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 	int count = 0;
 	int ret = 0;
 	int inflight = _cmdqueue_inflight(dispatch_q);
+	unsigned int budget = _context_inflight_limit(dispatch_q);
+	unsigned int ctx_inflight = _context_inflight(dispatch_q, drawctxt);
 	unsigned int timestamp;
 
-	if (dispatch_q->inflight >= inflight) {
+	if (dispatch_q->inflight >= inflight || ctx_inflight >= budget) {
 		expire_markers(drawctxt);
 		return -EBUSY;
 	}
 
 	/*
 	 * Each context can send a specific number of command batches per cycle
+	 * and may only have so many in the ringbuffer at once
 	 */
 	while ((count < _context_cmdbatch_burst) &&
-		(dispatch_q->inflight < inflight)) {
+		(dispatch_q->inflight < inflight) &&
+		(ctx_inflight < budget)) {
 		struct kgsl_cmdbatch *cmdbatch;
 
 		if (adreno_gpu_fault(adreno_dev) != 0)
@@ -737,6 +898,7 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 		drawctxt->submitted_timestamp = timestamp;
 
 		count++;
+		ctx_inflight++;
 	}
 
 	/*
@@ -792,9 +954,8 @@ static void _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 			break;
 		}
 
-		/* Get the next entry on the list */
-		drawctxt = plist_first_entry(&dispatcher->pending,
-			struct adreno_context, pending);
+		/* Get the next context to run */
+		drawctxt = _sched_pick(dispatcher);
 
 		plist_del(&drawctxt->pending, &dispatcher->pending);
 
@@ -812,6 +973,10 @@ static void _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 		if (ret != 0 && ret != -ENOENT) {
 			spin_lock(&dispatcher->plist_lock);
 
+			/* The rest of the commands get a fresh deadline */
+			if (ret > 0)
+				_sched_arm_deadline(drawctxt, true);
+
 			/*
 			 * Check to seen if the context had been requeued while
 			 * we were processing it (probably by another thread
@@ -839,6 +1004,15 @@ static void _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 
 			spin_unlock(&dispatcher->plist_lock);
 		} else {
+			/*
+			 * Nothing left to meet a deadline for unless somebody
+			 * queued commands (and armed it) in the meantime
+			 */
+			spin_lock(&dispatcher->plist_lock);
+			if (plist_node_empty(&drawctxt->pending))
+				drawctxt->deadline = 0;
+			spin_unlock(&dispatcher->plist_lock);
+
 			/*
 			 * If the context doesn't need be requeued put back the
 			 * refcount
@@ -935,6 +1109,8 @@ int adreno_dispatcher_queue_cmd(struct adreno_device *adreno_dev,
 {
 	struct adreno_dispatcher_cmdqueue *dispatch_q =
 				ADRENO_CMDBATCH_DISPATCH_CMDQUEUE(cmdbatch);
+	/* The cmdbatch may be gone by the time the dispatcher gets kicked */
+	bool defer = test_bit(CMDBATCH_FLAG_DEFER_ISSUE, &cmdbatch->priv);
 	int ret;
 
 	spin_lock(&drawctxt->lock);
@@ -1074,6 +1250,7 @@ int adreno_dispatcher_queue_cmd(struct adreno_device *adreno_dev,
 		cmdbatch->fault_policy = adreno_dev->ft_policy;
 
 	/* Put the command into the queue */
+	cmdbatch->queue_ktime = local_clock();
 	drawctxt->cmdqueue[drawctxt->cmdqueue_tail] = cmdbatch;
 	drawctxt->cmdqueue_tail = (drawctxt->cmdqueue_tail + 1) %
 		ADRENO_CONTEXT_CMDQUEUE_SIZE;
@@ -1115,7 +1292,7 @@ int adreno_dispatcher_queue_cmd(struct adreno_device *adreno_dev,
 	 * queue will try to schedule new commands anyway.
 	 */
 
-	if (dispatch_q->inflight < _context_cmdbatch_burst)
+	if (dispatch_q->inflight < _context_cmdbatch_burst && !defer)
 		adreno_dispatcher_issuecmds(adreno_dev);
 
 	return 0;
@@ -1825,6 +2002,7 @@ static int adreno_dispatch_process_cmdqueue(struct adreno_device *adreno_dev,
 	struct kgsl_device *device = &(adreno_dev->dev);
 	struct adreno_dispatcher *dispatcher = &(adreno_dev->dispatcher);
 	uint64_t start_ticks = 0, retire_ticks = 0;
+	u64 busy;
 
 	struct adreno_dispatcher_cmdqueue *active_q =
 			&(adreno_dev->cur_rb->dispatch_q);
@@ -1879,6 +2057,15 @@ static int adreno_dispatch_process_cmdqueue(struct adreno_device *adreno_dev,
 				(int) dispatcher->inflight, start_ticks,
 				retire_ticks);
 
+			/* Charge the time on the GPU to the context */
+			busy = _sched_charge(dispatcher, dispatch_q, drawctxt,
+				cmdbatch);
+
+			adreno_telemetry_retire(&adreno_dev->telemetry,
+				adreno_dev, drawctxt, cmdbatch, busy);
+
+			_sched_frame(device, drawctxt, cmdbatch, busy);
+
 			/* Record the delta between submit and retire ticks */
 			drawctxt->submit_retire_ticks[drawctxt->ticks_index] =
 				retire_ticks - cmdbatch->submit_ticks;
@@ -2046,6 +2233,39 @@ void adreno_dispatcher_queue_context(struct kgsl_device *device,
 	adreno_dispatcher_schedule(device);
 }
 
+/**
+ * adreno_dispatcher_set_sched() - Set the scheduling hints of a context
+ * @adreno_dev: Pointer to the adreno device struct
+ * @drawctxt: Pointer to the adreno draw context
+ * @weight: Share of GPU time relative to the contexts at the same priority,
+ * 0 for the default
+ * @deadline_us: Deadline hint in microseconds for queued commands, 0 for none
+ */
+int adreno_dispatcher_set_sched(struct adreno_device *adreno_dev,
+		struct adreno_context *drawctxt, unsigned int weight,
+		unsigned int deadline_us)
+{
+	struct adreno_dispatcher *dispatcher = &adreno_dev->dispatcher;
+
+	if (weight == 0)
+		weight = KGSL_SCHED_WEIGHT_DEFAULT;
+
+	if (weight < KGSL_SCHED_WEIGHT_MIN || weight > KGSL_SCHED_WEIGHT_MAX ||
+		deadline_us > USEC_PER_SEC)
+		return -EINVAL;
+
+	spin_lock(&dispatcher->plist_lock);
+	drawctxt->weight = weight;
+	drawctxt->deadline_us = deadline_us;
+	if (!plist_node_empty(&drawctxt->pending))
+		_sched_arm_deadline(drawctxt, true);
+	else
+		drawctxt->deadline = 0;
+	spin_unlock(&dispatcher->plist_lock);
+
+	return 0;
+}
+
 /*
  * This is called on a regular basis while command batches are inflight.  Fault
  * detection registers are read and compared to the existing values - if they
@@ -2238,6 +2458,10 @@ static DISPATCHER_UINT_ATTR(fault_throttle_time, 0644, 0,
 	_fault_throttle_time);
 static DISPATCHER_UINT_ATTR(fault_throttle_burst, 0644, 0,
 	_fault_throttle_burst);
+static DISPATCHER_UINT_ATTR(context_inflight_budget, 0644,
+	ADRENO_DISPATCH_CMDQUEUE_SIZE, _context_inflight_budget);
+static DISPATCHER_UINT_ATTR(context_deadline_credit, 0644, 0,
+	_context_deadline_credit);
 
 static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_inflight.attr,
@@ -2249,6 +2473,8 @@ static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_fault_detect_interval.attr,
 	&dispatcher_attr_fault_throttle_time.attr,
 	&dispatcher_attr_fault_throttle_burst.attr,
+	&dispatcher_attr_context_inflight_budget.attr,
+	&dispatcher_attr_context_deadline_credit.attr,
 	NULL,
 };
 
@@ -40,6 +40,7 @@ struct adreno_context_list {
  * @tail: Queues tail pointer
  * @active_contexts: List of most recently seen contexts
  * @active_context_count: Number of active contexts in the active_contexts list
+ * @retire_ktime: local_clock() time the last command batch in the q retired
  */
 struct adreno_dispatcher_cmdqueue {
 	struct kgsl_cmdbatch *cmd_q[ADRENO_DISPATCH_CMDQUEUE_SIZE];
@@ -48,6 +49,7 @@ struct adreno_dispatcher_cmdqueue {
 	unsigned int tail;
 	struct adreno_context_list active_contexts[ACTIVE_CONTEXT_LIST_MAX];
 	int active_context_count;
+	u64 retire_ktime;
 };
 
 /**
@@ -62,6 +64,8 @@ struct adreno_dispatcher_cmdqueue {
  * @work: work_struct to put the dispatcher in a work queue
  * @kobj: kobject for the dispatcher directory in the device sysfs node
  * @idle_gate: Gate to wait on for dispatcher to idle
+ * @vtime_floor: Virtual time of the last context picked, contexts joining
+ * the pending list start from here. Protected by plist_lock.
  */
 struct adreno_dispatcher {
 	struct mutex mutex;
@@ -75,6 +79,7 @@ struct adreno_dispatcher {
 	struct work_struct work;
 	struct kobject kobj;
 	struct completion idle_gate;
+	u64 vtime_floor;
 };
 
 enum adreno_dispatcher_flags {
@@ -97,5 +102,8 @@ void adreno_dispatcher_schedule(struct kgsl_device *device);
 void adreno_dispatcher_pause(struct adreno_device *adreno_dev);
 void adreno_dispatcher_queue_context(struct kgsl_device *device,
 		struct adreno_context *drawctxt);
+int adreno_dispatcher_set_sched(struct adreno_device *adreno_dev,
+		struct adreno_context *drawctxt, unsigned int weight,
+		unsigned int deadline_us);
 
 #endif /* __ADRENO_DISPATCHER_H */
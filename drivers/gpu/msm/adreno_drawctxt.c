@@ -390,6 +390,7 @@ adreno_drawctxt_create(struct kgsl_device_private *dev_priv,
 	 * drawctxt pending list based on priority.
 	 */
 	plist_node_init(&drawctxt->pending, drawctxt->base.priority);
+	drawctxt->weight = KGSL_SCHED_WEIGHT_DEFAULT;
 
 	kgsl_sharedmem_writel(device, &device->memstore,
 			KGSL_MEMSTORE_OFFSET(drawctxt->base.id, soptimestamp),
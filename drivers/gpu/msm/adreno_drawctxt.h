@@ -13,6 +13,7 @@
 #ifndef __ADRENO_DRAWCTXT_H
 #define __ADRENO_DRAWCTXT_H
 
+#include <linux/msm_kgsl_sched.h>
 #include "adreno_pm4types.h"
 
 struct adreno_context_type {
@@ -51,6 +52,14 @@ struct kgsl_context;
  *                       to retire
  * @ticks_index: The index into submit_retire_ticks[] where the new delta will
  *		 be written.
+ * @weight: Share of GPU time relative to contexts of the same priority
+ * @deadline_us: Userspace deadline hint for queued commands, 0 if none
+ * @deadline: local_clock() time by which the pending commands should be sent
+ * @vtime: GPU time consumed scaled by the weight, guarded by the dispatcher
+ *	   plist_lock
+ * @gpu_time: Total GPU time consumed by the context in ns
+ * @frame_time: GPU time of the frame being retired in ns
+ * @frame_end: local_clock() time the previous frame retired at
  */
 struct adreno_context {
 	struct kgsl_context base;
@@ -76,6 +85,13 @@ struct adreno_context {
 	unsigned int submitted_timestamp;
 	uint64_t submit_retire_ticks[SUBMIT_RETIRE_TICKS_SIZE];
 	int ticks_index;
+	unsigned int weight;
+	unsigned int deadline_us;
+	u64 deadline;
+	u64 vtime;
+	u64 gpu_time;
+	u64 frame_time;
+	u64 frame_end;
 };
 
 /* Flag definitions for flag field in adreno_context */
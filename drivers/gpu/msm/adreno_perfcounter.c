@@ -357,6 +357,37 @@ done:
 	return ret;
 }
 
+/**
+ * adreno_perfcounter_read() - Read the counter a countable is assigned to
+ * @adreno_dev: Adreno device
+ * @groupid: Performance counter group
+ * @countable: Countable assigned to a counter of the group
+ *
+ * Return the 64 bit value of the counter or 0 if the countable is not
+ * assigned. The caller has to make sure that the GPU is powered.
+ */
+uint64_t adreno_perfcounter_read(struct adreno_device *adreno_dev,
+	unsigned int groupid, unsigned int countable)
+{
+	struct adreno_gpudev *gpudev = ADRENO_GPU_DEVICE(adreno_dev);
+	struct adreno_perfcounters *counters = gpudev->perfcounters;
+	struct adreno_perfcount_group *group;
+	unsigned int i;
+
+	if (counters == NULL || groupid >= counters->group_count ||
+		gpudev->perfcounter_read == NULL)
+		return 0;
+
+	group = &(counters->groups[groupid]);
+
+	for (i = 0; i < group->reg_count; i++) {
+		if (group->regs[i].countable == countable)
+			return gpudev->perfcounter_read(adreno_dev, groupid, i);
+	}
+
+	return 0;
+}
+
 /**
  * adreno_perfcounter_get_groupid() - Get the performance counter ID
  * @adreno_dev: Adreno device
@@ -13,6 +13,7 @@
 #ifndef __ADRENO_PROFILE_H
 #define __ADRENO_PROFILE_H
 #include <linux/seq_file.h>
+#include <linux/sched.h>
 
 /**
  * struct adreno_profile_assigns_list: linked list for assigned perf counters
@@ -90,6 +91,32 @@ static inline void adreno_profile_postib_processing(
 		unsigned int *cmd_flags, unsigned int **rbptr) { }
 #endif
 
+/**
+ * adreno_profile_cmdbatch_gpu_time() - Account the GPU time of a command batch
+ * @dispatch_q: Dispatcher queue the command batch retired from
+ * @drawctxt: Context the command batch belongs to
+ * @cmdbatch: The retired command batch
+ *
+ * A ringbuffer executes in order, so the command batch has occupied the
+ * GPU from the later of its submission and the previous retirement on the
+ * same queue until now. Add that to the GPU time of the context and return
+ * it in nanoseconds.
+ */
+static inline u64 adreno_profile_cmdbatch_gpu_time(
+		struct adreno_dispatcher_cmdqueue *dispatch_q,
+		struct adreno_context *drawctxt,
+		struct kgsl_cmdbatch *cmdbatch)
+{
+	u64 now = local_clock();
+	u64 start = max(cmdbatch->submit_ktime, dispatch_q->retire_ktime);
+	u64 ns = (now > start) ? now - start : 0;
+
+	dispatch_q->retire_ktime = now;
+	drawctxt->gpu_time += ns;
+
+	return ns;
+}
+
 static inline bool adreno_profile_enabled(struct adreno_profile *profile)
 {
 	return profile->enabled;
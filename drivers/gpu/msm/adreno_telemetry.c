@@ -0,0 +1,446 @@
+/* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/sysfs.h>
+
+#include "adreno.h"
+#include "adreno_telemetry.h"
+
+/*
+ * Sampled GPU telemetry. Unlike the debugfs profiling in adreno_profile.c
+ * nothing is added to the command stream: the dispatcher accounts every
+ * retired command batch and one in "sample" of them is written into a
+ * per-CPU ring together with the deltas of a few kernel owned performance
+ * counters. The rings are mapped by userspace through the telemetry/ring
+ * sysfs file and never read by the kernel.
+ */
+
+#define TELEMETRY_NUM_RECORDS \
+	((KGSL_TELEMETRY_RING_SIZE - \
+		sizeof(struct kgsl_telemetry_ring_header)) / \
+		sizeof(struct kgsl_telemetry_record))
+
+#define COUNTER_STR_FORMAT "%.8s:%u "
+
+static inline struct kgsl_telemetry_ring_header *
+_telemetry_ring(struct adreno_telemetry *telemetry, unsigned int cpu)
+{
+	return telemetry->buffer + cpu * KGSL_TELEMETRY_RING_SIZE;
+}
+
+/* Allocate the rings the first time the telemetry is turned on */
+static int _telemetry_alloc(struct adreno_telemetry *telemetry)
+{
+	size_t size = nr_cpu_ids * KGSL_TELEMETRY_RING_SIZE;
+	void *buffer;
+	unsigned int cpu;
+
+	if (ACCESS_ONCE(telemetry->buffer))
+		return 0;
+
+	buffer = vmalloc_user(size);
+	if (buffer == NULL)
+		return -ENOMEM;
+
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++) {
+		struct kgsl_telemetry_ring_header *header =
+			buffer + cpu * KGSL_TELEMETRY_RING_SIZE;
+
+		header->version = KGSL_TELEMETRY_VERSION;
+		header->record_size = sizeof(struct kgsl_telemetry_record);
+		header->num_records = TELEMETRY_NUM_RECORDS;
+		header->cpu = cpu;
+	}
+
+	spin_lock(&telemetry->lock);
+	if (telemetry->buffer == NULL) {
+		telemetry->size = size;
+		telemetry->buffer = buffer;
+		buffer = NULL;
+	}
+	spin_unlock(&telemetry->lock);
+
+	vfree(buffer);
+	return 0;
+}
+
+/* Return the delta of the counter since the last call and remember it */
+static uint64_t _telemetry_counter_delta(struct adreno_device *adreno_dev,
+		struct adreno_telemetry_counter *counter)
+{
+	uint64_t value = adreno_perfcounter_read(adreno_dev, counter->groupid,
+		counter->countable);
+	uint64_t delta = (value >= counter->last) ? value - counter->last :
+		value;
+
+	counter->last = value;
+	return delta;
+}
+
+/**
+ * __adreno_telemetry_retire() - Account a retired command batch and write a
+ * record if it is sampled
+ * @adreno_dev: The device
+ * @drawctxt: Context of the command batch
+ * @cmdbatch: The retired command batch
+ * @busy: GPU time of the command batch in ns
+ *
+ * Called from the dispatcher with the GPU powered.
+ */
+void __adreno_telemetry_retire(struct adreno_device *adreno_dev,
+		struct adreno_context *drawctxt, struct kgsl_cmdbatch *cmdbatch,
+		u64 busy)
+{
+	struct adreno_telemetry *telemetry = &adreno_dev->telemetry;
+	struct kgsl_telemetry_ring_header *header;
+	struct kgsl_telemetry_record *record;
+	u64 now = local_clock();
+	u64 queued = cmdbatch->queue_ktime;
+	u64 submitted = cmdbatch->submit_ktime;
+	unsigned int i;
+
+	spin_lock(&telemetry->lock);
+
+	if (telemetry->buffer == NULL || telemetry->sample == 0 ||
+		++telemetry->retired < telemetry->sample)
+		goto done;
+
+	header = _telemetry_ring(telemetry, smp_processor_id());
+	record = (struct kgsl_telemetry_record *) (header + 1) +
+		(header->head % TELEMETRY_NUM_RECORDS);
+
+	record->time = now;
+	record->busy = busy;
+	record->context_busy = drawctxt->gpu_time;
+	record->queue_latency = (submitted > queued) ? submitted - queued : 0;
+	record->retire_latency = (now > submitted) ? now - submitted : 0;
+	record->context_id = drawctxt->base.id;
+	record->timestamp = cmdbatch->timestamp;
+	record->pid = drawctxt->base.proc_priv->pid;
+	record->retired = telemetry->retired;
+
+	for (i = 0; i < KGSL_TELEMETRY_MAX_COUNTERS; i++)
+		record->counters[i] = (i < telemetry->num_counters) ?
+			_telemetry_counter_delta(adreno_dev,
+				&telemetry->counters[i]) : 0;
+
+	/* Make the record visible before the new head */
+	smp_wmb();
+	header->head++;
+
+	telemetry->retired = 0;
+done:
+	spin_unlock(&telemetry->lock);
+}
+
+/* Release the counters held by the telemetry, called with the device mutex */
+static void _telemetry_put_counters(struct adreno_device *adreno_dev)
+{
+	struct adreno_telemetry *telemetry = &adreno_dev->telemetry;
+	unsigned int i, count;
+
+	spin_lock(&telemetry->lock);
+	count = telemetry->num_counters;
+	telemetry->num_counters = 0;
+	spin_unlock(&telemetry->lock);
+
+	for (i = 0; i < count; i++)
+		adreno_perfcounter_put(adreno_dev,
+			telemetry->counters[i].groupid,
+			telemetry->counters[i].countable,
+			PERFCOUNTER_FLAG_KERNEL);
+}
+
+/*
+ * Replace the sampled counters with the ones in buf, a list of
+ * "group:countable" pairs as used by the profiling assignments
+ */
+static int _telemetry_set_counters(struct adreno_device *adreno_dev,
+		const char *buf)
+{
+	struct kgsl_device *device = &adreno_dev->dev;
+	struct adreno_telemetry *telemetry = &adreno_dev->telemetry;
+	struct adreno_telemetry_counter counters[KGSL_TELEMETRY_MAX_COUNTERS];
+	unsigned int count = 0, i;
+	char *str, *tmp, *token;
+	int ret = 0;
+
+	str = kstrdup(buf, GFP_KERNEL);
+	if (str == NULL)
+		return -ENOMEM;
+
+	tmp = str;
+	while ((token = strsep(&tmp, " ,\n")) != NULL) {
+		char name[16];
+		unsigned int countable;
+		int groupid;
+
+		if (*token == '\0')
+			continue;
+
+		if (count == KGSL_TELEMETRY_MAX_COUNTERS ||
+			sscanf(token, "%15[^:]:%u", name, &countable) != 2) {
+			ret = -EINVAL;
+			goto out;
+		}
+
+		groupid = adreno_perfcounter_get_groupid(adreno_dev, name);
+		if (groupid < 0) {
+			ret = -EINVAL;
+			goto out;
+		}
+
+		counters[count].groupid = groupid;
+		counters[count].countable = countable;
+		counters[count].last = 0;
+		count++;
+	}
+
+	mutex_lock(&device->mutex);
+
+	ret = kgsl_active_count_get(device);
+	if (ret)
+		goto unlock;
+
+	_telemetry_put_counters(adreno_dev);
+
+	for (i = 0; i < count; i++) {
+		ret = adreno_perfcounter_get(adreno_dev, counters[i].groupid,
+			counters[i].countable, NULL, NULL,
+			PERFCOUNTER_FLAG_KERNEL);
+		if (ret) {
+			while (i--)
+				adreno_perfcounter_put(adreno_dev,
+					counters[i].groupid,
+					counters[i].countable,
+					PERFCOUNTER_FLAG_KERNEL);
+			goto put;
+		}
+
+		counters[i].last = adreno_perfcounter_read(adreno_dev,
+			counters[i].groupid, counters[i].countable);
+	}
+
+	spin_lock(&telemetry->lock);
+	memcpy(telemetry->counters, counters, count * sizeof(counters[0]));
+	telemetry->num_counters = count;
+	spin_unlock(&telemetry->lock);
+
+put:
+	kgsl_active_count_put(device);
+unlock:
+	mutex_unlock(&device->mutex);
+out:
+	kfree(str);
+	return ret;
+}
+
+struct telemetry_attribute {
+	struct attribute attr;
+	ssize_t (*show)(struct adreno_device *adreno_dev, char *buf);
+	ssize_t (*store)(struct adreno_device *adreno_dev, const char *buf,
+		size_t count);
+};
+
+#define to_telemetry_attr(a) \
+	container_of(a, struct telemetry_attribute, attr)
+
+static inline struct adreno_device *kobj_to_adreno(struct kobject *kobj)
+{
+	return container_of(kobj, struct adreno_device, telemetry.kobj);
+}
+
+#define TELEMETRY_ATTR(_name, _mode, _show, _store) \
+struct telemetry_attribute attr_##_name = { \
+	.attr = { .name = __stringify(_name), .mode = _mode }, \
+	.show = _show, \
+	.store = _store, \
+}
+
+static ssize_t sample_show(struct adreno_device *adreno_dev, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", adreno_dev->telemetry.sample);
+}
+
+static ssize_t sample_store(struct adreno_device *adreno_dev,
+		const char *buf, size_t count)
+{
+	struct adreno_telemetry *telemetry = &adreno_dev->telemetry;
+	unsigned int val = 0;
+	int ret;
+
+	ret = kgsl_sysfs_store(buf, &val);
+	if (ret)
+		return ret;
+
+	if (val) {
+		ret = _telemetry_alloc(telemetry);
+		if (ret)
+			return ret;
+	}
+
+	spin_lock(&telemetry->lock);
+	telemetry->sample = val;
+	telemetry->retired = 0;
+	spin_unlock(&telemetry->lock);
+
+	return count;
+}
+
+static ssize_t counters_show(struct adreno_device *adreno_dev, char *buf)
+{
+	struct adreno_telemetry *telemetry = &adreno_dev->telemetry;
+	ssize_t len = 0;
+	unsigned int i;
+
+	spin_lock(&telemetry->lock);
+	for (i = 0; i < telemetry->num_counters; i++)
+		len += snprintf(buf + len, PAGE_SIZE - len, COUNTER_STR_FORMAT,
+			adreno_perfcounter_get_name(adreno_dev,
+				telemetry->counters[i].groupid),
+			telemetry->counters[i].countable);
+	spin_unlock(&telemetry->lock);
+
+	len += snprintf(buf + len, PAGE_SIZE - len, "\n");
+	return len;
+}
+
+static ssize_t counters_store(struct adreno_device *adreno_dev,
+		const char *buf, size_t count)
+{
+	int ret = _telemetry_set_counters(adreno_dev, buf);
+
+	return ret ? ret : count;
+}
+
+static TELEMETRY_ATTR(sample, 0644, sample_show, sample_store);
+static TELEMETRY_ATTR(counters, 0644, counters_show, counters_store);
+
+static struct attribute *telemetry_attrs[] = {
+	&attr_sample.attr,
+	&attr_counters.attr,
+	NULL,
+};
+
+static ssize_t telemetry_sysfs_show(struct kobject *kobj,
+	struct attribute *attr, char *buf)
+{
+	struct telemetry_attribute *pattr = to_telemetry_attr(attr);
+	ssize_t ret = -EIO;
+
+	if (pattr->show)
+		ret = pattr->show(kobj_to_adreno(kobj), buf);
+
+	return ret;
+}
+
+static ssize_t telemetry_sysfs_store(struct kobject *kobj,
+	struct attribute *attr, const char *buf, size_t count)
+{
+	struct telemetry_attribute *pattr = to_telemetry_attr(attr);
+	ssize_t ret = -EIO;
+
+	if (pattr->store)
+		ret = pattr->store(kobj_to_adreno(kobj), buf, count);
+
+	return ret;
+}
+
+static void telemetry_sysfs_release(struct kobject *kobj)
+{
+}
+
+static const struct sysfs_ops telemetry_sysfs_ops = {
+	.show = telemetry_sysfs_show,
+	.store = telemetry_sysfs_store,
+};
+
+static struct kobj_type ktype_telemetry = {
+	.sysfs_ops = &telemetry_sysfs_ops,
+	.default_attrs = telemetry_attrs,
+	.release = telemetry_sysfs_release,
+};
+
+/* Map the rings read only into the caller */
+static int ring_mmap(struct file *filep, struct kobject *kobj,
+		struct bin_attribute *attr, struct vm_area_struct *vma)
+{
+	struct adreno_telemetry *telemetry = &kobj_to_adreno(kobj)->telemetry;
+	void *buffer = ACCESS_ONCE(telemetry->buffer);
+
+	if (buffer == NULL)
+		return -ENODEV;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_vmalloc_range(vma, buffer, vma->vm_pgoff);
+}
+
+static struct bin_attribute ring_attr = {
+	.attr.name = "ring",
+	.attr.mode = 0444,
+	.size = 0,
+	.mmap = ring_mmap,
+};
+
+/**
+ * adreno_telemetry_init() - Create the telemetry sysfs files
+ * @adreno_dev: The device
+ *
+ * The telemetry starts out off and its rings are only allocated once it
+ * is turned on.
+ */
+int adreno_telemetry_init(struct adreno_device *adreno_dev)
+{
+	struct kgsl_device *device = &adreno_dev->dev;
+	struct adreno_telemetry *telemetry = &adreno_dev->telemetry;
+	int ret;
+
+	spin_lock_init(&telemetry->lock);
+
+	ret = kobject_init_and_add(&telemetry->kobj, &ktype_telemetry,
+		&device->dev->kobj, "telemetry");
+	if (ret)
+		return ret;
+
+	return sysfs_create_bin_file(&telemetry->kobj, &ring_attr);
+}
+
+/**
+ * adreno_telemetry_close() - Remove the telemetry sysfs files and free the
+ * rings
+ * @adreno_dev: The device
+ */
+void adreno_telemetry_close(struct adreno_device *adreno_dev)
+{
+	struct adreno_telemetry *telemetry = &adreno_dev->telemetry;
+
+	sysfs_remove_bin_file(&telemetry->kobj, &ring_attr);
+	kobject_put(&telemetry->kobj);
+
+	spin_lock(&telemetry->lock);
+	telemetry->sample = 0;
+	spin_unlock(&telemetry->lock);
+
+	vfree(telemetry->buffer);
+	telemetry->buffer = NULL;
+	telemetry->size = 0;
+}
@@ -0,0 +1,88 @@
+/* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#ifndef __ADRENO_TELEMETRY_H
+#define __ADRENO_TELEMETRY_H
+
+#include <linux/kobject.h>
+#include <linux/spinlock.h>
+#include <linux/msm_kgsl_telemetry.h>
+
+struct adreno_device;
+struct adreno_context;
+struct kgsl_cmdbatch;
+
+/**
+ * struct adreno_telemetry_counter - a performance counter sampled by the
+ * telemetry
+ * @groupid: Performance counter group
+ * @countable: Countable assigned to a counter of the group
+ * @last: Value of the counter at the previous record
+ */
+struct adreno_telemetry_counter {
+	unsigned int groupid;
+	unsigned int countable;
+	uint64_t last;
+};
+
+/**
+ * struct adreno_telemetry - sampled always-on GPU telemetry
+ * @kobj: The telemetry sysfs directory
+ * @lock: Protects the counters and the rings
+ * @buffer: vmalloc_user() buffer holding one ring per possible CPU
+ * @size: Size of @buffer
+ * @sample: Write a record for one in @sample retired command batches, 0 to
+ * turn the telemetry off
+ * @retired: Command batches retired since the last record
+ * @num_counters: Number of entries used in @counters
+ * @counters: Performance counters whose deltas are recorded
+ */
+struct adreno_telemetry {
+	struct kobject kobj;
+	spinlock_t lock;
+	void *buffer;
+	size_t size;
+	unsigned int sample;
+	unsigned int retired;
+	unsigned int num_counters;
+	struct adreno_telemetry_counter counters[KGSL_TELEMETRY_MAX_COUNTERS];
+};
+
+int adreno_telemetry_init(struct adreno_device *adreno_dev);
+void adreno_telemetry_close(struct adreno_device *adreno_dev);
+void __adreno_telemetry_retire(struct adreno_device *adreno_dev,
+		struct adreno_context *drawctxt, struct kgsl_cmdbatch *cmdbatch,
+		u64 busy);
+
+/**
+ * adreno_telemetry_retire() - Account a retired command batch
+ * @telemetry: The telemetry of the device
+ * @adreno_dev: The device
+ * @drawctxt: Context of the command batch
+ * @cmdbatch: The retired command batch
+ * @busy: GPU time of the command batch in ns
+ *
+ * Called by the dispatcher for every retired command batch, costs a single
+ * load while the telemetry is off.
+ */
+static inline void adreno_telemetry_retire(struct adreno_telemetry *telemetry,
+		struct adreno_device *adreno_dev,
+		struct adreno_context *drawctxt, struct kgsl_cmdbatch *cmdbatch,
+		u64 busy)
+{
+	if (likely(ACCESS_ONCE(telemetry->sample) == 0))
+		return;
+
+	__adreno_telemetry_retire(adreno_dev, drawctxt, cmdbatch, busy);
+}
+
+#endif /* __ADRENO_TELEMETRY_H */
@@ -30,6 +30,7 @@
 #include <linux/sort.h>
 #include <linux/security.h>
 #include <linux/compat.h>
+#include <linux/msm_kgsl_submit.h>
 #include <asm/cacheflush.h>
 
 #include "kgsl.h"
@@ -40,6 +41,7 @@
 #include "kgsl_device.h"
 #include "kgsl_trace.h"
 #include "kgsl_sync.h"
+#include "kgsl_pool.h"
 #include "adreno.h"
 #include "kgsl_compat.h"
 
@@ -402,6 +404,38 @@ kgsl_mem_entry_untrack_gpuaddr(struct kgsl_process_private *process,
 	}
 }
 
+/*
+ * Add (sign 1) or remove (sign -1) the entry from the GPU memory counters of
+ * its process
+ */
+static void kgsl_mem_entry_account(struct kgsl_mem_entry *entry, long sign)
+{
+	struct kgsl_process_private *private = entry->priv;
+	long size = sign * (long) entry->memdesc.size;
+
+	atomic_long_add(size, &private->gpumem.total);
+	if (kgsl_memdesc_is_reclaimable(&entry->memdesc))
+		atomic_long_add(size, &private->gpumem.reclaimable);
+}
+
+/*
+ * The vmas mapping an entry hold a reference to it so the entry, and with it
+ * entry->priv, stays around until the last one is closed
+ */
+static void kgsl_mem_entry_map_user(struct kgsl_mem_entry *entry)
+{
+	if (atomic_inc_return(&entry->map_count) == 1)
+		atomic_long_add(entry->memdesc.size,
+			&entry->priv->gpumem.mapped);
+}
+
+static void kgsl_mem_entry_unmap_user(struct kgsl_mem_entry *entry)
+{
+	if (atomic_dec_and_test(&entry->map_count))
+		atomic_long_sub(entry->memdesc.size,
+			&entry->priv->gpumem.mapped);
+}
+
 /**
  * kgsl_mem_entry_attach_process - Attach a mem_entry to its owner process
  * @entry: the memory entry
@@ -448,6 +482,9 @@ kgsl_mem_entry_attach_process(struct kgsl_mem_entry *entry,
 	spin_unlock(&process->mem_lock);
 	if (ret)
 		goto err_put_proc_priv;
+
+	kgsl_mem_entry_account(entry, 1);
+
 	/* map the memory after unlocking if gpuaddr has been assigned */
 	if (entry->memdesc.gpuaddr) {
 		/* if a secured buffer map it to secure global pagetable */
@@ -489,6 +526,7 @@ static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry)
 	type = kgsl_memdesc_usermem_type(&entry->memdesc);
 	entry->priv->stats[type].cur -= entry->memdesc.size;
 	spin_unlock(&entry->priv->mem_lock);
+	kgsl_mem_entry_account(entry, -1);
 	kgsl_process_private_put(entry->priv);
 
 	entry->priv = NULL;
@@ -864,7 +902,8 @@ static void kgsl_destroy_process_private(struct kref *kref)
 	idr_destroy(&private->syncsource_idr);
 	kgsl_mmu_putpagetable(private->pagetable);
 
-	kfree(private);
+	/* kgsl_process_reclaimable_pages() may still be looking at it */
+	kfree_rcu(private, rcu);
 	return;
 }
 
@@ -897,6 +936,35 @@ struct kgsl_process_private *kgsl_process_private_find(pid_t pid)
 	return private;
 }
 
+/**
+ * kgsl_process_reclaimable_pages() - Return the number of pages that killing
+ * a process would give back
+ * @pid: tgid of the process
+ *
+ * Returns the pages of the GPU buffers the process has allocated from kgsl,
+ * which go back to the page pools or the page allocator when it dies. The
+ * lookup doesn't sleep and takes no locks so that the lowmemorykiller can
+ * call it for every candidate from within rcu_read_lock().
+ */
+unsigned long kgsl_process_reclaimable_pages(pid_t pid)
+{
+	struct kgsl_process_private *private;
+	unsigned long pages = 0;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(private, &kgsl_driver.process_list, list) {
+		if (private->pid == pid) {
+			pages = atomic_long_read(
+				&private->gpumem.reclaimable) >> PAGE_SHIFT;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	return pages;
+}
+EXPORT_SYMBOL(kgsl_process_reclaimable_pages);
+
 static struct kgsl_process_private *kgsl_process_private_new(
 		struct kgsl_device *device)
 {
@@ -1015,7 +1083,7 @@ static void kgsl_process_private_close(struct kgsl_device_private *dev_priv,
 	kgsl_mmu_detach_pagetable(private->pagetable);
 
 	/* Remove the process struct from the master list */
-	list_del(&private->list);
+	list_del_rcu(&private->list);
 
 	/*
 	 * Unlock the mutex before releasing the memory - this prevents a
@@ -1061,7 +1129,7 @@ static struct kgsl_process_private *kgsl_process_private_open(
 			goto done;
 		}
 
-		list_add(&private->list, &kgsl_driver.process_list);
+		list_add_rcu(&private->list, &kgsl_driver.process_list);
 	}
 
 done:
@@ -2432,10 +2500,26 @@ done:
 	return result;
 }
 
-long kgsl_ioctl_submit_commands(struct kgsl_device_private *dev_priv,
-				      unsigned int cmd, void *data)
+/*
+ * _kgsl_submit_commands() - Create, verify and queue one command batch
+ * @dev_priv: Pointer to the private device structure
+ * @context_id: Context the command batch is for
+ * @flags: Flags passed in from the user command
+ * @cmdlist: Pointer to the list of commands from the user
+ * @numcmds: Number of commands in the list
+ * @synclist: Pointer to the list of syncpoints from the user
+ * @numsyncs: Number of syncpoints in the list
+ * @timestamp: Requested timestamp in, assigned timestamp out
+ * @defer: Leave it to the caller to kick the device afterwards
+ *
+ * Shared by IOCTL_KGSL_SUBMIT_COMMANDS and IOCTL_KGSL_SUBMIT_BATCH.
+ */
+static long _kgsl_submit_commands(struct kgsl_device_private *dev_priv,
+		unsigned int context_id, unsigned int flags,
+		void __user *cmdlist, unsigned int numcmds,
+		void __user *synclist, unsigned int numsyncs,
+		unsigned int *timestamp, bool defer)
 {
-	struct kgsl_submit_commands *param = data;
 	struct kgsl_device *device = dev_priv->device;
 	struct kgsl_context *context;
 	struct kgsl_cmdbatch *cmdbatch;
@@ -2450,21 +2534,20 @@ long kgsl_ioctl_submit_commands(struct kgsl_device_private *dev_priv,
 	 * specified a sane number of IBs
 	 */
 
-	if ((param->flags & KGSL_CMDBATCH_SYNC) && param->numcmds)
+	if ((flags & KGSL_CMDBATCH_SYNC) && numcmds)
 		KGSL_DEV_ERR_ONCE(device,
 			"Commands specified with the SYNC flag.  They will be ignored\n");
-	else if (param->numcmds > KGSL_MAX_NUMIBS)
+	else if (numcmds > KGSL_MAX_NUMIBS)
 		return -EINVAL;
-	else if (!(param->flags & KGSL_CMDBATCH_SYNC) && param->numcmds == 0)
-		param->flags |= KGSL_CMDBATCH_MARKER;
+	else if (!(flags & KGSL_CMDBATCH_SYNC) && numcmds == 0)
+		flags |= KGSL_CMDBATCH_MARKER;
 
-	context = kgsl_context_get_owner(dev_priv, param->context_id);
+	context = kgsl_context_get_owner(dev_priv, context_id);
 	if (context == NULL)
 		return -EINVAL;
 
-	cmdbatch = _kgsl_cmdbatch_create(device, context, param->flags,
-		param->cmdlist, param->numcmds,
-		param->synclist, param->numsyncs);
+	cmdbatch = _kgsl_cmdbatch_create(device, context, flags,
+		cmdlist, numcmds, synclist, numsyncs);
 
 	if (IS_ERR(cmdbatch)) {
 		result = PTR_ERR(cmdbatch);
@@ -2475,8 +2558,11 @@ long kgsl_ioctl_submit_commands(struct kgsl_device_private *dev_priv,
 	if (!_kgsl_cmdbatch_verify(dev_priv, cmdbatch))
 		goto free_cmdbatch;
 
+	if (defer)
+		set_bit(CMDBATCH_FLAG_DEFER_ISSUE, &cmdbatch->priv);
+
 	result = dev_priv->device->ftbl->issueibcmds(dev_priv, context,
-		cmdbatch, &param->timestamp);
+		cmdbatch, timestamp);
 
 free_cmdbatch:
 	/*
@@ -2491,6 +2577,112 @@ done:
 	return result;
 }
 
+long kgsl_ioctl_submit_commands(struct kgsl_device_private *dev_priv,
+				      unsigned int cmd, void *data)
+{
+	struct kgsl_submit_commands *param = data;
+
+	return _kgsl_submit_commands(dev_priv, param->context_id,
+		param->flags, param->cmdlist, param->numcmds,
+		param->synclist, param->numsyncs, &param->timestamp, false);
+}
+
+/*
+ * Queue several command batches with one call. All but the last one are
+ * queued without kicking the dispatcher so that it gets to submit the
+ * whole lot in one pass, and the fences are only created once all the
+ * commands are on their way.
+ */
+long kgsl_ioctl_submit_batch(struct kgsl_device_private *dev_priv,
+				      unsigned int cmd, void *data)
+{
+	struct kgsl_submit_batch *param = data;
+	struct kgsl_device *device = dev_priv->device;
+	struct kgsl_submit_batch_entry __user *uentries =
+		(struct kgsl_submit_batch_entry __user *)
+			(uintptr_t) param->entries;
+	struct kgsl_submit_batch_entry *entries;
+	struct kgsl_context *context;
+	unsigned int last = 0;
+	long result = 0;
+	int i;
+
+	param->submitted = 0;
+
+	if (param->count == 0 || param->count > KGSL_SUBMIT_BATCH_MAX)
+		return -EINVAL;
+
+	entries = kcalloc(param->count, sizeof(*entries), GFP_KERNEL);
+	if (entries == NULL)
+		return -ENOMEM;
+
+	if (copy_from_user(entries, uentries,
+		param->count * sizeof(*entries))) {
+		result = -EFAULT;
+		goto done;
+	}
+
+	for (i = 0; i < param->count; i++) {
+		struct kgsl_submit_batch_entry *e = &entries[i];
+
+		e->fence_fd = -1;
+		e->result = _kgsl_submit_commands(dev_priv, e->context_id,
+			e->flags, (void __user *)(uintptr_t) e->cmdlist,
+			e->numcmds, (void __user *)(uintptr_t) e->synclist,
+			e->numsyncs, &e->timestamp, i < param->count - 1);
+
+		param->submitted++;
+
+		if (e->result && e->result != -EPROTO) {
+			result = e->result;
+			break;
+		}
+
+		last = i + 1;
+	}
+
+	/*
+	 * If the batch stopped early the dispatcher has not been told about
+	 * the commands queued so far, do it now
+	 */
+	if (last && last < param->count && device->ftbl->drawctxt_sched) {
+		context = kgsl_context_get_owner(dev_priv,
+			entries[last - 1].context_id);
+		if (context) {
+			device->ftbl->drawctxt_sched(device, context);
+			kgsl_context_put(context);
+		}
+	}
+
+	if (copy_to_user(uentries, entries,
+		param->submitted * sizeof(*entries))) {
+		result = -EFAULT;
+		goto done;
+	}
+
+	/* The fence fds go straight to the user copy of the entries */
+	for (i = 0; i < last; i++) {
+		struct kgsl_submit_batch_entry *e = &entries[i];
+		long ret;
+
+		if (!(e->request & KGSL_SUBMIT_BATCH_FENCE) ||
+			(e->flags & KGSL_CMDBATCH_SYNC))
+			continue;
+
+		ret = kgsl_add_fence_event(device, e->context_id,
+			e->timestamp, &uentries[i].fence_fd,
+			sizeof(struct kgsl_timestamp_event_fence), dev_priv);
+		if (ret) {
+			result = ret;
+			break;
+		}
+	}
+
+done:
+	kfree(entries);
+	return result;
+}
+
 long kgsl_ioctl_cmdstream_readtimestamp_ctxtid(struct kgsl_device_private
 						*dev_priv, unsigned int cmd,
 						void *data)
@@ -3830,6 +4022,8 @@ static const struct kgsl_ioctl kgsl_ioctl_funcs[] = {
 			kgsl_ioctl_syncsource_create_fence),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_SYNCSOURCE_SIGNAL_FENCE,
 			kgsl_ioctl_syncsource_signal_fence),
+	KGSL_IOCTL_FUNC(IOCTL_KGSL_SUBMIT_BATCH,
+			kgsl_ioctl_submit_batch),
 };
 
 long kgsl_ioctl_helper(struct file *filep, unsigned int cmd,
@@ -3969,6 +4163,8 @@ static void kgsl_gpumem_vm_open(struct vm_area_struct *vma)
 
 	if (kgsl_mem_entry_get(entry) == 0)
 		vma->vm_private_data = NULL;
+	else
+		kgsl_mem_entry_map_user(entry);
 }
 
 static int
@@ -3993,6 +4189,7 @@ kgsl_gpumem_vm_close(struct vm_area_struct *vma)
 		return;
 
 	entry->memdesc.useraddr = 0;
+	kgsl_mem_entry_unmap_user(entry);
 	kgsl_mem_entry_put(entry);
 }
 
@@ -4509,6 +4706,7 @@ static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 	vma->vm_file = file;
 
 	entry->memdesc.useraddr = vma->vm_start;
+	kgsl_mem_entry_map_user(entry);
 
 	trace_kgsl_mem_mmap(entry);
 	return 0;
@@ -4828,6 +5026,7 @@ static void kgsl_core_exit(void)
 		kmem_cache_destroy(memobjs_cache);
 
 	kgsl_memfree_exit();
+	kgsl_exit_page_pools();
 	unregister_chrdev_region(kgsl_driver.major, KGSL_DEVICE_MAX);
 }
 
@@ -4907,6 +5106,8 @@ static int __init kgsl_core_init(void)
 
 	kgsl_memfree_init();
 
+	kgsl_init_page_pools();
+
 	return 0;
 
 err:
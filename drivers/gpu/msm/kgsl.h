@@ -131,6 +131,8 @@ struct kgsl_memdesc_ops {
 #define KGSL_MEMDESC_PRIVILEGED BIT(8)
 /* The memdesc is TZ locked content protection */
 #define KGSL_MEMDESC_TZ_LOCKED BIT(9)
+/* The pages stay allocated until the TLB flush for the unmap is done */
+#define KGSL_MEMDESC_DEFER_TLB_FLUSH BIT(10)
 
 /* shared memory allocation */
 struct kgsl_memdesc {
@@ -182,6 +184,7 @@ struct kgsl_memdesc {
  * @pending_free: if !0, userspace requested that his memory be freed, but there
  *  are still references to it.
  * @dev_priv: back pointer to the device file that created this entry.
+ * @map_count: Number of user space vmas mapping this entry
  */
 struct kgsl_mem_entry {
 	struct kref refcount;
@@ -191,6 +194,7 @@ struct kgsl_mem_entry {
 	unsigned int id;
 	struct kgsl_process_private *priv;
 	int pending_free;
+	atomic_t map_count;
 };
 
 struct kgsl_device_private;
@@ -206,9 +210,8 @@ typedef void (*kgsl_event_func)(struct kgsl_device *, struct kgsl_event_group *,
  * @timestamp: Timestamp for the event to expire
  * @func: Callback function for for the event when it expires
  * @priv: Private data passed to the callback function
- * @node: List node for the kgsl_event_group list
+ * @node: List node for the kgsl_event_group events or retired list
  * @created: Jiffies when the event was created
- * @work: Work struct for dispatching the callback
  * @result: KGSL event result type to pass to the callback
  * group: The event group this event belongs to
  */
@@ -220,7 +223,6 @@ struct kgsl_event {
 	void *priv;
 	struct list_head node;
 	unsigned int created;
-	struct work_struct work;
 	int result;
 	struct kgsl_event_group *group;
 };
@@ -231,8 +233,10 @@ typedef int (*readtimestamp_func)(struct kgsl_device *, void *,
 /**
  * struct event_group - A list of GPU events
  * @context: Pointer to the active context for the events
- * @lock: Spinlock for protecting the list
- * @events: List of active GPU events
+ * @lock: Spinlock for protecting the lists
+ * @events: List of active GPU events, sorted by timestamp
+ * @retired: List of signalled events waiting for their callback to run
+ * @work: Work struct for running the callbacks of @retired in one batch
  * @group: Node for the master group list
  * @processed: Last processed timestamp
  * @name: String name for the group (for the debugfs file)
@@ -243,6 +247,8 @@ struct kgsl_event_group {
 	struct kgsl_context *context;
 	spinlock_t lock;
 	struct list_head events;
+	struct list_head retired;
+	struct work_struct work;
 	struct list_head group;
 	unsigned int processed;
 	char name[64];
@@ -260,6 +266,8 @@ long kgsl_ioctl_rb_issueibcmds(struct kgsl_device_private *dev_priv,
 				      unsigned int cmd, void *data);
 long kgsl_ioctl_submit_commands(struct kgsl_device_private *dev_priv,
 				unsigned int cmd, void *data);
+long kgsl_ioctl_submit_batch(struct kgsl_device_private *dev_priv,
+				unsigned int cmd, void *data);
 long kgsl_ioctl_cmdstream_readtimestamp_ctxtid(struct kgsl_device_private
 					*dev_priv, unsigned int cmd,
 					void *data);
@@ -358,6 +358,8 @@ static const struct kgsl_ioctl kgsl_compat_ioctl_funcs[] = {
 			kgsl_ioctl_syncsource_create_fence),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_SYNCSOURCE_SIGNAL_FENCE,
 			kgsl_ioctl_syncsource_signal_fence),
+	KGSL_IOCTL_FUNC(IOCTL_KGSL_SUBMIT_BATCH,
+			kgsl_ioctl_submit_batch),
 };
 
 long kgsl_compat_ioctl(struct file *filep, unsigned int cmd,
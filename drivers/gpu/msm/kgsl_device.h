@@ -241,6 +241,9 @@ struct kgsl_memobj_node {
  * @profile_index: Index to store the start/stop ticks in the kernel profiling
  * buffer
  * @submit_ticks: Variable to hold ticks at the time of cmdbatch submit.
+ * @submit_ktime: local_clock() at the time of cmdbatch submit
+ * @queue_ktime: local_clock() at the time the cmdbatch was queued to its
+ * context
  * @timeout_jiffies: For a syncpoint cmdbatch the jiffies at which the
  * timer will expire
  * This structure defines an atomic batch of command buffers issued from
@@ -266,6 +269,8 @@ struct kgsl_cmdbatch {
 	unsigned long profiling_buffer_gpuaddr;
 	unsigned int profile_index;
 	uint64_t submit_ticks;
+	u64 submit_ktime;
+	u64 queue_ktime;
 	unsigned long timeout_jiffies;
 };
 
@@ -300,6 +305,8 @@ struct kgsl_cmdbatch_sync_event {
  * in the profiling buffer
  * @CMDBATCH_FLAG_FENCE_LOG - Set if the cmdbatch is dumping fence logs via the
  * cmdbatch timer - this is used to avoid recursion
+ * @CMDBATCH_FLAG_DEFER_ISSUE - Queue the cmdbatch without kicking the
+ * dispatcher, the submitter kicks it once the rest of its batch is queued
  */
 
 enum kgsl_cmdbatch_priv {
@@ -308,6 +315,7 @@ enum kgsl_cmdbatch_priv {
 	CMDBATCH_FLAG_WFI,
 	CMDBATCH_FLAG_PROFILE,
 	CMDBATCH_FLAG_FENCE_LOG,
+	CMDBATCH_FLAG_DEFER_ISSUE,
 };
 
 struct kgsl_device {
@@ -370,6 +378,7 @@ struct kgsl_device {
 	struct kgsl_snapshot *snapshot;
 
 	u32 snapshot_faultcount;	/* Total number of faults since boot */
+	bool snapshot_compress;		/* LZO compress the GPU objects */
 	struct kobject snapshot_kobj;
 
 	struct kobject ppd_kobj;
@@ -489,6 +498,10 @@ struct kgsl_context {
  * @syncsource_idr: sync sources created by this process
  * @syncsource_lock: Spinlock to protect the syncsource idr
  * @fd_count: Counter for the number of FDs for this process
+ * @gpumem: Bytes of GPU memory attached to the process in total, mapped into
+ * user space and allocated from the kgsl page pools, kept up to date as
+ * entries come and go so that they can be read without walking the entries
+ * @rcu: Defers freeing the struct for kgsl_process_reclaimable_pages()
  */
 struct kgsl_process_private {
 	unsigned long priv;
@@ -509,6 +522,12 @@ struct kgsl_process_private {
 	struct idr syncsource_idr;
 	spinlock_t syncsource_lock;
 	int fd_count;
+	struct {
+		atomic_long_t total;
+		atomic_long_t mapped;
+		atomic_long_t reclaimable;
+	} gpumem;
+	struct rcu_head rcu;
 };
 
 /**
@@ -533,6 +552,7 @@ struct kgsl_device_private {
  * @timestamp: Timestamp of the snapshot instance (in seconds since boot)
  * @mempool: Pointer to the memory pool for storing memory objects
  * @mempool_size: Size of the memory pool
+ * @compress: Store the GPU objects LZO compressed
  * @obj_list: List of frozen GPU buffers that are waiting to be dumped.
  * @cp_list: List of IB's to be dumped.
  * @work: worker to dump the frozen memory
@@ -547,6 +567,7 @@ struct kgsl_snapshot {
 	unsigned long timestamp;
 	u8 *mempool;
 	size_t mempool_size;
+	bool compress;
 	struct list_head obj_list;
 	struct list_head cp_list;
 	struct work_struct work;
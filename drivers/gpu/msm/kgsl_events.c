@@ -15,6 +15,7 @@
 #include <linux/list.h>
 #include <linux/workqueue.h>
 #include <linux/debugfs.h>
+#include <linux/rculist.h>
 #include <kgsl_device.h>
 
 #include "kgsl_debugfs.h"
@@ -27,33 +28,74 @@
 static struct kmem_cache *events_cache;
 static struct dentry *events_dentry;
 
+/*
+ * Move an event to the retired list of its group, the callbacks are run in
+ * a batch by _kgsl_event_group_worker() once the caller has kicked the work
+ * with kick_event_group(). Called with the group lock held.
+ */
 static inline void signal_event(struct kgsl_device *device,
 		struct kgsl_event *event, int result)
 {
-	list_del(&event->node);
 	event->result = result;
-	queue_work(device->events_wq, &event->work);
+	list_move_tail(&event->node, &event->group->retired);
+}
+
+/*
+ * Queue the batch worker for the group if it has retired events. The
+ * queued work holds a reference to the context so that the group stays
+ * around until the worker has run. Called with the group lock held.
+ */
+static void kick_event_group(struct kgsl_device *device,
+		struct kgsl_event_group *group)
+{
+	if (list_empty(&group->retired))
+		return;
+
+	_kgsl_context_get(group->context);
+	if (!queue_work(device->events_wq, &group->work))
+		kgsl_context_put(group->context);
 }
 
 /**
- * _kgsl_event_worker() - Work handler for processing GPU event callbacks
- * @work: Pointer to the work_struct for the event
+ * _kgsl_event_group_worker() - Work handler for processing GPU event callbacks
+ * @work: Pointer to the work_struct for the event group
  *
- * Each event callback has its own work struct and is run on a event specific
- * workqeuue.  This is the worker that queues up the event callback function.
+ * Runs the callbacks of all the events retired or cancelled in the group
+ * since the last run, in timestamp order, on the event specific workqueue.
  */
-static void _kgsl_event_worker(struct work_struct *work)
+static void _kgsl_event_group_worker(struct work_struct *work)
 {
-	struct kgsl_event *event = container_of(work, struct kgsl_event, work);
-	int id = KGSL_CONTEXT_ID(event->context);
+	struct kgsl_event_group *group = container_of(work,
+		struct kgsl_event_group, work);
+	struct kgsl_context *context = group->context;
+	struct kgsl_event *event, *tmp;
+	LIST_HEAD(retired);
 
-	trace_kgsl_fire_event(id, event->timestamp, event->result,
-		jiffies - event->created, event->func);
+	spin_lock(&group->lock);
+	list_splice_init(&group->retired, &retired);
+	spin_unlock(&group->lock);
+
+	/*
+	 * Every event holds its own context reference so the group must not
+	 * be touched once the last one of them is gone
+	 */
+	list_for_each_entry_safe(event, tmp, &retired, node) {
+		int id = KGSL_CONTEXT_ID(event->context);
+
+		list_del(&event->node);
 
-	event->func(event->device, event->group, event->priv, event->result);
+		trace_kgsl_fire_event(id, event->timestamp, event->result,
+			jiffies - event->created, event->func);
 
-	kgsl_context_put(event->context);
-	kmem_cache_free(events_cache, event);
+		event->func(event->device, event->group, event->priv,
+			event->result);
+
+		kgsl_context_put(event->context);
+		kmem_cache_free(events_cache, event);
+	}
+
+	/* Drop the reference taken by kick_event_group() */
+	kgsl_context_put(context);
 }
 
 static void _process_event_group(struct kgsl_device *device,
@@ -66,33 +108,39 @@ static void _process_event_group(struct kgsl_device *device,
 	if (group == NULL)
 		return;
 
-	context = group->context;
-
-	_kgsl_context_get(context);
-
-	spin_lock(&group->lock);
-
 	group->readtimestamp(device, group->priv, KGSL_TIMESTAMP_RETIRED,
 		&timestamp);
 
 	/*
 	 * If no timestamps have been retired since the last time we were here
-	 * then we can avoid going through this loop
+	 * then we can avoid taking the lock at all. Events added since then
+	 * check the retired timestamp themselves when they are added.
 	 */
-	if (!flush && timestamp_cmp(timestamp, group->processed) <= 0)
-		goto out;
+	if (!flush && timestamp_cmp(timestamp,
+			ACCESS_ONCE(group->processed)) <= 0)
+		return;
+
+	context = group->context;
+
+	_kgsl_context_get(context);
+
+	spin_lock(&group->lock);
 
+	/* The list is sorted so stop at the first pending event */
 	list_for_each_entry_safe(event, tmp, &group->events, node) {
 		if (timestamp_cmp(event->timestamp, timestamp) <= 0)
 			signal_event(device, event, KGSL_EVENT_RETIRED);
 		else if (flush)
 			signal_event(device, event, KGSL_EVENT_CANCELLED);
-
+		else
+			break;
 	}
 
-	group->processed = timestamp;
+	if (timestamp_cmp(timestamp, group->processed) > 0)
+		group->processed = timestamp;
+
+	kick_event_group(device, group);
 
-out:
 	spin_unlock(&group->lock);
 	kgsl_context_put(context);
 }
@@ -141,6 +189,7 @@ void kgsl_cancel_events_timestamp(struct kgsl_device *device,
 			signal_event(device, event, KGSL_EVENT_CANCELLED);
 	}
 
+	kick_event_group(device, group);
 	spin_unlock(&group->lock);
 }
 EXPORT_SYMBOL(kgsl_cancel_events_timestamp);
@@ -160,6 +209,7 @@ void kgsl_cancel_events(struct kgsl_device *device,
 	list_for_each_entry_safe(event, tmp, &group->events, node)
 		signal_event(device, event, KGSL_EVENT_CANCELLED);
 
+	kick_event_group(device, group);
 	spin_unlock(&group->lock);
 }
 EXPORT_SYMBOL(kgsl_cancel_events);
@@ -185,6 +235,7 @@ void kgsl_cancel_event(struct kgsl_device *device,
 			signal_event(device, event, KGSL_EVENT_CANCELLED);
 	}
 
+	kick_event_group(device, group);
 	spin_unlock(&group->lock);
 }
 EXPORT_SYMBOL(kgsl_cancel_event);
@@ -227,7 +278,7 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 {
 	unsigned int queued;
 	struct kgsl_context *context = group->context;
-	struct kgsl_event *event;
+	struct kgsl_event *event, *prev;
 	unsigned int retired;
 
 	if (!func)
@@ -261,8 +312,6 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 	event->created = jiffies;
 	event->group = group;
 
-	INIT_WORK(&event->work, _kgsl_event_worker);
-
 	trace_kgsl_register_event(KGSL_CONTEXT_ID(context), timestamp, func);
 
 	spin_lock(&group->lock);
@@ -276,13 +325,21 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 
 	if (timestamp_cmp(retired, timestamp) >= 0) {
 		event->result = KGSL_EVENT_RETIRED;
-		queue_work(device->events_wq, &event->work);
+		list_add_tail(&event->node, &group->retired);
+		kick_event_group(device, group);
 		spin_unlock(&group->lock);
 		return 0;
 	}
 
-	/* Add the event to the group list */
-	list_add_tail(&event->node, &group->events);
+	/*
+	 * Keep the group list sorted by timestamp. Events nearly always come
+	 * in timestamp order so look for the spot from the tail.
+	 */
+	list_for_each_entry_reverse(prev, &group->events, node) {
+		if (timestamp_cmp(prev->timestamp, timestamp) <= 0)
+			break;
+	}
+	list_add(&event->node, &prev->node);
 
 	spin_unlock(&group->lock);
 
@@ -290,7 +347,8 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 }
 EXPORT_SYMBOL(kgsl_add_event);
 
-static DEFINE_RWLOCK(group_lock);
+/* group_lock serializes the writers, group_list is walked under RCU */
+static DEFINE_SPINLOCK(group_lock);
 static LIST_HEAD(group_list);
 
 /**
@@ -303,10 +361,10 @@ void kgsl_process_events(struct work_struct *work)
 	struct kgsl_device *device = container_of(work, struct kgsl_device,
 		event_work);
 
-	read_lock(&group_lock);
-	list_for_each_entry(group, &group_list, group)
+	rcu_read_lock();
+	list_for_each_entry_rcu(group, &group_list, group)
 		_process_event_group(device, group, false);
-	read_unlock(&group_lock);
+	rcu_read_unlock();
 }
 EXPORT_SYMBOL(kgsl_process_events);
 
@@ -319,9 +377,12 @@ void kgsl_del_event_group(struct kgsl_event_group *group)
 	/* Make sure that all the events have been deleted from the list */
 	BUG_ON(!list_empty(&group->events));
 
-	write_lock(&group_lock);
-	list_del(&group->group);
-	write_unlock(&group_lock);
+	spin_lock(&group_lock);
+	list_del_rcu(&group->group);
+	spin_unlock(&group_lock);
+
+	/* Wait for kgsl_process_events() to be done with the group */
+	synchronize_rcu();
 }
 EXPORT_SYMBOL(kgsl_del_event_group);
 
@@ -342,6 +403,8 @@ void kgsl_add_event_group(struct kgsl_event_group *group,
 
 	spin_lock_init(&group->lock);
 	INIT_LIST_HEAD(&group->events);
+	INIT_LIST_HEAD(&group->retired);
+	INIT_WORK(&group->work, _kgsl_event_group_worker);
 
 	group->context = context;
 	group->readtimestamp = readtimestamp;
@@ -350,9 +413,9 @@ void kgsl_add_event_group(struct kgsl_event_group *group,
 	if (name)
 		strlcpy(group->name, name, sizeof(group->name));
 
-	write_lock(&group_lock);
-	list_add_tail(&group->group, &group_list);
-	write_unlock(&group_lock);
+	spin_lock(&group_lock);
+	list_add_tail_rcu(&group->group, &group_list);
+	spin_unlock(&group_lock);
 }
 EXPORT_SYMBOL(kgsl_add_event_group);
 
@@ -387,12 +450,12 @@ static int events_debugfs_print(struct seq_file *s, void *unused)
 	seq_puts(s, "event groups:\n");
 	seq_puts(s, "--------------\n");
 
-	read_lock(&group_lock);
-	list_for_each_entry(group, &group_list, group) {
+	rcu_read_lock();
+	list_for_each_entry_rcu(group, &group_list, group) {
 		events_debugfs_print_group(s, group);
 		seq_puts(s, "\n");
 	}
-	read_unlock(&group_lock);
+	rcu_read_unlock();
 
 	return 0;
 }
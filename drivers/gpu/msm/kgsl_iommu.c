@@ -31,6 +31,7 @@
 #include "kgsl_trace.h"
 #include "kgsl_cffdump.h"
 #include "kgsl_pwrctrl.h"
+#include "kgsl_pool.h"
 
 static struct kgsl_iommu_register_list kgsl_iommuv0_reg[KGSL_IOMMU_REG_MAX] = {
 	{ 0, 0 },			/* GLOBAL_BASE */
@@ -1322,6 +1323,11 @@ static int kgsl_iommu_init(struct kgsl_mmu *mmu)
 		return -ENOMEM;
 
 	mmu->priv = iommu;
+	iommu->device = mmu->device;
+	spin_lock_init(&iommu->deferred_lock);
+	INIT_LIST_HEAD(&iommu->deferred_list);
+	INIT_WORK(&iommu->deferred_work, kgsl_iommu_deferred_free_work);
+
 	status = kgsl_get_iommu_ctxt(mmu);
 	if (status)
 		goto done;
@@ -1638,6 +1644,7 @@ done:
  * kgsl_iommu_flush_tlb_pt_current - Flush IOMMU TLB if pagetable is
  * currently used by GPU.
  * @pt - Pointer to kgsl pagetable structure
+ * @memdesc - The memory that was (un)mapped, or NULL
  *
  * Return - void
  */
@@ -1646,7 +1653,7 @@ static void kgsl_iommu_flush_tlb_pt_current(struct kgsl_pagetable *pt,
 {
 	struct kgsl_iommu *iommu = pt->mmu->priv;
 
-	if (kgsl_memdesc_is_secured(memdesc))
+	if (memdesc && kgsl_memdesc_is_secured(memdesc))
 		return;
 
 	mutex_lock(&pt->mmu->device->mutex);
@@ -1662,6 +1669,131 @@ static void kgsl_iommu_flush_tlb_pt_current(struct kgsl_pagetable *pt,
 	mutex_unlock(&pt->mmu->device->mutex);
 }
 
+/*
+ * struct kgsl_iommu_deferred_free - Pages waiting for a TLB flush
+ * @node: Entry in the deferred_list of the iommu
+ * @pt: The pagetable the pages were unmapped from, holds a reference
+ * @sg: The pages, allocated with kgsl_pool_alloc_page()
+ * @sglen: Number of entries in @sg
+ * @flush_seq: flush_seq of the iommu at the time of the unmap
+ */
+struct kgsl_iommu_deferred_free {
+	struct list_head node;
+	struct kgsl_pagetable *pt;
+	struct scatterlist *sg;
+	unsigned int sglen;
+	unsigned int flush_seq;
+};
+
+static void _kgsl_iommu_free_deferred(struct kgsl_iommu_deferred_free *entry)
+{
+	struct scatterlist *sg;
+	int i;
+
+	for_each_sg(entry->sg, sg, entry->sglen, i)
+		kgsl_pool_free_page(sg_page(sg), get_order(sg->length));
+
+	kgsl_free(entry->sg);
+	kgsl_mmu_putpagetable(entry->pt);
+	kfree(entry);
+}
+
+/*
+ * kgsl_iommu_deferred_free_work - Flush the TLB once for all the pages
+ * unmapped since the last run and free them
+ *
+ * The flush is skipped if the TLB has been flushed since the last unmap of
+ * the batch or if none of the pagetables of the batch is current anymore,
+ * the pagetable switch done by the ringbuffer invalidates the TLB.
+ */
+static void kgsl_iommu_deferred_free_work(struct work_struct *work)
+{
+	struct kgsl_iommu *iommu = container_of(work, struct kgsl_iommu,
+						deferred_work);
+	struct kgsl_mmu *mmu = &iommu->device->mmu;
+	struct kgsl_iommu_deferred_free *entry, *tmp;
+	phys_addr_t current_ptbase = 0;
+	bool ptbase_read = false;
+	LIST_HEAD(list);
+
+	spin_lock(&iommu->deferred_lock);
+	list_splice_init(&iommu->deferred_list, &list);
+	spin_unlock(&iommu->deferred_lock);
+
+	if (list_empty(&list))
+		return;
+
+	mutex_lock(&mmu->device->mutex);
+	if (kgsl_mmu_is_perprocess(mmu) &&
+		iommu->iommu_units[0].dev[KGSL_IOMMU_CONTEXT_USER].attached) {
+		list_for_each_entry(entry, &list, node) {
+			if (entry->flush_seq != iommu->flush_seq)
+				continue;
+
+			if (!ptbase_read) {
+				current_ptbase =
+					kgsl_iommu_get_current_ptbase(mmu);
+				ptbase_read = true;
+			}
+
+			if (kgsl_iommu_pt_equal(mmu, entry->pt,
+					current_ptbase)) {
+				kgsl_iommu_flush_pt(mmu);
+				break;
+			}
+		}
+	}
+
+	/* Nothing unmapped is left in the TLB unless more was queued since */
+	spin_lock(&iommu->deferred_lock);
+	if (list_empty(&iommu->deferred_list))
+		iommu->tlb_stale = false;
+	spin_unlock(&iommu->deferred_lock);
+	mutex_unlock(&mmu->device->mutex);
+
+	list_for_each_entry_safe(entry, tmp, &list, node) {
+		list_del(&entry->node);
+		_kgsl_iommu_free_deferred(entry);
+	}
+}
+
+/*
+ * kgsl_iommu_defer_free_pages - Queue unmapped pages to be freed after the
+ * next TLB flush
+ * @pt - Pointer to kgsl pagetable structure the pages were unmapped from
+ * @sg - The pages
+ * @sglen - Number of entries in @sg
+ *
+ * Return - 0 if the pages were queued, else the TLB is flushed right away
+ * and an error code is returned
+ */
+static int kgsl_iommu_defer_free_pages(struct kgsl_pagetable *pt,
+			struct scatterlist *sg, unsigned int sglen)
+{
+	struct kgsl_iommu *iommu = pt->mmu->priv;
+	struct kgsl_iommu_deferred_free *entry;
+
+	entry = kmalloc(sizeof(*entry), GFP_KERNEL);
+	if (entry == NULL) {
+		kgsl_iommu_flush_tlb_pt_current(pt, NULL);
+		return -ENOMEM;
+	}
+
+	kref_get(&pt->refcount);
+	entry->pt = pt;
+	entry->sg = sg;
+	entry->sglen = sglen;
+
+	spin_lock(&iommu->deferred_lock);
+	entry->flush_seq = ACCESS_ONCE(iommu->flush_seq);
+	list_add_tail(&entry->node, &iommu->deferred_list);
+	iommu->tlb_stale = true;
+	spin_unlock(&iommu->deferred_lock);
+
+	queue_work(system_unbound_wq, &iommu->deferred_work);
+	return 0;
+}
+
 static int
 kgsl_iommu_unmap(struct kgsl_pagetable *pt,
 		struct kgsl_memdesc *memdesc)
@@ -1705,8 +1837,14 @@ kgsl_iommu_unmap(struct kgsl_pagetable *pt,
 	 * We only need to flush the TLB for non-global memory.
 	 * This is because global mappings are only removed at pagetable destroy
 	 * time, and the pagetable is not active in the TLB at this point.
+	 * If the caller keeps the pages until kgsl_mmu_defer_free_pages()
+	 * the flush is left to the deferred free work, which does one flush
+	 * for a whole batch of unmaps.
 	 */
-	if (!kgsl_memdesc_is_global(memdesc))
+	if (kgsl_memdesc_is_global(memdesc) ||
+		kgsl_memdesc_is_secured(memdesc))
+		memdesc->priv &= ~KGSL_MEMDESC_DEFER_TLB_FLUSH;
+	else if (!(memdesc->priv & KGSL_MEMDESC_DEFER_TLB_FLUSH))
 		kgsl_iommu_flush_tlb_pt_current(pt, memdesc);
 
 	return ret;
@@ -1774,6 +1912,7 @@ kgsl_iommu_map(struct kgsl_pagetable *pt,
 	unsigned int protflags;
 	struct kgsl_device *device = pt->mmu->device;
 	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+	struct kgsl_iommu *pt_iommu = pt->mmu->priv;
 	struct scatterlist *sg_temp = NULL;
 
 	BUG_ON(NULL == iommu_pt);
@@ -1788,9 +1927,15 @@ kgsl_iommu_map(struct kgsl_pagetable *pt,
 	if (memdesc->priv & KGSL_MEMDESC_PRIVILEGED)
 		protflags |= IOMMU_PRIV;
 
-	sg_temp = _create_sg_no_large_pages(memdesc);
-	if (IS_ERR(sg_temp))
-		return PTR_ERR(sg_temp);
+	/*
+	 * The v1 and v2 pagetable code maps each segment with the largest
+	 * section size it is aligned to, only v0 needs the 1M chunks split
+	 */
+	if (msm_soc_version_supports_iommu_v0()) {
+		sg_temp = _create_sg_no_large_pages(memdesc);
+		if (IS_ERR(sg_temp))
+			return PTR_ERR(sg_temp);
+	}
 
 	if (kgsl_memdesc_is_secured(memdesc) && kgsl_mmu_is_secured(pt->mmu)) {
 		mutex_lock(&device->mutex);
@@ -1846,10 +1991,15 @@ kgsl_iommu_map(struct kgsl_pagetable *pt,
 	 * We only need to flush the TLB for non-global memory.
 	 * This is because global mappings are only created at pagetable create
 	 * time, and the pagetable is not active in the TLB at this point.
+	 *
+	 * The same applies if unmaps are still waiting for their deferred
+	 * flush: the address range may just have been freed and the TLB can
+	 * still hold the translations to the old pages.
 	 */
 
-	if (ADRENO_FEATURE(adreno_dev, IOMMU_FLUSH_TLB_ON_MAP)
-		&& !kgsl_memdesc_is_global(memdesc))
+	if ((ADRENO_FEATURE(adreno_dev, IOMMU_FLUSH_TLB_ON_MAP) ||
+		ACCESS_ONCE(pt_iommu->tlb_stale)) &&
+		!kgsl_memdesc_is_global(memdesc))
 		kgsl_iommu_flush_tlb_pt_current(pt, memdesc);
 
 	return ret;
@@ -1915,6 +2065,10 @@ static int kgsl_iommu_close(struct kgsl_mmu *mmu)
 	struct kgsl_iommu *iommu = mmu->priv;
 	int i;
 
+	/* Free whatever is still waiting for a TLB flush */
+	flush_work(&iommu->deferred_work);
+	kgsl_iommu_deferred_free_work(&iommu->deferred_work);
+
 	if (mmu->priv_bank_table != NULL)
 		kgsl_mmu_putpagetable(mmu->priv_bank_table);
 
@@ -1986,6 +2140,13 @@ static int kgsl_iommu_flush_pt(struct kgsl_mmu *mmu)
 	}
 	kgsl_iommu_enable_clk(mmu, KGSL_IOMMU_MAX_UNITS);
 
+	/*
+	 * Count the flush before it is issued so that pages unmapped while
+	 * it is in progress still get a flush of their own
+	 */
+	iommu->flush_seq++;
+	smp_mb();
+
 	/* Acquire GPU-CPU sync Lock here */
 	_iommu_lock(iommu);
 
@@ -2302,4 +2463,5 @@ struct kgsl_mmu_pt_ops iommu_pt_ops = {
 	.mmu_create_secure_pagetable = kgsl_iommu_create_secure_pagetable,
 	.mmu_destroy_pagetable = kgsl_iommu_destroy_pagetable,
 	.get_ptbase = kgsl_iommu_get_ptbase,
+	.mmu_defer_free_pages = kgsl_iommu_defer_free_pages,
 };
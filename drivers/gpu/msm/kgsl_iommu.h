@@ -247,6 +247,12 @@ struct kgsl_iommu_unit {
  * @sync_lock_initialized: True if the sync_lock feature is enabled
  * @gtcu_iface_clk: The gTCU AHB Clock connected to SMMU
  * @events: The event group for iommu events
+ * @flush_seq: Incremented every time the TLB of the user context is flushed
+ * @deferred_lock: Protects @deferred_list
+ * @deferred_list: Unmapped pages waiting for a TLB flush before being freed
+ * @deferred_work: Work item that flushes the TLB and frees @deferred_list
+ * @tlb_stale: True while the TLB may still hold translations of unmapped
+ * memory on @deferred_list
  */
 struct kgsl_iommu {
 	struct kgsl_iommu_unit iommu_units[KGSL_IOMMU_MAX_UNITS];
@@ -261,6 +267,11 @@ struct kgsl_iommu {
 	bool sync_lock_initialized;
 	struct clk *gtcu_iface_clk;
 	struct clk *gtbu_clk;
+	unsigned int flush_seq;
+	spinlock_t deferred_lock;
+	struct list_head deferred_list;
+	struct work_struct deferred_work;
+	bool tlb_stale;
 };
 
 /*
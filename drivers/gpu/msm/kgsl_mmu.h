@@ -127,6 +127,8 @@ struct kgsl_mmu_pt_ops {
 	void *(*mmu_create_secure_pagetable) (void);
 	void (*mmu_destroy_pagetable) (struct kgsl_pagetable *);
 	phys_addr_t (*get_ptbase) (struct kgsl_pagetable *);
+	int (*mmu_defer_free_pages) (struct kgsl_pagetable *pt,
+			struct scatterlist *sg, unsigned int sglen);
 };
 
 #define KGSL_MMU_FLAGS_IOMMU_SYNC BIT(31)
@@ -323,6 +325,27 @@ static inline int kgsl_mmu_hw_halt_supported(struct kgsl_mmu *mmu,
 		return 0;
 }
 
+/*
+ * kgsl_mmu_defer_free_pages() - Free unmapped pages after the next TLB flush
+ * @pagetable: the pagetable the pages were unmapped from
+ * @sg: the scatterlist of pages from kgsl_pool_alloc_page()
+ * @sglen: the number of entries in @sg
+ *
+ * On success the mmu owns both the pages and @sg and frees them once the
+ * TLB can no longer hold translations to them. On failure the TLB has been
+ * flushed already and the caller frees the pages itself.
+ */
+static inline int kgsl_mmu_defer_free_pages(struct kgsl_pagetable *pagetable,
+			struct scatterlist *sg, unsigned int sglen)
+{
+	if (pagetable && pagetable->pt_ops &&
+		pagetable->pt_ops->mmu_defer_free_pages)
+		return pagetable->pt_ops->mmu_defer_free_pages(pagetable,
+				sg, sglen);
+	else
+		return -ENODEV;
+}
+
 /*
  * kgsl_mmu_is_perprocess() - Runtime check for per-process
  * pagetables.
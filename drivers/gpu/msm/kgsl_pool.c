@@ -0,0 +1,354 @@
+/* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/highmem.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/shrinker.h>
+#include <linux/log2.h>
+#include <linux/sizes.h>
+#include <asm/cacheflush.h>
+
+#include "kgsl_pool.h"
+
+/**
+ * struct kgsl_page_pool - pool of pages of one order
+ * @order: Order of the pages in the pool
+ * @max_pages: Maximum number of pages held, clean and dirty together
+ * @reserve: Number of clean pages the pool tries to keep ready
+ * @lock: Protects the lists and counts below
+ * @clean: Pages that are zeroed and flushed, ready to be handed out
+ * @clean_count: Number of pages on @clean
+ * @dirty: Pages given back by kgsl that still have to be zeroed
+ * @dirty_count: Number of pages on @dirty
+ */
+struct kgsl_page_pool {
+	unsigned int order;
+	unsigned int max_pages;
+	unsigned int reserve;
+	spinlock_t lock;
+	struct list_head clean;
+	unsigned int clean_count;
+	struct list_head dirty;
+	unsigned int dirty_count;
+};
+
+/*
+ * One pool for each of the chunk sizes _kgsl_sharedmem_page_alloc() uses.
+ * Each pool is capped at 8M (4K) or 16M (64K and 1M) and the large order
+ * pools keep a few pages ready since those are the ones that are
+ * expensive to find and to zero at allocation time.
+ */
+static struct kgsl_page_pool kgsl_pools[] = {
+	{
+		.order = 0,
+		.max_pages = SZ_8M >> PAGE_SHIFT,
+		.reserve = 0,
+	},
+	{
+		.order = ilog2(SZ_64K) - PAGE_SHIFT,
+		.max_pages = SZ_16M / SZ_64K,
+		.reserve = 16,
+	},
+	{
+		.order = ilog2(SZ_1M) - PAGE_SHIFT,
+		.max_pages = SZ_16M / SZ_1M,
+		.reserve = 4,
+	},
+};
+
+static bool kgsl_pools_ready;
+
+static void kgsl_pool_worker(struct work_struct *work);
+static DECLARE_WORK(kgsl_pool_work, kgsl_pool_worker);
+
+static struct kgsl_page_pool *_kgsl_get_pool(unsigned int order)
+{
+	int i;
+
+	if (!kgsl_pools_ready)
+		return NULL;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++)
+		if (kgsl_pools[i].order == order)
+			return &kgsl_pools[i];
+
+	return NULL;
+}
+
+/* Same flags _kgsl_sharedmem_page_alloc() uses for large chunks */
+static gfp_t _kgsl_pool_gfp(struct kgsl_page_pool *pool)
+{
+	if (pool->order)
+		return __GFP_HIGHMEM | __GFP_COMP | __GFP_NORETRY |
+			__GFP_NO_KSWAPD | __GFP_NOWARN;
+
+	return __GFP_HIGHMEM | GFP_KERNEL | __GFP_NOWARN;
+}
+
+/*
+ * Zero the page and flush it out of the cache so that it can be given to
+ * the GPU and to user space through write-combined mappings
+ */
+static void _kgsl_pool_zero_page(struct page *page, unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < (1 << order); i++) {
+		void *ptr = kmap_atomic(nth_page(page, i));
+
+		memset(ptr, 0, PAGE_SIZE);
+		dmac_flush_range(ptr, ptr + PAGE_SIZE);
+		kunmap_atomic(ptr);
+	}
+}
+
+static void _kgsl_pool_add_clean(struct kgsl_page_pool *pool,
+		struct page *page)
+{
+	spin_lock(&pool->lock);
+	list_add_tail(&page->lru, &pool->clean);
+	pool->clean_count++;
+	spin_unlock(&pool->lock);
+}
+
+/* Zero the pages that were given back and top up the reserves */
+static void kgsl_pool_worker(struct work_struct *work)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++) {
+		struct kgsl_page_pool *pool = &kgsl_pools[i];
+		struct page *page;
+
+		for (;;) {
+			spin_lock(&pool->lock);
+			page = list_first_entry_or_null(&pool->dirty,
+					struct page, lru);
+			if (page) {
+				list_del(&page->lru);
+				pool->dirty_count--;
+			}
+			spin_unlock(&pool->lock);
+
+			if (page == NULL)
+				break;
+
+			_kgsl_pool_zero_page(page, pool->order);
+			_kgsl_pool_add_clean(pool, page);
+			cond_resched();
+		}
+
+		while (ACCESS_ONCE(pool->clean_count) < pool->reserve) {
+			page = alloc_pages(_kgsl_pool_gfp(pool), pool->order);
+			if (page == NULL)
+				break;
+
+			_kgsl_pool_zero_page(page, pool->order);
+			_kgsl_pool_add_clean(pool, page);
+			cond_resched();
+		}
+	}
+}
+
+/**
+ * kgsl_pool_alloc_page() - Allocate a page of the given order
+ * @order: Order of the page
+ * @gfp_mask: Flags to use if the page has to come from the page allocator
+ * @zeroed: Set to true if the page is already zeroed and flushed
+ *
+ * Pages are taken from the pool of that order when it has any ready,
+ * otherwise from the page allocator in which case the caller has to zero
+ * and flush the page itself.
+ */
+struct page *kgsl_pool_alloc_page(unsigned int order, gfp_t gfp_mask,
+			bool *zeroed)
+{
+	struct kgsl_page_pool *pool = _kgsl_get_pool(order);
+	struct page *page = NULL;
+	bool refill = false;
+
+	if (pool != NULL) {
+		spin_lock(&pool->lock);
+		page = list_first_entry_or_null(&pool->clean, struct page, lru);
+		if (page) {
+			list_del(&page->lru);
+			pool->clean_count--;
+		}
+		refill = pool->clean_count < pool->reserve;
+		spin_unlock(&pool->lock);
+
+		if (refill)
+			queue_work(system_unbound_wq, &kgsl_pool_work);
+	}
+
+	if (page != NULL) {
+		*zeroed = true;
+		return page;
+	}
+
+	*zeroed = false;
+	return alloc_pages(gfp_mask, order);
+}
+
+/**
+ * kgsl_pool_free_page() - Give back a page allocated by kgsl_pool_alloc_page
+ * @page: The page
+ * @order: Order of the page
+ *
+ * The page is kept to be zeroed in the background unless the pool of that
+ * order is full, in which case it goes straight back to the page allocator.
+ */
+void kgsl_pool_free_page(struct page *page, unsigned int order)
+{
+	struct kgsl_page_pool *pool = _kgsl_get_pool(order);
+
+	if (pool != NULL) {
+		spin_lock(&pool->lock);
+		if (pool->clean_count + pool->dirty_count < pool->max_pages) {
+			list_add_tail(&page->lru, &pool->dirty);
+			pool->dirty_count++;
+			page = NULL;
+		}
+		spin_unlock(&pool->lock);
+
+		if (page == NULL) {
+			queue_work(system_unbound_wq, &kgsl_pool_work);
+			return;
+		}
+	}
+
+	__free_pages(page, order);
+}
+
+/* Number of PAGE_SIZE pages held in all the pools */
+static unsigned int _kgsl_pool_pages(void)
+{
+	unsigned int total = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++) {
+		struct kgsl_page_pool *pool = &kgsl_pools[i];
+
+		total += (ACCESS_ONCE(pool->clean_count) +
+			ACCESS_ONCE(pool->dirty_count)) << pool->order;
+	}
+
+	return total;
+}
+
+/**
+ * kgsl_pool_size_total() - Return the number of bytes held in the pools
+ */
+unsigned int kgsl_pool_size_total(void)
+{
+	return _kgsl_pool_pages() << PAGE_SHIFT;
+}
+
+/*
+ * Free up to nr_pages PAGE_SIZE pages from one pool, dirty pages first
+ * since those would still cost a zeroing pass to be of any use
+ */
+static unsigned long _kgsl_pool_shrink(struct kgsl_page_pool *pool,
+		unsigned long nr_pages)
+{
+	unsigned long freed = 0;
+	struct page *page;
+
+	while (freed < nr_pages) {
+		spin_lock(&pool->lock);
+		page = list_first_entry_or_null(&pool->dirty, struct page, lru);
+		if (page) {
+			pool->dirty_count--;
+		} else {
+			page = list_first_entry_or_null(&pool->clean,
+					struct page, lru);
+			if (page)
+				pool->clean_count--;
+		}
+		if (page)
+			list_del(&page->lru);
+		spin_unlock(&pool->lock);
+
+		if (page == NULL)
+			break;
+
+		__free_pages(page, pool->order);
+		freed += 1 << pool->order;
+	}
+
+	return freed;
+}
+
+static int kgsl_pool_shrink(struct shrinker *shrinker,
+		struct shrink_control *sc)
+{
+	unsigned long nr = sc->nr_to_scan;
+	int i;
+
+	/*
+	 * Start with the large pages, they are the ones the rest of the
+	 * system is most likely to be short of
+	 */
+	for (i = ARRAY_SIZE(kgsl_pools) - 1; i >= 0 && nr; i--) {
+		unsigned long freed = _kgsl_pool_shrink(&kgsl_pools[i], nr);
+
+		nr -= min(freed, nr);
+	}
+
+	return _kgsl_pool_pages();
+}
+
+static struct shrinker kgsl_pool_shrinker = {
+	.shrink = kgsl_pool_shrink,
+	.seeks = DEFAULT_SEEKS,
+	.batch = 0,
+};
+
+void kgsl_init_page_pools(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++) {
+		spin_lock_init(&kgsl_pools[i].lock);
+		INIT_LIST_HEAD(&kgsl_pools[i].clean);
+		INIT_LIST_HEAD(&kgsl_pools[i].dirty);
+		kgsl_pools[i].clean_count = 0;
+		kgsl_pools[i].dirty_count = 0;
+	}
+
+	register_shrinker(&kgsl_pool_shrinker);
+	kgsl_pools_ready = true;
+
+	/* Fill the reserves */
+	queue_work(system_unbound_wq, &kgsl_pool_work);
+}
+
+void kgsl_exit_page_pools(void)
+{
+	int i;
+
+	if (!kgsl_pools_ready)
+		return;
+
+	kgsl_pools_ready = false;
+	unregister_shrinker(&kgsl_pool_shrinker);
+	cancel_work_sync(&kgsl_pool_work);
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++)
+		_kgsl_pool_shrink(&kgsl_pools[i], ULONG_MAX);
+}
@@ -152,6 +152,34 @@ void kgsl_pwrscale_update(struct kgsl_device *device)
 }
 EXPORT_SYMBOL(kgsl_pwrscale_update);
 
+/**
+ * kgsl_pwrscale_frame() - account a retired frame
+ * @device: The device
+ * @gpu_time: Time the frame occupied the GPU, in ns
+ * @period: Time the frame had to complete in, in ns
+ *
+ * Called by the dispatcher when the last command batch of a frame retires.
+ * The governor gets the most expensive frame and the tightest period seen
+ * since its last call so that it can clock for the worst case.
+ */
+void kgsl_pwrscale_frame(struct kgsl_device *device, u64 gpu_time,
+		u64 period)
+{
+	struct kgsl_frame_stats *frame = &device->pwrscale.frame_stats;
+
+	if (!device->pwrscale.enabled || period == 0)
+		return;
+
+	spin_lock(&device->pwrscale.frame_lock);
+	if (frame->count == 0 || gpu_time > frame->gpu_time)
+		frame->gpu_time = gpu_time;
+	if (frame->count == 0 || period < frame->period)
+		frame->period = period;
+	frame->count++;
+	spin_unlock(&device->pwrscale.frame_lock);
+}
+EXPORT_SYMBOL(kgsl_pwrscale_frame);
+
 /*
  * kgsl_pwrscale_disable - temporarily disable the governor
  * @device: The device
@@ -287,6 +315,7 @@ int kgsl_devfreq_get_dev_status(struct device *dev,
 	struct kgsl_device *device = dev_get_drvdata(dev);
 	struct kgsl_pwrctrl *pwrctrl;
 	struct kgsl_pwrscale *pwrscale;
+	struct devfreq_msm_adreno_tz_data *data;
 	ktime_t tmp;
 
 	if (device == NULL)
@@ -313,6 +342,15 @@ int kgsl_devfreq_get_dev_status(struct device *dev,
 
 	stat->current_frequency = kgsl_pwrctrl_active_freq(&device->pwrctrl);
 
+	/* Hand the frames retired in this window to the governor */
+	data = pwrscale->gpu_profile.private_data;
+	spin_lock(&pwrscale->frame_lock);
+	data->frame.gpu_time = pwrscale->frame_stats.gpu_time;
+	data->frame.period = pwrscale->frame_stats.period;
+	data->frame.count = pwrscale->frame_stats.count;
+	memset(&pwrscale->frame_stats, 0, sizeof(pwrscale->frame_stats));
+	spin_unlock(&pwrscale->frame_lock);
+
 	/*
 	 * keep the latest devfreq_dev_status values
 	 * and vbif counters data
@@ -535,6 +573,7 @@ int kgsl_pwrscale_init(struct device *dev, const char *governor)
 	profile = &pwrscale->gpu_profile.profile;
 
 	srcu_init_notifier_head(&pwrscale->nh);
+	spin_lock_init(&pwrscale->frame_lock);
 
 	profile->initial_freq =
 		pwr->pwrlevels[pwr->default_pwrlevel].gpu_freq;
@@ -26,6 +26,18 @@ struct kgsl_power_stats {
 	u64 ram_wait;
 };
 
+/**
+ * struct kgsl_frame_stats - frames retired since the last governor call
+ * @gpu_time: GPU time of the most expensive frame, in ns
+ * @period: Shortest time the frames had to complete in, in ns
+ * @count: Number of frames
+ */
+struct kgsl_frame_stats {
+	u64 gpu_time;
+	u64 period;
+	unsigned int count;
+};
+
 struct kgsl_pwrscale {
 	struct devfreq *devfreqptr;
 	struct msm_adreno_extended_profile gpu_profile;
@@ -42,6 +54,8 @@ struct kgsl_pwrscale {
 	struct work_struct devfreq_resume_ws;
 	struct work_struct devfreq_notify_ws;
 	ktime_t next_governor_call;
+	spinlock_t frame_lock;
+	struct kgsl_frame_stats frame_stats;
 };
 
 int kgsl_pwrscale_init(struct device *dev, const char *governor);
@@ -52,6 +66,8 @@ void kgsl_pwrscale_update_stats(struct kgsl_device *device);
 void kgsl_pwrscale_busy(struct kgsl_device *device);
 void kgsl_pwrscale_sleep(struct kgsl_device *device);
 void kgsl_pwrscale_wake(struct kgsl_device *device);
+void kgsl_pwrscale_frame(struct kgsl_device *device, u64 gpu_time,
+		u64 period);
 
 void kgsl_pwrscale_enable(struct kgsl_device *device);
 void kgsl_pwrscale_disable(struct kgsl_device *device);
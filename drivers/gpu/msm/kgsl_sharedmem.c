@@ -24,6 +24,7 @@
 #include "kgsl_cffdump.h"
 #include "kgsl_device.h"
 #include "kgsl_log.h"
+#include "kgsl_pool.h"
 
 static DEFINE_MUTEX(kernel_map_global_lock);
 
@@ -108,6 +109,32 @@ mem_entry_max_show(struct kgsl_process_private *priv, int type, char *buf)
 }
 
 
+/**
+ * Show one of the incrementally maintained GPU memory counters of the process
+ */
+
+static ssize_t
+gpumem_total_show(struct kgsl_process_private *priv, int type, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%ld\n",
+		atomic_long_read(&priv->gpumem.total));
+}
+
+static ssize_t
+gpumem_mapped_show(struct kgsl_process_private *priv, int type, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%ld\n",
+		atomic_long_read(&priv->gpumem.mapped));
+}
+
+static ssize_t
+gpumem_reclaimable_show(struct kgsl_process_private *priv, int type,
+		char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%ld\n",
+		atomic_long_read(&priv->gpumem.reclaimable));
+}
+
 static void mem_entry_sysfs_release(struct kobject *kobj)
 {
 }
@@ -160,6 +187,12 @@ static struct mem_entry_stats mem_stats[] = {
 #endif
 };
 
+static struct kgsl_mem_entry_attribute gpumem_attrs[] = {
+	__MEM_ENTRY_ATTR(0, gpumem_total, gpumem_total_show),
+	__MEM_ENTRY_ATTR(0, gpumem_mapped, gpumem_mapped_show),
+	__MEM_ENTRY_ATTR(0, gpumem_reclaimable, gpumem_reclaimable_show),
+};
+
 void
 kgsl_process_uninit_sysfs(struct kgsl_process_private *private)
 {
@@ -171,6 +204,9 @@ kgsl_process_uninit_sysfs(struct kgsl_process_private *private)
 			&mem_stats[i].max_attr.attr);
 	}
 
+	for (i = 0; i < ARRAY_SIZE(gpumem_attrs); i++)
+		sysfs_remove_file(&private->kobj, &gpumem_attrs[i].attr);
+
 	kobject_put(&private->kobj);
 	/* Put the refcount we got in kgsl_process_init_sysfs */
 	kgsl_process_private_put(private);
@@ -213,6 +249,10 @@ kgsl_process_init_sysfs(struct kgsl_device *device,
 			&mem_stats[i].max_attr.attr);
 	}
 
+	for (i = 0; i < ARRAY_SIZE(gpumem_attrs); i++)
+		ret = sysfs_create_file(&private->kobj,
+			&gpumem_attrs[i].attr);
+
 	/* Keep private valid until the sysfs enries are removed. */
 	if (!ret)
 		kgsl_process_private_get(private);
@@ -246,6 +286,8 @@ static ssize_t kgsl_drv_memstat_show(struct device *dev,
 		val = kgsl_driver.stats.mapped;
 	else if (!strcmp(attr->attr.name, "mapped_max"))
 		val = kgsl_driver.stats.mapped_max;
+	else if (!strcmp(attr->attr.name, "page_pool"))
+		val = kgsl_pool_size_total();
 
 	return snprintf(buf, PAGE_SIZE, "%u\n", val);
 }
@@ -283,6 +325,7 @@ static DEVICE_ATTR(secure, 0444, kgsl_drv_memstat_show, NULL);
 static DEVICE_ATTR(secure_max, 0444, kgsl_drv_memstat_show, NULL);
 static DEVICE_ATTR(mapped, 0444, kgsl_drv_memstat_show, NULL);
 static DEVICE_ATTR(mapped_max, 0444, kgsl_drv_memstat_show, NULL);
+static DEVICE_ATTR(page_pool, 0444, kgsl_drv_memstat_show, NULL);
 static DEVICE_ATTR(full_cache_threshold, 0644,
 		kgsl_drv_full_cache_threshold_show,
 		kgsl_drv_full_cache_threshold_store);
@@ -298,6 +341,7 @@ static const struct device_attribute *drv_attr_list[] = {
 	&dev_attr_secure_max,
 	&dev_attr_mapped,
 	&dev_attr_mapped_max,
+	&dev_attr_page_pool,
 	&dev_attr_full_cache_threshold,
 	NULL
 };
@@ -393,9 +437,21 @@ static void kgsl_page_alloc_free(struct kgsl_memdesc *memdesc)
 	/* we certainly do not expect the hostptr to still be mapped */
 	BUG_ON(memdesc->hostptr);
 
+	/*
+	 * If the TLB flush for the unmap was deferred hand the pages to the
+	 * mmu, it frees them once the flush has been done
+	 */
+	if ((memdesc->priv & KGSL_MEMDESC_DEFER_TLB_FLUSH) && sglen &&
+		memdesc->sg && !kgsl_mmu_defer_free_pages(memdesc->pagetable,
+					memdesc->sg, sglen)) {
+		memdesc->sg = NULL;
+		memdesc->sglen = 0;
+		return;
+	}
+
 	if (sglen && memdesc->sg)
 		for_each_sg(memdesc->sg, sg, sglen, i)
-			__free_pages(sg_page(sg), get_order(sg->length));
+			kgsl_pool_free_page(sg_page(sg), get_order(sg->length));
 }
 
 /*
@@ -645,6 +701,9 @@ EXPORT_SYMBOL(kgsl_cache_range_op);
 #ifndef CONFIG_ALLOC_BUFFERS_IN_4K_CHUNKS
 static inline int get_page_size(size_t size, unsigned int align)
 {
+	if (align >= ilog2(SZ_1M) && size >= SZ_1M)
+		return SZ_1M;
+
 	return (align >= ilog2(SZ_64K) && size >= SZ_64K)
 					? SZ_64K : PAGE_SIZE;
 }
@@ -655,6 +714,12 @@ static inline int get_page_size(size_t size, unsigned int align)
 }
 #endif
 
+/* Next chunk size to try when the current one can not be used */
+static inline int get_smaller_page_size(size_t len, int page_size)
+{
+	return (page_size > SZ_64K && len >= SZ_64K) ? SZ_64K : PAGE_SIZE;
+}
+
 static int
 _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 			struct kgsl_pagetable *pagetable,
@@ -727,11 +792,12 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 	while (len > 0) {
 		struct page *page;
 		unsigned int gfp_mask = __GFP_HIGHMEM;
+		bool zeroed;
 		int j;
 
 		/* don't waste space at the end of the allocation*/
 		if (len < page_size)
-			page_size = PAGE_SIZE;
+			page_size = get_smaller_page_size(len, page_size);
 
 		/*
 		 * Don't do some of the more aggressive memory recovery
@@ -743,11 +809,13 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 		else
 			gfp_mask |= GFP_KERNEL;
 
-		page = alloc_pages(gfp_mask, get_order(page_size));
+		page = kgsl_pool_alloc_page(get_order(page_size), gfp_mask,
+				&zeroed);
 
 		if (page == NULL) {
 			if (page_size != PAGE_SIZE) {
-				page_size = PAGE_SIZE;
+				page_size = get_smaller_page_size(len,
+						page_size);
 				continue;
 			}
 
@@ -770,8 +838,10 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 			goto done;
 		}
 
-		for (j = 0; j < page_size >> PAGE_SHIFT; j++)
-			pages[pcount++] = nth_page(page, j);
+		/* Pages from the pool are already zeroed and flushed */
+		if (!zeroed)
+			for (j = 0; j < page_size >> PAGE_SHIFT; j++)
+				pages[pcount++] = nth_page(page, j);
 
 		sg_set_page(&memdesc->sg[sglen++], page, page_size, 0);
 		len -= page_size;
@@ -850,12 +920,29 @@ kgsl_sharedmem_page_alloc_user(struct kgsl_memdesc *memdesc,
 }
 EXPORT_SYMBOL(kgsl_sharedmem_page_alloc_user);
 
+/**
+ * kgsl_memdesc_is_reclaimable() - Check if freeing a memdesc gives its pages
+ * back to the kgsl page pools
+ * @memdesc: The memdesc
+ */
+bool kgsl_memdesc_is_reclaimable(const struct kgsl_memdesc *memdesc)
+{
+	return memdesc->ops == &kgsl_page_alloc_ops;
+}
+
 void kgsl_sharedmem_free(struct kgsl_memdesc *memdesc)
 {
 	if (memdesc == NULL || memdesc->size == 0)
 		return;
 
 	if (memdesc->gpuaddr) {
+		/*
+		 * Pages we allocated ourselves can wait for a batched TLB
+		 * flush, anything else is released by its owner as soon as
+		 * the free op returns
+		 */
+		if (memdesc->ops == &kgsl_page_alloc_ops)
+			memdesc->priv |= KGSL_MEMDESC_DEFER_TLB_FLUSH;
 		kgsl_mmu_unmap(memdesc->pagetable, memdesc);
 		kgsl_mmu_put_gpuaddr(memdesc->pagetable, memdesc);
 	}
@@ -42,6 +42,8 @@ int kgsl_cma_alloc_secure(struct kgsl_device *device,
 
 void kgsl_sharedmem_free(struct kgsl_memdesc *memdesc);
 
+bool kgsl_memdesc_is_reclaimable(const struct kgsl_memdesc *memdesc);
+
 int kgsl_sharedmem_readl(const struct kgsl_memdesc *memdesc,
 			uint32_t *dst,
 			unsigned int offsetbytes);
@@ -16,6 +16,8 @@
 #include <linux/utsname.h>
 #include <linux/sched.h>
 #include <linux/idr.h>
+#include <linux/lzo.h>
+#include <linux/vmalloc.h>
 
 #include "kgsl.h"
 #include "kgsl_log.h"
@@ -688,6 +690,7 @@ int kgsl_device_snapshot(struct kgsl_device *device,
 	INIT_LIST_HEAD(&snapshot->obj_list);
 	INIT_LIST_HEAD(&snapshot->cp_list);
 	INIT_WORK(&snapshot->work, kgsl_snapshot_save_frozen_objs);
+	snapshot->compress = device->snapshot_compress;
 
 	snapshot->start = device->snapshot_memory.ptr;
 	snapshot->ptr = device->snapshot_memory.ptr;
@@ -877,6 +880,28 @@ static ssize_t faultcount_store(struct kgsl_device *device, const char *buf,
 	return count;
 }
 
+/* Show whether the GPU objects of new snapshots get compressed */
+static ssize_t compress_show(struct kgsl_device *device, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", device->snapshot_compress);
+}
+
+/* Turn the LZO compression of the GPU objects on or off */
+static ssize_t compress_store(struct kgsl_device *device, const char *buf,
+	size_t count)
+{
+	unsigned int val;
+	int ret;
+
+	ret = kstrtou32(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	device->snapshot_compress = val ? true : false;
+
+	return count;
+}
+
 /* Show the timestamp of the last collected snapshot */
 static ssize_t timestamp_show(struct kgsl_device *device, char *buf)
 {
@@ -902,6 +927,7 @@ struct kgsl_snapshot_attribute attr_##_name = { \
 
 static SNAPSHOT_ATTR(timestamp, 0444, timestamp_show, NULL);
 static SNAPSHOT_ATTR(faultcount, 0644, faultcount_show, faultcount_store);
+static SNAPSHOT_ATTR(compress, 0644, compress_show, compress_store);
 
 static void snapshot_sysfs_release(struct kobject *kobj)
 {
@@ -1002,6 +1028,10 @@ int kgsl_device_snapshot_init(struct kgsl_device *device)
 		goto done;
 
 	ret  = sysfs_create_file(&device->snapshot_kobj, &attr_faultcount.attr);
+	if (ret)
+		goto done;
+
+	ret  = sysfs_create_file(&device->snapshot_kobj, &attr_compress.attr);
 
 done:
 	return ret;
@@ -1019,6 +1049,7 @@ void kgsl_device_snapshot_close(struct kgsl_device *device)
 {
 	sysfs_remove_bin_file(&device->snapshot_kobj, &snapshot_attr);
 	sysfs_remove_file(&device->snapshot_kobj, &attr_timestamp.attr);
+	sysfs_remove_file(&device->snapshot_kobj, &attr_compress.attr);
 
 	kobject_put(&device->snapshot_kobj);
 
@@ -1083,6 +1114,50 @@ static size_t _mempool_add_object(u8 *data, struct kgsl_snapshot_object *obj)
 	return section->size;
 }
 
+/*
+ * Store a GPU object LZO compressed. scratch has to hold the worst case
+ * compressed size of the object. Return 0 if the object can't be mapped or
+ * does not shrink, in which case the caller stores it as is.
+ */
+static size_t _mempool_add_object_lzo(u8 *data,
+		struct kgsl_snapshot_object *obj, void *scratch, void *wrkmem)
+{
+	struct kgsl_snapshot_section_header *section =
+		(struct kgsl_snapshot_section_header *)data;
+	struct kgsl_snapshot_gpu_object_lzo *header =
+		(struct kgsl_snapshot_gpu_object_lzo *)(data + sizeof(*section));
+	u8 *dest = data + sizeof(*section) + sizeof(*header);
+	size_t len;
+	int ret;
+
+	if (!kgsl_memdesc_map(&obj->entry->memdesc))
+		return 0;
+
+	ret = lzo1x_1_compress(obj->entry->memdesc.hostptr + obj->offset,
+		obj->size, scratch, &len, wrkmem);
+	kgsl_memdesc_unmap(&obj->entry->memdesc);
+
+	/* The uncompressed section has room for the extra header dword */
+	if (ret != LZO_E_OK || ALIGN(len, 4) + sizeof(__u32) >= obj->size)
+		return 0;
+
+	section->magic = SNAPSHOT_SECTION_MAGIC;
+	section->id = KGSL_SNAPSHOT_SECTION_GPU_OBJECT_LZO;
+	section->size = ALIGN(len, 4) + sizeof(*header) + sizeof(*section);
+
+	header->size = obj->size >> 2;
+	header->gpuaddr = obj->gpuaddr;
+	header->ptbase =
+	 (__u32)kgsl_mmu_pagetable_get_ptbase(obj->entry->priv->pagetable);
+	header->type = obj->type;
+	header->csize = len;
+
+	memcpy(dest, scratch, len);
+	memset(dest + len, 0, ALIGN(len, 4) - len);
+
+	return section->size;
+}
+
 /**
  * kgsl_snapshot_save_frozen_objs() - Save the objects frozen in snapshot into
  * memory so that the data reported in these objects is correct when snapshot
@@ -1094,13 +1169,15 @@ void kgsl_snapshot_save_frozen_objs(struct work_struct *work)
 	struct kgsl_snapshot *snapshot = container_of(work,
 				struct kgsl_snapshot, work);
 	struct kgsl_snapshot_object *obj, *tmp;
-	size_t size = 0;
+	size_t size = 0, max_size = 0;
+	void *scratch = NULL, *wrkmem = NULL;
 	void *ptr;
 
 	kgsl_snapshot_process_ib_obj_list(snapshot);
 
 	list_for_each_entry(obj, &snapshot->obj_list, node) {
 		obj->size = ALIGN(obj->size, 4);
+		max_size = max_t(size_t, max_size, obj->size);
 		size += (obj->size +
 			sizeof(struct kgsl_snapshot_gpu_object) +
 			sizeof(struct kgsl_snapshot_section_header));
@@ -1109,6 +1186,12 @@ void kgsl_snapshot_save_frozen_objs(struct work_struct *work)
 	if (size == 0)
 		goto done;
 
+	/* Without the buffers for LZO the objects are simply stored as is */
+	if (snapshot->compress) {
+		scratch = vmalloc(lzo1x_worst_compress(max_size));
+		wrkmem = vmalloc(LZO1X_1_MEM_COMPRESS);
+	}
+
 	snapshot->mempool = vmalloc(size);
 
 	ptr = snapshot->mempool;
@@ -1117,13 +1200,32 @@ void kgsl_snapshot_save_frozen_objs(struct work_struct *work)
 	/* even if vmalloc fails, make sure we clean up the obj_list */
 	list_for_each_entry_safe(obj, tmp, &snapshot->obj_list, node) {
 		if (snapshot->mempool) {
-			size_t ret = _mempool_add_object(ptr, obj);
+			size_t ret = 0;
+
+			if (scratch && wrkmem)
+				ret = _mempool_add_object_lzo(ptr, obj,
+					scratch, wrkmem);
+			if (ret == 0)
+				ret = _mempool_add_object(ptr, obj);
 			ptr += ret;
 			snapshot->mempool_size += ret;
 		}
 
 		kgsl_snapshot_put_object(obj);
 	}
+
+	vfree(scratch);
+	vfree(wrkmem);
+
+	/* Give back what compression saved until the snapshot is read */
+	if (snapshot->mempool && snapshot->mempool_size < size / 2) {
+		ptr = vmalloc(snapshot->mempool_size);
+		if (ptr) {
+			memcpy(ptr, snapshot->mempool, snapshot->mempool_size);
+			vfree(snapshot->mempool);
+			snapshot->mempool = ptr;
+		}
+	}
 done:
 	/*
 	 * Get rid of the process struct here, so that it doesn't sit
@@ -52,6 +52,7 @@ struct kgsl_snapshot_section_header {
 #define KGSL_SNAPSHOT_SECTION_DEBUG        0x0901
 #define KGSL_SNAPSHOT_SECTION_DEBUGBUS     0x0A01
 #define KGSL_SNAPSHOT_SECTION_GPU_OBJECT   0x0B01
+#define KGSL_SNAPSHOT_SECTION_GPU_OBJECT_LZO 0x0B02
 #define KGSL_SNAPSHOT_SECTION_MEMLIST      0x0E01
 
 #define KGSL_SNAPSHOT_SECTION_END          0xFFFF
@@ -183,4 +184,16 @@ struct kgsl_snapshot_gpu_object {
 	int size;    /* Size of the object (in dwords) */
 };
 
+/*
+ * Compressed GPU object: the header is followed by csize bytes of LZO1X
+ * data, padded to a dword, that decompress to size dwords
+ */
+struct kgsl_snapshot_gpu_object_lzo {
+	int type;      /* Type of GPU object */
+	__u32 gpuaddr; /* GPU address of the the object */
+	__u32 ptbase;  /* Base for the pagetable the GPU address is valid in */
+	int size;      /* Size of the uncompressed object (in dwords) */
+	__u32 csize;   /* Size of the compressed data (in bytes) */
+};
+
 #endif
@@ -31,6 +31,7 @@
 #include <linux/qpnp/qpnp-adc.h>
 #include <linux/platform_device.h>
 #include <linux/thermal.h>
+#include <linux/jiffies.h>
 
 /* QPNP VADC register definition */
 #define QPNP_VADC_REVISION1				0x0
@@ -132,6 +133,13 @@ struct qpnp_vadc_thermal_data {
 	struct qpnp_vadc_chip *vadc_dev;
 };
 
+/* Last result of a channel, shared by qpnp_vadc_read_cached() callers */
+struct qpnp_vadc_cache {
+	struct qpnp_vadc_result		result;
+	unsigned long			stamp;
+	bool				valid;
+};
+
 struct qpnp_vadc_chip {
 	struct device			*dev;
 	struct qpnp_adc_drv		*adc;
@@ -153,6 +161,8 @@ struct qpnp_vadc_chip {
 	struct work_struct		trigger_low_thr_work;
 	struct qpnp_vadc_mode_state	*state_copy;
 	struct qpnp_vadc_thermal_data	*vadc_therm_chan;
+	struct mutex			cache_lock;
+	struct qpnp_vadc_cache		*cache;
 	struct sensor_device_attribute	sens_attr[0];
 };
 
@@ -1744,7 +1754,20 @@ fail_unlock:
 }
 EXPORT_SYMBOL(qpnp_vadc_conv_seq_request);
 
-int32_t qpnp_vadc_read(struct qpnp_vadc_chip *vadc,
+static struct qpnp_vadc_cache *qpnp_vadc_cache_entry(
+		struct qpnp_vadc_chip *vadc, enum qpnp_vadc_channels channel)
+{
+	int dt_index;
+
+	for (dt_index = 0; dt_index < vadc->max_channels_available;
+								dt_index++)
+		if (vadc->adc->adc_channels[dt_index].channel_num == channel)
+			return &vadc->cache[dt_index];
+
+	return NULL;
+}
+
+static int32_t __qpnp_vadc_read(struct qpnp_vadc_chip *vadc,
 				enum qpnp_vadc_channels channel,
 				struct qpnp_vadc_result *result)
 {
@@ -1776,8 +1799,53 @@ int32_t qpnp_vadc_read(struct qpnp_vadc_chip *vadc,
 		return qpnp_vadc_conv_seq_request(vadc, ADC_SEQ_NONE,
 				channel, result);
 }
+
+int32_t qpnp_vadc_read(struct qpnp_vadc_chip *vadc,
+				enum qpnp_vadc_channels channel,
+				struct qpnp_vadc_result *result)
+{
+	return qpnp_vadc_read_cached(vadc, channel, result, 0);
+}
 EXPORT_SYMBOL(qpnp_vadc_read);
 
+int32_t qpnp_vadc_read_cached(struct qpnp_vadc_chip *vadc,
+				enum qpnp_vadc_channels channel,
+				struct qpnp_vadc_result *result,
+				unsigned int max_age_ms)
+{
+	struct qpnp_vadc_cache *entry;
+	int rc;
+
+	if (qpnp_vadc_is_valid(vadc))
+		return -EPROBE_DEFER;
+
+	/*
+	 * Held across the conversion so that clients racing for the same
+	 * stale channel wait for one conversion instead of each starting
+	 * their own.
+	 */
+	mutex_lock(&vadc->cache_lock);
+	entry = qpnp_vadc_cache_entry(vadc, channel);
+	if (entry && entry->valid && max_age_ms &&
+		time_before(jiffies, entry->stamp +
+					msecs_to_jiffies(max_age_ms))) {
+		*result = entry->result;
+		mutex_unlock(&vadc->cache_lock);
+		return 0;
+	}
+
+	rc = __qpnp_vadc_read(vadc, channel, result);
+	if (entry) {
+		entry->valid = !rc;
+		entry->result = *result;
+		entry->stamp = jiffies;
+	}
+	mutex_unlock(&vadc->cache_lock);
+
+	return rc;
+}
+EXPORT_SYMBOL(qpnp_vadc_read_cached);
+
 static void qpnp_vadc_lock(struct qpnp_vadc_chip *vadc)
 {
 	mutex_lock(&vadc->adc->adc_lock);
@@ -2252,12 +2320,21 @@ static int qpnp_vadc_probe(struct spmi_device *spmi)
 	}
 
 	vadc->vadc_therm_chan = adc_thermal;
+	vadc->cache = devm_kzalloc(&spmi->dev,
+			(sizeof(struct qpnp_vadc_cache) *
+				count_adc_channel_list), GFP_KERNEL);
+	if (!vadc->cache) {
+		dev_err(&spmi->dev, "Unable to allocate memory\n");
+		return -ENOMEM;
+	}
+
 	rc = qpnp_adc_get_devicetree_data(spmi, vadc->adc);
 	if (rc) {
 		dev_err(&spmi->dev, "failed to read device tree\n");
 		return rc;
 	}
 	mutex_init(&vadc->adc->adc_lock);
+	mutex_init(&vadc->cache_lock);
 
 	rc = qpnp_vadc_init_hwmon(vadc, spmi);
 	if (rc) {
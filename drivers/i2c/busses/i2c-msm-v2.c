@@ -2019,6 +2019,16 @@ i2c_msm_qup_choose_mode(struct i2c_msm_ctrl *ctrl)
 	if (ctrl->dbgfs.force_xfer_mode != I2C_MSM_XFER_MODE_NONE)
 		return ctrl->dbgfs.force_xfer_mode;
 
+	/*
+	 * Bursts of messages (e.g. register address write + data read from a
+	 * sensor hub) interrupt once per FIFO service even when they fit.
+	 * Past the DT threshold, hand the whole chain to BAM in one go.
+	 */
+	if (!ctrl->rsrcs.disable_dma && ctrl->rsrcs.dma_min_xfer_len &&
+	    (xfer->msg_cnt > 1) &&
+	    ((xfer->rx_cnt + xfer->tx_cnt) >= ctrl->rsrcs.dma_min_xfer_len))
+		return I2C_MSM_XFER_MODE_DMA;
+
 	if (((rx_cnt_sum < fifo->input_fifo_sz) &&
 		(tx_cnt_sum < fifo->output_fifo_sz)))
 		return I2C_MSM_XFER_MODE_FIFO;
@@ -2433,6 +2443,8 @@ static int i2c_msm_rsrcs_process_dt(struct i2c_msm_ctrl *ctrl,
 							DT_REQ,  DT_U32,  0},
 	{"qcom,disable-dma",		&(ctrl->rsrcs.disable_dma),
 							DT_OPT,  DT_BOOL, 0},
+	{"qcom,dma-min-xfer-len",	&(ctrl->rsrcs.dma_min_xfer_len),
+							DT_OPT,  DT_U32,  0},
 	{"qcom,master-id",		&(ctrl->rsrcs.clk_path_vote.mstr_id),
 							DT_SGST, DT_U32,  0},
 	{"qcom,noise-rjct-scl",		&noise_rjct_scl,
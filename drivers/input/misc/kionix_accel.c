@@ -278,6 +278,7 @@ struct kionix_accel_driver {
 	u8 shift;
 
 	atomic_t delay;
+	ktime_t timestamp;	/* boot time the current sample was taken */
 
 	unsigned int poll_interval;
 	unsigned int poll_delay;
@@ -481,6 +482,18 @@ static int kionix_accel_grp1_standby(struct kionix_accel_driver *acceld)
 	return 0;
 }
 
+/*
+ * Tag the sample with the time it was taken rather than the time the
+ * work got to report it, so the HAL does not see the scheduling jitter.
+ */
+static void kionix_accel_report_timestamp(struct kionix_accel_driver *acceld)
+{
+	struct timespec ts = ktime_to_timespec(acceld->timestamp);
+
+	input_event(acceld->input_dev, EV_SYN, SYN_TIME_SEC, ts.tv_sec);
+	input_event(acceld->input_dev, EV_SYN, SYN_TIME_NSEC, ts.tv_nsec);
+}
+
 static void kionix_accel_grp1_report_accel_data(struct kionix_accel_driver
 						*acceld)
 {
@@ -552,6 +565,7 @@ static void kionix_accel_grp1_report_accel_data(struct kionix_accel_driver
 							 ABS_Z,
 							 acceld->accel_data
 							 [acceld->axis_map_z]);
+					kionix_accel_report_timestamp(acceld);
 					input_sync(acceld->input_dev);
 				}
 
@@ -758,6 +772,7 @@ static void kionix_accel_grp2_report_accel_data(struct kionix_accel_driver
 							 ABS_Z,
 							 acceld->accel_data
 							 [acceld->axis_map_z]);
+					kionix_accel_report_timestamp(acceld);
 					input_sync(acceld->input_dev);
 				}
 
@@ -1018,6 +1033,7 @@ static void kionix_accel_grp4_report_accel_data(struct kionix_accel_driver
 							 ABS_Z,
 							 acceld->accel_data
 							 [acceld->axis_map_z]);
+					kionix_accel_report_timestamp(acceld);
 					input_sync(acceld->input_dev);
 				}
 				write_unlock(&acceld->rwlock_accel_data);
@@ -1187,6 +1203,7 @@ static irqreturn_t kionix_accel_isr(int irq, void *dev)
 {
 	struct kionix_accel_driver *acceld = dev;
 
+	acceld->timestamp = ktime_get_boottime();
 	queue_delayed_work(acceld->accel_workqueue, &acceld->accel_work, 0);
 
 	return IRQ_HANDLED;
@@ -1202,6 +1219,8 @@ static void kionix_accel_work(struct work_struct *work)
 		queue_delayed_work(acceld->accel_workqueue, &acceld->accel_work,
 				   msecs_to_jiffies(atomic_read
 						    (&acceld->delay)));
+	if (acceld->accel_drdy == 0)
+		acceld->timestamp = ktime_get_boottime();
 	acceld->kionix_accel_report_accel_data(acceld);
 }
 
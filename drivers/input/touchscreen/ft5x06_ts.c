@@ -30,6 +30,7 @@
 #include <linux/firmware.h>
 #include <linux/debugfs.h>
 #include <linux/sensors.h>
+#include <linux/sched.h>
 #include <linux/input/ft5x06_ts.h>
 
 #if defined(CONFIG_FB)
@@ -257,6 +258,8 @@ struct ft5x06_ts_data {
 	u32 tch_data_len;
 	u8 fw_ver[3];
 	u8 fw_vendor_id;
+	ktime_t irq_time;
+	bool irq_prio_set;
 #if defined(CONFIG_FB)
 	struct work_struct fb_notify_work;
 	struct notifier_block fb_notif;
@@ -685,6 +688,32 @@ static void ft5x06_update_fw_ver(struct ft5x06_ts_data *data)
 		data->fw_ver[0], data->fw_ver[1], data->fw_ver[2]);
 }
 
+/*
+ * Take the time stamp of the touch frame before the threaded handler gets
+ * scheduled, so its latency does not show up in the reported time.
+ */
+static irqreturn_t ft5x06_ts_hardirq(int irq, void *dev_id)
+{
+	struct ft5x06_ts_data *data = dev_id;
+
+	data->irq_time = ktime_get_boottime();
+
+	return IRQ_WAKE_THREAD;
+}
+
+static void ft5x06_set_irq_thread_prio(struct ft5x06_ts_data *data)
+{
+	struct sched_param param = {
+		.sched_priority = data->pdata->irq_thread_prio,
+	};
+
+	data->irq_prio_set = true;
+	if (sched_setscheduler(current, SCHED_FIFO, &param))
+		dev_err(&data->client->dev,
+			"failed to set irq thread priority %d\n",
+			param.sched_priority);
+}
+
 static irqreturn_t ft5x06_ts_interrupt(int irq, void *dev_id)
 {
 	struct ft5x06_ts_data *data = dev_id;
@@ -699,6 +728,9 @@ static irqreturn_t ft5x06_ts_interrupt(int irq, void *dev_id)
 		return IRQ_HANDLED;
 	}
 
+	if (unlikely(data->pdata->irq_thread_prio && !data->irq_prio_set))
+		ft5x06_set_irq_thread_prio(data);
+
 	ip_dev = data->input_dev;
 	buf = data->tch_data;
 
@@ -720,7 +752,9 @@ static irqreturn_t ft5x06_ts_interrupt(int irq, void *dev_id)
 			return IRQ_HANDLED;
 	}
 
-	if (ft5x06_gesture_support_enabled() && data->pdata->gesture_support) {
+	/* gesture mode is only entered on suspend */
+	if (ft5x06_gesture_support_enabled() && data->pdata->gesture_support &&
+		data->suspended) {
 		ft5x0x_read_reg(data->client, FT_REG_GESTURE_ENABLE,
 					&gesture_is_active);
 		if (gesture_is_active) {
@@ -775,6 +809,10 @@ static irqreturn_t ft5x06_ts_interrupt(int irq, void *dev_id)
 
 	if (update_input) {
 		input_mt_report_pointer_emulation(ip_dev, false);
+		input_event(ip_dev, EV_SYN, SYN_TIME_SEC,
+			ktime_to_timespec(data->irq_time).tv_sec);
+		input_event(ip_dev, EV_SYN, SYN_TIME_NSEC,
+			ktime_to_timespec(data->irq_time).tv_nsec);
 		input_sync(ip_dev);
 	}
 
@@ -2075,6 +2113,18 @@ static int ft5x06_parse_dt(struct device *dev,
 	pdata->resume_in_workqueue = of_property_read_bool(np,
 					"focaltech,resume-in-workqueue");
 
+	rc = of_property_read_u32(np, "focaltech,irq-thread-prio", &temp_val);
+	if (!rc) {
+		if (temp_val >= MAX_USER_RT_PRIO) {
+			dev_err(dev, "Invalid irq thread priority\n");
+			return -EINVAL;
+		}
+		pdata->irq_thread_prio = temp_val;
+	} else if (rc != -EINVAL) {
+		dev_err(dev, "Unable to read irq thread priority\n");
+		return rc;
+	}
+
 	rc = of_property_read_u32(np, "focaltech,family-id", &temp_val);
 	if (!rc)
 		pdata->family_id = temp_val;
@@ -2276,7 +2326,7 @@ static int ft5x06_ts_probe(struct i2c_client *client,
 
 	data->family_id = pdata->family_id;
 
-	err = request_threaded_irq(client->irq, NULL,
+	err = request_threaded_irq(client->irq, ft5x06_ts_hardirq,
 				ft5x06_ts_interrupt,
 	/*
 	* the interrupt trigger mode will be set in Device Tree with property
@@ -21,6 +21,7 @@
 #include <linux/crypto.h>
 #include <linux/qcrypto.h>
 #include <linux/workqueue.h>
+#include <linux/semaphore.h>
 #include <linux/backing-dev.h>
 #include <linux/atomic.h>
 #include <linux/scatterlist.h>
@@ -45,15 +46,11 @@
 #define MIN_POOL_PAGES 32
 #define KEY_SIZE_XTS 64
 #define AES_XTS_IV_LEN 16
+#define MAX_INFLIGHT_REQS 16
 
 #define DM_REQ_CRYPT_ERROR -1
 #define DM_REQ_CRYPT_ERROR_AFTER_PAGE_MALLOC -2
 
-struct req_crypt_result {
-	struct completion completion;
-	int err;
-};
-
 #define FDE_KEY_ID	0
 #define PFE_KEY_ID	1
 
@@ -62,6 +59,8 @@ static struct kmem_cache *_req_crypt_io_pool;
 static struct kmem_cache *_req_dm_scatterlist_pool;
 static sector_t start_sector_orig;
 static struct workqueue_struct *req_crypt_queue;
+static struct workqueue_struct *req_crypt_done_queue;
+static struct semaphore req_crypt_inflight;
 static mempool_t *req_io_pool;
 static mempool_t *req_page_pool;
 static mempool_t *req_scatterlist_pool;
@@ -74,6 +73,14 @@ unsigned int num_engines_pfe, pfe_cursor;
 struct crypto_engine_entry *fde_eng, *pfe_eng;
 DEFINE_MUTEX(engine_list_mutex);
 
+/*
+ * Upper bound on the number of requests handed to the crypto engines at
+ * any time, applied when the target is constructed.
+ */
+static unsigned int max_inflight = MAX_INFLIGHT_REQS;
+module_param(max_inflight, uint, S_IRUGO);
+MODULE_PARM_DESC(max_inflight, "Maximum number of requests in flight to the crypto engines");
+
 struct req_dm_crypt_io {
 	struct work_struct work;
 	struct request *cloned_request;
@@ -83,6 +90,10 @@ struct req_dm_crypt_io {
 	bool should_encrypt;
 	bool should_decrypt;
 	u32 key_id;
+	struct ablkcipher_request *req;
+	struct scatterlist *req_sg_in;
+	struct scatterlist *req_sg_out;
+	u8 IV[AES_XTS_IV_LEN];
 };
 
 static void req_crypt_cipher_complete
@@ -218,9 +229,28 @@ static void req_crypt_dec_pending_decrypt(struct req_dm_crypt_io *io)
 	mempool_free(io, req_io_pool);
 }
 
+/*
+ * Release the crypto resources of a decrypted read and use the dm function
+ * to complete the bios and requests. Called either from the worker queue
+ * or from the cipher complete callback (atomic).
+ */
+static void req_cryptd_crypt_read_done(struct req_dm_crypt_io *io)
+{
+	if (io->req) {
+		ablkcipher_request_free(io->req);
+		io->req = NULL;
+	}
+	mempool_free(io->req_sg_in, req_scatterlist_pool);
+	io->req_sg_in = NULL;
+
+	up(&req_crypt_inflight);
+	req_crypt_dec_pending_decrypt(io);
+}
+
 /*
  * The callback that will be called by the worker queue to perform Decryption
- * for reads and use the dm function to complete the bios and requests.
+ * for reads. The request is completed by req_cryptd_crypt_read_done once the
+ * crypto engine is done with it.
  */
 static void req_cryptd_crypt_read_convert(struct req_dm_crypt_io *io)
 {
@@ -228,10 +258,8 @@ static void req_cryptd_crypt_read_convert(struct req_dm_crypt_io *io)
 	int error = 0;
 	int total_sg_len = 0, rc = 0, total_bytes_in_req = 0;
 	struct ablkcipher_request *req = NULL;
-	struct req_crypt_result result;
 	struct scatterlist *req_sg_read = NULL;
 	int err = 0;
-	u8 IV[AES_XTS_IV_LEN];
 	struct crypto_engine_entry engine;
 	unsigned int engine_list_total = 0;
 	struct crypto_engine_entry *curr_engine_list = NULL;
@@ -262,15 +290,19 @@ static void req_cryptd_crypt_read_convert(struct req_dm_crypt_io *io)
 		goto submit_request;
 	}
 
+	/* Throttle here, the worker is released once the slot frees up */
+	down(&req_crypt_inflight);
+
 	req = ablkcipher_request_alloc(tfm, GFP_KERNEL);
 	if (!req) {
 		DMERR("%s ablkcipher request allocation failed\n", __func__);
 		err = DM_REQ_CRYPT_ERROR;
 		goto ablkcipher_req_alloc_failure;
 	}
+	io->req = req;
 
 	ablkcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
-					req_crypt_cipher_complete, &result);
+					req_crypt_cipher_complete, io);
 
 	mutex_lock(&engine_list_mutex);
 
@@ -289,7 +321,7 @@ static void req_cryptd_crypt_read_convert(struct req_dm_crypt_io *io)
 	if ((engine_list_total < 1) || (NULL == curr_engine_list)
 			|| (NULL == engine_cursor)) {
 		DMERR("%s Unknown Key ID!\n", __func__);
-		error = DM_REQ_CRYPT_ERROR;
+		err = DM_REQ_CRYPT_ERROR;
 		mutex_unlock(&engine_list_mutex);
 		goto ablkcipher_req_alloc_failure;
 	}
@@ -308,7 +340,6 @@ static void req_cryptd_crypt_read_convert(struct req_dm_crypt_io *io)
 	}
 	mutex_unlock(&engine_list_mutex);
 
-	init_completion(&result.completion);
 	qcrypto_cipher_set_flag(req,
 		QCRYPTO_CTX_USE_PIPE_KEY | QCRYPTO_CTX_XTS_DU_SIZE_512B);
 	crypto_ablkcipher_clear_flags(tfm, ~0);
@@ -322,6 +353,7 @@ static void req_cryptd_crypt_read_convert(struct req_dm_crypt_io *io)
 		err = DM_REQ_CRYPT_ERROR;
 		goto ablkcipher_req_alloc_failure;
 	}
+	io->req_sg_in = req_sg_read;
 	memset(req_sg_read, 0, sizeof(struct scatterlist) * MAX_SG_LIST);
 
 	total_sg_len = blk_rq_map_sg(clone->q, clone, req_sg_read);
@@ -339,12 +371,13 @@ static void req_cryptd_crypt_read_convert(struct req_dm_crypt_io *io)
 		goto ablkcipher_req_alloc_failure;
 	}
 
-	memset(IV, 0, AES_XTS_IV_LEN);
-	memcpy(IV, &clone->__sector, sizeof(sector_t));
+	memset(io->IV, 0, AES_XTS_IV_LEN);
+	memcpy(io->IV, &clone->__sector, sizeof(sector_t));
 
 	ablkcipher_request_set_crypt(req, req_sg_read, req_sg_read,
-			total_bytes_in_req, (void *) IV);
+			total_bytes_in_req, (void *) io->IV);
 
+	io->error = 0;
 	rc = crypto_ablkcipher_decrypt(req);
 
 	switch (rc) {
@@ -353,17 +386,11 @@ static void req_cryptd_crypt_read_convert(struct req_dm_crypt_io *io)
 
 	case -EBUSY:
 		/*
-		 * Lets make this synchronous request by waiting on
-		 * in progress as well
+		 * The request has been backlogged, the callback completes
+		 * it the same way as an in progress one
 		 */
 	case -EINPROGRESS:
-		wait_for_completion_io(&result.completion);
-		if (result.err) {
-			DMERR("%s error = %d encrypting the request\n",
-				 __func__, result.err);
-			err = DM_REQ_CRYPT_ERROR;
-		}
-		break;
+		return;
 
 	default:
 		err = DM_REQ_CRYPT_ERROR;
@@ -371,10 +398,10 @@ static void req_cryptd_crypt_read_convert(struct req_dm_crypt_io *io)
 	}
 
 ablkcipher_req_alloc_failure:
+	io->error = err;
+	req_cryptd_crypt_read_done(io);
+	return;
 
-	if (req)
-		ablkcipher_request_free(req);
-	mempool_free(req_sg_read, req_scatterlist_pool);
 submit_request:
 	if (io)
 		io->error = err;
@@ -401,27 +428,81 @@ static void req_cryptd_crypt_read_plain(struct req_dm_crypt_io *io)
 	mempool_free(io, req_io_pool);
 }
 
+/*
+ * Bounce the encrypted pages into the clone, release the crypto resources
+ * and submit the request using the elevator. This may sleep, so the cipher
+ * complete callback defers it to the done worker queue.
+ */
+static void req_cryptd_crypt_write_done(struct req_dm_crypt_io *io)
+{
+	struct request *clone = io->cloned_request;
+	struct bio *bio_src = NULL;
+	struct req_iterator iter = {0, NULL};
+	struct bio_vec *bvec = NULL;
+	int copy_bio_sector_to_req = 0;
+
+	if (io->error == DM_REQ_CRYPT_ERROR_AFTER_PAGE_MALLOC) {
+		rq_for_each_segment(bvec, clone, iter) {
+			if (bvec->bv_offset == 0) {
+				mempool_free(bvec->bv_page, req_page_pool);
+				bvec->bv_page = NULL;
+			} else
+				bvec->bv_page = NULL;
+		}
+	} else if (io->error >= 0) {
+		__rq_for_each_bio(bio_src, clone) {
+			if (copy_bio_sector_to_req == 0) {
+				clone->buffer = bio_data(bio_src);
+				copy_bio_sector_to_req++;
+			}
+			blk_queue_bounce(clone->q, &bio_src);
+		}
+
+		/*
+		 * Recalculate the phy_segments as we allocate new pages
+		 * This is used by storage driver to fill the sg list.
+		 */
+		blk_recalc_rq_segments(clone);
+	}
+
+	if (io->req) {
+		ablkcipher_request_free(io->req);
+		io->req = NULL;
+	}
+	mempool_free(io->req_sg_in, req_scatterlist_pool);
+	mempool_free(io->req_sg_out, req_scatterlist_pool);
+	io->req_sg_in = NULL;
+	io->req_sg_out = NULL;
+
+	up(&req_crypt_inflight);
+	req_crypt_dec_pending_encrypt(io);
+}
+
+static void req_cryptd_crypt_write_done_work(struct work_struct *work)
+{
+	struct req_dm_crypt_io *io =
+			container_of(work, struct req_dm_crypt_io, work);
+
+	req_cryptd_crypt_write_done(io);
+}
+
 /*
  * The callback that will be called by the worker queue to perform Encryption
- * for writes and submit the request using the elevelator.
+ * for writes. The request is submitted by req_cryptd_crypt_write_done once
+ * the crypto engine is done with it.
  */
 static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 {
 	struct request *clone = NULL;
-	struct bio *bio_src = NULL;
 	unsigned int total_sg_len_req_in = 0, total_sg_len_req_out = 0,
 		total_bytes_in_req = 0, error = DM_MAPIO_REMAPPED, rc = 0;
 	struct req_iterator iter = {0, NULL};
-	struct req_iterator iter1 = {0, NULL};
 	struct ablkcipher_request *req = NULL;
-	struct req_crypt_result result;
 	struct bio_vec *bvec = NULL;
 	struct scatterlist *req_sg_in = NULL;
 	struct scatterlist *req_sg_out = NULL;
-	int copy_bio_sector_to_req = 0;
 	gfp_t gfp_mask = GFP_NOIO | __GFP_HIGHMEM;
 	struct page *page = NULL;
-	u8 IV[AES_XTS_IV_LEN];
 	int remaining_size = 0, err = 0;
 	struct crypto_engine_entry engine;
 	unsigned int engine_list_total = 0;
@@ -447,6 +528,9 @@ static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 
 	req_crypt_inc_pending(io);
 
+	/* Throttle here, the worker is released once the slot frees up */
+	down(&req_crypt_inflight);
+
 	req = ablkcipher_request_alloc(tfm, GFP_KERNEL);
 	if (!req) {
 		DMERR("%s ablkcipher request allocation failed\n",
@@ -454,9 +538,10 @@ static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 		error = DM_REQ_CRYPT_ERROR;
 		goto ablkcipher_req_alloc_failure;
 	}
+	io->req = req;
 
 	ablkcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
-				req_crypt_cipher_complete, &result);
+				req_crypt_cipher_complete, io);
 
 	mutex_lock(&engine_list_mutex);
 	engine_list_total = (io->key_id == FDE_KEY_ID ? num_engines_fde :
@@ -493,8 +578,6 @@ static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 	}
 	mutex_unlock(&engine_list_mutex);
 
-	init_completion(&result.completion);
-
 	qcrypto_cipher_set_flag(req,
 		QCRYPTO_CTX_USE_PIPE_KEY | QCRYPTO_CTX_XTS_DU_SIZE_512B);
 	crypto_ablkcipher_clear_flags(tfm, ~0);
@@ -508,6 +591,7 @@ static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 		error = DM_REQ_CRYPT_ERROR;
 		goto ablkcipher_req_alloc_failure;
 	}
+	io->req_sg_in = req_sg_in;
 	memset(req_sg_in, 0, sizeof(struct scatterlist) * MAX_SG_LIST);
 
 	req_sg_out = (struct scatterlist *)mempool_alloc(req_scatterlist_pool,
@@ -518,6 +602,7 @@ static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 		error = DM_REQ_CRYPT_ERROR;
 		goto ablkcipher_req_alloc_failure;
 	}
+	io->req_sg_out = req_sg_out;
 	memset(req_sg_out, 0, sizeof(struct scatterlist) * MAX_SG_LIST);
 
 	total_sg_len_req_in = blk_rq_map_sg(clone->q, clone, req_sg_in);
@@ -568,12 +653,13 @@ static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 		goto ablkcipher_req_alloc_failure;
 	}
 
-	memset(IV, 0, AES_XTS_IV_LEN);
-	memcpy(IV, &clone->__sector, sizeof(sector_t));
+	memset(io->IV, 0, AES_XTS_IV_LEN);
+	memcpy(io->IV, &clone->__sector, sizeof(sector_t));
 
 	ablkcipher_request_set_crypt(req, req_sg_in, req_sg_out,
-			total_bytes_in_req, (void *) IV);
+			total_bytes_in_req, (void *) io->IV);
 
+	io->error = error;
 	rc = crypto_ablkcipher_encrypt(req);
 
 	switch (rc) {
@@ -582,55 +668,22 @@ static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 
 	case -EBUSY:
 		/*
-		 * Lets make this synchronous request by waiting on
-		 * in progress as well
+		 * The request has been backlogged, the callback completes
+		 * it the same way as an in progress one
 		 */
 	case -EINPROGRESS:
-		wait_for_completion_interruptible(&result.completion);
-		if (result.err) {
-			DMERR("%s error = %d encrypting the request\n",
-				 __func__, result.err);
-			error = DM_REQ_CRYPT_ERROR_AFTER_PAGE_MALLOC;
-			goto ablkcipher_req_alloc_failure;
-		}
-		break;
+		return;
 
 	default:
 		error = DM_REQ_CRYPT_ERROR_AFTER_PAGE_MALLOC;
-		goto ablkcipher_req_alloc_failure;
-	}
-
-	__rq_for_each_bio(bio_src, clone) {
-		if (copy_bio_sector_to_req == 0) {
-			clone->buffer = bio_data(bio_src);
-			copy_bio_sector_to_req++;
-		}
-		blk_queue_bounce(clone->q, &bio_src);
+		break;
 	}
 
-	/*
-	 * Recalculate the phy_segments as we allocate new pages
-	 * This is used by storage driver to fill the sg list.
-	 */
-	blk_recalc_rq_segments(clone);
-
 ablkcipher_req_alloc_failure:
-	if (req)
-		ablkcipher_request_free(req);
+	io->error = error;
+	req_cryptd_crypt_write_done(io);
+	return;
 
-	if (error == DM_REQ_CRYPT_ERROR_AFTER_PAGE_MALLOC) {
-		bvec = NULL;
-		rq_for_each_segment(bvec, clone, iter1) {
-			if (bvec->bv_offset == 0) {
-				mempool_free(bvec->bv_page, req_page_pool);
-				bvec->bv_page = NULL;
-			} else
-				bvec->bv_page = NULL;
-		}
-	}
-
-	mempool_free(req_sg_in, req_scatterlist_pool);
-	mempool_free(req_sg_out, req_scatterlist_pool);
 submit_request:
 	if (io)
 		io->error = error;
@@ -685,18 +738,32 @@ static void req_cryptd_queue_crypt(struct req_dm_crypt_io *io)
 
 /*
  * Cipher complete callback, this is triggered by the Linux crypto api once
- * the operation is done. This signals the waiting thread that the crypto
- * operation is complete.
+ * the operation is done. Reads are completed right away, writes are handed
+ * to the done worker queue since submitting them may sleep.
  */
 static void req_crypt_cipher_complete(struct crypto_async_request *req, int err)
 {
-	struct req_crypt_result *res = req->data;
+	struct req_dm_crypt_io *io = req->data;
 
 	if (err == -EINPROGRESS)
 		return;
 
-	res->err = err;
-	complete(&res->completion);
+	if (rq_data_dir(io->cloned_request) == WRITE) {
+		if (err) {
+			DMERR("%s error = %d encrypting the request\n",
+				 __func__, err);
+			io->error = DM_REQ_CRYPT_ERROR_AFTER_PAGE_MALLOC;
+		}
+		INIT_WORK(&io->work, req_cryptd_crypt_write_done_work);
+		queue_work(req_crypt_done_queue, &io->work);
+	} else {
+		if (err) {
+			DMERR("%s error = %d decrypting the request\n",
+				 __func__, err);
+			io->error = DM_REQ_CRYPT_ERROR;
+		}
+		req_cryptd_crypt_read_done(io);
+	}
 }
 
 /*
@@ -794,6 +861,9 @@ static int req_crypt_map(struct dm_target *ti, struct request *clone,
 	req_io->cloned_request = clone;
 	map_context->ptr = req_io;
 	atomic_set(&req_io->pending, 0);
+	req_io->req = NULL;
+	req_io->req_sg_in = NULL;
+	req_io->req_sg_out = NULL;
 
 	if (rq_data_dir(clone) == WRITE)
 		req_io->should_encrypt = req_crypt_should_encrypt(req_io);
@@ -877,6 +947,10 @@ static void req_crypt_dtr(struct dm_target *ti)
 		destroy_workqueue(req_crypt_queue);
 		req_crypt_queue = NULL;
 	}
+	if (req_crypt_done_queue) {
+		destroy_workqueue(req_crypt_done_queue);
+		req_crypt_done_queue = NULL;
+	}
 	kmem_cache_destroy(_req_dm_scatterlist_pool);
 	kmem_cache_destroy(_req_crypt_io_pool);
 	if (dev) {
@@ -962,17 +1036,33 @@ static int req_crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto ctr_exit;
 	}
 
+	/*
+	 * One submitting worker per CPU, requests stay on the CPU that mapped
+	 * or completed them and the workers never wait on the crypto engine.
+	 */
 	req_crypt_queue = alloc_workqueue("req_cryptd",
-					WQ_UNBOUND |
+					WQ_HIGHPRI |
 					WQ_CPU_INTENSIVE |
 					WQ_MEM_RECLAIM,
-					0);
+					1);
 	if (!req_crypt_queue) {
 		DMERR("%s req_crypt_queue not allocated\n", __func__);
 		err =  DM_REQ_CRYPT_ERROR;
 		goto ctr_exit;
 	}
 
+	req_crypt_done_queue = alloc_workqueue("req_crypt_done",
+					WQ_HIGHPRI |
+					WQ_MEM_RECLAIM,
+					0);
+	if (!req_crypt_done_queue) {
+		DMERR("%s req_crypt_done_queue not allocated\n", __func__);
+		err =  DM_REQ_CRYPT_ERROR;
+		goto ctr_exit;
+	}
+
+	sema_init(&req_crypt_inflight, max_t(unsigned int, max_inflight, 1));
+
 	/* Allocate the crypto alloc blk cipher and keep the handle */
 	tfm = crypto_alloc_ablkcipher("qcom-xts(aes)", 0, 0);
 	if (IS_ERR(tfm)) {
@@ -132,7 +132,6 @@ static int msm_isp_prepare_isp_buf(struct msm_isp_buf_mgr *buf_mgr,
 {
 	int i, rc = -1;
 	struct msm_isp_buffer_mapped_info *mapped_info;
-	struct buffer_cmd *buf_pending = NULL;
 	int domain_num;
 
 	if (buf_mgr->secure_enable == NON_SECURE_MODE)
@@ -162,23 +161,15 @@ static int msm_isp_prepare_isp_buf(struct msm_isp_buf_mgr *buf_mgr,
 		mapped_info->paddr += qbuf_buf->planes[i].offset;
 		CDBG("%s: plane: %d addr:%lu\n",
 			__func__, i, (unsigned long)mapped_info->paddr);
-
-		buf_pending = kzalloc(sizeof(struct buffer_cmd), GFP_ATOMIC);
-		if (!buf_pending) {
-			pr_err("No free memory for buf_pending\n");
-			return rc;
-		}
-
-		buf_pending->mapped_info = mapped_info;
-		list_add_tail(&buf_pending->list, &buf_mgr->buffer_q);
 	}
 	buf_info->num_planes = qbuf_buf->num_planes;
+	buf_info->mapped = 1;
 	return 0;
 ion_map_error:
 	for (--i; i >= 0; i--) {
 		mapped_info = &buf_info->mapped_info[i];
 		ion_unmap_iommu(buf_mgr->client, mapped_info->handle,
-		buf_mgr->iommu_domain_num, 0);
+		domain_num, 0);
 		ion_free(buf_mgr->client, mapped_info->handle);
 	}
 	return rc;
@@ -190,7 +181,6 @@ static void msm_isp_unprepare_v4l2_buf(
 {
 	int i;
 	struct msm_isp_buffer_mapped_info *mapped_info;
-	struct buffer_cmd *buf_pending = NULL;
 	int domain_num;
 
 	if (buf_mgr->secure_enable == NON_SECURE_MODE)
@@ -198,30 +188,21 @@ static void msm_isp_unprepare_v4l2_buf(
 	else
 		domain_num = buf_mgr->iommu_domain_num_secure;
 
+	if (!buf_info->mapped)
+		return;
+
 	if (buf_info->num_planes > VIDEO_MAX_PLANES) {
 		pr_err("%s: Invalid num_planes %d \n",
 			__func__, buf_info->num_planes);
 		return;
 	}
 
+	buf_info->mapped = 0;
 	for (i = 0; i < buf_info->num_planes; i++) {
 		mapped_info = &buf_info->mapped_info[i];
-
-		list_for_each_entry(buf_pending, &buf_mgr->buffer_q, list) {
-			if (!buf_pending)
-				break;
-
-			if (buf_pending->mapped_info == mapped_info) {
-				ion_unmap_iommu(buf_mgr->client,
-					mapped_info->handle,
-					domain_num, 0);
-				ion_free(buf_mgr->client, mapped_info->handle);
-
-				list_del_init(&buf_pending->list);
-				kfree(buf_pending);
-				break;
-			}
-		}
+		ion_unmap_iommu(buf_mgr->client, mapped_info->handle,
+			domain_num, 0);
+		ion_free(buf_mgr->client, mapped_info->handle);
 	}
 	return;
 }
@@ -326,10 +307,7 @@ static int msm_isp_get_buf_by_index(struct msm_isp_buf_mgr *buf_mgr,
 	struct msm_isp_buffer **buf_info)
 {
 	int rc = -EINVAL;
-	unsigned long flags;
 	struct msm_isp_bufq *bufq = NULL;
-	struct msm_isp_buffer *temp_buf_info;
-	uint32_t i = 0;
 
 	bufq = msm_isp_get_bufq(buf_mgr, bufq_handle);
 	if (!bufq) {
@@ -337,29 +315,15 @@ static int msm_isp_get_buf_by_index(struct msm_isp_buf_mgr *buf_mgr,
 		return rc;
 	}
 
-	spin_lock_irqsave(&bufq->bufq_lock, flags);
 	if (buf_index >= bufq->num_bufs) {
 		pr_err("%s: Invalid buf index: %d max: %d\n", __func__,
 			buf_index, bufq->num_bufs);
-		spin_unlock_irqrestore(&bufq->bufq_lock, flags);
 		return rc;
 	}
 
-	*buf_info = NULL;
-	for (i = 0; bufq->num_bufs; i++) {
-		temp_buf_info = &bufq->bufs[i];
-		if (temp_buf_info && temp_buf_info->buf_idx == buf_index) {
-			*buf_info = temp_buf_info;
-			break;
-		}
-	}
-
-	if (*buf_info) {
-		pr_debug("Found buf in isp buf mgr");
-		rc = 0;
-	}
-	spin_unlock_irqrestore(&bufq->bufq_lock, flags);
-	return rc;
+	/* bufs[] is indexed by buf_idx and fixed until the queue is released */
+	*buf_info = &bufq->bufs[buf_index];
+	return 0;
 }
 
 
@@ -371,9 +335,6 @@ static int msm_isp_get_buf(struct msm_isp_buf_mgr *buf_mgr, uint32_t id,
 	struct msm_isp_buffer *temp_buf_info;
 	struct msm_isp_bufq *bufq = NULL;
 	struct vb2_buffer *vb2_buf = NULL;
-	struct buffer_cmd *buf_pending = NULL;
-	struct msm_isp_buffer_mapped_info *mped_info_tmp1;
-	struct msm_isp_buffer_mapped_info *mped_info_tmp2;
 	bufq = msm_isp_get_bufq(buf_mgr, bufq_handle);
 	if (!bufq) {
 		pr_err("%s: Invalid bufq\n", __func__);
@@ -414,27 +375,10 @@ static int msm_isp_get_buf(struct msm_isp_buf_mgr *buf_mgr, uint32_t id,
 		list_for_each_entry(temp_buf_info, &bufq->head, list) {
 			if (temp_buf_info->state ==
 					MSM_ISP_BUFFER_STATE_QUEUED) {
-
-					list_for_each_entry(buf_pending,
-						&buf_mgr->buffer_q, list) {
-					if (!buf_pending)
-						break;
-					mped_info_tmp1 =
-						buf_pending->mapped_info;
-					mped_info_tmp2 =
-						&temp_buf_info->mapped_info[0];
-
-					if (mped_info_tmp1 == mped_info_tmp2
-						&& (mped_info_tmp1->len ==
-							mped_info_tmp2->len)
-						&& (mped_info_tmp1->paddr ==
-						mped_info_tmp2->paddr)) {
-						/* found one buf */
-						list_del_init(
-							&temp_buf_info->list);
-						*buf_info = temp_buf_info;
-						break;
-					}
+				if (temp_buf_info->mapped) {
+					/* found one buf */
+					list_del_init(&temp_buf_info->list);
+					*buf_info = temp_buf_info;
 				}
 				break;
 			}
@@ -445,27 +389,11 @@ static int msm_isp_get_buf(struct msm_isp_buf_mgr *buf_mgr, uint32_t id,
 			bufq->session_id, bufq->stream_id);
 		if (vb2_buf) {
 			if (vb2_buf->v4l2_buf.index < bufq->num_bufs) {
-
-				list_for_each_entry(buf_pending,
-						&buf_mgr->buffer_q, list) {
-					if (!buf_pending)
-						break;
-					mped_info_tmp1 =
-						buf_pending->mapped_info;
-					mped_info_tmp2 =
-					&bufq->bufs[vb2_buf->v4l2_buf.index]
-						.mapped_info[0];
-
-					if (mped_info_tmp1 == mped_info_tmp2
-						&& (mped_info_tmp1->len ==
-							mped_info_tmp2->len)
-						&& (mped_info_tmp1->paddr ==
-						mped_info_tmp2->paddr)) {
-						*buf_info =
+				temp_buf_info =
 					&bufq->bufs[vb2_buf->v4l2_buf.index];
-						(*buf_info)->vb2_buf = vb2_buf;
-						break;
-					}
+				if (temp_buf_info->mapped) {
+					*buf_info = temp_buf_info;
+					(*buf_info)->vb2_buf = vb2_buf;
 				}
 			} else {
 				pr_err("%s: Incorrect buf index %d\n",
@@ -646,11 +574,8 @@ static int msm_isp_buf_done(struct msm_isp_buf_mgr *buf_mgr,
 
 	spin_lock_irqsave(&bufq->bufq_lock, flags);
 	state = buf_info->state;
-	spin_unlock_irqrestore(&bufq->bufq_lock, flags);
-
 	if (state == MSM_ISP_BUFFER_STATE_DEQUEUED ||
 		state == MSM_ISP_BUFFER_STATE_DIVERTED) {
-		spin_lock_irqsave(&bufq->bufq_lock, flags);
 		if (bufq->buf_type == ISP_SHARE_BUF) {
 			buf_info->buf_put_count++;
 			if (buf_info->buf_put_count != ISP_SHARE_BUF_CLIENT) {
@@ -675,6 +600,8 @@ static int msm_isp_buf_done(struct msm_isp_buf_mgr *buf_mgr,
 				return rc;
 			}
 		}
+	} else {
+		spin_unlock_irqrestore(&bufq->bufq_lock, flags);
 	}
 
 	return 0;
@@ -1070,7 +997,6 @@ static int msm_isp_init_isp_buf_mgr(
 	}
 	CDBG("%s: E\n", __func__);
 
-	INIT_LIST_HEAD(&buf_mgr->buffer_q);
 	buf_mgr->num_buf_q = num_buf_q;
 	buf_mgr->bufq =
 		kzalloc(sizeof(struct msm_isp_bufq) * num_buf_q,
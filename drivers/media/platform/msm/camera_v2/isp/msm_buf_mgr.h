@@ -63,15 +63,12 @@ struct msm_isp_buffer_mapped_info {
 	struct ion_handle *handle;
 };
 
-struct buffer_cmd {
-	struct list_head list;
-	struct msm_isp_buffer_mapped_info *mapped_info;
-};
-
 struct msm_isp_buffer {
 	/*Common Data structure*/
 	int num_planes;
 	struct msm_isp_buffer_mapped_info mapped_info[VIDEO_MAX_PLANES];
+	/*Set once all planes are mapped, cleared on unmap*/
+	uint8_t mapped;
 	int buf_idx;
 	uint32_t bufq_handle;
 	uint32_t frame_id;
@@ -181,7 +178,6 @@ struct msm_isp_buf_mgr {
 
 	int num_iommu_ctx;
 	struct device *iommu_ctx[2];
-	struct list_head buffer_q;
 	int num_iommu_secure_ctx;
 	struct device *iommu_secure_ctx[2];
 	int attach_ref_cnt[MAX_PROTECTION_MODE][MAX_IOMMU_CTX];
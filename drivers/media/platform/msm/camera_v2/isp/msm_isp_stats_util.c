@@ -89,6 +89,19 @@ void msm_isp_process_stats_irq(struct vfe_device *vfe_dev,
 		return;
 	ISP_DBG("%s: status: 0x%x\n", __func__, irq_status0);
 
+	/*
+	 * All groups done in this irq belong to the same frame: read the
+	 * ping-pong status once and send one composite event for all of
+	 * them, so 3A dequeues the frame's stats with a single event.
+	 */
+	memset(&buf_event, 0, sizeof(struct msm_isp_event_data));
+	buf_event.timestamp = ts->event_time;
+	buf_event.frame_id =
+		vfe_dev->axi_data.src_info[VFE_PIX_0].frame_id;
+	buf_event.input_intf = VFE_PIX_0;
+	pingpong_status = vfe_dev->hw_info->
+		vfe_ops.stats_ops.get_pingpong_status(vfe_dev);
+
 	/*
 	 * If any of composite mask is set, clear irq bits from mask,
 	 * they will be restored by comp mask
@@ -113,13 +126,6 @@ void msm_isp_process_stats_irq(struct vfe_device *vfe_dev,
 		/* if no irq bits set from this composite mask continue*/
 		if (!stats_irq_mask)
 			continue;
-		memset(&buf_event, 0, sizeof(struct msm_isp_event_data));
-		buf_event.timestamp = ts->event_time;
-		buf_event.frame_id =
-			vfe_dev->axi_data.src_info[VFE_PIX_0].frame_id;
-		buf_event.input_intf = VFE_PIX_0;
-		pingpong_status = vfe_dev->hw_info->
-			vfe_ops.stats_ops.get_pingpong_status(vfe_dev);
 
 		for (i = 0; i < vfe_dev->hw_info->stats_hw_info->num_stats_type;
 			i++) {
@@ -159,16 +165,15 @@ void msm_isp_process_stats_irq(struct vfe_device *vfe_dev,
 				}
 			}
 		}
+	}
 
-		if (comp_stats_type_mask) {
-			ISP_DBG("%s: comp_stats frameid: 0x%x, 0x%x\n",
-				__func__, buf_event.frame_id,
-				comp_stats_type_mask);
-			stats_event->stats_mask = comp_stats_type_mask;
-			msm_isp_send_event(vfe_dev,
-				ISP_EVENT_COMP_STATS_NOTIFY, &buf_event);
-			comp_stats_type_mask = 0;
-		}
+	if (comp_stats_type_mask) {
+		ISP_DBG("%s: comp_stats frameid: 0x%x, 0x%x\n",
+			__func__, buf_event.frame_id,
+			comp_stats_type_mask);
+		stats_event->stats_mask = comp_stats_type_mask;
+		msm_isp_send_event(vfe_dev,
+			ISP_EVENT_COMP_STATS_NOTIFY, &buf_event);
 	}
 }
 
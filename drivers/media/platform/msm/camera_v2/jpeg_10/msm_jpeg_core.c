@@ -28,6 +28,7 @@ int msm_jpeg_core_reset(struct msm_jpeg_device *pgmn_dev, uint8_t op_mode,
 	pgmn_dev->fe_pingpong_buf.is_fe = 1;
 	memset(&pgmn_dev->we_pingpong_buf, 0,
 		sizeof(pgmn_dev->we_pingpong_buf));
+	pgmn_dev->fe_start_pending = 0;
 	spin_lock_irqsave(&pgmn_dev->reset_lock, flags);
 	pgmn_dev->reset_done_ack = 0;
 	if (pgmn_dev->core_type == MSM_JPEG_CORE_CODEC)
@@ -178,6 +179,25 @@ void *msm_jpeg_core_err_irq(int jpeg_irq_status,
 
 static int (*msm_jpeg_irq_handler) (int, void *, void *);
 
+/*
+ * Called after the framedone handlers have returned the finished buffers
+ * and programmed the next queued ones. If both an input and an output
+ * buffer are ready, start the next image straight from the interrupt so
+ * queued images encode back to back; otherwise the core goes idle.
+ */
+static void msm_jpeg_core_start_next(struct msm_jpeg_device *pgmn_dev)
+{
+	if (pgmn_dev->fe_start_pending &&
+		pgmn_dev->we_pingpong_buf.buf_status[0]) {
+		JPEG_DBG("%s:%d] start next\n", __func__, __LINE__);
+		pgmn_dev->fe_start_pending = 0;
+		msm_jpeg_core_fe_start(pgmn_dev);
+		return;
+	}
+	pgmn_dev->fe_start_pending = 0;
+	pgmn_dev->state = MSM_JPEG_INIT;
+}
+
 void msm_jpeg_core_return_buffers(struct msm_jpeg_device *pgmn_dev,
 	 int jpeg_irq_status)
 {
@@ -244,7 +264,7 @@ irqreturn_t msm_jpeg_core_irq(int irq_num, void *context)
 			msm_jpeg_irq_handler(
 				MSM_JPEG_HW_MASK_COMP_FRAMEDONE,
 				context, data);
-		pgmn_dev->state = MSM_JPEG_INIT;
+		msm_jpeg_core_start_next(pgmn_dev);
 	}
 	if (msm_jpeg_hw_irq_is_reset_ack(jpeg_irq_status)) {
 		data = msm_jpeg_core_reset_ack_irq(jpeg_irq_status,
@@ -274,6 +294,7 @@ irqreturn_t msm_jpeg_core_irq(int irq_num, void *context)
 			if (pgmn_dev->decode_flag)
 				msm_jpeg_decode_status(pgmn_dev->base);
 			msm_jpeg_core_return_buffers(pgmn_dev, jpeg_irq_status);
+			pgmn_dev->fe_start_pending = 0;
 			data = msm_jpeg_core_err_irq(jpeg_irq_status, pgmn_dev);
 			if (msm_jpeg_irq_handler) {
 				msm_jpeg_irq_handler(MSM_JPEG_HW_MASK_COMP_ERR,
@@ -333,7 +354,7 @@ irqreturn_t msm_jpegdma_core_irq(int irq_num, void *context)
 			msm_jpeg_irq_handler(
 				MSM_JPEG_HW_MASK_COMP_FRAMEDONE,
 				context, data);
-		pgmn_dev->state = MSM_JPEG_INIT;
+		msm_jpeg_core_start_next(pgmn_dev);
 	}
 	if (msm_jpegdma_hw_irq_is_reset_ack(jpeg_irq_status)) {
 		data = msm_jpeg_core_reset_ack_irq(jpeg_irq_status,
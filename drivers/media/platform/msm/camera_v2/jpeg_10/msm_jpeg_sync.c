@@ -545,7 +545,7 @@ int msm_jpeg_fe_pingpong_irq(struct msm_jpeg_device *pgmn_dev,
 	if (buf_out) {
 		rc = msm_jpeg_core_fe_buf_update(pgmn_dev, buf_out);
 		kfree(buf_out);
-		msm_jpeg_core_fe_start(pgmn_dev);
+		pgmn_dev->fe_start_pending = 1;
 	} else {
 		JPEG_DBG("%s:%d] no input buffer\n", __func__, __LINE__);
 		rc = -EFAULT;
@@ -878,6 +878,7 @@ int msm_jpeg_start(struct msm_jpeg_device *pgmn_dev, void * __user arg,
 	JPEG_DBG("%s:%d] Enter\n", __func__, __LINE__);
 
 	pgmn_dev->release_buf = 1;
+	pgmn_dev->fe_start_pending = 0;
 	for (i = 0; i < 2; i++) {
 		buf_out = msm_jpeg_q_out(&pgmn_dev->input_buf_q);
 
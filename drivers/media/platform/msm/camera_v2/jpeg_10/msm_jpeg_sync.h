@@ -107,6 +107,8 @@ struct msm_jpeg_device {
 	struct ion_client *jpeg_client;
 	void *jpeg_vbif;
 	int release_buf;
+	/* next input is programmed, start it once the output is too */
+	int fe_start_pending;
 	struct msm_jpeg_hw_pingpong fe_pingpong_buf;
 	struct msm_jpeg_hw_pingpong we_pingpong_buf;
 	int we_pingpong_index;
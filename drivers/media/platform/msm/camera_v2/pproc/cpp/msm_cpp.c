@@ -280,6 +280,7 @@ static int get_clock_index(const char *clk_name)
 
 static int msm_cpp_notify_frame_done(struct cpp_device *cpp_dev,
 	uint8_t put_buf);
+static void msm_cpp_submit_pending(struct cpp_device *cpp_dev);
 static void cpp_load_fw(struct cpp_device *cpp_dev, char *fw_name_bin);
 static void cpp_timer_callback(unsigned long data);
 
@@ -789,6 +790,9 @@ void msm_cpp_do_tasklet(unsigned long data)
 			}
 		}
 	}
+	/* refill the firmware queue, sending a frame may sleep */
+	if (cpp_dev->pending_q.len)
+		queue_work(cpp_dev->timer_wq, &cpp_dev->submit_work);
 }
 
 static void cpp_get_clk_freq_tbl(struct clk *clk, struct cpp_hw_info *hw_info)
@@ -1190,6 +1194,7 @@ static int cpp_close_node(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 	uint32_t i;
 	struct cpp_device *cpp_dev = NULL;
 	struct msm_device_queue *processing_q = NULL;
+	struct msm_device_queue *pending_q = NULL;
 	struct msm_device_queue *eventData_q = NULL;
 
 	if (!sd) {
@@ -1206,6 +1211,7 @@ static int cpp_close_node(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 	mutex_lock(&cpp_dev->mutex);
 
 	processing_q = &cpp_dev->processing_q;
+	pending_q = &cpp_dev->pending_q;
 	eventData_q = &cpp_dev->eventData_q;
 
 	if (cpp_dev->cpp_open_cnt == 0) {
@@ -1268,6 +1274,7 @@ static int cpp_close_node(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 		}
 		cpp_deinit_mem(cpp_dev);
 		msm_cpp_empty_list(processing_q, list_frame);
+		msm_cpp_empty_list(pending_q, list_frame);
 		msm_cpp_empty_list(eventData_q, list_eventdata);
 		cpp_dev->state = CPP_STATE_OFF;
 	}
@@ -1449,6 +1456,7 @@ static void msm_cpp_do_timeout_work(struct work_struct *work)
 	atomic_set(&cpp_timer.used, 0);
 	cpp_timer.data.processed_frame = NULL;
 	cpp_timer.data.cpp_dev->timeout_trial_cnt = 0;
+	msm_cpp_submit_pending(cpp_timer.data.cpp_dev);
 	mutex_unlock(&cpp_timer.data.cpp_dev->mutex);
 	pr_info("exit\n");
 	return;
@@ -1462,7 +1470,7 @@ void cpp_timer_callback(unsigned long data)
 		(struct work_struct *)work);
 }
 
-static int msm_cpp_send_frame_to_hardware(struct cpp_device *cpp_dev,
+static int msm_cpp_write_frame(struct cpp_device *cpp_dev,
 	struct msm_queue_cmd *frame_qcmd)
 {
 	uint32_t i;
@@ -1506,6 +1514,54 @@ static int msm_cpp_send_frame_to_hardware(struct cpp_device *cpp_dev,
 		do_gettimeofday(&(process_frame->in_time));
 		rc = 0;
 	}
+	return rc;
+}
+
+/*
+ * Move frames from the pending queue into the free processing slots.
+ * Called with cpp_dev->mutex held.
+ */
+static void msm_cpp_submit_pending(struct cpp_device *cpp_dev)
+{
+	struct msm_queue_cmd *frame_qcmd;
+	struct msm_device_queue *queue = &cpp_dev->pending_q;
+
+	while (cpp_dev->processing_q.len < MAX_CPP_PROCESSING_FRAME) {
+		frame_qcmd = msm_dequeue(queue, list_frame);
+		if (!frame_qcmd)
+			break;
+		msm_cpp_write_frame(cpp_dev, frame_qcmd);
+	}
+}
+
+static void msm_cpp_submit_work(struct work_struct *work)
+{
+	struct cpp_device *cpp_dev =
+		container_of(work, struct cpp_device, submit_work);
+
+	mutex_lock(&cpp_dev->mutex);
+	if (cpp_dev->state == CPP_STATE_ACTIVE)
+		msm_cpp_submit_pending(cpp_dev);
+	mutex_unlock(&cpp_dev->mutex);
+}
+
+static int msm_cpp_send_frame_to_hardware(struct cpp_device *cpp_dev,
+	struct msm_queue_cmd *frame_qcmd)
+{
+	int32_t rc = -EAGAIN;
+
+	/*
+	 * Park the frame while both firmware slots are busy instead of
+	 * dropping it, so userspace can queue a burst back to back. The
+	 * frame done path refills the slots from the pending queue.
+	 */
+	msm_cpp_submit_pending(cpp_dev);
+	if (!cpp_dev->pending_q.len)
+		rc = msm_cpp_write_frame(cpp_dev, frame_qcmd);
+	if (rc < 0 && cpp_dev->pending_q.len < MAX_CPP_PENDING_FRAME) {
+		msm_enqueue(&cpp_dev->pending_q, &frame_qcmd->list_frame);
+		rc = 0;
+	}
 	if (rc < 0)
 		pr_err("process queue full. drop frame\n");
 	return rc;
@@ -1846,6 +1902,18 @@ void msm_cpp_clean_queue(struct cpp_device *cpp_dev)
 			kfree(processed_frame);
 		}
 	}
+
+	while (cpp_dev->pending_q.len) {
+		queue = &cpp_dev->pending_q;
+		frame_qcmd = msm_dequeue(queue, list_frame);
+		if (frame_qcmd) {
+			processed_frame = frame_qcmd->command;
+			kfree(frame_qcmd);
+			if (processed_frame)
+				kfree(processed_frame->cpp_cmd_msg);
+			kfree(processed_frame);
+		}
+	}
 }
 
 #ifdef CONFIG_COMPAT
@@ -3150,6 +3218,8 @@ static int cpp_probe(struct platform_device *pdev)
 
 	msm_queue_init(&cpp_dev->eventData_q, "eventdata");
 	msm_queue_init(&cpp_dev->processing_q, "frame");
+	msm_queue_init(&cpp_dev->pending_q, "pending");
+	INIT_WORK(&cpp_dev->submit_work, msm_cpp_submit_work);
 	INIT_LIST_HEAD(&cpp_dev->tasklet_q);
 	tasklet_init(&cpp_dev->cpp_tasklet, msm_cpp_do_tasklet,
 		(unsigned long)cpp_dev);
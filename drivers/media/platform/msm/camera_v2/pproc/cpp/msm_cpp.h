@@ -37,6 +37,7 @@
 
 #define MAX_ACTIVE_CPP_INSTANCE 8
 #define MAX_CPP_PROCESSING_FRAME 2
+#define MAX_CPP_PENDING_FRAME 8
 #define MAX_CPP_V4l2_EVENTS 30
 
 #define MSM_CPP_MICRO_BASE          0x4000
@@ -225,6 +226,12 @@ struct cpp_device {
 	 */
 	struct msm_device_queue processing_q;
 
+	/* Pending Queue
+	 * store frames waiting for a free slot in the processing queue
+	 */
+	struct msm_device_queue pending_q;
+	struct work_struct submit_work;
+
 	struct msm_cpp_buff_queue_info_t *buff_queue;
 	uint32_t num_buffq;
 	struct v4l2_subdev *buf_mgr_subdev;
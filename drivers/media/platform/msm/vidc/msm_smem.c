@@ -12,6 +12,8 @@
  */
 
 #include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
 #include <linux/msm_ion.h>
 #include <linux/types.h>
 #include <linux/msm_iommu_domains.h>
@@ -22,6 +24,22 @@ struct smem_client {
 	int mem_type;
 	void *clnt;
 	struct msm_vidc_platform_resources *res;
+	struct mutex map_lock;
+	struct list_head map_cache;
+	u32 map_cnt;
+};
+
+/*
+ * An iommu mapping of a user buffer kept alive by the session. It holds a
+ * reference on both the ion handle and the mapping, so when the buffer
+ * is registered again ion_map_iommu() only has to take a reference on
+ * the existing mapping instead of building a new one.
+ */
+struct smem_map_entry {
+	struct list_head list;
+	struct ion_handle *hndl;
+	int domain;
+	int partition;
 };
 
 static int get_device_address(struct smem_client *smem_client,
@@ -109,6 +127,103 @@ static void put_device_address(struct smem_client *smem_client,
 	}
 }
 
+static void smem_map_entry_free(struct smem_client *client,
+		struct smem_map_entry *entry)
+{
+	list_del(&entry->list);
+	client->map_cnt--;
+	put_device_address(client, entry->hndl, entry->domain,
+			entry->partition, 0);
+	ion_free(client->clnt, entry->hndl);
+	kfree(entry);
+}
+
+static void smem_map_cache_trim(struct smem_client *client, u32 max)
+{
+	struct smem_map_entry *entry;
+
+	while (client->map_cnt > max) {
+		entry = list_entry(client->map_cache.prev,
+				struct smem_map_entry, list);
+		smem_map_entry_free(client, entry);
+	}
+}
+
+/*
+ * Keep the mapping of a user buffer that was just mapped. Entries are
+ * kept in LRU order, the least recently registered buffer is unmapped
+ * once the session holds more than msm_vidc_smem_map_cache of them.
+ */
+static void smem_map_cache_get(struct smem_client *client, int fd,
+		struct ion_handle *hndl, unsigned long align,
+		unsigned long flags, enum hal_buffer buffer_type)
+{
+	struct smem_map_entry *entry;
+	struct ion_handle *ref;
+	ion_phys_addr_t iova = 0;
+	unsigned long buffer_size = 0;
+	int domain, partition;
+	u32 max = msm_vidc_smem_map_cache;
+
+	if (!is_iommu_present(client->res))
+		return;
+
+	if (msm_smem_get_domain_partition(client, flags, buffer_type,
+				&domain, &partition))
+		return;
+
+	mutex_lock(&client->map_lock);
+	list_for_each_entry(entry, &client->map_cache, list) {
+		if (entry->hndl == hndl && entry->domain == domain &&
+				entry->partition == partition) {
+			list_move(&entry->list, &client->map_cache);
+			goto exit;
+		}
+	}
+
+	smem_map_cache_trim(client, max ? max - 1 : 0);
+	if (!max)
+		goto exit;
+
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		goto exit;
+
+	/* importing the fd again takes another reference on the handle */
+	ref = ion_import_dma_buf(client->clnt, fd);
+	if (IS_ERR_OR_NULL(ref))
+		goto fail_import;
+	if (ref != hndl)
+		goto fail_map;
+
+	if (get_device_address(client, hndl, align, &iova, &buffer_size,
+				flags, buffer_type))
+		goto fail_map;
+
+	entry->hndl = hndl;
+	entry->domain = domain;
+	entry->partition = partition;
+	list_add(&entry->list, &client->map_cache);
+	client->map_cnt++;
+	dprintk(VIDC_DBG, "%s: caching mapping of %pK, %u cached\n",
+			__func__, hndl, client->map_cnt);
+	goto exit;
+
+fail_map:
+	ion_free(client->clnt, ref);
+fail_import:
+	kfree(entry);
+exit:
+	mutex_unlock(&client->map_lock);
+}
+
+static void smem_map_cache_flush(struct smem_client *client)
+{
+	mutex_lock(&client->map_lock);
+	smem_map_cache_trim(client, 0);
+	mutex_unlock(&client->map_lock);
+}
+
 static int ion_user_to_kernel(struct smem_client *client, int fd, u32 offset,
 		struct msm_smem *mem, enum hal_buffer buffer_type)
 {
@@ -152,6 +267,7 @@ static int ion_user_to_kernel(struct smem_client *client, int fd, u32 offset,
 			&iova, (u32)mem->device_addr);
 		goto fail_device_address;
 	}
+	smem_map_cache_get(client, fd, hndl, align, mem->flags, buffer_type);
 	dprintk(VIDC_DBG,
 		"%s: ion_handle = 0x%pK, fd = %d, device_addr = 0x%pa, size = %zx, kvaddr = 0x%pK, buffer_type = %d, flags = 0x%lx\n",
 		__func__, mem->smem_priv, fd, &mem->device_addr, mem->size,
@@ -433,6 +549,8 @@ void *msm_smem_new_client(enum smem_type mtype,
 			client->mem_type = mtype;
 			client->clnt = clnt;
 			client->res = res;
+			mutex_init(&client->map_lock);
+			INIT_LIST_HEAD(&client->map_cache);
 		}
 	} else {
 		dprintk(VIDC_ERR, "Failed to create new client: mtype = %d\n",
@@ -507,6 +625,7 @@ void msm_smem_delete_client(void *clt)
 	}
 	switch (client->mem_type) {
 	case SMEM_ION:
+		smem_map_cache_flush(client);
 		ion_delete_client(client);
 		break;
 	default:
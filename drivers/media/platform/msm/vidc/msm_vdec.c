@@ -1722,6 +1722,8 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 			goto fail_start;
 		}
 	}
+	/* the buffers queued before streamon go out with one interrupt */
+	call_hfi_op(hdev, cmdq_batch_begin, hdev->hfi_device_data);
 	mutex_lock(&inst->pendingq.lock);
 	list_for_each_safe(ptr, next, &inst->pendingq.list) {
 		temp = list_entry(ptr, struct vb2_buf_entry, list);
@@ -1735,6 +1737,7 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 		kfree(temp);
 	}
 	mutex_unlock(&inst->pendingq.lock);
+	call_hfi_op(hdev, cmdq_batch_end, hdev->hfi_device_data);
 	return rc;
 fail_start:
 	return rc;
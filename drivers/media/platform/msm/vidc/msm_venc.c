@@ -1417,11 +1417,13 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 	int rc = 0;
 	struct vb2_buf_entry *temp;
 	struct list_head *ptr, *next;
+	struct hfi_device *hdev;
 
 	if (!inst || !inst->core || !inst->core->device) {
 		dprintk(VIDC_ERR, "%s invalid parameters\n", __func__);
 		return -EINVAL;
 	}
+	hdev = inst->core->device;
 
 	if (inst->capability.pixelprocess_capabilities &
 		HAL_VIDEO_ENCODER_SCALING_CAPABILITY)
@@ -1455,6 +1457,8 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 			"Failed to move inst: %pK to start done state\n", inst);
 		goto fail_start;
 	}
+	/* the buffers queued before streamon go out with one interrupt */
+	call_hfi_op(hdev, cmdq_batch_begin, hdev->hfi_device_data);
 	mutex_lock(&inst->pendingq.lock);
 	list_for_each_safe(ptr, next, &inst->pendingq.list) {
 		temp = list_entry(ptr, struct vb2_buf_entry, list);
@@ -1468,6 +1472,7 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 		kfree(temp);
 	}
 	mutex_unlock(&inst->pendingq.lock);
+	call_hfi_op(hdev, cmdq_batch_end, hdev->hfi_device_data);
 	return rc;
 fail_start:
 	return rc;
@@ -15,6 +15,7 @@
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/kernel.h>
+#include <linux/math64.h>
 #include <soc/qcom/subsystem_restart.h>
 #include <asm/div64.h>
 #include "msm_vidc_common.h"
@@ -95,6 +96,9 @@ static void handle_session_error(enum command_response cmd, void *data);
 static void msm_comm_dcvs_monitor_buffer(struct msm_vidc_inst *inst);
 static int msm_comm_scale_clocks_dcvs(struct msm_vidc_inst *inst, bool fbd);
 static int msm_comm_check_dcvs_supported(struct msm_vidc_inst *inst);
+static void msm_comm_dcvs_update_busy(struct msm_vidc_inst *inst);
+static void msm_comm_dcvs_check_load(struct msm_vidc_inst *inst);
+static void msm_comm_dcvs_reset_load(struct msm_vidc_inst *inst);
 
 static inline bool is_turbo_session(struct msm_vidc_inst *inst)
 {
@@ -181,6 +185,7 @@ enum load_calc_quirks {
 	LOAD_CALC_IGNORE_TURBO_LOAD = 1 << 0,
 	LOAD_CALC_IGNORE_THUMBNAIL_LOAD = 1 << 1,
 	LOAD_CALC_IGNORE_NON_REALTIME_LOAD = 1 << 2,
+	LOAD_CALC_MEASURED = 1 << 3,
 };
 
 static int msm_comm_get_inst_load(struct msm_vidc_inst *inst,
@@ -194,6 +199,9 @@ static int msm_comm_get_inst_load(struct msm_vidc_inst *inst,
 
 	load = msm_comm_get_mbs_per_sec(inst);
 
+	if ((quirks & LOAD_CALC_MEASURED) && inst->dcvs.measured_load)
+		load = min(load, inst->dcvs.measured_load);
+
 	if (is_thumbnail_session(inst)) {
 		if (quirks & LOAD_CALC_IGNORE_THUMBNAIL_LOAD)
 			load = 0;
@@ -1394,6 +1402,7 @@ static void handle_ebd(enum command_response cmd, void *data)
 		mutex_unlock(&inst->bufq[OUTPUT_PORT].lock);
 		wake_up(&inst->kernel_event_queue);
 		msm_vidc_debugfs_update(inst, MSM_VIDC_DEBUGFS_EVENT_EBD);
+		msm_comm_dcvs_update_busy(inst);
 	}
 }
 
@@ -1670,6 +1679,7 @@ static void handle_fbd(enum command_response cmd, void *data)
 			break;
 		}
 		inst->count.fbd++;
+		msm_comm_dcvs_update_busy(inst);
 		if (fill_buf_done->filled_len1)
 			msm_vidc_debugfs_update(inst,
 				MSM_VIDC_DEBUGFS_EVENT_FBD);
@@ -1849,6 +1859,9 @@ void msm_comm_init_dcvs_load(struct msm_vidc_inst *inst)
 	core = inst->core;
 	dcvs = &inst->dcvs;
 
+	dcvs->measured_load = 0;
+	msm_comm_dcvs_reset_load(inst);
+
 	dcvs->load = msm_comm_get_inst_load(inst, LOAD_CALC_NO_QUIRKS);
 
 	if (dcvs->load >= DCVS_NOMINAL_LOAD) {
@@ -2097,8 +2110,8 @@ static int msm_comm_scale_clocks(struct msm_vidc_core *core)
 	}
 	mutex_unlock(&core->lock);
 	num_mbs_per_sec =
-		msm_comm_get_load(core, MSM_VIDC_ENCODER, LOAD_CALC_NO_QUIRKS) +
-		msm_comm_get_load(core, MSM_VIDC_DECODER, LOAD_CALC_NO_QUIRKS);
+		msm_comm_get_load(core, MSM_VIDC_ENCODER, LOAD_CALC_MEASURED) +
+		msm_comm_get_load(core, MSM_VIDC_DECODER, LOAD_CALC_MEASURED);
 
 
 	dprintk(VIDC_INFO, "num_mbs_per_sec = %d codecs_enabled 0x%x\n",
@@ -2110,6 +2123,122 @@ static int msm_comm_scale_clocks(struct msm_vidc_core *core)
 	return rc;
 }
 
+/*
+ * Load based DCVS: track the time venus has both an input and an output
+ * buffer of the session to work on. Decoders whose content takes less
+ * than the worst case per frame are then voted for the load they
+ * actually need instead of resolution x fps.
+ */
+static void msm_comm_dcvs_update_busy(struct msm_vidc_inst *inst)
+{
+	struct dcvs_stats *dcvs = &inst->dcvs;
+	ktime_t now;
+	bool busy;
+
+	if (inst->session_type != MSM_VIDC_DECODER)
+		return;
+
+	mutex_lock(&inst->lock);
+	busy = inst->count.etb > inst->count.ebd &&
+		inst->count.ftb > inst->count.fbd;
+	if (busy != dcvs->busy) {
+		now = ktime_get();
+		if (busy)
+			dcvs->busy_start = now;
+		else
+			dcvs->busy_us += ktime_us_delta(now, dcvs->busy_start);
+		dcvs->busy = busy;
+	}
+	mutex_unlock(&inst->lock);
+}
+
+static void msm_comm_dcvs_reset_load(struct msm_vidc_inst *inst)
+{
+	struct dcvs_stats *dcvs = &inst->dcvs;
+
+	mutex_lock(&inst->lock);
+	dcvs->busy_us = 0;
+	dcvs->busy_start = dcvs->window_start = ktime_get();
+	mutex_unlock(&inst->lock);
+}
+
+/*
+ * Once per DCVS_LOAD_WINDOW_MS, rescale the session's vote so venus would
+ * have been busy DCVS_LOAD_TARGET_UTIL percent of the window. The vote
+ * goes back to the static load as soon as fewer than
+ * DCVS_MIN_DISPLAY_BUFF output buffers are left outside the firmware,
+ * i.e. when the decoder starts to fall behind the display.
+ */
+static void msm_comm_dcvs_check_load(struct msm_vidc_inst *inst)
+{
+	struct dcvs_stats *dcvs = &inst->dcvs;
+	struct hal_buffer_requirements *output_buf_req;
+	int static_load, old_load, load, util;
+	int buffers_outside_fw = INT_MAX;
+	s64 window_us, busy_us;
+	ktime_t now;
+
+	if (inst->session_type != MSM_VIDC_DECODER)
+		return;
+
+	if (!msm_vidc_load_dcvs || inst->dcvs_mode ||
+		is_turbo_session(inst) || is_thumbnail_session(inst)) {
+		if (dcvs->measured_load) {
+			dcvs->measured_load = 0;
+			msm_comm_scale_clocks(inst->core);
+		}
+		return;
+	}
+
+	now = ktime_get();
+	mutex_lock(&inst->lock);
+	window_us = ktime_us_delta(now, dcvs->window_start);
+	if (window_us < DCVS_LOAD_WINDOW_MS * USEC_PER_MSEC) {
+		mutex_unlock(&inst->lock);
+		return;
+	}
+
+	busy_us = dcvs->busy_us;
+	if (dcvs->busy) {
+		busy_us += ktime_us_delta(now, dcvs->busy_start);
+		dcvs->busy_start = now;
+	}
+	dcvs->busy_us = 0;
+	dcvs->window_start = now;
+
+	output_buf_req = get_buff_req_buffer(inst,
+		msm_comm_get_hal_output_buffer(inst));
+	if (output_buf_req)
+		buffers_outside_fw = output_buf_req->buffer_count_actual -
+			get_pending_bufs_fw(inst);
+	mutex_unlock(&inst->lock);
+
+	static_load = msm_comm_get_inst_load(inst, LOAD_CALC_NO_QUIRKS);
+	old_load = dcvs->measured_load ? : static_load;
+	util = (int)div64_s64(busy_us * 100, window_us);
+
+	if (buffers_outside_fw < DCVS_MIN_DISPLAY_BUFF)
+		load = static_load;
+	else
+		load = mult_frac(old_load, util, DCVS_LOAD_TARGET_UTIL);
+	load = clamp(load, static_load / DCVS_LOAD_MIN_DIV, static_load);
+
+	dprintk(VIDC_PROF,
+		"DCVS: util %d%% buffers_outside_fw %d load %d -> %d (static %d)\n",
+		util, buffers_outside_fw, old_load, load, static_load);
+
+	if (load != static_load && abs(load - old_load) * 100 <
+			old_load * DCVS_LOAD_HYSTERESIS)
+		return;
+
+	if (load == old_load)
+		return;
+
+	dcvs->measured_load = load == static_load ? 0 : load;
+	if (msm_comm_scale_clocks(inst->core))
+		dprintk(VIDC_WARN, "%s: Failed to scale clocks\n", __func__);
+}
+
 void msm_comm_scale_clocks_and_bus(struct msm_vidc_inst *inst)
 {
 	struct msm_vidc_core *core;
@@ -3450,9 +3579,11 @@ int msm_comm_qbuf(struct vb2_buffer *vb)
 
 			rc = call_hfi_op(hdev, session_etb, (void *)
 					inst->session, &frame_data);
-			if (!rc)
+			if (!rc) {
 				msm_vidc_debugfs_update(inst,
 					MSM_VIDC_DEBUGFS_EVENT_ETB);
+				msm_comm_dcvs_update_busy(inst);
+			}
 			dprintk(VIDC_DBG, "Sent etb to HAL\n");
 		} else if (q->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
 			struct vidc_seq_hdr seq_hdr;
@@ -3516,11 +3647,14 @@ int msm_comm_qbuf(struct vb2_buffer *vb)
 							"%s: Failed to scale clocks in DCVS: %d\n",
 							__func__, rc);
 				}
+				msm_comm_dcvs_check_load(inst);
 				rc = call_hfi_op(hdev, session_ftb,
 					(void *) inst->session, &frame_data);
-				if (!rc)
+				if (!rc) {
 					msm_vidc_debugfs_update(inst,
 						MSM_VIDC_DEBUGFS_EVENT_FTB);
+					msm_comm_dcvs_update_busy(inst);
+				}
 			}
 		} else {
 			dprintk(VIDC_ERR,
@@ -27,6 +27,8 @@ u32 msm_fw_coverage = 0x0;
 int msm_vidc_dcvs_mode = 0x1;
 int msm_vidc_sys_idle_indicator = 0x0;
 u32 msm_vidc_firmware_unload_delay = 15000;
+u32 msm_vidc_smem_map_cache = 32;
+u32 msm_vidc_load_dcvs = 0x1;
 
 #define DYNAMIC_BUF_OWNER(__binfo) ({ \
 	atomic_read(&__binfo->ref_count) == 2 ? "video driver" : "firmware";\
@@ -222,6 +224,18 @@ struct dentry *msm_vidc_debugfs_init_drv(void)
 			"debugfs_create_file: firmware_unload_delay fail\n");
 		goto failed_create_dir;
 	}
+	if (!debugfs_create_u32("smem_map_cache", S_IRUGO | S_IWUSR,
+			dir, &msm_vidc_smem_map_cache)) {
+		dprintk(VIDC_ERR,
+			"debugfs_create_file: smem_map_cache fail\n");
+		goto failed_create_dir;
+	}
+	if (!debugfs_create_u32("load_dcvs", S_IRUGO | S_IWUSR,
+			dir, &msm_vidc_load_dcvs)) {
+		dprintk(VIDC_ERR,
+			"debugfs_create_file: load_dcvs fail\n");
+		goto failed_create_dir;
+	}
 	return dir;
 
 failed_create_dir:
@@ -63,6 +63,8 @@ extern int msm_vidc_vpe_csc_601_to_709;
 extern int msm_vidc_dcvs_mode;
 extern int msm_vidc_sys_idle_indicator;
 extern u32 msm_vidc_firmware_unload_delay;
+extern u32 msm_vidc_smem_map_cache;
+extern u32 msm_vidc_load_dcvs;
 
 #define VIDC_MSG_PRIO2STRING(__level) ({ \
 	char *__str; \
@@ -78,6 +78,14 @@
 #define DCVS_FTB_WINDOW 32
 /* Supported DCVS MBs per frame */
 #define DCVS_MIN_SUPPORTED_MBPERFRAME NUM_MBS_PER_FRAME(2160, 3840)
+/* Window over which venus busy time is measured for load based DCVS */
+#define DCVS_LOAD_WINDOW_MS 500
+/* Venus utilization (percent) load based DCVS aims for */
+#define DCVS_LOAD_TARGET_UTIL 80
+/* Load based DCVS never goes below static load / this */
+#define DCVS_LOAD_MIN_DIV 4
+/* Ignore measured load changes smaller than this (percent) */
+#define DCVS_LOAD_HYSTERESIS 10
 
 enum vidc_ports {
 	OUTPUT_PORT,
@@ -210,6 +218,11 @@ struct dcvs_stats {
 	int min_threshold;
 	int max_threshold;
 	bool is_clock_scaled;
+	bool busy;
+	ktime_t busy_start;
+	s64 busy_us;
+	ktime_t window_start;
+	int measured_load;
 };
 
 struct profile_data {
@@ -1856,7 +1856,9 @@ static int venus_hfi_iface_cmdq_write_nolock(struct venus_hfi_device *device,
 			dprintk(VIDC_ERR, "Clock scaling failed\n");
 			goto err_q_write;
 		}
-		if (rx_req_is_set)
+		if (rx_req_is_set && device->cmdq_batch)
+			device->cmdq_intr_pending = true;
+		else if (rx_req_is_set)
 			venus_hfi_write_register(
 				device, VIDC_CPU_IC_SOFTINT,
 				1 << VIDC_CPU_IC_SOFTINT_H2A_SHFT);
@@ -1882,6 +1884,50 @@ err_q_null:
 	return result;
 }
 
+/*
+ * Commands written between venus_hfi_cmdq_batch_begin() and
+ * venus_hfi_cmdq_batch_end() only raise a single interrupt to venus, when
+ * the outermost batch ends, instead of one per packet.
+ */
+static int venus_hfi_cmdq_batch_begin(void *dev)
+{
+	struct venus_hfi_device *device = dev;
+
+	if (!device) {
+		dprintk(VIDC_ERR, "%s: invalid device\n", __func__);
+		return -EINVAL;
+	}
+
+	mutex_lock(&device->write_lock);
+	device->cmdq_batch++;
+	mutex_unlock(&device->write_lock);
+	return 0;
+}
+
+static int venus_hfi_cmdq_batch_end(void *dev)
+{
+	struct venus_hfi_device *device = dev;
+
+	if (!device) {
+		dprintk(VIDC_ERR, "%s: invalid device\n", __func__);
+		return -EINVAL;
+	}
+
+	mutex_lock(&device->write_lock);
+	if (WARN_ON(!device->cmdq_batch))
+		goto exit;
+
+	if (!--device->cmdq_batch && device->cmdq_intr_pending) {
+		device->cmdq_intr_pending = false;
+		if (venus_hfi_core_in_valid_state(device))
+			venus_hfi_write_register(device, VIDC_CPU_IC_SOFTINT,
+				1 << VIDC_CPU_IC_SOFTINT_H2A_SHFT);
+	}
+exit:
+	mutex_unlock(&device->write_lock);
+	return 0;
+}
+
 static int venus_hfi_iface_msgq_read(struct venus_hfi_device *device, void *pkt)
 {
 	u32 tx_req_is_set = 0;
@@ -1906,13 +1952,15 @@ static int venus_hfi_iface_msgq_read(struct venus_hfi_device *device, void *pkt)
 		goto read_error_null;
 	}
 
+	/*
+	 * If venus waits for room in the message queue, it is told once the
+	 * response handler has drained the queue, not after every packet.
+	 */
 	q_info = &device->iface_queues[VIDC_IFACEQ_MSGQ_IDX];
 	if (!venus_hfi_read_queue(q_info, (u8 *)pkt, &tx_req_is_set)) {
 		venus_hfi_hal_sim_modify_msg_packet((u8 *)pkt, device);
 		if (tx_req_is_set)
-			venus_hfi_write_register(
-				device, VIDC_CPU_IC_SOFTINT,
-				1 << VIDC_CPU_IC_SOFTINT_H2A_SHFT);
+			device->msgq_intr_pending = true;
 		rc = 0;
 	} else
 		rc = -ENODATA;
@@ -3381,6 +3429,15 @@ static void venus_hfi_response_handler(struct venus_hfi_device *device)
 						"Failed to allocate OCMEM. Performance will be impacted\n");
 			}
 		}
+		mutex_lock(&device->read_lock);
+		if (device->msgq_intr_pending) {
+			device->msgq_intr_pending = false;
+			if (venus_hfi_core_in_valid_state(device))
+				venus_hfi_write_register(device,
+					VIDC_CPU_IC_SOFTINT,
+					1 << VIDC_CPU_IC_SOFTINT_H2A_SHFT);
+		}
+		mutex_unlock(&device->read_lock);
 		venus_hfi_flush_debug_queue(device, packet);
 		switch (rc) {
 		case HFI_MSG_SYS_PC_PREP_DONE:
@@ -4489,6 +4546,8 @@ static void venus_init_hfi_callbacks(struct hfi_device *hdev)
 	hdev->session_flush = venus_hfi_session_flush;
 	hdev->session_set_property = venus_hfi_session_set_property;
 	hdev->session_get_property = venus_hfi_session_get_property;
+	hdev->cmdq_batch_begin = venus_hfi_cmdq_batch_begin;
+	hdev->cmdq_batch_end = venus_hfi_cmdq_batch_end;
 	hdev->scale_clocks = venus_hfi_scale_clocks;
 	hdev->vote_bus = venus_hfi_vote_active_buses;
 	hdev->unvote_bus = venus_hfi_unvote_active_buses;
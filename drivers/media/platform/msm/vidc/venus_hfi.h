@@ -187,6 +187,9 @@ struct venus_hfi_device {
 	bool power_enabled;
 	struct mutex read_lock;
 	struct mutex write_lock;
+	u32 cmdq_batch;
+	bool cmdq_intr_pending;
+	bool msgq_intr_pending;
 	struct mutex clk_pwr_lock;
 	struct mutex session_lock;
 	msm_vidc_callback callback;
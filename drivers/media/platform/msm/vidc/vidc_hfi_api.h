@@ -1374,6 +1374,8 @@ struct hfi_device {
 	int (*session_set_property)(void *sess, enum hal_property ptype,
 			void *pdata);
 	int (*session_get_property)(void *sess, enum hal_property ptype);
+	int (*cmdq_batch_begin)(void *dev);
+	int (*cmdq_batch_end)(void *dev);
 	int (*scale_clocks)(void *dev, int load, int codecs_enabled);
 	int (*vote_bus)(void *dev, struct vidc_bus_vote_data *data,
 			int num_data);
@@ -2048,8 +2048,8 @@ static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 	struct qseecom_registered_app_list *ptr_app;
 	bool found_app = false;
 	int name_len = 0;
+	uintptr_t req_virt, resp_virt, sb_start;
 
-	reqd_len_sb_in = req->cmd_req_len + req->resp_len;
 	/* find app_id & img_name from list */
 	spin_lock_irqsave(&qseecom.registered_app_list_lock, flags);
 	list_for_each_entry(ptr_app, &qseecom.registered_app_list_head,
@@ -2080,8 +2080,19 @@ static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 					(uintptr_t)req->resp_buf));
 	send_data_req.rsp_len = req->resp_len;
 
+	/*
+	 * Both buffers were validated to lie in the shared buffer, so only
+	 * the span covering them needs cache maintenance, not all of it.
+	 */
+	req_virt = __qseecom_uvirt_to_kvirt(data,
+					(uintptr_t)req->cmd_req_buf);
+	resp_virt = __qseecom_uvirt_to_kvirt(data, (uintptr_t)req->resp_buf);
+	sb_start = min(req_virt, resp_virt);
+	reqd_len_sb_in = max(req_virt + req->cmd_req_len,
+				resp_virt + req->resp_len) - sb_start;
+
 	ret = msm_ion_do_cache_op(qseecom.ion_clnt, data->client.ihandle,
-					data->client.sb_virt,
+					(void *)sb_start,
 					reqd_len_sb_in,
 					ION_IOC_CLEAN_INV_CACHES);
 	if (ret) {
@@ -2112,7 +2123,7 @@ static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 		}
 	}
 	ret = msm_ion_do_cache_op(qseecom.ion_clnt, data->client.ihandle,
-				data->client.sb_virt, data->client.sb_length,
+				(void *)sb_start, reqd_len_sb_in,
 				ION_IOC_INV_CACHES);
 	if (ret)
 		pr_err("cache operation failed %d\n", ret);
@@ -14,120 +14,128 @@
  */
 
 #include <linux/atomic.h>
+#include <linux/cred.h>
 #include <linux/err.h>
 #include <linux/hashtable.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/kernel_stat.h>
 #include <linux/list.h>
 #include <linux/proc_fs.h>
-#include <linux/profile.h>
+#include <linux/rcupdate.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/uaccess.h>
+#include <linux/user_namespace.h>
 
 #define UID_HASH_BITS	10
-DECLARE_HASHTABLE(hash_table, UID_HASH_BITS);
+static DEFINE_HASHTABLE(hash_table, UID_HASH_BITS);
 
-static DEFINE_MUTEX(uid_lock);
+/* Serialises adding and removing entries, lookups are done under RCU */
+static DEFINE_SPINLOCK(uid_lock);
 static struct proc_dir_entry *parent;
 
+/*
+ * The times and power are charged by the scheduler accounting as they are
+ * spent, to the uid of the task at that time, so reading them does not
+ * need to walk the tasks.
+ */
 struct uid_entry {
 	uid_t uid;
-	cputime_t utime;
-	cputime_t stime;
-	cputime_t active_utime;
-	cputime_t active_stime;
-	unsigned long long active_power;
-	unsigned long long power;
+	atomic64_t utime;
+	atomic64_t stime;
+	atomic64_t power;
 	struct hlist_node hash;
+	struct rcu_head rcu;
 };
 
 static struct uid_entry *find_uid_entry(uid_t uid)
 {
 	struct uid_entry *uid_entry;
-	hash_for_each_possible(hash_table, uid_entry, hash, uid) {
+	hash_for_each_possible_rcu(hash_table, uid_entry, hash, uid) {
 		if (uid_entry->uid == uid)
 			return uid_entry;
 	}
 	return NULL;
 }
 
+/* Called under rcu_read_lock(), from any context */
 static struct uid_entry *find_or_register_uid(uid_t uid)
 {
 	struct uid_entry *uid_entry;
+	unsigned long flags;
 
 	uid_entry = find_uid_entry(uid);
 	if (uid_entry)
 		return uid_entry;
 
+	spin_lock_irqsave(&uid_lock, flags);
+	uid_entry = find_uid_entry(uid);
+	if (uid_entry)
+		goto out;
+
 	uid_entry = kzalloc(sizeof(struct uid_entry), GFP_ATOMIC);
 	if (!uid_entry)
-		return NULL;
+		goto out;
 
 	uid_entry->uid = uid;
 
-	hash_add(hash_table, &uid_entry->hash, uid);
-
+	hash_add_rcu(hash_table, &uid_entry->hash, uid);
+out:
+	spin_unlock_irqrestore(&uid_lock, flags);
 	return uid_entry;
 }
 
+/**
+ * uid_cputime_account() - charge cpu time and power to the uid of a task
+ * @p: the task the time was accounted to
+ * @utime: user time spent
+ * @stime: system time spent
+ * @power: power used over that time
+ *
+ * Called from the scheduler cpu time accounting.
+ */
+void uid_cputime_account(struct task_struct *p, cputime_t utime,
+			 cputime_t stime, unsigned long long power)
+{
+	struct uid_entry *uid_entry;
+
+	rcu_read_lock();
+	uid_entry = find_or_register_uid(from_kuid_munged(&init_user_ns,
+							  task_uid(p)));
+	if (uid_entry) {
+		if (utime)
+			atomic64_add((__force u64)utime, &uid_entry->utime);
+		if (stime)
+			atomic64_add((__force u64)stime, &uid_entry->stime);
+		if (power)
+			atomic64_add(power, &uid_entry->power);
+	}
+	rcu_read_unlock();
+}
+
 static int uid_stat_show(struct seq_file *m, void *v)
 {
 	struct uid_entry *uid_entry;
-	struct task_struct *task, *temp;
 	cputime_t utime;
 	cputime_t stime;
 	unsigned long bkt;
 
-	mutex_lock(&uid_lock);
-
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
-		uid_entry->active_stime = 0;
-		uid_entry->active_utime = 0;
-		uid_entry->active_power = 0;
-	}
-
-	read_lock(&tasklist_lock);
-	do_each_thread(temp, task) {
-		uid_entry = find_or_register_uid(from_kuid_munged(
-			current_user_ns(), task_uid(task)));
-		if (!uid_entry) {
-			read_unlock(&tasklist_lock);
-			mutex_unlock(&uid_lock);
-			pr_err("%s: failed to find the uid_entry for uid %d\n",
-				__func__, from_kuid_munged(current_user_ns(),
-				task_uid(task)));
-			return -ENOMEM;
-		}
-		/* if this task is exiting, we have already accounted for the
-		 * time and power.
-		 */
-		if (task->cpu_power == ULLONG_MAX)
-			continue;
-		task_cputime_adjusted(task, &utime, &stime);
-		uid_entry->active_utime += utime;
-		uid_entry->active_stime += stime;
-		uid_entry->active_power += task->cpu_power;
-	} while_each_thread(temp, task);
-	read_unlock(&tasklist_lock);
-
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
-		cputime_t total_utime = uid_entry->utime +
-							uid_entry->active_utime;
-		cputime_t total_stime = uid_entry->stime +
-							uid_entry->active_stime;
-		unsigned long long total_power = uid_entry->power +
-							uid_entry->active_power;
+	rcu_read_lock();
+	hash_for_each_rcu(hash_table, bkt, uid_entry, hash) {
+		utime = (__force cputime_t)atomic64_read(&uid_entry->utime);
+		stime = (__force cputime_t)atomic64_read(&uid_entry->stime);
 		seq_printf(m, "%d: %llu %llu %llu\n", uid_entry->uid,
 			(unsigned long long)jiffies_to_msecs(
-				cputime_to_jiffies(total_utime)) * USEC_PER_MSEC,
+				cputime_to_jiffies(utime)) * USEC_PER_MSEC,
 			(unsigned long long)jiffies_to_msecs(
-				cputime_to_jiffies(total_stime)) * USEC_PER_MSEC,
-			total_power);
+				cputime_to_jiffies(stime)) * USEC_PER_MSEC,
+			(unsigned long long)atomic64_read(&uid_entry->power));
 	}
+	rcu_read_unlock();
 
-	mutex_unlock(&uid_lock);
 	return 0;
 }
 
@@ -175,17 +183,19 @@ static ssize_t uid_remove_write(struct file *file,
 		return -EINVAL;
 	}
 
-	mutex_lock(&uid_lock);
+	spin_lock_irq(&uid_lock);
 
 	for (; uid_start <= uid_end; uid_start++) {
 		hash_for_each_possible_safe(hash_table, uid_entry, tmp,
 							hash, uid_start) {
-			hash_del(&uid_entry->hash);
-			kfree(uid_entry);
+			if (uid_entry->uid != uid_start)
+				continue;
+			hash_del_rcu(&uid_entry->hash);
+			kfree_rcu(uid_entry, rcu);
 		}
 	}
 
-	mutex_unlock(&uid_lock);
+	spin_unlock_irq(&uid_lock);
 	return count;
 }
 
@@ -195,44 +205,8 @@ static const struct file_operations uid_remove_fops = {
 	.write		= uid_remove_write,
 };
 
-static int process_notifier(struct notifier_block *self,
-			unsigned long cmd, void *v)
-{
-	struct task_struct *task = v;
-	struct uid_entry *uid_entry;
-	cputime_t utime, stime;
-	uid_t uid;
-
-	if (!task)
-		return NOTIFY_OK;
-
-	mutex_lock(&uid_lock);
-	uid = from_kuid_munged(current_user_ns(), task_uid(task));
-	uid_entry = find_or_register_uid(uid);
-	if (!uid_entry) {
-		pr_err("%s: failed to find uid %d\n", __func__, uid);
-		goto exit;
-	}
-
-	task_cputime_adjusted(task, &utime, &stime);
-	uid_entry->utime += utime;
-	uid_entry->stime += stime;
-	uid_entry->power += task->cpu_power;
-	task->cpu_power = ULLONG_MAX;
-
-exit:
-	mutex_unlock(&uid_lock);
-	return NOTIFY_OK;
-}
-
-static struct notifier_block process_notifier_block = {
-	.notifier_call	= process_notifier,
-};
-
 static int __init proc_uid_cputime_init(void)
 {
-	hash_init(hash_table);
-
 	parent = proc_mkdir("uid_cputime", NULL);
 	if (!parent) {
 		pr_err("%s: failed to create proc entry\n", __func__);
@@ -245,8 +219,6 @@ static int __init proc_uid_cputime_init(void)
 	proc_create_data("show_uid_stat", S_IRUGO, parent, &uid_stat_fops,
 					NULL);
 
-	profile_event_register(PROFILE_TASK_EXIT, &process_notifier_block);
-
 	return 0;
 }
 
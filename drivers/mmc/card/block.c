@@ -85,6 +85,9 @@ MODULE_ALIAS("mmc:block");
 #define PCKD_TRGR_URGENT_PENALTY	2
 #define PCKD_TRGR_LOWER_BOUND		5
 #define PCKD_TRGR_PRECISION_MULTIPLIER	100
+#define PCKD_TRGR_LATENCY_PENALTY	2
+#define PCKD_TRGR_RD_LAT_TARGET_US	20000
+#define PCKD_TRGR_RD_LAT_EWMA_WEIGHT	8
 
 static DEFINE_MUTEX(block_mutex);
 
@@ -141,6 +144,7 @@ struct mmc_blk_data {
 	struct device_attribute num_wr_reqs_to_start_packing;
 	struct device_attribute bkops_check_threshold;
 	struct device_attribute no_pack_for_random;
+	struct device_attribute packing_rd_lat_target_us;
 	int	area_type;
 };
 
@@ -445,6 +449,47 @@ exit:
 	return count;
 }
 
+static ssize_t
+packing_rd_lat_target_us_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret;
+
+	if (!md)
+		return -EINVAL;
+	ret = snprintf(buf, PAGE_SIZE, "%u\n", md->queue.rd_lat_target_us);
+
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t
+packing_rd_lat_target_us_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	unsigned int value;
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret = count;
+
+	if (!md)
+		return -EINVAL;
+
+	if (sscanf(buf, "%u", &value) != 1) {
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	/* 0 leaves the trigger to the write potential alone */
+	md->queue.rd_lat_target_us = value;
+	md->queue.rd_lat_ewma_us = 0;
+
+exit:
+	mmc_blk_put(md);
+	return ret;
+}
+
 static ssize_t
 no_pack_for_random_show(struct device *dev,
 				  struct device_attribute *attr, char *buf)
@@ -746,6 +791,11 @@ static int mmc_blk_ioctl_cmd(struct block_device *bdev,
 	if (mmc_card_get_bkops_en_manual(card))
 		mmc_stop_bkops(card);
 
+	/* user commands are sent in legacy mode */
+	err = mmc_cmdq_disable(card);
+	if (err)
+		goto cmd_rel_host;
+
 	err = mmc_blk_part_switch(card, md);
 	if (err)
 		goto cmd_rel_host;
@@ -891,6 +941,11 @@ static int mmc_blk_ioctl_rpmb_cmd(struct block_device *bdev,
 	if (mmc_card_get_bkops_en_manual(card))
 		mmc_stop_bkops(card);
 
+	/* user commands are sent in legacy mode */
+	err = mmc_cmdq_disable(card);
+	if (err)
+		goto cmd_rel_host;
+
 	err = mmc_blk_part_switch(card, md);
 	if (err)
 		goto cmd_rel_host;
@@ -1043,6 +1098,11 @@ static inline int mmc_blk_part_switch(struct mmc_card *card,
 	if (mmc_card_mmc(card)) {
 		u8 part_config = card->ext_csd.part_config;
 
+		/* partitions can't be switched in command queue mode */
+		ret = mmc_cmdq_disable(card);
+		if (ret)
+			return ret;
+
 		part_config &= ~EXT_CSD_PART_CONFIG_ACC_MASK;
 		part_config |= md->part_type;
 
@@ -2050,13 +2110,32 @@ void mmc_blk_disable_wr_packing(struct mmc_queue *mq)
 }
 EXPORT_SYMBOL(mmc_blk_disable_wr_packing);
 
-static int get_packed_trigger(int potential, struct mmc_card *card,
-			      struct request *req, int curr_trigger)
+/*
+ * Fold the latency of a completed read into the running mean the packing
+ * trigger is checked against. The latency is counted from the moment the
+ * request was queued, which includes the time spent behind packed writes.
+ */
+static void mmc_blk_update_rd_latency(struct mmc_queue *mq,
+				      struct request *req)
 {
-	static int num_mean_elements = 1;
-	static unsigned long mean_potential = PCKD_TRGR_INIT_MEAN_POTEN;
-	unsigned int trigger = curr_trigger;
+	unsigned int lat_us = jiffies_to_usecs(jiffies - req->start_time);
+
+	if (!mq->rd_lat_ewma_us)
+		mq->rd_lat_ewma_us = lat_us;
+	else
+		mq->rd_lat_ewma_us = (mq->rd_lat_ewma_us *
+			(PCKD_TRGR_RD_LAT_EWMA_WEIGHT - 1) + lat_us) /
+			PCKD_TRGR_RD_LAT_EWMA_WEIGHT;
+}
+
+static int get_packed_trigger(struct mmc_queue *mq, int potential,
+			      struct request *req)
+{
+	struct mmc_card *card = mq->card;
+	struct mmc_wr_pack_stats *stats = &card->wr_pack_stats;
+	unsigned int trigger = mq->num_wr_reqs_to_start_packing;
 	unsigned int pckd_trgr_upper_bound = card->ext_csd.max_packed_writes;
+	unsigned int pending_wr;
 
 	/* scale down the upper bound to 75% */
 	pckd_trgr_upper_bound = (pckd_trgr_upper_bound * 3) / 4;
@@ -2074,9 +2153,10 @@ static int get_packed_trigger(int potential, struct mmc_card *card,
 	 * this is to prevent integer overflow in the following calculation:
 	 * once every PACKED_TRIGGER_MAX_ELEMENTS reset the algorithm
 	 */
-	if (num_mean_elements > PACKED_TRIGGER_MAX_ELEMENTS) {
-		num_mean_elements = 1;
-		mean_potential = PCKD_TRGR_INIT_MEAN_POTEN;
+	if (!mq->pckd_trgr_num_mean ||
+	    mq->pckd_trgr_num_mean > PACKED_TRIGGER_MAX_ELEMENTS) {
+		mq->pckd_trgr_num_mean = 1;
+		mq->pckd_trgr_mean_potential = PCKD_TRGR_INIT_MEAN_POTEN;
 	}
 
 	/*
@@ -2085,19 +2165,19 @@ static int get_packed_trigger(int potential, struct mmc_card *card,
 	 * mean_pot[i+1] =
 	 *	((mean_pot[i] * num_mean_elem) + potential)/(num_mean_elem + 1)
 	 */
-	mean_potential *= num_mean_elements;
+	mq->pckd_trgr_mean_potential *= mq->pckd_trgr_num_mean;
 	/*
 	 * add num_mean_elements so that the division of two integers doesn't
 	 * lower mean_potential too much
 	 */
-	if (potential > mean_potential)
-		mean_potential += num_mean_elements;
-	mean_potential += potential;
+	if (potential > mq->pckd_trgr_mean_potential)
+		mq->pckd_trgr_mean_potential += mq->pckd_trgr_num_mean;
+	mq->pckd_trgr_mean_potential += potential;
 	/* this is for gaining more precision when dividing two integers */
-	mean_potential *= PCKD_TRGR_PRECISION_MULTIPLIER;
+	mq->pckd_trgr_mean_potential *= PCKD_TRGR_PRECISION_MULTIPLIER;
 	/* this completes the mean calculation */
-	mean_potential /= ++num_mean_elements;
-	mean_potential /= PCKD_TRGR_PRECISION_MULTIPLIER;
+	mq->pckd_trgr_mean_potential /= ++mq->pckd_trgr_num_mean;
+	mq->pckd_trgr_mean_potential /= PCKD_TRGR_PRECISION_MULTIPLIER;
 
 	/*
 	 * if current potential packed writes is greater than the mean potential
@@ -2106,7 +2186,7 @@ static int get_packed_trigger(int potential, struct mmc_card *card,
 	 * opposite case we want to increase the trigger in order to get less
 	 * packing events.
 	 */
-	if (potential >= mean_potential)
+	if (potential >= mq->pckd_trgr_mean_potential)
 		trigger = (trigger <= PCKD_TRGR_LOWER_BOUND) ?
 				PCKD_TRGR_LOWER_BOUND : trigger - 1;
 	else
@@ -2121,6 +2201,31 @@ static int get_packed_trigger(int potential, struct mmc_card *card,
 	if (req && (req->cmd_flags & REQ_URGENT) && (rq_data_dir(req) == READ))
 		trigger += PCKD_TRGR_URGENT_PENALTY;
 
+	/*
+	 * Reads finishing later than the target are queued behind packed
+	 * writes, back off. Otherwise more writes pending than the trigger
+	 * means a sequential stream that gains from packing early.
+	 */
+	pending_wr = mq->queue->nr_rqs[BLK_RW_ASYNC];
+	spin_lock(&stats->lock);
+	if (mq->rd_lat_target_us &&
+	    mq->rd_lat_ewma_us > mq->rd_lat_target_us) {
+		trigger = min_t(unsigned int,
+				trigger + PCKD_TRGR_LATENCY_PENALTY,
+				card->ext_csd.max_packed_writes);
+		if (stats->enabled)
+			stats->trigger_raised++;
+	} else if (pending_wr > trigger && trigger > PCKD_TRGR_LOWER_BOUND) {
+		trigger--;
+		if (stats->enabled)
+			stats->trigger_lowered++;
+	}
+	if (stats->enabled) {
+		stats->trigger = trigger;
+		stats->rd_lat_us = mq->rd_lat_ewma_us;
+	}
+	spin_unlock(&stats->lock);
+
 	return trigger;
 }
 
@@ -2152,9 +2257,9 @@ static void mmc_blk_write_packing_control(struct mmc_queue *mq,
 				mq->num_wr_reqs_to_start_packing)
 			mq->wr_packing_enabled = true;
 		mq->num_wr_reqs_to_start_packing =
-			get_packed_trigger(mq->num_of_potential_packed_wr_reqs,
-					   mq->card, req,
-					   mq->num_wr_reqs_to_start_packing);
+			get_packed_trigger(mq,
+					   mq->num_of_potential_packed_wr_reqs,
+					   req);
 		mq->num_of_potential_packed_wr_reqs = 0;
 		return;
 	}
@@ -2164,9 +2269,9 @@ static void mmc_blk_write_packing_control(struct mmc_queue *mq,
 	if (data_dir == READ) {
 		mmc_blk_disable_wr_packing(mq);
 		mq->num_wr_reqs_to_start_packing =
-			get_packed_trigger(mq->num_of_potential_packed_wr_reqs,
-					   mq->card, req,
-					   mq->num_wr_reqs_to_start_packing);
+			get_packed_trigger(mq,
+					   mq->num_of_potential_packed_wr_reqs,
+					   req);
 		mq->num_of_potential_packed_wr_reqs = 0;
 		mq->wr_packing_enabled = false;
 		return;
@@ -2203,6 +2308,8 @@ void mmc_blk_init_packed_statistics(struct mmc_card *card)
 	       sizeof(*card->wr_pack_stats.packing_events));
 	memset(&card->wr_pack_stats.pack_stop_reason, 0,
 		sizeof(card->wr_pack_stats.pack_stop_reason));
+	card->wr_pack_stats.trigger_raised = 0;
+	card->wr_pack_stats.trigger_lowered = 0;
 	card->wr_pack_stats.enabled = true;
 	spin_unlock(&card->wr_pack_stats.lock);
 }
@@ -2655,6 +2762,8 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 				ret = mmc_blk_end_packed_req(mq_rq);
 				break;
 			} else {
+				if (type == MMC_BLK_READ)
+					mmc_blk_update_rd_latency(mq, req);
 				ret = blk_end_request(req, 0,
 						brq->data.bytes_xfered);
 			}
@@ -2787,6 +2896,215 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 	return 0;
 }
 
+/*
+ * Completion of a command queue task, in interrupt context. The request is
+ * finished from the block softirq by mmc_blk_cmdq_complete_rq().
+ */
+static void mmc_blk_cmdq_req_done(struct mmc_request *mrq)
+{
+	struct mmc_queue_req *mqrq = container_of(mrq->cmdq_req,
+			struct mmc_queue_req, cmdq_req);
+
+	blk_complete_request(mqrq->req);
+}
+
+static void mmc_blk_cmdq_complete_rq(struct request *req)
+{
+	struct mmc_queue_req *mqrq = req->special;
+	struct mmc_queue *mq = req->q->queuedata;
+	struct mmc_host *host = mq->card->host;
+	struct mmc_cmdq_req *cmdq_req = &mqrq->cmdq_req;
+	int err = cmdq_req->data.error;
+	unsigned long flags;
+
+	mqrq->req = NULL;
+	if (err == -EAGAIN) {
+		/* dropped by the engine on a reset, queue it again */
+		spin_lock_irqsave(req->q->queue_lock, flags);
+		blk_requeue_request(req->q, req);
+		spin_unlock_irqrestore(req->q->queue_lock, flags);
+	} else {
+		if (err)
+			pr_err("%s: %s: tag %d failed %d resp 0x%08x\n",
+				req->rq_disk->disk_name, __func__,
+				cmdq_req->tag, err, cmdq_req->resp_err);
+		blk_end_request(req, err ? -EIO : 0, blk_rq_bytes(req));
+	}
+
+	clear_bit(cmdq_req->tag, &host->cmdq_ctx.active_reqs);
+	wake_up(&host->cmdq_ctx.wait);
+	wake_up_process(mq->thread);
+}
+
+static struct mmc_cmdq_req *mmc_blk_cmdq_rw_prep(struct mmc_queue_req *mqrq,
+						 struct mmc_queue *mq)
+{
+	struct request *req = mqrq->req;
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = mq->card;
+	struct mmc_cmdq_req *cmdq_req = &mqrq->cmdq_req;
+	struct mmc_data *data = &cmdq_req->data;
+	unsigned int tag = mqrq - mq->mqrq_cmdq;
+
+	memset(cmdq_req, 0, sizeof(*cmdq_req));
+	cmdq_req->tag = tag;
+	cmdq_req->blk_addr = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		cmdq_req->blk_addr <<= 9;
+
+	data->blksz = 512;
+	data->blocks = blk_rq_sectors(req);
+	if (rq_data_dir(req) == READ) {
+		data->flags = MMC_DATA_READ;
+		cmdq_req->cmd_flags |= MMC_CMDQ_DIR_READ;
+		if (req->cmd_flags & REQ_PRIO)
+			cmdq_req->cmd_flags |= MMC_CMDQ_PRIO;
+	} else {
+		data->flags = MMC_DATA_WRITE;
+		/* same rules as mmc_blk_rw_rq_prep() */
+		if ((req->cmd_flags & (REQ_FUA | REQ_META)) &&
+		    (md->flags & MMC_BLK_REL_WR))
+			cmdq_req->cmd_flags |= MMC_CMDQ_REL_WR;
+		if (card->ext_csd.data_tag_unit_size &&
+		    (req->cmd_flags & REQ_META) &&
+		    (data->blocks * data->blksz) >=
+		    card->ext_csd.data_tag_unit_size)
+			cmdq_req->cmd_flags |= MMC_CMDQ_DATA_TAG;
+	}
+	data->sg = mqrq->sg;
+	data->sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	cmdq_req->mrq.data = data;
+	cmdq_req->mrq.done = mmc_blk_cmdq_req_done;
+
+	return cmdq_req;
+}
+
+static int mmc_blk_cmdq_issue_rw_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_card *card = mq->card;
+	struct mmc_host *host = card->host;
+	struct mmc_queue_req *mqrq;
+	unsigned int tag;
+	int ret;
+
+	if (!mmc_card_cmdq(card)) {
+		ret = mmc_cmdq_enable(card);
+		if (ret) {
+			blk_end_request_all(req, -EIO);
+			return 0;
+		}
+	}
+
+	tag = find_first_zero_bit(&host->cmdq_ctx.active_reqs,
+				  mq->cmdq_depth);
+	BUG_ON(tag >= mq->cmdq_depth);
+	set_bit(tag, &host->cmdq_ctx.active_reqs);
+
+	mqrq = &mq->mqrq_cmdq[tag];
+	mqrq->req = req;
+	req->special = mqrq;
+
+	ret = mmc_cmdq_start_req(host, mmc_blk_cmdq_rw_prep(mqrq, mq));
+	if (ret) {
+		pr_err("%s: %s: failed to queue tag %d %d\n",
+			req->rq_disk->disk_name, __func__, tag, ret);
+		mqrq->req = NULL;
+		clear_bit(tag, &host->cmdq_ctx.active_reqs);
+		blk_end_request_all(req, -EIO);
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * The engine halts on a failed task. Drop the tasks it still holds, they
+ * come back through the request queue, and leave command queue mode so the
+ * next request starts from a clean state.
+ */
+static void mmc_blk_cmdq_err(struct mmc_queue *mq)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = mq->card;
+	struct mmc_host *host = card->host;
+
+	if (host->cmdq_ops->dumpstate)
+		host->cmdq_ops->dumpstate(host);
+
+	mmc_host_clk_hold(host);
+	host->cmdq_ops->disable(host, false);
+	mmc_host_clk_release(host);
+	wait_event(host->cmdq_ctx.wait, !host->cmdq_ctx.active_reqs);
+
+	if (mmc_cmdq_disable(card) && mmc_blk_reset(md, host, MMC_BLK_WRITE))
+		pr_err("%s: %s: card did not recover\n",
+			md->disk->disk_name, __func__);
+	else
+		mmc_blk_reset_success(md, MMC_BLK_WRITE);
+
+	clear_bit(CMDQ_STATE_ERR, &host->cmdq_ctx.curr_state);
+}
+
+/*
+ * Issue function of a queue in command queue mode, see mmc_cmdq_thread().
+ * Discard and flush are legacy commands: the queue is drained and the card
+ * leaves command queue mode for them, the next read or write re-enables it.
+ */
+static int mmc_blk_cmdq_issue_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_host *host = card->host;
+	unsigned int cmd_flags;
+	int ret;
+
+	if (!req) {
+		if (test_bit(CMDQ_STATE_ERR, &host->cmdq_ctx.curr_state)) {
+			mmc_blk_cmdq_err(mq);
+		} else if (test_and_clear_bit(MMC_QUEUE_CMDQ_CLAIMED,
+					      &mq->flags)) {
+			if (mmc_card_need_bkops(card) && !mmc_cmdq_disable(card))
+				mmc_start_bkops(card, false);
+			mmc_release_host(host);
+			mmc_rpm_release(host, &card->dev);
+		}
+		return 0;
+	}
+
+	if (!test_and_set_bit(MMC_QUEUE_CMDQ_CLAIMED, &mq->flags)) {
+		mmc_rpm_hold(host, &card->dev);
+		mmc_claim_host(host);
+		if (mmc_card_get_bkops_en_manual(card))
+			mmc_stop_bkops(card);
+	}
+
+	ret = mmc_blk_part_switch(card, md);
+	if (ret) {
+		blk_end_request_all(req, -EIO);
+		return 0;
+	}
+
+	cmd_flags = req->cmd_flags;
+	if (!(cmd_flags & (REQ_DISCARD | REQ_FLUSH)))
+		return mmc_blk_cmdq_issue_rw_rq(mq, req);
+
+	wait_event(host->cmdq_ctx.wait, !host->cmdq_ctx.active_reqs);
+	mmc_cmdq_disable(card);
+
+	if (cmd_flags & REQ_DISCARD) {
+		if (cmd_flags & REQ_SECURE &&
+			!(card->quirks & MMC_QUIRK_SEC_ERASE_TRIM_BROKEN))
+			ret = mmc_blk_issue_secdiscard_rq(mq, req);
+		else
+			ret = mmc_blk_issue_discard_rq(mq, req);
+	} else {
+		ret = mmc_blk_issue_flush(mq, req);
+	}
+
+	return ret;
+}
+
 static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 {
 	int ret;
@@ -2934,6 +3252,12 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 
 	md->queue.issue_fn = mmc_blk_issue_rq;
 	md->queue.data = md;
+	md->queue.rd_lat_target_us = PCKD_TRGR_RD_LAT_TARGET_US;
+	if (md->queue.cmdq_depth) {
+		md->queue.cmdq_issue_fn = mmc_blk_cmdq_issue_rq;
+		blk_queue_softirq_done(md->queue.queue,
+				       mmc_blk_cmdq_complete_rq);
+	}
 
 	md->disk->major	= MMC_BLOCK_MAJOR;
 	md->disk->first_minor = devidx * perdev_minors;
@@ -3096,6 +3420,8 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 		card = md->queue.card;
 		device_remove_file(disk_to_dev(md->disk),
 				   &md->num_wr_reqs_to_start_packing);
+		device_remove_file(disk_to_dev(md->disk),
+				   &md->packing_rd_lat_target_us);
 		if (md->disk->flags & GENHD_FL_UP) {
 			device_remove_file(disk_to_dev(md->disk), &md->force_ro);
 			if ((md->area_type & MMC_BLK_DATA_AREA_BOOT) &&
@@ -3198,8 +3524,21 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	if (ret)
 		goto no_pack_for_random_fails;
 
+	md->packing_rd_lat_target_us.show = packing_rd_lat_target_us_show;
+	md->packing_rd_lat_target_us.store = packing_rd_lat_target_us_store;
+	sysfs_attr_init(&md->packing_rd_lat_target_us.attr);
+	md->packing_rd_lat_target_us.attr.name = "packing_rd_lat_target_us";
+	md->packing_rd_lat_target_us.attr.mode = S_IRUGO | S_IWUSR;
+	ret = device_create_file(disk_to_dev(md->disk),
+				 &md->packing_rd_lat_target_us);
+	if (ret)
+		goto packing_rd_lat_target_us_fails;
+
 	return ret;
 
+packing_rd_lat_target_us_fails:
+	device_remove_file(disk_to_dev(md->disk),
+			   &md->no_pack_for_random);
 no_pack_for_random_fails:
 	device_remove_file(disk_to_dev(md->disk),
 			   &md->bkops_check_threshold);
@@ -71,6 +71,16 @@
 				    (stats.suspend != exp_suspend))
 #define BKOPS_TEST_TIMEOUT 60000
 
+/* number of requests issued by each performance scenario */
+#define PERF_TEST_NUM_REQS		1000
+/* max number of queued and dispatched requests of a performance scenario */
+#define PERF_TEST_MAX_QUEUED		(TEST_MAX_REQUESTS / 2)
+#define PERF_TEST_SECTOR_RANGE		(TEST_MAX_SECTOR_RANGE >> 9)
+#define PERF_TEST_SECTORS_PER_BIO	(TEST_BIO_SIZE >> 9)
+#define PERF_SEQ_WRITE_NUM_BIOS		TEST_MAX_BIOS_PER_REQ /* 512KiB */
+#define PERF_DISCARD_NUM_SECTS		256 /* 128KiB */
+#define PERF_TEST_TIMEOUT_MS		(5 * 60 * 1000)
+
 enum is_random {
 	NON_RANDOM_TEST,
 	RANDOM_TEST,
@@ -149,6 +159,13 @@ enum mmc_block_test_testcases {
 	TEST_LONG_SEQUENTIAL_READ,
 	TEST_LONG_SEQUENTIAL_WRITE,
 
+	/* Start of performance scenarios */
+	PERF_MIN_TESTCASE,
+	TEST_PERF_RAND_READ_SEQ_WRITE = PERF_MIN_TESTCASE,
+	TEST_PERF_FSYNC_WRITE,
+	TEST_PERF_DISCARD_STORM,
+	PERF_MAX_TESTCASE = TEST_PERF_DISCARD_STORM,
+
 	TEST_NEW_REQ_NOTIFICATION,
 };
 
@@ -180,6 +197,7 @@ struct mmc_block_test_debug {
 	struct dentry *long_sequential_read_test;
 	struct dentry *long_sequential_write_test;
 	struct dentry *new_req_notification_test;
+	struct dentry *perf_mix_test;
 };
 
 struct mmc_block_test_data {
@@ -217,6 +235,8 @@ struct mmc_block_test_data {
 	wait_queue_head_t bkops_wait_q;
 	/* A counter for the number of test requests completed */
 	unsigned int completed_req_count;
+	/* Number of completions ending the current performance scenario */
+	unsigned int perf_target_reqs;
 };
 
 static struct mmc_block_test_data *mbtd;
@@ -649,6 +669,12 @@ switch (td->test_info.testcase) {
 		return "\"long sequential read\"";
 	case TEST_LONG_SEQUENTIAL_WRITE:
 		return "\"long sequential write\"";
+	case TEST_PERF_RAND_READ_SEQ_WRITE:
+		return "\"perf - 4K random read + sequential write\"";
+	case TEST_PERF_FSYNC_WRITE:
+		return "\"perf - fsync heavy small writes\"";
+	case TEST_PERF_DISCARD_STORM:
+		return "\"perf - discard storm\"";
 	case TEST_NEW_REQ_NOTIFICATION:
 		return "\"new request notification test\"";
 	default:
@@ -2796,6 +2822,7 @@ static void long_seq_write_free_end_io_fn(struct request *rq, int err)
 	spin_lock_irq(&ptd->lock);
 	list_del_init(&test_rq->queuelist);
 	ptd->dispatched_count--;
+	test_iosched_account_lat(test_rq);
 	__blk_put_request(ptd->req_q, test_rq->rq);
 	spin_unlock_irq(&ptd->lock);
 
@@ -2948,6 +2975,271 @@ const struct file_operations long_sequential_write_test_ops = {
 	.read = long_sequential_write_test_read,
 };
 
+static bool perf_test_completed(void)
+{
+	return mbtd->completed_req_count >= mbtd->perf_target_reqs;
+}
+
+/* Wait until the scenario has room for another outstanding request */
+static void perf_wait_for_slot(struct test_data *td)
+{
+	while (td->test_count + td->dispatched_count >=
+	       PERF_TEST_MAX_QUEUED) {
+		blk_run_queue(td->req_q);
+		msleep(NEW_REQ_TEST_SLEEP_TIME);
+	}
+}
+
+/* Pick a pseudo-random sector of the test area, aligned to nr_sects */
+static u32 perf_rand_sector(struct test_data *td, unsigned int nr_sects)
+{
+	return td->start_sector + nr_sects *
+		pseudo_random_seed(&mbtd->random_test_seed, 0,
+				   PERF_TEST_SECTOR_RANGE / nr_sects);
+}
+
+static int perf_add_wr_rd_req(struct test_data *td, int direction,
+			      u32 sector, int num_bios)
+{
+	return test_iosched_add_wr_rd_test_req(0, direction, sector, num_bios,
+			TEST_NO_PATTERN, long_seq_write_free_end_io_fn);
+}
+
+/*
+ * Issue the requests of the current performance scenario:
+ * - random read + sequential write: three 4KiB random reads for every
+ *   512KiB sequential write
+ * - fsync heavy: a database commit, i.e. a 4KiB journal append, a 4KiB
+ *   random page update and a flush
+ * - discard storm: three 128KiB random discards for every 4KiB random read
+ */
+static int run_perf_test(struct test_data *td)
+{
+	int ret = 0;
+	int i;
+	u32 seq_sector = td->start_sector;
+
+	mbtd->completed_req_count = 0;
+	mbtd->perf_target_reqs = PERF_TEST_NUM_REQS;
+
+	for (i = 0; i < PERF_TEST_NUM_REQS; i++) {
+		perf_wait_for_slot(td);
+
+		if (seq_sector + PERF_SEQ_WRITE_NUM_BIOS *
+		    PERF_TEST_SECTORS_PER_BIO >
+		    td->start_sector + PERF_TEST_SECTOR_RANGE)
+			seq_sector = td->start_sector;
+
+		switch (td->test_info.testcase) {
+		case TEST_PERF_RAND_READ_SEQ_WRITE:
+			if (i % 4 == 3) {
+				ret = perf_add_wr_rd_req(td, WRITE, seq_sector,
+						PERF_SEQ_WRITE_NUM_BIOS);
+				seq_sector += PERF_SEQ_WRITE_NUM_BIOS *
+					PERF_TEST_SECTORS_PER_BIO;
+			} else {
+				ret = perf_add_wr_rd_req(td, READ,
+					perf_rand_sector(td,
+						PERF_TEST_SECTORS_PER_BIO), 1);
+			}
+			break;
+		case TEST_PERF_FSYNC_WRITE:
+			if (i % 3 == 0) {
+				ret = perf_add_wr_rd_req(td, WRITE, seq_sector,
+							 1);
+				seq_sector += PERF_TEST_SECTORS_PER_BIO;
+			} else if (i % 3 == 1) {
+				ret = perf_add_wr_rd_req(td, WRITE,
+					perf_rand_sector(td,
+						PERF_TEST_SECTORS_PER_BIO), 1);
+			} else {
+				ret = test_iosched_add_unique_test_req(0,
+					REQ_UNIQUE_FLUSH, 0, 0,
+					long_seq_write_free_end_io_fn);
+			}
+			break;
+		case TEST_PERF_DISCARD_STORM:
+			if (i % 4 == 3)
+				ret = perf_add_wr_rd_req(td, READ,
+					perf_rand_sector(td,
+						PERF_TEST_SECTORS_PER_BIO), 1);
+			else
+				ret = test_iosched_add_unique_test_req(0,
+					REQ_UNIQUE_DISCARD,
+					perf_rand_sector(td,
+						PERF_DISCARD_NUM_SECTS),
+					PERF_DISCARD_NUM_SECTS,
+					long_seq_write_free_end_io_fn);
+			break;
+		default:
+			pr_err("%s: Invalid test case %d", __func__,
+			       td->test_info.testcase);
+			ret = -EINVAL;
+		}
+
+		if (ret)
+			break;
+
+		blk_run_queue(td->req_q);
+	}
+
+	if (ret) {
+		pr_err("%s: failed to add request %d, ret=%d",
+		       __func__, i, ret);
+		if (!i)
+			return ret;
+		/* let the requests already issued complete the scenario */
+		mbtd->perf_target_reqs = i;
+	}
+
+	blk_run_queue(td->req_q);
+
+	return 0;
+}
+
+static void perf_print_lat(const char *dir_str, int direction)
+{
+	struct test_lat_report rep;
+
+	if (test_iosched_get_lat_report(direction, &rep))
+		return;
+
+	pr_info("%s: %s latency (%u reqs): p50 %u us, p90 %u us, p99 %u us, max %u us",
+		__func__, dir_str, rep.nr_samples, rep.p50_us, rep.p90_us,
+		rep.p99_us, rep.max_us);
+}
+
+static void perf_print_results(struct test_data *td, struct mmc_queue *mq)
+{
+	unsigned long mtime, integer, fraction, byte_count;
+	unsigned long iops;
+
+	mtime = ktime_to_ms(mbtd->test_info.test_duration);
+	if (!mtime)
+		mtime = 1;
+	byte_count = mbtd->test_info.test_byte_count;
+	iops = (mbtd->completed_req_count * 1000UL) / mtime;
+
+	pr_info("%s: %s: packing %s, cmdq %s",
+		__func__, get_test_case_str(td),
+		mmc_host_packed_wr(mq->card->host) ? "on" : "off",
+		mmc_card_cmdq(mq->card) ? "on" : "off");
+	pr_info("%s: %u reqs in %lu msec, %lu IOPS",
+		__func__, mbtd->completed_req_count, mtime, iops);
+
+	mtime *= MB_MSEC_RATIO_APPROXIMATION;
+	fraction = integer = (byte_count * 10) / mtime;
+	integer /= 10;
+	fraction -= integer * 10;
+	pr_info("%s: Throughput: %lu.%lu MiB/sec", __func__, integer, fraction);
+
+	perf_print_lat("read", READ);
+	perf_print_lat("write", WRITE);
+}
+
+static ssize_t perf_mix_test_write(struct file *file,
+				const char __user *buf,
+				size_t count,
+				loff_t *ppos)
+{
+	int ret = 0;
+	int i, j;
+	int number = -1;
+	struct test_data *td = test_get_test_data();
+	struct mmc_queue *mq;
+
+	pr_info("%s: -- Performance scenarios TEST --", __func__);
+
+	sscanf(buf, "%d", &number);
+
+	if (number <= 0)
+		number = 1;
+
+	if (!td) {
+		pr_err("%s: NULL td", __func__);
+		return -EINVAL;
+	}
+
+	mq = td->req_q->queuedata;
+	if (!mq) {
+		pr_err("%s: NULL mq", __func__);
+		return -EINVAL;
+	}
+
+	for (i = 0 ; i < number ; ++i) {
+		pr_info("%s: Cycle # %d / %d", __func__, i+1, number);
+		pr_info("%s: ====================", __func__);
+
+		for (j = PERF_MIN_TESTCASE; j <= PERF_MAX_TESTCASE; j++) {
+			if (j == TEST_PERF_DISCARD_STORM &&
+			    !blk_queue_discard(td->req_q)) {
+				pr_info("%s: discard not supported, skipping",
+					__func__);
+				continue;
+			}
+
+			memset(&mbtd->test_info, 0, sizeof(struct test_info));
+			mbtd->test_group = TEST_GENERAL_GROUP;
+			mbtd->test_info.data = mbtd;
+			mbtd->test_info.get_test_case_str_fn =
+				get_test_case_str;
+			mbtd->test_info.run_test_fn = run_perf_test;
+			mbtd->test_info.check_test_completion_fn =
+				perf_test_completed;
+			mbtd->test_info.timeout_msec = PERF_TEST_TIMEOUT_MS;
+			mbtd->test_info.testcase = j;
+			mbtd->is_random = RANDOM_TEST;
+
+			ret = test_iosched_start_test(&mbtd->test_info);
+			if (ret)
+				return count;
+
+			perf_print_results(td, mq);
+
+			/* Allow FS requests to be dispatched */
+			msleep(1000);
+		}
+	}
+
+	return count;
+}
+
+static ssize_t perf_mix_test_read(struct file *file,
+			       char __user *buffer,
+			       size_t count,
+			       loff_t *offset)
+{
+	if (!access_ok(VERIFY_WRITE, buffer, count))
+		return -EFAULT;
+
+	memset((void *)buffer, 0, count);
+
+	snprintf(buffer, count,
+		 "\nperf_mix_test\n"
+		 "=========\n"
+		 "Description:\n"
+		 "This test runs the following performance scenarios and "
+		 "reports IOPS, throughput and read/write latency "
+		 "percentiles for each:\n"
+		 "- 4K random reads mixed with 512K sequential writes\n"
+		 "- fsync heavy database commits: 4K journal append, 4K page "
+		 "update and flush\n"
+		 "- discard storm: 128K random discards mixed with 4K random "
+		 "reads\n");
+
+	if (message_repeat == 1) {
+		message_repeat = 0;
+		return strnlen(buffer, count);
+	} else
+		return 0;
+}
+
+const struct file_operations perf_mix_test_ops = {
+	.open = test_open,
+	.write = perf_mix_test_write,
+	.read = perf_mix_test_read,
+};
+
 static ssize_t new_req_notification_test_write(struct file *file,
 				const char __user *buf,
 				size_t count,
@@ -3030,6 +3322,7 @@ static void mmc_block_test_debugfs_cleanup(void)
 	debugfs_remove(mbtd->debug.long_sequential_read_test);
 	debugfs_remove(mbtd->debug.long_sequential_write_test);
 	debugfs_remove(mbtd->debug.new_req_notification_test);
+	debugfs_remove(mbtd->debug.perf_mix_test);
 }
 
 static int mmc_block_test_debugfs_init(void)
@@ -3131,6 +3424,16 @@ static int mmc_block_test_debugfs_init(void)
 	if (!mbtd->debug.long_sequential_write_test)
 		goto err_nomem;
 
+	mbtd->debug.perf_mix_test = debugfs_create_file(
+					"perf_mix_test",
+					S_IRUGO | S_IWUGO,
+					tests_root,
+					NULL,
+					&perf_mix_test_ops);
+
+	if (!mbtd->debug.perf_mix_test)
+		goto err_nomem;
+
 	return 0;
 
 err_nomem:
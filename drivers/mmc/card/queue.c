@@ -119,6 +119,54 @@ static int mmc_queue_thread(void *d)
 	return 0;
 }
 
+/*
+ * Queue thread of a card in command queue mode. Requests are issued as long
+ * as a task slot is free and never waited for, a completing task wakes the
+ * thread up again. The host stays claimed, and thread_sem held, until the
+ * last queued task is done.
+ */
+static int mmc_cmdq_thread(void *d)
+{
+	struct mmc_queue *mq = d;
+	struct request_queue *q = mq->queue;
+	struct mmc_cmdq_context_info *ctx = &mq->card->host->cmdq_ctx;
+
+	current->flags |= PF_MEMALLOC;
+
+	down(&mq->thread_sem);
+	do {
+		struct request *req = NULL;
+		bool err;
+
+		spin_lock_irq(q->queue_lock);
+		set_current_state(TASK_INTERRUPTIBLE);
+		err = test_bit(CMDQ_STATE_ERR, &ctx->curr_state);
+		if (!err && find_first_zero_bit(&ctx->active_reqs,
+				mq->cmdq_depth) < mq->cmdq_depth)
+			req = blk_fetch_request(q);
+		spin_unlock_irq(q->queue_lock);
+
+		if (req || err || (!ctx->active_reqs &&
+		    test_bit(MMC_QUEUE_CMDQ_CLAIMED, &mq->flags))) {
+			set_current_state(TASK_RUNNING);
+			mq->cmdq_issue_fn(mq, req);
+		} else if (ctx->active_reqs) {
+			schedule();
+		} else {
+			if (kthread_should_stop()) {
+				set_current_state(TASK_RUNNING);
+				break;
+			}
+			up(&mq->thread_sem);
+			schedule();
+			down(&mq->thread_sem);
+		}
+	} while (1);
+	up(&mq->thread_sem);
+
+	return 0;
+}
+
 /*
  * Generic MMC request handler.  This is called for any queue on a
  * particular host.  When the host is not busy, we look for a request
@@ -140,6 +188,11 @@ static void mmc_request_fn(struct request_queue *q)
 		return;
 	}
 
+	if (mq->cmdq_depth) {
+		wake_up_process(mq->thread);
+		return;
+	}
+
 	cntx = &mq->card->host->context_info;
 	if (!mq->mqrq_cur->req && mq->mqrq_prev->req) {
 		/*
@@ -234,6 +287,56 @@ static void mmc_queue_setup_discard(struct request_queue *q,
 		queue_flag_set_unlocked(QUEUE_FLAG_SECDISCARD, q);
 }
 
+static void mmc_cmdq_free_slots(struct mmc_queue *mq, int depth)
+{
+	int i;
+
+	if (!mq->mqrq_cmdq)
+		return;
+
+	for (i = 0; i < depth; i++)
+		kfree(mq->mqrq_cmdq[i].sg);
+	kfree(mq->mqrq_cmdq);
+	mq->mqrq_cmdq = NULL;
+	mq->cmdq_depth = 0;
+}
+
+/*
+ * Allocate a request per task slot and switch the card to command queue
+ * mode, the queue stays in legacy mode if any of it fails.
+ */
+static int mmc_cmdq_init_queue(struct mmc_queue *mq, struct mmc_card *card)
+{
+	struct mmc_host *host = card->host;
+	int i, ret = 0, depth;
+
+	depth = min_t(int, host->num_cq_slots, card->ext_csd.cmdq_depth);
+	mq->mqrq_cmdq = kzalloc(sizeof(*mq->mqrq_cmdq) * depth, GFP_KERNEL);
+	if (!mq->mqrq_cmdq)
+		return -ENOMEM;
+
+	for (i = 0; i < depth; i++) {
+		mq->mqrq_cmdq[i].sg = mmc_alloc_sg(host->max_segs, &ret);
+		if (ret)
+			goto free_slots;
+	}
+
+	mmc_rpm_hold(host, &card->dev);
+	mmc_claim_host(host);
+	ret = mmc_cmdq_enable(card);
+	mmc_release_host(host);
+	mmc_rpm_release(host, &card->dev);
+	if (ret)
+		goto free_slots;
+
+	mq->cmdq_depth = depth;
+	return 0;
+
+free_slots:
+	mmc_cmdq_free_slots(mq, depth);
+	return ret;
+}
+
 /**
  * mmc_init_queue - initialise a queue structure.
  * @mq: mmc queue
@@ -372,9 +475,19 @@ cur_sg_alloc_failed:
 	}
 
 success:
+	/* only the user area is queued, other partitions stay legacy */
+	if (!subname && !mqrq_cur->bounce_buf && mmc_host_cmdq(host) &&
+	    card->ext_csd.cmdq_support) {
+		ret = mmc_cmdq_init_queue(mq, card);
+		if (ret)
+			pr_warn("%s: command queue not used %d\n",
+				mmc_card_name(card), ret);
+	}
+
 	sema_init(&mq->thread_sem, 1);
 
-	mq->thread = kthread_run(mmc_queue_thread, mq, "mmcqd/%d%s",
+	mq->thread = kthread_run(mq->cmdq_depth ? mmc_cmdq_thread :
+		mmc_queue_thread, mq, "mmcqd/%d%s",
 		host->index, subname ? subname : "");
 
 	if (IS_ERR(mq->thread)) {
@@ -384,6 +497,7 @@ success:
 
 	return 0;
  free_bounce_sg:
+	mmc_cmdq_free_slots(mq, mq->cmdq_depth);
 	kfree(mqrq_cur->bounce_sg);
 	mqrq_cur->bounce_sg = NULL;
 	kfree(mqrq_prev->bounce_sg);
@@ -441,6 +555,8 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	kfree(mqrq_prev->bounce_buf);
 	mqrq_prev->bounce_buf = NULL;
 
+	mmc_cmdq_free_slots(mq, mq->cmdq_depth);
+
 	mq->card = NULL;
 }
 EXPORT_SYMBOL(mmc_cleanup_queue);
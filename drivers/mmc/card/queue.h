@@ -41,6 +41,7 @@ struct mmc_queue_req {
 	struct mmc_async_req	mmc_active;
 	enum mmc_packed_type	cmd_type;
 	struct mmc_packed	*packed;
+	struct mmc_cmdq_req	cmdq_req;
 };
 
 struct mmc_queue {
@@ -51,6 +52,7 @@ struct mmc_queue {
 #define MMC_QUEUE_SUSPENDED		0
 #define MMC_QUEUE_NEW_REQUEST		1
 #define MMC_QUEUE_URGENT_REQUEST	2
+#define MMC_QUEUE_CMDQ_CLAIMED		3
 
 	int			(*issue_fn)(struct mmc_queue *, struct request *);
 	void			*data;
@@ -62,8 +64,21 @@ struct mmc_queue {
 	int			num_of_potential_packed_wr_reqs;
 	int			num_wr_reqs_to_start_packing;
 	bool			no_pack_for_random;
+	/* adaptive packing trigger state, see get_packed_trigger() */
+	unsigned long		pckd_trgr_mean_potential;
+	int			pckd_trgr_num_mean;
+	unsigned int		rd_lat_ewma_us;
+	unsigned int		rd_lat_target_us;
 	int (*err_check_fn) (struct mmc_card *, struct mmc_async_req *);
 	void (*packed_test_fn) (struct request_queue *, struct mmc_queue_req *);
+	/*
+	 * Command queue mode: one mmc_queue_req per task slot, the tag of a
+	 * task is its index. cmdq_issue_fn is called with a NULL request when
+	 * the queue went idle or the engine reported an error.
+	 */
+	struct mmc_queue_req	*mqrq_cmdq;
+	int			cmdq_depth;
+	int (*cmdq_issue_fn)(struct mmc_queue *, struct request *);
 };
 
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *,
@@ -1042,6 +1042,165 @@ void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
 }
 EXPORT_SYMBOL(mmc_wait_for_req);
 
+/**
+ *	mmc_cmdq_start_req - queue a task to the command queue engine
+ *	@host: MMC host with the card in command queue mode
+ *	@cmdq_req: task to queue, its tag must be free in the engine
+ *
+ *	Returns once the task is queued, completion is reported through
+ *	cmdq_req->mrq.done which may run in interrupt context.
+ */
+int mmc_cmdq_start_req(struct mmc_host *host, struct mmc_cmdq_req *cmdq_req)
+{
+	struct mmc_request *mrq = &cmdq_req->mrq;
+	int err;
+
+	WARN_ON(!host->claimed);
+
+	if (!host->card || !mmc_card_cmdq(host->card))
+		return -EINVAL;
+
+	mrq->host = host;
+	mrq->cmdq_req = cmdq_req;
+	if (mrq->data) {
+		BUG_ON(mrq->data->blksz > host->max_blk_size);
+		BUG_ON(mrq->data->blocks > host->max_blk_count);
+		mrq->data->error = 0;
+		mrq->data->bytes_xfered = 0;
+		mrq->data->mrq = mrq;
+	}
+
+	mmc_host_clk_hold(host);
+	err = host->cmdq_ops->request(host, mrq);
+	if (err)
+		mmc_host_clk_release(host);
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_cmdq_start_req);
+
+/**
+ *	mmc_cmdq_req_done - finish processing a command queue task
+ *	@mrq: request of the task
+ *
+ *	Host drivers call this when the engine reports the task done or
+ *	failed, with mrq->data->error set in the latter case.
+ */
+void mmc_cmdq_req_done(struct mmc_request *mrq)
+{
+	struct mmc_host *host = mrq->host;
+
+	if (mrq->data && !mrq->data->error)
+		mrq->data->bytes_xfered = mrq->data->blksz *
+			mrq->data->blocks;
+
+	if (mrq->done)
+		mrq->done(mrq);
+
+	mmc_host_clk_release(host);
+}
+EXPORT_SYMBOL(mmc_cmdq_req_done);
+
+/**
+ *	mmc_cmdq_enable - switch the card and host to command queue mode
+ *	@card: MMC card, the host must be claimed and no request in flight
+ */
+int mmc_cmdq_enable(struct mmc_card *card)
+{
+	struct mmc_host *host = card->host;
+	int err;
+
+	if (mmc_card_cmdq(card))
+		return 0;
+
+	if (!card->ext_csd.cmdq_support || !mmc_host_cmdq(host))
+		return -EOPNOTSUPP;
+
+	err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN,
+			 EXT_CSD_CMDQ_MODE_ENABLE,
+			 card->ext_csd.generic_cmd6_time);
+	if (err) {
+		pr_err("%s: %s: failed to enable command queue mode %d\n",
+			mmc_hostname(host), __func__, err);
+		return err;
+	}
+
+	mmc_host_clk_hold(host);
+	err = host->cmdq_ops->enable(host);
+	mmc_host_clk_release(host);
+	if (err) {
+		pr_err("%s: %s: failed to enable the command queue engine %d\n",
+			mmc_hostname(host), __func__, err);
+		mmc_switch(card, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN,
+			   0, card->ext_csd.generic_cmd6_time);
+		return err;
+	}
+
+	host->cmdq_ctx.curr_state = 0;
+	mmc_card_set_cmdq(card);
+	return 0;
+}
+EXPORT_SYMBOL(mmc_cmdq_enable);
+
+/**
+ *	mmc_cmdq_disable - bring the card and host back to legacy mode
+ *	@card: MMC card, the host must be claimed and the queue empty
+ */
+int mmc_cmdq_disable(struct mmc_card *card)
+{
+	struct mmc_host *host = card->host;
+	int err;
+
+	if (!mmc_card_cmdq(card))
+		return 0;
+
+	WARN_ON(host->cmdq_ctx.active_reqs);
+
+	mmc_host_clk_hold(host);
+	host->cmdq_ops->disable(host, true);
+	mmc_host_clk_release(host);
+	mmc_card_clr_cmdq(card);
+
+	err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN,
+			 0, card->ext_csd.generic_cmd6_time);
+	if (err)
+		pr_err("%s: %s: failed to disable command queue mode %d\n",
+			mmc_hostname(host), __func__, err);
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_cmdq_disable);
+
+/**
+ *	mmc_cmdq_halt - halt or resume the command queue engine
+ *	@host: MMC host with the card in command queue mode
+ *	@halt: true to halt, false to resume
+ */
+int mmc_cmdq_halt(struct mmc_host *host, bool halt)
+{
+	int err;
+
+	if (halt == test_bit(CMDQ_STATE_HALT, &host->cmdq_ctx.curr_state))
+		return 0;
+
+	mmc_host_clk_hold(host);
+	err = host->cmdq_ops->halt(host, halt);
+	mmc_host_clk_release(host);
+	if (err) {
+		pr_err("%s: %s: failed to %s the command queue engine %d\n",
+			mmc_hostname(host), __func__,
+			halt ? "halt" : "resume", err);
+		return err;
+	}
+
+	if (halt)
+		set_bit(CMDQ_STATE_HALT, &host->cmdq_ctx.curr_state);
+	else
+		clear_bit(CMDQ_STATE_HALT, &host->cmdq_ctx.curr_state);
+	return 0;
+}
+EXPORT_SYMBOL(mmc_cmdq_halt);
+
 bool mmc_card_is_prog_state(struct mmc_card *card)
 {
 	bool rc;
@@ -568,6 +568,17 @@ static ssize_t mmc_wr_pack_stats_read(struct file *filp, char __user *ubuf,
 			pack_stats->pack_stop_reason[FUA]);
 		strlcat(temp_ubuf, temp_buf, tubuf_cnt);
 	}
+
+	snprintf(temp_buf, TEMP_BUF_SIZE,
+		 "%s: packing trigger %d, raised %d times, lowered %d times\n",
+		 mmc_hostname(card->host), pack_stats->trigger,
+		 pack_stats->trigger_raised, pack_stats->trigger_lowered);
+	strlcat(temp_ubuf, temp_buf, tubuf_cnt);
+	snprintf(temp_buf, TEMP_BUF_SIZE,
+		 "%s: mean read latency %d us\n",
+		 mmc_hostname(card->host), pack_stats->rd_lat_us);
+	strlcat(temp_ubuf, temp_buf, tubuf_cnt);
+
 	if (strlen_user(ubuf) < cnt - strlen(temp_ubuf))
 		ret = copy_to_user((ubuf + strlen_user(ubuf)),
 				temp_ubuf, tubuf_cnt);
@@ -619,6 +619,15 @@ static int mmc_read_ext_csd(struct mmc_card *card, u8 *ext_csd)
 		card->ext_csd.data_sector_size = 512;
 	}
 
+	/* eMMC v5.1 or later */
+	if (card->ext_csd.rev >= 8) {
+		card->ext_csd.cmdq_support = ext_csd[EXT_CSD_CMDQ_SUPPORT] &
+			EXT_CSD_CMDQ_SUPPORTED;
+		if (card->ext_csd.cmdq_support)
+			card->ext_csd.cmdq_depth = (ext_csd[EXT_CSD_CMDQ_DEPTH] &
+				EXT_CSD_CMDQ_DEPTH_MASK) + 1;
+	}
+
 out:
 	return err;
 }
@@ -1360,6 +1369,15 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 	BUG_ON(!host);
 	WARN_ON(!host->claimed);
 
+	/*
+	 * The card leaves command queue mode on reset, stop the engine and
+	 * drop whatever it still holds so the two stay in step.
+	 */
+	if (oldcard && mmc_card_cmdq(oldcard)) {
+		host->cmdq_ops->disable(host, false);
+		mmc_card_clr_cmdq(oldcard);
+	}
+
 	/* Set correct bus mode for MMC before attempting init */
 	if (!mmc_host_is_spi(host))
 		mmc_set_bus_mode(host, MMC_BUSMODE_OPENDRAIN);
@@ -1859,6 +1877,10 @@ static int mmc_suspend(struct mmc_host *host)
 	 */
 	mmc_disable_clk_scaling(host);
 
+	err = mmc_cmdq_disable(host->card);
+	if (err)
+		goto out;
+
 	err = mmc_cache_ctrl(host, 0);
 	if (err)
 		goto out;
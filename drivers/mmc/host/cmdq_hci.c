@@ -0,0 +1,496 @@
+/* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/dma-mapping.h>
+#include <linux/slab.h>
+#include <linux/scatterlist.h>
+#include <linux/platform_device.h>
+
+#include <linux/mmc/mmc.h>
+#include <linux/mmc/host.h>
+#include <linux/mmc/card.h>
+
+#include "cmdq_hci.h"
+
+static inline u8 *get_desc(struct cmdq_host *cq_host, u8 tag)
+{
+	return cq_host->desc_base + (tag * cq_host->slot_sz);
+}
+
+static inline u8 *get_link_desc(struct cmdq_host *cq_host, u8 tag)
+{
+	return get_desc(cq_host, tag) + cq_host->task_desc_len;
+}
+
+static inline dma_addr_t get_trans_desc_dma(struct cmdq_host *cq_host, u8 tag)
+{
+	return cq_host->trans_desc_dma_base +
+		(cq_host->mmc->max_segs * tag * cq_host->trans_desc_len);
+}
+
+static inline u8 *get_trans_desc(struct cmdq_host *cq_host, u8 tag)
+{
+	return cq_host->trans_desc_base +
+		(cq_host->mmc->max_segs * tag * cq_host->trans_desc_len);
+}
+
+/*
+ * Write a transfer or link descriptor. Descriptors are little endian and
+ * the address starts at byte 4, which is why it is written as 32-bit words.
+ */
+static void cmdq_set_desc(struct cmdq_host *cq_host, u8 *desc, u32 attr,
+			  dma_addr_t addr)
+{
+	__le32 *word = (__le32 *)desc;
+
+	word[0] = cpu_to_le32(attr);
+	word[1] = cpu_to_le32(lower_32_bits(addr));
+	if (cq_host->dma64)
+		word[2] = cpu_to_le32(upper_32_bits(addr));
+}
+
+/* Point the link descriptor of every slot at the transfer list of the slot */
+static void cmdq_setup_link_desc(struct cmdq_host *cq_host)
+{
+	int tag;
+
+	for (tag = 0; tag < cq_host->num_slots; tag++)
+		cmdq_set_desc(cq_host, get_link_desc(cq_host, tag),
+			      VALID(1) | ACT(ACT_LINK) | END(0),
+			      get_trans_desc_dma(cq_host, tag));
+}
+
+static int cmdq_host_alloc_tdl(struct cmdq_host *cq_host)
+{
+	size_t desc_size, data_size;
+
+	if (cq_host->desc_base)
+		return 0;
+
+	/* 128-bit descriptors are required for 64-bit addresses */
+	cq_host->task_desc_len = cq_host->dma64 ? 16 : 8;
+	cq_host->link_desc_len = cq_host->dma64 ? 16 : 8;
+	cq_host->trans_desc_len = cq_host->dma64 ? 16 : 8;
+	cq_host->slot_sz = cq_host->task_desc_len + cq_host->link_desc_len;
+
+	desc_size = cq_host->slot_sz * cq_host->num_slots;
+	data_size = cq_host->trans_desc_len * cq_host->mmc->max_segs *
+		cq_host->num_slots;
+
+	cq_host->desc_base = dmam_alloc_coherent(mmc_dev(cq_host->mmc),
+			desc_size, &cq_host->desc_dma_base, GFP_KERNEL);
+	cq_host->trans_desc_base = dmam_alloc_coherent(mmc_dev(cq_host->mmc),
+			data_size, &cq_host->trans_desc_dma_base, GFP_KERNEL);
+	if (!cq_host->desc_base || !cq_host->trans_desc_base) {
+		cq_host->desc_base = NULL;
+		return -ENOMEM;
+	}
+
+	pr_debug("%s: desc-base: 0x%p trans-base: 0x%p\n desc_dma 0x%llx trans_dma: 0x%llx\n",
+		mmc_hostname(cq_host->mmc), cq_host->desc_base,
+		cq_host->trans_desc_base,
+		(unsigned long long)cq_host->desc_dma_base,
+		(unsigned long long)cq_host->trans_desc_dma_base);
+
+	return 0;
+}
+
+static void cmdq_dumpregs(struct cmdq_host *cq_host)
+{
+	struct mmc_host *mmc = cq_host->mmc;
+
+	pr_info("%s: ========== CMDQ REGISTER DUMP ==========\n",
+		mmc_hostname(mmc));
+	pr_info("%s: Caps: 0x%08x | Version: 0x%08x\n", mmc_hostname(mmc),
+		cmdq_readl(cq_host, CQCAP), cmdq_readl(cq_host, CQVER));
+	pr_info("%s: Config: 0x%08x | Control: 0x%08x\n", mmc_hostname(mmc),
+		cmdq_readl(cq_host, CQCFG), cmdq_readl(cq_host, CQCTL));
+	pr_info("%s: Int stat: 0x%08x | Int enab: 0x%08x\n",
+		mmc_hostname(mmc), cmdq_readl(cq_host, CQIS),
+		cmdq_readl(cq_host, CQISTE));
+	pr_info("%s: Int sig: 0x%08x | Int Coal: 0x%08x\n", mmc_hostname(mmc),
+		cmdq_readl(cq_host, CQISGE), cmdq_readl(cq_host, CQIC));
+	pr_info("%s: TDL base: 0x%08x | TDL up32: 0x%08x\n",
+		mmc_hostname(mmc), cmdq_readl(cq_host, CQTDLBA),
+		cmdq_readl(cq_host, CQTDLBAU));
+	pr_info("%s: Doorbell: 0x%08x | Comp Notif: 0x%08x\n",
+		mmc_hostname(mmc), cmdq_readl(cq_host, CQTDBR),
+		cmdq_readl(cq_host, CQTCN));
+	pr_info("%s: Dev queue: 0x%08x | Dev Pend: 0x%08x\n",
+		mmc_hostname(mmc), cmdq_readl(cq_host, CQDQS),
+		cmdq_readl(cq_host, CQDPT));
+	pr_info("%s: Task clr: 0x%08x | Send stat 1: 0x%08x\n",
+		mmc_hostname(mmc), cmdq_readl(cq_host, CQTCLR),
+		cmdq_readl(cq_host, CQSSC1));
+	pr_info("%s: Send stat 2: 0x%08x | DCMD resp: 0x%08x\n",
+		mmc_hostname(mmc), cmdq_readl(cq_host, CQSSC2),
+		cmdq_readl(cq_host, CQCRDCT));
+	pr_info("%s: Resp err mask: 0x%08x | Task err: 0x%08x\n",
+		mmc_hostname(mmc), cmdq_readl(cq_host, CQRMEM),
+		cmdq_readl(cq_host, CQTERRI));
+	pr_info("%s: Resp idx 0x%08x | Resp arg: 0x%08x\n",
+		mmc_hostname(mmc), cmdq_readl(cq_host, CQCRI),
+		cmdq_readl(cq_host, CQCRA));
+	pr_info("%s: ===========================================\n",
+		mmc_hostname(mmc));
+
+	if (cq_host->ops->dump_vendor_regs)
+		cq_host->ops->dump_vendor_regs(mmc);
+}
+
+static void cmdq_dumpstate(struct mmc_host *mmc)
+{
+	cmdq_dumpregs(mmc_cmdq_private(mmc));
+}
+
+static int cmdq_enable(struct mmc_host *mmc)
+{
+	struct cmdq_host *cq_host = mmc_cmdq_private(mmc);
+	u32 cqcfg;
+	int err;
+
+	if (cq_host->enabled)
+		return 0;
+
+	err = cmdq_host_alloc_tdl(cq_host);
+	if (err)
+		return err;
+
+	cqcfg = cmdq_readl(cq_host, CQCFG);
+	if (cqcfg & CQ_ENABLE)
+		cmdq_writel(cq_host, cqcfg & ~CQ_ENABLE, CQCFG);
+
+	cqcfg = cq_host->dma64 ? CQ_TASK_DESC_SZ : 0;
+	cmdq_writel(cq_host, cqcfg, CQCFG);
+
+	cmdq_setup_link_desc(cq_host);
+	cmdq_writel(cq_host, lower_32_bits(cq_host->desc_dma_base), CQTDLBA);
+	cmdq_writel(cq_host, upper_32_bits(cq_host->desc_dma_base), CQTDLBAU);
+
+	if (cq_host->ops->set_block_size)
+		cq_host->ops->set_block_size(mmc);
+	if (cq_host->ops->clear_set_irqs)
+		cq_host->ops->clear_set_irqs(mmc, true);
+
+	cmdq_writel(cq_host, CQIS_MASK, CQIS);
+	cmdq_writel(cq_host, CQIS_MASK, CQISTE);
+	cmdq_writel(cq_host, CQIS_MASK, CQISGE);
+
+	/* the descriptors have to be visible before the engine starts */
+	wmb();
+	cmdq_writel(cq_host, cqcfg | CQ_ENABLE, CQCFG);
+	cq_host->enabled = true;
+
+	return 0;
+}
+
+/*
+ * Drop the tasks still held by the engine, they are completed with -EAGAIN
+ * so that their owners can queue them again.
+ */
+static void cmdq_drop_tasks(struct cmdq_host *cq_host)
+{
+	struct mmc_request *mrq;
+	unsigned long flags;
+	int tag;
+
+	for (tag = 0; tag < cq_host->num_slots; tag++) {
+		spin_lock_irqsave(&cq_host->lock, flags);
+		mrq = cq_host->mrq_slot[tag];
+		cq_host->mrq_slot[tag] = NULL;
+		spin_unlock_irqrestore(&cq_host->lock, flags);
+
+		if (!mrq)
+			continue;
+
+		dma_unmap_sg(mmc_dev(cq_host->mmc), mrq->data->sg,
+			     mrq->data->sg_len,
+			     (mrq->data->flags & MMC_DATA_READ) ?
+			     DMA_FROM_DEVICE : DMA_TO_DEVICE);
+		mrq->data->error = -EAGAIN;
+		mmc_cmdq_req_done(mrq);
+	}
+}
+
+static void cmdq_disable(struct mmc_host *mmc, bool soft)
+{
+	struct cmdq_host *cq_host = mmc_cmdq_private(mmc);
+
+	if (!cq_host->enabled)
+		return;
+
+	if (!soft) {
+		cmdq_writel(cq_host, cmdq_readl(cq_host, CQCTL) | HALT, CQCTL);
+		cmdq_writel(cq_host, cmdq_readl(cq_host, CQCTL) |
+			    CLEAR_ALL_TASKS, CQCTL);
+	}
+
+	cmdq_writel(cq_host, 0, CQISTE);
+	cmdq_writel(cq_host, 0, CQISGE);
+	cmdq_writel(cq_host, cmdq_readl(cq_host, CQCFG) & ~CQ_ENABLE, CQCFG);
+	cmdq_writel(cq_host, cmdq_readl(cq_host, CQCTL) & ~HALT, CQCTL);
+
+	if (cq_host->ops->clear_set_irqs)
+		cq_host->ops->clear_set_irqs(mmc, false);
+
+	cq_host->enabled = false;
+
+	if (!soft)
+		cmdq_drop_tasks(cq_host);
+}
+
+static u64 cmdq_prep_task_desc(struct mmc_request *mrq)
+{
+	struct mmc_cmdq_req *cmdq_req = mrq->cmdq_req;
+	unsigned int flags = cmdq_req->cmd_flags;
+
+	return VALID(1) | END(1) | INT(1) | ACT(ACT_TASK) |
+		FORCED_PROG(!!(flags & MMC_CMDQ_FORCED_PRG)) |
+		CONTEXT(0) |
+		DATA_TAG(!!(flags & MMC_CMDQ_DATA_TAG)) |
+		DATA_DIR(!!(flags & MMC_CMDQ_DIR_READ)) |
+		PRIORITY(!!(flags & MMC_CMDQ_PRIO)) |
+		QBAR(0) |
+		REL_WRITE(!!(flags & MMC_CMDQ_REL_WR)) |
+		BLK_COUNT(mrq->data->blocks) |
+		BLK_ADDR((u64)cmdq_req->blk_addr);
+}
+
+static int cmdq_prep_tran_desc(struct cmdq_host *cq_host,
+			       struct mmc_request *mrq, u8 tag)
+{
+	struct mmc_data *data = mrq->data;
+	struct scatterlist *sg;
+	u8 *desc;
+	int i, sg_count;
+
+	sg_count = dma_map_sg(mmc_dev(cq_host->mmc), data->sg, data->sg_len,
+			      (data->flags & MMC_DATA_READ) ?
+			      DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	if (!sg_count) {
+		pr_err("%s: %s: sg-len: %d\n", mmc_hostname(cq_host->mmc),
+			__func__, data->sg_len);
+		return -ENOMEM;
+	}
+
+	desc = get_trans_desc(cq_host, tag);
+	for_each_sg(data->sg, sg, sg_count, i) {
+		cmdq_set_desc(cq_host, desc,
+			      VALID(1) | END(i == sg_count - 1) | INT(0) |
+			      ACT(ACT_TRAN) | DAT_LENGTH(sg_dma_len(sg)),
+			      sg_dma_address(sg));
+		desc += cq_host->trans_desc_len;
+	}
+
+	return 0;
+}
+
+static int cmdq_request(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct cmdq_host *cq_host = mmc_cmdq_private(mmc);
+	unsigned int tag = mrq->cmdq_req->tag;
+	unsigned long flags;
+	__le64 *task_desc;
+	int err;
+
+	if (!cq_host->enabled || tag >= cq_host->num_slots || !mrq->data)
+		return -EINVAL;
+
+	task_desc = (__le64 *)get_desc(cq_host, tag);
+	*task_desc = cpu_to_le64(cmdq_prep_task_desc(mrq));
+
+	err = cmdq_prep_tran_desc(cq_host, mrq, tag);
+	if (err)
+		return err;
+
+	spin_lock_irqsave(&cq_host->lock, flags);
+	BUG_ON(cq_host->mrq_slot[tag]);
+	cq_host->mrq_slot[tag] = mrq;
+	/* the descriptors have to be visible before the doorbell rings */
+	wmb();
+	cmdq_writel(cq_host, 1 << tag, CQTDBR);
+	spin_unlock_irqrestore(&cq_host->lock, flags);
+
+	return 0;
+}
+
+static void cmdq_finish_data(struct cmdq_host *cq_host, unsigned int tag,
+			     int err)
+{
+	struct mmc_request *mrq;
+
+	spin_lock(&cq_host->lock);
+	mrq = cq_host->mrq_slot[tag];
+	cq_host->mrq_slot[tag] = NULL;
+	spin_unlock(&cq_host->lock);
+
+	if (!mrq)
+		return;
+
+	dma_unmap_sg(mmc_dev(cq_host->mmc), mrq->data->sg, mrq->data->sg_len,
+		     (mrq->data->flags & MMC_DATA_READ) ?
+		     DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	mrq->data->error = err;
+	if (err)
+		mrq->cmdq_req->resp_err = cmdq_readl(cq_host, CQCRA);
+	mmc_cmdq_req_done(mrq);
+}
+
+/**
+ * cmdq_irq() - handle an interrupt of the engine
+ * @mmc: MMC host of the engine
+ * @err: Error the host controller reported along, 0 if none
+ *
+ * Called by the host controller driver for every interrupt raised while the
+ * engine is enabled. A failed task is completed with its error and the host
+ * is flagged CMDQ_STATE_ERR, recovery is left to the owner of the queue.
+ */
+irqreturn_t cmdq_irq(struct mmc_host *mmc, int err)
+{
+	struct cmdq_host *cq_host = mmc_cmdq_private(mmc);
+	unsigned long comp_status;
+	u32 status, terri;
+	int tag;
+
+	status = cmdq_readl(cq_host, CQIS);
+	cmdq_writel(cq_host, status, CQIS);
+
+	if (err || (status & CQIS_RED)) {
+		terri = cmdq_readl(cq_host, CQTERRI);
+		pr_err("%s: %s: error %d status 0x%08x task err 0x%08x\n",
+			mmc_hostname(mmc), __func__, err, status, terri);
+		cmdq_dumpregs(cq_host);
+
+		set_bit(CMDQ_STATE_ERR, &mmc->cmdq_ctx.curr_state);
+		if (terri & CQ_TERRI_DAT_VALID)
+			tag = CQ_TERRI_DAT_TASK(terri);
+		else if (terri & CQ_TERRI_CMD_VALID)
+			tag = CQ_TERRI_CMD_TASK(terri);
+		else
+			tag = -1;
+
+		if (tag >= 0)
+			cmdq_finish_data(cq_host, tag, err ? err : -EIO);
+	}
+
+	if (status & CQIS_TCC) {
+		comp_status = cmdq_readl(cq_host, CQTCN);
+		cmdq_writel(cq_host, comp_status, CQTCN);
+
+		for_each_set_bit(tag, &comp_status, cq_host->num_slots)
+			cmdq_finish_data(cq_host, tag, 0);
+	}
+
+	if (status & CQIS_HAC)
+		complete(&cq_host->halt_comp);
+
+	return IRQ_HANDLED;
+}
+EXPORT_SYMBOL(cmdq_irq);
+
+static int cmdq_halt(struct mmc_host *mmc, bool halt)
+{
+	struct cmdq_host *cq_host = mmc_cmdq_private(mmc);
+	u32 ctl = cmdq_readl(cq_host, CQCTL);
+
+	if (!halt) {
+		cmdq_writel(cq_host, ctl & ~HALT, CQCTL);
+		return 0;
+	}
+
+	INIT_COMPLETION(cq_host->halt_comp);
+	cmdq_writel(cq_host, ctl | HALT, CQCTL);
+	if (!wait_for_completion_timeout(&cq_host->halt_comp,
+				msecs_to_jiffies(HALT_TIMEOUT_MS)) &&
+	    !(cmdq_readl(cq_host, CQCTL) & HALT))
+		return -ETIMEDOUT;
+
+	return 0;
+}
+
+static const struct mmc_cmdq_host_ops cmdq_host_ops = {
+	.enable = cmdq_enable,
+	.disable = cmdq_disable,
+	.request = cmdq_request,
+	.halt = cmdq_halt,
+	.dumpstate = cmdq_dumpstate,
+};
+
+/**
+ * cmdq_pltfm_init() - map the registers of an engine
+ * @pdev: Platform device with a "cmdq_mem" memory resource
+ */
+struct cmdq_host *cmdq_pltfm_init(struct platform_device *pdev)
+{
+	struct cmdq_host *cq_host;
+	struct resource *cmdq_memres;
+
+	cmdq_memres = platform_get_resource_byname(pdev, IORESOURCE_MEM,
+						   "cmdq_mem");
+	if (!cmdq_memres) {
+		dev_dbg(&pdev->dev, "CMDQ not supported\n");
+		return ERR_PTR(-EINVAL);
+	}
+
+	cq_host = devm_kzalloc(&pdev->dev, sizeof(*cq_host), GFP_KERNEL);
+	if (!cq_host) {
+		dev_err(&pdev->dev, "failed to allocate memory for CMDQ\n");
+		return ERR_PTR(-ENOMEM);
+	}
+
+	cq_host->mmio = devm_ioremap(&pdev->dev, cmdq_memres->start,
+				     resource_size(cmdq_memres));
+	if (!cq_host->mmio) {
+		dev_err(&pdev->dev, "failed to remap cmdq regs\n");
+		return ERR_PTR(-EBUSY);
+	}
+	dev_dbg(&pdev->dev, "CMDQ ioremap: done\n");
+
+	return cq_host;
+}
+EXPORT_SYMBOL(cmdq_pltfm_init);
+
+/**
+ * cmdq_init() - attach an engine to a MMC host
+ * @cq_host: Engine returned by cmdq_pltfm_init(), with ops set
+ * @mmc: MMC host
+ * @dma64: Whether the engine has to use 64-bit addresses
+ *
+ * The descriptor lists are only allocated the first time the engine is
+ * enabled, once mmc->max_segs is final.
+ */
+int cmdq_init(struct cmdq_host *cq_host, struct mmc_host *mmc, bool dma64)
+{
+	cq_host->mmc = mmc;
+	cq_host->dma64 = dma64;
+	cq_host->num_slots = NUM_SLOTS;
+	spin_lock_init(&cq_host->lock);
+	init_completion(&cq_host->halt_comp);
+
+	cq_host->mrq_slot = devm_kzalloc(mmc_dev(mmc),
+			sizeof(*cq_host->mrq_slot) * cq_host->num_slots,
+			GFP_KERNEL);
+	if (!cq_host->mrq_slot)
+		return -ENOMEM;
+
+	mmc->cmdq_ops = &cmdq_host_ops;
+	mmc->num_cq_slots = cq_host->num_slots;
+	mmc->cmdq_private = cq_host;
+
+	return 0;
+}
+EXPORT_SYMBOL(cmdq_init);
+
+MODULE_DESCRIPTION("eMMC 5.1 Command Queue Host Controller Interface driver");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,169 @@
+/* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LINUX_MMC_CQ_HCI_H
+#define LINUX_MMC_CQ_HCI_H
+
+#include <linux/io.h>
+#include <linux/completion.h>
+#include <linux/interrupt.h>
+
+/* registers of the JEDEC eMMC 5.1 command queue host controller */
+#define CQVER		0x00
+#define CQCAP		0x04
+
+#define CQCFG		0x08
+#define CQ_DCMD		0x00001000
+#define CQ_TASK_DESC_SZ	0x00000100
+#define CQ_ENABLE	0x00000001
+
+#define CQCTL		0x0C
+#define CLEAR_ALL_TASKS	0x00000100
+#define HALT		0x00000001
+
+#define CQIS		0x10
+#define CQIS_HAC	(1 << 0)
+#define CQIS_TCC	(1 << 1)
+#define CQIS_RED	(1 << 2)
+#define CQIS_TCL	(1 << 3)
+#define CQIS_MASK	(CQIS_HAC | CQIS_TCC | CQIS_RED | CQIS_TCL)
+
+#define CQISTE		0x14
+#define CQISGE		0x18
+#define CQIC		0x1C
+#define CQTDLBA		0x20
+#define CQTDLBAU	0x24
+#define CQTDBR		0x28
+#define CQTCN		0x2C
+#define CQDQS		0x30
+#define CQDPT		0x34
+#define CQTCLR		0x38
+#define CQSSC1		0x40
+#define CQSSC2		0x44
+#define CQCRDCT		0x48
+#define CQRMEM		0x50
+
+#define CQTERRI		0x54
+#define CQ_TERRI_CMD_TASK(x)	((x) & 0x1F)
+#define CQ_TERRI_CMD_VALID	(1 << 15)
+#define CQ_TERRI_DAT_TASK(x)	(((x) >> 16) & 0x1F)
+#define CQ_TERRI_DAT_VALID	(1 << 31)
+
+#define CQCRI		0x58
+#define CQCRA		0x5C
+
+/* attributes shared by task, transfer and link descriptors */
+#define VALID(x)	(((x) & 1) << 0)
+#define END(x)		(((x) & 1) << 1)
+#define INT(x)		(((x) & 1) << 2)
+#define ACT(x)		(((x) & 7) << 3)
+
+/* task descriptor fields */
+#define FORCED_PROG(x)	((u64)((x) & 1) << 6)
+#define CONTEXT(x)	((u64)((x) & 0xF) << 7)
+#define DATA_TAG(x)	((u64)((x) & 1) << 11)
+#define DATA_DIR(x)	((u64)((x) & 1) << 12)
+#define PRIORITY(x)	((u64)((x) & 1) << 13)
+#define QBAR(x)		((u64)((x) & 1) << 14)
+#define REL_WRITE(x)	((u64)((x) & 1) << 15)
+#define BLK_COUNT(x)	((u64)((x) & 0xFFFF) << 16)
+#define BLK_ADDR(x)	((u64)((x) & 0xFFFFFFFF) << 32)
+
+/* transfer descriptor fields */
+#define DAT_LENGTH(x)	(((x) & 0xFFFF) << 16)
+
+#define ACT_TASK	0x5
+#define ACT_TRAN	0x4
+#define ACT_LINK	0x6
+
+#define NUM_SLOTS	32
+#define HALT_TIMEOUT_MS	1000
+
+struct mmc_host;
+struct mmc_request;
+struct platform_device;
+struct cmdq_host_ops;
+
+/**
+ * struct cmdq_host - a command queue engine
+ * @ops: Glue of the host controller the engine belongs to
+ * @mmio: Engine registers
+ * @mmc: MMC host the engine queues tasks for
+ * @lock: Protects @mrq_slot and the doorbell
+ * @dma64: Use 64-bit addresses, and 128-bit descriptors
+ * @enabled: Engine is enabled
+ * @num_slots: Task slots of the engine
+ * @task_desc_len: Size of a task descriptor
+ * @link_desc_len: Size of the link descriptor following it
+ * @trans_desc_len: Size of a transfer descriptor
+ * @slot_sz: Size of a slot of the task descriptor list
+ * @desc_base: Task descriptor list, one task and link descriptor per slot
+ * @desc_dma_base: DMA address of @desc_base
+ * @trans_desc_base: Transfer descriptor lists, max_segs per slot
+ * @trans_desc_dma_base: DMA address of @trans_desc_base
+ * @mrq_slot: Request queued in each slot
+ * @halt_comp: Completed by the halt interrupt
+ * @private: Host controller the engine belongs to
+ */
+struct cmdq_host {
+	const struct cmdq_host_ops *ops;
+	void __iomem *mmio;
+	struct mmc_host *mmc;
+	spinlock_t lock;
+
+	bool dma64;
+	bool enabled;
+	int num_slots;
+
+	int task_desc_len;
+	int link_desc_len;
+	int trans_desc_len;
+	int slot_sz;
+
+	u8 *desc_base;
+	dma_addr_t desc_dma_base;
+	u8 *trans_desc_base;
+	dma_addr_t trans_desc_dma_base;
+
+	struct mmc_request **mrq_slot;
+	struct completion halt_comp;
+
+	void *private;
+};
+
+/**
+ * struct cmdq_host_ops - host controller glue
+ * @clear_set_irqs: Route the controller interrupts to the engine (true) or
+ * back to the legacy path (false)
+ * @set_block_size: Program the block size transfers of the engine use
+ * @dump_vendor_regs: Dump controller registers on errors
+ */
+struct cmdq_host_ops {
+	void (*clear_set_irqs)(struct mmc_host *mmc, bool set);
+	void (*set_block_size)(struct mmc_host *mmc);
+	void (*dump_vendor_regs)(struct mmc_host *mmc);
+};
+
+static inline void cmdq_writel(struct cmdq_host *host, u32 val, int reg)
+{
+	writel_relaxed(val, host->mmio + reg);
+}
+
+static inline u32 cmdq_readl(struct cmdq_host *host, int reg)
+{
+	return readl_relaxed(host->mmio + reg);
+}
+
+extern irqreturn_t cmdq_irq(struct mmc_host *mmc, int err);
+extern int cmdq_init(struct cmdq_host *cq_host, struct mmc_host *mmc,
+		     bool dma64);
+extern struct cmdq_host *cmdq_pltfm_init(struct platform_device *pdev);
+#endif
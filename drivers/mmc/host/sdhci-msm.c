@@ -43,6 +43,7 @@
 #include <linux/msm-bus.h>
 
 #include "sdhci-pltfm.h"
+#include "cmdq_hci.h"
 
 enum sdc_mpm_pin_state {
 	SDC_DAT1_DISABLE,
@@ -207,6 +208,7 @@ enum sdc_mpm_pin_state {
 
 #define NUM_TUNING_PHASES		16
 #define MAX_DRV_TYPES_SUPPORTED_HS200	3
+#define NUM_TUNING_CACHE_ENTRIES	4
 
 /* Timeout value to avoid infinite waiting for pwr_irq */
 #define MSM_PWR_IRQ_TIMEOUT_MS 5000
@@ -336,6 +338,15 @@ struct sdhci_msm_bus_vote {
 	struct device_attribute max_bus_bw;
 };
 
+/* Tuning phase found for one operating point of the card */
+struct sdhci_msm_tuning_cache {
+	u32 clock;
+	u8 timing;
+	u32 io_level;
+	u8 phase;
+	bool valid;
+};
+
 struct sdhci_msm_host {
 	struct platform_device	*pdev;
 	void __iomem *core_mem;    /* MSM SDCC mapped address */
@@ -358,8 +369,11 @@ struct sdhci_msm_host {
 	bool tuning_done;
 	bool calibration_done;
 	u8 saved_tuning_phase;
+	struct sdhci_msm_tuning_cache tuning_cache[NUM_TUNING_CACHE_ENTRIES];
+	int tuning_cache_next;
 	bool en_auto_cmd21;
 	struct device_attribute auto_cmd21_attr;
+	struct device_attribute iopoll_attr;
 	bool is_sdiowakeup_enabled;
 	atomic_t controller_clock;
 	bool use_cdclp533;
@@ -464,6 +478,25 @@ static ssize_t show_auto_cmd21(struct device *dev,
 	return snprintf(buf, PAGE_SIZE, "%d\n", msm_host->en_auto_cmd21);
 }
 
+static ssize_t store_iopoll(struct device *dev, struct device_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct sdhci_host *host = dev_get_drvdata(dev);
+	u32 tmp;
+
+	if (!kstrtou32(buf, 0, &tmp))
+		sdhci_set_iopoll(host, !!tmp);
+	return count;
+}
+
+static ssize_t show_iopoll(struct device *dev,
+			   struct device_attribute *attr, char *buf)
+{
+	struct sdhci_host *host = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", host->iopoll_enabled);
+}
+
 /* MSM auto-tuning handler */
 static int sdhci_msm_config_auto_tuning_cmd(struct sdhci_host *host,
 					    bool enable,
@@ -990,6 +1023,129 @@ static void sdhci_msm_set_mmc_drv_type(struct sdhci_host *host, u32 opcode,
 			drv_type);
 }
 
+/*
+ * Read the tuning block at the given phase. Returns 1 if the block came
+ * back intact, 0 if not, or a negative error if the phase can't be set.
+ */
+static int sdhci_msm_tuning_phase_ok(struct sdhci_host *host, u32 opcode,
+				     u8 phase, u8 *data_buf,
+				     const u32 *tuning_block_pattern, int size)
+{
+	struct mmc_host *mmc = host->mmc;
+	struct mmc_card *card = mmc->card;
+	struct mmc_command cmd = {0};
+	struct mmc_data data = {0};
+	struct mmc_request mrq = {
+		.cmd = &cmd,
+		.data = &data
+	};
+	struct scatterlist sg;
+	struct mmc_command sts_cmd = {0};
+	int sts_retry;
+	int rc;
+
+	/* set the phase in delay line hw block */
+	rc = msm_config_cm_dll_phase(host, phase);
+	if (rc)
+		return rc;
+
+	cmd.opcode = opcode;
+	cmd.flags = MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	data.blksz = size;
+	data.blocks = 1;
+	data.flags = MMC_DATA_READ;
+	data.timeout_ns = 1000 * 1000 * 1000; /* 1 sec */
+
+	data.sg = &sg;
+	data.sg_len = 1;
+	sg_init_one(&sg, data_buf, size);
+	memset(data_buf, 0, size);
+	mmc_wait_for_req(mmc, &mrq);
+
+	if (card && (cmd.error || data.error)) {
+		sts_cmd.opcode = MMC_SEND_STATUS;
+		sts_cmd.arg = card->rca << 16;
+		sts_cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+		sts_retry = 5;
+		while (sts_retry) {
+			mmc_wait_for_cmd(mmc, &sts_cmd, 0);
+
+			if (sts_cmd.error ||
+			   (R1_CURRENT_STATE(sts_cmd.resp[0])
+			   != R1_STATE_TRAN)) {
+				sts_retry--;
+				/*
+				 * wait for at least 146 MCLK cycles for
+				 * the card to move to TRANS state. As
+				 * the MCLK would be min 200MHz for
+				 * tuning, we need max 0.73us delay. To
+				 * be on safer side 1ms delay is given.
+				 */
+				usleep_range(1000, 1200);
+				pr_debug("%s: phase %d sts cmd err %d resp 0x%x\n",
+					mmc_hostname(mmc), phase,
+					sts_cmd.error, sts_cmd.resp[0]);
+				continue;
+			}
+			break;
+		};
+	}
+
+	return !cmd.error && !data.error &&
+		!memcmp(data_buf, tuning_block_pattern, size);
+}
+
+/*
+ * Tuning results are kept per clock rate, timing and IO voltage so that
+ * resume and clock scaling only have to check the phase found last time.
+ * Only non-removable cards are cached, an SD card may have been swapped.
+ */
+static struct sdhci_msm_tuning_cache *
+sdhci_msm_tuning_cache_find(struct sdhci_host *host)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_msm_host *msm_host = pltfm_host->priv;
+	struct sdhci_msm_tuning_cache *entry;
+	int i;
+
+	if (!(host->mmc->caps & MMC_CAP_NONREMOVABLE))
+		return NULL;
+
+	for (i = 0; i < NUM_TUNING_CACHE_ENTRIES; i++) {
+		entry = &msm_host->tuning_cache[i];
+		if (entry->valid && entry->clock == host->clock &&
+		    entry->timing == host->mmc->ios.timing &&
+		    entry->io_level == msm_host->curr_io_level)
+			return entry;
+	}
+
+	return NULL;
+}
+
+static void sdhci_msm_tuning_cache_store(struct sdhci_host *host, u8 phase)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_msm_host *msm_host = pltfm_host->priv;
+	struct sdhci_msm_tuning_cache *entry;
+
+	if (!(host->mmc->caps & MMC_CAP_NONREMOVABLE))
+		return;
+
+	entry = sdhci_msm_tuning_cache_find(host);
+	if (!entry) {
+		entry = &msm_host->tuning_cache[msm_host->tuning_cache_next];
+		msm_host->tuning_cache_next = (msm_host->tuning_cache_next + 1) %
+			NUM_TUNING_CACHE_ENTRIES;
+	}
+
+	entry->clock = host->clock;
+	entry->timing = host->mmc->ios.timing;
+	entry->io_level = msm_host->curr_io_level;
+	entry->phase = phase;
+	entry->valid = true;
+}
+
 int sdhci_msm_execute_tuning(struct sdhci_host *host, u32 opcode)
 {
 	unsigned long flags;
@@ -1005,7 +1161,7 @@ int sdhci_msm_execute_tuning(struct sdhci_host *host, u32 opcode)
 	u8 drv_type = 0;
 	bool drv_type_changed = false;
 	struct mmc_card *card = host->mmc->card;
-	int sts_retry;
+	struct sdhci_msm_tuning_cache *cached;
 
 	/*
 	 * Tuning is required for SDR104, HS200 and HS400 cards and
@@ -1046,6 +1202,35 @@ int sdhci_msm_execute_tuning(struct sdhci_host *host, u32 opcode)
 		goto out;
 	}
 
+	/*
+	 * A CRC error since the last tuning means the cached phase has
+	 * drifted off, otherwise one block read at it is enough to trust it.
+	 */
+	cached = sdhci_msm_tuning_cache_find(host);
+	if (cached && host->tuning_crc_err) {
+		cached->valid = false;
+		cached = NULL;
+	}
+	if (cached) {
+		rc = msm_init_cm_dll(host);
+		if (rc)
+			goto kfree;
+
+		rc = sdhci_msm_tuning_phase_ok(host, opcode, cached->phase,
+				data_buf, tuning_block_pattern, size);
+		if (rc < 0)
+			goto kfree;
+		if (rc) {
+			msm_host->saved_tuning_phase = cached->phase;
+			pr_debug("%s: %s: reusing tuning phase %d\n",
+				mmc_hostname(mmc), __func__, cached->phase);
+			rc = 0;
+			goto kfree;
+		}
+		cached->valid = false;
+	}
+	host->tuning_crc_err = false;
+
 retry:
 	tuned_phase_cnt = 0;
 
@@ -1056,65 +1241,12 @@ retry:
 
 	phase = 0;
 	do {
-		struct mmc_command cmd = {0};
-		struct mmc_data data = {0};
-		struct mmc_request mrq = {
-			.cmd = &cmd,
-			.data = &data
-		};
-		struct scatterlist sg;
-		struct mmc_command sts_cmd = {0};
-
-		/* set the phase in delay line hw block */
-		rc = msm_config_cm_dll_phase(host, phase);
-		if (rc)
+		rc = sdhci_msm_tuning_phase_ok(host, opcode, phase, data_buf,
+					       tuning_block_pattern, size);
+		if (rc < 0)
 			goto kfree;
 
-		cmd.opcode = opcode;
-		cmd.flags = MMC_RSP_R1 | MMC_CMD_ADTC;
-
-		data.blksz = size;
-		data.blocks = 1;
-		data.flags = MMC_DATA_READ;
-		data.timeout_ns = 1000 * 1000 * 1000; /* 1 sec */
-
-		data.sg = &sg;
-		data.sg_len = 1;
-		sg_init_one(&sg, data_buf, size);
-		memset(data_buf, 0, size);
-		mmc_wait_for_req(mmc, &mrq);
-
-		if (card && (cmd.error || data.error)) {
-			sts_cmd.opcode = MMC_SEND_STATUS;
-			sts_cmd.arg = card->rca << 16;
-			sts_cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
-			sts_retry = 5;
-			while (sts_retry) {
-				mmc_wait_for_cmd(mmc, &sts_cmd, 0);
-
-				if (sts_cmd.error ||
-				   (R1_CURRENT_STATE(sts_cmd.resp[0])
-				   != R1_STATE_TRAN)) {
-					sts_retry--;
-					/*
-					 * wait for at least 146 MCLK cycles for
-					 * the card to move to TRANS state. As
-					 * the MCLK would be min 200MHz for
-					 * tuning, we need max 0.73us delay. To
-					 * be on safer side 1ms delay is given.
-					 */
-					usleep_range(1000, 1200);
-					pr_debug("%s: phase %d sts cmd err %d resp 0x%x\n",
-						mmc_hostname(mmc), phase,
-						sts_cmd.error, sts_cmd.resp[0]);
-					continue;
-				}
-				break;
-			};
-		}
-
-		if (!cmd.error && !data.error &&
-			!memcmp(data_buf, tuning_block_pattern, size)) {
+		if (rc) {
 			/* tuning is successful at this tuning point */
 			tuned_phases[tuned_phase_cnt++] = phase;
 			pr_debug("%s: %s: found *** good *** phase = %d\n",
@@ -1174,6 +1306,7 @@ retry:
 		if (rc)
 			goto kfree;
 		msm_host->saved_tuning_phase = phase;
+		sdhci_msm_tuning_cache_store(host, phase);
 		pr_debug("%s: %s: finally setting the tuning phase to %d\n",
 				mmc_hostname(mmc), __func__, phase);
 	} else {
@@ -3566,6 +3699,17 @@ static int sdhci_msm_probe(struct platform_device *pdev)
 	if (msm_host->pdata->nonhotplug)
 		msm_host->mmc->caps2 |= MMC_CAP2_NONHOTPLUG;
 
+#ifdef CONFIG_MMC_CQ_HCI
+	host->cq_host = cmdq_pltfm_init(pdev);
+	if (IS_ERR(host->cq_host)) {
+		dev_dbg(&pdev->dev, "cmdq-pltfm init: failed: %ld\n",
+			PTR_ERR(host->cq_host));
+		host->cq_host = NULL;
+	} else {
+		msm_host->mmc->caps2 |= MMC_CAP2_CMD_QUEUE;
+	}
+#endif
+
 	init_completion(&msm_host->pwr_irq_completion);
 
 	if (gpio_is_valid(msm_host->pdata->status_gpio)) {
@@ -3662,6 +3806,20 @@ static int sdhci_msm_probe(struct platform_device *pdev)
 		device_remove_file(&pdev->dev, &msm_host->auto_cmd21_attr);
 	}
 
+	msm_host->iopoll_attr.show = show_iopoll;
+	msm_host->iopoll_attr.store = store_iopoll;
+	sysfs_attr_init(&msm_host->iopoll_attr.attr);
+	msm_host->iopoll_attr.attr.name = "iopoll";
+	msm_host->iopoll_attr.attr.mode = S_IRUGO | S_IWUSR;
+	ret = device_create_file(&pdev->dev, &msm_host->iopoll_attr);
+	if (ret) {
+		pr_err("%s: %s: failed creating iopoll attr: %d\n",
+		       mmc_hostname(host->mmc), __func__, ret);
+		ret = 0;
+	}
+	if (of_property_read_bool(pdev->dev.of_node, "qcom,iopoll"))
+		sdhci_set_iopoll(host, true);
+
 	if (msm_host->pdata->mpm_sdiowakeup_int != -1) {
 		ret = sdhci_msm_cfg_mpm_pin_wakeup(host, SDC_DAT1_ENABLE);
 		if (ret) {
@@ -3727,6 +3885,7 @@ static int sdhci_msm_remove(struct platform_device *pdev)
 	if (!gpio_is_valid(msm_host->pdata->status_gpio))
 		device_remove_file(&pdev->dev, &msm_host->polling);
 	device_remove_file(&pdev->dev, &msm_host->msm_bus_vote.max_bus_bw);
+	device_remove_file(&pdev->dev, &msm_host->iopoll_attr);
 	sdhci_remove_host(host, dead);
 	pm_runtime_disable(&pdev->dev);
 	sdhci_pltfm_free(pdev);
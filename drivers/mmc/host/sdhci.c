@@ -34,11 +34,13 @@
 #include <trace/events/mmc.h>
 
 #include "sdhci.h"
+#include "cmdq_hci.h"
 
 #define DRIVER_NAME "sdhci"
 #define SDHCI_SUSPEND_TIMEOUT 300 /* 300 ms */
 #define SDHCI_PM_QOS_DEFAULT_DELAY 5 /* 5 ms */
 #define SDHCI_MAX_PM_QOS_TIMEOUT   100 /* 100 ms */
+#define SDHCI_IOPOLL_WEIGHT 16 /* events handled per iopoll run */
 
 #define DBG(f, x...) \
 	pr_debug(DRIVER_NAME " [%s()]: " f, __func__,## x)
@@ -1115,6 +1117,18 @@ static void sdhci_set_transfer_mode(struct sdhci_host *host,
 	sdhci_writew(host, mode, SDHCI_TRANSFER_MODE);
 }
 
+/*
+ * Completes the current request from the finish tasklet, or from the iopoll
+ * handler when that is the caller. Called with host->lock held.
+ */
+static inline void sdhci_schedule_finish(struct sdhci_host *host)
+{
+	if (host->in_iopoll)
+		host->iopoll_finish = true;
+	else
+		tasklet_schedule(&host->finish_tasklet);
+}
+
 static void sdhci_finish_data(struct sdhci_host *host)
 {
 	struct mmc_data *data;
@@ -1168,7 +1182,7 @@ static void sdhci_finish_data(struct sdhci_host *host)
 
 		sdhci_send_command(host, data->stop);
 	} else
-		tasklet_schedule(&host->finish_tasklet);
+		sdhci_schedule_finish(host);
 }
 
 #define SDHCI_REQUEST_TIMEOUT	10 /* Default request timeout in seconds */
@@ -1199,7 +1213,7 @@ static void sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 				"inhibit bit(s).\n", mmc_hostname(host->mmc));
 			sdhci_dumpregs(host);
 			cmd->error = -EIO;
-			tasklet_schedule(&host->finish_tasklet);
+			sdhci_schedule_finish(host);
 			return;
 		}
 		timeout--;
@@ -1224,7 +1238,7 @@ static void sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 		pr_err("%s: Unsupported response type!\n",
 			mmc_hostname(host->mmc));
 		cmd->error = -EINVAL;
-		tasklet_schedule(&host->finish_tasklet);
+		sdhci_schedule_finish(host);
 		return;
 	}
 
@@ -1288,7 +1302,7 @@ static void sdhci_finish_command(struct sdhci_host *host)
 			sdhci_finish_data(host);
 
 		if (!host->cmd->data)
-			tasklet_schedule(&host->finish_tasklet);
+			sdhci_schedule_finish(host);
 
 		host->cmd = NULL;
 	}
@@ -2923,9 +2937,11 @@ static void sdhci_cmd_irq(struct sdhci_host *host, u32 intmask)
 		    (command != MMC_SEND_TUNING_BLOCK_HS400) &&
 		    (command != MMC_SEND_TUNING_BLOCK_HS200) &&
 		    (command != MMC_SEND_TUNING_BLOCK) &&
-		    (command != MMC_SEND_STATUS))
-				host->flags |= SDHCI_NEEDS_RETUNING;
-		tasklet_schedule(&host->finish_tasklet);
+		    (command != MMC_SEND_STATUS)) {
+			host->flags |= SDHCI_NEEDS_RETUNING;
+			host->tuning_crc_err = true;
+		}
+		sdhci_schedule_finish(host);
 		return;
 	}
 
@@ -3051,8 +3067,10 @@ static void sdhci_data_irq(struct sdhci_host *host, u32 intmask)
 			    (command != MMC_SEND_TUNING_BLOCK_HS200) &&
 			    (command != MMC_SEND_TUNING_BLOCK)) {
 				pr_msg = true;
-				if (intmask & SDHCI_INT_DATA_CRC)
+				if (intmask & SDHCI_INT_DATA_CRC) {
 					host->flags |= SDHCI_NEEDS_RETUNING;
+					host->tuning_crc_err = true;
+				}
 			}
 		} else {
 			pr_msg = true;
@@ -3111,11 +3129,113 @@ static void sdhci_data_irq(struct sdhci_host *host, u32 intmask)
 	}
 }
 
+static void sdhci_cmd_data_irq(struct sdhci_host *host, u32 intmask)
+{
+	if (intmask & SDHCI_INT_CMD_MASK) {
+		if (intmask & SDHCI_INT_AUTO_CMD_ERR)
+			host->auto_cmd_err_sts = sdhci_readw(host,
+					SDHCI_AUTO_CMD_ERR);
+		sdhci_writel(host, intmask & SDHCI_INT_CMD_MASK,
+			SDHCI_INT_STATUS);
+		if ((host->quirks2 & SDHCI_QUIRK2_SLOW_INT_CLR) &&
+		    (host->clock <= 400000))
+			udelay(40);
+		sdhci_cmd_irq(host, intmask & SDHCI_INT_CMD_MASK);
+	}
+
+	if (intmask & SDHCI_INT_DATA_MASK) {
+		sdhci_writel(host, intmask & SDHCI_INT_DATA_MASK,
+			SDHCI_INT_STATUS);
+		if ((host->quirks2 & SDHCI_QUIRK2_SLOW_INT_CLR) &&
+		    (host->clock <= 400000))
+			udelay(40);
+		sdhci_data_irq(host, intmask & SDHCI_INT_DATA_MASK);
+	}
+}
+
+/*
+ * blk-iopoll handler, runs in softirq context. Handles the command and data
+ * events latched since the irq and completes finished requests directly,
+ * without a trip through the finish tasklet. Events are counted against
+ * @budget, when fewer are found the irq is unmasked again.
+ */
+static int sdhci_iopoll(struct blk_iopoll *iop, int budget)
+{
+	struct sdhci_host *host = container_of(iop, struct sdhci_host, iop);
+	unsigned long flags;
+	u32 intmask;
+	int done = 0;
+
+	spin_lock_irqsave(&host->lock, flags);
+	while (done < budget && !host->runtime_suspended) {
+		intmask = sdhci_readl(host, SDHCI_INT_STATUS) &
+			(SDHCI_INT_CMD_MASK | SDHCI_INT_DATA_MASK);
+		if (!intmask)
+			break;
+
+		host->in_iopoll = true;
+		sdhci_cmd_data_irq(host, intmask);
+		host->in_iopoll = false;
+		done++;
+
+		if (host->iopoll_finish) {
+			host->iopoll_finish = false;
+			spin_unlock_irqrestore(&host->lock, flags);
+			sdhci_tasklet_finish((unsigned long)host);
+			spin_lock_irqsave(&host->lock, flags);
+			/* nothing more to poll for until the next request */
+			if (!host->mrq)
+				break;
+		}
+	}
+
+	if (done < budget) {
+		blk_iopoll_complete(iop);
+		if (!host->runtime_suspended)
+			sdhci_writel(host, sdhci_readl(host, SDHCI_INT_ENABLE),
+				SDHCI_SIGNAL_ENABLE);
+	}
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	return done;
+}
+
+/**
+ * sdhci_set_iopoll - complete requests by blk-iopoll instead of the irq
+ * @host: host to configure
+ * @enable: true to poll for command and data completions in softirq
+ *
+ * In this mode the interrupt only schedules the iopoll handler, which
+ * handles the command and data events and completes the request in the
+ * same softirq run. Card detect and SDIO interrupts are not affected.
+ */
+void sdhci_set_iopoll(struct sdhci_host *host, bool enable)
+{
+	unsigned long flags;
+
+	if (enable == host->iopoll_enabled)
+		return;
+
+	if (enable) {
+		blk_iopoll_enable(&host->iop);
+		spin_lock_irqsave(&host->lock, flags);
+		host->iopoll_enabled = true;
+		spin_unlock_irqrestore(&host->lock, flags);
+	} else {
+		spin_lock_irqsave(&host->lock, flags);
+		host->iopoll_enabled = false;
+		spin_unlock_irqrestore(&host->lock, flags);
+		/* waits for a scheduled run, which unmasks the irq */
+		blk_iopoll_disable(&host->iop);
+	}
+}
+EXPORT_SYMBOL_GPL(sdhci_set_iopoll);
+
 static irqreturn_t sdhci_irq(int irq, void *dev_id)
 {
 	irqreturn_t result;
 	struct sdhci_host *host = dev_id;
-	u32 intmask, unexpected = 0;
+	u32 intmask, unexpected = 0, deferred = 0;
 	int cardint = 0, max_loops = 16;
 
 	spin_lock(&host->lock);
@@ -3151,6 +3271,12 @@ static irqreturn_t sdhci_irq(int irq, void *dev_id)
 		goto out;
 	}
 
+	if (host->mmc->card && mmc_card_cmdq(host->mmc->card)) {
+		sdhci_writel(host, intmask, SDHCI_INT_STATUS);
+		spin_unlock(&host->lock);
+		return sdhci_cmdq_irq(host, intmask);
+	}
+
 again:
 	DBG("*** %s got interrupt: 0x%08x\n",
 		mmc_hostname(host->mmc), intmask);
@@ -3180,25 +3306,22 @@ again:
 		tasklet_schedule(&host->card_tasklet);
 	}
 
-	if (intmask & SDHCI_INT_CMD_MASK) {
-		if (intmask & SDHCI_INT_AUTO_CMD_ERR)
-			host->auto_cmd_err_sts = sdhci_readw(host,
-					SDHCI_AUTO_CMD_ERR);
-		sdhci_writel(host, intmask & SDHCI_INT_CMD_MASK,
-			SDHCI_INT_STATUS);
-		if ((host->quirks2 & SDHCI_QUIRK2_SLOW_INT_CLR) &&
-		    (host->clock <= 400000))
-			udelay(40);
-		sdhci_cmd_irq(host, intmask & SDHCI_INT_CMD_MASK);
-	}
-
-	if (intmask & SDHCI_INT_DATA_MASK) {
-		sdhci_writel(host, intmask & SDHCI_INT_DATA_MASK,
-			SDHCI_INT_STATUS);
-		if ((host->quirks2 & SDHCI_QUIRK2_SLOW_INT_CLR) &&
-		    (host->clock <= 400000))
-			udelay(40);
-		sdhci_data_irq(host, intmask & SDHCI_INT_DATA_MASK);
+	if (intmask & (SDHCI_INT_CMD_MASK | SDHCI_INT_DATA_MASK)) {
+		if (host->iopoll_enabled && blk_iopoll_enabled) {
+			/*
+			 * Leave the status bits latched for the iopoll
+			 * handler and stop them from raising the irq
+			 * until it is done.
+			 */
+			sdhci_writel(host, sdhci_readl(host,
+				SDHCI_SIGNAL_ENABLE) & ~(SDHCI_INT_CMD_MASK |
+				SDHCI_INT_DATA_MASK), SDHCI_SIGNAL_ENABLE);
+			deferred = SDHCI_INT_CMD_MASK | SDHCI_INT_DATA_MASK;
+			if (!blk_iopoll_sched_prep(&host->iop))
+				blk_iopoll_sched(&host->iop);
+		} else {
+			sdhci_cmd_data_irq(host, intmask);
+		}
 	}
 
 	intmask &= ~(SDHCI_INT_CMD_MASK | SDHCI_INT_DATA_MASK);
@@ -3225,7 +3348,7 @@ again:
 
 	result = IRQ_HANDLED;
 
-	intmask = sdhci_readl(host, SDHCI_INT_STATUS);
+	intmask = sdhci_readl(host, SDHCI_INT_STATUS) & ~deferred;
 	if (intmask && --max_loops)
 		goto again;
 out:
@@ -3249,6 +3372,82 @@ out:
 	return result;
 }
 
+#ifdef CONFIG_MMC_CQ_HCI
+/*
+ * While the engine is enabled the controller only raises the command queue
+ * interrupt and errors, everything else is handled by the engine itself.
+ */
+static void sdhci_cmdq_clear_set_irqs(struct mmc_host *mmc, bool set)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->lock, flags);
+	if (set) {
+		host->cmdq_saved_ier = sdhci_readl(host, SDHCI_INT_ENABLE);
+		sdhci_writel(host, SDHCI_INT_CMDQ | SDHCI_INT_ERROR_MASK,
+			     SDHCI_INT_ENABLE);
+		sdhci_writel(host, SDHCI_INT_CMDQ | SDHCI_INT_ERROR_MASK,
+			     SDHCI_SIGNAL_ENABLE);
+	} else {
+		sdhci_writel(host, host->cmdq_saved_ier, SDHCI_INT_ENABLE);
+		sdhci_writel(host, host->cmdq_saved_ier, SDHCI_SIGNAL_ENABLE);
+	}
+	spin_unlock_irqrestore(&host->lock, flags);
+}
+
+static void sdhci_cmdq_set_block_size(struct mmc_host *mmc)
+{
+	sdhci_set_blk_size_reg(mmc_priv(mmc), 512, 0);
+}
+
+static void sdhci_cmdq_dump_vendor_regs(struct mmc_host *mmc)
+{
+	sdhci_dumpregs(mmc_priv(mmc));
+}
+
+static const struct cmdq_host_ops sdhci_cmdq_ops = {
+	.clear_set_irqs = sdhci_cmdq_clear_set_irqs,
+	.set_block_size = sdhci_cmdq_set_block_size,
+	.dump_vendor_regs = sdhci_cmdq_dump_vendor_regs,
+};
+
+static irqreturn_t sdhci_cmdq_irq(struct sdhci_host *host, u32 intmask)
+{
+	int err = 0;
+
+	if (intmask & (SDHCI_INT_TIMEOUT | SDHCI_INT_DATA_TIMEOUT))
+		err = -ETIMEDOUT;
+	else if (intmask & (SDHCI_INT_CRC | SDHCI_INT_DATA_CRC |
+			    SDHCI_INT_END_BIT | SDHCI_INT_DATA_END_BIT |
+			    SDHCI_INT_INDEX))
+		err = -EILSEQ;
+	else if (intmask & (SDHCI_INT_ADMA_ERROR | SDHCI_INT_ERROR))
+		err = -EIO;
+
+	return cmdq_irq(host->mmc, err);
+}
+
+static int sdhci_cmdq_init(struct sdhci_host *host, struct mmc_host *mmc)
+{
+	host->cq_host->ops = &sdhci_cmdq_ops;
+	host->cq_host->private = host;
+
+	return cmdq_init(host->cq_host, mmc,
+			 !!(host->flags & SDHCI_USE_ADMA_64BIT));
+}
+#else
+static irqreturn_t sdhci_cmdq_irq(struct sdhci_host *host, u32 intmask)
+{
+	return IRQ_NONE;
+}
+
+static int sdhci_cmdq_init(struct sdhci_host *host, struct mmc_host *mmc)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
 /*****************************************************************************\
  *                                                                           *
  * Suspend/resume                                                            *
@@ -4016,6 +4215,8 @@ int sdhci_add_host(struct sdhci_host *host)
 		sdhci_tasklet_card, (unsigned long)host);
 	tasklet_init(&host->finish_tasklet,
 		sdhci_tasklet_finish, (unsigned long)host);
+	/* stays disabled until sdhci_set_iopoll() */
+	blk_iopoll_init(&host->iop, SDHCI_IOPOLL_WEIGHT, sdhci_iopoll);
 
 	setup_timer(&host->timer, sdhci_timeout_timer, (unsigned long)host);
 
@@ -4094,6 +4295,16 @@ int sdhci_add_host(struct sdhci_host *host)
 	}
 	if (caps[0] & SDHCI_ASYNC_INTR)
 		host->async_int_supp = true;
+
+	if (host->cq_host) {
+		ret = sdhci_cmdq_init(host, mmc);
+		if (ret) {
+			pr_err("%s: CMDQ init failed %d, not using it\n",
+				mmc_hostname(mmc), ret);
+			mmc->caps2 &= ~MMC_CAP2_CMD_QUEUE;
+		}
+	}
+
 	mmc_add_host(mmc);
 
 	if (host->quirks2 & SDHCI_QUIRK2_IGN_DATA_END_BIT_ERROR)
@@ -4172,6 +4383,7 @@ void sdhci_remove_host(struct sdhci_host *host, int dead)
 
 	del_timer_sync(&host->timer);
 
+	sdhci_set_iopoll(host, false);
 	tasklet_kill(&host->card_tasklet);
 	tasklet_kill(&host->finish_tasklet);
 
@@ -14,16 +14,54 @@
 #include <linux/err.h>
 #include <linux/wcnss_wlan.h>
 #include <linux/spinlock.h>
+#include <linux/hashtable.h>
+#include <linux/skbuff.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#define WCNSS_PREALLOC_MAX_CLASSES	8
+#define WCNSS_PREALLOC_HASH_BITS	6
+
+/* pre-built RX skbs, refilled from process context below the watermark */
+#define WCNSS_PRE_SKB_SIZE		(4 * 1024)
+#define WCNSS_PRE_SKB_COUNT		64
+#define WCNSS_PRE_SKB_LOW_WM		(WCNSS_PRE_SKB_COUNT / 2)
 
 static DEFINE_SPINLOCK(alloc_lock);
 
+/* all the slots of one size; free slots sit on the free list */
+struct wcnss_prealloc_class {
+	unsigned int size;
+	unsigned int total;
+	unsigned int used;
+	unsigned int peak;
+	struct list_head free;
+};
+
 struct wcnss_prealloc {
 	int occupied;
 	unsigned int size;
 	void *ptr;
+	struct wcnss_prealloc_class *class;
+	struct list_head list;
+	struct hlist_node node;
 };
 
-/* pre-alloced mem for WLAN driver */
+static struct wcnss_prealloc_class wcnss_classes[WCNSS_PREALLOC_MAX_CLASSES];
+static int wcnss_num_classes;
+static unsigned long wcnss_alloc_fail;
+
+/* slot lookup by pointer for wcnss_prealloc_put() */
+static DEFINE_HASHTABLE(wcnss_prealloc_hash, WCNSS_PREALLOC_HASH_BITS);
+
+static struct sk_buff_head wcnss_skb_pool;
+static struct work_struct wcnss_skb_refill_work;
+static unsigned long wcnss_skb_fail;
+
+static struct dentry *wcnss_prealloc_dent;
+
+/* pre-alloced mem for WLAN driver, sorted by size */
 static struct wcnss_prealloc wcnss_allocs[] = {
 	{0, 8  * 1024, NULL},
 	{0, 8  * 1024, NULL},
@@ -90,8 +128,72 @@ static struct wcnss_prealloc wcnss_allocs[] = {
 	{0, 76 * 1024, NULL},
 };
 
+static struct wcnss_prealloc_class *wcnss_prealloc_class(unsigned int size)
+{
+	int i;
+
+	for (i = 0; i < wcnss_num_classes; i++)
+		if (wcnss_classes[i].size == size)
+			return &wcnss_classes[i];
+
+	if (wcnss_num_classes == WCNSS_PREALLOC_MAX_CLASSES)
+		return NULL;
+
+	wcnss_classes[i].size = size;
+	INIT_LIST_HEAD(&wcnss_classes[i].free);
+	wcnss_num_classes++;
+
+	return &wcnss_classes[i];
+}
+
+static void wcnss_skb_refill(struct work_struct *work)
+{
+	struct sk_buff *skb;
+
+	while (skb_queue_len(&wcnss_skb_pool) < WCNSS_PRE_SKB_COUNT) {
+		skb = __dev_alloc_skb(WCNSS_PRE_SKB_SIZE, GFP_KERNEL);
+		if (!skb)
+			break;
+		skb_queue_tail(&wcnss_skb_pool, skb);
+	}
+}
+
+static int wcnss_prealloc_show(struct seq_file *s, void *unused)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&alloc_lock, flags);
+	seq_puts(s, "size     total  used  peak\n");
+	for (i = 0; i < wcnss_num_classes; i++)
+		seq_printf(s, "%-8u %5u %5u %5u\n", wcnss_classes[i].size,
+			   wcnss_classes[i].total, wcnss_classes[i].used,
+			   wcnss_classes[i].peak);
+	seq_printf(s, "alloc failures: %lu\n", wcnss_alloc_fail);
+	spin_unlock_irqrestore(&alloc_lock, flags);
+
+	seq_printf(s, "rx skbs: %u/%u, empty pool: %lu\n",
+		   skb_queue_len(&wcnss_skb_pool), WCNSS_PRE_SKB_COUNT,
+		   wcnss_skb_fail);
+
+	return 0;
+}
+
+static int wcnss_prealloc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wcnss_prealloc_show, inode->i_private);
+}
+
+static const struct file_operations wcnss_prealloc_fops = {
+	.open = wcnss_prealloc_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 int wcnss_prealloc_init(void)
 {
+	struct wcnss_prealloc_class *class;
 	int i;
 
 	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
@@ -99,8 +201,25 @@ int wcnss_prealloc_init(void)
 		wcnss_allocs[i].ptr = kmalloc(wcnss_allocs[i].size, GFP_KERNEL);
 		if (wcnss_allocs[i].ptr == NULL)
 			return -ENOMEM;
+
+		class = wcnss_prealloc_class(wcnss_allocs[i].size);
+		if (WARN_ON(class == NULL))
+			return -EINVAL;
+		wcnss_allocs[i].class = class;
+		list_add_tail(&wcnss_allocs[i].list, &class->free);
+		class->total++;
+		hash_add(wcnss_prealloc_hash, &wcnss_allocs[i].node,
+			 (unsigned long)wcnss_allocs[i].ptr);
 	}
 
+	skb_queue_head_init(&wcnss_skb_pool);
+	INIT_WORK(&wcnss_skb_refill_work, wcnss_skb_refill);
+	wcnss_skb_refill(&wcnss_skb_refill_work);
+
+	wcnss_prealloc_dent = debugfs_create_file("wcnss_prealloc", S_IRUGO,
+						  NULL, NULL,
+						  &wcnss_prealloc_fops);
+
 	return 0;
 }
 
@@ -108,29 +227,43 @@ void wcnss_prealloc_deinit(void)
 {
 	int i = 0;
 
+	debugfs_remove(wcnss_prealloc_dent);
+	cancel_work_sync(&wcnss_skb_refill_work);
+	skb_queue_purge(&wcnss_skb_pool);
+
 	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
+		if (wcnss_allocs[i].ptr)
+			hash_del(&wcnss_allocs[i].node);
 		kfree(wcnss_allocs[i].ptr);
 		wcnss_allocs[i].ptr = NULL;
 	}
+	wcnss_num_classes = 0;
 }
 
 void *wcnss_prealloc_get(unsigned int size)
 {
+	struct wcnss_prealloc_class *class;
+	struct wcnss_prealloc *slot;
 	int i = 0;
 	unsigned long flags;
 
 	spin_lock_irqsave(&alloc_lock, flags);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (wcnss_allocs[i].occupied)
+	for (i = 0; i < wcnss_num_classes; i++) {
+		class = &wcnss_classes[i];
+		if (class->size <= size || list_empty(&class->free))
 			continue;
 
-		if (wcnss_allocs[i].size > size) {
-			/* we found the slot */
-			wcnss_allocs[i].occupied = 1;
-			spin_unlock_irqrestore(&alloc_lock, flags);
-			return wcnss_allocs[i].ptr;
-		}
+		/* we found the slot */
+		slot = list_first_entry(&class->free, struct wcnss_prealloc,
+					list);
+		list_del(&slot->list);
+		slot->occupied = 1;
+		if (++class->used > class->peak)
+			class->peak = class->used;
+		spin_unlock_irqrestore(&alloc_lock, flags);
+		return slot->ptr;
 	}
+	wcnss_alloc_fail++;
 	spin_unlock_irqrestore(&alloc_lock, flags);
 	pr_err("wcnss: %s: prealloc not available for size: %d\n",
 			__func__, size);
@@ -141,16 +274,22 @@ EXPORT_SYMBOL(wcnss_prealloc_get);
 
 int wcnss_prealloc_put(void *ptr)
 {
-	int i = 0;
+	struct wcnss_prealloc *slot;
 	unsigned long flags;
 
 	spin_lock_irqsave(&alloc_lock, flags);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (wcnss_allocs[i].ptr == ptr) {
-			wcnss_allocs[i].occupied = 0;
-			spin_unlock_irqrestore(&alloc_lock, flags);
-			return 1;
+	hash_for_each_possible(wcnss_prealloc_hash, slot, node,
+			       (unsigned long)ptr) {
+		if (slot->ptr != ptr)
+			continue;
+
+		if (slot->occupied) {
+			slot->occupied = 0;
+			slot->class->used--;
+			list_add(&slot->list, &slot->class->free);
 		}
+		spin_unlock_irqrestore(&alloc_lock, flags);
+		return 1;
 	}
 	spin_unlock_irqrestore(&alloc_lock, flags);
 
@@ -158,6 +297,33 @@ int wcnss_prealloc_put(void *ptr)
 }
 EXPORT_SYMBOL(wcnss_prealloc_put);
 
+/**
+ * wcnss_skb_prealloc_get() - take a pre-built RX skb
+ * @size: buffer size the caller needs
+ *
+ * Safe from any context.  The skb is owned by the caller and is freed
+ * the usual way; the pool is topped up again from a work item.
+ *
+ * Return: skb with WCNSS_PRE_SKB_SIZE of room, or NULL if @size does not
+ * fit or the pool is empty.
+ */
+struct sk_buff *wcnss_skb_prealloc_get(unsigned int size)
+{
+	struct sk_buff *skb = NULL;
+
+	if (size <= WCNSS_PRE_SKB_SIZE)
+		skb = skb_dequeue(&wcnss_skb_pool);
+
+	if (skb_queue_len(&wcnss_skb_pool) < WCNSS_PRE_SKB_LOW_WM)
+		schedule_work(&wcnss_skb_refill_work);
+
+	if (!skb)
+		wcnss_skb_fail++;
+
+	return skb;
+}
+EXPORT_SYMBOL(wcnss_skb_prealloc_get);
+
 static int __init wcnss_pre_alloc_init(void)
 {
 	return wcnss_prealloc_init();
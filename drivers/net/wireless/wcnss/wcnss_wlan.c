@@ -37,6 +37,7 @@
 #include <linux/qpnp/qpnp-adc.h>
 #include <linux/pinctrl/consumer.h>
 #include <linux/pm_qos.h>
+#include <linux/skbuff.h>
 
 #include <soc/qcom/subsystem_restart.h>
 #include <soc/qcom/subsystem_notif.h>
@@ -1974,24 +1975,27 @@ static void wcnss_update_vbatt(struct work_struct *work)
 }
 
 
-static unsigned char wcnss_fw_status(void)
+/* Copy @len bytes from the head of a received message, NULL discards */
+static int wcnss_rx_pull(struct sk_buff *skb, void *data, int len)
 {
-	int len = 0;
-	int rc = 0;
+	if (len > skb->len)
+		len = skb->len;
+	if (data)
+		memcpy(data, skb->data, len);
+	skb_pull(skb, len);
+	return len;
+}
 
+static unsigned char wcnss_fw_status(struct sk_buff *skb)
+{
 	unsigned char fw_status = 0xFF;
 
-	len = smd_read_avail(penv->smd_ch);
-	if (len < 1) {
+	if (skb->len < 1) {
 		pr_err("%s: invalid firmware status", __func__);
 		return fw_status;
 	}
 
-	rc = smd_read(penv->smd_ch, &fw_status, 1);
-	if (rc < 0) {
-		pr_err("%s: incomplete data read from smd\n", __func__);
-		return fw_status;
-	}
+	wcnss_rx_pull(skb, &fw_status, 1);
 	return fw_status;
 }
 
@@ -2020,7 +2024,7 @@ static void wcnss_send_cal_rsp(unsigned char fw_status)
 }
 
 /* Collect calibrated data from WCNSS */
-void extract_cal_data(int len)
+static void extract_cal_data(struct sk_buff *skb, int len)
 {
 	int rc;
 	struct cal_data_params calhdr;
@@ -2032,7 +2036,7 @@ void extract_cal_data(int len)
 	}
 
 	mutex_lock(&penv->dev_lock);
-	rc = smd_read(penv->smd_ch, (unsigned char *)&calhdr,
+	rc = wcnss_rx_pull(skb, (unsigned char *)&calhdr,
 			sizeof(struct cal_data_params));
 	if (rc < sizeof(struct cal_data_params)) {
 		pr_err("wcnss: incomplete cal header read from smd\n");
@@ -2052,7 +2056,7 @@ void extract_cal_data(int len)
 
 	if (penv->fw_cal_available) {
 		/* ignore cal upload from SSR */
-		smd_read(penv->smd_ch, NULL, calhdr.frag_size);
+		wcnss_rx_pull(skb, NULL, calhdr.frag_size);
 		penv->fw_cal_exp_frag++;
 		if (calhdr.msg_flags & LAST_FRAGMENT) {
 			penv->fw_cal_exp_frag = 0;
@@ -2073,7 +2077,7 @@ void extract_cal_data(int len)
 		penv->fw_cal_data = kmalloc(calhdr.total_size,
 				GFP_KERNEL);
 		if (penv->fw_cal_data == NULL) {
-			smd_read(penv->smd_ch, NULL, calhdr.frag_size);
+			wcnss_rx_pull(skb, NULL, calhdr.frag_size);
 			goto unlock_exit;
 		}
 	}
@@ -2084,11 +2088,11 @@ void extract_cal_data(int len)
 				penv->fw_cal_rcvd + calhdr.frag_size);
 		penv->fw_cal_exp_frag = 0;
 		penv->fw_cal_rcvd = 0;
-		smd_read(penv->smd_ch, NULL, calhdr.frag_size);
+		wcnss_rx_pull(skb, NULL, calhdr.frag_size);
 		goto unlock_exit;
 	}
 
-	rc = smd_read(penv->smd_ch, penv->fw_cal_data + penv->fw_cal_rcvd,
+	rc = wcnss_rx_pull(skb, penv->fw_cal_data + penv->fw_cal_rcvd,
 			calhdr.frag_size);
 	if (rc < calhdr.frag_size)
 		goto unlock_exit;
@@ -2117,7 +2121,7 @@ unlock_exit:
 }
 
 
-static void wcnssctrl_rx_handler(struct work_struct *worker)
+static void wcnssctrl_rx_msg(struct sk_buff *skb)
 {
 	int len = 0;
 	int rc = 0;
@@ -2129,18 +2133,13 @@ static void wcnssctrl_rx_handler(struct work_struct *worker)
 	int hw_type;
 	unsigned char fw_status = 0;
 
-	len = smd_read_avail(penv->smd_ch);
-	if (len > WCNSS_MAX_FRAME_SIZE) {
-		pr_err("wcnss: frame larger than the allowed size\n");
-		smd_read(penv->smd_ch, NULL, len);
-		return;
-	}
+	len = skb->len;
 	if (len < sizeof(struct smd_msg_hdr)) {
 		pr_err("wcnss: incomplete header available len = %d\n", len);
 		return;
 	}
 
-	rc = smd_read(penv->smd_ch, buf, sizeof(struct smd_msg_hdr));
+	rc = wcnss_rx_pull(skb, buf, sizeof(struct smd_msg_hdr));
 	if (rc < sizeof(struct smd_msg_hdr)) {
 		pr_err("wcnss: incomplete header read from smd\n");
 		return;
@@ -2158,7 +2157,7 @@ static void wcnssctrl_rx_handler(struct work_struct *worker)
 					len);
 			return;
 		}
-		rc = smd_read(penv->smd_ch, buf+sizeof(struct smd_msg_hdr),
+		rc = wcnss_rx_pull(skb, buf+sizeof(struct smd_msg_hdr),
 				len);
 		if (rc < len) {
 			pr_err("wcnss: incomplete data read from smd\n");
@@ -2209,7 +2208,7 @@ static void wcnssctrl_rx_handler(struct work_struct *worker)
 					len);
 			return;
 		}
-		rc = smd_read(penv->smd_ch, build, len);
+		rc = wcnss_rx_pull(skb, build, len);
 		if (rc < len) {
 			pr_err("wcnss: incomplete data read from smd\n");
 			return;
@@ -2220,7 +2219,7 @@ static void wcnssctrl_rx_handler(struct work_struct *worker)
 
 	case WCNSS_NVBIN_DNLD_RSP:
 		penv->nv_downloaded = true;
-		fw_status = wcnss_fw_status();
+		fw_status = wcnss_fw_status(skb);
 		pr_debug("wcnss: received WCNSS_NVBIN_DNLD_RSP from ccpu %u\n",
 			fw_status);
 		if (fw_status != WAIT_FOR_CBC_IND)
@@ -2230,7 +2229,7 @@ static void wcnssctrl_rx_handler(struct work_struct *worker)
 
 	case WCNSS_CALDATA_DNLD_RSP:
 		penv->nv_downloaded = true;
-		fw_status = wcnss_fw_status();
+		fw_status = wcnss_fw_status(skb);
 		pr_debug("wcnss: received WCNSS_CALDATA_DNLD_RSP from ccpu %u\n",
 			fw_status);
 		break;
@@ -2240,7 +2239,7 @@ static void wcnssctrl_rx_handler(struct work_struct *worker)
 		break;
 
 	case WCNSS_CALDATA_UPLD_REQ:
-		extract_cal_data(len);
+		extract_cal_data(skb, len);
 		break;
 
 	default:
@@ -2249,6 +2248,48 @@ static void wcnssctrl_rx_handler(struct work_struct *worker)
 	return;
 }
 
+/* Called by smd_read_packets() with the SMD lock held */
+static void *wcnssctrl_rx_buf(void *priv, int len)
+{
+	struct sk_buff_head *q = priv;
+	struct sk_buff *skb;
+
+	if (len > WCNSS_MAX_FRAME_SIZE) {
+		pr_err("wcnss: frame larger than the allowed size\n");
+		return NULL;
+	}
+
+	skb = alloc_skb(len, GFP_ATOMIC);
+	if (!skb) {
+		pr_err("wcnss: failed to allocate rx buffer\n");
+		return NULL;
+	}
+
+	__skb_queue_tail(q, skb);
+	return skb_put(skb, len);
+}
+
+/*
+ * Drain every complete control message in one SMD lock hold, then handle
+ * them one by one. Data events raised while we run reschedule this work.
+ */
+static void wcnssctrl_rx_handler(struct work_struct *worker)
+{
+	struct sk_buff_head q;
+	struct sk_buff *skb;
+	int rc;
+
+	__skb_queue_head_init(&q);
+	rc = smd_read_packets(penv->smd_ch, wcnssctrl_rx_buf, &q, 0);
+	if (rc < 0)
+		pr_err("wcnss: failed to read from smd %d\n", rc);
+
+	while ((skb = __skb_dequeue(&q))) {
+		wcnssctrl_rx_msg(skb);
+		kfree_skb(skb);
+	}
+}
+
 static void wcnss_send_version_req(struct work_struct *worker)
 {
 	struct smd_msg_hdr smd_msg;
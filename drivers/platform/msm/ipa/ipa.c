@@ -2667,6 +2667,35 @@ bail:
 	return res;
 }
 
+/**
+* ipa_dec_client_disable_clks_no_block() - Only decrement the number of active
+* clients if this is not the last vote. Gating the clocks is an asynchronous
+* action which needs to lock a mutex.
+*
+* Return codes: 0 for success
+*		-EPERM if an asynchronous action should have been done
+*/
+int ipa_dec_client_disable_clks_no_block(void)
+{
+	int res = 0;
+	unsigned long flags;
+
+	if (ipa_active_clients_trylock(&flags) == 0)
+		return -EPERM;
+
+	if (ipa_ctx->ipa_active_clients.cnt <= 1) {
+		res = -EPERM;
+		goto bail;
+	}
+
+	ipa_ctx->ipa_active_clients.cnt--;
+	IPADBG("active clients = %d\n", ipa_ctx->ipa_active_clients.cnt);
+bail:
+	ipa_active_clients_trylock_unlock(&flags);
+
+	return res;
+}
+
 /**
  * ipa_dec_client_disable_clks() - Decrease active clients counter
  *
@@ -97,6 +97,8 @@ static struct dentry *dfile_dbg_cnt;
 static struct dentry *dfile_msg;
 static struct dentry *dfile_ip4_nat;
 static struct dentry *dfile_rm_stats;
+static struct dentry *dfile_rm_it_stats;
+static struct dentry *dfile_dp_lat;
 static char dbg_buff[IPA_MAX_MSG_LEN];
 static s8 ep_reg_idx;
 
@@ -899,7 +901,9 @@ static ssize_t ipa_read_stats(struct file *file, char __user *ubuf,
 			"wan_rx_empty=%u\n"
 			"wan_repl_rx_empty=%u\n"
 			"lan_rx_empty=%u\n"
-			"lan_repl_rx_empty=%u\n",
+			"lan_repl_rx_empty=%u\n"
+			"rx_page_recycled=%u\n"
+			"rx_page_alloc=%u\n",
 			ipa_ctx->stats.tx_sw_pkts,
 			ipa_ctx->stats.tx_hw_pkts,
 			ipa_ctx->stats.tx_pkts_compl,
@@ -912,7 +916,9 @@ static ssize_t ipa_read_stats(struct file *file, char __user *ubuf,
 			ipa_ctx->stats.wan_rx_empty,
 			ipa_ctx->stats.wan_repl_rx_empty,
 			ipa_ctx->stats.lan_rx_empty,
-			ipa_ctx->stats.lan_repl_rx_empty);
+			ipa_ctx->stats.lan_repl_rx_empty,
+			ipa_ctx->stats.rx_page_recycled,
+			ipa_ctx->stats.rx_page_alloc);
 		cnt += nbytes;
 
 		for (i = 0; i < MAX_NUM_EXCP; i++) {
@@ -1475,6 +1481,61 @@ static ssize_t ipa_rm_read_stats(struct file *file, char __user *ubuf,
 	return simple_read_from_buffer(ubuf, count, ppos, dbg_buff, cnt);
 }
 
+static ssize_t ipa_rm_it_read_stats(struct file *file, char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	int result, cnt = 0;
+
+	result = ipa_rm_inactivity_timer_stat(dbg_buff, IPA_MAX_MSG_LEN);
+	if (result < 0)
+		cnt = scnprintf(dbg_buff, IPA_MAX_MSG_LEN,
+				"Error in printing RM timer stat %d\n", result);
+	else
+		cnt = result;
+	return simple_read_from_buffer(ubuf, count, ppos, dbg_buff, cnt);
+}
+
+/* "<resource> <0|1>" selects the fixed or adaptive release delay */
+static ssize_t ipa_rm_it_write_mode(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	unsigned long missing;
+	u32 resource, adaptive;
+
+	if (sizeof(dbg_buff) < count + 1)
+		return -EFAULT;
+
+	missing = copy_from_user(dbg_buff, buf, count);
+	if (missing)
+		return -EFAULT;
+
+	dbg_buff[count] = '\0';
+	if (sscanf(dbg_buff, "%u %u", &resource, &adaptive) != 2)
+		return -EFAULT;
+
+	if (ipa_rm_inactivity_timer_set_adaptive(resource, adaptive))
+		return -EINVAL;
+
+	return count;
+}
+
+static ssize_t ipa_read_dp_lat(struct file *file, char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	int cnt;
+
+	cnt = ipa_dp_lat_stat(dbg_buff, IPA_MAX_MSG_LEN);
+	return simple_read_from_buffer(ubuf, count, ppos, dbg_buff, cnt);
+}
+
+/* any write clears the histograms */
+static ssize_t ipa_write_dp_lat(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	ipa_dp_lat_reset();
+	return count;
+}
+
 const struct file_operations ipa_gen_reg_ops = {
 	.read = ipa_read_gen_reg,
 };
@@ -1540,6 +1601,16 @@ const struct file_operations ipa_rm_stats = {
 	.read = ipa_rm_read_stats,
 };
 
+const struct file_operations ipa_rm_it_stats = {
+	.read = ipa_rm_it_read_stats,
+	.write = ipa_rm_it_write_mode,
+};
+
+const struct file_operations ipa_dp_lat_ops = {
+	.read = ipa_read_dp_lat,
+	.write = ipa_write_dp_lat,
+};
+
 void ipa_debugfs_init(void)
 {
 	const mode_t read_only_mode = S_IRUSR | S_IRGRP | S_IROTH;
@@ -1681,6 +1752,13 @@ void ipa_debugfs_init(void)
 		goto fail;
 	}
 
+	dfile_rm_it_stats = debugfs_create_file("rm_it_stats",
+			read_write_mode, dent, 0, &ipa_rm_it_stats);
+	if (!dfile_rm_it_stats || IS_ERR(dfile_rm_it_stats)) {
+		IPAERR("fail to create file for debug_fs rm_it_stats\n");
+		goto fail;
+	}
+
 	file = debugfs_create_u32("enable_clock_scaling", read_write_mode,
 		dent, &ipa_ctx->enable_clock_scaling);
 	if (!file) {
@@ -1696,6 +1774,20 @@ void ipa_debugfs_init(void)
 		goto fail;
 	}
 
+	file = debugfs_create_u32("dp_lat_sample_rate", read_write_mode,
+		dent, &ipa_ctx->dp_lat_sample_rate);
+	if (!file) {
+		IPAERR("could not create dp_lat_sample_rate file\n");
+		goto fail;
+	}
+
+	dfile_dp_lat = debugfs_create_file("dp_lat", read_write_mode, dent, 0,
+			&ipa_dp_lat_ops);
+	if (!dfile_dp_lat || IS_ERR(dfile_dp_lat)) {
+		IPAERR("fail to create file for debug_fs dp_lat\n");
+		goto fail;
+	}
+
 	return;
 
 fail:
@@ -44,6 +44,22 @@
 #define IPA_ODU_RX_POOL_SZ 32
 #define IPA_SIZE_DL_CSUM_META_TRAILER 8
 
+/*
+ * Rx page pool: one page holds a full generic aggregation buffer together
+ * with the skb headroom and skb_shared_info, the same footprint a kmalloced
+ * skb head of IPA_LAN_RX_BUFF_SZ already has
+ */
+#define IPA_RX_PAGE_ORDER get_order(NET_SKB_PAD + IPA_LAN_RX_BUFF_SZ + \
+		SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+#define IPA_RX_PAGE_SZ (PAGE_SIZE << IPA_RX_PAGE_ORDER)
+#define IPA_RX_PAGE_BUFF_SZ (IPA_RX_PAGE_SZ - NET_SKB_PAD - \
+		SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+/* HW ring plus replenish cache must fit the pool with room to spare */
+#define IPA_RX_PAGE_POOL_FACTOR 3
+
+/* Rx buffers posted per BAM doorbell by the fast replenish path */
+#define IPA_REPL_BATCH_MAX 16
+
 static struct sk_buff *ipa_get_skb_ipa_rx(unsigned int len, gfp_t flags);
 static void ipa_replenish_wlan_rx_cache(struct ipa_sys_context *sys);
 static void ipa_replenish_rx_cache(struct ipa_sys_context *sys);
@@ -60,6 +76,13 @@ static void ipa_wq_rx_avail(struct work_struct *work);
 static void ipa_alloc_wlan_rx_common_cache(u32 size);
 static void ipa_cleanup_wlan_rx_common_cache(void);
 static void ipa_wq_repl_rx(struct work_struct *work);
+static void ipa_wq_napi_clk_rel(struct work_struct *work);
+static int ipa_rx_pkt_alloc_buff(struct ipa_sys_context *sys,
+		struct ipa_rx_pkt_wrapper *rx_pkt, gfp_t flag);
+static void ipa_rx_pkt_free_buff(struct ipa_sys_context *sys,
+		struct ipa_rx_pkt_wrapper *rx_pkt);
+static void ipa_rx_page_pool_init(struct ipa_sys_context *sys);
+static void ipa_rx_page_pool_destroy(struct ipa_sys_context *sys);
 
 static void ipa_wq_write_done_common(struct ipa_sys_context *sys, u32 cnt)
 {
@@ -738,6 +761,91 @@ static void ipa_sps_irq_tx_no_aggr_notify(struct sps_event_notify *notify)
 	}
 }
 
+static inline void ipa_dp_lat_account(struct ipa_sys_context *sys,
+		enum ipa_dp_lat_stage stage, s64 ns)
+{
+	u32 bucket = ns > 0 ? fls((u32)min_t(s64, ns / NSEC_PER_USEC,
+				U32_MAX)) : 0;
+
+	sys->lat.hist[stage][min_t(u32, bucket, IPA_DP_LAT_BUCKETS - 1)]++;
+}
+
+/* Called from the EOT interrupt, starts timing the scheduling delay */
+static inline void ipa_dp_lat_irq(struct ipa_sys_context *sys)
+{
+	if (unlikely(ipa_ctx->dp_lat_sample_rate) && !sys->lat.irq_ts.tv64)
+		sys->lat.irq_ts = ktime_get();
+}
+
+/* Called before the first buffer of a poll cycle is handled */
+static inline void ipa_dp_lat_sched(struct ipa_sys_context *sys)
+{
+	if (likely(!sys->lat.irq_ts.tv64))
+		return;
+
+	ipa_dp_lat_account(sys, IPA_DP_LAT_SCHED,
+		ktime_to_ns(ktime_sub(ktime_get(), sys->lat.irq_ts)));
+	sys->lat.irq_ts.tv64 = 0;
+}
+
+/**
+ * ipa_dp_lat_stat() - print the sampled Rx latency histograms of all pipes
+ * @buf: output buffer
+ * @size: size of @buf
+ *
+ * Returns: number of characters written to @buf
+ */
+int ipa_dp_lat_stat(char *buf, int size)
+{
+	static const char * const stage_name[IPA_DP_LAT_STAGE_MAX] = {
+		[IPA_DP_LAT_SCHED] = "sched",
+		[IPA_DP_LAT_DELIVER] = "deliver",
+		[IPA_DP_LAT_REPL] = "repl",
+	};
+	struct ipa_dp_lat *lat;
+	int cnt = 0;
+	int i, j, k;
+
+	cnt += scnprintf(buf + cnt, size - cnt,
+		"sample_rate=%u (bucket n: < 2^n usec)\n",
+		ipa_ctx->dp_lat_sample_rate);
+	for (i = 0; i < IPA_NUM_PIPES; i++) {
+		if (!ipa_ctx->ep[i].valid || !ipa_ctx->ep[i].sys ||
+			!IPA_CLIENT_IS_CONS(ipa_ctx->ep[i].client))
+			continue;
+
+		lat = &ipa_ctx->ep[i].sys->lat;
+		cnt += scnprintf(buf + cnt, size - cnt,
+			"ep %d client %d: samples=%u pkts=%llu ns_per_pkt=%llu\n",
+			i, ipa_ctx->ep[i].client, lat->samples, lat->pkts,
+			lat->pkts ? div64_u64(lat->deliver_ns, lat->pkts) : 0);
+		for (j = 0; j < IPA_DP_LAT_STAGE_MAX; j++) {
+			cnt += scnprintf(buf + cnt, size - cnt, "  %-8s",
+				stage_name[j]);
+			for (k = 0; k < IPA_DP_LAT_BUCKETS; k++)
+				cnt += scnprintf(buf + cnt, size - cnt, " %u",
+					lat->hist[j][k]);
+			cnt += scnprintf(buf + cnt, size - cnt, "\n");
+		}
+	}
+
+	return cnt;
+}
+
+/**
+ * ipa_dp_lat_reset() - clear the sampled Rx latency of all pipes
+ */
+void ipa_dp_lat_reset(void)
+{
+	int i;
+
+	for (i = 0; i < IPA_NUM_PIPES; i++) {
+		if (ipa_ctx->ep[i].valid && ipa_ctx->ep[i].sys)
+			memset(&ipa_ctx->ep[i].sys->lat, 0,
+				sizeof(struct ipa_dp_lat));
+	}
+}
+
 /**
  * ipa_handle_rx_core() - The core functionality of packet reception. This
  * function is read from multiple code paths.
@@ -773,6 +881,9 @@ static int ipa_handle_rx_core(struct ipa_sys_context *sys, bool process_all,
 		if (iov.addr == 0)
 			break;
 
+		if (!cnt)
+			ipa_dp_lat_sched(sys);
+
 		if (IPA_CLIENT_IS_WLAN_CONS(sys->ep->client))
 			ipa_wlan_wq_rx_common(sys, iov.size);
 		else
@@ -823,6 +934,155 @@ fail:
 			msecs_to_jiffies(1));
 }
 
+/**
+ * ipa_rx_napi_start_poll() - Move a NAPI enabled Rx pipe to polling mode and
+ * hand it over to the client NAPI context
+ * @sys:	system pipe context
+ *
+ * Can be called from interrupt context. Only the caller which moves the pipe
+ * out of interrupt mode schedules the client, so a racing EOT interrupt and
+ * the drain check in ipa_rx_napi_switch_to_intr_mode() cannot both do it.
+ * The active clients vote taken here is dropped when the pipe goes back to
+ * interrupt mode.
+ */
+static void ipa_rx_napi_start_poll(struct ipa_sys_context *sys)
+{
+	int ret;
+
+	if (atomic_cmpxchg(&sys->curr_polling_state, 0, 1))
+		return;
+
+	ret = sps_get_config(sys->ep->ep_hdl, &sys->ep->connect);
+	if (ret) {
+		IPAERR("sps_get_config() failed %d\n", ret);
+		goto fail;
+	}
+	sys->ep->connect.options = SPS_O_AUTO_ENABLE |
+		SPS_O_ACK_TRANSFERS | SPS_O_POLL;
+	ret = sps_set_config(sys->ep->ep_hdl, &sys->ep->connect);
+	if (ret) {
+		IPAERR("sps_set_config() failed %d\n", ret);
+		goto fail;
+	}
+
+	if (ipa_inc_client_enable_clks_no_block()) {
+		/* clocks need a blocking vote, let the pipe wq take it */
+		queue_work(sys->wq, &sys->work);
+		return;
+	}
+
+	sys->ep->client_notify(sys->ep->priv, IPA_CLIENT_START_POLL, 0);
+	return;
+
+fail:
+	atomic_set(&sys->curr_polling_state, 0);
+}
+
+/**
+ * ipa_rx_napi_switch_to_intr_mode() - Return a NAPI enabled Rx pipe to
+ * interrupt mode once the client NAPI context ran out of packets
+ * @sys:	system pipe context
+ *
+ * Called from the client NAPI context. Packets which completed while the EOT
+ * interrupt was masked do not raise a new one, so the pipe is checked again
+ * after the switch and polling is restarted if it is not empty.
+ */
+static void ipa_rx_napi_switch_to_intr_mode(struct ipa_sys_context *sys)
+{
+	u32 empty = 1;
+	int ret;
+
+	sys->ep->client_notify(sys->ep->priv, IPA_CLIENT_COMP_NAPI, 0);
+
+	ret = sps_get_config(sys->ep->ep_hdl, &sys->ep->connect);
+	if (ret) {
+		IPAERR("sps_get_config() failed %d\n", ret);
+		goto fail;
+	}
+	sys->event.options = SPS_O_EOT;
+	ret = sps_register_event(sys->ep->ep_hdl, &sys->event);
+	if (ret) {
+		IPAERR("sps_register_event() failed %d\n", ret);
+		goto fail;
+	}
+	sys->ep->connect.options =
+		SPS_O_AUTO_ENABLE | SPS_O_ACK_TRANSFERS | SPS_O_EOT;
+	ret = sps_set_config(sys->ep->ep_hdl, &sys->ep->connect);
+	if (ret) {
+		IPAERR("sps_set_config() failed %d\n", ret);
+		goto fail;
+	}
+	atomic_set(&sys->curr_polling_state, 0);
+
+	if (ipa_dec_client_disable_clks_no_block())
+		queue_work(sys->wq, &sys->napi_clk_rel_work);
+
+	ret = sps_is_pipe_empty(sys->ep->ep_hdl, &empty);
+	if (ret || !empty)
+		ipa_rx_napi_start_poll(sys);
+	return;
+
+fail:
+	/* still in polling mode, let the client poll and retry */
+	sys->ep->client_notify(sys->ep->priv, IPA_CLIENT_START_POLL, 0);
+}
+
+/**
+ * ipa_rx_poll() - Pull packets from a NAPI enabled Rx pipe
+ * @clnt_hdl:	[in] opaque client handle assigned by IPA to client
+ * @budget:	[in] maximal number of packets to process
+ *
+ * Called by the client from its NAPI poll callback after it was notified
+ * with IPA_CLIENT_START_POLL. Packets are handed to the client notify
+ * callback in softirq context. When fewer than @budget packets were found the
+ * client is notified with IPA_CLIENT_COMP_NAPI and the pipe is moved back to
+ * interrupt mode.
+ *
+ * Returns:	number of packets processed, negative on failure in which case
+ * the client should complete its NAPI context on its own
+ */
+int ipa_rx_poll(u32 clnt_hdl, int budget)
+{
+	struct ipa_ep_context *ep;
+	struct sps_iovec iov;
+	int cnt = 0;
+	int ret;
+
+	if (clnt_hdl >= IPA_NUM_PIPES || ipa_ctx->ep[clnt_hdl].valid == 0) {
+		IPAERR("bad parm 0x%x\n", clnt_hdl);
+		return -EINVAL;
+	}
+
+	ep = &ipa_ctx->ep[clnt_hdl];
+	if (unlikely(!ep->napi_enabled)) {
+		IPAERR("NAPI not enabled on ep %d\n", clnt_hdl);
+		return -EINVAL;
+	}
+
+	while (cnt < budget && atomic_read(&ep->sys->curr_polling_state)) {
+		ret = sps_get_iovec(ep->ep_hdl, &iov);
+		if (ret) {
+			IPAERR("sps_get_iovec failed %d\n", ret);
+			break;
+		}
+
+		if (iov.addr == 0)
+			break;
+
+		if (!cnt)
+			ipa_dp_lat_sched(ep->sys);
+
+		ipa_wq_rx_common(ep->sys, iov.size);
+		cnt++;
+	}
+
+	if (cnt < budget)
+		ipa_rx_napi_switch_to_intr_mode(ep->sys);
+
+	return cnt;
+}
+EXPORT_SYMBOL(ipa_rx_poll);
+
 /**
  * ipa_rx_notify() - Callback function which is called by the SPS driver when a
  * a packet is received
@@ -845,6 +1105,11 @@ static void ipa_sps_irq_rx_notify(struct sps_event_notify *notify)
 
 	switch (notify->event_id) {
 	case SPS_EVENT_EOT:
+		ipa_dp_lat_irq(sys);
+		if (sys->ep->napi_enabled) {
+			ipa_rx_napi_start_poll(sys);
+			break;
+		}
 		if (!atomic_read(&sys->curr_polling_state)) {
 			ret = sps_get_config(sys->ep->ep_hdl,
 					&sys->ep->connect);
@@ -916,6 +1181,11 @@ static void switch_to_intr_rx_work_func(struct work_struct *work)
 	ipa_handle_rx(sys);
 }
 
+static void ipa_wq_napi_clk_rel(struct work_struct *work)
+{
+	ipa_dec_client_disable_clks();
+}
+
 /**
  * ipa_setup_sys_pipe() - Setup an IPA end-point in system-BAM mode and perform
  * IPA EP configuration
@@ -1031,6 +1301,7 @@ int ipa_setup_sys_pipe(struct ipa_sys_connect_params *sys_in, u32 *clnt_hdl)
 	}
 
 	ep->skip_ep_cfg = sys_in->skip_ep_cfg;
+	ep->napi_enabled = sys_in->napi_enabled;
 	if (ipa_assign_policy(sys_in, ep->sys)) {
 		IPAERR("failed to sys ctx for client %d\n", sys_in->client);
 		result = -ENOMEM;
@@ -1132,6 +1403,10 @@ int ipa_setup_sys_pipe(struct ipa_sys_connect_params *sys_in, u32 *clnt_hdl)
 
 	*clnt_hdl = ipa_ep_idx;
 
+	if (sys_in->client == IPA_CLIENT_APPS_LAN_CONS ||
+	    sys_in->client == IPA_CLIENT_APPS_WAN_CONS)
+		ipa_rx_page_pool_init(ep->sys);
+
 	if (IPA_CLIENT_IS_CONS(sys_in->client))
 		ipa_replenish_rx_cache(ep->sys);
 
@@ -1228,13 +1503,20 @@ int ipa_teardown_sys_pipe(u32 clnt_hdl)
 	}
 
 	flush_workqueue(ep->sys->wq);
+	if (ep->napi_enabled && atomic_read(&ep->sys->curr_polling_state)) {
+		/* drop the vote held by the interrupted NAPI poll session */
+		atomic_set(&ep->sys->curr_polling_state, 0);
+		ipa_dec_client_disable_clks();
+	}
 	sps_disconnect(ep->ep_hdl);
 	dma_free_coherent(ipa_ctx->pdev, ep->connect.desc.size,
 			  ep->connect.desc.base,
 			  ep->connect.desc.phys_base);
 	sps_free_endpoint(ep->ep_hdl);
-	if (IPA_CLIENT_IS_CONS(ep->client))
+	if (IPA_CLIENT_IS_CONS(ep->client)) {
 		ipa_cleanup_rx(ep->sys);
+		ipa_rx_page_pool_destroy(ep->sys);
+	}
 
 	ipa_delete_dflt_flt_rules(clnt_hdl);
 
@@ -1416,17 +1698,100 @@ fail_gen:
 }
 EXPORT_SYMBOL(ipa_tx_dp);
 
+/**
+ * ipa_tx_dp_batch() - Data-path tx handler for a batch of packets
+ * @dst: [in] producer client the packets are sent on
+ * @skbs: [in] packets to send, in order
+ *
+ * This is the HW data path of ipa_tx_dp() for several packets at once. All
+ * packets are posted to the BAM pipe as a single transfer, so the pipe
+ * doorbell is rung once for the batch and one completion is generated for
+ * the last packet. Each skb is still released through the client callback
+ * (or freed by IPA) as with ipa_tx_dp().
+ *
+ * On success the skbs are owned by IPA and @skbs is empty. On failure @skbs
+ * is left untouched and the client needs to free the skbs as needed.
+ *
+ * Returns:	0 on success, negative on failure
+ */
+int ipa_tx_dp_batch(enum ipa_client_type dst, struct sk_buff_head *skbs)
+{
+	struct ipa_desc *desc;
+	struct ipa_sys_context *sys;
+	struct sk_buff *skb;
+	u32 num_desc;
+	int src_ep_idx;
+	int i;
+
+	num_desc = skb_queue_len(skbs);
+	if (num_desc == 0)
+		return 0;
+
+	if (IPA_CLIENT_IS_CONS(dst)) {
+		IPAERR("batch is supported on HW data path only\n");
+		return -EINVAL;
+	}
+
+	src_ep_idx = ipa_get_ep_mapping(dst);
+	if (src_ep_idx == -1) {
+		IPAERR("client %d does not exist\n", dst);
+		return -EINVAL;
+	}
+
+	sys = ipa_ctx->ep[src_ep_idx].sys;
+	if (!sys || !sys->ep->valid) {
+		IPAERR("pipe not valid\n");
+		return -EFAULT;
+	}
+
+	desc = kcalloc(num_desc, sizeof(struct ipa_desc), GFP_ATOMIC);
+	if (!desc) {
+		IPAERR("failed to alloc desc array\n");
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < num_desc; i++) {
+		skb = __skb_dequeue(skbs);
+		desc[i].pyld = skb->data;
+		desc[i].len = skb->len;
+		desc[i].type = IPA_DATA_DESC_SKB;
+		desc[i].callback = ipa_tx_comp_usr_notify_release;
+		desc[i].user1 = skb;
+		desc[i].user2 = src_ep_idx;
+	}
+
+	if (ipa_send(sys, num_desc, desc, true)) {
+		IPAERR("fail to send batch of %u skbs\n", num_desc);
+		for (i = 0; i < num_desc; i++)
+			__skb_queue_tail(skbs, desc[i].user1);
+		kfree(desc);
+		return -EFAULT;
+	}
+
+	ipa_ctx->stats.tx_hw_pkts += num_desc;
+	kfree(desc);
+
+	return 0;
+}
+EXPORT_SYMBOL(ipa_tx_dp_batch);
+
 static void ipa_wq_handle_rx(struct work_struct *work)
 {
 	struct ipa_sys_context *sys;
 	sys = container_of(work, struct ipa_sys_context, work);
-	ipa_handle_rx(sys);
+
+	if (sys->ep->napi_enabled) {
+		ipa_inc_client_enable_clks();
+		sys->ep->client_notify(sys->ep->priv,
+				IPA_CLIENT_START_POLL, 0);
+	} else {
+		ipa_handle_rx(sys);
+	}
 }
 
 static void ipa_wq_repl_rx(struct work_struct *work)
 {
 	struct ipa_sys_context *sys;
-	void *ptr;
 	struct ipa_rx_pkt_wrapper *rx_pkt;
 	gfp_t flag = GFP_NOWAIT | __GFP_NOWARN;
 	u32 next;
@@ -1452,21 +1817,8 @@ begin:
 		INIT_WORK(&rx_pkt->work, ipa_wq_rx_avail);
 		rx_pkt->sys = sys;
 
-		rx_pkt->data.skb = sys->get_skb(sys->rx_buff_sz, flag);
-		if (rx_pkt->data.skb == NULL) {
-			IPAERR("failed to alloc skb\n");
-			goto fail_skb_alloc;
-		}
-		ptr = skb_put(rx_pkt->data.skb, sys->rx_buff_sz);
-		rx_pkt->data.dma_addr = dma_map_single(ipa_ctx->pdev, ptr,
-						     sys->rx_buff_sz,
-						     DMA_FROM_DEVICE);
-		if (rx_pkt->data.dma_addr == 0 ||
-				rx_pkt->data.dma_addr == ~0) {
-			IPAERR("dma_map_single failure %p for %p\n",
-			       (void *)rx_pkt->data.dma_addr, ptr);
-			goto fail_dma_mapping;
-		}
+		if (ipa_rx_pkt_alloc_buff(sys, rx_pkt, flag))
+			goto fail_buff_alloc;
 
 		sys->repl.cache[curr] = rx_pkt;
 		curr = next;
@@ -1476,9 +1828,7 @@ begin:
 
 	return;
 
-fail_dma_mapping:
-	sys->free_skb(rx_pkt->data.skb);
-fail_skb_alloc:
+fail_buff_alloc:
 	kmem_cache_free(ipa_ctx->rx_pkt_wrapper_cache, rx_pkt);
 fail_kmem_cache_alloc:
 	if (atomic_read(&sys->repl.tail_idx) ==
@@ -1645,7 +1995,8 @@ fail_kmem_cache_alloc:
  *   - Allocate a buffer in the cache
  *   - Initialized the packets link
  *   - Initialize the packets work struct
- *   - Allocate the packets socket buffer (skb)
+ *   - Allocate the packets socket buffer (skb), from the page pool when the
+ *     pipe has one
  *   - Fill the packets skb with data
  *   - Make the packet DMAable
  *   - Add the packet to the system pipe linked list
@@ -1653,7 +2004,6 @@ fail_kmem_cache_alloc:
  */
 static void ipa_replenish_rx_cache(struct ipa_sys_context *sys)
 {
-	void *ptr;
 	struct ipa_rx_pkt_wrapper *rx_pkt;
 	int ret;
 	int rx_len_cached = 0;
@@ -1673,21 +2023,8 @@ static void ipa_replenish_rx_cache(struct ipa_sys_context *sys)
 		INIT_WORK(&rx_pkt->work, ipa_wq_rx_avail);
 		rx_pkt->sys = sys;
 
-		rx_pkt->data.skb = sys->get_skb(sys->rx_buff_sz, flag);
-		if (rx_pkt->data.skb == NULL) {
-			IPAERR("failed to alloc skb\n");
-			goto fail_skb_alloc;
-		}
-		ptr = skb_put(rx_pkt->data.skb, sys->rx_buff_sz);
-		rx_pkt->data.dma_addr = dma_map_single(ipa_ctx->pdev, ptr,
-						     sys->rx_buff_sz,
-						     DMA_FROM_DEVICE);
-		if (rx_pkt->data.dma_addr == 0 ||
-				rx_pkt->data.dma_addr == ~0) {
-			IPAERR("dma_map_single failure %p for %p\n",
-			       (void *)rx_pkt->data.dma_addr, ptr);
-			goto fail_dma_mapping;
-		}
+		if (ipa_rx_pkt_alloc_buff(sys, rx_pkt, flag))
+			goto fail_buff_alloc;
 
 		list_add_tail(&rx_pkt->link, &sys->head_desc_list);
 		rx_len_cached = ++sys->len;
@@ -1706,11 +2043,8 @@ static void ipa_replenish_rx_cache(struct ipa_sys_context *sys)
 fail_sps_transfer:
 	list_del(&rx_pkt->link);
 	rx_len_cached = --sys->len;
-	dma_unmap_single(ipa_ctx->pdev, rx_pkt->data.dma_addr,
-			sys->rx_buff_sz, DMA_FROM_DEVICE);
-fail_dma_mapping:
-	sys->free_skb(rx_pkt->data.skb);
-fail_skb_alloc:
+	ipa_rx_pkt_free_buff(sys, rx_pkt);
+fail_buff_alloc:
 	kmem_cache_free(ipa_ctx->rx_pkt_wrapper_cache, rx_pkt);
 fail_kmem_cache_alloc:
 	if (rx_len_cached == 0)
@@ -1721,30 +2055,51 @@ fail_kmem_cache_alloc:
 static void ipa_fast_replenish_rx_cache(struct ipa_sys_context *sys)
 {
 	struct ipa_rx_pkt_wrapper *rx_pkt;
+	struct sps_iovec iovec[IPA_REPL_BATCH_MAX];
+	void *user[IPA_REPL_BATCH_MAX];
 	int ret;
 	int rx_len_cached = 0;
 	u32 curr;
+	u32 next;
+	u32 cnt;
+	u32 i;
 
 	rx_len_cached = sys->len;
 	curr = atomic_read(&sys->repl.head_idx);
 
 	while (rx_len_cached < sys->rx_pool_sz) {
-		if (curr == atomic_read(&sys->repl.tail_idx))
+		/* post up to IPA_REPL_BATCH_MAX buffers behind one doorbell */
+		next = curr;
+		cnt = 0;
+		while (cnt < IPA_REPL_BATCH_MAX &&
+		       rx_len_cached + cnt < sys->rx_pool_sz &&
+		       next != atomic_read(&sys->repl.tail_idx)) {
+			rx_pkt = sys->repl.cache[next];
+			list_add_tail(&rx_pkt->link, &sys->head_desc_list);
+			iovec[cnt].addr = SPS_GET_LOWER_ADDR(
+					rx_pkt->data.dma_addr);
+			iovec[cnt].size = sys->rx_buff_sz;
+			iovec[cnt].flags = DESC_FLAG_WORD(0,
+					rx_pkt->data.dma_addr);
+			user[cnt] = rx_pkt;
+			cnt++;
+			next = (next + 1) % sys->repl.capacity;
+		}
+		if (!cnt)
 			break;
 
-		rx_pkt = sys->repl.cache[curr];
-		list_add_tail(&rx_pkt->link, &sys->head_desc_list);
-
-		ret = sps_transfer_one(sys->ep->ep_hdl,
-			rx_pkt->data.dma_addr, sys->rx_buff_sz, rx_pkt, 0);
-
+		ret = sps_transfer_batch(sys->ep->ep_hdl, iovec, user, cnt);
 		if (ret) {
-			IPAERR("sps_transfer_one failed %d\n", ret);
-			list_del(&rx_pkt->link);
+			IPAERR("sps_transfer_batch failed %d\n", ret);
+			for (i = 0; i < cnt; i++) {
+				rx_pkt = user[i];
+				list_del(&rx_pkt->link);
+			}
 			break;
 		}
-		rx_len_cached = ++sys->len;
-		curr = (curr + 1) % sys->repl.capacity;
+		sys->len += cnt;
+		rx_len_cached = sys->len;
+		curr = next;
 		mb();
 		atomic_set(&sys->repl.head_idx, curr);
 	}
@@ -1786,13 +2141,229 @@ static void ipa_cleanup_rx(struct ipa_sys_context *sys)
 	list_for_each_entry_safe(rx_pkt, r,
 				 &sys->head_desc_list, link) {
 		list_del(&rx_pkt->link);
-		dma_unmap_single(ipa_ctx->pdev, rx_pkt->data.dma_addr,
-			sys->rx_buff_sz, DMA_FROM_DEVICE);
-		sys->free_skb(rx_pkt->data.skb);
+		ipa_rx_pkt_free_buff(sys, rx_pkt);
 		kmem_cache_free(ipa_ctx->rx_pkt_wrapper_cache, rx_pkt);
 	}
 }
 
+/**
+ * ipa_rx_page_pool_init() - Set up the Rx page pool of a sys pipe
+ * @sys:	system pipe context
+ *
+ * Rx buffers of the pipe are carved out of DMA mapped pages which are handed
+ * back to the descriptor ring once the stack released every skb pointing at
+ * them. Failing to set up the pool is not fatal, the pipe then keeps
+ * allocating and mapping a new skb for every Rx buffer.
+ */
+static void ipa_rx_page_pool_init(struct ipa_sys_context *sys)
+{
+	struct ipa_rx_page_pool *pool = &sys->page_pool;
+	u32 capacity = sys->rx_pool_sz * IPA_RX_PAGE_POOL_FACTOR;
+
+	spin_lock_init(&pool->lock);
+	pool->next = 0;
+	pool->capacity = 0;
+	if (sys->rx_buff_sz > IPA_RX_PAGE_BUFF_SZ) {
+		IPAERR("Rx buffer %u does not fit a pool page\n",
+			sys->rx_buff_sz);
+		return;
+	}
+
+	pool->pages = kzalloc(capacity * sizeof(struct ipa_rx_page),
+			GFP_KERNEL);
+	if (!pool->pages) {
+		IPAERR("failed to alloc Rx page pool\n");
+		return;
+	}
+	pool->capacity = capacity;
+}
+
+/**
+ * ipa_rx_page_pool_destroy() - Release the Rx page pool of a sys pipe
+ * @sys:	system pipe context
+ *
+ * Pages which are still referenced by skbs in the stack are not unmapped as
+ * that would discard CPU writes to them, the pool reference is dropped and
+ * the last skb frees the page.
+ */
+static void ipa_rx_page_pool_destroy(struct ipa_sys_context *sys)
+{
+	struct ipa_rx_page_pool *pool = &sys->page_pool;
+	struct ipa_rx_page *slot;
+	u32 i;
+
+	if (!pool->capacity)
+		return;
+
+	for (i = 0; i < pool->capacity; i++) {
+		slot = &pool->pages[i];
+		if (!slot->page)
+			continue;
+		if (page_count(slot->page) == 1)
+			dma_unmap_page(ipa_ctx->pdev, slot->dma_addr,
+					IPA_RX_PAGE_SZ, DMA_FROM_DEVICE);
+		put_page(slot->page);
+	}
+
+	kfree(pool->pages);
+	pool->pages = NULL;
+	pool->capacity = 0;
+}
+
+/**
+ * ipa_rx_page_pool_get_skb() - Build an Rx skb on top of a pool page
+ * @sys:	system pipe context
+ * @rx_pkt:	Rx wrapper which receives the skb and its DMA address
+ * @flag:	allocation flags for a new pool page
+ *
+ * Slots are visited in ring order. An empty slot gets a new mapped page, a
+ * slot whose page is only referenced by the pool is recycled without any
+ * allocation or mapping. Slots whose page is owned by HW or still used by
+ * the stack are skipped.
+ *
+ * Returns:	the skb, NULL if no slot is available
+ */
+static struct sk_buff *ipa_rx_page_pool_get_skb(struct ipa_sys_context *sys,
+		struct ipa_rx_pkt_wrapper *rx_pkt, gfp_t flag)
+{
+	struct ipa_rx_page_pool *pool = &sys->page_pool;
+	struct ipa_rx_page *slot = NULL;
+	struct sk_buff *skb;
+	struct page *page;
+	u32 i;
+
+	spin_lock_bh(&pool->lock);
+	for (i = 0; i < pool->capacity; i++) {
+		slot = &pool->pages[pool->next];
+		pool->next = (pool->next + 1) % pool->capacity;
+		if (!slot->page ||
+		    (!slot->in_use && page_count(slot->page) == 1))
+			break;
+	}
+	if (i == pool->capacity)
+		goto fail;
+
+	if (slot->page) {
+		dma_sync_single_range_for_device(ipa_ctx->pdev,
+				slot->dma_addr, NET_SKB_PAD, sys->rx_buff_sz,
+				DMA_FROM_DEVICE);
+		IPA_STATS_INC_CNT(ipa_ctx->stats.rx_page_recycled);
+	} else {
+		page = alloc_pages(flag | __GFP_COMP, IPA_RX_PAGE_ORDER);
+		if (!page)
+			goto fail;
+		slot->dma_addr = dma_map_page(ipa_ctx->pdev, page, 0,
+				IPA_RX_PAGE_SZ, DMA_FROM_DEVICE);
+		if (dma_mapping_error(ipa_ctx->pdev, slot->dma_addr)) {
+			IPAERR("dma_map_page failure\n");
+			__free_pages(page, IPA_RX_PAGE_ORDER);
+			goto fail;
+		}
+		slot->page = page;
+		IPA_STATS_INC_CNT(ipa_ctx->stats.rx_page_alloc);
+	}
+
+	skb = build_skb(page_address(slot->page), IPA_RX_PAGE_SZ);
+	if (!skb)
+		goto fail;
+	/* the pool keeps its own reference, the skb owns the other one */
+	get_page(slot->page);
+	slot->in_use = true;
+	spin_unlock_bh(&pool->lock);
+
+	skb_reserve(skb, NET_SKB_PAD);
+	skb_put(skb, sys->rx_buff_sz);
+	rx_pkt->rx_page = slot;
+	rx_pkt->data.skb = skb;
+	rx_pkt->data.dma_addr = slot->dma_addr + NET_SKB_PAD;
+
+	return skb;
+
+fail:
+	spin_unlock_bh(&pool->lock);
+	return NULL;
+}
+
+/**
+ * ipa_rx_pkt_alloc_buff() - Attach a DMA mapped Rx buffer to an Rx wrapper
+ * @sys:	system pipe context
+ * @rx_pkt:	Rx wrapper
+ * @flag:	allocation flags
+ *
+ * The buffer comes from the pipe page pool when possible, otherwise a new
+ * skb is allocated and mapped.
+ *
+ * Returns:	0 on success, negative on failure
+ */
+static int ipa_rx_pkt_alloc_buff(struct ipa_sys_context *sys,
+		struct ipa_rx_pkt_wrapper *rx_pkt, gfp_t flag)
+{
+	void *ptr;
+
+	rx_pkt->rx_page = NULL;
+	if (sys->page_pool.capacity &&
+	    ipa_rx_page_pool_get_skb(sys, rx_pkt, flag))
+		return 0;
+
+	rx_pkt->data.skb = sys->get_skb(sys->rx_buff_sz, flag);
+	if (rx_pkt->data.skb == NULL) {
+		IPAERR("failed to alloc skb\n");
+		return -ENOMEM;
+	}
+	ptr = skb_put(rx_pkt->data.skb, sys->rx_buff_sz);
+	rx_pkt->data.dma_addr = dma_map_single(ipa_ctx->pdev, ptr,
+					     sys->rx_buff_sz,
+					     DMA_FROM_DEVICE);
+	if (rx_pkt->data.dma_addr == 0 ||
+			rx_pkt->data.dma_addr == ~0) {
+		IPAERR("dma_map_single failure %p for %p\n",
+		       (void *)rx_pkt->data.dma_addr, ptr);
+		sys->free_skb(rx_pkt->data.skb);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/**
+ * ipa_rx_pkt_unmap_buff() - Give the CPU access to a completed Rx buffer
+ * @sys:	system pipe context
+ * @rx_pkt:	Rx wrapper
+ *
+ * Pool buffers stay mapped, only the data area is synced for the CPU and the
+ * slot becomes recyclable once the stack releases the skb.
+ */
+static void ipa_rx_pkt_unmap_buff(struct ipa_sys_context *sys,
+		struct ipa_rx_pkt_wrapper *rx_pkt)
+{
+	struct ipa_rx_page *slot = rx_pkt->rx_page;
+
+	if (!slot) {
+		dma_unmap_single(ipa_ctx->pdev, rx_pkt->data.dma_addr,
+				sys->rx_buff_sz, DMA_FROM_DEVICE);
+		return;
+	}
+
+	dma_sync_single_range_for_cpu(ipa_ctx->pdev, slot->dma_addr,
+			NET_SKB_PAD, sys->rx_buff_sz, DMA_FROM_DEVICE);
+	spin_lock_bh(&sys->page_pool.lock);
+	slot->in_use = false;
+	spin_unlock_bh(&sys->page_pool.lock);
+	rx_pkt->rx_page = NULL;
+}
+
+/**
+ * ipa_rx_pkt_free_buff() - Release an Rx buffer never handed to the stack
+ * @sys:	system pipe context
+ * @rx_pkt:	Rx wrapper
+ */
+static void ipa_rx_pkt_free_buff(struct ipa_sys_context *sys,
+		struct ipa_rx_pkt_wrapper *rx_pkt)
+{
+	ipa_rx_pkt_unmap_buff(sys, rx_pkt);
+	sys->free_skb(rx_pkt->data.skb);
+}
+
 
 static int ipa_lan_rx_pyld_hdlr(struct sk_buff *skb,
 		struct ipa_sys_context *sys)
@@ -2026,12 +2597,12 @@ begin:
 }
 
 static struct sk_buff *join_prev_skb(struct sk_buff *prev_skb,
-		struct sk_buff *skb, unsigned int len)
+		struct sk_buff *skb, unsigned int len, gfp_t flags)
 {
 	struct sk_buff *skb2;
 
 	skb2 = skb_copy_expand(prev_skb, 0,
-			len, GFP_KERNEL);
+			len, flags);
 	if (likely(skb2)) {
 		memcpy(skb_put(skb2, len),
 			skb->data, len);
@@ -2045,7 +2616,7 @@ static struct sk_buff *join_prev_skb(struct sk_buff *prev_skb,
 }
 
 static void wan_rx_handle_splt_pyld(struct sk_buff *skb,
-		struct ipa_sys_context *sys)
+		struct ipa_sys_context *sys, gfp_t flags)
 {
 	struct sk_buff *skb2;
 
@@ -2053,7 +2624,7 @@ static void wan_rx_handle_splt_pyld(struct sk_buff *skb,
 	if (sys->len_rem <= skb->len) {
 		if (sys->prev_skb) {
 			skb2 = join_prev_skb(sys->prev_skb, skb,
-					sys->len_rem);
+					sys->len_rem, flags);
 			if (likely(skb2)) {
 				IPADBG(
 					"removing Status element from skb and sending to WAN client");
@@ -2069,7 +2640,7 @@ static void wan_rx_handle_splt_pyld(struct sk_buff *skb,
 	} else {
 		if (sys->prev_skb) {
 			skb2 = join_prev_skb(sys->prev_skb, skb,
-					skb->len);
+					skb->len, flags);
 			sys->prev_skb = skb2;
 		}
 		sys->len_rem -= skb->len;
@@ -2088,6 +2659,8 @@ static int ipa_wan_rx_pyld_hdlr(struct sk_buff *skb,
 	int checksum_trailer_exists;
 	int frame_len;
 	int ep_idx;
+	/* NAPI enabled pipes deliver packets in softirq context */
+	gfp_t flags = sys->ep->napi_enabled ? GFP_ATOMIC : GFP_KERNEL;
 
 	IPA_DUMP_BUFF(skb->data, 0, skb->len);
 	if (skb->len == 0) {
@@ -2099,7 +2672,7 @@ static int ipa_wan_rx_pyld_hdlr(struct sk_buff *skb,
 	 * take the start of the payload from prev_skb
 	 */
 	if (sys->len_rem)
-		wan_rx_handle_splt_pyld(skb, sys);
+		wan_rx_handle_splt_pyld(skb, sys, flags);
 
 	while (skb->len) {
 		IPADBG("LEN_REM %d\n", skb->len);
@@ -2170,7 +2743,7 @@ static int ipa_wan_rx_pyld_hdlr(struct sk_buff *skb,
 			frame_len += IPA_DL_CHECKSUM_LENGTH;
 		IPADBG("frame_len %d\n", frame_len);
 
-		skb2 = skb_clone(skb, GFP_KERNEL);
+		skb2 = skb_clone(skb, flags);
 		if (likely(skb2)) {
 			/*
 			 * the len of actual data is smaller than expected
@@ -2206,6 +2779,8 @@ static int ipa_wan_rx_pyld_hdlr(struct sk_buff *skb,
 	};
 bail:
 	sys->free_skb(skb);
+	if (sys->ep->napi_enabled)
+		sys->ep->client_notify(sys->ep->priv, IPA_CLIENT_AGGR_END, 0);
 	return rc;
 }
 
@@ -2320,13 +2895,31 @@ static void ipa_wq_rx_common(struct ipa_sys_context *sys, u32 size)
 	if (size)
 		rx_pkt_expected->len = size;
 	rx_skb = rx_pkt_expected->data.skb;
-	dma_unmap_single(ipa_ctx->pdev, rx_pkt_expected->data.dma_addr,
-			sys->rx_buff_sz, DMA_FROM_DEVICE);
+	ipa_rx_pkt_unmap_buff(sys, rx_pkt_expected);
 	skb_set_tail_pointer(rx_skb, rx_pkt_expected->len);
 	rx_skb->len = rx_pkt_expected->len;
 	rx_skb->truesize = rx_pkt_expected->len + sizeof(struct sk_buff);
-	sys->pyld_hdlr(rx_skb, sys);
-	sys->repl_hdlr(sys);
+	if (unlikely(ipa_ctx->dp_lat_sample_rate) &&
+		!(++sys->lat.seq % ipa_ctx->dp_lat_sample_rate)) {
+		ktime_t t0, t1;
+		u32 pkts = ipa_ctx->stats.rx_pkts;
+
+		t0 = ktime_get();
+		sys->pyld_hdlr(rx_skb, sys);
+		t1 = ktime_get();
+		sys->repl_hdlr(sys);
+		/* rx_pkts is global, concurrent pipes make this approximate */
+		sys->lat.pkts += ipa_ctx->stats.rx_pkts - pkts;
+		sys->lat.deliver_ns += ktime_to_ns(ktime_sub(t1, t0));
+		sys->lat.samples++;
+		ipa_dp_lat_account(sys, IPA_DP_LAT_DELIVER,
+			ktime_to_ns(ktime_sub(t1, t0)));
+		ipa_dp_lat_account(sys, IPA_DP_LAT_REPL,
+			ktime_to_ns(ktime_sub(ktime_get(), t1)));
+	} else {
+		sys->pyld_hdlr(rx_skb, sys);
+		sys->repl_hdlr(sys);
+	}
 	kmem_cache_free(ipa_ctx->rx_pkt_wrapper_cache, rx_pkt_expected);
 
 }
@@ -2493,6 +3086,8 @@ static int ipa_assign_policy(struct ipa_sys_connect_params *in,
 				INIT_DELAYED_WORK(&sys->replenish_rx_work,
 						replenish_rx_work_func);
 				INIT_WORK(&sys->repl_work, ipa_wq_repl_rx);
+				INIT_WORK(&sys->napi_clk_rel_work,
+					ipa_wq_napi_clk_rel);
 				atomic_set(&sys->curr_polling_state, 0);
 				sys->rx_buff_sz = IPA_LAN_RX_BUFF_SZ;
 				sys->rx_pool_sz = IPA_GENERIC_RX_POOL_SZ;
@@ -230,6 +230,19 @@ static int ipa_generate_flt_hw_rule(enum ipa_ip_type ip,
 	return 0;
 }
 
+/**
+ * ipa_flt_tbl_is_clean() - check whether a rule-set in sys memory can be reused
+ * @tbl: filter table
+ *
+ * Returns:	true if @tbl lives in sys memory and its rule-set did not change
+ *		since it was last generated
+ */
+static bool ipa_flt_tbl_is_clean(struct ipa_flt_tbl *tbl)
+{
+	return tbl->in_sys && !tbl->dirty && tbl->curr_mem.phys_base &&
+		!list_empty(&tbl->head_flt_rule_list);
+}
+
 /**
  * ipa_get_flt_hw_tbl_size() - returns the size of HW filtering table
  * @ip: the ip address family type
@@ -251,6 +264,11 @@ static int ipa_get_flt_hw_tbl_size(enum ipa_ip_type ip, u32 *hdr_sz)
 	*hdr_sz = 0;
 	tbl = &ipa_ctx->glob_flt_tbl[ip];
 	rule_set_sz = 0;
+	if (ipa_flt_tbl_is_clean(tbl)) {
+		/* the rule-set in sys memory is reused as is */
+		*hdr_sz += IPA_FLT_TABLE_WORD_SIZE;
+		goto pipe_tbls;
+	}
 	list_for_each_entry(entry, &tbl->head_flt_rule_list, link) {
 		if (ipa_generate_flt_hw_rule(ip, entry, NULL)) {
 			IPAERR("failed to find HW FLT rule size\n");
@@ -273,9 +291,14 @@ static int ipa_get_flt_hw_tbl_size(enum ipa_ip_type ip, u32 *hdr_sz)
 		}
 	}
 
+pipe_tbls:
 	for (i = 0; i < IPA_NUM_PIPES; i++) {
 		tbl = &ipa_ctx->flt_tbl[i][ip];
 		rule_set_sz = 0;
+		if (ipa_flt_tbl_is_clean(tbl)) {
+			*hdr_sz += IPA_FLT_TABLE_WORD_SIZE;
+			continue;
+		}
 		list_for_each_entry(entry, &tbl->head_flt_rule_list, link) {
 			if (ipa_generate_flt_hw_rule(ip, entry, NULL)) {
 				IPAERR("failed to find HW FLT rule size\n");
@@ -372,6 +395,12 @@ static int ipa_generate_flt_hw_tbl_common(enum ipa_ip_type ip, u8 *base,
 				body = body + (IPA_FLT_TABLE_WORD_SIZE -
 					((long)body &
 					IPA_FLT_ENTRY_MEMORY_ALLIGNMENT));
+		} else if (ipa_flt_tbl_is_clean(tbl)) {
+			if (hdr2)
+				*(u32 *)hdr = tbl->curr_mem.phys_base;
+			else
+				hdr = ipa_write_32(tbl->curr_mem.phys_base,
+						hdr);
 		} else {
 			if (tbl->sz == 0) {
 				IPAERR("tbl size is 0\n");
@@ -419,6 +448,7 @@ static int ipa_generate_flt_hw_tbl_common(enum ipa_ip_type ip, u8 *base,
 				tbl->prev_mem = tbl->curr_mem;
 			}
 			tbl->curr_mem = flt_tbl_mem;
+			tbl->dirty = false;
 		}
 	}
 
@@ -464,6 +494,13 @@ static int ipa_generate_flt_hw_tbl_common(enum ipa_ip_type ip, u8 *base,
 					body = body + (IPA_FLT_TABLE_WORD_SIZE -
 						((long)body &
 					IPA_FLT_ENTRY_MEMORY_ALLIGNMENT));
+			} else if (ipa_flt_tbl_is_clean(tbl)) {
+				if (hdr2)
+					IPA_WRITE_FLT_HDR(i,
+						tbl->curr_mem.phys_base)
+				else
+					hdr = ipa_write_32(
+						tbl->curr_mem.phys_base, hdr);
 			} else {
 				if (tbl->sz == 0) {
 					IPAERR("tbl size is 0\n");
@@ -518,6 +555,7 @@ static int ipa_generate_flt_hw_tbl_common(enum ipa_ip_type ip, u8 *base,
 					tbl->prev_mem = tbl->curr_mem;
 				}
 				tbl->curr_mem = flt_tbl_mem;
+				tbl->dirty = false;
 			}
 		}
 	}
@@ -996,6 +1034,25 @@ fail_desc:
 	return rc;
 }
 
+/**
+ * __ipa_commit_flt() - Commit the SW filtering tables of specified type to
+ * IPA HW, or defer the commit to the end of the open commit batch
+ * @ip:	[in] the family of filtering tables
+ *
+ * Returns:	0 on success, negative on failure
+ *
+ * caller needs to hold ipa_ctx->lock
+ */
+int __ipa_commit_flt(enum ipa_ip_type ip)
+{
+	if (ipa_ctx->tbl_commit_batch) {
+		set_bit(ip, &ipa_ctx->flt_commit_pending);
+		return 0;
+	}
+
+	return ipa_ctx->ctrl->ipa_commit_flt(ip);
+}
+
 static int __ipa_add_flt_rule(struct ipa_flt_tbl *tbl, enum ipa_ip_type ip,
 			      const struct ipa_flt_rule *rule, u8 add_rear,
 			      u32 *rule_hdl)
@@ -1051,6 +1108,7 @@ static int __ipa_add_flt_rule(struct ipa_flt_tbl *tbl, enum ipa_ip_type ip,
 		list_add(&entry->link, &tbl->head_flt_rule_list);
 	}
 	tbl->rule_cnt++;
+	tbl->dirty = true;
 	if (entry->rt_tbl)
 		entry->rt_tbl->ref_cnt++;
 	id = ipa_id_alloc(entry);
@@ -1093,6 +1151,7 @@ static int __ipa_del_flt_rule(u32 rule_hdl)
 
 	list_del(&entry->link);
 	entry->tbl->rule_cnt--;
+	entry->tbl->dirty = true;
 	if (entry->rt_tbl)
 		entry->rt_tbl->ref_cnt--;
 	IPADBG("del flt rule rule_cnt=%d\n", entry->tbl->rule_cnt);
@@ -1157,6 +1216,7 @@ static int __ipa_mdfy_flt_rule(struct ipa_flt_rule_mdfy *frule,
 	if (entry->rt_tbl)
 		entry->rt_tbl->ref_cnt++;
 	entry->hw_len = 0;
+	entry->tbl->dirty = true;
 
 	return 0;
 
@@ -1249,7 +1309,7 @@ int ipa_add_flt_rule(struct ipa_ioc_add_flt_rule *rules)
 	}
 
 	if (rules->commit)
-		if (ipa_ctx->ctrl->ipa_commit_flt(rules->ip)) {
+		if (__ipa_commit_flt(rules->ip)) {
 			result = -EPERM;
 			goto bail;
 		}
@@ -1290,7 +1350,7 @@ int ipa_del_flt_rule(struct ipa_ioc_del_flt_rule *hdls)
 	}
 
 	if (hdls->commit)
-		if (ipa_ctx->ctrl->ipa_commit_flt(hdls->ip)) {
+		if (__ipa_commit_flt(hdls->ip)) {
 			result = -EPERM;
 			goto bail;
 		}
@@ -1331,7 +1391,7 @@ int ipa_mdfy_flt_rule(struct ipa_ioc_mdfy_flt_rule *hdls)
 	}
 
 	if (hdls->commit)
-		if (ipa_ctx->ctrl->ipa_commit_flt(hdls->ip)) {
+		if (__ipa_commit_flt(hdls->ip)) {
 			result = -EPERM;
 			goto bail;
 		}
@@ -1364,7 +1424,7 @@ int ipa_commit_flt(enum ipa_ip_type ip)
 
 	mutex_lock(&ipa_ctx->lock);
 
-	if (ipa_ctx->ctrl->ipa_commit_flt(ip)) {
+	if (__ipa_commit_flt(ip)) {
 		result = -EPERM;
 		goto bail;
 	}
@@ -1421,6 +1481,7 @@ int ipa_reset_flt(enum ipa_ip_type ip)
 
 		list_del(&entry->link);
 		entry->tbl->rule_cnt--;
+		entry->tbl->dirty = true;
 		if (entry->rt_tbl)
 			entry->rt_tbl->ref_cnt--;
 		entry->cookie = 0;
@@ -1442,6 +1503,7 @@ int ipa_reset_flt(enum ipa_ip_type ip)
 			}
 			list_del(&entry->link);
 			entry->tbl->rule_cnt--;
+			entry->tbl->dirty = true;
 			if (entry->rt_tbl)
 				entry->rt_tbl->ref_cnt--;
 			entry->cookie = 0;
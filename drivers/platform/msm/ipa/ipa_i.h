@@ -196,6 +196,7 @@ struct ipa_flt_entry {
  * @curr_mem: current routing tables block in sys memory
  * @prev_mem: previous routing table block in sys memory
  * @id: routing table id
+ * @dirty: rule-set changed since @curr_mem was generated
  */
 struct ipa_rt_tbl {
 	struct list_head link;
@@ -211,6 +212,7 @@ struct ipa_rt_tbl {
 	struct ipa_mem_buffer curr_mem;
 	struct ipa_mem_buffer prev_mem;
 	int id;
+	bool dirty;
 };
 
 /**
@@ -366,6 +368,7 @@ struct ipa_hdr_proc_ctx_tbl {
  * @end: the last header index
  * @curr_mem: current filter tables block in sys memory
  * @prev_mem: previous filter table block in sys memory
+ * @dirty: rule-set changed since @curr_mem was generated
  */
 struct ipa_flt_tbl {
 	struct list_head head_flt_rule_list;
@@ -375,6 +378,7 @@ struct ipa_flt_tbl {
 	struct ipa_mem_buffer curr_mem;
 	struct ipa_mem_buffer prev_mem;
 	bool sticky_rear;
+	bool dirty;
 };
 
 /**
@@ -492,6 +496,7 @@ struct ipa_wlan_comm_memb {
  * @skip_ep_cfg: boolean field that determines if EP should be configured
  *  by IPA driver
  * @keep_ipa_awake: when true, IPA will not be clock gated
+ * @napi_enabled: when true, Rx is polled from the client NAPI context
  */
 struct ipa_ep_context {
 	int valid;
@@ -517,6 +522,7 @@ struct ipa_ep_context {
 	u32 dflt_flt6_rule_hdl;
 	bool skip_ep_cfg;
 	bool keep_ipa_awake;
+	bool napi_enabled;
 	struct ipa_wlan_stats wstats;
 	u32 wdi_state;
 
@@ -537,6 +543,71 @@ struct ipa_repl_ctx {
 	u32 capacity;
 };
 
+/**
+ * struct ipa_rx_page - Rx page owned by a sys pipe page pool
+ * @page: compound page backing the Rx buffer, NULL if the slot is empty
+ * @dma_addr: DMA address of the page, mapped for the lifetime of the slot
+ * @in_use: the page backs an Rx buffer which was not completed by HW yet
+ */
+struct ipa_rx_page {
+	struct page *page;
+	dma_addr_t dma_addr;
+	bool in_use;
+};
+
+/**
+ * struct ipa_rx_page_pool - pool of DMA mapped pages recycled as Rx buffers
+ * @pages: pool slots, visited in ring order
+ * @capacity: number of slots, 0 when the pool is not used by the pipe
+ * @next: next slot to hand out
+ * @lock: protects the slots and @next
+ *
+ * The pool keeps one reference on each of its pages. A page is recycled as
+ * soon as all skbs built on top of it were released by the stack, i.e. when
+ * the pool reference is the only one left.
+ */
+struct ipa_rx_page_pool {
+	struct ipa_rx_page *pages;
+	u32 capacity;
+	u32 next;
+	spinlock_t lock;
+};
+
+#define IPA_DP_LAT_BUCKETS 16
+
+/**
+ * enum ipa_dp_lat_stage - Rx data path stages timed by struct ipa_dp_lat
+ * @IPA_DP_LAT_SCHED: EOT interrupt until the first buffer is handled, i.e.
+ * workqueue or NAPI scheduling delay
+ * @IPA_DP_LAT_DELIVER: payload handler, including the client notify callback
+ * and the network stack work done synchronously below it
+ * @IPA_DP_LAT_REPL: Rx buffer replenish after the payload was handled
+ */
+enum ipa_dp_lat_stage {
+	IPA_DP_LAT_SCHED,
+	IPA_DP_LAT_DELIVER,
+	IPA_DP_LAT_REPL,
+	IPA_DP_LAT_STAGE_MAX
+};
+
+/**
+ * struct ipa_dp_lat - sampled Rx data path latency of a sys pipe
+ * @irq_ts: time of the pending sampled EOT interrupt, zero if none
+ * @seq: Rx buffer counter used to pick the sampled buffers
+ * @samples: number of sampled Rx buffers
+ * @pkts: packets accounted to the sampled buffers
+ * @deliver_ns: time spent in the deliver stage of the sampled buffers
+ * @hist: per stage histograms, bucket n counts latencies below 2^n usec
+ */
+struct ipa_dp_lat {
+	ktime_t irq_ts;
+	u32 seq;
+	u32 samples;
+	u64 pkts;
+	u64 deliver_ns;
+	u32 hist[IPA_DP_LAT_STAGE_MAX][IPA_DP_LAT_BUCKETS];
+};
+
 /**
  * struct ipa_sys_context - IPA endpoint context for system to BAM pipes
  * @head_desc_list: header descriptors list
@@ -569,6 +640,9 @@ struct ipa_sys_context {
 	struct work_struct repl_work;
 	void (*repl_hdlr)(struct ipa_sys_context *sys);
 	struct ipa_repl_ctx repl;
+	struct work_struct napi_clk_rel_work;
+	struct ipa_rx_page_pool page_pool;
+	struct ipa_dp_lat lat;
 
 	/* ordering is important - mutable fields go above */
 	struct ipa_ep_context *ep;
@@ -658,6 +732,8 @@ struct ipa_desc {
  * @dma_address: DMA address of this Rx packet
  * @link: linked to the Rx packets on that pipe
  * @len: how many bytes are copied into skb's flat buffer
+ * @rx_page: page pool slot backing the skb, NULL if the skb was allocated
+ *  and mapped on its own
  */
 struct ipa_rx_pkt_wrapper {
 	struct list_head link;
@@ -665,6 +741,7 @@ struct ipa_rx_pkt_wrapper {
 	u32 len;
 	struct work_struct work;
 	struct ipa_sys_context *sys;
+	struct ipa_rx_page *rx_page;
 };
 
 /**
@@ -746,6 +823,8 @@ struct ipa_stats {
 	u32 wan_repl_rx_empty;
 	u32 lan_rx_empty;
 	u32 lan_repl_rx_empty;
+	u32 rx_page_recycled;
+	u32 rx_page_alloc;
 };
 
 struct ipa_active_clients {
@@ -832,6 +911,9 @@ struct ipa_sps_pm {
  * @tx_pkt_wrapper_cache: Tx packets cache
  * @rx_pkt_wrapper_cache: Rx packets cache
  * @rt_idx_bitmap: routing table index bitmap
+ * @tbl_commit_batch: nesting level of open filter/routing commit batches
+ * @flt_commit_pending: IP families with a filter commit deferred by a batch
+ * @rt_commit_pending: IP families with a routing commit deferred by a batch
  * @lock: this does NOT protect the linked lists within ipa_sys_context
  * @smem_sz: shared memory size available for SW use starting
  *  from non-restricted bytes
@@ -898,6 +980,9 @@ struct ipa_context {
 	struct kmem_cache *tx_pkt_wrapper_cache;
 	struct kmem_cache *rx_pkt_wrapper_cache;
 	unsigned long rt_idx_bitmap[IPA_IP_MAX];
+	u32 tbl_commit_batch;
+	unsigned long flt_commit_pending;
+	unsigned long rt_commit_pending;
 	struct mutex lock;
 	u16 smem_sz;
 	u16 smem_restricted_bytes;
@@ -945,6 +1030,7 @@ struct ipa_context {
 	struct device *pdev;
 	spinlock_t idr_lock;
 	u32 enable_clock_scaling;
+	u32 dp_lat_sample_rate;
 	u32 curr_ipa_clk_rate;
 	bool q6_proxy_clk_vote_valid;
 
@@ -1124,6 +1210,8 @@ int ipa_set_single_ndp_per_mbim(bool);
 int ipa_set_hw_timer_fix_for_mbim_aggr(bool);
 void ipa_debugfs_init(void);
 void ipa_debugfs_remove(void);
+int ipa_dp_lat_stat(char *buf, int size);
+void ipa_dp_lat_reset(void);
 
 void ipa_dump_buff_internal(void *base, dma_addr_t phy_base, u32 size);
 #ifdef IPA_DEBUG
@@ -1147,6 +1235,7 @@ void ipa_disable_clks(void);
 void ipa_inc_client_enable_clks(void);
 int ipa_inc_client_enable_clks_no_block(void);
 void ipa_dec_client_disable_clks(void);
+int ipa_dec_client_disable_clks_no_block(void);
 int ipa_interrupts_init(u32 ipa_irq, u32 ee, struct device *ipa_dev);
 int ipa_del_hdr_by_user(struct ipa_ioc_del_hdr *hdls, bool by_user);
 int ipa_del_hdr_proc_ctx_by_user(struct ipa_ioc_del_hdr_proc_ctx *hdls,
@@ -1211,8 +1300,10 @@ int _ipa_init_rt6_v2(void);
 int _ipa_init_flt4_v2(void);
 int _ipa_init_flt6_v2(void);
 
+int __ipa_commit_flt(enum ipa_ip_type ip);
 int __ipa_commit_flt_v1(enum ipa_ip_type ip);
 int __ipa_commit_flt_v2(enum ipa_ip_type ip);
+int __ipa_commit_rt(enum ipa_ip_type ip);
 int __ipa_commit_rt_v1(enum ipa_ip_type ip);
 int __ipa_commit_rt_v2(enum ipa_ip_type ip);
 int __ipa_generate_rt_hw_rule_v2(enum ipa_ip_type ip,
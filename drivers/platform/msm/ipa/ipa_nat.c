@@ -12,6 +12,7 @@
 
 #include <linux/device.h>
 #include <linux/fs.h>
+#include <linux/hashtable.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/mm.h>
@@ -34,6 +35,25 @@ enum nat_table_type {
 #define NAT_TABLE_ENTRY_SIZE_BYTE 32
 #define NAT_INTEX_TABLE_ENTRY_SIZE_BYTE 4
 
+/* index of the NAT_DMA targets of one command vector */
+#define IPA_NAT_DMA_HASH_BITS 6
+#define IPA_NAT_DMA_KEY(base_addr, offset) (((u32)(base_addr) << 30) | \
+		(offset))
+
+/**
+ * struct ipa_nat_dma_target - NAT_DMA target of a command vector entry
+ * @link: link in the target index
+ * @key: table and offset written by the entry
+ * @idx: index of the entry in the command vector
+ * @superseded: a later entry of the vector writes the same target
+ */
+struct ipa_nat_dma_target {
+	struct hlist_node link;
+	u32 key;
+	u16 idx;
+	bool superseded;
+};
+
 static int ipa_nat_vma_fault_remap(
 	 struct vm_area_struct *vma, struct vm_fault *vmf)
 {
@@ -434,13 +454,22 @@ bail:
  *
  * Called by NAT client driver to post NAT_DMA command to IPA HW
  *
+ * All entries of @dma are posted as a single immediate command chain. When
+ * several entries write the same table offset only the last one is posted,
+ * at the position of that last entry.
+ *
  * Returns:	0 on success, negative on failure
  */
 int ipa_nat_dma_cmd(struct ipa_ioc_nat_dma_cmd *dma)
 {
+	DECLARE_HASHTABLE(targets, IPA_NAT_DMA_HASH_BITS);
+	struct ipa_nat_dma_target *target = NULL;
+	struct ipa_nat_dma_target *iter;
 	struct ipa_nat_dma *cmd = NULL;
 	struct ipa_desc *desc = NULL;
 	u16 size = 0, cnt = 0;
+	u16 num_desc = 0;
+	u32 key;
 	int ret = 0;
 
 	IPADBG("\n");
@@ -514,6 +543,13 @@ int ipa_nat_dma_cmd(struct ipa_ioc_nat_dma_cmd *dma)
 			goto bail;
 		}
 	}
+	size = sizeof(struct ipa_nat_dma_target) * dma->entries;
+	target = kzalloc(size, GFP_KERNEL);
+	if (target == NULL) {
+		IPAERR("Failed to alloc memory\n");
+		ret = -ENOMEM;
+		goto bail;
+	}
 	size = sizeof(struct ipa_desc) * dma->entries;
 	desc = kzalloc(size, GFP_KERNEL);
 	if (desc == NULL) {
@@ -528,29 +564,56 @@ int ipa_nat_dma_cmd(struct ipa_ioc_nat_dma_cmd *dma)
 		ret = -ENOMEM;
 		goto bail;
 	}
+
+	/* keep the last write of every target */
+	hash_init(targets);
 	for (cnt = 0; cnt < dma->entries; cnt++) {
-		cmd[cnt].table_index = dma->dma[cnt].table_index;
-		cmd[cnt].base_addr = dma->dma[cnt].base_addr;
-		cmd[cnt].offset = dma->dma[cnt].offset;
-		cmd[cnt].data = dma->dma[cnt].data;
-		desc[cnt].type = IPA_IMM_CMD_DESC;
-		desc[cnt].opcode = IPA_NAT_DMA;
-		desc[cnt].callback = NULL;
-		desc[cnt].user1 = NULL;
-
-		desc[cnt].user2 = 0;
-
-		desc[cnt].len = sizeof(struct ipa_nat_dma);
-		desc[cnt].pyld = (void *)&cmd[cnt];
-
-		ret = ipa_send_cmd(1, &desc[cnt]);
-		if (ret == -EPERM)
-			IPAERR("Fail to send immediate command %d\n", cnt);
+		key = IPA_NAT_DMA_KEY(dma->dma[cnt].base_addr,
+				dma->dma[cnt].offset);
+		hash_for_each_possible(targets, iter, link, key) {
+			if (iter->key == key) {
+				iter->superseded = true;
+				hash_del(&iter->link);
+				break;
+			}
+		}
+		target[cnt].key = key;
+		target[cnt].idx = cnt;
+		hash_add(targets, &target[cnt].link, key);
+	}
+
+	for (cnt = 0; cnt < dma->entries; cnt++) {
+		if (target[cnt].superseded)
+			continue;
+
+		cmd[num_desc].table_index = dma->dma[cnt].table_index;
+		cmd[num_desc].base_addr = dma->dma[cnt].base_addr;
+		cmd[num_desc].offset = dma->dma[cnt].offset;
+		cmd[num_desc].data = dma->dma[cnt].data;
+		desc[num_desc].type = IPA_IMM_CMD_DESC;
+		desc[num_desc].opcode = IPA_NAT_DMA;
+		desc[num_desc].callback = NULL;
+		desc[num_desc].user1 = NULL;
+
+		desc[num_desc].user2 = 0;
+
+		desc[num_desc].len = sizeof(struct ipa_nat_dma);
+		desc[num_desc].pyld = (void *)&cmd[num_desc];
+		num_desc++;
+	}
+	IPADBG("posting %d NAT_DMA commands out of %d entries\n",
+			num_desc, dma->entries);
+
+	ret = ipa_send_cmd(num_desc, desc);
+	if (ret) {
+		IPAERR("Fail to send immediate command chain\n");
+		ret = -EPERM;
 	}
 
 bail:
 	kfree(cmd);
 	kfree(desc);
+	kfree(target);
 
 	return ret;
 }
@@ -113,6 +113,8 @@ int ipa_rm_initialize(void);
 
 int ipa_rm_stat(char *buf, int size);
 
+int ipa_rm_inactivity_timer_stat(char *buf, int size);
+
 const char *ipa_rm_resource_str(enum ipa_rm_resource_name resource_name);
 
 void ipa_rm_perf_profile_change(enum ipa_rm_resource_name resource_name);
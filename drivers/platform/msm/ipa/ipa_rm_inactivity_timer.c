@@ -19,6 +19,19 @@
 #include <linux/workqueue.h>
 #include <linux/ipa.h>
 #include "ipa_i.h"
+#include "ipa_rm_i.h"
+
+/*
+ * Idle gaps shorter than IPA_RM_IT_MIN_GAP_MSECS belong to the same burst
+ * and are not sampled. Sampled gaps are kept in log2 buckets starting at
+ * IPA_RM_IT_MIN_GAP_MSECS, the last bucket is open ended.
+ */
+#define IPA_RM_IT_MIN_GAP_MSECS 10
+#define IPA_RM_IT_HIST_BUCKETS 12
+#define IPA_RM_IT_MIN_SAMPLES 16
+#define IPA_RM_IT_HIST_DECAY 256
+#define IPA_RM_IT_PERCENTILE 90
+#define IPA_RM_IT_MAX_FACTOR 4
 
 /**
  * struct ipa_rm_it_private - IPA RM Inactivity Timer private
@@ -31,6 +44,12 @@
  * @release_in_prog: boolean flag indicates if release resource
  *			is scheduled for happen in the future.
  * @jiffies: number of jiffies for timeout
+ * @adaptive: release delay is picked from @gap_hist instead of @jiffies
+ * @curr_jiffies: release delay used for the last release
+ * @idle: resource was released and not requested since @idle_start
+ * @idle_start: jiffies of the last release
+ * @gap_hist: histogram of idle gaps between bursts
+ * @gap_samples: number of samples in @gap_hist
  *
  * WWAN private - holds all relevant info about WWAN driver
  */
@@ -41,6 +60,12 @@ struct ipa_rm_it_private {
 	struct delayed_work work;
 	bool release_in_prog;
 	unsigned long jiffies;
+	bool adaptive;
+	unsigned long curr_jiffies;
+	bool idle;
+	unsigned long idle_start;
+	u32 gap_hist[IPA_RM_IT_HIST_BUCKETS];
+	u32 gap_samples;
 };
 
 static struct ipa_rm_it_private ipa_rm_it_handles[IPA_RM_RESOURCE_MAX];
@@ -84,6 +109,76 @@ static void ipa_rm_inactivity_timer_func(struct work_struct *work)
 		&ipa_rm_it_handles[me->resource_name].lock, flags);
 }
 
+/**
+ * ipa_rm_it_record_gap() - account an idle gap in the gap histogram
+ * @me: inactivity timer of the resource
+ *
+ * Called with me->lock held when the resource is requested after a release.
+ * Older samples are halved every IPA_RM_IT_HIST_DECAY samples so the
+ * histogram follows recent traffic.
+ */
+static void ipa_rm_it_record_gap(struct ipa_rm_it_private *me)
+{
+	unsigned int gap_msecs;
+	int bucket;
+	int i;
+
+	me->idle = false;
+	gap_msecs = jiffies_to_msecs(jiffies - me->idle_start);
+	if (gap_msecs < IPA_RM_IT_MIN_GAP_MSECS)
+		return;
+
+	bucket = min(fls(gap_msecs / IPA_RM_IT_MIN_GAP_MSECS) - 1,
+		     IPA_RM_IT_HIST_BUCKETS - 1);
+	me->gap_hist[bucket]++;
+	if (++me->gap_samples < IPA_RM_IT_HIST_DECAY)
+		return;
+
+	me->gap_samples = 0;
+	for (i = 0; i < IPA_RM_IT_HIST_BUCKETS; i++) {
+		me->gap_hist[i] /= 2;
+		me->gap_samples += me->gap_hist[i];
+	}
+}
+
+/**
+ * ipa_rm_it_adaptive_jiffies() - pick the release delay from the histogram
+ * @me: inactivity timer of the resource
+ *
+ * If IPA_RM_IT_PERCENTILE percent of the recent bursts started within
+ * IPA_RM_IT_MAX_FACTOR times the configured timeout, the resource is held
+ * until that point so those bursts do not pay the clock-on latency.
+ * Otherwise waiting is mostly wasted power and the resource is released
+ * after IPA_RM_IT_MIN_GAP_MSECS. Called with me->lock held.
+ *
+ * Return codes:
+ * release delay in jiffies
+ */
+static unsigned long ipa_rm_it_adaptive_jiffies(struct ipa_rm_it_private *me)
+{
+	unsigned long msecs;
+	u32 target;
+	u32 sum = 0;
+	int i;
+
+	if (me->gap_samples < IPA_RM_IT_MIN_SAMPLES)
+		return me->jiffies;
+
+	target = DIV_ROUND_UP(me->gap_samples * IPA_RM_IT_PERCENTILE, 100);
+	for (i = 0; i < IPA_RM_IT_HIST_BUCKETS - 1; i++) {
+		sum += me->gap_hist[i];
+		if (sum >= target)
+			break;
+	}
+
+	msecs = IPA_RM_IT_MIN_GAP_MSECS << (i + 1);
+	if (i == IPA_RM_IT_HIST_BUCKETS - 1 ||
+	    msecs_to_jiffies(msecs) > me->jiffies * IPA_RM_IT_MAX_FACTOR)
+		msecs = IPA_RM_IT_MIN_GAP_MSECS;
+
+	return msecs_to_jiffies(msecs);
+}
+
 /**
 * ipa_rm_inactivity_timer_init() - Init function for IPA RM
 * inactivity timer. This function shall be called prior calling
@@ -117,6 +212,8 @@ int ipa_rm_inactivity_timer_init(enum ipa_rm_resource_name resource_name,
 	spin_lock_init(&ipa_rm_it_handles[resource_name].lock);
 	ipa_rm_it_handles[resource_name].resource_name = resource_name;
 	ipa_rm_it_handles[resource_name].jiffies = msecs_to_jiffies(msecs);
+	ipa_rm_it_handles[resource_name].curr_jiffies =
+		ipa_rm_it_handles[resource_name].jiffies;
 	ipa_rm_it_handles[resource_name].release_in_prog = false;
 
 	INIT_DELAYED_WORK(&ipa_rm_it_handles[resource_name].work,
@@ -195,6 +292,8 @@ int ipa_rm_inactivity_timer_request_resource(
 	spin_lock_irqsave(&ipa_rm_it_handles[resource_name].lock, flags);
 	cancel_delayed_work(&ipa_rm_it_handles[resource_name].work);
 	ipa_rm_it_handles[resource_name].release_in_prog = false;
+	if (ipa_rm_it_handles[resource_name].idle)
+		ipa_rm_it_record_gap(&ipa_rm_it_handles[resource_name]);
 	spin_unlock_irqrestore(&ipa_rm_it_handles[resource_name].lock, flags);
 	ret = ipa_rm_request_resource(resource_name);
 	IPADBG("%s: resource %d: returning %d\n", __func__, resource_name, ret);
@@ -221,6 +320,7 @@ int ipa_rm_inactivity_timer_release_resource(
 				enum ipa_rm_resource_name resource_name)
 {
 	unsigned long flags;
+	unsigned long delay;
 	IPADBG("%s: resource %d\n", __func__, resource_name);
 
 	if (resource_name < 0 ||
@@ -243,13 +343,106 @@ int ipa_rm_inactivity_timer_release_resource(
 		return 0;
 	}
 	ipa_rm_it_handles[resource_name].release_in_prog = true;
+	ipa_rm_it_handles[resource_name].idle = true;
+	ipa_rm_it_handles[resource_name].idle_start = jiffies;
+	if (ipa_rm_it_handles[resource_name].adaptive)
+		delay = ipa_rm_it_adaptive_jiffies(
+			&ipa_rm_it_handles[resource_name]);
+	else
+		delay = ipa_rm_it_handles[resource_name].jiffies;
+	ipa_rm_it_handles[resource_name].curr_jiffies = delay;
 	spin_unlock_irqrestore(&ipa_rm_it_handles[resource_name].lock, flags);
 
 	IPADBG("%s: setting delayed work\n", __func__);
-	schedule_delayed_work(&ipa_rm_it_handles[resource_name].work,
-			      ipa_rm_it_handles[resource_name].jiffies);
+	schedule_delayed_work(&ipa_rm_it_handles[resource_name].work, delay);
 
 	return 0;
 }
 EXPORT_SYMBOL(ipa_rm_inactivity_timer_release_resource);
 
+
+/**
+* ipa_rm_inactivity_timer_set_adaptive() - Selects between the
+* fixed timeout set by ipa_rm_inactivity_timer_init() and a
+* release delay learned from the recent gaps between bursts.
+*
+* @resource_name: Resource name. @see ipa_rm.h
+* @adaptive: true to learn the release delay, false for the fixed
+* timeout
+*
+* Return codes:
+* 0: success
+* -EINVAL: invalid parameters
+*/
+int ipa_rm_inactivity_timer_set_adaptive(
+				enum ipa_rm_resource_name resource_name,
+				bool adaptive)
+{
+	unsigned long flags;
+	IPADBG("%s: resource %d adaptive %d\n", __func__, resource_name,
+		adaptive);
+
+	if (resource_name < 0 ||
+	    resource_name >= IPA_RM_RESOURCE_MAX) {
+		IPAERR("%s: Invalid parameter\n", __func__);
+		return -EINVAL;
+	}
+
+	if (!ipa_rm_it_handles[resource_name].initied) {
+		IPAERR("%s: Not initialized\n", __func__);
+		return -EINVAL;
+	}
+
+	spin_lock_irqsave(&ipa_rm_it_handles[resource_name].lock, flags);
+	ipa_rm_it_handles[resource_name].adaptive = adaptive;
+	spin_unlock_irqrestore(&ipa_rm_it_handles[resource_name].lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL(ipa_rm_inactivity_timer_set_adaptive);
+
+/**
+ * ipa_rm_inactivity_timer_stat() - print inactivity timer stat
+ * @buf: [in] The user buff used to print
+ * @size: [in] The size of buf
+ * Returns: number of bytes used on success, negative on failure
+ *
+ * This function is called by ipa_debugfs in order to show the
+ * idle gap distribution and release delay of every resource
+ */
+int ipa_rm_inactivity_timer_stat(char *buf, int size)
+{
+	struct ipa_rm_it_private *me;
+	unsigned long flags;
+	int i, j, cnt = 0;
+
+	if (!buf || size < 0)
+		return -EINVAL;
+
+	for (i = 0; i < IPA_RM_RESOURCE_MAX; i++) {
+		me = &ipa_rm_it_handles[i];
+		if (!me->initied)
+			continue;
+
+		spin_lock_irqsave(&me->lock, flags);
+		cnt += scnprintf(buf + cnt, size - cnt,
+			"%s: mode=%s timeout=%u ms delay=%u ms samples=%u\n",
+			ipa_rm_resource_str(i),
+			me->adaptive ? "adaptive" : "fixed",
+			jiffies_to_msecs(me->jiffies),
+			jiffies_to_msecs(me->curr_jiffies),
+			me->gap_samples);
+		for (j = 0; j < IPA_RM_IT_HIST_BUCKETS - 1; j++)
+			cnt += scnprintf(buf + cnt, size - cnt,
+				"  gap %u-%u ms: %u\n",
+				IPA_RM_IT_MIN_GAP_MSECS << j,
+				IPA_RM_IT_MIN_GAP_MSECS << (j + 1),
+				me->gap_hist[j]);
+		cnt += scnprintf(buf + cnt, size - cnt,
+			"  gap %u+ ms: %u\n",
+			IPA_RM_IT_MIN_GAP_MSECS << j, me->gap_hist[j]);
+		spin_unlock_irqrestore(&me->lock, flags);
+	}
+
+	return cnt;
+}
@@ -190,6 +190,18 @@ int __ipa_generate_rt_hw_rule_v2_5(enum ipa_ip_type ip,
 	return 0;
 }
 
+/**
+ * ipa_rt_tbl_is_clean() - check whether a rule-set in sys memory can be reused
+ * @tbl: routing table
+ *
+ * Returns:	true if @tbl lives in sys memory and its rule-set did not change
+ *		since it was last generated
+ */
+static bool ipa_rt_tbl_is_clean(struct ipa_rt_tbl *tbl)
+{
+	return tbl->in_sys && !tbl->dirty && tbl->curr_mem.phys_base;
+}
+
 /**
  * ipa_get_rt_hw_tbl_size() - returns the size of HW routing table
  * @ip: the ip address family type
@@ -235,6 +247,10 @@ static int ipa_get_rt_hw_tbl_size(enum ipa_ip_type ip, u32 *hdr_sz,
 	*hdr_sz = (highest_bit_set + 1) * IPA_RT_TABLE_WORD_SIZE;
 	total_sz += *hdr_sz;
 	list_for_each_entry(tbl, &set->head_rt_tbl_list, link) {
+		/* the rule-set in sys memory is reused as is */
+		if (ipa_rt_tbl_is_clean(tbl))
+			continue;
+
 		tbl_sz = 0;
 		list_for_each_entry(entry, &tbl->head_rt_rule_list, link) {
 			res = ipa_ctx->ctrl->ipa_generate_rt_hw_rule(
@@ -324,6 +340,11 @@ static int ipa_generate_rt_hw_tbl_common(enum ipa_ip_type ip, u8 *base, u8 *hdr,
 				body = body + (IPA_RT_TABLE_WORD_SIZE -
 					      ((long)body &
 					      IPA_RT_ENTRY_MEMORY_ALLIGNMENT));
+		} else if (ipa_rt_tbl_is_clean(tbl)) {
+			/* update the hdr at the right index */
+			ipa_write_32(tbl->curr_mem.phys_base,
+					hdr + ((tbl->idx - apps_start_idx) *
+					IPA_RT_TABLE_WORD_SIZE));
 		} else {
 			if (tbl->sz == 0) {
 				IPAERR("cannot generate 0 size table\n");
@@ -373,6 +394,7 @@ static int ipa_generate_rt_hw_tbl_common(enum ipa_ip_type ip, u8 *base, u8 *hdr,
 				tbl->prev_mem = tbl->curr_mem;
 			}
 			tbl->curr_mem = rt_tbl_mem;
+			tbl->dirty = false;
 		}
 	}
 
@@ -987,6 +1009,7 @@ static int __ipa_add_rt_rule(enum ipa_ip_type ip, const char *name,
 	else
 		list_add(&entry->link, &tbl->head_rt_rule_list);
 	tbl->rule_cnt++;
+	tbl->dirty = true;
 	if (entry->hdr)
 		entry->hdr->ref_cnt++;
 	else if (entry->proc_ctx)
@@ -1043,7 +1066,7 @@ int ipa_add_rt_rule(struct ipa_ioc_add_rt_rule *rules)
 	}
 
 	if (rules->commit)
-		if (ipa_ctx->ctrl->ipa_commit_rt(rules->ip)) {
+		if (__ipa_commit_rt(rules->ip)) {
 			ret = -EPERM;
 			goto bail;
 		}
@@ -1078,6 +1101,7 @@ int __ipa_del_rt_rule(u32 rule_hdl)
 		__ipa_release_hdr_proc_ctx(entry->proc_ctx->id);
 	list_del(&entry->link);
 	entry->tbl->rule_cnt--;
+	entry->tbl->dirty = true;
 	IPADBG("del rt rule tbl_idx=%d rule_cnt=%d\n", entry->tbl->idx,
 			entry->tbl->rule_cnt);
 	if (entry->tbl->rule_cnt == 0 && entry->tbl->ref_cnt == 0) {
@@ -1124,7 +1148,7 @@ int ipa_del_rt_rule(struct ipa_ioc_del_rt_rule *hdls)
 	}
 
 	if (hdls->commit)
-		if (ipa_ctx->ctrl->ipa_commit_rt(hdls->ip)) {
+		if (__ipa_commit_rt(hdls->ip)) {
 			ret = -EPERM;
 			goto bail;
 		}
@@ -1162,7 +1186,7 @@ int ipa_commit_rt(enum ipa_ip_type ip)
 		return -EPERM;
 
 	mutex_lock(&ipa_ctx->lock);
-	if (ipa_ctx->ctrl->ipa_commit_rt(ip)) {
+	if (__ipa_commit_rt(ip)) {
 		ret = -EPERM;
 		goto bail;
 	}
@@ -1174,6 +1198,93 @@ bail:
 }
 EXPORT_SYMBOL(ipa_commit_rt);
 
+/**
+ * __ipa_commit_rt() - Commit the SW routing tables of specified type to IPA
+ * HW, or defer the commit to the end of the open commit batch
+ * @ip:	[in] the family of routing tables
+ *
+ * Returns:	0 on success, negative on failure
+ *
+ * caller needs to hold ipa_ctx->lock
+ */
+int __ipa_commit_rt(enum ipa_ip_type ip)
+{
+	if (ipa_ctx->tbl_commit_batch) {
+		set_bit(ip, &ipa_ctx->rt_commit_pending);
+		return 0;
+	}
+
+	return ipa_ctx->ctrl->ipa_commit_rt(ip);
+}
+
+/**
+ * ipa_commit_batch_begin() - Open a batch of filtering and routing changes
+ *
+ * Until the matching ipa_commit_batch_end(), commits of filtering and
+ * routing tables requested by rule changes are not sent to IPA HW, they are
+ * issued once per IP family when the batch is closed. Batches may nest, the
+ * outermost ipa_commit_batch_end() commits.
+ *
+ * Returns:	0 on success, negative on failure
+ *
+ * Note:	Should not be called from atomic context
+ */
+int ipa_commit_batch_begin(void)
+{
+	mutex_lock(&ipa_ctx->lock);
+	ipa_ctx->tbl_commit_batch++;
+	mutex_unlock(&ipa_ctx->lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(ipa_commit_batch_begin);
+
+/**
+ * ipa_commit_batch_end() - Close a batch of filtering and routing changes
+ *
+ * Commits the filtering and routing tables of every IP family that was
+ * changed during the batch, filtering tables first since filtering rules
+ * point to routing tables.
+ *
+ * Returns:	0 on success, negative on failure
+ *
+ * Note:	Should not be called from atomic context
+ */
+int ipa_commit_batch_end(void)
+{
+	enum ipa_ip_type ip;
+	int result = 0;
+
+	mutex_lock(&ipa_ctx->lock);
+	if (ipa_ctx->tbl_commit_batch == 0) {
+		IPAERR("no commit batch is open\n");
+		result = -EINVAL;
+		goto bail;
+	}
+
+	if (--ipa_ctx->tbl_commit_batch)
+		goto bail;
+
+	for (ip = IPA_IP_v4; ip < IPA_IP_MAX; ip++) {
+		if (test_and_clear_bit(ip, &ipa_ctx->flt_commit_pending) &&
+		    ipa_ctx->ctrl->ipa_commit_flt(ip)) {
+			IPAERR("fail to commit flt ip=%d\n", ip);
+			result = -EPERM;
+		}
+		if (test_and_clear_bit(ip, &ipa_ctx->rt_commit_pending) &&
+		    ipa_ctx->ctrl->ipa_commit_rt(ip)) {
+			IPAERR("fail to commit rt ip=%d\n", ip);
+			result = -EPERM;
+		}
+	}
+
+bail:
+	mutex_unlock(&ipa_ctx->lock);
+
+	return result;
+}
+EXPORT_SYMBOL(ipa_commit_batch_end);
+
 /**
  * ipa_reset_rt() - reset the current SW routing table of specified type
  * (does not commit to HW)
@@ -1238,6 +1349,7 @@ int ipa_reset_rt(enum ipa_ip_type ip)
 
 			list_del(&rule->link);
 			tbl->rule_cnt--;
+			tbl->dirty = true;
 			if (rule->hdr)
 				__ipa_release_hdr(rule->hdr->id);
 			else if (rule->proc_ctx)
@@ -1315,7 +1427,7 @@ int ipa_get_rt_tbl(struct ipa_ioc_get_rt_tbl *lookup)
 		lookup->hdl = entry->id;
 
 		/* commit for get */
-		if (ipa_ctx->ctrl->ipa_commit_rt(lookup->ip))
+		if (__ipa_commit_rt(lookup->ip))
 			IPAERR_RL("fail to commit RT tbl\n");
 
 		result = 0;
@@ -1371,7 +1483,7 @@ int ipa_put_rt_tbl(u32 rt_tbl_hdl)
 		if (__ipa_del_rt_tbl(entry))
 			IPAERR_RL("fail to del RT tbl\n");
 		/* commit for put */
-		if (ipa_ctx->ctrl->ipa_commit_rt(ip))
+		if (__ipa_commit_rt(ip))
 			IPAERR_RL("fail to commit RT tbl\n");
 	}
 
@@ -1414,6 +1526,7 @@ static int __ipa_mdfy_rt_rule(struct ipa_rt_rule_mdfy *rtrule)
 
 	entry->rule = rtrule->rule;
 	entry->hdr = hdr;
+	entry->tbl->dirty = true;
 
 	if (entry->hdr)
 		entry->hdr->ref_cnt++;
@@ -1453,7 +1566,7 @@ int ipa_mdfy_rt_rule(struct ipa_ioc_mdfy_rt_rule *hdls)
 	}
 
 	if (hdls->commit)
-		if (ipa_ctx->ctrl->ipa_commit_rt(hdls->ip)) {
+		if (__ipa_commit_rt(hdls->ip)) {
 			result = -EPERM;
 			goto bail;
 		}
@@ -70,11 +70,17 @@
  * @num_dl_packets: number of packets bridged in downink direction
  * bridge
  * @num_lan_packets: number of packets bridged to APPS on bridge mode
+ * @num_ul_hw_bridged: uplink packets sent to IPA on bridge mode without
+ * being seen by the APPS network stack
+ * @num_dl_hw_bridged: downlink packets given to the adapter on bridge mode
+ * without being seen by the APPS network stack
  */
 struct stats {
 	u64 num_ul_packets;
 	u64 num_dl_packets;
 	u64 num_lan_packets;
+	u64 num_ul_hw_bridged;
+	u64 num_dl_hw_bridged;
 };
 
 /**
@@ -168,6 +174,8 @@ static void odu_bridge_teth_cons_cb(void *priv, enum ipa_dp_evt_type evt,
 		} else {
 			ODU_BRIDGE_ERR("No memory\n");
 		}
+	} else {
+		odu_bridge_ctx->stats.num_dl_hw_bridged++;
 	}
 
 	odu_bridge_ctx->send_dl_skb(priv, skb);
@@ -663,6 +671,14 @@ static ssize_t odu_debugfs_stats(struct file *file,
 			    ODU_MAX_MSG_LEN - nbytes,
 			    "LAN packets: %lld\n",
 			    odu_bridge_ctx->stats.num_lan_packets);
+	nbytes += scnprintf(&dbg_buff[nbytes],
+			    ODU_MAX_MSG_LEN - nbytes,
+			    "UL HW bridged packets: %lld\n",
+			    odu_bridge_ctx->stats.num_ul_hw_bridged);
+	nbytes += scnprintf(&dbg_buff[nbytes],
+			    ODU_MAX_MSG_LEN - nbytes,
+			    "DL HW bridged packets: %lld\n",
+			    odu_bridge_ctx->stats.num_dl_hw_bridged);
 	return simple_read_from_buffer(ubuf, count, ppos, dbg_buff, nbytes);
 }
 
@@ -875,6 +891,7 @@ int odu_bridge_tx_dp(struct sk_buff *skb, struct ipa_tx_meta *metadata)
 			goto out;
 		}
 		odu_bridge_ctx->stats.num_ul_packets++;
+		odu_bridge_ctx->stats.num_ul_hw_bridged++;
 		goto out;
 
 	default:
@@ -889,6 +906,119 @@ out:
 }
 EXPORT_SYMBOL(odu_bridge_tx_dp);
 
+/*
+ * In Bridge Mode only QMI packets and IPv6 multicast need the APPS network
+ * stack, all other traffic is bridged by IPA.
+ */
+static bool odu_bridge_is_exception(struct sk_buff *skb)
+{
+	struct ipv6hdr *ipv6hdr = (struct ipv6hdr *)(skb->data + ETH_HLEN);
+
+	return ipv6hdr->version == 6 &&
+		(ODU_BRIDGE_IS_QMI_ADDR(ipv6hdr->daddr) ||
+		 ipv6_addr_is_multicast(&ipv6hdr->daddr));
+}
+
+/*
+ * Send @batch to IPA in Bridge Mode. On failure the packets are put back at
+ * the head of @skbs.
+ */
+static int odu_bridge_tx_hw_bridged(struct sk_buff_head *batch,
+		struct sk_buff_head *skbs)
+{
+	u32 num_pkts = skb_queue_len(batch);
+	int res;
+
+	res = ipa_tx_dp_batch(IPA_CLIENT_ODU_PROD, batch);
+	if (res) {
+		ODU_BRIDGE_DBG("tx dp batch failed %d\n", res);
+		skb_queue_splice(batch, skbs);
+		return res;
+	}
+	odu_bridge_ctx->stats.num_ul_packets += num_pkts;
+	odu_bridge_ctx->stats.num_ul_hw_bridged += num_pkts;
+
+	return 0;
+}
+
+/**
+ * odu_bridge_tx_dp_batch() - Send a batch of skbs to ODU bridge
+ * @skbs: skbs to send, in order
+ * @metadata: metadata applied to all packets
+ *
+ * When no per packet metadata is needed, the batch is sent to IPA with a
+ * single doorbell. In Bridge Mode the control packets which need the APPS
+ * network stack split the batch and go through odu_bridge_tx_dp(), so the
+ * order of the packets is kept. Otherwise every packet goes through
+ * odu_bridge_tx_dp().
+ * Sent packets are removed from @skbs, on failure the packets which were not
+ * sent are left in @skbs.
+ *
+ * Return codes: 0- success, error otherwise
+ */
+int odu_bridge_tx_dp_batch(struct sk_buff_head *skbs,
+		struct ipa_tx_meta *metadata)
+{
+	struct sk_buff_head batch;
+	struct sk_buff *skb;
+	bool no_meta;
+	u32 num_pkts;
+	int res = 0;
+
+	ODU_BRIDGE_FUNC_ENTRY();
+
+	no_meta = !metadata || (!metadata->pkt_init_dst_ep_valid &&
+				!metadata->dma_address_valid);
+
+	if (odu_bridge_ctx->mode == ODU_BRIDGE_MODE_ROUTER && no_meta) {
+		num_pkts = skb_queue_len(skbs);
+		res = ipa_tx_dp_batch(IPA_CLIENT_ODU_PROD, skbs);
+		if (res) {
+			ODU_BRIDGE_DBG("tx dp batch failed %d\n", res);
+			goto out;
+		}
+		odu_bridge_ctx->stats.num_ul_packets += num_pkts;
+		goto out;
+	}
+
+	if (odu_bridge_ctx->mode == ODU_BRIDGE_MODE_BRIDGE && no_meta) {
+		__skb_queue_head_init(&batch);
+		while ((skb = __skb_dequeue(skbs)) != NULL) {
+			if (!odu_bridge_is_exception(skb)) {
+				__skb_queue_tail(&batch, skb);
+				continue;
+			}
+
+			__skb_queue_head(skbs, skb);
+			res = odu_bridge_tx_hw_bridged(&batch, skbs);
+			if (res)
+				goto out;
+
+			skb = __skb_dequeue(skbs);
+			res = odu_bridge_tx_dp(skb, metadata);
+			if (res) {
+				__skb_queue_head(skbs, skb);
+				goto out;
+			}
+		}
+		res = odu_bridge_tx_hw_bridged(&batch, skbs);
+		goto out;
+	}
+
+	while ((skb = __skb_dequeue(skbs)) != NULL) {
+		res = odu_bridge_tx_dp(skb, metadata);
+		if (res) {
+			__skb_queue_head(skbs, skb);
+			break;
+		}
+	}
+
+out:
+	ODU_BRIDGE_FUNC_EXIT();
+	return res;
+}
+EXPORT_SYMBOL(odu_bridge_tx_dp_batch);
+
 static int odu_bridge_add_hdrs(void)
 {
 	struct ipa_ioc_add_hdr *hdrs;
@@ -41,6 +41,8 @@
 #define UL_FILTER_RULE_HANDLE_START 69
 #define DEFAULT_OUTSTANDING_HIGH 64
 #define DEFAULT_OUTSTANDING_LOW 32
+#define NAPI_WEIGHT 60
+#define IPA_WWAN_TX_BATCH_MAX 16 /* max packets posted with one doorbell */
 
 #define IPA_WWAN_DEV_NAME "rmnet_ipa%d"
 #define IPA_WWAN_DEVICE_COUNT (1)
@@ -72,8 +74,11 @@ enum wwan_device_status {
 struct ipa_rmnet_plat_drv_res {
 	bool ipa_rmnet_ssr;
 	bool ipa_loaduC;
+	bool ipa_napi_enable;
 };
 
+static struct ipa_rmnet_plat_drv_res ipa_rmnet_res = {0, };
+
 /**
  * struct wwan_private - WWAN private data
  * @net: network interface struct implemented by this driver
@@ -84,6 +89,8 @@ struct ipa_rmnet_plat_drv_res {
  * @ch_id: channel id
  * @lock: spinlock for mutual exclusion
  * @device_status: holds device status
+ * @napi: NAPI context used to poll the WAN consumer pipe
+ * @tx_batch: uplink packets accepted but not yet posted to IPA
  *
  * WWAN private - holds all relevant info about WWAN driver
  */
@@ -97,6 +104,8 @@ struct wwan_private {
 	spinlock_t lock;
 	struct completion resource_granted_completion;
 	enum wwan_device_status device_status;
+	struct napi_struct napi;
+	struct sk_buff_head tx_batch;
 };
 
 /**
@@ -551,6 +560,8 @@ static int wwan_add_ul_flt_rule_to_ipa(void)
 	param->global = false;
 	param->num_rules = (uint8_t)1;
 
+	/* commit all UL filter rules to IPA HW at once */
+	ipa_commit_batch_begin();
 	for (i = 0; i < num_q6_rule; i++) {
 		param->ip = q6_ul_filter_rule[i].ip;
 		memset(&flt_rule_entry, 0, sizeof(struct ipa_flt_rule_add));
@@ -577,6 +588,10 @@ static int wwan_add_ul_flt_rule_to_ipa(void)
 			q6_ul_filter_rule_hdl[i] = param->rules[0].flt_rule_hdl;
 		}
 	}
+	if (ipa_commit_batch_end()) {
+		retval = -EFAULT;
+		IPAWANERR("commit A7 UL filter rules failed\n");
+	}
 
 	/* send ipa_fltr_installed_notif_req_msg_v01 to Q6*/
 	memset(&req, 0, sizeof(struct ipa_fltr_installed_notif_req_msg_v01));
@@ -625,6 +640,8 @@ static int wwan_del_ul_flt_rule_to_ipa(void)
 	param->commit = 1;
 	param->num_hdls = (uint8_t) 1;
 
+	/* commit the removal of all UL filter rules to IPA HW at once */
+	ipa_commit_batch_begin();
 	for (i = 0; i < old_num_q6_rule; i++) {
 		param->ip = q6_ul_filter_rule[i].ip;
 		memset(&flt_rule_entry, 0, sizeof(struct ipa_flt_rule_del));
@@ -635,10 +652,16 @@ static int wwan_del_ul_flt_rule_to_ipa(void)
 			sizeof(struct ipa_flt_rule_del));
 		if (ipa_del_flt_rule((struct ipa_ioc_del_flt_rule *)param)) {
 			IPAWANERR("del A7 UL filter rule(%d) failed\n", i);
+			ipa_commit_batch_end();
 			kfree(param);
 			return -EFAULT;
 		}
 	}
+	if (ipa_commit_batch_end()) {
+		IPAWANERR("commit del of A7 UL filter rules failed\n");
+		kfree(param);
+		return -EFAULT;
+	}
 
 	/* set UL filter-rule add-indication */
 	a7_ul_flt_set = false;
@@ -895,9 +918,15 @@ static int __ipa_wwan_close(struct net_device *dev)
  */
 static int ipa_wwan_stop(struct net_device *dev)
 {
+	struct wwan_private *wwan_ptr = netdev_priv(dev);
+
 	IPAWANDBG("[%s] ipa_wwan_stop()\n", dev->name);
 	__ipa_wwan_close(dev);
 	netif_stop_queue(dev);
+	/* xmit is quiesced, drop uplink packets which were never posted */
+	atomic_sub(skb_queue_len(&wwan_ptr->tx_batch),
+		&wwan_ptr->outstanding_pkts);
+	__skb_queue_purge(&wwan_ptr->tx_batch);
 	return 0;
 }
 
@@ -911,12 +940,77 @@ static int ipa_wwan_change_mtu(struct net_device *dev, int new_mtu)
 	return 0;
 }
 
+/**
+ * ipa_wwan_tx_more() - Check whether more uplink packets follow
+ *
+ * @dev: network device
+ *
+ * The qdisc keeps calling ipa_wwan_xmit() while it holds packets, so the
+ * doorbell of the current packet may be deferred to one of them.
+ */
+static bool ipa_wwan_tx_more(struct net_device *dev)
+{
+	struct Qdisc *q = netdev_get_tx_queue(dev, 0)->qdisc;
+
+	return q && qdisc_qlen(q) > 0;
+}
+
+/**
+ * ipa_wwan_tx_flush() - Post the accepted uplink packets to IPA
+ *
+ * @dev: network device
+ * @skb: packet of the current xmit call, NULL if there is none
+ *
+ * All packets of the batch are posted with a single doorbell. If posting
+ * fails, @skb is handed back to the stack and the earlier packets of the
+ * batch are dropped.
+ *
+ * Return codes:
+ * NETDEV_TX_OK: batch posted
+ * NETDEV_TX_BUSY: batch not posted, try @skb again later
+ */
+static int ipa_wwan_tx_flush(struct net_device *dev, struct sk_buff *skb)
+{
+	struct wwan_private *wwan_ptr = netdev_priv(dev);
+	struct sk_buff_head *batch = &wwan_ptr->tx_batch;
+	unsigned int bytes = 0;
+	unsigned int pkts;
+	struct sk_buff *iter;
+
+	pkts = skb_queue_len(batch);
+	if (!pkts)
+		return NETDEV_TX_OK;
+
+	skb_queue_walk(batch, iter)
+		bytes += iter->len;
+
+	if (ipa_tx_dp_batch(IPA_CLIENT_APPS_LAN_WAN_PROD, batch)) {
+		if (skb && skb_peek_tail(batch) == skb) {
+			__skb_unlink(skb, batch);
+			atomic_dec(&wwan_ptr->outstanding_pkts);
+			pkts--;
+		}
+		atomic_sub(pkts, &wwan_ptr->outstanding_pkts);
+		dev->stats.tx_dropped += pkts + (skb ? 1 : 0);
+		__skb_queue_purge(batch);
+		return skb ? NETDEV_TX_BUSY : NETDEV_TX_OK;
+	}
+
+	dev->stats.tx_packets += pkts;
+	dev->stats.tx_bytes += bytes;
+	return NETDEV_TX_OK;
+}
+
 /**
  * ipa_wwan_xmit() - Transmits an skb.
  *
  * @skb: skb to be transmitted
  * @dev: network device
  *
+ * Packets are collected while the qdisc holds more of them and posted to
+ * IPA in batches of up to IPA_WWAN_TX_BATCH_MAX packets, one doorbell per
+ * batch.
+ *
  * Return codes:
  * 0: success
  * NETDEV_TX_BUSY: Error while transmitting the skb. Try again
@@ -949,6 +1043,8 @@ static int ipa_wwan_xmit(struct sk_buff *skb, struct net_device *dev)
 		IPAWANDBG
 		("SW filtering out none QMAP packet received from %s",
 		current->comm);
+		if (!ipa_wwan_tx_more(dev))
+			ipa_wwan_tx_flush(dev, NULL);
 		ret = NETDEV_TX_OK;
 		goto out;
 	}
@@ -958,21 +1054,22 @@ static int ipa_wwan_xmit(struct sk_buff *skb, struct net_device *dev)
 					wwan_ptr->outstanding_high) {
 		IPAWANDBG("Outstanding high (%d)- stopping\n",
 				wwan_ptr->outstanding_high);
+		/* nothing may be left unposted once the queue is stopped */
+		ipa_wwan_tx_flush(dev, NULL);
 		netif_stop_queue(dev);
 		ret = NETDEV_TX_BUSY;
 		goto out;
 	}
-	ret = ipa_tx_dp(IPA_CLIENT_APPS_LAN_WAN_PROD, skb, NULL);
-	if (ret) {
-		ret = NETDEV_TX_BUSY;
-		dev->stats.tx_dropped++;
+
+	__skb_queue_tail(&wwan_ptr->tx_batch, skb);
+	atomic_inc(&wwan_ptr->outstanding_pkts);
+	if (ipa_wwan_tx_more(dev) &&
+	    skb_queue_len(&wwan_ptr->tx_batch) < IPA_WWAN_TX_BATCH_MAX) {
+		ret = NETDEV_TX_OK;
 		goto out;
 	}
 
-	atomic_inc(&wwan_ptr->outstanding_pkts);
-	dev->stats.tx_packets++;
-	dev->stats.tx_bytes += skb->len;
-	ret = NETDEV_TX_OK;
+	ret = ipa_wwan_tx_flush(dev, skb);
 
 out:
 	ipa_rm_inactivity_timer_release_resource(
@@ -1027,7 +1124,11 @@ static void apps_ipa_tx_complete_notify(void *priv,
  * @evt: event type
  * @data: data provided with event
  *
- * IPA will pass a packet to the Linux network stack with skb->data
+ * IPA will pass a packet to the Linux network stack with skb->data.
+ * When NAPI is enabled the packet is delivered from the NAPI poll context
+ * through GRO, IPA_CLIENT_START_POLL and IPA_CLIENT_COMP_NAPI drive that
+ * context and IPA_CLIENT_AGGR_END flushes GRO once a whole aggregation frame
+ * was delivered.
  */
 static void apps_ipa_packet_receive_notify(void *priv,
 		enum ipa_dp_evt_type evt,
@@ -1035,8 +1136,23 @@ static void apps_ipa_packet_receive_notify(void *priv,
 {
 	struct sk_buff *skb = (struct sk_buff *)data;
 	struct net_device *dev = (struct net_device *)priv;
+	struct wwan_private *wwan_ptr = netdev_priv(dev);
+	unsigned int len;
 	int result;
 
+	if (evt == IPA_CLIENT_START_POLL) {
+		napi_schedule(&wwan_ptr->napi);
+		return;
+	}
+	if (evt == IPA_CLIENT_COMP_NAPI) {
+		napi_complete(&wwan_ptr->napi);
+		return;
+	}
+	if (evt == IPA_CLIENT_AGGR_END) {
+		napi_gro_flush(&wwan_ptr->napi, false);
+		return;
+	}
+
 	IPAWANDBG("Tx packet was received");
 	if (evt != IPA_RECEIVE) {
 		IPAWANERR("A none IPA_RECEIVE event in wan_ipa_receive\n");
@@ -1045,17 +1161,45 @@ static void apps_ipa_packet_receive_notify(void *priv,
 
 	skb->dev = ipa_netdevs[0];
 	skb->protocol = htons(ETH_P_MAP);
+	/* the stack owns the skb once it is delivered */
+	len = skb->len;
 
-	result = netif_rx(skb);
+	if (ipa_rmnet_res.ipa_napi_enable)
+		result = (napi_gro_receive(&wwan_ptr->napi, skb) == GRO_DROP) ?
+			NET_RX_DROP : NET_RX_SUCCESS;
+	else
+		result = netif_rx(skb);
 	if (result)	{
 		IPAWANERR("fail on netif_rx\n");
 		dev->stats.rx_dropped++;
 	}
 	dev->stats.rx_packets++;
-	dev->stats.rx_bytes += skb->len;
+	dev->stats.rx_bytes += len;
 	return;
 }
 
+/**
+ * ipa_rmnet_poll() - NAPI poll callback of the WAN consumer pipe
+ *
+ * @napi: NAPI context
+ * @budget: maximal number of packets to deliver
+ *
+ * IPA completes the NAPI context itself through IPA_CLIENT_COMP_NAPI when
+ * fewer than @budget packets were pulled from the pipe.
+ */
+static int ipa_rmnet_poll(struct napi_struct *napi, int budget)
+{
+	int rcvd_pkts;
+
+	rcvd_pkts = ipa_rx_poll(ipa_to_apps_hdl, budget);
+	if (rcvd_pkts < 0) {
+		napi_complete(napi);
+		return 0;
+	}
+	IPAWANDBG("rcvd packets: %d\n", rcvd_pkts);
+	return rcvd_pkts;
+}
+
 /**
  * ipa_wwan_ioctl() - I/O control for wwan network driver.
  *
@@ -1364,6 +1508,8 @@ static int ipa_wwan_ioctl(struct net_device *dev, struct ifreq *ifr, int cmd)
 				apps_ipa_packet_receive_notify;
 			ipa_to_apps_ep_cfg.desc_fifo_sz = IPA_SYS_DESC_FIFO_SZ;
 			ipa_to_apps_ep_cfg.priv = dev;
+			ipa_to_apps_ep_cfg.napi_enabled =
+				ipa_rmnet_res.ipa_napi_enable;
 
 			rc = ipa_setup_sys_pipe(
 				&ipa_to_apps_ep_cfg, &ipa_to_apps_hdl);
@@ -1649,8 +1795,6 @@ static struct notifier_block ssr_notifier = {
 	.notifier_call = ssr_notifier_cb,
 };
 
-static struct ipa_rmnet_plat_drv_res ipa_rmnet_res = {0, };
-
 static int get_ipa_rmnet_dts_configuration(struct platform_device *pdev,
 		struct ipa_rmnet_plat_drv_res *ipa_rmnet_drv_res)
 {
@@ -1664,6 +1808,11 @@ static int get_ipa_rmnet_dts_configuration(struct platform_device *pdev,
 			"qcom,ipa-loaduC");
 	IPAWANERR(": IPA ipa-loaduC = %s",
 		ipa_rmnet_drv_res->ipa_loaduC ? "True" : "False");
+	ipa_rmnet_drv_res->ipa_napi_enable =
+			of_property_read_bool(pdev->dev.of_node,
+			"qcom,ipa-napi-enable");
+	IPAWANERR(": IPA napi = %s",
+		ipa_rmnet_drv_res->ipa_napi_enable ? "True" : "False");
 
 	return 0;
 }
@@ -1761,10 +1910,17 @@ static int ipa_wwan_probe(struct platform_device *pdev)
 	wwan_ptr->net = dev;
 	wwan_ptr->outstanding_high = DEFAULT_OUTSTANDING_HIGH;
 	wwan_ptr->outstanding_low = DEFAULT_OUTSTANDING_LOW;
+	skb_queue_head_init(&wwan_ptr->tx_batch);
 	atomic_set(&wwan_ptr->outstanding_pkts, 0);
 	spin_lock_init(&wwan_ptr->lock);
 	init_completion(&wwan_ptr->resource_granted_completion);
 
+	if (ipa_rmnet_res.ipa_napi_enable) {
+		netif_napi_add(dev, &wwan_ptr->napi, ipa_rmnet_poll,
+				NAPI_WEIGHT);
+		napi_enable(&wwan_ptr->napi);
+	}
+
 	if (!atomic_read(&is_ssr)) {
 		/* IPA_RM configuration starts */
 		ret = q6_initialize_rm();
@@ -1870,7 +2026,12 @@ setup_a7_qmap_hdr_err:
 static int ipa_wwan_remove(struct platform_device *pdev)
 {
 	int ret;
+	struct wwan_private *wwan_ptr = netdev_priv(ipa_netdevs[0]);
 
+	if (ipa_rmnet_res.ipa_napi_enable) {
+		napi_disable(&wwan_ptr->napi);
+		netif_napi_del(&wwan_ptr->napi);
+	}
 	unregister_netdev(ipa_netdevs[0]);
 	ret = ipa_rm_delete_dependency(IPA_RM_RESOURCE_WWAN_0_PROD,
 		IPA_RM_RESOURCE_Q6_CONS);
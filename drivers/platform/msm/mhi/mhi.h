@@ -452,6 +452,7 @@ struct mhi_device_ctxt {
 	u32 alloced_ev_rings[EVENT_RINGS_ALLOCATED];
 	u32 ev_ring_props[EVENT_RINGS_ALLOCATED];
 	u32 msi_counter[EVENT_RINGS_ALLOCATED];
+	unsigned long msi_pending;
 	u32 db_mode[MHI_MAX_CHANNELS];
 	u32 uldl_enabled;
 	u32 hw_intmod_rate;
@@ -539,6 +540,7 @@ enum MHI_STATUS get_element_index(struct mhi_ring *ring, void *address,
 							uintptr_t *index);
 enum MHI_STATUS recycle_trb_and_ring(struct mhi_device_ctxt *mhi_dev_ctxt,
 	struct mhi_ring *ring, enum MHI_RING_TYPE ring_type, u32 ring_index);
+void mhi_ring_ev_db(struct mhi_device_ctxt *mhi_dev_ctxt, u32 ev_index);
 enum MHI_STATUS parse_xfer_event(struct mhi_device_ctxt *ctxt,
 					union mhi_event_pkt *event);
 enum MHI_STATUS parse_cmd_event(struct mhi_device_ctxt *ctxt,
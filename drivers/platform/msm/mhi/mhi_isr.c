@@ -34,6 +34,8 @@ irqreturn_t mhi_msi_handlr(int irq_number, void *dev_id)
 	case 0:
 	case 1:
 	case 2:
+		set_bit(IRQ_TO_MSI(mhi_dev_ctxt, irq_number),
+			&mhi_dev_ctxt->msi_pending);
 		atomic_inc(&mhi_dev_ctxt->flags.events_pending);
 		wake_up_interruptible(mhi_dev_ctxt->event_handle);
 		break;
@@ -71,6 +73,8 @@ static enum MHI_STATUS mhi_process_event_ring(
 	struct mhi_event_ctxt *ev_ctxt = NULL;
 	struct mhi_ring *local_ev_ctxt =
 		&mhi_dev_ctxt->mhi_local_event_ctxt[ev_index];
+	bool single_step = (1 == event_quota);
+	bool db_pending = false;
 
 	ev_ctxt = &mhi_dev_ctxt->mhi_ctrl_seg->mhi_ec_list[ev_index];
 
@@ -96,6 +100,12 @@ static enum MHI_STATUS mhi_process_event_ring(
 						MHI_RING_TYPE_EVENT_RING,
 						ev_index)))
 			mhi_log(MHI_MSG_ERROR, "Failed to recycle ev pkt\n");
+		db_pending = true;
+		if (!(mhi_dev_ctxt->ev_counter[ev_index] %
+					MHI_EV_DB_INTERVAL)) {
+			mhi_ring_ev_db(mhi_dev_ctxt, ev_index);
+			db_pending = false;
+		}
 		switch (MHI_TRB_READ_INFO(EV_TRB_TYPE, (&event_to_process))) {
 		case MHI_PKT_TYPE_CMD_COMPLETION_EVENT:
 			mhi_log(MHI_MSG_INFO,
@@ -156,6 +166,13 @@ static enum MHI_STATUS mhi_process_event_ring(
 					(u64)ev_ctxt->mhi_event_read_ptr);
 		--event_quota;
 	}
+	/*
+	 * Give the rest of the batch back to the device in one doorbell
+	 * write. A NAPI poller taking one element per call only does so
+	 * once it has drained the ring.
+	 */
+	if (db_pending && (!single_step || local_rp == device_rp))
+		mhi_ring_ev_db(mhi_dev_ctxt, ev_index);
 	return MHI_STATUS_SUCCESS;
 }
 
@@ -164,6 +181,8 @@ int parse_event_thread(void *ctxt)
 	struct mhi_device_ctxt *mhi_dev_ctxt = ctxt;
 	u32 i = 0;
 	u32 ev_poll_en = 0;
+	u32 ev_msi_vec = 0;
+	unsigned long msi_pending;
 	int ret_val = 0;
 
 	/* Go through all event rings */
@@ -196,10 +215,21 @@ int parse_event_thread(void *ctxt)
 		mhi_dev_ctxt->ev_thread_stopped = 0;
 		atomic_dec(&mhi_dev_ctxt->flags.events_pending);
 
+		/*
+		 * Only walk the rings whose MSI fired; a wakeup without
+		 * one (already consumed, or a kick from the state machine)
+		 * falls back to walking them all.
+		 */
+		msi_pending = xchg(&mhi_dev_ctxt->msi_pending, 0);
 		for (i = 0; i < EVENT_RINGS_ALLOCATED; ++i) {
 			MHI_GET_EVENT_RING_INFO(EVENT_RING_POLLING,
 					mhi_dev_ctxt->ev_ring_props[i],
 					ev_poll_en)
+			MHI_GET_EVENT_RING_INFO(EVENT_RING_MSI_VEC,
+					mhi_dev_ctxt->ev_ring_props[i],
+					ev_msi_vec)
+			if (msi_pending && !(msi_pending & BIT(ev_msi_vec)))
+				continue;
 			if (ev_poll_en) {
 				mhi_process_event_ring(mhi_dev_ctxt,
 				 mhi_dev_ctxt->alloced_ev_rings[i],
@@ -1060,14 +1060,9 @@ enum MHI_STATUS recycle_trb_and_ring(struct mhi_device_ctxt *mhi_dev_ctxt,
 			spinlock_t *lock = NULL;
 			unsigned long flags = 0;
 			lock = &mhi_dev_ctxt->mhi_ev_spinlock_list[ring_index];
+			/* The doorbell is rung once per batch by the caller */
 			spin_lock_irqsave(lock, flags);
 			mhi_dev_ctxt->mhi_ev_db_order[ring_index] = 1;
-			if ((mhi_dev_ctxt->ev_counter[ring_index] %
-						MHI_EV_DB_INTERVAL) == 0) {
-				mhi_process_db(mhi_dev_ctxt,
-						mhi_dev_ctxt->event_db_addr,
-						ring_index, db_value);
-			}
 			mhi_dev_ctxt->ev_counter[ring_index]++;
 			spin_unlock_irqrestore(lock, flags);
 			break;
@@ -1095,6 +1090,28 @@ enum MHI_STATUS recycle_trb_and_ring(struct mhi_device_ctxt *mhi_dev_ctxt,
 	return ret_val;
 }
 
+void mhi_ring_ev_db(struct mhi_device_ctxt *mhi_dev_ctxt, u32 ev_index)
+{
+	spinlock_t *lock = &mhi_dev_ctxt->mhi_ev_spinlock_list[ev_index];
+	struct mhi_ring *ev_ring =
+		&mhi_dev_ctxt->mhi_local_event_ctxt[ev_index];
+	unsigned long flags = 0;
+	u64 db_value = 0;
+
+	atomic_inc(&mhi_dev_ctxt->flags.data_pending);
+	if ((MHI_STATE_M0 == mhi_dev_ctxt->mhi_state ||
+	     MHI_STATE_M1 == mhi_dev_ctxt->mhi_state) &&
+	     mhi_dev_ctxt->flags.link_up) {
+		spin_lock_irqsave(lock, flags);
+		db_value = mhi_v2p_addr(mhi_dev_ctxt->mhi_ctrl_seg_info,
+					(uintptr_t)ev_ring->wp);
+		mhi_process_db(mhi_dev_ctxt, mhi_dev_ctxt->event_db_addr,
+				ev_index, db_value);
+		spin_unlock_irqrestore(lock, flags);
+	}
+	atomic_dec(&mhi_dev_ctxt->flags.data_pending);
+}
+
 enum MHI_STATUS mhi_change_chan_state(struct mhi_device_ctxt *mhi_dev_ctxt,
 				u32 chan_id, enum MHI_CHAN_STATE new_state)
 {
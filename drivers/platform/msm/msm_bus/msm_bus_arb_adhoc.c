@@ -16,6 +16,8 @@
 #include <linux/slab.h>
 #include <linux/mutex.h>
 #include <linux/clk.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
 #include <linux/msm-bus.h>
 #include "msm_bus_core.h"
 #include "msm_bus_adhoc.h"
@@ -41,6 +43,21 @@ struct list_head apply_list;
 
 DEFINE_MUTEX(msm_bus_adhoc_lock);
 
+/*
+ * Bandwidth decreases are held back for commit_defer_ms and flushed
+ * together, so a burst of clients dropping their votes costs one commit
+ * instead of one per vote. Increases are never delayed and flush any
+ * pending decreases of the same context with them. 0 disables deferral.
+ */
+static unsigned int commit_defer_ms;
+module_param(commit_defer_ms, uint, S_IRUGO | S_IWUSR);
+
+static int *deferred_dirty[NUM_CTX];
+static int num_deferred[NUM_CTX];
+
+static void msm_bus_commit_deferred(struct work_struct *work);
+static DECLARE_DELAYED_WORK(commit_work, msm_bus_commit_deferred);
+
 static bool chk_bl_list(struct list_head *black_list, unsigned int id)
 {
 	struct msm_bus_node_device_type *bus_node = NULL;
@@ -528,6 +545,81 @@ static uint64_t get_node_ib(struct msm_bus_node_device_type *bus_dev)
 	return max_ib;
 }
 
+/*
+ * Move the node ids of @src into @dst, skipping the ones already there:
+ * committing a fabric twice in one go would reset its aggregated clock.
+ * @src is freed on success and left untouched on failure.
+ */
+static int merge_dirty_nodes(int **dst, int *num_dst, int *src, int num_src)
+{
+	int *merged;
+	int i, j, n = *num_dst;
+
+	if (!num_src) {
+		kfree(src);
+		return 0;
+	}
+
+	merged = krealloc(*dst, sizeof(int) * (n + num_src), GFP_KERNEL);
+	if (!merged)
+		return -ENOMEM;
+
+	for (i = 0; i < num_src; i++) {
+		for (j = 0; j < n; j++)
+			if (merged[j] == src[i])
+				break;
+		if (j == n)
+			merged[n++] = src[i];
+	}
+
+	kfree(src);
+	*dst = merged;
+	*num_dst = n;
+	return 0;
+}
+
+static void msm_bus_commit_deferred(struct work_struct *work)
+{
+	int ctx;
+
+	mutex_lock(&msm_bus_adhoc_lock);
+	for (ctx = 0; ctx < NUM_CTX; ctx++) {
+		if (!num_deferred[ctx])
+			continue;
+		msm_bus_commit_data(deferred_dirty[ctx], ctx,
+					num_deferred[ctx]);
+		deferred_dirty[ctx] = NULL;
+		num_deferred[ctx] = 0;
+	}
+	mutex_unlock(&msm_bus_adhoc_lock);
+}
+
+static void commit_or_defer(int *dirty_nodes, int num_dirty, int ctx,
+				bool decrease)
+{
+	if (decrease && commit_defer_ms) {
+		if (merge_dirty_nodes(&deferred_dirty[ctx], &num_deferred[ctx],
+					dirty_nodes, num_dirty)) {
+			msm_bus_commit_data(dirty_nodes, ctx, num_dirty);
+			return;
+		}
+		if (num_deferred[ctx])
+			schedule_delayed_work(&commit_work,
+				msecs_to_jiffies(commit_defer_ms));
+		return;
+	}
+
+	if (num_deferred[ctx]) {
+		if (merge_dirty_nodes(&dirty_nodes, &num_dirty,
+				deferred_dirty[ctx], num_deferred[ctx]))
+			msm_bus_commit_data(deferred_dirty[ctx], ctx,
+						num_deferred[ctx]);
+		deferred_dirty[ctx] = NULL;
+		num_deferred[ctx] = 0;
+	}
+	msm_bus_commit_data(dirty_nodes, ctx, num_dirty);
+}
+
 static int update_path(int src, int dest, uint64_t req_ib, uint64_t req_bw,
 			uint64_t cur_ib, uint64_t cur_bw, int src_idx, int ctx)
 {
@@ -541,6 +633,7 @@ static int update_path(int src, int dest, uint64_t req_ib, uint64_t req_bw,
 	int num_dirty = 0;
 	struct rule_update_path_info *rule_node;
 	bool rules_registered = msm_rule_are_rules_registered();
+	ktime_t start = ktime_get();
 
 	src_dev = bus_find_device(&msm_bus_type, NULL,
 				(void *) &src,
@@ -621,13 +714,16 @@ static int update_path(int src, int dest, uint64_t req_ib, uint64_t req_bw,
 		msm_bus_apply_rules(&apply_list, false);
 	}
 
-	msm_bus_commit_data(dirty_nodes, ctx, num_dirty);
+	/* Rules act on the committed state, so never defer under them */
+	commit_or_defer(dirty_nodes, num_dirty, ctx, !rules_registered &&
+				req_ib <= cur_ib && req_bw <= cur_bw);
 
 	if (rules_registered) {
 		msm_bus_apply_rules(&apply_list, true);
 		del_inp_list(&input_list);
 		del_op_list(&apply_list);
 	}
+	msm_bus_dbg_rec_latency(ktime_us_delta(ktime_get(), start));
 exit_update_path:
 	return ret;
 }
@@ -322,6 +322,7 @@ int msm_bus_dbg_add_client(const struct msm_bus_client_handle *pdata);
 int msm_bus_dbg_rec_transaction(const struct msm_bus_client_handle *pdata,
 						u64 ab, u64 ib);
 void msm_bus_dbg_remove_client(const struct msm_bus_client_handle *pdata);
+void msm_bus_dbg_rec_latency(s64 usecs);
 
 #else
 static inline void msm_bus_dbg_client_data(struct msm_bus_scale_pdata *pdata,
@@ -350,6 +351,10 @@ msm_bus_dbg_add_client(const struct msm_bus_client_handle *pdata)
 {
 	return 0;
 }
+
+static inline void msm_bus_dbg_rec_latency(s64 usecs)
+{
+}
 #endif
 
 #ifdef CONFIG_CORESIGHT
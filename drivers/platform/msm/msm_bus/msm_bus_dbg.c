@@ -66,6 +66,14 @@ struct msm_bus_fab_list {
 
 static char *rules_buf;
 
+/*
+ * Histogram of the time taken by adhoc path updates. Bucket i counts the
+ * votes that took [2^(i-1), 2^i) microseconds, the last one everything
+ * slower.
+ */
+#define NUM_LAT_BUCKETS 16
+static unsigned long vote_lat_hist[NUM_LAT_BUCKETS];
+
 LIST_HEAD(fabdata_list);
 LIST_HEAD(cl_list);
 
@@ -676,6 +684,34 @@ static const struct file_operations rules_dbg_fops = {
 	.read		= rules_dbg_read,
 };
 
+/* Called with the adhoc lock held, which serialises the updates */
+void msm_bus_dbg_rec_latency(s64 usecs)
+{
+	int bucket = usecs > 0 ? fls64(usecs) : 0;
+
+	vote_lat_hist[min(bucket, NUM_LAT_BUCKETS - 1)]++;
+}
+
+static ssize_t vote_latency_read(struct file *file, char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	char lat_buf[NUM_LAT_BUCKETS * 32];
+	int i, len = 0;
+
+	for (i = 0; i < NUM_LAT_BUCKETS - 1; i++)
+		len += scnprintf(lat_buf + len, sizeof(lat_buf) - len,
+			"<%lu us: %lu\n", 1UL << i, vote_lat_hist[i]);
+	len += scnprintf(lat_buf + len, sizeof(lat_buf) - len,
+		">=%lu us: %lu\n", 1UL << (i - 1), vote_lat_hist[i]);
+
+	return simple_read_from_buffer(buf, count, ppos, lat_buf, len);
+}
+
+static const struct file_operations vote_latency_fops = {
+	.open		= simple_open,
+	.read		= vote_latency_read,
+};
+
 static int msm_bus_dbg_record_fabric(const char *fabname, struct dentry *file)
 {
 	struct msm_bus_fab_list *fablist;
@@ -857,6 +893,10 @@ static int __init msm_bus_debugfs_init(void)
 		rules_dbg, &val, &rules_dbg_fops) == NULL)
 		goto err;
 
+	if (debugfs_create_file("vote_latency", S_IRUGO, dir, NULL,
+		&vote_latency_fops) == NULL)
+		goto err;
+
 	if (debugfs_create_file("update_request", S_IRUGO | S_IWUSR,
 		shell_client, &val, &shell_client_en_fops) == NULL)
 		goto err;
@@ -113,6 +113,7 @@ struct dentry *dfile_testbus_sel;
 struct dentry *dfile_bam_pipe_sel;
 struct dentry *dfile_desc_option;
 struct dentry *dfile_bam_addr;
+struct dentry *dfile_mem_stats;
 
 static struct sps_bam *phy2bam(phys_addr_t phys_addr);
 
@@ -533,6 +534,40 @@ const struct file_operations sps_bam_addr_ops = {
 	.write = sps_set_bam_addr,
 };
 
+/* output the pipe memory statistics to userspace */
+static ssize_t sps_read_mem_stats(struct file *file, char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	struct sps_mem_stats stats;
+	char buf[512];
+	int nbytes;
+
+	sps_mem_get_stats(&stats);
+
+	nbytes = scnprintf(buf, sizeof(buf),
+		"base:           0x%x\n"
+		"size:           %u\n"
+		"blocks used:    %u\n"
+		"bytes used:     %u\n"
+		"max bytes used: %u\n"
+		"bytes cached:   %u\n"
+		"bytes avail:    %u\n"
+		"cache hits:     %u\n"
+		"cache misses:   %u\n"
+		"alloc failures: %u\n"
+		"frag failures:  %u\n",
+		stats.base_addr, stats.size, stats.blocks_used,
+		stats.bytes_used, stats.max_bytes_used, stats.bytes_cached,
+		stats.bytes_avail, stats.cache_hits, stats.cache_misses,
+		stats.alloc_failures, stats.frag_failures);
+
+	return simple_read_from_buffer(ubuf, count, ppos, buf, nbytes);
+}
+
+const struct file_operations sps_mem_stats_ops = {
+	.read = sps_read_mem_stats,
+};
+
 static void sps_debugfs_init(void)
 {
 	debugfs_record_enabled = false;
@@ -621,10 +656,20 @@ static void sps_debugfs_init(void)
 		goto bam_addr_err;
 	}
 
+	dfile_mem_stats = debugfs_create_file("mem_stats", 0444,
+			dent, 0, &sps_mem_stats_ops);
+	if (!dfile_mem_stats || IS_ERR(dfile_mem_stats)) {
+		pr_err("sps:fail to create the file for debug_fs "
+			"mem_stats.\n");
+		goto mem_stats_err;
+	}
+
 	mutex_init(&sps_debugfs_lock);
 
 	return;
 
+mem_stats_err:
+	debugfs_remove(dfile_bam_addr);
 bam_addr_err:
 	debugfs_remove(dfile_desc_option);
 desc_option_err:
@@ -665,6 +710,8 @@ static void sps_debugfs_exit(void)
 		debugfs_remove(dfile_desc_option);
 	if (dfile_bam_addr)
 		debugfs_remove(dfile_bam_addr);
+	if (dfile_mem_stats)
+		debugfs_remove(dfile_mem_stats);
 	if (dent)
 		debugfs_remove(dent);
 	kfree(debugfs_buf);
@@ -1681,6 +1728,49 @@ int sps_transfer_one(struct sps_pipe *h, phys_addr_t addr, u32 size,
 }
 EXPORT_SYMBOL(sps_transfer_one);
 
+/**
+ * Perform a batch of single-buffer DMA transfers on an SPS connection
+ * end point
+ *
+ */
+int sps_transfer_batch(struct sps_pipe *h, const struct sps_iovec *iovec,
+		       void * const *user, u32 count)
+{
+	struct sps_pipe *pipe = h;
+	struct sps_bam *bam;
+	int result;
+	u32 i;
+
+	SPS_DBG("sps:%s.", __func__);
+
+	if (h == NULL) {
+		SPS_ERR("sps:%s:pipe is NULL.\n", __func__);
+		return SPS_ERROR;
+	} else if (iovec == NULL) {
+		SPS_ERR("sps:%s:iovec list is NULL.\n", __func__);
+		return SPS_ERROR;
+	} else if (count == 0) {
+		SPS_ERR("sps:%s:iovec list is empty.\n", __func__);
+		return SPS_ERROR;
+	}
+
+	for (i = 0; i < count; i++)
+		if (sps_check_iovec_flags(iovec[i].flags))
+			return SPS_ERROR;
+
+	bam = sps_bam_lock(pipe);
+	if (bam == NULL)
+		return SPS_ERROR;
+
+	result = sps_bam_pipe_transfer_batch(bam, pipe->pipe_index, iovec,
+					     user, count);
+
+	sps_bam_unlock(bam);
+
+	return result;
+}
+EXPORT_SYMBOL(sps_transfer_batch);
+
 /**
  * Read event queue for an SPS connection end point
  *
@@ -1868,6 +1958,8 @@ int sps_set_config(struct sps_pipe *h, struct sps_connect *config)
 	if (bam == NULL)
 		return SPS_ERROR;
 
+	pipe->connect.irq_coalesce_usec = config->irq_coalesce_usec;
+	pipe->connect.irq_coalesce_count = config->irq_coalesce_count;
 	result = sps_bam_pipe_set_params(bam, pipe->pipe_index,
 					 config->options);
 	if (result == 0)
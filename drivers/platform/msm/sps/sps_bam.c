@@ -93,6 +93,10 @@ static void pipe_handler(struct sps_bam *dev,
 static void pipe_handler_eot(struct sps_bam *dev,
 			   struct sps_pipe *pipe);
 
+/* Pipe interrupt enable state control */
+static void pipe_set_irq(struct sps_bam *dev, u32 pipe_index,
+				 u32 poll);
+
 /**
  * BAM driver initialization
  */
@@ -118,6 +122,129 @@ int sps_bam_driver_init(u32 options)
 	return 0;
 }
 
+/**
+ * Count descriptors completed since the last moderation poll
+ *
+ * This function reads the pipe's hardware descriptor read offset and returns
+ *    the number of descriptors retired since the previous call.
+ *
+ * @dev - pointer to BAM device descriptor
+ *
+ * @pipe - pointer to pipe state
+ *
+ * @return number of descriptors completed
+ *
+ */
+static u32 pipe_coalesce_progress(struct sps_bam *dev, struct sps_pipe *pipe)
+{
+	u32 offset;
+	u32 delta;
+
+	offset = bam_pipe_get_desc_read_offset(dev->base, pipe->pipe_index);
+	if (offset >= pipe->coalesce.offset)
+		delta = offset - pipe->coalesce.offset;
+	else
+		delta = pipe->desc_size - pipe->coalesce.offset + offset;
+	pipe->coalesce.offset = offset;
+
+	return delta / sizeof(struct sps_iovec);
+}
+
+/**
+ * Enter interrupt moderation polling for a BAM pipe
+ *
+ * This function is called after a pipe's interrupt sources have been handled.
+ *    If moderation is enabled, the pipe's interrupt is masked and completions
+ *    are polled from the moderation timer until the pipe goes quiet.
+ *    The caller of this function must hold the BAM device's ISR lock.
+ *
+ * @dev - pointer to BAM device descriptor
+ *
+ * @pipe - pointer to pipe state
+ *
+ */
+static void pipe_coalesce_start(struct sps_bam *dev, struct sps_pipe *pipe)
+{
+	if (pipe->coalesce.active || pipe->polled ||
+	    ktime_to_ns(pipe->coalesce.period) == 0)
+		return;
+
+	bam_pipe_set_irq(dev->base, pipe->pipe_index, BAM_DISABLE,
+			 pipe->irq_mask, dev->props.ee);
+	pipe->coalesce.offset =
+		bam_pipe_get_desc_read_offset(dev->base, pipe->pipe_index);
+	pipe->coalesce.active = true;
+	hrtimer_start(&pipe->coalesce.timer, pipe->coalesce.period,
+		      HRTIMER_MODE_REL);
+}
+
+/**
+ * Interrupt moderation timer
+ *
+ * This function polls a moderated pipe for completed descriptors.  The pipe
+ *    stays in polling mode while at least the configured number of
+ *    descriptors complete per period, otherwise its interrupt is re-enabled.
+ *
+ * @timer - pointer to the pipe's moderation timer
+ *
+ * @return HRTIMER_RESTART to keep polling, HRTIMER_NORESTART otherwise
+ *
+ */
+static enum hrtimer_restart pipe_coalesce_timer(struct hrtimer *timer)
+{
+	struct sps_pipe *pipe = container_of(timer, struct sps_pipe,
+					     coalesce.timer);
+	struct sps_bam *dev = pipe->bam;
+	enum hrtimer_restart ret = HRTIMER_NORESTART;
+	unsigned long flags;
+	u32 done;
+
+	spin_lock_irqsave(&dev->isr_lock, flags);
+
+	if (!pipe->coalesce.active || pipe->disconnecting)
+		goto out;
+
+	done = pipe_coalesce_progress(dev, pipe);
+	pipe_handler(dev, pipe);
+	if (!pipe->sys.no_queue)
+		pipe_handler_eot(dev, pipe);
+#ifdef SPS_BAM_STATISTICS
+	pipe->coalesce.polls++;
+#endif /* SPS_BAM_STATISTICS */
+
+	if (done >= pipe->coalesce.count) {
+		hrtimer_forward_now(timer, pipe->coalesce.period);
+		ret = HRTIMER_RESTART;
+	} else {
+		/* Pipe went quiet, hand completions back to the interrupt */
+		pipe->coalesce.active = false;
+		pipe_set_irq(dev, pipe->pipe_index, pipe->polled);
+#ifdef SPS_BAM_STATISTICS
+		pipe->coalesce.irq_rearms++;
+#endif /* SPS_BAM_STATISTICS */
+	}
+
+out:
+	spin_unlock_irqrestore(&dev->isr_lock, flags);
+
+	return ret;
+}
+
+/**
+ * Stop interrupt moderation for a BAM pipe
+ *
+ * This function cancels the moderation timer.  The caller must not hold the
+ *    BAM device's ISR lock.
+ *
+ * @pipe - pointer to pipe state
+ *
+ */
+static void pipe_coalesce_stop(struct sps_pipe *pipe)
+{
+	hrtimer_cancel(&pipe->coalesce.timer);
+	pipe->coalesce.active = false;
+}
+
 /*
  * Check BAM interrupt
  */
@@ -169,6 +296,7 @@ polling:
 				&& (source & pipe->pipe_index_mask)) {
 			/* This pipe has an interrupt pending */
 			pipe_handler(dev, pipe);
+			pipe_coalesce_start(dev, pipe);
 			source &= ~pipe->pipe_index_mask;
 		}
 		if (source == 0)
@@ -666,6 +794,9 @@ static void pipe_clear(struct sps_pipe *pipe)
 	pipe->late_eot = false;
 	memset(&pipe->sys, 0, sizeof(pipe->sys));
 	INIT_LIST_HEAD(&pipe->sys.events_q);
+	memset(&pipe->coalesce, 0, sizeof(pipe->coalesce));
+	hrtimer_init(&pipe->coalesce.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	pipe->coalesce.timer.function = pipe_coalesce_timer;
 }
 
 /**
@@ -1024,6 +1155,7 @@ int sps_bam_pipe_disconnect(struct sps_bam *dev, u32 pipe_index)
 	/* Deallocate and reset the BAM pipe */
 	pipe = dev->pipes[pipe_index];
 	if (BAM_PIPE_IS_ASSIGNED(pipe)) {
+		pipe_coalesce_stop(pipe);
 		if ((dev->pipe_active_mask & (1UL << pipe_index))) {
 			list_del(&pipe->list);
 			dev->pipe_active_mask &= ~(1UL << pipe_index);
@@ -1132,6 +1264,17 @@ int sps_bam_pipe_set_params(struct sps_bam *dev, u32 pipe_index, u32 options)
 	pipe->hybrid = options & SPS_O_HYBRID;
 	pipe->late_eot = options & SPS_O_LATE_EOT;
 
+	/* Is client setting invalid interrupt moderation parameters? */
+	if ((options & SPS_O_IRQ_COALESCE) &&
+	    (pipe->connect.irq_coalesce_usec == 0 ||
+	     (pipe->state & (BAM_STATE_BAM2BAM | BAM_STATE_MTI)))) {
+		SPS_ERR(
+			"sps:Invalid IRQ moderation: BAM %pa pipe %d opt 0x%x usec %d\n",
+			BAM_ID(dev), pipe_index, options,
+			pipe->connect.irq_coalesce_usec);
+		return SPS_ERROR;
+	}
+
 	/* Create interrupt source mask */
 	mask = 0;
 	for (n = 0; n < ARRAY_SIZE(opt_event_table); n++) {
@@ -1216,6 +1359,23 @@ int sps_bam_pipe_set_params(struct sps_bam *dev, u32 pipe_index, u32 options)
 	 * failure, so no free() handling is needed.
 	 */
 
+	/* Restart interrupt moderation with the new parameters */
+	pipe_coalesce_stop(pipe);
+	if ((options & SPS_O_IRQ_COALESCE) &&
+	    (mask & (SPS_O_EOT | SPS_O_DESC_DONE))) {
+		pipe->coalesce.period =
+			ns_to_ktime((u64)pipe->connect.irq_coalesce_usec *
+				    NSEC_PER_USEC);
+		pipe->coalesce.count =
+			max_t(u32, pipe->connect.irq_coalesce_count, 1);
+		SPS_DBG2("sps:BAM %pa pipe %d IRQ moderation %d usec %d desc\n",
+			BAM_ID(dev), pipe_index,
+			pipe->connect.irq_coalesce_usec,
+			pipe->coalesce.count);
+	} else {
+		pipe->coalesce.period = ktime_set(0, 0);
+	}
+
 	/* Enable/disable the pipe's interrupt sources */
 	pipe->irq_mask = mask;
 	pipe_set_irq(dev, pipe_index, (options & SPS_O_POLL));
@@ -1496,6 +1656,79 @@ int sps_bam_pipe_transfer(struct sps_bam *dev,
 	return 0;
 }
 
+/**
+ * Submit a batch of buffers to a BAM pipe
+ *
+ */
+int sps_bam_pipe_transfer_batch(struct sps_bam *dev, u32 pipe_index,
+				const struct sps_iovec *iovec,
+				void * const *user, u32 count)
+{
+	struct sps_pipe *pipe = dev->pipes[pipe_index];
+	u32 free_count;
+	u32 flags;
+	u32 n;
+	int result;
+
+	if (count == 0) {
+		SPS_ERR("sps:iovec count zero: BAM %pa pipe %d\n",
+			BAM_ID(dev), pipe_index);
+		return SPS_ERROR;
+	}
+
+	/*
+	 * Reject anything sps_bam_pipe_transfer_one() would refuse before
+	 * the first descriptor is written, so a batch is queued entirely or
+	 * not at all.
+	 */
+	if ((pipe->state & (BAM_STATE_BAM2BAM | BAM_STATE_REMOTE))) {
+		SPS_ERR("sps:Transfer on BAM-to-BAM: BAM %pa pipe %d\n",
+			BAM_ID(dev), pipe_index);
+		return SPS_ERROR;
+	}
+
+	if (pipe->sys.no_queue && user != NULL) {
+		SPS_ERR("sps:User pointer arg non-NULL: BAM %pa pipe %d\n",
+			BAM_ID(dev), pipe_index);
+		return SPS_ERROR;
+	}
+
+	if (!pipe->sys.ack_xfers && pipe->polled) {
+		sps_bam_pipe_get_unused_desc_num(dev, pipe_index,
+					&free_count);
+		free_count = pipe->desc_size - free_count - 1;
+	} else
+		sps_bam_get_free_count(dev, pipe_index, &free_count);
+
+	if (free_count < count) {
+		SPS_DBG2("sps:Insufficient free desc: BAM %pa pipe %d: %d\n",
+			BAM_ID(dev), pipe_index, free_count);
+		return SPS_ERROR;
+	}
+
+	/* Only the last descriptor writes the pipe event register */
+	for (n = 0; n < count; n++) {
+		flags = iovec[n].flags;
+		if (n < count - 1)
+			flags |= SPS_IOVEC_FLAG_NO_SUBMIT;
+
+		result = sps_bam_pipe_transfer_one(dev, pipe_index,
+						 iovec[n].addr,
+						 iovec[n].size,
+						 user ? user[n] : NULL,
+						 flags);
+		if (result) {
+			/* Hand over whatever was queued so far */
+			wmb(); /* Memory Barrier */
+			bam_pipe_set_desc_write_offset(dev->base, pipe_index,
+						       pipe->sys.desc_offset);
+			return SPS_ERROR;
+		}
+	}
+
+	return 0;
+}
+
 /**
  * Allocate an event tracking struct
  *
@@ -23,6 +23,7 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
+#include <linux/hrtimer.h>
 
 #include "spsi.h"
 
@@ -159,6 +160,19 @@ struct sps_bam_sys_mode {
 #endif /* SPS_BAM_STATISTICS */
 };
 
+/* Interrupt moderation control */
+struct sps_bam_coalesce {
+	struct hrtimer timer;	/* Poll period timer */
+	ktime_t period;		/* Poll period, zero if moderation is off */
+	u32 count;		/* Descriptor threshold for staying in poll */
+	u32 offset;		/* Descriptor read offset at last poll */
+	bool active;		/* Pipe IRQ masked and timer running */
+#ifdef SPS_BAM_STATISTICS
+	u32 polls;
+	u32 irq_rearms;
+#endif /* SPS_BAM_STATISTICS */
+};
+
 /* BAM pipe descriptor */
 struct sps_pipe {
 	struct list_head list;
@@ -186,6 +200,9 @@ struct sps_pipe {
 	/* System mode control */
 	struct sps_bam_sys_mode sys;
 
+	/* Interrupt moderation control */
+	struct sps_bam_coalesce coalesce;
+
 	bool disconnecting;
 };
 
@@ -451,6 +468,30 @@ int sps_bam_pipe_transfer_one(struct sps_bam *dev, u32 pipe_index, u32 addr,
 int sps_bam_pipe_transfer(struct sps_bam *dev, u32 pipe_index,
 			 struct sps_transfer *transfer);
 
+/**
+ * Submit a batch of buffers to a BAM pipe
+ *
+ * This function queues count descriptors, each with its own user
+ * pointer, and writes the pipe event register once after the last
+ * one.
+ *
+ * @dev - pointer to BAM device descriptor
+ *
+ * @pipe_index - pipe index
+ *
+ * @iovec - array of count descriptors
+ *
+ * @user - array of count user pointers, or NULL
+ *
+ * @count - number of descriptors
+ *
+ * @return 0 on success, negative value on error
+ *
+ */
+int sps_bam_pipe_transfer_batch(struct sps_bam *dev, u32 pipe_index,
+				const struct sps_iovec *iovec,
+				void * const *user, u32 count);
+
 /**
  * Get a BAM pipe event
  *
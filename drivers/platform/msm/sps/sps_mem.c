@@ -21,6 +21,7 @@
 #include <linux/list.h>		/* list_head */
 #include <linux/genalloc.h>	/* gen_pool_alloc() */
 #include <linux/errno.h>	/* ENOMEM */
+#include <linux/spinlock.h>	/* spinlock_t */
 
 #include "sps_bam.h"
 #include "spsi.h"
@@ -36,6 +37,123 @@ static u32 nid = 0xaa;
 static u32 total_alloc;
 static u32 total_free;
 
+/*
+ * Cache of freed pipe-memory blocks.  Pipes are usually reconnected with the
+ * same FIFO sizes, so a freed block is parked here and handed out again on
+ * the next allocation of the same size instead of going back to the gen_pool.
+ */
+#define SPS_MEM_CACHE_MAX	16
+
+struct sps_mem_cache_entry {
+	phys_addr_t phys_addr;
+	u32 bytes;	/* zero if the entry is unused */
+};
+
+static struct sps_mem_cache_entry mem_cache[SPS_MEM_CACHE_MAX];
+static DEFINE_SPINLOCK(mem_cache_lock);
+
+/* Statistics */
+static u32 blocks_used;
+static u32 bytes_used;
+static u32 max_bytes_used;
+static u32 bytes_cached;
+static u32 cache_hits;
+static u32 cache_misses;
+static u32 alloc_failures;
+static u32 frag_failures;
+
+/**
+ * Take a block of the requested size out of the free block cache
+ *
+ * @bytes - block size
+ *
+ * @return physical address of the block, or SPS_ADDR_INVALID on a miss
+ *
+ */
+static phys_addr_t sps_mem_cache_get(u32 bytes)
+{
+	phys_addr_t phys_addr = SPS_ADDR_INVALID;
+	unsigned long flags;
+	int n;
+
+	spin_lock_irqsave(&mem_cache_lock, flags);
+	for (n = 0; n < SPS_MEM_CACHE_MAX; n++) {
+		if (mem_cache[n].bytes != bytes)
+			continue;
+
+		phys_addr = mem_cache[n].phys_addr;
+		mem_cache[n].bytes = 0;
+		bytes_cached -= bytes;
+		break;
+	}
+	if (phys_addr == SPS_ADDR_INVALID)
+		cache_misses++;
+	else
+		cache_hits++;
+	spin_unlock_irqrestore(&mem_cache_lock, flags);
+
+	return phys_addr;
+}
+
+/**
+ * Park a freed block in the free block cache
+ *
+ * @phys_addr - physical address of the block
+ *
+ * @bytes - block size
+ *
+ * @return true if the block was cached, false if the cache is full
+ *
+ */
+static bool sps_mem_cache_put(phys_addr_t phys_addr, u32 bytes)
+{
+	unsigned long flags;
+	bool cached = false;
+	int n;
+
+	spin_lock_irqsave(&mem_cache_lock, flags);
+	for (n = 0; n < SPS_MEM_CACHE_MAX; n++) {
+		if (mem_cache[n].bytes != 0)
+			continue;
+
+		mem_cache[n].phys_addr = phys_addr;
+		mem_cache[n].bytes = bytes;
+		bytes_cached += bytes;
+		cached = true;
+		break;
+	}
+	spin_unlock_irqrestore(&mem_cache_lock, flags);
+
+	return cached;
+}
+
+/**
+ * Return all cached blocks to the gen_pool
+ *
+ * This is done when an allocation cannot be satisfied from the gen_pool,
+ * so that cached blocks of other sizes never starve a new connection.
+ *
+ */
+static void sps_mem_cache_flush(void)
+{
+	struct sps_mem_cache_entry entry;
+	unsigned long flags;
+	int n;
+
+	for (n = 0; n < SPS_MEM_CACHE_MAX; n++) {
+		spin_lock_irqsave(&mem_cache_lock, flags);
+		entry = mem_cache[n];
+		mem_cache[n].bytes = 0;
+		bytes_cached -= entry.bytes;
+		spin_unlock_irqrestore(&mem_cache_lock, flags);
+
+		if (entry.bytes)
+			gen_pool_free(pool, (uintptr_t) iomem_virt +
+				      (entry.phys_addr - iomem_phys),
+				      entry.bytes);
+	}
+}
+
 /**
  * Translate physical to virtual address
  *
@@ -64,16 +182,36 @@ phys_addr_t sps_mem_alloc_io(u32 bytes)
 	phys_addr_t phys_addr = SPS_ADDR_INVALID;
 	unsigned long virt_addr = 0;
 
+	phys_addr = sps_mem_cache_get(bytes);
+	if (phys_addr != SPS_ADDR_INVALID) {
+		iomem_offset = phys_addr - iomem_phys;
+		virt_addr = (uintptr_t) iomem_virt + iomem_offset;
+		goto done;
+	}
+
 	virt_addr = gen_pool_alloc(pool, bytes);
+	if (!virt_addr && bytes_cached) {
+		sps_mem_cache_flush();
+		virt_addr = gen_pool_alloc(pool, bytes);
+	}
 	if (virt_addr) {
 		iomem_offset = virt_addr - (uintptr_t) iomem_virt;
 		phys_addr = iomem_phys + iomem_offset;
-		total_alloc += bytes;
 	} else {
+		alloc_failures++;
+		if (gen_pool_avail(pool) >= bytes)
+			frag_failures++;
 		SPS_ERR("sps:gen_pool_alloc %d bytes fail.", bytes);
 		return SPS_ADDR_INVALID;
 	}
 
+done:
+	total_alloc += bytes;
+	blocks_used++;
+	bytes_used += bytes;
+	if (bytes_used > max_bytes_used)
+		max_bytes_used = bytes_used;
+
 	SPS_DBG2("sps:sps_mem_alloc_io.phys=%pa.virt=0x%lx.size=0x%x.",
 		&phys_addr, virt_addr, bytes);
 
@@ -94,8 +232,30 @@ void sps_mem_free_io(phys_addr_t phys_addr, u32 bytes)
 	SPS_DBG2("sps:sps_mem_free_io.phys=%pa.virt=0x%lx.size=0x%x.",
 		&phys_addr, virt_addr, bytes);
 
-	gen_pool_free(pool, virt_addr, bytes);
+	if (!sps_mem_cache_put(phys_addr, bytes))
+		gen_pool_free(pool, virt_addr, bytes);
 	total_free += bytes;
+	blocks_used--;
+	bytes_used -= bytes;
+}
+
+/**
+ * Get pipe memory statistics
+ *
+ */
+void sps_mem_get_stats(struct sps_mem_stats *stats)
+{
+	stats->base_addr = (u32) iomem_phys;
+	stats->size = iomem_size;
+	stats->blocks_used = blocks_used;
+	stats->bytes_used = bytes_used;
+	stats->max_bytes_used = max_bytes_used;
+	stats->bytes_cached = bytes_cached;
+	stats->bytes_avail = pool ? (u32) gen_pool_avail(pool) : 0;
+	stats->cache_hits = cache_hits;
+	stats->cache_misses = cache_misses;
+	stats->alloc_failures = alloc_failures;
+	stats->frag_failures = frag_failures;
 }
 
 /**
@@ -152,6 +312,9 @@ int sps_mem_init(phys_addr_t pipemem_phys_base, u32 pipemem_size)
  */
 int sps_mem_de_init(void)
 {
+	if (pool != NULL)
+		sps_mem_cache_flush();
+
 	if (iomem_virt != NULL) {
 		gen_pool_destroy(pool);
 		pool = NULL;
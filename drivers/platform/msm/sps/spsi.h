@@ -178,6 +178,12 @@ struct sps_mem_stats {
 	u32 blocks_used;
 	u32 bytes_used;
 	u32 max_bytes_used;
+	u32 bytes_cached;	/* Freed blocks parked for reuse */
+	u32 bytes_avail;	/* Free bytes left in the heap */
+	u32 cache_hits;
+	u32 cache_misses;
+	u32 alloc_failures;
+	u32 frag_failures;	/* Failures with enough free, but split, bytes */
 };
 
 enum sps_bam_type {
@@ -246,6 +252,16 @@ phys_addr_t sps_mem_alloc_io(u32 bytes);
  */
 void sps_mem_free_io(phys_addr_t phys_addr, u32 bytes);
 
+/**
+ * Get I/O (pipe) memory statistics
+ *
+ * This function reports pipe memory usage, reuse of cached FIFO blocks and
+ * fragmentation of the pipe memory heap.
+ *
+ * @stats - pointer to statistics struct to fill in
+ */
+void sps_mem_get_stats(struct sps_mem_stats *stats);
+
 /**
  * Find matching connection mapping
  *
@@ -175,6 +175,8 @@ struct bcl_context {
 	struct bcl_threshold vbat_high_thresh;
 	struct bcl_threshold vbat_low_thresh;
 	uint32_t bcl_p_freq_max;
+	/* Interval of the graded release of the mitigation, 0 to disable */
+	uint32_t bcl_recovery_step_ms;
 };
 
 enum bcl_threshold_state {
@@ -192,6 +194,19 @@ static struct work_struct bcl_hotplug_work;
 static DEFINE_MUTEX(bcl_hotplug_mutex);
 static bool bcl_hotplug_enabled;
 
+/*
+ * Once the mitigation clears, the cap is released in BCL_RECOVERY_STEPS
+ * steps from the mitigation frequency up to the policy maximum.  Level
+ * BCL_RECOVERY_STEPS means no cap at all.
+ */
+#define BCL_RECOVERY_STEPS	8
+static unsigned int bcl_recovery_level = BCL_RECOVERY_STEPS;
+static void bcl_recovery_step(struct work_struct *work);
+static DECLARE_DELAYED_WORK(bcl_recovery_work, bcl_recovery_step);
+static DEFINE_MUTEX(bcl_recovery_mutex);
+/* Per cluster mitigation frequency, 0 to use the common one */
+static DEFINE_PER_CPU(uint32_t, bcl_cpu_freq_max);
+
 #ifdef CONFIG_SMP
 static void __ref bcl_handle_hotplug(struct work_struct *work)
 {
@@ -268,19 +283,43 @@ static struct notifier_block __refdata bcl_cpu_notifier = {
 	.notifier_call = bcl_cpu_ctrl_callback,
 };
 
+static bool bcl_mitigation_active(void)
+{
+	return bcl_vph_state == BCL_LOW_THRESHOLD
+		&& bcl_ibat_state == BCL_HIGH_THRESHOLD;
+}
+
+static uint32_t bcl_recovery_freq(struct cpufreq_policy *policy,
+		uint32_t mitig_freq, unsigned int level)
+{
+	uint32_t max_freq = policy->cpuinfo.max_freq;
+
+	if (mitig_freq >= max_freq)
+		return mitig_freq;
+
+	return mitig_freq + (max_freq - mitig_freq) * level
+			/ BCL_RECOVERY_STEPS;
+}
+
 static int bcl_cpufreq_callback(struct notifier_block *nfb,
 		unsigned long event, void *data)
 {
 	struct cpufreq_policy *policy = data;
 	uint32_t max_freq = UINT_MAX;
+	unsigned int level = ACCESS_ONCE(bcl_recovery_level);
 
 	switch (event) {
 	case CPUFREQ_INCOMPATIBLE:
-		if (bcl_vph_state == BCL_LOW_THRESHOLD
-			&& bcl_ibat_state == BCL_HIGH_THRESHOLD) {
+		if (bcl_mitigation_active())
+			level = 0;
+		if (level < BCL_RECOVERY_STEPS) {
 			max_freq = (gbcl->bcl_monitor_type
 				== BCL_IBAT_MONITOR_TYPE) ? gbcl->btm_freq_max
 				: gbcl->bcl_p_freq_max;
+			if (per_cpu(bcl_cpu_freq_max, policy->cpu))
+				max_freq = per_cpu(bcl_cpu_freq_max,
+						policy->cpu);
+			max_freq = bcl_recovery_freq(policy, max_freq, level);
 			pr_debug("Requesting Max freq:%d for CPU%d\n",
 				max_freq, policy->cpu);
 			cpufreq_verify_within_limits(policy, 0,
@@ -421,12 +460,66 @@ static void bcl_iavail_work(struct work_struct *work)
 	}
 }
 
+/*
+ * Step the cap up towards the policy maximum.  The more the battery
+ * current is below the high threshold, the bigger the step, and no step
+ * is taken while it is still above it.
+ */
+static void bcl_recovery_step(struct work_struct *work)
+{
+	int ibat = 0, span, step = 1;
+
+	mutex_lock(&bcl_recovery_mutex);
+	if (bcl_mitigation_active()
+		|| bcl_recovery_level >= BCL_RECOVERY_STEPS) {
+		mutex_unlock(&bcl_recovery_mutex);
+		return;
+	}
+
+	span = gbcl->ibat_high_thresh.trip_value
+		- gbcl->ibat_low_thresh.trip_value;
+	if (span > 0 && !msm_bcl_read(BCL_PARAM_CURRENT, &ibat)) {
+		if (ibat >= gbcl->ibat_high_thresh.trip_value)
+			step = 0;
+		else
+			step = 1 + (gbcl->ibat_high_thresh.trip_value - ibat)
+				/ span;
+	}
+	bcl_recovery_level = min_t(unsigned int, bcl_recovery_level + step,
+			BCL_RECOVERY_STEPS);
+	pr_debug("Ibat:%d recovery level:%u\n", ibat, bcl_recovery_level);
+	if (bcl_recovery_level < BCL_RECOVERY_STEPS)
+		schedule_delayed_work(&bcl_recovery_work,
+			msecs_to_jiffies(gbcl->bcl_recovery_step_ms));
+	mutex_unlock(&bcl_recovery_mutex);
+
+	if (step)
+		update_cpu_freq();
+}
+
+static void bcl_update_mitigation(void)
+{
+	mutex_lock(&bcl_recovery_mutex);
+	if (bcl_mitigation_active()) {
+		cancel_delayed_work(&bcl_recovery_work);
+		bcl_recovery_level = 0;
+	} else if (!bcl_recovery_level && gbcl->bcl_recovery_step_ms) {
+		schedule_delayed_work(&bcl_recovery_work,
+			msecs_to_jiffies(gbcl->bcl_recovery_step_ms));
+	} else if (!delayed_work_pending(&bcl_recovery_work)) {
+		bcl_recovery_level = BCL_RECOVERY_STEPS;
+	}
+	mutex_unlock(&bcl_recovery_mutex);
+
+	update_cpu_freq();
+}
+
 static void bcl_ibat_notify(enum bcl_threshold_state thresh_type)
 {
 	if (bcl_hotplug_enabled)
 		schedule_work(&bcl_hotplug_work);
 	bcl_ibat_state = thresh_type;
-	update_cpu_freq();
+	bcl_update_mitigation();
 }
 
 static void bcl_vph_notify(enum bcl_threshold_state thresh_type)
@@ -434,7 +527,7 @@ static void bcl_vph_notify(enum bcl_threshold_state thresh_type)
 	if (bcl_hotplug_enabled)
 		schedule_work(&bcl_hotplug_work);
 	bcl_vph_state = thresh_type;
-	update_cpu_freq();
+	bcl_update_mitigation();
 }
 
 int bcl_voltage_notify(bool is_high_thresh)
@@ -1401,6 +1494,38 @@ vdd_rstr_exit:
 	return;
 }
 
+/*
+ * qcom,cluster-mitigation-freq-khz lists <cpu-mask frequency> pairs for
+ * clusters that can be capped less hard than the common
+ * qcom,mitigation-freq-khz.
+ */
+static void probe_cluster_freq(struct bcl_context *bcl,
+		struct device_node *ibat_node)
+{
+	char *key = "qcom,cluster-mitigation-freq-khz";
+	uint32_t mask = 0, freq = 0;
+	int len = 0, i, cpu;
+
+	if (!of_find_property(ibat_node, key, &len))
+		return;
+	len /= sizeof(uint32_t);
+	if (len % 2) {
+		pr_err("Invalid %s length:%d\n", key, len);
+		return;
+	}
+
+	for (i = 0; i < len; i += 2) {
+		if (of_property_read_u32_index(ibat_node, key, i, &mask)
+			|| of_property_read_u32_index(ibat_node, key, i + 1,
+				&freq))
+			return;
+		freq = max(freq, bcl->thermal_freq_limit);
+		for_each_possible_cpu(cpu)
+			if (mask & BIT(cpu))
+				per_cpu(bcl_cpu_freq_max, cpu) = freq;
+	}
+}
+
 static int probe_bcl_periph_prop(struct bcl_context *bcl)
 {
 	int ret = 0;
@@ -1434,6 +1559,9 @@ static int probe_bcl_periph_prop(struct bcl_context *bcl)
 		= bcl->ibat_low_thresh.trip_data = (void *) bcl;
 	get_vdd_rstr_freq(bcl, ibat_node);
 	bcl->bcl_p_freq_max = max(bcl->bcl_p_freq_max, bcl->thermal_freq_limit);
+	probe_cluster_freq(bcl, ibat_node);
+	key = "qcom,recovery-step-ms";
+	of_property_read_u32(ibat_node, key, &bcl->bcl_recovery_step_ms);
 
 	bcl->btm_mode = BCL_MONITOR_DISABLED;
 	bcl->bcl_monitor_type = BCL_IBAT_PERIPH_MONITOR_TYPE;
@@ -38,8 +38,10 @@ struct level_stats {
 	int64_t max_time[CONFIG_MSM_IDLE_STATS_BUCKET_COUNT];
 	int success_count;
 	int failed_count;
+	int premature_count;
 	int64_t total_time;
 	uint64_t enter_time;
+	uint64_t target_residency;
 };
 
 struct lifo_stats {
@@ -77,6 +79,8 @@ static void update_level_stats(struct level_stats *stats, uint64_t t,
 
 	stats->success_count++;
 	stats->total_time += t;
+	if (t < stats->target_residency)
+		stats->premature_count++;
 	bt = t;
 	do_div(bt, stats->first_bucket_time);
 
@@ -123,6 +127,12 @@ static void level_stats_print(struct seq_file *m, struct level_stats *stats)
 		seq_puts(m, seqs);
 	}
 
+	if (stats->premature_count) {
+		snprintf(seqs, MAX_STR_LEN, "  premature exit count: %7d\n",
+			stats->premature_count);
+		seq_puts(m, seqs);
+	}
+
 	bucket_time = stats->first_bucket_time;
 	for (i = 0;
 		i < CONFIG_MSM_IDLE_STATS_BUCKET_COUNT - 1;
@@ -191,6 +201,7 @@ static void level_stats_reset(struct level_stats *stats)
 	memset(stats->max_time, 0, sizeof(stats->max_time));
 	stats->success_count = 0;
 	stats->failed_count = 0;
+	stats->premature_count = 0;
 	stats->total_time = 0;
 }
 
@@ -665,6 +676,37 @@ struct lpm_stats *lpm_stats_config_level(const char *name,
 }
 EXPORT_SYMBOL(lpm_stats_config_level);
 
+/**
+ * lpm_stats_config_cpu_residency() - API to configure the target
+ * residency of cpu levels.
+ *
+ * @residency_us:	Target residency of each level, in microseconds.
+ * @num_levels:		Number of levels in @residency_us.
+ * @mask:		cpus the levels belong to.
+ *
+ * Exits from a level before its target residency are counted as
+ * premature: the cpu spent more energy entering and leaving the level
+ * than it saved while in it.  Must be called after the cpus' levels are
+ * configured with lpm_stats_config_level().
+ */
+void lpm_stats_config_cpu_residency(const uint32_t *residency_us,
+		int num_levels, struct cpumask *mask)
+{
+	int cpu, i;
+
+	for_each_cpu(cpu, mask) {
+		struct lpm_stats *stats = &per_cpu(cpu_stats, cpu);
+
+		if (!stats->time_stats)
+			continue;
+
+		for (i = 0; i < min_t(int, num_levels, stats->num_levels); i++)
+			stats->time_stats[i].target_residency =
+				(uint64_t)residency_us[i] * NSEC_PER_USEC;
+	}
+}
+EXPORT_SYMBOL(lpm_stats_config_cpu_residency);
+
 /**
  * lpm_stats_cluster_enter() - API to communicate the lpm level a cluster
  * is prepared to enter.
@@ -1205,12 +1205,19 @@ out:
 	return rc;
 }
 
+/*
+ * Results up to this old, from this driver or any other VADC client, are
+ * reused instead of converting again.
+ */
+#define VBAT_MAX_AGE_MS			100
+#define BATT_THERM_MAX_AGE_MS		1000
 static int get_prop_battery_voltage_now(struct qpnp_lbc_chip *chip)
 {
 	int rc = 0;
 	struct qpnp_vadc_result results;
 
-	rc = qpnp_vadc_read(chip->vadc_dev, VBAT_SNS, &results);
+	rc = qpnp_vadc_read_cached(chip->vadc_dev, VBAT_SNS, &results,
+						VBAT_MAX_AGE_MS);
 	if (rc) {
 		pr_err("Unable to read vbat rc=%d\n", rc);
 		return 0;
@@ -1374,7 +1381,8 @@ static int get_prop_batt_temp(struct qpnp_lbc_chip *chip)
 	if (chip->cfg_use_fake_battery || !get_prop_batt_present(chip))
 		return DEFAULT_TEMP;
 
-	rc = qpnp_vadc_read(chip->vadc_dev, LR_MUX1_BATT_THERM, &results);
+	rc = qpnp_vadc_read_cached(chip->vadc_dev, LR_MUX1_BATT_THERM,
+					&results, BATT_THERM_MAX_AGE_MS);
 	if (rc) {
 		pr_debug("Unable to read batt temperature rc=%d\n", rc);
 		return DEFAULT_TEMP;
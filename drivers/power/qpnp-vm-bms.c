@@ -1179,12 +1179,19 @@ static int read_and_update_ocv(struct qpnp_bms_chip *chip, int batt_temp,
 	return 0;
 }
 
+/*
+ * Results up to this old, from this driver or any other VADC client, are
+ * reused instead of converting again.
+ */
+#define VBAT_MAX_AGE_MS			100
+#define BATT_THERM_MAX_AGE_MS		1000
 static int get_battery_voltage(struct qpnp_bms_chip *chip, int *result_uv)
 {
 	int rc;
 	struct qpnp_vadc_result adc_result;
 
-	rc = qpnp_vadc_read(chip->vadc_dev, VBAT_SNS, &adc_result);
+	rc = qpnp_vadc_read_cached(chip->vadc_dev, VBAT_SNS, &adc_result,
+						VBAT_MAX_AGE_MS);
 	if (rc) {
 		pr_err("error reading adc channel = %d, rc = %d\n",
 							VBAT_SNS, rc);
@@ -1220,7 +1227,8 @@ static int get_batt_therm(struct qpnp_bms_chip *chip, int *batt_temp)
 	int rc;
 	struct qpnp_vadc_result result;
 
-	rc = qpnp_vadc_read(chip->vadc_dev, LR_MUX1_BATT_THERM, &result);
+	rc = qpnp_vadc_read_cached(chip->vadc_dev, LR_MUX1_BATT_THERM,
+					&result, BATT_THERM_MAX_AGE_MS);
 	if (rc) {
 		pr_err("error reading adc channel = %d, rc = %d\n",
 					LR_MUX1_BATT_THERM, rc);
@@ -84,6 +84,7 @@ static struct bam_ops_if bam_default_ops = {
 	.sps_device_reset_ptr = &sps_device_reset,
 	.sps_register_event_ptr = &sps_register_event,
 	.sps_transfer_one_ptr = &sps_transfer_one,
+	.sps_transfer_batch_ptr = &sps_transfer_batch,
 	.sps_get_iovec_ptr = &sps_get_iovec,
 	.sps_get_unused_desc_num_ptr = &sps_get_unused_desc_num,
 
@@ -176,6 +177,7 @@ struct bam_ch_info {
 #define A2_PHYS_BASE		0x124C2000
 #define A2_PHYS_SIZE		0x2000
 #define DEFAULT_NUM_BUFFERS	32
+#define RX_REPLENISH_BATCH	8
 
 #ifndef A2_BAM_IRQ
 #define A2_BAM_IRQ -1
@@ -213,6 +215,10 @@ static unsigned long rx_timer_interval;
 static LIST_HEAD(bam_rx_pool);
 static DEFINE_MUTEX(bam_rx_pool_mutexlock);
 static int bam_rx_pool_len;
+static uint32_t rx_pool_target;
+static int rx_pool_min = DEFAULT_NUM_BUFFERS;
+module_param_named(rx_pool_min, rx_pool_min,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 static LIST_HEAD(bam_tx_pool);
 static DEFINE_SPINLOCK(bam_tx_pool_spinlock);
 static DEFINE_MUTEX(bam_pdev_mutexlock);
@@ -389,84 +395,200 @@ static inline void verify_tx_queue_is_empty(const char *func)
 	spin_unlock_irqrestore(&bam_tx_pool_spinlock, flags);
 }
 
-static void __queue_rx(gfp_t alloc_flags)
+/**
+ * rx_pool_floor() - Get the smallest rx pool depth the pool may shrink to
+ *
+ * The floor is the rx_pool_min module parameter bounded below by one
+ * replenish batch and above by the size of the rx descriptor ring.
+ */
+static uint32_t rx_pool_floor(void)
+{
+	uint32_t floor = max_t(int, rx_pool_min, RX_REPLENISH_BATCH);
+
+	return min_t(uint32_t, floor, num_buffers);
+}
+
+/**
+ * rx_pool_grow() - Double the rx pool depth after sustained rx traffic
+ *
+ * Must be called with bam_rx_pool_mutexlock held.
+ */
+static void rx_pool_grow(void)
+{
+	uint32_t target = min_t(uint32_t, rx_pool_target * 2, num_buffers);
+
+	if (target == rx_pool_target)
+		return;
+
+	BAM_DMUX_LOG("%s: rx pool %u -> %u\n", __func__, rx_pool_target,
+								target);
+	rx_pool_target = target;
+	schedule_work(&queue_rx_work);
+}
+
+/**
+ * rx_pool_shrink() - Halve the rx pool depth once rx traffic goes idle
+ *
+ * Buffers already posted beyond the new depth are not reclaimed; they are
+ * simply not replenished as the modem consumes them.  Must be called with
+ * bam_rx_pool_mutexlock held.
+ */
+static void rx_pool_shrink(void)
+{
+	uint32_t target = max_t(uint32_t, rx_pool_target / 2, rx_pool_floor());
+
+	if (target == rx_pool_target)
+		return;
+
+	BAM_DMUX_LOG("%s: rx pool %u -> %u\n", __func__, rx_pool_target,
+								target);
+	rx_pool_target = target;
+}
+
+/**
+ * rx_pkt_info_alloc() - Allocate and dma map one rx buffer
+ * @len:		Size of the rx buffer
+ * @alloc_flags:	Allocation flags
+ *
+ * Return: the new rx_pkt_info, or NULL on failure
+ */
+static struct rx_pkt_info *rx_pkt_info_alloc(uint16_t len, gfp_t alloc_flags)
 {
+	struct rx_pkt_info *info;
 	void *ptr;
+
+	info = kmalloc(sizeof(struct rx_pkt_info), alloc_flags);
+	if (!info) {
+		DMUX_LOG_KERR(
+		"%s: unable to alloc rx_pkt_info w/ flags %x, will retry later\n",
+							__func__,
+							alloc_flags);
+		return NULL;
+	}
+
+	info->len = len;
+
+	INIT_WORK(&info->work, handle_bam_mux_cmd);
+
+	info->skb = __dev_alloc_skb(info->len, alloc_flags);
+	if (info->skb == NULL) {
+		DMUX_LOG_KERR(
+			"%s: unable to alloc skb w/ flags %x, will retry later\n",
+							__func__,
+							alloc_flags);
+		goto fail_info;
+	}
+	ptr = skb_put(info->skb, info->len);
+
+	info->dma_address = dma_map_single(dma_dev, ptr, info->len,
+						bam_ops->dma_from);
+	if (info->dma_address == 0 || info->dma_address == ~0) {
+		DMUX_LOG_KERR("%s: dma_map_single failure %p for %p\n",
+			__func__, (void *)info->dma_address, ptr);
+		goto fail_skb;
+	}
+
+	return info;
+
+fail_skb:
+	dev_kfree_skb_any(info->skb);
+
+fail_info:
+	kfree(info);
+	return NULL;
+}
+
+/**
+ * rx_pkt_info_free() - Unmap and free an rx buffer that was never queued
+ * @info:	rx buffer to free
+ */
+static void rx_pkt_info_free(struct rx_pkt_info *info)
+{
+	dma_unmap_single(dma_dev, info->dma_address, info->len,
+				bam_ops->dma_from);
+	dev_kfree_skb_any(info->skb);
+	kfree(info);
+}
+
+/**
+ * __queue_rx() - Replenish the rx pool up to its current depth
+ * @alloc_flags:	Allocation flags
+ * @min_batch:		Skip the replenish while fewer than this many buffers
+ *			are missing and the pool still holds at least this
+ *			many buffers
+ *
+ * Buffers are allocated and mapped outside of the pool lock and queued on the
+ * rx pipe RX_REPLENISH_BATCH at a time, so the BAM sees a single pipe event
+ * register write per batch.
+ */
+static void __queue_rx(gfp_t alloc_flags, int min_batch)
+{
 	struct rx_pkt_info *info;
+	struct rx_pkt_info *tmp;
+	struct sps_iovec iovec[RX_REPLENISH_BATCH];
+	void *user[RX_REPLENISH_BATCH];
+	LIST_HEAD(batch);
 	int ret;
-	int rx_len_cached;
+	int deficit;
+	int n;
+	int i;
 	uint16_t current_buffer_size;
 
 	mutex_lock(&bam_rx_pool_mutexlock);
-	rx_len_cached = bam_rx_pool_len;
+	deficit = (int)rx_pool_target - bam_rx_pool_len;
+	if (deficit < min_batch && bam_rx_pool_len >= min_batch) {
+		mutex_unlock(&bam_rx_pool_mutexlock);
+		return;
+	}
 	current_buffer_size = buffer_size;
 	mutex_unlock(&bam_rx_pool_mutexlock);
 
-	while (bam_connection_is_active && rx_len_cached < num_buffers) {
-		if (in_global_reset)
-			goto fail;
-
-		info = kmalloc(sizeof(struct rx_pkt_info), alloc_flags);
-		if (!info) {
-			DMUX_LOG_KERR(
-			"%s: unable to alloc rx_pkt_info w/ flags %x, will retry later\n",
-								__func__,
-								alloc_flags);
-			goto fail;
-		}
-
-		info->len = current_buffer_size;
-
-		INIT_WORK(&info->work, handle_bam_mux_cmd);
+	while (bam_connection_is_active && deficit > 0) {
+		n = min(deficit, RX_REPLENISH_BATCH);
+		for (i = 0; i < n; i++) {
+			if (in_global_reset)
+				break;
 
-		info->skb = __dev_alloc_skb(info->len, alloc_flags);
-		if (info->skb == NULL) {
-			DMUX_LOG_KERR(
-				"%s: unable to alloc skb w/ flags %x, will retry later\n",
-								__func__,
+			info = rx_pkt_info_alloc(current_buffer_size,
 								alloc_flags);
-			goto fail_info;
-		}
-		ptr = skb_put(info->skb, info->len);
+			if (!info)
+				break;
 
-		info->dma_address = dma_map_single(dma_dev, ptr, info->len,
-							bam_ops->dma_from);
-		if (info->dma_address == 0 || info->dma_address == ~0) {
-			DMUX_LOG_KERR("%s: dma_map_single failure %p for %p\n",
-				__func__, (void *)info->dma_address, ptr);
-			goto fail_skb;
+			list_add_tail(&info->list_node, &batch);
+			iovec[i].addr = SPS_GET_LOWER_ADDR(info->dma_address);
+			iovec[i].size = info->len;
+			iovec[i].flags = DESC_FLAG_WORD(0, info->dma_address);
+			user[i] = info;
 		}
 
-		mutex_lock(&bam_rx_pool_mutexlock);
-		list_add_tail(&info->list_node, &bam_rx_pool);
-		rx_len_cached = ++bam_rx_pool_len;
-		current_buffer_size = buffer_size;
-		ret = bam_ops->sps_transfer_one_ptr(bam_rx_pipe,
-				info->dma_address, info->len, info, 0);
-		if (ret) {
-			list_del(&info->list_node);
-			rx_len_cached = --bam_rx_pool_len;
+		if (i) {
+			mutex_lock(&bam_rx_pool_mutexlock);
+			ret = bam_ops->sps_transfer_batch_ptr(bam_rx_pipe,
+							iovec, user, i);
+			if (ret) {
+				mutex_unlock(&bam_rx_pool_mutexlock);
+				DMUX_LOG_KERR(
+					"%s: sps_transfer_batch failed %d\n",
+					__func__, ret);
+				list_for_each_entry_safe(info, tmp, &batch,
+								list_node) {
+					list_del(&info->list_node);
+					rx_pkt_info_free(info);
+				}
+				goto fail;
+			}
+			list_splice_tail_init(&batch, &bam_rx_pool);
+			bam_rx_pool_len += i;
+			deficit = (int)rx_pool_target - bam_rx_pool_len;
+			current_buffer_size = buffer_size;
 			mutex_unlock(&bam_rx_pool_mutexlock);
-			DMUX_LOG_KERR("%s: sps_transfer_one failed %d\n",
-				__func__, ret);
-
-			dma_unmap_single(dma_dev, info->dma_address,
-						info->len,
-						bam_ops->dma_from);
-
-			goto fail_skb;
 		}
-		mutex_unlock(&bam_rx_pool_mutexlock);
 
+		if (i < n)
+			goto fail;
 	}
 	return;
 
-fail_skb:
-	dev_kfree_skb_any(info->skb);
-
-fail_info:
-	kfree(info);
-
 fail:
 	if (!in_global_reset) {
 		DMUX_LOG_KERR("%s: rescheduling\n", __func__);
@@ -481,7 +603,7 @@ static void queue_rx(void)
 	 * not immediately available, and delays from logging allocation
 	 * failures which cannot be tolerated at this time.
 	 */
-	__queue_rx(GFP_NOWAIT | __GFP_NOWARN);
+	__queue_rx(GFP_NOWAIT | __GFP_NOWARN, RX_REPLENISH_BATCH);
 }
 
 static void queue_rx_work_func(struct work_struct *work)
@@ -491,7 +613,7 @@ static void queue_rx_work_func(struct work_struct *work)
 	 * guarentee the requested memory will be found, after some ammount of
 	 * delay.
 	 */
-	__queue_rx(GFP_KERNEL);
+	__queue_rx(GFP_KERNEL, 1);
 }
 
 /**
@@ -1286,6 +1408,10 @@ static void rx_switch_to_interrupt_mode(void)
 	complete_all(&shutdown_completion);
 	release_wakelock();
 
+	mutex_lock(&bam_rx_pool_mutexlock);
+	rx_pool_shrink();
+	mutex_unlock(&bam_rx_pool_mutexlock);
+
 	/* handle any rx packets before interrupt was enabled */
 	while (bam_connection_is_active && !polling_mode) {
 		ret = bam_ops->sps_get_iovec_ptr(bam_rx_pipe, &iov);
@@ -1365,10 +1491,12 @@ static void rx_timer_work_func(struct work_struct *work)
 	int inactive_cycles = 0;
 	int ret;
 	u32 buffs_unused, buffs_used;
+	u32 rx_handled;
 
 	BAM_DMUX_LOG("%s: polling start\n", __func__);
 	while (bam_connection_is_active) { /* timer loop */
 		++inactive_cycles;
+		rx_handled = 0;
 		while (bam_connection_is_active) { /* deplete queue loop */
 			if (in_global_reset) {
 				BAM_DMUX_LOG(
@@ -1417,6 +1545,18 @@ static void rx_timer_work_func(struct work_struct *work)
 			mutex_unlock(&bam_rx_pool_mutexlock);
 			info->sps_size = iov.size;
 			handle_bam_mux_cmd(&info->work);
+			++rx_handled;
+		}
+
+		/*
+		 * Half the pool or more consumed within one polling interval
+		 * means the modem is close to running dry, so deepen the pool.
+		 */
+		if (rx_handled) {
+			mutex_lock(&bam_rx_pool_mutexlock);
+			if (rx_handled >= rx_pool_target / 2)
+				rx_pool_grow();
+			mutex_unlock(&bam_rx_pool_mutexlock);
 		}
 
 		if (inactive_cycles >= POLLING_INACTIVITY) {
@@ -1588,6 +1728,7 @@ static int debug_stats(char *buf, int max)
 			"sps tx failures: %u\n"
 			"sps tx stalls:   %u\n"
 			"rx queue len:    %d\n"
+			"rx pool depth:   %u\n"
 			"a2 ack out cnt:  %d\n"
 			"a2 ack in cnt:   %d\n"
 			"a2 pwr cntl in:  %d\n",
@@ -1598,6 +1739,7 @@ static int debug_stats(char *buf, int max)
 			bam_dmux_tx_sps_failure_cnt,
 			bam_dmux_tx_stall_cnt,
 			bam_rx_pool_len,
+			rx_pool_target,
 			atomic_read(&bam_dmux_ack_out_cnt),
 			atomic_read(&bam_dmux_ack_in_cnt),
 			atomic_read(&bam_dmux_a2_pwr_cntl_in_cnt)
@@ -2688,6 +2830,8 @@ static int bam_dmux_probe(struct platform_device *pdev)
 		set_rx_buffer_ring_pool(num_buffers);
 	}
 
+	rx_pool_target = rx_pool_floor();
+
 	dma_dev = &pdev->dev;
 	/* The BAM only suports 32 bits of address */
 	dma_dev->dma_mask = kmalloc(sizeof(*dma_dev->dma_mask), GFP_KERNEL);
@@ -50,6 +50,7 @@
  * @sps_device_reset_ptr: pointer to sps_device_reset function
  * @sps_register_event_ptr: pointer to sps_register_event function
  * @sps_transfer_one_ptr: pointer to sps_transfer_one function
+ * @sps_transfer_batch_ptr: pointer to sps_transfer_batch function
  * @sps_get_iovec_ptr: pointer to sps_get_iovec function
  * @sps_get_unused_desc_num_ptr: pointer to sps_get_unused_desc_num function
  * @dma_to: enum for the direction of dma operations to device
@@ -102,6 +103,10 @@ struct bam_ops_if {
 		phys_addr_t addr, u32 size,
 		void *user, u32 flags);
 
+	int (*sps_transfer_batch_ptr)(struct sps_pipe *h,
+		const struct sps_iovec *iovec, void * const *user,
+		u32 count);
+
 	int (*sps_get_iovec_ptr)(struct sps_pipe *h,
 		struct sps_iovec *iovec);
 
@@ -22,6 +22,15 @@
 #include <linux/sched.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <soc/qcom/boot_stats.h>
+
+#define BOOT_MARKER_MAX		256
+#define BOOT_MARKER_NAME_LEN	48
 
 struct boot_stats {
 	uint32_t bootloader_start;
@@ -34,6 +43,24 @@ static void __iomem *mpm_counter_base;
 static uint32_t mpm_counter_freq;
 static struct boot_stats __iomem *boot_stats;
 
+/*
+ * Kernel side events stamped with the same MPM counter the bootloader
+ * uses, so that both halves of the boot read as a single timeline.
+ */
+struct boot_marker {
+	char name[BOOT_MARKER_NAME_LEN];
+	uint32_t count;
+};
+
+static struct boot_marker boot_markers[BOOT_MARKER_MAX];
+static unsigned int num_boot_markers;
+static unsigned int dropped_boot_markers;
+static DEFINE_SPINLOCK(boot_marker_lock);
+
+/* Initcalls shorter than this are left out of the timeline */
+static unsigned int initcall_threshold_us = 1000;
+module_param(initcall_threshold_us, uint, S_IRUGO | S_IWUSR);
+
 static int mpm_parse_dt(void)
 {
 	struct device_node *np;
@@ -88,6 +115,99 @@ static void print_boot_stats(void)
 		mpm_counter_freq);
 }
 
+/**
+ * boot_stats_marker() - record a named event on the boot timeline
+ * @fmt: printf style name of the event
+ *
+ * The event is stamped with the current MPM counter value.  Events
+ * arriving before the counter is mapped, or after the table is full,
+ * are dropped.
+ */
+void boot_stats_marker(const char *fmt, ...)
+{
+	struct boot_marker *marker;
+	unsigned long flags;
+	va_list args;
+
+	if (!mpm_counter_base)
+		return;
+
+	spin_lock_irqsave(&boot_marker_lock, flags);
+	if (num_boot_markers >= BOOT_MARKER_MAX) {
+		dropped_boot_markers++;
+		goto out;
+	}
+	marker = &boot_markers[num_boot_markers];
+	marker->count = readl_relaxed(mpm_counter_base);
+	va_start(args, fmt);
+	vsnprintf(marker->name, sizeof(marker->name), fmt, args);
+	va_end(args);
+	num_boot_markers++;
+out:
+	spin_unlock_irqrestore(&boot_marker_lock, flags);
+}
+EXPORT_SYMBOL(boot_stats_marker);
+
+void boot_stats_initcall(initcall_t fn, ktime_t duration)
+{
+	s64 usecs = ktime_to_us(duration);
+
+	if (usecs >= initcall_threshold_us)
+		boot_stats_marker("initcall %pf %lld us", fn, usecs);
+}
+
+static unsigned long boot_stats_count_to_ms(uint32_t count)
+{
+	if (!mpm_counter_freq)
+		return 0;
+	return (unsigned long)div_u64((u64)count * MSEC_PER_SEC,
+				      mpm_counter_freq);
+}
+
+static void boot_stats_show_count(struct seq_file *m, const char *name,
+				  uint32_t count)
+{
+	seq_printf(m, "%10u %8lu ms  %s\n", count,
+		   boot_stats_count_to_ms(count), name);
+}
+
+static int boot_stats_timeline_show(struct seq_file *m, void *unused)
+{
+	unsigned int i;
+
+	seq_printf(m, "MPM clock frequency %u Hz\n", mpm_counter_freq);
+	boot_stats_show_count(m, "bootloader start",
+			      readl_relaxed(&boot_stats->bootloader_start));
+	boot_stats_show_count(m, "bootloader display",
+			      readl_relaxed(&boot_stats->bootloader_display));
+	boot_stats_show_count(m, "bootloader load kernel",
+			readl_relaxed(&boot_stats->bootloader_load_kernel));
+	boot_stats_show_count(m, "bootloader end",
+			      readl_relaxed(&boot_stats->bootloader_end));
+
+	spin_lock_irq(&boot_marker_lock);
+	for (i = 0; i < num_boot_markers; i++)
+		boot_stats_show_count(m, boot_markers[i].name,
+				      boot_markers[i].count);
+	if (dropped_boot_markers)
+		seq_printf(m, "%u events dropped\n", dropped_boot_markers);
+	spin_unlock_irq(&boot_marker_lock);
+
+	return 0;
+}
+
+static int boot_stats_timeline_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, boot_stats_timeline_show, NULL);
+}
+
+static const struct file_operations boot_stats_timeline_fops = {
+	.open = boot_stats_timeline_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 int boot_stats_init(void)
 {
 	int ret;
@@ -98,8 +218,12 @@ int boot_stats_init(void)
 
 	print_boot_stats();
 
-	iounmap(boot_stats);
-	iounmap(mpm_counter_base);
+	/* Both regions stay mapped for the markers and the timeline */
+	if (mpm_counter_base) {
+		boot_stats_marker("kernel boot_stats init");
+		debugfs_create_file("boot_timeline", S_IRUGO, NULL, NULL,
+				    &boot_stats_timeline_fops);
+	}
 
 	return 0;
 }
@@ -30,11 +30,13 @@
  * @timer: hrtimer created for this event.
  * @function : callback function for event timer.
  * @data : callback data for event timer.
+ * @slack : how late the event may fire, to share a wakeup with others.
  */
 struct event_timer_info {
 	struct timerqueue_node node;
 	void (*function)(void *);
 	void *data;
+	ktime_t slack;
 };
 
 static DEFINE_TIME_HEAD(timer_head);
@@ -145,28 +147,44 @@ static void create_hrtimer(ktime_t expires)
 	hrtimer_start(&event_hrtimer, expires, HRTIMER_MODE_ABS);
 }
 
+/**
+ * is_event_due(): Helper function to check if an event may fire at @now,
+ *                 either because it expired or because @now is within
+ *                 its slack.
+ * @event : handle to the event to be checked.
+ * @now : time of the wakeup.
+ */
+static bool is_event_due(struct event_timer_info *event, ktime_t now)
+{
+	return ktime_to_ns(ktime_sub(event->node.expires, event->slack))
+		<= ktime_to_ns(now);
+}
+
 /**
  * event_hrtimer_cb() : Callback function for hr timer.
  *                      Make the client CB from here and remove the event
- *                      from the time ordered queue.
+ *                      from the time ordered queue. Events that are not
+ *                      expired yet but tolerate firing now are run too,
+ *                      so that they do not cause a wakeup of their own.
  */
 static enum hrtimer_restart event_hrtimer_cb(struct hrtimer *hrtimer)
 {
 	struct event_timer_info *event;
-	struct timerqueue_node *next;
+	struct timerqueue_node *next, *iter;
+	ktime_t now = hrtimer->node.expires;
 	unsigned long flags;
 
 	spin_lock_irqsave(&event_timer_lock, flags);
 	next = timerqueue_getnext(&timer_head);
 
-	while (next && (ktime_to_ns(next->expires)
-		<= ktime_to_ns(hrtimer->node.expires))) {
-		if (!next)
-			goto hrtimer_cb_exit;
+	while (next) {
+		iter = timerqueue_iterate_next(next);
 
 		event = container_of(next, struct event_timer_info, node);
-		if (!event)
-			goto hrtimer_cb_exit;
+		if (!is_event_due(event, now)) {
+			next = iter;
+			continue;
+		}
 
 		if (msm_event_debug_mask && MSM_EVENT_TIMER_DEBUG)
 			pr_info("%s: Deleting event %p @ %lu", __func__,
@@ -177,17 +195,50 @@ static enum hrtimer_restart event_hrtimer_cb(struct hrtimer *hrtimer)
 
 		if (event->function)
 			event->function(event->data);
+
+		/* the callback may have requeued events, so start over */
 		next = timerqueue_getnext(&timer_head);
 	}
 
+	next = timerqueue_getnext(&timer_head);
+
 	if (next)
 		create_hrtimer(next->expires);
 
 	spin_unlock_irqrestore(&event_timer_lock, flags);
-hrtimer_cb_exit:
 	return HRTIMER_NORESTART;
 }
 
+/**
+ * align_event(): Helper function to move an event with slack onto the
+ *                first wakeup already queued within its slack, or to
+ *                the end of its slack when there is none.
+ * @event : handle to the event to be aligned.
+ */
+static void align_event(struct event_timer_info *event)
+{
+	struct timerqueue_node *next;
+	ktime_t latest;
+
+	if (!ktime_to_ns(event->slack))
+		return;
+
+	latest = ktime_add(event->node.expires, event->slack);
+	for (next = timerqueue_getnext(&timer_head); next;
+			next = timerqueue_iterate_next(next)) {
+		if (ktime_to_ns(next->expires) > ktime_to_ns(latest))
+			break;
+
+		if (ktime_to_ns(next->expires) >=
+				ktime_to_ns(event->node.expires)) {
+			event->node.expires = next->expires;
+			return;
+		}
+	}
+
+	event->node.expires = latest;
+}
+
 /**
  * create_timer_smp(): Helper function used setting up timer on core 0.
  */
@@ -202,6 +253,8 @@ static void create_timer_smp(void *data)
 	if (is_event_active(event))
 		timerqueue_del(&timer_head, &event->node);
 
+	align_event(event);
+
 	next = timerqueue_getnext(&timer_head);
 	timerqueue_add(&timer_head, &event->node);
 	if (msm_event_debug_mask && MSM_EVENT_TIMER_DEBUG)
@@ -238,16 +291,33 @@ static void setup_event_hrtimer(struct event_timer_info *event)
  *  @event_time : event time in absolute ktime.
  */
 void activate_event_timer(struct event_timer_info *event, ktime_t event_time)
+{
+	activate_event_timer_slack(event, event_time, ktime_set(0, 0));
+}
+
+/**
+ * activate_event_timer_slack() : Set the expiration time for an event in
+ *                                absolute ktime, allowing it to fire up to
+ *                                @slack later so that its wakeup can be
+ *                                shared with other events.
+ *  @event : event handle.
+ *  @event_time : earliest event time in absolute ktime.
+ *  @slack : tolerated delay past @event_time.
+ */
+void activate_event_timer_slack(struct event_timer_info *event,
+				ktime_t event_time, ktime_t slack)
 {
 	if (!event)
 		return;
 
 	if (msm_event_debug_mask && MSM_EVENT_TIMER_DEBUG)
-		pr_info("%s: Adding event timer @ %lu", __func__,
-				(unsigned long)ktime_to_us(event_time));
+		pr_info("%s: Adding event timer @ %lu slack %lu", __func__,
+				(unsigned long)ktime_to_us(event_time),
+				(unsigned long)ktime_to_us(slack));
 
 	spin_lock(&event_setup_lock);
 	event->node.expires = event_time;
+	event->slack = slack;
 	/* Start hr timer and add event to rb tree */
 	setup_event_hrtimer(event);
 	spin_unlock(&event_setup_lock);
@@ -32,6 +32,15 @@ static int msm_ipc_router_smd_xprt_debug_mask;
 module_param_named(debug_mask, msm_ipc_router_smd_xprt_debug_mask,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Packets up to this size are received into a single sk_buff even when
+ * they are drained from SMD in several chunks, so that they reach the
+ * router and its clients unfragmented.
+ */
+static unsigned int max_contig_pkt_sz = 8192;
+module_param_named(max_contig_pkt_sz, max_contig_pkt_sz,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
 #if defined(DEBUG)
 #define D(x...) do { \
 if (msm_ipc_router_smd_xprt_debug_mask) \
@@ -273,6 +282,7 @@ static void smd_xprt_read_data(struct work_struct *work)
 	int pkt_size, sz_read, sz;
 	struct sk_buff *ipc_rtr_pkt;
 	void *data;
+	bool new_skb;
 	unsigned long flags;
 	struct delayed_work *rwork = to_delayed_work(work);
 	struct msm_ipc_router_smd_xprt *smd_xprtp =
@@ -313,7 +323,16 @@ static void smd_xprt_read_data(struct work_struct *work)
 			return;
 
 		sz = smd_read_avail(smd_xprtp->channel);
-		do {
+		ipc_rtr_pkt = skb_peek_tail(smd_xprtp->in_pkt->pkt_fragment_q);
+		new_skb = !ipc_rtr_pkt || skb_tailroom(ipc_rtr_pkt) < sz;
+		if (new_skb) {
+			ipc_rtr_pkt = NULL;
+			/* size the first fragment for the whole packet */
+			if (!smd_xprtp->in_pkt->length &&
+			    pkt_size <= max_contig_pkt_sz)
+				ipc_rtr_pkt = alloc_skb(pkt_size, GFP_KERNEL);
+		}
+		while (!ipc_rtr_pkt) {
 			ipc_rtr_pkt = alloc_skb(sz, GFP_KERNEL);
 			if (!ipc_rtr_pkt) {
 				if (sz <= (PAGE_SIZE/2)) {
@@ -325,20 +344,23 @@ static void smd_xprt_read_data(struct work_struct *work)
 				}
 				sz = sz / 2;
 			}
-		} while (!ipc_rtr_pkt);
+		}
 
-		D("%s: Allocated the sk_buff of size %d\n", __func__, sz);
+		D("%s: Reading %d bytes into sk_buff\n", __func__, sz);
 		data = skb_put(ipc_rtr_pkt, sz);
 		sz_read = smd_read(smd_xprtp->channel, data, sz);
 		if (sz_read != sz) {
 			IPC_RTR_ERR("%s: Couldn't read %s completely\n",
 				__func__, smd_xprtp->xprt.name);
-			kfree_skb(ipc_rtr_pkt);
+			if (new_skb)
+				kfree_skb(ipc_rtr_pkt);
 			release_pkt(smd_xprtp->in_pkt);
 			smd_xprtp->is_partial_in_pkt = 0;
 			return;
 		}
-		skb_queue_tail(smd_xprtp->in_pkt->pkt_fragment_q, ipc_rtr_pkt);
+		if (new_skb)
+			skb_queue_tail(smd_xprtp->in_pkt->pkt_fragment_q,
+				       ipc_rtr_pkt);
 		smd_xprtp->in_pkt->length += sz_read;
 		if (sz_read != pkt_size)
 			smd_xprtp->is_partial_in_pkt = 1;
@@ -18,6 +18,8 @@
 #include <linux/of_device.h>
 #include <linux/platform_device.h>
 #include <linux/notifier.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <soc/qcom/subsystem_restart.h>
 #include <soc/qcom/subsystem_notif.h>
 #include <soc/qcom/msm_qmi_interface.h>
@@ -45,6 +47,7 @@ struct memshare_driver {
 	struct mutex mem_share;
 	struct mutex mem_free;
 	struct work_struct memshare_init_work;
+	struct dentry *dent;
 };
 
 struct memshare_child {
@@ -127,6 +130,9 @@ static int check_client(int client_id, int proc, int request)
 				memblock[i].alloted = 0;
 				memblock[i].guarantee = 0;
 				memblock[i].peripheral = proc;
+				memblock[i].alloc_count = 0;
+				memblock[i].alloc_fail = 0;
+				memblock[i].free_count = 0;
 				found = i;
 				break;
 			}
@@ -136,6 +142,16 @@ static int check_client(int client_id, int proc, int request)
 	return found;
 }
 
+static void memshare_free_block(int id)
+{
+	dma_free_attrs(memsh_drv->dev, memblock[id].size,
+		memblock[id].virtual_addr, memblock[id].phy_addr, &attrs);
+	memblock[id].phy_addr = 0;
+	memblock[id].virtual_addr = 0;
+	memblock[id].alloted = 0;
+	memblock[id].free_count++;
+}
+
 void free_client(int id)
 {
 
@@ -148,6 +164,7 @@ void free_client(int id)
 	memblock[id].peripheral = -1;
 	memblock[id].sequence_id = -1;
 	memblock[id].memory_type = MEMORY_CMA;
+	memblock[id].alloc_on_request = 0;
 
 }
 
@@ -158,14 +175,17 @@ void free_mem_clients(int proc)
 	pr_debug("memshare: freeing clients\n");
 
 	for (i = 0; i < MAX_CLIENTS; i++) {
-		if (memblock[i].peripheral == proc &&
-				!memblock[i].guarantee) {
+		if (memblock[i].peripheral != proc)
+			continue;
+		if (!memblock[i].guarantee) {
 			pr_debug("Freeing memory for client id: %d\n",
 					memblock[i].client_id);
-			dma_free_attrs(memsh_drv->dev, memblock[i].size,
-				memblock[i].virtual_addr, memblock[i].phy_addr,
-				&attrs);
+			memshare_free_block(i);
 			free_client(i);
+		} else if (memblock[i].alloc_on_request &&
+					memblock[i].alloted) {
+			/* The client asks again once the peripheral is up */
+			memshare_free_block(i);
 		}
 	}
 }
@@ -203,6 +223,7 @@ void initialize_client(void)
 		memblock[i].peripheral = -1;
 		memblock[i].sequence_id = -1;
 		memblock[i].memory_type = MEMORY_CMA;
+		memblock[i].alloc_on_request = 0;
 	}
 	dma_set_attr(DMA_ATTR_NO_KERNEL_MAPPING, &attrs);
 }
@@ -241,11 +262,18 @@ static int handle_alloc_req(void *req_h, void *req)
 	pr_debug("%s: Received Alloc Request\n", __func__);
 	pr_debug("%s: req->num_bytes = %d\n", __func__, alloc_req->num_bytes);
 	mutex_lock(&memsh_drv->mem_share);
-	if (!memblock[GPS].size) {
+	if (!memblock[GPS].alloted) {
 		memset(&alloc_resp, 0, sizeof(struct mem_alloc_resp_msg_v01));
 		alloc_resp.resp = QMI_RESULT_FAILURE_V01;
 		rc = memshare_alloc(memsh_drv->dev, alloc_req->num_bytes,
 					&memblock[GPS]);
+		if (rc) {
+			memblock[GPS].alloc_fail++;
+		} else {
+			memblock[GPS].alloted = 1;
+			memblock[GPS].size = alloc_req->num_bytes;
+			memblock[GPS].alloc_count++;
+		}
 	}
 	alloc_resp.num_bytes_valid = 1;
 	alloc_resp.num_bytes =  alloc_req->num_bytes;
@@ -314,12 +342,14 @@ static int handle_alloc_generic_req(void *req_h, void *req)
 		if (rc) {
 			pr_err("In %s,Unable to allocate memory for requested client\n",
 							__func__);
+			memblock[client_id].alloc_fail++;
 			resp = 1;
 		}
 		if (!resp) {
 			memblock[client_id].alloted = 1;
 			memblock[client_id].size = alloc_req->num_bytes;
 			memblock[client_id].peripheral = alloc_req->proc_id;
+			memblock[client_id].alloc_count++;
 		}
 	}
 	memblock[client_id].sequence_id = alloc_req->sequence_id;
@@ -350,7 +380,8 @@ static int handle_free_req(void *req_h, void *req)
 	int rc;
 
 	mutex_lock(&memsh_drv->mem_free);
-	if (!memblock[GPS].guarantee) {
+	if (memblock[GPS].alloted && (!memblock[GPS].guarantee ||
+				memblock[GPS].alloc_on_request)) {
 		free_req = (struct mem_free_req_msg_v01 *)req;
 		pr_debug("%s: Received Free Request\n", __func__);
 		memset(&free_resp, 0, sizeof(struct mem_free_resp_msg_v01));
@@ -359,9 +390,7 @@ static int handle_free_req(void *req_h, void *req)
 			(unsigned long int)memblock[GPS].virtual_addr,
 			(unsigned long int)free_req->handle,
 			memblock[GPS].size);
-		dma_free_coherent(memsh_drv->dev, memblock[GPS].size,
-			memblock[GPS].virtual_addr,
-				free_req->handle);
+		memshare_free_block(GPS);
 	}
 	free_resp.resp = QMI_RESULT_SUCCESS_V01;
 	mutex_unlock(&memsh_drv->mem_free);
@@ -404,11 +433,13 @@ static int handle_free_generic_req(void *req_h, void *req)
 				memblock[client_id].virtual_addr,
 				(unsigned long int)memblock[client_id].phy_addr,
 				memblock[client_id].size);
-		dma_free_attrs(memsh_drv->dev, memblock[client_id].size,
-			memblock[client_id].virtual_addr,
-			memblock[client_id].phy_addr,
-			&attrs);
+		memshare_free_block(client_id);
 		free_client(client_id);
+	} else if (memblock[client_id].alloc_on_request &&
+					memblock[client_id].alloted) {
+		pr_debug("In %s: releasing on-request memory of client %d\n",
+				__func__, memblock[client_id].client_id);
+		memshare_free_block(client_id);
 	} else {
 		pr_err("In %s, Request came for a guaranteed client cannot free up the memory\n",
 						__func__);
@@ -661,6 +692,18 @@ static int memshare_child_probe(struct platform_device *pdev)
 	memblock[num_clients].client_id = client_table[num_clients];
 	memblock[num_clients].guarantee = 1;
 
+	/*
+	 * Clients marked allocate-on-request keep their slot, but the
+	 * memory is only taken from CMA when the peripheral asks for it
+	 * and is given back to Linux when it is released.
+	 */
+	if (of_property_read_bool(pdev->dev.of_node,
+				"qcom,allocate-on-request")) {
+		memblock[num_clients].alloc_on_request = 1;
+		num_clients++;
+		return 0;
+	}
+
 	rc = memshare_alloc(memsh_child->dev, memblock[num_clients].size,
 					&memblock[num_clients]);
 	if (rc) {
@@ -669,11 +712,46 @@ static int memshare_child_probe(struct platform_device *pdev)
 		return rc;
 	}
 	memblock[num_clients].alloted = 1;
+	memblock[num_clients].alloc_count++;
 	num_clients++;
 
 	return 0;
 }
 
+static int memshare_clients_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	seq_puts(s, "client proc guarantee on_request alloted size allocs fails frees\n");
+	mutex_lock(&memsh_drv->mem_share);
+	for (i = 0; i < MAX_CLIENTS; i++) {
+		if (memblock[i].client_id == DHMS_MEM_CLIENT_INVALID)
+			continue;
+		seq_printf(s, "%6u %4d %9u %10u %7u %4u %6u %5u %5u\n",
+			memblock[i].client_id, (int)memblock[i].peripheral,
+			memblock[i].guarantee, memblock[i].alloc_on_request,
+			memblock[i].alloted,
+			memblock[i].alloted ? memblock[i].size : 0,
+			memblock[i].alloc_count, memblock[i].alloc_fail,
+			memblock[i].free_count);
+	}
+	mutex_unlock(&memsh_drv->mem_share);
+
+	return 0;
+}
+
+static int memshare_clients_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, memshare_clients_show, inode->i_private);
+}
+
+static const struct file_operations memshare_clients_fops = {
+	.open = memshare_clients_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int memshare_probe(struct platform_device *pdev)
 {
 	int rc;
@@ -708,6 +786,12 @@ static int memshare_probe(struct platform_device *pdev)
 	}
 
 	subsys_notif_register_notifier("modem", &nb);
+
+	drv->dent = debugfs_create_dir("memshare", NULL);
+	if (!IS_ERR_OR_NULL(drv->dent))
+		debugfs_create_file("clients", S_IRUGO, drv->dent, NULL,
+					&memshare_clients_fops);
+
 	pr_info("In %s, Memshare probe success\n", __func__);
 	return 0;
 }
@@ -717,6 +801,7 @@ static int memshare_remove(struct platform_device *pdev)
 	if (!memsh_drv)
 		return 0;
 
+	debugfs_remove_recursive(memsh_drv->dent);
 	qmi_svc_unregister(mem_share_svc_handle);
 	flush_workqueue(mem_share_svc_workqueue);
 	qmi_handle_destroy(mem_share_svc_handle);
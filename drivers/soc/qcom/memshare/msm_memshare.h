@@ -43,6 +43,14 @@ struct mem_blocks {
 	uint32_t alloted;
 	/* Size required for client */
 	uint32_t size;
+	/* Allocate only when the client asks, free when it releases */
+	uint32_t alloc_on_request;
+	/* Number of successful allocations */
+	uint32_t alloc_count;
+	/* Number of failed allocations */
+	uint32_t alloc_fail;
+	/* Number of releases */
+	uint32_t free_count;
 	/* start address of the memory block reserved by server memory
 	 * subsystem to client
 	*/
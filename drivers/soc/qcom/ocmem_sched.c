@@ -22,6 +22,7 @@
 #include <linux/platform_device.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/ktime.h>
 #include "ocmem_priv.h"
 
 enum request_states {
@@ -88,6 +89,24 @@ static struct workqueue_struct *ocmem_eviction_wq;
 
 static struct ocmem_eviction_data *evictions[OCMEM_CLIENT_MAX];
 
+/* Per client OCMEM utilization, protected by usage_lock */
+struct ocmem_client_usage {
+	unsigned long cur_sz;
+	unsigned long peak_sz;
+	/* Time integral of cur_sz, in byte milliseconds */
+	u64 byte_ms;
+	ktime_t last_update;
+	/* Number of times requests of this client were evicted */
+	unsigned long nr_evicted;
+	/* Number of times this client stalled on an eviction */
+	unsigned long nr_eviction_waits;
+	unsigned int max_eviction_wait;
+	u64 total_eviction_wait;
+};
+
+static struct ocmem_client_usage client_usage[OCMEM_CLIENT_MAX];
+static DEFINE_SPINLOCK(usage_lock);
+
 struct ocmem_rdm_work {
 	int id;
 	struct ocmem_map_list *list;
@@ -298,6 +317,53 @@ static unsigned long core_address(int id, unsigned long addr)
 	return ret_addr;
 }
 
+/* Must be called with usage_lock held */
+static void __update_usage_time(struct ocmem_client_usage *u, ktime_t now)
+{
+	u->byte_ms += (u64)u->cur_sz *
+			ktime_to_ms(ktime_sub(now, u->last_update));
+	u->last_update = now;
+}
+
+static void account_usage(int id, unsigned long old_sz, unsigned long new_sz)
+{
+	struct ocmem_client_usage *u = &client_usage[id];
+	unsigned long flags;
+
+	if (old_sz == new_sz)
+		return;
+
+	spin_lock_irqsave(&usage_lock, flags);
+	__update_usage_time(u, ktime_get());
+	u->cur_sz = u->cur_sz - old_sz + new_sz;
+	if (u->cur_sz > u->peak_sz)
+		u->peak_sz = u->cur_sz;
+	spin_unlock_irqrestore(&usage_lock, flags);
+}
+
+static void account_evicted(int id)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&usage_lock, flags);
+	client_usage[id].nr_evicted++;
+	spin_unlock_irqrestore(&usage_lock, flags);
+}
+
+static void account_eviction_wait(int id, ktime_t start)
+{
+	struct ocmem_client_usage *u = &client_usage[id];
+	unsigned int wait = ktime_to_ms(ktime_sub(ktime_get(), start));
+	unsigned long flags;
+
+	spin_lock_irqsave(&usage_lock, flags);
+	u->nr_eviction_waits++;
+	u->total_eviction_wait += wait;
+	if (wait > u->max_eviction_wait)
+		u->max_eviction_wait = wait;
+	spin_unlock_irqrestore(&usage_lock, flags);
+}
+
 static inline struct ocmem_zone *zone_of(struct ocmem_req *req)
 {
 	int owner;
@@ -775,6 +841,7 @@ retry_next_step:
 		/* update the request */
 		req->req_start = alloc_addr;
 		/* increment the size to reflect new length */
+		account_usage(req->owner, req->req_sz, curr_sz);
 		req->req_sz = curr_sz;
 		req->req_end = alloc_addr + req->req_sz - 1;
 
@@ -892,6 +959,7 @@ static int __sched_free(struct ocmem_req *req)
 	}
 
 	/* Update the request */
+	account_usage(req->owner, req->req_sz, 0x0);
 	req->req_start = 0x0;
 	req->req_sz = 0x0;
 	req->req_end = 0x0;
@@ -963,6 +1031,7 @@ static int __sched_shrink(struct ocmem_req *req, unsigned long new_sz)
 	}
 	/* update the request */
 	req->req_start = alloc_addr;
+	account_usage(req->owner, req->req_sz, new_sz);
 	req->req_sz = new_sz;
 	req->req_end = alloc_addr + req->req_sz;
 
@@ -1097,6 +1166,8 @@ retry_next_step:
 			goto internal_error;
 		}
 
+		account_usage(req->owner, 0x0, sz);
+
 		if (retry) {
 			SET_STATE(req, R_MUST_GROW);
 			SET_STATE(req, R_PENDING);
@@ -1951,6 +2022,7 @@ static void trigger_eviction(struct ocmem_eviction_data *edata)
 			buffer.addr = req->req_start;
 			buffer.len = 0x0;
 			CLEAR_STATE(req, R_MUST_SHRINK);
+			account_evicted(req->owner);
 			dispatch_notification(req->owner, OCMEM_ALLOC_SHRINK,
 								&buffer);
 			SET_STATE(req, R_WF_SHRINK);
@@ -1962,6 +2034,7 @@ static void trigger_eviction(struct ocmem_eviction_data *edata)
 int process_evict(int id)
 {
 	struct ocmem_eviction_data *edata = NULL;
+	ktime_t start;
 	int rc = 0;
 
 	edata = init_eviction(id);
@@ -1984,7 +2057,9 @@ int process_evict(int id)
 
 	mutex_unlock(&sched_mutex);
 
+	start = ktime_get();
 	wait_for_completion(&edata->completion);
+	account_eviction_wait(id, start);
 
 	return 0;
 
@@ -1997,6 +2072,7 @@ skip_eviction:
 static int run_evict(struct ocmem_req *req)
 {
 	struct ocmem_eviction_data *edata = NULL;
+	ktime_t start;
 	int rc = 0;
 
 	if (!req)
@@ -2022,7 +2098,9 @@ static int run_evict(struct ocmem_req *req)
 
 	mutex_unlock(&free_mutex);
 
+	start = ktime_get();
 	wait_for_completion(&edata->completion);
+	account_eviction_wait(req->owner, start);
 
 	pr_debug("ocmem: eviction completed successfully\n");
 	return 0;
@@ -2484,6 +2562,44 @@ static const struct file_operations allocations_show_fops = {
 	.release = seq_release,
 };
 
+static int ocmem_utilization_show(struct seq_file *f, void *dummy)
+{
+	struct ocmem_client_usage u;
+	ktime_t now = ktime_get();
+	unsigned long flags;
+	int id;
+
+	for (id = 0; id < OCMEM_CLIENT_MAX; id++) {
+		spin_lock_irqsave(&usage_lock, flags);
+		__update_usage_time(&client_usage[id], now);
+		u = client_usage[id];
+		spin_unlock_irqrestore(&usage_lock, flags);
+
+		if (!u.peak_sz && !u.nr_evicted && !u.nr_eviction_waits)
+			continue;
+
+		seq_printf(f, "%s: size 0x%lx peak 0x%lx usage %llu KB*s\n",
+				get_name(id), u.cur_sz, u.peak_sz,
+				div_u64(u.byte_ms, 1024 * MSEC_PER_SEC));
+		seq_printf(f, "\tevicted %lu stalls %lu (total %llu ms, max %u ms)\n",
+				u.nr_evicted, u.nr_eviction_waits,
+				u.total_eviction_wait, u.max_eviction_wait);
+	}
+	return 0;
+}
+
+static int ocmem_utilization_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ocmem_utilization_show, inode->i_private);
+}
+
+static const struct file_operations utilization_show_fops = {
+	.open = ocmem_utilization_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = seq_release,
+};
+
 int ocmem_sched_init(struct platform_device *pdev)
 {
 	int i = 0;
@@ -2514,5 +2630,11 @@ int ocmem_sched_init(struct platform_device *pdev)
 		dev_err(dev, "Unable to create debugfs node for scheduler\n");
 		return -EBUSY;
 	}
+
+	if (!debugfs_create_file("utilization", S_IRUGO, pdata->debug_node,
+					NULL, &utilization_show_fops)) {
+		dev_err(dev, "Unable to create debugfs node for utilization\n");
+		return -EBUSY;
+	}
 	return 0;
 }
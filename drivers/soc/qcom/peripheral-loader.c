@@ -27,6 +27,7 @@
 #include <linux/err.h>
 #include <linux/list.h>
 #include <linux/list_sort.h>
+#include <linux/async.h>
 #include <linux/idr.h>
 #include <linux/interrupt.h>
 #include <linux/of_gpio.h>
@@ -35,6 +36,7 @@
 #include <linux/dma-mapping.h>
 #include <soc/qcom/ramdump.h>
 #include <soc/qcom/subsystem_restart.h>
+#include <soc/qcom/boot_stats.h>
 
 #include <asm/uaccess.h>
 #include <asm/setup.h>
@@ -83,6 +85,9 @@ struct pil_mdt {
  * @filesz: size of segment on disk
  * @num: segment number
  * @relocated: true if segment is relocated, false otherwise
+ * @desc: descriptor the segment belongs to
+ * @cookie: async cookie of the segment load
+ * @load_ret: result of the segment load
  *
  * Loosely based on an elf program header. Contains all necessary information
  * to load and initialize a segment of the image in memory.
@@ -94,6 +99,9 @@ struct pil_seg {
 	int num;
 	struct list_head list;
 	bool relocated;
+	struct pil_desc *desc;
+	async_cookie_t cookie;
+	int load_ret;
 };
 
 /**
@@ -268,7 +276,7 @@ static phys_addr_t pil_reloc(const struct pil_priv *priv, phys_addr_t addr)
 	return addr - priv->base_addr + priv->region_start;
 }
 
-static struct pil_seg *pil_init_seg(const struct pil_desc *desc,
+static struct pil_seg *pil_init_seg(struct pil_desc *desc,
 				  const struct elf32_phdr *phdr, int num)
 {
 	bool reloc = segment_is_relocatable(phdr);
@@ -296,6 +304,7 @@ static struct pil_seg *pil_init_seg(const struct pil_desc *desc,
 	seg->filesz = phdr->p_filesz;
 	seg->sz = phdr->p_memsz;
 	seg->relocated = reloc;
+	seg->desc = desc;
 	INIT_LIST_HEAD(&seg->list);
 
 	return seg;
@@ -620,12 +629,49 @@ static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 		paddr += size;
 	}
 
-	if (desc->ops->verify_blob) {
-		ret = desc->ops->verify_blob(desc, seg->paddr, seg->sz);
+	return ret;
+}
+
+static void pil_load_seg_async(void *data, async_cookie_t cookie)
+{
+	struct pil_seg *seg = data;
+
+	seg->load_ret = pil_load_seg(seg->desc, seg);
+}
+
+/*
+ * Read all the segments in parallel. Verification has to follow the
+ * segment order, so each segment is handed to verify_blob() as soon as it
+ * and all the segments before it are in memory, while the later ones are
+ * still being read.
+ */
+static int pil_load_segs(struct pil_desc *desc)
+{
+	ASYNC_DOMAIN_EXCLUSIVE(load_domain);
+	struct pil_seg *seg;
+	int ret = 0;
+
+	list_for_each_entry(seg, &desc->priv->segs, list)
+		seg->cookie = async_schedule_domain(pil_load_seg_async, seg,
+						    &load_domain);
+
+	list_for_each_entry(seg, &desc->priv->segs, list) {
+		async_synchronize_cookie_domain(seg->cookie + 1, &load_domain);
+		ret = seg->load_ret;
 		if (ret)
-			pil_err(desc, "Blob%u failed verification\n", num);
+			break;
+
+		if (desc->ops->verify_blob) {
+			ret = desc->ops->verify_blob(desc, seg->paddr, seg->sz);
+			if (ret) {
+				pil_err(desc, "Blob%u failed verification\n",
+					seg->num);
+				break;
+			}
+		}
 	}
 
+	async_synchronize_full_domain(&load_domain);
 	return ret;
 }
 
@@ -674,7 +720,6 @@ int pil_boot(struct pil_desc *desc)
 	char fw_name[30];
 	const struct pil_mdt *mdt;
 	const struct elf32_hdr *ehdr;
-	struct pil_seg *seg;
 	const struct firmware *fw;
 	struct pil_priv *priv = desc->priv;
 
@@ -682,6 +727,7 @@ int pil_boot(struct pil_desc *desc)
 	pil_release_mmap(desc);
 
 	down_read(&pil_pm_rwsem);
+	boot_stats_marker("pil %s load start", desc->name);
 	snprintf(fw_name, sizeof(fw_name), "%s.mdt", desc->name);
 	ret = request_firmware(&fw, fw_name, desc->dev);
 	if (ret) {
@@ -744,11 +790,10 @@ int pil_boot(struct pil_desc *desc)
 		goto err_deinit_image;
 	}
 
-	list_for_each_entry(seg, &desc->priv->segs, list) {
-		ret = pil_load_seg(desc, seg);
-		if (ret)
-			goto err_deinit_image;
-	}
+	ret = pil_load_segs(desc);
+	if (ret)
+		goto err_deinit_image;
+	boot_stats_marker("pil %s segments loaded", desc->name);
 
 	ret = desc->ops->auth_and_reset(desc);
 	if (ret) {
@@ -756,6 +801,7 @@ int pil_boot(struct pil_desc *desc)
 		goto err_deinit_image;
 	}
 	pil_info(desc, "Brought out of reset\n");
+	boot_stats_marker("pil %s out of reset", desc->name);
 err_deinit_image:
 	if (ret && desc->ops->deinit_image)
 		desc->ops->deinit_image(desc);
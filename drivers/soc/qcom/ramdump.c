@@ -24,11 +24,21 @@
 #include <linux/uaccess.h>
 #include <linux/elf.h>
 #include <linux/wait.h>
+#include <linux/vmalloc.h>
+#include <linux/mutex.h>
 #include <soc/qcom/ramdump.h>
 #include <linux/dma-mapping.h>
 
 #define RAMDUMP_WAIT_MSECS	120000
 
+/*
+ * Dumps up to this size are copied into a kernel snapshot and handed to
+ * userspace after do_ramdump() has returned, so the subsystem can restart
+ * without waiting for the dump to be read. 0 disables snapshots.
+ */
+static unsigned int snapshot_max_mb;
+module_param(snapshot_max_mb, uint, S_IRUGO | S_IWUSR);
+
 struct ramdump_device {
 	char name[256];
 
@@ -45,8 +55,25 @@ struct ramdump_device {
 	size_t elfcore_size;
 	char *elfcore_buf;
 	struct dma_attrs attrs;
+
+	/* Pending snapshot, read in place of the segments */
+	struct mutex snapshot_lock;
+	void *snapshot_buf;
+	size_t snapshot_size;
 };
 
+/* Called with snapshot_lock held */
+static void ramdump_free_snapshot(struct ramdump_device *rd_dev)
+{
+	vfree(rd_dev->snapshot_buf);
+	rd_dev->snapshot_buf = NULL;
+	rd_dev->snapshot_size = 0;
+	kfree(rd_dev->elfcore_buf);
+	rd_dev->elfcore_buf = NULL;
+	rd_dev->elfcore_size = 0;
+	rd_dev->data_ready = 0;
+}
+
 static int ramdump_open(struct inode *inode, struct file *filep)
 {
 	struct ramdump_device *rd_dev = container_of(filep->private_data,
@@ -62,6 +89,10 @@ static int ramdump_release(struct inode *inode, struct file *filep)
 				struct ramdump_device, device);
 	rd_dev->consumer_present = 0;
 	rd_dev->data_ready = 0;
+	mutex_lock(&rd_dev->snapshot_lock);
+	if (rd_dev->snapshot_buf)
+		ramdump_free_snapshot(rd_dev);
+	mutex_unlock(&rd_dev->snapshot_lock);
 	complete(&rd_dev->ramdump_complete);
 	return 0;
 }
@@ -100,6 +131,37 @@ static unsigned long offset_translate(loff_t user_offset,
 
 #define MAX_IOREMAP_SIZE SZ_1M
 
+static ssize_t ramdump_read_snapshot(struct ramdump_device *rd_dev,
+			char __user *buf, size_t count, loff_t *pos)
+{
+	size_t total = rd_dev->elfcore_size + rd_dev->snapshot_size;
+	size_t copy_size;
+	char *src;
+
+	if (*pos >= total) {
+		pr_debug("Ramdump(%s): Snapshot complete. %lld bytes read.",
+			rd_dev->name, *pos);
+		ramdump_free_snapshot(rd_dev);
+		*pos = 0;
+		return 0;
+	}
+
+	if (*pos < rd_dev->elfcore_size) {
+		src = rd_dev->elfcore_buf + *pos;
+		copy_size = rd_dev->elfcore_size - *pos;
+	} else {
+		src = rd_dev->snapshot_buf + (*pos - rd_dev->elfcore_size);
+		copy_size = total - *pos;
+	}
+	copy_size = min(copy_size, count);
+
+	if (copy_to_user(buf, src, copy_size))
+		return -EFAULT;
+
+	*pos += copy_size;
+	return copy_size;
+}
+
 static ssize_t ramdump_read(struct file *filep, char __user *buf, size_t count,
 			loff_t *pos)
 {
@@ -120,6 +182,14 @@ static ssize_t ramdump_read(struct file *filep, char __user *buf, size_t count,
 	if (ret)
 		return ret;
 
+	mutex_lock(&rd_dev->snapshot_lock);
+	if (rd_dev->snapshot_buf) {
+		ret = ramdump_read_snapshot(rd_dev, buf, count, pos);
+		mutex_unlock(&rd_dev->snapshot_lock);
+		return ret;
+	}
+	mutex_unlock(&rd_dev->snapshot_lock);
+
 	if (*pos < rd_dev->elfcore_size) {
 		copy_size = rd_dev->elfcore_size - *pos;
 		copy_size = min(copy_size, count);
@@ -267,6 +337,7 @@ void *create_ramdump_device(const char *dev_name, struct device *parent)
 		 dev_name);
 
 	init_completion(&rd_dev->ramdump_complete);
+	mutex_init(&rd_dev->snapshot_lock);
 
 	rd_dev->device.minor = MISC_DYNAMIC_MINOR;
 	rd_dev->device.name = rd_dev->name;
@@ -296,10 +367,65 @@ void destroy_ramdump_device(void *dev)
 		return;
 
 	misc_deregister(&rd_dev->device);
+	ramdump_free_snapshot(rd_dev);
+	mutex_destroy(&rd_dev->snapshot_lock);
 	kfree(rd_dev);
 }
 EXPORT_SYMBOL(destroy_ramdump_device);
 
+/* Copy the segments into a snapshot. Called with snapshot_lock held. */
+static int ramdump_snapshot(struct ramdump_device *rd_dev,
+		struct ramdump_segment *segments, int nsegments)
+{
+	size_t total = 0, off = 0, copy_size;
+	unsigned long pos;
+	void *device_mem;
+	char *snapshot;
+	int i;
+
+	for (i = 0; i < nsegments; i++)
+		total += segments[i].size;
+
+	if (!total || total > (size_t)snapshot_max_mb * SZ_1M)
+		return -E2BIG;
+
+	snapshot = vmalloc(total);
+	if (!snapshot)
+		return -ENOMEM;
+
+	init_dma_attrs(&rd_dev->attrs);
+	dma_set_attr(DMA_ATTR_SKIP_ZEROING, &rd_dev->attrs);
+	for (i = 0; i < nsegments; i++) {
+		for (pos = 0; pos < segments[i].size; pos += copy_size) {
+			copy_size = min_t(size_t, segments[i].size - pos,
+					  MAX_IOREMAP_SIZE);
+			if (segments[i].v_address)
+				device_mem = segments[i].v_address + pos;
+			else
+				device_mem = dma_remap(rd_dev->device.parent,
+						NULL, segments[i].address + pos,
+						copy_size, &rd_dev->attrs);
+			if (!device_mem) {
+				pr_err("Ramdump(%s): Unable to ioremap: addr %lx, size %zd\n",
+					rd_dev->name,
+					segments[i].address + pos, copy_size);
+				vfree(snapshot);
+				return -ENOMEM;
+			}
+
+			memcpy_fromio(snapshot + off, device_mem, copy_size);
+			if (!segments[i].v_address)
+				dma_unremap(rd_dev->device.parent, device_mem,
+					    copy_size);
+			off += copy_size;
+		}
+	}
+
+	rd_dev->snapshot_buf = snapshot;
+	rd_dev->snapshot_size = total;
+	return 0;
+}
+
 static int _do_ramdump(void *handle, struct ramdump_segment *segments,
 		int nsegments, bool use_elf)
 {
@@ -314,6 +440,14 @@ static int _do_ramdump(void *handle, struct ramdump_segment *segments,
 		return -EPIPE;
 	}
 
+	mutex_lock(&rd_dev->snapshot_lock);
+	if (rd_dev->snapshot_buf) {
+		mutex_unlock(&rd_dev->snapshot_lock);
+		pr_err("Ramdump(%s): Previous dump not collected yet\n",
+			rd_dev->name);
+		return -EBUSY;
+	}
+
 	for (i = 0; i < nsegments; i++)
 		segments[i].size = PAGE_ALIGN(segments[i].size);
 
@@ -325,8 +459,10 @@ static int _do_ramdump(void *handle, struct ramdump_segment *segments,
 				       sizeof(*phdr) * nsegments;
 		ehdr = kzalloc(rd_dev->elfcore_size, GFP_KERNEL);
 		rd_dev->elfcore_buf = (char *)ehdr;
-		if (!rd_dev->elfcore_buf)
+		if (!rd_dev->elfcore_buf) {
+			mutex_unlock(&rd_dev->snapshot_lock);
 			return -ENOMEM;
+		}
 
 		memcpy(ehdr->e_ident, ELFMAG, SELFMAG);
 		ehdr->e_ident[EI_CLASS] = ELFCLASS32;
@@ -352,6 +488,15 @@ static int _do_ramdump(void *handle, struct ramdump_segment *segments,
 		}
 	}
 
+	/* With a snapshot the segments may be reused as soon as we return */
+	if (snapshot_max_mb && !ramdump_snapshot(rd_dev, segments, nsegments)) {
+		rd_dev->data_ready = 1;
+		mutex_unlock(&rd_dev->snapshot_lock);
+		wake_up(&rd_dev->dump_wait_q);
+		return 0;
+	}
+	mutex_unlock(&rd_dev->snapshot_lock);
+
 	rd_dev->data_ready = 1;
 	rd_dev->ramdump_status = -1;
 
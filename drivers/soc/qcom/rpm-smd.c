@@ -309,6 +309,82 @@ static void tr_update(struct slp_buf *s, char *buf)
 		}
 	}
 }
+/*
+ * Last value sent in the active set for each {resource, key}. Active set
+ * requests that would rewrite the value RPM already holds are dropped.
+ * A NACK from RPM invalidates the whole cache, since we no longer know
+ * what RPM holds.
+ */
+#define MAX_CACHED_KVP_SIZE	16
+
+struct active_kvp {
+	struct rb_node node;
+	uint32_t rsc_type;
+	uint32_t rsc_id;
+	uint32_t key;
+	uint32_t nbytes;	/* 0 when invalid */
+	uint8_t value[MAX_CACHED_KVP_SIZE];
+};
+static struct rb_root active_kvp_root = RB_ROOT;
+static DEFINE_SPINLOCK(active_kvp_lock);
+
+static int active_kvp_cmp(struct active_kvp *a, uint32_t rsc_type,
+		uint32_t rsc_id, uint32_t key)
+{
+	if (a->rsc_type != rsc_type)
+		return a->rsc_type < rsc_type ? -1 : 1;
+	if (a->rsc_id != rsc_id)
+		return a->rsc_id < rsc_id ? -1 : 1;
+	if (a->key != key)
+		return a->key < key ? -1 : 1;
+	return 0;
+}
+
+/* Called with active_kvp_lock held */
+static struct active_kvp *active_kvp_lookup(uint32_t rsc_type,
+		uint32_t rsc_id, uint32_t key, bool create)
+{
+	struct rb_node **node = &active_kvp_root.rb_node, *parent = NULL;
+	struct active_kvp *a;
+	int cmp;
+
+	while (*node) {
+		a = rb_entry(*node, struct active_kvp, node);
+		cmp = active_kvp_cmp(a, rsc_type, rsc_id, key);
+		parent = *node;
+		if (cmp > 0)
+			node = &((*node)->rb_left);
+		else if (cmp < 0)
+			node = &((*node)->rb_right);
+		else
+			return a;
+	}
+
+	if (!create)
+		return NULL;
+
+	a = kzalloc(sizeof(*a), GFP_ATOMIC);
+	if (!a)
+		return NULL;
+	a->rsc_type = rsc_type;
+	a->rsc_id = rsc_id;
+	a->key = key;
+	rb_link_node(&a->node, parent, node);
+	rb_insert_color(&a->node, &active_kvp_root);
+	return a;
+}
+
+static void active_kvp_invalidate(void)
+{
+	struct rb_node *t;
+	unsigned long flags;
+
+	spin_lock_irqsave(&active_kvp_lock, flags);
+	for (t = rb_first(&active_kvp_root); t; t = rb_next(t))
+		rb_entry(t, struct active_kvp, node)->nbytes = 0;
+	spin_unlock_irqrestore(&active_kvp_lock, flags);
+}
+
 static atomic_t msm_rpm_msg_id = ATOMIC_INIT(0);
 
 struct msm_rpm_request {
@@ -321,6 +397,63 @@ struct msm_rpm_request {
 	uint32_t numbytes;
 };
 
+/* Drop the KVPs of an active set request that RPM already holds */
+static void msm_rpm_drop_cached_kvps(struct msm_rpm_request *cdata)
+{
+	struct msm_rpm_kvp_data *kvp;
+	struct active_kvp *a;
+	unsigned long flags;
+	uint32_t i;
+
+	spin_lock_irqsave(&active_kvp_lock, flags);
+	for (i = 0; i < cdata->write_idx; i++) {
+		kvp = &cdata->kvp[i];
+		if (!kvp->valid)
+			continue;
+
+		a = active_kvp_lookup(cdata->msg_hdr.resource_type,
+				cdata->msg_hdr.resource_id, kvp->key, false);
+		if (!a || a->nbytes != kvp->nbytes ||
+				memcmp(a->value, kvp->value, kvp->nbytes))
+			continue;
+
+		kvp->valid = false;
+		cdata->msg_hdr.data_len -= kvp->nbytes +
+					sizeof(struct rpm_request_header);
+	}
+	spin_unlock_irqrestore(&active_kvp_lock, flags);
+}
+
+/* Record the KVPs of an active set request that was just sent */
+static void msm_rpm_cache_kvps(struct msm_rpm_request *cdata)
+{
+	struct msm_rpm_kvp_data *kvp;
+	struct active_kvp *a;
+	unsigned long flags;
+	uint32_t i;
+
+	spin_lock_irqsave(&active_kvp_lock, flags);
+	for (i = 0; i < cdata->write_idx; i++) {
+		kvp = &cdata->kvp[i];
+		if (!kvp->valid)
+			continue;
+
+		a = active_kvp_lookup(cdata->msg_hdr.resource_type,
+				cdata->msg_hdr.resource_id, kvp->key,
+				kvp->nbytes <= MAX_CACHED_KVP_SIZE);
+		if (!a)
+			continue;
+
+		if (kvp->nbytes > MAX_CACHED_KVP_SIZE) {
+			a->nbytes = 0;
+			continue;
+		}
+		memcpy(a->value, kvp->value, kvp->nbytes);
+		a->nbytes = kvp->nbytes;
+	}
+	spin_unlock_irqrestore(&active_kvp_lock, flags);
+}
+
 /*
  * Data related to message acknowledgement
  */
@@ -855,6 +988,9 @@ static void msm_rpm_process_ack(uint32_t msg_id, int errno)
 		trace_rpm_smd_ack_recvd(0, msg_id, 0xDEADBEEF);
 
 	spin_unlock_irqrestore(&msm_rpm_list_lock, flags);
+
+	if (errno)
+		active_kvp_invalidate();
 }
 
 struct msm_rpm_kvp_packet {
@@ -1090,6 +1226,9 @@ static int msm_rpm_send_data(struct msm_rpm_request *cdata,
 	if (probe_status)
 		return probe_status;
 
+	if (cdata->msg_hdr.set == MSM_RPM_CTX_ACTIVE_SET && !standalone)
+		msm_rpm_drop_cached_kvps(cdata);
+
 	if (!cdata->msg_hdr.data_len)
 		return 1;
 
@@ -1168,6 +1307,8 @@ static int msm_rpm_send_data(struct msm_rpm_request *cdata,
 	ret = msm_rpm_send_smd_buffer(&cdata->buf[0], msg_size, noirq);
 
 	if (ret == msg_size) {
+		if (cdata->msg_hdr.set == MSM_RPM_CTX_ACTIVE_SET)
+			msm_rpm_cache_kvps(cdata);
 		for (i = 0; (i < cdata->write_idx); i++)
 			cdata->kvp[i].valid = false;
 		cdata->msg_hdr.data_len = 0;
@@ -26,6 +26,7 @@
 #include <linux/list.h>
 #include <linux/slab.h>
 #include <linux/delay.h>
+#include <linux/hrtimer.h>
 #include <linux/io.h>
 #include <linux/termios.h>
 #include <linux/ctype.h>
@@ -144,6 +145,11 @@ int msm_smd_debug_mask = MSM_SMD_POWER_INFO | MSM_SMD_INFO |
 							MSM_SMSM_POWER_INFO;
 module_param_named(debug_mask, msm_smd_debug_mask,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* default write notification coalescing window for newly opened channels */
+static unsigned smd_write_coalesce_us;
+module_param_named(write_coalesce_us, smd_write_coalesce_us,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
 void *smd_log_ctx;
 void *smsm_log_ctx;
 #define NUM_LOG_PAGES 4
@@ -1552,6 +1558,66 @@ static int smd_is_packet(struct smd_alloc_elm *alloc_elm)
 					SMD_CHANNEL_TYPE(alloc_elm->type));
 }
 
+static enum hrtimer_restart smd_ntfy_timer_fn(struct hrtimer *timer)
+{
+	struct smd_channel *ch = container_of(timer, struct smd_channel,
+						ntfy_timer);
+
+	if (ch_is_open(ch)) {
+		ch->ntfy_signalled = true;
+		ch->notify_other_cpu(ch);
+	}
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * smd_notify_write() - tell the remote side that new data was written
+ * @ch: channel that was written to
+ * @busy: remote had not yet serviced our previous interrupt when the write
+ *	started
+ *
+ * With coalescing disabled this is a plain notify_other_cpu().  Otherwise
+ * the interrupt is suppressed while the remote is still processing the
+ * FIFO because of an earlier one, and a flush is deferred by coalesce_us so
+ * that data written after the remote has sampled the head pointer is never
+ * left unannounced.
+ */
+static void smd_notify_write(struct smd_channel *ch, bool busy)
+{
+	if (!ch->coalesce_us) {
+		ch->notify_other_cpu(ch);
+		return;
+	}
+
+	if (busy) {
+		++interrupt_stats[edge_to_pids[ch->type].remote_pid]
+							.smd_out_coalesced;
+		if (!hrtimer_is_queued(&ch->ntfy_timer))
+			hrtimer_start(&ch->ntfy_timer,
+				ns_to_ktime(ch->coalesce_us * NSEC_PER_USEC),
+				HRTIMER_MODE_REL);
+		return;
+	}
+
+	hrtimer_try_to_cancel(&ch->ntfy_timer);
+	ch->ntfy_signalled = true;
+	ch->notify_other_cpu(ch);
+}
+
+/*
+ * The remote clears fHEAD once it services our interrupt, so a set fHEAD
+ * with an interrupt raised since then means the remote is due to read the
+ * FIFO anyway.  Must be sampled before the write sets fHEAD again.
+ */
+static bool smd_remote_busy(struct smd_channel *ch)
+{
+	if (!ch->coalesce_us)
+		return false;
+	if (!ch->half_ch->get_fHEAD(ch->send))
+		ch->ntfy_signalled = false;
+	return ch->ntfy_signalled;
+}
+
 static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 				bool intr_ntfy)
 {
@@ -1559,6 +1625,7 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 	const unsigned char *buf = _data;
 	unsigned xfer;
 	int orig_len = len;
+	bool busy;
 
 	SMD_DBG("smd_stream_write() %d -> ch%d\n", len, ch->n);
 	if (len < 0)
@@ -1566,6 +1633,8 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 	else if (len == 0)
 		return 0;
 
+	busy = smd_remote_busy(ch);
+
 	while ((xfer = ch_write_buffer(ch, &ptr)) != 0) {
 		if (!ch_is_open(ch)) {
 			len = orig_len;
@@ -1583,7 +1652,7 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 	}
 
 	if (orig_len - len && intr_ntfy)
-		ch->notify_other_cpu(ch);
+		smd_notify_write(ch, busy);
 
 	return orig_len - len;
 }
@@ -1847,6 +1916,9 @@ static int smd_alloc_channel(struct smd_alloc_elm *alloc_elm, int table_id,
 	ch->pdev.name = ch->name;
 	ch->pdev.id = ch->type;
 
+	hrtimer_init(&ch->ntfy_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ch->ntfy_timer.function = smd_ntfy_timer_fn;
+
 	SMD_INFO("smd_alloc_channel() '%s' cid=%d\n",
 		 ch->name, ch->n);
 
@@ -1984,6 +2056,9 @@ int smd_named_open_on_edge(const char *name, uint32_t edge,
 	ch->current_packet = 0;
 	ch->last_state = SMD_SS_CLOSED;
 	ch->priv = priv;
+	ch->ntfy_signalled = false;
+	/* RPM requests are latency bound and never batched by default */
+	ch->coalesce_us = ch->type == SMD_APPS_RPM ? 0 : smd_write_coalesce_us;
 
 	*_ch = ch;
 
@@ -2013,6 +2088,9 @@ int smd_close(smd_channel_t *ch)
 
 	SMD_INFO("smd_close(%s)\n", ch->name);
 
+	ch->coalesce_us = 0;
+	hrtimer_cancel(&ch->ntfy_timer);
+
 	spin_lock_irqsave(&smd_lock, flags);
 	list_del(&ch->ch_list);
 
@@ -2171,6 +2249,136 @@ int smd_read_from_cb(smd_channel_t *ch, void *data, int len)
 }
 EXPORT_SYMBOL(smd_read_from_cb);
 
+int smd_read_peek(smd_channel_t *ch, struct kvec vec[2], int len)
+{
+	void *ptr;
+	int avail;
+	unsigned n;
+
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+
+	if (!vec || len < 0)
+		return -EINVAL;
+
+	if (ch->current_packet > (uint32_t)INT_MAX) {
+		pr_err("%s: Invalid packet size for Edge %d and Channel %s",
+			__func__, ch->type, ch->name);
+		return -EFAULT;
+	}
+
+	vec[0].iov_base = NULL;
+	vec[0].iov_len = 0;
+	vec[1].iov_base = NULL;
+	vec[1].iov_len = 0;
+
+	avail = ch->read_avail(ch);
+	if (len > avail)
+		len = avail;
+	if (len == 0)
+		return 0;
+
+	n = ch_read_buffer(ch, &ptr);
+	if (n > len)
+		n = len;
+	vec[0].iov_base = ptr;
+	vec[0].iov_len = n;
+	if (n < len) {
+		vec[1].iov_base = (void *)ch->recv_data;
+		vec[1].iov_len = len - n;
+	}
+
+	return len;
+}
+EXPORT_SYMBOL(smd_read_peek);
+
+int smd_read_consume(smd_channel_t *ch, int len)
+{
+	unsigned long flags;
+
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+
+	if (len < 0 || len > ch->read_avail(ch))
+		return -EINVAL;
+	if (len == 0)
+		return 0;
+
+	ch_read_done(ch, len);
+	if (!read_intr_blocked(ch))
+		ch->notify_other_cpu(ch);
+
+	if (ch->is_pkt_ch) {
+		spin_lock_irqsave(&smd_lock, flags);
+		ch->current_packet -= len;
+		update_packet_state(ch);
+		spin_unlock_irqrestore(&smd_lock, flags);
+	}
+
+	return len;
+}
+EXPORT_SYMBOL(smd_read_consume);
+
+int smd_read_packets(smd_channel_t *ch,
+		     void *(*get_buf)(void *priv, int len), void *priv,
+		     int max_pkts)
+{
+	unsigned long flags;
+	void *buf;
+	int len;
+	int n = 0;
+
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+
+	if (!ch->is_pkt_ch || !get_buf || max_pkts < 0)
+		return -EINVAL;
+
+	spin_lock_irqsave(&smd_lock, flags);
+	while (!max_pkts || n < max_pkts) {
+		if (ch->current_packet > (uint32_t)INT_MAX)
+			break;
+		len = ch->current_packet;
+		if (!len || smd_stream_read_avail(ch) < len)
+			break;
+
+		buf = get_buf(priv, len);
+		ch_read(ch, buf, len);
+		ch->current_packet = 0;
+		update_packet_state(ch);
+		n++;
+	}
+	spin_unlock_irqrestore(&smd_lock, flags);
+
+	if (n && !read_intr_blocked(ch))
+		ch->notify_other_cpu(ch);
+
+	return n;
+}
+EXPORT_SYMBOL(smd_read_packets);
+
+int smd_copy_from_fifo(smd_channel_t *ch, void *dest, const void *src,
+		       int len)
+{
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+
+	if (!dest || !src || len < 0)
+		return -EINVAL;
+
+	ch->read_from_fifo(dest, src, len);
+	return len;
+}
+EXPORT_SYMBOL(smd_copy_from_fifo);
+
 int smd_write(smd_channel_t *ch, const void *data, int len)
 {
 	if (!ch) {
@@ -2182,6 +2390,21 @@ int smd_write(smd_channel_t *ch, const void *data, int len)
 }
 EXPORT_SYMBOL(smd_write);
 
+int smd_set_write_coalesce(smd_channel_t *ch, unsigned int usecs)
+{
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+
+	ch->coalesce_us = usecs;
+	if (!usecs && hrtimer_cancel(&ch->ntfy_timer))
+		ch->notify_other_cpu(ch);
+
+	return 0;
+}
+EXPORT_SYMBOL(smd_set_write_coalesce);
+
 int smd_read_avail(smd_channel_t *ch)
 {
 	if (!ch) {
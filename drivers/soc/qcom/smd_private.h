@@ -22,6 +22,7 @@
 #include <linux/remote_spinlock.h>
 #include <linux/platform_device.h>
 #include <linux/interrupt.h>
+#include <linux/hrtimer.h>
 
 #include <soc/qcom/smd.h>
 #include <soc/qcom/smsm.h>
@@ -162,6 +163,15 @@ struct smd_channel {
 
 	char is_pkt_ch;
 
+	/*
+	 * write notification coalescing: while the remote has not yet
+	 * serviced our last interrupt, further writes only arm ntfy_timer
+	 * instead of raising another interrupt
+	 */
+	unsigned coalesce_us;
+	bool ntfy_signalled;
+	struct hrtimer ntfy_timer;
+
 	/*
 	 * private internal functions to access *send and *recv.
 	 * never to be exported outside of smd
@@ -174,6 +184,7 @@ extern spinlock_t smem_lock;
 struct interrupt_stat {
 	uint32_t smd_in_count;
 	uint32_t smd_out_count;
+	uint32_t smd_out_coalesced;
 	uint32_t smd_interrupt_id;
 
 	uint32_t smsm_in_count;
@@ -12,6 +12,7 @@
 
 #include <linux/export.h>
 #include <linux/err.h>
+#include <linux/hash.h>
 #include <linux/init.h>
 #include <linux/ipc_logging.h>
 #include <linux/kernel.h>
@@ -140,6 +141,36 @@ struct smem_partition_info {
 static struct smem_partition_info partitions[NUM_SMEM_SUBSYSTEMS];
 /* end smem security feature components */
 
+/*
+ * Lookup cache for existing SMEM items.  Items are never freed or moved
+ * once allocated, so a successful lookup can be remembered for good and
+ * later lookups of the same item avoid the TOC read or partition scan in
+ * uncached shared memory.  Misses are never cached since a remote host may
+ * allocate the item at any time.  Slots are only ever filled, never
+ * cleared, which lets readers run without a lock: the key is published
+ * after the data it describes.
+ */
+#define SMEM_CACHE_BITS 8
+#define SMEM_CACHE_SIZE (1 << SMEM_CACHE_BITS)
+#define SMEM_CACHE_KEY_VALID BIT(31)
+#define SMEM_CACHE_KEY_CACHED BIT(30)
+#define SMEM_CACHE_NONSECURE_HOST 0xff
+#define SMEM_CACHE_KEY(id, host, cached) (SMEM_CACHE_KEY_VALID | \
+	((cached) ? SMEM_CACHE_KEY_CACHED : 0) | ((host) << 16) | (id))
+
+struct smem_cache_entry {
+	uint32_t key;
+	unsigned size;
+	void *item;
+};
+
+static struct smem_cache_entry smem_cache[SMEM_CACHE_SIZE];
+static DEFINE_SPINLOCK(smem_cache_lock);
+static atomic_t smem_cache_hits = ATOMIC_INIT(0);
+static atomic_t smem_cache_misses = ATOMIC_INIT(0);
+static int smem_cache_used;
+static int smem_cache_full;
+
 /* Identifier for the SMEM target info struct. */
 #define SMEM_TARG_INFO_IDENTIFIER 0x49494953 /* "SIII" in little-endian. */
 
@@ -288,6 +319,80 @@ phys_addr_t smem_virt_to_phys(void *smem_address)
 }
 EXPORT_SYMBOL(smem_virt_to_phys);
 
+/**
+ * smem_cache_lookup - Look up a previously found SMEM item
+ *
+ * @key:     Cache key of the item
+ * @size:    Pointer to size variable for storing the result
+ * @returns: Pointer to SMEM item or NULL if it is not cached
+ */
+static void *smem_cache_lookup(uint32_t key, unsigned *size)
+{
+	struct smem_cache_entry *entry;
+	unsigned i, slot = hash_32(key, SMEM_CACHE_BITS);
+	uint32_t k;
+
+	for (i = 0; i < SMEM_CACHE_SIZE; i++) {
+		entry = &smem_cache[(slot + i) & (SMEM_CACHE_SIZE - 1)];
+		k = ACCESS_ONCE(entry->key);
+		if (!k)
+			break;
+		if (k == key) {
+			smp_rmb();
+			*size = entry->size;
+			atomic_inc(&smem_cache_hits);
+			return entry->item;
+		}
+	}
+	atomic_inc(&smem_cache_misses);
+	return NULL;
+}
+
+/**
+ * smem_cache_insert - Remember the location of an existing SMEM item
+ *
+ * @key:  Cache key of the item
+ * @item: Pointer to the SMEM item
+ * @size: Size of the SMEM item
+ */
+static void smem_cache_insert(uint32_t key, void *item, unsigned size)
+{
+	struct smem_cache_entry *entry;
+	unsigned i, slot = hash_32(key, SMEM_CACHE_BITS);
+	unsigned long flags;
+
+	spin_lock_irqsave(&smem_cache_lock, flags);
+	/* keep a free slot so that lookups of uncached items terminate early */
+	if (smem_cache_used >= SMEM_CACHE_SIZE - 1) {
+		smem_cache_full++;
+		goto out;
+	}
+	for (i = 0; i < SMEM_CACHE_SIZE; i++) {
+		entry = &smem_cache[(slot + i) & (SMEM_CACHE_SIZE - 1)];
+		if (entry->key == key)
+			goto out;
+		if (!entry->key) {
+			entry->item = item;
+			entry->size = size;
+			smp_wmb();
+			ACCESS_ONCE(entry->key) = key;
+			smem_cache_used++;
+			break;
+		}
+	}
+out:
+	spin_unlock_irqrestore(&smem_cache_lock, flags);
+}
+
+void smem_get_cache_stats(struct smem_cache_stats *stats)
+{
+	stats->hits = atomic_read(&smem_cache_hits);
+	stats->misses = atomic_read(&smem_cache_misses);
+	stats->used = smem_cache_used;
+	stats->size = SMEM_CACHE_SIZE;
+	stats->full = smem_cache_full;
+}
+
 /**
  * __smem_get_entry_nonsecure - Get pointer and size of existing SMEM item
  *
@@ -305,6 +410,7 @@ static void *__smem_get_entry_nonsecure(unsigned id, unsigned *size,
 	int use_spinlocks = spinlocks_initialized && use_rspinlock;
 	void *ret = 0;
 	unsigned long flags = 0;
+	uint32_t key;
 
 	if (!skip_init_check && !smem_initialized_check())
 		return ret;
@@ -312,6 +418,11 @@ static void *__smem_get_entry_nonsecure(unsigned id, unsigned *size,
 	if (id >= SMEM_NUM_ITEMS)
 		return ret;
 
+	key = SMEM_CACHE_KEY(id, SMEM_CACHE_NONSECURE_HOST, false);
+	ret = smem_cache_lookup(key, size);
+	if (ret)
+		return ret;
+
 	if (use_spinlocks)
 		remote_spin_lock_irqsave(&remote_spinlock, flags);
 	/* toc is in device memory and cannot be speculatively accessed */
@@ -331,6 +442,8 @@ static void *__smem_get_entry_nonsecure(unsigned id, unsigned *size,
 	if (use_spinlocks)
 		remote_spin_unlock_irqrestore(&remote_spinlock, flags);
 
+	if (ret)
+		smem_cache_insert(key, ret, *size);
 	return ret;
 }
 
@@ -359,6 +472,7 @@ static void *__smem_get_entry_secure(unsigned id,
 	struct smem_partition_allocation_header *alloc_hdr;
 	uint32_t partition_num;
 	uint32_t a_hdr_size;
+	uint32_t key;
 	int rc;
 
 	SMEM_DBG("%s(%u, %u, %u, %d, %d)\n", __func__, id, to_proc,
@@ -382,6 +496,11 @@ static void *__smem_get_entry_secure(unsigned id,
 		return __smem_get_entry_nonsecure(id, size, skip_init_check,
 								use_rspinlock);
 
+	key = SMEM_CACHE_KEY(id, to_proc, flags & SMEM_ITEM_CACHED_FLAG);
+	item = smem_cache_lookup(key, size);
+	if (item)
+		return item;
+
 	partition_num = partitions[to_proc].partition_num;
 	hdr = smem_areas[0].virt_addr + partitions[to_proc].offset;
 	if (unlikely(!spinlocks_initialized)) {
@@ -463,6 +582,8 @@ static void *__smem_get_entry_secure(unsigned id,
 	if (use_rspinlock)
 		remote_spin_unlock_irqrestore(&remote_spinlock, lflags);
 
+	if (item)
+		smem_cache_insert(key, item, *size);
 	return item;
 }
 
@@ -86,6 +86,16 @@ static void debug_read_build_id(struct seq_file *s)
 	seq_write(s, data, size);
 }
 
+static void debug_read_lookup_cache(struct seq_file *s)
+{
+	struct smem_cache_stats stats;
+
+	smem_get_cache_stats(&stats);
+	seq_printf(s, "hits: %u\nmisses: %u\nentries: %u/%u\nfull: %u\n",
+			stats.hits, stats.misses, stats.used, stats.size,
+			stats.full);
+}
+
 static int debugfs_show(struct seq_file *s, void *data)
 {
 	void (*show)(struct seq_file *) = s->private;
@@ -128,6 +138,7 @@ static int __init smem_debugfs_init(void)
 
 	debug_create("mem", 0444, dent, debug_read_mem);
 	debug_create("version", 0444, dent, debug_read_smem_version);
+	debug_create("lookup_cache", 0444, dent, debug_read_lookup_cache);
 
 	/* NNV: this is google only stuff */
 	debug_create("build", 0444, dent, debug_read_build_id);
@@ -94,6 +94,21 @@ int smem_module_init_notifier_unregister(struct notifier_block *nb);
  */
 unsigned smem_get_free_space(unsigned to_proc);
 
+struct smem_cache_stats {
+	unsigned hits;
+	unsigned misses;
+	unsigned used;
+	unsigned size;
+	unsigned full;
+};
+
+/**
+ * smem_get_cache_stats() - Get statistics of the SMEM item lookup cache
+ *
+ * @stats: Filled in with the current cache statistics
+ */
+void smem_get_cache_stats(struct smem_cache_stats *stats);
+
 /**
  * smem_get_version() - Get the smem user version number
  *
@@ -68,6 +68,10 @@ struct smp2p_out_list_item {
 
 	bool feature_ssr_ack_enabled;
 	bool restart_ack;
+
+	/* interrupts are held back while a batch of updates is applied */
+	bool defer_interrupt;
+	bool interrupt_pending;
 };
 static struct smp2p_out_list_item out_list[SMP2P_NUM_PROCS];
 
@@ -1362,6 +1366,63 @@ int msm_smp2p_out_modify(struct msm_smp2p_out *handle, uint32_t set_mask,
 }
 EXPORT_SYMBOL(msm_smp2p_out_modify);
 
+/**
+ * msm_smp2p_out_modify_batch - Modifies several entries of one edge at once.
+ *
+ * @updates: Array of modifications, all for entries of the same remote
+ *           processor.
+ * @num_updates: Number of elements in @updates.
+ * @returns: 0 on success, standard Linux error code otherwise.
+ *
+ * Applies each modification as msm_smp2p_out_modify() would, but under a
+ * single acquisition of the edge lock and with a single interrupt to the
+ * remote processor once all of them are visible.  The batch stops at the
+ * first failing modification; the ones before it remain applied and are
+ * still signalled.
+ */
+int msm_smp2p_out_modify_batch(struct msm_smp2p_out_update *updates,
+							int num_updates)
+{
+	int ret = 0;
+	int i;
+	int remote_pid;
+	unsigned long flags;
+	struct smp2p_out_list_item *out_item;
+
+	if (!updates || num_updates <= 0 || !updates[0].handle)
+		return -EINVAL;
+
+	remote_pid = updates[0].handle->remote_pid;
+	for (i = 1; i < num_updates; i++) {
+		if (!updates[i].handle ||
+		    updates[i].handle->remote_pid != remote_pid)
+			return -EINVAL;
+	}
+
+	if ((remote_pid != SMP2P_REMOTE_MOCK_PROC) &&
+			!smp2p_int_cfgs[remote_pid].is_configured) {
+		SMP2P_INFO("%s before msm_smp2p_init(): pid[%d]\n",
+			__func__, remote_pid);
+		return -EPROBE_DEFER;
+	}
+
+	out_item = &out_list[remote_pid];
+	spin_lock_irqsave(&out_item->out_item_lock_lha1, flags);
+	out_item->defer_interrupt = true;
+	for (i = 0; i < num_updates && !ret; i++)
+		ret = out_item->ops_ptr->modify_entry(updates[i].handle,
+				updates[i].set_mask, updates[i].clear_mask);
+	out_item->defer_interrupt = false;
+	if (out_item->interrupt_pending) {
+		out_item->interrupt_pending = false;
+		smp2p_send_interrupt(remote_pid);
+	}
+	spin_unlock_irqrestore(&out_item->out_item_lock_lha1, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL(msm_smp2p_out_modify_batch);
+
 /**
  * msm_smp2p_in_read - Read an entry on a remote processor.
  *
@@ -1573,6 +1634,11 @@ EXPORT_SYMBOL(msm_smp2p_in_unregister);
  */
 static void smp2p_send_interrupt(int remote_pid)
 {
+	if (out_list[remote_pid].defer_interrupt) {
+		out_list[remote_pid].interrupt_pending = true;
+		return;
+	}
+
 	if (smp2p_int_cfgs[remote_pid].name)
 		SMP2P_DBG("SMP2P Int Apps->%s(%d)\n",
 			smp2p_int_cfgs[remote_pid].name, remote_pid);
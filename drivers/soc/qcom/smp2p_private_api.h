@@ -62,6 +62,19 @@ struct msm_smp2p_update_notif {
 	uint32_t current_value;
 };
 
+/**
+ * One entry modification of a batch passed to msm_smp2p_out_modify_batch().
+ *
+ * @handle:      outbound entry to modify
+ * @set_mask:    bits to set
+ * @clear_mask:  bits to clear (applied before @set_mask)
+ */
+struct msm_smp2p_out_update {
+	struct msm_smp2p_out *handle;
+	uint32_t set_mask;
+	uint32_t clear_mask;
+};
+
 int msm_smp2p_out_open(int remote_pid, const char *entry,
 	struct notifier_block *open_notifier,
 	struct msm_smp2p_out **handle);
@@ -70,6 +83,8 @@ int msm_smp2p_out_read(struct msm_smp2p_out *handle, uint32_t *data);
 int msm_smp2p_out_write(struct msm_smp2p_out *handle, uint32_t data);
 int msm_smp2p_out_modify(struct msm_smp2p_out *handle, uint32_t set_mask,
 	uint32_t clear_mask);
+int msm_smp2p_out_modify_batch(struct msm_smp2p_out_update *updates,
+	int num_updates);
 int msm_smp2p_in_read(int remote_pid, const char *entry, uint32_t *data);
 int msm_smp2p_in_register(int remote_pid, const char *entry,
 	struct notifier_block *in_notifier);
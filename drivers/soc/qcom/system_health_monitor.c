@@ -16,6 +16,8 @@
 #include <linux/fs.h>
 #include <linux/ioctl.h>
 #include <linux/ipc_logging.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
@@ -26,10 +28,12 @@
 #include <linux/srcu.h>
 #include <linux/thread_info.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 
 #include <soc/qcom/msm_qmi_interface.h>
 #include <soc/qcom/subsystem_notif.h>
 #include <soc/qcom/subsystem_restart.h>
+#include <soc/qcom/system_health_monitor.h>
 
 #include "system_health_monitor_v01.h"
 
@@ -80,6 +84,78 @@ static struct device *system_health_monitor_devp;
 #define CHECK_SYSTEM_HEALTH_IOCTL \
 	_IOR(SYSTEM_HEALTH_MONITOR_IOCTL_MAGIC, 0, unsigned int)
 
+#define SHM_TELEM_VERSION 1
+#define SHM_TELEM_MAX_STATS 32
+#define SHM_TELEM_NAME_LEN 32
+#define SHM_TELEM_NUM_PAGES 16
+
+/**
+ * struct shm_telem_hdr - Header of the telemetry ring buffer
+ * @version:		Layout version, SHM_TELEM_VERSION.
+ * @num_stats:		Number of valid value slots in each record.
+ * @record_size:	Size of one record in bytes.
+ * @num_records:	Number of records in the ring.
+ * @period_ms:		Sampling period used for the latest record.
+ * @reserved:		Reserved for future use.
+ * @head:		Number of records written so far. Record n lives in
+ *			slot n % num_records.
+ * @names:		Name of the stat sampled into each value slot. An
+ *			empty name marks an unused slot.
+ *
+ * The header occupies the first page of the buffer mapped through the
+ * character device and the records follow from the second page on.
+ * A record is complete once @head has moved past it.
+ */
+struct shm_telem_hdr {
+	uint32_t version;
+	uint32_t num_stats;
+	uint32_t record_size;
+	uint32_t num_records;
+	uint32_t period_ms;
+	uint32_t reserved[3];
+	uint64_t head;
+	char names[SHM_TELEM_MAX_STATS][SHM_TELEM_NAME_LEN];
+};
+
+/**
+ * struct shm_telem_record - One telemetry sample
+ * @timestamp_ns:	Monotonic time at which the sample was taken.
+ * @val:		Value of each registered stat.
+ */
+struct shm_telem_record {
+	uint64_t timestamp_ns;
+	uint64_t val[SHM_TELEM_MAX_STATS];
+};
+
+/**
+ * struct shm_telem_stat - A registered telemetry source
+ * @name:	Name of the stat.
+ * @get:	Callback to read the current value of the stat.
+ * @priv:	Private data passed to @get.
+ */
+struct shm_telem_stat {
+	char name[SHM_TELEM_NAME_LEN];
+	uint64_t (*get)(void *priv);
+	void *priv;
+};
+
+static struct shm_telem_stat shm_telem_stats[SHM_TELEM_MAX_STATS];
+static DEFINE_MUTEX(shm_telem_lock);
+static struct shm_telem_hdr *shm_telem_hdr;
+static uint32_t shm_telem_idx;
+static void shm_telem_sample(struct work_struct *work);
+static DECLARE_DEFERRABLE_WORK(shm_telem_work, shm_telem_sample);
+
+static int shm_telem_period_ms;
+static int shm_telem_set_period(const char *val,
+				const struct kernel_param *kp);
+static struct kernel_param_ops shm_telem_period_ops = {
+	.set = shm_telem_set_period,
+	.get = param_get_int,
+};
+module_param_cb(telemetry_period_ms, &shm_telem_period_ops,
+		&shm_telem_period_ms, S_IRUGO | S_IWUSR | S_IWGRP);
+
 static struct workqueue_struct *shm_svc_workqueue;
 static void shm_svc_recv_msg(struct work_struct *work);
 static DECLARE_DELAYED_WORK(work_recv_msg, shm_svc_recv_msg);
@@ -114,6 +190,8 @@ static void shm_svc_req_worker(struct work_struct *work);
  * @restart_nb:		Notifier block to receive subsystem restart events.
  * @restart_nb_h:	Handle to subsystem restart notifier block.
  * @rs:			Rate-limit the health check.
+ * @ssr_count:		Count of the restarts undergone by the subsystem.
+ * @stat_ids:		Telemetry stat ids registered for this HMA.
  */
 struct hma_info {
 	struct list_head list;
@@ -128,6 +206,8 @@ struct hma_info {
 	struct notifier_block restart_nb;
 	void *restart_nb_h;
 	struct ratelimit_state rs;
+	atomic_t ssr_count;
+	int stat_ids[3];
 };
 
 struct restart_work {
@@ -190,6 +270,7 @@ static int restart_notifier_cb(struct notifier_block *this,
 		container_of(this, struct hma_info, restart_nb);
 
 	if (code == SUBSYS_BEFORE_SHUTDOWN) {
+		atomic_inc(&tmp_hma_info->ssr_count);
 		atomic_set(&tmp_hma_info->is_in_reset, 1);
 		synchronize_srcu(&tmp_hma_info->reset_srcu);
 		SHM_INFO("%s: %s going to shutdown\n",
@@ -680,6 +761,236 @@ static struct qmi_svc_ops_options shm_svc_ops_options = {
 	.req_cb = shm_svc_req_cb,
 };
 
+/**
+ * shm_telem_record() - Get a record slot of the telemetry ring buffer
+ * @hdr:	Header of the telemetry ring buffer.
+ * @idx:	Index of the record slot.
+ *
+ * Return: Pointer to the record slot.
+ */
+static struct shm_telem_record *shm_telem_record(struct shm_telem_hdr *hdr,
+						  uint32_t idx)
+{
+	return (struct shm_telem_record *)((char *)hdr + PAGE_SIZE +
+					   idx * sizeof(struct shm_telem_record));
+}
+
+/**
+ * shm_telem_sync_hdr() - Update the stat names in the telemetry header
+ *
+ * This function must be called with shm_telem_lock held.
+ */
+static void shm_telem_sync_hdr(void)
+{
+	int i;
+	uint32_t num_stats = 0;
+
+	if (!shm_telem_hdr)
+		return;
+
+	for (i = 0; i < SHM_TELEM_MAX_STATS; i++) {
+		strlcpy(shm_telem_hdr->names[i], shm_telem_stats[i].name,
+			SHM_TELEM_NAME_LEN);
+		if (shm_telem_stats[i].get)
+			num_stats = i + 1;
+	}
+	shm_telem_hdr->num_stats = num_stats;
+}
+
+/**
+ * shm_telem_sample() - Worker to take one telemetry sample
+ * @work:	Reference to the work item.
+ *
+ * This function reads every registered stat into the next record of the
+ * ring buffer and re-arms itself as long as sampling is enabled. The work
+ * is deferrable so that sampling does not wake up an idle system.
+ */
+static void shm_telem_sample(struct work_struct *work)
+{
+	int i;
+	int period_ms = ACCESS_ONCE(shm_telem_period_ms);
+	struct shm_telem_hdr *hdr = shm_telem_hdr;
+	struct shm_telem_record *rec;
+
+	if (!hdr || period_ms <= 0)
+		return;
+
+	mutex_lock(&shm_telem_lock);
+	rec = shm_telem_record(hdr, shm_telem_idx);
+	rec->timestamp_ns = ktime_to_ns(ktime_get());
+	for (i = 0; i < hdr->num_stats; i++) {
+		if (shm_telem_stats[i].get)
+			rec->val[i] = shm_telem_stats[i].get(
+						shm_telem_stats[i].priv);
+		else
+			rec->val[i] = 0;
+	}
+	hdr->period_ms = period_ms;
+	/* Publish the record before moving the head past it */
+	smp_wmb();
+	hdr->head++;
+	if (++shm_telem_idx == hdr->num_records)
+		shm_telem_idx = 0;
+	mutex_unlock(&shm_telem_lock);
+
+	schedule_delayed_work(&shm_telem_work, msecs_to_jiffies(period_ms));
+}
+
+/**
+ * shm_telem_set_period() - Set the telemetry sampling period
+ * @val:	Value written to the module parameter.
+ * @kp:		Reference to the module parameter.
+ *
+ * A period of 0 stops sampling. Any other period (re)starts it right away.
+ *
+ * Return: 0 on success, standard Linux error codes on failure.
+ */
+static int shm_telem_set_period(const char *val,
+				const struct kernel_param *kp)
+{
+	int rc;
+
+	rc = param_set_int(val, kp);
+	if (rc)
+		return rc;
+
+	if (shm_telem_hdr && shm_telem_period_ms > 0)
+		mod_delayed_work(system_wq, &shm_telem_work, 0);
+	return 0;
+}
+
+/**
+ * shm_register_stat() - Register a telemetry stat
+ * @name:	Name of the stat as reported to the user-space.
+ * @get:	Callback to read the current value of the stat.
+ * @priv:	Private data passed to @get.
+ *
+ * @get is called from process context once every sampling period and must
+ * be cheap. It can sleep, but it must not call back into this module.
+ *
+ * Return: Stat id on success, standard Linux error codes on failure.
+ */
+int shm_register_stat(const char *name, uint64_t (*get)(void *priv),
+		      void *priv)
+{
+	int i;
+
+	if (!name || !get)
+		return -EINVAL;
+
+	mutex_lock(&shm_telem_lock);
+	for (i = 0; i < SHM_TELEM_MAX_STATS; i++)
+		if (!shm_telem_stats[i].get)
+			break;
+	if (i == SHM_TELEM_MAX_STATS) {
+		mutex_unlock(&shm_telem_lock);
+		SHM_ERR("%s: No free slot for %s\n", __func__, name);
+		return -ENOSPC;
+	}
+
+	strlcpy(shm_telem_stats[i].name, name, SHM_TELEM_NAME_LEN);
+	shm_telem_stats[i].get = get;
+	shm_telem_stats[i].priv = priv;
+	shm_telem_sync_hdr();
+	mutex_unlock(&shm_telem_lock);
+	SHM_DEBUG("%s: %s registered as stat %d\n", __func__, name, i);
+	return i;
+}
+EXPORT_SYMBOL(shm_register_stat);
+
+/**
+ * shm_unregister_stat() - Unregister a telemetry stat
+ * @id:		Stat id returned by shm_register_stat().
+ */
+void shm_unregister_stat(int id)
+{
+	if (id < 0 || id >= SHM_TELEM_MAX_STATS)
+		return;
+
+	mutex_lock(&shm_telem_lock);
+	memset(&shm_telem_stats[id], 0, sizeof(shm_telem_stats[id]));
+	shm_telem_sync_hdr();
+	mutex_unlock(&shm_telem_lock);
+}
+EXPORT_SYMBOL(shm_unregister_stat);
+
+static uint64_t shm_hma_ssr_count(void *priv)
+{
+	struct hma_info *hma = priv;
+
+	return atomic_read(&hma->ssr_count);
+}
+
+static uint64_t shm_hma_check_count(void *priv)
+{
+	struct hma_info *hma = priv;
+
+	return atomic_read(&hma->check_count);
+}
+
+static uint64_t shm_hma_report_count(void *priv)
+{
+	struct hma_info *hma = priv;
+
+	return atomic_read(&hma->report_count);
+}
+
+/**
+ * shm_hma_register_stats() - Register the telemetry stats of an HMA
+ * @hma:	HMA whose restart and health check counts are to be sampled.
+ *
+ * Failing to register a stat is not fatal, the stat is just not sampled.
+ */
+static void shm_hma_register_stats(struct hma_info *hma)
+{
+	char name[SHM_TELEM_NAME_LEN];
+
+	snprintf(name, sizeof(name), "%s_ssr", hma->subsys_name);
+	hma->stat_ids[0] = shm_register_stat(name, shm_hma_ssr_count, hma);
+	snprintf(name, sizeof(name), "%s_checks", hma->subsys_name);
+	hma->stat_ids[1] = shm_register_stat(name, shm_hma_check_count, hma);
+	snprintf(name, sizeof(name), "%s_reports", hma->subsys_name);
+	hma->stat_ids[2] = shm_register_stat(name, shm_hma_report_count, hma);
+}
+
+static void shm_hma_unregister_stats(struct hma_info *hma)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(hma->stat_ids); i++)
+		shm_unregister_stat(hma->stat_ids[i]);
+}
+
+/**
+ * shm_telem_init() - Allocate the telemetry ring buffer
+ *
+ * Return: 0 on success, standard Linux error codes on failure.
+ */
+static int shm_telem_init(void)
+{
+	struct shm_telem_hdr *hdr;
+
+	BUILD_BUG_ON(sizeof(struct shm_telem_hdr) > PAGE_SIZE);
+
+	hdr = vmalloc_user(SHM_TELEM_NUM_PAGES * PAGE_SIZE);
+	if (!hdr)
+		return -ENOMEM;
+
+	hdr->version = SHM_TELEM_VERSION;
+	hdr->record_size = sizeof(struct shm_telem_record);
+	hdr->num_records = ((SHM_TELEM_NUM_PAGES - 1) * PAGE_SIZE) /
+			   sizeof(struct shm_telem_record);
+
+	mutex_lock(&shm_telem_lock);
+	shm_telem_hdr = hdr;
+	shm_telem_sync_hdr();
+	mutex_unlock(&shm_telem_lock);
+
+	if (shm_telem_period_ms > 0)
+		schedule_delayed_work(&shm_telem_work, 0);
+	return 0;
+}
+
 static int system_health_monitor_open(struct inode *inode, struct file *file)
 {
 	SHM_DEBUG("%s by %s\n", __func__, current->comm);
@@ -707,6 +1018,21 @@ static ssize_t system_health_monitor_read(struct file *file, char __user *buf,
 	return -ENOTSUPP;
 }
 
+static int system_health_monitor_mmap(struct file *file,
+				      struct vm_area_struct *vma)
+{
+	if (!shm_telem_hdr)
+		return -ENODEV;
+
+	/* The ring buffer is read-only for the user-space */
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	SHM_DEBUG("%s by %s\n", __func__, current->comm);
+	return remap_vmalloc_range(vma, shm_telem_hdr, vma->vm_pgoff);
+}
+
 static long system_health_monitor_ioctl(struct file *file, unsigned int cmd,
 			  unsigned long arg)
 {
@@ -731,6 +1057,7 @@ static const struct file_operations system_health_monitor_fops = {
 	.release = system_health_monitor_release,
 	.read = system_health_monitor_read,
 	.write = system_health_monitor_write,
+	.mmap = system_health_monitor_mmap,
 	.unlocked_ioctl = system_health_monitor_ioctl,
 	.compat_ioctl = system_health_monitor_ioctl,
 };
@@ -849,6 +1176,7 @@ static int system_health_monitor_probe(struct platform_device *pdev)
 		}
 
 		list_add_tail(&hma->list, &hma_info_list);
+		shm_hma_register_stats(hma);
 		SHM_INFO("%s: Added HMA info for %s\n",
 			 __func__, hma->subsys_name);
 	}
@@ -863,6 +1191,7 @@ static int system_health_monitor_probe(struct platform_device *pdev)
 probe_err:
 	list_for_each_entry_safe(hma, tmp_hma, &hma_info_list, list) {
 		list_del(&hma->list);
+		shm_hma_unregister_stats(hma);
 		subsys_notif_unregister_notifier(hma->restart_nb_h,
 						 &hma->restart_nb);
 		cleanup_srcu_struct(&hma->reset_srcu);
@@ -905,6 +1234,10 @@ static int __init system_health_monitor_init(void)
 		shm_debug_mask = 0;
 	}
 
+	rc = shm_telem_init();
+	if (rc)
+		SHM_ERR("%s: Telemetry unavailable - rc %d\n", __func__, rc);
+
 	rc = platform_driver_register(&system_health_monitor_driver);
 	if (rc) {
 		SHM_ERR("%s: system_health_monitor_driver register failed %d\n",
@@ -25,6 +25,7 @@
 #include <linux/of.h>
 #include <linux/cpu.h>
 #include <linux/cpu_pm.h>
+#include <linux/kernel_stat.h>
 #include <linux/platform_device.h>
 #include <soc/qcom/scm.h>
 #include <soc/qcom/memory_dump.h>
@@ -51,6 +52,7 @@ static struct workqueue_struct *wdog_wq;
 static struct msm_watchdog_data *wdog_data;
 
 static int cpu_idle_pc_state[NR_CPUS];
+static unsigned int cpu_irqs_snap[NR_CPUS];
 
 struct msm_watchdog_data {
 	unsigned int __iomem phys_base;
@@ -68,6 +70,9 @@ struct msm_watchdog_data {
 	unsigned long long min_slack_ns;
 	void *scm_regsave;
 	cpumask_t alive_mask;
+	cpumask_t ping_mask;
+	unsigned long ping_sent;
+	unsigned long ping_skipped;
 	struct mutex disable_lock;
 	struct work_struct init_dogwork_struct;
 	struct delayed_work dogwork_struct;
@@ -101,6 +106,15 @@ module_param(WDT_HZ, long, 0);
 static int ipi_opt_en;
 module_param(ipi_opt_en, int, 0);
 
+/*
+ * On the kernel command line specify
+ * watchdog_v2.ipi_lazy_en=1 to only ping cpus which have not
+ * serviced any interrupt since the previous pet. By default
+ * every non power collapsed cpu is pinged.
+ */
+static int ipi_lazy_en;
+module_param(ipi_lazy_en, int, 0);
+
 static void pet_watchdog_work(struct work_struct *work);
 static void init_watchdog_work(struct work_struct *work);
 
@@ -299,14 +313,41 @@ static void keep_alive_response(void *info)
  */
 static void ping_other_cpus(struct msm_watchdog_data *wdog_dd)
 {
-	int cpu;
+	int cpu, this_cpu;
+	unsigned int irqs;
+
 	cpumask_clear(&wdog_dd->alive_mask);
+	cpumask_clear(&wdog_dd->ping_mask);
 	smp_mb();
 	for_each_cpu(cpu, cpu_online_mask) {
-		if (!cpu_idle_pc_state[cpu])
-			smp_call_function_single(cpu, keep_alive_response,
-						 wdog_dd, 1);
+		if (cpu_idle_pc_state[cpu])
+			continue;
+		/*
+		 * A cpu whose interrupt count moved since the last pet
+		 * has had interrupts enabled and taken at least its tick,
+		 * which is all the keep alive ipi would prove.
+		 */
+		irqs = kstat_cpu_irqs_sum(cpu);
+		if (ipi_lazy_en && irqs != cpu_irqs_snap[cpu]) {
+			cpu_irqs_snap[cpu] = irqs;
+			cpumask_set_cpu(cpu, &wdog_dd->alive_mask);
+			wdog_dd->ping_skipped++;
+			continue;
+		}
+		cpu_irqs_snap[cpu] = irqs;
+		cpumask_set_cpu(cpu, &wdog_dd->ping_mask);
 	}
+	if (cpumask_empty(&wdog_dd->ping_mask))
+		return;
+
+	wdog_dd->ping_sent += cpumask_weight(&wdog_dd->ping_mask);
+	this_cpu = get_cpu();
+	if (cpumask_test_and_clear_cpu(this_cpu, &wdog_dd->ping_mask))
+		keep_alive_response(wdog_dd);
+	/* Send the remaining pings together and wait for all of them */
+	smp_call_function_many(&wdog_dd->ping_mask, keep_alive_response,
+				wdog_dd, 1);
+	put_cpu();
 }
 
 static void pet_watchdog_work(struct work_struct *work)
@@ -411,8 +452,11 @@ static irqreturn_t wdog_bark_handler(int irq, void *dev_id)
 	nanosec_rem = do_div(wdog_dd->last_pet, 1000000000);
 	printk(KERN_INFO "Watchdog last pet at %lu.%06lu\n", (unsigned long)
 		wdog_dd->last_pet, nanosec_rem / 1000);
-	if (wdog_dd->do_ipi_ping)
+	if (wdog_dd->do_ipi_ping) {
 		dump_cpu_alive_mask(wdog_dd);
+		printk(KERN_INFO "Watchdog pings sent %lu skipped %lu\n",
+			wdog_dd->ping_sent, wdog_dd->ping_skipped);
+	}
 	msm_trigger_wdog_bite();
 	panic("Failed to cause a watchdog bite! - Falling back to kernel panic!");
 	return IRQ_HANDLED;
@@ -1223,6 +1223,13 @@ static int msm_spi_bam_map_buffers(struct msm_spi *dd)
 	dev = dd->dev;
 	first_xfr = dd->cur_transfer;
 
+	/*
+	 * Clients streaming from long lived buffers map them once and pass
+	 * tx_dma/rx_dma with is_dma_mapped set; use those as they are.
+	 */
+	if (dd->cur_msg->is_dma_mapped)
+		return 0;
+
 	do {
 		tx_buf = (void *)first_xfr->tx_buf;
 		rx_buf = first_xfr->rx_buf;
@@ -1281,7 +1288,7 @@ static void msm_spi_bam_unmap_buffers(struct msm_spi *dd)
 	void *tx_buf, *rx_buf;
 	u32  tx_len, rx_len;
 
-	dev = &dd->cur_msg->spi->dev;
+	dev = dd->dev;
 	first_xfr = dd->cur_transfer;
 
 	 /* mapped by client */
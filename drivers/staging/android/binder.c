@@ -87,6 +87,15 @@ BINDER_DEBUG_ENTRY(proc);
 
 #define BINDER_SMALL_BUF_SIZE (PAGE_SIZE * 64)
 
+/*
+ * Freed buffers of 64 << n up to 64 << (n + 1) bytes are kept aside in
+ * size class n, with their pages still mapped, instead of being merged
+ * back into the free tree.
+ */
+#define BINDER_CACHE_MIN_SHIFT	6
+#define BINDER_NR_SIZE_CLASSES	6
+#define BINDER_CACHE_DEPTH	4
+
 enum {
 	BINDER_DEBUG_USER_ERROR             = 1U << 0,
 	BINDER_DEBUG_FAILED_TRANSACTION     = 1U << 1,
@@ -112,6 +121,27 @@ module_param_named(debug_mask, binder_debug_mask, uint, S_IWUSR | S_IRUGO);
 static bool binder_debug_no_lock;
 module_param_named(proc_no_lock, binder_debug_no_lock, bool, S_IWUSR | S_IRUGO);
 
+/* Pages at the start of each mapping that stay populated until release */
+static uint32_t binder_pinned_pages = 4;
+module_param_named(pinned_pages, binder_pinned_pages, uint, S_IWUSR | S_IRUGO);
+
+/*
+ * Best nice level a one-way transaction passes on to the thread serving it;
+ * 20 leaves one-way transactions at the node's minimum priority only.
+ */
+static int binder_async_inherit_nice = 20;
+module_param_named(async_inherit_nice, binder_async_inherit_nice, int,
+		   S_IWUSR | S_IRUGO);
+
+static bool binder_latency_stats = true;
+module_param_named(latency_stats, binder_latency_stats, bool,
+		   S_IWUSR | S_IRUGO);
+
+/* Calls whose queue plus execution time reach this fire binder_transaction_slow */
+static uint32_t binder_slow_call_ms = 100;
+module_param_named(slow_call_ms, binder_slow_call_ms, uint,
+		   S_IWUSR | S_IRUGO);
+
 static DECLARE_WAIT_QUEUE_HEAD(binder_user_error_wait);
 static int binder_stop_on_user_error;
 
@@ -154,13 +184,41 @@ enum binder_stat_types {
 
 struct binder_stats {
 	int br[_IOC_NR(BR_FAILED_REPLY) + 1];
-	int bc[_IOC_NR(BC_DEAD_BINDER_DONE) + 1];
+	int bc[_IOC_NR(BC_REPLY_SG) + 1];
 	int obj_created[BINDER_STAT_COUNT];
 	int obj_deleted[BINDER_STAT_COUNT];
 };
 
 static struct binder_stats binder_stats;
 
+/*
+ * Latency histograms.  Bucket 0 counts samples under 1us, bucket n
+ * [2^(n-1), 2^n) us, and the last one everything slower than that.
+ */
+#define BINDER_LAT_BUCKETS 20
+
+enum binder_lat_stage {
+	BINDER_LAT_QUEUE,	/* queued until a server thread picks it up */
+	BINDER_LAT_EXEC,	/* picked up until the server replies */
+	BINDER_LAT_REPLY,	/* reply queued until the caller picks it up */
+	BINDER_LAT_COUNT
+};
+
+static const char * const binder_lat_strings[] = {
+	"queue",
+	"exec",
+	"reply"
+};
+
+struct binder_lat_hist {
+	u32 count;
+	u32 max_us;
+	u64 sum_us;
+	u32 bucket[BINDER_LAT_BUCKETS];
+};
+
+static struct binder_lat_hist binder_lat[BINDER_LAT_COUNT];
+
 static inline void binder_stats_deleted(enum binder_stat_types type)
 {
 	binder_stats.obj_deleted[type]++;
@@ -237,8 +295,10 @@ struct binder_node {
 	unsigned pending_weak_ref:1;
 	unsigned has_async_transaction:1;
 	unsigned accept_fds:1;
+	unsigned inherit_rt:1;
 	unsigned min_priority:8;
 	struct list_head async_todo;
+	struct binder_lat_hist exec_lat;
 };
 
 struct binder_ref_death {
@@ -265,8 +325,11 @@ struct binder_ref {
 
 struct binder_buffer {
 	struct list_head entry; /* free and allocated entries by address */
-	struct rb_node rb_node; /* free entry by size or allocated entry */
-				/* by address */
+	union {
+		struct rb_node rb_node;	/* free entry by size or allocated */
+					/* entry by address */
+		struct list_head cache_entry; /* entry in a size class */
+	};
 	unsigned free:1;
 	unsigned allow_user_free:1;
 	unsigned async_transaction:1;
@@ -277,6 +340,7 @@ struct binder_buffer {
 	struct binder_node *target_node;
 	size_t data_size;
 	size_t offsets_size;
+	size_t extra_buffers_size;
 	uint8_t data[0];
 };
 
@@ -286,6 +350,16 @@ enum binder_deferred_state {
 	BINDER_DEFERRED_RELEASE      = 0x04,
 };
 
+/*
+ * A scheduling policy and a priority on the scale of task->normal_prio:
+ * 0..MAX_RT_PRIO-1 for the real-time policies, MAX_RT_PRIO..MAX_PRIO-1
+ * for nice -20..19.  Lower is more important for both.
+ */
+struct binder_priority {
+	unsigned int sched_policy;
+	int prio;
+};
+
 struct binder_proc {
 	struct hlist_node proc_node;
 	struct rb_root threads;
@@ -302,23 +376,37 @@ struct binder_proc {
 	void *buffer;
 	ptrdiff_t user_buffer_offset;
 
+	/*
+	 * alloc_lock protects the buffer allocator: buffers, the two trees,
+	 * the size classes, free_async_space and pages. It nests inside binder_main_lock but
+	 * is also taken alone, so a transaction can fill a target buffer
+	 * without the main lock. tmp_ref keeps the proc around for that,
+	 * is_dead is set once binder_deferred_release() started on it.
+	 */
+	struct mutex alloc_lock;
+	int tmp_ref;
+	bool is_dead;
 	struct list_head buffers;
 	struct rb_root free_buffers;
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
+	struct list_head size_classes[BINDER_NR_SIZE_CLASSES];
+	int size_class_count[BINDER_NR_SIZE_CLASSES];
 
 	struct page **pages;
+	size_t pinned_size;
 	size_t buffer_size;
 	uint32_t buffer_free;
 	struct list_head todo;
 	wait_queue_head_t wait;
 	struct binder_stats stats;
+	struct binder_lat_hist lat[BINDER_LAT_COUNT];
 	struct list_head delivered_death;
 	int max_threads;
 	int requested_threads;
 	int requested_threads_started;
 	int ready_threads;
-	long default_priority;
+	struct binder_priority default_priority;
 	struct dentry *debugfs_entry;
 };
 
@@ -360,9 +448,13 @@ struct binder_transaction {
 	struct binder_buffer *buffer;
 	unsigned int	code;
 	unsigned int	flags;
-	long	priority;
-	long	saved_priority;
+	struct binder_priority	priority;
+	struct binder_priority	saved_priority;
+	int	sched_boost;
+	int	saved_sched_boost;
 	kuid_t	sender_euid;
+	u64	queue_ns;	/* when it was queued to the target */
+	u64	start_ns;	/* when a server thread picked it up */
 };
 
 static void
@@ -430,21 +522,179 @@ static inline void binder_unlock(const char *tag)
 	mutex_unlock(&binder_main_lock);
 }
 
-static void binder_set_nice(long nice)
+static bool is_rt_policy(int policy)
+{
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+static bool is_fair_policy(int policy)
+{
+	return policy == SCHED_NORMAL || policy == SCHED_BATCH ||
+		policy == SCHED_IDLE;
+}
+
+static int to_userspace_prio(int policy, int kernel_priority)
+{
+	if (is_rt_policy(policy))
+		return MAX_USER_RT_PRIO - 1 - kernel_priority;
+	return kernel_priority - MAX_RT_PRIO - 20;
+}
+
+static int to_kernel_prio(int policy, int user_priority)
+{
+	if (is_rt_policy(policy))
+		return MAX_USER_RT_PRIO - 1 - user_priority;
+	return MAX_RT_PRIO + 20 + user_priority;
+}
+
+/*
+ * Switch current to @desired, capped by what its own RLIMIT_RTPRIO and
+ * RLIMIT_NICE allow unless it has CAP_SYS_NICE.  A real-time priority the
+ * thread may not use at all degrades to the best nice level it may use.
+ */
+static void binder_set_priority(struct binder_priority desired)
 {
-	long min_nice;
-	if (can_nice(current, nice)) {
-		set_user_nice(current, nice);
+	unsigned int policy = desired.sched_policy;
+	bool has_cap_nice;
+	int priority;
+
+	if (current->policy == policy && current->normal_prio == desired.prio)
 		return;
+
+	has_cap_nice = has_capability_noaudit(current, CAP_SYS_NICE);
+	priority = to_userspace_prio(policy, desired.prio);
+
+	if (is_rt_policy(policy) && !has_cap_nice) {
+		long max_rtprio = task_rlimit(current, RLIMIT_RTPRIO);
+
+		if (max_rtprio == 0) {
+			policy = SCHED_NORMAL;
+			priority = -20;
+		} else if (priority > max_rtprio) {
+			priority = max_rtprio;
+		}
 	}
-	min_nice = 20 - current->signal->rlim[RLIMIT_NICE].rlim_cur;
-	binder_debug(BINDER_DEBUG_PRIORITY_CAP,
-		     "%d: nice value %ld not allowed use %ld instead\n",
-		      current->pid, nice, min_nice);
-	set_user_nice(current, min_nice);
-	if (min_nice < 20)
+
+	if (is_fair_policy(policy) && !has_cap_nice) {
+		long min_nice = 20 - task_rlimit(current, RLIMIT_NICE);
+
+		if (min_nice > 19) {
+			binder_user_error("%d RLIMIT_NICE not set\n",
+					  current->pid);
+			return;
+		}
+		if (priority < min_nice)
+			priority = min_nice;
+	}
+
+	if (policy != desired.sched_policy ||
+	    to_kernel_prio(policy, priority) != desired.prio)
+		binder_debug(BINDER_DEBUG_PRIORITY_CAP,
+			     "%d: priority %u:%d not allowed, using %u:%d instead\n",
+			     current->pid, desired.sched_policy, desired.prio,
+			     policy, to_kernel_prio(policy, priority));
+
+	if (current->policy != policy || is_rt_policy(policy)) {
+		struct sched_param params;
+
+		params.sched_priority = is_rt_policy(policy) ? priority : 0;
+		sched_setscheduler_nocheck(current,
+					   policy | SCHED_RESET_ON_FORK,
+					   &params);
+	}
+	if (is_fair_policy(policy))
+		set_user_nice(current, priority);
+}
+
+/*
+ * Called on the thread picking up @t.  A synchronous call runs at the
+ * caller's priority, an asynchronous one keeps the thread's own unless
+ * async_inherit_nice allows inheriting up to that nice level; either way
+ * the node's min_priority is a floor.
+ */
+static void binder_transaction_priority(struct binder_transaction *t,
+					struct binder_node *node)
+{
+	struct binder_priority desired = t->priority;
+	struct binder_priority node_prio;
+
+	node_prio.sched_policy = SCHED_NORMAL;
+	node_prio.prio = to_kernel_prio(SCHED_NORMAL,
+					min_t(int, node->min_priority, 19));
+
+	if (t->flags & TF_ONE_WAY) {
+		if (binder_async_inherit_nice > 19) {
+			desired = t->saved_priority;
+		} else {
+			int nice = max(binder_async_inherit_nice, -20);
+
+			desired.sched_policy = SCHED_NORMAL;
+			desired.prio = max(desired.prio,
+					   to_kernel_prio(SCHED_NORMAL, nice));
+		}
+	}
+
+	if (node_prio.prio < desired.prio)
+		desired = node_prio;
+
+	binder_set_priority(desired);
+}
+
+static inline u64 binder_lat_now(void)
+{
+	return binder_latency_stats ? ktime_to_ns(ktime_get()) : 0;
+}
+
+static void binder_lat_add(struct binder_lat_hist *h, u64 delta_ns)
+{
+	u64 us = div_u64(delta_ns, NSEC_PER_USEC);
+	u32 us32 = min_t(u64, us, U32_MAX);
+
+	h->count++;
+	h->sum_us += us;
+	if (us32 > h->max_us)
+		h->max_us = us32;
+	h->bucket[min(fls(us32), BINDER_LAT_BUCKETS - 1)]++;
+}
+
+/*
+ * Account @delta_ns of @stage to @proc and the global histogram.  Either
+ * timestamp being zero means latency_stats was off when it was taken.
+ */
+static void binder_lat_record(struct binder_proc *proc,
+			      enum binder_lat_stage stage,
+			      u64 start_ns, u64 end_ns)
+{
+	if (!start_ns || !end_ns || end_ns < start_ns)
 		return;
-	binder_user_error("%d RLIMIT_NICE not set\n", current->pid);
+	binder_lat_add(&binder_lat[stage], end_ns - start_ns);
+	binder_lat_add(&proc->lat[stage], end_ns - start_ns);
+}
+
+/*
+ * Called by the server thread replying to @t, before @t goes away: its
+ * execution time is all that is left to account.
+ */
+static void binder_lat_reply(struct binder_proc *proc,
+			     struct binder_transaction *t)
+{
+	struct binder_node *node = NULL;
+	u64 now = binder_lat_now();
+
+	if (!now || !t->start_ns)
+		return;
+
+	binder_lat_record(proc, BINDER_LAT_EXEC, t->start_ns, now);
+	if (t->buffer && t->buffer->target_node) {
+		node = t->buffer->target_node;
+		binder_lat_add(&node->exec_lat, now - t->start_ns);
+	}
+
+	if (binder_slow_call_ms && t->queue_ns &&
+	    now - t->queue_ns >= (u64)binder_slow_call_ms * NSEC_PER_MSEC)
+		trace_binder_transaction_slow(t, node,
+					      t->start_ns - t->queue_ns,
+					      now - t->start_ns);
 }
 
 static size_t binder_buffer_size(struct binder_proc *proc,
@@ -547,12 +797,17 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	unsigned long user_page_addr;
 	struct vm_struct tmp_area;
 	struct page **page;
+	struct page **page_array_ptr;
 	struct mm_struct *mm;
+	int ret;
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "%d: %s pages %pK-%pK\n", proc->pid,
 		     allocate ? "allocate" : "free", start, end);
 
+	/* The pinned pages are populated by binder_mmap() for good */
+	if (start < proc->buffer + proc->pinned_size)
+		start = proc->buffer + proc->pinned_size;
 	if (end <= start)
 		return 0;
 
@@ -582,9 +837,11 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		goto err_no_vma;
 	}
 
+	/*
+	 * Allocate the whole range first, so that it can be mapped into the
+	 * kernel with a single map_vm_area() rather than one per page.
+	 */
 	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
-		int ret;
-		struct page **page_array_ptr;
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
 
 		BUG_ON(*page);
@@ -594,15 +851,20 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 				proc->pid, page_addr);
 			goto err_alloc_page_failed;
 		}
-		tmp_area.addr = page_addr;
-		tmp_area.size = PAGE_SIZE + PAGE_SIZE /* guard page? */;
-		page_array_ptr = page;
-		ret = map_vm_area(&tmp_area, PAGE_KERNEL, &page_array_ptr);
-		if (ret) {
-			pr_err("%d: binder_alloc_buf failed to map page at %pK in kernel\n",
-			       proc->pid, page_addr);
-			goto err_map_kernel_failed;
-		}
+	}
+
+	tmp_area.addr = start;
+	tmp_area.size = end - start + PAGE_SIZE /* guard page? */;
+	page_array_ptr = &proc->pages[(start - proc->buffer) / PAGE_SIZE];
+	ret = map_vm_area(&tmp_area, PAGE_KERNEL, &page_array_ptr);
+	if (ret) {
+		pr_err("%d: binder_alloc_buf failed to map pages %pK-%pK in kernel\n",
+		       proc->pid, start, end);
+		goto err_map_kernel_failed;
+	}
+
+	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
+		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
 		user_page_addr =
 			(uintptr_t)page_addr + proc->user_buffer_offset;
 		ret = vm_insert_page(vma, user_page_addr, page[0]);
@@ -620,19 +882,30 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	return 0;
 
 free_range:
-	for (page_addr = end - PAGE_SIZE; page_addr >= start;
-	     page_addr -= PAGE_SIZE) {
+	if (vma)
+		zap_page_range(vma, (uintptr_t)start + proc->user_buffer_offset,
+			       end - start, NULL);
+	unmap_kernel_range((unsigned long)start, end - start);
+	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
-		if (vma)
-			zap_page_range(vma, (uintptr_t)page_addr +
-				proc->user_buffer_offset, PAGE_SIZE, NULL);
-err_vm_insert_page_failed:
-		unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
-err_map_kernel_failed:
 		__free_page(*page);
 		*page = NULL;
+	}
+	goto err_no_vma;
+
+err_vm_insert_page_failed:
+	if (page_addr > start)
+		zap_page_range(vma, (uintptr_t)start + proc->user_buffer_offset,
+			       page_addr - start, NULL);
+err_map_kernel_failed:
+	unmap_kernel_range((unsigned long)start, end - start);
 err_alloc_page_failed:
-		;
+	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
+		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
+		if (*page) {
+			__free_page(*page);
+			*page = NULL;
+		}
 	}
 err_no_vma:
 	if (mm) {
@@ -642,17 +915,97 @@ err_no_vma:
 	return -ENOMEM;
 }
 
+/* Size class that a request of @size bytes is served from */
+static int binder_size_class(size_t size)
+{
+	int class = 0;
+
+	while ((size_t)1 << (class + BINDER_CACHE_MIN_SHIFT) < size)
+		class++;
+
+	return class;
+}
+
+static struct binder_buffer *binder_size_class_get(struct binder_proc *proc,
+						   size_t size)
+{
+	struct binder_buffer *buffer;
+	int class = binder_size_class(size);
+
+	for (; class < BINDER_NR_SIZE_CLASSES; class++) {
+		if (list_empty(&proc->size_classes[class]))
+			continue;
+
+		buffer = list_first_entry(&proc->size_classes[class],
+					  struct binder_buffer, cache_entry);
+		list_del(&buffer->cache_entry);
+		proc->size_class_count[class]--;
+		binder_insert_allocated_buffer(proc, buffer);
+		return buffer;
+	}
+
+	return NULL;
+}
+
+/*
+ * Park a buffer that is being freed in its size class. It keeps its pages
+ * and stays marked as in use, so its neighbours don't merge with it.
+ */
+static bool binder_size_class_put(struct binder_proc *proc,
+				  struct binder_buffer *buffer,
+				  size_t buffer_size)
+{
+	int class;
+
+	if (buffer_size < (size_t)1 << BINDER_CACHE_MIN_SHIFT)
+		return false;
+
+	class = binder_size_class(buffer_size + 1) - 1;
+	if (class >= BINDER_NR_SIZE_CLASSES ||
+	    proc->size_class_count[class] >= BINDER_CACHE_DEPTH)
+		return false;
+
+	rb_erase(&buffer->rb_node, &proc->allocated_buffers);
+	list_add(&buffer->cache_entry, &proc->size_classes[class]);
+	proc->size_class_count[class]++;
+	return true;
+}
+
+static void __binder_free_buf(struct binder_proc *proc,
+			      struct binder_buffer *buffer);
+
+/* Give the parked buffers back to the free tree */
+static void binder_size_class_flush(struct binder_proc *proc)
+{
+	struct binder_buffer *buffer;
+	int class;
+
+	for (class = 0; class < BINDER_NR_SIZE_CLASSES; class++) {
+		while (!list_empty(&proc->size_classes[class])) {
+			buffer = list_first_entry(&proc->size_classes[class],
+					struct binder_buffer, cache_entry);
+			list_del(&buffer->cache_entry);
+			binder_insert_allocated_buffer(proc, buffer);
+			__binder_free_buf(proc, buffer);
+		}
+		proc->size_class_count[class] = 0;
+	}
+}
+
 static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 					      size_t data_size,
-					      size_t offsets_size, int is_async)
+					      size_t offsets_size,
+					      size_t extra_buffers_size,
+					      int is_async)
 {
-	struct rb_node *n = proc->free_buffers.rb_node;
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	size_t buffer_size;
 	struct rb_node *best_fit = NULL;
 	void *has_page_addr;
 	void *end_page_addr;
-	size_t size;
+	size_t data_offsets_size, size;
+	bool flushed = false;
 
 	if (proc->vma == NULL) {
 		pr_err("%d: binder_alloc_buf, no vma\n",
@@ -660,14 +1013,20 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		return NULL;
 	}
 
-	size = ALIGN(data_size, sizeof(void *)) +
+	data_offsets_size = ALIGN(data_size, sizeof(void *)) +
 		ALIGN(offsets_size, sizeof(void *));
 
-	if (size < data_size || size < offsets_size) {
+	if (data_offsets_size < data_size || data_offsets_size < offsets_size) {
 		binder_user_error("%d: got transaction with invalid size %zd-%zd\n",
 				proc->pid, data_size, offsets_size);
 		return NULL;
 	}
+	size = data_offsets_size + ALIGN(extra_buffers_size, sizeof(void *));
+	if (size < data_offsets_size || size < extra_buffers_size) {
+		binder_user_error("%d: got transaction with invalid extra_buffers_size %zd\n",
+				proc->pid, extra_buffers_size);
+		return NULL;
+	}
 
 	if (is_async &&
 	    proc->free_async_space < size + sizeof(struct binder_buffer)) {
@@ -677,6 +1036,16 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		return NULL;
 	}
 
+	buffer = binder_size_class_get(proc, size);
+	if (buffer) {
+		binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+			     "%d: binder_alloc_buf size %zd got cached %pK\n",
+			      proc->pid, size, buffer);
+		goto found;
+	}
+
+retry:
+	n = proc->free_buffers.rb_node;
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(!buffer->free);
@@ -693,6 +1062,11 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		}
 	}
 	if (best_fit == NULL) {
+		if (!flushed) {
+			binder_size_class_flush(proc);
+			flushed = true;
+			goto retry;
+		}
 		pr_err("%d: binder_alloc_buf size %zd failed, no address space\n",
 			proc->pid, size);
 		return NULL;
@@ -734,9 +1108,12 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "%d: binder_alloc_buf size %zd got %pK\n",
 		      proc->pid, size, buffer);
+found:
 	buffer->data_size = data_size;
 	buffer->offsets_size = offsets_size;
+	buffer->extra_buffers_size = extra_buffers_size;
 	buffer->async_transaction = is_async;
+	buffer->allow_user_free = 0;
 	if (is_async) {
 		proc->free_async_space -= size + sizeof(struct binder_buffer);
 		binder_debug(BINDER_DEBUG_BUFFER_ALLOC_ASYNC,
@@ -802,6 +1179,37 @@ static void binder_delete_free_buffer(struct binder_proc *proc,
 	}
 }
 
+static void __binder_free_buf(struct binder_proc *proc,
+			      struct binder_buffer *buffer)
+{
+	size_t buffer_size = binder_buffer_size(proc, buffer);
+
+	binder_update_page_range(proc, 0,
+		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
+		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK),
+		NULL);
+	rb_erase(&buffer->rb_node, &proc->allocated_buffers);
+	buffer->free = 1;
+	if (!list_is_last(&buffer->entry, &proc->buffers)) {
+		struct binder_buffer *next = list_entry(buffer->entry.next,
+						struct binder_buffer, entry);
+		if (next->free) {
+			rb_erase(&next->rb_node, &proc->free_buffers);
+			binder_delete_free_buffer(proc, next);
+		}
+	}
+	if (proc->buffers.next != &buffer->entry) {
+		struct binder_buffer *prev = list_entry(buffer->entry.prev,
+						struct binder_buffer, entry);
+		if (prev->free) {
+			binder_delete_free_buffer(proc, buffer);
+			rb_erase(&prev->rb_node, &proc->free_buffers);
+			buffer = prev;
+		}
+	}
+	binder_insert_free_buffer(proc, buffer);
+}
+
 static void binder_free_buf(struct binder_proc *proc,
 			    struct binder_buffer *buffer)
 {
@@ -810,7 +1218,8 @@ static void binder_free_buf(struct binder_proc *proc,
 	buffer_size = binder_buffer_size(proc, buffer);
 
 	size = ALIGN(buffer->data_size, sizeof(void *)) +
-		ALIGN(buffer->offsets_size, sizeof(void *));
+		ALIGN(buffer->offsets_size, sizeof(void *)) +
+		ALIGN(buffer->extra_buffers_size, sizeof(void *));
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "%d: binder_free_buf %pK size %zd buffer_size %zd\n",
@@ -830,30 +1239,12 @@ static void binder_free_buf(struct binder_proc *proc,
 			      proc->pid, size, proc->free_async_space);
 	}
 
-	binder_update_page_range(proc, 0,
-		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
-		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK),
-		NULL);
-	rb_erase(&buffer->rb_node, &proc->allocated_buffers);
-	buffer->free = 1;
-	if (!list_is_last(&buffer->entry, &proc->buffers)) {
-		struct binder_buffer *next = list_entry(buffer->entry.next,
-						struct binder_buffer, entry);
-		if (next->free) {
-			rb_erase(&next->rb_node, &proc->free_buffers);
-			binder_delete_free_buffer(proc, next);
-		}
-	}
-	if (proc->buffers.next != &buffer->entry) {
-		struct binder_buffer *prev = list_entry(buffer->entry.prev,
-						struct binder_buffer, entry);
-		if (prev->free) {
-			binder_delete_free_buffer(proc, buffer);
-			rb_erase(&prev->rb_node, &proc->free_buffers);
-			buffer = prev;
-		}
+	if (binder_size_class_put(proc, buffer, buffer_size)) {
+		/* Already credited back, don't do it again on flush */
+		buffer->async_transaction = 0;
+		return;
 	}
-	binder_insert_free_buffer(proc, buffer);
+	__binder_free_buf(proc, buffer);
 }
 
 static struct binder_node *binder_get_node(struct binder_proc *proc,
@@ -1232,6 +1623,137 @@ static void binder_send_failed_reply(struct binder_transaction *t,
 	}
 }
 
+/*
+ * Returns the size of the object at @offset in @buffer, or 0 if there is
+ * no object of a known type that fits in the data there.
+ */
+static size_t binder_validate_object(struct binder_buffer *buffer, u64 offset)
+{
+	struct binder_object_header *hdr;
+	size_t object_size;
+
+	if (buffer->data_size < sizeof(*hdr) ||
+	    offset > buffer->data_size - sizeof(*hdr) ||
+	    !IS_ALIGNED(offset, sizeof(u32)))
+		return 0;
+
+	hdr = (struct binder_object_header *)(buffer->data + offset);
+	switch (hdr->type) {
+	case BINDER_TYPE_BINDER:
+	case BINDER_TYPE_WEAK_BINDER:
+	case BINDER_TYPE_HANDLE:
+	case BINDER_TYPE_WEAK_HANDLE:
+	case BINDER_TYPE_FD:
+		object_size = sizeof(struct flat_binder_object);
+		break;
+	case BINDER_TYPE_PTR:
+		object_size = sizeof(struct binder_buffer_object);
+		break;
+	default:
+		return 0;
+	}
+
+	if (buffer->data_size < object_size ||
+	    offset > buffer->data_size - object_size)
+		return 0;
+	return object_size;
+}
+
+/*
+ * Returns object number @index of @b if it is a buffer object.  Only the
+ * first @num_valid objects have been validated so far.
+ */
+static struct binder_buffer_object *binder_validate_ptr(struct binder_buffer *b,
+							binder_size_t index,
+							binder_size_t *start,
+							binder_size_t num_valid)
+{
+	struct binder_buffer_object *bp;
+
+	if (index >= num_valid)
+		return NULL;
+
+	bp = (struct binder_buffer_object *)(b->data + start[index]);
+	if (bp->hdr.type != BINDER_TYPE_PTR)
+		return NULL;
+	return bp;
+}
+
+/*
+ * Fixups have to come in order: either into the buffer of the last buffer
+ * object, after any earlier fixup into it, or into one of its ancestors,
+ * after the pointer to the child we came from.  That way a fixup never
+ * lands in a range the driver has already handed out to another one.
+ */
+static bool binder_validate_fixup(struct binder_buffer *b,
+				  binder_size_t *start,
+				  struct binder_buffer_object *parent,
+				  binder_size_t fixup_offset,
+				  struct binder_buffer_object *last_obj,
+				  binder_size_t last_min_offset)
+{
+	if (!last_obj)
+		return false;
+
+	while (last_obj != parent) {
+		/* Already validated when last_obj was */
+		if (!(last_obj->flags & BINDER_BUFFER_FLAG_HAS_PARENT))
+			return false;
+		last_min_offset = last_obj->parent_offset +
+				  sizeof(binder_uintptr_t);
+		last_obj = (struct binder_buffer_object *)
+			(b->data + start[last_obj->parent]);
+	}
+	return fixup_offset >= last_min_offset;
+}
+
+/*
+ * Point the parent of @bp, already copied to the target, at the target's
+ * copy of @bp.
+ */
+static int binder_fixup_parent(struct binder_transaction *t,
+			       struct binder_thread *thread,
+			       struct binder_buffer_object *bp,
+			       binder_size_t *start,
+			       binder_size_t num_valid,
+			       struct binder_buffer_object *last_fixup_obj,
+			       binder_size_t last_fixup_min_off)
+{
+	struct binder_buffer_object *parent;
+	struct binder_buffer *b = t->buffer;
+	struct binder_proc *proc = thread->proc;
+	u8 *parent_buffer;
+
+	if (!(bp->flags & BINDER_BUFFER_FLAG_HAS_PARENT))
+		return 0;
+
+	parent = binder_validate_ptr(b, bp->parent, start, num_valid);
+	if (!parent) {
+		binder_user_error("%d:%d got transaction with invalid parent offset or type\n",
+				  proc->pid, thread->pid);
+		return -EINVAL;
+	}
+
+	if (!binder_validate_fixup(b, start, parent, bp->parent_offset,
+				   last_fixup_obj, last_fixup_min_off)) {
+		binder_user_error("%d:%d got transaction with out-of-order buffer fixup\n",
+				  proc->pid, thread->pid);
+		return -EINVAL;
+	}
+
+	if (parent->length < sizeof(binder_uintptr_t) ||
+	    bp->parent_offset > parent->length - sizeof(binder_uintptr_t)) {
+		binder_user_error("%d:%d got transaction with invalid parent offset\n",
+				  proc->pid, thread->pid);
+		return -EINVAL;
+	}
+
+	parent_buffer = (u8 *)((uintptr_t)parent->buffer -
+			       t->to_proc->user_buffer_offset);
+	*(binder_uintptr_t *)(parent_buffer + bp->parent_offset) = bp->buffer;
+	return 0;
+}
+
 static void binder_transaction_buffer_release(struct binder_proc *proc,
 					      struct binder_buffer *buffer,
 					      binder_size_t *failed_at)
@@ -1255,10 +1777,9 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 		off_end = (void *)offp + buffer->offsets_size;
 	for (; offp < off_end; offp++) {
 		struct flat_binder_object *fp;
-		if (*offp > buffer->data_size - sizeof(*fp) ||
-		    buffer->data_size < sizeof(*fp) ||
-		    !IS_ALIGNED(*offp, sizeof(u32))) {
-			pr_err("transaction release %d bad offset %lld, size %zd\n",
+
+		if (!binder_validate_object(buffer, *offp)) {
+			pr_err("transaction release %d bad object at offset %lld, size %zd\n",
 			       debug_id, (u64)*offp, buffer->data_size);
 			continue;
 		}
@@ -1300,6 +1821,10 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 				task_close_fd(proc, fp->handle);
 			break;
 
+		case BINDER_TYPE_PTR:
+			/* Lives in the buffer itself, nothing to release */
+			break;
+
 		default:
 			pr_err("transaction release %d bad object type %x\n",
 				debug_id, fp->type);
@@ -1308,14 +1833,113 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	}
 }
 
+static void binder_proc_dec_tmpref(struct binder_proc *proc)
+{
+	proc->tmp_ref--;
+	if (proc->is_dead && !proc->tmp_ref)
+		kfree(proc);
+}
+
+/*
+ * Page allocation and copy_from_user() are the slow part of a transaction
+ * and only need the allocator of the target, so do them with the target's
+ * alloc_lock instead of binder_main_lock. The target found here is only a
+ * guess: binder_transaction() resolves it again under the main lock and
+ * hands the buffer back to binder_transaction_prealloc_put() if it does
+ * not match. Called and returns with binder_main_lock held, but drops it.
+ */
+static struct binder_buffer *binder_transaction_prealloc(
+		struct binder_proc *proc, struct binder_thread *thread,
+		struct binder_transaction_data *tr, int reply,
+		binder_size_t extra_buffers_size,
+		struct binder_proc **target_procp)
+{
+	struct binder_proc *target_proc = NULL;
+	struct binder_buffer *buffer = NULL;
+	binder_size_t *offp;
+
+	*target_procp = NULL;
+	if (reply) {
+		struct binder_transaction *in_reply_to;
+
+		in_reply_to = thread->transaction_stack;
+		if (in_reply_to && in_reply_to->to_thread == thread &&
+		    in_reply_to->from)
+			target_proc = in_reply_to->from->proc;
+	} else {
+		struct binder_node *node = binder_context_mgr_node;
+
+		if (tr->target.handle) {
+			struct binder_ref *ref;
+
+			ref = binder_get_ref(proc, tr->target.handle, true);
+			node = ref ? ref->node : NULL;
+		}
+		if (node)
+			target_proc = node->proc;
+		if (target_proc &&
+		    security_binder_transaction(proc->tsk, target_proc->tsk) < 0)
+			target_proc = NULL;
+	}
+	if (target_proc == NULL)
+		return NULL;
+
+	target_proc->tmp_ref++;
+	binder_unlock(__func__);
+
+	mutex_lock(&target_proc->alloc_lock);
+	if (!target_proc->is_dead)
+		buffer = binder_alloc_buf(target_proc, tr->data_size,
+			tr->offsets_size, extra_buffers_size,
+			!reply && (tr->flags & TF_ONE_WAY));
+	if (buffer) {
+		offp = (binder_size_t *)(buffer->data +
+					 ALIGN(tr->data_size, sizeof(void *)));
+		/* Leave the error reporting to binder_transaction() */
+		if (copy_from_user(buffer->data, (const void __user *)
+				   (uintptr_t)tr->data.ptr.buffer,
+				   tr->data_size) ||
+		    copy_from_user(offp, (const void __user *)
+				   (uintptr_t)tr->data.ptr.offsets,
+				   tr->offsets_size)) {
+			binder_free_buf(target_proc, buffer);
+			buffer = NULL;
+		}
+	}
+	mutex_unlock(&target_proc->alloc_lock);
+
+	binder_lock(__func__);
+	*target_procp = target_proc;
+	return buffer;
+}
+
+static void binder_transaction_prealloc_put(struct binder_proc *target_proc,
+					    struct binder_buffer *buffer)
+{
+	if (target_proc == NULL)
+		return;
+
+	/* A dead proc has already freed all of its buffers */
+	if (buffer && !target_proc->is_dead) {
+		mutex_lock(&target_proc->alloc_lock);
+		binder_free_buf(target_proc, buffer);
+		mutex_unlock(&target_proc->alloc_lock);
+	}
+	binder_proc_dec_tmpref(target_proc);
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
-			       struct binder_transaction_data *tr, int reply)
+			       struct binder_transaction_data *tr, int reply,
+			       binder_size_t extra_buffers_size)
 {
 	struct binder_transaction *t;
 	struct binder_work *tcomplete;
-	binder_size_t *offp, *off_end;
+	binder_size_t *offp, *off_end, *off_start;
 	binder_size_t off_min;
+	u8 *sg_bufp, *sg_buf_end;
+	struct binder_buffer_object *last_fixup_obj = NULL;
+	binder_size_t last_fixup_min_off = 0;
 	struct binder_proc *target_proc;
 	struct binder_thread *target_thread = NULL;
 	struct binder_node *target_node = NULL;
@@ -1324,6 +1948,13 @@ static void binder_transaction(struct binder_proc *proc,
 	struct binder_transaction *in_reply_to = NULL;
 	struct binder_transaction_log_entry *e;
 	uint32_t return_error;
+	struct binder_proc *prealloc_proc;
+	struct binder_buffer *prealloc_buf;
+	bool copied = false;
+
+	prealloc_buf = binder_transaction_prealloc(proc, thread, tr, reply,
+						   extra_buffers_size,
+						   &prealloc_proc);
 
 	e = binder_transaction_log_add(&binder_transaction_log);
 	e->call_type = reply ? 2 : !!(tr->flags & TF_ONE_WAY);
@@ -1341,7 +1972,8 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
-		binder_set_nice(in_reply_to->saved_priority);
+		binder_set_priority(in_reply_to->saved_priority);
+		sched_set_task_boost(current, in_reply_to->saved_sched_boost);
 		if (in_reply_to->to_thread != thread) {
 			binder_user_error("%d:%d got reply transaction with bad transaction stack, transaction %d has target %d:%d\n",
 				proc->pid, thread->pid, in_reply_to->debug_id,
@@ -1473,15 +2105,36 @@ static void binder_transaction(struct binder_proc *proc,
 	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
-	t->priority = task_nice(current);
+	/*
+	 * Real-time policies are only passed on to nodes that asked for them
+	 * with FLAT_BINDER_FLAG_INHERIT_RT; everyone else gets the nice level.
+	 */
+	if (is_rt_policy(current->policy) && target_node &&
+	    target_node->inherit_rt) {
+		t->priority.sched_policy = current->policy;
+		t->priority.prio = current->normal_prio;
+	} else {
+		t->priority.sched_policy = SCHED_NORMAL;
+		t->priority.prio = current->static_prio;
+	}
+	t->sched_boost = sched_task_boosted(current);
 
 	trace_binder_transaction(reply, t, target_node);
 
-	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
-		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
-	if (t->buffer == NULL) {
-		return_error = BR_FAILED_REPLY;
-		goto err_binder_alloc_buf_failed;
+	if (prealloc_buf && prealloc_proc == target_proc) {
+		t->buffer = prealloc_buf;
+		prealloc_buf = NULL;
+		copied = true;
+	} else {
+		mutex_lock(&target_proc->alloc_lock);
+		t->buffer = binder_alloc_buf(target_proc, tr->data_size,
+			tr->offsets_size, extra_buffers_size,
+			!reply && (t->flags & TF_ONE_WAY));
+		mutex_unlock(&target_proc->alloc_lock);
+		if (t->buffer == NULL) {
+			return_error = BR_FAILED_REPLY;
+			goto err_binder_alloc_buf_failed;
+		}
 	}
 	t->buffer->allow_user_free = 0;
 	t->buffer->debug_id = t->debug_id;
@@ -1494,14 +2147,15 @@ static void binder_transaction(struct binder_proc *proc,
 	offp = (binder_size_t *)(t->buffer->data +
 				 ALIGN(tr->data_size, sizeof(void *)));
 
-	if (copy_from_user(t->buffer->data, (const void __user *)(uintptr_t)
+	if (!copied && copy_from_user(t->buffer->data,
+			   (const void __user *)(uintptr_t)
 			   tr->data.ptr.buffer, tr->data_size)) {
 		binder_user_error("%d:%d got transaction with invalid data ptr\n",
 				proc->pid, thread->pid);
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
-	if (copy_from_user(offp, (const void __user *)(uintptr_t)
+	if (!copied && copy_from_user(offp, (const void __user *)(uintptr_t)
 			   tr->data.ptr.offsets, tr->offsets_size)) {
 		binder_user_error("%d:%d got transaction with invalid offsets ptr\n",
 				proc->pid, thread->pid);
@@ -1514,24 +2168,32 @@ static void binder_transaction(struct binder_proc *proc,
 		return_error = BR_FAILED_REPLY;
 		goto err_bad_offset;
 	}
+	if (!IS_ALIGNED(extra_buffers_size, sizeof(u64))) {
+		binder_user_error("%d:%d got transaction with unaligned buffers size, %lld\n",
+				  proc->pid, thread->pid,
+				  (u64)extra_buffers_size);
+		return_error = BR_FAILED_REPLY;
+		goto err_bad_offset;
+	}
+	off_start = offp;
 	off_end = (void *)offp + tr->offsets_size;
+	sg_bufp = (u8 *)offp + ALIGN(tr->offsets_size, sizeof(void *));
+	sg_buf_end = sg_bufp + extra_buffers_size;
 	off_min = 0;
 	for (; offp < off_end; offp++) {
 		struct flat_binder_object *fp;
-		if (*offp > t->buffer->data_size - sizeof(*fp) ||
-		    *offp < off_min ||
-		    t->buffer->data_size < sizeof(*fp) ||
-		    !IS_ALIGNED(*offp, sizeof(u32))) {
-			binder_user_error("%d:%d got transaction with invalid offset, %lld (min %lld, max %lld)\n",
+		size_t object_size = binder_validate_object(t->buffer, *offp);
+
+		if (object_size == 0 || *offp < off_min) {
+			binder_user_error("%d:%d got transaction with invalid offset (%lld, min %lld max %lld) or object\n",
 					  proc->pid, thread->pid, (u64)*offp,
 					  (u64)off_min,
-					  (u64)(t->buffer->data_size -
-					  sizeof(*fp)));
+					  (u64)t->buffer->data_size);
 			return_error = BR_FAILED_REPLY;
 			goto err_bad_offset;
 		}
 		fp = (struct flat_binder_object *)(t->buffer->data + *offp);
-		off_min = *offp + sizeof(struct flat_binder_object);
+		off_min = *offp + object_size;
 		switch (fp->type) {
 		case BINDER_TYPE_BINDER:
 		case BINDER_TYPE_WEAK_BINDER: {
@@ -1545,6 +2207,7 @@ static void binder_transaction(struct binder_proc *proc,
 				}
 				node->min_priority = fp->flags & FLAT_BINDER_FLAG_PRIORITY_MASK;
 				node->accept_fds = !!(fp->flags & FLAT_BINDER_FLAG_ACCEPTS_FDS);
+				node->inherit_rt = !!(fp->flags & FLAT_BINDER_FLAG_INHERIT_RT);
 			}
 			if (fp->cookie != node->cookie) {
 				binder_user_error("%d:%d sending u%016llx node %d, cookie mismatch %016llx != %016llx\n",
@@ -1672,6 +2335,40 @@ static void binder_transaction(struct binder_proc *proc,
 			fp->handle = target_fd;
 		} break;
 
+		case BINDER_TYPE_PTR: {
+			struct binder_buffer_object *bp =
+				(struct binder_buffer_object *)fp;
+			size_t buf_left = sg_buf_end - sg_bufp;
+
+			if (bp->length > buf_left) {
+				binder_user_error("%d:%d got transaction with too large buffer\n",
+						  proc->pid, thread->pid);
+				return_error = BR_FAILED_REPLY;
+				goto err_bad_offset;
+			}
+			if (copy_from_user(sg_bufp, (const void __user *)
+					   (uintptr_t)bp->buffer, bp->length)) {
+				binder_user_error("%d:%d got transaction with invalid buffer ptr\n",
+						  proc->pid, thread->pid);
+				return_error = BR_FAILED_REPLY;
+				goto err_copy_data_failed;
+			}
+			/* Hand the target its own copy */
+			bp->buffer = (uintptr_t)sg_bufp +
+				     target_proc->user_buffer_offset;
+			sg_bufp += ALIGN(bp->length, sizeof(u64));
+
+			if (binder_fixup_parent(t, thread, bp, off_start,
+						offp - off_start,
+						last_fixup_obj,
+						last_fixup_min_off)) {
+				return_error = BR_FAILED_REPLY;
+				goto err_bad_offset;
+			}
+			last_fixup_obj = bp;
+			last_fixup_min_off = 0;
+		} break;
+
 		default:
 			binder_user_error("%d:%d got transaction with invalid object type, %x\n",
 				proc->pid, thread->pid, fp->type);
@@ -1681,6 +2378,7 @@ static void binder_transaction(struct binder_proc *proc,
 	}
 	if (reply) {
 		BUG_ON(t->buffer->async_transaction != 0);
+		binder_lat_reply(proc, in_reply_to);
 		binder_pop_transaction(target_thread, in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
@@ -1697,11 +2395,13 @@ static void binder_transaction(struct binder_proc *proc,
 			target_node->has_async_transaction = 1;
 	}
 	t->work.type = BINDER_WORK_TRANSACTION;
+	t->queue_ns = binder_lat_now();
 	list_add_tail(&t->work.entry, target_list);
 	tcomplete->type = BINDER_WORK_TRANSACTION_COMPLETE;
 	list_add_tail(&tcomplete->entry, &thread->todo);
 	if (target_wait)
 		wake_up_interruptible(target_wait);
+	binder_transaction_prealloc_put(prealloc_proc, prealloc_buf);
 	return;
 
 err_get_unused_fd_failed:
@@ -1716,7 +2416,9 @@ err_copy_data_failed:
 	trace_binder_transaction_failed_buffer_release(t->buffer);
 	binder_transaction_buffer_release(target_proc, t->buffer, offp);
 	t->buffer->transaction = NULL;
+	mutex_lock(&target_proc->alloc_lock);
 	binder_free_buf(target_proc, t->buffer);
+	mutex_unlock(&target_proc->alloc_lock);
 err_binder_alloc_buf_failed:
 	kfree(tcomplete);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
@@ -1746,6 +2448,7 @@ err_no_context_mgr_node:
 		binder_send_failed_reply(in_reply_to, return_error);
 	} else
 		thread->return_error = return_error;
+	binder_transaction_prealloc_put(prealloc_proc, prealloc_buf);
 }
 
 static int binder_thread_write(struct binder_proc *proc,
@@ -1901,7 +2604,9 @@ static int binder_thread_write(struct binder_proc *proc,
 				return -EFAULT;
 			ptr += sizeof(binder_uintptr_t);
 
+			mutex_lock(&proc->alloc_lock);
 			buffer = binder_buffer_lookup(proc, data_ptr);
+			mutex_unlock(&proc->alloc_lock);
 			if (buffer == NULL) {
 				binder_user_error("%d:%d BC_FREE_BUFFER u%016llx no match\n",
 					proc->pid, thread->pid, (u64)data_ptr);
@@ -1930,7 +2635,9 @@ static int binder_thread_write(struct binder_proc *proc,
 			}
 			trace_binder_transaction_buffer_release(buffer);
 			binder_transaction_buffer_release(proc, buffer, NULL);
+			mutex_lock(&proc->alloc_lock);
 			binder_free_buf(proc, buffer);
+			mutex_unlock(&proc->alloc_lock);
 			break;
 		}
 
@@ -1941,7 +2648,19 @@ static int binder_thread_write(struct binder_proc *proc,
 			if (copy_from_user(&tr, ptr, sizeof(tr)))
 				return -EFAULT;
 			ptr += sizeof(tr);
-			binder_transaction(proc, thread, &tr, cmd == BC_REPLY);
+			binder_transaction(proc, thread, &tr, cmd == BC_REPLY, 0);
+			break;
+		}
+
+		case BC_TRANSACTION_SG:
+		case BC_REPLY_SG: {
+			struct binder_transaction_data_sg tr;
+
+			if (copy_from_user(&tr, ptr, sizeof(tr)))
+				return -EFAULT;
+			ptr += sizeof(tr);
+			binder_transaction(proc, thread, &tr.transaction_data,
+					   cmd == BC_REPLY_SG, tr.buffers_size);
 			break;
 		}
 
@@ -2197,7 +2916,7 @@ retry:
 			wait_event_interruptible(binder_user_error_wait,
 						 binder_stop_on_user_error < 2);
 		}
-		binder_set_nice(proc->default_priority);
+		binder_set_priority(proc->default_priority);
 		if (non_block) {
 			if (!binder_has_proc_work(proc, thread))
 				ret = -EAGAIN;
@@ -2368,18 +3087,27 @@ retry:
 			struct binder_node *target_node = t->buffer->target_node;
 			tr.target.ptr = target_node->ptr;
 			tr.cookie =  target_node->cookie;
-			t->saved_priority = task_nice(current);
-			if (t->priority < target_node->min_priority &&
-			    !(t->flags & TF_ONE_WAY))
-				binder_set_nice(t->priority);
-			else if (!(t->flags & TF_ONE_WAY) ||
-				 t->saved_priority > target_node->min_priority)
-				binder_set_nice(target_node->min_priority);
+			t->saved_priority.sched_policy = current->policy;
+			t->saved_priority.prio = current->normal_prio;
+			binder_transaction_priority(t, target_node);
+			t->start_ns = binder_lat_now();
+			binder_lat_record(proc, BINDER_LAT_QUEUE,
+					  t->queue_ns, t->start_ns);
+			/*
+			 * The placement boost of the caller carries over to
+			 * the thread serving its synchronous call, until it
+			 * replies.
+			 */
+			t->saved_sched_boost = sched_get_task_boost(current);
+			if (t->sched_boost && !(t->flags & TF_ONE_WAY))
+				sched_set_task_boost(current, 1);
 			cmd = BR_TRANSACTION;
 		} else {
 			tr.target.ptr = 0;
 			tr.cookie = 0;
 			cmd = BR_REPLY;
+			binder_lat_record(proc, BINDER_LAT_REPLY,
+					  t->queue_ns, binder_lat_now());
 		}
 		tr.code = t->code;
 		tr.flags = t->flags;
@@ -2792,6 +3520,7 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	struct binder_proc *proc = filp->private_data;
 	const char *failure_string;
 	struct binder_buffer *buffer;
+	size_t pinned_size;
 
 	if (proc->tsk != current)
 		return -EINVAL;
@@ -2848,11 +3577,14 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	vma->vm_ops = &binder_vm_ops;
 	vma->vm_private_data = proc;
 
-	if (binder_update_page_range(proc, 1, proc->buffer, proc->buffer + PAGE_SIZE, vma)) {
+	pinned_size = clamp_t(size_t, binder_pinned_pages * PAGE_SIZE,
+			      PAGE_SIZE, proc->buffer_size);
+	if (binder_update_page_range(proc, 1, proc->buffer, proc->buffer + pinned_size, vma)) {
 		ret = -ENOMEM;
 		failure_string = "alloc small buf";
 		goto err_alloc_small_buf_failed;
 	}
+	proc->pinned_size = pinned_size;
 	buffer = proc->buffer;
 	INIT_LIST_HEAD(&proc->buffers);
 	list_add(&buffer->entry, &proc->buffers);
@@ -2887,6 +3619,7 @@ err_bad_arg:
 static int binder_open(struct inode *nodp, struct file *filp)
 {
 	struct binder_proc *proc;
+	int i;
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE, "binder_open: %d:%d\n",
 		     current->group_leader->pid, current->pid);
@@ -2898,7 +3631,17 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	proc->tsk = current;
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
-	proc->default_priority = task_nice(current);
+	mutex_init(&proc->alloc_lock);
+	for (i = 0; i < BINDER_NR_SIZE_CLASSES; i++)
+		INIT_LIST_HEAD(&proc->size_classes[i]);
+	if (is_rt_policy(current->policy) || current->policy == SCHED_NORMAL ||
+	    current->policy == SCHED_BATCH) {
+		proc->default_priority.sched_policy = current->policy;
+		proc->default_priority.prio = current->normal_prio;
+	} else {
+		proc->default_priority.sched_policy = SCHED_NORMAL;
+		proc->default_priority.prio = current->static_prio;
+	}
 
 	binder_lock(__func__);
 
@@ -3012,6 +3755,7 @@ static void binder_deferred_release(struct binder_proc *proc)
 	BUG_ON(proc->files);
 
 	hlist_del(&proc->proc_node);
+	proc->is_dead = true;
 
 	if (binder_context_mgr_node && binder_context_mgr_node->proc == proc) {
 		binder_debug(BINDER_DEBUG_DEAD_BINDER,
@@ -3054,6 +3798,7 @@ static void binder_deferred_release(struct binder_proc *proc)
 	binder_release_work(&proc->delivered_death);
 
 	buffers = 0;
+	mutex_lock(&proc->alloc_lock);
 	while ((n = rb_first(&proc->allocated_buffers))) {
 		struct binder_buffer *buffer;
 
@@ -3095,6 +3840,7 @@ static void binder_deferred_release(struct binder_proc *proc)
 		kfree(proc->pages);
 		vfree(proc->buffer);
 	}
+	mutex_unlock(&proc->alloc_lock);
 
 	put_task_struct(proc->tsk);
 
@@ -3103,7 +3849,9 @@ static void binder_deferred_release(struct binder_proc *proc)
 		     __func__, proc->pid, threads, nodes, incoming_refs,
 		     outgoing_refs, active_transactions, buffers, page_count);
 
-	kfree(proc);
+	/* A transaction filling one of our buffers frees us when done */
+	if (!proc->tmp_ref)
+		kfree(proc);
 }
 
 static void binder_deferred_func(struct work_struct *work)
@@ -3164,13 +3912,14 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 				     struct binder_transaction *t)
 {
 	seq_printf(m,
-		   "%s %d: %pK from %d:%d to %d:%d code %x flags %x pri %ld r%d",
+		   "%s %d: %pK from %d:%d to %d:%d code %x flags %x pri %u:%d r%d",
 		   prefix, t->debug_id, t,
 		   t->from ? t->from->proc->pid : 0,
 		   t->from ? t->from->pid : 0,
 		   t->to_proc ? t->to_proc->pid : 0,
 		   t->to_thread ? t->to_thread->pid : 0,
-		   t->code, t->flags, t->priority, t->need_reply);
+		   t->code, t->flags, t->priority.sched_policy,
+		   t->priority.prio, t->need_reply);
 	if (t->buffer == NULL) {
 		seq_puts(m, " buffer free\n");
 		return;
@@ -3321,9 +4070,13 @@ static void print_binder_proc(struct seq_file *m,
 			print_binder_ref(m, rb_entry(n, struct binder_ref,
 						     rb_node_desc));
 	}
+	if (!binder_debug_no_lock)
+		mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		print_binder_buffer(m, "  buffer",
 				    rb_entry(n, struct binder_buffer, rb_node));
+	if (!binder_debug_no_lock)
+		mutex_unlock(&proc->alloc_lock);
 	list_for_each_entry(w, &proc->todo, entry)
 		print_binder_work(m, "  ", "  pending transaction", w);
 	list_for_each_entry(w, &proc->delivered_death, entry) {
@@ -3372,7 +4125,9 @@ static const char * const binder_command_strings[] = {
 	"BC_EXIT_LOOPER",
 	"BC_REQUEST_DEATH_NOTIFICATION",
 	"BC_CLEAR_DEATH_NOTIFICATION",
-	"BC_DEAD_BINDER_DONE"
+	"BC_DEAD_BINDER_DONE",
+	"BC_TRANSACTION_SG",
+	"BC_REPLY_SG"
 };
 
 static const char * const binder_objstat_strings[] = {
@@ -3419,6 +4174,35 @@ static void print_binder_stats(struct seq_file *m, const char *prefix,
 	}
 }
 
+static void print_binder_lat_hist(struct seq_file *m, const char *prefix,
+				  const char *name, struct binder_lat_hist *h)
+{
+	int i;
+
+	if (!h->count)
+		return;
+	seq_printf(m, "%s%s: count %u avg %lluus max %uus\n", prefix, name,
+		   h->count, div_u64(h->sum_us, h->count), h->max_us);
+	seq_printf(m, "%s ", prefix);
+	for (i = 0; i < BINDER_LAT_BUCKETS; i++) {
+		if (h->bucket[i])
+			seq_printf(m, " %s%uus:%u", i ? "" : "<",
+				   i ? 1U << (i - 1) : 1, h->bucket[i]);
+	}
+	seq_puts(m, "\n");
+}
+
+static void print_binder_lat(struct seq_file *m, const char *prefix,
+			     struct binder_lat_hist *lat)
+{
+	int i;
+
+	BUILD_BUG_ON(ARRAY_SIZE(binder_lat_strings) != BINDER_LAT_COUNT);
+	for (i = 0; i < BINDER_LAT_COUNT; i++)
+		print_binder_lat_hist(m, prefix, binder_lat_strings[i],
+				      &lat[i]);
+}
+
 static void print_binder_proc_stats(struct seq_file *m,
 				    struct binder_proc *proc)
 {
@@ -3453,8 +4237,12 @@ static void print_binder_proc_stats(struct seq_file *m,
 	seq_printf(m, "  refs: %d s %d w %d\n", count, strong, weak);
 
 	count = 0;
+	if (!binder_debug_no_lock)
+		mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		count++;
+	if (!binder_debug_no_lock)
+		mutex_unlock(&proc->alloc_lock);
 	seq_printf(m, "  buffers: %d\n", count);
 
 	count = 0;
@@ -3515,6 +4303,38 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static int binder_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_proc *proc;
+	struct rb_node *n;
+	int do_lock = !binder_debug_no_lock;
+
+	if (do_lock)
+		binder_lock(__func__);
+
+	seq_puts(m, "binder latency:\n");
+	print_binder_lat(m, "", binder_lat);
+
+	hlist_for_each_entry(proc, &binder_procs, proc_node) {
+		seq_printf(m, "proc %d\n", proc->pid);
+		print_binder_lat(m, "  ", proc->lat);
+		for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n)) {
+			struct binder_node *node = rb_entry(n,
+					struct binder_node, rb_node);
+
+			if (!node->exec_lat.count)
+				continue;
+			seq_printf(m, "  node %d: u%016llx\n", node->debug_id,
+				   (u64)node->ptr);
+			print_binder_lat_hist(m, "    ", "exec",
+					      &node->exec_lat);
+		}
+	}
+	if (do_lock)
+		binder_unlock(__func__);
+	return 0;
+}
+
 static int binder_transactions_show(struct seq_file *m, void *unused)
 {
 	struct binder_proc *proc;
@@ -3600,6 +4420,7 @@ static struct miscdevice binder_miscdev = {
 
 BINDER_DEBUG_ENTRY(state);
 BINDER_DEBUG_ENTRY(stats);
+BINDER_DEBUG_ENTRY(latency);
 BINDER_DEBUG_ENTRY(transactions);
 BINDER_DEBUG_ENTRY(transaction_log);
 
@@ -3627,6 +4448,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    NULL,
 				    &binder_stats_fops);
+		debugfs_create_file("latency",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
 		debugfs_create_file("transactions",
 				    S_IRUGO,
 				    binder_debugfs_dir_entry_root,
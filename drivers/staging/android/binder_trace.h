@@ -144,6 +144,40 @@ TRACE_EVENT(binder_transaction_received,
 	TP_printk("transaction=%d", __entry->debug_id)
 );
 
+TRACE_EVENT(binder_transaction_slow,
+	TP_PROTO(struct binder_transaction *t, struct binder_node *target_node,
+		 u64 queue_ns, u64 exec_ns),
+	TP_ARGS(t, target_node, queue_ns, exec_ns),
+
+	TP_STRUCT__entry(
+		__field(int, debug_id)
+		__field(int, target_node)
+		__field(int, from_proc)
+		__field(int, from_thread)
+		__field(int, to_proc)
+		__field(int, to_thread)
+		__field(unsigned int, code)
+		__field(u64, queue_ns)
+		__field(u64, exec_ns)
+	),
+	TP_fast_assign(
+		__entry->debug_id = t->debug_id;
+		__entry->target_node = target_node ? target_node->debug_id : 0;
+		__entry->from_proc = t->from ? t->from->proc->pid : 0;
+		__entry->from_thread = t->from ? t->from->pid : 0;
+		__entry->to_proc = t->to_proc->pid;
+		__entry->to_thread = t->to_thread ? t->to_thread->pid : 0;
+		__entry->code = t->code;
+		__entry->queue_ns = queue_ns;
+		__entry->exec_ns = exec_ns;
+	),
+	TP_printk("transaction=%d dest_node=%d from=%d:%d to=%d:%d code=0x%x queue_ns=%llu exec_ns=%llu",
+		  __entry->debug_id, __entry->target_node,
+		  __entry->from_proc, __entry->from_thread,
+		  __entry->to_proc, __entry->to_thread, __entry->code,
+		  __entry->queue_ns, __entry->exec_ns)
+);
+
 TRACE_EVENT(binder_transaction_node_to_ref,
 	TP_PROTO(struct binder_transaction *t, struct binder_node *node,
 		 struct binder_ref *ref),
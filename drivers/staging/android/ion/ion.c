@@ -1611,6 +1611,9 @@ static long ion_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	case ION_IOC_CLEAN_INV_CACHES:
 		return client->dev->custom_ioctl(client,
 						ION_IOC_CLEAN_INV_CACHES, arg);
+	case ION_IOC_CACHE_OPS:
+		return client->dev->custom_ioctl(client,
+						ION_IOC_CACHE_OPS, arg);
 	default:
 		return -ENOTTY;
 	}
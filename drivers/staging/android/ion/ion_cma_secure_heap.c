@@ -33,19 +33,29 @@
 
 #define ION_CMA_ALLOCATE_FAILED NULL
 
+/* Granule the secure environment locks memory in */
+#define ION_SECURE_CMA_GRANULE		SZ_1M
+
 struct ion_secure_cma_buffer_info {
 	dma_addr_t phys;
 	struct sg_table *table;
 	bool is_cached;
+	bool presecured;
 	int len;
 };
 
+/*
+ * @table: set if the chunk was secured when it was prefetched, buffers
+ * allocated from it are already secure and the chunk is unsecured as a whole
+ * when it leaves the pool
+ */
 struct ion_cma_alloc_chunk {
 	void *cpu_addr;
 	struct list_head entry;
 	dma_addr_t handle;
 	unsigned long chunk_size;
 	atomic_t cnt;
+	struct sg_table *table;
 };
 
 struct ion_cma_secure_heap {
@@ -91,6 +101,7 @@ struct ion_cma_secure_heap {
 	atomic_t total_leaked;
 	unsigned long heap_size;
 	unsigned long default_prefetch_size;
+	bool prefetch_secure;
 };
 
 static void ion_secure_pool_pages(struct work_struct *work);
@@ -115,6 +126,42 @@ int ion_secure_cma_get_sgtable(struct device *dev, struct sg_table *sgt,
 	return 0;
 }
 
+/*
+ * Lock a prefetched chunk for the secure environment right away, so that the
+ * allocations made from it later don't have to wait for it. The chunk stays
+ * an ordinary one if that fails.
+ */
+static void ion_secure_cma_secure_chunk(struct ion_cma_secure_heap *sheap,
+					struct ion_cma_alloc_chunk *chunk)
+{
+	struct sg_table *table;
+
+	if (!msm_secure_v2_is_supported() ||
+	    !IS_ALIGNED(sheap->base, ION_SECURE_CMA_GRANULE) ||
+	    !IS_ALIGNED(chunk->handle, ION_SECURE_CMA_GRANULE) ||
+	    !IS_ALIGNED(chunk->chunk_size, ION_SECURE_CMA_GRANULE))
+		return;
+
+	table = kmalloc(sizeof(*table), GFP_KERNEL);
+	if (!table)
+		return;
+
+	if (ion_secure_cma_get_sgtable(sheap->dev, table, chunk->handle,
+					chunk->chunk_size))
+		goto err;
+
+	if (msm_ion_secure_table(table)) {
+		pr_err("%s: failed to secure prefetched chunk\n", __func__);
+		sg_free_table(table);
+		goto err;
+	}
+
+	chunk->table = table;
+	return;
+err:
+	kfree(table);
+}
+
 static int ion_secure_cma_add_to_pool(
 					struct ion_cma_secure_heap *sheap,
 					unsigned long len,
@@ -152,6 +199,8 @@ static int ion_secure_cma_add_to_pool(
 	chunk->handle = handle;
 	chunk->chunk_size = len;
 	atomic_set(&chunk->cnt, 0);
+	if (prefetch && sheap->prefetch_secure)
+		ion_secure_cma_secure_chunk(sheap, chunk);
 	list_add(&chunk->entry, &sheap->chunks);
 	atomic_add(len, &sheap->total_pool_size);
 	 /* clear the bitmap to indicate this region can be allocated from */
@@ -247,6 +296,13 @@ int ion_secure_cma_prefetch(struct ion_heap *heap, void *data)
 	if (len > diff)
 		len = diff;
 
+	/* Only whole granules can be secured ahead of time */
+	if (sheap->prefetch_secure)
+		len = round_down(len, ION_SECURE_CMA_GRANULE);
+
+	if (len == 0)
+		return 0;
+
 	sheap->last_alloc = len;
 	trace_ion_prefetching(sheap->last_alloc);
 	schedule_work(&sheap->work);
@@ -276,10 +332,74 @@ static void bad_math_dump(unsigned long len, int total_overlap,
 
 }
 
+/* Return the secured chunk overlapping the pages, if any */
+static struct ion_cma_alloc_chunk *ion_secure_cma_secured_chunk(
+					struct ion_cma_secure_heap *sheap,
+					unsigned long page_no,
+					unsigned long nr)
+{
+	struct ion_cma_alloc_chunk *chunk;
+	dma_addr_t paddr = sheap->base + (page_no << PAGE_SHIFT);
+
+	list_for_each_entry(chunk, &sheap->chunks, entry) {
+		if (chunk->table && intersect(chunk->handle,
+				chunk->chunk_size, paddr, nr << PAGE_SHIFT))
+			return chunk;
+	}
+
+	return NULL;
+}
+
+/*
+ * Find free pages for a buffer, preferably within one of the secured chunks.
+ * A buffer outside of them must not share a granule with any, it gets
+ * secured on its own.
+ */
+static unsigned long ion_secure_cma_find_area(
+					struct ion_cma_secure_heap *sheap,
+					unsigned long nr, bool *presecured)
+{
+	struct ion_cma_alloc_chunk *chunk;
+	unsigned long page_no;
+
+	list_for_each_entry(chunk, &sheap->chunks, entry) {
+		unsigned long start, end;
+
+		if (!chunk->table)
+			continue;
+
+		start = (chunk->handle - sheap->base) >> PAGE_SHIFT;
+		end = start + (chunk->chunk_size >> PAGE_SHIFT);
+		page_no = bitmap_find_next_zero_area(sheap->bitmap, end, start,
+				nr, (ION_SECURE_CMA_GRANULE >> PAGE_SHIFT) - 1);
+		if (page_no < end) {
+			*presecured = true;
+			return page_no;
+		}
+	}
+
+	*presecured = false;
+	page_no = 0;
+	while (1) {
+		page_no = bitmap_find_next_zero_area(sheap->bitmap,
+					sheap->npages, page_no, nr, 0);
+		if (page_no >= sheap->npages)
+			return page_no;
+
+		chunk = ion_secure_cma_secured_chunk(sheap, page_no, nr);
+		if (!chunk)
+			return page_no;
+
+		page_no = (chunk->handle + chunk->chunk_size - sheap->base)
+				>> PAGE_SHIFT;
+	}
+}
+
 static int ion_secure_cma_alloc_from_pool(
 					struct ion_cma_secure_heap *sheap,
 					dma_addr_t *phys,
-					unsigned long len)
+					unsigned long len,
+					bool *presecured)
 {
 	dma_addr_t paddr;
 	unsigned long page_no;
@@ -289,8 +409,8 @@ static int ion_secure_cma_alloc_from_pool(
 
 	mutex_lock(&sheap->chunk_lock);
 
-	page_no = bitmap_find_next_zero_area(sheap->bitmap,
-				sheap->npages, 0, len >> PAGE_SHIFT, 0);
+	page_no = ion_secure_cma_find_area(sheap, len >> PAGE_SHIFT,
+				presecured);
 	if (page_no >= sheap->npages) {
 		ret = -ENOMEM;
 		goto out;
@@ -322,13 +442,24 @@ static void ion_secure_cma_free_chunk(struct ion_cma_secure_heap *sheap,
 					struct ion_cma_alloc_chunk *chunk)
 {
 	DEFINE_DMA_ATTRS(attrs);
+	bool leak = false;
 
 	dma_set_attr(DMA_ATTR_NO_KERNEL_MAPPING, &attrs);
 	/* This region is 'allocated' and not available to allocate from */
 	bitmap_set(sheap->bitmap, (chunk->handle - sheap->base) >> PAGE_SHIFT,
 			chunk->chunk_size >> PAGE_SHIFT);
-	dma_free_attrs(sheap->dev, chunk->chunk_size, chunk->cpu_addr,
-				chunk->handle, &attrs);
+	if (chunk->table) {
+		if (msm_ion_unsecure_table(chunk->table)) {
+			WARN(1, "Unsecure failed, can't free the chunk. Leaking it!");
+			atomic_add(chunk->chunk_size, &sheap->total_leaked);
+			leak = true;
+		}
+		sg_free_table(chunk->table);
+		kfree(chunk->table);
+	}
+	if (!leak)
+		dma_free_attrs(sheap->dev, chunk->chunk_size, chunk->cpu_addr,
+					chunk->handle, &attrs);
 	atomic_sub(chunk->chunk_size, &sheap->total_pool_size);
 	list_del(&chunk->entry);
 	kfree(chunk);
@@ -454,7 +585,8 @@ static struct ion_secure_cma_buffer_info *__ion_secure_cma_allocate(
 	}
 
 	mutex_lock(&sheap->alloc_lock);
-	ret = ion_secure_cma_alloc_from_pool(sheap, &info->phys, len);
+	ret = ion_secure_cma_alloc_from_pool(sheap, &info->phys, len,
+					&info->presecured);
 
 	if (ret) {
 retry:
@@ -464,7 +596,8 @@ retry:
 			dev_err(sheap->dev, "Fail to allocate buffer\n");
 			goto err;
 		}
-		ret = ion_secure_cma_alloc_from_pool(sheap, &info->phys, len);
+		ret = ion_secure_cma_alloc_from_pool(sheap, &info->phys, len,
+						&info->presecured);
 		if (ret) {
 			/*
 			 * Lost the race with the shrinker, try again
@@ -539,7 +672,10 @@ static int ion_secure_cma_allocate(struct ion_heap *heap,
 	if (buf) {
 		int ret;
 
-		if (!msm_secure_v2_is_supported()) {
+		if (buf->presecured) {
+			/* Carved out of a chunk secured by the prefetch */
+			ret = 0;
+		} else if (!msm_secure_v2_is_supported()) {
 			pr_err("%s: securing buffers from clients is not supported on this platform\n",
 				__func__);
 			ret = 1;
@@ -572,7 +708,8 @@ static void ion_secure_cma_free(struct ion_buffer *buffer)
 	int ret = 0;
 
 	dev_dbg(sheap->dev, "Release buffer %pK\n", buffer);
-	if (msm_secure_v2_is_supported())
+	/* A presecured buffer goes back to its chunk still secure */
+	if (msm_secure_v2_is_supported() && !info->presecured)
 		ret = msm_ion_unsecure_table(info->table);
 	atomic_sub(buffer->size, &sheap->total_allocated);
 	BUG_ON(atomic_read(&sheap->total_allocated) < 0);
@@ -721,7 +858,11 @@ struct ion_heap *ion_secure_cma_heap_create(struct ion_platform_heap *data)
 
 	if (data->extra_data) {
 		struct ion_cma_pdata *extra = data->extra_data;
-		sheap->default_prefetch_size = extra->default_prefetch_size;
+
+		if (extra->default_prefetch_size)
+			sheap->default_prefetch_size =
+				extra->default_prefetch_size;
+		sheap->prefetch_secure = extra->prefetch_secure;
 	}
 
 	/*
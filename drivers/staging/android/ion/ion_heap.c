@@ -151,6 +151,15 @@ end:
 	return ret;
 }
 
+void ion_heap_refill(struct ion_heap *heap)
+{
+	if (!(heap->flags & ION_HEAP_FLAG_DEFER_FREE) || !heap->ops->refill)
+		return;
+
+	if (atomic_xchg(&heap->refill_pending, 1) == 0)
+		wake_up(&heap->waitqueue);
+}
+
 void ion_heap_freelist_add(struct ion_heap *heap, struct ion_buffer *buffer)
 {
 	spin_lock(&heap->free_lock);
@@ -221,11 +230,19 @@ static int ion_heap_deferred_free(void *data)
 		struct ion_buffer *buffer;
 
 		wait_event_freezable(heap->waitqueue,
-				     ion_heap_freelist_size(heap) > 0);
+				     ion_heap_freelist_size(heap) > 0 ||
+				     atomic_read(&heap->refill_pending));
 
 		spin_lock(&heap->free_lock);
 		if (list_empty(&heap->free_list)) {
 			spin_unlock(&heap->free_lock);
+			/*
+			 * The buffers freed above went back to the pools
+			 * first so only top up what they didn't cover
+			 */
+			if (atomic_xchg(&heap->refill_pending, 0) &&
+			    heap->ops->refill)
+				heap->ops->refill(heap);
 			continue;
 		}
 		buffer = list_first_entry(&heap->free_list, struct ion_buffer,
@@ -245,6 +262,7 @@ int ion_heap_init_deferred_free(struct ion_heap *heap)
 
 	INIT_LIST_HEAD(&heap->free_list);
 	heap->free_list_size = 0;
+	atomic_set(&heap->refill_pending, 0);
 	spin_lock_init(&heap->free_lock);
 	init_waitqueue_head(&heap->waitqueue);
 	heap->task = kthread_run(ion_heap_deferred_free, heap,
@@ -20,11 +20,20 @@
 #include <linux/fs.h>
 #include <linux/list.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/swap.h>
 #include <linux/vmalloc.h>
 #include "ion_priv.h"
 
+/*
+ * Bytes each per-cpu cache holds at most. Orders too large to have at
+ * least two items in that budget don't get caches, their few items per
+ * buffer don't make the pool mutex a bottleneck.
+ */
+#define ION_PAGE_POOL_CACHE_BYTES	SZ_256K
+
 static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
 {
 	struct page *page;
@@ -50,9 +59,8 @@ static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 	__free_pages(page, pool->order);
 }
 
-static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+static void __ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 {
-	mutex_lock(&pool->mutex);
 	if (PageHighMem(page)) {
 		list_add_tail(&page->lru, &pool->high_items);
 		pool->high_count++;
@@ -60,10 +68,33 @@ static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 		list_add_tail(&page->lru, &pool->low_items);
 		pool->low_count++;
 	}
+}
+
+static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+{
+	mutex_lock(&pool->mutex);
+	__ion_page_pool_add(pool, page);
 	mutex_unlock(&pool->mutex);
 	return 0;
 }
 
+/* Give a batch of items back to the pool under a single lock */
+static void ion_page_pool_add_list(struct ion_page_pool *pool,
+				   struct list_head *pages)
+{
+	struct page *page, *tmp;
+
+	if (list_empty(pages))
+		return;
+
+	mutex_lock(&pool->mutex);
+	list_for_each_entry_safe(page, tmp, pages, lru) {
+		list_del(&page->lru);
+		__ion_page_pool_add(pool, page);
+	}
+	mutex_unlock(&pool->mutex);
+}
+
 static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 {
 	struct page *page;
@@ -82,6 +113,126 @@ static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 	return page;
 }
 
+static struct page *ion_page_pool_cache_get(struct ion_page_pool *pool)
+{
+	struct ion_page_pool_cache *cache;
+	struct page *page;
+	LIST_HEAD(batch);
+	unsigned int count = 0;
+
+	cache = get_cpu_ptr(pool->caches);
+	spin_lock(&cache->lock);
+	page = list_first_entry_or_null(&cache->items, struct page, lru);
+	if (page) {
+		list_del(&page->lru);
+		cache->count--;
+	}
+	spin_unlock(&cache->lock);
+	put_cpu_ptr(pool->caches);
+
+	if (page)
+		return page;
+
+	/*
+	 * Take half a cache worth of items from the pool in one go, the
+	 * caller is most likely allocating a buffer of many more pages
+	 */
+	if (!mutex_trylock(&pool->mutex))
+		return NULL;
+	while (count < pool->cache_size / 2) {
+		if (pool->high_count)
+			page = ion_page_pool_remove(pool, true);
+		else if (pool->low_count)
+			page = ion_page_pool_remove(pool, false);
+		else
+			break;
+		list_add_tail(&page->lru, &batch);
+		count++;
+	}
+	mutex_unlock(&pool->mutex);
+
+	page = list_first_entry_or_null(&batch, struct page, lru);
+	if (!page)
+		return NULL;
+	list_del(&page->lru);
+	count--;
+
+	if (count) {
+		cache = get_cpu_ptr(pool->caches);
+		spin_lock(&cache->lock);
+		list_splice_tail(&batch, &cache->items);
+		cache->count += count;
+		spin_unlock(&cache->lock);
+		put_cpu_ptr(pool->caches);
+	}
+
+	return page;
+}
+
+static void ion_page_pool_cache_put(struct ion_page_pool *pool,
+				    struct page *page)
+{
+	struct ion_page_pool_cache *cache;
+	struct page *item, *tmp;
+	LIST_HEAD(batch);
+	unsigned int count = 0;
+
+	/* Move the older half of a full cache back to the pool */
+	cache = get_cpu_ptr(pool->caches);
+	spin_lock(&cache->lock);
+	if (cache->count >= pool->cache_size) {
+		list_for_each_entry_safe(item, tmp, &cache->items, lru) {
+			if (count == pool->cache_size / 2)
+				break;
+			list_move_tail(&item->lru, &batch);
+			count++;
+		}
+		cache->count -= count;
+	}
+	list_add_tail(&page->lru, &cache->items);
+	cache->count++;
+	spin_unlock(&cache->lock);
+	put_cpu_ptr(pool->caches);
+
+	ion_page_pool_add_list(pool, &batch);
+}
+
+/* Move the items of all the per-cpu caches back to the pool */
+static void ion_page_pool_cache_drain(struct ion_page_pool *pool)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_cache *cache =
+			per_cpu_ptr(pool->caches, cpu);
+		LIST_HEAD(batch);
+
+		if (!ACCESS_ONCE(cache->count))
+			continue;
+
+		spin_lock(&cache->lock);
+		list_splice_init(&cache->items, &batch);
+		cache->count = 0;
+		spin_unlock(&cache->lock);
+
+		ion_page_pool_add_list(pool, &batch);
+	}
+}
+
+static unsigned int ion_page_pool_cache_total(struct ion_page_pool *pool)
+{
+	unsigned int total = 0;
+	int cpu;
+
+	if (!pool->cache_size)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		total += ACCESS_ONCE(per_cpu_ptr(pool->caches, cpu)->count);
+
+	return total;
+}
+
 void *ion_page_pool_alloc(struct ion_page_pool *pool, bool *from_pool)
 {
 	struct page *page = NULL;
@@ -90,7 +241,10 @@ void *ion_page_pool_alloc(struct ion_page_pool *pool, bool *from_pool)
 
 	*from_pool = true;
 
-	if (mutex_trylock(&pool->mutex)) {
+	if (pool->cache_size)
+		page = ion_page_pool_cache_get(pool);
+
+	if (!page && mutex_trylock(&pool->mutex)) {
 		if (pool->high_count)
 			page = ion_page_pool_remove(pool, true);
 		else if (pool->low_count)
@@ -108,37 +262,80 @@ void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
 {
 	int ret;
 
+	if (pool->cache_size) {
+		ion_page_pool_cache_put(pool, page);
+		return;
+	}
+
 	ret = ion_page_pool_add(pool, page);
 	if (ret)
 		ion_page_pool_free_pages(pool, page);
 }
 
+void ion_page_pool_refill(struct ion_page_pool *pool)
+{
+	while (ACCESS_ONCE(pool->high_count) + ACCESS_ONCE(pool->low_count) <
+			pool->reserve) {
+		struct page *page;
+
+		page = alloc_pages(pool->gfp_mask & ~__GFP_ZERO, pool->order);
+		if (!page)
+			break;
+
+		if (msm_ion_heap_high_order_page_zero(page, pool->order)) {
+			ion_page_pool_free_pages(pool, page);
+			break;
+		}
+
+		ion_page_pool_add(pool, page);
+		cond_resched();
+	}
+}
+
 static int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 {
 	int total = 0;
 
-	total += high ? (pool->high_count + pool->low_count) *
+	/* The caches mix highmem and lowmem, count them for highmem only */
+	total += high ? (pool->high_count + pool->low_count +
+			 ion_page_pool_cache_total(pool)) *
 		(1 << pool->order) :
 			pool->low_count * (1 << pool->order);
 	return total;
 }
 
-int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
-				int nr_to_scan)
+static bool ion_page_pool_gfp_high(gfp_t gfp_mask)
 {
-	int i;
-	bool high;
-
 	if (current_is_kswapd())
-		high = 1;
-	else
-		high = !!(gfp_mask & __GFP_HIGHMEM);
+		return true;
+
+	return !!(gfp_mask & __GFP_HIGHMEM);
+}
 
-	for (i = 0; i < nr_to_scan; i++) {
+unsigned int ion_page_pool_count(struct ion_page_pool *pool)
+{
+	return ACCESS_ONCE(pool->high_count) + ACCESS_ONCE(pool->low_count) +
+		ion_page_pool_cache_total(pool);
+}
+
+int ion_page_pool_trim(struct ion_page_pool *pool, gfp_t gfp_mask,
+			int nr_to_scan, unsigned int keep)
+{
+	int freed = 0;
+	bool high = ion_page_pool_gfp_high(gfp_mask);
+
+	if (nr_to_scan > 0 && pool->cache_size)
+		ion_page_pool_cache_drain(pool);
+
+	/* nr_to_scan is in pages, an item can be many of them */
+	while (freed < nr_to_scan) {
 		struct page *page;
 
 		mutex_lock(&pool->mutex);
-		if (pool->low_count) {
+		if (pool->high_count + pool->low_count <= keep) {
+			mutex_unlock(&pool->mutex);
+			break;
+		} else if (pool->low_count) {
 			page = ion_page_pool_remove(pool, false);
 		} else if (high && pool->high_count) {
 			page = ion_page_pool_remove(pool, true);
@@ -148,23 +345,59 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 		}
 		mutex_unlock(&pool->mutex);
 		ion_page_pool_free_pages(pool, page);
+		freed += 1 << pool->order;
 	}
 
-	return ion_page_pool_total(pool, high);
+	return freed;
+}
+
+int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
+				int nr_to_scan)
+{
+	ion_page_pool_trim(pool, gfp_mask, nr_to_scan, 0);
+
+	return ion_page_pool_total(pool, ion_page_pool_gfp_high(gfp_mask));
 }
 
 struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
 {
 	struct ion_page_pool *pool = kmalloc(sizeof(struct ion_page_pool),
 					     GFP_KERNEL);
+	int cpu;
+
 	if (!pool)
 		return NULL;
+
+	pool->cache_size = ION_PAGE_POOL_CACHE_BYTES / (PAGE_SIZE << order);
+	if (pool->cache_size < 2)
+		pool->cache_size = 0;
+
+	pool->caches = NULL;
+	if (pool->cache_size) {
+		pool->caches = alloc_percpu(struct ion_page_pool_cache);
+		if (!pool->caches) {
+			kfree(pool);
+			return NULL;
+		}
+
+		for_each_possible_cpu(cpu) {
+			struct ion_page_pool_cache *cache =
+				per_cpu_ptr(pool->caches, cpu);
+
+			spin_lock_init(&cache->lock);
+			cache->count = 0;
+			INIT_LIST_HEAD(&cache->items);
+		}
+	}
+
 	pool->high_count = 0;
 	pool->low_count = 0;
 	INIT_LIST_HEAD(&pool->low_items);
 	INIT_LIST_HEAD(&pool->high_items);
 	pool->gfp_mask = gfp_mask;
 	pool->order = order;
+	pool->reserve = 0;
+	pool->high = 0;
 	mutex_init(&pool->mutex);
 	plist_node_init(&pool->list, order);
 
@@ -173,6 +406,19 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
 
 void ion_page_pool_destroy(struct ion_page_pool *pool)
 {
+	int cpu;
+
+	if (pool->caches) {
+		for_each_possible_cpu(cpu) {
+			struct ion_page_pool_cache *cache =
+				per_cpu_ptr(pool->caches, cpu);
+			struct page *page, *tmp;
+
+			list_for_each_entry_safe(page, tmp, &cache->items, lru)
+				ion_page_pool_free_pages(pool, page);
+		}
+		free_percpu(pool->caches);
+	}
 	kfree(pool);
 }
 
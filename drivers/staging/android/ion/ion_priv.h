@@ -107,6 +107,9 @@ void ion_buffer_destroy(struct ion_buffer *buffer);
  * @unmap_kernel	unmap memory to the kernel
  * @map_user		map memory to userspace
  * @unmap_user		unmap memory to userspace
+ * @refill		optional, called from the deferred free thread once
+ *			the free list is empty after ion_heap_refill() was
+ *			called, to prepare memory for future allocations
  *
  * allocate, phys, and map_user return 0 on success, -errno on error.
  * map_dma and map_kernel return pointer on success, ERR_PTR on
@@ -131,6 +134,7 @@ struct ion_heap_ops {
 			 struct vm_area_struct *vma);
 	void (*unmap_user) (struct ion_heap *mapper, struct ion_buffer *buffer);
 	int (*shrink)(struct ion_heap *heap, gfp_t gfp_mask, int nr_to_scan);
+	void (*refill)(struct ion_heap *heap);
 	int (*print_debug)(struct ion_heap *heap, struct seq_file *s,
 			   const struct list_head *mem_map);
 };
@@ -170,6 +174,7 @@ struct ion_heap_ops {
  * @lock:		protects the free list
  * @waitqueue:		queue to wait on from deferred free thread
  * @task:		task struct of deferred free thread
+ * @refill_pending:	set by ion_heap_refill() for the deferred free thread
  * @debug_show:		called when heap debug file is read to add any
  *			heap specific debug info to output
  *
@@ -193,6 +198,7 @@ struct ion_heap {
 	spinlock_t free_lock;
 	wait_queue_head_t waitqueue;
 	struct task_struct *task;
+	atomic_t refill_pending;
 	int (*debug_show)(struct ion_heap *heap, struct seq_file *, void *);
 	atomic_t total_allocated;
 	atomic_t total_handles;
@@ -281,6 +287,15 @@ void ion_heap_init_shrinker(struct ion_heap *heap);
  */
 int ion_heap_init_deferred_free(struct ion_heap *heap);
 
+/**
+ * ion_heap_refill - ask the deferred free thread to call the refill op
+ * @heap:		the heap
+ *
+ * Does nothing unless the heap sets ION_HEAP_FLAG_DEFER_FREE. The refill
+ * runs at idle priority once the deferred free list has been drained.
+ */
+void ion_heap_refill(struct ion_heap *heap);
+
 /**
  * ion_heap_freelist_add - add a buffer to the deferred free list
  * @heap:		the heap
@@ -375,6 +390,19 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * invalidated from the cache, provides a significant peformance benefit on
  * many systems */
 
+/**
+ * struct ion_page_pool_cache - per-cpu cache of a page pool
+ * @lock:		protects the cache, only contended while the shrinker
+ *			drains it
+ * @count:		number of items in the cache
+ * @items:		list of items, highmem and lowmem mixed
+ */
+struct ion_page_pool_cache {
+	spinlock_t lock;
+	unsigned int count;
+	struct list_head items;
+};
+
 /**
  * struct ion_page_pool - pagepool struct
  * @high_count:		number of highmem items in the pool
@@ -385,6 +413,13 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  *			item list
  * @gfp_mask:		gfp_mask to use from alloc
  * @order:		order of pages in the pool
+ * @reserve:		low watermark, number of items ion_page_pool_refill()
+ *			fills the pool up to
+ * @high:		high watermark, number of items above which the heap
+ *			trims the pool in the background, 0 for no limit
+ * @caches:		per-cpu caches of items in front of the lists above
+ * @cache_size:		number of items each per-cpu cache holds at most,
+ *			0 if the pool has no caches
  * @list:		plist node for list of pools
  *
  * Allows you to keep a pool of pre allocated pages to use from your heap.
@@ -400,6 +435,10 @@ struct ion_page_pool {
 	struct mutex mutex;
 	gfp_t gfp_mask;
 	unsigned int order;
+	unsigned int reserve;
+	unsigned int high;
+	struct ion_page_pool_cache __percpu *caches;
+	unsigned int cache_size;
 	struct plist_node list;
 };
 
@@ -408,16 +447,40 @@ void ion_page_pool_destroy(struct ion_page_pool *);
 void *ion_page_pool_alloc(struct ion_page_pool *, bool *from_pool);
 void ion_page_pool_free(struct ion_page_pool *, struct page *);
 
+/** ion_page_pool_refill - zero new pages into the pool up to its reserve
+ * @pool:		the pool
+ *
+ * Allocation from the pool then no longer has to zero the pages itself.
+ * Stops early if no page can be had without reclaim.
+ */
+void ion_page_pool_refill(struct ion_page_pool *pool);
+
 /** ion_page_pool_shrink - shrinks the size of the memory cached in the pool
  * @pool:		the pool
  * @gfp_mask:		the memory type to reclaim
  * @nr_to_scan:		number of items to shrink in pages
  *
- * returns the number of items freed in pages
+ * returns the number of pages left in the pool that match @gfp_mask
  */
 int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 			  int nr_to_scan);
 
+/** ion_page_pool_trim - free items down to a number of items
+ * @pool:		the pool
+ * @gfp_mask:		the memory type to reclaim
+ * @nr_to_scan:		maximum number of pages to free
+ * @keep:		number of items to leave in the pool
+ *
+ * returns the number of pages freed
+ */
+int ion_page_pool_trim(struct ion_page_pool *pool, gfp_t gfp_mask,
+			int nr_to_scan, unsigned int keep);
+
+/** ion_page_pool_count - number of items in the pool, per-cpu caches included
+ * @pool:		the pool
+ */
+unsigned int ion_page_pool_count(struct ion_page_pool *pool);
+
 /**
  * ion_pages_sync_for_device - cache flush pages for use with the specified
  *                             device
@@ -22,6 +22,7 @@
 #include <linux/mm.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include "ion.h"
@@ -41,6 +42,22 @@ static const unsigned int orders[] = {0};
 #endif
 
 static const int num_orders = ARRAY_SIZE(orders);
+
+/*
+ * Bytes of pre-zeroed pages the deferred free thread keeps in each of the
+ * uncached high order pools, so that large media buffers can be allocated
+ * without zeroing them on the spot
+ */
+#define ION_SYSTEM_HEAP_POOL_RESERVE	SZ_4M
+
+/*
+ * Bytes each pool may hold before the deferred free thread starts trimming
+ * it, at most ION_SYSTEM_HEAP_TRIM_BATCH at a time so that the pages trickle
+ * back to the system instead of being freed all at once
+ */
+#define ION_SYSTEM_HEAP_POOL_HIGH	SZ_16M
+#define ION_SYSTEM_HEAP_TRIM_BATCH	(SZ_2M >> PAGE_SHIFT)
+
 static int order_to_index(unsigned int order)
 {
 	int i;
@@ -56,12 +73,24 @@ static unsigned int order_to_size(int order)
 	return PAGE_SIZE << order;
 }
 
+/*
+ * @trimmed: pages the deferred free thread freed from pools above their high
+ * watermark
+ * @shrunk: pages the shrinker freed from the pools
+ */
 struct ion_system_heap {
 	struct ion_heap heap;
 	struct ion_page_pool **uncached_pools;
 	struct ion_page_pool **cached_pools;
+	atomic_long_t trimmed;
+	atomic_long_t shrunk;
 };
 
+static bool ion_system_heap_above_high(struct ion_page_pool *pool)
+{
+	return pool->high && ion_page_pool_count(pool) > pool->high;
+}
+
 struct page_info {
 	struct page *page;
 	bool from_pool;
@@ -285,8 +314,11 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 				       DMA_BIDIRECTIONAL);
 
 	buffer->priv_virt = table;
-	if (nents_sync)
+	if (nents_sync) {
 		sg_free_table(&table_sync);
+		/* The pools ran dry, top them up before the next buffer */
+		ion_heap_refill(heap);
+	}
 	msm_ion_heap_free_pages_mem(&data);
 	return 0;
 err_free_sg2:
@@ -335,6 +367,14 @@ void ion_system_heap_free(struct ion_buffer *buffer)
 				get_order(sg->length));
 	sg_free_table(table);
 	kfree(table);
+
+	for (i = 0; i < num_orders; i++) {
+		if (ion_system_heap_above_high(sys_heap->uncached_pools[i]) ||
+		    ion_system_heap_above_high(sys_heap->cached_pools[i])) {
+			ion_heap_refill(heap);
+			break;
+		}
+	}
 }
 
 struct sg_table *ion_system_heap_map_dma(struct ion_heap *heap,
@@ -354,21 +394,85 @@ static int ion_system_heap_shrink(struct ion_heap *heap, gfp_t gfp_mask,
 {
 	struct ion_system_heap *sys_heap;
 	int nr_total = 0;
-	int i;
+	int nr_freed = 0;
+	int i, pass;
 
 	sys_heap = container_of(heap, struct ion_system_heap, heap);
 
+	/*
+	 * Share nr_to_scan out among the pools instead of taking it from
+	 * each of them. Whatever sits above the high watermarks goes first,
+	 * then the pools are emptied from the largest order down.
+	 */
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < num_orders * 2; i++) {
+			struct ion_page_pool *pool = i < num_orders ?
+				sys_heap->uncached_pools[i] :
+				sys_heap->cached_pools[i - num_orders];
+
+			if (nr_freed >= nr_to_scan)
+				break;
+			if (pass == 0 && !pool->high)
+				continue;
+
+			nr_freed += ion_page_pool_trim(pool, gfp_mask,
+					nr_to_scan - nr_freed,
+					pass == 0 ? pool->high : 0);
+		}
+	}
+
+	atomic_long_add(nr_freed, &sys_heap->shrunk);
+
 	for (i = 0; i < num_orders; i++) {
 		struct ion_page_pool *pool = sys_heap->uncached_pools[i];
-		nr_total += ion_page_pool_shrink(pool, gfp_mask, nr_to_scan);
+		nr_total += ion_page_pool_shrink(pool, gfp_mask, 0);
 
 		pool = sys_heap->cached_pools[i];
-		nr_total += ion_page_pool_shrink(pool, gfp_mask, nr_to_scan);
+		nr_total += ion_page_pool_shrink(pool, gfp_mask, 0);
 	}
 
 	return nr_total;
 }
 
+/*
+ * Trim a pool that went above its high watermark by one batch, returns true
+ * if it is still above
+ */
+static bool ion_system_heap_trim(struct ion_system_heap *sys_heap,
+				 struct ion_page_pool *pool)
+{
+	if (!ion_system_heap_above_high(pool))
+		return false;
+
+	atomic_long_add(ion_page_pool_trim(pool, __GFP_HIGHMEM,
+				ION_SYSTEM_HEAP_TRIM_BATCH, pool->high),
+			&sys_heap->trimmed);
+	cond_resched();
+
+	return ion_system_heap_above_high(pool);
+}
+
+static void ion_system_heap_refill(struct ion_heap *heap)
+{
+	struct ion_system_heap *sys_heap;
+	bool again = false;
+	int i;
+
+	sys_heap = container_of(heap, struct ion_system_heap, heap);
+
+	for (i = 0; i < num_orders; i++) {
+		again |= ion_system_heap_trim(sys_heap,
+				sys_heap->uncached_pools[i]);
+		again |= ion_system_heap_trim(sys_heap,
+				sys_heap->cached_pools[i]);
+		ion_page_pool_refill(sys_heap->uncached_pools[i]);
+	}
+
+	/* Come back for the next batch once the free list is empty again */
+	if (again)
+		ion_heap_refill(heap);
+}
+
 static struct ion_heap_ops system_heap_ops = {
 	.allocate = ion_system_heap_allocate,
 	.free = ion_system_heap_free,
@@ -378,6 +482,7 @@ static struct ion_heap_ops system_heap_ops = {
 	.unmap_kernel = ion_heap_unmap_kernel,
 	.map_user = ion_heap_map_user,
 	.shrink = ion_system_heap_shrink,
+	.refill = ion_system_heap_refill,
 };
 
 static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
@@ -405,6 +510,10 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 				pool->low_count, pool->order,
 				(1 << pool->order) * PAGE_SIZE *
 					pool->low_count);
+			seq_printf(s,
+				"order %u uncached pool watermarks low %u high %u, %u items in total\n",
+				pool->order, pool->reserve, pool->high,
+				ion_page_pool_count(pool));
 		}
 
 		uncached_total += (1 << pool->order) * PAGE_SIZE *
@@ -425,6 +534,10 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 				pool->low_count, pool->order,
 				(1 << pool->order) * PAGE_SIZE *
 					pool->low_count);
+			seq_printf(s,
+				"order %u cached pool watermarks low %u high %u, %u items in total\n",
+				pool->order, pool->reserve, pool->high,
+				ion_page_pool_count(pool));
 		}
 
 		cached_total += (1 << pool->order) * PAGE_SIZE *
@@ -439,6 +552,9 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 				uncached_total, cached_total);
 		seq_printf(s, "pool total (uncached + cached) = %lu\n",
 				uncached_total + cached_total);
+		seq_printf(s, "pages trimmed = %ld shrunk = %ld\n",
+				atomic_long_read(&sys_heap->trimmed),
+				atomic_long_read(&sys_heap->shrunk));
 		seq_puts(s, "--------------------------------------------\n");
 	} else {
 		pr_info("-------------------------------------------------\n");
@@ -492,6 +608,7 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 {
 	struct ion_system_heap *heap;
 	int pools_size = sizeof(struct ion_page_pool *) * num_orders;
+	int i;
 
 	heap = kzalloc(sizeof(struct ion_system_heap), GFP_KERNEL);
 	if (!heap)
@@ -514,6 +631,21 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 	if (ion_system_heap_create_pools(heap->cached_pools))
 		goto err_create_cached_pools;
 
+	/* Order 0 pages are cheap enough to zero when they are needed */
+	for (i = 0; i < num_orders; i++) {
+		unsigned int high = ION_SYSTEM_HEAP_POOL_HIGH /
+			order_to_size(orders[i]);
+
+		if (orders[i])
+			heap->uncached_pools[i]->reserve =
+				ION_SYSTEM_HEAP_POOL_RESERVE /
+				order_to_size(orders[i]);
+		heap->uncached_pools[i]->high = max(high, 1U);
+		heap->cached_pools[i]->high = max(high, 1U);
+	}
+	atomic_long_set(&heap->trimmed, 0);
+	atomic_long_set(&heap->shrunk, 0);
+
 	heap->heap.debug_show = ion_system_heap_debug_show;
 	return &heap->heap;
 
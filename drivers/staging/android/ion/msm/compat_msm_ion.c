@@ -148,6 +148,10 @@ long compat_msm_ion_ioctl(struct ion_client *client, unsigned int cmd,
 						(unsigned long)data);
 
 	}
+	case ION_IOC_CACHE_OPS:
+		/* Same layout for 32 and 64 bit tasks */
+		return msm_ion_custom_ioctl(client, cmd,
+					(unsigned long)compat_ptr(arg));
 	default:
 		if (is_compat_task())
 			return -ENOIOCTLCMD;
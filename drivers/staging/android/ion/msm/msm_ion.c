@@ -12,6 +12,7 @@
  */
 
 #include <linux/export.h>
+#include <linux/moduleparam.h>
 #include <linux/err.h>
 #include <linux/msm_ion.h>
 #include <linux/platform_device.h>
@@ -30,6 +31,7 @@
 #include <linux/vmalloc.h>
 #include <linux/highmem.h>
 #include <linux/show_mem_notifier.h>
+#include <linux/sizes.h>
 #include <asm/cacheflush.h>
 #include "../ion_priv.h"
 #include "ion_cp_common.h"
@@ -142,6 +144,14 @@ int msm_ion_do_cache_op(struct ion_client *client, struct ion_handle *handle,
 }
 EXPORT_SYMBOL(msm_ion_do_cache_op);
 
+int msm_ion_prefetch(struct ion_client *client, int heap_id,
+			unsigned long len)
+{
+	return ion_walk_heaps(client, heap_id, ION_HEAP_TYPE_SECURE_DMA,
+			(void *)len, ion_secure_cma_prefetch);
+}
+EXPORT_SYMBOL(msm_ion_prefetch);
+
 static int ion_no_pages_cache_ops(struct ion_client *client,
 			struct ion_handle *handle,
 			void *vaddr,
@@ -326,11 +336,14 @@ static int msm_init_extra_data(struct device_node *node,
 	case ION_HEAP_TYPE_SECURE_DMA:
 	{
 		unsigned int val;
+		bool prefetch_secure;
 
 		ret = of_property_read_u32(node,
 					"qcom,default-prefetch-size", &val);
+		prefetch_secure = of_property_read_bool(node,
+					"qcom,prefetch-secure");
 
-		if (!ret) {
+		if (!ret || prefetch_secure) {
 			heap->extra_data = kzalloc(sizeof(struct ion_cma_pdata),
 					   GFP_KERNEL);
 
@@ -338,7 +351,9 @@ static int msm_init_extra_data(struct device_node *node,
 				ret = -ENOMEM;
 			} else {
 				struct ion_cma_pdata *extra = heap->extra_data;
-				extra->default_prefetch_size = val;
+				extra->default_prefetch_size = ret ? 0 : val;
+				extra->prefetch_secure = prefetch_secure;
+				ret = 0;
 			}
 		} else {
 			ret = 0;
@@ -622,6 +637,13 @@ static void free_pdata(const struct ion_platform_data *pdata)
 }
 #endif
 
+/*
+ * Size at which ION_IOC_CACHE_OPS flushes the whole cache instead of the
+ * buffers one by one, 0 to never do so
+ */
+static unsigned int cache_ops_full_threshold = SZ_16M;
+module_param(cache_ops_full_threshold, uint, 0644);
+
 static int check_vaddr_bounds(unsigned long start, unsigned long end)
 {
 	struct mm_struct *mm = current->active_mm;
@@ -659,6 +681,122 @@ int ion_heap_allow_heap_secure(enum ion_heap_type type)
 	return false;
 }
 
+static unsigned int msm_ion_cache_op_cmd(unsigned int op)
+{
+	switch (op) {
+	case ION_CACHE_OP_CLEAN:
+		return ION_IOC_CLEAN_CACHES;
+	case ION_CACHE_OP_INV:
+		return ION_IOC_INV_CACHES;
+	case ION_CACHE_OP_CLEAN_INV:
+		return ION_IOC_CLEAN_INV_CACHES;
+	default:
+		return 0;
+	}
+}
+
+static int msm_ion_cache_ops(struct ion_client *client,
+			struct ion_cache_op_list *list)
+{
+	struct mm_struct *mm = current->active_mm;
+	struct ion_cache_op_entry *entries;
+	struct ion_handle **handles;
+	unsigned long total = 0;
+	bool full_flush = cache_ops_full_threshold != 0;
+	int i, ret = 0;
+
+	if (list->count == 0)
+		return 0;
+
+	if (list->count > ION_CACHE_OPS_MAX || list->__pad)
+		return -EINVAL;
+
+	entries = kcalloc(list->count, sizeof(*entries), GFP_KERNEL);
+	handles = kcalloc(list->count, sizeof(*handles), GFP_KERNEL);
+	if (entries == NULL || handles == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (copy_from_user(entries,
+			(void __user *)(uintptr_t) list->entries,
+			list->count * sizeof(*entries))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	for (i = 0; i < list->count; i++) {
+		unsigned long flags;
+
+		if (msm_ion_cache_op_cmd(entries[i].op) == 0) {
+			ret = -EINVAL;
+			goto out;
+		}
+
+		handles[i] = ion_import_dma_buf(client, entries[i].fd);
+		if (IS_ERR(handles[i])) {
+			pr_info("%s: Could not import handle: %pK\n",
+				__func__, handles[i]);
+			handles[i] = NULL;
+			ret = -EINVAL;
+			goto out;
+		}
+
+		/* ion_do_cache_op() skips these */
+		if (ion_handle_get_flags(client, handles[i], &flags) ||
+		    !ION_IS_CACHED(flags) || (flags & ION_FLAG_SECURE))
+			continue;
+
+		total += entries[i].length;
+
+		/* Cleaning would overwrite what the device wrote */
+		if (entries[i].op == ION_CACHE_OP_INV)
+			full_flush = false;
+	}
+
+	if (total < cache_ops_full_threshold)
+		full_flush = false;
+
+	down_read(&mm->mmap_sem);
+
+	for (i = 0; i < list->count; i++) {
+		unsigned long start = (unsigned long)entries[i].vaddr +
+			entries[i].offset;
+		unsigned long end = start + entries[i].length;
+
+		if (check_vaddr_bounds(start, end)) {
+			pr_err("%s: virtual address %pK is out of bounds\n",
+			       __func__, (void *)(uintptr_t) entries[i].vaddr);
+			ret = -EINVAL;
+			break;
+		}
+
+		if (full_flush)
+			continue;
+
+		ret = ion_do_cache_op(client, handles[i],
+				(void *)(uintptr_t) entries[i].vaddr,
+				entries[i].offset, entries[i].length,
+				msm_ion_cache_op_cmd(entries[i].op));
+		if (ret < 0)
+			break;
+	}
+
+	if (full_flush && ret == 0)
+		flush_cache_all();
+
+	up_read(&mm->mmap_sem);
+
+out:
+	if (handles != NULL) {
+		for (i = 0; i < list->count && handles[i]; i++)
+			ion_free(client, handles[i]);
+	}
+	kfree(handles);
+	kfree(entries);
+	return ret;
+}
+
 /* fix up the cases where the ioctl direction bits are incorrect */
 static unsigned int msm_ion_ioctl_dir(unsigned int cmd)
 {
@@ -682,6 +820,7 @@ long msm_ion_custom_ioctl(struct ion_client *client,
 	union {
 		struct ion_flush_data flush_data;
 		struct ion_prefetch_data prefetch_data;
+		struct ion_cache_op_list cache_op_list;
 	} data;
 
 	dir = msm_ion_ioctl_dir(cmd);
@@ -770,6 +909,15 @@ long msm_ion_custom_ioctl(struct ion_client *client,
 			return ret;
 		break;
 	}
+	case ION_IOC_CACHE_OPS:
+	{
+		int ret;
+
+		ret = msm_ion_cache_ops(client, &data.cache_op_list);
+		if (ret)
+			return ret;
+		break;
+	}
 
 	default:
 		return -ENOTTY;
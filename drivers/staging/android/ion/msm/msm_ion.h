@@ -86,9 +86,11 @@ struct ion_co_heap_pdata {
 /**
  * struct ion_cma_pdata - extra data for CMA regions
  * @default_prefetch_size - default size to use for prefetching
+ * @prefetch_secure - secure the prefetched memory ahead of the allocations
  */
 struct ion_cma_pdata {
 	unsigned long default_prefetch_size;
+	bool prefetch_secure;
 };
 
 #ifdef CONFIG_ION
@@ -153,6 +155,23 @@ int msm_ion_do_cache_op(struct ion_client *client, struct ion_handle *handle,
 int msm_ion_secure_table(struct sg_table *table);
 
 int msm_ion_unsecure_table(struct sg_table *table);
+
+/**
+ * msm_ion_prefetch - prepare memory in a secure heap ahead of allocations
+ *
+ * @client - pointer to ION client.
+ * @heap_id - id of the secure heap
+ * @len - bytes to prefetch, 0 for the default size of the heap
+ *
+ * Kernel counterpart of ION_IOC_PREFETCH, for drivers that know a secure
+ * session is about to start, e.g. when a secure decoder is opened. The
+ * memory is migrated out of CMA and, if the heap is set up to, secured
+ * asynchronously.
+ *
+ * Returns 0 on success
+ */
+int msm_ion_prefetch(struct ion_client *client, int heap_id,
+			unsigned long len);
 #else
 static inline struct ion_client *msm_ion_client_create(const char *name)
 {
@@ -182,6 +201,12 @@ static inline int msm_ion_unsecure_table(struct sg_table *table)
 	return -ENODEV;
 }
 
+static inline int msm_ion_prefetch(struct ion_client *client, int heap_id,
+			unsigned long len)
+{
+	return -ENODEV;
+}
+
 
 #endif /* CONFIG_ION */
 
@@ -26,6 +26,8 @@
 #include <linux/uaccess.h>
 #include <linux/poll.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/percpu.h>
 #include <linux/time.h>
 #include <linux/vmalloc.h>
 #include <linux/aio.h>
@@ -43,22 +45,27 @@
  * @misc:	The "misc" device representing the log
  * @wq:		The wait queue for @readers
  * @readers:	This log's readers
- * @mutex:	The mutex that protects the @buffer
+ * @lock:	The spinlock that protects the @buffer, offsets and @readers
+ * @mutex:	The mutex that serializes the readers and protects @rbuf
+ * @rbuf:	Bounce buffer the entry being read is copied to
  * @w_off:	The current write head offset
  * @head:	The head, or location that readers start reading at.
  * @size:	The size of the log
  * @logs:	The list of log channels
  *
  * This structure lives from module insertion until module removal, so it does
- * not need additional reference counting. The structure is protected by the
- * mutex 'mutex'.
+ * not need additional reference counting. Writers only ever take the spinlock
+ * 'lock', for as long as it takes to copy an entry into the ring, so that they
+ * never wait for a reader copying to user space.
  */
 struct logger_log {
 	unsigned char		*buffer;
 	struct miscdevice	misc;
 	wait_queue_head_t	wq;
 	struct list_head	readers;
+	spinlock_t		lock;
 	struct mutex		mutex;
+	unsigned char		*rbuf;
 	size_t			w_off;
 	size_t			head;
 	size_t			size;
@@ -67,6 +74,16 @@ struct logger_log {
 
 static LIST_HEAD(log_list);
 
+/*
+ * Per-cpu buffer the payload of an entry is copied to from user space,
+ * with page faults disabled, before taking the log lock.
+ */
+struct logger_staging {
+	unsigned char		buf[LOGGER_ENTRY_MAX_PAYLOAD];
+};
+
+static DEFINE_PER_CPU(struct logger_staging, logger_staging);
+
 
 /**
  * struct logger_reader - a logging device open for reading
@@ -77,7 +94,7 @@ static LIST_HEAD(log_list);
  * @r_ver:	Reader ABI version
  *
  * This object lives from open to release, so we don't need additional
- * reference counting. The structure is protected by log->mutex.
+ * reference counting. The structure is protected by log->lock.
  */
 struct logger_reader {
 	struct logger_log	*log;
@@ -146,7 +163,7 @@ static struct logger_entry *get_entry_header(struct logger_log *log,
  * In the log, the length does not include the size of the log entry structure.
  * This function returns the size including the log entry structure.
  *
- * Caller needs to hold log->mutex.
+ * Caller needs to hold log->lock.
  */
 static __u32 get_entry_msg_len(struct logger_log *log, size_t off)
 {
@@ -190,8 +207,27 @@ static ssize_t copy_header_to_user(int ver, struct logger_entry *entry,
 }
 
 /*
- * do_read_log_to_user - reads exactly 'count' bytes from 'log' into the
- * user-space buffer 'buf'. Returns 'count' on success.
+ * copy_entry - copies the entry at offset 'off' out of the ring into
+ * 'log->rbuf', and returns its size including the log entry structure.
+ *
+ * Caller must hold log->mutex and log->lock.
+ */
+static size_t copy_entry(struct logger_log *log, size_t off)
+{
+	size_t count = sizeof(struct logger_entry) +
+		get_entry_msg_len(log, off);
+	size_t len = min(count, log->size - off);
+
+	memcpy(log->rbuf, log->buffer + off, len);
+	if (count != len)
+		memcpy(log->rbuf + len, log->buffer, count - len);
+
+	return count;
+}
+
+/*
+ * do_read_log_to_user - reads exactly 'count' bytes of the entry copied to
+ * 'log->rbuf' into the user-space buffer 'buf'. Returns 'count' on success.
  *
  * Caller must hold log->mutex.
  */
@@ -200,45 +236,21 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 				   char __user *buf,
 				   size_t count)
 {
-	struct logger_entry scratch;
-	struct logger_entry *entry;
-	size_t len;
-	size_t msg_start;
+	struct logger_entry *entry = (struct logger_entry *) log->rbuf;
+	size_t hdr_len = get_user_hdr_len(reader->r_ver);
 
 	/*
 	 * First, copy the header to userspace, using the version of
 	 * the header requested
 	 */
-	entry = get_entry_header(log, reader->r_off, &scratch);
 	if (copy_header_to_user(reader->r_ver, entry, buf))
 		return -EFAULT;
 
-	count -= get_user_hdr_len(reader->r_ver);
-	buf += get_user_hdr_len(reader->r_ver);
-	msg_start = logger_offset(log,
-		reader->r_off + sizeof(struct logger_entry));
-
-	/*
-	 * We read from the msg in two disjoint operations. First, we read from
-	 * the current msg head offset up to 'count' bytes or to the end of
-	 * the log, whichever comes first.
-	 */
-	len = min(count, log->size - msg_start);
-	if (copy_to_user(buf, log->buffer + msg_start, len))
+	/* then the msg, which follows the header in 'log->rbuf' */
+	if (copy_to_user(buf + hdr_len, entry->msg, count - hdr_len))
 		return -EFAULT;
 
-	/*
-	 * Second, we read any remaining bytes, starting back at the head of
-	 * the log.
-	 */
-	if (count != len)
-		if (copy_to_user(buf + len, log->buffer, count - len))
-			return -EFAULT;
-
-	reader->r_off = logger_offset(log, reader->r_off +
-		sizeof(struct logger_entry) + count);
-
-	return count + get_user_hdr_len(reader->r_ver);
+	return count;
 }
 
 /*
@@ -282,17 +294,18 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 {
 	struct logger_reader *reader = file->private_data;
 	struct logger_log *log = reader->log;
+	size_t off, len;
 	ssize_t ret;
 	DEFINE_WAIT(wait);
 
 start:
 	while (1) {
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
 		ret = (log->w_off == reader->r_off);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 		if (!ret)
 			break;
 
@@ -314,6 +327,7 @@ start:
 		return ret;
 
 	mutex_lock(&log->mutex);
+	spin_lock(&log->lock);
 
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
@@ -321,6 +335,7 @@ start:
 
 	/* is there still something to read or did we race? */
 	if (unlikely(log->w_off == reader->r_off)) {
+		spin_unlock(&log->lock);
 		mutex_unlock(&log->mutex);
 		goto start;
 	}
@@ -329,12 +344,25 @@ start:
 	ret = get_user_hdr_len(reader->r_ver) +
 		get_entry_msg_len(log, reader->r_off);
 	if (count < ret) {
+		spin_unlock(&log->lock);
 		ret = -EINVAL;
 		goto out;
 	}
 
-	/* get exactly one entry from the log */
+	/* get exactly one entry from the log, out of the writers' way */
+	off = reader->r_off;
+	len = copy_entry(log, off);
+	spin_unlock(&log->lock);
+
 	ret = do_read_log_to_user(log, reader, buf, ret);
+	if (ret < 0)
+		goto out;
+
+	/* move on, unless a writer lapped us meanwhile */
+	spin_lock(&log->lock);
+	if (reader->r_off == off)
+		reader->r_off = logger_offset(log, off + len);
+	spin_unlock(&log->lock);
 
 out:
 	mutex_unlock(&log->mutex);
@@ -346,7 +374,7 @@ out:
  * get_next_entry - return the offset of the first valid entry at least 'len'
  * bytes after 'off'.
  *
- * Caller must hold log->mutex.
+ * Caller must hold log->lock.
  */
 static size_t get_next_entry(struct logger_log *log, size_t off, size_t len)
 {
@@ -397,7 +425,7 @@ static inline int is_between(size_t a, size_t b, size_t c)
  * We do this by "pulling forward" the readers and start head to the first
  * entry after the new write head.
  *
- * The caller needs to hold log->mutex.
+ * The caller needs to hold log->lock.
  */
 static void fix_up_readers(struct logger_log *log, size_t len)
 {
@@ -416,7 +444,7 @@ static void fix_up_readers(struct logger_log *log, size_t len)
 /*
  * do_write_log - writes 'len' bytes from 'buf' to 'log'
  *
- * The caller needs to hold log->mutex.
+ * The caller needs to hold log->lock.
  */
 static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 {
@@ -433,35 +461,35 @@ static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 }
 
 /*
- * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
- *
- * The caller needs to hold log->mutex.
+ * copy_payload_from_user - gathers the first 'count' bytes of the user-space
+ * vector 'iov' into 'buf'.  With 'atomic' set, page faults must be disabled
+ * by the caller, and a payload that is not resident fails with -EFAULT.
  *
  * Returns 'count' on success, negative error code on failure.
  */
-static ssize_t do_write_log_from_user(struct logger_log *log,
-				      const void __user *buf, size_t count)
+static ssize_t copy_payload_from_user(void *buf, const struct iovec *iov,
+				      unsigned long nr_segs, size_t count,
+				      bool atomic)
 {
-	size_t len;
+	size_t done = 0;
 
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
-		return -EFAULT;
+	while (nr_segs-- > 0 && done < count) {
+		size_t len = min_t(size_t, iov->iov_len, count - done);
 
-	if (count != len)
-		if (copy_from_user(log->buffer, buf + len, count - len))
-			/*
-			 * Note that by not updating w_off, this abandons the
-			 * portion of the new entry that *was* successfully
-			 * copied, just above.  This is intentional to avoid
-			 * message corruption from missing fragments.
-			 */
+		if (atomic) {
+			if (!access_ok(VERIFY_READ, iov->iov_base, len) ||
+			    __copy_from_user_inatomic(buf + done,
+						      iov->iov_base, len))
+				return -EFAULT;
+		} else if (copy_from_user(buf + done, iov->iov_base, len)) {
 			return -EFAULT;
+		}
 
-	log->w_off = logger_offset(log, log->w_off + count);
+		done += len;
+		iov++;
+	}
 
-	return count;
+	return done;
 }
 
 /*
@@ -473,10 +501,11 @@ static ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig;
 	struct logger_entry header;
 	struct timespec now;
-	ssize_t ret = 0;
+	unsigned char *payload;
+	void *slow_buf = NULL;
+	ssize_t ret;
 
 	now = current_kernel_time();
 
@@ -492,40 +521,48 @@ static ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
-	mutex_lock(&log->mutex);
+	/*
+	 * Stage the payload in this cpu's buffer, so that nothing can fault
+	 * or sleep under the log lock.  If the payload is not resident, fall
+	 * back to a buffer of our own.
+	 */
+	payload = get_cpu_var(logger_staging).buf;
+	pagefault_disable();
+	ret = copy_payload_from_user(payload, iov, nr_segs, header.len, true);
+	pagefault_enable();
+	if (unlikely(ret < 0)) {
+		put_cpu_var(logger_staging);
+
+		slow_buf = kmalloc(header.len, GFP_KERNEL);
+		if (!slow_buf)
+			return -ENOMEM;
 
-	orig = log->w_off;
+		ret = copy_payload_from_user(slow_buf, iov, nr_segs,
+					     header.len, false);
+		if (ret < 0) {
+			kfree(slow_buf);
+			return ret;
+		}
+		payload = slow_buf;
+	}
+
+	spin_lock(&log->lock);
 
 	/*
 	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
+	 * entry after (what will be) the new write offset.
 	 */
 	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
 
 	do_write_log(log, &header, sizeof(struct logger_entry));
+	do_write_log(log, payload, header.len);
 
-	while (nr_segs-- > 0) {
-		size_t len;
-		ssize_t nr;
+	spin_unlock(&log->lock);
 
-		/* figure out how much of this vector we can keep */
-		len = min_t(size_t, iov->iov_len, header.len - ret);
-
-		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
-		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
-			return nr;
-		}
-
-		iov++;
-		ret += nr;
-	}
-
-	mutex_unlock(&log->mutex);
+	if (slow_buf)
+		kfree(slow_buf);
+	else
+		put_cpu_var(logger_staging);
 
 	/* wake up any blocked readers */
 	wake_up_interruptible(&log->wq);
@@ -575,10 +612,10 @@ static int logger_open(struct inode *inode, struct file *file)
 
 		INIT_LIST_HEAD(&reader->list);
 
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 		reader->r_off = log->head;
 		list_add_tail(&reader->list, &log->readers);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 
 		file->private_data = reader;
 	} else
@@ -598,9 +635,9 @@ static int logger_release(struct inode *ignored, struct file *file)
 		struct logger_reader *reader = file->private_data;
 		struct logger_log *log = reader->log;
 
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 		list_del(&reader->list);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 
 		kfree(reader);
 	}
@@ -631,14 +668,14 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 
 	poll_wait(file, &log->wq, wait);
 
-	mutex_lock(&log->mutex);
+	spin_lock(&log->lock);
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
 			reader->r_off, current_euid());
 
 	if (log->w_off != reader->r_off)
 		ret |= POLLIN | POLLRDNORM;
-	mutex_unlock(&log->mutex);
+	spin_unlock(&log->lock);
 
 	return ret;
 }
@@ -675,10 +712,12 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		}
 		reader = file->private_data;
+		spin_lock(&log->lock);
 		if (log->w_off >= reader->r_off)
 			ret = log->w_off - reader->r_off;
 		else
 			ret = (log->size - reader->r_off) + log->w_off;
+		spin_unlock(&log->lock);
 		break;
 	case LOGGER_GET_NEXT_ENTRY_LEN:
 		if (!(file->f_mode & FMODE_READ)) {
@@ -687,6 +726,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		}
 		reader = file->private_data;
 
+		spin_lock(&log->lock);
 		if (!reader->r_all)
 			reader->r_off = get_next_entry_by_uid(log,
 				reader->r_off, current_euid());
@@ -696,6 +736,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 				get_entry_msg_len(log, reader->r_off);
 		else
 			ret = 0;
+		spin_unlock(&log->lock);
 		break;
 	case LOGGER_FLUSH_LOG:
 		if (!(file->f_mode & FMODE_WRITE)) {
@@ -707,9 +748,11 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			ret = -EPERM;
 			break;
 		}
+		spin_lock(&log->lock);
 		list_for_each_entry(reader, &log->readers, list)
 			reader->r_off = log->w_off;
 		log->head = log->w_off;
+		spin_unlock(&log->lock);
 		ret = 0;
 		break;
 	case LOGGER_GET_VERSION:
@@ -767,11 +810,18 @@ static int __init create_log(char *log_name, int size)
 	}
 	log->buffer = buffer;
 
+	log->rbuf = kmalloc(sizeof(struct logger_entry) +
+			    LOGGER_ENTRY_MAX_PAYLOAD, GFP_KERNEL);
+	if (log->rbuf == NULL) {
+		ret = -ENOMEM;
+		goto out_free_log;
+	}
+
 	log->misc.minor = MISC_DYNAMIC_MINOR;
 	log->misc.name = kstrdup(log_name, GFP_KERNEL);
 	if (log->misc.name == NULL) {
 		ret = -ENOMEM;
-		goto out_free_log;
+		goto out_free_rbuf;
 	}
 
 	log->misc.fops = &logger_fops;
@@ -779,6 +829,7 @@ static int __init create_log(char *log_name, int size)
 
 	init_waitqueue_head(&log->wq);
 	INIT_LIST_HEAD(&log->readers);
+	spin_lock_init(&log->lock);
 	mutex_init(&log->mutex);
 	log->w_off = 0;
 	log->head = 0;
@@ -792,7 +843,7 @@ static int __init create_log(char *log_name, int size)
 	if (unlikely(ret)) {
 		pr_err("failed to register misc device for log '%s'!\n",
 				log->misc.name);
-		goto out_free_log;
+		goto out_free_rbuf;
 	}
 
 	pr_info("created %luK log '%s'\n",
@@ -800,6 +851,9 @@ static int __init create_log(char *log_name, int size)
 
 	return 0;
 
+out_free_rbuf:
+	kfree(log->rbuf);
+
 out_free_log:
 	kfree(log);
 
@@ -840,6 +894,7 @@ static void __exit logger_exit(void)
 		/* we have to delete all the entry inside log_list */
 		misc_deregister(&current_log->misc);
 		vfree(current_log->buffer);
+		kfree(current_log->rbuf);
 		kfree(current_log->misc.name);
 		list_del(&current_log->logs);
 		kfree(current_log);
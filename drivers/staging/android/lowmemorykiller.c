@@ -46,6 +46,14 @@
 #include <linux/cpuset.h>
 #include <linux/show_mem_notifier.h>
 #include <linux/vmpressure.h>
+#include <linux/msm_kgsl.h>
+#include <linux/hashtable.h>
+#include <linux/profile.h>
+#include <linux/slab.h>
+#include <linux/kthread.h>
+#include <linux/wait.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/almk.h>
@@ -102,6 +110,72 @@ static int vmpressure_file_min;
 module_param_named(vmpressure_file_min, vmpressure_file_min, int,
 	S_IRUGO | S_IWUSR);
 
+/*
+ * Kill from a thread of our own, woken when vmpressure reaches
+ * lmk_kthread_pressure, once free and file pages drop below the minfree
+ * levels raised by lmk_kthread_headroom percent. This gets processes
+ * killed before direct reclaim of the foreground app hits the minfree
+ * levels themselves.
+ */
+static int enable_lmk_kthread;
+module_param_named(enable_lmk_kthread, enable_lmk_kthread, int,
+	S_IRUGO | S_IWUSR);
+
+static int lmk_kthread_pressure = 80;
+module_param_named(lmk_kthread_pressure, lmk_kthread_pressure, int,
+	S_IRUGO | S_IWUSR);
+
+static int lmk_kthread_headroom = 25;
+module_param_named(lmk_kthread_headroom, lmk_kthread_headroom, int,
+	S_IRUGO | S_IWUSR);
+
+static DECLARE_WAIT_QUEUE_HEAD(lmk_kthread_wait);
+static atomic_t lmk_kthread_wakeup = ATOMIC_INIT(0);
+
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_RECLAIM
+/*
+ * Swap out the anonymous pages of the processes at or above
+ * bg_reclaim_min_adj, up to bg_reclaim_batch pages at a time and at most
+ * one batch every bg_reclaim_interval_ms, once vmpressure reaches
+ * bg_reclaim_pressure. Batches are skipped while there are more runnable
+ * tasks than online CPUs.
+ */
+static int enable_bg_reclaim;
+module_param_named(enable_bg_reclaim, enable_bg_reclaim, int,
+	S_IRUGO | S_IWUSR);
+
+static int bg_reclaim_pressure = 50;
+module_param_named(bg_reclaim_pressure, bg_reclaim_pressure, int,
+	S_IRUGO | S_IWUSR);
+
+static short bg_reclaim_min_adj = 529;
+module_param_named(bg_reclaim_min_adj, bg_reclaim_min_adj, short,
+	S_IRUGO | S_IWUSR);
+
+static int bg_reclaim_batch = 2048;
+module_param_named(bg_reclaim_batch, bg_reclaim_batch, int,
+	S_IRUGO | S_IWUSR);
+
+static unsigned int bg_reclaim_interval_ms = 100;
+module_param_named(bg_reclaim_interval_ms, bg_reclaim_interval_ms, uint,
+	S_IRUGO | S_IWUSR);
+
+static DECLARE_WAIT_QUEUE_HEAD(bg_reclaim_wait);
+static atomic_t bg_reclaim_wakeup = ATOMIC_INIT(0);
+
+static void lowmem_bg_reclaim_wake(unsigned long pressure)
+{
+	if (enable_bg_reclaim && pressure >= bg_reclaim_pressure) {
+		atomic_set(&bg_reclaim_wakeup, 1);
+		wake_up(&bg_reclaim_wait);
+	}
+}
+#else
+static inline void lowmem_bg_reclaim_wake(unsigned long pressure)
+{
+}
+#endif
+
 enum {
 	VMPRESSURE_NO_ADJUST = 0,
 	VMPRESSURE_ADJUST_ENCROACH,
@@ -135,6 +209,12 @@ static int lmk_vmpressure_notifier(struct notifier_block *nb,
 	unsigned long pressure = action;
 	int array_size = ARRAY_SIZE(lowmem_adj);
 
+	if (enable_lmk_kthread && pressure >= lmk_kthread_pressure) {
+		atomic_set(&lmk_kthread_wakeup, 1);
+		wake_up(&lmk_kthread_wait);
+	}
+	lowmem_bg_reclaim_wake(pressure);
+
 	if (!enable_adaptive_lmk)
 		return 0;
 
@@ -200,6 +280,431 @@ static int test_task_flag(struct task_struct *p, int flag)
 
 static DEFINE_MUTEX(scan_mutex);
 
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_ADJ_INDEX
+/*
+ * Index of the processes user space gave an oom_score_adj to, bucketed by
+ * that value. The victim is the largest process of the highest bucket, so
+ * only the processes of that bucket have their size looked at. Children
+ * inherit the oom_score_adj of their parent without it being written, so
+ * the task list is still scanned when the index has no candidate.
+ */
+struct lmk_index_entry {
+	struct hlist_node hash;		/* in lmk_index_hash, by tgid */
+	struct hlist_node bucket;	/* in lmk_index_buckets */
+	struct task_struct *task;	/* group leader, referenced */
+	pid_t tgid;
+	short adj;
+	unsigned long adj_time;		/* jiffies of the last adj change */
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_RECLAIM
+	unsigned long reclaimed;	/* pages swapped out in background */
+	bool reclaim_done;		/* nothing left since the adj change */
+#endif
+};
+
+#define LMK_INDEX_BUCKETS	(OOM_SCORE_ADJ_MAX - OOM_SCORE_ADJ_MIN + 1)
+
+/* Never held around an allocation, reclaim ends up in lowmem_shrink() */
+static DEFINE_MUTEX(lmk_index_lock);
+static DEFINE_HASHTABLE(lmk_index_hash, 8);
+static struct hlist_head lmk_index_buckets[LMK_INDEX_BUCKETS];
+static DECLARE_BITMAP(lmk_index_used, LMK_INDEX_BUCKETS);
+
+/* Last victim picked from the index, referenced, under scan_mutex */
+static struct task_struct *lowmem_deathpending;
+
+static struct lmk_index_entry *lmk_index_find(pid_t tgid)
+{
+	struct lmk_index_entry *entry;
+
+	hash_for_each_possible(lmk_index_hash, entry, hash, tgid)
+		if (entry->tgid == tgid)
+			return entry;
+
+	return NULL;
+}
+
+static void lmk_index_link(struct lmk_index_entry *entry, short adj)
+{
+	int b = adj - OOM_SCORE_ADJ_MIN;
+
+	if (entry->adj != adj) {
+		entry->adj_time = jiffies;
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_RECLAIM
+		entry->reclaim_done = false;
+#endif
+	}
+	entry->adj = adj;
+	hlist_add_head(&entry->bucket, &lmk_index_buckets[b]);
+	__set_bit(b, lmk_index_used);
+}
+
+static void lmk_index_unlink(struct lmk_index_entry *entry)
+{
+	int b = entry->adj - OOM_SCORE_ADJ_MIN;
+
+	hlist_del(&entry->bucket);
+	if (hlist_empty(&lmk_index_buckets[b]))
+		__clear_bit(b, lmk_index_used);
+}
+
+static void lmk_index_remove(struct lmk_index_entry *entry)
+{
+	lmk_index_unlink(entry);
+	hash_del(&entry->hash);
+	put_task_struct(entry->task);
+	kfree(entry);
+}
+
+/**
+ * lowmem_oom_score_adj_update() - Move a process to its new bucket
+ * @task: A thread of the process, referenced by the caller
+ *
+ * Called after oom_score_adj was written through /proc. May sleep.
+ */
+void lowmem_oom_score_adj_update(struct task_struct *task)
+{
+	struct lmk_index_entry *entry, *new;
+	struct task_struct *leader;
+	short adj;
+
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+
+	rcu_read_lock();
+	leader = task->group_leader;
+	get_task_struct(leader);
+	rcu_read_unlock();
+
+	mutex_lock(&lmk_index_lock);
+	/* Read under the lock so that the last writer leaves its value */
+	adj = ACCESS_ONCE(task->signal->oom_score_adj);
+	entry = lmk_index_find(task->tgid);
+	if (entry != NULL) {
+		/* The leader changes when another thread calls exec */
+		swap(entry->task, leader);
+		lmk_index_unlink(entry);
+		lmk_index_link(entry, adj);
+	} else if (new != NULL) {
+		new->task = leader;
+		new->tgid = task->tgid;
+		new->adj = OOM_SCORE_ADJ_MAX + 1;
+		hash_add(lmk_index_hash, &new->hash, new->tgid);
+		lmk_index_link(new, adj);
+		new = NULL;
+		leader = NULL;
+	}
+	mutex_unlock(&lmk_index_lock);
+
+	if (leader != NULL)
+		put_task_struct(leader);
+	kfree(new);
+}
+
+static int lmk_index_task_exit(struct notifier_block *nb,
+			unsigned long action, void *data)
+{
+	struct task_struct *task = data;
+	struct lmk_index_entry *entry;
+
+	/* Called before the thread drops out of signal->live */
+	if (atomic_read(&task->signal->live) > 1)
+		return NOTIFY_OK;
+
+	mutex_lock(&lmk_index_lock);
+	entry = lmk_index_find(task->tgid);
+	if (entry != NULL)
+		lmk_index_remove(entry);
+	mutex_unlock(&lmk_index_lock);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block lmk_index_exit_nb = {
+	.notifier_call = lmk_index_task_exit,
+};
+
+/* Called under rcu_read_lock() */
+static bool lowmem_victim_dying(void)
+{
+	struct task_struct *victim = lowmem_deathpending;
+
+	if (victim == NULL)
+		return false;
+
+	if (time_before_eq(jiffies, lowmem_deathpending_timeout) &&
+	    pid_alive(victim) && !test_task_flag(victim, TIF_MM_RELEASED) &&
+	    test_task_flag(victim, TIF_MEMDIE))
+		return true;
+
+	put_task_struct(victim);
+	lowmem_deathpending = NULL;
+	return false;
+}
+
+/*
+ * Look for the largest process of the highest bucket at or above
+ * min_score_adj. Returns the victim referenced, NULL if the index has no
+ * candidate or ERR_PTR(-EAGAIN) while the previous victim is still dying.
+ */
+static struct task_struct *lowmem_select_indexed(short min_score_adj,
+		int *selected_tasksize, short *selected_oom_score_adj)
+{
+	struct lmk_index_entry *entry;
+	struct hlist_node *tmp;
+	struct task_struct *selected = NULL;
+	int min_b = min_score_adj - OOM_SCORE_ADJ_MIN;
+	int size = LMK_INDEX_BUCKETS;
+	int tasksize, max_tasksize = 0;
+	int b = 0;
+
+	mutex_lock(&lmk_index_lock);
+	rcu_read_lock();
+
+	if (lowmem_victim_dying()) {
+		selected = ERR_PTR(-EAGAIN);
+		goto out;
+	}
+
+	while (selected == NULL) {
+		b = find_last_bit(lmk_index_used, size);
+		if (b >= size || b < min_b)
+			break;
+		size = b;
+
+		hlist_for_each_entry_safe(entry, tmp, &lmk_index_buckets[b],
+					bucket) {
+			struct task_struct *p;
+
+			if (!pid_alive(entry->task)) {
+				lmk_index_remove(entry);
+				continue;
+			}
+
+			/* if task no longer has any memory ignore it */
+			if (test_task_flag(entry->task, TIF_MM_RELEASED))
+				continue;
+
+			p = find_lock_task_mm(entry->task);
+			if (!p)
+				continue;
+
+			if (p->signal->oom_score_adj < min_score_adj) {
+				task_unlock(p);
+				continue;
+			}
+			tasksize = get_mm_rss(p->mm);
+			task_unlock(p);
+			tasksize += kgsl_process_reclaimable_pages(p->tgid);
+			if (tasksize <= max_tasksize)
+				continue;
+
+			selected = p;
+			max_tasksize = tasksize;
+			lowmem_print(3, "select '%s' (%d), adj %d, size %d, to kill\n",
+				     p->comm, p->pid, b + OOM_SCORE_ADJ_MIN,
+				     tasksize);
+		}
+	}
+
+	if (selected != NULL) {
+		get_task_struct(selected);
+		*selected_tasksize = max_tasksize;
+		*selected_oom_score_adj = b + OOM_SCORE_ADJ_MIN;
+	}
+out:
+	rcu_read_unlock();
+	mutex_unlock(&lmk_index_lock);
+
+	return selected;
+}
+
+static void lowmem_index_killed(struct task_struct *selected)
+{
+	if (lowmem_deathpending != NULL)
+		put_task_struct(lowmem_deathpending);
+	get_task_struct(selected);
+	lowmem_deathpending = selected;
+}
+
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_RECLAIM
+static struct task_struct *bg_reclaim_kthread;
+
+/*
+ * The process at or above bg_reclaim_min_adj that went into its bucket
+ * first and still has pages to give since then, returned referenced
+ */
+static struct task_struct *lowmem_bg_reclaim_pick(void)
+{
+	struct lmk_index_entry *entry, *oldest = NULL;
+	struct task_struct *task = NULL;
+	int min_b = bg_reclaim_min_adj - OOM_SCORE_ADJ_MIN;
+	int size = LMK_INDEX_BUCKETS;
+	int b;
+
+	mutex_lock(&lmk_index_lock);
+	for (;;) {
+		b = find_last_bit(lmk_index_used, size);
+		if (b >= size || b < min_b)
+			break;
+		size = b;
+
+		hlist_for_each_entry(entry, &lmk_index_buckets[b], bucket) {
+			if (entry->reclaim_done || !pid_alive(entry->task))
+				continue;
+			if (!oldest || time_before(entry->adj_time,
+						oldest->adj_time))
+				oldest = entry;
+		}
+	}
+	if (oldest) {
+		task = oldest->task;
+		get_task_struct(task);
+	}
+	mutex_unlock(&lmk_index_lock);
+
+	return task;
+}
+
+static void lowmem_bg_reclaim_one(void)
+{
+	struct lmk_index_entry *entry;
+	struct task_struct *task;
+	struct reclaim_param rp;
+
+	task = lowmem_bg_reclaim_pick();
+	if (!task)
+		return;
+
+	/* Swapping allocates, the index lock cannot be held meanwhile */
+	rp = reclaim_task_anon(task, bg_reclaim_batch);
+
+	mutex_lock(&lmk_index_lock);
+	entry = lmk_index_find(task->tgid);
+	if (entry && entry->task == task) {
+		entry->reclaimed += rp.nr_reclaimed;
+		/* The walk ran out of pages before the batch was done */
+		if (rp.nr_reclaimed < bg_reclaim_batch)
+			entry->reclaim_done = true;
+	}
+	mutex_unlock(&lmk_index_lock);
+
+	lowmem_print(3, "bg reclaim '%s' (%d), scanned %d, reclaimed %d\n",
+		     task->comm, task->pid, rp.nr_scanned, rp.nr_reclaimed);
+	put_task_struct(task);
+}
+
+static int lowmem_bg_reclaim_thread(void *unused)
+{
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(bg_reclaim_wait,
+				atomic_read(&bg_reclaim_wakeup) ||
+				kthread_should_stop());
+		atomic_set(&bg_reclaim_wakeup, 0);
+
+		/* Leave the CPUs to the foreground while they are busy */
+		if (enable_bg_reclaim && nr_running() <= num_online_cpus())
+			lowmem_bg_reclaim_one();
+
+		schedule_timeout_interruptible(
+				msecs_to_jiffies(bg_reclaim_interval_ms));
+	}
+
+	return 0;
+}
+
+static int lowmem_bg_reclaim_show(struct seq_file *m, void *v)
+{
+	struct lmk_index_entry *entry;
+	int bkt;
+
+	seq_printf(m, "%8s %6s %12s %s\n", "pid", "adj", "reclaimed_kB",
+		   "comm");
+
+	mutex_lock(&lmk_index_lock);
+	hash_for_each(lmk_index_hash, bkt, entry, hash) {
+		if (!entry->reclaimed)
+			continue;
+
+		seq_printf(m, "%8d %6hd %12lu %s\n", entry->tgid, entry->adj,
+			   entry->reclaimed * (PAGE_SIZE / 1024),
+			   entry->task->comm);
+	}
+	mutex_unlock(&lmk_index_lock);
+
+	return 0;
+}
+
+static int lowmem_bg_reclaim_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lowmem_bg_reclaim_show, NULL);
+}
+
+static const struct file_operations lowmem_bg_reclaim_fops = {
+	.open = lowmem_bg_reclaim_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void __init lowmem_bg_reclaim_init(void)
+{
+	proc_create("lmk_reclaim", S_IRUGO, NULL, &lowmem_bg_reclaim_fops);
+
+	bg_reclaim_kthread = kthread_run(lowmem_bg_reclaim_thread, NULL,
+					"lmk_reclaim");
+	if (IS_ERR(bg_reclaim_kthread)) {
+		pr_err("failed to start reclaim thread: %ld\n",
+		       PTR_ERR(bg_reclaim_kthread));
+		bg_reclaim_kthread = NULL;
+	}
+}
+
+static void __exit lowmem_bg_reclaim_exit(void)
+{
+	if (bg_reclaim_kthread)
+		kthread_stop(bg_reclaim_kthread);
+	remove_proc_entry("lmk_reclaim", NULL);
+}
+#else
+static inline void lowmem_bg_reclaim_init(void)
+{
+}
+
+static inline void lowmem_bg_reclaim_exit(void)
+{
+}
+#endif
+
+static void __init lowmem_index_init(void)
+{
+	profile_event_register(PROFILE_TASK_EXIT, &lmk_index_exit_nb);
+	lowmem_bg_reclaim_init();
+}
+
+static void __exit lowmem_index_exit(void)
+{
+	lowmem_bg_reclaim_exit();
+	profile_event_unregister(PROFILE_TASK_EXIT, &lmk_index_exit_nb);
+}
+#else
+static inline struct task_struct *lowmem_select_indexed(short min_score_adj,
+		int *selected_tasksize, short *selected_oom_score_adj)
+{
+	return NULL;
+}
+
+static inline void lowmem_index_killed(struct task_struct *selected)
+{
+}
+
+static inline void lowmem_index_init(void)
+{
+}
+
+static inline void lowmem_index_exit(void)
+{
+}
+#endif
+
 int can_use_cma_pages(gfp_t gfp_mask)
 {
 	int can_use = 0;
@@ -368,12 +873,84 @@ void tune_lmk_param(int *other_free, int *other_file, struct shrink_control *sc)
 	}
 }
 
-static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+/*
+ * Walk the task list for the largest task of the highest oom_score_adj at
+ * or above min_score_adj. Returns the victim referenced, NULL if there is
+ * none or ERR_PTR(-EAGAIN) while an earlier victim is still dying.
+ */
+static struct task_struct *lowmem_select_scan(short min_score_adj,
+		int *selected_tasksize, short *selected_oom_score_adj)
 {
 	struct task_struct *tsk;
 	struct task_struct *selected = NULL;
-	int rem = 0;
 	int tasksize;
+
+	rcu_read_lock();
+	for_each_process(tsk) {
+		struct task_struct *p;
+		short oom_score_adj;
+
+		if (tsk->flags & PF_KTHREAD)
+			continue;
+
+		/* if task no longer has any memory ignore it */
+		if (test_task_flag(tsk, TIF_MM_RELEASED))
+			continue;
+
+		if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+			if (test_task_flag(tsk, TIF_MEMDIE)) {
+				rcu_read_unlock();
+				return ERR_PTR(-EAGAIN);
+			}
+		}
+
+		p = find_lock_task_mm(tsk);
+		if (!p)
+			continue;
+
+		oom_score_adj = p->signal->oom_score_adj;
+		if (oom_score_adj < min_score_adj) {
+			task_unlock(p);
+			continue;
+		}
+		tasksize = get_mm_rss(p->mm);
+		task_unlock(p);
+		/* GPU buffers are not in the rss but go away with the task */
+		tasksize += kgsl_process_reclaimable_pages(p->tgid);
+		if (tasksize <= 0)
+			continue;
+		if (selected) {
+			if (oom_score_adj < *selected_oom_score_adj)
+				continue;
+			if (oom_score_adj == *selected_oom_score_adj &&
+			    tasksize <= *selected_tasksize)
+				continue;
+		}
+		selected = p;
+		*selected_tasksize = tasksize;
+		*selected_oom_score_adj = oom_score_adj;
+		lowmem_print(3, "select '%s' (%d), adj %hd, size %d, to kill\n",
+			     p->comm, p->pid, oom_score_adj, tasksize);
+	}
+	if (selected)
+		get_task_struct(selected);
+	rcu_read_unlock();
+
+	return selected;
+}
+
+static void lowmem_kill_task(struct task_struct *selected)
+{
+	lowmem_deathpending_timeout = jiffies + HZ;
+	send_sig(SIGKILL, selected, 0);
+	set_tsk_thread_flag(selected, TIF_MEMDIE);
+	lowmem_index_killed(selected);
+}
+
+static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+{
+	struct task_struct *selected = NULL;
+	int rem = 0;
 	int i;
 	int ret = 0;
 	short min_score_adj = OOM_SCORE_ADJ_MAX + 1;
@@ -439,54 +1016,19 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	}
 	selected_oom_score_adj = min_score_adj;
 
-	rcu_read_lock();
-	for_each_process(tsk) {
-		struct task_struct *p;
-		short oom_score_adj;
-
-		if (tsk->flags & PF_KTHREAD)
-			continue;
-
-		/* if task no longer has any memory ignore it */
-		if (test_task_flag(tsk, TIF_MM_RELEASED))
-			continue;
-
-		if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-			if (test_task_flag(tsk, TIF_MEMDIE)) {
-				rcu_read_unlock();
-				/* give the system time to free up the memory */
-				msleep_interruptible(20);
-				mutex_unlock(&scan_mutex);
-				return 0;
-			}
-		}
-
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
-
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(p->mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
-				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(3, "select '%s' (%d), adj %hd, size %d, to kill\n",
-			     p->comm, p->pid, oom_score_adj, tasksize);
+	selected = lowmem_select_indexed(min_score_adj, &selected_tasksize,
+					&selected_oom_score_adj);
+	if (!selected)
+		selected = lowmem_select_scan(min_score_adj,
+					&selected_tasksize,
+					&selected_oom_score_adj);
+	if (IS_ERR(selected)) {
+		/* give the system time to free up the memory */
+		msleep_interruptible(20);
+		mutex_unlock(&scan_mutex);
+		return 0;
 	}
+
 	if (selected) {
 		lowmem_print(1, "Killing '%s' (%d), adj %hd,\n" \
 				"   to free %ldkB on behalf of '%s' (%d) because\n" \
@@ -531,18 +1073,15 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			show_mem_call_notifiers();
 		}
 
-		lowmem_deathpending_timeout = jiffies + HZ;
-		send_sig(SIGKILL, selected, 0);
-		set_tsk_thread_flag(selected, TIF_MEMDIE);
+		lowmem_kill_task(selected);
 		rem -= selected_tasksize;
-		rcu_read_unlock();
+		put_task_struct(selected);
 		/* give the system time to free up the memory */
 		msleep_interruptible(20);
 		trace_almk_shrink(selected_tasksize, ret,
 			other_free, other_file, selected_oom_score_adj);
 	} else {
 		trace_almk_shrink(1, ret, other_free, other_file, 0);
-		rcu_read_unlock();
 	}
 
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
@@ -551,6 +1090,118 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	return rem;
 }
 
+/*
+ * Wait for the victim to give its memory back, or for the usual death
+ * pending timeout, before another victim is looked for
+ */
+static void lowmem_kthread_wait_victim(struct task_struct *victim)
+{
+	while (time_before_eq(jiffies, lowmem_deathpending_timeout) &&
+	       !kthread_should_stop()) {
+		bool released;
+
+		rcu_read_lock();
+		released = !pid_alive(victim) ||
+			test_task_flag(victim, TIF_MM_RELEASED);
+		rcu_read_unlock();
+		if (released)
+			break;
+
+		schedule_timeout_interruptible(msecs_to_jiffies(10));
+	}
+}
+
+/* Kill one victim if memory is within the headroom above minfree */
+static bool lowmem_kthread_kill(void)
+{
+	struct task_struct *selected;
+	int other_free, other_file;
+	int selected_tasksize = 0;
+	short min_score_adj = OOM_SCORE_ADJ_MAX + 1;
+	short selected_oom_score_adj;
+	int array_size = ARRAY_SIZE(lowmem_adj);
+	int minfree = 0;
+	int i;
+
+	other_free = global_page_state(NR_FREE_PAGES) - totalreserve_pages;
+	if (global_page_state(NR_SHMEM) + total_swapcache_pages() <
+		global_page_state(NR_FILE_PAGES))
+		other_file = global_page_state(NR_FILE_PAGES) -
+						global_page_state(NR_SHMEM) -
+						total_swapcache_pages();
+	else
+		other_file = 0;
+
+	if (lowmem_adj_size < array_size)
+		array_size = lowmem_adj_size;
+	if (lowmem_minfree_size < array_size)
+		array_size = lowmem_minfree_size;
+	for (i = 0; i < array_size; i++) {
+		minfree = lowmem_minfree[i] +
+			lowmem_minfree[i] * lmk_kthread_headroom / 100;
+		if (other_free < minfree && other_file < minfree) {
+			min_score_adj = lowmem_adj[i];
+			break;
+		}
+	}
+	if (min_score_adj == OOM_SCORE_ADJ_MAX + 1)
+		return false;
+
+	mutex_lock(&scan_mutex);
+	selected_oom_score_adj = min_score_adj;
+	selected = lowmem_select_indexed(min_score_adj, &selected_tasksize,
+					&selected_oom_score_adj);
+	if (!selected)
+		selected = lowmem_select_scan(min_score_adj,
+					&selected_tasksize,
+					&selected_oom_score_adj);
+	if (IS_ERR_OR_NULL(selected)) {
+		mutex_unlock(&scan_mutex);
+		/* A victim of the shrinker is still dying, wait for it */
+		if (selected)
+			schedule_timeout_interruptible(msecs_to_jiffies(20));
+		return selected != NULL;
+	}
+
+	lowmem_print(1, "Killing '%s' (%d), adj %hd, to free %ldkB ahead of minfree %ldkB for oom_score_adj %hd, cache %ldkB free %ldkB\n",
+		     selected->comm, selected->pid, selected_oom_score_adj,
+		     selected_tasksize * (long)(PAGE_SIZE / 1024),
+		     minfree * (long)(PAGE_SIZE / 1024), min_score_adj,
+		     other_file * (long)(PAGE_SIZE / 1024),
+		     other_free * (long)(PAGE_SIZE / 1024));
+	lowmem_kill_task(selected);
+	mutex_unlock(&scan_mutex);
+
+	trace_almk_shrink(selected_tasksize, 0, other_free, other_file,
+			selected_oom_score_adj);
+
+	lowmem_kthread_wait_victim(selected);
+	put_task_struct(selected);
+
+	return true;
+}
+
+static int lowmem_kthread(void *unused)
+{
+	set_user_nice(current, -10);
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(lmk_kthread_wait,
+				atomic_read(&lmk_kthread_wakeup) ||
+				kthread_should_stop());
+		atomic_set(&lmk_kthread_wakeup, 0);
+
+		/* Keep going as long as memory stays within the headroom */
+		while (enable_lmk_kthread && !kthread_should_stop() &&
+		       lowmem_kthread_kill())
+			;
+	}
+
+	return 0;
+}
+
+static struct task_struct *lmk_kthread;
+
 static struct shrinker lowmem_shrinker = {
 	.shrink = lowmem_shrink,
 	.seeks = DEFAULT_SEEKS * 16
@@ -558,6 +1209,13 @@ static struct shrinker lowmem_shrinker = {
 
 static int __init lowmem_init(void)
 {
+	lowmem_index_init();
+	lmk_kthread = kthread_run(lowmem_kthread, NULL, "lowmemorykiller");
+	if (IS_ERR(lmk_kthread)) {
+		pr_err("failed to start kill thread: %ld\n",
+		       PTR_ERR(lmk_kthread));
+		lmk_kthread = NULL;
+	}
 	register_shrinker(&lowmem_shrinker);
 	vmpressure_notifier_register(&lmk_vmpr_nb);
 	return 0;
@@ -566,6 +1224,9 @@ static int __init lowmem_init(void)
 static void __exit lowmem_exit(void)
 {
 	unregister_shrinker(&lowmem_shrinker);
+	if (lmk_kthread)
+		kthread_stop(lmk_kthread);
+	lowmem_index_exit();
 }
 
 #ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_AUTODETECT_OOM_ADJ_VALUES
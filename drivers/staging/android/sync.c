@@ -19,6 +19,8 @@
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
 #include <linux/poll.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
@@ -40,6 +42,16 @@ static DEFINE_SPINLOCK(sync_timeline_list_lock);
 static LIST_HEAD(sync_fence_list_head);
 static DEFINE_SPINLOCK(sync_fence_list_lock);
 
+static struct kmem_cache *sync_fence_cachep __read_mostly;
+
+/*
+ * Time sync_fence_wait() polls an active fence before going to sleep, so
+ * that a fence signaled a few microseconds later does not pay for a
+ * sleep and wake up.  0 disables the polling.
+ */
+static unsigned int sync_wait_spin_us = 20;
+module_param_named(wait_spin_us, sync_wait_spin_us, uint, S_IRUGO | S_IWUSR);
+
 struct sync_timeline *sync_timeline_create(const struct sync_timeline_ops *ops,
 					   int size, const char *name)
 {
@@ -254,7 +266,7 @@ static struct sync_fence *sync_fence_alloc(const char *name)
 	struct sync_fence *fence;
 	unsigned long flags;
 
-	fence = kzalloc(sizeof(struct sync_fence), GFP_KERNEL);
+	fence = kmem_cache_zalloc(sync_fence_cachep, GFP_KERNEL);
 	if (fence == NULL)
 		return NULL;
 
@@ -279,7 +291,7 @@ static struct sync_fence *sync_fence_alloc(const char *name)
 	return fence;
 
 err:
-	kfree(fence);
+	kmem_cache_free(sync_fence_cachep, fence);
 	return NULL;
 }
 
@@ -389,6 +401,42 @@ static int sync_fence_merge_pts(struct sync_fence *dst, struct sync_fence *src)
 	return 0;
 }
 
+/*
+ * Returns true if every pt of @b has a pt of @a on the same timeline that
+ * signals no earlier, so that merging @b into @a would leave @a unchanged.
+ */
+static bool sync_fence_covers(struct sync_fence *a, struct sync_fence *b)
+{
+	struct sync_pt *a_pt, *b_pt;
+
+	list_for_each_entry(b_pt, &b->pt_list_head, pt_list) {
+		bool covered = false;
+
+		list_for_each_entry(a_pt, &a->pt_list_head, pt_list) {
+			int (*cmp_fn)(struct sync_pt *, struct sync_pt *);
+			int cmp_val;
+
+			if (a_pt->parent != b_pt->parent)
+				continue;
+
+			cmp_fn = a_pt->parent->ops->compare;
+			cmp_val = cmp_fn(a_pt, b_pt);
+
+			/* see sync_fence_merge_pts() for out-of-order users */
+			if (cmp_val != -cmp_fn(b_pt, a_pt))
+				return false;
+
+			covered = cmp_val >= 0;
+			break;
+		}
+
+		if (!covered)
+			return false;
+	}
+
+	return true;
+}
+
 static void sync_fence_detach_pts(struct sync_fence *fence)
 {
 	struct list_head *pos, *n;
@@ -466,6 +514,20 @@ struct sync_fence *sync_fence_merge(const char *name,
 	struct list_head *pos;
 	int err;
 
+	/*
+	 * Merging a fence with one it already waits for, or with itself,
+	 * is common enough in the display pipelines to hand out another
+	 * reference to the larger fence instead of allocating a copy.
+	 */
+	if (sync_fence_covers(a, b)) {
+		get_file(a->file);
+		return a;
+	}
+	if (sync_fence_covers(b, a)) {
+		get_file(b->file);
+		return b;
+	}
+
 	fence = sync_fence_alloc(name);
 	if (fence == NULL)
 		return NULL;
@@ -495,7 +557,7 @@ struct sync_fence *sync_fence_merge(const char *name,
 	return fence;
 err:
 	sync_fence_free_pts(fence);
-	kfree(fence);
+	kmem_cache_free(sync_fence_cachep, fence);
 	return NULL;
 }
 EXPORT_SYMBOL(sync_fence_merge);
@@ -599,6 +661,26 @@ static bool sync_fence_check(struct sync_fence *fence)
 	return fence->status != 0;
 }
 
+/* Poll the fence for up to sync_wait_spin_us, returns true if signaled */
+static bool sync_fence_spin(struct sync_fence *fence)
+{
+	ktime_t end;
+
+	if (!sync_wait_spin_us)
+		return false;
+
+	end = ktime_add_us(ktime_get(), sync_wait_spin_us);
+	do {
+		if (sync_fence_check(fence))
+			return true;
+		if (need_resched())
+			break;
+		cpu_relax();
+	} while (ktime_compare(ktime_get(), end) < 0);
+
+	return false;
+}
+
 static const char *sync_status_str(int status)
 {
 	if (status > 0)
@@ -681,6 +763,9 @@ int sync_fence_wait(struct sync_fence *fence, long timeout)
 	list_for_each_entry(pt, &fence->pt_list_head, pt_list)
 		trace_sync_pt(pt);
 
+	if (timeout && !sync_fence_check(fence))
+		sync_fence_spin(fence);
+
 	if (timeout > 0) {
 		timeout = msecs_to_jiffies(timeout);
 		err = wait_event_interruptible_timeout(fence->wq,
@@ -720,7 +805,7 @@ static void sync_fence_free(struct kref *kref)
 
 	sync_fence_free_pts(fence);
 
-	kfree(fence);
+	kmem_cache_free(sync_fence_cachep, fence);
 }
 
 static int sync_fence_release(struct inode *inode, struct file *file)
@@ -926,6 +1011,15 @@ static long sync_fence_ioctl(struct file *file, unsigned int cmd,
 	}
 }
 
+static __init int sync_init(void)
+{
+	sync_fence_cachep = KMEM_CACHE(sync_fence, 0);
+	if (!sync_fence_cachep)
+		return -ENOMEM;
+	return 0;
+}
+core_initcall(sync_init);
+
 #ifdef CONFIG_DEBUG_FS
 static void sync_print_pt(struct seq_file *s, struct sync_pt *pt, bool fence)
 {
@@ -32,11 +32,13 @@ enum {
 	BINDER_TYPE_HANDLE	= B_PACK_CHARS('s', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_WEAK_HANDLE	= B_PACK_CHARS('w', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_FD		= B_PACK_CHARS('f', 'd', '*', B_TYPE_LARGE),
+	BINDER_TYPE_PTR		= B_PACK_CHARS('p', 't', '*', B_TYPE_LARGE),
 };
 
 enum {
 	FLAT_BINDER_FLAG_PRIORITY_MASK = 0xff,
 	FLAT_BINDER_FLAG_ACCEPTS_FDS = 0x100,
+	FLAT_BINDER_FLAG_INHERIT_RT = 0x800,
 };
 
 #ifdef BINDER_IPC_32BIT
@@ -69,6 +71,35 @@ struct flat_binder_object {
 	binder_uintptr_t	cookie;
 };
 
+/*
+ * The header shared by all objects in a transaction, so the driver can
+ * tell their type and size before it knows which object it is looking at.
+ */
+struct binder_object_header {
+	__u32	type;
+};
+
+/*
+ * A buffer the sender keeps outside the transaction data.  The driver
+ * copies it straight into the target's buffer, after the offsets array,
+ * and rewrites 'buffer' to where the target sees it.  With
+ * BINDER_BUFFER_FLAG_HAS_PARENT set it also patches that new address into
+ * the buffer of object number 'parent' at 'parent_offset', so embedded
+ * pointers stay valid without the sender flattening them first.
+ */
+struct binder_buffer_object {
+	struct binder_object_header	hdr;
+	__u32				flags;
+	binder_uintptr_t		buffer;
+	binder_size_t			length;
+	binder_size_t			parent;
+	binder_size_t			parent_offset;
+};
+
+enum {
+	BINDER_BUFFER_FLAG_HAS_PARENT = 0x01,
+};
+
 /*
  * On 64-bit platforms where user code may run in 32-bits the driver must
  * translate the buffer (and local binder) addresses appropriately.
@@ -159,6 +190,15 @@ struct binder_transaction_data {
 	} data;
 };
 
+/*
+ * BC_TRANSACTION_SG and BC_REPLY_SG: a transaction plus the total size,
+ * each buffer aligned to 8 bytes, of the BINDER_TYPE_PTR buffers in it.
+ */
+struct binder_transaction_data_sg {
+	struct binder_transaction_data	transaction_data;
+	binder_size_t			buffers_size;
+};
+
 struct binder_ptr_cookie {
 	binder_uintptr_t ptr;
 	binder_uintptr_t cookie;
@@ -341,6 +381,12 @@ enum binder_driver_command_protocol {
 	/*
 	 * void *: cookie
 	 */
+
+	BC_TRANSACTION_SG = _IOW('c', 17, struct binder_transaction_data_sg),
+	BC_REPLY_SG = _IOW('c', 18, struct binder_transaction_data_sg),
+	/*
+	 * binder_transaction_data_sg: the sent command.
+	 */
 };
 
 #endif /* _UAPI_LINUX_BINDER_H */
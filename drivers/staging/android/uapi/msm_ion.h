@@ -142,6 +142,43 @@ struct ion_prefetch_data {
 	unsigned long len;
 };
 
+#define ION_CACHE_OP_CLEAN	1
+#define ION_CACHE_OP_INV	2
+#define ION_CACHE_OP_CLEAN_INV	3
+
+#define ION_CACHE_OPS_MAX	64
+
+/* struct ion_cache_op_entry - one buffer region of ION_IOC_CACHE_OPS
+ *
+ * @fd:		dma-buf fd of the buffer
+ * @op:		ION_CACHE_OP_CLEAN, ION_CACHE_OP_INV or
+ *		ION_CACHE_OP_CLEAN_INV
+ * @vaddr:	userspace virtual address the buffer is mapped at
+ * @offset:	offset into the buffer to start the operation at
+ * @length:	length of the region
+ *
+ * Same meaning as the fields of struct ion_flush_data.
+ */
+struct ion_cache_op_entry {
+	__s32 fd;
+	__u32 op;
+	__u64 vaddr;
+	__u32 offset;
+	__u32 length;
+};
+
+/* struct ion_cache_op_list - argument of ION_IOC_CACHE_OPS
+ *
+ * @entries:	userspace pointer to an array of struct ion_cache_op_entry
+ * @count:	number of entries, at most ION_CACHE_OPS_MAX
+ * @__pad:	must be zero
+ */
+struct ion_cache_op_list {
+	__u64 entries;
+	__u32 count;
+	__u32 __pad;
+};
+
 #define ION_IOC_MSM_MAGIC 'M'
 
 /**
@@ -172,4 +209,16 @@ struct ion_prefetch_data {
 #define ION_IOC_DRAIN			_IOWR(ION_IOC_MSM_MAGIC, 4, \
 						struct ion_prefetch_data)
 
+/**
+ * DOC: ION_IOC_CACHE_OPS - clean and/or invalidate the caches of many buffers
+ *
+ * Performs the cache operation of each entry of the list in a single call.
+ * If no entry is a plain ION_CACHE_OP_INV and the cached buffers add up to
+ * at least the cache_ops_full_threshold module parameter the whole cache is
+ * cleaned and invalidated instead. The structs have the same layout for 32
+ * and 64 bit userspace.
+ */
+#define ION_IOC_CACHE_OPS		_IOWR(ION_IOC_MSM_MAGIC, 5, \
+						struct ion_cache_op_list)
+
 #endif
@@ -30,9 +30,15 @@
 #include <linux/highmem.h>
 #include <linux/slab.h>
 #include <linux/lzo.h>
+#include <linux/lz4.h>
+#include <linux/jhash.h>
+#include <linux/fs.h>
+#include <linux/dcache.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 #include <linux/ratelimit.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/show_mem_notifier.h>
 
 #include "zram_drv.h"
@@ -50,6 +56,23 @@ static struct zram *zram_devices;
 /* Module params (documentation at end) */
 static unsigned int num_devices = 1;
 
+static const struct zram_compressor zram_compressors[] = {
+	{
+		.name = "lzo",
+		.workmem_size = LZO1X_MEM_COMPRESS,
+		.compress = lzo1x_1_compress,
+		.decompress = lzo1x_decompress_safe,
+	},
+#ifdef CONFIG_ZRAM_LZ4_COMPRESS
+	{
+		.name = "lz4",
+		.workmem_size = LZ4_MEM_COMPRESS,
+		.compress = lz4_compress,
+		.decompress = lz4_decompress_unknownoutputsize,
+	},
+#endif
+};
+
 static int zram_show_mem_notifier(struct notifier_block *nb,
 				unsigned long action,
 				void *data)
@@ -154,6 +177,23 @@ static ssize_t zero_pages_show(struct device *dev,
 	return sprintf(buf, "%u\n", zram->stats.pages_zero);
 }
 
+static ssize_t same_pages_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%u\n", zram->stats.pages_same);
+}
+
+static ssize_t dup_data_size_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%llu\n",
+			(u64)atomic64_read(&zram->stats.dup_data_size));
+}
+
 static ssize_t orig_data_size_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -187,6 +227,36 @@ static ssize_t mem_used_total_show(struct device *dev,
 	return sprintf(buf, "%llu\n", val);
 }
 
+static ssize_t pages_compacted_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	unsigned long val = 0;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	if (zram->init_done)
+		val = zs_get_pages_compacted(zram->meta->mem_pool);
+	up_read(&zram->init_lock);
+
+	return sprintf(buf, "%lu\n", val);
+}
+
+static ssize_t compact_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+	zs_compact(zram->meta->mem_pool);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
 static int zram_test_flag(struct zram_meta *meta, u32 index,
 			enum zram_pageflags flag)
 {
@@ -234,38 +304,126 @@ static inline int valid_io_request(struct zram *zram, struct bio *bio)
 	return 1;
 }
 
+static void zram_comp_strm_free(struct zram_comp_strm *zstrm)
+{
+	kfree(zstrm->workmem);
+	free_pages((unsigned long)zstrm->buffer, 1);
+	kfree(zstrm);
+}
+
+static struct zram_comp_strm *
+zram_comp_strm_alloc(const struct zram_compressor *comp)
+{
+	struct zram_comp_strm *zstrm = kmalloc(sizeof(*zstrm), GFP_KERNEL);
+	if (!zstrm)
+		return NULL;
+
+	zstrm->workmem = kzalloc(comp->workmem_size, GFP_KERNEL);
+	/*
+	 * Allocate 2 pages: one for the compressed output and one in case
+	 * the compressed data ends up larger than the input page, which
+	 * covers the worst case of all of zram_compressors[].
+	 */
+	zstrm->buffer = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
+	if (!zstrm->workmem || !zstrm->buffer) {
+		zram_comp_strm_free(zstrm);
+		return NULL;
+	}
+
+	return zstrm;
+}
+
+static void zram_comp_strm_destroy(struct zram_meta *meta)
+{
+	struct zram_comp_strm *zstrm, *tmp;
+
+	list_for_each_entry_safe(zstrm, tmp, &meta->idle_strm, list) {
+		list_del(&zstrm->list);
+		zram_comp_strm_free(zstrm);
+	}
+	meta->num_strm = 0;
+}
+
+/*
+ * Get an idle compression stream, waiting for a concurrent write to
+ * release one if all of them are in use.
+ */
+static struct zram_comp_strm *zram_comp_strm_find(struct zram_meta *meta)
+{
+	struct zram_comp_strm *zstrm;
+
+	spin_lock(&meta->strm_lock);
+	while (list_empty(&meta->idle_strm)) {
+		spin_unlock(&meta->strm_lock);
+		wait_event(meta->strm_wait, !list_empty(&meta->idle_strm));
+		spin_lock(&meta->strm_lock);
+	}
+	zstrm = list_first_entry(&meta->idle_strm, struct zram_comp_strm,
+				list);
+	list_del(&zstrm->list);
+	spin_unlock(&meta->strm_lock);
+
+	return zstrm;
+}
+
+static void zram_comp_strm_release(struct zram_meta *meta,
+				   struct zram_comp_strm *zstrm)
+{
+	spin_lock(&meta->strm_lock);
+	list_add(&zstrm->list, &meta->idle_strm);
+	spin_unlock(&meta->strm_lock);
+
+	wake_up(&meta->strm_wait);
+}
+
 static void zram_meta_free(struct zram_meta *meta)
 {
 	zs_destroy_pool(meta->mem_pool);
-	kfree(meta->compress_workmem);
-	free_pages((unsigned long)meta->compress_buffer, 1);
+	zram_comp_strm_destroy(meta);
 	vfree(meta->table);
 	kfree(meta);
 }
 
-static struct zram_meta *zram_meta_alloc(u64 disksize)
+static struct zram_meta *zram_meta_alloc(u64 disksize, int max_strm,
+					 const struct zram_compressor *comp)
 {
 	size_t num_pages;
+	struct zram_comp_strm *zstrm;
 	struct zram_meta *meta = kmalloc(sizeof(*meta), GFP_KERNEL);
 	if (!meta)
 		goto out;
 
-	meta->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!meta->compress_workmem)
-		goto free_meta;
+	INIT_LIST_HEAD(&meta->idle_strm);
+	spin_lock_init(&meta->strm_lock);
+	meta->use_dedup = false;
+	meta->dedup_tree = RB_ROOT;
+	spin_lock_init(&meta->dedup_lock);
+	init_waitqueue_head(&meta->strm_wait);
+	meta->num_strm = 0;
+
+	while (meta->num_strm < max_strm) {
+		zstrm = zram_comp_strm_alloc(comp);
+		if (!zstrm)
+			break;
+		list_add(&zstrm->list, &meta->idle_strm);
+		meta->num_strm++;
+	}
 
-	meta->compress_buffer =
-		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (!meta->compress_buffer) {
+	/* Writes only need one stream to make progress */
+	if (!meta->num_strm) {
 		pr_err("Error allocating compressor buffer space\n");
-		goto free_workmem;
+		goto free_meta;
 	}
 
+	if (meta->num_strm < max_strm)
+		pr_warn("Allocated %d of %d compression streams\n",
+			meta->num_strm, max_strm);
+
 	num_pages = disksize >> PAGE_SHIFT;
 	meta->table = vzalloc(num_pages * sizeof(*meta->table));
 	if (!meta->table) {
 		pr_err("Error allocating zram address table\n");
-		goto free_buffer;
+		goto free_strm;
 	}
 
 	meta->mem_pool = zs_create_pool(GFP_NOIO | __GFP_HIGHMEM |
@@ -279,10 +437,8 @@ static struct zram_meta *zram_meta_alloc(u64 disksize)
 
 free_table:
 	vfree(meta->table);
-free_buffer:
-	free_pages((unsigned long)meta->compress_buffer, 1);
-free_workmem:
-	kfree(meta->compress_workmem);
+free_strm:
+	zram_comp_strm_destroy(meta);
 free_meta:
 	kfree(meta);
 	meta = NULL;
@@ -297,42 +453,381 @@ static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 	*offset = (*offset + bvec->bv_len) % PAGE_SIZE;
 }
 
-static int page_zero_filled(void *ptr)
+/* Return 1 and the repeated word if the page is a single word repeated */
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
 
 	page = (unsigned long *)ptr;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos] != page[0])
 			return 0;
 	}
 
+	*element = page[0];
 	return 1;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+/* len and the alignment of ptr are multiples of sizeof(unsigned long) */
+static void zram_fill_page(void *ptr, unsigned int len, unsigned long value)
+{
+	unsigned long *page = ptr;
+	unsigned int pos;
+
+	for (pos = 0; pos != len / sizeof(*page); pos++)
+		page[pos] = value;
+}
+
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page);
-	if (is_partial_io(bvec))
-		memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
-	else
-		clear_page(user_mem);
+	if (is_partial_io(bvec)) {
+		if (element)
+			zram_fill_page(user_mem + bvec->bv_offset,
+				       bvec->bv_len, element);
+		else
+			memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
+	} else {
+		if (element)
+			zram_fill_page(user_mem, PAGE_SIZE, element);
+		else
+			clear_page(user_mem);
+	}
 	kunmap_atomic(user_mem);
 
 	flush_dcache_page(page);
 }
 
+/*
+ * Look for an object holding the len bytes at data, take a reference on
+ * it if there is one.
+ */
+static struct zram_dedup_entry *zram_dedup_get(struct zram *zram,
+		const unsigned char *data, u16 len, u32 checksum)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zram_dedup_entry *entry;
+	struct rb_node *node, *prev;
+
+	spin_lock(&meta->dedup_lock);
+	node = meta->dedup_tree.rb_node;
+	while (node) {
+		entry = rb_entry(node, struct zram_dedup_entry, node);
+		if (checksum < entry->checksum)
+			node = node->rb_left;
+		else if (checksum > entry->checksum)
+			node = node->rb_right;
+		else
+			break;
+	}
+
+	/* Rewind to the first of the entries sharing the checksum */
+	while (node && (prev = rb_prev(node)) &&
+	       rb_entry(prev, struct zram_dedup_entry, node)->checksum ==
+			checksum)
+		node = prev;
+
+	for (; node; node = rb_next(node)) {
+		unsigned char *cmem;
+		bool match;
+
+		entry = rb_entry(node, struct zram_dedup_entry, node);
+		if (entry->checksum != checksum)
+			break;
+		if (entry->len != len)
+			continue;
+
+		cmem = zs_map_object(meta->mem_pool, entry->handle, ZS_MM_RO);
+		match = !memcmp(cmem, data, len);
+		zs_unmap_object(meta->mem_pool, entry->handle);
+
+		if (match) {
+			entry->refcount++;
+			spin_unlock(&meta->dedup_lock);
+			atomic64_add(len, &zram->stats.dup_data_size);
+			return entry;
+		}
+	}
+	spin_unlock(&meta->dedup_lock);
+
+	return NULL;
+}
+
+/*
+ * Wrap a new object in an entry. Only compressed objects are indexed,
+ * incompressible pages seldom repeat.
+ */
+static struct zram_dedup_entry *zram_dedup_add(struct zram *zram,
+		unsigned long handle, u16 len, u32 checksum)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zram_dedup_entry *entry, *parent;
+	struct rb_node **p, *node = NULL;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO);
+	if (!entry)
+		return NULL;
+
+	entry->handle = handle;
+	entry->checksum = checksum;
+	entry->len = len;
+	entry->refcount = 1;
+	RB_CLEAR_NODE(&entry->node);
+
+	if (len == PAGE_SIZE)
+		return entry;
+
+	spin_lock(&meta->dedup_lock);
+	p = &meta->dedup_tree.rb_node;
+	while (*p) {
+		node = *p;
+		parent = rb_entry(node, struct zram_dedup_entry, node);
+		if (checksum < parent->checksum)
+			p = &node->rb_left;
+		else
+			p = &node->rb_right;
+	}
+	rb_link_node(&entry->node, node, p);
+	rb_insert_color(&entry->node, &meta->dedup_tree);
+	spin_unlock(&meta->dedup_lock);
+
+	return entry;
+}
+
+static void zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry)
+{
+	struct zram_meta *meta = zram->meta;
+	u16 len = entry->len;
+
+	spin_lock(&meta->dedup_lock);
+	if (--entry->refcount) {
+		spin_unlock(&meta->dedup_lock);
+		atomic64_sub(len, &zram->stats.dup_data_size);
+		return;
+	}
+	if (!RB_EMPTY_NODE(&entry->node))
+		rb_erase(&entry->node, &meta->dedup_tree);
+	spin_unlock(&meta->dedup_lock);
+
+	zs_free(meta->mem_pool, entry->handle);
+	kfree(entry);
+}
+
+/* zsmalloc handle of the object backing a slot */
+static unsigned long zram_get_handle(struct zram_meta *meta, size_t index)
+{
+	unsigned long handle = meta->table[index].handle;
+
+	if (handle && meta->use_dedup)
+		return ((struct zram_dedup_entry *)handle)->handle;
+
+	return handle;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+/*
+ * Pages per write to the backing device: idle and incompressible pages
+ * are written back in batches to keep the number of I/Os down.
+ */
+#define ZRAM_WB_BATCH_PAGES	32
+
+static void zram_reset_bdev(struct zram *zram)
+{
+	if (!zram->backing_dev)
+		return;
+
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	filp_close(zram->backing_dev, NULL);
+	vfree(zram->bitmap);
+
+	zram->backing_dev = NULL;
+	zram->bdev = NULL;
+	zram->bitmap = NULL;
+	zram->nr_blocks = 0;
+}
+
+/*
+ * Reserve up to *count contiguous blocks of the backing device, *count
+ * is set to the number reserved.
+ */
+static unsigned long zram_wb_alloc_blocks(struct zram *zram,
+		unsigned int *count)
+{
+	unsigned long blk = 0;
+	unsigned int nr;
+
+	spin_lock(&zram->bitmap_lock);
+	for (nr = *count; nr; nr >>= 1) {
+		blk = bitmap_find_next_zero_area(zram->bitmap, zram->nr_blocks,
+						 0, nr, 0);
+		if (blk + nr <= zram->nr_blocks) {
+			bitmap_set(zram->bitmap, blk, nr);
+			break;
+		}
+	}
+	spin_unlock(&zram->bitmap_lock);
+
+	*count = nr;
+	return blk;
+}
+
+static void zram_wb_free_blocks(struct zram *zram, unsigned long blk,
+		unsigned int count)
+{
+	spin_lock(&zram->bitmap_lock);
+	bitmap_clear(zram->bitmap, blk, count);
+	spin_unlock(&zram->bitmap_lock);
+}
+
+static int zram_read_from_bdev_sync(struct zram *zram, void *mem,
+		unsigned long blk)
+{
+	struct page *page;
+	struct bio *bio;
+	int ret;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio) {
+		__free_page(page);
+		return -ENOMEM;
+	}
+
+	bio->bi_bdev = zram->bdev;
+	bio->bi_sector = blk << SECTORS_PER_PAGE_SHIFT;
+	bio_add_page(bio, page, PAGE_SIZE, 0);
+
+	ret = submit_bio_wait(READ, bio);
+	bio_put(bio);
+
+	if (!ret) {
+		memcpy(mem, page_address(page), PAGE_SIZE);
+		atomic64_inc(&zram->stats.bd_reads);
+	}
+	__free_page(page);
+
+	return ret;
+}
+
+static void zram_bio_ctx_put(struct zram_bio_ctx *ctx);
+
+static void zram_bdev_read_end_io(struct bio *bio, int error)
+{
+	struct zram_bio_ctx *ctx = bio->bi_private;
+
+	if (error)
+		ctx->error = error;
+	bio_put(bio);
+
+	zram_bio_ctx_put(ctx);
+}
+
+/*
+ * Read a full page from the backing device straight into the page of the
+ * bio, which is completed once the read is done.
+ */
+static int zram_read_from_bdev_async(struct zram *zram, struct bio_vec *bvec,
+		unsigned long blk, struct bio *parent,
+		struct zram_bio_ctx **ctxp)
+{
+	struct zram_bio_ctx *ctx = *ctxp;
+	struct bio *bio;
+
+	if (!ctx) {
+		ctx = kmalloc(sizeof(*ctx), GFP_NOIO);
+		if (!ctx)
+			return -ENOMEM;
+
+		ctx->parent = parent;
+		/* Dropped by __zram_make_request() once all pages are done */
+		atomic_set(&ctx->pending, 1);
+		ctx->error = 0;
+		*ctxp = ctx;
+	}
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_bdev = zram->bdev;
+	bio->bi_sector = blk << SECTORS_PER_PAGE_SHIFT;
+	if (!bio_add_page(bio, bvec->bv_page, bvec->bv_len,
+			  bvec->bv_offset)) {
+		bio_put(bio);
+		return -EIO;
+	}
+	bio->bi_end_io = zram_bdev_read_end_io;
+	bio->bi_private = ctx;
+
+	atomic_inc(&ctx->pending);
+	atomic64_inc(&zram->stats.bd_reads);
+	submit_bio(READ, bio);
+
+	return 0;
+}
+#else
+static inline void zram_reset_bdev(struct zram *zram) {}
+
+static inline void zram_wb_free_blocks(struct zram *zram, unsigned long blk,
+		unsigned int count) {}
+
+static inline int zram_read_from_bdev_sync(struct zram *zram, void *mem,
+		unsigned long blk)
+{
+	return -EIO;
+}
+
+static inline int zram_read_from_bdev_async(struct zram *zram,
+		struct bio_vec *bvec, unsigned long blk, struct bio *parent,
+		struct zram_bio_ctx **ctxp)
+{
+	return -EIO;
+}
+#endif
+
+static void zram_bio_ctx_put(struct zram_bio_ctx *ctx)
+{
+	if (!atomic_dec_and_test(&ctx->pending))
+		return;
+
+	if (!ctx->error)
+		set_bit(BIO_UPTODATE, &ctx->parent->bi_flags);
+	bio_endio(ctx->parent, ctx->error);
+	kfree(ctx);
+}
+
 static void zram_free_page(struct zram *zram, size_t index)
 {
 	struct zram_meta *meta = zram->meta;
 	unsigned long handle = meta->table[index].handle;
 	u16 size = meta->table[index].size;
 
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		zram_wb_free_blocks(zram, handle, 1);
+		zram->stats.pages_wb--;
+		meta->table[index].handle = 0;
+		return;
+	}
+
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_clear_flag(meta, index, ZRAM_SAME);
+		zram->stats.pages_same--;
+		meta->table[index].element = 0;
+		return;
+	}
+
 	if (unlikely(!handle)) {
 		/*
 		 * No memory is allocated for zero filled pages.
@@ -348,7 +843,10 @@ static void zram_free_page(struct zram *zram, size_t index)
 	if (unlikely(size > max_zpage_size))
 		zram->stats.bad_compress--;
 
-	zs_free(meta->mem_pool, handle);
+	if (meta->use_dedup)
+		zram_dedup_put(zram, (struct zram_dedup_entry *)handle);
+	else
+		zs_free(meta->mem_pool, handle);
 
 	if (size <= PAGE_SIZE / 2)
 		zram->stats.good_compress--;
@@ -362,11 +860,29 @@ static void zram_free_page(struct zram *zram, size_t index)
 
 static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 {
-	int ret = LZO_E_OK;
+	int ret = 0;
 	size_t clen = PAGE_SIZE;
 	unsigned char *cmem;
 	struct zram_meta *meta = zram->meta;
-	unsigned long handle = meta->table[index].handle;
+	unsigned long handle;
+
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_fill_page(mem, PAGE_SIZE, meta->table[index].element);
+		return 0;
+	}
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		ret = zram_read_from_bdev_sync(zram, mem,
+					       meta->table[index].handle);
+		if (unlikely(ret)) {
+			pr_err("Backing device read failed! err=%d, page=%u\n",
+			       ret, index);
+			atomic64_inc(&zram->stats.failed_reads);
+		}
+		return ret;
+	}
+
+	handle = zram_get_handle(meta, index);
 
 	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
 		clear_page(mem);
@@ -377,12 +893,12 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	if (meta->table[index].size == PAGE_SIZE)
 		copy_page(mem, cmem);
 	else
-		ret = lzo1x_decompress_safe(cmem, meta->table[index].size,
-						mem, &clen);
+		ret = zram->comp->decompress(cmem, meta->table[index].size,
+					     mem, &clen);
 	zs_unmap_object(meta->mem_pool, handle);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		atomic64_inc(&zram->stats.failed_reads);
 		return ret;
@@ -392,7 +908,8 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 }
 
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
-			  u32 index, int offset, struct bio *bio)
+			  u32 index, int offset, struct bio *bio,
+			  struct zram_bio_ctx **ctx)
 {
 	int ret;
 	struct page *page;
@@ -400,12 +917,32 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	struct zram_meta *meta = zram->meta;
 	page = bvec->bv_page;
 
-	if (unlikely(!meta->table[index].handle) ||
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		handle_same_page(bvec, meta->table[index].element);
+		return 0;
+	}
+
+	if (zram_test_flag(meta, index, ZRAM_WB) && !is_partial_io(bvec)) {
+		ret = zram_read_from_bdev_async(zram, bvec,
+				meta->table[index].handle, bio, ctx);
+		if (unlikely(ret))
+			atomic64_inc(&zram->stats.failed_reads);
+		return ret;
+	}
+
+	if (unlikely(!meta->table[index].handle &&
+		     !zram_test_flag(meta, index, ZRAM_WB)) ||
 			zram_test_flag(meta, index, ZRAM_ZERO)) {
-		handle_zero_page(bvec);
+		handle_same_page(bvec, 0);
 		return 0;
 	}
 
+	/*
+	 * Readers only ever clear this flag, which is only set with
+	 * zram->lock held for writing.
+	 */
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+
 	if (is_partial_io(bvec))
 		/* Use  a temporary buffer to decompress the page */
 		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
@@ -422,7 +959,7 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 
 	ret = zram_decompress_page(zram, uncmem, index);
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK))
+	if (unlikely(ret))
 		goto out_cleanup;
 
 	if (is_partial_io(bvec))
@@ -438,6 +975,25 @@ out_cleanup:
 	return ret;
 }
 
+static void handle_pending_slot_free(struct zram *zram)
+{
+	struct zram_slot_free *free_rq;
+
+	spin_lock(&zram->slot_free_lock);
+	while (zram->slot_free_rq) {
+		free_rq = zram->slot_free_rq;
+		zram->slot_free_rq = free_rq->next;
+		zram_free_page(zram, free_rq->index);
+		kfree(free_rq);
+	}
+	spin_unlock(&zram->slot_free_lock);
+}
+
+/*
+ * Writes only hold zram->lock for writing while they update the table:
+ * the compression and the copy to the zsmalloc object run in parallel on
+ * one of the streams of meta->idle_strm.
+ */
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			   int offset)
 {
@@ -447,10 +1003,14 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	struct page *page;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
+	struct zram_comp_strm *zstrm = NULL;
+	struct zram_dedup_entry *entry;
+	unsigned long element;
+	u32 checksum = 0;
+	bool bad_compress = false;
 	static unsigned long zram_rs_time;
 
 	page = bvec->bv_page;
-	src = meta->compress_buffer;
 
 	if (is_partial_io(bvec)) {
 		/*
@@ -462,7 +1022,9 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			ret = -ENOMEM;
 			goto out;
 		}
+		down_read(&zram->lock);
 		ret = zram_decompress_page(zram, uncmem, index);
+		up_read(&zram->lock);
 		if (ret)
 			goto out;
 	}
@@ -478,27 +1040,33 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = user_mem;
 	}
 
-	if (page_zero_filled(uncmem)) {
-		kunmap_atomic(user_mem);
+	if (page_same_filled(uncmem, &element)) {
+		if (user_mem)
+			kunmap_atomic(user_mem);
+
+		down_write(&zram->lock);
+		handle_pending_slot_free(zram);
 		/* Free memory associated with this sector now. */
 		zram_free_page(zram, index);
 
-		zram->stats.pages_zero++;
-		zram_set_flag(meta, index, ZRAM_ZERO);
+		if (element) {
+			meta->table[index].element = element;
+			zram->stats.pages_same++;
+			zram_set_flag(meta, index, ZRAM_SAME);
+		} else {
+			zram->stats.pages_zero++;
+			zram_set_flag(meta, index, ZRAM_ZERO);
+		}
+		up_write(&zram->lock);
 		ret = 0;
 		goto out;
 	}
 
-	/*
-	 * zram_slot_free_notify could miss free so that let's
-	 * double check.
-	 */
-	if (unlikely(meta->table[index].handle ||
-			zram_test_flag(meta, index, ZRAM_ZERO)))
-		zram_free_page(zram, index);
+	zstrm = zram_comp_strm_find(meta);
+	src = zstrm->buffer;
 
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       meta->compress_workmem);
+	ret = zram->comp->compress(uncmem, PAGE_SIZE, src, &clen,
+				   zstrm->workmem);
 
 	if (!is_partial_io(bvec)) {
 		kunmap_atomic(user_mem);
@@ -506,19 +1074,28 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = NULL;
 	}
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Compression failed! err=%d\n", ret);
 		goto out;
 	}
 
 	if (unlikely(clen > max_zpage_size)) {
-		zram->stats.bad_compress++;
+		bad_compress = true;
 		clen = PAGE_SIZE;
 		src = NULL;
 		if (is_partial_io(bvec))
 			src = uncmem;
 	}
 
+	if (meta->use_dedup && clen != PAGE_SIZE) {
+		checksum = jhash(src, clen, 0);
+		entry = zram_dedup_get(zram, src, clen, checksum);
+		if (entry) {
+			handle = (unsigned long)entry;
+			goto store;
+		}
+	}
+
 	handle = zs_malloc(meta->mem_pool, clen);
 	if (!handle) {
 		if (printk_timed_ratelimit(&zram_rs_time,
@@ -540,6 +1117,22 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 	zs_unmap_object(meta->mem_pool, handle);
 
+	if (meta->use_dedup) {
+		entry = zram_dedup_add(zram, handle, clen, checksum);
+		if (!entry) {
+			zs_free(meta->mem_pool, handle);
+			ret = -ENOMEM;
+			goto out;
+		}
+		handle = (unsigned long)entry;
+	}
+
+store:
+	zram_comp_strm_release(meta, zstrm);
+	zstrm = NULL;
+
+	down_write(&zram->lock);
+	handle_pending_slot_free(zram);
 	/*
 	 * Free memory associated with this sector
 	 * before overwriting unused sectors.
@@ -554,8 +1147,13 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	zram->stats.pages_stored++;
 	if (clen <= PAGE_SIZE / 2)
 		zram->stats.good_compress++;
+	if (bad_compress)
+		zram->stats.bad_compress++;
+	up_write(&zram->lock);
 
 out:
+	if (zstrm)
+		zram_comp_strm_release(meta, zstrm);
 	if (is_partial_io(bvec))
 		kfree(uncmem);
 
@@ -564,35 +1162,19 @@ out:
 	return ret;
 }
 
-static void handle_pending_slot_free(struct zram *zram)
-{
-	struct zram_slot_free *free_rq;
-
-	spin_lock(&zram->slot_free_lock);
-	while (zram->slot_free_rq) {
-		free_rq = zram->slot_free_rq;
-		zram->slot_free_rq = free_rq->next;
-		zram_free_page(zram, free_rq->index);
-		kfree(free_rq);
-	}
-	spin_unlock(&zram->slot_free_lock);
-}
-
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
-			int offset, struct bio *bio, int rw)
+			int offset, struct bio *bio, int rw,
+			struct zram_bio_ctx **ctx)
 {
 	int ret;
 
 	if (rw == READ) {
 		down_read(&zram->lock);
 		handle_pending_slot_free(zram);
-		ret = zram_bvec_read(zram, bvec, index, offset, bio);
+		ret = zram_bvec_read(zram, bvec, index, offset, bio, ctx);
 		up_read(&zram->lock);
 	} else {
-		down_write(&zram->lock);
-		handle_pending_slot_free(zram);
 		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
 	}
 
 	return ret;
@@ -604,9 +1186,11 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 	struct zram_meta *meta;
 
 	flush_work(&zram->free_work);
+	flush_work(&zram->ra_work);
 
 	down_write(&zram->init_lock);
 	if (!zram->init_done) {
+		zram_reset_bdev(zram);
 		up_write(&zram->init_lock);
 		return;
 	}
@@ -617,14 +1201,19 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		unsigned long handle = meta->table[index].handle;
-		if (!handle)
+		if (!handle || zram_test_flag(meta, index, ZRAM_SAME) ||
+		    zram_test_flag(meta, index, ZRAM_WB))
 			continue;
 
-		zs_free(meta->mem_pool, handle);
+		if (meta->use_dedup)
+			zram_dedup_put(zram, (struct zram_dedup_entry *)handle);
+		else
+			zs_free(meta->mem_pool, handle);
 	}
 
 	zram_meta_free(zram->meta);
 	zram->meta = NULL;
+	zram_reset_bdev(zram);
 	/* Reset stats */
 	memset(&zram->stats, 0, sizeof(zram->stats));
 
@@ -664,6 +1253,7 @@ static ssize_t disksize_store(struct device *dev,
 {
 	u64 disksize;
 	struct zram_meta *meta;
+	const struct zram_compressor *comp;
 	struct zram *zram = dev_to_zram(dev);
 
 	disksize = memparse(buf, NULL);
@@ -671,15 +1261,27 @@ static ssize_t disksize_store(struct device *dev,
 		return -EINVAL;
 
 	disksize = PAGE_ALIGN(disksize);
-	meta = zram_meta_alloc(disksize);
+	/*
+	 * The streams are sized for the algorithm selected now, check that
+	 * it has not been changed by the time init_lock is held.
+	 */
+	comp = ACCESS_ONCE(zram->comp);
+	meta = zram_meta_alloc(disksize, ACCESS_ONCE(zram->max_comp_streams),
+			       comp);
+	if (!meta)
+		return -ENOMEM;
+
 	down_write(&zram->init_lock);
-	if (zram->init_done) {
+	if (zram->init_done || zram->comp != comp) {
 		up_write(&zram->init_lock);
 		zram_meta_free(meta);
+		if (!zram->init_done)
+			return -EAGAIN;
 		pr_info("Cannot change disksize for initialized device\n");
 		return -EBUSY;
 	}
 
+	meta->use_dedup = zram->use_dedup;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
 	zram_init_device(zram, meta);
@@ -688,6 +1290,422 @@ static ssize_t disksize_store(struct device *dev,
 	return len;
 }
 
+static ssize_t max_comp_streams_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%d\n", zram->max_comp_streams);
+}
+
+static ssize_t max_comp_streams_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int num;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (kstrtoint(buf, 0, &num) || num < 1)
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		up_write(&zram->init_lock);
+		pr_info("Cannot change max compression streams for initialized device\n");
+		return -EBUSY;
+	}
+	zram->max_comp_streams = num;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+	char *p;
+
+	down_read(&zram->init_lock);
+	if (!zram->backing_dev) {
+		up_read(&zram->init_lock);
+		return sprintf(buf, "none\n");
+	}
+
+	p = d_path(&zram->backing_dev->f_path, buf, PAGE_SIZE - 1);
+	if (IS_ERR(p)) {
+		ret = PTR_ERR(p);
+	} else {
+		ret = strlen(p);
+		memmove(buf, p, ret);
+		buf[ret++] = '\n';
+	}
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct file *backing_dev = NULL;
+	struct block_device *bdev = NULL;
+	unsigned long nr_blocks, *bitmap = NULL;
+	struct inode *inode;
+	char *file_name;
+	size_t sz;
+	int err;
+
+	file_name = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!file_name)
+		return -ENOMEM;
+
+	strlcpy(file_name, buf, PATH_MAX);
+	/* ignore trailing newline */
+	sz = strlen(file_name);
+	if (sz > 0 && file_name[sz - 1] == '\n')
+		file_name[sz - 1] = 0x00;
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		pr_info("Cannot change backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	backing_dev = filp_open(file_name, O_RDWR | O_LARGEFILE, 0);
+	if (IS_ERR(backing_dev)) {
+		err = PTR_ERR(backing_dev);
+		backing_dev = NULL;
+		goto out;
+	}
+
+	inode = backing_dev->f_mapping->host;
+	/* Only block devices are supported */
+	if (!S_ISBLK(inode->i_mode)) {
+		err = -ENOTBLK;
+		goto out;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (err < 0) {
+		bdev = NULL;
+		goto out;
+	}
+
+	nr_blocks = i_size_read(inode) >> PAGE_SHIFT;
+	if (!nr_blocks) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	bitmap = vzalloc(BITS_TO_LONGS(nr_blocks) * sizeof(long));
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	zram_reset_bdev(zram);
+	zram->backing_dev = backing_dev;
+	zram->bdev = bdev;
+	zram->nr_blocks = nr_blocks;
+	zram->bitmap = bitmap;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", file_name);
+	kfree(file_name);
+
+	return len;
+
+out:
+	if (bdev)
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	if (backing_dev)
+		filp_close(backing_dev, NULL);
+	up_write(&zram->init_lock);
+	kfree(file_name);
+
+	return err;
+}
+
+/* Mark all the pages stored in memory idle, accessing a page unmarks it */
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	size_t index;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	meta = zram->meta;
+	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
+		down_write(&zram->lock);
+		if (meta->table[index].handle &&
+		    !zram_test_flag(meta, index, ZRAM_SAME) &&
+		    !zram_test_flag(meta, index, ZRAM_WB))
+			zram_set_flag(meta, index, ZRAM_IDLE);
+		up_write(&zram->lock);
+	}
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+/*
+ * Pick the slot for writeback if it is idle, or incompressible, and
+ * decompress it into mem. The slot is marked ZRAM_UNDER_WB, which is
+ * cleared if it gets freed or overwritten meanwhile.
+ */
+static bool zram_wb_get_slot(struct zram *zram, size_t index, bool idle,
+		void *mem)
+{
+	struct zram_meta *meta = zram->meta;
+	bool picked = false;
+
+	down_write(&zram->lock);
+	if (!meta->table[index].handle ||
+	    zram_test_flag(meta, index, ZRAM_ZERO) ||
+	    zram_test_flag(meta, index, ZRAM_SAME) ||
+	    zram_test_flag(meta, index, ZRAM_WB) ||
+	    zram_test_flag(meta, index, ZRAM_UNDER_WB))
+		goto out;
+
+	if (idle ? !zram_test_flag(meta, index, ZRAM_IDLE) :
+		   meta->table[index].size != PAGE_SIZE)
+		goto out;
+
+	if (zram_decompress_page(zram, mem, index))
+		goto out;
+
+	zram_set_flag(meta, index, ZRAM_UNDER_WB);
+	picked = true;
+out:
+	up_write(&zram->lock);
+
+	return picked;
+}
+
+/*
+ * Write the n pages to the blocks starting at blk with a single bio, then
+ * switch the slots that were not changed meanwhile over to the backing
+ * device.
+ */
+static int zram_wb_write_batch(struct zram *zram, struct page **pages,
+		size_t *slots, unsigned int n, unsigned long blk)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned int i, added;
+	struct bio *bio;
+	int ret;
+
+	bio = bio_alloc(GFP_KERNEL, n);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_bdev = zram->bdev;
+	bio->bi_sector = blk << SECTORS_PER_PAGE_SHIFT;
+	for (added = 0; added < n; added++)
+		if (bio_add_page(bio, pages[added], PAGE_SIZE, 0) != PAGE_SIZE)
+			break;
+
+	ret = added ? submit_bio_wait(WRITE, bio) : -EIO;
+	bio_put(bio);
+
+	for (i = 0; i < n; i++) {
+		size_t index = slots[i];
+
+		down_write(&zram->lock);
+		if (!ret && i < added &&
+		    zram_test_flag(meta, index, ZRAM_UNDER_WB)) {
+			zram_free_page(zram, index);
+			meta->table[index].handle = blk + i;
+			zram_set_flag(meta, index, ZRAM_WB);
+			zram->stats.pages_wb++;
+		} else {
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			zram_wb_free_blocks(zram, blk + i, 1);
+		}
+		up_write(&zram->lock);
+	}
+
+	if (!ret)
+		atomic64_add(added, &zram->stats.bd_writes);
+
+	return ret;
+}
+
+static int zram_writeback(struct zram *zram, bool idle)
+{
+	struct page *pages[ZRAM_WB_BATCH_PAGES] = { NULL };
+	size_t slots[ZRAM_WB_BATCH_PAGES];
+	size_t index = 0, nr_slots = zram->disksize >> PAGE_SHIFT;
+	unsigned int i, n, count;
+	unsigned long blk;
+	int ret = 0;
+
+	for (i = 0; i < ZRAM_WB_BATCH_PAGES; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	while (index < nr_slots) {
+		count = ZRAM_WB_BATCH_PAGES;
+		blk = zram_wb_alloc_blocks(zram, &count);
+		if (!count) {
+			ret = -ENOSPC;
+			break;
+		}
+
+		for (n = 0; n < count && index < nr_slots; index++)
+			if (zram_wb_get_slot(zram, index, idle,
+					     page_address(pages[n])))
+				slots[n++] = index;
+
+		if (n < count)
+			zram_wb_free_blocks(zram, blk + n, count - n);
+		if (!n)
+			break;
+
+		ret = zram_wb_write_batch(zram, pages, slots, n, blk);
+		if (ret)
+			break;
+
+		cond_resched();
+	}
+
+out:
+	for (i = 0; i < ZRAM_WB_BATCH_PAGES; i++)
+		if (pages[i])
+			__free_page(pages[i]);
+
+	return ret;
+}
+
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool idle;
+	int ret;
+
+	if (sysfs_streq(buf, "idle"))
+		idle = true;
+	else if (sysfs_streq(buf, "huge"))
+		idle = false;
+	else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done)
+		ret = -EINVAL;
+	else if (!zram->backing_dev)
+		ret = -ENODEV;
+	else
+		ret = zram_writeback(zram, idle);
+	up_read(&zram->init_lock);
+
+	return ret ? ret : len;
+}
+
+static ssize_t bd_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%8u %8llu %8llu\n", zram->stats.pages_wb,
+			(u64)atomic64_read(&zram->stats.bd_reads),
+			(u64)atomic64_read(&zram->stats.bd_writes));
+}
+#endif
+
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%d\n", zram->use_dedup);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (strtobool(buf, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		up_write(&zram->init_lock);
+		pr_info("Cannot change dedup for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t comp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t sz = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(zram_compressors); i++) {
+		const struct zram_compressor *comp = &zram_compressors[i];
+
+		if (comp == zram->comp)
+			sz += sprintf(buf + sz, "[%s] ", comp->name);
+		else
+			sz += sprintf(buf + sz, "%s ", comp->name);
+	}
+	sz += sprintf(buf + sz, "\n");
+
+	return sz;
+}
+
+static ssize_t comp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(zram_compressors); i++)
+		if (sysfs_streq(buf, zram_compressors[i].name))
+			break;
+
+	if (i == ARRAY_SIZE(zram_compressors))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		up_write(&zram->init_lock);
+		pr_info("Cannot change compression algorithm for initialized device\n");
+		return -EBUSY;
+	}
+	zram->comp = &zram_compressors[i];
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
 static ssize_t reset_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
@@ -723,6 +1741,7 @@ static void __zram_make_request(struct zram *zram, struct bio *bio, int rw)
 	int i, offset;
 	u32 index;
 	struct bio_vec *bvec;
+	struct zram_bio_ctx *ctx = NULL;
 
 	switch (rw) {
 	case READ:
@@ -750,32 +1769,67 @@ static void __zram_make_request(struct zram *zram, struct bio *bio, int rw)
 			bv.bv_len = max_transfer_size;
 			bv.bv_offset = bvec->bv_offset;
 
-			if (zram_bvec_rw(zram, &bv, index, offset, bio, rw) < 0)
+			if (zram_bvec_rw(zram, &bv, index, offset, bio, rw,
+					 &ctx) < 0)
 				goto out;
 
 			bv.bv_len = bvec->bv_len - max_transfer_size;
 			bv.bv_offset += max_transfer_size;
-			if (zram_bvec_rw(zram, &bv, index+1, 0, bio, rw) < 0)
+			if (zram_bvec_rw(zram, &bv, index+1, 0, bio, rw,
+					 &ctx) < 0)
 				goto out;
 		} else
-			if (zram_bvec_rw(zram, bvec, index, offset, bio, rw)
-			    < 0)
+			if (zram_bvec_rw(zram, bvec, index, offset, bio, rw,
+					 &ctx) < 0)
 				goto out;
 
 		update_position(&index, &offset, bvec);
 	}
 
+	/* Some pages are still being read from the backing device */
+	if (ctx) {
+		zram_bio_ctx_put(ctx);
+		return;
+	}
+
 	set_bit(BIO_UPTODATE, &bio->bi_flags);
 	bio_endio(bio, 0);
 	return;
 
 out:
+	if (ctx) {
+		ctx->error = -EIO;
+		zram_bio_ctx_put(ctx);
+		return;
+	}
 	bio_io_error(bio);
 }
 
 /*
  * Handler function for all zram I/O requests.
  */
+static void zram_readahead_work(struct work_struct *work)
+{
+	struct zram *zram = container_of(work, struct zram, ra_work);
+	struct bio_list bios;
+	struct bio *bio;
+
+	spin_lock(&zram->ra_lock);
+	bios = zram->ra_bios;
+	bio_list_init(&zram->ra_bios);
+	spin_unlock(&zram->ra_lock);
+
+	while ((bio = bio_list_pop(&bios))) {
+		down_read(&zram->init_lock);
+		/* The device may have been reset since the bio was queued */
+		if (likely(zram->init_done))
+			__zram_make_request(zram, bio, READ);
+		else
+			bio_io_error(bio);
+		up_read(&zram->init_lock);
+	}
+}
+
 static void zram_make_request(struct request_queue *queue, struct bio *bio)
 {
 	struct zram *zram = queue->queuedata;
@@ -789,6 +1843,19 @@ static void zram_make_request(struct request_queue *queue, struct bio *bio)
 		goto error;
 	}
 
+	/*
+	 * Nobody waits on readahead yet, so leave decompressing it to a
+	 * worker and let the submitter go on to the page it faulted on.
+	 */
+	if (bio_data_dir(bio) == READ && (bio->bi_rw & REQ_RAHEAD)) {
+		spin_lock(&zram->ra_lock);
+		bio_list_add(&zram->ra_bios, bio);
+		spin_unlock(&zram->ra_lock);
+		queue_work(system_unbound_wq, &zram->ra_work);
+		up_read(&zram->init_lock);
+		return;
+	}
+
 	__zram_make_request(zram, bio, bio_data_dir(bio));
 	up_read(&zram->init_lock);
 
@@ -844,27 +1911,57 @@ static DEVICE_ATTR(disksize, S_IRUGO | S_IWUSR,
 		disksize_show, disksize_store);
 static DEVICE_ATTR(initstate, S_IRUGO, initstate_show, NULL);
 static DEVICE_ATTR(reset, S_IWUSR, NULL, reset_store);
+static DEVICE_ATTR(max_comp_streams, S_IRUGO | S_IWUSR,
+		max_comp_streams_show, max_comp_streams_store);
+static DEVICE_ATTR(comp_algorithm, S_IRUGO | S_IWUSR,
+		comp_algorithm_show, comp_algorithm_store);
+static DEVICE_ATTR(use_dedup, S_IRUGO | S_IWUSR,
+		use_dedup_show, use_dedup_store);
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR(backing_dev, S_IRUGO | S_IWUSR,
+		backing_dev_show, backing_dev_store);
+static DEVICE_ATTR(idle, S_IWUSR, NULL, idle_store);
+static DEVICE_ATTR(writeback, S_IWUSR, NULL, writeback_store);
+static DEVICE_ATTR(bd_stat, S_IRUGO, bd_stat_show, NULL);
+#endif
 static DEVICE_ATTR(num_reads, S_IRUGO, num_reads_show, NULL);
 static DEVICE_ATTR(num_writes, S_IRUGO, num_writes_show, NULL);
 static DEVICE_ATTR(invalid_io, S_IRUGO, invalid_io_show, NULL);
 static DEVICE_ATTR(notify_free, S_IRUGO, notify_free_show, NULL);
 static DEVICE_ATTR(zero_pages, S_IRUGO, zero_pages_show, NULL);
+static DEVICE_ATTR(same_pages, S_IRUGO, same_pages_show, NULL);
+static DEVICE_ATTR(dup_data_size, S_IRUGO, dup_data_size_show, NULL);
 static DEVICE_ATTR(orig_data_size, S_IRUGO, orig_data_size_show, NULL);
 static DEVICE_ATTR(compr_data_size, S_IRUGO, compr_data_size_show, NULL);
 static DEVICE_ATTR(mem_used_total, S_IRUGO, mem_used_total_show, NULL);
+static DEVICE_ATTR(pages_compacted, S_IRUGO, pages_compacted_show, NULL);
+static DEVICE_ATTR(compact, S_IWUSR, NULL, compact_store);
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
 	&dev_attr_initstate.attr,
 	&dev_attr_reset.attr,
+	&dev_attr_max_comp_streams.attr,
+	&dev_attr_comp_algorithm.attr,
+	&dev_attr_use_dedup.attr,
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_bd_stat.attr,
+#endif
 	&dev_attr_num_reads.attr,
 	&dev_attr_num_writes.attr,
 	&dev_attr_invalid_io.attr,
 	&dev_attr_notify_free.attr,
 	&dev_attr_zero_pages.attr,
+	&dev_attr_same_pages.attr,
+	&dev_attr_dup_data_size.attr,
 	&dev_attr_orig_data_size.attr,
 	&dev_attr_compr_data_size.attr,
 	&dev_attr_mem_used_total.attr,
+	&dev_attr_pages_compacted.attr,
+	&dev_attr_compact.attr,
 	NULL,
 };
 
@@ -872,6 +1969,52 @@ static struct attribute_group zram_disk_attr_group = {
 	.attrs = zram_disk_attrs,
 };
 
+static struct dentry *zram_debugfs_root;
+
+static int zram_classes_show(struct seq_file *s, void *v)
+{
+	struct zram *zram = s->private;
+	struct zs_class_stats stats;
+	int i;
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done) {
+		up_read(&zram->init_lock);
+		return 0;
+	}
+
+	seq_printf(s, "%5s %5s %11s %12s %13s %10s %10s %16s\n",
+			"class", "size", "almost_full", "almost_empty",
+			"obj_allocated", "obj_used", "pages_used",
+			"pages_per_zspage");
+	for (i = 0; !zs_get_class_stats(zram->meta->mem_pool, i, &stats);
+			i++) {
+		if (!stats.pages_used)
+			continue;
+
+		seq_printf(s, "%5d %5d %11lu %12lu %13lu %10lu %10lu %16d\n",
+				i, stats.size, stats.almost_full,
+				stats.almost_empty, stats.obj_allocated,
+				stats.obj_used, stats.pages_used,
+				stats.pages_per_zspage);
+	}
+	up_read(&zram->init_lock);
+
+	return 0;
+}
+
+static int zram_classes_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zram_classes_show, inode->i_private);
+}
+
+static const struct file_operations zram_classes_fops = {
+	.open = zram_classes_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int create_device(struct zram *zram, int device_id)
 {
 	int ret = -ENOMEM;
@@ -880,8 +2023,16 @@ static int create_device(struct zram *zram, int device_id)
 	init_rwsem(&zram->init_lock);
 
 	INIT_WORK(&zram->free_work, zram_slot_free);
+	INIT_WORK(&zram->ra_work, zram_readahead_work);
+	bio_list_init(&zram->ra_bios);
+	spin_lock_init(&zram->ra_lock);
 	spin_lock_init(&zram->slot_free_lock);
 	zram->slot_free_rq = NULL;
+	zram->max_comp_streams = num_online_cpus();
+	zram->comp = &zram_compressors[0];
+#ifdef CONFIG_ZRAM_WRITEBACK
+	spin_lock_init(&zram->bitmap_lock);
+#endif
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -909,6 +2060,9 @@ static int create_device(struct zram *zram, int device_id)
 	snprintf(zram->disk->disk_name, 16, "zram%d", device_id);
 
 	__set_bit(QUEUE_FLAG_FAST, &zram->queue->queue_flags);
+	/* No seek cost, and compressed RAM is no source of entropy */
+	__set_bit(QUEUE_FLAG_NONROT, &zram->queue->queue_flags);
+	__clear_bit(QUEUE_FLAG_ADD_RANDOM, &zram->queue->queue_flags);
 	/* Actual capacity set using syfs (/sys/block/zram<id>/disksize */
 	set_capacity(zram->disk, 0);
 
@@ -931,6 +2085,12 @@ static int create_device(struct zram *zram, int device_id)
 		goto out_free_disk;
 	}
 
+	/* Statistics only, zram works without them */
+	if (!IS_ERR_OR_NULL(zram_debugfs_root))
+		zram->debugfs_file = debugfs_create_file(zram->disk->disk_name,
+				S_IRUGO, zram_debugfs_root, zram,
+				&zram_classes_fops);
+
 	zram->init_done = 0;
 	return 0;
 
@@ -945,6 +2105,9 @@ out:
 
 static void destroy_device(struct zram *zram)
 {
+	debugfs_remove(zram->debugfs_file);
+	zram->debugfs_file = NULL;
+
 	sysfs_remove_group(&disk_to_dev(zram->disk)->kobj,
 			&zram_disk_attr_group);
 
@@ -975,6 +2138,8 @@ static int __init zram_init(void)
 		goto out;
 	}
 
+	zram_debugfs_root = debugfs_create_dir("zram", NULL);
+
 	/* Allocate the device array and initialize each one */
 	zram_devices = kzalloc(num_devices * sizeof(struct zram), GFP_KERNEL);
 	if (!zram_devices) {
@@ -998,6 +2163,7 @@ free_devices:
 		destroy_device(&zram_devices[--dev_id]);
 	kfree(zram_devices);
 unregister:
+	debugfs_remove(zram_debugfs_root);
 	unregister_blkdev(zram_major, "zram");
 out:
 	return ret;
@@ -1020,6 +2186,7 @@ static void __exit zram_exit(void)
 		zram_reset_device(zram, false);
 	}
 
+	debugfs_remove(zram_debugfs_root);
 	unregister_blkdev(zram_major, "zram");
 
 	kfree(zram_devices);
@@ -17,6 +17,8 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/rbtree.h>
 
 #include "../zsmalloc/zsmalloc.h"
 
@@ -55,6 +57,14 @@ static const size_t max_zpage_size = PAGE_SIZE / 10 * 9;
 enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO,
+	/* Page is filled with table[page_no].element, no memory allocated */
+	ZRAM_SAME,
+	/* Page is on the backing device, at block table[page_no].handle */
+	ZRAM_WB,
+	/* Page is being written to the backing device */
+	ZRAM_UNDER_WB,
+	/* Page not accessed since it was last marked through sysfs idle */
+	ZRAM_IDLE,
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -63,7 +73,10 @@ enum zram_pageflags {
 
 /* Allocated for each disk page */
 struct table {
-	unsigned long handle;
+	union {
+		unsigned long handle;
+		unsigned long element;	/* for ZRAM_SAME pages */
+	};
 	u16 size;	/* object size (excluding header) */
 	u8 count;	/* object ref count (not yet used) */
 	u8 flags;
@@ -81,17 +94,70 @@ struct zram_stats {
 	atomic64_t failed_writes;	/* can happen when memory is too low */
 	atomic64_t invalid_io;	/* non-page-aligned I/O requests */
 	atomic64_t notify_free;	/* no. of swap slot free notifications */
+	atomic64_t dup_data_size;	/* compressed bytes saved by dedup */
 	u32 pages_zero;		/* no. of zero filled pages */
+	u32 pages_same;		/* no. of non-zero same filled pages */
+	u32 pages_wb;		/* no. of pages on the backing device */
+	atomic64_t bd_reads;	/* pages read from the backing device */
+	atomic64_t bd_writes;	/* pages written to the backing device */
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 bad_compress;	/* % of pages with compression ratio>=75% */
 };
 
+/* A compression algorithm a device can use */
+struct zram_compressor {
+	const char *name;
+	size_t workmem_size;
+	int (*compress)(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len, void *workmem);
+	/* Must never access memory outside of src and dst */
+	int (*decompress)(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len);
+};
+
+/*
+ * A compressed object shared by all the slots holding the same data when
+ * deduplication is enabled, table[].handle then points to the entry.
+ */
+struct zram_dedup_entry {
+	struct rb_node node;	/* in zram_meta.dedup_tree, by checksum */
+	unsigned long handle;
+	u32 checksum;
+	u16 len;
+	unsigned int refcount;	/* protected by zram_meta.dedup_lock */
+};
+
+/*
+ * Completes a read bio once all of its pages that have been written back
+ * are read from the backing device.
+ */
+struct zram_bio_ctx {
+	struct bio *parent;
+	atomic_t pending;
+	int error;
+};
+
+/* Working memory and output buffer of one compression in flight */
+struct zram_comp_strm {
+	void *workmem;
+	void *buffer;
+	struct list_head list;
+};
+
 struct zram_meta {
-	void *compress_workmem;
-	void *compress_buffer;
 	struct table *table;
 	struct zs_pool *mem_pool;
+
+	/* Compression streams not in use, protected by strm_lock */
+	struct list_head idle_strm;
+	spinlock_t strm_lock;
+	wait_queue_head_t strm_wait;
+	int num_strm;
+
+	bool use_dedup;
+	struct rb_root dedup_tree;
+	spinlock_t dedup_lock;
 };
 
 struct zram_slot_free {
@@ -101,13 +167,18 @@ struct zram_slot_free {
 
 struct zram {
 	struct zram_meta *meta;
-	struct rw_semaphore lock; /* protect compression buffers, table,
-				   * 32bit stat counters against concurrent
-				   * notifications, reads and writes */
+	struct rw_semaphore lock; /* protect table and 32bit stat counters
+				   * against concurrent notifications, reads
+				   * and writes */
 
 	struct work_struct free_work;  /* handle pending free request */
 	struct zram_slot_free *slot_free_rq; /* list head of free request */
 
+	/* Readahead bios, decompressed off the submitting thread */
+	struct work_struct ra_work;
+	struct bio_list ra_bios;
+	spinlock_t ra_lock;
+
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -118,8 +189,25 @@ struct zram {
 	 * we can store in a disk.
 	 */
 	u64 disksize;	/* bytes */
+	/* Number of writes that can be compressed in parallel */
+	int max_comp_streams;
+	/* Compression algorithm, only changed while not initialized */
+	const struct zram_compressor *comp;
+	/* Share the objects of identical compressed pages */
+	bool use_dedup;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	/* Only changed while not initialized */
+	struct file *backing_dev;
+	struct block_device *bdev;
+	unsigned long nr_blocks;	/* PAGE_SIZE blocks of bdev */
+	unsigned long *bitmap;		/* blocks in use */
+	spinlock_t bitmap_lock;
+#endif
 	spinlock_t slot_free_lock;
 
+	/* Per size class zsmalloc stats, in the zram debugfs directory */
+	struct dentry *debugfs_file;
+
 	struct zram_stats stats;
 };
 #endif
@@ -40,4 +40,24 @@ void zs_unmap_object(struct zs_pool *pool, unsigned long handle);
 
 u64 zs_get_total_size_bytes(struct zs_pool *pool);
 
+/*
+ * State of one size class, see zs_get_class_stats(). Zspages that are
+ * empty or full are only accounted in obj_allocated and pages_used.
+ */
+struct zs_class_stats {
+	int size;
+	int pages_per_zspage;
+	unsigned long almost_full;	/* zspages in ZS_ALMOST_FULL */
+	unsigned long almost_empty;	/* zspages in ZS_ALMOST_EMPTY */
+	unsigned long obj_allocated;	/* object slots in all zspages */
+	unsigned long obj_used;
+	unsigned long pages_used;
+};
+
+int zs_get_class_stats(struct zs_pool *pool, int index,
+			struct zs_class_stats *stats);
+
+unsigned long zs_compact(struct zs_pool *pool);
+unsigned long zs_get_pages_compacted(struct zs_pool *pool);
+
 #endif
@@ -40,6 +40,7 @@
 #include <soc/qcom/rpm-smd.h>
 #include <soc/qcom/scm.h>
 #include <linux/sched/rt.h>
+#include <linux/ktime.h>
 
 #define CREATE_TRACE_POINTS
 #define TRACE_MSM_THERMAL
@@ -124,6 +125,22 @@ static struct regulator *vdd_mx;
 static struct cpufreq_frequency_table *pending_freq_table_ptr;
 static int pending_cpu_freq = -1;
 static long *tsens_temp_at_panic;
+static bool predictive_mitigation;
+static uint32_t pred_horizon_ms = 1000;
+static uint32_t pred_tau_ms = 5000;
+static long last_temp_mdegc;
+static s64 last_temp_ms;
+static long temp_rate;
+static bool temp_rate_valid;
+static struct freq_model *limit_model;
+
+module_param(predictive_mitigation, bool, 0644);
+MODULE_PARM_DESC(predictive_mitigation,
+	"cap cpu frequency on the predicted temperature while polling");
+module_param(pred_horizon_ms, uint, 0644);
+MODULE_PARM_DESC(pred_horizon_ms, "temperature prediction horizon in ms");
+module_param(pred_tau_ms, uint, 0644);
+MODULE_PARM_DESC(pred_tau_ms, "thermal time constant of the cpu in ms");
 
 static LIST_HEAD(devices_list);
 static LIST_HEAD(thresholds_list);
@@ -135,12 +152,22 @@ enum thermal_threshold {
 	THRESHOLD_MAX_NR,
 };
 
+/*
+ * Steady state temperature, in millidegC, the temperature was heading to
+ * while the cluster was capped at a given frequency.
+ */
+struct freq_model {
+	long temp_ss;
+	uint32_t samples;
+};
+
 struct cluster_info {
 	int cluster_id;
 	uint32_t entity_count;
 	struct cluster_info *child_entity_ptr;
 	struct cluster_info *parent_ptr;
 	struct cpufreq_frequency_table *freq_table;
+	struct freq_model *freq_model;
 	int freq_idx;
 	int freq_idx_low;
 	int freq_idx_high;
@@ -979,6 +1006,13 @@ static int __ref init_cluster_freq_table(void)
 		for (idx = 0; idx < table_len; idx++)
 			cluster_ptr->freq_table[idx].frequency =
 				freq_table_ptr[idx].frequency;
+		cluster_ptr->freq_model = devm_kzalloc(
+			&msm_thermal_info.pdev->dev,
+			sizeof(struct freq_model) * table_len,
+			GFP_KERNEL);
+		if (!cluster_ptr->freq_model)
+			pr_err("Cluster%d freq model alloc failed\n",
+				cluster_ptr->cluster_id);
 	}
 
 	return ret;
@@ -1026,6 +1060,106 @@ static void update_cluster_freq(void)
 	}
 }
 
+static void update_temp_rate(long temp)
+{
+	s64 now = ktime_to_ms(ktime_get());
+	long temp_mdegc = temp * 1000;
+	long rate = 0;
+
+	if (last_temp_ms && now > last_temp_ms) {
+		rate = div_s64((s64)(temp_mdegc - last_temp_mdegc) * 1000,
+				(s32)min_t(s64, now - last_temp_ms, INT_MAX));
+		if (temp_rate_valid)
+			temp_rate += (rate - temp_rate) / 4;
+		else
+			temp_rate = rate;
+		temp_rate_valid = true;
+	}
+	last_temp_mdegc = temp_mdegc;
+	last_temp_ms = now;
+}
+
+/*
+ * Fold the steady state temperature implied by the current rate of rise
+ * into the model of the frequency level the cluster is capped at. The
+ * gap between two levels is a property of the silicon while the absolute
+ * temperature follows the workload, so the other learned levels are
+ * shifted by the same amount.
+ */
+static void update_freq_model(struct freq_model *model, int idx,
+				int low, int high, long temp_ss)
+{
+	long delta = 0;
+	int i = 0;
+
+	if (!model[idx].samples) {
+		model[idx].temp_ss = temp_ss;
+		model[idx].samples = 1;
+		return;
+	}
+
+	delta = (temp_ss - model[idx].temp_ss) / 4;
+	for (i = low; i <= high; i++)
+		if (model[i].samples)
+			model[i].temp_ss += delta;
+	if (model[idx].samples < UINT_MAX)
+		model[idx].samples++;
+}
+
+/*
+ * Highest frequency level below the first one that is known to settle
+ * above the limit. Levels that were never visited are assumed to be
+ * sustainable until proven otherwise.
+ */
+static int sustainable_freq_idx(struct freq_model *model, int low, int high,
+				long limit_mdegc)
+{
+	int idx = low;
+
+	if (!model)
+		return high;
+
+	for (; idx <= high; idx++)
+		if (model[idx].samples && model[idx].temp_ss >= limit_mdegc)
+			break;
+
+	return max(low, idx - 1);
+}
+
+/*
+ * Pick the frequency cap from the temperature predicted pred_horizon_ms
+ * ahead instead of the current one, and go straight to the highest
+ * sustainable level rather than stepping down after an overshoot.
+ */
+static int predict_freq_idx(struct freq_model *model, int idx, int low,
+				int high, long temp)
+{
+	long limit_mdegc = msm_thermal_info.limit_temp_degC * 1000;
+	long hyst_mdegc = msm_thermal_info.temp_hysteresis_degC * 1000;
+	long temp_mdegc = temp * 1000, temp_pred = temp_mdegc;
+	int sustainable = 0;
+
+	if (temp_rate_valid) {
+		temp_pred += div_s64((s64)temp_rate * pred_horizon_ms, 1000);
+		if (model)
+			update_freq_model(model, idx, low, high, temp_mdegc +
+				div_s64((s64)temp_rate * pred_tau_ms, 1000));
+	}
+	sustainable = sustainable_freq_idx(model, low, high, limit_mdegc);
+
+	if (temp_mdegc >= limit_mdegc || temp_pred >= limit_mdegc)
+		idx = min(sustainable,
+			idx - (int)msm_thermal_info.bootup_freq_step);
+	else if (temp_mdegc < limit_mdegc - hyst_mdegc &&
+		temp_pred < limit_mdegc - hyst_mdegc)
+		idx = min(sustainable,
+			idx + (int)msm_thermal_info.bootup_freq_step);
+	else
+		idx = min(sustainable, idx);
+
+	return clamp(idx, low, high);
+}
+
 static void do_cluster_freq_ctrl(long temp)
 {
 	uint32_t _cluster = 0;
@@ -1033,7 +1167,9 @@ static void do_cluster_freq_ctrl(long temp)
 	bool mitigate = false;
 	struct cluster_info *cluster_ptr = NULL;
 
-	if (temp >= msm_thermal_info.limit_temp_degC)
+	if (predictive_mitigation)
+		mitigate = false;
+	else if (temp >= msm_thermal_info.limit_temp_degC)
 		mitigate = true;
 	else if (temp < msm_thermal_info.limit_temp_degC -
 		 msm_thermal_info.temp_hysteresis_degC)
@@ -1047,7 +1183,12 @@ static void do_cluster_freq_ctrl(long temp)
 		if (!cluster_ptr->freq_table)
 			continue;
 
-		if (mitigate)
+		if (predictive_mitigation)
+			freq_idx = predict_freq_idx(cluster_ptr->freq_model,
+				cluster_ptr->freq_idx,
+				cluster_ptr->freq_idx_low,
+				cluster_ptr->freq_idx_high, temp);
+		else if (mitigate)
 			freq_idx = max_t(int, cluster_ptr->freq_idx_low,
 				(cluster_ptr->freq_idx
 				- msm_thermal_info.bootup_freq_step));
@@ -1114,6 +1255,10 @@ static int check_freq_table(void)
 		WARN(1, "CPU0 frequency table length:%d\n", i);
 		return -EINVAL;
 	}
+	limit_model = devm_kzalloc(&msm_thermal_info.pdev->dev,
+			sizeof(struct freq_model) * i, GFP_KERNEL);
+	if (!limit_model)
+		pr_err("CPU0 freq model alloc failed\n");
 	freq_table_get = 1;
 
 	return 0;
@@ -2618,13 +2763,26 @@ static void do_freq_control(long temp)
 {
 	uint32_t cpu = 0;
 	uint32_t max_freq = cpus[cpu].limited_max_freq;
+	int freq_idx = 0;
 
+	update_temp_rate(temp);
 	if (core_ptr)
 		return do_cluster_freq_ctrl(temp);
 	if (!freq_table_get)
 		return;
 
-	if (temp >= msm_thermal_info.limit_temp_degC) {
+	if (predictive_mitigation) {
+		freq_idx = predict_freq_idx(limit_model, limit_idx,
+				limit_idx_low, limit_idx_high, temp);
+		if (freq_idx == limit_idx)
+			return;
+
+		limit_idx = freq_idx;
+		if (limit_idx >= limit_idx_high)
+			max_freq = UINT_MAX;
+		else
+			max_freq = table[limit_idx].frequency;
+	} else if (temp >= msm_thermal_info.limit_temp_degC) {
 		if (limit_idx == limit_idx_low)
 			return;
 
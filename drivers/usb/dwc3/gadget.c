@@ -288,8 +288,12 @@ resize_fifo:
 	return 0;
 }
 
-void dwc3_gadget_giveback(struct dwc3_ep *dep, struct dwc3_request *req,
-		int status)
+/*
+ * Return the TRBs of @req to the pool and unmap it, leaving only the
+ * completion callback to be called.
+ */
+static void dwc3_gadget_giveback_prep(struct dwc3_ep *dep,
+		struct dwc3_request *req, int status)
 {
 	struct dwc3			*dwc = dep->dwc;
 	int				i;
@@ -336,11 +340,41 @@ void dwc3_gadget_giveback(struct dwc3_ep *dep, struct dwc3_request *req,
 			req->request.length, status);
 
 	dbg_done(dep->number, req->request.actual, req->request.status);
+}
+
+void dwc3_gadget_giveback(struct dwc3_ep *dep, struct dwc3_request *req,
+		int status)
+{
+	struct dwc3			*dwc = dep->dwc;
+
+	dwc3_gadget_giveback_prep(dep, req, status);
 	spin_unlock(&dwc->lock);
 	req->request.complete(&dep->endpoint, &req->request);
 	spin_lock(&dwc->lock);
 }
 
+/*
+ * Complete all requests of @done, which dwc3_gadget_giveback_prep() has
+ * already been called for, dropping dwc->lock only once for the batch.
+ */
+static void dwc3_gadget_giveback_list(struct dwc3_ep *dep,
+		struct list_head *done)
+{
+	struct dwc3			*dwc = dep->dwc;
+	struct dwc3_request		*req;
+
+	if (list_empty(done))
+		return;
+
+	spin_unlock(&dwc->lock);
+	while (!list_empty(done)) {
+		req = list_first_entry(done, struct dwc3_request, list);
+		list_del(&req->list);
+		req->request.complete(&dep->endpoint, &req->request);
+	}
+	spin_lock(&dwc->lock);
+}
+
 static const char *dwc3_gadget_ep_cmd_string(u8 cmd)
 {
 	switch (cmd) {
@@ -2475,8 +2509,9 @@ static int __dwc3_cleanup_done_trbs(struct dwc3 *dwc, struct dwc3_ep *dep,
 	return 0;
 }
 
-static int dwc3_cleanup_done_reqs(struct dwc3 *dwc, struct dwc3_ep *dep,
-		const struct dwc3_event_depevt *event, int status)
+static int __dwc3_cleanup_done_reqs(struct dwc3 *dwc, struct dwc3_ep *dep,
+		const struct dwc3_event_depevt *event, int status,
+		struct list_head *done)
 {
 	struct dwc3_request	*req;
 	struct dwc3_trb		*trb;
@@ -2526,14 +2561,8 @@ static int dwc3_cleanup_done_reqs(struct dwc3 *dwc, struct dwc3_ep *dep,
 					(trb->ctrl & DWC3_TRB_CTRL_IOC))
 				ret = 1;
 		}
-		dwc3_gadget_giveback(dep, req, status);
-
-		/* EP possibly disabled during giveback? */
-		if (!(dep->flags & DWC3_EP_ENABLED)) {
-			dev_dbg(dwc->dev, "%s disabled while handling ep event\n",
-					dep->name);
-			return 0;
-		}
+		dwc3_gadget_giveback_prep(dep, req, status);
+		list_add_tail(&req->list, done);
 
 		if (ret)
 			break;
@@ -2563,6 +2592,29 @@ static int dwc3_cleanup_done_reqs(struct dwc3 *dwc, struct dwc3_ep *dep,
 	return 1;
 }
 
+/*
+ * All requests finished by one event are given back together once the
+ * endpoint state is updated, rather than dropping the lock after each.
+ */
+static int dwc3_cleanup_done_reqs(struct dwc3 *dwc, struct dwc3_ep *dep,
+		const struct dwc3_event_depevt *event, int status)
+{
+	LIST_HEAD(done);
+	int			ret;
+
+	ret = __dwc3_cleanup_done_reqs(dwc, dep, event, status, &done);
+	dwc3_gadget_giveback_list(dep, &done);
+
+	/* EP possibly disabled during giveback? */
+	if (!(dep->flags & DWC3_EP_ENABLED)) {
+		dev_dbg(dwc->dev, "%s disabled while handling ep event\n",
+				dep->name);
+		return 0;
+	}
+
+	return ret;
+}
+
 static void dwc3_endpoint_transfer_complete(struct dwc3 *dwc,
 		struct dwc3_ep *dep, const struct dwc3_event_depevt *event,
 		int start_new)
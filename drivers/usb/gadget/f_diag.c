@@ -160,6 +160,8 @@ struct diag_context {
 	unsigned long dpkts_tolaptop;
 	unsigned long dpkts_tomodem;
 	unsigned dpkts_tolaptop_pending;
+	/* write requests allocated on demand beyond usb_diag_alloc_req() */
+	unsigned long write_reqs_grown;
 
 	/* A list node inside the diag_dev_list */
 	struct list_head list_item;
@@ -507,13 +509,26 @@ int usb_diag_write(struct usb_diag_ch *ch, struct diag_request *d_req)
 	in = ctxt->in;
 
 	if (list_empty(&ctxt->write_pool)) {
-		spin_unlock_irqrestore(&ctxt->lock, flags);
-		ERROR(ctxt->cdev, "%s: no requests available\n", __func__);
-		return -EAGAIN;
+		/*
+		 * The client is writing faster than the host drains the
+		 * pool; grow it rather than drop the data.  The request
+		 * joins the pool on completion and is freed with it.
+		 */
+		req = usb_ep_alloc_request(in, GFP_ATOMIC);
+		if (!req) {
+			spin_unlock_irqrestore(&ctxt->lock, flags);
+			ERROR(ctxt->cdev, "%s: no requests available\n",
+								__func__);
+			return -EAGAIN;
+		}
+		kmemleak_not_leak(req);
+		req->complete = diag_write_complete;
+		ctxt->write_reqs_grown++;
+	} else {
+		req = list_first_entry(&ctxt->write_pool, struct usb_request,
+									list);
+		list_del(&req->list);
 	}
-
-	req = list_first_entry(&ctxt->write_pool, struct usb_request, list);
-	list_del(&req->list);
 	spin_unlock_irqrestore(&ctxt->lock, flags);
 
 	req->buf = d_req->buf;
@@ -794,12 +809,14 @@ static ssize_t debug_read_stats(struct file *file, char __user *ubuf,
 					"endpoints: %s, %s\n"
 					"dpkts_tolaptop: %lu\n"
 					"dpkts_tomodem:  %lu\n"
-					"pkts_tolaptop_pending: %u\n",
+					"pkts_tolaptop_pending: %u\n"
+					"write_reqs_grown: %lu\n",
 					ch->name,
 					ctxt->in->name, ctxt->out->name,
 					ctxt->dpkts_tolaptop,
 					ctxt->dpkts_tomodem,
-					ctxt->dpkts_tolaptop_pending);
+					ctxt->dpkts_tolaptop_pending,
+					ctxt->write_reqs_grown);
 	}
 
 	return simple_read_from_buffer(ubuf, count, ppos, buf, temp);
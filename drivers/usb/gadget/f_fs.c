@@ -22,6 +22,9 @@
 #include <linux/pagemap.h>
 #include <linux/export.h>
 #include <linux/hid.h>
+#include <linux/aio.h>
+#include <linux/uio.h>
+#include <linux/mmu_context.h>
 #include <asm/unaligned.h>
 
 #include <linux/usb/composite.h>
@@ -970,6 +973,230 @@ ffs_epfile_read(struct file *file, char __user *buf, size_t len, loff_t *ptr)
 	return ffs_epfile_io(file, buf, len, 1);
 }
 
+/*
+ * Asynchronous I/O: every kiocb gets its own usb_request, so several of
+ * them can be queued on an endpoint at once, and the iovec is gathered
+ * into (or scattered from) a single transfer buffer.
+ */
+struct ffs_aio_data {
+	struct kiocb		*kiocb;
+	struct ffs_epfile	*epfile;
+	struct usb_ep		*ep;
+	struct usb_request	*req;	/* P: ffs->eps_lock */
+	const struct iovec	*iovec;
+	unsigned long		nr_segs;
+	char			*buf;
+	int			read;
+	ssize_t			status;
+	struct mm_struct	*mm;
+	struct work_struct	work;
+};
+
+static ssize_t ffs_aio_copy_to_user(struct ffs_aio_data *aio, size_t total)
+{
+	char *from = aio->buf;
+	ssize_t len = 0;
+	unsigned long i;
+
+	for (i = 0; i < aio->nr_segs && total; i++) {
+		size_t this = min(aio->iovec[i].iov_len, total);
+
+		if (copy_to_user(aio->iovec[i].iov_base, from, this))
+			return len ? len : -EFAULT;
+
+		total -= this;
+		len += this;
+		from += this;
+	}
+
+	return len;
+}
+
+static void ffs_aio_complete_work(struct work_struct *work)
+{
+	struct ffs_aio_data *aio = container_of(work, struct ffs_aio_data,
+						work);
+	struct ffs_data *ffs = aio->epfile->ffs;
+	struct usb_request *req;
+	ssize_t ret = aio->status;
+
+	/* Fence off ffs_aio_cancel() before the request goes away */
+	spin_lock_irq(&ffs->eps_lock);
+	req = aio->req;
+	aio->req = NULL;
+	aio->kiocb->private = NULL;
+	spin_unlock_irq(&ffs->eps_lock);
+	usb_ep_free_request(aio->ep, req);
+
+	if (aio->read && ret > 0) {
+		use_mm(aio->mm);
+		ret = ffs_aio_copy_to_user(aio, ret);
+		unuse_mm(aio->mm);
+	}
+
+	/* completing the iocb can drop the ctx and mm, don't touch mm after */
+	aio_complete(aio->kiocb, ret, ret);
+
+	kfree(aio->buf);
+	kfree(aio);
+}
+
+static void ffs_aio_io_complete(struct usb_ep *_ep, struct usb_request *req)
+{
+	struct ffs_aio_data *aio = req->context;
+
+	ENTER();
+
+	aio->status = req->status ? req->status : req->actual;
+	schedule_work(&aio->work);
+}
+
+static int ffs_aio_cancel(struct kiocb *kiocb, struct io_event *e)
+{
+	struct ffs_epfile *epfile = kiocb->ki_filp->private_data;
+	struct ffs_aio_data *aio;
+	int value = -EINVAL;
+
+	ENTER();
+
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	aio = kiocb->private;
+	if (likely(aio && aio->req))
+		value = usb_ep_dequeue(aio->ep, aio->req);
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+
+	aio_put_req(kiocb);
+	return value;
+}
+
+static ssize_t ffs_epfile_aio_io(struct kiocb *kiocb, const struct iovec *iov,
+				 unsigned long nr_segs, int read)
+{
+	struct ffs_epfile *epfile = kiocb->ki_filp->private_data;
+	struct ffs_aio_data *aio;
+	struct usb_request *req;
+	struct ffs_ep *ep;
+	size_t len = iov_length(iov, nr_segs);
+	size_t buffer_len, pos = 0;
+	unsigned long i;
+	ssize_t ret;
+
+	pr_debug("%s: len %zu, segs %lu, read %d\n", __func__, len, nr_segs,
+		 read);
+
+	if (atomic_read(&epfile->error))
+		return -ENODEV;
+	if (WARN_ON(epfile->ffs->state != FFS_ACTIVE))
+		return -ENODEV;
+
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	ep = epfile->ep;
+	if (!ep) {
+		spin_unlock_irq(&epfile->ffs->eps_lock);
+		return -ENODEV;
+	}
+	/* Halting from an async request makes no sense */
+	if (!read == !epfile->in) {
+		spin_unlock_irq(&epfile->ffs->eps_lock);
+		return -EINVAL;
+	}
+	buffer_len = !read ? len :
+		round_up(len, ep->ep->desc->wMaxPacketSize);
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+
+	aio = kzalloc(sizeof(*aio), GFP_KERNEL);
+	if (unlikely(!aio))
+		return -ENOMEM;
+	aio->buf = kzalloc(buffer_len, GFP_KERNEL);
+	if (unlikely(!aio->buf)) {
+		ret = -ENOMEM;
+		goto error;
+	}
+
+	if (!read) {
+		for (i = 0; i < nr_segs; i++) {
+			if (unlikely(copy_from_user(&aio->buf[pos],
+						    iov[i].iov_base,
+						    iov[i].iov_len))) {
+				ret = -EFAULT;
+				goto error;
+			}
+			pos += iov[i].iov_len;
+		}
+	}
+
+	aio->kiocb = kiocb;
+	aio->epfile = epfile;
+	aio->iovec = iov;
+	aio->nr_segs = nr_segs;
+	aio->read = read;
+	aio->mm = current->mm; /* mm teardown waits for iocbs in exit_aio() */
+	INIT_WORK(&aio->work, ffs_aio_complete_work);
+
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	/* Endpoint disabled or changed while we were copying? */
+	if (epfile->ep != ep) {
+		spin_unlock_irq(&epfile->ffs->eps_lock);
+		ret = -ENODEV;
+		goto error;
+	}
+
+	req = usb_ep_alloc_request(ep->ep, GFP_ATOMIC);
+	if (unlikely(!req)) {
+		spin_unlock_irq(&epfile->ffs->eps_lock);
+		ret = -ENOMEM;
+		goto error;
+	}
+	req->buf      = aio->buf;
+	req->length   = buffer_len;
+	req->context  = aio;
+	req->complete = ffs_aio_io_complete;
+	aio->ep = ep->ep;
+	aio->req = req;
+	kiocb->private = aio;
+
+	ret = usb_ep_queue(ep->ep, req, GFP_ATOMIC);
+	if (unlikely(ret)) {
+		kiocb->private = NULL;
+		usb_ep_free_request(ep->ep, req);
+		spin_unlock_irq(&epfile->ffs->eps_lock);
+		ret = -EIO;
+		goto error;
+	}
+	/*
+	 * Still under eps_lock, which the completion work takes before it
+	 * completes the kiocb.
+	 */
+	if (!is_sync_kiocb(kiocb))
+		kiocb_set_cancel_fn(kiocb, ffs_aio_cancel);
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+
+	return -EIOCBQUEUED;
+
+error:
+	kfree(aio->buf);
+	kfree(aio);
+	return ret;
+}
+
+static ssize_t
+ffs_epfile_aio_write(struct kiocb *kiocb, const struct iovec *iov,
+		     unsigned long nr_segs, loff_t pos)
+{
+	ENTER();
+
+	return ffs_epfile_aio_io(kiocb, iov, nr_segs, 0);
+}
+
+static ssize_t
+ffs_epfile_aio_read(struct kiocb *kiocb, const struct iovec *iov,
+		    unsigned long nr_segs, loff_t pos)
+{
+	ENTER();
+
+	return ffs_epfile_aio_io(kiocb, iov, nr_segs, 1);
+}
+
 static int
 ffs_epfile_open(struct inode *inode, struct file *file)
 {
@@ -1045,6 +1272,8 @@ static const struct file_operations ffs_epfile_operations = {
 	.open =		ffs_epfile_open,
 	.write =	ffs_epfile_write,
 	.read =		ffs_epfile_read,
+	.aio_write =	ffs_epfile_aio_write,
+	.aio_read =	ffs_epfile_aio_read,
 	.release =	ffs_epfile_release,
 	.unlocked_ioctl =	ffs_epfile_ioctl,
 };
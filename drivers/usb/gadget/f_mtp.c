@@ -32,6 +32,8 @@
 #include <linux/file.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/pagemap.h>
+#include <linux/scatterlist.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
@@ -53,7 +55,8 @@
 
 /* number of tx and rx requests to allocate */
 #define MTP_TX_REQ_MAX 8
-#define RX_REQ_MAX 2
+#define MTP_RX_REQS 4
+#define RX_REQ_MAX 8
 #define INTR_REQ_MAX 5
 
 /* ID for Microsoft MTP OS String */
@@ -80,6 +83,14 @@ module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
 unsigned int mtp_tx_reqs = MTP_TX_REQ_MAX;
 module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
 
+/* number of rx buffers shared by receive_file_work and the file writer */
+unsigned int mtp_rx_reqs = MTP_RX_REQS;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+
+/* send file data straight from the page cache when the UDC supports SG */
+static bool mtp_tx_zero_copy = true;
+module_param(mtp_tx_zero_copy, bool, S_IRUGO | S_IWUSR);
+
 static const char mtp_shortname[] = "mtp_usb";
 
 struct mtp_dev {
@@ -105,6 +116,8 @@ struct mtp_dev {
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
+	unsigned rx_reqs;
+	/* number of rx requests completed since it was last cleared */
 	int rx_done;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
@@ -113,6 +126,13 @@ struct mtp_dev {
 	struct workqueue_struct *wq;
 	struct work_struct send_file_work;
 	struct work_struct receive_file_work;
+	/* write-behind of received buffers, see rx_write_work() */
+	struct workqueue_struct *wr_wq;
+	struct work_struct rx_write_work;
+	struct list_head rx_write_q;
+	unsigned rx_writing;
+	loff_t rx_write_offset;
+	int rx_write_result;
 	struct file *xfer_file;
 	loff_t xfer_file_offset;
 	int64_t xfer_file_length;
@@ -392,6 +412,48 @@ static inline struct mtp_dev *func_to_mtp(struct usb_function *f)
 	return container_of(f, struct mtp_dev, function);
 }
 
+/* page cache pages attached to a tx request for zero-copy sends */
+struct mtp_tx_pages {
+	int max_pages;
+	int nr_pages;
+	struct page **pages;
+	struct scatterlist *sg;
+};
+
+static struct mtp_tx_pages *mtp_tx_pages_new(int buffer_size)
+{
+	struct mtp_tx_pages *tp;
+	int max_pages = DIV_ROUND_UP(buffer_size, PAGE_CACHE_SIZE);
+
+	tp = kzalloc(sizeof(*tp) + max_pages *
+			(sizeof(struct page *) + sizeof(struct scatterlist)),
+			GFP_KERNEL);
+	if (!tp)
+		return NULL;
+
+	tp->max_pages = max_pages;
+	tp->sg = (struct scatterlist *)(tp + 1);
+	tp->pages = (struct page **)(tp->sg + max_pages);
+
+	return tp;
+}
+
+/* drop the page cache pages of a completed or failed zero-copy request */
+static void mtp_tx_pages_release(struct usb_request *req)
+{
+	struct mtp_tx_pages *tp = req->context;
+	int i;
+
+	if (!tp)
+		return;
+
+	for (i = 0; i < tp->nr_pages; i++)
+		page_cache_release(tp->pages[i]);
+	tp->nr_pages = 0;
+	req->sg = NULL;
+	req->num_sgs = 0;
+}
+
 static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 {
 	struct usb_request *req = usb_ep_alloc_request(ep, GFP_KERNEL);
@@ -411,6 +473,7 @@ static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 static void mtp_request_free(struct usb_request *req, struct usb_ep *ep)
 {
 	if (req) {
+		kfree(req->context);
 		kfree(req->buf);
 		usb_ep_free_request(ep, req);
 	}
@@ -467,6 +530,7 @@ static void mtp_complete_in(struct usb_ep *ep, struct usb_request *req)
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
+	mtp_tx_pages_release(req);
 	mtp_req_put(dev, &dev->tx_idle, req);
 
 	wake_up(&dev->write_wq);
@@ -476,7 +540,7 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
 
-	dev->rx_done = 1;
+	dev->rx_done++;
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
@@ -550,6 +614,8 @@ retry_tx_alloc:
 			mtp_tx_reqs = MTP_TX_REQ_MAX;
 			goto retry_tx_alloc;
 		}
+		/* zero-copy is simply not used for this request on failure */
+		req->context = mtp_tx_pages_new(mtp_tx_req_len);
 		req->complete = mtp_complete_in;
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
@@ -563,8 +629,12 @@ retry_tx_alloc:
 	if (mtp_rx_req_len % 1024)
 		mtp_rx_req_len = MTP_BULK_BUFFER_SIZE;
 
+	if (mtp_rx_reqs < 1 || mtp_rx_reqs > RX_REQ_MAX)
+		mtp_rx_reqs = MTP_RX_REQS;
+
 retry_rx_alloc:
-	for (i = 0; i < RX_REQ_MAX; i++) {
+	dev->rx_reqs = mtp_rx_reqs;
+	for (i = 0; i < dev->rx_reqs; i++) {
 		req = mtp_request_new(dev->ep_out, mtp_rx_req_len);
 		if (!req) {
 			if (mtp_rx_req_len <= MTP_BULK_BUFFER_SIZE)
@@ -775,6 +845,57 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+/* true if req can carry file data straight out of the page cache */
+static bool mtp_tx_can_map(struct mtp_dev *dev, struct usb_request *req,
+		struct file *filp)
+{
+	return mtp_tx_zero_copy && req->context &&
+		dev->cdev->gadget->sg_supported &&
+		filp->f_mapping->a_ops->readpage;
+}
+
+/*
+ * Attach up to xfer bytes of the file at the page aligned offset to req as a
+ * scatterlist of page cache pages.  Returns the number of bytes attached,
+ * 0 if the data has to be copied instead, or a negative error.
+ */
+static int mtp_tx_map_pages(struct usb_request *req, struct file *filp,
+		loff_t offset, int xfer)
+{
+	struct mtp_tx_pages *tp = req->context;
+	struct address_space *mapping = filp->f_mapping;
+	pgoff_t index = offset >> PAGE_CACHE_SHIFT;
+	loff_t size = i_size_read(mapping->host);
+	struct page *page;
+	int len = 0;
+	int n;
+
+	if ((offset & ~PAGE_CACHE_MASK) || offset >= size || xfer <= 0)
+		return 0;
+
+	xfer = min_t(loff_t, xfer, size - offset);
+	xfer = min(xfer, tp->max_pages << PAGE_CACHE_SHIFT);
+
+	sg_init_table(tp->sg, DIV_ROUND_UP(xfer, PAGE_CACHE_SIZE));
+	for (n = 0; len < xfer; n++) {
+		page = read_mapping_page(mapping, index + n, filp);
+		if (IS_ERR(page)) {
+			mtp_tx_pages_release(req);
+			return PTR_ERR(page);
+		}
+		tp->pages[n] = page;
+		tp->nr_pages = n + 1;
+		sg_set_page(&tp->sg[n], page,
+			min_t(int, PAGE_CACHE_SIZE, xfer - len), 0);
+		len += tp->sg[n].length;
+	}
+
+	req->sg = tp->sg;
+	req->num_sgs = tp->nr_pages;
+
+	return xfer;
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data)
 {
@@ -786,7 +907,7 @@ static void send_file_work(struct work_struct *data)
 	struct file *filp;
 	loff_t offset;
 	int64_t count;
-	int xfer, ret, hdr_size;
+	int xfer, ret, hdr_size, len;
 	int r = 0;
 	int sendZLP = 0;
 	ktime_t start_time;
@@ -846,14 +967,36 @@ static void send_file_work(struct work_struct *data)
 					__cpu_to_le32(dev->xfer_transaction_id);
 		}
 		start_time = ktime_get();
-		ret = vfs_read(filp, req->buf + hdr_size, xfer - hdr_size,
-								&offset);
+		ret = 0;
+		if (!hdr_size && mtp_tx_can_map(dev, req, filp))
+			ret = mtp_tx_map_pages(req, filp, offset, xfer);
 		if (ret < 0) {
 			r = ret;
 			break;
 		}
 
-		xfer = ret + hdr_size;
+		if (ret > 0) {
+			offset += ret;
+			xfer = ret;
+		} else {
+			/*
+			 * The header and any unaligned head of the file are
+			 * copied up to the next page boundary, so that the
+			 * following units can be sent from the page cache.
+			 */
+			len = xfer - hdr_size;
+			if (mtp_tx_can_map(dev, req, filp))
+				len = min_t(int, len, PAGE_CACHE_SIZE -
+					(offset & ~PAGE_CACHE_MASK));
+			ret = vfs_read(filp, req->buf + hdr_size, len,
+								&offset);
+			if (ret < 0) {
+				r = ret;
+				break;
+			}
+
+			xfer = ret + hdr_size;
+		}
 		dev->perf[dev->dbg_read_index].vfs_rtime =
 			ktime_to_us(ktime_sub(ktime_get(), start_time));
 		dev->perf[dev->dbg_read_index].vfs_rbytes = xfer;
@@ -864,6 +1007,7 @@ static void send_file_work(struct work_struct *data)
 		ret = usb_ep_queue(dev->ep_in, req, GFP_KERNEL);
 		if (ret < 0) {
 			DBG(cdev, "send_file_work: xfer error %d\n", ret);
+			mtp_tx_pages_release(req);
 			if (dev->state != STATE_OFFLINE)
 				dev->state = STATE_ERROR;
 			r = -EIO;
@@ -885,24 +1029,64 @@ static void send_file_work(struct work_struct *data)
 	smp_wmb();
 }
 
-/* read from USB and write to a local file */
+/*
+ * Write received buffers to the local file on behalf of receive_file_work,
+ * so that USB OUT transfers continue while the storage write is in progress.
+ */
+static void rx_write_work(struct work_struct *data)
+{
+	struct mtp_dev *dev = container_of(data, struct mtp_dev,
+						rx_write_work);
+	struct usb_composite_dev *cdev = dev->cdev;
+	struct usb_request *req;
+	ktime_t start_time;
+	int ret;
+
+	while ((req = mtp_req_get(dev, &dev->rx_write_q))) {
+		/* after a failed write the remaining buffers are dropped */
+		if (!dev->rx_write_result) {
+			DBG(cdev, "rx %pK %d\n", req, req->actual);
+			start_time = ktime_get();
+			ret = vfs_write(dev->xfer_file, req->buf, req->actual,
+				&dev->rx_write_offset);
+			DBG(cdev, "vfs_write %d\n", ret);
+			if (ret != req->actual) {
+				dev->rx_write_result = -EIO;
+				if (dev->state != STATE_OFFLINE)
+					dev->state = STATE_ERROR;
+			} else {
+				dev->perf[dev->dbg_write_index].vfs_wtime =
+					ktime_to_us(ktime_sub(ktime_get(),
+							start_time));
+				dev->perf[dev->dbg_write_index].vfs_wbytes =
+					ret;
+				dev->dbg_write_index =
+					(dev->dbg_write_index + 1) %
+						MAX_ITERATION;
+			}
+		}
+
+		spin_lock_irq(&dev->lock);
+		dev->rx_writing--;
+		spin_unlock_irq(&dev->lock);
+		wake_up(&dev->read_wq);
+	}
+}
+
+/* read from USB and hand the data to rx_write_work */
 static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
 						receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
-	struct file *filp;
-	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	struct usb_request *read_req;
+	int64_t count, pending;
+	int ret, head = 0, tail = 0, queued = 0, done = 0;
 	int r = 0;
-	ktime_t start_time;
 
 	/* read our parameters */
 	smp_rmb();
-	filp = dev->xfer_file;
-	offset = dev->xfer_file_offset;
+	dev->rx_write_offset = dev->xfer_file_offset;
 	count = dev->xfer_file_length;
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
@@ -910,82 +1094,115 @@ static void receive_file_work(struct work_struct *data)
 		DBG(cdev, "%s- count(%lld) not multiple of mtu(%d)\n", __func__,
 						count, dev->ep_out->maxpacket);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	/* bytes of the file not yet covered by a queued read */
+	pending = count;
+	dev->rx_done = 0;
+	dev->rx_write_result = 0;
+
+	while (count > 0) {
+		/*
+		 * Queue reads into every buffer not owned by the writer.
+		 * Buffers are read, written and freed in ring order.  Reads
+		 * are never queued past the end of the file, or the next
+		 * command from the host would land in them, so a file of
+		 * unknown length (read until a short packet) keeps a single
+		 * read in flight.
+		 */
+		while (queued + ACCESS_ONCE(dev->rx_writing) < dev->rx_reqs &&
+		       pending > 0 && !(count == 0xFFFFFFFF && queued)) {
+			read_req = dev->rx_req[tail];
 
 			/* some h/w expects size to be aligned to ep's MTU */
 			read_req->length = mtp_rx_req_len;
 
-			dev->rx_done = 0;
 			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				if (dev->state != STATE_OFFLINE)
 					dev->state = STATE_ERROR;
-				break;
+				goto dequeue;
 			}
+			tail = (tail + 1) % dev->rx_reqs;
+			queued++;
+			if (count != 0xFFFFFFFF)
+				pending -= min_t(int64_t, pending,
+						mtp_rx_req_len);
 		}
 
-		if (write_req) {
-			DBG(cdev, "rx %pK %d\n", write_req, write_req->actual);
-			start_time = ktime_get();
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
-				r = -EIO;
-				if (dev->state != STATE_OFFLINE)
-					dev->state = STATE_ERROR;
+		if (!queued) {
+			/* every buffer is waiting to be written */
+			wait_event(dev->read_wq,
+				ACCESS_ONCE(dev->rx_writing) < dev->rx_reqs);
+			if (dev->rx_write_result) {
+				r = dev->rx_write_result;
 				break;
 			}
-			dev->perf[dev->dbg_write_index].vfs_wtime =
-				ktime_to_us(ktime_sub(ktime_get(), start_time));
-			dev->perf[dev->dbg_write_index].vfs_wbytes = ret;
-			dev->dbg_write_index =
-				(dev->dbg_write_index + 1) % MAX_ITERATION;
-			write_req = NULL;
+			continue;
 		}
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED
-					|| dev->state == STATE_OFFLINE) {
-				if (dev->state == STATE_OFFLINE)
-					r = -EIO;
-				else
-					r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* Check if we aligned the size due to MTU constraint */
-			if (count < read_req->length)
-				read_req->actual = (read_req->actual > count ?
-						count : read_req->actual);
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
+		/* wait for the oldest read to complete */
+		read_req = dev->rx_req[head];
+		ret = wait_event_interruptible(dev->read_wq,
+			dev->rx_done > done || dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED
+				|| dev->state == STATE_OFFLINE) {
+			if (dev->state == STATE_OFFLINE)
+				r = -EIO;
+			else
+				r = -ECANCELED;
+			goto dequeue;
+		}
+		if (dev->rx_write_result) {
+			r = dev->rx_write_result;
+			goto dequeue;
+		}
+		if (dev->rx_done <= done) {
+			r = ret ? ret : -EIO;
+			goto dequeue;
+		}
+		done++;
+		queued--;
+		head = (head + 1) % dev->rx_reqs;
+
+		/* Check if we aligned the size due to MTU constraint */
+		if (count < read_req->length)
+			read_req->actual = (read_req->actual > count ?
+					count : read_req->actual);
+		/* if xfer_file_length is 0xFFFFFFFF, then we read until
+		 * we get a zero length packet
+		 */
+		if (count != 0xFFFFFFFF)
+			count -= read_req->actual;
+		if (read_req->actual < read_req->length) {
+			/*
+			 * short packet is used to signal EOF for
+			 * sizes > 4 gig
 			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/*
-				 * short packet is used to signal EOF for
-				 * sizes > 4 gig
-				 */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
-
-			write_req = read_req;
-			read_req = NULL;
+			DBG(cdev, "got short packet\n");
+			count = 0;
+			pending = 0;
 		}
+
+		/* hand the buffer to the writer */
+		spin_lock_irq(&dev->lock);
+		dev->rx_writing++;
+		list_add_tail(&read_req->list, &dev->rx_write_q);
+		spin_unlock_irq(&dev->lock);
+		queue_work(dev->wr_wq, &dev->rx_write_work);
+	}
+
+dequeue:
+	/* reads still in flight after an error or an early short packet */
+	for (; queued > 0; queued--) {
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[head]);
+		head = (head + 1) % dev->rx_reqs;
 	}
 
+	/* the buffers and the file must not be released under the writer */
+	wait_event(dev->read_wq, ACCESS_ONCE(dev->rx_writing) == 0);
+	if (!r)
+		r = dev->rx_write_result;
+
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -1405,7 +1622,7 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	while ((req = mtp_req_get(dev, &dev->tx_idle)))
 		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
+	for (i = 0; i < dev->rx_reqs; i++)
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
@@ -1651,14 +1868,21 @@ static int mtp_setup(void)
 	atomic_set(&dev->ioctl_excl, 0);
 	INIT_LIST_HEAD(&dev->tx_idle);
 	INIT_LIST_HEAD(&dev->intr_idle);
+	INIT_LIST_HEAD(&dev->rx_write_q);
 
 	dev->wq = create_singlethread_workqueue("f_mtp");
 	if (!dev->wq) {
 		ret = -ENOMEM;
 		goto err1;
 	}
+	dev->wr_wq = create_singlethread_workqueue("f_mtp_write");
+	if (!dev->wr_wq) {
+		ret = -ENOMEM;
+		goto err3;
+	}
 	INIT_WORK(&dev->send_file_work, send_file_work);
 	INIT_WORK(&dev->receive_file_work, receive_file_work);
+	INIT_WORK(&dev->rx_write_work, rx_write_work);
 
 	_mtp_dev = dev;
 
@@ -1670,6 +1894,8 @@ static int mtp_setup(void)
 	return 0;
 
 err2:
+	destroy_workqueue(dev->wr_wq);
+err3:
 	destroy_workqueue(dev->wq);
 err1:
 	_mtp_dev = NULL;
@@ -1687,6 +1913,7 @@ static void mtp_cleanup(void)
 
 	mtp_debugfs_remove();
 	misc_deregister(&mtp_device);
+	destroy_workqueue(dev->wr_wq);
 	destroy_workqueue(dev->wq);
 	_mtp_dev = NULL;
 	kfree(dev);
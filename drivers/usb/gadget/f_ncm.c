@@ -19,6 +19,8 @@
 #include <linux/device.h>
 #include <linux/etherdevice.h>
 #include <linux/crc32.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 
 #include <linux/usb/cdc.h>
 
@@ -75,6 +77,17 @@ struct f_ncm {
 	bool				is_crc;
 	u32				ndp_sign;
 
+	/* DL multi-frame NTB aggregation, see ncm_wrap_ntb() */
+	struct net_device		*netdev;
+	struct sk_buff			*skb_tx_data;
+	u8				*tx_ndp;
+	unsigned			tx_ndp_len;
+	u16				ndp_dgram_count;
+	bool				timer_force_tx;
+	bool				timer_stopping;
+	struct hrtimer			task_timer;
+	struct tasklet_struct		tx_tasklet;
+
 	/*
 	 * for notification, it is accessed from both
 	 * callback and ethernet open/close
@@ -99,20 +112,18 @@ static inline unsigned ncm_bitrate(struct usb_gadget *g)
 /*-------------------------------------------------------------------------*/
 
 /*
- * We cannot group frames so use just the minimal size which ok to put
- * one max-size ethernet frame.
- * If the host can group frames, allow it to do that, 16K is selected,
- * because it's used by default by the current linux host driver
+ * Both directions group frames, 16K is selected because it's used by
+ * default by the current linux host driver.
  */
-#define NTB_DEFAULT_IN_SIZE	USB_CDC_NCM_NTB_MIN_IN_SIZE
+#define NTB_DEFAULT_IN_SIZE	16384
 #define NTB_OUT_SIZE		16384
 
 /*
- * skbs of size less than that will not be aligned
- * to NCM's dwNtbInMaxSize to save bus bandwidth
+ * Upper bound of datagrams per IN NTB, which sizes the NDP template, and
+ * how long a partially filled NTB may wait for more traffic.
  */
-
-#define	MAX_TX_NONFIXED		(512 * 3)
+#define TX_MAX_NUM_DPE		32
+#define TX_TIMEOUT_NSECS	300000
 
 #define FORMATS_SUPPORTED	(USB_CDC_NCM_NTB16_SUPPORTED |	\
 				 USB_CDC_NCM_NTB32_SUPPORTED)
@@ -785,6 +796,8 @@ invalid:
 }
 
 
+static void ncm_tx_reset(struct f_ncm *ncm);
+
 static int ncm_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 {
 	struct f_ncm		*ncm = func_to_ncm(f);
@@ -816,6 +829,7 @@ static int ncm_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 		if (ncm->port.in_ep->driver_data) {
 			DBG(cdev, "reset ncm\n");
 			gether_disconnect(&ncm->port);
+			ncm_tx_reset(ncm);
 			ncm_reset_values(ncm);
 		}
 
@@ -851,6 +865,7 @@ static int ncm_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 			net = gether_connect(&ncm->port);
 			if (IS_ERR(net))
 				return PTR_ERR(net);
+			ncm->netdev = net;
 		}
 
 		spin_lock(&ncm->lock);
@@ -877,95 +892,187 @@ static int ncm_get_alt(struct usb_function *f, unsigned intf)
 	return ncm->port.in_ep->driver_data ? 1 : 0;
 }
 
+/*
+ * Close the NTB being built: finish the NTH, append the NDP from the
+ * template buffer plus its terminating zero entry and hand the result
+ * back for transmission.
+ */
+static struct sk_buff *ncm_package_for_tx(struct f_ncm *ncm)
+{
+	const struct ndp_parser_opts *opts = ncm->parser_opts;
+	const int	ndp_align = le16_to_cpu(ntb_parameters.wNdpInAlignment);
+	const int	dgram_idx_len = 2 * 2 * opts->dgram_item_len;
+	struct sk_buff	*skb = ncm->skb_tx_data;
+	__le16		*tmp;
+	unsigned	ndp_pad;
+	unsigned	ndp_index;
+
+	hrtimer_try_to_cancel(&ncm->task_timer);
+
+	ndp_pad = ALIGN(skb->len, ndp_align) - skb->len;
+	ndp_index = skb->len + ndp_pad;
+
+	/* (d)wBlockLength and (d)wFpIndex follow wHeaderLength, wSequence */
+	tmp = (void *)skb->data + 4 + 2 + 2;
+	put_ncm(&tmp, opts->block_length,
+		ndp_index + ncm->tx_ndp_len + dgram_idx_len);
+	put_ncm(&tmp, opts->fp_index, ndp_index);
+
+	/* NDP wLength covers the zero entry as well */
+	put_unaligned_le16(ncm->tx_ndp_len + dgram_idx_len,
+			   (void *)ncm->tx_ndp + 4);
+
+	memset(skb_put(skb, ndp_pad), 0, ndp_pad);
+	memcpy(skb_put(skb, ncm->tx_ndp_len), ncm->tx_ndp, ncm->tx_ndp_len);
+	memset(skb_put(skb, dgram_idx_len), 0, dgram_idx_len);
+
+	ncm->skb_tx_data = NULL;
+	ncm->tx_ndp_len = 0;
+	ncm->ndp_dgram_count = 0;
+
+	return skb;
+}
+
+/*
+ * Datagrams are copied into one NTB of up to the host's NTB input size
+ * and only sent once the next one would not fit, TX_MAX_NUM_DPE are
+ * queued, or TX_TIMEOUT_NSECS pass without new traffic. A NULL @skb is
+ * the flush request issued from ncm_tx_tasklet().
+ *
+ * Context: called from eth_start_xmit() with the eth_dev lock held
+ */
 static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 				    struct sk_buff *skb)
 {
 	struct f_ncm	*ncm = func_to_ncm(&port->func);
-	struct sk_buff	*skb2;
-	int		ncb_len = 0;
+	struct sk_buff	*skb2 = NULL;
 	__le16		*tmp;
-	int		div;
-	int		rem;
-	int		pad;
-	int		ndp_align;
-	int		ndp_pad;
+	int		ncb_len;
+	int		dgram_pad;
 	unsigned	max_size = ncm->port.fixed_in_len;
 	const struct ndp_parser_opts *opts = ncm->parser_opts;
+	const int	ndp_align = le16_to_cpu(ntb_parameters.wNdpInAlignment);
+	const int	div = le16_to_cpu(ntb_parameters.wNdpInDivisor);
+	const int	rem = le16_to_cpu(ntb_parameters.wNdpInPayloadRemainder);
+	const int	dgram_idx_len = 2 * 2 * opts->dgram_item_len;
 	unsigned	crc_len = ncm->is_crc ? sizeof(uint32_t) : 0;
 
-	div = le16_to_cpu(ntb_parameters.wNdpInDivisor);
-	rem = le16_to_cpu(ntb_parameters.wNdpInPayloadRemainder);
-	ndp_align = le16_to_cpu(ntb_parameters.wNdpInAlignment);
-
-	ncb_len += opts->nth_size;
-	ndp_pad = ALIGN(ncb_len, ndp_align) - ncb_len;
-	ncb_len += ndp_pad;
-	ncb_len += opts->ndp_size;
-	ncb_len += 2 * 2 * opts->dgram_item_len; /* Datagram entry */
-	ncb_len += 2 * 2 * opts->dgram_item_len; /* Zero datagram entry */
-	pad = ALIGN(ncb_len, div) + rem - ncb_len;
-	ncb_len += pad;
+	if (!skb) {
+		if (ncm->skb_tx_data && ncm->timer_force_tx)
+			skb2 = ncm_package_for_tx(ncm);
+		return skb2;
+	}
 
-	if (ncb_len + skb->len + crc_len > max_size) {
+	/* worst case size of an NTB carrying just this datagram */
+	ncb_len = ALIGN(opts->nth_size, div) + rem + skb->len + crc_len +
+		ndp_align + opts->ndp_size + 2 * dgram_idx_len;
+	if (ncb_len > max_size) {
 		dev_kfree_skb_any(skb);
-		return NULL;
+		goto err;
 	}
 
-	skb2 = skb_copy_expand(skb, ncb_len,
-			       max_size - skb->len - ncb_len - crc_len,
-			       GFP_ATOMIC);
-	dev_kfree_skb_any(skb);
-	if (!skb2)
-		return NULL;
-
-	skb = skb2;
-
-	tmp = (void *) skb_push(skb, ncb_len);
-	memset(tmp, 0, ncb_len);
+	/* send the pending NTB first if this datagram would not fit */
+	if (ncm->skb_tx_data &&
+	    (ncm->ndp_dgram_count >= TX_MAX_NUM_DPE ||
+	     ncm->skb_tx_data->len + div + rem + skb->len + crc_len +
+	     ndp_align + ncm->tx_ndp_len + 2 * dgram_idx_len > max_size))
+		skb2 = ncm_package_for_tx(ncm);
+
+	if (!ncm->skb_tx_data) {
+		ncm->skb_tx_data = alloc_skb(max_size, GFP_ATOMIC);
+		if (!ncm->skb_tx_data) {
+			dev_kfree_skb_any(skb);
+			goto err;
+		}
 
-	put_unaligned_le32(opts->nth_sign, tmp); /* dwSignature */
-	tmp += 2;
-	/* wHeaderLength */
-	put_unaligned_le16(opts->nth_size, tmp++);
-	tmp++; /* skip wSequence */
-	put_ncm(&tmp, opts->block_length, skb->len); /* (d)wBlockLength */
-	/* (d)wFpIndex */
-	/* the first pointer is right after the NTH + align */
-	put_ncm(&tmp, opts->fp_index, opts->nth_size + ndp_pad);
+		tmp = (void *)skb_put(ncm->skb_tx_data, opts->nth_size);
+		memset(tmp, 0, opts->nth_size);
+		put_unaligned_le32(opts->nth_sign, tmp); /* dwSignature */
+		tmp += 2;
+		/* wHeaderLength */
+		put_unaligned_le16(opts->nth_size, tmp++);
 
-	tmp = (void *)tmp + ndp_pad;
+		/*
+		 * The NDP header is the same for every NTB of a connection,
+		 * only the signature can change with SET_CRC_MODE.
+		 */
+		memset(ncm->tx_ndp, 0, opts->ndp_size);
+		put_unaligned_le32(ncm->ndp_sign, ncm->tx_ndp);
+		ncm->tx_ndp_len = opts->ndp_size;
+	}
 
-	/* NDP */
-	put_unaligned_le32(ncm->ndp_sign, tmp); /* dwSignature */
-	tmp += 2;
-	/* wLength */
-	put_unaligned_le16(ncb_len - opts->nth_size - pad, tmp++);
+	dgram_pad = ALIGN(ncm->skb_tx_data->len, div) + rem -
+		ncm->skb_tx_data->len;
+	memset(skb_put(ncm->skb_tx_data, dgram_pad), 0, dgram_pad);
 
-	tmp += opts->reserved1;
-	tmp += opts->next_fp_index; /* skip reserved (d)wNextFpIndex */
-	tmp += opts->reserved2;
+	/* (d)wDatagramIndex and (d)wDatagramLength */
+	tmp = (void *)ncm->tx_ndp + ncm->tx_ndp_len;
+	put_ncm(&tmp, opts->dgram_item_len, ncm->skb_tx_data->len);
+	put_ncm(&tmp, opts->dgram_item_len, skb->len + crc_len);
+	ncm->tx_ndp_len += dgram_idx_len;
+	ncm->ndp_dgram_count++;
 
+	memcpy(skb_put(ncm->skb_tx_data, skb->len), skb->data, skb->len);
 	if (ncm->is_crc) {
 		uint32_t crc;
 
-		crc = ~crc32_le(~0,
-				skb->data + ncb_len,
-				skb->len - ncb_len);
-		put_unaligned_le32(crc, skb->data + skb->len);
-		skb_put(skb, crc_len);
+		crc = ~crc32_le(~0, skb->data, skb->len);
+		put_unaligned_le32(crc, skb_put(ncm->skb_tx_data, crc_len));
 	}
+	dev_kfree_skb_any(skb);
 
-	/* (d)wDatagramIndex[0] */
-	put_ncm(&tmp, opts->dgram_item_len, ncb_len);
-	/* (d)wDatagramLength[0] */
-	put_ncm(&tmp, opts->dgram_item_len, skb->len - ncb_len);
-	/* (d)wDatagramIndex[1] and  (d)wDatagramLength[1] already zeroed */
+	/* (re)arm the flush timer for the NTB being built */
+	hrtimer_start(&ncm->task_timer, ktime_set(0, TX_TIMEOUT_NSECS),
+		      HRTIMER_MODE_REL);
 
-	if (skb->len > MAX_TX_NONFIXED)
-		memset(skb_put(skb, max_size - skb->len),
-		       0, max_size - skb->len);
+	return skb2;
 
-	return skb;
+err:
+	if (ncm->netdev)
+		ncm->netdev->stats.tx_dropped++;
+	return skb2;
+}
+
+/*
+ * Flush the pending NTB once the aggregation timer expires. The network
+ * stack serializes ndo_start_xmit() through the tx lock, so take it here.
+ */
+static void ncm_tx_tasklet(unsigned long data)
+{
+	struct f_ncm	*ncm = (void *)data;
+	struct net_device *net = ncm->netdev;
+
+	if (ncm->timer_stopping || !net || !ncm->skb_tx_data)
+		return;
+
+	netif_tx_lock(net);
+	ncm->timer_force_tx = true;
+	net->netdev_ops->ndo_start_xmit(NULL, net);
+	ncm->timer_force_tx = false;
+	netif_tx_unlock(net);
+}
+
+static enum hrtimer_restart ncm_tx_timeout(struct hrtimer *timer)
+{
+	struct f_ncm *ncm = container_of(timer, struct f_ncm, task_timer);
+
+	tasklet_schedule(&ncm->tx_tasklet);
+	return HRTIMER_NORESTART;
+}
+
+/* Drop any half built NTB; the USB link must already be disconnected */
+static void ncm_tx_reset(struct f_ncm *ncm)
+{
+	ncm->timer_stopping = true;
+	hrtimer_cancel(&ncm->task_timer);
+
+	if (ncm->skb_tx_data) {
+		dev_kfree_skb_any(ncm->skb_tx_data);
+		ncm->skb_tx_data = NULL;
+	}
+	ncm->tx_ndp_len = 0;
+	ncm->ndp_dgram_count = 0;
+	ncm->timer_stopping = false;
 }
 
 static int ncm_unwrap_ntb(struct gether *port,
@@ -1109,8 +1216,10 @@ static void ncm_disable(struct usb_function *f)
 
 	DBG(cdev, "ncm deactivated\n");
 
-	if (ncm->port.in_ep->driver_data)
+	if (ncm->port.in_ep->driver_data) {
 		gether_disconnect(&ncm->port);
+		ncm_tx_reset(ncm);
+	}
 
 	if (ncm->notify->driver_data) {
 		usb_ep_disable(ncm->notify);
@@ -1281,12 +1390,16 @@ ncm_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	DBG(c->cdev, "ncm unbind\n");
 
+	hrtimer_cancel(&ncm->task_timer);
+	tasklet_kill(&ncm->tx_tasklet);
+
 	ncm_string_defs[0].id = 0;
 	usb_free_all_descriptors(f);
 
 	kfree(ncm->notify_req->buf);
 	usb_ep_free_request(ncm->notify, ncm->notify_req);
 
+	kfree(ncm->tx_ndp);
 	kfree(ncm);
 }
 
@@ -1335,10 +1448,23 @@ int ncm_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN],
 	snprintf(ncm->ethaddr, sizeof ncm->ethaddr, "%pm", ethaddr);
 	ncm_string_defs[STRING_MAC_IDX].s = ncm->ethaddr;
 
+	/* NDP header plus every datagram entry; the zero entry is added on tx */
+	ncm->tx_ndp = kzalloc(sizeof(struct usb_cdc_ncm_ndp32) +
+			TX_MAX_NUM_DPE * 2 * sizeof(__le32), GFP_KERNEL);
+	if (!ncm->tx_ndp) {
+		kfree(ncm);
+		return -ENOMEM;
+	}
+
 	spin_lock_init(&ncm->lock);
 	ncm_reset_values(ncm);
 	ncm->port.ioport = dev;
 	ncm->port.is_fixed = true;
+	ncm->port.supports_multi_frame = true;
+
+	hrtimer_init(&ncm->task_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ncm->task_timer.function = ncm_tx_timeout;
+	tasklet_init(&ncm->tx_tasklet, ncm_tx_tasklet, (unsigned long)ncm);
 
 	ncm->port.func.name = "cdc_network";
 	ncm->port.func.strings = ncm_strings;
@@ -1354,7 +1480,9 @@ int ncm_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN],
 	ncm->port.unwrap = ncm_unwrap_ntb;
 
 	status = usb_add_function(c, &ncm->port.func);
-	if (status)
+	if (status) {
+		kfree(ncm->tx_ndp);
 		kfree(ncm);
+	}
 	return status;
 }
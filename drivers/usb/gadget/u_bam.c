@@ -105,6 +105,12 @@ module_param(bam_mux_rx_req_size, ulong, S_IRUGO);
 static unsigned int dl_intr_threshold = DL_INTR_THRESHOLD;
 module_param(dl_intr_threshold, uint, S_IRUGO | S_IWUSR);
 
+#define BAM_MUX_RX_POOL_MAX			1024
+#define BAM_MUX_RX_POOL_WINDOW			1024
+
+static unsigned int bam_mux_rx_pool_max = BAM_MUX_RX_POOL_MAX;
+module_param(bam_mux_rx_pool_max, uint, S_IRUGO | S_IWUSR);
+
 #define BAM_CH_OPENED			BIT(0)
 #define BAM_CH_READY			BIT(1)
 #define BAM_CH_WRITE_INPROGRESS		BIT(2)
@@ -132,6 +138,13 @@ struct bam_ch_info {
 	struct sk_buff_head	rx_skb_q;
 	struct sk_buff_head	rx_skb_idle;
 
+	/* rx skb pool sizing, see gbam_rx_pool_target() */
+	struct work_struct	rx_pool_fill_w;
+	unsigned int		rx_skb_outstanding;
+	unsigned int		rx_skb_peak;
+	unsigned int		rx_skb_window_peak;
+	unsigned int		rx_skb_window_cnt;
+
 	struct gbam_port	*port;
 	struct work_struct	write_tobam_w;
 	struct work_struct	write_tohost_w;
@@ -169,6 +182,11 @@ struct bam_ch_info {
 	unsigned int		max_num_pkts_pending_with_bam;
 	unsigned int		max_bytes_pending_with_bam;
 	unsigned int		delayed_bam_mux_write_done;
+	unsigned long		rx_pool_hits;
+	unsigned long		rx_pool_misses;
+	unsigned int		rx_pool_alloc_fail;
+	unsigned int		rx_pool_filled;
+	unsigned int		rx_pool_trimmed;
 };
 
 struct gbam_port {
@@ -248,13 +266,99 @@ static inline dma_addr_t gbam_get_dma_from_skb(struct sk_buff *skb)
 	return *((dma_addr_t *)(skb->cb));
 }
 
+/* Allocate an rx skb, DMA mapped up front for the sys2bam IPA path */
+static struct sk_buff *gbam_alloc_rx_skb(struct usb_gadget *gadget,
+		enum transport_type trans, gfp_t flags)
+{
+	struct sk_buff *skb;
+	dma_addr_t      skb_buf_dma_addr;
+
+	skb = alloc_skb(bam_mux_rx_req_size + BAM_MUX_HDR, flags);
+	if (!skb)
+		return NULL;
+
+	skb_reserve(skb, BAM_MUX_HDR);
+
+	if (trans == USB_GADGET_XPORT_BAM2BAM_IPA) {
+		skb_buf_dma_addr =
+			dma_map_single(&gadget->dev, skb->data,
+				bam_mux_rx_req_size, DMA_BIDIRECTIONAL);
+
+		if (dma_mapping_error(&gadget->dev, skb_buf_dma_addr)) {
+			pr_err("%s: Could not DMA map SKB buffer\n",
+				__func__);
+			skb_buf_dma_addr = DMA_ERROR_CODE;
+		}
+	} else {
+		skb_buf_dma_addr = DMA_ERROR_CODE;
+	}
+
+	memcpy(skb->cb, &skb_buf_dma_addr,
+		sizeof(skb_buf_dma_addr));
+
+	return skb;
+}
+
+/* Unmap and free an rx skb that was allocated by gbam_alloc_rx_skb() */
+static void gbam_free_rx_skb(struct usb_gadget *gadget, struct sk_buff *skb)
+{
+	dma_addr_t dma_addr = gbam_get_dma_from_skb(skb);
+
+	if (gadget && dma_addr != DMA_ERROR_CODE) {
+		dma_unmap_single(&gadget->dev, dma_addr,
+			bam_mux_rx_req_size, DMA_BIDIRECTIONAL);
+
+		dma_addr = DMA_ERROR_CODE;
+		memcpy(skb->cb, &dma_addr,
+			sizeof(dma_addr));
+	}
+	dev_kfree_skb_any(skb);
+}
+
+/*
+ * Number of rx skbs the pool should own, in flight and idle together: the
+ * observed peak of skbs in flight plus a quarter of headroom, but never
+ * less than one skb per OUT request.
+ */
+static unsigned int gbam_rx_pool_target(struct bam_ch_info *d)
+{
+	unsigned int target = d->rx_skb_peak + d->rx_skb_peak / 4;
+
+	target = max(target, bam_mux_rx_q_size);
+
+	return min(target, max(bam_mux_rx_pool_max, bam_mux_rx_q_size));
+}
+
+/* This function should be called with port_lock_ul lock held */
+static void gbam_rx_pool_track(struct bam_ch_info *d)
+{
+	d->rx_skb_outstanding++;
+	if (d->rx_skb_outstanding > d->rx_skb_window_peak)
+		d->rx_skb_window_peak = d->rx_skb_outstanding;
+	if (d->rx_skb_outstanding > d->rx_skb_peak)
+		d->rx_skb_peak = d->rx_skb_outstanding;
+
+	/* let the peak decay towards the demand seen in the last window */
+	if (++d->rx_skb_window_cnt >= BAM_MUX_RX_POOL_WINDOW) {
+		if (d->rx_skb_window_peak < d->rx_skb_peak)
+			d->rx_skb_peak = (d->rx_skb_peak +
+					  d->rx_skb_window_peak) / 2;
+		d->rx_skb_window_peak = d->rx_skb_outstanding;
+		d->rx_skb_window_cnt = 0;
+	}
+
+	/* refill from process context before the idle list runs dry */
+	if (d->rx_skb_idle.qlen < bam_mux_rx_q_size / 4 &&
+	    d->rx_skb_outstanding + d->rx_skb_idle.qlen <
+						gbam_rx_pool_target(d))
+		queue_work(gbam_wq, &d->rx_pool_fill_w);
+}
+
 /* This function should be called with port_lock_ul lock held */
 static struct sk_buff *gbam_alloc_skb_from_pool(struct gbam_port *port)
 {
 	struct bam_ch_info *d;
 	struct sk_buff *skb;
-	dma_addr_t      skb_buf_dma_addr;
-	struct usb_gadget *gadget;
 
 	if (!port)
 		return NULL;
@@ -271,43 +375,26 @@ static struct sk_buff *gbam_alloc_skb_from_pool(struct gbam_port *port)
 		 * stop when the pool will arrive to its optimal size.
 		 */
 		pr_debug("%s: allocate skb\n", __func__);
-		skb = alloc_skb(bam_mux_rx_req_size + BAM_MUX_HDR, GFP_ATOMIC);
+		d->rx_pool_misses++;
+		skb = gbam_alloc_rx_skb(port->port_usb->gadget, d->trans,
+								GFP_ATOMIC);
 
 		if (!skb) {
 			pr_err("%s: alloc skb failed\n", __func__);
+			d->rx_pool_alloc_fail++;
+			queue_work(gbam_wq, &d->rx_pool_fill_w);
 			goto alloc_exit;
 		}
-
-		skb_reserve(skb, BAM_MUX_HDR);
-
-		if ((d->trans == USB_GADGET_XPORT_BAM2BAM_IPA)) {
-
-			gadget = port->port_usb->gadget;
-
-			skb_buf_dma_addr =
-				dma_map_single(&gadget->dev, skb->data,
-					bam_mux_rx_req_size, DMA_BIDIRECTIONAL);
-
-			if (dma_mapping_error(&gadget->dev, skb_buf_dma_addr)) {
-				pr_err("%s: Could not DMA map SKB buffer\n",
-					__func__);
-				skb_buf_dma_addr = DMA_ERROR_CODE;
-			}
-		} else {
-			skb_buf_dma_addr = DMA_ERROR_CODE;
-		}
-
-
-		memcpy(skb->cb, &skb_buf_dma_addr,
-			sizeof(skb_buf_dma_addr));
-
 	} else {
 		pr_debug("%s: pull skb from pool\n", __func__);
+		d->rx_pool_hits++;
 		skb = __skb_dequeue(&d->rx_skb_idle);
 		if (skb_headroom(skb) < BAM_MUX_HDR)
 			skb_reserve(skb, BAM_MUX_HDR);
 	}
 
+	gbam_rx_pool_track(d);
+
 alloc_exit:
 	return skb;
 }
@@ -321,16 +408,64 @@ static void gbam_free_skb_to_pool(struct gbam_port *port, struct sk_buff *skb)
 		return;
 	d = &port->data_ch;
 
+	if (d->rx_skb_outstanding)
+		d->rx_skb_outstanding--;
+
+	/* shrink back towards the target once demand has dropped */
+	if (port->port_usb && d->rx_skb_outstanding + d->rx_skb_idle.qlen >=
+						gbam_rx_pool_target(d)) {
+		gbam_free_rx_skb(port->port_usb->gadget, skb);
+		d->rx_pool_trimmed++;
+		return;
+	}
+
 	skb->len = 0;
 	skb_reset_tail_pointer(skb);
 	__skb_queue_tail(&d->rx_skb_idle, skb);
 }
 
+/* Grow the idle list towards the pool target with sleeping allocations */
+static void gbam_rx_pool_fill(struct work_struct *w)
+{
+	struct bam_ch_info *d = container_of(w, struct bam_ch_info,
+						rx_pool_fill_w);
+	struct gbam_port *port = d->port;
+	struct usb_gadget *gadget;
+	enum transport_type trans;
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	for (;;) {
+		spin_lock_irqsave(&port->port_lock_ul, flags);
+		if (!port->port_usb || d->rx_skb_outstanding +
+			d->rx_skb_idle.qlen >= gbam_rx_pool_target(d)) {
+			spin_unlock_irqrestore(&port->port_lock_ul, flags);
+			return;
+		}
+		gadget = port->port_usb->gadget;
+		trans = d->trans;
+		spin_unlock_irqrestore(&port->port_lock_ul, flags);
+
+		skb = gbam_alloc_rx_skb(gadget, trans, GFP_KERNEL);
+		if (!skb)
+			return;
+
+		spin_lock_irqsave(&port->port_lock_ul, flags);
+		if (!port->port_usb) {
+			spin_unlock_irqrestore(&port->port_lock_ul, flags);
+			gbam_free_rx_skb(gadget, skb);
+			return;
+		}
+		__skb_queue_tail(&d->rx_skb_idle, skb);
+		d->rx_pool_filled++;
+		spin_unlock_irqrestore(&port->port_lock_ul, flags);
+	}
+}
+
 static void gbam_free_rx_skb_idle_list(struct gbam_port *port)
 {
 	struct bam_ch_info *d;
 	struct sk_buff *skb;
-	dma_addr_t dma_addr;
 	struct usb_gadget *gadget = NULL;
 
 	if (!port)
@@ -341,17 +476,7 @@ static void gbam_free_rx_skb_idle_list(struct gbam_port *port)
 
 	while (d->rx_skb_idle.qlen > 0) {
 		skb = __skb_dequeue(&d->rx_skb_idle);
-		dma_addr = gbam_get_dma_from_skb(skb);
-
-		if (gadget && dma_addr != DMA_ERROR_CODE) {
-			dma_unmap_single(&gadget->dev, dma_addr,
-				bam_mux_rx_req_size, DMA_BIDIRECTIONAL);
-
-			dma_addr = DMA_ERROR_CODE;
-			memcpy(skb->cb, &dma_addr,
-				sizeof(dma_addr));
-		}
-		dev_kfree_skb_any(skb);
+		gbam_free_rx_skb(gadget, skb);
 	}
 }
 
@@ -1123,9 +1248,10 @@ static void gbam_free_rx_buffers(struct gbam_port *port)
 	gbam_free_requests(port->port_usb->out, &d->rx_idle);
 
 	while ((skb = __skb_dequeue(&d->rx_skb_q)))
-		dev_kfree_skb_any(skb);
+		gbam_free_rx_skb(port->port_usb->gadget, skb);
 
 	gbam_free_rx_skb_idle_list(port);
+	d->rx_skb_outstanding = 0;
 
 free_rx_buf_out:
 	spin_unlock_irqrestore(&port->port_lock_ul, flags);
@@ -1815,6 +1941,7 @@ static int gbam_port_alloc(int portno)
 	skb_queue_head_init(&d->tx_skb_q);
 	skb_queue_head_init(&d->rx_skb_q);
 	skb_queue_head_init(&d->rx_skb_idle);
+	INIT_WORK(&d->rx_pool_fill_w, gbam_rx_pool_fill);
 	d->id = bam_ch_ids[portno];
 
 	bam_ports[portno].port = port;
@@ -1867,6 +1994,7 @@ static int gbam2bam_port_alloc(int portno)
 	skb_queue_head_init(&d->rx_skb_idle);
 	INIT_LIST_HEAD(&d->rx_idle);
 	INIT_WORK(&d->write_tobam_w, gbam_data_write_tobam);
+	INIT_WORK(&d->rx_pool_fill_w, gbam_rx_pool_fill);
 
 	pr_debug("%s: port:%pK portno:%d\n", __func__, port, portno);
 
@@ -1913,6 +2041,14 @@ static ssize_t gbam_read_stats(struct file *file, char __user *ubuf,
 				"max_num_pkts_pending_with_bam: %u\n"
 				"max_bytes_pending_with_bam: %u\n"
 				"delayed_bam_mux_write_done: %u\n"
+				"rx_pool_hits: %lu\n"
+				"rx_pool_misses: %lu\n"
+				"rx_pool_alloc_fail: %u\n"
+				"rx_pool_filled: %u\n"
+				"rx_pool_trimmed: %u\n"
+				"rx_pool_idle: %u\n"
+				"rx_pool_peak: %u\n"
+				"rx_pool_target: %u\n"
 				"tx_buf_len:	 %u\n"
 				"rx_buf_len:	 %u\n"
 				"data_ch_open:   %d\n"
@@ -1928,6 +2064,10 @@ static ssize_t gbam_read_stats(struct file *file, char __user *ubuf,
 				d->max_num_pkts_pending_with_bam,
 				d->max_bytes_pending_with_bam,
 				d->delayed_bam_mux_write_done,
+				d->rx_pool_hits, d->rx_pool_misses,
+				d->rx_pool_alloc_fail, d->rx_pool_filled,
+				d->rx_pool_trimmed, d->rx_skb_idle.qlen,
+				d->rx_skb_peak, gbam_rx_pool_target(d),
 				d->tx_skb_q.qlen, d->rx_skb_q.qlen,
 				test_bit(BAM_CH_OPENED, &d->flags),
 				test_bit(BAM_CH_READY, &d->flags));
@@ -1973,6 +2113,11 @@ static ssize_t gbam_reset_stats(struct file *file, const char __user *buf,
 		d->max_num_pkts_pending_with_bam = 0;
 		d->max_bytes_pending_with_bam = 0;
 		d->delayed_bam_mux_write_done = 0;
+		d->rx_pool_hits = 0;
+		d->rx_pool_misses = 0;
+		d->rx_pool_alloc_fail = 0;
+		d->rx_pool_filled = 0;
+		d->rx_pool_trimmed = 0;
 
 		spin_unlock(&port->port_lock_dl);
 		spin_unlock_irqrestore(&port->port_lock_ul, flags);
@@ -2173,6 +2318,11 @@ int gbam_connect(struct grmnet *gr, u8 port_num,
 		d->max_num_pkts_pending_with_bam = 0;
 		d->max_bytes_pending_with_bam = 0;
 		d->delayed_bam_mux_write_done = 0;
+		d->rx_pool_hits = 0;
+		d->rx_pool_misses = 0;
+		d->rx_pool_alloc_fail = 0;
+		d->rx_pool_filled = 0;
+		d->rx_pool_trimmed = 0;
 	}
 
 	spin_unlock(&port->port_lock_dl);
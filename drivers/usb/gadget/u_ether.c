@@ -76,6 +76,29 @@ MODULE_PARM_DESC(min_cpu_freq,
  */
 #define DL_MAX_PKTS_PER_XFER	20
 
+/*
+ * DL aggregation is re-evaluated once per window from the observed packet
+ * rate: bulk traffic that keeps the IN queue backed up doubles the number
+ * of packets per transfer, while slow traffic halves it back towards one
+ * so that interactive packets are not held waiting for company.
+ */
+#define DL_AGGR_WINDOW		(HZ / 10)
+
+static unsigned int dl_aggr_adaptive = 1;
+module_param(dl_aggr_adaptive, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dl_aggr_adaptive,
+	"Adapt DL packets per transfer to the observed packet rate");
+
+static unsigned int dl_aggr_high_rate = 8000;
+module_param(dl_aggr_high_rate, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dl_aggr_high_rate,
+	"DL packets per second above which aggregation is increased");
+
+static unsigned int dl_aggr_low_rate = 2000;
+module_param(dl_aggr_low_rate, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dl_aggr_low_rate,
+	"DL packets per second below which aggregation is decreased");
+
 enum ifc_state {
 	ETH_UNDEFINED,
 	ETH_STOP,
@@ -107,6 +130,11 @@ struct eth_dev {
 	unsigned int		ul_max_pkts_per_xfer;
 	unsigned int		dl_max_pkts_per_xfer;
 	uint32_t		dl_max_xfer_size;
+	/* current DL packets per transfer, <= dl_max_pkts_per_xfer */
+	unsigned int		dl_aggr_limit;
+	unsigned int		dl_aggr_pkts;
+	unsigned int		dl_aggr_rate;
+	unsigned long		dl_aggr_stamp;
 	bool			rx_trigger_enabled;
 	struct sk_buff		*(*wrap)(struct gether *, struct sk_buff *skb);
 	int			(*unwrap)(struct gether *,
@@ -130,6 +158,8 @@ struct eth_dev {
 	unsigned long		rx_throttle;
 	unsigned int		tx_aggr_cnt[DL_MAX_PKTS_PER_XFER];
 	unsigned int		tx_pkts_rcvd;
+	unsigned int		dl_aggr_grow;
+	unsigned int		dl_aggr_shrink;
 	unsigned int		loop_brk_cnt;
 	struct dentry		*uether_dent;
 	struct dentry		*uether_dfile;
@@ -669,6 +699,64 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static inline void eth_tx_aggr_account(struct eth_dev *dev, unsigned int n)
+{
+	if (!n)
+		return;
+
+	dev->tx_aggr_cnt[min_t(unsigned int, n, DL_MAX_PKTS_PER_XFER) - 1]++;
+}
+
+/* Restart DL aggregation tuning after (re)negotiation with the host */
+static void eth_dl_aggr_reset(struct eth_dev *dev)
+{
+	unsigned int max = dev->dl_max_pkts_per_xfer ? : 1;
+
+	dev->dl_aggr_limit = dl_aggr_adaptive ? 1 : max;
+	dev->dl_aggr_pkts = 0;
+	dev->dl_aggr_rate = 0;
+	dev->dl_aggr_stamp = jiffies;
+}
+
+/* Called from ndo_start_xmit, which the network stack serializes */
+static void eth_dl_aggr_update(struct eth_dev *dev)
+{
+	unsigned long elapsed = jiffies - dev->dl_aggr_stamp;
+	unsigned int max = dev->dl_max_pkts_per_xfer ? : 1;
+	unsigned int limit = dev->dl_aggr_limit;
+	bool backlog;
+
+	dev->dl_aggr_pkts++;
+	if (elapsed < DL_AGGR_WINDOW)
+		return;
+
+	dev->dl_aggr_rate = dev->dl_aggr_pkts * HZ / elapsed;
+	dev->dl_aggr_pkts = 0;
+	dev->dl_aggr_stamp = jiffies;
+
+	if (!dl_aggr_adaptive) {
+		dev->dl_aggr_limit = max;
+		return;
+	}
+
+	/* only aggregate more when packets are already waiting anyway */
+	if (dev->gadget->sg_supported)
+		backlog = dev->tx_skb_q.qlen > limit;
+	else
+		backlog = dev->no_tx_req_used > MAX_TX_REQ_WITH_NO_INT;
+
+	if (dev->dl_aggr_rate >= dl_aggr_high_rate && backlog &&
+							limit < max) {
+		limit = min(limit * 2, max);
+		dev->dl_aggr_grow++;
+	} else if (dev->dl_aggr_rate < dl_aggr_low_rate && limit > 1) {
+		limit /= 2;
+		dev->dl_aggr_shrink++;
+	}
+
+	dev->dl_aggr_limit = min(limit, max);
+}
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb;
@@ -712,7 +800,7 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 		struct sg_ctx *sg_ctx = req->context;
 
 		n = skb_queue_len(&sg_ctx->skbs);
-		dev->tx_aggr_cnt[n-1]++;
+		eth_tx_aggr_account(dev, n);
 
 		/* sg_ctx is only accessible here, can use lock-free version */
 		__skb_queue_purge(&sg_ctx->skbs);
@@ -767,6 +855,9 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 
 				/* set when tx completion interrupt needed */
 				spin_lock(&dev->req_lock);
+				eth_tx_aggr_account(dev,
+						dev->tx_skb_hold_count);
+				dev->tx_skb_hold_count = 0;
 				dev->tx_qlen++;
 				if (dev->tx_qlen == MAX_TX_REQ_WITH_NO_INT) {
 					new_req->no_interrupt = 0;
@@ -890,7 +981,7 @@ static void process_tx_w(struct work_struct *w)
 	if (dev->port_usb) {
 		in = dev->port_usb->in_ep;
 		max_size = dev->dl_max_xfer_size;
-		max_num_pkts = dev->dl_max_pkts_per_xfer;
+		max_num_pkts = dev->dl_aggr_limit;
 		if (!max_num_pkts)
 			max_num_pkts = 1;
 		hlen = dev->header_len;
@@ -1019,22 +1110,34 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 					struct net_device *net)
 {
 	struct eth_dev		*dev = netdev_priv(net);
-	int			length = skb->len;
+	int			length = 0;
 	int			retval;
 	struct usb_request	*req = NULL;
 	unsigned long		flags;
 	struct usb_ep		*in = NULL;
 	u16			cdc_filter = 0;
 	bool			multi_pkt_xfer = false;
+	bool			multi_frame = false;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
 		in = dev->port_usb->in_ep;
 		cdc_filter = dev->port_usb->cdc_filter;
 		multi_pkt_xfer = dev->port_usb->multi_pkt_xfer;
+		multi_frame = dev->port_usb->supports_multi_frame;
 	}
 	spin_unlock_irqrestore(&dev->lock, flags);
 
+	/*
+	 * A NULL skb is a flush request from a multi-frame function
+	 * (f_ncm) whose wrap() is holding frames back for aggregation.
+	 */
+	if (!skb) {
+		if (!in || !multi_frame || dev->gadget->sg_supported)
+			return NETDEV_TX_OK;
+		goto wrap;
+	}
+
 	if (!in) {
 		dev_kfree_skb_any(skb);
 		return NETDEV_TX_OK;
@@ -1064,6 +1167,7 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	}
 
 	dev->tx_pkts_rcvd++;
+	eth_dl_aggr_update(dev);
 	if (dev->gadget->sg_supported) {
 		skb_queue_tail(&dev->tx_skb_q, skb);
 		if (dev->tx_skb_q.qlen > tx_stop_threshold) {
@@ -1075,6 +1179,7 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		return NETDEV_TX_OK;
 	}
 
+wrap:
 	/*
 	 * No buffer copies needed, unless the network stack did it
 	 * or the hardware can't use skb buffers or there's not enough
@@ -1086,11 +1191,17 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	spin_unlock_irqrestore(&dev->lock, flags);
 
 	if (!skb) {
-		dev->net->stats.tx_dropped++;
+		/*
+		 * Multi-frame functions keep the frame for a later NTB,
+		 * which is not a drop; they account their own drops.
+		 */
+		if (!multi_frame)
+			dev->net->stats.tx_dropped++;
 
 		/* no error code for dropped packets */
 		return NETDEV_TX_OK;
 	}
+	length = skb->len;
 
 	/* Allocate memory for tx_reqs to support multi packet transfer */
 	spin_lock_irqsave(&dev->req_lock, flags);
@@ -1148,7 +1259,7 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 
 		spin_lock_irqsave(&dev->req_lock, flags);
 		dev->tx_skb_hold_count++;
-		if (dev->tx_skb_hold_count < dev->dl_max_pkts_per_xfer) {
+		if (dev->tx_skb_hold_count < dev->dl_aggr_limit) {
 
 			/*
 			 * should allow aggregation only, if the number of
@@ -1164,6 +1275,7 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		}
 
 		dev->no_tx_req_used++;
+		eth_tx_aggr_account(dev, dev->tx_skb_hold_count);
 		dev->tx_skb_hold_count = 0;
 		spin_unlock_irqrestore(&dev->req_lock, flags);
 	} else {
@@ -1722,6 +1834,7 @@ void gether_update_dl_max_pkts_per_xfer(struct gether *link, uint32_t n)
 
 	spin_lock_irqsave(&dev->lock, flags);
 	dev->dl_max_pkts_per_xfer = n;
+	eth_dl_aggr_reset(dev);
 	spin_unlock_irqrestore(&dev->lock, flags);
 }
 
@@ -1783,8 +1896,10 @@ struct net_device *gether_connect(struct gether *link)
 	dev->unwrap = link->unwrap;
 	dev->wrap = link->wrap;
 	dev->ul_max_pkts_per_xfer = link->ul_max_pkts_per_xfer;
-	dev->dl_max_pkts_per_xfer = link->dl_max_pkts_per_xfer;
+	dev->dl_max_pkts_per_xfer = min_t(unsigned int,
+			link->dl_max_pkts_per_xfer, DL_MAX_PKTS_PER_XFER);
 	dev->dl_max_xfer_size = link->dl_max_xfer_size;
+	eth_dl_aggr_reset(dev);
 	dev->rx_trigger_enabled = link->rx_trigger_enabled;
 
 	if (result == 0)
@@ -1968,6 +2083,13 @@ static int uether_stat_show(struct seq_file *s, void *unused)
 		seq_printf(s, "\nloop_brk_cnt = %u\n tx_pkts_rcvd=%u\n",
 					dev->loop_brk_cnt,
 					dev->tx_pkts_rcvd);
+		seq_printf(s, "dl_aggr_limit=%u dl_max_pkts_per_xfer=%u\n",
+					dev->dl_aggr_limit,
+					dev->dl_max_pkts_per_xfer);
+		seq_printf(s, "dl_aggr_rate=%u pps grow=%u shrink=%u\n",
+					dev->dl_aggr_rate,
+					dev->dl_aggr_grow,
+					dev->dl_aggr_shrink);
 	}
 
 	return ret;
@@ -1989,6 +2111,9 @@ static ssize_t uether_stat_reset(struct file *file,
 	/* Reset tx_throttle */
 	dev->tx_throttle = 0;
 	dev->rx_throttle = 0;
+	memset(dev->tx_aggr_cnt, 0, sizeof(dev->tx_aggr_cnt));
+	dev->dl_aggr_grow = 0;
+	dev->dl_aggr_shrink = 0;
 	spin_unlock_irqrestore(&dev->lock, flags);
 	return count;
 }
@@ -59,6 +59,8 @@ struct gether {
 	uint32_t			dl_max_pkts_per_xfer;
 	uint32_t			dl_max_xfer_size;
 	bool				multi_pkt_xfer;
+	/* wrap() may hold frames back and return NULL, see f_ncm */
+	bool				supports_multi_frame;
 	bool				rx_trigger_enabled;
 	bool				rx_triggered;
 	struct sk_buff			*(*wrap)(struct gether *port,
@@ -20,6 +20,7 @@
 #include <linux/module.h>
 #include <linux/uaccess.h>
 #include <linux/delay.h>
+#include <linux/math64.h>
 #include <linux/dma-buf.h>
 #include <linux/pm_runtime.h>
 
@@ -28,6 +29,7 @@
 #include "mdp3_ppp.h"
 
 #define VSYNC_EXPIRE_TICK	4
+#define MDP3_IDLE_FPS_MS	1000
 
 static void mdp3_ctrl_pan_display(struct msm_fb_data_type *mfd);
 static int mdp3_overlay_unset(struct msm_fb_data_type *mfd, int ndx);
@@ -136,26 +138,6 @@ int mdp3_ctrl_notify(struct mdp3_session_data *ses, int event)
 	return blocking_notifier_call_chain(&ses->notifier_head, event, ses);
 }
 
-static void mdp3_dispatch_dma_done(struct work_struct *work)
-{
-	struct mdp3_session_data *session;
-	int cnt = 0;
-
-	pr_debug("%s\n", __func__);
-	session = container_of(work, struct mdp3_session_data,
-				dma_done_work);
-	if (!session)
-		return;
-
-	cnt = atomic_read(&session->dma_done_cnt);
-
-	while (cnt > 0) {
-		mdp3_ctrl_notify(session, MDP_NOTIFY_FRAME_DONE);
-		atomic_dec(&session->dma_done_cnt);
-		cnt--;
-	}
-}
-
 static void mdp3_dispatch_clk_off(struct work_struct *work)
 {
 	struct mdp3_session_data *session;
@@ -209,8 +191,9 @@ void vsync_notify_handler(void *arg)
 void dma_done_notify_handler(void *arg)
 {
 	struct mdp3_session_data *session = (struct mdp3_session_data *)arg;
-	atomic_inc(&session->dma_done_cnt);
-	schedule_work(&session->dma_done_work);
+
+	/* release the frame from here rather than from a work item */
+	mdss_fb_signal_timeline(&session->mfd->mdp_sync_pt_data);
 	complete_all(&session->dma_completion);
 }
 
@@ -420,14 +403,101 @@ static ssize_t mdp3_dyn_pu_store(struct device *dev,
 	return count;
 }
 
+static ssize_t mdp3_idle_fps_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = fbi->par;
+	struct mdp3_session_data *mdp3_session = NULL;
+
+	if (!mfd || !mfd->mdp.private1)
+		return -EAGAIN;
+
+	mdp3_session = (struct mdp3_session_data *)mfd->mdp.private1;
+	return scnprintf(buf, PAGE_SIZE, "%d %d\n", mdp3_session->idle_fps,
+			mfd->panel_info->mipi.frame_rate);
+}
+
+static ssize_t mdp3_idle_fps_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = fbi->par;
+	struct mdp3_session_data *mdp3_session = NULL;
+	int ret, fps;
+
+	if (!mfd || !mfd->mdp.private1)
+		return -EAGAIN;
+
+	mdp3_session = (struct mdp3_session_data *)mfd->mdp.private1;
+	ret = kstrtoint(buf, 10, &fps);
+	if (ret) {
+		pr_err("Invalid input for idle fps: ret = %d\n", ret);
+		return ret;
+	}
+
+	if (fps < 0 || (fps && (fps < mfd->panel_info->min_fps ||
+			fps >= mdp3_session->default_fps))) {
+		pr_err("idle fps %d out of range [%u, %d)\n", fps,
+			mfd->panel_info->min_fps, mdp3_session->default_fps);
+		return -EINVAL;
+	}
+
+	/* a lower rate already in effect is undone by the next commit */
+	mdp3_session->idle_fps = fps;
+	return count;
+}
+
+static ssize_t mdp3_idle_fps_ms_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = fbi->par;
+	struct mdp3_session_data *mdp3_session = NULL;
+
+	if (!mfd || !mfd->mdp.private1)
+		return -EAGAIN;
+
+	mdp3_session = (struct mdp3_session_data *)mfd->mdp.private1;
+	return scnprintf(buf, PAGE_SIZE, "%d\n", mdp3_session->idle_fps_ms);
+}
+
+static ssize_t mdp3_idle_fps_ms_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = fbi->par;
+	struct mdp3_session_data *mdp3_session = NULL;
+	int ret, ms;
+
+	if (!mfd || !mfd->mdp.private1)
+		return -EAGAIN;
+
+	mdp3_session = (struct mdp3_session_data *)mfd->mdp.private1;
+	ret = kstrtoint(buf, 10, &ms);
+	if (ret || ms < 0) {
+		pr_err("Invalid input for idle fps period: ret = %d\n", ret);
+		return ret ? ret : -EINVAL;
+	}
+
+	mdp3_session->idle_fps_ms = ms;
+	return count;
+}
+
 static DEVICE_ATTR(vsync_event, S_IRUGO, mdp3_vsync_show_event, NULL);
 static DEVICE_ATTR(packpattern, S_IRUGO, mdp3_packpattern_show, NULL);
 static DEVICE_ATTR(dyn_pu, S_IRUGO | S_IWUSR | S_IWGRP, mdp3_dyn_pu_show,
 		mdp3_dyn_pu_store);
+static DEVICE_ATTR(idle_fps, S_IRUGO | S_IWUSR | S_IWGRP, mdp3_idle_fps_show,
+		mdp3_idle_fps_store);
+static DEVICE_ATTR(idle_fps_ms, S_IRUGO | S_IWUSR | S_IWGRP,
+		mdp3_idle_fps_ms_show, mdp3_idle_fps_ms_store);
 
 static struct attribute *generic_attrs[] = {
 	&dev_attr_packpattern.attr,
 	&dev_attr_dyn_pu.attr,
+	&dev_attr_idle_fps.attr,
+	&dev_attr_idle_fps_ms.attr,
 	NULL,
 };
 
@@ -473,19 +543,38 @@ static int mdp3_ctrl_clk_enable(struct msm_fb_data_type *mfd, int enable)
 
 static int mdp3_ctrl_res_req_bus(struct msm_fb_data_type *mfd, int status)
 {
+	struct mdp3_session_data *session = mfd->mdp.private1;
 	int rc = 0;
 	u32 vtotal = 0;
 	if (status) {
 		struct mdss_panel_info *panel_info = mfd->panel_info;
 		u64 ab = 0;
 		u64 ib = 0;
+		int vfp = panel_info->lcdc.v_front_porch;
+
+		/* lines added to the porch by idle fps are not fetched */
+		if (session && session->default_fps)
+			vfp = session->default_vfp;
 		vtotal = panel_info->yres + panel_info->lcdc.v_back_porch +
-			panel_info->lcdc.v_front_porch +
-			panel_info->lcdc.v_pulse_width;
+			vfp + panel_info->lcdc.v_pulse_width;
 		ab = panel_info->xres * vtotal * ppp_bpp(mfd->fb_imgType);
 		ab *= panel_info->mipi.frame_rate;
 		/* ab and ib vote should be same for honest voting */
 		ib = ab;
+		/*
+		 * A command mode panel only fetches the ROI of a partial
+		 * update.  ib stays, the ROI still goes out at the line rate
+		 * of a full frame.
+		 */
+		if (session && session->dma && panel_info->partial_update_enabled &&
+		    mdp3_ctrl_get_intf_type(mfd) == MDP3_DMA_OUTPUT_SEL_DSI_CMD) {
+			struct mdp3_rect *roi = &session->dma->roi;
+			u64 frame = (u64)panel_info->xres * panel_info->yres;
+
+			if (roi->w && roi->h && frame &&
+			    (u64)roi->w * roi->h < frame)
+				ab = div64_u64(ab * roi->w * roi->h, frame);
+		}
 		rc = mdp3_bus_scale_set_quota(MDP3_CLIENT_DMA_P, ab, ib);
 	} else {
 		rc = mdp3_bus_scale_set_quota(MDP3_CLIENT_DMA_P, 0, 0);
@@ -493,6 +582,99 @@ static int mdp3_ctrl_res_req_bus(struct msm_fb_data_type *mfd, int status)
 	return rc;
 }
 
+static bool mdp3_ctrl_idle_fps_supported(struct mdp3_session_data *session)
+{
+	struct mdss_panel_info *pinfo = session->mfd->panel_info;
+
+	return session->default_fps &&
+		mdp3_ctrl_get_intf_type(session->mfd) ==
+					MDP3_DMA_OUTPUT_SEL_DSI_VIDEO &&
+		pinfo->dynamic_fps &&
+		pinfo->dfps_update == DFPS_IMMEDIATE_PORCH_UPDATE_MODE;
+}
+
+/*
+ * Change the refresh rate of a running video mode panel by stretching the
+ * vertical front porch, the pixel clock is left alone.  The MDP timing
+ * generator is updated first and the DSI controller follows, both latch
+ * the new total at the next frame boundary.  Called with session->lock.
+ */
+static int mdp3_ctrl_update_fps(struct mdp3_session_data *session,
+				int new_fps)
+{
+	struct msm_fb_data_type *mfd = session->mfd;
+	struct mdss_panel_data *panel = session->panel;
+	struct mdss_panel_info *pinfo = mfd->panel_info;
+	struct mdp3_intf *intf = session->intf;
+	int old_vfp, new_vfp, old_period, new_period;
+	int rc;
+
+	if (new_fps <= 0 || new_fps == pinfo->mipi.frame_rate)
+		return 0;
+
+	if (!intf->set_vsync_period || !panel->event_handler)
+		return -EINVAL;
+
+	old_vfp = pinfo->lcdc.v_front_porch;
+	new_vfp = session->default_vfp + mult_frac(session->default_vtotal,
+				session->default_fps - new_fps, new_fps);
+	old_period = intf->cfg.video.vsync_period;
+	new_period = old_period +
+		(new_vfp - old_vfp) * intf->cfg.video.hsync_period;
+
+	pinfo->lcdc.v_front_porch = new_vfp;
+	intf->set_vsync_period(intf, new_period);
+	rc = panel->event_handler(panel, MDSS_EVENT_PANEL_UPDATE_FPS,
+				(void *)(unsigned long)new_fps);
+	if (rc) {
+		pr_err("%s: fps update to %d failed, rc=%d\n", __func__,
+			new_fps, rc);
+		intf->set_vsync_period(intf, old_period);
+		pinfo->lcdc.v_front_porch = old_vfp;
+		return rc;
+	}
+
+	pinfo->mipi.frame_rate = new_fps;
+	session->vsync_period = 1000 / new_fps;
+	mdp3_ctrl_res_req_bus(mfd, 1);
+	pr_debug("%s: fps=%d vfp=%d\n", __func__, new_fps, new_vfp);
+	return 0;
+}
+
+static void mdp3_ctrl_idle_fps_work(struct work_struct *work)
+{
+	struct mdp3_session_data *session;
+	int fps;
+
+	session = container_of(to_delayed_work(work),
+				struct mdp3_session_data, idle_fps_work);
+
+	mutex_lock(&session->lock);
+	fps = session->idle_fps;
+	if (session->status && session->clk_on && !mdp3_res->idle_pc &&
+		fps && fps < session->mfd->panel_info->mipi.frame_rate)
+		mdp3_ctrl_update_fps(session, fps);
+	mutex_unlock(&session->lock);
+}
+
+/*
+ * A new frame is about to go out: bring the panel back to its full rate
+ * so that this frame is already shown at it, and restart the static
+ * period.  Called with session->lock.
+ */
+static void mdp3_ctrl_idle_fps_kick(struct mdp3_session_data *session)
+{
+	if (!mdp3_ctrl_idle_fps_supported(session))
+		return;
+
+	if (session->mfd->panel_info->mipi.frame_rate != session->default_fps)
+		mdp3_ctrl_update_fps(session, session->default_fps);
+
+	if (session->idle_fps && session->idle_fps_ms)
+		mod_delayed_work(system_wq, &session->idle_fps_work,
+				msecs_to_jiffies(session->idle_fps_ms));
+}
+
 static int mdp3_ctrl_res_req_clk(struct msm_fb_data_type *mfd, int status)
 {
 	int rc = 0;
@@ -625,6 +807,9 @@ static int mdp3_ctrl_intf_init(struct msm_fb_data_type *mfd,
 	} else
 		return -EINVAL;
 
+	/* kept for the timing updates of idle fps */
+	intf->cfg.video = cfg.video;
+
 	if (!(mdp3_session->in_splash_screen)) {
 		if (intf->config)
 			rc = intf->config(intf, &cfg);
@@ -886,6 +1071,8 @@ static int mdp3_ctrl_off(struct msm_fb_data_type *mfd)
 	 */
 	pm_runtime_get_sync(&mdp3_res->pdev->dev);
 
+	cancel_delayed_work_sync(&mdp3_session->idle_fps_work);
+
 	panel = mdp3_session->panel;
 	mutex_lock(&mdp3_session->lock);
 
@@ -941,6 +1128,16 @@ static int mdp3_ctrl_off(struct msm_fb_data_type *mfd)
 		mdp3_splash_done(mfd->panel_info);
 
 		mdp3_irq_deregister();
+
+		/* the interface comes back up at the default rate */
+		if (mdp3_ctrl_idle_fps_supported(mdp3_session)) {
+			mfd->panel_info->lcdc.v_front_porch =
+				mdp3_session->default_vfp;
+			mfd->panel_info->mipi.frame_rate =
+				mdp3_session->default_fps;
+			mdp3_session->vsync_period =
+				1000 / mdp3_session->default_fps;
+		}
 	}
 
 	if (panel->event_handler)
@@ -969,7 +1166,6 @@ static int mdp3_ctrl_off(struct msm_fb_data_type *mfd)
 
 		mdp3_session->vsync_enabled = 0;
 		atomic_set(&mdp3_session->vsync_countdown, 0);
-		atomic_set(&mdp3_session->dma_done_cnt, 0);
 		mdp3_session->clk_on = 0;
 		mdp3_session->in_splash_screen = 0;
 		mdp3_res->solid_fill_vote_en = false;
@@ -1218,6 +1414,43 @@ bool is_roi_valid(struct mdp3_dma_source source_config, struct mdp_rect roi)
 		((roi.y + roi.h) <= source_config.height);
 }
 
+/*
+ * Grow @roi to the start/size alignment and minimum size the panel
+ * needs for its column and page address commands.  An empty ROI, or one
+ * that no longer fits the frame once aligned, becomes a full update.
+ */
+static void mdp3_ctrl_align_roi(struct mdss_panel_info *pinfo,
+				struct mdp3_dma_source *src,
+				struct mdp_rect *roi)
+{
+	u32 x_end, y_end;
+
+	if (!is_roi_valid(*src, *roi))
+		goto full_frame;
+
+	x_end = roi->x + roi->w;
+	y_end = roi->y + roi->h;
+	if (pinfo->xstart_pix_align)
+		roi->x = rounddown(roi->x, pinfo->xstart_pix_align);
+	if (pinfo->ystart_pix_align)
+		roi->y = rounddown(roi->y, pinfo->ystart_pix_align);
+	roi->w = max(x_end - roi->x, pinfo->min_width);
+	roi->h = max(y_end - roi->y, pinfo->min_height);
+	if (pinfo->width_pix_align)
+		roi->w = roundup(roi->w, pinfo->width_pix_align);
+	if (pinfo->height_pix_align)
+		roi->h = roundup(roi->h, pinfo->height_pix_align);
+
+	if (is_roi_valid(*src, *roi))
+		return;
+
+full_frame:
+	roi->x = src->x;
+	roi->y = src->y;
+	roi->w = src->width;
+	roi->h = src->height;
+}
+
 static int mdp3_ctrl_display_commit_kickoff(struct msm_fb_data_type *mfd,
 					struct mdp_display_commit *cmt_data)
 {
@@ -1241,9 +1474,12 @@ static int mdp3_ctrl_display_commit_kickoff(struct msm_fb_data_type *mfd,
 		return -EPERM;
 	}
 
+	if (panel_info->partial_update_enabled)
+		mdp3_ctrl_align_roi(panel_info,
+			&mdp3_session->dma->source_config, &cmt_data->l_roi);
+
 	if (panel_info->partial_update_enabled &&
-		is_roi_valid(mdp3_session->dma->source_config, cmt_data->l_roi)
-		&& update_roi(mdp3_session->dma->roi, cmt_data->l_roi)) {
+		update_roi(mdp3_session->dma->roi, cmt_data->l_roi)) {
 			mdp3_session->dma->roi.x = cmt_data->l_roi.x;
 			mdp3_session->dma->roi.y = cmt_data->l_roi.y;
 			mdp3_session->dma->roi.w = cmt_data->l_roi.w;
@@ -1281,12 +1517,14 @@ static int mdp3_ctrl_display_commit_kickoff(struct msm_fb_data_type *mfd,
 	if (data) {
 		mdp3_ctrl_reset_countdown(mdp3_session, mfd);
 		mdp3_ctrl_clk_enable(mfd, 1);
+		mdp3_ctrl_idle_fps_kick(mdp3_session);
 		if (mdp3_session->dma->update_src_cfg &&
 				panel_info->partial_update_enabled) {
 			panel->panel_info.roi.x = mdp3_session->dma->roi.x;
 			panel->panel_info.roi.y = mdp3_session->dma->roi.y;
 			panel->panel_info.roi.w = mdp3_session->dma->roi.w;
 			panel->panel_info.roi.h = mdp3_session->dma->roi.h;
+			mdp3_ctrl_res_req_bus(mfd, 1);
 			rc = mdp3_session->dma->update(mdp3_session->dma,
 					(void *)(int)data->addr,
 					mdp3_session->intf, (void *)panel);
@@ -1405,6 +1643,7 @@ static void mdp3_ctrl_pan_display(struct msm_fb_data_type *mfd)
 		mdp3_ctrl_reset_countdown(mdp3_session, mfd);
 		mdp3_ctrl_notify(mdp3_session, MDP_NOTIFY_FRAME_BEGIN);
 		mdp3_ctrl_clk_enable(mfd, 1);
+		mdp3_ctrl_idle_fps_kick(mdp3_session);
 		rc = mdp3_session->dma->update(mdp3_session->dma,
 				(void *)(int)(mfd->iova + offset),
 				mdp3_session->intf, NULL);
@@ -2604,7 +2843,8 @@ int mdp3_ctrl_init(struct msm_fb_data_type *mfd)
 	}
 	mutex_init(&mdp3_session->lock);
 	INIT_WORK(&mdp3_session->clk_off_work, mdp3_dispatch_clk_off);
-	INIT_WORK(&mdp3_session->dma_done_work, mdp3_dispatch_dma_done);
+	INIT_DELAYED_WORK(&mdp3_session->idle_fps_work,
+				mdp3_ctrl_idle_fps_work);
 	atomic_set(&mdp3_session->vsync_countdown, 0);
 	mutex_init(&mdp3_session->histo_lock);
 	mdp3_session->dma = mdp3_get_dma_pipe(MDP3_DMA_CAP_ALL);
@@ -2646,6 +2886,11 @@ int mdp3_ctrl_init(struct msm_fb_data_type *mfd)
 	mdp3_session->vsync_timer.function = mdp3_vsync_timer_func;
 	mdp3_session->vsync_timer.data = (u32)mdp3_session;
 	mdp3_session->vsync_period = 1000 / mfd->panel_info->mipi.frame_rate;
+	mdp3_session->default_fps = mfd->panel_info->mipi.frame_rate;
+	mdp3_session->default_vfp = mfd->panel_info->lcdc.v_front_porch;
+	mdp3_session->default_vtotal = mdss_panel_get_vtotal(mfd->panel_info);
+	mdp3_session->idle_fps = mfd->panel_info->min_fps;
+	mdp3_session->idle_fps_ms = MDP3_IDLE_FPS_MS;
 	mfd->mdp.private1 = mdp3_session;
 	INIT_COMPLETION(mdp3_session->dma_completion);
 	if (intf_type != MDP3_DMA_OUTPUT_SEL_DSI_VIDEO)
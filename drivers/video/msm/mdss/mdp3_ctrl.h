@@ -18,6 +18,7 @@
 #include <linux/mutex.h>
 #include <linux/completion.h>
 #include <linux/timer.h>
+#include <linux/workqueue.h>
 
 #include "mdp3.h"
 #include "mdp3_dma.h"
@@ -51,8 +52,6 @@ struct mdp3_session_data {
 	struct mdp3_buffer_queue bufq_in;
 	struct mdp3_buffer_queue bufq_out;
 	struct work_struct clk_off_work;
-	struct work_struct dma_done_work;
-	atomic_t dma_done_cnt;
 	int histo_status;
 	struct mutex histo_lock;
 	int lut_sel;
@@ -67,6 +66,14 @@ struct mdp3_session_data {
 	bool esd_recovery;
 	int dyn_pu_state; /* dynamic partial update status */
 
+	/* idle dynamic fps, video mode panels with porch update only */
+	int default_fps;
+	int default_vfp;
+	int default_vtotal;
+	int idle_fps; /* refresh rate once content is static, 0 disables */
+	int idle_fps_ms; /* static period before dropping to idle_fps */
+	struct delayed_work idle_fps_work;
+
 	bool dma_active;
 	struct completion dma_completion;
 	int (*wait_for_dma_done)(struct mdp3_session_data *session);
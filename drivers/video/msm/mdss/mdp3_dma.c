@@ -1220,6 +1220,20 @@ int dsi_video_stop(struct mdp3_intf *intf)
 	return 0;
 }
 
+/*
+ * Stretch or shrink the vertical front porch of a running interface.  The
+ * display window is programmed relative to the start of the frame, so only
+ * the period needs to change and it is latched at the next frame boundary.
+ */
+int dsi_video_set_vsync_period(struct mdp3_intf *intf, int vsync_period)
+{
+	pr_debug("dsi_video_set_vsync_period %d\n", vsync_period);
+	MDP3_REG_WRITE(MDP3_REG_DSI_VIDEO_VSYNC_PERIOD, vsync_period);
+	wmb();
+	intf->cfg.video.vsync_period = vsync_period;
+	return 0;
+}
+
 int dsi_cmd_config(struct mdp3_intf *intf, struct mdp3_intf_cfg *cfg)
 {
 	u32 id_map = 0;
@@ -1258,16 +1272,19 @@ int mdp3_intf_init(struct mdp3_intf *intf)
 		intf->config = lcdc_config;
 		intf->start = lcdc_start;
 		intf->stop = lcdc_stop;
+		intf->set_vsync_period = NULL;
 		break;
 	case MDP3_DMA_OUTPUT_SEL_DSI_VIDEO:
 		intf->config = dsi_video_config;
 		intf->start = dsi_video_start;
 		intf->stop = dsi_video_stop;
+		intf->set_vsync_period = dsi_video_set_vsync_period;
 		break;
 	case MDP3_DMA_OUTPUT_SEL_DSI_CMD:
 		intf->config = dsi_cmd_config;
 		intf->start = dsi_cmd_start;
 		intf->stop = dsi_cmd_stop;
+		intf->set_vsync_period = NULL;
 		break;
 
 	default:
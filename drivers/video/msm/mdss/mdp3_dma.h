@@ -378,6 +378,7 @@ struct mdp3_intf {
 	int (*config)(struct mdp3_intf *intf, struct mdp3_intf_cfg *cfg);
 	int (*start)(struct mdp3_intf *intf);
 	int (*stop)(struct mdp3_intf *intf);
+	int (*set_vsync_period)(struct mdp3_intf *intf, int vsync_period);
 };
 
 int mdp3_dma_init(struct mdp3_dma *dma);
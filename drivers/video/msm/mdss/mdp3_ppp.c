@@ -113,6 +113,9 @@ struct ppp_status {
 	bool bw_update;
 	bool bw_on;
 	u32 mdp_clk;
+
+	bool batch; /* Layers of a request list are queued back to back */
+	bool busy; /* A batched blit has been kicked off and not waited for */
 };
 
 static struct ppp_status *ppp_stat;
@@ -361,6 +364,12 @@ static int mdp3_ppp_callback_setup(void)
 void mdp3_ppp_kickoff(void)
 {
 	init_completion(&ppp_stat->ppp_comp);
+	if (ppp_stat->batch) {
+		/* Left to the next layer, or the end of the list, to wait */
+		ppp_enable();
+		ppp_stat->busy = true;
+		return;
+	}
 	mdp3_irq_enable(MDP3_PPP_DONE);
 	ppp_enable();
 	ATRACE_BEGIN("mdp3_wait_for_ppp_comp");
@@ -369,6 +378,16 @@ void mdp3_ppp_kickoff(void)
 	mdp3_irq_disable(MDP3_PPP_DONE);
 }
 
+static void mdp3_ppp_wait_idle(void)
+{
+	if (!ppp_stat->busy)
+		return;
+	ATRACE_BEGIN("mdp3_wait_for_ppp_comp");
+	mdp3_ppp_pipe_wait();
+	ATRACE_END("mdp3_wait_for_ppp_comp");
+	ppp_stat->busy = false;
+}
+
 struct bpp_info {
 	int bpp_num;
 	int bpp_den;
@@ -705,6 +724,9 @@ int mdp3_ppp_turnon(struct msm_fb_data_type *mfd, int on_off)
 
 void mdp3_start_ppp(struct ppp_blit_op *blit_op)
 {
+	/* Registers are not double buffered, let a batched blit finish */
+	mdp3_ppp_wait_idle();
+
 	/* Wait for the pipe to clear */
 	if (MDP3_REG_READ(MDP3_REG_DISPLAY_STATUS) &
 			MDP3_PPP_ACTIVE) {
@@ -1491,8 +1513,6 @@ static void mdp3_ppp_blit_wq_handler(struct work_struct *work)
 	struct msm_fb_data_type *mfd = ppp_stat->mfd;
 	struct blit_req_list *req;
 	int i, rc = 0;
-	bool smart_blit = false;
-	int smart_blit_fg_index = -1;
 
 	mutex_lock(&ppp_stat->config_ppp_mutex);
 	req = mdp3_ppp_next_req(&ppp_stat->req_q);
@@ -1527,31 +1547,34 @@ static void mdp3_ppp_blit_wq_handler(struct work_struct *work)
 			ppp_stat->bw_update = false;
 		}
 		ATRACE_BEGIN("mpd3_ppp_start");
+		/*
+		 * Each layer only waits for the blit of the previous one
+		 * right before programming the registers, so validating and
+		 * setting up a layer overlaps the blit before it, and
+		 * PPP_DONE stays enabled across the whole list.
+		 */
+		ppp_stat->batch = true;
+		mdp3_irq_enable(MDP3_PPP_DONE);
 		for (i = 0; i < req->count; i++) {
-			smart_blit = is_blit_optimization_possible(req, i);
-			if (smart_blit)
-				/* Blit request index of FG layer in smart blit */
-				smart_blit_fg_index = i + 1;
-			if (!(req->req_list[i].flags & MDP_NO_BLIT)) {
-				/* Do the actual blit. */
-				if (!rc) {
-					rc = mdp3_ppp_start_blit(mfd,
-						&(req->req_list[i]),
-						&req->src_data[i],
-						&req->dst_data[i]);
-				}
-				/* Unmap blit source buffer */
-				if (smart_blit == false)
-					mdp3_put_img(&req->src_data[i], MDP3_CLIENT_PPP);
-				if (smart_blit_fg_index == i) {
-					/* Unmap smart blit background buffer */
-					mdp3_put_img(&req->src_data[i - 1], MDP3_CLIENT_PPP);
-					smart_blit_fg_index = -1;
-				}
-				mdp3_put_img(&req->dst_data[i], MDP3_CLIENT_PPP);
-				smart_blit = false;
+			/* May swap layers 0 and 1 for smart blit */
+			is_blit_optimization_possible(req, i);
+			/* Do the actual blit. */
+			if (!(req->req_list[i].flags & MDP_NO_BLIT) && !rc)
+				rc = mdp3_ppp_start_blit(mfd,
+					&(req->req_list[i]),
+					&req->src_data[i],
+					&req->dst_data[i]);
+		}
+		mdp3_ppp_wait_idle();
+		mdp3_irq_disable(MDP3_PPP_DONE);
+		ppp_stat->batch = false;
 
-			}
+		/* Unmap the buffers once the hardware is done with all */
+		for (i = 0; i < req->count; i++) {
+			if (req->req_list[i].flags & MDP_NO_BLIT)
+				continue;
+			mdp3_put_img(&req->src_data[i], MDP3_CLIENT_PPP);
+			mdp3_put_img(&req->dst_data[i], MDP3_CLIENT_PPP);
 		}
 		ATRACE_END("mdp3_ppp_start");
 		/* Signal to release fence */
@@ -15,6 +15,8 @@
 #include <linux/spinlock.h>
 #include <linux/ktime.h>
 #include <linux/debugfs.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
 
 #include "mdss.h"
 #include "mdss_mdp.h"
@@ -31,12 +33,23 @@ struct tlog {
 	u32 data_cnt;
 };
 
+/*
+ * Each cpu logs into its own ring with only local interrupts disabled, so
+ * logging from the vsync and commit paths never contends on a shared lock.
+ * The rings are merged by timestamp when dumped.
+ */
 struct mdss_dbg_xlog {
 	struct tlog logs[MDSS_XLOG_ENTRY];
-	int first;
-	int last;
-	spinlock_t xlock;
-} mdss_dbg_xlog;
+	u32 next;
+};
+
+static DEFINE_PER_CPU(struct mdss_dbg_xlog, mdss_dbg_xlog);
+
+/* serializes dumps, and protects the merge cursors below */
+static DEFINE_SPINLOCK(xlog_dump_lock);
+static u32 xlog_pos[NR_CPUS];
+static u32 xlog_end[NR_CPUS];
+static u32 xlog_top[NR_CPUS];
 
 static int mdss_xlog_dump_open(struct inode *inode, struct file *file)
 {
@@ -60,8 +73,6 @@ static const struct file_operations mdss_xlog_fops = {
 
 int mdss_create_xlog_debug(struct mdss_debug_data *mdd)
 {
-	spin_lock_init(&mdss_dbg_xlog.xlock);
-
 	mdd->logd.xlog = debugfs_create_dir("xlog", mdd->root);
 	if (IS_ERR_OR_NULL(mdd->logd.xlog)) {
 		pr_err("debugfs_create_dir fail, error %ld\n",
@@ -71,6 +82,9 @@ int mdss_create_xlog_debug(struct mdss_debug_data *mdd)
 	}
 	debugfs_create_file("dump", 0644, mdd->logd.xlog, NULL,
 						&mdss_xlog_fops);
+
+	/* logging is cheap enough now to keep it on for field issues */
+	mdd->logd.xlog_enable = true;
 	debugfs_create_bool("enable", 0644, mdd->logd.xlog,
 			    &mdd->logd.xlog_enable);
 	debugfs_create_bool("panic", 0644, mdd->logd.xlog,
@@ -84,23 +98,21 @@ void mdss_xlog(const char *name, ...)
 {
 	struct mdss_data_type *mdata = mdss_mdp_get_mdata();
 	struct mdss_debug_data *mdd = mdata->debug_inf.debug_data;
+	struct mdss_dbg_xlog *xlog;
 	unsigned long flags;
 	int i, val = 0;
 	va_list args;
 	struct tlog *log;
-	ktime_t time;
 
 	if (!mdd->logd.xlog_enable)
 		return;
 
-	spin_lock_irqsave(&mdss_dbg_xlog.xlock, flags);
+	local_irq_save(flags);
 
-	time = ktime_get();
-
-	log = &mdss_dbg_xlog.logs[mdss_dbg_xlog.first];
+	xlog = this_cpu_ptr(&mdss_dbg_xlog);
+	log = &xlog->logs[xlog->next % MDSS_XLOG_ENTRY];
 	log->tick = local_clock();
 	log->name = name;
-	log->data_cnt = 0;
 
 	va_start(args, name);
 	for (i = 0; i < MDSS_XLOG_MAX_DATA; i++) {
@@ -114,35 +126,98 @@ void mdss_xlog(const char *name, ...)
 	va_end(args);
 
 	log->data_cnt = i;
+	xlog->next++;
+
+	local_irq_restore(flags);
+}
+
+/*
+ * Pick the cpu whose next entry in the given direction is the oldest
+ * (forward) or the newest (backward), or -1 once all rings are drained.
+ */
+static int mdss_xlog_pick_cpu(bool forward)
+{
+	struct tlog *log;
+	u64 best = 0;
+	int cpu, sel = -1;
+
+	for_each_possible_cpu(cpu) {
+		struct mdss_dbg_xlog *xlog = &per_cpu(mdss_dbg_xlog, cpu);
+
+		if (xlog_pos[cpu] == xlog_end[cpu])
+			continue;
+
+		if (forward)
+			log = &xlog->logs[xlog_pos[cpu] % MDSS_XLOG_ENTRY];
+		else
+			log = &xlog->logs[(xlog_end[cpu] - 1) %
+				MDSS_XLOG_ENTRY];
 
-	mdss_dbg_xlog.last = mdss_dbg_xlog.first;
-	mdss_dbg_xlog.first++;
-	mdss_dbg_xlog.first %= MDSS_XLOG_ENTRY;
+		if (sel < 0 || (forward ? log->tick < best : log->tick > best)) {
+			best = log->tick;
+			sel = cpu;
+		}
+	}
 
-	spin_unlock_irqrestore(&mdss_dbg_xlog.xlock, flags);
+	return sel;
 }
 
 void mdss_xlog_dump(void)
 {
 	struct mdss_data_type *mdata = mdss_mdp_get_mdata();
 	struct mdss_debug_data *mdd = mdata->debug_inf.debug_data;
-	int i, n, d_cnt, off;
+	int cpu, n, d_cnt, off;
 	unsigned long flags;
 	unsigned long rem_nsec;
 	struct tlog *log;
+	u64 tick;
 	char xlog_buf[MDSS_XLOG_BUF_MAX];
 
 	if (!mdd->logd.xlog_enable)
 		return;
 
-	spin_lock_irqsave(&mdss_dbg_xlog.xlock, flags);
-	i = mdss_dbg_xlog.first;
+	spin_lock_irqsave(&xlog_dump_lock, flags);
+
+	/* snapshot what each cpu has logged so far */
+	for_each_possible_cpu(cpu) {
+		struct mdss_dbg_xlog *xlog = &per_cpu(mdss_dbg_xlog, cpu);
+
+		xlog_top[cpu] = ACCESS_ONCE(xlog->next);
+		xlog_end[cpu] = xlog_top[cpu];
+		xlog_pos[cpu] = xlog_top[cpu] > MDSS_XLOG_ENTRY ?
+			xlog_top[cpu] - MDSS_XLOG_ENTRY : 0;
+	}
+
+	/*
+	 * Walk back from the newest entries to find where the last
+	 * MDSS_XLOG_ENTRY events across all cpus start, then print them
+	 * oldest first.
+	 */
+	for (n = 0; n < MDSS_XLOG_ENTRY; n++) {
+		cpu = mdss_xlog_pick_cpu(false);
+		if (cpu < 0)
+			break;
+		xlog_end[cpu]--;
+	}
+	for_each_possible_cpu(cpu) {
+		xlog_pos[cpu] = xlog_end[cpu];
+		xlog_end[cpu] = xlog_top[cpu];
+	}
+
 	for (n = 0; n < MDSS_XLOG_ENTRY; n++) {
-		log = &mdss_dbg_xlog.logs[i];
-		rem_nsec = do_div(log->tick, 1000000000);
+		cpu = mdss_xlog_pick_cpu(true);
+		if (cpu < 0)
+			break;
+
+		log = &per_cpu(mdss_dbg_xlog, cpu).logs[xlog_pos[cpu] %
+			MDSS_XLOG_ENTRY];
+		xlog_pos[cpu]++;
+
+		tick = log->tick;
+		rem_nsec = do_div(tick, 1000000000);
 		off = snprintf(xlog_buf, MDSS_XLOG_BUF_MAX,
-				"%-32s => [%5llu.%06lu]: ", log->name,
-					log->tick, rem_nsec / 1000);
+				"%-32s => [%5llu.%06lu] %d: ", log->name,
+					tick, rem_nsec / 1000, cpu);
 		for (d_cnt = 0; d_cnt < log->data_cnt;) {
 			off += snprintf((xlog_buf + off),
 					(MDSS_XLOG_BUF_MAX - off),
@@ -150,10 +225,8 @@ void mdss_xlog_dump(void)
 			d_cnt++;
 		}
 		pr_err("%s\n", xlog_buf);
-
-		i = (i + 1) % MDSS_XLOG_ENTRY;
 	}
-	spin_unlock_irqrestore(&mdss_dbg_xlog.xlock, flags);
+	spin_unlock_irqrestore(&xlog_dump_lock, flags);
 }
 
 void mdss_xlog_tout_handler(const char *name, ...)
@@ -250,6 +250,7 @@ struct dsi_panel_cmds {
 	struct dsi_cmd_desc *cmds;
 	int cmd_cnt;
 	int link_state;
+	struct dsi_cmd_packed packed;
 };
 
 struct dsi_kickoff_action {
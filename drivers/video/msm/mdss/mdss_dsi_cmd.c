@@ -567,6 +567,109 @@ int mdss_dsi_cmd_dma_add(struct dsi_buf *dp, struct dsi_cmd_desc *cm)
 	return len;
 }
 
+static inline int mdss_dsi_pkt_len(struct dsi_cmd_desc *cm)
+{
+	return DSI_HOST_HDR_SIZE + ALIGN(cm->dchdr.dlen, 4);
+}
+
+/*
+ * mdss_dsi_cmds_pack() - build the DMA image of a command sequence
+ * @cmds: command sequence as parsed from the panel node
+ * @cnt: number of commands
+ * @pk: packed sequence to fill in
+ * @max_len: largest single DMA transfer, the tx buffer size
+ *
+ * A chain which ends without a delay or an ack is merged with the next one,
+ * so a sequence only needs a new DMA transfer where the panel asks for a
+ * pause, or where the transfer would not fit in @max_len. The last flag of
+ * each packet is rewritten to match the transfers it ends up in.
+ *
+ * Returns 0, or a negative error when the sequence can not be prebuilt and
+ * has to be sent with mdss_dsi_cmds_tx().
+ */
+int mdss_dsi_cmds_pack(struct dsi_cmd_desc *cmds, int cnt,
+		struct dsi_cmd_packed *pk, int max_len)
+{
+	struct dsi_buf tp;
+	struct dsi_cmd_desc cm;
+	struct dsi_packed_seg *segs;
+	int i, len, size = 0, seg_len = 0, seg_cnt = 0;
+	bool end;
+
+	memset(pk, 0, sizeof(*pk));
+
+	for (i = 0; i < cnt; i++) {
+		switch (cmds[i].dchdr.dtype) {
+		case DTYPE_GEN_READ:
+		case DTYPE_GEN_READ1:
+		case DTYPE_GEN_READ2:
+		case DTYPE_DCS_READ:
+			return -EINVAL;
+		}
+		if (mdss_dsi_pkt_len(&cmds[i]) > max_len)
+			return -E2BIG;
+		size += mdss_dsi_pkt_len(&cmds[i]);
+	}
+
+	if (!size)
+		return -EINVAL;
+
+	memset(&tp, 0, sizeof(tp));
+	tp.start = kzalloc(size, GFP_KERNEL);
+	segs = kcalloc(cnt, sizeof(*segs), GFP_KERNEL);
+	if (!tp.start || !segs) {
+		kfree(tp.start);
+		kfree(segs);
+		return -ENOMEM;
+	}
+	tp.end = tp.start + size;
+	tp.size = size;
+	tp.data = tp.start;
+
+	for (i = 0; i < cnt; i++) {
+		cm = cmds[i];
+		end = (i == cnt - 1) ||
+			(cm.dchdr.last && (cm.dchdr.wait || cm.dchdr.ack)) ||
+			(seg_len + mdss_dsi_pkt_len(&cmds[i]) +
+			 mdss_dsi_pkt_len(&cmds[i + 1]) > max_len);
+		cm.dchdr.last = end;
+
+		len = mdss_dsi_cmd_dma_add(&tp, &cm);
+		if (!len) {
+			pr_err("%s: failed to add cmd = 0x%x\n",
+				__func__, cm.payload ? cm.payload[0] : 0);
+			kfree(tp.start);
+			kfree(segs);
+			return -EINVAL;
+		}
+		mdss_dsi_buf_reserve(&tp, len);
+		seg_len += len;
+
+		if (end) {
+			segs[seg_cnt].len = seg_len;
+			segs[seg_cnt].wait = cm.dchdr.wait;
+			seg_cnt++;
+			seg_len = 0;
+		}
+	}
+
+	pk->buf = tp.start;
+	pk->len = tp.len;
+	pk->segs = segs;
+	pk->seg_cnt = seg_cnt;
+
+	pr_debug("%s: %d cmds packed into %d transfers, len=%d\n",
+		__func__, cnt, seg_cnt, pk->len);
+	return 0;
+}
+
+void mdss_dsi_cmds_unpack(struct dsi_cmd_packed *pk)
+{
+	kfree(pk->buf);
+	kfree(pk->segs);
+	memset(pk, 0, sizeof(*pk));
+}
+
 /*
  * mdss_dsi_short_read1_resp: 1 parameter
  */
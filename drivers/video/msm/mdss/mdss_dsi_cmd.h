@@ -14,11 +14,14 @@
 #ifndef MDSS_DSI_CMD_H
 #define MDSS_DSI_CMD_H
 
+#include <linux/sizes.h>
+
 #include "mdss.h"
 
 struct mdss_dsi_ctrl_pdata;
 
 #define DSI_HOST_HDR_SIZE	4
+#define DSI_TX_BUF_SIZE		SZ_4K
 #define DSI_HDR_LAST		BIT(31)
 #define DSI_HDR_LONG_PKT	BIT(30)
 #define DSI_HDR_BTA		BIT(29)
@@ -104,9 +107,27 @@ struct dsi_cmd_desc {
 #define CMD_REQ_LP_MODE 0x0010
 #define CMD_REQ_HS_MODE 0x0020
 
+/* one DMA transfer of a packed command sequence */
+struct dsi_packed_seg {
+	int len;	/* bytes, host headers included */
+	int wait;	/* ms, after the transfer */
+};
+
+/*
+ * Host formatted image of a whole command sequence, built once by
+ * mdss_dsi_cmds_pack() and copied into the tx buffer segment by segment.
+ */
+struct dsi_cmd_packed {
+	char *buf;
+	int len;
+	struct dsi_packed_seg *segs;
+	int seg_cnt;
+};
+
 struct dcs_cmd_req {
 	struct dsi_cmd_desc *cmds;
 	int cmds_cnt;
+	struct dsi_cmd_packed *packed;	/* optional prebuilt form of cmds */
 	u32 flags;
 	int rlen;       /* rx length */
 	char *rbuf;	/* rx buf */
@@ -127,6 +148,9 @@ char *mdss_dsi_buf_reserve_hdr(struct dsi_buf *dp, int hlen);
 char *mdss_dsi_buf_init(struct dsi_buf *dp);
 int mdss_dsi_buf_alloc(struct device *ctrl_dev, struct dsi_buf *dp, int size);
 int mdss_dsi_cmd_dma_add(struct dsi_buf *dp, struct dsi_cmd_desc *cm);
+int mdss_dsi_cmds_pack(struct dsi_cmd_desc *cmds, int cnt,
+		struct dsi_cmd_packed *pk, int max_len);
+void mdss_dsi_cmds_unpack(struct dsi_cmd_packed *pk);
 int mdss_dsi_short_read1_resp(struct dsi_buf *rp);
 int mdss_dsi_short_read2_resp(struct dsi_buf *rp);
 int mdss_dsi_long_read_resp(struct dsi_buf *rp);
@@ -111,7 +111,7 @@ void mdss_dsi_ctrl_init(struct device *ctrl_dev,
 	mutex_init(&ctrl->mutex);
 	mutex_init(&ctrl->cmd_mutex);
 	mutex_init(&ctrl->clk_lane_mutex);
-	mdss_dsi_buf_alloc(ctrl_dev, &ctrl->tx_buf, SZ_4K);
+	mdss_dsi_buf_alloc(ctrl_dev, &ctrl->tx_buf, DSI_TX_BUF_SIZE);
 	mdss_dsi_buf_alloc(ctrl_dev, &ctrl->rx_buf, SZ_4K);
 	mdss_dsi_buf_alloc(ctrl_dev, &ctrl->status_buf, SZ_4K);
 	ctrl->cmdlist_commit = mdss_dsi_cmdlist_commit;
@@ -1320,13 +1320,39 @@ static int mdss_dsi_cmd_dma_tpg_tx(struct mdss_dsi_ctrl_pdata *ctrl,
 	return ret;
 }
 
+/* send the packets built in @tp as one DMA transfer, then wait @wait_ms */
+static int mdss_dsi_buf_tx(struct mdss_dsi_ctrl_pdata *ctrl,
+			struct dsi_buf *tp, int wait_ms, int use_dma_tpg)
+{
+	int len, wait;
+
+	tp->data = tp->start; /* begin of buf */
+
+	wait = mdss_dsi_wait4video_eng_busy(ctrl);
+
+	mdss_dsi_enable_irq(ctrl, DSI_CMD_TERM);
+	if (use_dma_tpg)
+		len = mdss_dsi_cmd_dma_tpg_tx(ctrl, tp);
+	else
+		len = mdss_dsi_cmd_dma_tx(ctrl, tp);
+	if (IS_ERR_VALUE(len)) {
+		mdss_dsi_disable_irq(ctrl, DSI_CMD_TERM);
+		return len;
+	}
+
+	if (!wait || wait_ms > VSYNC_PERIOD)
+		usleep(wait_ms * 1000);
+
+	return len;
+}
+
 static int mdss_dsi_cmds2buf_tx(struct mdss_dsi_ctrl_pdata *ctrl,
 			struct dsi_cmd_desc *cmds, int cnt, int use_dma_tpg)
 {
 	struct dsi_buf *tp;
 	struct dsi_cmd_desc *cm;
 	struct dsi_ctrl_hdr *dchdr;
-	int len, wait, tot = 0;
+	int len, tot = 0;
 
 	tp = &ctrl->tx_buf;
 	mdss_dsi_buf_init(tp);
@@ -1343,25 +1369,14 @@ static int mdss_dsi_cmds2buf_tx(struct mdss_dsi_ctrl_pdata *ctrl,
 		}
 		tot += len;
 		if (dchdr->last) {
-			tp->data = tp->start; /* begin of buf */
-
-			wait = mdss_dsi_wait4video_eng_busy(ctrl);
-
-			mdss_dsi_enable_irq(ctrl, DSI_CMD_TERM);
-			if (use_dma_tpg)
-				len = mdss_dsi_cmd_dma_tpg_tx(ctrl, tp);
-			else
-				len = mdss_dsi_cmd_dma_tx(ctrl, tp);
+			len = mdss_dsi_buf_tx(ctrl, tp, dchdr->wait,
+					use_dma_tpg);
 			if (IS_ERR_VALUE(len)) {
-				mdss_dsi_disable_irq(ctrl, DSI_CMD_TERM);
 				pr_err("%s: failed to call cmd_dma_tx for cmd = 0x%x\n",
 					__func__,  cmds->payload[0]);
 				return 0;
 			}
 
-			if (!wait || dchdr->wait > VSYNC_PERIOD)
-				usleep(dchdr->wait * 1000);
-
 			mdss_dsi_buf_init(tp);
 			len = 0;
 		}
@@ -1370,6 +1385,41 @@ static int mdss_dsi_cmds2buf_tx(struct mdss_dsi_ctrl_pdata *ctrl,
 	return tot;
 }
 
+/*
+ * Send a sequence prebuilt by mdss_dsi_cmds_pack(), one DMA transfer and
+ * completion per segment instead of per command chain.
+ */
+static int mdss_dsi_packed2buf_tx(struct mdss_dsi_ctrl_pdata *ctrl,
+			struct dsi_cmd_packed *pk)
+{
+	struct dsi_buf *tp = &ctrl->tx_buf;
+	char *bp = pk->buf;
+	int i, len, tot = 0;
+
+	for (i = 0; i < pk->seg_cnt; i++) {
+		mdss_dsi_buf_init(tp);
+		if (pk->segs[i].len > tp->end - tp->data) {
+			pr_err("%s: segment %d too long, len=%d\n",
+				__func__, i, pk->segs[i].len);
+			return 0;
+		}
+		memcpy(tp->data, bp, pk->segs[i].len);
+		tp->len = pk->segs[i].len;
+
+		len = mdss_dsi_buf_tx(ctrl, tp, pk->segs[i].wait, 0);
+		if (IS_ERR_VALUE(len)) {
+			pr_err("%s: failed to call cmd_dma_tx for segment %d\n",
+				__func__, i);
+			return 0;
+		}
+		bp += pk->segs[i].len;
+		tot += pk->segs[i].len;
+	}
+	mdss_dsi_buf_init(tp);
+
+	return tot;
+}
+
 /**
  * __mdss_dsi_cmd_mode_config() - Enable/disable command mode engine
  * @ctrl: pointer to the dsi controller structure
@@ -1405,11 +1455,12 @@ static inline bool __mdss_dsi_cmd_mode_config(
 }
 
 /*
- * mdss_dsi_cmds_tx:
- * thread context only
+ * __mdss_dsi_cmds_tx:
+ * thread context only, @packed is used instead of @cmds when given
  */
-int mdss_dsi_cmds_tx(struct mdss_dsi_ctrl_pdata *ctrl,
-		struct dsi_cmd_desc *cmds, int cnt, int use_dma_tpg)
+static int __mdss_dsi_cmds_tx(struct mdss_dsi_ctrl_pdata *ctrl,
+		struct dsi_cmd_desc *cmds, int cnt,
+		struct dsi_cmd_packed *packed, int use_dma_tpg)
 {
 	int len = 0;
 	struct mdss_dsi_ctrl_pdata *mctrl = NULL;
@@ -1444,7 +1495,10 @@ int mdss_dsi_cmds_tx(struct mdss_dsi_ctrl_pdata *ctrl,
 do_send:
 	ctrl->cmd_cfg_restore = __mdss_dsi_cmd_mode_config(ctrl, 1);
 
-	len = mdss_dsi_cmds2buf_tx(ctrl, cmds, cnt, use_dma_tpg);
+	if (packed)
+		len = mdss_dsi_packed2buf_tx(ctrl, packed);
+	else
+		len = mdss_dsi_cmds2buf_tx(ctrl, cmds, cnt, use_dma_tpg);
 	if (!len)
 		pr_err("%s: failed to call\n", __func__);
 
@@ -1463,6 +1517,12 @@ do_send:
 	return len;
 }
 
+int mdss_dsi_cmds_tx(struct mdss_dsi_ctrl_pdata *ctrl,
+		struct dsi_cmd_desc *cmds, int cnt, int use_dma_tpg)
+{
+	return __mdss_dsi_cmds_tx(ctrl, cmds, cnt, NULL, use_dma_tpg);
+}
+
 /* MIPI_DSI_MRPS, Maximum Return Packet Size */
 static char max_pktsize[2] = {0x00, 0x00}; /* LSB tx first, 10 bytes */
 
@@ -2108,7 +2168,12 @@ int mdss_dsi_cmdlist_tx(struct mdss_dsi_ctrl_pdata *ctrl,
 			ctrl->do_unicast = true;
 	}
 
-	len = mdss_dsi_cmds_tx(ctrl, req->cmds, req->cmds_cnt,
+	/* the DMA TPG FIFO is too small for a prebuilt sequence */
+	if (req->packed && !(req->flags & CMD_REQ_DMA_TPG))
+		len = __mdss_dsi_cmds_tx(ctrl, req->cmds, req->cmds_cnt,
+				req->packed, 0);
+	else
+		len = mdss_dsi_cmds_tx(ctrl, req->cmds, req->cmds_cnt,
 				(req->flags & CMD_REQ_DMA_TPG));
 
 	if (req->cb)
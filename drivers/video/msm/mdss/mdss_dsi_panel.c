@@ -162,6 +162,8 @@ static void mdss_dsi_panel_cmds_send(struct mdss_dsi_ctrl_pdata *ctrl,
 	memset(&cmdreq, 0, sizeof(cmdreq));
 	cmdreq.cmds = pcmds->cmds;
 	cmdreq.cmds_cnt = pcmds->cmd_cnt;
+	if (pcmds->packed.seg_cnt)
+		cmdreq.packed = &pcmds->packed;
 	cmdreq.flags = CMD_REQ_COMMIT;
 
 	/*Panel ON/Off commands should be sent in DSI Low Power Mode*/
@@ -854,6 +856,26 @@ exit_free:
 }
 
 
+/*
+ * Build the DMA image of a command sequence once, so that sending it only
+ * takes a copy and one DMA transfer per delay the panel asks for.
+ */
+static void mdss_dsi_pack_dcs_cmds(struct device_node *np,
+		struct dsi_panel_cmds *pcmds)
+{
+	int rc;
+
+	if (!pcmds->cmd_cnt ||
+		of_property_read_bool(np, "qcom,mdss-dsi-no-cmd-packing"))
+		return;
+
+	rc = mdss_dsi_cmds_pack(pcmds->cmds, pcmds->cmd_cnt, &pcmds->packed,
+				DSI_TX_BUF_SIZE);
+	if (rc)
+		pr_debug("%s: sending dcs_cmd=%x unpacked, rc=%d\n",
+			__func__, pcmds->buf[0], rc);
+}
+
 int mdss_panel_get_dst_fmt(u32 bpp, char mipi_mode, u32 pixel_packing,
 				char *dst_format)
 {
@@ -1790,6 +1812,10 @@ static int mdss_panel_parse_dt(struct device_node *np,
 	mdss_dsi_parse_dcs_cmds(np, &ctrl_pdata->off_cmds,
 		"qcom,mdss-dsi-off-command", "qcom,mdss-dsi-off-command-state");
 
+	mdss_dsi_pack_dcs_cmds(np, &ctrl_pdata->on_cmds);
+	mdss_dsi_pack_dcs_cmds(np, &ctrl_pdata->post_panel_on_cmds);
+	mdss_dsi_pack_dcs_cmds(np, &ctrl_pdata->off_cmds);
+
 	mdss_dsi_parse_dcs_cmds(np, &ctrl_pdata->status_cmds,
 			"qcom,mdss-dsi-panel-status-command",
 				"qcom,mdss-dsi-panel-status-command-state");
@@ -50,6 +50,7 @@
 
 #include <linux/qcom_iommu.h>
 #include <linux/msm_iommu_domains.h>
+#include <soc/qcom/boot_stats.h>
 
 #include "mdss_fb.h"
 #include "mdss_mdp_splash_logo.h"
@@ -104,6 +105,7 @@ static int __mdss_fb_sync_buf_done_callback(struct notifier_block *p,
 		unsigned long val, void *data);
 
 static int __mdss_fb_display_thread(void *data);
+static int __mdss_fb_fence_thread(void *data);
 static int mdss_fb_pan_idle(struct msm_fb_data_type *mfd);
 static int mdss_fb_send_panel_event(struct msm_fb_data_type *mfd,
 					int event, void *arg);
@@ -1249,7 +1251,28 @@ static int mdss_fb_start_disp_thread(struct msm_fb_data_type *mfd)
 
 	mdss_fb_get_split(mfd);
 
+	/*
+	 * Drivers which wait for the acquire fences themselves pick them up
+	 * from the sync point data at kickoff, so they cannot have a second
+	 * commit queued behind the one being processed.
+	 */
+	mfd->commit_depth = mfd->mdp_sync_pt_data.async_wait_fences ?
+		1 : MDSS_FB_COMMIT_DEPTH;
+	mfd->commit_head = 0;
+	atomic_set(&mfd->commits_queued, 0);
+	atomic_set(&mfd->commits_fenced, 0);
 	atomic_set(&mfd->commits_pending, 0);
+
+	mfd->fence_thread = kthread_run(__mdss_fb_fence_thread,
+				mfd, "mdss_fb_fence%d", mfd->index);
+	if (IS_ERR(mfd->fence_thread)) {
+		pr_err("ERROR: unable to start fence thread %d\n",
+				mfd->index);
+		ret = PTR_ERR(mfd->fence_thread);
+		mfd->fence_thread = NULL;
+		return ret;
+	}
+
 	mfd->disp_thread = kthread_run(__mdss_fb_display_thread,
 				mfd, "mdss_fb%d", mfd->index);
 
@@ -1258,6 +1281,8 @@ static int mdss_fb_start_disp_thread(struct msm_fb_data_type *mfd)
 				mfd->index);
 		ret = PTR_ERR(mfd->disp_thread);
 		mfd->disp_thread = NULL;
+		kthread_stop(mfd->fence_thread);
+		mfd->fence_thread = NULL;
 	}
 
 	return ret;
@@ -1265,11 +1290,29 @@ static int mdss_fb_start_disp_thread(struct msm_fb_data_type *mfd)
 
 static void mdss_fb_stop_disp_thread(struct msm_fb_data_type *mfd)
 {
+	u32 i;
+
 	pr_debug("%pS: stop display thread fb%d\n",
 		__builtin_return_address(0), mfd->index);
 
+	kthread_stop(mfd->fence_thread);
+	mfd->fence_thread = NULL;
 	kthread_stop(mfd->disp_thread);
 	mfd->disp_thread = NULL;
+
+	/* drop the acquire fences of commits which never got to wait */
+	for (i = atomic_read(&mfd->commits_fenced);
+	     i != atomic_read(&mfd->commits_queued); i++) {
+		struct msm_fb_backup_type *fb_backup =
+			&mfd->msm_fb_backup[i % mfd->commit_depth];
+
+		while (fb_backup->acq_fen_cnt)
+			sync_fence_put(
+				fb_backup->acq_fen[--fb_backup->acq_fen_cnt]);
+	}
+	atomic_set(&mfd->commits_queued, 0);
+	atomic_set(&mfd->commits_fenced, 0);
+	mfd->commit_head = 0;
 }
 
 static void mdss_panel_validate_debugfs_info(struct msm_fb_data_type *mfd)
@@ -2141,8 +2184,12 @@ static int mdss_fb_register(struct msm_fb_data_type *mfd)
 	mutex_init(&mfd->update.lock);
 	mutex_init(&mfd->no_update.lock);
 	mutex_init(&mfd->mdp_sync_pt_data.sync_mutex);
+	spin_lock_init(&mfd->mdp_sync_pt_data.timeline_lock);
 	atomic_set(&mfd->mdp_sync_pt_data.commit_cnt, 0);
 	atomic_set(&mfd->commits_pending, 0);
+	atomic_set(&mfd->commits_queued, 0);
+	atomic_set(&mfd->commits_fenced, 0);
+	mfd->commit_depth = 1;
 	atomic_set(&mfd->ioctl_ref_cnt, 0);
 	atomic_set(&mfd->kickoff_pending, 0);
 
@@ -2157,6 +2204,7 @@ static int mdss_fb_register(struct msm_fb_data_type *mfd)
 	init_completion(&mfd->power_off_comp);
 	init_completion(&mfd->power_set_comp);
 	init_waitqueue_head(&mfd->commit_wait_q);
+	init_waitqueue_head(&mfd->fence_wait_q);
 	init_waitqueue_head(&mfd->idle_wait_q);
 	init_waitqueue_head(&mfd->ioctl_q);
 	init_waitqueue_head(&mfd->kickoff_wait_q);
@@ -2539,11 +2587,14 @@ int mdss_fb_wait_for_fence(struct msm_sync_pt_data *sync_pt_data)
  *			should be signaled.
  *
  * This is called after a frame has been pushed to display. This signals the
- * timeline to release the fences associated with this frame.
+ * timeline to release the fences associated with this frame. It does not
+ * sleep, so it may be called straight from the frame done interrupt.
  */
 void mdss_fb_signal_timeline(struct msm_sync_pt_data *sync_pt_data)
 {
-	mutex_lock(&sync_pt_data->sync_mutex);
+	unsigned long flags;
+
+	spin_lock_irqsave(&sync_pt_data->timeline_lock, flags);
 	if (atomic_add_unless(&sync_pt_data->commit_cnt, -1, 0) &&
 			sync_pt_data->timeline) {
 		sw_sync_timeline_inc(sync_pt_data->timeline, 1);
@@ -2556,7 +2607,7 @@ void mdss_fb_signal_timeline(struct msm_sync_pt_data *sync_pt_data)
 		pr_debug("%s timeline signaled without commits val=%d\n",
 			sync_pt_data->fence_name, sync_pt_data->timeline_value);
 	}
-	mutex_unlock(&sync_pt_data->sync_mutex);
+	spin_unlock_irqrestore(&sync_pt_data->timeline_lock, flags);
 }
 
 /**
@@ -2571,9 +2622,11 @@ void mdss_fb_signal_timeline(struct msm_sync_pt_data *sync_pt_data)
 static void mdss_fb_release_fences(struct msm_fb_data_type *mfd)
 {
 	struct msm_sync_pt_data *sync_pt_data = &mfd->mdp_sync_pt_data;
+	unsigned long flags;
 	int val;
 
 	mutex_lock(&sync_pt_data->sync_mutex);
+	spin_lock_irqsave(&sync_pt_data->timeline_lock, flags);
 	if (sync_pt_data->timeline) {
 		val = sync_pt_data->threshold +
 			atomic_read(&sync_pt_data->commit_cnt);
@@ -2581,6 +2634,7 @@ static void mdss_fb_release_fences(struct msm_fb_data_type *mfd)
 		sync_pt_data->timeline_value += val;
 		atomic_set(&sync_pt_data->commit_cnt, 0);
 	}
+	spin_unlock_irqrestore(&sync_pt_data->timeline_lock, flags);
 	mutex_unlock(&sync_pt_data->sync_mutex);
 }
 
@@ -2652,20 +2706,13 @@ static int __mdss_fb_sync_buf_done_callback(struct notifier_block *p,
 	return NOTIFY_OK;
 }
 
-/**
- * mdss_fb_pan_idle() - wait for panel programming to be idle
- * @mfd:	Framebuffer data structure for display
- *
- * Wait for any pending programming to be done if in the process of programming
- * hardware configuration. After this function returns it is safe to perform
- * software updates for next frame.
- */
-static int mdss_fb_pan_idle(struct msm_fb_data_type *mfd)
+static int __mdss_fb_wait_for_commits(struct msm_fb_data_type *mfd,
+	int max_pending)
 {
 	int ret = 0;
 
 	ret = wait_event_timeout(mfd->idle_wait_q,
-			(!atomic_read(&mfd->commits_pending) ||
+			((atomic_read(&mfd->commits_pending) <= max_pending) ||
 			 mfd->shutdown_pending),
 			msecs_to_jiffies(WAIT_DISP_OP_TIMEOUT));
 	if (!ret) {
@@ -2681,6 +2728,19 @@ static int mdss_fb_pan_idle(struct msm_fb_data_type *mfd)
 	return 0;
 }
 
+/**
+ * mdss_fb_pan_idle() - wait for panel programming to be idle
+ * @mfd:	Framebuffer data structure for display
+ *
+ * Wait for any pending programming to be done if in the process of programming
+ * hardware configuration. After this function returns it is safe to perform
+ * software updates for next frame.
+ */
+static int mdss_fb_pan_idle(struct msm_fb_data_type *mfd)
+{
+	return __mdss_fb_wait_for_commits(mfd, 0);
+}
+
 static int mdss_fb_wait_for_kickoff(struct msm_fb_data_type *mfd)
 {
 	int ret = 0;
@@ -2710,6 +2770,8 @@ static int mdss_fb_pan_display_ex(struct fb_info *info,
 	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
 	struct fb_var_screeninfo *var = &disp_commit->var;
 	u32 wait_for_finish = disp_commit->wait_for_finish;
+	struct msm_sync_pt_data *sync_pt_data = &mfd->mdp_sync_pt_data;
+	struct msm_fb_backup_type *fb_backup;
 	int ret = 0;
 
 	if (!mfd || (!mfd->op_enable))
@@ -2726,13 +2788,14 @@ static int mdss_fb_pan_display_ex(struct fb_info *info,
 	if (var->yoffset > (info->var.yres_virtual - info->var.yres))
 		return -EINVAL;
 
-	ret = mdss_fb_pan_idle(mfd);
+	/* wait for a free slot in the commit queue */
+	ret = __mdss_fb_wait_for_commits(mfd, mfd->commit_depth - 1);
 	if (ret) {
 		pr_err("Shutdown pending. Aborting operation\n");
 		return ret;
 	}
 
-	mutex_lock(&mfd->mdp_sync_pt_data.sync_mutex);
+	mutex_lock(&sync_pt_data->sync_mutex);
 	if (info->fix.xpanstep)
 		info->var.xoffset =
 		(var->xoffset / info->fix.xpanstep) * info->fix.xpanstep;
@@ -2741,14 +2804,27 @@ static int mdss_fb_pan_display_ex(struct fb_info *info,
 		info->var.yoffset =
 		(var->yoffset / info->fix.ypanstep) * info->fix.ypanstep;
 
-	mfd->msm_fb_backup.info = *info;
-	mfd->msm_fb_backup.disp_commit = *disp_commit;
+	fb_backup = &mfd->msm_fb_backup[atomic_read(&mfd->commits_queued) %
+					mfd->commit_depth];
+	fb_backup->info = *info;
+	fb_backup->disp_commit = *disp_commit;
 
-	atomic_inc(&mfd->mdp_sync_pt_data.commit_cnt);
+	/* the acquire fences set up by buf sync belong to this commit */
+	fb_backup->acq_fen_cnt = 0;
+	if (!sync_pt_data->async_wait_fences) {
+		fb_backup->acq_fen_cnt = sync_pt_data->acq_fen_cnt;
+		memcpy(fb_backup->acq_fen, sync_pt_data->acq_fen,
+			sync_pt_data->acq_fen_cnt * sizeof(struct sync_fence *));
+		sync_pt_data->acq_fen_cnt = 0;
+	}
+
+	atomic_inc(&sync_pt_data->commit_cnt);
 	atomic_inc(&mfd->commits_pending);
 	atomic_inc(&mfd->kickoff_pending);
-	wake_up_all(&mfd->commit_wait_q);
-	mutex_unlock(&mfd->mdp_sync_pt_data.sync_mutex);
+	smp_wmb();
+	atomic_inc(&mfd->commits_queued);
+	wake_up_all(&mfd->fence_wait_q);
+	mutex_unlock(&sync_pt_data->sync_mutex);
 	if (wait_for_finish)
 		mdss_fb_pan_idle(mfd);
 	return ret;
@@ -2834,18 +2910,17 @@ static void mdss_panelinfo_to_fb_var(struct mdss_panel_info *pinfo,
 /**
  * __mdss_fb_perform_commit() - process a frame to display
  * @mfd:	Framebuffer data structure for display
+ * @fb_backup:	Queued commit, its acquire fences have already signaled
  *
  * Processes all layers and buffers programmed and ensures all pending release
  * fences are signaled once the buffer is transfered to display.
  */
-static int __mdss_fb_perform_commit(struct msm_fb_data_type *mfd)
+static int __mdss_fb_perform_commit(struct msm_fb_data_type *mfd,
+	struct msm_fb_backup_type *fb_backup)
 {
 	struct msm_sync_pt_data *sync_pt_data = &mfd->mdp_sync_pt_data;
-	struct msm_fb_backup_type *fb_backup = &mfd->msm_fb_backup;
 	int ret = -ENOSYS;
 
-	if (!sync_pt_data->async_wait_fences)
-		mdss_fb_wait_for_fence(sync_pt_data);
 	sync_pt_data->flushed = false;
 
 	if (fb_backup->disp_commit.flags & MDP_DISPLAY_COMMIT_OVERLAY) {
@@ -2865,6 +2940,15 @@ static int __mdss_fb_perform_commit(struct msm_fb_data_type *mfd)
 	if (!ret)
 		mdss_fb_update_backlight(mfd);
 
+	if (!ret && !mfd->index) {
+		static bool first_frame_logged;
+
+		if (!first_frame_logged) {
+			boot_stats_marker("first frame on fb0");
+			first_frame_logged = true;
+		}
+	}
+
 	if (IS_ERR_VALUE(ret) || !sync_pt_data->flushed) {
 		mdss_fb_release_kickoff(mfd);
 		mdss_fb_signal_timeline(sync_pt_data);
@@ -2891,13 +2975,17 @@ static int __mdss_fb_display_thread(void *data)
 
 	while (1) {
 		wait_event(mfd->commit_wait_q,
-				(atomic_read(&mfd->commits_pending) ||
+				((atomic_read(&mfd->commits_fenced) !=
+				  mfd->commit_head) ||
 				 kthread_should_stop()));
 
 		if (kthread_should_stop())
 			break;
 
-		ret = __mdss_fb_perform_commit(mfd);
+		smp_rmb();
+		ret = __mdss_fb_perform_commit(mfd, &mfd->msm_fb_backup[
+				mfd->commit_head % mfd->commit_depth]);
+		mfd->commit_head++;
 		atomic_dec(&mfd->commits_pending);
 		wake_up_all(&mfd->idle_wait_q);
 	}
@@ -2909,6 +2997,51 @@ static int __mdss_fb_display_thread(void *data)
 	return ret;
 }
 
+/*
+ * Waits for the acquire fences of queued commits in order and hands them to
+ * the display thread, so that the wait for the buffers of the next frame
+ * overlaps with the kickoff of the current one.
+ */
+static int __mdss_fb_fence_thread(void *data)
+{
+	struct msm_fb_data_type *mfd = data;
+	struct msm_fb_backup_type *fb_backup;
+	struct sched_param param;
+	u32 fenced;
+	int ret;
+
+	/* same priority as the display thread it feeds */
+	param.sched_priority = 16;
+	ret = sched_setscheduler(current, SCHED_FIFO, &param);
+	if (ret)
+		pr_warn("set priority failed for fb%d fence thread\n",
+				mfd->index);
+
+	while (1) {
+		wait_event(mfd->fence_wait_q,
+				((atomic_read(&mfd->commits_queued) !=
+				  atomic_read(&mfd->commits_fenced)) ||
+				 kthread_should_stop()));
+
+		if (kthread_should_stop())
+			break;
+
+		smp_rmb();
+		fenced = atomic_read(&mfd->commits_fenced);
+		fb_backup = &mfd->msm_fb_backup[fenced % mfd->commit_depth];
+		if (fb_backup->acq_fen_cnt)
+			__mdss_fb_wait_for_fence_sub(&mfd->mdp_sync_pt_data,
+				fb_backup->acq_fen, fb_backup->acq_fen_cnt);
+		fb_backup->acq_fen_cnt = 0;
+
+		smp_wmb();
+		atomic_inc(&mfd->commits_fenced);
+		wake_up_all(&mfd->commit_wait_q);
+	}
+
+	return 0;
+}
+
 static int mdss_fb_check_var(struct fb_var_screeninfo *var,
 			     struct fb_info *info)
 {
@@ -3242,6 +3375,7 @@ static int mdss_fb_handle_buf_sync_ioctl(struct msm_sync_pt_data *sync_pt_data,
 	struct sync_fence *fence, *rel_fence, *retire_fence;
 	int rel_fen_fd;
 	int retire_fen_fd;
+	unsigned long flags;
 	int val;
 
 	if ((buf_sync->acq_fen_fd_cnt > MDP_MAX_FENCE_FD) ||
@@ -3277,8 +3411,10 @@ static int mdss_fb_handle_buf_sync_ioctl(struct msm_sync_pt_data *sync_pt_data,
 	if (ret)
 		goto buf_sync_err_1;
 
+	spin_lock_irqsave(&sync_pt_data->timeline_lock, flags);
 	val = sync_pt_data->timeline_value + sync_pt_data->threshold +
 			atomic_read(&sync_pt_data->commit_cnt);
+	spin_unlock_irqrestore(&sync_pt_data->timeline_lock, flags);
 
 	/* Set release fence */
 	rel_fence = mdss_fb_sync_get_fence(sync_pt_data->timeline,
@@ -3390,6 +3526,14 @@ static int __ioctl_wait_idle(struct msm_fb_data_type *mfd, u32 cmd)
 		(cmd == MSMFB_BUFFER_SYNC) ||
 		(cmd == MSMFB_OVERLAY_SET))) {
 		ret = mdss_fb_wait_for_kickoff(mfd);
+	} else if ((mfd->commit_depth > 1) &&
+		((cmd == MSMFB_BUFFER_SYNC) ||
+		(cmd == MSMFB_DISPLAY_COMMIT))) {
+		/*
+		 * The fences of a buf sync are tied to the commit that
+		 * follows it, and a commit only waits for a free slot.
+		 */
+		ret = 0;
 	} else if ((cmd != MSMFB_VSYNC_CTRL) &&
 		(cmd != MSMFB_OVERLAY_VSYNC_CTRL) &&
 		(cmd != MSMFB_ASYNC_BLIT) &&
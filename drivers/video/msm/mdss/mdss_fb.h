@@ -38,6 +38,8 @@
  * are already quite long and proceed without any further waits. */
 #define WAIT_DISP_OP_TIMEOUT (WAIT_FENCE_FIRST_TIMEOUT + \
 		WAIT_FENCE_FINAL_TIMEOUT + 1)
+/* Commits that may be queued to the display thread at once */
+#define MDSS_FB_COMMIT_DEPTH 2
 
 #ifndef MAX
 #define  MAX(x, y) (((x) > (y)) ? (x) : (y))
@@ -140,6 +142,8 @@ struct msm_sync_pt_data {
 	bool async_wait_fences;
 
 	struct mutex sync_mutex;
+	/* timeline_value and commit_cnt, taken from irq context */
+	spinlock_t timeline_lock;
 	struct notifier_block notifier;
 
 	struct sync_fence *(*get_retire_fence)
@@ -200,6 +204,8 @@ struct mdss_fb_proc_info {
 struct msm_fb_backup_type {
 	struct fb_info info;
 	struct mdp_display_commit disp_commit;
+	u32 acq_fen_cnt;
+	struct sync_fence *acq_fen[MDP_MAX_FENCE_FD];
 };
 
 struct msm_fb_data_type {
@@ -263,7 +269,14 @@ struct msm_fb_data_type {
 
 	/* for non-blocking */
 	struct task_struct *disp_thread;
+	struct task_struct *fence_thread;
 	atomic_t commits_pending;
+	/* commit queue, see __mdss_fb_fence_thread() */
+	u32 commit_depth;
+	u32 commit_head;
+	atomic_t commits_queued;
+	atomic_t commits_fenced;
+	wait_queue_head_t fence_wait_q;
 	atomic_t kickoff_pending;
 	wait_queue_head_t commit_wait_q;
 	wait_queue_head_t idle_wait_q;
@@ -275,7 +288,7 @@ struct msm_fb_data_type {
 	wait_queue_head_t ioctl_q;
 	atomic_t ioctl_ref_cnt;
 
-	struct msm_fb_backup_type msm_fb_backup;
+	struct msm_fb_backup_type msm_fb_backup[MDSS_FB_COMMIT_DEPTH];
 	struct completion power_set_comp;
 	u32 is_power_setting;
 
@@ -410,6 +410,13 @@ int mdss_bus_scale_set_quota(int client, u64 ab_quota, u64 ib_quota)
 
 	mutex_lock(&bus_bw_lock);
 
+	/* nothing to send to the bus driver if this client's vote is unchanged */
+	if (mdss_res->ab[client] == ab_quota &&
+	    mdss_res->ib[client] == ib_quota) {
+		mutex_unlock(&bus_bw_lock);
+		return 0;
+	}
+
 	mdss_res->ab[client] = ab_quota;
 	mdss_res->ib[client] = ib_quota;
 	trace_mdp_perf_update_bus(client, ab_quota, ib_quota);
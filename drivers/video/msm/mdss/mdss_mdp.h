@@ -184,6 +184,55 @@ struct mdss_mdp_perf_params {
 	DECLARE_BITMAP(bw_vote_mode, MDSS_MDP_BW_MODE_MAX);
 };
 
+/*
+ * Everything the ctl perf calculation depends on. Two configurations with
+ * the same key need the same bandwidth and clock, so the result of the
+ * last calculation can be reused while the key stays the same.
+ */
+struct mdss_mdp_perf_pipe_key {
+	u32 num;
+	u32 mixer_num;
+	u32 format;
+	u32 flags;
+	u32 smp_bytes;
+	struct mdss_rect src;
+	struct mdss_rect dst;
+	u8 vert_deci;
+	bool bwc_mode;
+	bool src_split_req;
+};
+
+struct mdss_mdp_perf_mixer_key {
+	u32 type;
+	u32 width;
+	u32 height;
+	struct mdss_rect roi;
+	bool rotator_mode;
+	int pipe_cnt;
+	struct mdss_mdp_perf_pipe_key pipe[MAX_PIPES_PER_LM];
+};
+
+struct mdss_mdp_perf_key {
+	struct mdss_mdp_perf_mixer_key mixer[2];
+	u32 fps;
+	u32 v_total;
+	u32 max_fps;
+	u32 max_v_total;
+	u32 h_total;
+	u32 xres;
+	u32 pclk_rate;
+	u32 vbp_fac;
+	u32 v_back_porch;
+	u32 transfer_time_us;
+	bool fbc_en;
+	struct mdss_fudge_factor clk_factor;
+	struct mdss_fudge_factor ib_factor;
+	struct mdss_fudge_factor ib_factor_overlap;
+	struct mdss_fudge_factor ib_factor_cmd;
+	u32 disable_prefill;
+	bool traffic_shaper_en;
+};
+
 struct mdss_mdp_ctl {
 	u32 num;
 	char __iomem *base;
@@ -217,6 +266,9 @@ struct mdss_mdp_ctl {
 	struct mdss_mdp_perf_params new_perf;
 	u32 perf_transaction_status;
 	bool perf_release_ctl_bw;
+	struct mdss_mdp_perf_key perf_key;
+	struct mdss_mdp_perf_params perf_cached;
+	bool perf_cache_valid;
 
 	bool traffic_shaper_enabled;
 	u32  traffic_shaper_mdp_clk;
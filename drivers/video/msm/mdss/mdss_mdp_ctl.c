@@ -1110,6 +1110,100 @@ int mdss_mdp_perf_bw_check_pipe(struct mdss_mdp_perf_params *perf,
 	return 0;
 }
 
+static void mdss_mdp_perf_mixer_key(struct mdss_mdp_mixer *mixer,
+		struct mdss_mdp_pipe **plist, int cnt,
+		struct mdss_mdp_perf_mixer_key *mkey)
+{
+	int i;
+
+	if (!mixer)
+		return;
+
+	mkey->type = mixer->type;
+	mkey->width = mixer->width;
+	mkey->height = mixer->height;
+	mkey->roi = mixer->roi;
+	mkey->rotator_mode = mixer->rotator_mode;
+	mkey->pipe_cnt = cnt;
+
+	for (i = 0; i < cnt; i++) {
+		struct mdss_mdp_pipe *pipe = plist[i];
+		struct mdss_mdp_perf_pipe_key *pkey = &mkey->pipe[i];
+
+		pkey->num = pipe->num;
+		pkey->mixer_num = pipe->mixer_left ? pipe->mixer_left->num : 0;
+		pkey->format = pipe->src_fmt ? pipe->src_fmt->format : 0;
+		pkey->flags = pipe->flags;
+		pkey->smp_bytes = mdss_mdp_smp_get_size(pipe, MAX_PLANES);
+		pkey->src = pipe->src;
+		pkey->dst = pipe->dst;
+		pkey->vert_deci = pipe->vert_deci;
+		pkey->bwc_mode = pipe->bwc_mode;
+		pkey->src_split_req = pipe->src_split_req;
+	}
+}
+
+/*
+ * Scratch key for mdss_mdp_perf_calc_ctl(), too big for the stack. Only
+ * used with mdss_mdp_ctl_lock held.
+ */
+static struct mdss_mdp_perf_key perf_key_new;
+
+/**
+ * mdss_mdp_perf_key_update() - build the perf key of the staged config
+ * @ctl: ctl whose configuration is being committed
+ * @left_plist/@right_plist: pipes staged on the left and right mixers
+ *
+ * Returns true if the key differs from the one of the cached perf
+ * numbers, in which case the cached key is replaced by the new one.
+ */
+static bool mdss_mdp_perf_key_update(struct mdss_mdp_ctl *ctl,
+		struct mdss_mdp_pipe **left_plist, int left_cnt,
+		struct mdss_mdp_pipe **right_plist, int right_cnt)
+{
+	struct mdss_mdp_perf_key *key = &perf_key_new;
+	struct mdss_data_type *mdata = ctl->mdata;
+
+	memset(key, 0, sizeof(*key));
+
+	mdss_mdp_perf_mixer_key(ctl->mixer_left, left_plist, left_cnt,
+			&key->mixer[0]);
+	mdss_mdp_perf_mixer_key(ctl->mixer_right, right_plist, right_cnt,
+			&key->mixer[1]);
+
+	if (ctl->panel_data) {
+		struct mdss_panel_info *pinfo = &ctl->panel_data->panel_info;
+
+		key->fps = mdss_panel_get_framerate(pinfo);
+		key->v_total = mdss_panel_get_vtotal(pinfo);
+		key->max_fps = pinfo->panel_max_fps;
+		key->max_v_total = pinfo->panel_max_vtotal;
+		key->h_total = mdss_panel_get_htotal(pinfo, false);
+		key->xres = get_panel_xres(pinfo);
+		key->v_back_porch = pinfo->lcdc.v_back_porch;
+		key->transfer_time_us = pinfo->mdp_transfer_time_us;
+		key->fbc_en = pinfo->fbc.enabled;
+		if (ctl->intf_type)
+			key->pclk_rate = mdss_mdp_get_pclk_rate(ctl);
+	}
+
+	if (ctl->intf_type != MDSS_MDP_NO_INTF)
+		key->vbp_fac = mdss_mdp_get_vbp_factor_max(ctl);
+
+	key->clk_factor = mdata->clk_factor;
+	key->ib_factor = mdata->ib_factor;
+	key->ib_factor_overlap = mdata->ib_factor_overlap;
+	key->ib_factor_cmd = mdata->ib_factor_cmd;
+	key->disable_prefill = mdata->disable_prefill;
+	key->traffic_shaper_en = mdata->traffic_shaper_en;
+
+	if (ctl->perf_cache_valid && !memcmp(key, &ctl->perf_key, sizeof(*key)))
+		return false;
+
+	memcpy(&ctl->perf_key, key, sizeof(*key));
+	return true;
+}
+
 static void mdss_mdp_perf_calc_ctl(struct mdss_mdp_ctl *ctl,
 		struct mdss_mdp_perf_params *perf)
 {
@@ -1131,6 +1225,17 @@ static void mdss_mdp_perf_calc_ctl(struct mdss_mdp_ctl *ctl,
 		}
 	}
 
+	/*
+	 * Steady state commits (e.g. video playback) keep restaging the same
+	 * layers, reuse the previous numbers rather than redoing the math.
+	 */
+	if (!mdss_mdp_perf_key_update(ctl, left_plist, left_cnt,
+			right_plist, right_cnt)) {
+		*perf = ctl->perf_cached;
+		pr_debug("ctl=%d perf config unchanged\n", ctl->num);
+		return;
+	}
+
 	__mdss_mdp_perf_calc_ctl_helper(ctl, perf,
 		left_plist, left_cnt, right_plist, right_cnt, 0);
 
@@ -1147,6 +1252,9 @@ static void mdss_mdp_perf_calc_ctl(struct mdss_mdp_ctl *ctl,
 	pr_debug("ctl=%d clk_rate=%u\n", ctl->num, perf->mdp_clk_rate);
 	pr_debug("bw_overlap=%llu bw_prefill=%llu prefill_bytes=%d\n",
 		 perf->bw_overlap, perf->bw_prefill, perf->prefill_bytes);
+
+	ctl->perf_cached = *perf;
+	ctl->perf_cache_valid = true;
 }
 
 static void set_status(u32 *value, bool status, u32 bit_num)
@@ -1526,6 +1634,7 @@ static void mdss_mdp_ctl_perf_update(struct mdss_mdp_ctl *ctl,
 	} else {
 		memset(old, 0, sizeof(*old));
 		memset(new, 0, sizeof(*new));
+		ctl->perf_cache_valid = false;
 		update_bus = 1;
 		update_clk = 1;
 	}
@@ -349,6 +349,7 @@ static struct msm_sync_pt_data *mdss_mdp_rotator_sync_pt_create(
 	INIT_WORK(&rot->commit_work,
 				mdss_mdp_rotator_commit_wq_handler);
 	mutex_init(&sync_pt_data->sync_mutex);
+	spin_lock_init(&sync_pt_data->timeline_lock);
 	return sync_pt_data;
 }
 
@@ -37,17 +37,6 @@
 #include <asm/unaligned.h>
 #include "ecryptfs_kernel.h"
 
-static int
-ecryptfs_decrypt_page_offset(struct ecryptfs_crypt_stat *crypt_stat,
-			     struct page *dst_page, int dst_offset,
-			     struct page *src_page, int src_offset, int size,
-			     unsigned char *iv);
-static int
-ecryptfs_encrypt_page_offset(struct ecryptfs_crypt_stat *crypt_stat,
-			     struct page *dst_page, int dst_offset,
-			     struct page *src_page, int src_offset, int size,
-			     unsigned char *iv);
-
 /**
  * ecryptfs_to_hex
  * @dst: Buffer to take hex character representation of contents of
@@ -319,39 +308,55 @@ int virt_to_scatterlist(const void *addr, int size, struct scatterlist *sg,
 	return i;
 }
 
-struct extent_crypt_result {
+#define DECRYPT		0
+#define ENCRYPT		1
+
+/*
+ * Extent crypto requests submitted together, so an asynchronous cipher
+ * (e.g. a crypto engine) can work on all of them while we wait once
+ * for the whole batch instead of once per extent.
+ */
+struct extent_crypt_batch {
+	atomic_t pending;
 	struct completion completion;
 	int rc;
 };
 
+struct extent_crypt_req {
+	struct ablkcipher_request *req;
+	struct scatterlist src_sg;
+	struct scatterlist dst_sg;
+	char iv[ECRYPTFS_MAX_IV_BYTES];
+};
+
+static void extent_crypt_batch_put(struct extent_crypt_batch *batch, int rc)
+{
+	if (rc)
+		batch->rc = rc;
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->completion);
+}
+
 static void extent_crypt_complete(struct crypto_async_request *req, int rc)
 {
-	struct extent_crypt_result *ecr = req->data;
+	struct extent_crypt_batch *batch = req->data;
 
 	if (rc == -EINPROGRESS)
 		return;
 
-	ecr->rc = rc;
-	complete(&ecr->completion);
+	extent_crypt_batch_put(batch, rc);
 }
 
 /**
- * encrypt_scatterlist
- * @crypt_stat: Pointer to the crypt_stat struct to initialize.
- * @dest_sg: Destination of encrypted data
- * @src_sg: Data to be encrypted
- * @size: Length of data to be encrypted
- * @iv: iv to use during encryption
+ * ecryptfs_set_tfm_key
+ * @crypt_stat: Cryptographic context
+ *
+ * Set the file key on the cipher the first time the file is crypted.
  *
- * Returns the number of bytes encrypted; negative value on error
+ * Returns zero on success; non-zero on error
  */
-static int encrypt_scatterlist(struct ecryptfs_crypt_stat *crypt_stat,
-			       struct scatterlist *dest_sg,
-			       struct scatterlist *src_sg, int size,
-			       unsigned char *iv)
+static int ecryptfs_set_tfm_key(struct ecryptfs_crypt_stat *crypt_stat)
 {
-	struct ablkcipher_request *req = NULL;
-	struct extent_crypt_result ecr;
 	int rc = 0;
 
 	BUG_ON(!crypt_stat || !crypt_stat->tfm
@@ -363,20 +368,7 @@ static int encrypt_scatterlist(struct ecryptfs_crypt_stat *crypt_stat,
 				  crypt_stat->key_size);
 	}
 
-	init_completion(&ecr.completion);
-
 	mutex_lock(&crypt_stat->cs_tfm_mutex);
-	req = ablkcipher_request_alloc(crypt_stat->tfm, GFP_NOFS);
-	if (!req) {
-		mutex_unlock(&crypt_stat->cs_tfm_mutex);
-		rc = -ENOMEM;
-		goto out;
-	}
-
-	ablkcipher_request_set_callback(req,
-			CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
-			extent_crypt_complete, &ecr);
-	/* Consider doing this once, when the file is opened */
 	if (!(crypt_stat->flags & ECRYPTFS_KEY_SET)) {
 		rc = crypto_ablkcipher_setkey(crypt_stat->tfm, crypt_stat->key,
 					      crypt_stat->key_size);
@@ -384,25 +376,119 @@ static int encrypt_scatterlist(struct ecryptfs_crypt_stat *crypt_stat,
 			ecryptfs_printk(KERN_ERR,
 					"Error setting key; rc = [%d]\n",
 					rc);
-			mutex_unlock(&crypt_stat->cs_tfm_mutex);
 			rc = -EINVAL;
 			goto out;
 		}
 		crypt_stat->flags |= ECRYPTFS_KEY_SET;
 	}
+out:
 	mutex_unlock(&crypt_stat->cs_tfm_mutex);
-	ecryptfs_printk(KERN_DEBUG, "Encrypting [%d] bytes.\n", size);
-	ablkcipher_request_set_crypt(req, src_sg, dest_sg, size, iv);
-	rc = crypto_ablkcipher_encrypt(req);
-	if (rc == -EINPROGRESS || rc == -EBUSY) {
-		struct extent_crypt_result *ecr = req->base.data;
+	return rc;
+}
 
-		wait_for_completion(&ecr->completion);
-		rc = ecr->rc;
-		INIT_COMPLETION(ecr->completion);
+/**
+ * crypt_pages
+ * @crypt_stat: Cryptographic context
+ * @pages: Plaintext pages of the eCryptfs inode
+ * @enc_pages: Pages holding the ciphertext of @pages
+ * @nr_pages: Number of pages in @pages and @enc_pages
+ * @op: ENCRYPT @pages into @enc_pages, or DECRYPT @enc_pages into @pages
+ *
+ * Submit one request per extent of all the pages, then wait for all of
+ * them to complete.  Extent n of a page is crypted from and to offset
+ * n * extent_size of both pages.
+ *
+ * Returns zero on success; negative on error
+ */
+static int crypt_pages(struct ecryptfs_crypt_stat *crypt_stat,
+		       struct page **pages, struct page **enc_pages,
+		       int nr_pages, int op)
+{
+	unsigned long extents_per_page = PAGE_CACHE_SIZE
+					 / crypt_stat->extent_size;
+	int nr_extents = nr_pages * extents_per_page;
+	struct extent_crypt_batch batch;
+	struct extent_crypt_req *ereqs;
+	int i, rc;
+
+	rc = ecryptfs_set_tfm_key(crypt_stat);
+	if (rc)
+		return rc;
+
+	ereqs = kcalloc(nr_extents, sizeof(*ereqs), GFP_NOFS);
+	if (!ereqs)
+		return -ENOMEM;
+
+	init_completion(&batch.completion);
+	atomic_set(&batch.pending, 1);
+	batch.rc = 0;
+
+	for (i = 0; i < nr_extents; i++) {
+		struct extent_crypt_req *ereq = &ereqs[i];
+		struct page *page = pages[i / extents_per_page];
+		struct page *enc_page = enc_pages[i / extents_per_page];
+		unsigned long extent_offset = i % extents_per_page;
+		loff_t extent_num = ((loff_t)page->index) * extents_per_page
+				    + extent_offset;
+		int offset = extent_offset * crypt_stat->extent_size;
+
+		rc = ecryptfs_derive_iv(ereq->iv, crypt_stat, extent_num);
+		if (rc) {
+			ecryptfs_printk(KERN_ERR, "Error attempting to derive "
+				"IV for extent [0x%.16llx]; rc = [%d]\n",
+				(unsigned long long)extent_num, rc);
+			break;
+		}
+
+		ereq->req = ablkcipher_request_alloc(crypt_stat->tfm,
+						     GFP_NOFS);
+		if (!ereq->req) {
+			rc = -ENOMEM;
+			break;
+		}
+		ablkcipher_request_set_callback(ereq->req,
+			CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+			extent_crypt_complete, &batch);
+
+		sg_init_table(&ereq->src_sg, 1);
+		sg_init_table(&ereq->dst_sg, 1);
+		if (op == ENCRYPT) {
+			sg_set_page(&ereq->src_sg, page,
+				    crypt_stat->extent_size, offset);
+			sg_set_page(&ereq->dst_sg, enc_page,
+				    crypt_stat->extent_size, offset);
+		} else {
+			sg_set_page(&ereq->src_sg, enc_page,
+				    crypt_stat->extent_size, offset);
+			sg_set_page(&ereq->dst_sg, page,
+				    crypt_stat->extent_size, offset);
+		}
+		ablkcipher_request_set_crypt(ereq->req, &ereq->src_sg,
+					     &ereq->dst_sg,
+					     crypt_stat->extent_size,
+					     ereq->iv);
+
+		atomic_inc(&batch.pending);
+		rc = (op == ENCRYPT) ? crypto_ablkcipher_encrypt(ereq->req) :
+				       crypto_ablkcipher_decrypt(ereq->req);
+		if (rc == -EINPROGRESS || rc == -EBUSY) {
+			/* completed from extent_crypt_complete() */
+			rc = 0;
+			continue;
+		}
+		extent_crypt_batch_put(&batch, rc);
+		if (rc)
+			break;
 	}
-out:
-	ablkcipher_request_free(req);
+
+	/* Drop the submission reference, then wait for in-flight extents */
+	extent_crypt_batch_put(&batch, rc);
+	wait_for_completion(&batch.completion);
+	rc = batch.rc;
+
+	for (i = 0; i < nr_extents; i++)
+		ablkcipher_request_free(ereqs[i].req);
+	kfree(ereqs);
 	return rc;
 }
 
@@ -419,109 +505,99 @@ static void ecryptfs_lower_offset_for_extent(loff_t *offset, loff_t extent_num,
 }
 
 /**
- * ecryptfs_encrypt_extent
- * @enc_extent_page: Allocated page into which to encrypt the data in
- *                   @page
- * @crypt_stat: crypt_stat containing cryptographic context for the
- *              encryption operation
- * @page: Page containing plaintext data extent to encrypt
- * @extent_offset: Page extent offset for use in generating IV
- *
- * Encrypts one extent of data.
+ * ecryptfs_lower_offset_for_page
  *
- * Return zero on success; non-zero otherwise
+ * Convert an eCryptfs page index into the lower byte offset of its
+ * first extent.  The extents of a page are contiguous in the lower file.
  */
-static int ecryptfs_encrypt_extent(struct page *enc_extent_page,
-				   struct ecryptfs_crypt_stat *crypt_stat,
-				   struct page *page,
-				   unsigned long extent_offset)
+static loff_t ecryptfs_lower_offset_for_page(struct page *page,
+				struct ecryptfs_crypt_stat *crypt_stat)
 {
-	loff_t extent_base;
-	char extent_iv[ECRYPTFS_MAX_IV_BYTES];
-	int rc;
+	loff_t offset;
 
-	extent_base = (((loff_t)page->index)
-		       * (PAGE_CACHE_SIZE / crypt_stat->extent_size));
-	rc = ecryptfs_derive_iv(extent_iv, crypt_stat,
-				(extent_base + extent_offset));
-	if (rc) {
-		ecryptfs_printk(KERN_ERR, "Error attempting to derive IV for "
-			"extent [0x%.16llx]; rc = [%d]\n",
-			(unsigned long long)(extent_base + extent_offset), rc);
-		goto out;
-	}
-	rc = ecryptfs_encrypt_page_offset(crypt_stat, enc_extent_page, 0,
-					  page, (extent_offset
-						 * crypt_stat->extent_size),
-					  crypt_stat->extent_size, extent_iv);
-	if (rc < 0) {
-		printk(KERN_ERR "%s: Error attempting to encrypt page with "
-		       "page->index = [%ld], extent_offset = [%ld]; "
-		       "rc = [%d]\n", __func__, page->index, extent_offset,
-		       rc);
-		goto out;
-	}
-	rc = 0;
-out:
-	return rc;
+	ecryptfs_lower_offset_for_extent(&offset,
+		((loff_t)page->index) * (PAGE_CACHE_SIZE
+					 / crypt_stat->extent_size),
+		crypt_stat);
+	return offset;
+}
+
+static void ecryptfs_free_enc_pages(struct page **enc_pages, int nr_pages)
+{
+	int i;
+
+	for (i = 0; i < nr_pages; i++)
+		if (enc_pages[i])
+			__free_page(enc_pages[i]);
+	kfree(enc_pages);
+}
+
+static struct page **ecryptfs_alloc_enc_pages(int nr_pages)
+{
+	struct page **enc_pages;
+	int i;
+
+	enc_pages = kcalloc(nr_pages, sizeof(*enc_pages), GFP_NOFS);
+	if (!enc_pages)
+		goto err;
+	for (i = 0; i < nr_pages; i++) {
+		enc_pages[i] = alloc_page(GFP_USER);
+		if (!enc_pages[i])
+			goto err;
+	}
+	return enc_pages;
+err:
+	ecryptfs_printk(KERN_ERR, "Error allocating memory for "
+			"encrypted extent\n");
+	if (enc_pages)
+		ecryptfs_free_enc_pages(enc_pages, nr_pages);
+	return NULL;
 }
 
 /**
- * ecryptfs_encrypt_page
- * @page: Page mapped from the eCryptfs inode for the file; contains
- *        decrypted content that needs to be encrypted (to a temporary
- *        page; not in place) and written out to the lower file
+ * ecryptfs_encrypt_pages
+ * @pages: Pages mapped from the same eCryptfs inode; contain decrypted
+ *         content that needs to be encrypted (to temporary pages; not
+ *         in place) and written out to the lower file
+ * @nr_pages: Number of pages in @pages
  *
- * Encrypt an eCryptfs page. This is done on a per-extent basis. Note
- * that eCryptfs pages may straddle the lower pages -- for instance,
- * if the file was created on a machine with an 8K page size
- * (resulting in an 8K header), and then the file is copied onto a
- * host with a 32K page size, then when reading page 0 of the eCryptfs
- * file, 24K of page 0 of the lower file will be read and decrypted,
- * and then 8K of page 1 of the lower file will be read and decrypted.
+ * Encrypt eCryptfs pages.  All the extents of all the pages are handed
+ * to the cipher before waiting for any of them, so an asynchronous
+ * cipher gets the whole batch to work on.  The encrypted pages are then
+ * written out to the lower file.
  *
  * Returns zero on success; negative on error
  */
-int ecryptfs_encrypt_page(struct page *page)
+int ecryptfs_encrypt_pages(struct page **pages, int nr_pages)
 {
 	struct inode *ecryptfs_inode;
 	struct ecryptfs_crypt_stat *crypt_stat;
-	char *enc_extent_virt;
-	struct page *enc_extent_page = NULL;
-	loff_t extent_offset;
-	int rc = 0;
+	struct page **enc_pages;
+	int i, rc;
 
-	ecryptfs_inode = page->mapping->host;
+	ecryptfs_inode = pages[0]->mapping->host;
 	crypt_stat =
 		&(ecryptfs_inode_to_private(ecryptfs_inode)->crypt_stat);
 	BUG_ON(!(crypt_stat->flags & ECRYPTFS_ENCRYPTED));
-	enc_extent_page = alloc_page(GFP_USER);
-	if (!enc_extent_page) {
-		rc = -ENOMEM;
-		ecryptfs_printk(KERN_ERR, "Error allocating memory for "
-				"encrypted extent\n");
+	enc_pages = ecryptfs_alloc_enc_pages(nr_pages);
+	if (!enc_pages)
+		return -ENOMEM;
+
+	rc = crypt_pages(crypt_stat, pages, enc_pages, nr_pages, ENCRYPT);
+	if (rc) {
+		printk(KERN_ERR "%s: Error encrypting pages starting at "
+		       "page->index = [%ld]; rc = [%d]\n", __func__,
+		       pages[0]->index, rc);
 		goto out;
 	}
-	enc_extent_virt = kmap(enc_extent_page);
-	for (extent_offset = 0;
-	     extent_offset < (PAGE_CACHE_SIZE / crypt_stat->extent_size);
-	     extent_offset++) {
-		loff_t offset;
 
-		rc = ecryptfs_encrypt_extent(enc_extent_page, crypt_stat, page,
-					     extent_offset);
-		if (rc) {
-			printk(KERN_ERR "%s: Error encrypting extent; "
-			       "rc = [%d]\n", __func__, rc);
-			goto out;
-		}
-		ecryptfs_lower_offset_for_extent(
-			&offset, ((((loff_t)page->index)
-				   * (PAGE_CACHE_SIZE
-				      / crypt_stat->extent_size))
-				  + extent_offset), crypt_stat);
-		rc = ecryptfs_write_lower(ecryptfs_inode, enc_extent_virt,
-					  offset, crypt_stat->extent_size);
+	for (i = 0; i < nr_pages; i++) {
+		char *enc_virt = kmap(enc_pages[i]);
+
+		rc = ecryptfs_write_lower(ecryptfs_inode, enc_virt,
+			ecryptfs_lower_offset_for_page(pages[i], crypt_stat),
+			PAGE_CACHE_SIZE);
+		kunmap(enc_pages[i]);
 		if (rc < 0) {
 			ecryptfs_printk(KERN_ERR, "Error attempting "
 					"to write lower page; rc = [%d]"
@@ -531,56 +607,17 @@ int ecryptfs_encrypt_page(struct page *page)
 	}
 	rc = 0;
 out:
-	if (enc_extent_page) {
-		kunmap(enc_extent_page);
-		__free_page(enc_extent_page);
-	}
-	return rc;
-}
-
-static int ecryptfs_decrypt_extent(struct page *page,
-				   struct ecryptfs_crypt_stat *crypt_stat,
-				   struct page *enc_extent_page,
-				   unsigned long extent_offset)
-{
-	loff_t extent_base;
-	char extent_iv[ECRYPTFS_MAX_IV_BYTES];
-	int rc;
-
-	extent_base = (((loff_t)page->index)
-		       * (PAGE_CACHE_SIZE / crypt_stat->extent_size));
-	rc = ecryptfs_derive_iv(extent_iv, crypt_stat,
-				(extent_base + extent_offset));
-	if (rc) {
-		ecryptfs_printk(KERN_ERR, "Error attempting to derive IV for "
-			"extent [0x%.16llx]; rc = [%d]\n",
-			(unsigned long long)(extent_base + extent_offset), rc);
-		goto out;
-	}
-	rc = ecryptfs_decrypt_page_offset(crypt_stat, page,
-					  (extent_offset
-					   * crypt_stat->extent_size),
-					  enc_extent_page, 0,
-					  crypt_stat->extent_size, extent_iv);
-	if (rc < 0) {
-		printk(KERN_ERR "%s: Error attempting to decrypt to page with "
-		       "page->index = [%ld], extent_offset = [%ld]; "
-		       "rc = [%d]\n", __func__, page->index, extent_offset,
-		       rc);
-		goto out;
-	}
-	rc = 0;
-out:
+	ecryptfs_free_enc_pages(enc_pages, nr_pages);
 	return rc;
 }
 
 /**
- * ecryptfs_decrypt_page
- * @page: Page mapped from the eCryptfs inode for the file; data read
- *        and decrypted from the lower file will be written into this
- *        page
+ * ecryptfs_encrypt_page
+ * @page: Page mapped from the eCryptfs inode for the file; contains
+ *        decrypted content that needs to be encrypted (to a temporary
+ *        page; not in place) and written out to the lower file
  *
- * Decrypt an eCryptfs page. This is done on a per-extent basis. Note
+ * Encrypt an eCryptfs page. This is done on a per-extent basis. Note
  * that eCryptfs pages may straddle the lower pages -- for instance,
  * if the file was created on a machine with an 8K page size
  * (resulting in an 8K header), and then the file is copied onto a
@@ -590,188 +627,82 @@ out:
  *
  * Returns zero on success; negative on error
  */
-int ecryptfs_decrypt_page(struct page *page)
+int ecryptfs_encrypt_page(struct page *page)
+{
+	return ecryptfs_encrypt_pages(&page, 1);
+}
+
+/**
+ * ecryptfs_decrypt_pages
+ * @pages: Pages mapped from the same eCryptfs inode for the file; data
+ *         read and decrypted from the lower file will be written into
+ *         these pages
+ * @nr_pages: Number of pages in @pages
+ *
+ * Read the encrypted pages from the lower file, then decrypt all their
+ * extents as one batch.
+ *
+ * Returns zero on success; negative on error
+ */
+int ecryptfs_decrypt_pages(struct page **pages, int nr_pages)
 {
 	struct inode *ecryptfs_inode;
 	struct ecryptfs_crypt_stat *crypt_stat;
-	char *enc_extent_virt;
-	struct page *enc_extent_page = NULL;
-	unsigned long extent_offset;
-	int rc = 0;
+	struct page **enc_pages;
+	int i, rc;
 
-	ecryptfs_inode = page->mapping->host;
+	ecryptfs_inode = pages[0]->mapping->host;
 	crypt_stat =
 		&(ecryptfs_inode_to_private(ecryptfs_inode)->crypt_stat);
 	BUG_ON(!(crypt_stat->flags & ECRYPTFS_ENCRYPTED));
-	enc_extent_page = alloc_page(GFP_USER);
-	if (!enc_extent_page) {
-		rc = -ENOMEM;
-		ecryptfs_printk(KERN_ERR, "Error allocating memory for "
-				"encrypted extent\n");
-		goto out;
-	}
-	enc_extent_virt = kmap(enc_extent_page);
-	for (extent_offset = 0;
-	     extent_offset < (PAGE_CACHE_SIZE / crypt_stat->extent_size);
-	     extent_offset++) {
-		loff_t offset;
-
-		ecryptfs_lower_offset_for_extent(
-			&offset, ((page->index * (PAGE_CACHE_SIZE
-						  / crypt_stat->extent_size))
-				  + extent_offset), crypt_stat);
-		rc = ecryptfs_read_lower(enc_extent_virt, offset,
-					 crypt_stat->extent_size,
-					 ecryptfs_inode);
+	enc_pages = ecryptfs_alloc_enc_pages(nr_pages);
+	if (!enc_pages)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_pages; i++) {
+		char *enc_virt = kmap(enc_pages[i]);
+
+		rc = ecryptfs_read_lower(enc_virt,
+			ecryptfs_lower_offset_for_page(pages[i], crypt_stat),
+			PAGE_CACHE_SIZE, ecryptfs_inode);
+		kunmap(enc_pages[i]);
 		if (rc < 0) {
 			ecryptfs_printk(KERN_ERR, "Error attempting "
 					"to read lower page; rc = [%d]"
 					"\n", rc);
 			goto out;
 		}
-		rc = ecryptfs_decrypt_extent(page, crypt_stat, enc_extent_page,
-					     extent_offset);
-		if (rc) {
-			printk(KERN_ERR "%s: Error encrypting extent; "
-			       "rc = [%d]\n", __func__, rc);
-			goto out;
-		}
-	}
-out:
-	if (enc_extent_page) {
-		kunmap(enc_extent_page);
-		__free_page(enc_extent_page);
-	}
-	return rc;
-}
-
-/**
- * decrypt_scatterlist
- * @crypt_stat: Cryptographic context
- * @dest_sg: The destination scatterlist to decrypt into
- * @src_sg: The source scatterlist to decrypt from
- * @size: The number of bytes to decrypt
- * @iv: The initialization vector to use for the decryption
- *
- * Returns the number of bytes decrypted; negative value on error
- */
-static int decrypt_scatterlist(struct ecryptfs_crypt_stat *crypt_stat,
-			       struct scatterlist *dest_sg,
-			       struct scatterlist *src_sg, int size,
-			       unsigned char *iv)
-{
-	struct ablkcipher_request *req = NULL;
-	struct extent_crypt_result ecr;
-	int rc = 0;
-
-	BUG_ON(!crypt_stat || !crypt_stat->tfm
-	       || !(crypt_stat->flags & ECRYPTFS_STRUCT_INITIALIZED));
-	if (unlikely(ecryptfs_verbosity > 0)) {
-		ecryptfs_printk(KERN_DEBUG, "Key size [%zd]; key:\n",
-				crypt_stat->key_size);
-		ecryptfs_dump_hex(crypt_stat->key,
-				  crypt_stat->key_size);
-	}
-
-	init_completion(&ecr.completion);
-
-	mutex_lock(&crypt_stat->cs_tfm_mutex);
-	req = ablkcipher_request_alloc(crypt_stat->tfm, GFP_NOFS);
-	if (!req) {
-		mutex_unlock(&crypt_stat->cs_tfm_mutex);
-		rc = -ENOMEM;
-		goto out;
-	}
-
-	ablkcipher_request_set_callback(req,
-			CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
-			extent_crypt_complete, &ecr);
-	/* Consider doing this once, when the file is opened */
-	if (!(crypt_stat->flags & ECRYPTFS_KEY_SET)) {
-		rc = crypto_ablkcipher_setkey(crypt_stat->tfm, crypt_stat->key,
-					      crypt_stat->key_size);
-		if (rc) {
-			ecryptfs_printk(KERN_ERR,
-					"Error setting key; rc = [%d]\n",
-					rc);
-			mutex_unlock(&crypt_stat->cs_tfm_mutex);
-			rc = -EINVAL;
-			goto out;
-		}
-		crypt_stat->flags |= ECRYPTFS_KEY_SET;
 	}
-	mutex_unlock(&crypt_stat->cs_tfm_mutex);
-	ecryptfs_printk(KERN_DEBUG, "Decrypting [%d] bytes.\n", size);
-	ablkcipher_request_set_crypt(req, src_sg, dest_sg, size, iv);
-	rc = crypto_ablkcipher_decrypt(req);
-	if (rc == -EINPROGRESS || rc == -EBUSY) {
-		struct extent_crypt_result *ecr = req->base.data;
 
-		wait_for_completion(&ecr->completion);
-		rc = ecr->rc;
-		INIT_COMPLETION(ecr->completion);
-	}
+	rc = crypt_pages(crypt_stat, pages, enc_pages, nr_pages, DECRYPT);
+	if (rc)
+		printk(KERN_ERR "%s: Error decrypting pages starting at "
+		       "page->index = [%ld]; rc = [%d]\n", __func__,
+		       pages[0]->index, rc);
 out:
-	ablkcipher_request_free(req);
+	ecryptfs_free_enc_pages(enc_pages, nr_pages);
 	return rc;
-
 }
 
 /**
- * ecryptfs_encrypt_page_offset
- * @crypt_stat: The cryptographic context
- * @dst_page: The page to encrypt into
- * @dst_offset: The offset in the page to encrypt into
- * @src_page: The page to encrypt from
- * @src_offset: The offset in the page to encrypt from
- * @size: The number of bytes to encrypt
- * @iv: The initialization vector to use for the encryption
+ * ecryptfs_decrypt_page
+ * @page: Page mapped from the eCryptfs inode for the file; data read
+ *        and decrypted from the lower file will be written into this
+ *        page
  *
- * Returns the number of bytes encrypted
- */
-static int
-ecryptfs_encrypt_page_offset(struct ecryptfs_crypt_stat *crypt_stat,
-			     struct page *dst_page, int dst_offset,
-			     struct page *src_page, int src_offset, int size,
-			     unsigned char *iv)
-{
-	struct scatterlist src_sg, dst_sg;
-
-	sg_init_table(&src_sg, 1);
-	sg_init_table(&dst_sg, 1);
-
-	sg_set_page(&src_sg, src_page, size, src_offset);
-	sg_set_page(&dst_sg, dst_page, size, dst_offset);
-	return encrypt_scatterlist(crypt_stat, &dst_sg, &src_sg, size, iv);
-}
-
-/**
- * ecryptfs_decrypt_page_offset
- * @crypt_stat: The cryptographic context
- * @dst_page: The page to decrypt into
- * @dst_offset: The offset in the page to decrypt into
- * @src_page: The page to decrypt from
- * @src_offset: The offset in the page to decrypt from
- * @size: The number of bytes to decrypt
- * @iv: The initialization vector to use for the decryption
+ * Decrypt an eCryptfs page. This is done on a per-extent basis. Note
+ * that eCryptfs pages may straddle the lower pages -- for instance,
+ * if the file was created on a machine with an 8K page size
+ * (resulting in an 8K header), and then the file is copied onto a
+ * host with a 32K page size, then when reading page 0 of the eCryptfs
+ * file, 24K of page 0 of the lower file will be read and decrypted,
+ * and then 8K of page 1 of the lower file will be read and decrypted.
  *
- * Returns the number of bytes decrypted
+ * Returns zero on success; negative on error
  */
-static int
-ecryptfs_decrypt_page_offset(struct ecryptfs_crypt_stat *crypt_stat,
-			     struct page *dst_page, int dst_offset,
-			     struct page *src_page, int src_offset, int size,
-			     unsigned char *iv)
+int ecryptfs_decrypt_page(struct page *page)
 {
-	struct scatterlist src_sg, dst_sg;
-
-	sg_init_table(&src_sg, 1);
-	sg_set_page(&src_sg, src_page, size, src_offset);
-
-	sg_init_table(&dst_sg, 1);
-	sg_set_page(&dst_sg, dst_page, size, dst_offset);
-
-	return decrypt_scatterlist(crypt_stat, &dst_sg, &src_sg, size, iv);
+	return ecryptfs_decrypt_pages(&page, 1);
 }
 
 #define ECRYPTFS_MAX_SCATTERLIST_LEN 4
@@ -597,7 +597,9 @@ void ecryptfs_destroy_mount_crypt_stat(
 int ecryptfs_init_crypt_ctx(struct ecryptfs_crypt_stat *crypt_stat);
 int ecryptfs_write_inode_size_to_metadata(struct inode *ecryptfs_inode);
 int ecryptfs_encrypt_page(struct page *page);
+int ecryptfs_encrypt_pages(struct page **pages, int nr_pages);
 int ecryptfs_decrypt_page(struct page *page);
+int ecryptfs_decrypt_pages(struct page **pages, int nr_pages);
 int ecryptfs_write_metadata(struct dentry *ecryptfs_dentry,
 			    struct inode *ecryptfs_inode);
 int ecryptfs_read_metadata(struct dentry *ecryptfs_dentry);
@@ -28,6 +28,7 @@
 #include <linux/pagemap.h>
 #include <linux/writeback.h>
 #include <linux/page-flags.h>
+#include <linux/pagevec.h>
 #include <linux/mount.h>
 #include <linux/file.h>
 #include <linux/crypto.h>
@@ -79,6 +80,80 @@ out:
 	return rc;
 }
 
+/*
+ * Encrypt and write out a batch of pages under writeback, then end
+ * writeback on them.
+ */
+static int ecryptfs_encrypt_pagevec(struct pagevec *pvec)
+{
+	int i, rc;
+
+	if (!pagevec_count(pvec))
+		return 0;
+
+	rc = ecryptfs_encrypt_pages(pvec->pages, pagevec_count(pvec));
+	if (rc)
+		ecryptfs_printk(KERN_WARNING, "Error encrypting pages (upper "
+				"index [0x%.16lx] onwards)\n",
+				pvec->pages[0]->index);
+
+	for (i = 0; i < pagevec_count(pvec); i++) {
+		struct page *page = pvec->pages[i];
+
+		if (rc) {
+			SetPageError(page);
+			mapping_set_error(page->mapping, rc);
+		}
+		end_page_writeback(page);
+		page_cache_release(page);
+	}
+	pagevec_reinit(pvec);
+	return rc;
+}
+
+static int ecryptfs_writepages_fill(struct page *page,
+				    struct writeback_control *wbc, void *data)
+{
+	struct pagevec *pvec = data;
+
+	/*
+	 * Hold the page under writeback rather than locked while it waits
+	 * for the rest of the batch, so it can't be truncated away, and
+	 * writers dirtying it again get it written out again later.
+	 */
+	set_page_writeback(page);
+	page_cache_get(page);
+	unlock_page(page);
+
+	if (!pagevec_add(pvec, page))
+		return ecryptfs_encrypt_pagevec(pvec);
+	return 0;
+}
+
+/**
+ * ecryptfs_writepages
+ * @mapping: The eCryptfs inode mapping to write back
+ * @wbc: Writeback control
+ *
+ * Batch the dirty pages, so all their extents are handed to the cipher
+ * at once.  An asynchronous cipher such as a crypto engine then works
+ * on the whole batch instead of waiting for each extent in turn.
+ *
+ * Returns zero on success; non-zero otherwise
+ */
+static int ecryptfs_writepages(struct address_space *mapping,
+			       struct writeback_control *wbc)
+{
+	struct pagevec pvec;
+	int rc, flush_rc;
+
+	pagevec_init(&pvec, 0);
+	rc = write_cache_pages(mapping, wbc, ecryptfs_writepages_fill, &pvec);
+	flush_rc = ecryptfs_encrypt_pagevec(&pvec);
+
+	return rc ? rc : flush_rc;
+}
+
 static void strip_xattr_flag(char *page_virt,
 			     struct ecryptfs_crypt_stat *crypt_stat)
 {
@@ -243,6 +318,79 @@ out:
 	return rc;
 }
 
+/*
+ * Read and decrypt a batch of locked pages, then unlock them.
+ */
+static int ecryptfs_decrypt_pagevec(struct pagevec *pvec)
+{
+	int i, rc;
+
+	if (!pagevec_count(pvec))
+		return 0;
+
+	rc = ecryptfs_decrypt_pages(pvec->pages, pagevec_count(pvec));
+	if (rc)
+		ecryptfs_printk(KERN_ERR, "Error decrypting pages (upper "
+				"index [0x%.16lx] onwards); rc = [%d]\n",
+				pvec->pages[0]->index, rc);
+
+	for (i = 0; i < pagevec_count(pvec); i++) {
+		struct page *page = pvec->pages[i];
+
+		if (rc)
+			ClearPageUptodate(page);
+		else
+			SetPageUptodate(page);
+		unlock_page(page);
+		page_cache_release(page);
+	}
+	pagevec_reinit(pvec);
+	return rc;
+}
+
+static int ecryptfs_readpages_fill(void *data, struct page *page)
+{
+	struct pagevec *pvec = data;
+
+	page_cache_get(page);
+	if (!pagevec_add(pvec, page))
+		return ecryptfs_decrypt_pagevec(pvec);
+	return 0;
+}
+
+/**
+ * ecryptfs_readpages
+ * @file: An eCryptfs file
+ * @mapping: The eCryptfs inode mapping
+ * @pages: Readahead pages, not yet in the page cache
+ * @nr_pages: Number of pages in @pages
+ *
+ * Decrypt readahead in batches, so all the extents of a batch are
+ * handed to the cipher at once.  Files which aren't decrypted on read
+ * go through ecryptfs_readpage() as before.
+ *
+ * Returns zero on success; non-zero on error.
+ */
+static int ecryptfs_readpages(struct file *file, struct address_space *mapping,
+			      struct list_head *pages, unsigned nr_pages)
+{
+	struct ecryptfs_crypt_stat *crypt_stat =
+		&ecryptfs_inode_to_private(mapping->host)->crypt_stat;
+	struct pagevec pvec;
+	int rc, flush_rc;
+
+	if (!(crypt_stat->flags & ECRYPTFS_ENCRYPTED)
+	    || (crypt_stat->flags & ECRYPTFS_VIEW_AS_ENCRYPTED))
+		return read_cache_pages(mapping, pages,
+					(filler_t *)ecryptfs_readpage, file);
+
+	pagevec_init(&pvec, 0);
+	rc = read_cache_pages(mapping, pages, ecryptfs_readpages_fill, &pvec);
+	flush_rc = ecryptfs_decrypt_pagevec(&pvec);
+
+	return rc ? rc : flush_rc;
+}
+
 /**
  * Called with lower inode mutex held.
  */
@@ -554,7 +702,9 @@ static sector_t ecryptfs_bmap(struct address_space *mapping, sector_t block)
 
 const struct address_space_operations ecryptfs_aops = {
 	.writepage = ecryptfs_writepage,
+	.writepages = ecryptfs_writepages,
 	.readpage = ecryptfs_readpage,
+	.readpages = ecryptfs_readpages,
 	.write_begin = ecryptfs_write_begin,
 	.write_end = ecryptfs_write_end,
 	.bmap = ecryptfs_bmap,
@@ -456,6 +456,11 @@ static int get_data_block_bmap(struct inode *inode, sector_t iblock,
 
 static int f2fs_read_data_page(struct file *file, struct page *page)
 {
+	struct inode *inode = page->mapping->host;
+
+	if (f2fs_has_inline_data(inode))
+		return f2fs_read_inline_data(inode, page);
+
 	return mpage_readpage(page, get_data_block_ro);
 }
 
@@ -463,6 +468,10 @@ static int f2fs_read_data_pages(struct file *file,
 			struct address_space *mapping,
 			struct list_head *pages, unsigned nr_pages)
 {
+	/* inline data is read by f2fs_read_data_page() */
+	if (f2fs_has_inline_data(mapping->host))
+		return 0;
+
 	return mpage_readpages(mapping, pages, nr_pages, get_data_block_ro);
 }
 
@@ -512,7 +521,7 @@ static int f2fs_write_data_page(struct page *page,
 	loff_t i_size = i_size_read(inode);
 	const pgoff_t end_index = ((unsigned long long) i_size)
 							>> PAGE_CACHE_SHIFT;
-	unsigned offset;
+	unsigned offset = 0;
 	bool need_balance_fs = false;
 	int err = 0;
 
@@ -544,6 +553,10 @@ write:
 		dec_page_count(sbi, F2FS_DIRTY_DENTS);
 		inode_dec_dirty_dents(inode);
 		err = do_write_data_page(page);
+	} else if (f2fs_has_inline_data(inode)) {
+		int ilock = mutex_lock_op(sbi);
+		err = f2fs_write_inline_data(inode, page, offset);
+		mutex_unlock_op(sbi, ilock);
 	} else {
 		int ilock = mutex_lock_op(sbi);
 		err = do_write_data_page(page);
@@ -632,12 +645,20 @@ static int f2fs_write_begin(struct file *file, struct address_space *mapping,
 	*fsdata = NULL;
 
 	f2fs_balance_fs(sbi);
+
+	err = f2fs_convert_inline_data(inode, pos + len);
+	if (err)
+		return err;
 repeat:
 	page = grab_cache_page_write_begin(mapping, index, flags);
 	if (!page)
 		return -ENOMEM;
 	*pagep = page;
 
+	/* the write still fits in the inode block */
+	if (f2fs_has_inline_data(inode))
+		goto inline_data;
+
 	ilock = mutex_lock_op(sbi);
 
 	set_new_dnode(&dn, inode, NULL, NULL, 0);
@@ -653,7 +674,7 @@ repeat:
 		goto err;
 
 	mutex_unlock_op(sbi, ilock);
-
+inline_data:
 	if ((len == PAGE_CACHE_SIZE) || PageUptodate(page))
 		return 0;
 
@@ -666,7 +687,16 @@ repeat:
 		goto out;
 	}
 
-	if (dn.data_blkaddr == NEW_ADDR) {
+	if (f2fs_has_inline_data(inode)) {
+		err = f2fs_read_inline_data(inode, page);
+		if (err)
+			return err;
+		lock_page(page);
+		if (page->mapping != mapping) {
+			f2fs_put_page(page, 1);
+			goto repeat;
+		}
+	} else if (dn.data_blkaddr == NEW_ADDR) {
 		zero_user_segment(page, 0, PAGE_CACHE_SIZE);
 	} else {
 		err = f2fs_readpage(sbi, page, dn.data_blkaddr, READ_SYNC);
@@ -702,6 +732,10 @@ static ssize_t f2fs_direct_IO(int rw, struct kiocb *iocb,
 	if (rw == WRITE)
 		return 0;
 
+	/* fall back to buffered reads for inline data */
+	if (f2fs_has_inline_data(inode))
+		return 0;
+
 	/* Needs synchronization with the cleaner */
 	return blockdev_direct_IO(rw, iocb, inode, iov, offset, nr_segs,
 						  get_data_block_ro);
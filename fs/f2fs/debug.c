@@ -57,6 +57,12 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->sits = SIT_I(sbi)->dirty_sentries;
 	si->fnids = NM_I(sbi)->fcnt;
 	si->bg_gc = sbi->bg_gc;
+	si->urgent_gc = sbi->urgent_gc;
+	for (i = 0; i < 2; i++) {
+		si->victim_count[i] = sbi->victim_count[i];
+		si->victim_scan[i] = sbi->victim_scan[i];
+		si->victim_vblocks[i] = sbi->victim_vblocks[i];
+	}
 	si->util_free = (int)(free_user_blocks(sbi) >> sbi->log_blocks_per_seg)
 		* 100 / (int)(sbi->user_block_count >> sbi->log_blocks_per_seg)
 		/ 2;
@@ -233,8 +239,18 @@ static int stat_show(struct seq_file *s, void *v)
 			   si->dirty_count);
 		seq_printf(s, "  - Prefree: %d\n  - Free: %d (%d)\n\n",
 			   si->prefree_count, si->free_segs, si->free_secs);
-		seq_printf(s, "GC calls: %d (BG: %d)\n",
-			   si->call_count, si->bg_gc);
+		seq_printf(s, "GC calls: %d (BG: %d, Urgent: %d)\n",
+			   si->call_count, si->bg_gc, si->urgent_gc);
+		for (j = BG_GC; j <= FG_GC; j++) {
+			unsigned int cnt = si->victim_count[j];
+
+			seq_printf(s, "  - %s victims : %u ",
+				   j == BG_GC ? "BG" : "FG", cnt);
+			seq_printf(s, "(avg. scanned %llu, ",
+				   cnt ? div_u64(si->victim_scan[j], cnt) : 0);
+			seq_printf(s, "valid blocks %llu)\n", cnt ?
+				   div_u64(si->victim_vblocks[j], cnt) : 0);
+		}
 		seq_printf(s, "  - data segments : %d\n", si->data_segs);
 		seq_printf(s, "  - node segments : %d\n", si->node_segs);
 		seq_printf(s, "Try to move %d blocks\n", si->tot_blks);
@@ -28,6 +28,7 @@
 #define F2FS_MOUNT_XATTR_USER		0x00000010
 #define F2FS_MOUNT_POSIX_ACL		0x00000020
 #define F2FS_MOUNT_DISABLE_EXT_IDENTIFY	0x00000040
+#define F2FS_MOUNT_INLINE_DATA		0x00000080
 
 #define clear_opt(sbi, option)	(sbi->mount_opt.opt &= ~F2FS_MOUNT_##option)
 #define set_opt(sbi, option)	(sbi->mount_opt.opt |= F2FS_MOUNT_##option)
@@ -412,6 +413,10 @@ struct f2fs_sb_info {
 	unsigned int last_victim[2];		/* last victim segment # */
 	int total_hit_ext, read_hit_ext;	/* extent cache hit ratio */
 	int bg_gc;				/* background gc calls */
+	int urgent_gc;				/* bg gc calls, screen off */
+	unsigned int victim_count[2];		/* # of victims per gc_type */
+	unsigned long long victim_scan[2];	/* # of sections evaluated */
+	unsigned long long victim_vblocks[2];	/* valid blocks in victims */
 	spinlock_t stat_lock;			/* lock for stat operations */
 };
 
@@ -846,6 +851,7 @@ enum {
 	FI_INC_LINK,		/* need to increment i_nlink */
 	FI_ACL_MODE,		/* indicate acl mode */
 	FI_NO_ALLOC,		/* should not allocate any blocks */
+	FI_INLINE_DATA,		/* used for inline data */
 };
 
 static inline void set_inode_flag(struct f2fs_inode_info *fi, int flag)
@@ -878,6 +884,23 @@ static inline int cond_clear_inode_flag(struct f2fs_inode_info *fi, int flag)
 	return 0;
 }
 
+static inline int f2fs_has_inline_data(struct inode *inode)
+{
+	return is_inode_flag_set(F2FS_I(inode), FI_INLINE_DATA);
+}
+
+/*
+ * Inline data is kept in i_addr[1..] of the inode block, so that
+ * i_addr[0] stays free to hold the first data block on conversion.
+ */
+#define MAX_INLINE_DATA		(sizeof(__le32) * (ADDRS_PER_INODE - 1))
+
+static inline void *inline_data_addr(struct page *page)
+{
+	struct f2fs_node *raw_node = (struct f2fs_node *)page_address(page);
+	return (void *)&(raw_node->i.i_addr[1]);
+}
+
 /*
  * file.c
  */
@@ -1047,6 +1070,15 @@ void destroy_gc_caches(void);
 int recover_fsync_data(struct f2fs_sb_info *);
 bool space_for_roll_forward(struct f2fs_sb_info *);
 
+/*
+ * inline.c
+ */
+int f2fs_read_inline_data(struct inode *, struct page *);
+int f2fs_convert_inline_data(struct inode *, loff_t);
+int f2fs_write_inline_data(struct inode *, struct page *, unsigned int);
+void truncate_inline_data(struct inode *, u64);
+bool recover_inline_data(struct inode *, struct page *);
+
 /*
  * debug.c
  */
@@ -1061,7 +1093,9 @@ struct f2fs_stat_info {
 	int ndirty_node, ndirty_dent, ndirty_dirs, ndirty_meta;
 	int nats, sits, fnids;
 	int total_count, utilization;
-	int bg_gc;
+	int bg_gc, urgent_gc;
+	unsigned int victim_count[2];
+	unsigned long long victim_scan[2], victim_vblocks[2];
 	unsigned int valid_count, valid_node_count, valid_inode_count;
 	unsigned int bimodal, avg_vblocks;
 	int util_free, util_valid, util_invalid;
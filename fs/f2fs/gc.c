@@ -17,6 +17,10 @@
 #include <linux/delay.h>
 #include <linux/freezer.h>
 #include <linux/blkdev.h>
+#if defined(CONFIG_FB)
+#include <linux/notifier.h>
+#include <linux/fb.h>
+#endif
 
 #include "f2fs.h"
 #include "node.h"
@@ -26,10 +30,34 @@
 
 static struct kmem_cache *winode_slab;
 
+static unsigned long read_bdev_ios(struct f2fs_sb_info *sbi)
+{
+	struct hd_struct *part = sbi->sb->s_bdev->bd_part;
+
+	return part_stat_read(part, ios[READ]) +
+		part_stat_read(part, ios[WRITE]);
+}
+
+/*
+ * is_idle() only sees the requests queued right now, so also count the
+ * requests the device completed since the previous check: foreground
+ * I/O issued while we slept makes the GC back off as well.
+ */
+static bool has_foreground_io(struct f2fs_sb_info *sbi)
+{
+	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
+	unsigned long ios = read_bdev_ios(sbi);
+	bool busy = ios - gc_th->last_ios > GC_THREAD_MAX_IDLE_IOS;
+
+	gc_th->last_ios = ios;
+	return busy || !is_idle(sbi);
+}
+
 static int gc_thread_func(void *data)
 {
 	struct f2fs_sb_info *sbi = data;
-	wait_queue_head_t *wq = &sbi->gc_thread->gc_wait_queue_head;
+	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
+	wait_queue_head_t *wq = &gc_th->gc_wait_queue_head;
 	long wait_ms;
 
 	wait_ms = GC_THREAD_MIN_SLEEP_TIME;
@@ -39,10 +67,12 @@ static int gc_thread_func(void *data)
 			continue;
 		else
 			wait_event_interruptible_timeout(*wq,
-						kthread_should_stop(),
+						kthread_should_stop() ||
+						gc_th->gc_wake,
 						msecs_to_jiffies(wait_ms));
 		if (kthread_should_stop())
 			break;
+		gc_th->gc_wake = false;
 
 		if (sbi->sb->s_writers.frozen >= SB_FREEZE_WRITE) {
 			wait_ms = GC_THREAD_MAX_SLEEP_TIME;
@@ -65,26 +95,57 @@ static int gc_thread_func(void *data)
 		if (!mutex_trylock(&sbi->gc_mutex))
 			continue;
 
-		if (!is_idle(sbi)) {
+		if (has_foreground_io(sbi)) {
 			wait_ms = increase_sleep_time(wait_ms);
 			mutex_unlock(&sbi->gc_mutex);
 			continue;
 		}
 
-		if (has_enough_invalid_blocks(sbi))
+		if (need_urgent_gc(sbi)) {
+			wait_ms = GC_THREAD_URGENT_SLEEP_TIME;
+			sbi->urgent_gc++;
+		} else if (has_enough_invalid_blocks(sbi)) {
 			wait_ms = decrease_sleep_time(wait_ms);
-		else
+		} else {
 			wait_ms = increase_sleep_time(wait_ms);
+		}
 
 		sbi->bg_gc++;
 
 		/* if return value is not zero, no victim was selected */
 		if (f2fs_gc(sbi))
 			wait_ms = GC_THREAD_NOGC_SLEEP_TIME;
+
+		/* do not take our own I/O for foreground one */
+		gc_th->last_ios = read_bdev_ios(sbi);
 	} while (!kthread_should_stop());
 	return 0;
 }
 
+#if defined(CONFIG_FB)
+static int gc_fb_notifier_callback(struct notifier_block *self,
+				unsigned long event, void *data)
+{
+	struct f2fs_gc_kthread *gc_th =
+		container_of(self, struct f2fs_gc_kthread, fb_notif);
+	struct fb_event *evdata = data;
+	int *blank;
+
+	if (event != FB_EVENT_BLANK || !evdata || !evdata->data)
+		return 0;
+
+	blank = evdata->data;
+	if (*blank == FB_BLANK_POWERDOWN) {
+		gc_th->screen_off = true;
+		gc_th->gc_wake = true;
+		wake_up_interruptible(&gc_th->gc_wait_queue_head);
+	} else if (*blank == FB_BLANK_UNBLANK) {
+		gc_th->screen_off = false;
+	}
+	return 0;
+}
+#endif
+
 int start_gc_thread(struct f2fs_sb_info *sbi)
 {
 	struct f2fs_gc_kthread *gc_th;
@@ -92,12 +153,13 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 
 	if (!test_opt(sbi, BG_GC))
 		return 0;
-	gc_th = kmalloc(sizeof(struct f2fs_gc_kthread), GFP_KERNEL);
+	gc_th = kzalloc(sizeof(struct f2fs_gc_kthread), GFP_KERNEL);
 	if (!gc_th)
 		return -ENOMEM;
 
 	sbi->gc_thread = gc_th;
 	init_waitqueue_head(&sbi->gc_thread->gc_wait_queue_head);
+	gc_th->last_ios = read_bdev_ios(sbi);
 	sbi->gc_thread->f2fs_gc_task = kthread_run(gc_thread_func, sbi,
 			"f2fs_gc-%u:%u", MAJOR(dev), MINOR(dev));
 	if (IS_ERR(gc_th->f2fs_gc_task)) {
@@ -105,6 +167,11 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 		sbi->gc_thread = NULL;
 		return -ENOMEM;
 	}
+#if defined(CONFIG_FB)
+	gc_th->fb_notif.notifier_call = gc_fb_notifier_callback;
+	if (fb_register_client(&gc_th->fb_notif))
+		gc_th->fb_notif.notifier_call = NULL;
+#endif
 	return 0;
 }
 
@@ -113,6 +180,10 @@ void stop_gc_thread(struct f2fs_sb_info *sbi)
 	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	if (!gc_th)
 		return;
+#if defined(CONFIG_FB)
+	if (gc_th->fb_notif.notifier_call)
+		fb_unregister_client(&gc_th->fb_notif);
+#endif
 	kthread_stop(gc_th->f2fs_gc_task);
 	kfree(gc_th);
 	sbi->gc_thread = NULL;
@@ -296,6 +367,12 @@ got_it:
 				sbi->cur_victim_sec = secno;
 			else
 				set_bit(secno, dirty_i->victim_secmap);
+
+			/* cost of the victim selection and of its cleaning */
+			sbi->victim_count[gc_type]++;
+			sbi->victim_scan[gc_type] += nsearched;
+			sbi->victim_vblocks[gc_type] += get_valid_blocks(sbi,
+					p.min_segno, sbi->segs_per_sec);
 		}
 		*result = (p.min_segno / p.ofs_unit) * p.ofs_unit;
 
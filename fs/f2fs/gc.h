@@ -16,6 +16,12 @@
 #define GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define GC_THREAD_MAX_SLEEP_TIME	60000
 #define GC_THREAD_NOGC_SLEEP_TIME	300000	/* wait 5 min */
+#define GC_THREAD_URGENT_SLEEP_TIME	500	/* screen off */
+#define GC_THREAD_MAX_IDLE_IOS		16	/*
+						 * max. # of requests completed
+						 * by the device between two
+						 * wake ups to still be idle
+						 */
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
 #define LIMIT_FREE_BLOCK	40 /* percentage over invalid + free space */
 
@@ -25,6 +31,12 @@
 struct f2fs_gc_kthread {
 	struct task_struct *f2fs_gc_task;
 	wait_queue_head_t gc_wait_queue_head;
+	bool gc_wake;			/* wake up before the timeout */
+	bool screen_off;		/* display is powered down */
+	unsigned long last_ios;		/* device requests seen last */
+#if defined(CONFIG_FB)
+	struct notifier_block fb_notif;
+#endif
 };
 
 struct inode_entry {
@@ -93,6 +105,16 @@ static inline bool has_enough_invalid_blocks(struct f2fs_sb_info *sbi)
 	return false;
 }
 
+/*
+ * With the screen off, collect every few hundred ms as long as the free
+ * space is short of what could be reclaimed from invalid blocks.
+ */
+static inline bool need_urgent_gc(struct f2fs_sb_info *sbi)
+{
+	return sbi->gc_thread->screen_off &&
+		free_user_blocks(sbi) < limit_free_user_blocks(sbi);
+}
+
 static inline int is_idle(struct f2fs_sb_info *sbi)
 {
 	struct block_device *bdev = sbi->sb->s_bdev;
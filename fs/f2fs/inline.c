@@ -0,0 +1,213 @@
+/*
+ * fs/f2fs/inline.c
+ *
+ * Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/fs.h>
+#include <linux/f2fs_fs.h>
+#include <linux/pagemap.h>
+#include "f2fs.h"
+#include "node.h"
+#include "segment.h"
+
+int f2fs_read_inline_data(struct inode *inode, struct page *page)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct page *ipage;
+	void *dst_addr;
+
+	/* only the first page can hold any data */
+	if (page->index) {
+		zero_user_segment(page, 0, PAGE_CACHE_SIZE);
+		goto out;
+	}
+
+	ipage = get_node_page(sbi, inode->i_ino);
+	if (IS_ERR(ipage)) {
+		unlock_page(page);
+		return PTR_ERR(ipage);
+	}
+
+	zero_user_segment(page, MAX_INLINE_DATA, PAGE_CACHE_SIZE);
+
+	dst_addr = kmap(page);
+	memcpy(dst_addr, inline_data_addr(ipage), MAX_INLINE_DATA);
+	kunmap(page);
+	f2fs_put_page(ipage, 1);
+out:
+	SetPageUptodate(page);
+	unlock_page(page);
+	return 0;
+}
+
+/*
+ * Move the inline data out to a regular block at index 0.  The block is
+ * written synchronously before the inline copy is dropped, so a crash in
+ * between still finds the data in one of the two places.
+ */
+static int __f2fs_convert_inline_data(struct inode *inode, struct page *page)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct dnode_of_data dn;
+	struct page *ipage;
+	block_t new_blk_addr;
+	void *dst_addr;
+	int err, ilock;
+
+	ilock = mutex_lock_op(sbi);
+	ipage = get_node_page(sbi, inode->i_ino);
+	if (IS_ERR(ipage)) {
+		mutex_unlock_op(sbi, ilock);
+		return PTR_ERR(ipage);
+	}
+
+	/* i_addr[0] is not used by inline data, so this keeps it intact */
+	set_new_dnode(&dn, inode, ipage, ipage, inode->i_ino);
+	err = reserve_new_block(&dn);
+	if (err) {
+		f2fs_put_dnode(&dn);
+		mutex_unlock_op(sbi, ilock);
+		return err;
+	}
+
+	/* a cached page is at least as new as the inline copy */
+	if (!PageUptodate(page)) {
+		zero_user_segment(page, MAX_INLINE_DATA, PAGE_CACHE_SIZE);
+		dst_addr = kmap(page);
+		memcpy(dst_addr, inline_data_addr(ipage), MAX_INLINE_DATA);
+		kunmap(page);
+		SetPageUptodate(page);
+	}
+
+	wait_on_page_writeback(page);
+	clear_page_dirty_for_io(page);
+	set_page_writeback(page);
+	write_data_page(inode, page, &dn, NEW_ADDR, &new_blk_addr);
+	update_extent_cache(new_blk_addr, &dn);
+	f2fs_submit_bio(sbi, DATA, true);
+	wait_on_page_writeback(page);
+
+	/* clear inline data and flag after data writeback */
+	memset(inline_data_addr(ipage), 0, MAX_INLINE_DATA);
+	clear_inode_flag(F2FS_I(inode), FI_INLINE_DATA);
+	sync_inode_page(&dn);
+
+	f2fs_put_dnode(&dn);
+	mutex_unlock_op(sbi, ilock);
+	return 0;
+}
+
+/**
+ * f2fs_convert_inline_data
+ * @inode: The inode to convert
+ * @to_size: The size the file is about to reach
+ *
+ * Turns an inline inode into a regular one when @to_size no longer fits
+ * in the inode block.  Nothing is done for any other inode.
+ */
+int f2fs_convert_inline_data(struct inode *inode, loff_t to_size)
+{
+	struct page *page;
+	int err;
+
+	if (!f2fs_has_inline_data(inode) || to_size <= MAX_INLINE_DATA)
+		return 0;
+
+	page = grab_cache_page_write_begin(inode->i_mapping, 0, AOP_FLAG_NOFS);
+	if (!page)
+		return -ENOMEM;
+
+	err = __f2fs_convert_inline_data(inode, page);
+	f2fs_put_page(page, 1);
+	return err;
+}
+
+int f2fs_write_inline_data(struct inode *inode, struct page *page,
+						unsigned int size)
+{
+	struct dnode_of_data dn;
+	void *src_addr, *dst_addr;
+	int err;
+
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, 0, LOOKUP_NODE);
+	if (err)
+		return err;
+
+	wait_on_page_writeback(dn.inode_page);
+
+	dst_addr = inline_data_addr(dn.inode_page);
+	memset(dst_addr, 0, MAX_INLINE_DATA);
+	src_addr = kmap(page);
+	memcpy(dst_addr, src_addr, size);
+	kunmap(page);
+
+	sync_inode_page(&dn);
+	f2fs_put_dnode(&dn);
+	return 0;
+}
+
+/* Drop the inline bytes beyond @from so a later extension reads zeroes */
+void truncate_inline_data(struct inode *inode, u64 from)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct page *ipage;
+
+	if (from >= MAX_INLINE_DATA)
+		return;
+
+	ipage = get_node_page(sbi, inode->i_ino);
+	if (IS_ERR(ipage))
+		return;
+
+	wait_on_page_writeback(ipage);
+	memset(inline_data_addr(ipage) + from, 0, MAX_INLINE_DATA - from);
+	set_page_dirty(ipage);
+	f2fs_put_page(ipage, 1);
+}
+
+/**
+ * recover_inline_data
+ * @inode: The inode being recovered
+ * @npage: The node page logged by fsync
+ *
+ * Returns true when @npage carried inline data, which has then been
+ * copied into the inode block and leaves no block address to recover.
+ */
+bool recover_inline_data(struct inode *inode, struct page *npage)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct f2fs_inode *ri = NULL;
+	struct page *ipage;
+
+	if (IS_INODE(npage))
+		ri = &((struct f2fs_node *)page_address(npage))->i;
+
+	if (ri && (ri->i_inline & F2FS_INLINE_DATA)) {
+		ipage = get_node_page(sbi, inode->i_ino);
+		BUG_ON(IS_ERR(ipage));
+		wait_on_page_writeback(ipage);
+		memcpy(inline_data_addr(ipage), inline_data_addr(npage),
+							MAX_INLINE_DATA);
+		set_inode_flag(F2FS_I(inode), FI_INLINE_DATA);
+		update_inode(inode, ipage);
+		f2fs_put_page(ipage, 1);
+		return true;
+	}
+
+	/* the file was converted after the last checkpoint */
+	if (f2fs_has_inline_data(inode)) {
+		ipage = get_node_page(sbi, inode->i_ino);
+		BUG_ON(IS_ERR(ipage));
+		wait_on_page_writeback(ipage);
+		memset(inline_data_addr(ipage), 0, MAX_INLINE_DATA);
+		clear_inode_flag(F2FS_I(inode), FI_INLINE_DATA);
+		update_inode(inode, ipage);
+		f2fs_put_page(ipage, 1);
+	}
+	return false;
+}
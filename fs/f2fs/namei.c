@@ -136,6 +136,9 @@ static int f2fs_create(struct inode *dir, struct dentry *dentry, umode_t mode,
 	if (!test_opt(sbi, DISABLE_EXT_IDENTIFY))
 		set_cold_files(sbi, inode, dentry->d_name.name);
 
+	if (test_opt(sbi, INLINE_DATA))
+		set_inode_flag(F2FS_I(inode), FI_INLINE_DATA);
+
 	inode->i_op = &f2fs_file_inode_operations;
 	inode->i_fop = &f2fs_file_operations;
 	inode->i_mapping->a_ops = &f2fs_dblock_aops;
@@ -2130,14 +2130,20 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 {
 	struct fuse_conn *fc = fuse_get_conn(file);
 	if (fc) {
-		spin_lock(&fc->lock);
-		fc->connected = 0;
-		fc->blocked = 0;
-		fc->initialized = 1;
-		end_queued_requests(fc);
-		end_polls(fc);
-		wake_up_all(&fc->blocked_waitq);
-		spin_unlock(&fc->lock);
+		/*
+		 * Requests read from a closed clone can still be answered
+		 * on the other fds, only disconnect when the last one goes.
+		 */
+		if (atomic_dec_and_test(&fc->dev_count)) {
+			spin_lock(&fc->lock);
+			fc->connected = 0;
+			fc->blocked = 0;
+			fc->initialized = 1;
+			end_queued_requests(fc);
+			end_polls(fc);
+			wake_up_all(&fc->blocked_waitq);
+			spin_unlock(&fc->lock);
+		}
 		fuse_conn_put(fc);
 	}
 
@@ -2155,6 +2161,55 @@ static int fuse_dev_fasync(int fd, struct file *file, int on)
 	return fasync_helper(fd, file, on, &fc->fasync);
 }
 
+/*
+ * Bind a freshly opened /dev/fuse fd to an existing connection, so each
+ * daemon thread can read and splice requests through its own fd
+ * instead of all of them contending on the fd used for the mount.
+ */
+static int fuse_device_clone(struct fuse_conn *fc, struct file *new)
+{
+	/* new is either mounted already or cloned */
+	if (new->private_data)
+		return -EINVAL;
+
+	atomic_inc(&fc->dev_count);
+	new->private_data = fuse_conn_get(fc);
+
+	return 0;
+}
+
+static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	int err = -ENOTTY;
+
+	if (cmd == FUSE_DEV_IOC_CLONE) {
+		u32 oldfd;
+
+		err = -EFAULT;
+		if (!get_user(oldfd, (u32 __user *) arg)) {
+			struct file *old = fget(oldfd);
+
+			err = -EINVAL;
+			if (old) {
+				struct fuse_conn *fc = NULL;
+
+				if (old->f_op == file->f_op)
+					fc = fuse_get_conn(old);
+
+				if (fc) {
+					mutex_lock(&fuse_mutex);
+					err = fuse_device_clone(fc, file);
+					mutex_unlock(&fuse_mutex);
+				}
+				fput(old);
+			}
+		}
+	}
+
+	return err;
+}
+
 const struct file_operations fuse_dev_operations = {
 	.owner		= THIS_MODULE,
 	.llseek		= no_llseek,
@@ -2167,6 +2222,8 @@ const struct file_operations fuse_dev_operations = {
 	.poll		= fuse_dev_poll,
 	.release	= fuse_dev_release,
 	.fasync		= fuse_dev_fasync,
+	.unlocked_ioctl	= fuse_dev_ioctl,
+	.compat_ioctl	= fuse_dev_ioctl,
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
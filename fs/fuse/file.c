@@ -1880,7 +1880,9 @@ static int fuse_file_mmap(struct file *file, struct vm_area_struct *vma)
 {
 	struct fuse_file *ff = file->private_data;
 
-	ff->shortcircuit_enabled = 0;
+	if (ff->shortcircuit_enabled && ff->rw_lower_file)
+		return fuse_shortcircuit_mmap(file, vma);
+
 	if ((vma->vm_flags & VM_SHARED) && (vma->vm_flags & VM_MAYWRITE))
 		fuse_link_write_file(file);
 
@@ -47,6 +47,11 @@
 /** Number of page pointers embedded in fuse_req */
 #define FUSE_REQ_INLINE_PAGES 1
 
+/** Bind a /dev/fuse fd to the connection of the fd passed as argument */
+#ifndef FUSE_DEV_IOC_CLONE
+#define FUSE_DEV_IOC_CLONE	_IOR(229, 0, uint32_t)
+#endif
+
 /** List of active connections */
 extern struct list_head fuse_conn_list;
 
@@ -564,6 +569,9 @@ struct fuse_conn {
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
+	/** The number of /dev/fuse fds bound to the connection */
+	atomic_t dev_count;
+
 	/** Negotiated minor version */
 	unsigned minor;
 
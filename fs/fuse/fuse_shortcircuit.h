@@ -28,6 +28,8 @@ ssize_t fuse_shortcircuit_aio_read(struct kiocb *iocb, const struct iovec *iov,
 ssize_t fuse_shortcircuit_aio_write(struct kiocb *iocb, const struct iovec *iov,
 				    unsigned long nr_segs, loff_t pos);
 
+int fuse_shortcircuit_mmap(struct file *file, struct vm_area_struct *vma);
+
 void fuse_shortcircuit_release(struct fuse_file *ff);
 
 #endif /* _FS_FUSE_SHORCIRCUIT_H */
@@ -71,8 +71,10 @@ static ssize_t fuse_shortcircuit_aio_read_write(struct kiocb *iocb,
 	lower_inode = file_inode(lower_file);
 
 	if (do_write) {
-		if (!lower_file->f_op->aio_write)
-			return -EIO;
+		if (!lower_file->f_op->aio_write) {
+			ret_val = -EIO;
+			goto out;
+		}
 
 		ret_val = lower_file->f_op->aio_write(iocb, iov, nr_segs, pos);
 
@@ -81,14 +83,17 @@ static ssize_t fuse_shortcircuit_aio_read_write(struct kiocb *iocb,
 			fsstack_copy_attr_times(fuse_inode, lower_inode);
 		}
 	} else {
-		if (!lower_file->f_op->aio_read)
-			return -EIO;
+		if (!lower_file->f_op->aio_read) {
+			ret_val = -EIO;
+			goto out;
+		}
 
 		ret_val = lower_file->f_op->aio_read(iocb, iov, nr_segs, pos);
 		if (ret_val >= 0 || ret_val == -EIOCBQUEUED)
 			fsstack_copy_attr_atime(fuse_inode, lower_inode);
 	}
 
+out:
 	iocb->ki_filp = fuse_file;
 	fput(lower_file);
 	/* unlock lower file */
@@ -108,6 +113,37 @@ ssize_t fuse_shortcircuit_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	return fuse_shortcircuit_aio_read_write(iocb, iov, nr_segs, pos, 1);
 }
 
+int fuse_shortcircuit_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	int ret_val;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower_file = ff->rw_lower_file;
+
+	if (!lower_file->f_op->mmap)
+		return -ENODEV;
+
+	if (WARN_ON(file != vma->vm_file))
+		return -EIO;
+
+	/*
+	 * Map the lower file instead, so page faults are served from the
+	 * lower filesystem page cache without a daemon round trip.  The
+	 * vma holds its own reference to the lower file.
+	 */
+	vma->vm_file = get_file(lower_file);
+	ret_val = lower_file->f_op->mmap(lower_file, vma);
+	if (ret_val) {
+		vma->vm_file = file;
+		fput(lower_file);
+		return ret_val;
+	}
+	fput(file);
+
+	fsstack_copy_attr_atime(file_inode(file), file_inode(lower_file));
+
+	return 0;
+}
+
 void fuse_shortcircuit_release(struct fuse_file *ff)
 {
 	if (!(ff->rw_lower_file))
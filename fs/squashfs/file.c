@@ -371,6 +371,119 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+/*
+ * Decompress datablock directly into the page cache pages it covers,
+ * avoiding the copy through the read_page cache.  All the pages of the
+ * block must be grabbed, otherwise -EAGAIN is returned with
+ * target_page left untouched so the caller can fall back to the cache.
+ * On success every page, including target_page, is uptodate and
+ * unlocked.
+ */
+static int squashfs_readpage_block(struct page *target_page, u64 block,
+	int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int i, n, pages, missing_pages = 0, res = -EAGAIN;
+	struct page **page;
+	void **pageaddr;
+
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+
+	page = kcalloc(pages, sizeof(*page), GFP_KERNEL);
+	pageaddr = kcalloc(pages, sizeof(*pageaddr), GFP_KERNEL);
+	if (page == NULL || pageaddr == NULL)
+		goto out;
+
+	/* Try to grab all the pages covered by the datablock */
+	for (i = 0, n = start_index; i < pages; i++, n++) {
+		page[i] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+
+		if (page[i] == NULL) {
+			missing_pages++;
+			continue;
+		}
+
+		if (PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+			page[i] = NULL;
+			missing_pages++;
+		}
+	}
+
+	if (missing_pages) {
+		/*
+		 * Some pages are cached already, or another reader is
+		 * filling them.  Let the caller go through the cache.
+		 */
+		for (i = 0; i < pages; i++) {
+			if (page[i] == NULL || page[i] == target_page)
+				continue;
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+		}
+		goto out;
+	}
+
+	for (i = 0; i < pages; i++)
+		pageaddr[i] = kmap(page[i]);
+
+	/*
+	 * Bound the output by the pages grabbed, the last datablock of the
+	 * file may cover fewer pages than a full block.
+	 */
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+
+	for (i = 0; i < pages; i++) {
+		if (res >= 0) {
+			int avail = clamp_t(int, res - (i << PAGE_CACHE_SHIFT),
+				0, PAGE_CACHE_SIZE);
+
+			memset(pageaddr[i] + avail, 0, PAGE_CACHE_SIZE - avail);
+		}
+		kunmap(page[i]);
+		flush_dcache_page(page[i]);
+	}
+
+	if (res < 0) {
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+		/* target_page is marked errored by the caller */
+		for (i = 0; i < pages; i++) {
+			if (page[i] == target_page)
+				continue;
+			SetPageError(page[i]);
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+		}
+		goto out;
+	}
+
+	for (i = 0; i < pages; i++) {
+		SetPageUptodate(page[i]);
+		unlock_page(page[i]);
+		if (page[i] != target_page)
+			page_cache_release(page[i]);
+	}
+	res = 0;
+
+out:
+	kfree(pageaddr);
+	kfree(page);
+	return res;
+}
+#endif
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -412,6 +525,14 @@ static int squashfs_readpage(struct file *file, struct page *page)
 			/*
 			 * Read and decompress datablock.
 			 */
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+			int res = squashfs_readpage_block(page, block, bsize);
+
+			if (res == 0)
+				return 0;
+			if (res != -EAGAIN)
+				goto error_out;
+#endif
 			buffer = squashfs_get_datablock(inode->i_sb,
 								block, bsize);
 			if (buffer->error) {
@@ -36,6 +36,7 @@
 #include <linux/module.h>
 #include <linux/magic.h>
 #include <linux/xattr.h>
+#include <linux/parser.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -74,6 +75,74 @@ static const struct squashfs_decompressor *supported_squashfs_filesystem(short
 }
 
 
+#if defined(CONFIG_SQUASHFS_DECOMP_MULTI)
+#define SQUASHFS_DEFAULT_THREAD_OPS	(&squashfs_decompressor_multi)
+#elif defined(CONFIG_SQUASHFS_DECOMP_MULTI_PERCPU)
+#define SQUASHFS_DEFAULT_THREAD_OPS	(&squashfs_decompressor_percpu)
+#else
+#define SQUASHFS_DEFAULT_THREAD_OPS	(&squashfs_decompressor_single)
+#endif
+
+static const struct squashfs_decompressor_thread_ops *thread_ops[] = {
+	&squashfs_decompressor_single,
+	&squashfs_decompressor_multi,
+	&squashfs_decompressor_percpu,
+};
+
+enum {
+	Opt_threads, Opt_err
+};
+
+static const match_table_t squashfs_tokens = {
+	{Opt_threads, "threads=%s"},
+	{Opt_err, NULL}
+};
+
+
+/*
+ * Parse the mount options.  Squashfs used to ignore its mount data, so
+ * unknown options are still ignored rather than failing the mount.
+ */
+static int squashfs_parse_options(struct squashfs_sb_info *msblk,
+	char *options)
+{
+	substring_t args[MAX_OPT_ARGS];
+	char *p, *name;
+	int i;
+
+	msblk->thread_ops = SQUASHFS_DEFAULT_THREAD_OPS;
+	if (options == NULL)
+		return 0;
+
+	while ((p = strsep(&options, ",")) != NULL) {
+		if (!*p)
+			continue;
+
+		switch (match_token(p, squashfs_tokens, args)) {
+		case Opt_threads:
+			name = match_strdup(&args[0]);
+			if (name == NULL)
+				return -ENOMEM;
+			for (i = 0; i < ARRAY_SIZE(thread_ops); i++)
+				if (!strcmp(name, thread_ops[i]->name))
+					break;
+			kfree(name);
+			if (i == ARRAY_SIZE(thread_ops)) {
+				ERROR("Unknown threads mount option, expected "
+					"single, multi or percpu\n");
+				return -EINVAL;
+			}
+			msblk->thread_ops = thread_ops[i];
+			break;
+		default:
+			break;
+		}
+	}
+
+	return 0;
+}
+
+
 static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 {
 	struct squashfs_sb_info *msblk;
@@ -98,9 +167,13 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	msblk->devblksize = sb_min_blocksize(sb, SQUASHFS_DEVBLK_SIZE);
 	msblk->devblksize_log2 = ffz(~msblk->devblksize);
 
-	mutex_init(&msblk->read_data_mutex);
 	mutex_init(&msblk->meta_index_mutex);
 
+	err = squashfs_parse_options(msblk, data);
+	if (err)
+		goto failed_mount;
+	TRACE("Using %s decompressor threads\n", msblk->thread_ops->name);
+
 	/*
 	 * msblk->bytes_used is checked in squashfs_read_table to ensure reads
 	 * are not beyond filesystem end.  But as we're using
@@ -205,8 +278,9 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	if (msblk->block_cache == NULL)
 		goto failed_mount;
 
-	/* Allocate read_page block */
-	msblk->read_page = squashfs_cache_init("data", 1, msblk->block_size);
+	/* Allocate read_page blocks, one per decompressor that can run */
+	msblk->read_page = squashfs_cache_init("data",
+		msblk->thread_ops->max_decompressors(), msblk->block_size);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
 		goto failed_mount;
@@ -336,7 +410,7 @@ failed_mount:
 	squashfs_cache_delete(msblk->block_cache);
 	squashfs_cache_delete(msblk->fragment_cache);
 	squashfs_cache_delete(msblk->read_page);
-	squashfs_decompressor_free(msblk, msblk->stream);
+	squashfs_decompressor_destroy(msblk);
 	kfree(msblk->inode_lookup_table);
 	kfree(msblk->fragment_index);
 	kfree(msblk->id_table);
@@ -383,7 +457,7 @@ static void squashfs_put_super(struct super_block *sb)
 		squashfs_cache_delete(sbi->block_cache);
 		squashfs_cache_delete(sbi->fragment_cache);
 		squashfs_cache_delete(sbi->read_page);
-		squashfs_decompressor_free(sbi, sbi->stream);
+		squashfs_decompressor_destroy(sbi);
 		kfree(sbi->id_table);
 		kfree(sbi->fragment_index);
 		kfree(sbi->meta_index);
@@ -61,6 +61,35 @@
 #define DIAG_IOCTL_GET_REAL_TIME	34
 #define DIAG_IOCTL_PERIPHERAL_BUF_CONFIG	35
 #define DIAG_IOCTL_PERIPHERAL_BUF_DRAIN		36
+#define DIAG_IOCTL_DCI_REG_BATCH	37
+
+/*
+ * Shared rings. In memory device mode the logging process maps /dev/diag
+ * at offset 0; a registered DCI client maps it at DIAG_DCI_RING_OFFSET
+ * and receives its logs and events there, with the packet type
+ * (DCI_LOG_TYPE or DCI_EVENT_TYPE) in the token field. The first page
+ * holds struct diag_md_ring_hdr and the data area follows it. head and tail are byte offsets into the data area,
+ * the kernel advances head and the client advances tail. Each record is
+ * a struct diag_md_ring_rec followed by len bytes of data, padded to a
+ * multiple of four. A len of DIAG_MD_RING_WRAP, or fewer bytes left than
+ * a record header, means the next record starts at offset 0.
+ */
+#define DIAG_MD_RING_MAGIC	0x4449524e
+#define DIAG_MD_RING_WRAP	0xFFFFFFFF
+#define DIAG_DCI_RING_OFFSET	0x100000
+
+struct diag_md_ring_hdr {
+	unsigned int magic;
+	unsigned int size;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int dropped;
+};
+
+struct diag_md_ring_rec {
+	unsigned int len;
+	int token;
+};
 
 /* PC Tools IDs */
 #define APQ8060_TOOLS_ID	4062
@@ -451,6 +451,8 @@ struct qup_i2c_clk_path_vote {
  * @base I2C controller virtual base address
  * @clk_freq_in core clock frequency in Hz
  * @clk_freq_out bus clock frequency in Hz
+ * @dma_min_xfer_len multi-message transfers of at least this many bytes use
+ *                   DMA even when they fit in the FIFOs (0 disables)
  */
 struct i2c_msm_resources {
 	struct resource             *mem;
@@ -462,6 +464,7 @@ struct i2c_msm_resources {
 	struct qup_i2c_clk_path_vote clk_path_vote;
 	int                          irq;
 	bool                         disable_dma;
+	u32                          dma_min_xfer_len;
 	struct pinctrl              *pinctrl;
 	struct pinctrl_state        *gpio_state_active;
 	struct pinctrl_state        *gpio_state_suspend;
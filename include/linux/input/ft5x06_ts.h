@@ -72,6 +72,7 @@ struct ft5x06_ts_platform_data {
 	u32 hard_rst_dly;
 	u32 soft_rst_dly;
 	u32 num_max_touches;
+	u32 irq_thread_prio;
 	bool fw_vkey_support;
 	bool no_force_update;
 	bool i2c_pull_up;
@@ -80,10 +80,20 @@ enum ipa_aggr_mode {
  * invoked for on data path
  * @IPA_RECEIVE: data is struct sk_buff
  * @IPA_WRITE_DONE: data is struct sk_buff
+ * @IPA_CLIENT_START_POLL: pipe moved to polling mode, client should schedule
+ *  its NAPI context and call ipa_rx_poll(). data is not valid
+ * @IPA_CLIENT_COMP_NAPI: pipe is about to return to interrupt mode, client
+ *  should complete its NAPI context. data is not valid
+ * @IPA_CLIENT_AGGR_END: all packets of an aggregation frame were delivered
+ *  with IPA_RECEIVE, client may flush packets it held back for coalescing.
+ *  Only sent on NAPI enabled pipes. data is not valid
  */
 enum ipa_dp_evt_type {
 	IPA_RECEIVE,
 	IPA_WRITE_DONE,
+	IPA_CLIENT_START_POLL,
+	IPA_CLIENT_COMP_NAPI,
+	IPA_CLIENT_AGGR_END,
 };
 
 /**
@@ -490,6 +500,8 @@ struct ipa_ext_intf {
  * @skip_ep_cfg: boolean field that determines if EP should be configured
  *  by IPA driver
  * @keep_ipa_awake: when true, IPA will not be clock gated
+ * @napi_enabled: when true, Rx packets are pulled by the client NAPI context
+ *  through ipa_rx_poll() instead of the IPA workqueue
  */
 struct ipa_sys_connect_params {
 	struct ipa_ep_cfg ipa_ep_cfg;
@@ -499,6 +511,7 @@ struct ipa_sys_connect_params {
 	ipa_notify_cb notify;
 	bool skip_ep_cfg;
 	bool keep_ipa_awake;
+	bool napi_enabled;
 };
 
 /**
@@ -1025,6 +1038,13 @@ int ipa_commit_flt(enum ipa_ip_type ip);
 
 int ipa_reset_flt(enum ipa_ip_type ip);
 
+/*
+ * Filtering and Routing commit batch
+ */
+int ipa_commit_batch_begin(void);
+
+int ipa_commit_batch_end(void);
+
 /*
  * NAT
  */
@@ -1077,8 +1097,15 @@ int ipa_tx_dp(enum ipa_client_type dst, struct sk_buff *skb,
 int ipa_tx_dp_mul(enum ipa_client_type dst,
 			struct ipa_tx_data_desc *data_desc);
 
+/*
+ * To transfer a batch of skbs on the HW data path with a single doorbell
+ */
+int ipa_tx_dp_batch(enum ipa_client_type dst, struct sk_buff_head *skbs);
+
 void ipa_free_skb(struct ipa_rx_data *);
 
+int ipa_rx_poll(u32 clnt_hdl, int budget);
+
 /*
  * System pipes
  */
@@ -1136,6 +1163,10 @@ int ipa_rm_inactivity_timer_request_resource(
 int ipa_rm_inactivity_timer_release_resource(
 				enum ipa_rm_resource_name resource_name);
 
+int ipa_rm_inactivity_timer_set_adaptive(
+				enum ipa_rm_resource_name resource_name,
+				bool adaptive);
+
 /*
  * Tethering bridge (Rmnet / MBIM)
  */
@@ -1157,6 +1188,9 @@ int odu_bridge_disconnect(void);
 
 int odu_bridge_tx_dp(struct sk_buff *skb, struct ipa_tx_meta *metadata);
 
+int odu_bridge_tx_dp_batch(struct sk_buff_head *skbs,
+		struct ipa_tx_meta *metadata);
+
 int odu_bridge_cleanup(void);
 
 
@@ -1417,6 +1451,19 @@ static inline int ipa_reset_flt(enum ipa_ip_type ip)
 	return -EPERM;
 }
 
+/*
+ * Filtering and Routing commit batch
+ */
+static inline int ipa_commit_batch_begin(void)
+{
+	return -EPERM;
+}
+
+static inline int ipa_commit_batch_end(void)
+{
+	return -EPERM;
+}
+
 /*
  * NAT
  */
@@ -1523,11 +1570,22 @@ static inline int ipa_tx_dp_mul(
 	return -EPERM;
 }
 
+static inline int ipa_tx_dp_batch(enum ipa_client_type dst,
+		struct sk_buff_head *skbs)
+{
+	return -EPERM;
+}
+
 static inline void ipa_free_skb(struct ipa_rx_data *rx_in)
 {
 	return;
 }
 
+static inline int ipa_rx_poll(u32 clnt_hdl, int budget)
+{
+	return -EPERM;
+}
+
 /*
  * System pipes
  */
@@ -1669,6 +1727,13 @@ static inline int ipa_rm_inactivity_timer_release_resource(
 	return -EPERM;
 }
 
+static inline int ipa_rm_inactivity_timer_set_adaptive(
+				enum ipa_rm_resource_name resource_name,
+				bool adaptive)
+{
+	return -EPERM;
+}
+
 /*
  * Tethering bridge (Rmnet / MBIM)
  */
@@ -1712,6 +1777,12 @@ static inline int odu_bridge_tx_dp(struct sk_buff *skb,
 	return -EPERM;
 }
 
+static inline int odu_bridge_tx_dp_batch(struct sk_buff_head *skbs,
+						struct ipa_tx_meta *metadata)
+{
+	return -EPERM;
+}
+
 static inline int odu_bridge_cleanup(void)
 {
 	return -EPERM;
@@ -21,7 +21,8 @@ enum {
 	TSV_TYPE_MSG_START = 1,
 	TSV_TYPE_SKB = TSV_TYPE_MSG_START,
 	TSV_TYPE_STRING,
-	TSV_TYPE_MSG_END = TSV_TYPE_STRING,
+	TSV_TYPE_BSTRING,
+	TSV_TYPE_MSG_END = TSV_TYPE_BSTRING,
 };
 
 struct tsv_header {
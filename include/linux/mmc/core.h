@@ -107,11 +107,42 @@ struct mmc_request {
 	struct completion	completion;
 	void			(*done)(struct mmc_request *);/* completion function */
 	struct mmc_host		*host;
+	struct mmc_cmdq_req	*cmdq_req;	/* set for command queue tasks */
+};
+
+/**
+ * struct mmc_cmdq_req - a task queued to the command queue engine
+ * @cmd_flags: Task attributes, see the MMC_CMDQ_* flags
+ * @blk_addr: Start block address of the data
+ * @tag: Task id, also the slot used in the engine
+ * @resp_err: Card response of a task that failed
+ * @mrq: Request handed to the host, completed through mrq.done
+ * @data: Data of the task
+ */
+struct mmc_cmdq_req {
+	unsigned int		cmd_flags;
+#define MMC_CMDQ_DIR_READ	(1 << 0)	/* data flows from the card */
+#define MMC_CMDQ_REL_WR		(1 << 1)	/* reliable write */
+#define MMC_CMDQ_PRIO		(1 << 2)	/* high priority task */
+#define MMC_CMDQ_DATA_TAG	(1 << 3)	/* data tag the write */
+#define MMC_CMDQ_FORCED_PRG	(1 << 4)	/* forced programming */
+	u32			blk_addr;
+	unsigned int		tag;
+	u32			resp_err;
+	struct mmc_request	mrq;
+	struct mmc_data		data;
 };
 
 struct mmc_card;
 struct mmc_async_req;
 
+extern int mmc_cmdq_start_req(struct mmc_host *host,
+			      struct mmc_cmdq_req *cmdq_req);
+extern void mmc_cmdq_req_done(struct mmc_request *mrq);
+extern int mmc_cmdq_enable(struct mmc_card *card);
+extern int mmc_cmdq_disable(struct mmc_card *card);
+extern int mmc_cmdq_halt(struct mmc_host *host, bool halt);
+
 extern int mmc_stop_bkops(struct mmc_card *);
 extern int mmc_read_bkops_status(struct mmc_card *);
 extern bool mmc_card_is_prog_state(struct mmc_card *);
@@ -157,6 +157,21 @@ struct mmc_host_ops {
 	unsigned int	(*get_xfer_remain)(struct mmc_host *host);
 };
 
+/*
+ * Operations of a command queue engine (CQE). The card must be switched to
+ * command queue mode before 'enable' and the engine disabled before the card
+ * leaves it. 'request' queues a task in the slot given by its tag, tasks are
+ * completed through mmc_cmdq_req_done() in any order. 'halt' stops the engine
+ * from fetching further tasks, legacy commands may be sent while halted.
+ */
+struct mmc_cmdq_host_ops {
+	int	(*enable)(struct mmc_host *host);
+	void	(*disable)(struct mmc_host *host, bool soft);
+	int	(*request)(struct mmc_host *host, struct mmc_request *mrq);
+	int	(*halt)(struct mmc_host *host, bool halt);
+	void	(*dumpstate)(struct mmc_host *host);
+};
+
 struct mmc_card;
 struct device;
 
@@ -215,6 +230,20 @@ struct mmc_context_info {
 	spinlock_t		lock;
 };
 
+/**
+ * mmc_cmdq_context_info - state of the command queue of a host
+ * @active_reqs		tags of the tasks queued to the engine
+ * @curr_state		CMDQ_STATE_* bits
+ * @wait		woken up when a task completes
+ */
+struct mmc_cmdq_context_info {
+	unsigned long		active_reqs;
+	unsigned long		curr_state;
+#define	CMDQ_STATE_ERR	0
+#define	CMDQ_STATE_HALT	1
+	wait_queue_head_t	wait;
+};
+
 struct regulator;
 
 struct mmc_supply {
@@ -332,6 +361,7 @@ struct mmc_host {
 				 MMC_CAP2_HS400_1_2V)
 #define MMC_CAP2_AWAKE_SUPP	(1 << 25)	/*law modify for  use CMD5 awake 2016-1-27 */
 #define MMC_CAP2_NONHOTPLUG	(1 << 25)	/*Don't support hotplug*/
+#define MMC_CAP2_CMD_QUEUE	(1 << 26)	/* support eMMC command queue */
 	mmc_pm_flag_t		pm_caps;	/* supported pm features */
 
 	int			clk_requests;	/* internal reference counter */
@@ -412,6 +442,11 @@ struct mmc_host {
 	struct mmc_async_req	*areq;		/* active async req */
 	struct mmc_context_info	context_info;	/* async synchronization info */
 
+	const struct mmc_cmdq_host_ops *cmdq_ops;
+	struct mmc_cmdq_context_info	cmdq_ctx;
+	int			num_cq_slots;	/* engine task slots */
+	void			*cmdq_private;
+
 #ifdef CONFIG_FAIL_MMC_REQUEST
 	struct fault_attr	fail_mmc_request;
 #endif
@@ -599,6 +634,16 @@ static inline int mmc_host_packed_wr(struct mmc_host *host)
 	return host->caps2 & MMC_CAP2_PACKED_WR;
 }
 
+static inline int mmc_host_cmdq(struct mmc_host *host)
+{
+	return (host->caps2 & MMC_CAP2_CMD_QUEUE) && host->cmdq_ops;
+}
+
+static inline void *mmc_cmdq_private(struct mmc_host *host)
+{
+	return host->cmdq_private;
+}
+
 #ifdef CONFIG_MMC_CLKGATE
 void mmc_host_clk_hold(struct mmc_host *host);
 void mmc_host_clk_release(struct mmc_host *host);
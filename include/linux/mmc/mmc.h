@@ -215,6 +215,7 @@ struct _mmc_csd {
  * EXT_CSD fields
  */
 
+#define EXT_CSD_CMDQ_MODE_EN		15	/* R/W */
 #define EXT_CSD_FLUSH_CACHE		32      /* W */
 #define EXT_CSD_CACHE_CTRL		33      /* R/W */
 #define EXT_CSD_POWER_OFF_NOTIFICATION	34	/* R/W */
@@ -271,6 +272,8 @@ struct _mmc_csd {
 #define EXT_CSD_GENERIC_CMD6_TIME	248	/* RO */
 #define EXT_CSD_CACHE_SIZE		249	/* RO, 4 bytes */
 #define EXT_CSD_PWR_CL_DDR_200_360	253	/* RO */
+#define EXT_CSD_CMDQ_DEPTH		307	/* RO */
+#define EXT_CSD_CMDQ_SUPPORT		308	/* RO */
 #define EXT_CSD_TAG_UNIT_SIZE		498	/* RO */
 #define EXT_CSD_DATA_TAG_SUPPORT	499	/* RO */
 #define EXT_CSD_MAX_PACKED_WRITES	500	/* RO */
@@ -285,6 +288,10 @@ struct _mmc_csd {
 #define EXT_CSD_BKOPS_EN_MANUAL_EN	BIT(0)
 #define EXT_CSD_BKOPS_EN_AUTO_EN	BIT(1)
 
+#define EXT_CSD_CMDQ_MODE_ENABLE	BIT(0)
+#define EXT_CSD_CMDQ_DEPTH_MASK		0x1F
+#define EXT_CSD_CMDQ_SUPPORTED		BIT(0)
+
 #define EXT_CSD_WR_REL_PARAM_EN		(1<<2)
 #define EXT_CSD_WR_REL_PARAM_EN_RPMB	(1<<4)
 
@@ -18,6 +18,9 @@
 #include <linux/mmc/host.h>
 #include <linux/pm_qos.h>
 #include <linux/ratelimit.h>
+#include <linux/blk-iopoll.h>
+
+struct cmdq_host;
 
 struct sdhci_next {
 	unsigned int sg_count;
@@ -302,6 +305,15 @@ struct sdhci_host {
 	ktime_t reset_wa_t; /* time when the reset workaround is applied */
 	int reset_wa_cnt; /* total number of times workaround is used */
 
+	struct cmdq_host *cq_host; /* command queue engine, if any */
+	u32 cmdq_saved_ier; /* legacy irqs while the engine runs */
+	bool tuning_crc_err; /* CRC error seen since the last tuning */
+
+	struct blk_iopoll iop;	/* polled command/data completion */
+	bool iopoll_enabled;	/* complete requests from iop, not the irq */
+	bool in_iopoll;		/* iop handler running with the lock held */
+	bool iopoll_finish;	/* request finished from the iop handler */
+
 	unsigned long private[0] ____cacheline_aligned;
 };
 #endif /* LINUX_MMC_SDHCI_H */
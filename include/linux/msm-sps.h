@@ -184,6 +184,8 @@ enum sps_option {
 	SPS_O_LATE_EOT   = 0x00080000,
 
 	/* Options to enable software features */
+	/* Moderate EOT/DESC_DONE interrupts (see irq_coalesce_*) */
+	SPS_O_IRQ_COALESCE    = 0x00400000,
 	/* Do not disable a pipe during disconnection */
 	SPS_O_NO_DISABLE      = 0x00800000,
 	/* Transfer operation should be polled */
@@ -519,6 +521,13 @@ struct sps_mem_buffer {
  * @event_thresh - Pipe event threshold or derivative.
  * @lock_group - The lock group this pipe belongs to.
  *
+ * @irq_coalesce_usec - Interrupt moderation poll period in microseconds
+ * (SPS_O_IRQ_COALESCE only).  After an EOT/DESC_DONE interrupt the pipe
+ * interrupt is masked and completions are polled at this period.
+ * @irq_coalesce_count - Interrupt moderation descriptor threshold
+ * (SPS_O_IRQ_COALESCE only).  The pipe interrupt is unmasked once fewer than
+ * this many descriptors complete within one poll period.
+ *
  * @sps_reserved - Reserved word - client must not modify.
  *
  */
@@ -546,6 +555,10 @@ struct sps_connect {
 	u32 irq_gen_addr;
 	u32 irq_gen_data;
 
+	/* Interrupt moderation parameters */
+	u32 irq_coalesce_usec;
+	u32 irq_coalesce_count;
+
 	u32 sps_reserved;
 
 };
@@ -992,6 +1005,32 @@ int sps_register_event(struct sps_pipe *h, struct sps_register_event *reg);
 int sps_transfer_one(struct sps_pipe *h, phys_addr_t addr, u32 size,
 		     void *user, u32 flags);
 
+/**
+ * Perform a batch of single-buffer DMA transfers on an SPS connection
+ * end point
+ *
+ * This function queues count buffers on a pipe under a single pipe lock
+ * acquisition and writes the pipe event register once, after the last
+ * descriptor. It is equivalent to count calls to sps_transfer_one(),
+ * except that the batch is queued either entirely or not at all.
+ *
+ * @h - client context for SPS connection end point
+ *
+ * @iovec - array of count descriptors. The address and flags of each
+ *  entry are built like the arguments of sps_transfer_one(): lower
+ *  32 bits of the physical address in addr, DESC_FLAG_WORD() in flags
+ *
+ * @user - array of count user pointers returned as part of the event
+ *  payload of each descriptor, or NULL
+ *
+ * @count - number of descriptors
+ *
+ * @return 0 on success, negative value on error
+ *
+ */
+int sps_transfer_batch(struct sps_pipe *h, const struct sps_iovec *iovec,
+		       void * const *user, u32 count);
+
 /**
  * Read event queue for an SPS connection end point
  *
@@ -1434,6 +1473,13 @@ static inline int sps_transfer_one(struct sps_pipe *h, phys_addr_t addr,
 	return -EPERM;
 }
 
+static inline int sps_transfer_batch(struct sps_pipe *h,
+				const struct sps_iovec *iovec,
+				void * const *user, u32 count)
+{
+	return -EPERM;
+}
+
 static inline int sps_get_event(struct sps_pipe *h,
 				struct sps_event_notify *event)
 {
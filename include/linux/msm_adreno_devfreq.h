@@ -43,6 +43,12 @@ struct devfreq_msm_adreno_tz_data {
 		unsigned int *index;
 		uint64_t *ib;
 	} bus;
+	struct {
+		u64 gpu_time;
+		u64 period;
+		unsigned int count;
+		u64 predicted;
+	} frame;
 	unsigned int device_id;
 	bool is_64;
 };
@@ -74,6 +74,15 @@ struct kgsl_device_platform_data {
 	unsigned int pm_qos_wakeup_latency;
 };
 
+#if IS_BUILTIN(CONFIG_MSM_KGSL)
+unsigned long kgsl_process_reclaimable_pages(pid_t pid);
+#else
+static inline unsigned long kgsl_process_reclaimable_pages(pid_t pid)
+{
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_MSM_KGSL_DRM
 int kgsl_gem_obj_addr(int drm_fd, int handle, unsigned long *start,
 			unsigned long *len);
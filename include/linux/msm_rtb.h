@@ -13,6 +13,8 @@
 #ifndef __MSM_RTB_H__
 #define __MSM_RTB_H__
 
+#include <linux/types.h>
+
 /*
  * These numbers are used from the kernel command line and sysfs
  * to control filtering. Remove items from here with extreme caution.
@@ -37,16 +39,25 @@ struct msm_rtb_platform_data {
 };
 
 #if defined(CONFIG_MSM_RTB)
+extern u32 msm_rtb_log_mask;
+
 /*
  * returns 1 if data was logged, 0 otherwise
  */
 int uncached_logk_pc(enum logk_event_type log_type, void *caller,
 				void *data);
 
+int __uncached_logk(enum logk_event_type log_type, void *data);
+
 /*
  * returns 1 if data was logged, 0 otherwise
  */
-int uncached_logk(enum logk_event_type log_type, void *data);
+static inline int uncached_logk(enum logk_event_type log_type, void *data)
+{
+	if (!(msm_rtb_log_mask & (1 << (log_type & ~LOGTYPE_NOPC))))
+		return 0;
+	return __uncached_logk(log_type, data);
+}
 
 #define ETB_WAYPOINT  do { \
 				BRANCH_TO_NEXT_ISTR; \
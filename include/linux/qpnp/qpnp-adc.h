@@ -1116,6 +1116,21 @@ int32_t qpnp_vadc_read(struct qpnp_vadc_chip *dev,
 				enum qpnp_vadc_channels channel,
 				struct qpnp_vadc_result *result);
 
+/**
+ * qpnp_vadc_read_cached() - Returns the last result of the channel if it
+ *		is recent enough, else performs an ADC read on it.
+ * @dev:	Structure device for qpnp vadc
+ * @channel:	Input channel to perform the ADC read.
+ * @result:	Structure pointer of type adc_chan_result
+ *		in which the ADC read results are stored.
+ * @max_age_ms:	Oldest result in milliseconds the caller accepts.
+ *		Results of qpnp_vadc_read() from any client count.
+ */
+int32_t qpnp_vadc_read_cached(struct qpnp_vadc_chip *dev,
+				enum qpnp_vadc_channels channel,
+				struct qpnp_vadc_result *result,
+				unsigned int max_age_ms);
+
 /**
  * qpnp_vadc_conv_seq_request() - Performs ADC read on the conversion
  *				sequencer channel.
@@ -1696,6 +1711,11 @@ static inline int32_t qpnp_vadc_read(struct qpnp_vadc_chip *dev,
 				uint32_t channel,
 				struct qpnp_vadc_result *result)
 { return -ENXIO; }
+static inline int32_t qpnp_vadc_read_cached(struct qpnp_vadc_chip *dev,
+				uint32_t channel,
+				struct qpnp_vadc_result *result,
+				unsigned int max_age_ms)
+{ return -ENXIO; }
 static inline int32_t qpnp_vadc_conv_seq_request(struct qpnp_vadc_chip *dev,
 			enum qpnp_vadc_trigger trigger_channel,
 			enum qpnp_vadc_channels channel,
@@ -164,7 +164,8 @@ extern unsigned long nr_iowait_cpu(int cpu);
 extern unsigned long this_cpu_load(void);
 
 extern void sched_update_nr_prod(int cpu, unsigned long nr, bool inc);
-extern void sched_get_nr_running_avg(int *avg, int *iowait_avg);
+extern void sched_get_nr_running_avg(int *avg, int *iowait_avg, int *big_avg);
+extern unsigned int sched_get_cpu_nr_running_avg(int cpu);
 
 extern void calc_global_load(unsigned long ticks);
 extern void update_cpu_load_nohz(void);
@@ -1164,6 +1165,8 @@ struct task_struct {
 	struct sched_rt_entity rt;
 #ifdef CONFIG_SCHED_HMP
 	struct ravg ravg;
+	/* Placement hint, see sched_set_task_boost() */
+	int placement_boost;
 #endif
 #ifdef CONFIG_CGROUP_SCHED
 	struct task_group *sched_task_group;
@@ -1924,11 +1927,29 @@ sched_set_cpu_cstate(int cpu, int cstate, int wakeup_energy, int wakeup_latency)
 
 #ifdef CONFIG_SCHED_HMP
 extern int sched_set_boost(int enable);
+extern int sched_set_task_boost(struct task_struct *p, int boost);
+extern int sched_get_task_boost(struct task_struct *p);
+extern int sched_task_boosted(struct task_struct *p);
 #else
 static inline int sched_set_boost(int enable)
 {
 	return -EINVAL;
 }
+
+static inline int sched_set_task_boost(struct task_struct *p, int boost)
+{
+	return -EINVAL;
+}
+
+static inline int sched_get_task_boost(struct task_struct *p)
+{
+	return 0;
+}
+
+static inline int sched_task_boosted(struct task_struct *p)
+{
+	return 0;
+}
 #endif
 
 #ifdef CONFIG_NO_HZ_COMMON
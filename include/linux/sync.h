@@ -276,7 +276,9 @@ struct sync_fence *sync_fence_create(const char *name, struct sync_pt *pt);
  * @b:		fence b
  *
  * Creates a new fence which contains copies of all the sync_pts in both
- * @a and @b.  @a and @b remain valid, independent fences.
+ * @a and @b.  @a and @b remain valid, independent fences.  When one of
+ * them already waits for everything in the other, a new reference to it
+ * is returned instead, to be released with sync_fence_put() as well.
  */
 struct sync_fence *sync_fence_merge(const char *name,
 				    struct sync_fence *a, struct sync_fence *b);
@@ -29,6 +29,7 @@
 #define TEST_NO_PATTERN		0xDEADBEEF
 #define BIO_U32_SIZE 1024
 #define TEST_BIO_SIZE		PAGE_SIZE	/* use one page bios */
+#define TEST_MAX_LAT_SAMPLES	4096
 
 struct test_data;
 
@@ -107,6 +108,8 @@ struct test_debug {
  *			verify the data
  * @req_id:		A unique ID to identify a test request
  *			to ease the debugging of the test cases
+ * @dispatch_time:	The time the request was dispatched to the
+ *			driver, used for latency statistics
  */
 struct test_request {
 	struct list_head queuelist;
@@ -118,6 +121,34 @@ struct test_request {
 	int is_err_expected;
 	int wr_rd_data_pattern;
 	int req_id;
+	ktime_t dispatch_time;
+};
+
+/**
+ * struct test_lat_stats - completion latency samples of a test
+ * @samples:		Latency (usec) of each completed request, per
+ *			data direction
+ * @nr_samples:		Number of valid entries in @samples
+ */
+struct test_lat_stats {
+	u32 *samples[2];
+	unsigned int nr_samples[2];
+};
+
+/**
+ * struct test_lat_report - completion latency summary
+ * @nr_samples:		Number of requests the summary is based on
+ * @p50_us:		Median latency (usec)
+ * @p90_us:		90th percentile latency (usec)
+ * @p99_us:		99th percentile latency (usec)
+ * @max_us:		Highest latency (usec)
+ */
+struct test_lat_report {
+	unsigned int nr_samples;
+	u32 p50_us;
+	u32 p90_us;
+	u32 p99_us;
+	u32 max_us;
 };
 
 /**
@@ -207,6 +238,8 @@ struct blk_dev_test_type {
  *			test round was disturbed by an external
  *			flush request, therefore disqualifying
  *			the results
+ * @lat_stats:		Completion latency samples of the current
+ *			test round
  */
 struct test_data {
 	struct list_head queue;
@@ -232,6 +265,7 @@ struct test_data {
 	struct test_info test_info;
 	bool fs_wr_reqs_during_test;
 	bool ignore_round;
+	struct test_lat_stats lat_stats;
 };
 
 extern int test_iosched_start_test(struct test_info *t_info);
@@ -270,4 +304,8 @@ void check_test_completion(void);
 
 int compare_buffer_to_pattern(struct test_request *test_rq);
 
+void test_iosched_account_lat(struct test_request *test_rq);
+
+int test_iosched_get_lat_report(int direction, struct test_lat_report *rep);
+
 #endif /* _LINUX_TEST_IOSCHED_H */
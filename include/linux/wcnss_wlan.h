@@ -17,6 +17,8 @@
 #include <linux/device.h>
 #include <linux/sched.h>
 
+struct sk_buff;
+
 enum wcnss_opcode {
 	WCNSS_WLAN_SWITCH_OFF = 0,
 	WCNSS_WLAN_SWITCH_ON,
@@ -107,6 +109,7 @@ void wcnss_prevent_suspend(void);
 int wcnss_hardware_type(void);
 void *wcnss_prealloc_get(unsigned int size);
 int wcnss_prealloc_put(void *ptr);
+struct sk_buff *wcnss_skb_prealloc_get(unsigned int size);
 void wcnss_reset_intr(void);
 void wcnss_reset_fiq(bool clk_chk_en);
 void wcnss_suspend_notify(void);
@@ -2,6 +2,15 @@
 #define _NET_ESP_H
 
 #include <linux/skbuff.h>
+#include <linux/atomic.h>
+#include <linux/crypto.h>
+
+/*
+ * Number of requests per SA that may be backlogged on an asynchronous
+ * AEAD whose queue is full, rather than being dropped. Beyond that, -EBUSY
+ * still drops the packet so that a slow engine cannot pin unbounded memory.
+ */
+#define ESP_MAX_BACKLOG	64
 
 struct crypto_aead;
 
@@ -11,8 +20,23 @@ struct esp_data {
 
 	/* Confidentiality & Integrity */
 	struct crypto_aead *aead;
+
+	/* Requests submitted and not yet completed */
+	atomic_t inflight;
 };
 
+static inline u32 esp_req_flags(struct esp_data *esp)
+{
+	if (atomic_inc_return(&esp->inflight) <= ESP_MAX_BACKLOG)
+		return CRYPTO_TFM_REQ_MAY_BACKLOG;
+	return 0;
+}
+
+static inline void esp_req_done(struct esp_data *esp)
+{
+	atomic_dec(&esp->inflight);
+}
+
 extern void *pskb_put(struct sk_buff *skb, struct sk_buff *tail, int len);
 
 struct ip_esp_hdr;
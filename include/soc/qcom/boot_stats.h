@@ -10,8 +10,21 @@
  * GNU General Public License for more details.
  */
 
+#ifndef __SOC_QCOM_BOOT_STATS_H
+#define __SOC_QCOM_BOOT_STATS_H
+
+#include <linux/init.h>
+#include <linux/ktime.h>
+
 #ifdef CONFIG_MSM_BOOT_STATS
 int boot_stats_init(void);
+void boot_stats_marker(const char *fmt, ...) __printf(1, 2);
+void boot_stats_initcall(initcall_t fn, ktime_t duration);
 #else
 static inline int boot_stats_init(void) { return 0; }
+static inline __printf(1, 2)
+void boot_stats_marker(const char *fmt, ...) { }
+static inline void boot_stats_initcall(initcall_t fn, ktime_t duration) { }
+#endif
+
 #endif
@@ -53,6 +53,8 @@ struct clk_freq_tbl {
  * @set_rate: function to set frequency
  * @freq_tbl: frequency table for this RCG
  * @current_freq: current RCG frequency
+ * @prev_freq: frequency the RCG ran at before current_freq, checked before
+ *	       walking freq_tbl so toggling between two rates skips the search
  * @c: generic clock data
  * @base: pointer to base address of ioremapped registers.
  */
@@ -63,6 +65,7 @@ struct rcg_clk {
 
 	struct clk_freq_tbl *freq_tbl;
 	struct clk_freq_tbl *current_freq;
+	struct clk_freq_tbl *prev_freq;
 	struct clk	c;
 
 	void *const __iomem *base;
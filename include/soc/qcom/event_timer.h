@@ -37,6 +37,19 @@ struct event_timer_info *add_event_timer(void (*function)(void *), void *data);
  */
 void activate_event_timer(struct event_timer_info *event, ktime_t event_time);
 
+/**
+ * activate_event_timer_slack() : Set the expiration time for an event in
+ *                                absolute ktime, allowing it to fire up to
+ *                                @slack later. Events are aligned to share
+ *                                wakeups within their slack, which lets the
+ *                                system stay idle for longer.
+ *  @event : Event handle.
+ *  @event_time : Earliest event time in absolute ktime.
+ *  @slack : Tolerated delay past @event_time.
+ */
+void activate_event_timer_slack(struct event_timer_info *event,
+				ktime_t event_time, ktime_t slack);
+
 /**
  * deactivate_event_timer() : Deactivate an event timer.
  * @event: event handle.
@@ -64,6 +77,9 @@ static inline void *add_event_timer(void (*function)(void *), void *data)
 
 static inline void activate_event_timer(void *event, ktime_t event_time) {}
 
+static inline void activate_event_timer_slack(void *event,
+				ktime_t event_time, ktime_t slack) {}
+
 static inline void deactivate_event_timer(void *event) {}
 
 static inline void destroy_event_timer(void *event) {}
@@ -21,6 +21,8 @@ struct lpm_stats;
 struct lpm_stats *lpm_stats_config_level(const char *name,
 	const char **levels, int num_levels, struct lpm_stats *parent,
 	struct cpumask *mask);
+void lpm_stats_config_cpu_residency(const uint32_t *residency_us,
+	int num_levels, struct cpumask *mask);
 void lpm_stats_cluster_enter(struct lpm_stats *stats, uint32_t index);
 void lpm_stats_cluster_exit(struct lpm_stats *stats, uint32_t index,
 				bool success);
@@ -36,6 +38,12 @@ static inline struct lpm_stats *lpm_stats_config_level(const char *name,
 	return ERR_PTR(-ENODEV);
 }
 
+static inline void lpm_stats_config_cpu_residency(
+	const uint32_t *residency_us, int num_levels, struct cpumask *mask)
+{
+	return;
+}
+
 static inline void lpm_stats_cluster_enter(struct lpm_stats *stats,
 						uint32_t index)
 {
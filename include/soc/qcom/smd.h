@@ -19,6 +19,7 @@
 #define __ASM_ARCH_MSM_SMD_H
 
 #include <linux/io.h>
+#include <linux/uio.h>
 
 #include <soc/qcom/smem.h>
 
@@ -95,6 +96,32 @@ int smd_write(smd_channel_t *ch, const void *data, int len);
 int smd_write_avail(smd_channel_t *ch);
 int smd_read_avail(smd_channel_t *ch);
 
+/* Zero-copy reads.  smd_read_peek() describes up to @len readable bytes
+** in place as two segments, the second one only being used when the data
+** wraps around the end of the FIFO.  Packet channels are limited to the
+** rest of the current packet.  The segments point into shared memory and
+** must be read with smd_copy_from_fifo() or by DMA.  Nothing is consumed
+** until smd_read_consume() is called.  Callers serialize these with any
+** other reads on the channel, as for smd_read().
+*/
+int smd_read_peek(smd_channel_t *ch, struct kvec vec[2], int len);
+int smd_read_consume(smd_channel_t *ch, int len);
+int smd_copy_from_fifo(smd_channel_t *ch, void *dest, const void *src,
+		       int len);
+
+/* Batched reads for packet channels.  Reads up to @max_pkts (0 for no
+** limit) packets that are completely in the FIFO, holding the SMD lock
+** once for the whole batch and notifying the remote side once at the end.
+** @get_buf is called with the length of each packet and returns where to
+** copy it, or NULL to discard it.  It runs with the lock held and
+** interrupts disabled, so it must not sleep.  Returns the number of
+** packets read, including the discarded ones.  Callers serialize this
+** with any other reads on the channel, as for smd_read().
+*/
+int smd_read_packets(smd_channel_t *ch,
+		     void *(*get_buf)(void *priv, int len), void *priv,
+		     int max_pkts);
+
 /* Returns the total size of the current packet being read.
 ** Returns 0 if no packets available or a stream channel.
 */
@@ -127,6 +154,14 @@ void smd_enable_read_intr(smd_channel_t *ch);
  */
 void smd_disable_read_intr(smd_channel_t *ch);
 
+/*
+ * Coalesce the interrupts raised towards the remote processor by writes.
+ * While the remote has not yet serviced a previous write interrupt,
+ * further writes do not raise new ones; a single deferred notification
+ * is sent at most @usecs later instead.  0 disables coalescing.
+ */
+int smd_set_write_coalesce(smd_channel_t *ch, unsigned int usecs);
+
 /**
  * Enable/disable receive interrupts for the remote processor used by a
  * particular channel.
@@ -288,6 +323,29 @@ static inline int smd_cur_packet_size(smd_channel_t *ch)
 	return -ENODEV;
 }
 
+static inline int smd_read_peek(smd_channel_t *ch, struct kvec vec[2], int len)
+{
+	return -ENODEV;
+}
+
+static inline int smd_read_consume(smd_channel_t *ch, int len)
+{
+	return -ENODEV;
+}
+
+static inline int smd_read_packets(smd_channel_t *ch,
+				   void *(*get_buf)(void *priv, int len),
+				   void *priv, int max_pkts)
+{
+	return -ENODEV;
+}
+
+static inline int smd_copy_from_fifo(smd_channel_t *ch, void *dest,
+				     const void *src, int len)
+{
+	return -ENODEV;
+}
+
 static inline int smd_tiocmget(smd_channel_t *ch)
 {
 	return -ENODEV;
@@ -320,6 +378,11 @@ static inline void smd_disable_read_intr(smd_channel_t *ch)
 {
 }
 
+static inline int smd_set_write_coalesce(smd_channel_t *ch, unsigned int usecs)
+{
+	return -ENODEV;
+}
+
 static inline int smd_mask_receive_interrupt(smd_channel_t *ch, bool mask,
 		const struct cpumask *cpumask)
 {
@@ -13,6 +13,8 @@
 #ifndef SYSTEM_HEALTH_MONITOR_H
 #define SYSTEM_HEALTH_MONITOR_H
 
+#include <linux/types.h>
+
 #ifdef CONFIG_SYSTEM_HEALTH_MONITOR
 /**
  * kern_check_system_health() - Check the system health
@@ -24,11 +26,42 @@
  * Return: 0 on success, standard Linux error codes on failure.
  */
 int kern_check_system_health(void);
+
+/**
+ * shm_register_stat() - Register a telemetry stat
+ * @name:	Name of the stat as reported to the user-space.
+ * @get:	Callback to read the current value of the stat.
+ * @priv:	Private data passed to @get.
+ *
+ * This function is used by the kernel drivers to export a counter or a
+ * level, such as a queue depth or a drop count, to the periodic telemetry
+ * sampled by SHM.
+ *
+ * Return: Stat id on success, standard Linux error codes on failure.
+ */
+int shm_register_stat(const char *name, uint64_t (*get)(void *priv),
+		      void *priv);
+
+/**
+ * shm_unregister_stat() - Unregister a telemetry stat
+ * @id:		Stat id returned by shm_register_stat().
+ */
+void shm_unregister_stat(int id);
 #else
 static inline int kern_check_system_health(void)
 {
 	return -ENODEV;
 }
+
+static inline int shm_register_stat(const char *name,
+				    uint64_t (*get)(void *priv), void *priv)
+{
+	return -ENODEV;
+}
+
+static inline void shm_unregister_stat(int id)
+{
+}
 #endif /* CONFIG_SYSTEM_HEALTH_MONITOR */
 
 #endif /* SYSTEM_HEALTH_MONITOR_H */
@@ -0,0 +1,42 @@
+/* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _UAPI_MSM_KGSL_SCHED_H
+#define _UAPI_MSM_KGSL_SCHED_H
+
+#include <linux/types.h>
+
+/*
+ * Scheduling hints for a draw context, set through KGSL_PROP_PWR_CONSTRAINT
+ * with struct kgsl_device_constraint.type = KGSL_CONSTRAINT_SCHED and
+ * .data pointing to a struct kgsl_device_constraint_sched.
+ */
+#define KGSL_CONSTRAINT_SCHED		0x10
+
+/* Range and default of the per-context GPU time share weight */
+#define KGSL_SCHED_WEIGHT_MIN		1
+#define KGSL_SCHED_WEIGHT_DEFAULT	4
+#define KGSL_SCHED_WEIGHT_MAX		16
+
+/**
+ * struct kgsl_device_constraint_sched - draw context scheduling hints
+ * @weight: Share of GPU time relative to the other contexts of the same
+ * priority, KGSL_SCHED_WEIGHT_MIN to KGSL_SCHED_WEIGHT_MAX, 0 for the default
+ * @deadline_us: Time in microseconds within which queued commands should
+ * start executing (e.g. the frame period of a compositor), 0 for none
+ */
+struct kgsl_device_constraint_sched {
+	__u32 weight;
+	__u32 deadline_us;
+};
+
+#endif /* _UAPI_MSM_KGSL_SCHED_H */
@@ -0,0 +1,74 @@
+/* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _UAPI_MSM_KGSL_SUBMIT_H
+#define _UAPI_MSM_KGSL_SUBMIT_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+#include <linux/msm_kgsl.h>
+
+/* Maximum number of command batches in one IOCTL_KGSL_SUBMIT_BATCH */
+#define KGSL_SUBMIT_BATCH_MAX		16
+
+/* Return a sync fence for the timestamp of the command batch in fence_fd */
+#define KGSL_SUBMIT_BATCH_FENCE		0x00000001
+
+/**
+ * struct kgsl_submit_batch_entry - one command batch of a submission
+ * @context_id: KGSL context the commands are for
+ * @flags: KGSL_CMDBATCH_* flags, as for IOCTL_KGSL_SUBMIT_COMMANDS
+ * @cmdlist: User pointer to an array of struct kgsl_ibdesc
+ * @numcmds: Number of entries in @cmdlist
+ * @numsyncs: Number of entries in @synclist
+ * @synclist: User pointer to an array of struct kgsl_cmd_syncpoint
+ * @timestamp: In: requested timestamp for user generated timestamp
+ * contexts. Out: timestamp assigned to the command batch
+ * @request: KGSL_SUBMIT_BATCH_* requests for the command batch
+ * @result: Out: 0 or the error IOCTL_KGSL_SUBMIT_COMMANDS would have
+ * returned for this command batch, -EPROTO included
+ * @fence_fd: Out: fence for @timestamp if KGSL_SUBMIT_BATCH_FENCE was
+ * requested and the command batch was queued, -1 otherwise
+ */
+struct kgsl_submit_batch_entry {
+	__u32 context_id;
+	__u32 flags;
+	__u64 cmdlist;
+	__u32 numcmds;
+	__u32 numsyncs;
+	__u64 synclist;
+	__u32 timestamp;
+	__u32 request;
+	__s32 result;
+	__s32 fence_fd;
+};
+
+/**
+ * struct kgsl_submit_batch - argument to IOCTL_KGSL_SUBMIT_BATCH
+ * @entries: User pointer to an array of struct kgsl_submit_batch_entry
+ * @count: Number of entries, at most KGSL_SUBMIT_BATCH_MAX
+ * @submitted: Out: number of entries processed
+ *
+ * The entries are queued in order and processing stops at the first
+ * entry that fails with anything but -EPROTO, whose error the ioctl then
+ * returns. The layout is the same for 32 and 64 bit callers.
+ */
+struct kgsl_submit_batch {
+	__u64 entries;
+	__u32 count;
+	__u32 submitted;
+};
+
+#define IOCTL_KGSL_SUBMIT_BATCH \
+	_IOWR(KGSL_IOC_TYPE, 0x60, struct kgsl_submit_batch)
+
+#endif /* _UAPI_MSM_KGSL_SUBMIT_H */
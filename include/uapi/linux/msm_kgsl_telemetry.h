@@ -0,0 +1,81 @@
+/* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _UAPI_MSM_KGSL_TELEMETRY_H
+#define _UAPI_MSM_KGSL_TELEMETRY_H
+
+#include <linux/types.h>
+
+/*
+ * Layout of the sampled GPU telemetry buffer, mapped read only through
+ * /sys/class/kgsl/kgsl-3d0/telemetry/ring.
+ *
+ * The buffer holds one ring of KGSL_TELEMETRY_RING_SIZE bytes per possible
+ * CPU, the ring of CPU n starting at n * KGSL_TELEMETRY_RING_SIZE. Each ring
+ * starts with a struct kgsl_telemetry_ring_header followed by num_records
+ * struct kgsl_telemetry_record. Record number i of a ring lives in slot
+ * i % num_records and head is the number of records written so far.
+ *
+ * A reader copies a record and then reads head again: the copy is valid if
+ * head has not moved num_records or more past the record number meanwhile.
+ */
+
+#define KGSL_TELEMETRY_VERSION		1
+#define KGSL_TELEMETRY_RING_SIZE	(64 * 1024)
+#define KGSL_TELEMETRY_MAX_COUNTERS	4
+
+/**
+ * struct kgsl_telemetry_ring_header - header of a per-CPU ring
+ * @version: KGSL_TELEMETRY_VERSION
+ * @record_size: sizeof(struct kgsl_telemetry_record)
+ * @num_records: Number of record slots in the ring
+ * @cpu: CPU the ring belongs to
+ * @head: Number of records written to the ring so far
+ */
+struct kgsl_telemetry_ring_header {
+	__u32 version;
+	__u32 record_size;
+	__u32 num_records;
+	__u32 cpu;
+	__u32 head;
+	__u32 __pad[11];
+};
+
+/**
+ * struct kgsl_telemetry_record - one sampled command batch retirement
+ * @time: local clock at retirement, in ns
+ * @busy: Time the command batch occupied the GPU, in ns
+ * @context_busy: Total GPU time of the context so far, in ns
+ * @queue_latency: Time from queueing to submission to the ringbuffer, in ns
+ * @retire_latency: Time from submission to retirement, in ns
+ * @context_id: KGSL context id
+ * @timestamp: Timestamp of the command batch
+ * @pid: Process owning the context
+ * @retired: Command batches retired since the previous record, this one
+ * included
+ * @counters: Deltas of the selected performance counters since the previous
+ * record, in the order of the telemetry/counters attribute
+ */
+struct kgsl_telemetry_record {
+	__u64 time;
+	__u64 busy;
+	__u64 context_busy;
+	__u64 queue_latency;
+	__u64 retire_latency;
+	__u32 context_id;
+	__u32 timestamp;
+	__u32 pid;
+	__u32 retired;
+	__u64 counters[KGSL_TELEMETRY_MAX_COUNTERS];
+};
+
+#endif /* _UAPI_MSM_KGSL_TELEMETRY_H */
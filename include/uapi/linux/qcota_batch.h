@@ -0,0 +1,105 @@
+/* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _UAPI_QCOTA_BATCH_H
+#define _UAPI_QCOTA_BATCH_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+#include <linux/qcota.h>
+
+/*
+ * Asynchronous batch interface of the qcota device.
+ *
+ * QCOTA_BATCH_SUBMIT_REQ queues a number of F8/F9 operations and returns
+ * without waiting for them. Completed operations are collected on the
+ * file handle and retrieved with QCOTA_BATCH_REAP_REQ, which copies the
+ * F8 output to the data_out buffer given at submission and fills one
+ * completion entry per operation. The handle is readable (poll) while
+ * completions are pending. The data_out buffers must stay valid until
+ * the corresponding completion has been reaped.
+ */
+
+/* Maximum number of submitted but not yet reaped operations per handle */
+#define QCOTA_BATCH_MAX_OUTSTANDING	1024
+
+enum qcota_batch_op_type {
+	QCOTA_BATCH_OP_F8 = 0,
+	QCOTA_BATCH_OP_F9 = 1,
+	QCOTA_BATCH_OP_LAST
+};
+
+/**
+ * struct qcota_batch_op - one operation of a batch
+ * @user_data:	opaque value, returned in the completion
+ * @type:	enum qcota_batch_op_type
+ * @f8_req:	F8 request, for QCOTA_BATCH_OP_F8
+ * @f9_req:	F9 request, for QCOTA_BATCH_OP_F9
+ */
+struct qcota_batch_op {
+	__u64	user_data;
+	__u32	type;
+	__u32	reserved;
+	union {
+		struct qce_f8_req f8_req;
+		struct qce_f9_req f9_req;
+	};
+};
+
+/**
+ * struct qcota_batch_submit - QCOTA_BATCH_SUBMIT_REQ argument
+ * @ops:		array of operations
+ * @num_ops:		number of entries in @ops
+ * @num_submitted:	out, number of operations queued. Queuing stops at
+ *			the first invalid operation or when the handle has
+ *			QCOTA_BATCH_MAX_OUTSTANDING operations outstanding;
+ *			the ioctl only fails if nothing was queued.
+ */
+struct qcota_batch_submit {
+	struct qcota_batch_op	*ops;
+	__u32			num_ops;
+	__u32			num_submitted;
+};
+
+/**
+ * struct qcota_batch_completion - result of one operation
+ * @user_data:	value given at submission
+ * @status:	0 on success, negative errno otherwise
+ * @mac_i:	F9 message authentication code
+ */
+struct qcota_batch_completion {
+	__u64	user_data;
+	__s32	status;
+	__u32	mac_i;
+};
+
+/**
+ * struct qcota_batch_reap - QCOTA_BATCH_REAP_REQ argument
+ * @completions:	array receiving the completions
+ * @max_completions:	number of entries in @completions
+ * @min_completions:	block until at least this many operations are
+ *			complete, capped to the outstanding operations
+ * @num_completions:	out, number of entries filled in
+ */
+struct qcota_batch_reap {
+	struct qcota_batch_completion	*completions;
+	__u32				max_completions;
+	__u32				min_completions;
+	__u32				num_completions;
+};
+
+#define QCOTA_BATCH_SUBMIT_REQ \
+	_IOWR(QCOTA_IOC_MAGIC, 5, struct qcota_batch_submit)
+#define QCOTA_BATCH_REAP_REQ \
+	_IOWR(QCOTA_IOC_MAGIC, 6, struct qcota_batch_reap)
+
+#endif /* _UAPI_QCOTA_BATCH_H */
@@ -76,6 +76,7 @@
 #include <linux/elevator.h>
 #include <linux/sched_clock.h>
 #include <linux/random.h>
+#include <soc/qcom/boot_stats.h>
 
 #include <asm/io.h>
 #include <asm/bugs.h>
@@ -675,10 +676,30 @@ static int __init_or_module do_one_initcall_debug(initcall_t fn)
 	duration = (unsigned long long) ktime_to_ns(delta) >> 10;
 	pr_debug("initcall %pF returned %d after %lld usecs\n",
 		 fn, ret, duration);
+	boot_stats_initcall(fn, delta);
 
 	return ret;
 }
 
+#ifdef CONFIG_MSM_BOOT_STATS
+static int __init_or_module do_one_initcall_timed(initcall_t fn)
+{
+	ktime_t calltime;
+	int ret;
+
+	calltime = ktime_get();
+	ret = fn();
+	boot_stats_initcall(fn, ktime_sub(ktime_get(), calltime));
+
+	return ret;
+}
+#else
+static inline int do_one_initcall_timed(initcall_t fn)
+{
+	return fn();
+}
+#endif
+
 int __init_or_module do_one_initcall(initcall_t fn)
 {
 	int count = preempt_count();
@@ -687,7 +708,7 @@ int __init_or_module do_one_initcall(initcall_t fn)
 	if (initcall_debug)
 		ret = do_one_initcall_debug(fn);
 	else
-		ret = fn();
+		ret = do_one_initcall_timed(fn);
 
 	msgbuf[0] = 0;
 
@@ -911,4 +932,7 @@ static noinline void __init kernel_init_freeable(void)
 
 	/* rootfs is available now, try loading default modules */
 	load_default_modules();
+
+	/* and probe the devices that were not needed to get here */
+	driver_async_probe_start();
 }
@@ -1390,8 +1390,12 @@ heavy_task_wakeup(struct task_struct *p, struct rq *rq, int event)
 {
 	u32 task_demand = p->ravg.demand;
 
-	if (!sched_heavy_task || event != TASK_WAKE ||
-	    task_demand < sched_heavy_task || exiting_task(p))
+	if (event != TASK_WAKE || exiting_task(p))
+		return 0;
+
+	/* placement boosted tasks count as heavy whatever their demand */
+	if (!sched_task_boosted(p) &&
+	    (!sched_heavy_task || task_demand < sched_heavy_task))
 		return 0;
 
 	if (p->ravg.mark_start > rq->window_start)
@@ -3190,7 +3194,7 @@ out:
 	if (!same_freq_domain(src_cpu, cpu)) {
 		check_for_freq_change(cpu_rq(cpu));
 		check_for_freq_change(cpu_rq(src_cpu));
-	} else if (heavy_task)
+	} else if (heavy_task || (success && sched_task_boosted(p)))
 		check_for_freq_change(cpu_rq(cpu));
 
 	return success;
@@ -4431,6 +4435,7 @@ void scheduler_tick(void)
 	int cpu = smp_processor_id();
 	struct rq *rq = cpu_rq(cpu);
 	struct task_struct *curr = rq->curr;
+	u64 wallclock;
 
 	sched_clock_tick();
 
@@ -4439,7 +4444,8 @@ void scheduler_tick(void)
 	update_rq_clock(rq);
 	update_cpu_load_active(rq);
 	curr->sched_class->task_tick(rq, curr, 0);
-	update_task_ravg(rq->curr, rq, TASK_UPDATE, sched_clock(), 0);
+	wallclock = sched_clock();
+	update_task_ravg(rq->curr, rq, TASK_UPDATE, wallclock, 0);
 	raw_spin_unlock(&rq->lock);
 
 	perf_event_task_tick();
@@ -4451,6 +4457,7 @@ void scheduler_tick(void)
 	rq_last_tick_reset(rq);
 	if (curr->sched_class == &fair_sched_class)
 		check_for_migration(rq, curr);
+	core_ctl_check(wallclock);
 }
 
 #ifdef CONFIG_NO_HZ_FULL
@@ -9798,6 +9805,28 @@ static int cpu_notify_on_migrate_write_u64(struct cgroup *cgrp,
 	return 0;
 }
 
+#ifdef CONFIG_SCHED_HMP
+static u64 cpu_sched_boost_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+
+	return tg->sched_boost;
+}
+
+static int cpu_sched_boost_write_u64(struct cgroup *cgrp, struct cftype *cft,
+				     u64 boost)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+
+	if (boost > 1)
+		return -EINVAL;
+
+	tg->sched_boost = boost;
+
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 static int cpu_shares_write_u64(struct cgroup *cgrp, struct cftype *cftype,
 				u64 shareval)
@@ -10081,6 +10110,13 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_notify_on_migrate_read_u64,
 		.write_u64 = cpu_notify_on_migrate_write_u64,
 	},
+#ifdef CONFIG_SCHED_HMP
+	{
+		.name = "sched_boost",
+		.read_u64 = cpu_sched_boost_read_u64,
+		.write_u64 = cpu_sched_boost_write_u64,
+	},
+#endif
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
 		.name = "shares",
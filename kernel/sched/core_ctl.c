@@ -0,0 +1,630 @@
+/* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Core control: bring the cpus of each cluster online or offline from the
+ * load the scheduler tracks in its windows.
+ *
+ * At every window rollover the busy time of each cpu in the previous
+ * window marks it busy or not (with separate up and down thresholds), and
+ * the number of cpus a cluster needs is derived from its busy cpus, the
+ * big tasks waiting for a big cluster and the average number of runnable
+ * tasks.  The evaluation runs from the scheduler tick; cpus are then
+ * hotplugged by one kthread per cluster.  A cluster needing fewer cpus
+ * only shrinks once the need has stayed lower for offline_delay_ms.
+ *
+ * Tunables live in /sys/devices/system/cpu/cpuN/core_ctl/ of the first
+ * cpu of each cluster.  By default min_cpus is the size of the cluster,
+ * so no cpu is taken offline until userspace lowers it.
+ */
+
+#include <linux/init.h>
+#include <linux/notifier.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/sched/rt.h>
+#include <linux/topology.h>
+#include <linux/slab.h>
+
+#include <trace/events/power.h>
+
+#include "sched.h"
+
+#define MAX_CLUSTERS		2
+
+#define DEFAULT_BUSY_UP_THRES	60
+#define DEFAULT_BUSY_DOWN_THRES	30
+#define DEFAULT_OFFLINE_DELAY_MS	100
+
+struct cluster_data {
+	bool inited;
+	unsigned int first_cpu;
+	unsigned int num_cpus;
+	cpumask_t cpu_mask;
+	unsigned int min_cpus;
+	unsigned int max_cpus;
+	unsigned int busy_up_thres;
+	unsigned int busy_down_thres;
+	unsigned int offline_delay_ms;
+	/* Count big tasks towards the need of this cluster */
+	bool is_big_cluster;
+	unsigned int active_cpus;
+	unsigned int need_cpus;
+	s64 need_ts;
+	bool pending;
+	spinlock_t pending_lock;
+	struct task_struct *hotplug_thread;
+	struct kobject kobj;
+};
+
+struct cpu_data {
+	bool is_busy;
+	unsigned int busy;
+	struct cluster_data *cluster;
+};
+
+static DEFINE_PER_CPU(struct cpu_data, cpu_state);
+static struct cluster_data cluster_state[MAX_CLUSTERS];
+static unsigned int num_clusters;
+
+static DEFINE_SPINLOCK(state_lock);
+static u64 last_eval_ts;
+static bool initialized;
+
+/* ========================= sysfs interface =========================== */
+
+static ssize_t store_min_cpus(struct cluster_data *state,
+				const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u\n", &val) != 1)
+		return -EINVAL;
+
+	state->min_cpus = min(val, state->max_cpus);
+
+	return count;
+}
+
+static ssize_t show_min_cpus(struct cluster_data *state, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", state->min_cpus);
+}
+
+static ssize_t store_max_cpus(struct cluster_data *state,
+				const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u\n", &val) != 1)
+		return -EINVAL;
+
+	val = min(val, state->num_cpus);
+	state->max_cpus = val;
+	state->min_cpus = min(state->min_cpus, state->max_cpus);
+
+	return count;
+}
+
+static ssize_t show_max_cpus(struct cluster_data *state, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", state->max_cpus);
+}
+
+static ssize_t store_busy_up_thres(struct cluster_data *state,
+				const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u\n", &val) != 1 || val > 100)
+		return -EINVAL;
+
+	state->busy_up_thres = val;
+
+	return count;
+}
+
+static ssize_t show_busy_up_thres(struct cluster_data *state, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", state->busy_up_thres);
+}
+
+static ssize_t store_busy_down_thres(struct cluster_data *state,
+				const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u\n", &val) != 1 || val > 100)
+		return -EINVAL;
+
+	state->busy_down_thres = val;
+
+	return count;
+}
+
+static ssize_t show_busy_down_thres(struct cluster_data *state, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", state->busy_down_thres);
+}
+
+static ssize_t store_offline_delay_ms(struct cluster_data *state,
+				const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u\n", &val) != 1)
+		return -EINVAL;
+
+	state->offline_delay_ms = val;
+
+	return count;
+}
+
+static ssize_t show_offline_delay_ms(struct cluster_data *state, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", state->offline_delay_ms);
+}
+
+static ssize_t store_is_big_cluster(struct cluster_data *state,
+				const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u\n", &val) != 1)
+		return -EINVAL;
+
+	state->is_big_cluster = !!val;
+
+	return count;
+}
+
+static ssize_t show_is_big_cluster(struct cluster_data *state, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", state->is_big_cluster);
+}
+
+static ssize_t show_need_cpus(struct cluster_data *state, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", state->need_cpus);
+}
+
+static ssize_t show_active_cpus(struct cluster_data *state, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", state->active_cpus);
+}
+
+static ssize_t show_global_state(struct cluster_data *state, char *buf)
+{
+	struct cpu_data *c;
+	unsigned int cpu;
+	ssize_t count = 0;
+
+	for_each_cpu(cpu, &state->cpu_mask) {
+		c = &per_cpu(cpu_state, cpu);
+		count += snprintf(buf + count, PAGE_SIZE - count,
+				  "CPU%u\tonline: %u\tbusy: %u\tis_busy: %u\n",
+				  cpu, cpu_online(cpu), c->busy, c->is_busy);
+	}
+
+	return count;
+}
+
+struct core_ctl_attr {
+	struct attribute attr;
+	ssize_t (*show)(struct cluster_data *, char *);
+	ssize_t (*store)(struct cluster_data *, const char *, size_t count);
+};
+
+#define core_ctl_attr_ro(_name)		\
+static struct core_ctl_attr _name =	\
+__ATTR(_name, 0444, show_##_name, NULL)
+
+#define core_ctl_attr_rw(_name)			\
+static struct core_ctl_attr _name =		\
+__ATTR(_name, 0644, show_##_name, store_##_name)
+
+core_ctl_attr_rw(min_cpus);
+core_ctl_attr_rw(max_cpus);
+core_ctl_attr_rw(busy_up_thres);
+core_ctl_attr_rw(busy_down_thres);
+core_ctl_attr_rw(offline_delay_ms);
+core_ctl_attr_rw(is_big_cluster);
+core_ctl_attr_ro(need_cpus);
+core_ctl_attr_ro(active_cpus);
+core_ctl_attr_ro(global_state);
+
+static struct attribute *default_attrs[] = {
+	&min_cpus.attr,
+	&max_cpus.attr,
+	&busy_up_thres.attr,
+	&busy_down_thres.attr,
+	&offline_delay_ms.attr,
+	&is_big_cluster.attr,
+	&need_cpus.attr,
+	&active_cpus.attr,
+	&global_state.attr,
+	NULL
+};
+
+#define to_cluster_data(k) container_of(k, struct cluster_data, kobj)
+#define to_attr(a) container_of(a, struct core_ctl_attr, attr)
+
+static ssize_t show(struct kobject *kobj, struct attribute *attr, char *buf)
+{
+	struct cluster_data *data = to_cluster_data(kobj);
+	struct core_ctl_attr *cattr = to_attr(attr);
+	ssize_t ret = -EIO;
+
+	if (cattr->show)
+		ret = cattr->show(data, buf);
+
+	return ret;
+}
+
+static ssize_t store(struct kobject *kobj, struct attribute *attr,
+		     const char *buf, size_t count)
+{
+	struct cluster_data *data = to_cluster_data(kobj);
+	struct core_ctl_attr *cattr = to_attr(attr);
+	ssize_t ret = -EIO;
+
+	if (cattr->store)
+		ret = cattr->store(data, buf, count);
+
+	return ret;
+}
+
+static const struct sysfs_ops sysfs_ops = {
+	.show	= show,
+	.store	= store,
+};
+
+static struct kobj_type ktype_core_ctl = {
+	.sysfs_ops	= &sysfs_ops,
+	.default_attrs	= default_attrs,
+};
+
+/* ==================== load based need evaluation ==================== */
+
+static unsigned int get_active_cpu_count(struct cluster_data *cluster)
+{
+	cpumask_t online;
+
+	cpumask_and(&online, &cluster->cpu_mask, cpu_online_mask);
+	return cpumask_weight(&online);
+}
+
+/* Busy time of @cpu in the previous window, in percent of the window */
+static unsigned int cpu_busy_pct(int cpu)
+{
+	u64 busy = cpu_rq(cpu)->prev_runnable_sum * 100;
+
+	do_div(busy, sched_ravg_window);
+	return min_t(u64, busy, 100);
+}
+
+static void update_cpu_busy(struct cluster_data *cluster)
+{
+	unsigned int cpu;
+
+	for_each_cpu(cpu, &cluster->cpu_mask) {
+		struct cpu_data *c = &per_cpu(cpu_state, cpu);
+		bool old_is_busy = c->is_busy;
+
+		if (!cpu_online(cpu)) {
+			c->busy = 0;
+			c->is_busy = false;
+			continue;
+		}
+
+		c->busy = cpu_busy_pct(cpu);
+		if (c->is_busy)
+			c->is_busy = c->busy >= cluster->busy_down_thres;
+		else
+			c->is_busy = c->busy >= cluster->busy_up_thres;
+
+		trace_core_ctl_set_busy(cpu, c->busy, old_is_busy, c->is_busy);
+	}
+}
+
+static unsigned int apply_limits(struct cluster_data *cluster,
+				 unsigned int need)
+{
+	return clamp(need, cluster->min_cpus, cluster->max_cpus);
+}
+
+/*
+ * Called with state_lock held.  Returns true if the hotplug thread of the
+ * cluster has work to do.
+ */
+static bool eval_need(struct cluster_data *cluster, unsigned int nr_big,
+		      unsigned int nr_waiting, s64 now)
+{
+	unsigned int cpu, need = 0, old_need = cluster->need_cpus;
+	bool updated = false;
+
+	for_each_cpu(cpu, &cluster->cpu_mask)
+		need += per_cpu(cpu_state, cpu).is_busy;
+
+	if (cluster->is_big_cluster)
+		need = max(need, nr_big);
+	else
+		need += nr_waiting;
+
+	need = apply_limits(cluster, need);
+	cluster->active_cpus = get_active_cpu_count(cluster);
+
+	if (need > old_need) {
+		updated = true;
+	} else if (need < old_need) {
+		/* only shrink once the lower need has held long enough */
+		updated = now - cluster->need_ts >=
+				cluster->offline_delay_ms;
+	} else {
+		cluster->need_ts = now;
+	}
+
+	if (updated) {
+		cluster->need_cpus = need;
+		cluster->need_ts = now;
+	}
+
+	trace_core_ctl_eval_need(cluster->first_cpu, old_need, need, updated);
+
+	return updated || cluster->need_cpus != cluster->active_cpus;
+}
+
+static void wake_up_hotplug_thread(struct cluster_data *cluster)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&cluster->pending_lock, flags);
+	cluster->pending = true;
+	spin_unlock_irqrestore(&cluster->pending_lock, flags);
+
+	wake_up_process(cluster->hotplug_thread);
+}
+
+/**
+ * core_ctl_check
+ * @wallclock: sched_clock() of the caller
+ *
+ * Re-evaluate the cpus each cluster needs once per scheduler window,
+ * on the first tick after the window rolls over.  Called from the
+ * scheduler tick, without the rq lock held.
+ */
+void core_ctl_check(u64 wallclock)
+{
+	unsigned long flags;
+	int avg, iowait_avg, big_avg, i;
+	unsigned int nr_big, nr_waiting = 0, total_active = 0;
+	bool wakeup[MAX_CLUSTERS] = { false };
+	s64 now;
+
+	if (unlikely(!initialized))
+		return;
+
+	spin_lock_irqsave(&state_lock, flags);
+	if (wallclock - last_eval_ts < sched_ravg_window) {
+		spin_unlock_irqrestore(&state_lock, flags);
+		return;
+	}
+	last_eval_ts = wallclock;
+
+	/* average runnable tasks * 100, since the previous evaluation */
+	sched_get_nr_running_avg(&avg, &iowait_avg, &big_avg);
+	nr_big = DIV_ROUND_UP(big_avg, 100);
+	now = ktime_to_ms(ktime_get());
+
+	for (i = 0; i < num_clusters; i++) {
+		update_cpu_busy(&cluster_state[i]);
+		total_active += get_active_cpu_count(&cluster_state[i]);
+	}
+
+	/* runnable tasks queued behind the online cpus go to the little */
+	if (DIV_ROUND_UP(avg, 100) > total_active)
+		nr_waiting = DIV_ROUND_UP(avg, 100) - total_active;
+
+	for (i = 0; i < num_clusters; i++)
+		if (cluster_state[i].inited)
+			wakeup[i] = eval_need(&cluster_state[i], nr_big,
+					      nr_waiting, now);
+	spin_unlock_irqrestore(&state_lock, flags);
+
+	for (i = 0; i < num_clusters; i++)
+		if (wakeup[i])
+			wake_up_hotplug_thread(&cluster_state[i]);
+}
+
+/* ========================= cpu hotplug ============================== */
+
+static void __ref do_hotplug(struct cluster_data *cluster)
+{
+	unsigned int cpu, need;
+	unsigned long flags;
+
+	spin_lock_irqsave(&state_lock, flags);
+	need = cluster->need_cpus;
+	spin_unlock_irqrestore(&state_lock, flags);
+
+	if (get_active_cpu_count(cluster) > need) {
+		/* Offline idle cpus first, highest numbered first */
+		for (cpu = cluster->first_cpu + cluster->num_cpus - 1;
+		     cpu > cluster->first_cpu; cpu--) {
+			if (get_active_cpu_count(cluster) <= need)
+				break;
+			if (!cpu_online(cpu) || per_cpu(cpu_state, cpu).is_busy)
+				continue;
+			pr_debug("core_ctl: offlining cpu%u\n", cpu);
+			if (cpu_down(cpu))
+				pr_debug("core_ctl: unable to offline cpu%u\n",
+					 cpu);
+		}
+	} else if (get_active_cpu_count(cluster) < need) {
+		for_each_cpu(cpu, &cluster->cpu_mask) {
+			if (get_active_cpu_count(cluster) >= need)
+				break;
+			if (cpu_online(cpu))
+				continue;
+			pr_debug("core_ctl: onlining cpu%u\n", cpu);
+			if (cpu_up(cpu))
+				pr_debug("core_ctl: unable to online cpu%u\n",
+					 cpu);
+		}
+	}
+}
+
+static int try_hotplug(void *data)
+{
+	struct cluster_data *cluster = data;
+	unsigned long flags;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		spin_lock_irqsave(&cluster->pending_lock, flags);
+		if (!cluster->pending) {
+			spin_unlock_irqrestore(&cluster->pending_lock, flags);
+			schedule();
+			if (kthread_should_stop())
+				break;
+			continue;
+		}
+		cluster->pending = false;
+		spin_unlock_irqrestore(&cluster->pending_lock, flags);
+		set_current_state(TASK_RUNNING);
+
+		do_hotplug(cluster);
+	}
+
+	return 0;
+}
+
+static int __ref cpu_callback(struct notifier_block *nfb,
+			      unsigned long action, void *hcpu)
+{
+	unsigned int cpu = (unsigned long)hcpu;
+	struct cpu_data *c = &per_cpu(cpu_state, cpu);
+	unsigned long flags;
+
+	if (!c->cluster || !c->cluster->inited)
+		return NOTIFY_OK;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+	case CPU_DEAD:
+		spin_lock_irqsave(&state_lock, flags);
+		c->is_busy = false;
+		c->busy = 0;
+		c->cluster->active_cpus = get_active_cpu_count(c->cluster);
+		spin_unlock_irqrestore(&state_lock, flags);
+		break;
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block __refdata cpu_notifier = {
+	.notifier_call = cpu_callback,
+};
+
+/* ============================ init code ============================== */
+
+static struct cluster_data *find_cluster(unsigned int cpu)
+{
+	int id = topology_physical_package_id(cpu);
+	unsigned int i;
+
+	for (i = 0; i < num_clusters; i++)
+		if (topology_physical_package_id(cluster_state[i].first_cpu)
+		    == id)
+			return &cluster_state[i];
+
+	return NULL;
+}
+
+static int cluster_init(struct cluster_data *cluster)
+{
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO - 1 };
+	struct device *dev;
+	int ret;
+
+	dev = get_cpu_device(cluster->first_cpu);
+	if (!dev)
+		return -ENODEV;
+
+	cluster->num_cpus = cpumask_weight(&cluster->cpu_mask);
+	cluster->max_cpus = cluster->num_cpus;
+	cluster->min_cpus = cluster->num_cpus;
+	cluster->need_cpus = cluster->num_cpus;
+	cluster->busy_up_thres = DEFAULT_BUSY_UP_THRES;
+	cluster->busy_down_thres = DEFAULT_BUSY_DOWN_THRES;
+	cluster->offline_delay_ms = DEFAULT_OFFLINE_DELAY_MS;
+	cluster->is_big_cluster = cpu_rq(cluster->first_cpu)->
+					max_possible_capacity ==
+					max_possible_capacity;
+	cluster->active_cpus = get_active_cpu_count(cluster);
+	spin_lock_init(&cluster->pending_lock);
+
+	cluster->hotplug_thread = kthread_run(try_hotplug, cluster,
+					      "core_ctl/%u",
+					      cluster->first_cpu);
+	if (IS_ERR(cluster->hotplug_thread))
+		return PTR_ERR(cluster->hotplug_thread);
+	sched_setscheduler_nocheck(cluster->hotplug_thread, SCHED_FIFO,
+				   &param);
+
+	ret = kobject_init_and_add(&cluster->kobj, &ktype_core_ctl,
+				   &dev->kobj, "core_ctl");
+	if (ret) {
+		kthread_stop(cluster->hotplug_thread);
+		return ret;
+	}
+
+	cluster->inited = true;
+	return 0;
+}
+
+static int __init core_ctl_init(void)
+{
+	struct cluster_data *cluster;
+	unsigned int cpu, i;
+	int ret;
+
+	for_each_possible_cpu(cpu) {
+		cluster = find_cluster(cpu);
+		if (!cluster) {
+			if (num_clusters == MAX_CLUSTERS) {
+				pr_err("core_ctl: too many clusters\n");
+				return -EINVAL;
+			}
+			cluster = &cluster_state[num_clusters++];
+			cluster->first_cpu = cpu;
+		}
+		cpumask_set_cpu(cpu, &cluster->cpu_mask);
+		per_cpu(cpu_state, cpu).cluster = cluster;
+	}
+
+	for (i = 0; i < num_clusters; i++) {
+		ret = cluster_init(&cluster_state[i]);
+		if (ret)
+			pr_err("core_ctl: cluster of cpu%u init failed: %d\n",
+			       cluster_state[i].first_cpu, ret);
+	}
+
+	register_cpu_notifier(&cpu_notifier);
+	initialized = true;
+
+	return 0;
+}
+late_initcall(core_ctl_init);
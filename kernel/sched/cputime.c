@@ -142,6 +142,7 @@ static inline void task_group_account_field(struct task_struct *p, int index,
 void account_user_time(struct task_struct *p, cputime_t cputime,
 		       cputime_t cputime_scaled)
 {
+	unsigned long long power = p->cpu_power;
 	int index;
 
 	/* Add user time to process. */
@@ -159,6 +160,8 @@ void account_user_time(struct task_struct *p, cputime_t cputime,
 
 	/* Account power usage for user time */
 	acct_update_power(p, cputime);
+
+	uid_cputime_account(p, cputime, 0, p->cpu_power - power);
 }
 
 /*
@@ -199,6 +202,8 @@ static inline
 void __account_system_time(struct task_struct *p, cputime_t cputime,
 			cputime_t cputime_scaled, int index)
 {
+	unsigned long long power = p->cpu_power;
+
 	/* Add system time to process. */
 	p->stime += cputime;
 	p->stimescaled += cputime_scaled;
@@ -212,6 +217,8 @@ void __account_system_time(struct task_struct *p, cputime_t cputime,
 
 	/* Account power usage for system time */
 	acct_update_power(p, cputime);
+
+	uid_cputime_account(p, 0, cputime, p->cpu_power - power);
 }
 
 /*
@@ -1535,6 +1535,43 @@ int sched_set_boost(int enable)
 	return ret;
 }
 
+/*
+ * Placement boost of a single task.  A boosted task is placed as if
+ * sched_boost were on, but only itself: it prefers idle and higher
+ * capacity cpus on wakeup and is up-migrated from the lower capacity
+ * ones, and waking it up re-evaluates the frequency of its cpu.  Tasks
+ * can also be boosted as a group through the cpu cgroup's sched_boost
+ * file.  The hint is not inherited across fork.
+ */
+int sched_set_task_boost(struct task_struct *p, int boost)
+{
+	if (!sched_enable_hmp)
+		return -EINVAL;
+
+	if (boost < 0 || boost > 1)
+		return -EINVAL;
+
+	p->placement_boost = boost;
+
+	return 0;
+}
+
+int sched_get_task_boost(struct task_struct *p)
+{
+	return p->placement_boost;
+}
+
+int sched_task_boosted(struct task_struct *p)
+{
+	return sched_enable_hmp &&
+		(p->placement_boost || task_group_boost(p));
+}
+
+static inline int task_sched_boost(struct task_struct *p)
+{
+	return sched_boost() || sched_task_boosted(p);
+}
+
 int sched_boost_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *lenp,
 		loff_t *ppos)
@@ -1575,7 +1612,7 @@ static int task_load_will_fit(struct task_struct *p, u64 task_load, int cpu)
 	if (rq->capacity == max_capacity)
 		return 1;
 
-	if (sched_boost()) {
+	if (task_sched_boost(p)) {
 		if (rq->capacity > prev_rq->capacity)
 			return 1;
 	} else {
@@ -1908,7 +1945,7 @@ static int select_best_cpu(struct task_struct *p, int target, int reason,
 	u64 tload, cpu_load;
 	u64 min_load = ULLONG_MAX, min_fallback_load = ULLONG_MAX;
 	int small_task = is_small_task(p);
-	int boost = sched_boost();
+	int boost = task_sched_boost(p);
 	int cstate, min_cstate = INT_MAX;
 	int prefer_idle = reason ? 1 : sysctl_sched_prefer_idle;
 
@@ -1925,6 +1962,10 @@ static int select_best_cpu(struct task_struct *p, int target, int reason,
 		small_task = 0;
 	}
 
+	/* So do placement boosted tasks, see sched_set_task_boost() */
+	if (boost && !sched_boost())
+		prefer_idle = 1;
+
 	trace_sched_task_load(p, small_task, boost, reason, sync);
 
 	if (small_task && !boost) {
@@ -2393,7 +2434,7 @@ static inline int migration_needed(struct rq *rq, struct task_struct *p)
 	if (!sched_enable_hmp || p->state != TASK_RUNNING)
 		return 0;
 
-	if (sched_boost()) {
+	if (task_sched_boost(p)) {
 		if (rq->capacity != max_capacity)
 			return MOVE_TO_BIG_CPU;
 
@@ -2543,6 +2584,7 @@ void init_new_task_load(struct task_struct *p)
 	int i;
 
 	memset(&p->ravg, 0, sizeof(struct ravg));
+	p->placement_boost = 0;
 	p->se.avg.decay_count	= 0;
 
 	for (i = 0; i < RAVG_HIST_SIZE_MAX; ++i)
@@ -137,6 +137,7 @@ struct task_group {
 	struct cgroup_subsys_state css;
 
 	bool notify_on_migrate;
+	bool sched_boost;
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* schedulable entities of this group on each cpu */
@@ -825,6 +826,12 @@ static inline int same_freq_domain(int src_cpu, int dst_cpu)
 
 #endif	/* CONFIG_SCHED_FREQ_INPUT */
 
+#ifdef CONFIG_SCHED_CORE_CTL
+extern void core_ctl_check(u64 wallclock);
+#else
+static inline void core_ctl_check(u64 wallclock) { }
+#endif
+
 #ifdef CONFIG_SCHED_HMP
 
 #define	BOOST_KICK	0
@@ -917,6 +924,11 @@ static inline bool task_notify_on_migrate(struct task_struct *p)
 	return task_group(p)->notify_on_migrate;
 }
 
+static inline bool task_group_boost(struct task_struct *p)
+{
+	return task_group(p)->sched_boost;
+}
+
 /* Change a task's cfs_rq and parent entity if it moves across CPUs/groups */
 static inline void set_task_rq(struct task_struct *p, unsigned int cpu)
 {
@@ -946,6 +958,10 @@ static inline bool task_notify_on_migrate(struct task_struct *p)
 {
 	return false;
 }
+static inline bool task_group_boost(struct task_struct *p)
+{
+	return false;
+}
 #endif /* CONFIG_CGROUP_SCHED */
 
 static inline void __set_task_cpu(struct task_struct *p, unsigned int cpu)
@@ -18,64 +18,136 @@
 #include <linux/hrtimer.h>
 #include <linux/sched.h>
 #include <linux/math64.h>
+#include <linux/seqlock.h>
 
-static DEFINE_PER_CPU(u64, nr_prod_sum);
-static DEFINE_PER_CPU(u64, last_time);
-static DEFINE_PER_CPU(u64, nr);
-static DEFINE_PER_CPU(unsigned long, iowait_prod_sum);
-static DEFINE_PER_CPU(spinlock_t, nr_lock) = __SPIN_LOCK_UNLOCKED(nr_lock);
+#include "sched.h"
+
+/*
+ * Per-cpu time integrals of nr_running, nr_iowait and the number of big
+ * tasks.  They only ever grow, and are written by sched_update_nr_prod()
+ * under the rq lock of the cpu, so the seqcount is all readers need to
+ * get a consistent snapshot: the enqueue/dequeue path takes no extra
+ * lock for them.
+ */
+struct nr_stats {
+	seqcount_t seq;
+	u64 nr_prod_sum;
+	u64 iowait_prod_sum;
+	u64 big_prod_sum;
+	u64 last_time;
+	unsigned long nr;
+	unsigned long nr_iowait;
+	unsigned long nr_big;
+};
+
+static DEFINE_PER_CPU(struct nr_stats, nr_stats);
+
+/* Integrals at the previous poll, and per-cpu averages it computed */
+static DEFINE_PER_CPU(u64, last_nr_prod_sum);
+static DEFINE_PER_CPU(u64, last_iowait_prod_sum);
+static DEFINE_PER_CPU(u64, last_big_prod_sum);
+static DEFINE_PER_CPU(unsigned int, cpu_nr_avg);
 static s64 last_get_time;
 
+#ifdef CONFIG_SCHED_HMP
+static inline unsigned long cpu_nr_big_tasks(int cpu)
+{
+	return cpu_rq(cpu)->nr_big_tasks;
+}
+#else
+static inline unsigned long cpu_nr_big_tasks(int cpu)
+{
+	return 0;
+}
+#endif
+
+/* Read the integrals of @cpu extended up to @curr_time */
+static void read_nr_stats(int cpu, u64 curr_time, u64 *nr_sum,
+			  u64 *iowait_sum, u64 *big_sum)
+{
+	struct nr_stats *stats = &per_cpu(nr_stats, cpu);
+	unsigned int seq;
+	u64 delta;
+
+	do {
+		seq = read_seqcount_begin(&stats->seq);
+		delta = curr_time > stats->last_time ?
+			curr_time - stats->last_time : 0;
+		*nr_sum = stats->nr_prod_sum + stats->nr * delta;
+		*iowait_sum = stats->iowait_prod_sum +
+			      stats->nr_iowait * delta;
+		*big_sum = stats->big_prod_sum + stats->nr_big * delta;
+	} while (read_seqcount_retry(&stats->seq, seq));
+}
+
 /**
  * sched_get_nr_running_avg
- * @return: Average nr_running and iowait value since last poll.
- *	    Returns the avg * 100 to return up to two decimal points
- *	    of accuracy.
+ * @avg: Average nr_running since the last poll
+ * @iowait_avg: Average nr_iowait since the last poll
+ * @big_avg: Average number of big tasks since the last poll
+ *
+ * All the averages are returned * 100, to give up to two decimal points
+ * of accuracy.  The average of each cpu over the same period is kept
+ * for sched_get_cpu_nr_running_avg().
  *
- * Obtains the average nr_running value since the last poll.
  * This function may not be called concurrently with itself
  */
-void sched_get_nr_running_avg(int *avg, int *iowait_avg)
+void sched_get_nr_running_avg(int *avg, int *iowait_avg, int *big_avg)
 {
 	int cpu;
 	u64 curr_time = sched_clock();
 	u64 diff = curr_time - last_get_time;
-	u64 tmp_avg = 0, tmp_iowait = 0;
+	u64 tmp_avg = 0, tmp_iowait = 0, tmp_big = 0;
 
 	*avg = 0;
 	*iowait_avg = 0;
+	*big_avg = 0;
 
 	if (!diff)
 		return;
 
 	last_get_time = curr_time;
-	/* read and reset nr_running counts */
 	for_each_possible_cpu(cpu) {
-		unsigned long flags;
-
-		spin_lock_irqsave(&per_cpu(nr_lock, cpu), flags);
-		tmp_avg += per_cpu(nr_prod_sum, cpu);
-		tmp_avg += per_cpu(nr, cpu) *
-			(curr_time - per_cpu(last_time, cpu));
-		tmp_iowait = per_cpu(iowait_prod_sum, cpu);
-		tmp_iowait +=  nr_iowait_cpu(cpu) *
-			(curr_time - per_cpu(last_time, cpu));
-		per_cpu(last_time, cpu) = curr_time;
-		per_cpu(nr_prod_sum, cpu) = 0;
-		per_cpu(iowait_prod_sum, cpu) = 0;
-		spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
+		u64 nr_sum, iowait_sum, big_sum, cpu_nr;
+
+		read_nr_stats(cpu, curr_time, &nr_sum, &iowait_sum, &big_sum);
+
+		cpu_nr = nr_sum - per_cpu(last_nr_prod_sum, cpu);
+		per_cpu(cpu_nr_avg, cpu) = div64_u64(cpu_nr * 100, diff);
+		tmp_avg += cpu_nr;
+		tmp_iowait += iowait_sum - per_cpu(last_iowait_prod_sum, cpu);
+		tmp_big += big_sum - per_cpu(last_big_prod_sum, cpu);
+
+		per_cpu(last_nr_prod_sum, cpu) = nr_sum;
+		per_cpu(last_iowait_prod_sum, cpu) = iowait_sum;
+		per_cpu(last_big_prod_sum, cpu) = big_sum;
 	}
 
 	*avg = (int)div64_u64(tmp_avg * 100, diff);
 	*iowait_avg = (int)div64_u64(tmp_iowait * 100, diff);
+	*big_avg = (int)div64_u64(tmp_big * 100, diff);
 
 	BUG_ON(*avg < 0);
 	pr_debug("%s - avg:%d\n", __func__, *avg);
 	BUG_ON(*iowait_avg < 0);
 	pr_debug("%s - avg:%d\n", __func__, *iowait_avg);
+	BUG_ON(*big_avg < 0);
+	pr_debug("%s - avg:%d\n", __func__, *big_avg);
 }
 EXPORT_SYMBOL(sched_get_nr_running_avg);
 
+/**
+ * sched_get_cpu_nr_running_avg
+ * @cpu: The cpu to get the average of
+ * @return: Average nr_running of @cpu * 100, over the period of the last
+ *	    sched_get_nr_running_avg() poll
+ */
+unsigned int sched_get_cpu_nr_running_avg(int cpu)
+{
+	return per_cpu(cpu_nr_avg, cpu);
+}
+EXPORT_SYMBOL(sched_get_cpu_nr_running_avg);
+
 /**
  * sched_update_nr_prod
  * @cpu: The core id of the nr running driver.
@@ -83,24 +155,25 @@ EXPORT_SYMBOL(sched_get_nr_running_avg);
  * @inc: Whether we are increasing or decreasing the count
  * @return: N/A
  *
- * Update average with latest nr_running value for CPU
+ * Update average with latest nr_running value for CPU.  Called with the
+ * rq lock of @cpu held, which serialises the writers of its stats.
  */
 void sched_update_nr_prod(int cpu, unsigned long nr_running, bool inc)
 {
-	int diff;
-	s64 curr_time;
-	unsigned long flags;
-
-	spin_lock_irqsave(&per_cpu(nr_lock, cpu), flags);
-	curr_time = sched_clock();
-	diff = curr_time - per_cpu(last_time, cpu);
-	per_cpu(last_time, cpu) = curr_time;
-	per_cpu(nr, cpu) = nr_running + (inc ? 1 : -1);
+	struct nr_stats *stats = &per_cpu(nr_stats, cpu);
+	u64 curr_time = sched_clock();
+	u64 diff = curr_time - stats->last_time;
 
-	BUG_ON(per_cpu(nr, cpu) < 0);
+	write_seqcount_begin(&stats->seq);
+	stats->last_time = curr_time;
+	stats->nr_prod_sum += stats->nr * diff;
+	stats->iowait_prod_sum += stats->nr_iowait * diff;
+	stats->big_prod_sum += stats->nr_big * diff;
 
-	per_cpu(nr_prod_sum, cpu) += nr_running * diff;
-	per_cpu(iowait_prod_sum, cpu) += nr_iowait_cpu(cpu) * diff;
-	spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
+	BUG_ON(!inc && !nr_running);
+	stats->nr = nr_running + (inc ? 1 : -1);
+	stats->nr_iowait = nr_iowait_cpu(cpu);
+	stats->nr_big = cpu_nr_big_tasks(cpu);
+	write_seqcount_end(&stats->seq);
 }
 EXPORT_SYMBOL(sched_update_nr_prod);
@@ -27,12 +27,21 @@
 #include <linux/delay.h>
 #include <linux/completion.h>
 #include <linux/ipc_logging.h>
+#include <asm/sections.h>
 
 #include "ipc_logging_private.h"
 
 #define LOG_PAGE_DATA_SIZE	sizeof(((struct ipc_log_page *)0)->data)
 #define LOG_PAGE_FLAG (1 << 31)
 
+/*
+ * Store ipc_log_string() messages as a format pointer plus binary
+ * arguments and leave the formatting to the debugfs reader. Off by
+ * default since RAM dump parsers only understand formatted strings.
+ */
+static bool defer_format;
+module_param(defer_format, bool, S_IRUGO | S_IWUSR);
+
 static LIST_HEAD(ipc_log_context_list);
 static DEFINE_RWLOCK(context_list_lock_lha1);
 static void *get_deserialization_func(struct ipc_log_context *ilctxt,
@@ -469,6 +478,42 @@ int tsv_byte_array_write(struct encode_context *ectxt,
 }
 EXPORT_SYMBOL(tsv_byte_array_write);
 
+/*
+ * A format can only be decoded later if it outlives the caller (i.e. is
+ * not in a module that may be unloaded) and no %p extension in it would
+ * dereference memory that may be gone by the time the log is read.
+ */
+static bool can_defer_format(const char *fmt)
+{
+	return fmt >= __start_rodata && fmt < __end_rodata &&
+		!strstr(fmt, "%p");
+}
+
+/*
+ * Logs the format pointer and the arguments packed by vbin_printf().
+ *
+ * @returns 0 on success, -E2BIG if the arguments don't fit in a message
+ */
+static int ipc_log_bstring(void *ilctxt, const char *fmt, va_list args)
+{
+	struct encode_context ectxt;
+	u32 bin[MAX_MSG_SIZE / sizeof(u32)];
+	int avail_words, words;
+
+	msg_encode_start(&ectxt, TSV_TYPE_BSTRING);
+	tsv_timestamp_write(&ectxt);
+	tsv_pointer_write(&ectxt, (void *)fmt);
+	avail_words = (MAX_MSG_SIZE - (ectxt.offset +
+		       sizeof(struct tsv_header))) / sizeof(u32);
+	words = vbin_printf(bin, avail_words, fmt, args);
+	if (words > avail_words)
+		return -E2BIG;
+	tsv_byte_array_write(&ectxt, bin, words * sizeof(u32));
+	msg_encode_end(&ectxt);
+	ipc_log_write(ilctxt, &ectxt);
+	return 0;
+}
+
 /*
  * Helper function to log a string
  *
@@ -480,10 +525,19 @@ int ipc_log_string(void *ilctxt, const char *fmt, ...)
 	struct encode_context ectxt;
 	int avail_size, data_size, hdr_size = sizeof(struct tsv_header);
 	va_list arg_list;
+	int ret;
 
 	if (!ilctxt)
 		return -EINVAL;
 
+	if (defer_format && can_defer_format(fmt)) {
+		va_start(arg_list, fmt);
+		ret = ipc_log_bstring(ilctxt, fmt, arg_list);
+		va_end(arg_list);
+		if (!ret)
+			return 0;
+	}
+
 	msg_encode_start(&ectxt, TSV_TYPE_STRING);
 	tsv_timestamp_write(&ectxt);
 	avail_size = (MAX_MSG_SIZE - (ectxt.offset + hdr_size));
@@ -581,6 +635,27 @@ static void tsv_read_header(struct encode_context *ectxt,
 	ectxt->offset += sizeof(*hdr);
 }
 
+/*
+ * Reads a value of the given type without decoding it.
+ *
+ * @ectxt   context initialized by calling msg_read()
+ * @type    expected type of the value
+ * @data    buffer to copy the value to
+ * @size    size of @data
+ *
+ * @returns number of bytes copied to @data
+ */
+int tsv_raw_read(struct encode_context *ectxt, int type,
+		 void *data, int size)
+{
+	struct tsv_header hdr;
+
+	tsv_read_header(ectxt, &hdr);
+	BUG_ON(hdr.type != type || hdr.size > size);
+	tsv_read_data(ectxt, data, hdr.size);
+	return hdr.size;
+}
+
 /*
  * Reads a timestamp.
  *
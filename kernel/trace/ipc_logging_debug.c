@@ -130,13 +130,9 @@ static void debug_create(const char *name, mode_t mode,
 	debugfs_create_file(name, mode, dent, ilctxt, fops);
 }
 
-static void dfunc_string(struct encode_context *ectxt,
-			 struct decode_context *dctxt)
+/* add trailing \n if necessary */
+static void dfunc_end_line(struct decode_context *dctxt)
 {
-	tsv_timestamp_read(ectxt, dctxt, " ");
-	tsv_byte_array_read(ectxt, dctxt, "");
-
-	/* add trailing \n if necessary */
 	if (*(dctxt->buff - 1) != '\n') {
 		if (dctxt->size) {
 			++dctxt->buff;
@@ -146,6 +142,32 @@ static void dfunc_string(struct encode_context *ectxt,
 	}
 }
 
+static void dfunc_string(struct encode_context *ectxt,
+			 struct decode_context *dctxt)
+{
+	tsv_timestamp_read(ectxt, dctxt, " ");
+	tsv_byte_array_read(ectxt, dctxt, "");
+	dfunc_end_line(dctxt);
+}
+
+/* Formats a message logged with its format deferred to read time */
+static void dfunc_bstring(struct encode_context *ectxt,
+			  struct decode_context *dctxt)
+{
+	const char *fmt;
+	u32 bin[MAX_MSG_SIZE / sizeof(u32)];
+	int len;
+
+	tsv_timestamp_read(ectxt, dctxt, " ");
+	tsv_raw_read(ectxt, TSV_TYPE_POINTER, &fmt, sizeof(fmt));
+	tsv_raw_read(ectxt, TSV_TYPE_BYTE_ARRAY, bin, sizeof(bin));
+	len = bstr_printf(dctxt->buff, dctxt->size, fmt, bin);
+	len = min(len, dctxt->size - 1);
+	dctxt->buff += len;
+	dctxt->size -= len;
+	dfunc_end_line(dctxt);
+}
+
 void check_and_create_debugfs(void)
 {
 	mutex_lock(&ipc_log_debugfs_init_lock);
@@ -179,5 +201,7 @@ void create_ctx_debugfs(struct ipc_log_context *ctxt,
 	}
 	add_deserialization_func((void *)ctxt,
 				 TSV_TYPE_STRING, dfunc_string);
+	add_deserialization_func((void *)ctxt,
+				 TSV_TYPE_BSTRING, dfunc_bstring);
 }
 EXPORT_SYMBOL(create_ctx_debugfs);
@@ -146,6 +146,9 @@ enum {
 			((x) < TSV_TYPE_MSG_END))
 #define MAX_MSG_DECODED_SIZE (MAX_MSG_SIZE*4)
 
+int tsv_raw_read(struct encode_context *ectxt, int type,
+		 void *data, int size);
+
 #if (defined(CONFIG_DEBUG_FS))
 void check_and_create_debugfs(void);
 
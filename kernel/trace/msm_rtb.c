@@ -76,13 +76,56 @@ static struct msm_rtb_state msm_rtb = {
 	.enabled = 1,
 };
 
-module_param_named(filter, msm_rtb.filter, uint, 0644);
-module_param_named(enable, msm_rtb.enabled, int, 0644);
+/*
+ * Event types to log, or 0 while RTB is disabled or not set up yet. This
+ * is what the inline uncached_logk() checks on every register access, so
+ * filtered out events never leave the caller.
+ */
+u32 msm_rtb_log_mask __read_mostly;
+EXPORT_SYMBOL(msm_rtb_log_mask);
+
+static void msm_rtb_update_mask(void)
+{
+	msm_rtb_log_mask = (msm_rtb.initialized && msm_rtb.enabled) ?
+				msm_rtb.filter : 0;
+}
+
+static int msm_rtb_set_filter(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	if (!ret)
+		msm_rtb_update_mask();
+	return ret;
+}
+
+static const struct kernel_param_ops msm_rtb_filter_ops = {
+	.set = msm_rtb_set_filter,
+	.get = param_get_uint,
+};
+
+static int msm_rtb_set_enable(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_int(val, kp);
+
+	if (!ret)
+		msm_rtb_update_mask();
+	return ret;
+}
+
+static const struct kernel_param_ops msm_rtb_enable_ops = {
+	.set = msm_rtb_set_enable,
+	.get = param_get_int,
+};
+
+module_param_cb(filter, &msm_rtb_filter_ops, &msm_rtb.filter, 0644);
+module_param_cb(enable, &msm_rtb_enable_ops, &msm_rtb.enabled, 0644);
 
 static int msm_rtb_panic_notifier(struct notifier_block *this,
 					unsigned long event, void *ptr)
 {
 	msm_rtb.enabled = 0;
+	msm_rtb_update_mask();
 	return NOTIFY_DONE;
 }
 
@@ -224,11 +267,11 @@ int notrace uncached_logk_pc(enum logk_event_type log_type, void *caller,
 }
 EXPORT_SYMBOL(uncached_logk_pc);
 
-noinline int notrace uncached_logk(enum logk_event_type log_type, void *data)
+noinline int notrace __uncached_logk(enum logk_event_type log_type, void *data)
 {
 	return uncached_logk_pc(log_type, __builtin_return_address(0), data);
 }
-EXPORT_SYMBOL(uncached_logk);
+EXPORT_SYMBOL(__uncached_logk);
 
 static int msm_rtb_probe(struct platform_device *pdev)
 {
@@ -299,6 +342,7 @@ static int msm_rtb_probe(struct platform_device *pdev)
 	atomic_notifier_chain_register(&panic_notifier_list,
 						&msm_rtb_panic_blk);
 	msm_rtb.initialized = 1;
+	msm_rtb_update_mask();
 	return 0;
 }
 
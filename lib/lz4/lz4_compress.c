@@ -0,0 +1,152 @@
+/*
+ * LZ4 - Fast LZ compression algorithm
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Greedy single hash compressor producing the LZ4 block format.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/bitops.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+static inline u32 lz4_hash(u32 seq)
+{
+	return (seq * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/* Number of bytes of ip matching ref, not looking at limit and past */
+static inline size_t lz4_count(const u8 *ip, const u8 *ref, const u8 *limit)
+{
+	const u8 *start = ip;
+
+	while (ip + sizeof(unsigned long) <= limit) {
+		unsigned long diff = get_unaligned((const unsigned long *)ip) ^
+			get_unaligned((const unsigned long *)ref);
+
+		if (!diff) {
+			ip += sizeof(unsigned long);
+			ref += sizeof(unsigned long);
+			continue;
+		}
+#ifdef __LITTLE_ENDIAN
+		ip += __ffs(diff) >> 3;
+#else
+		ip += (BITS_PER_LONG - 1 - __fls(diff)) >> 3;
+#endif
+		return ip - start;
+	}
+
+	while (ip < limit && *ip == *ref) {
+		ip++;
+		ref++;
+	}
+
+	return ip - start;
+}
+
+/* Write the part of a length that does not fit in the token */
+static inline u8 *lz4_write_length(u8 *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+
+	return op;
+}
+
+/* Write the token and the literals of a sequence, return the token */
+static inline u8 *lz4_write_literals(u8 **op, const u8 *anchor, size_t len)
+{
+	u8 *token = (*op)++;
+
+	if (len >= RUN_MASK) {
+		*token = RUN_MASK << ML_BITS;
+		*op = lz4_write_length(*op, len - RUN_MASK);
+	} else {
+		*token = len << ML_BITS;
+	}
+
+	memcpy(*op, anchor, len);
+	*op += len;
+
+	return token;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	u32 *table = wrkmem;
+	const u8 *ip = src;
+	const u8 *anchor = src;
+	const u8 * const iend = src + src_len;
+	const u8 * const mflimit = iend - MFLIMIT;
+	const u8 * const matchlimit = iend - LASTLITERALS;
+	u8 *op = dst;
+	u8 *token;
+
+	if (src_len < MINLENGTH)
+		goto last_literals;
+
+	/* Stale entries only cost a failed comparison */
+	memset(table, 0, LZ4_MEM_COMPRESS);
+	table[lz4_hash(get_unaligned_le32(ip))] = 0;
+	ip++;
+
+	while (ip <= mflimit) {
+		u32 seq = get_unaligned_le32(ip);
+		u32 h = lz4_hash(seq);
+		const u8 *ref = src + table[h];
+		size_t len;
+
+		table[h] = ip - src;
+		if (ip - ref > MAX_DISTANCE ||
+		    get_unaligned_le32(ref) != seq) {
+			ip++;
+			continue;
+		}
+
+		/* Catch up with the bytes before the match */
+		while (ip > anchor && ref > (const u8 *)src &&
+		       ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		token = lz4_write_literals(&op, anchor, ip - anchor);
+		put_unaligned_le16(ip - ref, op);
+		op += 2;
+
+		len = lz4_count(ip + MINMATCH, ref + MINMATCH, matchlimit);
+		ip += MINMATCH + len;
+		if (len >= ML_MASK) {
+			*token |= ML_MASK;
+			op = lz4_write_length(op, len - ML_MASK);
+		} else {
+			*token |= len;
+		}
+		anchor = ip;
+
+		if (ip > mflimit)
+			break;
+
+		/* Index the end of the match for the next search */
+		table[lz4_hash(get_unaligned_le32(ip - 2))] = ip - 2 - src;
+	}
+
+last_literals:
+	lz4_write_literals(&op, anchor, iend - anchor);
+
+	*dst_len = op - dst;
+	return 0;
+}
+EXPORT_SYMBOL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 compressor");
@@ -0,0 +1,98 @@
+/*
+ * LZ4 Decompressor for Linux kernel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+/*
+ * Read the extra bytes of a length, return false if the input ends
+ * before the length does
+ */
+static inline bool lz4_read_length(const u8 **ip, const u8 *iend,
+		size_t *len)
+{
+	u8 s;
+
+	do {
+		if (unlikely(*ip >= iend))
+			return false;
+		s = *(*ip)++;
+		*len += s;
+	} while (s == 255);
+
+	return true;
+}
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	const u8 *ip = src;
+	const u8 * const iend = src + src_len;
+	u8 *op = dest;
+	u8 * const oend = dest + *dest_len;
+
+	for (;;) {
+		const u8 *ref;
+		size_t len, offset;
+		u8 token;
+
+		if (unlikely(ip >= iend))
+			return -1;
+
+		token = *ip++;
+		len = token >> ML_BITS;
+		if (len == RUN_MASK && !lz4_read_length(&ip, iend, &len))
+			return -1;
+
+		if (unlikely(len > iend - ip || len > oend - op))
+			return -1;
+		memcpy(op, ip, len);
+		ip += len;
+		op += len;
+
+		/* The last sequence ends with its literals */
+		if (ip == iend)
+			break;
+
+		if (unlikely(iend - ip < 2))
+			return -1;
+		offset = get_unaligned_le16(ip);
+		ip += 2;
+		if (unlikely(offset == 0 || offset > op - dest))
+			return -1;
+		ref = op - offset;
+
+		len = token & ML_MASK;
+		if (len == ML_MASK && !lz4_read_length(&ip, iend, &len))
+			return -1;
+		len += MINMATCH;
+
+		if (unlikely(len > oend - op))
+			return -1;
+
+		if (offset >= len) {
+			memcpy(op, ref, len);
+			op += len;
+		} else {
+			/* Overlapping match, repeats the last offset bytes */
+			while (len--)
+				*op++ = *ref++;
+		}
+	}
+
+	*dest_len = op - dest;
+	return 0;
+}
+EXPORT_SYMBOL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
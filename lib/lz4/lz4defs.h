@@ -0,0 +1,24 @@
+/*
+ * lz4defs.h -- architecture specific defines
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * A sequence is a token, the literal length (4 bits of the token and
+ * optional extra bytes), the literals, a 2 byte little endian match
+ * offset and the match length (4 bits of the token, minus MINMATCH, and
+ * optional extra bytes). The last sequence of a block only has literals.
+ */
+#define MINMATCH	4
+#define LASTLITERALS	5	/* the last 5 bytes are always literals */
+#define MFLIMIT		12	/* the last match starts 12 bytes before end */
+#define MINLENGTH	(MFLIMIT + 1)
+#define MAX_DISTANCE	65535
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
@@ -267,6 +267,48 @@ int qmi_kernel_encode(struct msg_desc *desc,
 }
 EXPORT_SYMBOL(qmi_kernel_encode);
 
+/**
+ * qmi_struct_is_flat() - Check if a struct element has a fixed wire layout
+ * @ei_array: Struct info array describing the struct element.
+ *
+ * @return: true if the encoded form of one instance of the struct is
+ *          byte-for-byte identical to its C layout, else false.
+ *
+ * A nested struct has no TLV or length framing of its own, so when it is
+ * built only from mandatory, fixed-length basic elements laid out back to
+ * back without padding, arrays of it can be encoded and decoded with a
+ * single memcpy instead of walking the element info once per instance.
+ */
+static bool qmi_struct_is_flat(struct elem_info *ei_array)
+{
+	struct elem_info *temp_ei;
+	uint32_t size = 0;
+
+	if (!ei_array->ei_array)
+		return false;
+
+	for (temp_ei = ei_array->ei_array; temp_ei->data_type != QMI_EOTI;
+	     temp_ei++) {
+		switch (temp_ei->data_type) {
+		case QMI_UNSIGNED_1_BYTE:
+		case QMI_UNSIGNED_2_BYTE:
+		case QMI_UNSIGNED_4_BYTE:
+		case QMI_UNSIGNED_8_BYTE:
+		case QMI_SIGNED_2_BYTE_ENUM:
+		case QMI_SIGNED_4_BYTE_ENUM:
+			break;
+		default:
+			return false;
+		}
+		if (temp_ei->is_array == VAR_LEN_ARRAY ||
+		    temp_ei->offset != size)
+			return false;
+		size += (temp_ei->is_array == STATIC_ARRAY ?
+			 temp_ei->elem_len : 1) * temp_ei->elem_size;
+	}
+	return size && size == ei_array->elem_size;
+}
+
 /**
  * qmi_encode_basic_elem() - Encodes elements of basic/primary data type
  * @buf_dst: Buffer to store the encoded information.
@@ -285,13 +327,10 @@ EXPORT_SYMBOL(qmi_kernel_encode);
 static int qmi_encode_basic_elem(void *buf_dst, void *buf_src,
 				 uint32_t elem_len, uint32_t elem_size)
 {
-	uint32_t i, rc = 0;
-
-	for (i = 0; i < elem_len; i++) {
-		QMI_ENCDEC_ENCODE_N_BYTES(buf_dst, buf_src, elem_size);
-		rc += elem_size;
-	}
+	uint32_t rc = elem_len * elem_size;
 
+	/* Wire format is the packed little endian array itself */
+	QMI_ENCDEC_ENCODE_N_BYTES(buf_dst, buf_src, rc);
 	return rc;
 }
 
@@ -321,6 +360,19 @@ static int qmi_encode_struct_elem(struct elem_info *ei_array,
 	int i, rc, encoded_bytes = 0;
 	struct elem_info *temp_ei = ei_array;
 
+	if (elem_len > 1 && qmi_struct_is_flat(temp_ei)) {
+		rc = elem_len * temp_ei->elem_size;
+		if (rc + TLV_LEN_SIZE + TLV_TYPE_SIZE > out_buf_len) {
+			pr_err("%s: Too Small Buffer for %d structs\n",
+				__func__, elem_len);
+			return -ETOOSMALL;
+		}
+		memcpy(buf_dst, buf_src, rc);
+		QMI_ENCODE_LOG_ELEM(enc_level, elem_len, temp_ei->elem_size,
+				    buf_src);
+		return rc;
+	}
+
 	for (i = 0; i < elem_len; i++) {
 		rc = _qmi_kernel_encode(temp_ei->ei_array, buf_dst, buf_src,
 					(out_buf_len - encoded_bytes),
@@ -616,13 +668,9 @@ EXPORT_SYMBOL(qmi_kernel_decode);
 static int qmi_decode_basic_elem(void *buf_dst, void *buf_src,
 				 uint32_t elem_len, uint32_t elem_size)
 {
-	uint32_t i, rc = 0;
-
-	for (i = 0; i < elem_len; i++) {
-		QMI_ENCDEC_DECODE_N_BYTES(buf_dst, buf_src, elem_size);
-		rc += elem_size;
-	}
+	uint32_t rc = elem_len * elem_size;
 
+	QMI_ENCDEC_DECODE_N_BYTES(buf_dst, buf_src, rc);
 	return rc;
 }
 
@@ -652,6 +700,22 @@ static int qmi_decode_struct_elem(struct elem_info *ei_array, void *buf_dst,
 	int i, rc, decoded_bytes = 0;
 	struct elem_info *temp_ei = ei_array;
 
+	/*
+	 * Only take the fast path when the size checks below would pass;
+	 * malformed input still goes through the per-instance walk so that
+	 * it is reported the same way.
+	 */
+	if (elem_len > 1 && qmi_struct_is_flat(temp_ei)) {
+		rc = elem_len * temp_ei->elem_size;
+		if ((dec_level <= 2 && rc == tlv_len) ||
+		    (dec_level > 2 && rc <= tlv_len)) {
+			memcpy(buf_dst, buf_src, rc);
+			QMI_DECODE_LOG_ELEM(dec_level, elem_len,
+					    temp_ei->elem_size, buf_dst);
+			return rc;
+		}
+	}
+
 	for (i = 0; i < elem_len && decoded_bytes < tlv_len; i++) {
 		rc = _qmi_kernel_decode(temp_ei->ei_array, buf_dst, buf_src,
 					(tlv_len - decoded_bytes), dec_level);
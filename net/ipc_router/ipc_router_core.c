@@ -33,6 +33,8 @@
 #include <linux/ipc_router.h>
 #include <linux/ipc_router_xprt.h>
 #include <linux/kref.h>
+#include <linux/rcupdate.h>
+#include <linux/rculist.h>
 #include <soc/qcom/subsystem_notif.h>
 
 #include <asm/byteorder.h>
@@ -126,6 +128,7 @@ struct msm_ipc_server {
 	int next_pdev_id;
 	int synced_sec_rule;
 	struct list_head server_port_list;
+	struct rcu_head rcu;
 };
 
 struct msm_ipc_server_port {
@@ -133,6 +136,7 @@ struct msm_ipc_server_port {
 	struct platform_device *pdev;
 	struct msm_ipc_port_addr server_addr;
 	struct msm_ipc_router_xprt_info *xprt_info;
+	struct rcu_head rcu;
 };
 
 struct msm_ipc_resume_tx_port {
@@ -164,6 +168,7 @@ struct msm_ipc_router_remote_port {
 	struct list_head conn_info_list;
 	void *sec_rule;
 	struct msm_ipc_server *server;
+	struct rcu_head rcu;
 };
 
 struct msm_ipc_router_xprt_info {
@@ -192,8 +197,15 @@ struct msm_ipc_routing_table_entry {
 	struct rw_semaphore lock_lha4;
 	unsigned long num_tx_bytes;
 	unsigned long num_rx_bytes;
+	struct rcu_head rcu;
 };
 
+/*
+ * The local port, server and routing tables (and the remote port lists
+ * hanging off routing entries) are looked up locklessly under RCU on the
+ * per-packet paths.  The rw_semaphores only serialize updaters and the
+ * slow-path walkers, and entries are freed through kfree_rcu().
+ */
 static struct list_head routing_table[RT_HASH_SIZE];
 static DECLARE_RWSEM(routing_table_lock_lha3);
 static int routing_table_inited;
@@ -279,7 +291,7 @@ static struct msm_ipc_routing_table_entry *create_routing_table_entry(
 		rt_entry->neighbor_node_id = xprt_info->remote_node_id;
 
 	key = (node_id % RT_HASH_SIZE);
-	list_add_tail(&rt_entry->list, &routing_table[key]);
+	list_add_tail_rcu(&rt_entry->list, &routing_table[key]);
 out_create_rtentry1:
 	kref_get(&rt_entry->ref);
 out_create_rtentry2:
@@ -299,14 +311,19 @@ out_create_rtentry2:
 static struct msm_ipc_routing_table_entry *ipc_router_get_rtentry_ref(
 	uint32_t node_id)
 {
+	uint32_t key = (node_id % RT_HASH_SIZE);
 	struct msm_ipc_routing_table_entry *rt_entry;
 
-	down_read(&routing_table_lock_lha3);
-	rt_entry = lookup_routing_table(node_id);
-	if (rt_entry)
-		kref_get(&rt_entry->ref);
-	up_read(&routing_table_lock_lha3);
-	return rt_entry;
+	rcu_read_lock();
+	list_for_each_entry_rcu(rt_entry, &routing_table[key], list) {
+		if (rt_entry->node_id == node_id &&
+		    kref_get_unless_zero(&rt_entry->ref)) {
+			rcu_read_unlock();
+			return rt_entry;
+		}
+	}
+	rcu_read_unlock();
+	return NULL;
 }
 
 /**
@@ -326,7 +343,7 @@ void ipc_router_release_rtentry(struct kref *ref)
 	 * As part of SSR, all the internals of the routing table entry
 	 * are cleaned. So just free the routing table entry.
 	 */
-	kfree(rt_entry);
+	kfree_rcu(rt_entry, rcu);
 }
 
 struct rr_packet *rr_read(struct msm_ipc_router_xprt_info *xprt_info)
@@ -900,6 +917,7 @@ static int post_pkt_to_port(struct msm_ipc_port *port_ptr,
 			    struct rr_packet *pkt, int clone)
 {
 	struct rr_packet *temp_pkt = pkt;
+	unsigned long flags;
 	void (*notify)(unsigned event, void *oob_data,
 		       size_t oob_data_len, void *priv);
 
@@ -917,12 +935,12 @@ static int post_pkt_to_port(struct msm_ipc_port *port_ptr,
 		}
 	}
 
-	mutex_lock(&port_ptr->port_rx_q_lock_lhc3);
+	spin_lock_irqsave(&port_ptr->port_rx_q_lock_lhc3, flags);
 	__pm_stay_awake(&port_ptr->port_rx_ws);
 	list_add_tail(&temp_pkt->list, &port_ptr->port_rx_q);
-	wake_up(&port_ptr->port_rx_wait_q);
 	notify = port_ptr->notify;
-	mutex_unlock(&port_ptr->port_rx_q_lock_lhc3);
+	spin_unlock_irqrestore(&port_ptr->port_rx_q_lock_lhc3, flags);
+	wake_up(&port_ptr->port_rx_wait_q);
 	if (notify)
 		notify(pkt->hdr.type, NULL, 0, port_ptr->priv);
 	return 0;
@@ -1020,7 +1038,7 @@ void msm_ipc_router_add_local_port(struct msm_ipc_port *port_ptr)
 
 	key = (port_ptr->this_port.port_id & (LP_HASH_SIZE - 1));
 	down_write(&local_ports_lock_lhc2);
-	list_add_tail(&port_ptr->list, &local_ports[key]);
+	list_add_tail_rcu(&port_ptr->list, &local_ports[key]);
 	up_write(&local_ports_lock_lhc2);
 }
 
@@ -1060,7 +1078,7 @@ struct msm_ipc_port *msm_ipc_router_create_raw_port(void *endpoint,
 
 	mutex_init(&port_ptr->port_lock_lhc3);
 	INIT_LIST_HEAD(&port_ptr->port_rx_q);
-	mutex_init(&port_ptr->port_rx_q_lock_lhc3);
+	spin_lock_init(&port_ptr->port_rx_q_lock_lhc3);
 	init_waitqueue_head(&port_ptr->port_rx_wait_q);
 	snprintf(port_ptr->rx_ws_name, MAX_WS_NAME_SZ,
 		 "ipc%08x_%s",
@@ -1090,15 +1108,15 @@ static struct msm_ipc_port *ipc_router_get_port_ref(uint32_t port_id)
 	int key = (port_id & (LP_HASH_SIZE - 1));
 	struct msm_ipc_port *port_ptr;
 
-	down_read(&local_ports_lock_lhc2);
-	list_for_each_entry(port_ptr, &local_ports[key], list) {
-		if (port_ptr->this_port.port_id == port_id) {
-			kref_get(&port_ptr->ref);
-			up_read(&local_ports_lock_lhc2);
+	rcu_read_lock();
+	list_for_each_entry_rcu(port_ptr, &local_ports[key], list) {
+		if (port_ptr->this_port.port_id == port_id &&
+		    kref_get_unless_zero(&port_ptr->ref)) {
+			rcu_read_unlock();
 			return port_ptr;
 		}
 	}
-	up_read(&local_ports_lock_lhc2);
+	rcu_read_unlock();
 	return NULL;
 }
 
@@ -1113,15 +1131,18 @@ void ipc_router_release_port(struct kref *ref)
 	struct rr_packet *pkt, *temp_pkt;
 	struct msm_ipc_port *port_ptr =
 		container_of(ref, struct msm_ipc_port, ref);
+	unsigned long flags;
+	LIST_HEAD(rx_q);
 
-	mutex_lock(&port_ptr->port_rx_q_lock_lhc3);
-	list_for_each_entry_safe(pkt, temp_pkt, &port_ptr->port_rx_q, list) {
+	spin_lock_irqsave(&port_ptr->port_rx_q_lock_lhc3, flags);
+	list_splice_init(&port_ptr->port_rx_q, &rx_q);
+	spin_unlock_irqrestore(&port_ptr->port_rx_q_lock_lhc3, flags);
+	list_for_each_entry_safe(pkt, temp_pkt, &rx_q, list) {
 		list_del(&pkt->list);
 		release_pkt(pkt);
 	}
-	mutex_unlock(&port_ptr->port_rx_q_lock_lhc3);
 	wakeup_source_trash(&port_ptr->port_rx_ws);
-	kfree(port_ptr);
+	kfree_rcu(port_ptr, rcu);
 }
 
 /**
@@ -1144,17 +1165,16 @@ static struct msm_ipc_router_remote_port *ipc_router_get_rport_ref(
 		return NULL;
 	}
 
-	down_read(&rt_entry->lock_lha4);
-	list_for_each_entry(rport_ptr,
+	rcu_read_lock();
+	list_for_each_entry_rcu(rport_ptr,
 			    &rt_entry->remote_port_list[key], list) {
-		if (rport_ptr->port_id == port_id) {
-			kref_get(&rport_ptr->ref);
+		if (rport_ptr->port_id == port_id &&
+		    kref_get_unless_zero(&rport_ptr->ref))
 			goto out_lookup_rmt_port1;
-		}
 	}
 	rport_ptr = NULL;
 out_lookup_rmt_port1:
-	up_read(&rt_entry->lock_lha4);
+	rcu_read_unlock();
 	kref_put(&rt_entry->ref, ipc_router_release_rtentry);
 	return rport_ptr;
 }
@@ -1204,7 +1224,7 @@ static struct msm_ipc_router_remote_port *ipc_router_create_rport(
 	mutex_init(&rport_ptr->rport_lock_lhb2);
 	INIT_LIST_HEAD(&rport_ptr->resume_tx_port_list);
 	INIT_LIST_HEAD(&rport_ptr->conn_info_list);
-	list_add_tail(&rport_ptr->list,
+	list_add_tail_rcu(&rport_ptr->list,
 		      &rt_entry->remote_port_list[key]);
 out_create_rmt_port1:
 	kref_get(&rport_ptr->ref);
@@ -1342,7 +1362,7 @@ static void ipc_router_release_rport(struct kref *ref)
 	mutex_lock(&rport_ptr->rport_lock_lhb2);
 	msm_ipc_router_free_resume_tx_port(rport_ptr);
 	mutex_unlock(&rport_ptr->rport_lock_lhb2);
-	kfree(rport_ptr);
+	kfree_rcu(rport_ptr, rcu);
 }
 
 /**
@@ -1365,7 +1385,7 @@ static void ipc_router_destroy_rport(
 		return;
 	}
 	down_write(&rt_entry->lock_lha4);
-	list_del(&rport_ptr->list);
+	list_del_rcu(&rport_ptr->list);
 	up_write(&rt_entry->lock_lha4);
 	signal_rport_exit(rport_ptr);
 	kref_put(&rport_ptr->ref, ipc_router_release_rport);
@@ -1426,12 +1446,30 @@ static struct msm_ipc_server *ipc_router_get_server_ref(
 	uint32_t svc, uint32_t ins, uint32_t node_id, uint32_t port_id)
 {
 	struct msm_ipc_server *server;
+	struct msm_ipc_server_port *server_port;
+	int key = (svc & (SRV_HASH_SIZE - 1));
 
-	down_read(&server_list_lock_lha2);
-	server = msm_ipc_router_lookup_server(svc, ins, node_id, port_id);
-	if (server)
-		kref_get(&server->ref);
-	up_read(&server_list_lock_lha2);
+	rcu_read_lock();
+	list_for_each_entry_rcu(server, &server_list[key], list) {
+		if ((server->name.service != svc) ||
+		    (server->name.instance != ins))
+			continue;
+		if ((node_id == 0) && (port_id == 0))
+			goto found_server;
+		list_for_each_entry_rcu(server_port,
+					&server->server_port_list, list) {
+			if ((server_port->server_addr.node_id == node_id) &&
+			    (server_port->server_addr.port_id == port_id))
+				goto found_server;
+		}
+	}
+	rcu_read_unlock();
+	return NULL;
+
+found_server:
+	if (!kref_get_unless_zero(&server->ref))
+		server = NULL;
+	rcu_read_unlock();
 	return server;
 }
 
@@ -1446,7 +1484,7 @@ static void ipc_router_release_server(struct kref *ref)
 	struct msm_ipc_server *server =
 		container_of(ref, struct msm_ipc_server, ref);
 
-	kfree(server);
+	kfree_rcu(server, rcu);
 }
 
 /**
@@ -1498,7 +1536,7 @@ static struct msm_ipc_server *msm_ipc_router_create_server(
 	server->synced_sec_rule = 0;
 	INIT_LIST_HEAD(&server->server_port_list);
 	kref_init(&server->ref);
-	list_add_tail(&server->list, &server_list[key]);
+	list_add_tail_rcu(&server->list, &server_list[key]);
 	scnprintf(server->pdev_name, sizeof(server->pdev_name),
 		  "SVC%08x:%08x", service, instance);
 	server->next_pdev_id = 1;
@@ -1511,8 +1549,8 @@ create_srv_port:
 		if (pdev)
 			platform_device_put(pdev);
 		if (list_empty(&server->server_port_list)) {
-			list_del(&server->list);
-			kfree(server);
+			list_del_rcu(&server->list);
+			kfree_rcu(server, rcu);
 		}
 		up_write(&server_list_lock_lha2);
 		IPC_RTR_ERR("%s: Server Port allocation failed\n", __func__);
@@ -1522,7 +1560,7 @@ create_srv_port:
 	server_port->server_addr.node_id = node_id;
 	server_port->server_addr.port_id = port_id;
 	server_port->xprt_info = xprt_info;
-	list_add_tail(&server_port->list, &server->server_port_list);
+	list_add_tail_rcu(&server_port->list, &server->server_port_list);
 	server->next_pdev_id++;
 	platform_device_add(server_port->pdev);
 
@@ -1562,11 +1600,11 @@ static void ipc_router_destroy_server_nolock(struct msm_ipc_server *server,
 	}
 	if (server_port_found && server_port) {
 		platform_device_unregister(server_port->pdev);
-		list_del(&server_port->list);
-		kfree(server_port);
+		list_del_rcu(&server_port->list);
+		kfree_rcu(server_port, rcu);
 	}
 	if (list_empty(&server->server_port_list)) {
-		list_del(&server->list);
+		list_del_rcu(&server->list);
 		kref_put(&server->ref, ipc_router_release_server);
 	}
 	return;
@@ -1927,7 +1965,7 @@ static void cleanup_rmt_ports(struct msm_ipc_router_xprt_info *xprt_info,
 	for (j = 0; j < RP_HASH_SIZE; j++) {
 		list_for_each_entry_safe(rport_ptr, tmp_rport_ptr,
 				&rt_entry->remote_port_list[j], list) {
-			list_del(&rport_ptr->list);
+			list_del_rcu(&rport_ptr->list);
 			mutex_lock(&rport_ptr->rport_lock_lhb2);
 			server = rport_ptr->server;
 			rport_ptr->server = NULL;
@@ -1973,7 +2011,7 @@ static void msm_ipc_cleanup_routing_table(
 			cleanup_rmt_ports(xprt_info, rt_entry);
 			rt_entry->xprt_info = NULL;
 			up_write(&rt_entry->lock_lha4);
-			list_del(&rt_entry->list);
+			list_del_rcu(&rt_entry->list);
 			kref_put(&rt_entry->ref, ipc_router_release_rtentry);
 		}
 	}
@@ -2965,26 +3003,27 @@ int msm_ipc_router_read(struct msm_ipc_port *port_ptr,
 			size_t buf_len)
 {
 	struct rr_packet *pkt;
+	unsigned long flags;
 
 	if (!port_ptr || !read_pkt)
 		return -EINVAL;
 
-	mutex_lock(&port_ptr->port_rx_q_lock_lhc3);
+	spin_lock_irqsave(&port_ptr->port_rx_q_lock_lhc3, flags);
 	if (list_empty(&port_ptr->port_rx_q)) {
-		mutex_unlock(&port_ptr->port_rx_q_lock_lhc3);
+		spin_unlock_irqrestore(&port_ptr->port_rx_q_lock_lhc3, flags);
 		return -EAGAIN;
 	}
 
 	pkt = list_first_entry(&port_ptr->port_rx_q, struct rr_packet, list);
 	if ((buf_len) && (pkt->hdr.size > buf_len)) {
-		mutex_unlock(&port_ptr->port_rx_q_lock_lhc3);
+		spin_unlock_irqrestore(&port_ptr->port_rx_q_lock_lhc3, flags);
 		return -ETOOSMALL;
 	}
 	list_del(&pkt->list);
 	if (list_empty(&port_ptr->port_rx_q))
 		__pm_relax(&port_ptr->port_rx_ws);
 	*read_pkt = pkt;
-	mutex_unlock(&port_ptr->port_rx_q_lock_lhc3);
+	spin_unlock_irqrestore(&port_ptr->port_rx_q_lock_lhc3, flags);
 	if (pkt->hdr.control_flag & CONTROL_FLAG_CONFIRM_RX)
 		msm_ipc_router_send_resume_tx(&pkt->hdr);
 
@@ -3007,9 +3046,7 @@ int msm_ipc_router_rx_data_wait(struct msm_ipc_port *port_ptr, long timeout)
 {
 	int ret = 0;
 
-	mutex_lock(&port_ptr->port_rx_q_lock_lhc3);
 	while (list_empty(&port_ptr->port_rx_q)) {
-		mutex_unlock(&port_ptr->port_rx_q_lock_lhc3);
 		if (timeout < 0) {
 			ret = wait_event_interruptible(
 					port_ptr->port_rx_wait_q,
@@ -3026,9 +3063,7 @@ int msm_ipc_router_rx_data_wait(struct msm_ipc_port *port_ptr, long timeout)
 		}
 		if (timeout == 0)
 			return -ENOMSG;
-		mutex_lock(&port_ptr->port_rx_q_lock_lhc3);
 	}
-	mutex_unlock(&port_ptr->port_rx_q_lock_lhc3);
 
 	return ret;
 }
@@ -3169,7 +3204,7 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 
 	if (port_ptr->type == SERVER_PORT || port_ptr->type == CLIENT_PORT) {
 		down_write(&local_ports_lock_lhc2);
-		list_del(&port_ptr->list);
+		list_del_rcu(&port_ptr->list);
 		up_write(&local_ports_lock_lhc2);
 
 		mutex_lock(&port_ptr->port_lock_lhc3);
@@ -3209,7 +3244,7 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 		up_write(&control_ports_lock_lha5);
 	} else if (port_ptr->type == IRSC_PORT) {
 		down_write(&local_ports_lock_lhc2);
-		list_del(&port_ptr->list);
+		list_del_rcu(&port_ptr->list);
 		up_write(&local_ports_lock_lhc2);
 		signal_irsc_completion();
 	}
@@ -3242,18 +3277,19 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 int msm_ipc_router_get_curr_pkt_size(struct msm_ipc_port *port_ptr)
 {
 	struct rr_packet *pkt;
+	unsigned long flags;
 	int rc = 0;
 
 	if (!port_ptr)
 		return -EINVAL;
 
-	mutex_lock(&port_ptr->port_rx_q_lock_lhc3);
+	spin_lock_irqsave(&port_ptr->port_rx_q_lock_lhc3, flags);
 	if (!list_empty(&port_ptr->port_rx_q)) {
 		pkt = list_first_entry(&port_ptr->port_rx_q,
 					struct rr_packet, list);
 		rc = pkt->length;
 	}
-	mutex_unlock(&port_ptr->port_rx_q_lock_lhc3);
+	spin_unlock_irqrestore(&port_ptr->port_rx_q_lock_lhc3, flags);
 
 	return rc;
 }
@@ -3264,8 +3300,10 @@ int msm_ipc_router_bind_control_port(struct msm_ipc_port *port_ptr)
 		return -EINVAL;
 
 	down_write(&local_ports_lock_lhc2);
-	list_del(&port_ptr->list);
+	list_del_rcu(&port_ptr->list);
 	up_write(&local_ports_lock_lhc2);
+	/* let lockless lookups finish walking local_ports through this port */
+	synchronize_rcu();
 	port_ptr->type = CONTROL_PORT;
 	down_write(&control_ports_lock_lha5);
 	list_add_tail(&port_ptr->list, &control_ports);
@@ -239,11 +239,11 @@ static int msm_ipc_router_extract_msg(struct msghdr *m,
 		m->msg_namelen = sizeof(struct sockaddr_msm_ipc);
 	}
 
+	/* copy straight out of each fragment, scattering over the iovecs */
 	data_len = hdr->size;
 	skb_queue_walk(pkt->pkt_fragment_q, temp) {
 		copy_len = data_len < temp->len ? data_len : temp->len;
-		if (copy_to_user(m->msg_iov->iov_base + offset, temp->data,
-				 copy_len)) {
+		if (memcpy_toiovec(m->msg_iov, temp->data, copy_len)) {
 			IPC_RTR_ERR("%s: Copy to user failed\n", __func__);
 			return -EFAULT;
 		}
@@ -456,9 +456,6 @@ static int msm_ipc_router_recvmsg(struct kiocb *iocb, struct socket *sock,
 	long timeout;
 	int ret;
 
-	if (m->msg_iovlen != 1)
-		return -EOPNOTSUPP;
-
 	if (!buf_len)
 		return -EINVAL;
 
@@ -109,6 +109,11 @@ static void esp_output_done(struct crypto_async_request *base, int err)
 {
 	struct sk_buff *skb = base->data;
 
+	/* backlogged request has been accepted by the engine */
+	if (err == -EINPROGRESS)
+		return;
+
+	esp_req_done(skb_dst(skb)->xfrm->data);
 	kfree(ESP_SKB_CB(skb)->tmp);
 	xfrm_output_resume(skb, err);
 }
@@ -136,6 +141,7 @@ static int esp_output(struct xfrm_state *x, struct sk_buff *skb)
 	int sglists;
 	int seqhilen;
 	__be32 *seqhi;
+	u32 flags;
 
 	/* skb is pure payload to encrypt */
 
@@ -256,7 +262,8 @@ static int esp_output(struct xfrm_state *x, struct sk_buff *skb)
 	} else
 		sg_init_one(asg, esph, sizeof(*esph));
 
-	aead_givcrypt_set_callback(req, 0, esp_output_done, skb);
+	flags = esp_req_flags(esp);
+	aead_givcrypt_set_callback(req, flags, esp_output_done, skb);
 	aead_givcrypt_set_crypt(req, sg, sg, clen, iv);
 	aead_givcrypt_set_assoc(req, asg, assoclen);
 	aead_givcrypt_set_giv(req, esph->enc_data,
@@ -267,6 +274,12 @@ static int esp_output(struct xfrm_state *x, struct sk_buff *skb)
 	if (err == -EINPROGRESS)
 		goto error;
 
+	if (err == -EBUSY && flags) {
+		err = -EINPROGRESS;
+		goto error;
+	}
+
+	esp_req_done(esp);
 	if (err == -EBUSY)
 		err = NET_XMIT_DROP;
 
@@ -365,6 +378,10 @@ static void esp_input_done(struct crypto_async_request *base, int err)
 {
 	struct sk_buff *skb = base->data;
 
+	if (err == -EINPROGRESS)
+		return;
+
+	esp_req_done(xfrm_input_state(skb)->data);
 	xfrm_input_resume(skb, esp_input_done2(skb, err));
 }
 
@@ -390,6 +407,7 @@ static int esp_input(struct xfrm_state *x, struct sk_buff *skb)
 	u8 *iv;
 	struct scatterlist *sg;
 	struct scatterlist *asg;
+	u32 flags;
 	int err = -EINVAL;
 
 	if (!pskb_may_pull(skb, sizeof(*esph) + crypto_aead_ivsize(aead)))
@@ -443,7 +461,8 @@ static int esp_input(struct xfrm_state *x, struct sk_buff *skb)
 	} else
 		sg_init_one(asg, esph, sizeof(*esph));
 
-	aead_request_set_callback(req, 0, esp_input_done, skb);
+	flags = esp_req_flags(esp);
+	aead_request_set_callback(req, flags, esp_input_done, skb);
 	aead_request_set_crypt(req, sg, sg, elen, iv);
 	aead_request_set_assoc(req, asg, assoclen);
 
@@ -451,6 +470,12 @@ static int esp_input(struct xfrm_state *x, struct sk_buff *skb)
 	if (err == -EINPROGRESS)
 		goto out;
 
+	if (err == -EBUSY && flags) {
+		err = -EINPROGRESS;
+		goto out;
+	}
+
+	esp_req_done(esp);
 	err = esp_input_done2(skb, err);
 
 out:
@@ -138,6 +138,11 @@ static void esp_output_done(struct crypto_async_request *base, int err)
 {
 	struct sk_buff *skb = base->data;
 
+	/* backlogged request has been accepted by the engine */
+	if (err == -EINPROGRESS)
+		return;
+
+	esp_req_done(skb_dst(skb)->xfrm->data);
 	kfree(ESP_SKB_CB(skb)->tmp);
 	xfrm_output_resume(skb, err);
 }
@@ -164,6 +169,7 @@ static int esp6_output(struct xfrm_state *x, struct sk_buff *skb)
 	u8 *iv;
 	u8 *tail;
 	__be32 *seqhi;
+	u32 flags;
 	struct esp_data *esp = x->data;
 
 	/* skb is pure payload to encrypt */
@@ -248,7 +254,8 @@ static int esp6_output(struct xfrm_state *x, struct sk_buff *skb)
 	} else
 		sg_init_one(asg, esph, sizeof(*esph));
 
-	aead_givcrypt_set_callback(req, 0, esp_output_done, skb);
+	flags = esp_req_flags(esp);
+	aead_givcrypt_set_callback(req, flags, esp_output_done, skb);
 	aead_givcrypt_set_crypt(req, sg, sg, clen, iv);
 	aead_givcrypt_set_assoc(req, asg, assoclen);
 	aead_givcrypt_set_giv(req, esph->enc_data,
@@ -259,6 +266,12 @@ static int esp6_output(struct xfrm_state *x, struct sk_buff *skb)
 	if (err == -EINPROGRESS)
 		goto error;
 
+	if (err == -EBUSY && flags) {
+		err = -EINPROGRESS;
+		goto error;
+	}
+
+	esp_req_done(esp);
 	if (err == -EBUSY)
 		err = NET_XMIT_DROP;
 
@@ -319,6 +332,10 @@ static void esp_input_done(struct crypto_async_request *base, int err)
 {
 	struct sk_buff *skb = base->data;
 
+	if (err == -EINPROGRESS)
+		return;
+
+	esp_req_done(xfrm_input_state(skb)->data);
 	xfrm_input_resume(skb, esp_input_done2(skb, err));
 }
 
@@ -337,6 +354,7 @@ static int esp6_input(struct xfrm_state *x, struct sk_buff *skb)
 	int ret = 0;
 	void *tmp;
 	__be32 *seqhi;
+	u32 flags;
 	u8 *iv;
 	struct scatterlist *sg;
 	struct scatterlist *asg;
@@ -398,7 +416,8 @@ static int esp6_input(struct xfrm_state *x, struct sk_buff *skb)
 	} else
 		sg_init_one(asg, esph, sizeof(*esph));
 
-	aead_request_set_callback(req, 0, esp_input_done, skb);
+	flags = esp_req_flags(esp);
+	aead_request_set_callback(req, flags, esp_input_done, skb);
 	aead_request_set_crypt(req, sg, sg, elen, iv);
 	aead_request_set_assoc(req, asg, assoclen);
 
@@ -406,6 +425,12 @@ static int esp6_input(struct xfrm_state *x, struct sk_buff *skb)
 	if (ret == -EINPROGRESS)
 		goto out;
 
+	if (ret == -EBUSY && flags) {
+		ret = -EINPROGRESS;
+		goto out;
+	}
+
+	esp_req_done(esp);
 	ret = esp_input_done2(skb, ret);
 
 out:
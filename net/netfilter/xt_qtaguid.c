@@ -15,6 +15,7 @@
 #define DEBUG
 
 #include <linux/file.h>
+#include <linux/hashtable.h>
 #include <linux/inetdevice.h>
 #include <linux/module.h>
 #include <linux/netfilter/x_tables.h>
@@ -106,6 +107,22 @@ static bool qtu_proc_handling_passive;
 module_param_named(tag_tracking_passive, qtu_proc_handling_passive, bool,
 		   S_IRUGO | S_IWUSR);
 
+/*
+ * How much accounting is done on the packet path.
+ *  QTU_ACCT_FULL: per iface, per uid and per socket tag.
+ *  QTU_ACCT_UID: per iface and per uid. Socket tags are not looked up,
+ *   so all traffic of a uid is billed to its {0, uid_tag} entry.
+ *  QTU_ACCT_IFACE: iface totals only. No uid/tag stats are kept, and
+ *   rules that only do accounting skip the socket lookup entirely.
+ */
+enum qtu_acct_level {
+	QTU_ACCT_FULL,
+	QTU_ACCT_UID,
+	QTU_ACCT_IFACE,
+};
+static unsigned int qtu_acct_level = QTU_ACCT_FULL;
+module_param_named(acct_level, qtu_acct_level, uint, S_IRUGO | S_IWUSR);
+
 #define QTU_DEV_NAME "xt_qtaguid"
 
 uint qtaguid_debug_mask = DEFAULT_DEBUG_MASK;
@@ -130,6 +147,15 @@ static DEFINE_SPINLOCK(iface_stat_list_lock);
 static struct rb_root sock_tag_tree = RB_ROOT;
 static DEFINE_SPINLOCK(sock_tag_list_lock);
 
+/*
+ * Lockless sk->tag lookup for the packet path. It mirrors sock_tag_tree,
+ * is only modified under sock_tag_list_lock, and entries are freed after
+ * a grace period. sock_tag_seq covers in-place retags of a 64bit tag.
+ */
+#define SOCK_TAG_HASH_BITS 8
+static DEFINE_HASHTABLE(sock_tag_hash, SOCK_TAG_HASH_BITS);
+static seqcount_t sock_tag_seq = SEQCNT_ZERO;
+
 static struct rb_root tag_counter_set_tree = RB_ROOT;
 static DEFINE_SPINLOCK(tag_counter_set_list_lock);
 
@@ -321,7 +347,7 @@ static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 			 get_uid_from_tag(st_entry->tag));
 		rb_erase(&st_entry->sock_node, st_to_free_tree);
 		sockfd_put(st_entry->socket);
-		kfree(st_entry);
+		kfree_rcu(st_entry, rcu);
 	}
 }
 
@@ -658,6 +684,26 @@ done:
 	return iface_entry;
 }
 
+/*
+ * Same as get_iface_entry() but for the packet path.
+ * iface_stat entries are never freed once listed, so the entry stays
+ * valid after rcu_read_unlock().
+ */
+static struct iface_stat *get_iface_entry_rcu(const char *ifname)
+{
+	struct iface_stat *iface_entry;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
+		if (!strcmp(ifname, iface_entry->ifname))
+			goto done;
+	}
+	iface_entry = NULL;
+done:
+	rcu_read_unlock();
+	return iface_entry;
+}
+
 /* This is for fmt2 only */
 static void pp_iface_stat_header(struct seq_file *m)
 {
@@ -887,7 +933,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	isw->iface_entry = new_iface;
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
-	list_add(&new_iface->list, &iface_stat_list);
+	list_add_rcu(&new_iface->list, &iface_stat_list);
 	return new_iface;
 }
 
@@ -1068,16 +1114,46 @@ static struct sock_tag *get_sock_stat_nl(const struct sock *sk)
 	return sock_tag_tree_search(&sock_tag_tree, sk);
 }
 
-static struct sock_tag *get_sock_stat(const struct sock *sk)
+static void sock_tag_link(struct sock_tag *st_entry)
+{
+	sock_tag_tree_insert(st_entry, &sock_tag_tree);
+	hash_add_rcu(sock_tag_hash, &st_entry->sock_hnode,
+		     (unsigned long)st_entry->sk);
+}
+
+static void sock_tag_unlink(struct sock_tag *st_entry)
+{
+	rb_erase(&st_entry->sock_node, &sock_tag_tree);
+	hash_del_rcu(&st_entry->sock_hnode);
+}
+
+/*
+ * Lockless lookup of the tag of a socket.
+ * Returns false when the socket is not tagged.
+ */
+static bool get_sock_tag(const struct sock *sk, tag_t *tag)
 {
 	struct sock_tag *sock_tag_entry;
-	MT_DEBUG("qtaguid: get_sock_stat(sk=%p)\n", sk);
+	unsigned int seq;
+	bool found = false;
+
+	MT_DEBUG("qtaguid: get_sock_tag(sk=%p)\n", sk);
 	if (!sk)
-		return NULL;
-	spin_lock_bh(&sock_tag_list_lock);
-	sock_tag_entry = get_sock_stat_nl(sk);
-	spin_unlock_bh(&sock_tag_list_lock);
-	return sock_tag_entry;
+		return false;
+	rcu_read_lock();
+	hash_for_each_possible_rcu(sock_tag_hash, sock_tag_entry, sock_hnode,
+				   (unsigned long)sk) {
+		if (sock_tag_entry->sk != sk)
+			continue;
+		do {
+			seq = read_seqcount_begin(&sock_tag_seq);
+			*tag = sock_tag_entry->tag;
+		} while (read_seqcount_retry(&sock_tag_seq, seq));
+		found = true;
+		break;
+	}
+	rcu_read_unlock();
+	return found;
 }
 
 static int ipx_proto(const struct sk_buff *skb,
@@ -1292,23 +1368,18 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	tag_t tag, acct_tag;
 	tag_t uid_tag;
 	struct data_counters *uid_tag_counters;
-	struct sock_tag *sock_tag_entry;
 	struct iface_stat *iface_entry;
 	struct tag_stat *new_tag_stat = NULL;
 	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
 		 ifname, uid, sk, direction, proto, bytes);
 
-
-	spin_lock_bh(&iface_stat_list_lock);
-	iface_entry = get_iface_entry(ifname);
+	iface_entry = get_iface_entry_rcu(ifname);
 	if (!iface_entry) {
-		spin_unlock_bh(&iface_stat_list_lock);
 		pr_err_ratelimited("qtaguid: tag_stat: stat_update() "
 				   "%s not found\n", ifname);
 		return;
 	}
-	spin_unlock_bh(&iface_stat_list_lock);
 	/* It is ok to process data when an iface_entry is inactive */
 
 	MT_DEBUG("qtaguid: tag_stat: stat_update() dev=%s entry=%p\n",
@@ -1318,9 +1389,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	 * Look for a tagged sock.
 	 * It will have an acct_uid.
 	 */
-	sock_tag_entry = get_sock_stat(sk);
-	if (sock_tag_entry) {
-		tag = sock_tag_entry->tag;
+	if (get_sock_tag(sk, &tag)) {
 		acct_tag = get_atag_from_tag(tag);
 		uid_tag = get_utag_from_tag(tag);
 	} else {
@@ -1638,9 +1707,12 @@ static void account_for_uid(const struct sk_buff *skb,
 		 par->hooknum, el_dev->name, el_dev->type,
 		 par->family, proto, direction);
 
-	if_tag_stat_update(el_dev->name, uid,
-			   skb->sk ? skb->sk : alternate_sk,
-			   direction,
+	if (qtu_acct_level == QTU_ACCT_UID)
+		alternate_sk = NULL;
+	else if (skb->sk)
+		alternate_sk = skb->sk;
+
+	if_tag_stat_update(el_dev->name, uid, alternate_sk, direction,
 			   proto, skb->len);
 }
 
@@ -1656,7 +1728,8 @@ static bool qtaguid_mt(const struct sk_buff *skb, struct xt_action_param *par)
 	 * TODO: unhack how to force just accounting.
 	 * For now we only do tag stats when the uid-owner is not requested
 	 */
-	bool do_tag_stat = !(info->match & XT_QTAGUID_UID);
+	bool do_tag_stat = !(info->match & XT_QTAGUID_UID) &&
+		qtu_acct_level < QTU_ACCT_IFACE;
 
 	if (unlikely(module_passive))
 		return (info->match ^ info->invert) == 0;
@@ -1685,6 +1758,12 @@ static bool qtaguid_mt(const struct sk_buff *skb, struct xt_action_param *par)
 	/* default: Fall through and do UID releated work */
 	}
 
+	/* Nothing to account and nothing to match against the socket */
+	if (!do_tag_stat && !info->match) {
+		res = (info->match ^ info->invert) == 0;
+		goto ret_res;
+	}
+
 	sk = skb->sk;
 	/*
 	 * When in TCP_TIME_WAIT the sk is not a "struct sock" but
@@ -2024,7 +2103,7 @@ static int ctrl_cmd_delete(const char *input)
 			 input, st_entry->tag, entry_uid);
 
 		if (!acct_tag || st_entry->tag == tag) {
-			rb_erase(&st_entry->sock_node, &sock_tag_tree);
+			sock_tag_unlink(st_entry);
 			/* Can't sockfd_put() within spinlock, do it later. */
 			sock_tag_tree_insert(st_entry, &st_to_free_tree);
 			tr_entry = lookup_tag_ref(st_entry->tag, NULL);
@@ -2272,7 +2351,9 @@ static int ctrl_cmd_tag(const char *input)
 		BUG_ON(IS_ERR_OR_NULL(prev_tag_ref_entry));
 		BUG_ON(prev_tag_ref_entry->num_sock_tags <= 0);
 		prev_tag_ref_entry->num_sock_tags--;
+		write_seqcount_begin(&sock_tag_seq);
 		sock_tag_entry->tag = full_tag;
+		write_seqcount_end(&sock_tag_seq);
 	} else {
 		CT_DEBUG("qtaguid: ctrl_tag(%s): newtag for sk=%p\n",
 			 input, el_socket->sk);
@@ -2311,7 +2392,7 @@ static int ctrl_cmd_tag(const char *input)
 				 &pqd_entry->sock_tag_list);
 		spin_unlock_bh(&uid_tag_data_tree_lock);
 
-		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
+		sock_tag_link(sock_tag_entry);
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
 	spin_unlock_bh(&sock_tag_list_lock);
@@ -2377,7 +2458,7 @@ static int ctrl_cmd_untag(const char *input)
 	 * The socket already belongs to the current process
 	 * so it can do whatever it wants to it.
 	 */
-	rb_erase(&sock_tag_entry->sock_node, &sock_tag_tree);
+	sock_tag_unlink(sock_tag_entry);
 
 	tag_ref_entry = lookup_tag_ref(sock_tag_entry->tag, &utd_entry);
 	BUG_ON(!tag_ref_entry);
@@ -2414,7 +2495,7 @@ static int ctrl_cmd_untag(const char *input)
 		 atomic_long_read(&el_socket->file->f_count) - 1);
 	sockfd_put(el_socket);
 
-	kfree(sock_tag_entry);
+	kfree_rcu(sock_tag_entry, rcu);
 	atomic64_inc(&qtu_events.sockets_untagged);
 
 	return 0;
@@ -2834,7 +2915,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 		tr->num_sock_tags--;
 		free_tag_ref_from_utd_entry(tr, utd_entry);
 
-		rb_erase(&st_entry->sock_node, &sock_tag_tree);
+		sock_tag_unlink(st_entry);
 		list_del(&st_entry->list);
 		/* Can't sockfd_put() within spinlock, do it later. */
 		sock_tag_tree_insert(st_entry, &st_to_free_tree);
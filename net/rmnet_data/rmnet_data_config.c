@@ -25,6 +25,7 @@
 #include "rmnet_data_handlers.h"
 #include "rmnet_data_vnd.h"
 #include "rmnet_data_private.h"
+#include "rmnet_map.h"
 #include "rmnet_data_trace.h"
 
 RMNET_LOG_MODULE(RMNET_DATA_LOGMASK_CONFIG);
@@ -44,6 +45,21 @@ static struct notifier_block rmnet_dev_notifier = {
 	.priority = 0
 };
 
+unsigned int rmnet_data_steer_mode = RMNET_STEER_NONE;
+module_param(rmnet_data_steer_mode, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rmnet_data_steer_mode,
+		 "Ingress CPU steering mode of newly set logical endpoints");
+
+unsigned int rmnet_data_agg_time_limit;
+module_param(rmnet_data_agg_time_limit, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rmnet_data_agg_time_limit,
+		 "Egress aggregation flush timeout (usec) of new devices");
+
+unsigned int rmnet_data_agg_adaptive;
+module_param(rmnet_data_agg_adaptive, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rmnet_data_agg_adaptive,
+		 "Adapt egress aggregation limits to packet rate on new devices");
+
 #define RMNET_NL_MSG_SIZE(Y) (sizeof(((struct rmnet_nl_msg_s *)0)->Y))
 
 struct rmnet_free_vnd_work {
@@ -704,6 +720,7 @@ int rmnet_unassociate_network_device(struct net_device *dev)
 	if (!config)
 		return RMNET_CONFIG_UNKNOWN_ERROR;
 
+	rmnet_map_agg_cleanup(config);
 	kfree(config);
 
 	netdev_rx_handler_unregister(dev);
@@ -784,6 +801,52 @@ int rmnet_set_egress_data_format(struct net_device *dev,
 	config->egress_data_format = egress_data_format;
 	config->egress_agg_size = agg_size;
 	config->egress_agg_count = agg_count;
+	rmnet_map_agg_reset(config);
+
+	return RMNET_CONFIG_OK;
+}
+
+/**
+ * rmnet_set_egress_agg_params() - Set egress aggregation timing on a device
+ * @dev:                 Device to set aggregation parameters on
+ * @agg_time_limit:      Maximum time (usec) a packet waits in the aggregation
+ *                       buffer. 0 selects one jiffy
+ * @agg_adaptive:        Non-zero to adapt the flush timeout and packet count
+ *                       limit to the observed packet rate
+ *
+ * In adaptive mode the flush timeout moves between RMNET_MAP_AGG_MIN_TIME_NS
+ * and @agg_time_limit, and the early flush count moves up to the agg_count set
+ * by rmnet_set_egress_data_format(). Network device must already have
+ * association with RmNet Data driver
+ *
+ * Return:
+ *      - RMNET_CONFIG_OK if successful
+ *      - RMNET_CONFIG_NO_SUCH_DEVICE dev is null
+ *      - RMNET_CONFIG_UNKNOWN_ERROR net_device private section is null
+ */
+int rmnet_set_egress_agg_params(struct net_device *dev,
+				uint32_t agg_time_limit,
+				uint8_t agg_adaptive)
+{
+	struct rmnet_phys_ep_conf_s *config;
+	ASSERT_RTNL();
+
+	if (!dev)
+		return RMNET_CONFIG_NO_SUCH_DEVICE;
+
+	LOGL("(%s, %d, %d);", dev->name, agg_time_limit, agg_adaptive);
+
+	config = _rmnet_get_phys_ep_config(dev);
+
+	if (!config)
+		return RMNET_CONFIG_UNKNOWN_ERROR;
+
+	if (!agg_time_limit)
+		agg_time_limit = jiffies_to_usecs(1);
+
+	config->egress_agg_time_limit = agg_time_limit;
+	config->egress_agg_adaptive = agg_adaptive ? 1 : 0;
+	rmnet_map_agg_reset(config);
 
 	return RMNET_CONFIG_OK;
 }
@@ -831,7 +894,11 @@ int rmnet_associate_network_device(struct net_device *dev)
 
 	memset(config, 0, sizeof(struct rmnet_phys_ep_conf_s));
 	config->dev = dev;
-	spin_lock_init(&config->agg_lock);
+	rmnet_map_agg_init(config);
+	if (rmnet_data_agg_time_limit)
+		config->egress_agg_time_limit = rmnet_data_agg_time_limit;
+	config->egress_agg_adaptive = rmnet_data_agg_adaptive ? 1 : 0;
+	rmnet_map_agg_reset(config);
 
 	rc = netdev_rx_handler_register(dev, rmnet_rx_handler, config);
 
@@ -974,10 +1041,55 @@ int rmnet_set_logical_endpoint_config(struct net_device *dev,
 	epconfig.refcount = 1;
 	epconfig.rmnet_mode = rmnet_mode;
 	epconfig.egress_dev = egress_dev;
+	if (rmnet_data_steer_mode < RMNET_STEER_MAX)
+		epconfig.steer_mode = rmnet_data_steer_mode;
 
 	return _rmnet_set_logical_endpoint_config(dev, config_id, &epconfig);
 }
 
+/**
+ * rmnet_set_logical_endpoint_steering() - Set ingress CPU steering mode of a
+ *                                         logical endpoint
+ * @dev:            Device the logical endpoint is configured on
+ * @config_id:      logical endpoint id on device
+ * @steer_mode:     steering mode. Values from: rmnet_steer_modes_e
+ *
+ * Only takes effect for endpoints in RMNET_EPMODE_VND mode. Endpoints start
+ * with the mode given by the rmnet_data_steer_mode module parameter.
+ *
+ * Return:
+ *      - RMNET_CONFIG_OK if successful
+ *      - RMNET_CONFIG_NO_SUCH_DEVICE if device is null or endpoint is not set
+ *      - RMNET_CONFIG_BAD_ARGUMENTS if logical endpoint id or mode is out of
+ *                                   range
+ */
+int rmnet_set_logical_endpoint_steering(struct net_device *dev,
+					int config_id,
+					uint8_t steer_mode)
+{
+	struct rmnet_logical_ep_conf_s *epconfig_l;
+
+	ASSERT_RTNL();
+
+	if (!dev)
+		return RMNET_CONFIG_NO_SUCH_DEVICE;
+
+	LOGL("(%s, %d, %d);", dev->name, config_id, steer_mode);
+
+	if (config_id < RMNET_LOCAL_LOGICAL_ENDPOINT
+		|| config_id >= RMNET_DATA_MAX_LOGICAL_EP
+		|| steer_mode >= RMNET_STEER_MAX)
+		return RMNET_CONFIG_BAD_ARGUMENTS;
+
+	epconfig_l = _rmnet_get_logical_ep(dev, config_id);
+
+	if (!epconfig_l || !epconfig_l->refcount)
+		return RMNET_CONFIG_NO_SUCH_DEVICE;
+
+	epconfig_l->steer_mode = steer_mode;
+	return RMNET_CONFIG_OK;
+}
+
 /**
  * rmnet_unset_logical_endpoint_config() - Un-set logical endpoing configuration
  * on a device
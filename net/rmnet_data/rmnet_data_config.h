@@ -16,6 +16,8 @@
 
 #include <linux/types.h>
 #include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 
 #ifndef _RMNET_DATA_CONFIG_H_
 #define _RMNET_DATA_CONFIG_H_
@@ -32,14 +34,33 @@
  * @mux_id: Virtual channel ID used by MAP protocol
  * @egress_dev: Next device to deliver the packet to. Exact usage of this
  *            parmeter depends on the rmnet_mode
+ * @steer_mode: Specifies how ingress packets delivered to a VND are spread
+ *            across CPUs. Possible options are available in
+ *            enum rmnet_steer_modes_e
  */
 struct rmnet_logical_ep_conf_s {
 	uint8_t refcount;
 	uint8_t rmnet_mode;
 	uint8_t mux_id;
+	uint8_t steer_mode;
 	struct net_device *egress_dev;
 };
 
+/**
+ * enum rmnet_steer_modes_e - Ingress CPU steering modes of a logical endpoint
+ *
+ * @RMNET_STEER_NONE: Deliver on the CPU which received the aggregate
+ * @RMNET_STEER_MUX_ID: All packets of the endpoint go to one CPU picked from
+ *                      the MAP mux_id
+ * @RMNET_STEER_FLOW_HASH: Each flow goes to a CPU picked from its 5-tuple hash
+ */
+enum rmnet_steer_modes_e {
+	RMNET_STEER_NONE,
+	RMNET_STEER_MUX_ID,
+	RMNET_STEER_FLOW_HASH,
+	RMNET_STEER_MAX
+};
+
 /**
  * struct rmnet_phys_ep_conf_s - Physical endpoint configuration
  * One instance of this structure is instantiated for each net_device associated
@@ -56,6 +77,16 @@ struct rmnet_logical_ep_conf_s {
  * @egress_agg_count: Maximum count (packets) of data which should be aggregated
  *                  Smaller of the two parameters above are chosen for
  *                  aggregation
+ * @egress_agg_time_limit: Maximum time (usec) a packet may wait in the
+ *                  aggregation buffer before it is flushed
+ * @egress_agg_adaptive: When set, the flush timeout and packet count limit
+ *                  adapt to the observed packet rate, bounded by
+ *                  @egress_agg_time_limit and @egress_agg_count
+ * @agg_time: Current flush timeout (nsec)
+ * @agg_count_limit: Current packet count which flushes the buffer early. Only
+ *                  used in adaptive mode
+ * @agg_timer: Flush timer armed when the first packet enters the buffer
+ * @agg_tasklet: Transmits the buffer when @agg_timer expires
  * @tail_spacing: Guaranteed padding (bytes) when de-aggregating ingress frames
  */
 struct rmnet_phys_ep_conf_s {
@@ -68,10 +99,16 @@ struct rmnet_phys_ep_conf_s {
 	/* MAP specific */
 	uint16_t egress_agg_size;
 	uint16_t egress_agg_count;
+	uint32_t egress_agg_time_limit;
+	uint8_t egress_agg_adaptive;
 	spinlock_t agg_lock;
 	struct sk_buff *agg_skb;
 	uint8_t agg_state;
 	uint8_t agg_count;
+	uint8_t agg_count_limit;
+	uint32_t agg_time;
+	struct hrtimer agg_timer;
+	struct tasklet_struct agg_tasklet;
 	uint8_t tail_spacing;
 };
 
@@ -86,6 +123,9 @@ int rmnet_set_egress_data_format(struct net_device *dev,
 				 uint32_t egress_data_format,
 				 uint16_t agg_size,
 				 uint16_t agg_count);
+int rmnet_set_egress_agg_params(struct net_device *dev,
+				uint32_t agg_time_limit,
+				uint8_t agg_adaptive);
 int rmnet_associate_network_device(struct net_device *dev);
 int _rmnet_set_logical_endpoint_config(struct net_device *dev,
 				       int config_id,
@@ -94,6 +134,9 @@ int rmnet_set_logical_endpoint_config(struct net_device *dev,
 				      int config_id,
 				      uint8_t rmnet_mode,
 				      struct net_device *egress_dev);
+int rmnet_set_logical_endpoint_steering(struct net_device *dev,
+					int config_id,
+					uint8_t steer_mode);
 int _rmnet_unset_logical_endpoint_config(struct net_device *dev,
 					 int config_id);
 int rmnet_unset_logical_endpoint_config(struct net_device *dev,
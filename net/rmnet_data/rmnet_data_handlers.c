@@ -20,6 +20,9 @@
 #include <linux/rmnet_data.h>
 #include <linux/net_map.h>
 #include <linux/netdev_features.h>
+#include <linux/interrupt.h>
+#include <linux/jhash.h>
+#include <linux/cpu.h>
 #include "rmnet_data_private.h"
 #include "rmnet_data_config.h"
 #include "rmnet_data_vnd.h"
@@ -43,6 +46,26 @@ module_param(dump_pkt_tx, uint, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(dump_pkt_tx, "Dump packets exiting egress handler");
 #endif /* CONFIG_RMNET_DATA_DEBUG_PKT */
 
+unsigned int rmnet_data_steer_backlog_max = 1000;
+module_param(rmnet_data_steer_backlog_max, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rmnet_data_steer_backlog_max,
+		 "Maximum packets queued to a steering backlog per CPU");
+
+/**
+ * struct rmnet_steer_backlog_s - Per-CPU ingress steering backlog
+ *
+ * @queue: Packets steered to this CPU waiting to enter the network stack
+ * @tasklet: Drains @queue on the owning CPU
+ * @csd: IPI used to schedule @tasklet from a remote CPU
+ */
+struct rmnet_steer_backlog_s {
+	struct sk_buff_head queue;
+	struct tasklet_struct tasklet;
+	struct call_single_data csd;
+};
+
+static DEFINE_PER_CPU(struct rmnet_steer_backlog_s, rmnet_steer_backlog);
+
 /* ***************** Helper Functions *************************************** */
 
 /**
@@ -164,6 +187,215 @@ static rx_handler_result_t rmnet_bridge_handler(struct sk_buff *skb,
 	return RX_HANDLER_CONSUMED;
 }
 
+/* ***************** Ingress CPU steering *********************************** */
+
+/**
+ * rmnet_steer_backlog_process() - Steering backlog tasklet
+ * @data:     Per-CPU backlog to drain
+ *
+ * Runs on the CPU owning the backlog and hands every queued packet to the
+ * network stack.
+ */
+static void rmnet_steer_backlog_process(unsigned long data)
+{
+	struct rmnet_steer_backlog_s *backlog;
+	struct sk_buff_head process_q;
+	struct sk_buff *skb;
+
+	backlog = (struct rmnet_steer_backlog_s *)data;
+	__skb_queue_head_init(&process_q);
+
+	spin_lock_irq(&backlog->queue.lock);
+	skb_queue_splice_tail_init(&backlog->queue, &process_q);
+	spin_unlock_irq(&backlog->queue.lock);
+
+	while ((skb = __skb_dequeue(&process_q)))
+		netif_receive_skb(skb);
+}
+
+/**
+ * rmnet_steer_backlog_kick() - IPI callback to start a remote backlog
+ * @info:     Per-CPU backlog to schedule
+ */
+static void rmnet_steer_backlog_kick(void *info)
+{
+	struct rmnet_steer_backlog_s *backlog = info;
+
+	tasklet_schedule(&backlog->tasklet);
+}
+
+/**
+ * rmnet_steer_get_cpu() - Pick the CPU which should process a packet
+ * @skb:      Packet being delivered. skb->protocol must be set
+ * @ep:       Logical endpoint the packet belongs to
+ *
+ * Return:
+ *      - CPU id to steer the packet to
+ *      - -1 if the packet should be processed on the current CPU
+ */
+static int rmnet_steer_get_cpu(struct sk_buff *skb,
+			       struct rmnet_logical_ep_conf_s *ep)
+{
+	uint32_t hash;
+	unsigned int index;
+	int cpu;
+
+	switch (ep->steer_mode) {
+	case RMNET_STEER_MUX_ID:
+		hash = jhash_1word(ep->mux_id, 0);
+		break;
+
+	case RMNET_STEER_FLOW_HASH:
+		hash = skb_get_rxhash(skb);
+		if (!hash)
+			return -1;
+		break;
+
+	default:
+		return -1;
+	}
+
+	index = ((uint64_t)hash * num_online_cpus()) >> 32;
+	for_each_online_cpu(cpu) {
+		if (!index--)
+			return cpu;
+	}
+
+	return -1;
+}
+
+/**
+ * rmnet_steer_skb() - Steer packet to the backlog of another CPU
+ * @skb:      Packet ready to enter the network stack
+ * @ep:       Logical endpoint the packet belongs to
+ *
+ * The target backlog tasklet is only kicked when its queue goes from empty to
+ * non-empty, so one IPI covers every packet of an aggregate which hashes to the
+ * same CPU.
+ *
+ * Return:
+ *      - 0 if packet was queued or dropped
+ *      - 1 if packet was not steered and should be delivered by the caller
+ */
+static int rmnet_steer_skb(struct sk_buff *skb,
+			   struct rmnet_logical_ep_conf_s *ep)
+{
+	struct rmnet_steer_backlog_s *backlog;
+	unsigned long flags;
+	int cpu, kick;
+
+	cpu = rmnet_steer_get_cpu(skb, ep);
+	if (cpu < 0 || cpu == smp_processor_id())
+		return 1;
+
+	backlog = &per_cpu(rmnet_steer_backlog, cpu);
+
+	spin_lock_irqsave(&backlog->queue.lock, flags);
+	if (skb_queue_len(&backlog->queue) >= rmnet_data_steer_backlog_max) {
+		spin_unlock_irqrestore(&backlog->queue.lock, flags);
+		rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_STEER_BACKLOG_FULL);
+		return 0;
+	}
+	kick = skb_queue_empty(&backlog->queue);
+	__skb_queue_tail(&backlog->queue, skb);
+	spin_unlock_irqrestore(&backlog->queue.lock, flags);
+
+#ifdef CONFIG_SMP
+	if (kick)
+		__smp_call_function_single(cpu, &backlog->csd, 0);
+#endif /* CONFIG_SMP */
+	return 0;
+}
+
+/**
+ * rmnet_steer_cpu_callback() - CPU hotplug notifier
+ *
+ * Packets left in the backlog of a CPU which went offline are processed on
+ * the CPU running the notifier.
+ */
+static int rmnet_steer_cpu_callback(struct notifier_block *nfb,
+				    unsigned long action, void *hcpu)
+{
+	struct rmnet_steer_backlog_s *backlog;
+
+	if (action != CPU_DEAD && action != CPU_DEAD_FROZEN)
+		return NOTIFY_OK;
+
+	backlog = &per_cpu(rmnet_steer_backlog, (unsigned long)hcpu);
+	if (!skb_queue_empty(&backlog->queue))
+		tasklet_schedule(&backlog->tasklet);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block rmnet_steer_cpu_notifier = {
+	.notifier_call = rmnet_steer_cpu_callback,
+};
+
+/**
+ * rmnet_steer_init() - Initialize per-CPU steering backlogs
+ */
+void rmnet_steer_init(void)
+{
+	struct rmnet_steer_backlog_s *backlog;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		backlog = &per_cpu(rmnet_steer_backlog, cpu);
+		skb_queue_head_init(&backlog->queue);
+		tasklet_init(&backlog->tasklet, rmnet_steer_backlog_process,
+			     (unsigned long)backlog);
+		backlog->csd.func = rmnet_steer_backlog_kick;
+		backlog->csd.info = backlog;
+		backlog->csd.flags = 0;
+	}
+
+	register_hotcpu_notifier(&rmnet_steer_cpu_notifier);
+}
+
+/**
+ * rmnet_steer_exit() - Stop steering backlogs and drop queued packets
+ */
+void rmnet_steer_exit(void)
+{
+	struct rmnet_steer_backlog_s *backlog;
+	int cpu;
+
+	unregister_hotcpu_notifier(&rmnet_steer_cpu_notifier);
+
+	for_each_possible_cpu(cpu) {
+		backlog = &per_cpu(rmnet_steer_backlog, cpu);
+		tasklet_kill(&backlog->tasklet);
+		skb_queue_purge(&backlog->queue);
+	}
+}
+
+/**
+ * rmnet_steer_flush_dev() - Drop steered packets destined to a device
+ * @dev:      Device being freed
+ *
+ * Must be called after the device is unregistered and before it is freed.
+ */
+void rmnet_steer_flush_dev(struct net_device *dev)
+{
+	struct rmnet_steer_backlog_s *backlog;
+	struct sk_buff *skb, *tmp;
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		backlog = &per_cpu(rmnet_steer_backlog, cpu);
+		spin_lock_irqsave(&backlog->queue.lock, flags);
+		skb_queue_walk_safe(&backlog->queue, skb, tmp) {
+			if (skb->dev == dev) {
+				__skb_unlink(skb, &backlog->queue);
+				kfree_skb(skb);
+			}
+		}
+		spin_unlock_irqrestore(&backlog->queue.lock, flags);
+	}
+}
+
 /**
  * __rmnet_deliver_skb() - Deliver skb
  *
@@ -194,7 +426,8 @@ static rx_handler_result_t __rmnet_deliver_skb(struct sk_buff *skb,
 
 		case RX_HANDLER_PASS:
 			skb->pkt_type = PACKET_HOST;
-			netif_receive_skb(skb);
+			if (rmnet_steer_skb(skb, ep))
+				netif_receive_skb(skb);
 			return RX_HANDLER_CONSUMED;
 		}
 		return RX_HANDLER_PASS;
@@ -304,7 +537,7 @@ static rx_handler_result_t _rmnet_map_ingress_handler(struct sk_buff *skb,
 
 	/* Subtract MAP header */
 	skb_pull(skb, sizeof(struct rmnet_map_header_s));
-	skb_trim(skb, len);
+	pskb_trim(skb, len);
 	__rmnet_data_set_skb_proto(skb);
 
 	return __rmnet_deliver_skb(skb, ep);
@@ -21,6 +21,8 @@
 #include <linux/skbuff.h>
 #include <linux/spinlock.h>
 #include <linux/netdevice.h>
+#include <linux/percpu.h>
+#include <linux/u64_stats_sync.h>
 #include "rmnet_data_private.h"
 #include "rmnet_data_stats.h"
 #include "rmnet_data_config.h"
@@ -32,46 +34,137 @@ enum rmnet_deagg_e {
 	RMNET_STATS_AGG_MAX
 };
 
-static DEFINE_SPINLOCK(rmnet_skb_free_lock);
-unsigned long int skb_free[RMNET_STATS_SKBFREE_MAX];
-module_param_array(skb_free, ulong, 0, S_IRUGO);
-MODULE_PARM_DESC(skb_free, "SKBs dropped or freed");
+/**
+ * struct rmnet_stats_pcpu_s - Per-CPU statistics counters
+ *
+ * Each counter array is exported as a read-only module parameter of the same
+ * name. Reading a parameter sums the counter over all CPUs.
+ *
+ * @agg_hist: Uplink aggregates by packet count; bucket n counts aggregates of
+ *            2^n to 2^(n+1)-1 packets, the last bucket is open ended
+ * @deagg_hist: Downlink aggregates by packet count, same buckets as @agg_hist
+ * @syncp: Synchronizes 64 bit counter reads on 32 bit systems
+ */
+struct rmnet_stats_pcpu_s {
+	u64 skb_free[RMNET_STATS_SKBFREE_MAX];
+	u64 queue_xmit[RMNET_STATS_QUEUE_XMIT_MAX*2];
+	u64 deagg_count[RMNET_STATS_AGG_MAX];
+	u64 agg_count[RMNET_STATS_AGG_MAX];
+	u64 checksum_dl_stats[RMNET_MAP_CHECKSUM_ENUM_LENGTH];
+	u64 checksum_ul_stats[RMNET_MAP_CHECKSUM_ENUM_LENGTH];
+	u64 agg_hist[RMNET_STATS_AGG_HIST_MAX];
+	u64 deagg_hist[RMNET_STATS_AGG_HIST_MAX];
+	struct u64_stats_sync syncp;
+};
 
-static DEFINE_SPINLOCK(rmnet_queue_xmit_lock);
-unsigned long int queue_xmit[RMNET_STATS_QUEUE_XMIT_MAX*2];
-module_param_array(queue_xmit, ulong, 0, S_IRUGO);
-MODULE_PARM_DESC(queue_xmit, "SKBs queued for transmit");
+/**
+ * struct rmnet_stats_param_s - Module parameter view of a counter array
+ * @offset:  Offset of the array in struct rmnet_stats_pcpu_s
+ * @count:   Number of counters in the array
+ */
+struct rmnet_stats_param_s {
+	size_t offset;
+	unsigned int count;
+};
 
-static DEFINE_SPINLOCK(rmnet_deagg_count);
-unsigned long int deagg_count[RMNET_STATS_AGG_MAX];
-module_param_array(deagg_count, ulong, 0, S_IRUGO);
-MODULE_PARM_DESC(deagg_count, "SKBs De-aggregated");
+static DEFINE_PER_CPU(struct rmnet_stats_pcpu_s, rmnet_stats_pcpu);
 
-static DEFINE_SPINLOCK(rmnet_agg_count);
-unsigned long int agg_count[RMNET_STATS_AGG_MAX];
-module_param_array(agg_count, ulong, 0, S_IRUGO);
-MODULE_PARM_DESC(agg_count, "SKBs Aggregated");
+static u64 rmnet_stats_sum(size_t offset, unsigned int index)
+{
+	struct rmnet_stats_pcpu_s *stats;
+	unsigned int start;
+	u64 total = 0, value;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		stats = &per_cpu(rmnet_stats_pcpu, cpu);
+		do {
+			start = u64_stats_fetch_begin(&stats->syncp);
+			value = ((u64 *)((char *)stats + offset))[index];
+		} while (u64_stats_fetch_retry(&stats->syncp, start));
+		total += value;
+	}
+
+	return total;
+}
+
+static int rmnet_stats_param_get(char *buffer, const struct kernel_param *kp)
+{
+	const struct rmnet_stats_param_s *param = kp->arg;
+	unsigned int i;
+	int len = 0;
 
-static DEFINE_SPINLOCK(rmnet_checksum_dl_stats);
-unsigned long int checksum_dl_stats[RMNET_MAP_CHECKSUM_ENUM_LENGTH];
-module_param_array(checksum_dl_stats, ulong, 0, S_IRUGO);
-MODULE_PARM_DESC(checksum_dl_stats, "Downlink Checksum Statistics");
+	for (i = 0; i < param->count; i++)
+		len += scnprintf(buffer + len, PAGE_SIZE - len, "%s%llu",
+				 i ? "," : "",
+				 rmnet_stats_sum(param->offset, i));
 
-static DEFINE_SPINLOCK(rmnet_checksum_ul_stats);
-unsigned long int checksum_ul_stats[RMNET_MAP_CHECKSUM_ENUM_LENGTH];
-module_param_array(checksum_ul_stats, ulong, 0, S_IRUGO);
-MODULE_PARM_DESC(checksum_ul_stats, "Uplink Checksum Statistics");
+	return len;
+}
+
+static struct kernel_param_ops rmnet_stats_param_ops = {
+	.get = rmnet_stats_param_get,
+};
+
+#define RMNET_STATS_PARAM(_name, _desc)					\
+	static struct rmnet_stats_param_s rmnet_stats_param_##_name = {	\
+		.offset = offsetof(struct rmnet_stats_pcpu_s, _name),	\
+		.count = ARRAY_SIZE(((struct rmnet_stats_pcpu_s *)0)->_name), \
+	};								\
+	module_param_cb(_name, &rmnet_stats_param_ops,			\
+			&rmnet_stats_param_##_name, S_IRUGO);		\
+	MODULE_PARM_DESC(_name, _desc)
+
+RMNET_STATS_PARAM(skb_free, "SKBs dropped or freed");
+RMNET_STATS_PARAM(queue_xmit, "SKBs queued for transmit");
+RMNET_STATS_PARAM(deagg_count, "SKBs De-aggregated");
+RMNET_STATS_PARAM(agg_count, "SKBs Aggregated");
+RMNET_STATS_PARAM(checksum_dl_stats, "Downlink Checksum Statistics");
+RMNET_STATS_PARAM(checksum_ul_stats, "Uplink Checksum Statistics");
+RMNET_STATS_PARAM(agg_hist, "Uplink aggregates by log2 of packet count");
+RMNET_STATS_PARAM(deagg_hist, "Downlink aggregates by log2 of packet count");
+
+/* Counters are updated from process, softirq and hard irq context, so irqs
+ * are disabled around the update to keep a single writer per CPU.
+ */
+static inline struct rmnet_stats_pcpu_s *rmnet_stats_begin(
+							unsigned long *flags)
+{
+	struct rmnet_stats_pcpu_s *stats;
+
+	local_irq_save(*flags);
+	stats = this_cpu_ptr(&rmnet_stats_pcpu);
+	u64_stats_update_begin(&stats->syncp);
+	return stats;
+}
+
+static inline void rmnet_stats_end(struct rmnet_stats_pcpu_s *stats,
+				   unsigned long flags)
+{
+	u64_stats_update_end(&stats->syncp);
+	local_irq_restore(flags);
+}
+
+static inline unsigned int rmnet_stats_hist_bucket(int aggcount)
+{
+	if (aggcount <= 0)
+		return 0;
+
+	return min_t(unsigned int, fls(aggcount) - 1,
+		     RMNET_STATS_AGG_HIST_MAX - 1);
+}
 
 void rmnet_kfree_skb(struct sk_buff *skb, unsigned int reason)
 {
+	struct rmnet_stats_pcpu_s *stats;
 	unsigned long flags;
 
 	if (reason >= RMNET_STATS_SKBFREE_MAX)
 		reason = RMNET_STATS_SKBFREE_UNKNOWN;
 
-	spin_lock_irqsave(&rmnet_skb_free_lock, flags);
-	skb_free[reason]++;
-	spin_unlock_irqrestore(&rmnet_skb_free_lock, flags);
+	stats = rmnet_stats_begin(&flags);
+	stats->skb_free[reason]++;
+	rmnet_stats_end(stats, flags);
 
 	if (skb)
 		kfree_skb(skb);
@@ -79,6 +172,7 @@ void rmnet_kfree_skb(struct sk_buff *skb, unsigned int reason)
 
 void rmnet_stats_queue_xmit(int rc, unsigned int reason)
 {
+	struct rmnet_stats_pcpu_s *stats;
 	unsigned long flags;
 
 	if (rc != 0)
@@ -86,51 +180,57 @@ void rmnet_stats_queue_xmit(int rc, unsigned int reason)
 	if (reason >= RMNET_STATS_QUEUE_XMIT_MAX*2)
 		reason = RMNET_STATS_SKBFREE_UNKNOWN;
 
-	spin_lock_irqsave(&rmnet_queue_xmit_lock, flags);
-	queue_xmit[reason]++;
-	spin_unlock_irqrestore(&rmnet_queue_xmit_lock, flags);
+	stats = rmnet_stats_begin(&flags);
+	stats->queue_xmit[reason]++;
+	rmnet_stats_end(stats, flags);
 }
 
 void rmnet_stats_agg_pkts(int aggcount)
 {
+	struct rmnet_stats_pcpu_s *stats;
 	unsigned long flags;
 
-	spin_lock_irqsave(&rmnet_agg_count, flags);
-	agg_count[RMNET_STATS_AGG_BUFF]++;
-	agg_count[RMNET_STATS_AGG_PKT] += aggcount;
-	spin_unlock_irqrestore(&rmnet_agg_count, flags);
+	stats = rmnet_stats_begin(&flags);
+	stats->agg_count[RMNET_STATS_AGG_BUFF]++;
+	stats->agg_count[RMNET_STATS_AGG_PKT] += aggcount;
+	stats->agg_hist[rmnet_stats_hist_bucket(aggcount)]++;
+	rmnet_stats_end(stats, flags);
 }
 
 void rmnet_stats_deagg_pkts(int aggcount)
 {
+	struct rmnet_stats_pcpu_s *stats;
 	unsigned long flags;
 
-	spin_lock_irqsave(&rmnet_deagg_count, flags);
-	deagg_count[RMNET_STATS_AGG_BUFF]++;
-	deagg_count[RMNET_STATS_AGG_PKT] += aggcount;
-	spin_unlock_irqrestore(&rmnet_deagg_count, flags);
+	stats = rmnet_stats_begin(&flags);
+	stats->deagg_count[RMNET_STATS_AGG_BUFF]++;
+	stats->deagg_count[RMNET_STATS_AGG_PKT] += aggcount;
+	stats->deagg_hist[rmnet_stats_hist_bucket(aggcount)]++;
+	rmnet_stats_end(stats, flags);
 }
 
 void rmnet_stats_dl_checksum(unsigned int rc)
 {
+	struct rmnet_stats_pcpu_s *stats;
 	unsigned long flags;
 
 	if (rc >= RMNET_MAP_CHECKSUM_ENUM_LENGTH)
 		rc = RMNET_MAP_CHECKSUM_ERR_UNKOWN;
 
-	spin_lock_irqsave(&rmnet_checksum_dl_stats, flags);
-	checksum_dl_stats[rc]++;
-	spin_unlock_irqrestore(&rmnet_checksum_dl_stats, flags);
+	stats = rmnet_stats_begin(&flags);
+	stats->checksum_dl_stats[rc]++;
+	rmnet_stats_end(stats, flags);
 }
 
 void rmnet_stats_ul_checksum(unsigned int rc)
 {
+	struct rmnet_stats_pcpu_s *stats;
 	unsigned long flags;
 
 	if (rc >= RMNET_MAP_CHECKSUM_ENUM_LENGTH)
 		rc = RMNET_MAP_CHECKSUM_ERR_UNKOWN;
 
-	spin_lock_irqsave(&rmnet_checksum_ul_stats, flags);
-	checksum_ul_stats[rc]++;
-	spin_unlock_irqrestore(&rmnet_checksum_ul_stats, flags);
+	stats = rmnet_stats_begin(&flags);
+	stats->checksum_ul_stats[rc]++;
+	rmnet_stats_end(stats, flags);
 }
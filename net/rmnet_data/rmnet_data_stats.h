@@ -39,6 +39,7 @@ enum rmnet_skb_free_e {
 	RMNET_STATS_SKBFREE_DEAGG_UNKOWN_IP_TYP,
 	RMNET_STATS_SKBFREE_DEAGG_DATA_LEN_0,
 	RMNET_STATS_SKBFREE_INGRESS_BAD_MAP_CKSUM,
+	RMNET_STATS_SKBFREE_STEER_BACKLOG_FULL,
 	RMNET_STATS_SKBFREE_MAX
 };
 
@@ -51,6 +52,9 @@ enum rmnet_queue_xmit_e {
 	RMNET_STATS_QUEUE_XMIT_MAX
 };
 
+/* Buckets of the aggregation histograms: 1, 2-3, 4-7, ... 128+ packets */
+#define RMNET_STATS_AGG_HIST_MAX 8
+
 void rmnet_kfree_skb(struct sk_buff *skb, unsigned int reason);
 void rmnet_stats_queue_xmit(int rc, unsigned int reason);
 void rmnet_stats_deagg_pkts(int aggcount);
@@ -23,6 +23,8 @@
 #include <linux/spinlock.h>
 #include <net/pkt_sched.h>
 #include <linux/atomic.h>
+#include <linux/percpu.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/net_map.h>
 #include "rmnet_data_config.h"
 #include "rmnet_data_handlers.h"
@@ -55,9 +57,23 @@ struct rmnet_map_flow_mapping_s {
 	atomic_t v6_seq;
 };
 
+/**
+ * struct rmnet_vnd_pcpu_stats_s - Per-CPU VND traffic counters
+ *
+ * Read through rmnet_vnd_get_stats64(). Rare error counters stay in dev->stats
+ */
+struct rmnet_vnd_pcpu_stats_s {
+	u64 rx_packets;
+	u64 rx_bytes;
+	u64 tx_packets;
+	u64 tx_bytes;
+	struct u64_stats_sync syncp;
+};
+
 struct rmnet_vnd_private_s {
 	uint32_t qos_version;
 	struct rmnet_logical_ep_conf_s local_ep;
+	struct rmnet_vnd_pcpu_stats_s __percpu *pcpu_stats;
 
 	rwlock_t flow_map_lock;
 	struct list_head flow_head;
@@ -119,11 +135,18 @@ static void rmnet_vnd_add_qos_header(struct sk_buff *skb,
  */
 int rmnet_vnd_rx_fixup(struct sk_buff *skb, struct net_device *dev)
 {
+	struct rmnet_vnd_private_s *dev_conf;
+	struct rmnet_vnd_pcpu_stats_s *stats;
+
 	if (unlikely(!dev || !skb))
 		BUG();
 
-	dev->stats.rx_packets++;
-	dev->stats.rx_bytes += skb->len;
+	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	stats = this_cpu_ptr(dev_conf->pcpu_stats);
+	u64_stats_update_begin(&stats->syncp);
+	stats->rx_packets++;
+	stats->rx_bytes += skb->len;
+	u64_stats_update_end(&stats->syncp);
 
 	return RX_HANDLER_PASS;
 }
@@ -142,13 +165,17 @@ int rmnet_vnd_rx_fixup(struct sk_buff *skb, struct net_device *dev)
 int rmnet_vnd_tx_fixup(struct sk_buff *skb, struct net_device *dev)
 {
 	struct rmnet_vnd_private_s *dev_conf;
-	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	struct rmnet_vnd_pcpu_stats_s *stats;
 
 	if (unlikely(!dev || !skb))
 		BUG();
 
-	dev->stats.tx_packets++;
-	dev->stats.tx_bytes += skb->len;
+	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	stats = this_cpu_ptr(dev_conf->pcpu_stats);
+	u64_stats_update_begin(&stats->syncp);
+	stats->tx_packets++;
+	stats->tx_bytes += skb->len;
+	u64_stats_update_end(&stats->syncp);
 
 	return RX_HANDLER_PASS;
 }
@@ -461,8 +488,86 @@ static int rmnet_vnd_ioctl(struct net_device *dev, struct ifreq *ifr, int cmd)
 	return rc;
 }
 
+/**
+ * rmnet_vnd_dev_init() - Init NDO callback
+ * @dev:         Virtual network device
+ *
+ * Allocates the per-CPU traffic counters.
+ *
+ * Return:
+ *      - 0 if successful
+ *      - -ENOMEM if counters cannot be allocated
+ */
+static int rmnet_vnd_dev_init(struct net_device *dev)
+{
+	struct rmnet_vnd_private_s *dev_conf;
+
+	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	dev_conf->pcpu_stats = alloc_percpu(struct rmnet_vnd_pcpu_stats_s);
+	if (!dev_conf->pcpu_stats)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/**
+ * rmnet_vnd_dev_uninit() - Uninit NDO callback
+ * @dev:         Virtual network device
+ */
+static void rmnet_vnd_dev_uninit(struct net_device *dev)
+{
+	struct rmnet_vnd_private_s *dev_conf;
+
+	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	free_percpu(dev_conf->pcpu_stats);
+	dev_conf->pcpu_stats = 0;
+}
+
+/**
+ * rmnet_vnd_get_stats64() - Get stats NDO callback
+ * @dev:         Virtual network device
+ * @storage:     Statistics to fill in
+ *
+ * Sums the per-CPU traffic counters on top of dev->stats.
+ *
+ * Return:
+ *      - storage
+ */
+static struct rtnl_link_stats64 *rmnet_vnd_get_stats64(struct net_device *dev,
+					struct rtnl_link_stats64 *storage)
+{
+	struct rmnet_vnd_private_s *dev_conf;
+	struct rmnet_vnd_pcpu_stats_s *stats;
+	u64 rx_packets, rx_bytes, tx_packets, tx_bytes;
+	unsigned int start;
+	int cpu;
+
+	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	netdev_stats_to_stats64(storage, &dev->stats);
+
+	for_each_possible_cpu(cpu) {
+		stats = per_cpu_ptr(dev_conf->pcpu_stats, cpu);
+		do {
+			start = u64_stats_fetch_begin_bh(&stats->syncp);
+			rx_packets = stats->rx_packets;
+			rx_bytes = stats->rx_bytes;
+			tx_packets = stats->tx_packets;
+			tx_bytes = stats->tx_bytes;
+		} while (u64_stats_fetch_retry_bh(&stats->syncp, start));
+
+		storage->rx_packets += rx_packets;
+		storage->rx_bytes += rx_bytes;
+		storage->tx_packets += tx_packets;
+		storage->tx_bytes += tx_bytes;
+	}
+
+	return storage;
+}
+
 static const struct net_device_ops rmnet_data_vnd_ops = {
-	.ndo_init = 0,
+	.ndo_init = rmnet_vnd_dev_init,
+	.ndo_uninit = rmnet_vnd_dev_uninit,
+	.ndo_get_stats64 = rmnet_vnd_get_stats64,
 	.ndo_start_xmit = rmnet_vnd_start_xmit,
 	.ndo_do_ioctl = rmnet_vnd_ioctl,
 	.ndo_change_mtu = rmnet_vnd_change_mtu,
@@ -651,6 +756,7 @@ int rmnet_vnd_free_dev(int id)
 
 	if (dev) {
 		unregister_netdev(dev);
+		rmnet_steer_flush_dev(dev);
 		free_netdev(dev);
 		return 0;
 	} else {
@@ -127,6 +127,12 @@ enum rmnet_map_agg_state_e {
 	RMNET_MAP_TXFER_SCHEDULED
 };
 
+#define RMNET_MAP_AGG_MIN_TIME_NS   100000
+
+/* Linear bytes of a zero-copy deaggregated frame: MAP + IP + L4 headers */
+#define RMNET_MAP_DEAGG_HDR_LEN     128
+#define RMNET_MAP_DEAGG_HEADROOM    NET_SKB_PAD
+
 #define RMNET_MAP_COMMAND_REQUEST     0
 #define RMNET_MAP_COMMAND_ACK         1
 #define RMNET_MAP_COMMAND_UNSUPPORTED 2
@@ -142,6 +148,9 @@ rx_handler_result_t rmnet_map_command(struct sk_buff *skb,
 				      struct rmnet_phys_ep_conf_s *config);
 void rmnet_map_aggregate(struct sk_buff *skb,
 			 struct rmnet_phys_ep_conf_s *config);
+void rmnet_map_agg_init(struct rmnet_phys_ep_conf_s *config);
+void rmnet_map_agg_reset(struct rmnet_phys_ep_conf_s *config);
+void rmnet_map_agg_cleanup(struct rmnet_phys_ep_conf_s *config);
 
 int rmnet_map_checksum_downlink_packet(struct sk_buff *skb);
 int rmnet_map_checksum_uplink_packet(struct sk_buff *skb,
@@ -20,7 +20,8 @@
 #include <linux/netdevice.h>
 #include <linux/rmnet_data.h>
 #include <linux/spinlock.h>
-#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 #include <linux/net_map.h>
 #include <linux/ip.h>
 #include <linux/ipv6.h>
@@ -38,11 +39,10 @@
 
 RMNET_LOG_MODULE(RMNET_DATA_LOGMASK_MAPD);
 
-/* ***************** Local Definitions ************************************** */
-struct agg_work {
-	struct delayed_work work;
-	struct rmnet_phys_ep_conf_s *config;
-};
+unsigned int rmnet_map_deagg_frags = 1;
+module_param(rmnet_map_deagg_frags, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rmnet_map_deagg_frags,
+		 "Deaggregate into page fragments instead of clones");
 
 /******************************************************************************/
 
@@ -102,15 +102,62 @@ done:
 	return map_header;
 }
 
+/**
+ * rmnet_map_deaggregate_frag() - Builds a page fragment skb for one MAP frame
+ * @skb:        Source socket buffer with a page fragment head
+ * @packet_len: Length of the MAP frame at skb->data, including MAP header
+ *
+ * Only the first RMNET_MAP_DEAGG_HDR_LEN bytes (MAP, IP and transport headers)
+ * are copied into the linear area of the new skb. The rest of the frame stays
+ * in the page of the source skb, which gains one reference per frame. Unlike a
+ * clone, the new skb does not share the source skb head, so the stack may
+ * modify its headers without unsharing the whole aggregate.
+ *
+ * Return:
+ *     - Pointer to new skb
+ *     - 0 (null) if allocation fails
+ */
+static struct sk_buff *rmnet_map_deaggregate_frag(struct sk_buff *skb,
+						  uint32_t packet_len)
+{
+	struct sk_buff *skbn;
+	struct page *page;
+	uint32_t hdr_len, offset;
+
+	hdr_len = min_t(uint32_t, packet_len, RMNET_MAP_DEAGG_HDR_LEN);
+	skbn = alloc_skb(RMNET_MAP_DEAGG_HEADROOM + hdr_len, GFP_ATOMIC);
+	if (!skbn)
+		return 0;
+
+	skb_reserve(skbn, RMNET_MAP_DEAGG_HEADROOM);
+	skbn->dev = skb->dev;
+	memcpy(skb_put(skbn, hdr_len), skb->data, hdr_len);
+
+	if (packet_len > hdr_len) {
+		page = virt_to_head_page(skb->data);
+		offset = skb->data + hdr_len
+			 - (unsigned char *)page_address(page);
+		get_page(page);
+		skb_add_rx_frag(skbn, 0, page, offset, packet_len - hdr_len,
+				packet_len - hdr_len);
+	}
+
+	skb_pull(skb, packet_len);
+	return skbn;
+}
+
 /**
  * rmnet_map_deaggregate() - Deaggregates a single packet
  * @skb:        Source socket buffer containing multiple MAP frames
  * @config:     Physical endpoint configuration of the ingress device
  *
- * Source skb is cloned with skb_clone(). The new skb data and tail pointers are
- * modified to contain a single MAP frame. Clone happens with GFP_ATOMIC flags
- * set. User should keep calling deaggregate() on the source skb until 0 is
- * returned, indicating that there are no more packets to deaggregate.
+ * When the source skb head is a page fragment, each MAP frame is returned as a
+ * page fragment skb referencing the source page; see
+ * rmnet_map_deaggregate_frag(). Otherwise the source skb is cloned with
+ * skb_clone() and the new skb data and tail pointers are modified to contain a
+ * single MAP frame. Allocations happen with GFP_ATOMIC flags set. User should
+ * keep calling deaggregate() on the source skb until 0 is returned, indicating
+ * that there are no more packets to deaggregate.
  *
  * Return:
  *     - Pointer to new skb
@@ -139,15 +186,22 @@ struct sk_buff *rmnet_map_deaggregate(struct sk_buff *skb,
 		return 0;
 	}
 
-	skbn = skb_clone(skb, GFP_ATOMIC);
-	if (!skbn)
-		return 0;
-
-	LOGD("Trimming to %d bytes", packet_len);
-	LOGD("before skbn->len = %d", skbn->len);
-	skb_trim(skbn, packet_len);
-	skb_pull(skb, packet_len);
-	LOGD("after skbn->len = %d", skbn->len);
+	if (rmnet_map_deagg_frags && skb->head_frag
+	    && !skb_is_nonlinear(skb)) {
+		skbn = rmnet_map_deaggregate_frag(skb, packet_len);
+		if (!skbn)
+			return 0;
+	} else {
+		skbn = skb_clone(skb, GFP_ATOMIC);
+		if (!skbn)
+			return 0;
+
+		LOGD("Trimming to %d bytes", packet_len);
+		LOGD("before skbn->len = %d", skbn->len);
+		skb_trim(skbn, packet_len);
+		skb_pull(skb, packet_len);
+		LOGD("after skbn->len = %d", skbn->len);
+	}
 
 	/* Some hardware can send us empty frames. Catch them */
 	if (ntohs(maph->pkt_len) == 0) {
@@ -167,26 +221,65 @@ struct sk_buff *rmnet_map_deaggregate(struct sk_buff *skb,
 	return skbn;
 }
 
+/**
+ * rmnet_map_agg_adapt() - Adapts aggregation limits to the packet rate
+ * @config:     Physical endpoint configuration of the egress device
+ * @full:       1 if the buffer is flushed because it is full, 0 if because the
+ *              flush timer expired
+ *
+ * A full buffer means packets arrive faster than the flush timeout, so both
+ * the timeout and the early flush count are doubled up to their configured
+ * limits. A timer flush means traffic is sparse: the timeout is halved down to
+ * RMNET_MAP_AGG_MIN_TIME_NS and the count limit follows the number of packets
+ * seen in the last window. Must be called with agg_lock held.
+ */
+static void rmnet_map_agg_adapt(struct rmnet_phys_ep_conf_s *config, int full)
+{
+	uint32_t time_limit;
+	unsigned int count_limit;
+
+	if (!config->egress_agg_adaptive)
+		return;
+
+	time_limit = max_t(uint32_t, RMNET_MAP_AGG_MIN_TIME_NS,
+			   config->egress_agg_time_limit * NSEC_PER_USEC);
+	count_limit = config->egress_agg_count ?
+		      min_t(unsigned int, config->egress_agg_count, U8_MAX) :
+		      U8_MAX;
+
+	if (full) {
+		config->agg_time = min_t(uint32_t, config->agg_time * 2,
+					 time_limit);
+		config->agg_count_limit = min_t(unsigned int,
+						config->agg_count_limit * 2,
+						count_limit);
+	} else {
+		config->agg_time = max_t(uint32_t, config->agg_time / 2,
+					 RMNET_MAP_AGG_MIN_TIME_NS);
+		config->agg_count_limit = clamp_t(unsigned int,
+						  config->agg_count * 2,
+						  2, count_limit);
+	}
+}
+
 /**
  * rmnet_map_flush_packet_queue() - Transmits aggregeted frame on timeout
- * @work:        struct agg_work containing delayed work and skb to flush
+ * @data:        struct rmnet_phys_ep_conf_s containing the skb to flush
  *
- * This function is scheduled to run in a specified number of jiffies after
- * the last frame transmitted by the network stack. When run, the buffer
+ * This tasklet is scheduled by the aggregation timer once the flush timeout
+ * has passed since the first frame entered the buffer. When run, the buffer
  * containing aggregated packets is finally transmitted on the underlying link.
  *
  */
-static void rmnet_map_flush_packet_queue(struct work_struct *work)
+static void rmnet_map_flush_packet_queue(unsigned long data)
 {
-	struct agg_work *real_work;
 	struct rmnet_phys_ep_conf_s *config;
 	unsigned long flags;
 	struct sk_buff *skb;
 	int rc, agg_count = 0;
 
 	skb = 0;
-	real_work = (struct agg_work *)work;
-	config = real_work->config;
+	config = (struct rmnet_phys_ep_conf_s *)data;
 	LOGD("%s", "Entering flush thread");
 	spin_lock_irqsave(&config->agg_lock, flags);
 	if (likely(config->agg_state == RMNET_MAP_TXFER_SCHEDULED)) {
@@ -195,9 +288,11 @@ static void rmnet_map_flush_packet_queue(struct work_struct *work)
 			rmnet_stats_agg_pkts(config->agg_count);
 			if (config->agg_count > 1)
 				LOGL("Agg count: %d", config->agg_count);
+			rmnet_map_agg_adapt(config, 0);
 			skb = config->agg_skb;
 			agg_count = config->agg_count;
 			config->agg_skb = 0;
+			config->agg_count = 0;
 		}
 		config->agg_state = RMNET_MAP_AGG_IDLE;
 	} else {
@@ -212,7 +307,87 @@ static void rmnet_map_flush_packet_queue(struct work_struct *work)
 		rc = dev_queue_xmit(skb);
 		rmnet_stats_queue_xmit(rc, RMNET_STATS_QUEUE_XMIT_AGG_TIMEOUT);
 	}
-	kfree(work);
+}
+
+/**
+ * rmnet_map_agg_timer_expired() - Aggregation flush timer callback
+ * @timer:       agg_timer of the physical endpoint
+ *
+ * Runs in hard irq context, so the transmit is deferred to the flush tasklet.
+ *
+ * Return:
+ *      - HRTIMER_NORESTART always
+ */
+static enum hrtimer_restart rmnet_map_agg_timer_expired(struct hrtimer *timer)
+{
+	struct rmnet_phys_ep_conf_s *config;
+
+	config = container_of(timer, struct rmnet_phys_ep_conf_s, agg_timer);
+	tasklet_schedule(&config->agg_tasklet);
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * rmnet_map_agg_init() - Initializes aggregation state of a physical endpoint
+ * @config:     Physical endpoint configuration of the egress device
+ *
+ * Flush timeout defaults to one jiffy and adaptive mode is off.
+ */
+void rmnet_map_agg_init(struct rmnet_phys_ep_conf_s *config)
+{
+	spin_lock_init(&config->agg_lock);
+	hrtimer_init(&config->agg_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	config->agg_timer.function = rmnet_map_agg_timer_expired;
+	tasklet_init(&config->agg_tasklet, rmnet_map_flush_packet_queue,
+		     (unsigned long)config);
+	config->egress_agg_time_limit = jiffies_to_usecs(1);
+	config->egress_agg_adaptive = 0;
+	rmnet_map_agg_reset(config);
+}
+
+/**
+ * rmnet_map_agg_reset() - Restarts adaptive aggregation from its limits
+ * @config:     Physical endpoint configuration of the egress device
+ *
+ * Called whenever the aggregation parameters change.
+ */
+void rmnet_map_agg_reset(struct rmnet_phys_ep_conf_s *config)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&config->agg_lock, flags);
+	config->agg_time = config->egress_agg_time_limit * NSEC_PER_USEC;
+	config->agg_count_limit = config->egress_agg_count ?
+		min_t(unsigned int, config->egress_agg_count, U8_MAX) :
+		U8_MAX;
+	if (config->egress_agg_adaptive
+	    && config->agg_time < RMNET_MAP_AGG_MIN_TIME_NS)
+		config->agg_time = RMNET_MAP_AGG_MIN_TIME_NS;
+	spin_unlock_irqrestore(&config->agg_lock, flags);
+}
+
+/**
+ * rmnet_map_agg_cleanup() - Stops aggregation on a physical endpoint
+ * @config:     Physical endpoint configuration of the egress device
+ *
+ * Cancels the flush timer and tasklet and drops any partially filled buffer.
+ * Must be called before config is freed.
+ */
+void rmnet_map_agg_cleanup(struct rmnet_phys_ep_conf_s *config)
+{
+	unsigned long flags;
+
+	hrtimer_cancel(&config->agg_timer);
+	tasklet_kill(&config->agg_tasklet);
+
+	spin_lock_irqsave(&config->agg_lock, flags);
+	if (config->agg_skb) {
+		kfree_skb(config->agg_skb);
+		config->agg_skb = 0;
+	}
+	config->agg_count = 0;
+	config->agg_state = RMNET_MAP_AGG_IDLE;
+	spin_unlock_irqrestore(&config->agg_lock, flags);
 }
 
 /**
@@ -227,7 +402,6 @@ static void rmnet_map_flush_packet_queue(struct work_struct *work)
 void rmnet_map_aggregate(struct sk_buff *skb,
 			 struct rmnet_phys_ep_conf_s *config) {
 	uint8_t *dest_buff;
-	struct agg_work *work;
 	unsigned long flags;
 	struct sk_buff *agg_skb;
 	int size, rc, agg_count = 0;
@@ -267,6 +441,7 @@ new_packet:
 		rmnet_stats_agg_pkts(config->agg_count);
 		if (config->agg_count > 1)
 			LOGL("Agg count: %d", config->agg_count);
+		rmnet_map_agg_adapt(config, 1);
 		agg_skb = config->agg_skb;
 		agg_count = config->agg_count;
 		config->agg_skb = 0;
@@ -284,22 +459,27 @@ new_packet:
 	config->agg_count++;
 	rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_AGG_INTO_BUFF);
 
+	if (config->egress_agg_adaptive
+	    && config->agg_count >= config->agg_count_limit) {
+		rmnet_stats_agg_pkts(config->agg_count);
+		rmnet_map_agg_adapt(config, 1);
+		agg_skb = config->agg_skb;
+		agg_count = config->agg_count;
+		config->agg_skb = 0;
+		config->agg_count = 0;
+		spin_unlock_irqrestore(&config->agg_lock, flags);
+		trace_rmnet_map_aggregate(agg_skb, agg_count);
+		rc = dev_queue_xmit(agg_skb);
+		rmnet_stats_queue_xmit(rc,
+					RMNET_STATS_QUEUE_XMIT_AGG_FILL_BUFFER);
+		return;
+	}
+
 schedule:
 	if (config->agg_state != RMNET_MAP_TXFER_SCHEDULED) {
-		work = (struct agg_work *)
-			kmalloc(sizeof(struct agg_work), GFP_ATOMIC);
-		if (!work) {
-			LOGE("Failed to allocate work item for packet %s",
-			     "transfer. DATA PATH LIKELY BROKEN!");
-			config->agg_state = RMNET_MAP_AGG_IDLE;
-			spin_unlock_irqrestore(&config->agg_lock, flags);
-			return;
-		}
-		INIT_DELAYED_WORK((struct delayed_work *)work,
-				  rmnet_map_flush_packet_queue);
-		work->config = config;
 		config->agg_state = RMNET_MAP_TXFER_SCHEDULED;
-		schedule_delayed_work((struct delayed_work *)work, 1);
+		hrtimer_start(&config->agg_timer, ns_to_ktime(config->agg_time),
+			      HRTIMER_MODE_REL);
 	}
 	spin_unlock_irqrestore(&config->agg_lock, flags);
 	return;
@@ -554,7 +734,7 @@ static int rmnet_map_validate_ipv6_packet_checksum(unsigned char *map_payload,
  */
 int rmnet_map_checksum_downlink_packet(struct sk_buff *skb)
 {
-	struct rmnet_map_dl_checksum_trailer_s *cksum_trailer;
+	struct rmnet_map_dl_checksum_trailer_s *cksum_trailer, trailer;
 	unsigned int data_len;
 	unsigned char *map_payload;
 	unsigned char ip_version;
@@ -565,9 +745,12 @@ int rmnet_map_checksum_downlink_packet(struct sk_buff *skb)
 	    sizeof(struct rmnet_map_dl_checksum_trailer_s))))
 		return RMNET_MAP_CHECKSUM_ERR_BAD_BUFFER;
 
-	cksum_trailer = (struct rmnet_map_dl_checksum_trailer_s *)
-			(skb->data + data_len
-			+ sizeof(struct rmnet_map_header_s));
+	/* Trailer may sit in a page fragment after zero-copy deaggregation */
+	cksum_trailer = skb_header_pointer(skb,
+			data_len + sizeof(struct rmnet_map_header_s),
+			sizeof(trailer), &trailer);
+	if (unlikely(!cksum_trailer))
+		return RMNET_MAP_CHECKSUM_ERR_BAD_BUFFER;
 
 	if (unlikely(!ntohs(cksum_trailer->valid)))
 		return RMNET_MAP_CHECKSUM_VALID_FLAG_NOT_SET;
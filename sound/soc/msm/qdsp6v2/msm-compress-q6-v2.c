@@ -63,6 +63,8 @@
 #define COMPR_PLAYBACK_MAX_FRAGMENT_SIZE (128 * 1024)
 #define COMPR_PLAYBACK_MIN_NUM_FRAGMENTS (4)
 #define COMPR_PLAYBACK_MAX_NUM_FRAGMENTS (16 * 4)
+/* whole fragments merged into one DSP write when the app is ahead */
+#define COMPR_PLAYBACK_MAX_FRAGMENTS_PER_WRITE (4)
 
 #define COMPRESSED_LR_VOL_MAX_STEPS	0x2000
 const DECLARE_TLV_DB_LINEAR(msm_compr_vol_gain, 0,
@@ -353,6 +355,16 @@ static int msm_compr_send_buffer(struct msm_compr_audio *prtd)
 	bytes_available = prtd->bytes_received - prtd->copied_total;
 	if (bytes_available < prtd->codec_param.buffer.fragment_size)
 		buffer_length = bytes_available;
+	else if (!atomic_read(&prtd->drain))
+		/*
+		 * Each write done wakes the AP, so hand the DSP every whole
+		 * fragment already queued in one write. Drain keeps single
+		 * fragments so the last buffer is still flagged.
+		 */
+		buffer_length = rounddown(min_t(int, bytes_available,
+				buffer_length *
+				COMPR_PLAYBACK_MAX_FRAGMENTS_PER_WRITE),
+				buffer_length);
 
 	if (prtd->byte_offset + buffer_length > prtd->buffer_size) {
 		buffer_length = (prtd->buffer_size - prtd->byte_offset);
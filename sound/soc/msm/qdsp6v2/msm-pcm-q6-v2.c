@@ -65,6 +65,8 @@ struct snd_msm {
 #define CAPTURE_MAX_PERIOD_SIZE     4096
 #define CAPTURE_MIN_PERIOD_SIZE     320
 #define CMD_EOS_MIN_TIMEOUT_LENGTH  50
+/* periods kept queued on the DSP in mmap playback */
+#define PLAYBACK_MMAP_QUEUED_PERIODS 2
 #define CMD_EOS_TIMEOUT_MULTIPLIER  (HZ * 50)
 
 static struct snd_pcm_hardware msm_pcm_hardware_capture = {
@@ -152,6 +154,7 @@ static void event_handler(uint32_t opcode,
 	uint32_t *ptrmem = (uint32_t *)payload;
 	uint32_t idx = 0;
 	uint32_t size = 0;
+	unsigned int queued;
 
 	switch (opcode) {
 	case ASM_DATA_EVENT_WRITE_DONE_V2: {
@@ -234,12 +237,22 @@ static void event_handler(uint32_t opcode,
 				break;
 			}
 			if (prtd->mmap_flag) {
-				pr_debug("%s:writing %d bytes of buffer to dsp\n",
-					__func__,
-					prtd->pcm_count);
-				q6asm_write_nolock(prtd->audio_client,
-					prtd->pcm_count,
-					0, 0, NO_TIMESTAMP);
+				/*
+				 * Keep a period queued behind the one being
+				 * rendered, so the DSP does not wait on the
+				 * write done round trip between periods.
+				 */
+				queued = min_t(unsigned int,
+					substream->runtime->periods,
+					PLAYBACK_MMAP_QUEUED_PERIODS);
+				while (queued--) {
+					pr_debug("%s:writing %d bytes of buffer to dsp\n",
+						__func__,
+						prtd->pcm_count);
+					q6asm_write_nolock(prtd->audio_client,
+						prtd->pcm_count,
+						0, 0, NO_TIMESTAMP);
+				}
 			} else {
 				while (atomic_read(&prtd->out_needed)) {
 					pr_debug("%s:writing %d bytes of buffer to dsp\n",
@@ -47,6 +47,8 @@ struct adm_copp {
 	atomic_t topology[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
 	atomic_t mode[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
 	atomic_t stat[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
+	/* SET_PP_PARAMS acks still owed to a calibration batch */
+	atomic_t cal_acks[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
 	atomic_t rate[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
 	atomic_t bit_width[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
 	atomic_t app_type[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
@@ -951,6 +953,8 @@ static int32_t adm_callback(struct apr_client_data *data, void *priv)
 						   0);
 					atomic_set(&this_adm.copp.stat[i][j],
 						   0);
+					atomic_set(
+					    &this_adm.copp.cal_acks[i][j], 0);
 					atomic_set(&this_adm.copp.rate[i][j],
 						   0);
 					atomic_set(
@@ -1031,6 +1035,10 @@ static int32_t adm_callback(struct apr_client_data *data, void *priv)
 				else if (rtac_make_adm_callback(payload,
 							data->payload_size))
 					break;
+				/* wake the sender only on the last batch ack */
+				if (atomic_dec_if_positive(&this_adm.copp.
+					cal_acks[port_idx][copp_idx]) > 0)
+					break;
 				/*
 				 * if soft volume is called and already
 				 * interrupted break out of the sequence here
@@ -1485,6 +1493,10 @@ done:
 	return;
 }
 
+/*
+ * Queue one calibration block to the COPP without waiting for the ack;
+ * send_adm_cal() collects the acks of the whole batch.
+ */
 static int send_adm_cal_block(int port_id, int copp_idx,
 			      struct cal_block_data *cal_block, int perf_mode,
 			      int app_type, int acdb_id, int sample_rate)
@@ -1520,6 +1532,7 @@ static int send_adm_cal_block(int port_id, int copp_idx,
 		pr_err("%s: perf_mode %d, topology 0x%x\n", __func__, perf_mode,
 			atomic_read(
 				&this_adm.copp.topology[port_idx][copp_idx]));
+		result = -EINVAL;
 		goto done;
 	}
 
@@ -1542,7 +1555,6 @@ static int send_adm_cal_block(int port_id, int copp_idx,
 	adm_params.mem_map_handle = cal_block->map_data.q6map_handle;
 	adm_params.payload_size = cal_block->cal_data.size;
 
-	atomic_set(&this_adm.copp.stat[port_idx][copp_idx], 0);
 	pr_debug("%s: Sending SET_PARAMS payload = 0x%pK, size = %d\n",
 		__func__, &cal_block->cal_data.paddr,
 		adm_params.payload_size);
@@ -1555,18 +1567,7 @@ static int send_adm_cal_block(int port_id, int copp_idx,
 		result = -EINVAL;
 		goto done;
 	}
-	/* Wait for the callback */
-	result = wait_event_timeout(this_adm.copp.wait[port_idx][copp_idx],
-		atomic_read(&this_adm.copp.stat[port_idx][copp_idx]),
-		msecs_to_jiffies(TIMEOUT_MS));
-	if (!result) {
-		pr_err("%s: Set params timed out port = 0x%x\n",
-				__func__, port_id);
-		pr_debug("%s: Set params timed out port = 0x%x, payload = 0x%pK\n",
-			__func__, port_id, &cal_block->cal_data.paddr);
-		result = -EINVAL;
-		goto done;
-	}
+	result = 0;
 
 done:
 	return result;
@@ -1670,40 +1671,6 @@ static struct cal_block_data *adm_find_cal(int cal_index, int path,
 	return adm_find_cal_by_app_type(cal_index, path, app_type);
 }
 
-static void send_adm_cal_type(int cal_index, int path, int port_id,
-			      int copp_idx, int perf_mode, int app_type,
-			      int acdb_id, int sample_rate)
-{
-	struct cal_block_data		*cal_block = NULL;
-	int ret;
-
-	pr_debug("%s: cal index %d\n", __func__, cal_index);
-
-	if (this_adm.cal_data[cal_index] == NULL) {
-		pr_debug("%s: cal_index %d not allocated!\n",
-			__func__, cal_index);
-		goto done;
-	}
-
-	mutex_lock(&this_adm.cal_data[cal_index]->lock);
-	cal_block = adm_find_cal(cal_index, path, app_type, acdb_id,
-				sample_rate);
-	if (cal_block == NULL)
-		goto unlock;
-
-	pr_debug("%s: Sending cal_index cal %d\n", __func__, cal_index);
-	remap_cal_data(cal_block, cal_index);
-	ret = send_adm_cal_block(port_id, copp_idx, cal_block, perf_mode,
-				app_type, acdb_id, sample_rate);
-	if (ret < 0)
-		pr_debug("%s: No cal sent for cal_index %d, port_id = 0x%x! ret %d sample_rate %d\n",
-			__func__, cal_index, port_id, ret, sample_rate);
-unlock:
-	mutex_unlock(&this_adm.cal_data[cal_index]->lock);
-done:
-	return;
-}
-
 static int get_cal_path(int path)
 {
 	if (path == 0x1)
@@ -1712,16 +1679,75 @@ static int get_cal_path(int path)
 		return TX_DEVICE;
 }
 
+static const int adm_cal_types[] = { ADM_AUDPROC_CAL, ADM_AUDVOL_CAL };
+
+/*
+ * Send all the COPP calibration types back to back and wait once for the
+ * acks, instead of one round trip per type.  cal_acks holds one count per
+ * command in flight plus a bias dropped after the last send, so an early
+ * ack cannot wake us before the batch is complete.  The cal blocks stay
+ * locked until the DSP has read them.
+ */
 static void send_adm_cal(int port_id, int copp_idx, int path, int perf_mode,
 			 int app_type, int acdb_id, int sample_rate)
 {
+	struct cal_block_data	*cal_block;
+	int			port_idx, cal_index, i, ret;
+
 	pr_debug("%s:\n", __func__);
 
-	send_adm_cal_type(ADM_AUDPROC_CAL, path, port_id, copp_idx, perf_mode,
-			  app_type, acdb_id, sample_rate);
-	send_adm_cal_type(ADM_AUDVOL_CAL, path, port_id, copp_idx, perf_mode,
-			  app_type, acdb_id, sample_rate);
-	return;
+	port_idx = adm_validate_and_get_port_index(
+				afe_convert_virtual_to_portid(port_id));
+	if (port_idx < 0) {
+		pr_err("%s: Invalid port_id 0x%x\n", __func__, port_id);
+		return;
+	}
+
+	atomic_set(&this_adm.copp.stat[port_idx][copp_idx], 0);
+	atomic_set(&this_adm.copp.cal_acks[port_idx][copp_idx], 1);
+
+	for (i = 0; i < ARRAY_SIZE(adm_cal_types); i++) {
+		cal_index = adm_cal_types[i];
+		if (this_adm.cal_data[cal_index] == NULL) {
+			pr_debug("%s: cal_index %d not allocated!\n",
+				__func__, cal_index);
+			continue;
+		}
+
+		mutex_lock(&this_adm.cal_data[cal_index]->lock);
+		cal_block = adm_find_cal(cal_index, path, app_type, acdb_id,
+					sample_rate);
+		if (cal_block == NULL)
+			continue;
+
+		pr_debug("%s: Sending cal_index cal %d\n", __func__, cal_index);
+		remap_cal_data(cal_block, cal_index);
+		atomic_inc(&this_adm.copp.cal_acks[port_idx][copp_idx]);
+		ret = send_adm_cal_block(port_id, copp_idx, cal_block,
+					 perf_mode, app_type, acdb_id,
+					 sample_rate);
+		if (ret < 0) {
+			atomic_dec(&this_adm.copp.cal_acks[port_idx][copp_idx]);
+			pr_debug("%s: No cal sent for cal_index %d, port_id = 0x%x! ret %d sample_rate %d\n",
+				__func__, cal_index, port_id, ret,
+				sample_rate);
+		}
+	}
+
+	if (!atomic_dec_and_test(&this_adm.copp.cal_acks[port_idx][copp_idx]) &&
+	    !wait_event_timeout(this_adm.copp.wait[port_idx][copp_idx],
+		atomic_read(&this_adm.copp.stat[port_idx][copp_idx]),
+		msecs_to_jiffies(TIMEOUT_MS))) {
+		pr_err("%s: Set params timed out port = 0x%x\n",
+			__func__, port_id);
+		atomic_set(&this_adm.copp.cal_acks[port_idx][copp_idx], 0);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(adm_cal_types); i++) {
+		cal_index = adm_cal_types[i];
+		if (this_adm.cal_data[cal_index] != NULL)
+			mutex_unlock(&this_adm.cal_data[cal_index]->lock);
+	}
 }
 
 int adm_connect_afe_port(int mode, int session_id, int port_id)
@@ -3645,6 +3671,7 @@ static int __init adm_init(void)
 			atomic_set(&this_adm.copp.topology[i][j], 0);
 			atomic_set(&this_adm.copp.mode[i][j], 0);
 			atomic_set(&this_adm.copp.stat[i][j], 0);
+			atomic_set(&this_adm.copp.cal_acks[i][j], 0);
 			atomic_set(&this_adm.copp.rate[i][j], 0);
 			atomic_set(&this_adm.copp.bit_width[i][j], 0);
 			atomic_set(&this_adm.copp.app_type[i][j], 0);